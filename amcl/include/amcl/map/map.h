@@ -41,15 +41,15 @@ struct _rtk_fig_t;
 // Limits
 #define MAP_WIFI_MAX_LEVELS 8
 
+// Number of steps between zero and max_occ_dist in the distance field
+#define MAP_OCC_DIST_STEPS 255
+
   
 // Description for a single map cell.
 typedef struct
 {
   // Occupancy state (-1 = free, 0 = unknown, +1 = occ)
-  int occ_state;
-
-  // Distance to the nearest occupied cell
-  double occ_dist;
+  signed char occ_state;
 
   // Wifi levels
   //int wifi_levels[MAP_WIFI_MAX_LEVELS];
@@ -57,6 +57,18 @@ typedef struct
 } map_cell_t;
 
 
+// A run of consecutive free cells (in MAP_INDEX order)
+typedef struct
+{
+  // Index of the first cell of the run
+  int start;
+
+  // Number of free cells in all runs before this one
+  int offset;
+
+} map_free_run_t;
+
+
 // Description for a map
 typedef struct
 {
@@ -75,6 +87,36 @@ typedef struct
   // Max distance at which we care about obstacles, for constructing
   // likelihood field
   double max_occ_dist;
+
+  // Distance to the nearest occupied cell, one byte per cell in steps of
+  // max_occ_dist / MAP_OCC_DIST_STEPS.  Kept apart from the cells so the
+  // likelihood field lookups only touch this plane.
+  unsigned char *occ_dist;
+
+  // Incremented whenever the distance field changes, also in place
+  unsigned int occ_dist_version;
+
+  // The distance field split in tiles of tile_size x tile_size cells, used
+  // instead of occ_dist when tile_size is non-zero.  Tiles are computed on
+  // demand by map_update_tiles(); tiles[] is NULL for tiles that are not
+  // resident, and tile_used holds the last pass that needed every tile.
+  int tile_size, tile_shift;
+  int tiles_x, tiles_y;
+  unsigned char **tiles;
+  unsigned int *tile_used;
+  unsigned int tile_pass;
+  int tile_count, tile_max_count;
+
+  // Precomputed ranges for map_lookup_range(), range_angles directions per
+  // cell, in cells.  Built by map_update_ranges(), NULL if there are none.
+  int range_angles;
+  uint16_t *ranges;
+
+  // Runs of free cells, for drawing free cells uniformly.  Built by
+  // map_update_free(), NULL if there are none.
+  int free_count;
+  int free_run_count;
+  map_free_run_t *free_runs;
   
 } map_t;
 
@@ -93,6 +135,15 @@ void map_free(map_t *map);
 // Get the cell at the given point
 map_cell_t *map_get_cell(map_t *map, double ox, double oy, double oa);
 
+// Index the free cells of the map.  Must be called again when the
+// occupancy changes.  Returns -1 if the index could not be allocated.
+int map_update_free(map_t *map);
+
+// Pick the free cell at the fraction u (0 <= u < 1) of all free cells, so a
+// uniform u gives a uniformly drawn free cell.  Returns -1 if the map has no
+// indexed free cells.
+int map_pick_free(map_t *map, double u, int *i, int *j);
+
 // Load an occupancy map
 int map_load_occ(map_t *map, const char *filename, double scale, int negate);
 
@@ -102,6 +153,37 @@ int map_load_occ(map_t *map, const char *filename, double scale, int negate);
 // Update the cspace distances
 void map_update_cspace(map_t *map, double max_occ_dist);
 
+// Recompute the cspace distances of the cells within max_occ_dist of the
+// given cells (inclusive bounds), after their occupancy changed.  Resident
+// tiles of a tiled field are dropped instead, to be recomputed on demand.
+void map_update_cspace_region(map_t *map, int i0, int j0, int i1, int j1);
+
+// Hash of the occupancy grid and its geometry, which is all the cspace
+// distances depend on
+uint64_t map_hash_occ(map_t *map);
+
+// Save the cspace distances.  The file is a fixed size header followed by
+// the raw distance plane, so it can be read back, or memory mapped, without
+// any parsing.  Returns -1 on error.
+int map_save_cspace(map_t *map, const char *filename);
+
+// Split the cspace distances for max_occ_dist in tiles of at least
+// tile_size cells square, of which at most max_tiles are kept in memory
+// besides the ones the last map_update_tiles() needed.  Does nothing if the
+// map is already tiled that way.  A tile_size of zero drops the tiles.
+// Returns -1 if the tiles could not be allocated.
+int map_set_tiles(map_t *map, double max_occ_dist, int tile_size, int max_tiles);
+
+// Make the tiles covering the given cells (inclusive bounds) resident,
+// evicting the tiles needed longest ago.  Returns the number of tiles that
+// were computed, or -1 if a tile could not be allocated.
+int map_update_tiles(map_t *map, int i0, int j0, int i1, int j1);
+
+// Load cspace distances saved by map_save_cspace().  Only succeeds if they
+// were computed for the same occupancy grid and max_occ_dist; returns -1
+// otherwise, leaving the map untouched.
+int map_load_cspace(map_t *map, double max_occ_dist, const char *filename);
+
 
 /**************************************************************************
  * Range functions
@@ -110,6 +192,16 @@ void map_update_cspace(map_t *map, double max_occ_dist);
 // Extract a single range reading from the map
 double map_calc_range(map_t *map, double ox, double oy, double oa, double max_range);
 
+// Precompute the range readings of every cell for the given number of evenly
+// spaced directions, zero directions drops the table.  Returns -1 if the table
+// could not be allocated.
+int map_update_ranges(map_t *map, int angles);
+
+// Extract a single range reading from the precomputed ranges, rounding the
+// angle to the nearest direction of the table.  Uses map_calc_range() if the
+// map has no table.
+double map_lookup_range(map_t *map, double ox, double oy, double oa, double max_range);
+
 
 /**************************************************************************
  * GUI/diagnostic functions
@@ -143,6 +235,33 @@ void map_draw_wifi(map_t *map, struct _rtk_fig_t *fig, int index);
 // Compute the cell index for the given map coords.
 #define MAP_INDEX(map, i, j) ((i) + (j) * map->size_x)
 
+// Convert a step of the distance field to a distance in meters
+#define MAP_OCC_DIST(map, step) ((step) * map->max_occ_dist / MAP_OCC_DIST_STEPS)
+
+// Index of the given map coords in the distance field, which is MAP_INDEX()
+// unless the field is tiled
+static inline int map_dist_index(const map_t *map, int i, int j)
+{
+  int s = map->tile_shift, m = map->tile_size - 1;
+  if (map->tile_size == 0)
+    return MAP_INDEX(map, i, j);
+  return ((((j >> s) * map->tiles_x + (i >> s)) << (2 * s)) |
+          ((j & m) << s) | (i & m));
+}
+
+// Step of the distance field at the given index; cells of tiles that are
+// not resident are as far from any obstacle as the field goes
+static inline unsigned char map_dist_at(const map_t *map, int index)
+{
+  const unsigned char *tile;
+  if (map->tile_size == 0)
+    return map->occ_dist[index];
+  tile = map->tiles[index >> (2 * map->tile_shift)];
+  if (tile == NULL)
+    return MAP_OCC_DIST_STEPS;
+  return tile[index & ((1 << (2 * map->tile_shift)) - 1)];
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -55,16 +55,14 @@ typedef double (*pf_sensor_model_fn_t) (void *sensor_data,
                                         struct _pf_sample_set_t* set);
 
 
-// Information for a single sample
-typedef struct
+// The ways to draw the samples of a new set from the current one
+typedef enum
 {
-  // Pose represented by this sample
-  pf_vector_t pose;
-
-  // Weight for this pose
-  double weight;
-  
-} pf_sample_t;
+  // Draw every sample independently
+  PF_RESAMPLE_MULTINOMIAL,
+  // Draw all samples with one walk over the weights at evenly spaced offsets
+  PF_RESAMPLE_SYSTEMATIC
+} pf_resample_model_t;
 
 
 // Information for a cluster of samples
@@ -89,9 +87,11 @@ typedef struct
 // Information for a set of samples
 typedef struct _pf_sample_set_t
 {
-  // The samples
+  // The samples, stored as one array per pose component and one for the
+  // weights so loops over the samples can be vectorized
   int sample_count;
-  pf_sample_t *samples;
+  double *x, *y, *theta;
+  double *weight;
 
   // A kdtree encoding the histogram
   pf_kdtree_t *kdtree;
@@ -104,6 +104,10 @@ typedef struct _pf_sample_set_t
   pf_vector_t mean;
   pf_matrix_t cov;
   int converged; 
+
+  // The bounds of the x and y positions of the samples, computed with the
+  // other statistics
+  double min[2], max[2];
 } pf_sample_set_t;
 
 
@@ -115,6 +119,14 @@ typedef struct _pf_t
 
   // Population size parameters
   double pop_err, pop_z;
+
+  // The population error used while the filter is converged, a larger
+  // value shrinks the sample set of a converged filter further; ignored
+  // when not above pop_err
+  double converged_pop_err;
+
+  // How the samples are drawn when resampling
+  pf_resample_model_t resample_model;
   
   // The sample sets.  We keep two sets and use [current_set]
   // to identify the active set.
@@ -133,9 +145,20 @@ typedef struct _pf_t
 
   double dist_threshold; //distance threshold in each axis over which the pf is considered to not be converged
   int converged; 
+
+  // When timing is set, the wall time (s) the last resample spent on
+  // clustering the new samples
+  int timing;
+  double cluster_time;
 } pf_t;
 
 
+// Get the pose of a sample
+pf_vector_t pf_get_sample_pose(pf_sample_set_t *set, int i);
+
+// Set the pose of a sample
+void pf_set_sample_pose(pf_sample_set_t *set, int i, pf_vector_t pose);
+
 // Create a new filter
 pf_t *pf_alloc(int min_samples, int max_samples,
                double alpha_slow, double alpha_fast,
@@ -181,6 +204,8 @@ void pf_draw_cluster_stats(pf_t *pf, struct _rtk_fig_t *fig);
 
 //calculate if the particle filter has converged - 
 //and sets the converged flag in the current set and the pf 
+//the statistics of the current set have to be up to date and its
+//samples equally weighted, as they are after resampling
 int pf_update_converged(pf_t *pf);
 
 //sets the current set and pf converged values to zero
@@ -19,7 +19,7 @@
  *
  */
 /**************************************************************************
- * Desc: KD tree functions
+ * Desc: KD tree functions (a hashed histogram over poses)
  * Author: Andrew Howard
  * Date: 18 Dec 2002
  * CVS: $Id: pf_kdtree.h 6532 2008-06-11 02:45:56Z gbiggs $
@@ -32,45 +32,55 @@
 #include "rtk.h"
 #endif
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 
-// Info for a node in the tree
+// Info for a histogram cell (a leaf of the old kd tree)
 typedef struct pf_kdtree_node
 {
-  // Depth in the tree
-  int leaf, depth;
-
-  // Pivot dimension and value
-  int pivot_dim;
-  double pivot_value;
-
   // The key for this node
   int key[3];
 
   // The value for this node
   double value;
 
-  // The cluster label (leaf nodes)
+  // Moments of the samples in this node, weighted by their values: the
+  // sample count, the sums of x, y, cos(theta) and sin(theta), and the
+  // second moments of x and y
+  int count;
+  double m[4], c[2][2];
+
+  // The bounds of the x and y positions of the samples in this node
+  double min[2], max[2];
+
+  // The cluster label
   int cluster;
 
-  // Child nodes
-  struct pf_kdtree_node *children[2];
+  // Slot of this node in the hash table
+  int slot;
 
 } pf_kdtree_node_t;
 
 
-// A kd tree
+// A histogram over discretized poses.  Cells are allocated from a fixed
+// pool and found through an open-addressing hash table on the key, so
+// inserts and lookups are constant time.
 typedef struct
 {
   // Cell size
   double size[3];
 
-  // The root node of the tree
-  pf_kdtree_node_t *root;
-
-  // The number of nodes in the tree
+  // The number of nodes in the pool
   int node_count, node_max_count;
   pf_kdtree_node_t *nodes;
 
+  // Hash table of node indices (-1 for empty slots); the size is a
+  // power of two larger than twice the pool size
+  int table_size;
+  int *table;
+
   // The number of leaf nodes in the tree
   int leaf_count;
 
@@ -86,7 +96,7 @@ extern void pf_kdtree_free(pf_kdtree_t *self);
 // Clear all entries from the tree
 extern void pf_kdtree_clear(pf_kdtree_t *self);
 
-// Insert a pose into the tree
+// Insert a pose into the tree, adding it to the moments of its node
 extern void pf_kdtree_insert(pf_kdtree_t *self, pf_vector_t pose, double value);
 
 // Cluster the leaves in the tree
@@ -106,4 +116,8 @@ extern void pf_kdtree_draw(pf_kdtree_t *self, rtk_fig_t *fig);
 
 #endif
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -28,6 +28,8 @@
 #ifndef PF_PDF_H
 #define PF_PDF_H
 
+#include <stdint.h>
+
 #include "pf_vector.h"
 
 //#include <gsl/gsl_rng.h>
@@ -79,6 +81,33 @@ double pf_ran_gaussian(double sigma);
 pf_vector_t pf_pdf_gaussian_sample(pf_pdf_gaussian_t *pdf);
 
 
+/**************************************************************************
+ * Counter-based random numbers
+ *************************************************************************/
+
+// Key of a counter-based generator (Philox4x32-10, from Salmon et al.,
+// "Parallel Random Numbers: As Easy as 1, 2, 3", SC 2011).  The numbers
+// drawn for a counter depend only on the key and the counter, so there is
+// no hidden state: samples can be drawn in any order, or from several
+// threads, and are reproduced exactly from the same key.
+typedef struct
+{
+  uint32_t k[2];
+} pf_ran_key_t;
+
+// Make a key from a seed
+pf_ran_key_t pf_ran_key(uint64_t seed);
+
+// Draw four 32 bit random numbers for the counter (c0, c1, c2, c3)
+void pf_ran_philox(pf_ran_key_t key, const uint32_t c[4], uint32_t r[4]);
+
+// Draw four independent zero-mean, unit-variance Gaussian samples for the
+// counter (c0, c1).  Uses the trigonometric form of the Box-Muller
+// transformation, which needs no rejection, so every counter gives exactly
+// one set of samples.
+void pf_ran_gaussian4(pf_ran_key_t key, uint32_t c0, uint32_t c1, double z[4]);
+
+
 #if 0
 
 /**************************************************************************
@@ -29,12 +29,19 @@
 #ifndef AMCL_LASER_H
 #define AMCL_LASER_H
 
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
 #include "amcl_sensor.h"
 #include "../map/map.h"
 
 namespace amcl
 {
 
+class LikelihoodFieldDevice;
+
 typedef enum
 {
   LASER_MODEL_BEAM,
@@ -69,13 +76,27 @@ class AMCLLaser : public AMCLSensor
                             double z_rand,
                             double sigma_hit,
                             double labda_short,
-                            double chi_outlier);
+                            double chi_outlier,
+                            int range_table_angles = 0);
 
   public: void SetModelLikelihoodField(double z_hit,
                                        double z_rand,
                                        double sigma_hit,
                                        double max_occ_dist);
 
+  // Keep the likelihood fields in the given directory, so they are only
+  // computed once per map and max_occ_dist.  Must be set before the model.
+  public: void SetLikelihoodFieldCache(const std::string& dir)
+          {this->likelihood_field_cache = dir;}
+
+  // Compute the likelihood field in tiles of tile_size cells square around
+  // the samples as they need them, keeping at most max_tiles tiles beyond
+  // those of the last update.  Zero computes the whole field up front.
+  // Must be set before the model.
+  public: void SetLikelihoodFieldTiles(int tile_size, int max_tiles)
+          {this->likelihood_tile_size = tile_size;
+           this->likelihood_max_tiles = max_tiles;}
+
   //a more probabilistically correct model - also with the option to do beam skipping
   public: void SetModelLikelihoodFieldProb(double z_hit,
 					   double z_rand,
@@ -90,10 +111,59 @@ class AMCLLaser : public AMCLSensor
   // filter has been updated.
   public: virtual bool UpdateSensor(pf_t *pf, AMCLSensorData *data);
 
+  // Update the filter with scans of several lasers in one weighting pass.
+  // The models of all scans multiply into the sample weights before they are
+  // normalized once, so the filter sees a single sensor update.  The sensor
+  // of every scan must be an AMCLLaser.  Returns true if the filter has been
+  // updated.
+  public: static bool UpdateSensors(pf_t *pf, std::vector<AMCLLaserData*>& data);
+
   // Set the laser's pose after construction
   public: void SetLaserPose(pf_vector_t& laser_pose) 
           {this->laser_pose = laser_pose;}
 
+  // Reuse the likelihood of a scan for all samples whose poses fall in the
+  // same bin of the given size.  A size of zero evaluates every sample.
+  public: void SetPoseCache(double bin_xy, double bin_theta)
+          {this->pose_cache_xy = bin_xy; this->pose_cache_theta = bin_theta;}
+
+  // Let the likelihood field models pick the beams of every scan by how
+  // much they tell about the pose instead of taking every n-th beam.  Only
+  // done once the filter has converged.
+  public: void SetAdaptiveBeams(bool adaptive_beams)
+          {this->adaptive_beams = adaptive_beams;}
+
+  // Weight the samples of the likelihood field models on a CUDA device.
+  // Scans the device cannot take, with beam skipping or a tiled field, and
+  // any device error fall back to the CPU.  Returns false if there is no
+  // device, or amcl was built without CUDA.
+  public: bool SetUseGPU(bool use_gpu);
+
+  // Statistics of the last adaptive beam selection: the number of usable
+  // beams in the scan, how many of them were selected, and which fraction
+  // of the summed likelihood gradient of the usable beams they carry
+  public: void GetBeamStats(int& candidates, int& selected, double& score_fraction) const
+          {candidates = this->beam_stats_candidates;
+           selected = this->beam_stats_selected;
+           score_fraction = this->beam_stats_score_fraction;}
+
+  // Refine a robot pose by matching the end points of all the beams of a
+  // scan against the likelihood field: at most the given number of damped
+  // Gauss-Newton steps on the summed squared distance of the end points to
+  // the nearest obstacle.  Returns true if the pose was improved, false
+  // with the pose untouched otherwise, or for the beam model.
+  public: bool RefinePose(AMCLLaserData *data, pf_vector_t *pose, int iterations);
+
+  // Bring the model up to date with the map and the filter before an update
+  private: void PrepareUpdate(pf_t *pf);
+
+  // Apply the model of the sensor of the data
+  private: static double ApplyModel(AMCLLaserData *data, pf_sample_set_t* set);
+
+  // Apply the models of several scans one after the other
+  private: static double ApplyModels(std::vector<AMCLLaserData*> *data,
+                                     pf_sample_set_t* set);
+
   // Determine the probability for the given pose
   private: static double BeamModel(AMCLLaserData *data, 
                                    pf_sample_set_t* set);
@@ -107,6 +177,24 @@ class AMCLLaser : public AMCLSensor
 
   private: void reallocTempData(int max_samples, int max_obs);
 
+  // Make sure the map has a distance field for max_occ_dist, from the cache
+  // if there is one
+  private: void UpdateLikelihoodField(double max_occ_dist);
+
+  // Weight the samples on the device, if there is one that can take the
+  // scan.  Returns false if they have to be weighted on the CPU.
+  private: bool WeighOnDevice(pf_sample_set_t* set,
+                              const std::vector<double>& ex,
+                              const std::vector<double>& ey,
+                              double range_max, bool log_model,
+                              std::vector<double>& p);
+
+  // Make the likelihood field tiles resident that the scan needs
+  private: void UpdateTiles(AMCLLaserData *data, pf_sample_set_t* set);
+
+  // Fill hit_prob for the current distance field of the map
+  private: void UpdateHitProb();
+
   private: laser_model_t model_type;
 
   // Current data timestamp
@@ -115,8 +203,29 @@ class AMCLLaser : public AMCLSensor
   // The laser map
   private: map_t *map;
 
+  // Directory of the likelihood field cache, empty for none
+  private: std::string likelihood_field_cache;
+
+  // Size and number of the likelihood field tiles, zero for no tiles
+  private: int likelihood_tile_size;
+  private: int likelihood_max_tiles;
+
   // Laser offset relative to robot
   private: pf_vector_t laser_pose;
+
+  // Size of the pose bins that share a likelihood, zero to disable
+  private: double pose_cache_xy;
+  private: double pose_cache_theta;
+
+  // The device weighting the samples, shared by the copies of the laser;
+  // NULL weights them on the CPU
+  private: boost::shared_ptr<LikelihoodFieldDevice> device;
+
+  // Adaptive beam selection, and the statistics of the last selection
+  private: bool adaptive_beams;
+  private: int beam_stats_candidates;
+  private: int beam_stats_selected;
+  private: double beam_stats_score_fraction;
   
   // Max beams to consider
   private: int max_beams;
@@ -130,9 +239,14 @@ class AMCLLaser : public AMCLSensor
   private: double beam_skip_error_threshold;
 
   //temp data that is kept before observations are integrated to each particle (requried for beam skipping)
+  //it is sized for the largest sample set of the filter, so it stays put when the sample count changes
   private: int max_samples;
   private: int max_obs;
-  private: double **temp_obs;
+  // max_samples rows of max_obs observations
+  private: std::vector<double> temp_obs;
+  // Number of particles for which each beam agreed with the map, and which beams to integrate
+  private: std::vector<int> obs_count;
+  private: std::vector<bool> obs_mask;
 
   // Laser model params
   //
@@ -144,6 +258,11 @@ class AMCLLaser : public AMCLSensor
   //
   // Stddev of Gaussian model for laser hits.
   private: double sigma_hit;
+  //
+  // Gaussian model for laser hits for every step of the distance field, and
+  // the max_occ_dist of the map it was computed for.
+  private: double hit_prob[MAP_OCC_DIST_STEPS + 1];
+  private: double hit_prob_max_occ_dist;
   // Decay rate of exponential model for short readings.
   private: double lambda_short;
   // Threshold for outlier rejection (unused)
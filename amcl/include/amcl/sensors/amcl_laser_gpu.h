@@ -0,0 +1,81 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Likelihood field weighting on a CUDA device
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef AMCL_LASER_GPU_H
+#define AMCL_LASER_GPU_H
+
+#include <vector>
+
+#include "../map/map.h"
+#include "../pf/pf.h"
+
+namespace amcl
+{
+
+// Weights the samples with a likelihood field model on the GPU.  The
+// distance field of the map stays on the device; every update uploads the
+// sample poses and beam end points and reads back one likelihood per
+// sample.  Computed in single precision.  Only built when CUDA is found.
+class LikelihoodFieldDevice
+{
+  // Returns NULL if there is no usable device
+  public: static LikelihoodFieldDevice* Create();
+
+  public: ~LikelihoodFieldDevice();
+
+  // Compute the likelihood of every sample of the set for beams ending at
+  // (ex, ey) in the laser frame: per beam pz = z_hit * hit_prob[step] +
+  // p_rand, summed as 1 + pz^3 or, with log_model, multiplied.  The
+  // distance field is uploaded first if the map has changed.  Returns false
+  // on any device error, leaving p undefined.
+  public: bool Weigh(const map_t* map, pf_sample_set_t* set,
+                     const pf_vector_t& laser_pose,
+                     const std::vector<double>& ex, const std::vector<double>& ey,
+                     const double* hit_prob, double z_hit, double p_rand,
+                     bool log_model, double* p);
+
+  private: LikelihoodFieldDevice();
+
+  // Upload the distance field, unless it is already on the device
+  private: bool SetField(const map_t* map);
+
+  // Make the buffers hold at least the given counts
+  private: bool Reserve(int samples, int beams);
+
+  // The uploaded field, to tell when the map changed
+  private: const unsigned char* field_source;
+  private: double field_max_occ_dist;
+  private: int field_size_x, field_size_y;
+  private: unsigned int field_version;
+
+  // Device buffers
+  private: unsigned char* d_field;
+  private: float *d_x, *d_y, *d_theta, *d_ends, *d_hit_prob, *d_p;
+  private: int sample_capacity, beam_capacity;
+
+  // Host staging buffers
+  private: std::vector<float> h_x, h_y, h_theta, h_ends, h_p;
+};
+
+}
+
+#endif
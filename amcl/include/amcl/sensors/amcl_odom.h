@@ -82,6 +82,10 @@ class AMCLOdom : public AMCLSensor
   // has been updated.
   public: virtual bool UpdateAction(pf_t *pf, AMCLSensorData *data);
 
+  // Seed the motion noise.  Runs with the same seed and odometry give the
+  // same samples, however many threads update them.
+  public: void SetRandomSeed(uint64_t seed);
+
   // Current data timestamp
   private: double time;
   
@@ -90,6 +94,11 @@ class AMCLOdom : public AMCLSensor
 
   // Drift parameters
   private: double alpha1, alpha2, alpha3, alpha4, alpha5;
+
+  // Key of the motion noise, and the number of updates drawn with it.  The
+  // noise of sample i in update n is drawn from the counter (i, n).
+  private: pf_ran_key_t rng_key;
+  private: uint32_t rng_update;
 };
 
 
@@ -61,6 +61,13 @@ class AMCLSensor
   // Flag is true if this is the action sensor
   public: bool is_action;
 
+  // Limit the number of threads the sensor models weight the particles
+  // with, zero uses as many as OpenMP would by default.
+  public: static void SetParallelThreads(int threads);
+
+  // The number of threads the sensor models weight the particles with
+  public: static int ParallelThreads();
+
   // Action pose (action sensors only)
   public: pf_vector_t pose;
 
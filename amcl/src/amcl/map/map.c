@@ -52,6 +52,31 @@ map_t *map_alloc(void)
   
   // Allocate storage for main map
   map->cells = (map_cell_t*) NULL;
+
+  // The distance field is computed by map_update_cspace()
+  map->max_occ_dist = 0;
+  map->occ_dist = (unsigned char*) NULL;
+  map->occ_dist_version = 0;
+
+  // The distance field is only tiled by map_set_tiles()
+  map->tile_size = 0;
+  map->tile_shift = 0;
+  map->tiles_x = 0;
+  map->tiles_y = 0;
+  map->tiles = (unsigned char**) NULL;
+  map->tile_used = (unsigned int*) NULL;
+  map->tile_pass = 0;
+  map->tile_count = 0;
+  map->tile_max_count = 0;
+
+  // The range table is computed by map_update_ranges()
+  map->range_angles = 0;
+  map->ranges = (uint16_t*) NULL;
+
+  // The free cells are indexed by map_update_free()
+  map->free_count = 0;
+  map->free_run_count = 0;
+  map->free_runs = (map_free_run_t*) NULL;
   
   return map;
 }
@@ -61,6 +86,10 @@ map_t *map_alloc(void)
 void map_free(map_t *map)
 {
   free(map->cells);
+  free(map->occ_dist);
+  map_set_tiles(map, 0, 0, 0);
+  free(map->ranges);
+  free(map->free_runs);
   free(map);
   return;
 }
@@ -82,3 +111,80 @@ map_cell_t *map_get_cell(map_t *map, double ox, double oy, double oa)
   return cell;
 }
 
+
+// Index the free cells of the map
+int map_update_free(map_t *map)
+{
+  int i, n, run_count, free_count;
+  map_free_run_t *runs;
+
+  n = map->size_x * map->size_y;
+
+  // Count the runs first, so the index is allocated only once
+  run_count = 0;
+  for (i = 0; i < n; i++)
+    if (map->cells[i].occ_state == -1 && (i == 0 || map->cells[i - 1].occ_state != -1))
+      run_count++;
+
+  runs = NULL;
+  if (run_count > 0)
+  {
+    runs = (map_free_run_t*) malloc(run_count * sizeof(map_free_run_t));
+    if (runs == NULL)
+      return -1;
+  }
+
+  run_count = 0;
+  free_count = 0;
+  for (i = 0; i < n; i++)
+  {
+    if (map->cells[i].occ_state != -1)
+      continue;
+    if (i == 0 || map->cells[i - 1].occ_state != -1)
+    {
+      runs[run_count].start = i;
+      runs[run_count].offset = free_count;
+      run_count++;
+    }
+    free_count++;
+  }
+
+  free(map->free_runs);
+  map->free_runs = runs;
+  map->free_run_count = run_count;
+  map->free_count = free_count;
+  return 0;
+}
+
+
+// Pick the free cell at the given fraction of all free cells
+int map_pick_free(map_t *map, double u, int *i, int *j)
+{
+  int k, lo, hi, mid, index;
+
+  if (map->free_count == 0)
+    return -1;
+
+  k = (int) (u * map->free_count);
+  if (k < 0)
+    k = 0;
+  if (k >= map->free_count)
+    k = map->free_count - 1;
+
+  // Find the last run that starts at or before the k-th free cell
+  lo = 0;
+  hi = map->free_run_count - 1;
+  while (lo < hi)
+  {
+    mid = (lo + hi + 1) / 2;
+    if (map->free_runs[mid].offset <= k)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+
+  index = map->free_runs[lo].start + (k - map->free_runs[lo].offset);
+  *i = index % map->size_x;
+  *j = index / map->size_x;
+  return 0;
+}
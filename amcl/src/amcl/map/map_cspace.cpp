@@ -19,215 +19,295 @@
  *
  */
 
-#include <queue>
+#include <algorithm>
+#include <vector>
+#include <limits.h>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include "map.h"
 
-class CellData
-{
-  public:
-    map_t* map_;
-    unsigned int i_, j_;
-    unsigned int src_i_, src_j_;
-};
+// Squared distances beyond any distance we care about
+static const double FAR_DIST_SQ = 1e20;
 
-class CachedDistanceMap
+// Exact squared euclidean distance transform of a sampled function,
+// see Felzenszwalb and Huttenlocher, "Distance Transforms of Sampled
+// Functions".  f holds n values, the result is written to d; v and z are
+// scratch buffers of n and n + 1 elements.
+static void
+distance_transform_1d(const double* f, int n, double* d, int* v, double* z)
 {
-  public:
-    CachedDistanceMap(double scale, double max_dist) : 
-      distances_(NULL), scale_(scale), max_dist_(max_dist) 
-    {
-      cell_radius_ = max_dist / scale;
-      distances_ = new double *[cell_radius_+2];
-      for(int i=0; i<=cell_radius_+1; i++)
-      {
-	distances_[i] = new double[cell_radius_+2];
-        for(int j=0; j<=cell_radius_+1; j++)
-	{
-	  distances_[i][j] = sqrt(i*i + j*j);
-	}
-      }
-    }
-    ~CachedDistanceMap()
+  int k = 0;
+  v[0] = 0;
+  z[0] = -FAR_DIST_SQ;
+  z[1] = +FAR_DIST_SQ;
+  for(int q = 1; q < n; q++)
+  {
+    double s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+    while(s <= z[k])
     {
-      if(distances_)
-      {
-	for(int i=0; i<=cell_radius_+1; i++)
-	  delete[] distances_[i];
-	delete[] distances_;
-      }
+      k--;
+      s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
     }
-    double** distances_;
-    double scale_;
-    double max_dist_;
-    int cell_radius_;
-};
-
-
-bool operator<(const CellData& a, const CellData& b)
-{
-  return a.map_->cells[MAP_INDEX(a.map_, a.i_, a.j_)].occ_dist > a.map_->cells[MAP_INDEX(b.map_, b.i_, b.j_)].occ_dist;
-}
-
-CachedDistanceMap*
-get_distance_map(double scale, double max_dist)
-{
-  static CachedDistanceMap* cdm = NULL;
+    k++;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = +FAR_DIST_SQ;
+  }
 
-  if(!cdm || (cdm->scale_ != scale) || (cdm->max_dist_ != max_dist))
+  k = 0;
+  for(int q = 0; q < n; q++)
   {
-    if(cdm)
-      delete cdm;
-    cdm = new CachedDistanceMap(scale, max_dist);
+    while(z[k + 1] < q)
+      k++;
+    d[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
   }
-
-  return cdm;
 }
 
-void enqueue(map_t* map, unsigned int i, unsigned int j, 
-	     unsigned int src_i, unsigned int src_j,
-	     std::priority_queue<CellData>& Q,
-	     CachedDistanceMap* cdm,
-	     unsigned char* marked)
+// Compute the distance steps of the cells in [ox0, ox1) x [oy0, oy1) into
+// out, which has rows of out_stride cells.  Only the occupied cells in the
+// window [x0, x1) x [y0, y1) around them are considered, which is exact as
+// long as the window reaches max_occ_dist beyond the output cells.
+static void
+compute_distances(const map_t *map, double max_occ_dist,
+                  int x0, int y0, int x1, int y1,
+                  int ox0, int oy0, int ox1, int oy1,
+                  unsigned char *out, int out_stride)
 {
-  if(marked[MAP_INDEX(map, i, j)])
-    return;
+  int w = x1 - x0;
+  int h = y1 - y0;
 
-  unsigned int di = abs(i - src_i);
-  unsigned int dj = abs(j - src_j);
-  double distance = cdm->distances_[di][dj];
+  // Distances along a row are clamped to this many cells, everything at or
+  // beyond it ends up at max_occ_dist anyway
+  int cell_radius = (int)ceil(max_occ_dist / map->scale) + 1;
 
-  if(distance > cdm->cell_radius_)
-    return;
+  // First pass: distance to the nearest occupied cell of the same row
+  std::vector<double> dist_sq((size_t)w*h);
+  for(int j=0; j<h; j++)
+  {
+    const map_cell_t* cells = map->cells + MAP_INDEX(map, x0, y0 + j);
+    double* row = &dist_sq[(size_t)j*w];
 
-  map->cells[MAP_INDEX(map, i, j)].occ_dist = distance * map->scale;
+    int d = cell_radius;
+    for(int i=0; i<w; i++)
+    {
+      d = (cells[i].occ_state == +1) ? 0 : std::min(d + 1, cell_radius);
+      row[i] = d;
+    }
+    d = cell_radius;
+    for(int i=w-1; i>=0; i--)
+    {
+      d = (cells[i].occ_state == +1) ? 0 : std::min(d + 1, cell_radius);
+      if(d < row[i])
+        row[i] = d;
+      row[i] = row[i] * row[i];
+    }
+  }
 
-  CellData cell;
-  cell.map_ = map;
-  cell.i_ = i;
-  cell.j_ = j;
-  cell.src_i_ = src_i;
-  cell.src_j_ = src_j;
+  // Second pass: combine the row distances along every column, a column at
+  // a time through contiguous buffers
+  std::vector<double> f(h), d(h), z(h + 1);
+  std::vector<int> v(h);
+  double max_dist_sq = (max_occ_dist / map->scale) * (max_occ_dist / map->scale);
+  for(int i=ox0; i<ox1; i++)
+  {
+    for(int j=0; j<h; j++)
+      f[j] = dist_sq[(size_t)j*w + (i - x0)];
 
-  Q.push(cell);
+    if(h > 0)
+      distance_transform_1d(&f[0], h, &d[0], &v[0], &z[0]);
 
-  marked[MAP_INDEX(map, i, j)] = 1;
+    for(int j=oy0; j<oy1; j++)
+    {
+      unsigned char step;
+      double dj = d[j - y0];
+      if(dj >= max_dist_sq)
+        step = MAP_OCC_DIST_STEPS;
+      else
+        step = (unsigned char)(sqrt(dj) * map->scale * MAP_OCC_DIST_STEPS / max_occ_dist + 0.5);
+      out[(size_t)(j - oy0)*out_stride + (i - ox0)] = step;
+    }
+  }
 }
 
 // Update the cspace distance values
 void map_update_cspace(map_t *map, double max_occ_dist)
 {
-  unsigned char* marked;
-  std::priority_queue<CellData> Q;
-
-  marked = new unsigned char[map->size_x*map->size_y];
-  memset(marked, 0, sizeof(unsigned char) * map->size_x*map->size_y);
+  int size_x = map->size_x;
+  int size_y = map->size_y;
 
+  map_set_tiles(map, max_occ_dist, 0, 0);
   map->max_occ_dist = max_occ_dist;
+  map->occ_dist = (unsigned char*)realloc(map->occ_dist, sizeof(unsigned char) * size_x*size_y);
+
+  compute_distances(map, max_occ_dist, 0, 0, size_x, size_y,
+                    0, 0, size_x, size_y, map->occ_dist, size_x);
+  map->occ_dist_version++;
+}
 
-  CachedDistanceMap* cdm = get_distance_map(map->scale, map->max_occ_dist);
+// Recompute the cspace distances around changed cells
+void map_update_cspace_region(map_t *map, int i0, int j0, int i1, int j1)
+{
+  // Only cells within max_occ_dist of a changed cell can get another distance,
+  // and only the occupied cells within max_occ_dist of those matter
+  int margin = (int)ceil(map->max_occ_dist / map->scale) + 1;
+  int ox0 = std::max(i0 - margin, 0);
+  int oy0 = std::max(j0 - margin, 0);
+  int ox1 = std::min(i1 + 1 + margin, map->size_x);
+  int oy1 = std::min(j1 + 1 + margin, map->size_y);
+  if(ox0 >= ox1 || oy0 >= oy1)
+    return;
 
-  // Enqueue all the obstacle cells
-  CellData cell;
-  cell.map_ = map;
-  for(int i=0; i<map->size_x; i++)
+  if(map->tile_size > 0)
   {
-    cell.src_i_ = cell.i_ = i;
-    for(int j=0; j<map->size_y; j++)
+    int shift = map->tile_shift;
+    for(int ty=(oy0 >> shift); ty<=((oy1 - 1) >> shift); ty++)
     {
-      if(map->cells[MAP_INDEX(map, i, j)].occ_state == +1)
+      for(int tx=(ox0 >> shift); tx<=((ox1 - 1) >> shift); tx++)
       {
-	map->cells[MAP_INDEX(map, i, j)].occ_dist = 0.0;
-	cell.src_j_ = cell.j_ = j;
-	marked[MAP_INDEX(map, i, j)] = 1;
-	Q.push(cell);
+        int t = ty*map->tiles_x + tx;
+        if(map->tiles[t] == NULL)
+          continue;
+        free(map->tiles[t]);
+        map->tiles[t] = NULL;
+        map->tile_count--;
       }
-      else
-	map->cells[MAP_INDEX(map, i, j)].occ_dist = max_occ_dist;
     }
   }
-
-  while(!Q.empty())
+  else if(map->occ_dist != NULL)
   {
-    CellData current_cell = Q.top();
-    if(current_cell.i_ > 0)
-      enqueue(map, current_cell.i_-1, current_cell.j_, 
-	      current_cell.src_i_, current_cell.src_j_,
-	      Q, cdm, marked);
-    if(current_cell.j_ > 0)
-      enqueue(map, current_cell.i_, current_cell.j_-1, 
-	      current_cell.src_i_, current_cell.src_j_,
-	      Q, cdm, marked);
-    if((int)current_cell.i_ < map->size_x - 1)
-      enqueue(map, current_cell.i_+1, current_cell.j_, 
-	      current_cell.src_i_, current_cell.src_j_,
-	      Q, cdm, marked);
-    if((int)current_cell.j_ < map->size_y - 1)
-      enqueue(map, current_cell.i_, current_cell.j_+1, 
-	      current_cell.src_i_, current_cell.src_j_,
-	      Q, cdm, marked);
-
-    Q.pop();
+    compute_distances(map, map->max_occ_dist,
+                      std::max(ox0 - margin, 0), std::max(oy0 - margin, 0),
+                      std::min(ox1 + margin, map->size_x),
+                      std::min(oy1 + margin, map->size_y),
+                      ox0, oy0, ox1, oy1,
+                      map->occ_dist + MAP_INDEX(map, ox0, oy0), map->size_x);
   }
-
-  delete[] marked;
+  map->occ_dist_version++;
 }
 
-#if 0
-// TODO: replace this with a more efficient implementation.  Not crucial,
-// because we only do it once, at startup.
-void map_update_cspace(map_t *map, double max_occ_dist)
+// Split the cspace distances in tiles
+int map_set_tiles(map_t *map, double max_occ_dist, int tile_size, int max_tiles)
 {
-  int i, j;
-  int ni, nj;
-  int s;
-  double d;
-  map_cell_t *cell, *ncell;
+  int shift = 0;
+  while(tile_size > 0 && (1 << shift) < tile_size)
+    shift++;
 
-  map->max_occ_dist = max_occ_dist;
-  s = (int) ceil(map->max_occ_dist / map->scale);
+  if(tile_size > 0 && map->tile_size == (1 << shift) &&
+     map->max_occ_dist == max_occ_dist)
+  {
+    map->tile_max_count = max_tiles;
+    return 0;
+  }
 
-  // Reset the distance values
-  for (j = 0; j < map->size_y; j++)
+  if(map->tiles != NULL)
   {
-    for (i = 0; i < map->size_x; i++)
-    {
-      cell = map->cells + MAP_INDEX(map, i, j);
-      cell->occ_dist = map->max_occ_dist;
-    }
+    for(int t=0; t<map->tiles_x*map->tiles_y; t++)
+      free(map->tiles[t]);
   }
+  free(map->tiles);
+  free(map->tile_used);
+  map->tiles = NULL;
+  map->tile_used = NULL;
+  map->tile_size = 0;
+  map->tile_shift = 0;
+  map->tiles_x = 0;
+  map->tiles_y = 0;
+  map->tile_count = 0;
+  map->tile_max_count = 0;
 
-  // Find all the occupied cells and update their neighbours
-  for (j = 0; j < map->size_y; j++)
+  if(tile_size <= 0)
+    return 0;
+
+  // The tiled indices must fit in an int
+  int tiles_x = (map->size_x + (1 << shift) - 1) >> shift;
+  int tiles_y = (map->size_y + (1 << shift) - 1) >> shift;
+  if((double)tiles_x * tiles_y * (1 << shift) * (1 << shift) > INT_MAX)
+    return -1;
+
+  map->tiles = (unsigned char**)calloc(tiles_x*tiles_y, sizeof(unsigned char*));
+  map->tile_used = (unsigned int*)calloc(tiles_x*tiles_y, sizeof(unsigned int));
+  if(map->tiles == NULL || map->tile_used == NULL)
   {
-    for (i = 0; i < map->size_x; i++)
+    free(map->tiles);
+    free(map->tile_used);
+    map->tiles = NULL;
+    map->tile_used = NULL;
+    return -1;
+  }
+
+  map->tile_size = 1 << shift;
+  map->tile_shift = shift;
+  map->tiles_x = tiles_x;
+  map->tiles_y = tiles_y;
+  map->tile_max_count = max_tiles;
+  map->max_occ_dist = max_occ_dist;
+  free(map->occ_dist);
+  map->occ_dist = NULL;
+  return 0;
+}
+
+// Compute every tile covering the given cells that is not resident yet
+int map_update_tiles(map_t *map, int i0, int j0, int i1, int j1)
+{
+  if(map->tile_size == 0)
+    return 0;
+
+  i0 = std::max(i0, 0);
+  j0 = std::max(j0, 0);
+  i1 = std::min(i1, map->size_x - 1);
+  j1 = std::min(j1, map->size_y - 1);
+
+  int size = map->tile_size;
+  int shift = map->tile_shift;
+  int margin = (int)ceil(map->max_occ_dist / map->scale) + 1;
+  int computed = 0;
+
+  map->tile_pass++;
+  for(int ty=(j0 >> shift); i0 <= i1 && ty<=(j1 >> shift); ty++)
+  {
+    for(int tx=(i0 >> shift); tx<=(i1 >> shift); tx++)
     {
-      cell = map->cells + MAP_INDEX(map, i, j);
-      if (cell->occ_state != +1)
+      int t = ty*map->tiles_x + tx;
+      map->tile_used[t] = map->tile_pass;
+      if(map->tiles[t] != NULL)
         continue;
-          
-      cell->occ_dist = 0;
 
-      // Update adjacent cells
-      for (nj = -s; nj <= +s; nj++)
-      {
-        for (ni = -s; ni <= +s; ni++)
-        {
-          if (!MAP_VALID(map, i + ni, j + nj))
-            continue;
+      unsigned char *tile = (unsigned char*)malloc(size*size);
+      if(tile == NULL)
+        return -1;
+      // Cells of the tile beyond the map are never looked up
+      memset(tile, MAP_OCC_DIST_STEPS, size*size);
 
-          ncell = map->cells + MAP_INDEX(map, i + ni, j + nj);
-          d = map->scale * sqrt(ni * ni + nj * nj);
+      int ox0 = tx*size, oy0 = ty*size;
+      int ox1 = std::min(ox0 + size, map->size_x);
+      int oy1 = std::min(oy0 + size, map->size_y);
+      compute_distances(map, map->max_occ_dist,
+                        std::max(ox0 - margin, 0), std::max(oy0 - margin, 0),
+                        std::min(ox1 + margin, map->size_x),
+                        std::min(oy1 + margin, map->size_y),
+                        ox0, oy0, ox1, oy1, tile, size);
+      map->tiles[t] = tile;
+      map->tile_count++;
+      computed++;
+    }
+  }
 
-          if (d < ncell->occ_dist)
-            ncell->occ_dist = d;
-        }
-      }
+  // Evict the tiles that were needed longest ago, but none of this pass
+  if(map->tile_count > map->tile_max_count)
+  {
+    std::vector<std::pair<unsigned int, int> > unused;
+    for(int t=0; t<map->tiles_x*map->tiles_y; t++)
+      if(map->tiles[t] != NULL && map->tile_used[t] != map->tile_pass)
+        unused.push_back(std::make_pair(map->tile_used[t], t));
+    std::sort(unused.begin(), unused.end());
+    for(size_t k=0; k<unused.size() && map->tile_count > map->tile_max_count; k++)
+    {
+      free(map->tiles[unused[k].second]);
+      map->tiles[unused[k].second] = NULL;
+      map->tile_count--;
     }
   }
-  
-  return;
+
+  return computed;
 }
-#endif
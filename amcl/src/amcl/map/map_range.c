@@ -118,3 +118,112 @@ double map_calc_range(map_t *map, double ox, double oy, double oa, double max_ra
   }
   return max_range;
 }
+
+
+// Fill one direction of the range table.  The map is swept with parallel
+// lines along the direction, one cell apart so every cell is on exactly one
+// line, and each line is walked backwards remembering the last occupied or
+// out-of-bound cell.  This makes the table linear in the number of cells
+// instead of casting a ray from every cell.
+static void map_update_ranges_angle(map_t *map, int k, double oa)
+{
+  int steep;
+  int major_size, minor_size;
+  double major_dir, minor_dir;
+  double slope, step;
+  int reach;
+  int b, u, hit;
+  int major, minor, i, j;
+  size_t index;
+  double range;
+
+  steep = fabs(sin(oa)) > fabs(cos(oa));
+  major_size = steep ? map->size_y : map->size_x;
+  minor_size = steep ? map->size_x : map->size_y;
+  major_dir = steep ? sin(oa) : cos(oa);
+  minor_dir = steep ? cos(oa) : sin(oa);
+
+  // Cells along the minor axis per cell along the major axis, and the length
+  // of such a step
+  slope = minor_dir / fabs(major_dir);
+  step = sqrt(1 + slope * slope);
+  reach = (int) ceil(fabs(slope) * major_size) + 1;
+
+  for (b = -reach; b < minor_size + reach; b++)
+  {
+    // Position along the line of the nearest blocking cell ahead
+    hit = major_size;
+    for (u = major_size - 1; u >= 0; u--)
+    {
+      major = (major_dir > 0) ? u : major_size - 1 - u;
+      minor = (int) floor(b + slope * u + 0.5);
+      if (minor < 0 || minor >= minor_size)
+      {
+        hit = u;
+        continue;
+      }
+
+      i = steep ? minor : major;
+      j = steep ? major : minor;
+      index = (size_t) MAP_INDEX(map, i, j) * map->range_angles + k;
+      if (map->cells[MAP_INDEX(map, i, j)].occ_state > -1)
+      {
+        hit = u;
+        map->ranges[index] = 0;
+        continue;
+      }
+
+      range = (hit - u) * step + 0.5;
+      map->ranges[index] = (range < UINT16_MAX) ? (uint16_t) range : UINT16_MAX;
+    }
+  }
+}
+
+
+// Precompute the range readings of every cell
+int map_update_ranges(map_t *map, int angles)
+{
+  int k;
+
+  free(map->ranges);
+  map->ranges = NULL;
+  map->range_angles = 0;
+
+  if (angles <= 0)
+    return 0;
+
+  map->ranges = (uint16_t*) malloc(sizeof(map->ranges[0]) *
+                                   (size_t) map->size_x * map->size_y * angles);
+  if (map->ranges == NULL)
+    return -1;
+  map->range_angles = angles;
+
+  for (k = 0; k < angles; k++)
+    map_update_ranges_angle(map, k, 2 * M_PI * k / angles);
+
+  return 0;
+}
+
+
+// Extract a single range reading from the precomputed ranges
+double map_lookup_range(map_t *map, double ox, double oy, double oa, double max_range)
+{
+  int i, j, k;
+  double range;
+
+  if (map->ranges == NULL)
+    return map_calc_range(map, ox, oy, oa, max_range);
+
+  // Ranges from outside the map are zero, as for map_calc_range()
+  i = MAP_GXWX(map, ox);
+  j = MAP_GYWY(map, oy);
+  if (!MAP_VALID(map, i, j))
+    return 0.0;
+
+  k = (int) floor(oa * map->range_angles / (2 * M_PI) + 0.5) % map->range_angles;
+  if (k < 0)
+    k += map->range_angles;
+
+  range = map->ranges[(size_t) MAP_INDEX(map, i, j) * map->range_angles + k] * map->scale;
+  return (range < max_range) ? range : max_range;
+}
@@ -211,4 +211,145 @@ int map_load_wifi(map_t *map, const char *filename, int index)
 */
 
 
+////////////////////////////////////////////////////////////////////////////
+// Header of a saved cspace; the distance plane follows it directly
+typedef struct
+{
+  char magic[8];
+  uint64_t occ_hash;
+  int32_t size_x, size_y;
+  double scale;
+  double max_occ_dist;
+  char pad[24];
+} map_cspace_header_t;
+
+static const char map_cspace_magic[8] = "AMCLDF1";
+
+
+////////////////////////////////////////////////////////////////////////////
+// Add bytes to a 64 bit FNV-1a hash
+static uint64_t map_hash_bytes(uint64_t h, const void *data, size_t size)
+{
+  size_t i;
+  for (i = 0; i < size; i++)
+    h = (h ^ ((const unsigned char *) data)[i]) * 1099511628211ULL;
+  return h;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Hash the occupancy grid.  The cells are hashed a word at a time, which
+// is weaker than hashing bytes but plenty to tell maps apart, and fast
+// enough to key the cache on large maps.
+uint64_t map_hash_occ(map_t *map)
+{
+  size_t i, size;
+  uint64_t h, w;
+  const unsigned char *cells;
+
+  h = 14695981039346656037ULL;
+  h = map_hash_bytes(h, &map->size_x, sizeof(map->size_x));
+  h = map_hash_bytes(h, &map->size_y, sizeof(map->size_y));
+  h = map_hash_bytes(h, &map->scale, sizeof(map->scale));
+
+  cells = (const unsigned char *) map->cells;
+  size = (size_t) map->size_x * map->size_y * sizeof(map_cell_t);
+  for (i = 0; i + sizeof(w) <= size; i += sizeof(w))
+  {
+    memcpy(&w, cells + i, sizeof(w));
+    h = (h ^ w) * 1099511628211ULL;
+    h ^= h >> 29;
+  }
+  h = map_hash_bytes(h, cells + i, size - i);
+
+  return h;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Save the cspace distances
+int map_save_cspace(map_t *map, const char *filename)
+{
+  FILE *file;
+  size_t size;
+  map_cspace_header_t header;
+
+  if (map->occ_dist == NULL)
+    return -1;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, map_cspace_magic, sizeof(header.magic));
+  header.occ_hash = map_hash_occ(map);
+  header.size_x = map->size_x;
+  header.size_y = map->size_y;
+  header.scale = map->scale;
+  header.max_occ_dist = map->max_occ_dist;
+
+  file = fopen(filename, "wb");
+  if (file == NULL)
+  {
+    fprintf(stderr, "%s: %s\n", strerror(errno), filename);
+    return -1;
+  }
 
+  size = (size_t) map->size_x * map->size_y;
+  if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+      fwrite(map->occ_dist, 1, size, file) != size)
+  {
+    fprintf(stderr, "%s: %s\n", strerror(errno), filename);
+    fclose(file);
+    remove(filename);
+    return -1;
+  }
+
+  if (fclose(file) != 0)
+  {
+    remove(filename);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Load cspace distances saved by map_save_cspace()
+int map_load_cspace(map_t *map, double max_occ_dist, const char *filename)
+{
+  FILE *file;
+  size_t size;
+  unsigned char *occ_dist;
+  map_cspace_header_t header;
+
+  file = fopen(filename, "rb");
+  if (file == NULL)
+    return -1;
+
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      memcmp(header.magic, map_cspace_magic, sizeof(header.magic)) != 0 ||
+      header.size_x != map->size_x || header.size_y != map->size_y ||
+      header.scale != map->scale || header.max_occ_dist != max_occ_dist ||
+      header.occ_hash != map_hash_occ(map))
+  {
+    fclose(file);
+    return -1;
+  }
+
+  size = (size_t) map->size_x * map->size_y;
+  occ_dist = malloc(size);
+  if (occ_dist == NULL || fread(occ_dist, 1, size, file) != size)
+  {
+    free(occ_dist);
+    fclose(file);
+    return -1;
+  }
+  fclose(file);
+
+  map_set_tiles(map, max_occ_dist, 0, 0);
+  free(map->occ_dist);
+  map->occ_dist = occ_dist;
+  map->max_occ_dist = max_occ_dist;
+  map->occ_dist_version++;
+
+  return 0;
+}
@@ -42,6 +42,35 @@ static int pf_resample_limit(pf_t *pf, int k);
 // Re-compute the cluster statistics for a sample set
 static void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set);
 
+// Draw the samples of set b from set a with a systematic resampler
+static double pf_resample_systematic(pf_t *pf, pf_sample_set_t *set_a, pf_sample_set_t *set_b,
+                                     double *c, double w_diff);
+
+// Monotonic wall time in seconds
+static double pf_wall_time(void);
+
+
+// Get the pose of a sample
+pf_vector_t pf_get_sample_pose(pf_sample_set_t *set, int i)
+{
+  pf_vector_t pose;
+
+  pose.v[0] = set->x[i];
+  pose.v[1] = set->y[i];
+  pose.v[2] = set->theta[i];
+
+  return pose;
+}
+
+
+// Set the pose of a sample
+void pf_set_sample_pose(pf_sample_set_t *set, int i, pf_vector_t pose)
+{
+  set->x[i] = pose.v[0];
+  set->y[i] = pose.v[1];
+  set->theta[i] = pose.v[2];
+}
+
 
 // Create a new filter
 pf_t *pf_alloc(int min_samples, int max_samples,
@@ -51,7 +80,6 @@ pf_t *pf_alloc(int min_samples, int max_samples,
   int i, j;
   pf_t *pf;
   pf_sample_set_t *set;
-  pf_sample_t *sample;
   
   srand48(time(NULL));
 
@@ -70,7 +98,11 @@ pf_t *pf_alloc(int min_samples, int max_samples,
   // distrubition will be less than [err].
   pf->pop_err = 0.01;
   pf->pop_z = 3;
+  pf->converged_pop_err = 0.0;
   pf->dist_threshold = 0.5; 
+  pf->resample_model = PF_RESAMPLE_MULTINOMIAL;
+  pf->timing = 0;
+  pf->cluster_time = 0.0;
   
   pf->current_set = 0;
   for (j = 0; j < 2; j++)
@@ -78,16 +110,13 @@ pf_t *pf_alloc(int min_samples, int max_samples,
     set = pf->sets + j;
       
     set->sample_count = max_samples;
-    set->samples = calloc(max_samples, sizeof(pf_sample_t));
+    set->x = calloc(max_samples, sizeof(double));
+    set->y = calloc(max_samples, sizeof(double));
+    set->theta = calloc(max_samples, sizeof(double));
+    set->weight = calloc(max_samples, sizeof(double));
 
     for (i = 0; i < set->sample_count; i++)
-    {
-      sample = set->samples + i;
-      sample->pose.v[0] = 0.0;
-      sample->pose.v[1] = 0.0;
-      sample->pose.v[2] = 0.0;
-      sample->weight = 1.0 / max_samples;
-    }
+      set->weight[i] = 1.0 / max_samples;
 
     // HACK: is 3 times max_samples enough?
     set->kdtree = pf_kdtree_alloc(3 * max_samples);
@@ -121,7 +150,10 @@ void pf_free(pf_t *pf)
   {
     free(pf->sets[i].clusters);
     pf_kdtree_free(pf->sets[i].kdtree);
-    free(pf->sets[i].samples);
+    free(pf->sets[i].x);
+    free(pf->sets[i].y);
+    free(pf->sets[i].theta);
+    free(pf->sets[i].weight);
   }
   free(pf);
   
@@ -133,7 +165,7 @@ void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov)
 {
   int i;
   pf_sample_set_t *set;
-  pf_sample_t *sample;
+  pf_vector_t pose;
   pf_pdf_gaussian_t *pdf;
   
   set = pf->sets + pf->current_set;
@@ -148,12 +180,12 @@ void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov)
   // Compute the new sample poses
   for (i = 0; i < set->sample_count; i++)
   {
-    sample = set->samples + i;
-    sample->weight = 1.0 / pf->max_samples;
-    sample->pose = pf_pdf_gaussian_sample(pdf);
+    set->weight[i] = 1.0 / pf->max_samples;
+    pose = pf_pdf_gaussian_sample(pdf);
+    pf_set_sample_pose(set, i, pose);
 
     // Add sample to histogram
-    pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
+    pf_kdtree_insert(set->kdtree, pose, set->weight[i]);
   }
 
   pf->w_slow = pf->w_fast = 0.0;
@@ -175,7 +207,7 @@ void pf_init_model(pf_t *pf, pf_init_model_fn_t init_fn, void *init_data)
 {
   int i;
   pf_sample_set_t *set;
-  pf_sample_t *sample;
+  pf_vector_t pose;
 
   set = pf->sets + pf->current_set;
 
@@ -187,12 +219,12 @@ void pf_init_model(pf_t *pf, pf_init_model_fn_t init_fn, void *init_data)
   // Compute the new sample poses
   for (i = 0; i < set->sample_count; i++)
   {
-    sample = set->samples + i;
-    sample->weight = 1.0 / pf->max_samples;
-    sample->pose = (*init_fn) (init_data);
+    set->weight[i] = 1.0 / pf->max_samples;
+    pose = (*init_fn) (init_data);
+    pf_set_sample_pose(set, i, pose);
 
     // Add sample to histogram
-    pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
+    pf_kdtree_insert(set->kdtree, pose, set->weight[i]);
   }
 
   pf->w_slow = pf->w_fast = 0.0;
@@ -217,25 +249,14 @@ int pf_update_converged(pf_t *pf)
 {
   int i;
   pf_sample_set_t *set;
-  pf_sample_t *sample;
-  double total;
 
   set = pf->sets + pf->current_set;
-  double mean_x = 0, mean_y = 0;
-
-  for (i = 0; i < set->sample_count; i++){
-    sample = set->samples + i;
 
-    mean_x += sample->pose.v[0];
-    mean_y += sample->pose.v[1];
-  }
-  mean_x /= set->sample_count;
-  mean_y /= set->sample_count;
-  
-  for (i = 0; i < set->sample_count; i++){
-    sample = set->samples + i;
-    if(fabs(sample->pose.v[0] - mean_x) > pf->dist_threshold || 
-       fabs(sample->pose.v[1] - mean_y) > pf->dist_threshold){
+  // With equal weights the mean of the statistics is the mean of the
+  // samples, and the samples farthest from it are at the bounds
+  for (i = 0; i < 2; i++){
+    if(set->max[i] - set->mean.v[i] > pf->dist_threshold ||
+       set->mean.v[i] - set->min[i] > pf->dist_threshold){
       set->converged = 0; 
       pf->converged = 0; 
       return 0;
@@ -265,7 +286,6 @@ void pf_update_sensor(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_dat
 {
   int i;
   pf_sample_set_t *set;
-  pf_sample_t *sample;
   double total;
 
   set = pf->sets + pf->current_set;
@@ -279,9 +299,8 @@ void pf_update_sensor(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_dat
     double w_avg=0.0;
     for (i = 0; i < set->sample_count; i++)
     {
-      sample = set->samples + i;
-      w_avg += sample->weight;
-      sample->weight /= total;
+      w_avg += set->weight[i];
+      set->weight[i] /= total;
     }
     // Update running averages of likelihood of samples (Prob Rob p258)
     w_avg /= set->sample_count;
@@ -300,10 +319,7 @@ void pf_update_sensor(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_dat
   {
     // Handle zero total
     for (i = 0; i < set->sample_count; i++)
-    {
-      sample = set->samples + i;
-      sample->weight = 1.0 / set->sample_count;
-    }
+      set->weight[i] = 1.0 / set->sample_count;
   }
 
   return;
@@ -316,7 +332,8 @@ void pf_update_resample(pf_t *pf)
   int i;
   double total;
   pf_sample_set_t *set_a, *set_b;
-  pf_sample_t *sample_a, *sample_b;
+  int b;
+  pf_vector_t pose;
 
   //double r,c,U;
   //int m;
@@ -324,6 +341,7 @@ void pf_update_resample(pf_t *pf)
   double* c;
 
   double w_diff;
+  int limit, limit_leaves;
 
   set_a = pf->sets + pf->current_set;
   set_b = pf->sets + (pf->current_set + 1) % 2;
@@ -334,7 +352,7 @@ void pf_update_resample(pf_t *pf)
   c = (double*)malloc(sizeof(double)*(set_a->sample_count+1));
   c[0] = 0.0;
   for(i=0;i<set_a->sample_count;i++)
-    c[i+1] = c[i]+set_a->samples[i].weight;
+    c[i+1] = c[i]+set_a->weight[i];
 
   // Create the kd tree for adaptive sampling
   pf_kdtree_clear(set_b->kdtree);
@@ -348,22 +366,34 @@ void pf_update_resample(pf_t *pf)
     w_diff = 0.0;
   //printf("w_diff: %9.6f\n", w_diff);
 
+  // The limit only changes when a sample opens a new bin
+  limit = pf->max_samples;
+  limit_leaves = -1;
+
+  if(pf->resample_model == PF_RESAMPLE_SYSTEMATIC)
+    total = pf_resample_systematic(pf, set_a, set_b, c, w_diff);
+
   // Can't (easily) combine low-variance sampler with KLD adaptive
-  // sampling, so we'll take the more traditional route.
+  // sampling sample by sample, so the multinomial model takes the more
+  // traditional route.  See pf_resample_systematic() for the other one.
   /*
   // Low-variance resampler, taken from Probabilistic Robotics, p110
   count_inv = 1.0/set_a->sample_count;
   r = drand48() * count_inv;
-  c = set_a->samples[0].weight;
+  c = set_a->weight[0];
   i = 0;
   m = 0;
   */
-  while(set_b->sample_count < pf->max_samples)
+  while(pf->resample_model == PF_RESAMPLE_MULTINOMIAL &&
+        set_b->sample_count < pf->max_samples)
   {
-    sample_b = set_b->samples + set_b->sample_count++;
+    b = set_b->sample_count++;
 
     if(drand48() < w_diff)
-      sample_b->pose = (pf->random_pose_fn)(pf->random_pose_data);
+    {
+      pose = (pf->random_pose_fn)(pf->random_pose_data);
+      pf_set_sample_pose(set_b, b, pose);
+    }
     else
     {
       // Can't (easily) combine low-variance sampler with KLD adaptive
@@ -379,13 +409,13 @@ void pf_update_resample(pf_t *pf)
         if(i >= set_a->sample_count)
         {
           r = drand48() * count_inv;
-          c = set_a->samples[0].weight;
+          c = set_a->weight[0];
           i = 0;
           m = 0;
           U = r + m * count_inv;
           continue;
         }
-        c += set_a->samples[i].weight;
+        c += set_a->weight[i];
       }
       m++;
       */
@@ -400,22 +430,27 @@ void pf_update_resample(pf_t *pf)
       }
       assert(i<set_a->sample_count);
 
-      sample_a = set_a->samples + i;
-
-      assert(sample_a->weight > 0);
+      assert(set_a->weight[i] > 0);
 
       // Add sample to list
-      sample_b->pose = sample_a->pose;
+      set_b->x[b] = set_a->x[i];
+      set_b->y[b] = set_a->y[i];
+      set_b->theta[b] = set_a->theta[i];
     }
 
-    sample_b->weight = 1.0;
-    total += sample_b->weight;
+    set_b->weight[b] = 1.0;
+    total += set_b->weight[b];
 
     // Add sample to histogram
-    pf_kdtree_insert(set_b->kdtree, sample_b->pose, sample_b->weight);
+    pf_kdtree_insert(set_b->kdtree, pf_get_sample_pose(set_b, b), set_b->weight[b]);
 
     // See if we have enough samples yet
-    if (set_b->sample_count > pf_resample_limit(pf, set_b->kdtree->leaf_count))
+    if (set_b->kdtree->leaf_count != limit_leaves)
+    {
+      limit_leaves = set_b->kdtree->leaf_count;
+      limit = pf_resample_limit(pf, limit_leaves);
+    }
+    if (set_b->sample_count > limit)
       break;
   }
   
@@ -427,13 +462,17 @@ void pf_update_resample(pf_t *pf)
 
   // Normalize weights
   for (i = 0; i < set_b->sample_count; i++)
-  {
-    sample_b = set_b->samples + i;
-    sample_b->weight /= total;
-  }
+    set_b->weight[i] /= total;
   
   // Re-compute cluster statistics
-  pf_cluster_stats(pf, set_b);
+  if (pf->timing)
+  {
+    double t = pf_wall_time();
+    pf_cluster_stats(pf, set_b);
+    pf->cluster_time = pf_wall_time() - t;
+  }
+  else
+    pf_cluster_stats(pf, set_b);
 
   // Use the newly created sample set
   pf->current_set = (pf->current_set + 1) % 2; 
@@ -445,22 +484,92 @@ void pf_update_resample(pf_t *pf)
 }
 
 
+// Draw the samples of set b from set a with a systematic resampler.  The
+// weights are walked once with evenly spaced offsets from a single random
+// number, which takes linear time and has less variance than drawing every
+// sample independently.  The offsets depend on the number of samples, so
+// KLD adaptive sampling cannot stop the walk half way.  Instead a first walk
+// with max_samples offsets finds the samples that are kept, the bins they
+// fall in give the sample count, and a second walk draws that many samples.
+// The bins of the second walk are a subset of the first, so the count is
+// never below what KLD sampling would ask for.  Returns the total weight of
+// set b.
+double pf_resample_systematic(pf_t *pf, pf_sample_set_t *set_a, pf_sample_set_t *set_b,
+                              double *c, double w_diff)
+{
+  int i, j, n, last;
+  double step, u;
+  pf_vector_t pose;
+
+  // Count the bins of the samples kept by a walk with max_samples offsets
+  step = c[set_a->sample_count] / pf->max_samples;
+  u = drand48() * step;
+  i = 0;
+  last = -1;
+  for (j = 0; j < pf->max_samples; j++, u += step)
+  {
+    while (i < set_a->sample_count - 1 && c[i+1] <= u)
+      i++;
+    if (i != last)
+      pf_kdtree_insert(set_b->kdtree, pf_get_sample_pose(set_a, i), set_a->weight[i]);
+    last = i;
+  }
+  n = pf_resample_limit(pf, set_b->kdtree->leaf_count);
+
+  // Draw the samples
+  pf_kdtree_clear(set_b->kdtree);
+  step = c[set_a->sample_count] / n;
+  u = drand48() * step;
+  i = 0;
+  for (j = 0; j < n; j++, u += step)
+  {
+    while (i < set_a->sample_count - 1 && c[i+1] <= u)
+      i++;
+
+    if (w_diff > 0.0 && drand48() < w_diff)
+    {
+      pose = (pf->random_pose_fn)(pf->random_pose_data);
+      pf_set_sample_pose(set_b, j, pose);
+    }
+    else
+    {
+      set_b->x[j] = set_a->x[i];
+      set_b->y[j] = set_a->y[i];
+      set_b->theta[j] = set_a->theta[i];
+    }
+    set_b->weight[j] = 1.0;
+
+    // Add sample to histogram
+    pf_kdtree_insert(set_b->kdtree, pf_get_sample_pose(set_b, j), set_b->weight[j]);
+  }
+  set_b->sample_count = n;
+
+  return n;
+}
+
+
 // Compute the required number of samples, given that there are k bins
 // with samples in them.  This is taken directly from Fox et al.
 int pf_resample_limit(pf_t *pf, int k)
 {
-  double a, b, c, x;
+  double a, b, c, x, err;
   int n;
 
   if (k <= 1)
     return pf->max_samples;
 
+  // A converged filter may get away with a looser bound, it falls back to
+  // pop_err as soon as the samples spread out again
+  err = pf->pop_err;
+  if (pf->converged && pf->converged_pop_err > err)
+    err = pf->converged_pop_err;
+
   a = 1;
   b = 2 / (9 * ((double) k - 1));
   c = sqrt(2 / (9 * ((double) k - 1))) * pf->pop_z;
   x = a - b + c;
 
-  n = (int) ceil((k - 1) / (2 * pf->pop_err) * x * x * x);
+  n = (int) ceil((k - 1) / (2 * err) * x * x * x);
 
   if (n < pf->min_samples)
     return pf->min_samples;
@@ -471,11 +580,15 @@ int pf_resample_limit(pf_t *pf, int k)
 }
 
 
-// Re-compute the cluster statistics for a sample set
+// Re-compute the cluster statistics for a sample set.  The histogram
+// holds the moments of the samples in each of its cells, accumulated as
+// they were inserted, so this only passes over the cells.  The values
+// inserted must be proportional to the normalized sample weights.
 void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set)
 {
   int i, j, k, cidx;
-  pf_sample_t *sample;
+  double w, scale;
+  pf_kdtree_node_t *node;
   pf_cluster_t *cluster;
   
   // Workspace
@@ -509,21 +622,39 @@ void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set)
   weight = 0.0;
   set->mean = pf_vector_zero();
   set->cov = pf_matrix_zero();
+  for (j = 0; j < 2; j++)
+  {
+    set->min[j] = DBL_MAX;
+    set->max[j] = -DBL_MAX;
+  }
   for (j = 0; j < 4; j++)
     m[j] = 0.0;
   for (j = 0; j < 2; j++)
     for (k = 0; k < 2; k++)
       c[j][k] = 0.0;
   
+  // The sample weights sum to one, the histogram values may not
+  scale = 0.0;
+  for (i = 0; i < set->kdtree->node_count; i++)
+    scale += set->kdtree->nodes[i].value;
+  scale = 1.0 / scale;
+
   // Compute cluster stats
-  for (i = 0; i < set->sample_count; i++)
+  for (i = 0; i < set->kdtree->node_count; i++)
   {
-    sample = set->samples + i;
+    node = set->kdtree->nodes + i;
+    w = scale * node->value;
 
-    //printf("%d %f %f %f\n", i, sample->pose.v[0], sample->pose.v[1], sample->pose.v[2]);
+    for (j = 0; j < 2; j++)
+    {
+      if (node->min[j] < set->min[j])
+        set->min[j] = node->min[j];
+      if (node->max[j] > set->max[j])
+        set->max[j] = node->max[j];
+    }
 
-    // Get the cluster label for this sample
-    cidx = pf_kdtree_get_cluster(set->kdtree, sample->pose);
+    // Get the cluster label for this cell
+    cidx = node->cluster;
     assert(cidx >= 0);
     if (cidx >= set->cluster_max_count)
       continue;
@@ -532,29 +663,25 @@ void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set)
     
     cluster = set->clusters + cidx;
 
-    cluster->count += 1;
-    cluster->weight += sample->weight;
+    cluster->count += node->count;
+    cluster->weight += w;
 
-    count += 1;
-    weight += sample->weight;
+    count += node->count;
+    weight += w;
 
     // Compute mean
-    cluster->m[0] += sample->weight * sample->pose.v[0];
-    cluster->m[1] += sample->weight * sample->pose.v[1];
-    cluster->m[2] += sample->weight * cos(sample->pose.v[2]);
-    cluster->m[3] += sample->weight * sin(sample->pose.v[2]);
-
-    m[0] += sample->weight * sample->pose.v[0];
-    m[1] += sample->weight * sample->pose.v[1];
-    m[2] += sample->weight * cos(sample->pose.v[2]);
-    m[3] += sample->weight * sin(sample->pose.v[2]);
+    for (j = 0; j < 4; j++)
+    {
+      cluster->m[j] += scale * node->m[j];
+      m[j] += scale * node->m[j];
+    }
 
     // Compute covariance in linear components
     for (j = 0; j < 2; j++)
       for (k = 0; k < 2; k++)
       {
-        cluster->c[j][k] += sample->weight * sample->pose.v[j] * sample->pose.v[k];
-        c[j][k] += sample->weight * sample->pose.v[j] * sample->pose.v[k];
+        cluster->c[j][k] += scale * node->c[j][k];
+        c[j][k] += scale * node->c[j][k];
       }
   }
 
@@ -609,7 +736,6 @@ void pf_get_cep_stats(pf_t *pf, pf_vector_t *mean, double *var)
   int i;
   double mn, mx, my, mrr;
   pf_sample_set_t *set;
-  pf_sample_t *sample;
   
   set = pf->sets + pf->current_set;
 
@@ -620,13 +746,11 @@ void pf_get_cep_stats(pf_t *pf, pf_vector_t *mean, double *var)
   
   for (i = 0; i < set->sample_count; i++)
   {
-    sample = set->samples + i;
-
-    mn += sample->weight;
-    mx += sample->weight * sample->pose.v[0];
-    my += sample->weight * sample->pose.v[1];
-    mrr += sample->weight * sample->pose.v[0] * sample->pose.v[0];
-    mrr += sample->weight * sample->pose.v[1] * sample->pose.v[1];
+    mn += set->weight[i];
+    mx += set->weight[i] * set->x[i];
+    my += set->weight[i] * set->y[i];
+    mrr += set->weight[i] * set->x[i] * set->x[i];
+    mrr += set->weight[i] * set->y[i] * set->y[i];
   }
 
   mean->v[0] = mx / mn;
@@ -660,3 +784,10 @@ int pf_get_cluster_stats(pf_t *pf, int clabel, double *weight,
 }
 
 
+// Monotonic wall time in seconds
+double pf_wall_time(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
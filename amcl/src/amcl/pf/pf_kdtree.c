@@ -35,26 +35,25 @@
 #include "pf_kdtree.h"
 
 
+// Compute the key for a pose
+static void pf_kdtree_key(pf_kdtree_t *self, pf_vector_t pose, int key[]);
+
 // Compare keys to see if they are equal
 static int pf_kdtree_equal(pf_kdtree_t *self, int key_a[], int key_b[]);
 
-// Insert a node into the tree
-static pf_kdtree_node_t *pf_kdtree_insert_node(pf_kdtree_t *self, pf_kdtree_node_t *parent,
-                                               pf_kdtree_node_t *node, int key[], double value);
-
-// Recursive node search
-static pf_kdtree_node_t *pf_kdtree_find_node(pf_kdtree_t *self, pf_kdtree_node_t *node, int key[]);
+// Hash a key onto the table
+static unsigned int pf_kdtree_hash(pf_kdtree_t *self, int key[]);
 
-// Recursively label nodes in this cluster
-static void pf_kdtree_cluster_node(pf_kdtree_t *self, pf_kdtree_node_t *node, int depth);
+// Find the node for a key, or the empty slot where it would go
+static pf_kdtree_node_t *pf_kdtree_find_node(pf_kdtree_t *self, int key[], int *slot);
 
-// Recursive node printing
-//static void pf_kdtree_print_node(pf_kdtree_t *self, pf_kdtree_node_t *node);
+// Find the cluster root of a node, compressing the path on the way
+static int pf_kdtree_find_root(int *parent, int i);
 
 
 #ifdef INCLUDE_RTKGUI
 
-// Recursively draw nodes
+// Draw a node
 static void pf_kdtree_draw_node(pf_kdtree_t *self, pf_kdtree_node_t *node, rtk_fig_t *fig);
 
 #endif
@@ -65,6 +64,7 @@ static void pf_kdtree_draw_node(pf_kdtree_t *self, pf_kdtree_node_t *node, rtk_f
 // Create a tree
 pf_kdtree_t *pf_kdtree_alloc(int max_size)
 {
+  int i;
   pf_kdtree_t *self;
 
   self = calloc(1, sizeof(pf_kdtree_t));
@@ -73,12 +73,18 @@ pf_kdtree_t *pf_kdtree_alloc(int max_size)
   self->size[1] = 0.50;
   self->size[2] = (10 * M_PI / 180);
 
-  self->root = NULL;
-
   self->node_count = 0;
   self->node_max_count = max_size;
   self->nodes = calloc(self->node_max_count, sizeof(pf_kdtree_node_t));
 
+  // Keep the load factor below one half so probe sequences stay short
+  self->table_size = 1;
+  while (self->table_size < 2 * max_size)
+    self->table_size *= 2;
+  self->table = malloc(self->table_size * sizeof(self->table[0]));
+  for (i = 0; i < self->table_size; i++)
+    self->table[i] = -1;
+
   self->leaf_count = 0;
 
   return self;
@@ -89,6 +95,7 @@ pf_kdtree_t *pf_kdtree_alloc(int max_size)
 // Destroy a tree
 void pf_kdtree_free(pf_kdtree_t *self)
 {
+  free(self->table);
   free(self->nodes);
   free(self);
   return;
@@ -99,7 +106,12 @@ void pf_kdtree_free(pf_kdtree_t *self)
 // Clear all entries from the tree
 void pf_kdtree_clear(pf_kdtree_t *self)
 {
-  self->root = NULL;
+  int i;
+
+  // Only the slots in use need emptying
+  for (i = 0; i < self->node_count; i++)
+    self->table[self->nodes[i].slot] = -1;
+
   self->leaf_count = 0;
   self->node_count = 0;
 
@@ -111,34 +123,54 @@ void pf_kdtree_clear(pf_kdtree_t *self)
 // Insert a pose into the tree.
 void pf_kdtree_insert(pf_kdtree_t *self, pf_vector_t pose, double value)
 {
+  int i, j, slot;
   int key[3];
+  pf_kdtree_node_t *node;
 
-  key[0] = floor(pose.v[0] / self->size[0]);
-  key[1] = floor(pose.v[1] / self->size[1]);
-  key[2] = floor(pose.v[2] / self->size[2]);
-
-  self->root = pf_kdtree_insert_node(self, NULL, self->root, key, value);
-
-  // Test code
-  /*
-  printf("find %d %d %d\n", key[0], key[1], key[2]);
-  assert(pf_kdtree_find_node(self, self->root, key) != NULL);
+  pf_kdtree_key(self, pose, key);
 
-  pf_kdtree_print_node(self, self->root);
+  node = pf_kdtree_find_node(self, key, &slot);
+  if (node == NULL)
+  {
+    assert(self->node_count < self->node_max_count);
+    node = self->nodes + self->node_count;
+    for (i = 0; i < 3; i++)
+      node->key[i] = key[i];
+    node->value = 0.0;
+    node->count = 0;
+    for (i = 0; i < 4; i++)
+      node->m[i] = 0.0;
+    for (i = 0; i < 2; i++)
+      for (j = 0; j < 2; j++)
+        node->c[i][j] = 0.0;
+    for (i = 0; i < 2; i++)
+      node->min[i] = node->max[i] = pose.v[i];
+    node->cluster = -1;
+    node->slot = slot;
+    self->table[slot] = self->node_count++;
 
-  printf("\n");
+    self->leaf_count += 1;
+  }
 
-  for (i = 0; i < self->node_count; i++)
+  node->value += value;
+
+  // Accumulate the moments here, so the cluster statistics need no
+  // second pass over the samples
+  node->count += 1;
+  node->m[0] += value * pose.v[0];
+  node->m[1] += value * pose.v[1];
+  node->m[2] += value * cos(pose.v[2]);
+  node->m[3] += value * sin(pose.v[2]);
+  for (i = 0; i < 2; i++)
+    for (j = 0; j < 2; j++)
+      node->c[i][j] += value * pose.v[i] * pose.v[j];
+  for (i = 0; i < 2; i++)
   {
-    node = self->nodes + i;
-    if (node->leaf)
-    {
-      printf("find %d %d %d\n", node->key[0], node->key[1], node->key[2]);
-      assert(pf_kdtree_find_node(self, self->root, node->key) == node);
-    }
+    if (pose.v[i] < node->min[i])
+      node->min[i] = pose.v[i];
+    if (pose.v[i] > node->max[i])
+      node->max[i] = pose.v[i];
   }
-  printf("\n\n");
-  */
 
   return;
 }
@@ -152,11 +184,9 @@ double pf_kdtree_get_prob(pf_kdtree_t *self, pf_vector_t pose)
   int key[3];
   pf_kdtree_node_t *node;
 
-  key[0] = floor(pose.v[0] / self->size[0]);
-  key[1] = floor(pose.v[1] / self->size[1]);
-  key[2] = floor(pose.v[2] / self->size[2]);
+  pf_kdtree_key(self, pose, key);
 
-  node = pf_kdtree_find_node(self, self->root, key);
+  node = pf_kdtree_find_node(self, key, NULL);
   if (node == NULL)
     return 0.0;
   return node->value;
@@ -170,17 +200,26 @@ int pf_kdtree_get_cluster(pf_kdtree_t *self, pf_vector_t pose)
   int key[3];
   pf_kdtree_node_t *node;
 
-  key[0] = floor(pose.v[0] / self->size[0]);
-  key[1] = floor(pose.v[1] / self->size[1]);
-  key[2] = floor(pose.v[2] / self->size[2]);
+  pf_kdtree_key(self, pose, key);
 
-  node = pf_kdtree_find_node(self, self->root, key);
+  node = pf_kdtree_find_node(self, key, NULL);
   if (node == NULL)
     return -1;
   return node->cluster;
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// Compute the key for a pose
+void pf_kdtree_key(pf_kdtree_t *self, pf_vector_t pose, int key[])
+{
+  key[0] = floor(pose.v[0] / self->size[0]);
+  key[1] = floor(pose.v[1] / self->size[1]);
+  key[2] = floor(pose.v[2] / self->size[2]);
+  return;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // Compare keys to see if they are equal
 int pf_kdtree_equal(pf_kdtree_t *self, int key_a[], int key_b[])
@@ -195,7 +234,7 @@ int pf_kdtree_equal(pf_kdtree_t *self, int key_a[], int key_b[])
   if (key_a[2] != key_b[2])
     return 0;
 
-  /* TODO: make this work (pivot selection needs fixing, too)
+  /* TODO: make this work (the hash needs fixing, too)
   // Normalize angles
   a = key_a[2] * self->size[2];
   a = atan2(sin(a), cos(a)) / self->size[2];
@@ -211,231 +250,122 @@ int pf_kdtree_equal(pf_kdtree_t *self, int key_a[], int key_b[])
 
 
 ////////////////////////////////////////////////////////////////////////////////
-// Insert a node into the tree
-pf_kdtree_node_t *pf_kdtree_insert_node(pf_kdtree_t *self, pf_kdtree_node_t *parent,
-                                        pf_kdtree_node_t *node, int key[], double value)
+// Hash a key onto the table
+unsigned int pf_kdtree_hash(pf_kdtree_t *self, int key[])
 {
-  int i;
-  int split, max_split;
-
-  // If the node doesnt exist yet...
-  if (node == NULL)
-  {
-    assert(self->node_count < self->node_max_count);
-    node = self->nodes + self->node_count++;
-    memset(node, 0, sizeof(pf_kdtree_node_t));
-
-    node->leaf = 1;
-
-    if (parent == NULL)
-      node->depth = 0;
-    else
-      node->depth = parent->depth + 1;
-
-    for (i = 0; i < 3; i++)
-      node->key[i] = key[i];
-
-    node->value = value;
-    self->leaf_count += 1;
-  }
-
-  // If the node exists, and it is a leaf node...
-  else if (node->leaf)
-  {
-    // If the keys are equal, increment the value
-    if (pf_kdtree_equal(self, key, node->key))
-    {
-      node->value += value;
-    }
-
-    // The keys are not equal, so split this node
-    else
-    {
-      // Find the dimension with the largest variance and do a mean
-      // split
-      max_split = 0;
-      node->pivot_dim = -1;
-      for (i = 0; i < 3; i++)
-      {
-        split = abs(key[i] - node->key[i]);
-        if (split > max_split)
-        {
-          max_split = split;
-          node->pivot_dim = i;
-        }
-      }
-      assert(node->pivot_dim >= 0);
-
-      node->pivot_value = (key[node->pivot_dim] + node->key[node->pivot_dim]) / 2.0;
-
-      if (key[node->pivot_dim] < node->pivot_value)
-      {
-        node->children[0] = pf_kdtree_insert_node(self, node, NULL, key, value);
-        node->children[1] = pf_kdtree_insert_node(self, node, NULL, node->key, node->value);
-      }
-      else
-      {
-        node->children[0] = pf_kdtree_insert_node(self, node, NULL, node->key, node->value);
-        node->children[1] = pf_kdtree_insert_node(self, node, NULL, key, value);
-      }
-
-      node->leaf = 0;
-      self->leaf_count -= 1;
-    }
-  }
+  unsigned int h;
 
-  // If the node exists, and it has children...
-  else
-  {
-    assert(node->children[0] != NULL);
-    assert(node->children[1] != NULL);
-
-    if (key[node->pivot_dim] < node->pivot_value)
-      pf_kdtree_insert_node(self, node, node->children[0], key, value);
-    else
-      pf_kdtree_insert_node(self, node, node->children[1], key, value);
-  }
+  h = (unsigned int) key[0] * 73856093u;
+  h ^= (unsigned int) key[1] * 19349663u;
+  h ^= (unsigned int) key[2] * 83492791u;
+  h ^= h >> 16;
 
-  return node;
+  return h & (self->table_size - 1);
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-// Recursive node search
-pf_kdtree_node_t *pf_kdtree_find_node(pf_kdtree_t *self, pf_kdtree_node_t *node, int key[])
+// Find the node for a key, or the empty slot where it would go
+pf_kdtree_node_t *pf_kdtree_find_node(pf_kdtree_t *self, int key[], int *slot)
 {
-  if (node->leaf)
+  unsigned int i;
+  pf_kdtree_node_t *node;
+
+  // Linear probing; the table is never more than half full
+  for (i = pf_kdtree_hash(self, key); ; i = (i + 1) & (self->table_size - 1))
   {
-    //printf("find  : leaf %p %d %d %d\n", node, node->key[0], node->key[1], node->key[2]);
+    if (self->table[i] < 0)
+    {
+      if (slot != NULL)
+        *slot = i;
+      return NULL;
+    }
 
-    // If the keys are the same...
+    node = self->nodes + self->table[i];
     if (pf_kdtree_equal(self, key, node->key))
       return node;
-    else
-      return NULL;
-  }
-  else
-  {
-    //printf("find  : brch %p %d %f\n", node, node->pivot_dim, node->pivot_value);
-
-    assert(node->children[0] != NULL);
-    assert(node->children[1] != NULL);
-
-    // If the keys are different...
-    if (key[node->pivot_dim] < node->pivot_value)
-      return pf_kdtree_find_node(self, node->children[0], key);
-    else
-      return pf_kdtree_find_node(self, node->children[1], key);
   }
 
   return NULL;
 }
 
 
-////////////////////////////////////////////////////////////////////////////////
-// Recursive node printing
-/*
-void pf_kdtree_print_node(pf_kdtree_t *self, pf_kdtree_node_t *node)
-{
-  if (node->leaf)
-  {
-    printf("(%+02d %+02d %+02d)\n", node->key[0], node->key[1], node->key[2]);
-    printf("%*s", node->depth * 11, "");
-  }
-  else
-  {
-    printf("(%+02d %+02d %+02d) ", node->key[0], node->key[1], node->key[2]);
-    pf_kdtree_print_node(self, node->children[0]);
-    pf_kdtree_print_node(self, node->children[1]);
-  }
-  return;
-}
-*/
-
-
 ////////////////////////////////////////////////////////////////////////////////
 // Cluster the leaves in the tree
 void pf_kdtree_cluster(pf_kdtree_t *self)
 {
-  int i;
-  int queue_count, cluster_count;
-  pf_kdtree_node_t **queue, *node;
+  int i, j, a, b;
+  int cluster_count;
+  int nkey[3];
+  int *parent;
+  pf_kdtree_node_t *node, *nnode;
 
-  queue_count = 0;
-  queue = calloc(self->node_count, sizeof(queue[0]));
+  parent = malloc(self->node_count * sizeof(parent[0]));
+
+  for (i = 0; i < self->node_count; i++)
+    parent[i] = i;
 
-  // Put all the leaves in a queue
+  // Join each cell with its occupied neighbours.  Adjacency is
+  // symmetric, so only the 13 neighbours on one side of the cell need
+  // checking; the other 13 see this cell in turn.
   for (i = 0; i < self->node_count; i++)
   {
     node = self->nodes + i;
-    if (node->leaf)
-    {
-      node->cluster = -1;
-      assert(queue_count < self->node_count);
-      queue[queue_count++] = node;
 
-      // TESTING; remove
-      assert(node == pf_kdtree_find_node(self, self->root, node->key));
+    for (j = 3 * 3 * 3 / 2 + 1; j < 3 * 3 * 3; j++)
+    {
+      nkey[0] = node->key[0] + (j / 9) - 1;
+      nkey[1] = node->key[1] + ((j % 9) / 3) - 1;
+      nkey[2] = node->key[2] + ((j % 9) % 3) - 1;
+
+      nnode = pf_kdtree_find_node(self, nkey, NULL);
+      if (nnode == NULL)
+        continue;
+
+      a = pf_kdtree_find_root(parent, i);
+      b = pf_kdtree_find_root(parent, nnode - self->nodes);
+      if (a < b)
+        parent[b] = a;
+      else if (b < a)
+        parent[a] = b;
     }
   }
 
+  // Number the clusters.  Roots are the lowest index of their set, so
+  // they are always labelled before the rest of it.
   cluster_count = 0;
-
-  // Do connected components for each node
-  while (queue_count > 0)
+  for (i = 0; i < self->node_count; i++)
   {
-    node = queue[--queue_count];
-
-    // If this node has already been labelled, skip it
-    if (node->cluster >= 0)
-      continue;
-
-    // Assign a label to this cluster
-    node->cluster = cluster_count++;
-
-    // Recursively label nodes in this cluster
-    pf_kdtree_cluster_node(self, node, 0);
+    a = pf_kdtree_find_root(parent, i);
+    if (a == i)
+      self->nodes[i].cluster = cluster_count++;
+    else
+      self->nodes[i].cluster = self->nodes[a].cluster;
   }
 
-  free(queue);
+  free(parent);
   return;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-// Recursively label nodes in this cluster
-void pf_kdtree_cluster_node(pf_kdtree_t *self, pf_kdtree_node_t *node, int depth)
+// Find the cluster root of a node, compressing the path on the way
+int pf_kdtree_find_root(int *parent, int i)
 {
-  int i;
-  int nkey[3];
-  pf_kdtree_node_t *nnode;
-
-  for (i = 0; i < 3 * 3 * 3; i++)
-  {
-    nkey[0] = node->key[0] + (i / 9) - 1;
-    nkey[1] = node->key[1] + ((i % 9) / 3) - 1;
-    nkey[2] = node->key[2] + ((i % 9) % 3) - 1;
+  int root, next;
 
-    nnode = pf_kdtree_find_node(self, self->root, nkey);
-    if (nnode == NULL)
-      continue;
+  root = i;
+  while (parent[root] != root)
+    root = parent[root];
 
-    assert(nnode->leaf);
-
-    // This node already has a label; skip it.  The label should be
-    // consistent, however.
-    if (nnode->cluster >= 0)
-    {
-      assert(nnode->cluster == node->cluster);
-      continue;
-    }
-
-    // Label this node and recurse
-    nnode->cluster = node->cluster;
-
-    pf_kdtree_cluster_node(self, nnode, depth + 1);
+  while (parent[i] != root)
+  {
+    next = parent[i];
+    parent[i] = root;
+    i = next;
   }
-  return;
+
+  return root;
 }
 
 
@@ -446,39 +376,31 @@ void pf_kdtree_cluster_node(pf_kdtree_t *self, pf_kdtree_node_t *node, int depth
 // Draw the tree
 void pf_kdtree_draw(pf_kdtree_t *self, rtk_fig_t *fig)
 {
-  if (self->root != NULL)
-    pf_kdtree_draw_node(self, self->root, fig);
+  int i;
+
+  for (i = 0; i < self->node_count; i++)
+    pf_kdtree_draw_node(self, self->nodes + i, fig);
   return;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-// Recursively draw nodes
+// Draw a node
 void pf_kdtree_draw_node(pf_kdtree_t *self, pf_kdtree_node_t *node, rtk_fig_t *fig)
 {
   double ox, oy;
   char text[64];
 
-  if (node->leaf)
-  {
-    ox = (node->key[0] + 0.5) * self->size[0];
-    oy = (node->key[1] + 0.5) * self->size[1];
+  ox = (node->key[0] + 0.5) * self->size[0];
+  oy = (node->key[1] + 0.5) * self->size[1];
 
-    rtk_fig_rectangle(fig, ox, oy, 0.0, self->size[0], self->size[1], 0);
+  rtk_fig_rectangle(fig, ox, oy, 0.0, self->size[0], self->size[1], 0);
 
-    //snprintf(text, sizeof(text), "%0.3f", node->value);
-    //rtk_fig_text(fig, ox, oy, 0.0, text);
+  //snprintf(text, sizeof(text), "%0.3f", node->value);
+  //rtk_fig_text(fig, ox, oy, 0.0, text);
 
-    snprintf(text, sizeof(text), "%d", node->cluster);
-    rtk_fig_text(fig, ox, oy, 0.0, text);
-  }
-  else
-  {
-    assert(node->children[0] != NULL);
-    assert(node->children[1] != NULL);
-    pf_kdtree_draw_node(self, node->children[0], fig);
-    pf_kdtree_draw_node(self, node->children[1], fig);
-  }
+  snprintf(text, sizeof(text), "%d", node->cluster);
+  rtk_fig_text(fig, ox, oy, 0.0, text);
 
   return;
 }
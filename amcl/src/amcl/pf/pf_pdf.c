@@ -145,6 +145,87 @@ double pf_ran_gaussian(double sigma)
   return(sigma * x2 * sqrt(-2.0*log(w)/w));
 }
 
+
+/**************************************************************************
+ * Counter-based random numbers
+ *************************************************************************/
+
+// Make a key from a seed
+pf_ran_key_t pf_ran_key(uint64_t seed)
+{
+  pf_ran_key_t key;
+
+  key.k[0] = (uint32_t) seed;
+  key.k[1] = (uint32_t) (seed >> 32);
+
+  return key;
+}
+
+
+// Draw four 32 bit random numbers for the counter
+void pf_ran_philox(pf_ran_key_t key, const uint32_t c[4], uint32_t r[4])
+{
+  int i;
+  uint32_t x0, x1, x2, x3, k0, k1;
+  uint64_t p0, p1;
+
+  x0 = c[0];
+  x1 = c[1];
+  x2 = c[2];
+  x3 = c[3];
+  k0 = key.k[0];
+  k1 = key.k[1];
+
+  for (i = 0; i < 10; i++)
+  {
+    p0 = (uint64_t) 0xD2511F53u * x0;
+    p1 = (uint64_t) 0xCD9E8D57u * x2;
+
+    x0 = (uint32_t) (p1 >> 32) ^ x1 ^ k0;
+    x1 = (uint32_t) p1;
+    x2 = (uint32_t) (p0 >> 32) ^ x3 ^ k1;
+    x3 = (uint32_t) p0;
+
+    // Bump the key (Weyl sequence)
+    k0 += 0x9E3779B9u;
+    k1 += 0xBB67AE85u;
+  }
+
+  r[0] = x0;
+  r[1] = x1;
+  r[2] = x2;
+  r[3] = x3;
+
+  return;
+}
+
+
+// Draw four independent Gaussian samples for the counter (c0, c1)
+void pf_ran_gaussian4(pf_ran_key_t key, uint32_t c0, uint32_t c1, double z[4])
+{
+  int i;
+  uint32_t c[4], r[4];
+  double u, v, s;
+
+  c[0] = c0;
+  c[1] = c1;
+  c[2] = 0;
+  c[3] = 0;
+  pf_ran_philox(key, c, r);
+
+  for (i = 0; i < 4; i += 2)
+  {
+    // u is in (0, 1], so the log is always finite
+    u = (r[i] + 1.0) * (1.0 / 4294967296.0);
+    v = r[i + 1] * (2 * M_PI / 4294967296.0);
+    s = sqrt(-2.0 * log(u));
+    z[i] = s * cos(v);
+    z[i + 1] = s * sin(v);
+  }
+
+  return;
+}
+
 #if 0
 
 /**************************************************************************
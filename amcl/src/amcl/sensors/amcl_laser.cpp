@@ -29,36 +29,42 @@
 
 #include <sys/types.h> // required by Darwin
 #include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <unistd.h>
+#include <vector>
+#include <algorithm>
 
 #include "amcl_laser.h"
+#include "amcl_laser_gpu.h"
 
 using namespace amcl;
 
 ////////////////////////////////////////////////////////////////////////////////
 // Default constructor
 AMCLLaser::AMCLLaser(size_t max_beams, map_t* map) : AMCLSensor(), 
-						     max_samples(0), max_obs(0), 
-						     temp_obs(NULL)
+						     max_samples(0), max_obs(0)
 {
   this->time = 0.0;
 
   this->max_beams = max_beams;
   this->map = map;
+  this->hit_prob_max_occ_dist = -1.0;
+  this->pose_cache_xy = 0.0;
+  this->pose_cache_theta = 0.0;
+  this->adaptive_beams = false;
+  this->beam_stats_candidates = 0;
+  this->beam_stats_selected = 0;
+  this->beam_stats_score_fraction = 0.0;
+  this->likelihood_tile_size = 0;
+  this->likelihood_max_tiles = 0;
 
   return;
 }
 
 AMCLLaser::~AMCLLaser()
 {
-  if(temp_obs){
-	for(int k=0; k < max_samples; k++){
-	  delete [] temp_obs[k];
-	}
-	delete []temp_obs; 
-  }
 }
 
 void 
@@ -68,7 +74,8 @@ AMCLLaser::SetModelBeam(double z_hit,
                         double z_rand,
                         double sigma_hit,
                         double lambda_short,
-                        double chi_outlier)
+                        double chi_outlier,
+                        int range_table_angles)
 {
   this->model_type = LASER_MODEL_BEAM;
   this->z_hit = z_hit;
@@ -78,6 +85,12 @@ AMCLLaser::SetModelBeam(double z_hit,
   this->sigma_hit = sigma_hit;
   this->lambda_short = lambda_short;
   this->chi_outlier = chi_outlier;
+
+  // The table belongs to the map, so it is only built once per map
+  if(this->map->range_angles != range_table_angles &&
+     map_update_ranges(this->map, range_table_angles) < 0)
+    fprintf(stderr, "Could not allocate a range table with %d directions, casting rays instead\n",
+            range_table_angles);
 }
 
 void 
@@ -91,7 +104,8 @@ AMCLLaser::SetModelLikelihoodField(double z_hit,
   this->z_rand = z_rand;
   this->sigma_hit = sigma_hit;
 
-  map_update_cspace(this->map, max_occ_dist);
+  UpdateLikelihoodField(max_occ_dist);
+  UpdateHitProb();
 }
 
 void 
@@ -112,7 +126,97 @@ AMCLLaser::SetModelLikelihoodFieldProb(double z_hit,
   this->beam_skip_distance = beam_skip_distance;
   this->beam_skip_threshold = beam_skip_threshold;
   this->beam_skip_error_threshold = beam_skip_error_threshold;
+  UpdateLikelihoodField(max_occ_dist);
+  UpdateHitProb();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Weight the samples on a CUDA device
+bool AMCLLaser::SetUseGPU(bool use_gpu)
+{
+  this->device.reset();
+#ifdef AMCL_USE_CUDA
+  if(use_gpu)
+    this->device.reset(LikelihoodFieldDevice::Create());
+#endif
+  return !use_gpu || this->device.get() != NULL;
+}
+
+bool AMCLLaser::WeighOnDevice(pf_sample_set_t* set,
+                              const std::vector<double>& ex,
+                              const std::vector<double>& ey,
+                              double range_max, bool log_model,
+                              std::vector<double>& p)
+{
+  // The device holds the whole distance field
+  if(this->device.get() == NULL || this->map->tile_size > 0)
+    return false;
+
+#ifdef AMCL_USE_CUDA
+  p.resize(set->sample_count);
+  if(this->device->Weigh(this->map, set, this->laser_pose, ex, ey,
+                         this->hit_prob, this->z_hit, this->z_rand / range_max,
+                         log_model, p.empty() ? NULL : &p[0]))
+    return true;
+  fprintf(stderr, "Could not weight the samples on the GPU, using the CPU from now on\n");
+  this->device.reset();
+#endif
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Make sure the map has a distance field for max_occ_dist
+void AMCLLaser::UpdateLikelihoodField(double max_occ_dist)
+{
+  // Lasers sharing the map, and models recreated on reconfigure, reuse the
+  // field that is already there
+  if(this->map->occ_dist != NULL && this->map->max_occ_dist == max_occ_dist)
+    return;
+
+  // Tiles are computed as the filter gets to them, so there is nothing to
+  // cache
+  if(this->likelihood_tile_size > 0)
+  {
+    if(map_set_tiles(this->map, max_occ_dist, this->likelihood_tile_size,
+                     this->likelihood_max_tiles) == 0)
+      return;
+    fprintf(stderr, "Could not tile the likelihood field, computing all of it\n");
+  }
+
+  std::string path;
+  if(!this->likelihood_field_cache.empty())
+  {
+    char name[64];
+    snprintf(name, sizeof(name), "/amcl_field_%016llx_%g.bin",
+             (unsigned long long) map_hash_occ(this->map), max_occ_dist);
+    path = this->likelihood_field_cache + name;
+    if(map_load_cspace(this->map, max_occ_dist, path.c_str()) == 0)
+      return;
+  }
+
   map_update_cspace(this->map, max_occ_dist);
+
+  // Write under a temporary name first so a reader never sees half a file
+  if(!path.empty())
+  {
+    std::string tmp_path = path + ".tmp";
+    if(map_save_cspace(this->map, tmp_path.c_str()) < 0 ||
+       rename(tmp_path.c_str(), path.c_str()) != 0)
+      fprintf(stderr, "Could not write the likelihood field cache %s\n", path.c_str());
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Fill the hit probability of every step of the distance field
+void AMCLLaser::UpdateHitProb()
+{
+  double z_hit_denom = 2 * this->sigma_hit * this->sigma_hit;
+  for (int k = 0; k <= MAP_OCC_DIST_STEPS; k++)
+  {
+    double z = MAP_OCC_DIST(this->map, k);
+    this->hit_prob[k] = exp(-(z * z) / z_hit_denom);
+  }
+  this->hit_prob_max_occ_dist = this->map->max_occ_dist;
 }
 
 
@@ -123,43 +227,210 @@ bool AMCLLaser::UpdateSensor(pf_t *pf, AMCLSensorData *data)
   if (this->max_beams < 2)
     return false;
 
-  // Apply the laser sensor model
-  if(this->model_type == LASER_MODEL_BEAM)
-    pf_update_sensor(pf, (pf_sensor_model_fn_t) BeamModel, data);
-  else if(this->model_type == LASER_MODEL_LIKELIHOOD_FIELD)
-    pf_update_sensor(pf, (pf_sensor_model_fn_t) LikelihoodFieldModel, data);  
-  else if(this->model_type == LASER_MODEL_LIKELIHOOD_FIELD_PROB)
-    pf_update_sensor(pf, (pf_sensor_model_fn_t) LikelihoodFieldModelProb, data);  
-  else
-    pf_update_sensor(pf, (pf_sensor_model_fn_t) BeamModel, data);
+  PrepareUpdate(pf);
+
+  pf_update_sensor(pf, (pf_sensor_model_fn_t) ApplyModel, data);
+
+  return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Apply the sensor models of several lasers in one filter update
+bool AMCLLaser::UpdateSensors(pf_t *pf, std::vector<AMCLLaserData*>& data)
+{
+  std::vector<AMCLLaserData*> scans;
+  for (size_t i = 0; i < data.size(); i++)
+  {
+    AMCLLaser *self = (AMCLLaser*) data[i]->sensor;
+    if (self->max_beams < 2)
+      continue;
+    self->PrepareUpdate(pf);
+    scans.push_back(data[i]);
+  }
+
+  if (scans.empty())
+    return false;
+
+  pf_update_sensor(pf, (pf_sensor_model_fn_t) ApplyModels, &scans);
 
   return true;
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// Bring the model up to date before an update
+void AMCLLaser::PrepareUpdate(pf_t *pf)
+{
+  // Another laser sharing the map may have rebuilt the distance field
+  if((this->model_type == LASER_MODEL_LIKELIHOOD_FIELD ||
+      this->model_type == LASER_MODEL_LIKELIHOOD_FIELD_PROB) &&
+     this->hit_prob_max_occ_dist != this->map->max_occ_dist)
+    UpdateHitProb();
+
+  // Beam skipping keeps every observation of every particle until all
+  // particles are weighted; make room for the largest sample set up front
+  if(this->model_type == LASER_MODEL_LIKELIHOOD_FIELD_PROB && this->do_beamskip &&
+     (this->max_samples < pf->max_samples || this->max_obs < this->max_beams))
+  {
+    reallocTempData(pf->max_samples, this->max_beams);
+    fprintf(stderr, "Reallocing temp weights %d - %d\n", this->max_samples, this->max_obs);
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Apply the model of the sensor of the data
+double AMCLLaser::ApplyModel(AMCLLaserData *data, pf_sample_set_t* set)
+{
+  AMCLLaser *self = (AMCLLaser*) data->sensor;
+
+  if(self->model_type != LASER_MODEL_BEAM && self->map->tile_size > 0)
+    self->UpdateTiles(data, set);
+
+  if(self->model_type == LASER_MODEL_BEAM)
+    return BeamModel(data, set);
+  else if(self->model_type == LASER_MODEL_LIKELIHOOD_FIELD)
+    return LikelihoodFieldModel(data, set);
+  else if(self->model_type == LASER_MODEL_LIKELIHOOD_FIELD_PROB)
+    return LikelihoodFieldModelProb(data, set);
+  else
+    return BeamModel(data, set);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Make the likelihood field tiles resident that the beams of the scan can
+// reach from any sample, one cell more for the adaptive beam scores
+void AMCLLaser::UpdateTiles(AMCLLaserData *data, pf_sample_set_t* set)
+{
+  if(set->sample_count == 0)
+    return;
+
+  double min_x = set->x[0], max_x = set->x[0];
+  double min_y = set->y[0], max_y = set->y[0];
+  for (int j = 1; j < set->sample_count; j++)
+  {
+    min_x = std::min(min_x, set->x[j]);
+    max_x = std::max(max_x, set->x[j]);
+    min_y = std::min(min_y, set->y[j]);
+    max_y = std::max(max_y, set->y[j]);
+  }
+  double reach = data->range_max +
+          hypot(this->laser_pose.v[0], this->laser_pose.v[1]) +
+          this->map->scale;
+
+  if(map_update_tiles(this->map,
+                      (int) MAP_GXWX(this->map, min_x - reach),
+                      (int) MAP_GYWY(this->map, min_y - reach),
+                      (int) MAP_GXWX(this->map, max_x + reach),
+                      (int) MAP_GYWY(this->map, max_y + reach)) < 0)
+    fprintf(stderr, "Could not allocate a likelihood field tile\n");
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Apply the models of several scans; every model multiplies into the weights
+// left by the one before, so the total of the last is the total of all
+double AMCLLaser::ApplyModels(std::vector<AMCLLaserData*> *data, pf_sample_set_t* set)
+{
+  double total_weight = 0.0;
+  for (size_t i = 0; i < data->size(); i++)
+    total_weight = ApplyModel((*data)[i], set);
+  return total_weight;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Once the filter has converged many samples have nearly the same pose, so
+// the models can evaluate one sample per pose bin and give the others the
+// same likelihood.
+struct PoseBin
+{
+  int key[3];
+  int sample;
+};
+
+static bool PoseBinLess(const PoseBin& a, const PoseBin& b)
+{
+  for (int i = 0; i < 3; i++)
+    if (a.key[i] != b.key[i])
+      return a.key[i] < b.key[i];
+  return a.sample < b.sample;
+}
+
+// Find for every sample the first sample in its pose bin (rep) and for those
+// the number of samples in the bin (count).  Both are left empty when the
+// cache is disabled.
+static void ComputePoseBins(pf_sample_set_t *set, double bin_xy, double bin_theta,
+                            std::vector<int>& rep, std::vector<int>& count)
+{
+  if (bin_xy <= 0.0 || bin_theta <= 0.0)
+    return;
+
+  std::vector<PoseBin> bins(set->sample_count);
+  for (int j = 0; j < set->sample_count; j++)
+  {
+    bins[j].key[0] = floor(set->x[j] / bin_xy);
+    bins[j].key[1] = floor(set->y[j] / bin_xy);
+    bins[j].key[2] = floor(set->theta[j] / bin_theta);
+    bins[j].sample = j;
+  }
+  std::sort(bins.begin(), bins.end(), PoseBinLess);
+
+  rep.resize(set->sample_count);
+  count.assign(set->sample_count, 0);
+  int first = 0;
+  for (int k = 0; k < set->sample_count; k++)
+  {
+    // Samples of a bin are sorted by index, so a new bin starts with its first
+    if (k == 0 || !std::equal(bins[k - 1].key, bins[k - 1].key + 3, bins[k].key))
+      first = bins[k].sample;
+    rep[bins[k].sample] = first;
+    count[first]++;
+  }
+}
+
+// Give the samples that were not evaluated the likelihood of their bin
+static void ApplyPoseBins(pf_sample_set_t *set, const std::vector<int>& rep,
+                          const std::vector<double>& p)
+{
+  for (int j = 0; j < (int)rep.size(); j++)
+    if (rep[j] != j)
+      set->weight[j] *= p[rep[j]];
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // Determine the probability for the given pose
 double AMCLLaser::BeamModel(AMCLLaserData *data, pf_sample_set_t* set)
 {
   AMCLLaser *self;
-  int i, j, step;
-  double z, pz;
-  double p;
-  double map_range;
-  double obs_range, obs_bearing;
+  int j;
   double total_weight;
-  pf_sample_t *sample;
-  pf_vector_t pose;
 
   self = (AMCLLaser*) data->sensor;
 
-  total_weight = 0.0;
+  std::vector<int> bin_rep, bin_count;
+  ComputePoseBins(set, self->pose_cache_xy, self->pose_cache_theta, bin_rep, bin_count);
+  std::vector<double> bin_p(bin_rep.size());
 
-  // Compute the sample weights
+  // Compute the sample weights, the samples are independent so they are
+  // weighted in parallel
+#pragma omp parallel for schedule(dynamic, 64) num_threads(ParallelThreads())
   for (j = 0; j < set->sample_count; j++)
   {
-    sample = set->samples + j;
-    pose = sample->pose;
+    int i, step;
+    double z, pz;
+    double p;
+    double map_range;
+    double obs_range, obs_bearing;
+    pf_vector_t pose;
+
+    if (!bin_rep.empty() && bin_rep[j] != j)
+      continue;
+
+    pose = pf_get_sample_pose(set, j);
 
     // Take account of the laser pose relative to the robot
     pose = pf_vector_coord_add(self->laser_pose, pose);
@@ -173,8 +444,8 @@ double AMCLLaser::BeamModel(AMCLLaserData *data, pf_sample_set_t* set)
       obs_bearing = data->ranges[i][1];
 
       // Compute the range according to the map
-      map_range = map_calc_range(self->map, pose.v[0], pose.v[1],
-                                 pose.v[2] + obs_bearing, data->range_max);
+      map_range = map_lookup_range(self->map, pose.v[0], pose.v[1],
+                                   pose.v[2] + obs_bearing, data->range_max);
       pz = 0.0;
 
       // Part 1: good, but noisy, hit
@@ -203,119 +474,345 @@ double AMCLLaser::BeamModel(AMCLLaserData *data, pf_sample_set_t* set)
       p += pz*pz*pz;
     }
 
-    sample->weight *= p;
-    total_weight += sample->weight;
+    set->weight[j] *= p;
+    if (!bin_rep.empty())
+      bin_p[j] = p;
   }
 
+  ApplyPoseBins(set, bin_rep, bin_p);
+
+  // Sum in sample order so the total does not depend on the threads
+  total_weight = 0.0;
+  for (j = 0; j < set->sample_count; j++)
+    total_weight += set->weight[j];
+
   return(total_weight);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// The end points of the beams used by the likelihood field models, in the
+// laser frame, so every sample only has to rotate and translate them
+struct BeamEnds
+{
+  std::vector<double> x, y;
+  // Index of the beam among the beams the model looks at
+  std::vector<int> beam;
+};
+
+// Collect the end points of every step-th beam, skipping max range readings
+// and NaNs
+static void ComputeBeamEnds(AMCLLaserData *data, int step, BeamEnds& ends)
+{
+  int beam_ind = 0;
+  for (int i = 0; i < data->range_count; i += step, beam_ind++)
+  {
+    double obs_range = data->ranges[i][0];
+    double obs_bearing = data->ranges[i][1];
+
+    // This model ignores max range readings
+    if(obs_range >= data->range_max)
+      continue;
+
+    // Check for NaN
+    if(obs_range != obs_range)
+      continue;
+
+    ends.x.push_back(obs_range * cos(obs_bearing));
+    ends.y.push_back(obs_range * sin(obs_bearing));
+    ends.beam.push_back(beam_ind);
+  }
+}
+
+// Compute the distance field index (see map_dist_index()) of the cell hit by
+// every beam for the given laser pose, -1 for cells that are off the map.  The grid coordinates are checked
+// against the map bounds before they are truncated, which is the same as
+// MAP_GXWX() and MAP_VALID() but has no floor() or branches, so the loop is
+// vectorized, and it multiplies by the inverse of the map scale instead of
+// dividing.  Only the lookups in the map are left to be done one by one.
+static void ComputeBeamCells(const map_t *map, const pf_vector_t& pose,
+                             const BeamEnds& ends, int *cells)
+{
+  const int count = ends.x.size();
+  const double *ex = &ends.x[0];
+  const double *ey = &ends.y[0];
+  const double c = cos(pose.v[2]);
+  const double s = sin(pose.v[2]);
+  const double ox = pose.v[0] - map->origin_x;
+  const double oy = pose.v[1] - map->origin_y;
+  const double inv_scale = 1.0 / map->scale;
+  const double gx0 = 0.5 + map->size_x / 2;
+  const double gy0 = 0.5 + map->size_y / 2;
+  const double size_x = map->size_x;
+  const double size_y = map->size_y;
+  const int stride = map->size_x;
+
+  if (map->tile_size == 0)
+  {
+    for (int k = 0; k < count; k++)
+    {
+      // Rotate the end point into the map frame and convert to map grid coords.
+      double gx = (ox + c * ex[k] - s * ey[k]) * inv_scale + gx0;
+      double gy = (oy + s * ex[k] + c * ey[k]) * inv_scale + gy0;
+      bool valid = (gx >= 0.0) & (gx < size_x) & (gy >= 0.0) & (gy < size_y);
+      int index = (int)(valid ? gx : 0.0) + (int)(valid ? gy : 0.0) * stride;
+      cells[k] = valid ? index : -1;
+    }
+  }
+  else
+  {
+    // The same with the index of map_dist_index(), spelled out so it is
+    // vectorized as well
+    const int shift = map->tile_shift;
+    const int mask = map->tile_size - 1;
+    const int tiles_x = map->tiles_x;
+    for (int k = 0; k < count; k++)
+    {
+      double gx = (ox + c * ex[k] - s * ey[k]) * inv_scale + gx0;
+      double gy = (oy + s * ex[k] + c * ey[k]) * inv_scale + gy0;
+      bool valid = (gx >= 0.0) & (gx < size_x) & (gy >= 0.0) & (gy < size_y);
+      int i = (int)(valid ? gx : 0.0);
+      int j = (int)(valid ? gy : 0.0);
+      int index = ((((j >> shift) * tiles_x + (i >> shift)) << (2 * shift)) |
+                   ((j & mask) << shift) | (i & mask));
+      cells[k] = valid ? index : -1;
+    }
+  }
+}
+
+// How much a beam ending in the given cell tells about the pose: the hit
+// likelihood of the cell, times how fast the distance to the nearest
+// obstacle grows around it.  A beam that ends on a wall scores high, one
+// that ends in open space or inside an obstacle scores zero, as do cells on
+// the map border.
+static double BeamScore(const map_t *map, const double *hit_prob, int cell)
+{
+  int x, y;
+  if (map->tile_size == 0)
+  {
+    x = cell % map->size_x;
+    y = cell / map->size_x;
+  }
+  else
+  {
+    // Undo map_dist_index()
+    int s = map->tile_shift;
+    int t = cell >> (2 * s);
+    x = ((t % map->tiles_x) << s) | (cell & (map->tile_size - 1));
+    y = ((t / map->tiles_x) << s) | ((cell >> s) & (map->tile_size - 1));
+  }
+  if (x < 1 || y < 1 || x >= map->size_x - 1 || y >= map->size_y - 1)
+    return 0.0;
+
+  int d0 = map_dist_at(map, cell);
+  int dl = map_dist_at(map, map_dist_index(map, x - 1, y));
+  int dr = map_dist_at(map, map_dist_index(map, x + 1, y));
+  int dd = map_dist_at(map, map_dist_index(map, x, y - 1));
+  int du = map_dist_at(map, map_dist_index(map, x, y + 1));
+  int sx = std::max(abs(dr - d0), abs(d0 - dl));
+  int sy = std::max(abs(du - d0), abs(d0 - dd));
+  return hit_prob[d0] * (sx + sy);
+}
+
+// Select up to one beam for each of sectors equal parts of the scan.  The
+// beams are projected from the mean pose of the samples, and in every part
+// the beam with the highest BeamScore() is kept.
+// Parts in which no beam ends near an obstacle are dropped, as are beams
+// that end in a cell already hit by a selected beam.  The selected beams
+// are numbered consecutively.  Returns the number of selected beams, and
+// stores the number of usable beams, and the fraction of their summed score
+// carried by the selected ones.
+static int SelectBeamEnds(const map_t *map, const double *hit_prob,
+                          const pf_vector_t& laser_pose, AMCLLaserData *data,
+                          pf_sample_set_t *set, int sectors, BeamEnds& ends,
+                          int& candidate_count, int& selected_count,
+                          double& score_fraction)
+{
+  // Weighted mean pose, with a circular mean for the heading
+  double w = 0.0, mx = 0.0, my = 0.0, mc = 0.0, ms = 0.0;
+  for (int j = 0; j < set->sample_count; j++)
+  {
+    w += set->weight[j];
+    mx += set->weight[j] * set->x[j];
+    my += set->weight[j] * set->y[j];
+    mc += set->weight[j] * cos(set->theta[j]);
+    ms += set->weight[j] * sin(set->theta[j]);
+  }
+  pf_vector_t pose = pf_vector_zero();
+  if (w > 0.0)
+  {
+    pose.v[0] = mx / w;
+    pose.v[1] = my / w;
+    pose.v[2] = atan2(ms, mc);
+  }
+  pose = pf_vector_coord_add(laser_pose, pose);
+
+  BeamEnds candidates;
+  ComputeBeamEnds(data, 1, candidates);
+  const int count = candidates.x.size();
+  std::vector<int> cells(count);
+  if (count > 0)
+    ComputeBeamCells(map, pose, candidates, &cells[0]);
+
+  double total_score = 0.0;
+  double selected_score = 0.0;
+
+  std::vector<int> selected_cells;
+  int k = 0;
+  for (int s = 0; s < sectors; s++)
+  {
+    int best = -1;
+    double best_score = 0.0;
+
+    // The candidates are in scan order, so each part is a run of them
+    for (; k < count && candidates.beam[k] * sectors / data->range_count == s; k++)
+    {
+      if (cells[k] < 0)
+        continue;
+      double score = BeamScore(map, hit_prob, cells[k]);
+      total_score += score;
+      if (score > best_score &&
+          std::find(selected_cells.begin(), selected_cells.end(), cells[k]) == selected_cells.end())
+      {
+        best = k;
+        best_score = score;
+      }
+    }
+    if (best < 0)
+      continue;
+
+    ends.x.push_back(candidates.x[best]);
+    ends.y.push_back(candidates.y[best]);
+    ends.beam.push_back(ends.beam.size());
+    selected_cells.push_back(cells[best]);
+    selected_score += best_score;
+  }
+
+  candidate_count = count;
+  selected_count = ends.x.size();
+  score_fraction = total_score > 0.0 ? selected_score / total_score : 0.0;
+  return selected_count;
+}
+
 double AMCLLaser::LikelihoodFieldModel(AMCLLaserData *data, pf_sample_set_t* set)
 {
   AMCLLaser *self;
-  int i, j, step;
-  double z, pz;
-  double p;
-  double obs_range, obs_bearing;
+  int j, step;
   double total_weight;
-  pf_sample_t *sample;
-  pf_vector_t pose;
-  pf_vector_t hit;
+  BeamEnds ends;
 
   self = (AMCLLaser*) data->sensor;
 
-  total_weight = 0.0;
+  // Pre-compute a couple of things
+  double z_rand_mult = 1.0/data->range_max;
 
-  // Compute the sample weights
-  for (j = 0; j < set->sample_count; j++)
-  {
-    sample = set->samples + j;
-    pose = sample->pose;
+  step = (data->range_count - 1) / (self->max_beams - 1);
 
-    // Take account of the laser pose relative to the robot
-    pose = pf_vector_coord_add(self->laser_pose, pose);
+  // Step size must be at least 1
+  if(step < 1)
+    step = 1;
 
-    p = 1.0;
+  if(self->adaptive_beams && set->converged)
+    SelectBeamEnds(self->map, self->hit_prob, self->laser_pose, data, set,
+                   self->max_beams, ends, self->beam_stats_candidates,
+                   self->beam_stats_selected, self->beam_stats_score_fraction);
+  else
+    ComputeBeamEnds(data, step, ends);
+  const int beam_count = ends.x.size();
 
-    // Pre-compute a couple of things
-    double z_hit_denom = 2 * self->sigma_hit * self->sigma_hit;
-    double z_rand_mult = 1.0/data->range_max;
+  // The device weighs every sample, so the pose bins are of no use there
+  std::vector<double> device_p;
+  if(self->WeighOnDevice(set, ends.x, ends.y, data->range_max, false, device_p))
+  {
+    total_weight = 0.0;
+    for (j = 0; j < set->sample_count; j++)
+    {
+      set->weight[j] *= device_p[j];
+      total_weight += set->weight[j];
+    }
+    return(total_weight);
+  }
 
-    step = (data->range_count - 1) / (self->max_beams - 1);
+  std::vector<int> bin_rep, bin_count;
+  ComputePoseBins(set, self->pose_cache_xy, self->pose_cache_theta, bin_rep, bin_count);
+  std::vector<double> bin_p(bin_rep.size());
 
-    // Step size must be at least 1
-    if(step < 1)
-      step = 1;
+  // Compute the sample weights, the samples are independent so they are
+  // weighted in parallel
+#pragma omp parallel num_threads(ParallelThreads())
+  {
+    std::vector<int> cells(beam_count);
 
-    for (i = 0; i < data->range_count; i += step)
+#pragma omp for schedule(dynamic, 64)
+    for (j = 0; j < set->sample_count; j++)
     {
-      obs_range = data->ranges[i][0];
-      obs_bearing = data->ranges[i][1];
+      int z_step;
+      double pz;
+      double p;
+      pf_vector_t pose;
 
-      // This model ignores max range readings
-      if(obs_range >= data->range_max)
+      if (!bin_rep.empty() && bin_rep[j] != j)
         continue;
 
-      // Check for NaN
-      if(obs_range != obs_range)
-        continue;
+      pose = pf_get_sample_pose(set, j);
 
-      pz = 0.0;
+      // Take account of the laser pose relative to the robot
+      pose = pf_vector_coord_add(self->laser_pose, pose);
 
-      // Compute the endpoint of the beam
-      hit.v[0] = pose.v[0] + obs_range * cos(pose.v[2] + obs_bearing);
-      hit.v[1] = pose.v[1] + obs_range * sin(pose.v[2] + obs_bearing);
-
-      // Convert to map grid coords.
-      int mi, mj;
-      mi = MAP_GXWX(self->map, hit.v[0]);
-      mj = MAP_GYWY(self->map, hit.v[1]);
-      
-      // Part 1: Get distance from the hit to closest obstacle.
-      // Off-map penalized as max distance
-      if(!MAP_VALID(self->map, mi, mj))
-        z = self->map->max_occ_dist;
-      else
-        z = self->map->cells[MAP_INDEX(self->map,mi,mj)].occ_dist;
-      // Gaussian model
-      // NOTE: this should have a normalization of 1/(sqrt(2pi)*sigma)
-      pz += self->z_hit * exp(-(z * z) / z_hit_denom);
-      // Part 2: random measurements
-      pz += self->z_rand * z_rand_mult;
+      p = 1.0;
 
-      // TODO: outlier rejection for short readings
+      if(beam_count > 0)
+        ComputeBeamCells(self->map, pose, ends, &cells[0]);
 
-      assert(pz <= 1.0);
-      assert(pz >= 0.0);
-      //      p *= pz;
-      // here we have an ad-hoc weighting scheme for combining beam probs
-      // works well, though...
-      p += pz*pz*pz;
-    }
+      for (int k = 0; k < beam_count; k++)
+      {
+        pz = 0.0;
+
+        // Part 1: Get distance from the hit to closest obstacle.
+        // Off-map penalized as max distance
+        if(cells[k] < 0)
+          z_step = MAP_OCC_DIST_STEPS;
+        else
+          z_step = map_dist_at(self->map, cells[k]);
+        // Gaussian model, looked up per step of the distance field
+        // NOTE: this should have a normalization of 1/(sqrt(2pi)*sigma)
+        pz += self->z_hit * self->hit_prob[z_step];
+        // Part 2: random measurements
+        pz += self->z_rand * z_rand_mult;
+
+        // TODO: outlier rejection for short readings
+
+        assert(pz <= 1.0);
+        assert(pz >= 0.0);
+        //      p *= pz;
+        // here we have an ad-hoc weighting scheme for combining beam probs
+        // works well, though...
+        p += pz*pz*pz;
+      }
 
-    sample->weight *= p;
-    total_weight += sample->weight;
+      set->weight[j] *= p;
+      if (!bin_rep.empty())
+        bin_p[j] = p;
+    }
   }
 
+  ApplyPoseBins(set, bin_rep, bin_p);
+
+  // Sum in sample order so the total does not depend on the threads
+  total_weight = 0.0;
+  for (j = 0; j < set->sample_count; j++)
+    total_weight += set->weight[j];
+
   return(total_weight);
 }
 
 double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t* set)
 {
   AMCLLaser *self;
-  int i, j, step;
-  double z, pz;
-  double log_p;
-  double obs_range, obs_bearing;
+  int j, step;
   double total_weight;
-  pf_sample_t *sample;
-  pf_vector_t pose;
-  pf_vector_t hit;
 
   self = (AMCLLaser*) data->sensor;
 
-  total_weight = 0.0;
-
   step = ceil((data->range_count) / static_cast<double>(self->max_beams)); 
   
   // Step size must be at least 1
@@ -323,10 +820,9 @@ double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t*
     step = 1;
 
   // Pre-compute a couple of things
-  double z_hit_denom = 2 * self->sigma_hit * self->sigma_hit;
   double z_rand_mult = 1.0/data->range_max;
 
-  double max_dist_prob = exp(-(self->map->max_occ_dist * self->map->max_occ_dist) / z_hit_denom);
+  double max_dist_prob = self->hit_prob[MAP_OCC_DIST_STEPS];
 
   //Beam skipping - ignores beams for which a majoirty of particles do not agree with the map
   //prevents correct particles from getting down weighted because of unexpected obstacles 
@@ -342,116 +838,133 @@ double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t*
   }
 
   //we need a count the no of particles for which the beam agreed with the map 
-  int *obs_count = new int[self->max_beams]();
-
-  //we also need a mask of which observations to integrate (to decide which beams to integrate to all particles) 
-  bool *obs_mask = new bool[self->max_beams]();
-  
-  int beam_ind = 0;
-  
-  //realloc indicates if we need to reallocate the temp data structure needed to do beamskipping 
-  bool realloc = false; 
-
+  //and a mask of which observations to integrate (to decide which beams to integrate to all particles) 
+  //both live in the workspace that UpdateSensor() sized for us
+  int *obs_count = NULL;
   if(do_beamskip){
-    if(self->max_obs < self->max_beams){
-      realloc = true;
-    }
+    assert(self->max_samples >= set->sample_count);
+    std::fill(self->obs_count.begin(), self->obs_count.end(), 0);
+    obs_count = &self->obs_count[0];
+  }
 
-    if(self->max_samples < set->sample_count){
-      realloc = true;
-    }
+  // The beam skipping statistics are kept per beam index
+  BeamEnds ends;
+  int beam_slots = self->max_beams;
+  if(self->adaptive_beams && set->converged)
+    beam_slots = SelectBeamEnds(self->map, self->hit_prob, self->laser_pose, data, set,
+                                self->max_beams, ends, self->beam_stats_candidates,
+                                self->beam_stats_selected, self->beam_stats_score_fraction);
+  else
+    ComputeBeamEnds(data, step, ends);
+  const int beam_count = ends.x.size();
 
-    if(realloc){
-      self->reallocTempData(set->sample_count, self->max_beams);     
-      fprintf(stderr, "Reallocing temp weights %d - %d\n", self->max_samples, self->max_obs);
+  // Beam skipping needs the per beam likelihoods, so that stays on the CPU
+  std::vector<double> device_p;
+  if(!do_beamskip &&
+     self->WeighOnDevice(set, ends.x, ends.y, data->range_max, true, device_p))
+  {
+    total_weight = 0.0;
+    for (j = 0; j < set->sample_count; j++)
+    {
+      set->weight[j] *= device_p[j];
+      total_weight += set->weight[j];
     }
+    return(total_weight);
   }
 
-  // Compute the sample weights
-  for (j = 0; j < set->sample_count; j++)
-  {
-    sample = set->samples + j;
-    pose = sample->pose;
+  std::vector<int> bin_rep, bin_count;
+  ComputePoseBins(set, self->pose_cache_xy, self->pose_cache_theta, bin_rep, bin_count);
+  std::vector<double> bin_p(bin_rep.size());
 
-    // Take account of the laser pose relative to the robot
-    pose = pf_vector_coord_add(self->laser_pose, pose);
+  // Compute the sample weights, the samples are independent so they are
+  // weighted in parallel
+#pragma omp parallel num_threads(ParallelThreads())
+  {
+    std::vector<int> cells(beam_count);
 
-    log_p = 0;
-    
-    beam_ind = 0;
-    
-    for (i = 0; i < data->range_count; i += step, beam_ind++)
+#pragma omp for schedule(dynamic, 64)
+    for (j = 0; j < set->sample_count; j++)
     {
-      obs_range = data->ranges[i][0];
-      obs_bearing = data->ranges[i][1];
+      double z, pz;
+      double log_p;
+      int samples;
+      pf_vector_t pose;
 
-      // This model ignores max range readings
-      if(obs_range >= data->range_max){
+      // The first sample of a bin stands in for all of them
+      if (!bin_rep.empty() && bin_rep[j] != j)
         continue;
-      }
+      samples = bin_rep.empty() ? 1 : bin_count[j];
 
-      // Check for NaN
-      if(obs_range != obs_range){
-        continue;
-      }
+      pose = pf_get_sample_pose(set, j);
 
-      pz = 0.0;
+      // Take account of the laser pose relative to the robot
+      pose = pf_vector_coord_add(self->laser_pose, pose);
 
-      // Compute the endpoint of the beam
-      hit.v[0] = pose.v[0] + obs_range * cos(pose.v[2] + obs_bearing);
-      hit.v[1] = pose.v[1] + obs_range * sin(pose.v[2] + obs_bearing);
-
-      // Convert to map grid coords.
-      int mi, mj;
-      mi = MAP_GXWX(self->map, hit.v[0]);
-      mj = MAP_GYWY(self->map, hit.v[1]);
-      
-      // Part 1: Get distance from the hit to closest obstacle.
-      // Off-map penalized as max distance
-      
-      if(!MAP_VALID(self->map, mi, mj)){
-	pz += self->z_hit * max_dist_prob;
-      }
-      else{
-	z = self->map->cells[MAP_INDEX(self->map,mi,mj)].occ_dist;
-	if(z < beam_skip_distance){
-	  obs_count[beam_ind] += 1;
-	}
-	pz += self->z_hit * exp(-(z * z) / z_hit_denom);
-      }
-       
-      // Gaussian model
-      // NOTE: this should have a normalization of 1/(sqrt(2pi)*sigma)
-      
-      // Part 2: random measurements
-      pz += self->z_rand * z_rand_mult;
-
-      assert(pz <= 1.0); 
-      assert(pz >= 0.0);
+      log_p = 0;
 
-      // TODO: outlier rejection for short readings
-            
-      if(!do_beamskip){
-	log_p += log(pz);
+      if(beam_count > 0)
+        ComputeBeamCells(self->map, pose, ends, &cells[0]);
+
+      for (int k = 0; k < beam_count; k++)
+      {
+        int beam_ind = ends.beam[k];
+
+        pz = 0.0;
+
+        // Part 1: Get distance from the hit to closest obstacle.
+        // Off-map penalized as max distance
+
+        if(cells[k] < 0){
+          pz += self->z_hit * max_dist_prob;
+        }
+        else{
+          int z_step = map_dist_at(self->map, cells[k]);
+          z = MAP_OCC_DIST(self->map, z_step);
+          if(do_beamskip && z < beam_skip_distance){
+#pragma omp atomic
+            obs_count[beam_ind] += samples;
+          }
+          pz += self->z_hit * self->hit_prob[z_step];
+        }
+
+        // Gaussian model
+        // NOTE: this should have a normalization of 1/(sqrt(2pi)*sigma)
+
+        // Part 2: random measurements
+        pz += self->z_rand * z_rand_mult;
+
+        assert(pz <= 1.0);
+        assert(pz >= 0.0);
+
+        // TODO: outlier rejection for short readings
+
+        if(!do_beamskip){
+          log_p += log(pz);
+        }
+        else{
+          self->temp_obs[j * self->max_obs + beam_ind] = pz;
+        }
       }
-      else{
-	self->temp_obs[j][beam_ind] = pz; 
+      if(!do_beamskip){
+        set->weight[j] *= exp(log_p);
+        if (!bin_rep.empty())
+          bin_p[j] = exp(log_p);
       }
     }
-    if(!do_beamskip){
-      sample->weight *= exp(log_p);
-      total_weight += sample->weight;
-    }
   }
+
+  if(!do_beamskip)
+    ApplyPoseBins(set, bin_rep, bin_p);
   
   if(do_beamskip){
+    int beam_ind;
     int skipped_beam_count = 0; 
-    for (beam_ind = 0; beam_ind < self->max_beams; beam_ind++){
+    for (beam_ind = 0; beam_ind < beam_slots; beam_ind++){
       if((obs_count[beam_ind] / static_cast<double>(set->sample_count)) > beam_skip_threshold){
-	obs_mask[beam_ind] = true;
+	self->obs_mask[beam_ind] = true;
       }
       else{
-	obs_mask[beam_ind] = false;
+	self->obs_mask[beam_ind] = false;
 	skipped_beam_count++; 
       }
     }
@@ -467,42 +980,188 @@ double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t*
       error = true; 
     }
 
+#pragma omp parallel for schedule(static) num_threads(ParallelThreads())
     for (j = 0; j < set->sample_count; j++)
       {
-	sample = set->samples + j;
-	pose = sample->pose;
+	double log_p = 0;
+	const double *obs = &self->temp_obs[(bin_rep.empty() ? j : bin_rep[j]) * self->max_obs];
 
-	log_p = 0;
-
-	for (beam_ind = 0; beam_ind < self->max_beams; beam_ind++){
-	  if(error || obs_mask[beam_ind]){
-	    log_p += log(self->temp_obs[j][beam_ind]);
+	for (int k = 0; k < beam_slots; k++){
+	  if(error || self->obs_mask[k]){
+	    log_p += log(obs[k]);
 	  }
 	}
 	
-	sample->weight *= exp(log_p);
-	
-	total_weight += sample->weight;
+	set->weight[j] *= exp(log_p);
       }      
   }
 
-  delete [] obs_count; 
-  delete [] obs_mask;
+  // Sum in sample order so the total does not depend on the threads
+  total_weight = 0.0;
+  for (j = 0; j < set->sample_count; j++)
+    total_weight += set->weight[j];
+
   return(total_weight);
 }
 
 void AMCLLaser::reallocTempData(int new_max_samples, int new_max_obs){
-  if(temp_obs){
-    for(int k=0; k < max_samples; k++){
-      delete [] temp_obs[k];
-    }
-    delete []temp_obs; 
-  }
   max_obs = new_max_obs; 
   max_samples = fmax(max_samples, new_max_samples); 
 
-  temp_obs = new double*[max_samples]();
-  for(int k=0; k < max_samples; k++){
-    temp_obs[k] = new double[max_obs]();
+  temp_obs.assign((size_t)max_samples * max_obs, 0.0);
+  obs_count.assign(max_obs, 0);
+  obs_mask.assign(max_obs, false);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Distance to the nearest obstacle at a point, interpolated bilinearly
+// between the cell centers of the distance field, and its gradient in meters
+// per meter.  Returns false for points near the map border or beyond
+// max_occ_dist from any obstacle, where the field is flat.
+static bool InterpolateDistance(const map_t *map, double x, double y,
+                                double *d, double *dx, double *dy)
+{
+  double gx = (x - map->origin_x) / map->scale + map->size_x / 2;
+  double gy = (y - map->origin_y) / map->scale + map->size_y / 2;
+  int i = (int)floor(gx);
+  int j = (int)floor(gy);
+  if (i < 0 || j < 0 || i + 1 >= map->size_x || j + 1 >= map->size_y)
+    return false;
+
+  int d00 = map_dist_at(map, map_dist_index(map, i, j));
+  int d10 = map_dist_at(map, map_dist_index(map, i + 1, j));
+  int d01 = map_dist_at(map, map_dist_index(map, i, j + 1));
+  int d11 = map_dist_at(map, map_dist_index(map, i + 1, j + 1));
+  if (std::max(std::max(d00, d10), std::max(d01, d11)) >= MAP_OCC_DIST_STEPS)
+    return false;
+
+  double fx = gx - i;
+  double fy = gy - j;
+  double step = map->max_occ_dist / MAP_OCC_DIST_STEPS;
+  *d = step * ((1 - fx) * (1 - fy) * d00 + fx * (1 - fy) * d10 +
+               (1 - fx) * fy * d01 + fx * fy * d11);
+  *dx = step / map->scale * ((1 - fy) * (d10 - d00) + fy * (d11 - d01));
+  *dy = step / map->scale * ((1 - fx) * (d01 - d00) + fx * (d11 - d10));
+  return true;
+}
+
+// Sum of the squared distances of the beam end points (in the robot frame)
+// to the nearest obstacle for a robot pose.  Points where the field is flat
+// count as max_occ_dist.  If H and g are given they are set to the Gauss-Newton
+// normal matrix and gradient of the sum, halved.
+static double MatchCost(const map_t *map, const std::vector<double>& rx,
+                        const std::vector<double>& ry, const pf_vector_t& pose,
+                        double H[3][3], double g[3])
+{
+  const double c = cos(pose.v[2]);
+  const double s = sin(pose.v[2]);
+  const double far = map->max_occ_dist * map->max_occ_dist;
+  if (H)
+  {
+    for (int a = 0; a < 3; a++)
+    {
+      g[a] = 0.0;
+      for (int b = 0; b < 3; b++)
+        H[a][b] = 0.0;
+    }
+  }
+
+  double cost = 0.0;
+  for (unsigned int k = 0; k < rx.size(); k++)
+  {
+    double d, dx, dy;
+    if (!InterpolateDistance(map, pose.v[0] + c * rx[k] - s * ry[k],
+                             pose.v[1] + s * rx[k] + c * ry[k], &d, &dx, &dy))
+    {
+      cost += far;
+      continue;
+    }
+    cost += d * d;
+    if (!H)
+      continue;
+
+    // Derivative of the distance by x, y and the heading of the robot
+    double J[3] = {dx, dy, dx * (-s * rx[k] - c * ry[k]) + dy * (c * rx[k] - s * ry[k])};
+    for (int a = 0; a < 3; a++)
+    {
+      g[a] += J[a] * d;
+      for (int b = 0; b < 3; b++)
+        H[a][b] += J[a] * J[b];
+    }
+  }
+  return cost;
+}
+
+bool AMCLLaser::RefinePose(AMCLLaserData *data, pf_vector_t *pose, int iterations)
+{
+  // Only the likelihood field models have a distance field
+  if (this->model_type == LASER_MODEL_BEAM || this->map->max_occ_dist <= 0.0 ||
+      (this->map->tile_size == 0 && this->map->occ_dist == NULL))
+    return false;
+
+  // The end points of all the beams, in the robot frame
+  BeamEnds ends;
+  ComputeBeamEnds(data, 1, ends);
+  std::vector<double> rx(ends.x.size()), ry(ends.x.size());
+  for (unsigned int k = 0; k < ends.x.size(); k++)
+  {
+    pf_vector_t end = pf_vector_zero();
+    end.v[0] = ends.x[k];
+    end.v[1] = ends.y[k];
+    end = pf_vector_coord_add(end, this->laser_pose);
+    rx[k] = end.v[0];
+    ry[k] = end.v[1];
   }
+  if (rx.size() < 3)
+    return false;
+
+  // Levenberg-Marquardt: Gauss-Newton steps, damped more after every step
+  // that does not lower the cost
+  pf_vector_t current = *pose;
+  double lambda = 1e-3;
+  bool improved = false;
+  for (int it = 0; it < iterations; it++)
+  {
+    double H[3][3], g[3];
+    double cost = MatchCost(this->map, rx, ry, current, H, g);
+    for (int a = 0; a < 3; a++)
+      H[a][a] *= 1.0 + lambda;
+
+    // Solve H delta = -g by Cramer's rule
+    double det = H[0][0] * (H[1][1] * H[2][2] - H[1][2] * H[2][1]) -
+                 H[0][1] * (H[1][0] * H[2][2] - H[1][2] * H[2][0]) +
+                 H[0][2] * (H[1][0] * H[2][1] - H[1][1] * H[2][0]);
+    if (fabs(det) < 1e-12)
+      break;
+    pf_vector_t delta;
+    for (int a = 0; a < 3; a++)
+    {
+      double M[3][3];
+      for (int r = 0; r < 3; r++)
+        for (int col = 0; col < 3; col++)
+          M[r][col] = col == a ? -g[r] : H[r][col];
+      delta.v[a] = (M[0][0] * (M[1][1] * M[2][2] - M[1][2] * M[2][1]) -
+                    M[0][1] * (M[1][0] * M[2][2] - M[1][2] * M[2][0]) +
+                    M[0][2] * (M[1][0] * M[2][1] - M[1][1] * M[2][0])) / det;
+    }
+
+    pf_vector_t candidate = pf_vector_add(current, delta);
+    candidate.v[2] = atan2(sin(candidate.v[2]), cos(candidate.v[2]));
+    if (MatchCost(this->map, rx, ry, candidate, NULL, NULL) >= cost)
+    {
+      lambda *= 10.0;
+      continue;
+    }
+    current = candidate;
+    improved = true;
+    lambda = std::max(lambda / 10.0, 1e-6);
+
+    // Stop once the steps are well below a cell
+    if (hypot(delta.v[0], delta.v[1]) < 1e-3 * this->map->scale && fabs(delta.v[2]) < 1e-4)
+      break;
+  }
+
+  if (improved)
+    *pose = current;
+  return improved;
 }
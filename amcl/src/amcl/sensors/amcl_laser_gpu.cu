@@ -0,0 +1,220 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Likelihood field weighting on a CUDA device
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <cuda_runtime.h>
+
+#include "amcl_laser_gpu.h"
+
+using namespace amcl;
+
+// Samples weighted by one block
+static const int BLOCK_SIZE = 128;
+
+// One thread per sample, the beams walked the same way as
+// ComputeBeamCells() does on the CPU
+__global__ static void
+WeighSamples(int sample_count, const float* x, const float* y, const float* theta,
+             float lx, float ly, float lth, const float* ends, int beam_count,
+             const unsigned char* field, int size_x, int size_y,
+             float origin_x, float origin_y, float scale,
+             const float* hit_prob, float z_hit, float p_rand,
+             int log_model, float* p)
+{
+  int j = blockIdx.x * blockDim.x + threadIdx.x;
+  if (j >= sample_count)
+    return;
+
+  // Take account of the laser pose relative to the robot
+  float cr = cosf(theta[j]);
+  float sr = sinf(theta[j]);
+  float ox = x[j] + cr * lx - sr * ly - origin_x;
+  float oy = y[j] + sr * lx + cr * ly - origin_y;
+  float c = cosf(theta[j] + lth);
+  float s = sinf(theta[j] + lth);
+  float gx0 = 0.5f + size_x / 2;
+  float gy0 = 0.5f + size_y / 2;
+
+  float sum = log_model ? 0.0f : 1.0f;
+  for (int k = 0; k < beam_count; k++)
+  {
+    float ex = ends[2 * k];
+    float ey = ends[2 * k + 1];
+    float gx = (ox + c * ex - s * ey) / scale + gx0;
+    float gy = (oy + s * ex + c * ey) / scale + gy0;
+    int step = MAP_OCC_DIST_STEPS;
+    if (gx >= 0.0f && gx < size_x && gy >= 0.0f && gy < size_y)
+      step = field[(int)gx + (int)gy * size_x];
+    float pz = z_hit * hit_prob[step] + p_rand;
+    if (log_model)
+      sum += logf(pz);
+    else
+      sum += pz * pz * pz;
+  }
+  // The product of the log model is beyond single precision for many
+  // beams, so it is left for the host to take its exponent
+  p[j] = sum;
+}
+
+LikelihoodFieldDevice*
+LikelihoodFieldDevice::Create()
+{
+  int count = 0;
+  if (cudaGetDeviceCount(&count) != cudaSuccess || count == 0)
+    return NULL;
+  return new LikelihoodFieldDevice();
+}
+
+LikelihoodFieldDevice::LikelihoodFieldDevice() :
+  field_source(NULL), field_max_occ_dist(-1.0), field_size_x(0), field_size_y(0),
+  field_version(0),
+  d_field(NULL), d_x(NULL), d_y(NULL), d_theta(NULL), d_ends(NULL),
+  d_hit_prob(NULL), d_p(NULL), sample_capacity(0), beam_capacity(0)
+{
+}
+
+LikelihoodFieldDevice::~LikelihoodFieldDevice()
+{
+  cudaFree(d_field);
+  cudaFree(d_x);
+  cudaFree(d_y);
+  cudaFree(d_theta);
+  cudaFree(d_ends);
+  cudaFree(d_hit_prob);
+  cudaFree(d_p);
+}
+
+// A device only ever sees the map of the lasers it belongs to, so the field
+// only changes when it is recomputed, which bumps its version
+bool
+LikelihoodFieldDevice::SetField(const map_t* map)
+{
+  if (map->occ_dist == field_source && map->max_occ_dist == field_max_occ_dist &&
+      map->size_x == field_size_x && map->size_y == field_size_y &&
+      map->occ_dist_version == field_version)
+    return true;
+
+  size_t size = (size_t)map->size_x * map->size_y;
+  field_source = NULL;
+  cudaFree(d_field);
+  d_field = NULL;
+  if (cudaMalloc((void**)&d_field, size) != cudaSuccess ||
+      cudaMemcpy(d_field, map->occ_dist, size, cudaMemcpyHostToDevice) != cudaSuccess)
+    return false;
+
+  if (d_hit_prob == NULL &&
+      cudaMalloc((void**)&d_hit_prob, sizeof(float) * (MAP_OCC_DIST_STEPS + 1)) != cudaSuccess)
+    return false;
+
+  field_source = map->occ_dist;
+  field_max_occ_dist = map->max_occ_dist;
+  field_size_x = map->size_x;
+  field_size_y = map->size_y;
+  field_version = map->occ_dist_version;
+  return true;
+}
+
+bool
+LikelihoodFieldDevice::Reserve(int samples, int beams)
+{
+  if (samples > sample_capacity)
+  {
+    cudaFree(d_x);
+    cudaFree(d_y);
+    cudaFree(d_theta);
+    cudaFree(d_p);
+    d_x = d_y = d_theta = d_p = NULL;
+    sample_capacity = 0;
+    if (cudaMalloc((void**)&d_x, sizeof(float) * samples) != cudaSuccess ||
+        cudaMalloc((void**)&d_y, sizeof(float) * samples) != cudaSuccess ||
+        cudaMalloc((void**)&d_theta, sizeof(float) * samples) != cudaSuccess ||
+        cudaMalloc((void**)&d_p, sizeof(float) * samples) != cudaSuccess)
+      return false;
+    sample_capacity = samples;
+  }
+  if (beams > beam_capacity)
+  {
+    cudaFree(d_ends);
+    d_ends = NULL;
+    beam_capacity = 0;
+    if (cudaMalloc((void**)&d_ends, sizeof(float) * 2 * beams) != cudaSuccess)
+      return false;
+    beam_capacity = beams;
+  }
+  return true;
+}
+
+bool
+LikelihoodFieldDevice::Weigh(const map_t* map, pf_sample_set_t* set,
+                             const pf_vector_t& laser_pose,
+                             const std::vector<double>& ex, const std::vector<double>& ey,
+                             const double* hit_prob, double z_hit, double p_rand,
+                             bool log_model, double* p)
+{
+  int n = set->sample_count;
+  int beams = ex.size();
+  if (n == 0)
+    return true;
+  if (map->occ_dist == NULL || !SetField(map) || !Reserve(n, beams > 0 ? beams : 1))
+    return false;
+
+  h_x.resize(n);
+  h_y.resize(n);
+  h_theta.resize(n);
+  h_p.resize(n);
+  for (int j = 0; j < n; j++)
+  {
+    h_x[j] = set->x[j];
+    h_y[j] = set->y[j];
+    h_theta[j] = set->theta[j];
+  }
+  h_ends.resize(2 * beams);
+  for (int k = 0; k < beams; k++)
+  {
+    h_ends[2 * k] = ex[k];
+    h_ends[2 * k + 1] = ey[k];
+  }
+  float h_hit_prob[MAP_OCC_DIST_STEPS + 1];
+  for (int k = 0; k <= MAP_OCC_DIST_STEPS; k++)
+    h_hit_prob[k] = hit_prob[k];
+
+  if (cudaMemcpy(d_x, &h_x[0], sizeof(float) * n, cudaMemcpyHostToDevice) != cudaSuccess ||
+      cudaMemcpy(d_y, &h_y[0], sizeof(float) * n, cudaMemcpyHostToDevice) != cudaSuccess ||
+      cudaMemcpy(d_theta, &h_theta[0], sizeof(float) * n, cudaMemcpyHostToDevice) != cudaSuccess ||
+      (beams > 0 && cudaMemcpy(d_ends, &h_ends[0], sizeof(float) * 2 * beams,
+                               cudaMemcpyHostToDevice) != cudaSuccess) ||
+      cudaMemcpy(d_hit_prob, h_hit_prob, sizeof(h_hit_prob), cudaMemcpyHostToDevice) != cudaSuccess)
+    return false;
+
+  WeighSamples<<<(n + BLOCK_SIZE - 1) / BLOCK_SIZE, BLOCK_SIZE>>>(
+      n, d_x, d_y, d_theta,
+      laser_pose.v[0], laser_pose.v[1], laser_pose.v[2], d_ends, beams,
+      d_field, map->size_x, map->size_y, map->origin_x, map->origin_y, map->scale,
+      d_hit_prob, z_hit, p_rand, log_model, d_p);
+  if (cudaGetLastError() != cudaSuccess ||
+      cudaMemcpy(&h_p[0], d_p, sizeof(float) * n, cudaMemcpyDeviceToHost) != cudaSuccess)
+    return false;
+
+  for (int j = 0; j < n; j++)
+    p[j] = log_model ? exp((double)h_p[j]) : h_p[j];
+  return true;
+}
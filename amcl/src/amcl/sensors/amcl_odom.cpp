@@ -31,6 +31,7 @@
 
 #include <sys/types.h> // required by Darwin
 #include <math.h>
+#include <stdlib.h>
 
 #include "amcl_odom.h"
 
@@ -62,6 +63,16 @@ angle_diff(double a, double b)
 AMCLOdom::AMCLOdom() : AMCLSensor()
 {
   this->time = 0.0;
+
+  // Follow the seeding of the rest of the filter
+  SetRandomSeed(((uint64_t) lrand48() << 32) | (uint64_t) lrand48());
+}
+
+void
+AMCLOdom::SetRandomSeed(uint64_t seed)
+{
+  this->rng_key = pf_ran_key(seed);
+  this->rng_update = 0;
 }
 
 void
@@ -121,12 +132,17 @@ bool AMCLOdom::UpdateAction(pf_t *pf, AMCLSensorData *data)
   set = pf->sets + pf->current_set;
   pf_vector_t old_pose = pf_vector_sub(ndata->pose, ndata->delta);
 
+  // The noise of every sample comes from its own counter, so the samples
+  // are moved in parallel
+  const pf_ran_key_t key = this->rng_key;
+  const uint32_t update = this->rng_update++;
+
   switch( this->model_type )
   {
   case ODOM_MODEL_OMNI:
+  case ODOM_MODEL_OMNI_CORRECTED:
   {
-    double delta_trans, delta_rot, delta_bearing;
-    double delta_trans_hat, delta_rot_hat, delta_strafe_hat;
+    double delta_trans, delta_rot, delta_bearing0;
 
     delta_trans = sqrt(ndata->delta.v[0]*ndata->delta.v[0] +
                        ndata->delta.v[1]*ndata->delta.v[1]);
@@ -139,34 +155,44 @@ bool AMCLOdom::UpdateAction(pf_t *pf, AMCLSensorData *data)
                              alpha2 * (delta_trans*delta_trans));
     double strafe_hat_stddev = (alpha1 * (delta_rot*delta_rot) +
                                 alpha5 * (delta_trans*delta_trans));
+    // The corrected model takes the square root, so these really are
+    // standard deviations
+    if(this->model_type == ODOM_MODEL_OMNI_CORRECTED)
+    {
+      trans_hat_stddev = sqrt(trans_hat_stddev);
+      rot_hat_stddev = sqrt(rot_hat_stddev);
+      strafe_hat_stddev = sqrt(strafe_hat_stddev);
+    }
+    delta_bearing0 = angle_diff(atan2(ndata->delta.v[1], ndata->delta.v[0]),
+                                old_pose.v[2]);
 
+#pragma omp parallel for schedule(static) num_threads(ParallelThreads())
     for (int i = 0; i < set->sample_count; i++)
     {
-      pf_sample_t* sample = set->samples + i;
-
-      delta_bearing = angle_diff(atan2(ndata->delta.v[1], ndata->delta.v[0]),
-                                 old_pose.v[2]) + sample->pose.v[2];
+      double z[4];
+      double delta_bearing = delta_bearing0 + set->theta[i];
       double cs_bearing = cos(delta_bearing);
       double sn_bearing = sin(delta_bearing);
 
       // Sample pose differences
-      delta_trans_hat = delta_trans + pf_ran_gaussian(trans_hat_stddev);
-      delta_rot_hat = delta_rot + pf_ran_gaussian(rot_hat_stddev);
-      delta_strafe_hat = 0 + pf_ran_gaussian(strafe_hat_stddev);
+      pf_ran_gaussian4(key, i, update, z);
+      double delta_trans_hat = delta_trans + trans_hat_stddev * z[0];
+      double delta_rot_hat = delta_rot + rot_hat_stddev * z[1];
+      double delta_strafe_hat = 0 + strafe_hat_stddev * z[2];
       // Apply sampled update to particle pose
-      sample->pose.v[0] += (delta_trans_hat * cs_bearing + 
-                            delta_strafe_hat * sn_bearing);
-      sample->pose.v[1] += (delta_trans_hat * sn_bearing - 
-                            delta_strafe_hat * cs_bearing);
-      sample->pose.v[2] += delta_rot_hat ;
+      set->x[i] += (delta_trans_hat * cs_bearing + 
+                    delta_strafe_hat * sn_bearing);
+      set->y[i] += (delta_trans_hat * sn_bearing - 
+                    delta_strafe_hat * cs_bearing);
+      set->theta[i] += delta_rot_hat ;
     }
   }
   break;
   case ODOM_MODEL_DIFF:
+  case ODOM_MODEL_DIFF_CORRECTED:
   {
     // Implement sample_motion_odometry (Prob Rob p 136)
     double delta_rot1, delta_trans, delta_rot2;
-    double delta_rot1_hat, delta_trans_hat, delta_rot2_hat;
     double delta_rot1_noise, delta_rot2_noise;
 
     // Avoid computing a bearing from two poses that are extremely near each
@@ -189,119 +215,40 @@ bool AMCLOdom::UpdateAction(pf_t *pf, AMCLSensorData *data)
     delta_rot2_noise = std::min(fabs(angle_diff(delta_rot2,0.0)),
                                 fabs(angle_diff(delta_rot2,M_PI)));
 
-    for (int i = 0; i < set->sample_count; i++)
-    {
-      pf_sample_t* sample = set->samples + i;
-
-      // Sample pose differences
-      delta_rot1_hat = angle_diff(delta_rot1,
-                                  pf_ran_gaussian(this->alpha1*delta_rot1_noise*delta_rot1_noise +
-                                                  this->alpha2*delta_trans*delta_trans));
-      delta_trans_hat = delta_trans - 
-              pf_ran_gaussian(this->alpha3*delta_trans*delta_trans +
-                              this->alpha4*delta_rot1_noise*delta_rot1_noise +
-                              this->alpha4*delta_rot2_noise*delta_rot2_noise);
-      delta_rot2_hat = angle_diff(delta_rot2,
-                                  pf_ran_gaussian(this->alpha1*delta_rot2_noise*delta_rot2_noise +
-                                                  this->alpha2*delta_trans*delta_trans));
-
-      // Apply sampled update to particle pose
-      sample->pose.v[0] += delta_trans_hat * 
-              cos(sample->pose.v[2] + delta_rot1_hat);
-      sample->pose.v[1] += delta_trans_hat * 
-              sin(sample->pose.v[2] + delta_rot1_hat);
-      sample->pose.v[2] += delta_rot1_hat + delta_rot2_hat;
-    }
-  }
-  break;
-  case ODOM_MODEL_OMNI_CORRECTED:
-  {
-    double delta_trans, delta_rot, delta_bearing;
-    double delta_trans_hat, delta_rot_hat, delta_strafe_hat;
-
-    delta_trans = sqrt(ndata->delta.v[0]*ndata->delta.v[0] +
-                       ndata->delta.v[1]*ndata->delta.v[1]);
-    delta_rot = ndata->delta.v[2];
-
     // Precompute a couple of things
-    double trans_hat_stddev = sqrt( alpha3 * (delta_trans*delta_trans) +
-                                    alpha1 * (delta_rot*delta_rot) );
-    double rot_hat_stddev = sqrt( alpha4 * (delta_rot*delta_rot) +
-                                  alpha2 * (delta_trans*delta_trans) );
-    double strafe_hat_stddev = sqrt( alpha1 * (delta_rot*delta_rot) +
-                                     alpha5 * (delta_trans*delta_trans) );
-
-    for (int i = 0; i < set->sample_count; i++)
+    double rot1_hat_stddev = this->alpha1*delta_rot1_noise*delta_rot1_noise +
+      this->alpha2*delta_trans*delta_trans;
+    double trans_hat_stddev = this->alpha3*delta_trans*delta_trans +
+      this->alpha4*delta_rot1_noise*delta_rot1_noise +
+      this->alpha4*delta_rot2_noise*delta_rot2_noise;
+    double rot2_hat_stddev = this->alpha1*delta_rot2_noise*delta_rot2_noise +
+      this->alpha2*delta_trans*delta_trans;
+    // The corrected model takes the square root, so these really are
+    // standard deviations
+    if(this->model_type == ODOM_MODEL_DIFF_CORRECTED)
     {
-      pf_sample_t* sample = set->samples + i;
-
-      delta_bearing = angle_diff(atan2(ndata->delta.v[1], ndata->delta.v[0]),
-                                 old_pose.v[2]) + sample->pose.v[2];
-      double cs_bearing = cos(delta_bearing);
-      double sn_bearing = sin(delta_bearing);
-
-      // Sample pose differences
-      delta_trans_hat = delta_trans + pf_ran_gaussian(trans_hat_stddev);
-      delta_rot_hat = delta_rot + pf_ran_gaussian(rot_hat_stddev);
-      delta_strafe_hat = 0 + pf_ran_gaussian(strafe_hat_stddev);
-      // Apply sampled update to particle pose
-      sample->pose.v[0] += (delta_trans_hat * cs_bearing + 
-                            delta_strafe_hat * sn_bearing);
-      sample->pose.v[1] += (delta_trans_hat * sn_bearing - 
-                            delta_strafe_hat * cs_bearing);
-      sample->pose.v[2] += delta_rot_hat ;
+      rot1_hat_stddev = sqrt(rot1_hat_stddev);
+      trans_hat_stddev = sqrt(trans_hat_stddev);
+      rot2_hat_stddev = sqrt(rot2_hat_stddev);
     }
-  }
-  break;
-  case ODOM_MODEL_DIFF_CORRECTED:
-  {
-    // Implement sample_motion_odometry (Prob Rob p 136)
-    double delta_rot1, delta_trans, delta_rot2;
-    double delta_rot1_hat, delta_trans_hat, delta_rot2_hat;
-    double delta_rot1_noise, delta_rot2_noise;
-
-    // Avoid computing a bearing from two poses that are extremely near each
-    // other (happens on in-place rotation).
-    if(sqrt(ndata->delta.v[1]*ndata->delta.v[1] + 
-            ndata->delta.v[0]*ndata->delta.v[0]) < 0.01)
-      delta_rot1 = 0.0;
-    else
-      delta_rot1 = angle_diff(atan2(ndata->delta.v[1], ndata->delta.v[0]),
-                              old_pose.v[2]);
-    delta_trans = sqrt(ndata->delta.v[0]*ndata->delta.v[0] +
-                       ndata->delta.v[1]*ndata->delta.v[1]);
-    delta_rot2 = angle_diff(ndata->delta.v[2], delta_rot1);
-
-    // We want to treat backward and forward motion symmetrically for the
-    // noise model to be applied below.  The standard model seems to assume
-    // forward motion.
-    delta_rot1_noise = std::min(fabs(angle_diff(delta_rot1,0.0)),
-                                fabs(angle_diff(delta_rot1,M_PI)));
-    delta_rot2_noise = std::min(fabs(angle_diff(delta_rot2,0.0)),
-                                fabs(angle_diff(delta_rot2,M_PI)));
 
+#pragma omp parallel for schedule(static) num_threads(ParallelThreads())
     for (int i = 0; i < set->sample_count; i++)
     {
-      pf_sample_t* sample = set->samples + i;
+      double z[4];
 
       // Sample pose differences
-      delta_rot1_hat = angle_diff(delta_rot1,
-                                  pf_ran_gaussian(sqrt(this->alpha1*delta_rot1_noise*delta_rot1_noise +
-                                                       this->alpha2*delta_trans*delta_trans)));
-      delta_trans_hat = delta_trans - 
-              pf_ran_gaussian(sqrt(this->alpha3*delta_trans*delta_trans +
-                                   this->alpha4*delta_rot1_noise*delta_rot1_noise +
-                                   this->alpha4*delta_rot2_noise*delta_rot2_noise));
-      delta_rot2_hat = angle_diff(delta_rot2,
-                                  pf_ran_gaussian(sqrt(this->alpha1*delta_rot2_noise*delta_rot2_noise +
-                                                       this->alpha2*delta_trans*delta_trans)));
+      pf_ran_gaussian4(key, i, update, z);
+      double delta_rot1_hat = angle_diff(delta_rot1, rot1_hat_stddev * z[0]);
+      double delta_trans_hat = delta_trans - trans_hat_stddev * z[1];
+      double delta_rot2_hat = angle_diff(delta_rot2, rot2_hat_stddev * z[2]);
 
       // Apply sampled update to particle pose
-      sample->pose.v[0] += delta_trans_hat * 
-              cos(sample->pose.v[2] + delta_rot1_hat);
-      sample->pose.v[1] += delta_trans_hat * 
-              sin(sample->pose.v[2] + delta_rot1_hat);
-      sample->pose.v[2] += delta_rot1_hat + delta_rot2_hat;
+      set->x[i] += delta_trans_hat * 
+              cos(set->theta[i] + delta_rot1_hat);
+      set->y[i] += delta_trans_hat * 
+              sin(set->theta[i] + delta_rot1_hat);
+      set->theta[i] += delta_rot1_hat + delta_rot2_hat;
     }
   }
   break;
@@ -28,10 +28,16 @@
 ///////////////////////////////////////////////////////////////////////////
 
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "amcl_sensor.h"
 
 using namespace amcl;
 
+static int parallel_threads = 0;
+
 ////////////////////////////////////////////////////////////////////////////////
 // Default constructor
 AMCLSensor::AMCLSensor()
@@ -43,6 +49,24 @@ AMCLSensor::~AMCLSensor()
 {
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Limit the threads of the parallel sensor models
+void AMCLSensor::SetParallelThreads(int threads)
+{
+  parallel_threads = threads > 0 ? threads : 0;
+}
+
+int AMCLSensor::ParallelThreads()
+{
+  if (parallel_threads > 0)
+    return parallel_threads;
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Apply the action model
 bool AMCLSensor::UpdateAction(pf_t *pf, AMCLSensorData *data)
@@ -0,0 +1,516 @@
+/*
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+// Replays recorded scans through the AMCL particle filter as fast as it
+// goes, without ROS, and reports the throughput and the pose error.
+//
+// The map is a binary PGM as written by map_server.  The log is a text file
+// with one scan per line:
+//
+//   scan <stamp> <odom x y yaw> <true x y yaw> <range_max> <angle_min>
+//        <angle_increment> <count> <range> ...
+//
+// The odometry pose is the one at the time of the scan, the true pose is
+// what the estimate is compared against and may be "nan" where it is not
+// known.  Angles are in the base frame, so the scan of an upside-down laser
+// has a negative increment.  Lines starting with '#' are ignored.
+
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "map/map.h"
+#include "pf/pf.h"
+#include "sensors/amcl_odom.h"
+#include "sensors/amcl_laser.h"
+
+using namespace amcl;
+
+// A recorded scan
+struct Scan
+{
+  double stamp;
+  pf_vector_t odom;
+  pf_vector_t truth;
+  double range_max;
+  double angle_min;
+  double angle_increment;
+  std::vector<double> ranges;
+};
+
+// Filter settings, defaulting to those of the node
+struct Settings
+{
+  int min_particles, max_particles;
+  double kld_err, kld_z;
+  double alpha_slow, alpha_fast;
+  double d_thresh, a_thresh;
+  int resample_interval;
+  pf_resample_model_t resample_model;
+  odom_model_t odom_model;
+  double alpha[5];
+  laser_model_t laser_model;
+  int max_beams;
+  double z_hit, z_short, z_max, z_rand, sigma_hit, lambda_short;
+  double likelihood_max_dist;
+  pf_vector_t laser_pose;
+  bool global;
+  int repeat;
+};
+
+static double
+wall_time()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static double
+angle_diff(double a, double b)
+{
+  double d = fmod(a - b + M_PI, 2 * M_PI);
+  if(d < 0)
+    d += 2 * M_PI;
+  return d - M_PI;
+}
+
+static pf_vector_t
+uniformPoseGenerator(void* arg)
+{
+  map_t* map = (map_t*)arg;
+  int i = map->size_x / 2, j = map->size_y / 2;
+  map_pick_free(map, drand48(), &i, &j);
+  pf_vector_t p;
+  p.v[0] = MAP_WXGX(map, i);
+  p.v[1] = MAP_WYGY(map, j);
+  p.v[2] = drand48() * 2 * M_PI - M_PI;
+  return p;
+}
+
+static bool
+readLog(const char* filename, std::vector<Scan>& scans)
+{
+  FILE* file = fopen(filename, "r");
+  if(file == NULL)
+  {
+    fprintf(stderr, "Could not open %s\n", filename);
+    return false;
+  }
+
+  char word[16];
+  int line = 0;
+  while(fscanf(file, "%15s", word) == 1)
+  {
+    line++;
+    if(word[0] == '#')
+    {
+      int ch;
+      while((ch = fgetc(file)) != '\n' && ch != EOF);
+      continue;
+    }
+
+    Scan scan;
+    int count;
+    if(strcmp(word, "scan") != 0 ||
+       fscanf(file, "%lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %d",
+              &scan.stamp,
+              &scan.odom.v[0], &scan.odom.v[1], &scan.odom.v[2],
+              &scan.truth.v[0], &scan.truth.v[1], &scan.truth.v[2],
+              &scan.range_max, &scan.angle_min, &scan.angle_increment,
+              &count) != 11 || count < 0)
+    {
+      fprintf(stderr, "%s: malformed record %d\n", filename, line);
+      fclose(file);
+      return false;
+    }
+    scan.ranges.resize(count);
+    for(int i = 0; i < count; i++)
+    {
+      if(fscanf(file, "%lf", &scan.ranges[i]) != 1)
+      {
+        fprintf(stderr, "%s: record %d has too few ranges\n", filename, line);
+        fclose(file);
+        return false;
+      }
+    }
+    scans.push_back(scan);
+  }
+  fclose(file);
+  return true;
+}
+
+// Mean of the heaviest cluster
+static bool
+estimate(pf_t* pf, pf_vector_t& pose)
+{
+  double max_weight = 0.0;
+  for(int i = 0; i < pf->sets[pf->current_set].cluster_count; i++)
+  {
+    double weight;
+    pf_vector_t mean;
+    pf_matrix_t cov;
+    if(pf_get_cluster_stats(pf, i, &weight, &mean, &cov) && weight > max_weight)
+    {
+      max_weight = weight;
+      pose = mean;
+    }
+  }
+  return max_weight > 0.0;
+}
+
+static double
+percentile(std::vector<double> v, double q)
+{
+  if(v.empty())
+    return 0.0;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, (size_t)(q * v.size()))];
+}
+
+// Run the filter over the scans once, drawing random numbers from the seed
+static void
+run(map_t* map, const std::vector<Scan>& scans, const Settings& s, long seed,
+    std::vector<double>& update_times, std::vector<double>& errors_xy,
+    std::vector<double>& errors_yaw)
+{
+  pf_t* pf = pf_alloc(s.min_particles, s.max_particles,
+                      s.alpha_slow, s.alpha_fast,
+                      (pf_init_model_fn_t)uniformPoseGenerator, (void*)map);
+  pf->pop_err = s.kld_err;
+  pf->pop_z = s.kld_z;
+  pf->resample_model = s.resample_model;
+
+  // pf_alloc() seeds drand48 from the clock and pf_init() from a counter of
+  // its own, so it is seeded again after each of them
+  srand48(seed);
+  if(s.global || scans.empty() || std::isnan(scans[0].truth.v[0]))
+    pf_init_model(pf, (pf_init_model_fn_t)uniformPoseGenerator, (void*)map);
+  else
+  {
+    pf_matrix_t cov = pf_matrix_zero();
+    cov.m[0][0] = 0.5 * 0.5;
+    cov.m[1][1] = 0.5 * 0.5;
+    cov.m[2][2] = (M_PI/12.0) * (M_PI/12.0);
+    pf_init(pf, scans[0].truth, cov);
+    srand48(seed);
+  }
+
+  AMCLOdom odom;
+  odom.SetRandomSeed(seed);
+  odom.SetModel(s.odom_model, s.alpha[0], s.alpha[1], s.alpha[2], s.alpha[3], s.alpha[4]);
+
+  AMCLLaser laser(s.max_beams, map);
+  pf_vector_t laser_pose = s.laser_pose;
+  laser.SetLaserPose(laser_pose);
+  if(s.laser_model == LASER_MODEL_BEAM)
+    laser.SetModelBeam(s.z_hit, s.z_short, s.z_max, s.z_rand,
+                       s.sigma_hit, s.lambda_short, 0.0);
+  else if(s.laser_model == LASER_MODEL_LIKELIHOOD_FIELD_PROB)
+    laser.SetModelLikelihoodFieldProb(s.z_hit, s.z_rand, s.sigma_hit,
+                                      s.likelihood_max_dist, false, 0.5, 0.3, 0.9);
+  else
+    laser.SetModelLikelihoodField(s.z_hit, s.z_rand, s.sigma_hit,
+                                  s.likelihood_max_dist);
+
+  pf_vector_t pf_odom_pose = pf_vector_zero();
+  int resample_count = 0;
+  for(size_t n = 0; n < scans.size(); n++)
+  {
+    const Scan& scan = scans[n];
+    pf_vector_t delta = pf_vector_zero();
+    if(n > 0)
+    {
+      delta.v[0] = scan.odom.v[0] - pf_odom_pose.v[0];
+      delta.v[1] = scan.odom.v[1] - pf_odom_pose.v[1];
+      delta.v[2] = angle_diff(scan.odom.v[2], pf_odom_pose.v[2]);
+      if(fabs(delta.v[0]) <= s.d_thresh && fabs(delta.v[1]) <= s.d_thresh &&
+         fabs(delta.v[2]) <= s.a_thresh)
+        continue;
+    }
+
+    double t0 = wall_time();
+
+    if(n > 0)
+    {
+      AMCLOdomData odata;
+      odata.pose = scan.odom;
+      odata.delta = delta;
+      odom.UpdateAction(pf, (AMCLSensorData*)&odata);
+    }
+
+    AMCLLaserData ldata;
+    ldata.sensor = &laser;
+    ldata.range_count = scan.ranges.size();
+    ldata.range_max = scan.range_max;
+    ldata.ranges = new double[ldata.range_count][2];
+    for(int i = 0; i < ldata.range_count; i++)
+    {
+      ldata.ranges[i][0] = scan.ranges[i];
+      ldata.ranges[i][1] = scan.angle_min + i * scan.angle_increment;
+    }
+    laser.UpdateSensor(pf, (AMCLSensorData*)&ldata);
+
+    if(!(++resample_count % s.resample_interval))
+      pf_update_resample(pf);
+
+    update_times.push_back(wall_time() - t0);
+    pf_odom_pose = scan.odom;
+
+    pf_vector_t pose = pf_vector_zero();
+    if(!std::isnan(scan.truth.v[0]) && estimate(pf, pose))
+    {
+      errors_xy.push_back(hypot(pose.v[0] - scan.truth.v[0],
+                                pose.v[1] - scan.truth.v[1]));
+      errors_yaw.push_back(fabs(angle_diff(pose.v[2], scan.truth.v[2])));
+    }
+  }
+
+  pf_free(pf);
+}
+
+static void
+usage()
+{
+  fprintf(stderr,
+          "USAGE: amcl_benchmark [options] <map.pgm> <resolution> <log>\n"
+          "  --origin X Y              world position of the lower left map corner (0 0)\n"
+          "  --negate                  the map is white on black\n"
+          "  --particles MIN MAX       sample count bounds (100 5000)\n"
+          "  --laser-model MODEL       beam, likelihood_field or likelihood_field_prob\n"
+          "  --odom-model MODEL        diff, omni, diff-corrected or omni-corrected\n"
+          "  --max-beams N             beams per scan (30)\n"
+          "  --laser-pose X Y          laser position in the base frame (0 0)\n"
+          "  --resample-model MODEL    multinomial or systematic\n"
+          "  --global                  start from a uniform distribution over the map\n"
+          "  --repeat N                replay the log N times and report all runs (1)\n"
+          "  --seed N                  seed of the random number generators, run R uses N + R (0)\n");
+}
+
+int
+main(int argc, char** argv)
+{
+  Settings s;
+  s.min_particles = 100;
+  s.max_particles = 5000;
+  s.kld_err = 0.01;
+  s.kld_z = 0.99;
+  s.alpha_slow = 0.001;
+  s.alpha_fast = 0.1;
+  s.d_thresh = 0.2;
+  s.a_thresh = M_PI/6.0;
+  s.resample_interval = 2;
+  s.resample_model = PF_RESAMPLE_MULTINOMIAL;
+  s.odom_model = ODOM_MODEL_DIFF;
+  for(int i = 0; i < 5; i++)
+    s.alpha[i] = 0.2;
+  s.laser_model = LASER_MODEL_LIKELIHOOD_FIELD;
+  s.max_beams = 30;
+  s.z_hit = 0.95;
+  s.z_short = 0.1;
+  s.z_max = 0.05;
+  s.z_rand = 0.05;
+  s.sigma_hit = 0.2;
+  s.lambda_short = 0.1;
+  s.likelihood_max_dist = 2.0;
+  s.laser_pose = pf_vector_zero();
+  s.global = false;
+  s.repeat = 1;
+
+  double origin_x = 0.0, origin_y = 0.0;
+  int negate = 0;
+  long seed = 0;
+
+  static struct option options[] = {
+    {"origin", required_argument, NULL, 'o'},
+    {"negate", no_argument, NULL, 'n'},
+    {"particles", required_argument, NULL, 'p'},
+    {"laser-model", required_argument, NULL, 'l'},
+    {"odom-model", required_argument, NULL, 'd'},
+    {"max-beams", required_argument, NULL, 'b'},
+    {"laser-pose", required_argument, NULL, 'x'},
+    {"resample-model", required_argument, NULL, 'r'},
+    {"global", no_argument, NULL, 'g'},
+    {"repeat", required_argument, NULL, 'R'},
+    {"seed", required_argument, NULL, 's'},
+    {NULL, 0, NULL, 0}
+  };
+
+  int opt;
+  while((opt = getopt_long(argc, argv, "", options, NULL)) != -1)
+  {
+    std::string arg = optarg ? optarg : "";
+    switch(opt)
+    {
+      // Options with two values take the second from the next argument
+      case 'o':
+      case 'p':
+      case 'x':
+        if(optind >= argc)
+        {
+          usage();
+          return 1;
+        }
+        if(opt == 'o')
+        {
+          origin_x = atof(optarg);
+          origin_y = atof(argv[optind++]);
+        }
+        else if(opt == 'p')
+        {
+          s.min_particles = atoi(optarg);
+          s.max_particles = atoi(argv[optind++]);
+        }
+        else
+        {
+          s.laser_pose.v[0] = atof(optarg);
+          s.laser_pose.v[1] = atof(argv[optind++]);
+        }
+        break;
+      case 'n':
+        negate = 1;
+        break;
+      case 'l':
+        if(arg == "beam")
+          s.laser_model = LASER_MODEL_BEAM;
+        else if(arg == "likelihood_field")
+          s.laser_model = LASER_MODEL_LIKELIHOOD_FIELD;
+        else if(arg == "likelihood_field_prob")
+          s.laser_model = LASER_MODEL_LIKELIHOOD_FIELD_PROB;
+        else
+        {
+          fprintf(stderr, "Unknown laser model type \"%s\"\n", optarg);
+          return 1;
+        }
+        break;
+      case 'd':
+        if(arg == "diff")
+          s.odom_model = ODOM_MODEL_DIFF;
+        else if(arg == "omni")
+          s.odom_model = ODOM_MODEL_OMNI;
+        else if(arg == "diff-corrected")
+          s.odom_model = ODOM_MODEL_DIFF_CORRECTED;
+        else if(arg == "omni-corrected")
+          s.odom_model = ODOM_MODEL_OMNI_CORRECTED;
+        else
+        {
+          fprintf(stderr, "Unknown odom model type \"%s\"\n", optarg);
+          return 1;
+        }
+        break;
+      case 'b':
+        s.max_beams = atoi(optarg);
+        break;
+      case 'r':
+        if(arg == "multinomial")
+          s.resample_model = PF_RESAMPLE_MULTINOMIAL;
+        else if(arg == "systematic")
+          s.resample_model = PF_RESAMPLE_SYSTEMATIC;
+        else
+        {
+          fprintf(stderr, "Unknown resample model type \"%s\"\n", optarg);
+          return 1;
+        }
+        break;
+      case 'g':
+        s.global = true;
+        break;
+      case 'R':
+        s.repeat = std::max(1, atoi(optarg));
+        break;
+      case 's':
+        seed = atol(optarg);
+        break;
+      default:
+        usage();
+        return 1;
+    }
+  }
+
+  if(argc - optind != 3)
+  {
+    usage();
+    return 1;
+  }
+
+  map_t* map = map_alloc();
+  if(map_load_occ(map, argv[optind], atof(argv[optind + 1]), negate) < 0)
+  {
+    fprintf(stderr, "Could not load the map %s\n", argv[optind]);
+    return 1;
+  }
+  // The map origin is its center, see AmclNode::convertMap()
+  map->origin_x = origin_x + (map->size_x / 2) * map->scale;
+  map->origin_y = origin_y + (map->size_y / 2) * map->scale;
+  map_update_free(map);
+
+  std::vector<Scan> scans;
+  if(!readLog(argv[optind + 2], scans))
+    return 1;
+
+  printf("map %dx%d cells, %d scans, %d-%d particles, %d beams\n",
+         map->size_x, map->size_y, (int)scans.size(),
+         s.min_particles, s.max_particles, s.max_beams);
+
+  // The wall time includes building the likelihood field for every run
+  double start = wall_time();
+  std::vector<double> update_times, errors_xy, errors_yaw;
+  for(int r = 0; r < s.repeat; r++)
+  {
+    std::vector<double> times, exy, eyaw;
+    run(map, scans, s, seed + r, times, exy, eyaw);
+    update_times.insert(update_times.end(), times.begin(), times.end());
+    errors_xy.insert(errors_xy.end(), exy.begin(), exy.end());
+    errors_yaw.insert(errors_yaw.end(), eyaw.begin(), eyaw.end());
+
+    double total = 0.0;
+    for(size_t i = 0; i < times.size(); i++)
+      total += times[i];
+    printf("run %d: %d updates in %.3f s (%.1f updates/s), final error %.3f m %.3f rad\n",
+           r, (int)times.size(), total, total > 0.0 ? times.size() / total : 0.0,
+           exy.empty() ? NAN : exy.back(), eyaw.empty() ? NAN : eyaw.back());
+  }
+  double elapsed = wall_time() - start;
+
+  double total = 0.0;
+  for(size_t i = 0; i < update_times.size(); i++)
+    total += update_times[i];
+  printf("updates: %d, %.1f updates/s, %.1f s wall time\n",
+         (int)update_times.size(),
+         total > 0.0 ? update_times.size() / total : 0.0, elapsed);
+  printf("update time (ms): median %.3f, p90 %.3f, p99 %.3f, max %.3f\n",
+         1e3 * percentile(update_times, 0.5), 1e3 * percentile(update_times, 0.9),
+         1e3 * percentile(update_times, 0.99), 1e3 * percentile(update_times, 1.0));
+  printf("position error (m): median %.3f, p90 %.3f, max %.3f\n",
+         percentile(errors_xy, 0.5), percentile(errors_xy, 0.9),
+         percentile(errors_xy, 1.0));
+  printf("heading error (rad): median %.3f, p90 %.3f, max %.3f\n",
+         percentile(errors_yaw, 0.5), percentile(errors_yaw, 0.9),
+         percentile(errors_yaw, 1.0));
+
+  map_free(map);
+  return 0;
+}
@@ -21,6 +21,8 @@
 /* Author: Brian Gerkey */
 
 #include <algorithm>
+#include <deque>
+#include <list>
 #include <vector>
 #include <map>
 #include <cmath>
@@ -28,6 +30,8 @@
 
 #include <boost/bind.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 #include "map/map.h"
 #include "pf/pf.h"
@@ -45,6 +49,9 @@
 #include "geometry_msgs/PoseArray.h"
 #include "geometry_msgs/Pose.h"
 #include "nav_msgs/GetMap.h"
+#include "nav_msgs/MapMetaData.h"
+#include "map_msgs/OccupancyGridUpdate.h"
+#include "map_server/map_segment.h"
 #include "std_srvs/Empty.h"
 
 // For transform support
@@ -57,6 +64,10 @@
 // Dynamic_reconfigure
 #include "dynamic_reconfigure/server.h"
 #include "amcl/AMCLConfig.h"
+#include "amcl/ParticleClusters.h"
+#include "amcl/Statistics.h"
+
+#include "nav_trace/trace.h"
 
 #define NEW_UNIFORM_SAMPLING 1
 
@@ -115,25 +126,54 @@ class AmclNode
 
     tf::Transform latest_tf_;
     bool latest_tf_valid_;
+    // Guards latest_tf_ against the tf publish timer when the filter is
+    // updated in its own thread
+    boost::mutex latest_tf_mutex_;
 
     // Pose-generating function used to uniformly distribute particles over
     // the map
     static pf_vector_t uniformPoseGenerator(void* arg);
-#if NEW_UNIFORM_SAMPLING
-    static std::vector<std::pair<int,int> > free_space_indices;
-#endif
     // Callbacks
     bool globalLocalizationCallback(std_srvs::Empty::Request& req,
                                     std_srvs::Empty::Response& res);
     bool nomotionUpdateCallback(std_srvs::Empty::Request& req,
                                     std_srvs::Empty::Response& res);
+    bool dumpTraceCallback(std_srvs::Empty::Request& req,
+                           std_srvs::Empty::Response& res);
 
     void laserReceived(const sensor_msgs::LaserScanConstPtr& laser_scan);
+    void processLaserScan(const sensor_msgs::LaserScanConstPtr& laser_scan);
     void initialPoseReceived(const geometry_msgs::PoseWithCovarianceStampedConstPtr& msg);
     void mapReceived(const nav_msgs::OccupancyGridConstPtr& msg);
+    // Reads the map from map_segment_ when the map server announces it
+    void mapMetaDataReceived(const nav_msgs::MapMetaDataConstPtr& msg);
+    // Patches the cells of the map and the likelihood field around them,
+    // keeping the particles
+    void mapUpdateReceived(const map_msgs::OccupancyGridUpdateConstPtr& msg);
 
     void handleMapMessage(const nav_msgs::OccupancyGrid& msg);
+    // The particle cloud and clusters are only published while someone
+    // listens, so a new subscriber gets the current ones on connect instead
+    // of a latched message that may be long out of date
+    void particleCloudConnected(const ros::SingleSubscriberPublisher& pub);
+    void particleClustersConnected(const ros::SingleSubscriberPublisher& pub);
+    void fillParticleCloud(geometry_msgs::PoseArray& cloud_msg);
     void freeMapDependentMemory();
+    // With a map_cache_size the maps replaced by a new one are kept together
+    // with their laser model, most recent first, and taken back when the map
+    // server switches to them again, e.g. between the floors of a building
+    struct CachedMap
+    {
+      nav_msgs::MapMetaData info;
+      map_t* map;
+      AMCLLaser* laser;
+    };
+    int map_cache_size_;
+    std::list< CachedMap > map_cache_;
+    nav_msgs::MapMetaData map_info_;
+    void cacheMap();
+    bool takeCachedMap(const nav_msgs::MapMetaData& info);
+    void clearMapCache();
     map_t* convertMap( const nav_msgs::OccupancyGrid& map_msg );
     void updatePoseFromServer();
     void applyInitialPose();
@@ -147,6 +187,8 @@ class AmclNode
     std::string global_frame_id_;
 
     bool use_map_topic_;
+    bool subscribe_to_updates_;
+    std::string map_segment_;
     bool first_map_only_;
 
     ros::Duration gui_publish_period;
@@ -167,9 +209,62 @@ class AmclNode
     std::vector< bool > lasers_update_;
     std::map< std::string, int > frame_to_laser_;
 
+    // Scans of different lasers that are applied to the filter together,
+    // and the time of the first one
+    double laser_fusion_window_;
+    int laser_refine_iterations_;
+    std::vector< AMCLLaserData* > pending_scans_;
+    ros::Time pending_scans_stamp_;
+    void applyPendingScans();
+    void clearPendingScans();
+
+    // With use_update_thread the laser callback only queues the scans, and
+    // the filter is updated from the queue in a thread of its own.  The
+    // transform is then republished from a timer, so it stays fresh while
+    // an update runs.
+    bool use_update_thread_;
+    int update_queue_size_;
+    boost::thread* update_thread_;
+    boost::mutex scan_queue_mutex_;
+    boost::condition_variable scan_queue_cond_;
+    std::deque< sensor_msgs::LaserScanConstPtr > scan_queue_;
+    bool update_thread_shutdown_;
+    ros::Timer tf_publish_timer_;
+    void updateThread();
+    void publishTransform(const ros::TimerEvent& event);
+
+    // With a statistics_rate the wall time of every stage of the filter
+    // updates is collected, and summarized on ~statistics at that rate.
+    // update_stage_time_ holds the stages of the current update, -1 for the
+    // ones it did not go through.
+    enum Stage
+    {
+      STAGE_TF,
+      STAGE_ACTION,
+      STAGE_SENSOR,
+      STAGE_RESAMPLE,
+      STAGE_CLUSTER,
+      STAGE_PUBLISH,
+      STAGE_COUNT
+    };
+    bool statistics_enabled_;
+    ros::WallDuration statistics_period_;
+    ros::WallTime statistics_last_time_;
+    ros::Publisher statistics_pub_;
+    double update_stage_time_[STAGE_COUNT];
+    std::vector<double> stage_times_[STAGE_COUNT];
+    int statistics_updates_;
+    int statistics_beams_;
+    ros::WallTime startStages();
+    void endStage(Stage stage, ros::WallTime& start);
+    void recordStatistics();
+    int usedBeams(AMCLLaser* laser, int range_count);
+
     // Particle filter
     pf_t *pf_;
     double pf_err_, pf_z_;
+    double pf_err_converged_;
+    int seed_;
     bool pf_init_;
     pf_vector_t pf_odom_pose_;
     double d_thresh_, a_thresh_;
@@ -202,10 +297,16 @@ class AmclNode
     ros::NodeHandle private_nh_;
     ros::Publisher pose_pub_;
     ros::Publisher particlecloud_pub_;
+    ros::Publisher particle_clusters_pub_;
+    int particlecloud_max_poses_;  // 0 publishes every particle
+    amcl::ParticleClusters clusters_msg_;  // clusters of the last resampling
     ros::ServiceServer global_loc_srv_;
     ros::ServiceServer nomotion_update_srv_; //to let amcl update samples without requiring motion
+    ros::ServiceServer dump_trace_srv_;
+    std::string trace_file_;
     ros::Subscriber initial_pose_sub_old_;
     ros::Subscriber map_sub_;
+    ros::Subscriber map_update_sub_;
 
     amcl_hyp_t* initial_pose_hyp_;
     bool first_map_received_;
@@ -224,7 +325,14 @@ class AmclNode
     bool do_beamskip_;
     double beam_skip_distance_, beam_skip_threshold_, beam_skip_error_threshold_;
     double laser_likelihood_max_dist_;
+    int laser_range_table_angles_;
+    double laser_pose_cache_xy_, laser_pose_cache_theta_;
+    bool laser_adaptive_beams_;
+    std::string laser_likelihood_cache_dir_;
+    int laser_likelihood_tile_size_, laser_likelihood_max_tiles_;
+    bool laser_use_gpu_;
     odom_model_t odom_model_type_;
+    pf_resample_model_t resample_model_type_;
     double init_pose_[3];
     double init_cov_[3];
     laser_model_t laser_model_type_;
@@ -237,8 +345,6 @@ class AmclNode
     void checkLaserReceived(const ros::TimerEvent& event);
 };
 
-std::vector<std::pair<int,int> > AmclNode::free_space_indices;
-
 #define USAGE "USAGE: amcl"
 
 int
@@ -317,6 +423,10 @@ AmclNode::AmclNode() :
         resample_count_(0),
         odom_(NULL),
         laser_(NULL),
+        update_thread_(NULL),
+        update_thread_shutdown_(false),
+        statistics_updates_(0),
+        statistics_beams_(0),
 	      private_nh_("~"),
         initial_pose_hyp_(NULL),
         first_map_received_(false),
@@ -327,6 +437,10 @@ AmclNode::AmclNode() :
   // Grab params off the param server
   private_nh_.param("use_map_topic", use_map_topic_, false);
   private_nh_.param("first_map_only", first_map_only_, false);
+  private_nh_.param("map_cache_size", map_cache_size_, 0);
+  private_nh_.param("subscribe_to_updates", subscribe_to_updates_, false);
+  // a map server on this host can share the map in memory instead of sending it
+  private_nh_.param("map_segment", map_segment_, std::string(""));
 
   double tmp;
   private_nh_.param("gui_publish_rate", tmp, -1.0);
@@ -341,6 +455,9 @@ AmclNode::AmclNode() :
   private_nh_.param("max_particles", max_particles_, 5000);
   private_nh_.param("kld_err", pf_err_, 0.01);
   private_nh_.param("kld_z", pf_z_, 0.99);
+  private_nh_.param("kld_err_converged", pf_err_converged_, 0.0);
+  // a negative seed seeds the random numbers from the clock
+  private_nh_.param("seed", seed_, -1);
   private_nh_.param("odom_alpha1", alpha1_, 0.2);
   private_nh_.param("odom_alpha2", alpha2_, 0.2);
   private_nh_.param("odom_alpha3", alpha3_, 0.2);
@@ -359,6 +476,20 @@ AmclNode::AmclNode() :
   private_nh_.param("laser_sigma_hit", sigma_hit_, 0.2);
   private_nh_.param("laser_lambda_short", lambda_short_, 0.1);
   private_nh_.param("laser_likelihood_max_dist", laser_likelihood_max_dist_, 2.0);
+  private_nh_.param("laser_range_table_angles", laser_range_table_angles_, 0);
+  private_nh_.param("laser_pose_cache_xy", laser_pose_cache_xy_, 0.0);
+  private_nh_.param("laser_pose_cache_theta", laser_pose_cache_theta_, 0.0);
+  private_nh_.param("laser_adaptive_beams", laser_adaptive_beams_, false);
+  private_nh_.param("laser_likelihood_cache_dir", laser_likelihood_cache_dir_, std::string(""));
+  private_nh_.param("laser_likelihood_tile_size", laser_likelihood_tile_size_, 256);
+  private_nh_.param("laser_likelihood_max_tiles", laser_likelihood_max_tiles_, 0);
+  private_nh_.param("laser_use_gpu", laser_use_gpu_, false);
+  private_nh_.param("laser_fusion_window", laser_fusion_window_, 0.0);
+  private_nh_.param("laser_refine_iterations", laser_refine_iterations_, 0);
+  // keeps the particle weighting from competing with the navigation workers for every core
+  int parallel_threads;
+  private_nh_.param("parallel_threads", parallel_threads, 0);
+  AMCLSensor::SetParallelThreads(parallel_threads);
   std::string tmp_model_type;
   private_nh_.param("laser_model_type", tmp_model_type, std::string("likelihood_field"));
   if(tmp_model_type == "beam")
@@ -397,11 +528,32 @@ AmclNode::AmclNode() :
   private_nh_.param("base_frame_id", base_frame_id_, std::string("base_link"));
   private_nh_.param("global_frame_id", global_frame_id_, std::string("map"));
   private_nh_.param("resample_interval", resample_interval_, 2);
+  private_nh_.param("resample_model_type", tmp_model_type, std::string("multinomial"));
+  if(tmp_model_type == "multinomial")
+    resample_model_type_ = PF_RESAMPLE_MULTINOMIAL;
+  else if(tmp_model_type == "systematic")
+    resample_model_type_ = PF_RESAMPLE_SYSTEMATIC;
+  else
+  {
+    ROS_WARN("Unknown resample model type \"%s\"; defaulting to multinomial model",
+             tmp_model_type.c_str());
+    resample_model_type_ = PF_RESAMPLE_MULTINOMIAL;
+  }
   double tmp_tol;
   private_nh_.param("transform_tolerance", tmp_tol, 0.1);
   private_nh_.param("recovery_alpha_slow", alpha_slow_, 0.001);
   private_nh_.param("recovery_alpha_fast", alpha_fast_, 0.1);
   private_nh_.param("tf_broadcast", tf_broadcast_, true);
+  private_nh_.param("use_update_thread", use_update_thread_, false);
+  private_nh_.param("update_queue_size", update_queue_size_, 4);
+  double tf_publish_rate;
+  private_nh_.param("tf_publish_rate", tf_publish_rate, 20.0);
+  private_nh_.param("particlecloud_max_poses", particlecloud_max_poses_, 0);
+  double statistics_rate;
+  private_nh_.param("statistics_rate", statistics_rate, 0.0);
+  statistics_enabled_ = statistics_rate > 0.0;
+  if(statistics_enabled_)
+    statistics_period_ = ros::WallDuration(1.0/statistics_rate);
 
   transform_tolerance_.fromSec(tmp_tol);
 
@@ -412,12 +564,32 @@ AmclNode::AmclNode() :
   tf_ = new tf::TransformListener();
 
   pose_pub_ = nh_.advertise<geometry_msgs::PoseWithCovarianceStamped>("amcl_pose", 2, true);
-  particlecloud_pub_ = nh_.advertise<geometry_msgs::PoseArray>("particlecloud", 2, true);
+  particlecloud_pub_ = nh_.advertise<geometry_msgs::PoseArray>("particlecloud", 2,
+      boost::bind(&AmclNode::particleCloudConnected, this, _1));
+  particle_clusters_pub_ = nh_.advertise<amcl::ParticleClusters>("particle_clusters", 2,
+      boost::bind(&AmclNode::particleClustersConnected, this, _1));
+  if(statistics_enabled_)
+  {
+    statistics_pub_ = private_nh_.advertise<amcl::Statistics>("statistics", 2);
+    statistics_last_time_ = ros::WallTime::now();
+  }
   global_loc_srv_ = nh_.advertiseService("global_localization", 
 					 &AmclNode::globalLocalizationCallback,
                                          this);
   nomotion_update_srv_= nh_.advertiseService("request_nomotion_update", &AmclNode::nomotionUpdateCallback, this);
 
+  // record where the time of the filter updates goes, see nav_trace/trace.h
+  int trace_buffer_size;
+  bool trace_marker;
+  private_nh_.param("trace_buffer_size", trace_buffer_size, 0);
+  private_nh_.param("trace_marker", trace_marker, false);
+  private_nh_.param("trace_file", trace_file_, std::string("/tmp/amcl_trace.json"));
+  if(trace_buffer_size > 0)
+  {
+    nav_trace::Tracer::enable(trace_buffer_size, trace_marker);
+    dump_trace_srv_ = private_nh_.advertiseService("dump_trace", &AmclNode::dumpTraceCallback, this);
+  }
+
   laser_scan_sub_ = new message_filters::Subscriber<sensor_msgs::LaserScan>(nh_, scan_topic_, 100);
   laser_scan_filter_ = 
           new tf::MessageFilter<sensor_msgs::LaserScan>(*laser_scan_sub_, 
@@ -428,9 +600,14 @@ AmclNode::AmclNode() :
                                                    this, _1));
   initial_pose_sub_ = nh_.subscribe("initialpose", 2, &AmclNode::initialPoseReceived, this);
 
-  if(use_map_topic_) {
+  if(!map_segment_.empty()) {
+    map_sub_ = nh_.subscribe("map_metadata", 1, &AmclNode::mapMetaDataReceived, this);
+    ROS_INFO("Reading the map from the shared memory segment %s.", map_segment_.c_str());
+  } else if(use_map_topic_) {
     map_sub_ = nh_.subscribe("map", 1, &AmclNode::mapReceived, this);
     ROS_INFO("Subscribed to map topic.");
+    if(subscribe_to_updates_)
+      map_update_sub_ = nh_.subscribe("map_updates", 10, &AmclNode::mapUpdateReceived, this);
   } else {
     requestMap();
   }
@@ -445,6 +622,16 @@ AmclNode::AmclNode() :
   check_laser_timer_ = nh_.createTimer(laser_check_interval_, 
                                        boost::bind(&AmclNode::checkLaserReceived, this, _1));
 
+  if(use_update_thread_)
+  {
+    if(update_queue_size_ < 1)
+      update_queue_size_ = 1;
+    update_thread_ = new boost::thread(boost::bind(&AmclNode::updateThread, this));
+    if(tf_publish_rate > 0.0)
+      tf_publish_timer_ = nh_.createTimer(ros::Duration(1.0/tf_publish_rate),
+                                          boost::bind(&AmclNode::publishTransform, this, _1));
+  }
+
   // Grab the initial pose from file
   geometry_msgs::PoseWithCovarianceStampedPtr ipff(new geometry_msgs::PoseWithCovarianceStamped);
   if (readPoseFromFile(ipff))
@@ -474,6 +661,10 @@ void AmclNode::reconfigureCB(AMCLConfig &config, uint32_t level)
   a_thresh_ = config.update_min_a;
 
   resample_interval_ = config.resample_interval;
+  if(config.resample_model_type == "multinomial")
+    resample_model_type_ = PF_RESAMPLE_MULTINOMIAL;
+  else if(config.resample_model_type == "systematic")
+    resample_model_type_ = PF_RESAMPLE_SYSTEMATIC;
 
   laser_min_range_ = config.laser_min_range;
   laser_max_range_ = config.laser_max_range;
@@ -497,6 +688,12 @@ void AmclNode::reconfigureCB(AMCLConfig &config, uint32_t level)
   sigma_hit_ = config.laser_sigma_hit;
   lambda_short_ = config.laser_lambda_short;
   laser_likelihood_max_dist_ = config.laser_likelihood_max_dist;
+  laser_range_table_angles_ = config.laser_range_table_angles;
+  laser_pose_cache_xy_ = config.laser_pose_cache_xy;
+  laser_pose_cache_theta_ = config.laser_pose_cache_theta;
+  laser_adaptive_beams_ = config.laser_adaptive_beams;
+  laser_fusion_window_ = config.laser_fusion_window;
+  laser_refine_iterations_ = config.laser_refine_iterations;
 
   if(config.laser_model_type == "beam")
     laser_model_type_ = LASER_MODEL_BEAM;
@@ -538,6 +735,9 @@ void AmclNode::reconfigureCB(AMCLConfig &config, uint32_t level)
   pf_z_ = config.kld_z; 
   pf_->pop_err = pf_err_;
   pf_->pop_z = pf_z_;
+  pf_->converged_pop_err = pf_err_converged_;
+  pf_->resample_model = resample_model_type_;
+  pf_->timing = statistics_enabled_;
 
   // Initialize the filter
   pf_vector_t pf_init_pose_mean = pf_vector_zero();
@@ -550,20 +750,38 @@ void AmclNode::reconfigureCB(AMCLConfig &config, uint32_t level)
   pf_init_pose_cov.m[2][2] = last_published_pose.pose.covariance[6*5+5];
   pf_init(pf_, pf_init_pose_mean, pf_init_pose_cov);
   pf_init_ = false;
+  // pf_alloc() and pf_init() seed drand48 from the clock and from a counter
+  if(seed_ >= 0)
+    srand48(seed_);
 
   // Instantiate the sensor objects
   // Odometry
   delete odom_;
   odom_ = new AMCLOdom();
   ROS_ASSERT(odom_);
+  if(seed_ >= 0)
+    odom_->SetRandomSeed(seed_);
   odom_->SetModel( odom_model_type_, alpha1_, alpha2_, alpha3_, alpha4_, alpha5_ );
-  // Laser
+  // Laser; the cached ones were set up with the old parameters
+  clearMapCache();
   delete laser_;
   laser_ = new AMCLLaser(max_beams_, map_);
   ROS_ASSERT(laser_);
+  laser_->SetPoseCache(laser_pose_cache_xy_, laser_pose_cache_theta_);
+  laser_->SetAdaptiveBeams(laser_adaptive_beams_);
+  laser_->SetLikelihoodFieldCache(laser_likelihood_cache_dir_);
+  if(laser_likelihood_max_tiles_ > 0)
+    laser_->SetLikelihoodFieldTiles(laser_likelihood_tile_size_, laser_likelihood_max_tiles_);
+  if(laser_use_gpu_ && !laser_->SetUseGPU(true))
+    ROS_WARN_ONCE("No usable GPU, weighting the particles on the CPU");
   if(laser_model_type_ == LASER_MODEL_BEAM)
+  {
+    if(laser_range_table_angles_ > 0)
+      ROS_INFO("Initializing beam model range table; this can take some time on large maps...");
     laser_->SetModelBeam(z_hit_, z_short_, z_max_, z_rand_,
-                         sigma_hit_, lambda_short_, 0.0);
+                         sigma_hit_, lambda_short_, 0.0,
+                         laser_range_table_angles_);
+  }
   else if(laser_model_type_ == LASER_MODEL_LIKELIHOOD_FIELD_PROB){
     ROS_INFO("Initializing likelihood field model; this can take some time on large maps...");
     laser_->SetModelLikelihoodFieldProb(z_hit_, z_rand_, sigma_hit_,
@@ -679,6 +897,120 @@ AmclNode::mapReceived(const nav_msgs::OccupancyGridConstPtr& msg)
   first_map_received_ = true;
 }
 
+void
+AmclNode::mapMetaDataReceived(const nav_msgs::MapMetaDataConstPtr& msg)
+{
+  if( first_map_only_ && first_map_received_ ) {
+    return;
+  }
+
+  nav_msgs::OccupancyGrid map;
+  if(!map_server::readMapSegment(map_segment_, map) || map.info.map_load_time != msg->map_load_time)
+  {
+    ROS_WARN("The shared memory segment %s does not hold the announced map", map_segment_.c_str());
+    return;
+  }
+  handleMapMessage( map );
+
+  first_map_received_ = true;
+}
+
+void
+AmclNode::mapUpdateReceived(const map_msgs::OccupancyGridUpdateConstPtr& msg)
+{
+  boost::recursive_mutex::scoped_lock cfl(configuration_mutex_);
+  if(map_ == NULL || first_map_only_)
+    return;
+
+  if(msg->x < 0 || msg->y < 0 || msg->x + (int)msg->width > map_->size_x ||
+     msg->y + (int)msg->height > map_->size_y ||
+     msg->data.size() != (size_t)msg->width * msg->height)
+  {
+    ROS_WARN("Ignoring a map update of %d X %d cells at %d, %d that does not fit the %d X %d map",
+             msg->width, msg->height, msg->x, msg->y, map_->size_x, map_->size_y);
+    return;
+  }
+
+  // Convert the cells like convertMap() does, keeping the bounds of the
+  // ones that changed
+  int i0 = map_->size_x, j0 = map_->size_y, i1 = -1, j1 = -1;
+  for(unsigned int y = 0; y < msg->height; y++)
+  {
+    for(unsigned int x = 0; x < msg->width; x++)
+    {
+      signed char value = msg->data[y * msg->width + x];
+      signed char occ_state = value == 0 ? -1 : (value == 100 ? +1 : 0);
+      int i = msg->x + x, j = msg->y + y;
+      map_cell_t* cell = map_->cells + MAP_INDEX(map_, i, j);
+      if(cell->occ_state == occ_state)
+        continue;
+      cell->occ_state = occ_state;
+      i0 = std::min(i0, i);
+      j0 = std::min(j0, j);
+      i1 = std::max(i1, i);
+      j1 = std::max(j1, j);
+    }
+  }
+  if(i1 < 0)
+    return;
+
+  // Only the likelihood field around the changed cells is recomputed; the
+  // range table of the beam model holds rays across the whole map
+  if(map_->max_occ_dist > 0.0)
+    map_update_cspace_region(map_, i0, j0, i1, j1);
+  if(map_->ranges != NULL)
+  {
+    ROS_INFO("Recomputing the beam model range table for the map update; this can take some time on large maps...");
+    map_update_ranges(map_, map_->range_angles);
+  }
+#if NEW_UNIFORM_SAMPLING
+  if(map_update_free(map_) < 0)
+    ROS_ERROR("Failed to index the free space of the map");
+#endif
+
+  ROS_INFO("Updated the cells [%d, %d] x [%d, %d] of the map", i0, i1, j0, j1);
+}
+
+void
+AmclNode::fillParticleCloud(geometry_msgs::PoseArray& cloud_msg)
+{
+  pf_sample_set_t* set = pf_->sets + pf_->current_set;
+  int step = 1;
+  if(particlecloud_max_poses_ > 0 && set->sample_count > particlecloud_max_poses_)
+    step = (set->sample_count + particlecloud_max_poses_ - 1) / particlecloud_max_poses_;
+
+  cloud_msg.header.stamp = ros::Time::now();
+  cloud_msg.header.frame_id = global_frame_id_;
+  cloud_msg.poses.resize((set->sample_count + step - 1) / step);
+  for(int i=0;i<set->sample_count;i+=step)
+  {
+    tf::poseTFToMsg(tf::Pose(tf::createQuaternionFromYaw(set->theta[i]),
+                             tf::Vector3(set->x[i],
+                                       set->y[i], 0)),
+                    cloud_msg.poses[i/step]);
+  }
+}
+
+void
+AmclNode::particleCloudConnected(const ros::SingleSubscriberPublisher& pub)
+{
+  boost::recursive_mutex::scoped_lock cl(configuration_mutex_);
+  if(pf_ == NULL)
+    return;
+  geometry_msgs::PoseArray cloud_msg;
+  fillParticleCloud(cloud_msg);
+  pub.publish(cloud_msg);
+}
+
+void
+AmclNode::particleClustersConnected(const ros::SingleSubscriberPublisher& pub)
+{
+  boost::recursive_mutex::scoped_lock cl(configuration_mutex_);
+  if(clusters_msg_.header.stamp.isZero())
+    return;
+  pub.publish(clusters_msg_);
+}
+
 void
 AmclNode::handleMapMessage(const nav_msgs::OccupancyGrid& msg)
 {
@@ -689,23 +1021,30 @@ AmclNode::handleMapMessage(const nav_msgs::OccupancyGrid& msg)
            msg.info.height,
            msg.info.resolution);
 
+  cacheMap();
   freeMapDependentMemory();
   // Clear queued laser objects because they hold pointers to the existing
   // map, #5202.
+  clearPendingScans();
   lasers_.clear();
   lasers_update_.clear();
   frame_to_laser_.clear();
 
-  map_ = convertMap(msg);
+  map_info_ = msg.info;
+  if(takeCachedMap(msg.info))
+  {
+    ROS_INFO("Switched back to a cached map, keeping its likelihood field");
+  }
+  else
+  {
+    map_ = convertMap(msg);
 
 #if NEW_UNIFORM_SAMPLING
-  // Index of free space
-  free_space_indices.resize(0);
-  for(int i = 0; i < map_->size_x; i++)
-    for(int j = 0; j < map_->size_y; j++)
-      if(map_->cells[MAP_INDEX(map_,i,j)].occ_state == -1)
-        free_space_indices.push_back(std::make_pair(i,j));
+    // Index of free space
+    if(map_update_free(map_) < 0)
+      ROS_ERROR("Failed to index the free space of the map");
 #endif
+  }
   // Create the particle filter
   pf_ = pf_alloc(min_particles_, max_particles_,
                  alpha_slow_, alpha_fast_,
@@ -713,6 +1052,9 @@ AmclNode::handleMapMessage(const nav_msgs::OccupancyGrid& msg)
                  (void *)map_);
   pf_->pop_err = pf_err_;
   pf_->pop_z = pf_z_;
+  pf_->converged_pop_err = pf_err_converged_;
+  pf_->resample_model = resample_model_type_;
+  pf_->timing = statistics_enabled_;
 
   // Initialize the filter
   updatePoseFromServer();
@@ -726,34 +1068,53 @@ AmclNode::handleMapMessage(const nav_msgs::OccupancyGrid& msg)
   pf_init_pose_cov.m[2][2] = init_cov_[2];
   pf_init(pf_, pf_init_pose_mean, pf_init_pose_cov);
   pf_init_ = false;
+  // pf_alloc() and pf_init() seed drand48 from the clock and from a counter
+  if(seed_ >= 0)
+    srand48(seed_);
 
   // Instantiate the sensor objects
   // Odometry
   delete odom_;
   odom_ = new AMCLOdom();
   ROS_ASSERT(odom_);
+  if(seed_ >= 0)
+    odom_->SetRandomSeed(seed_);
   odom_->SetModel( odom_model_type_, alpha1_, alpha2_, alpha3_, alpha4_, alpha5_ );
-  // Laser
-  delete laser_;
-  laser_ = new AMCLLaser(max_beams_, map_);
-  ROS_ASSERT(laser_);
-  if(laser_model_type_ == LASER_MODEL_BEAM)
-    laser_->SetModelBeam(z_hit_, z_short_, z_max_, z_rand_,
-                         sigma_hit_, lambda_short_, 0.0);
-  else if(laser_model_type_ == LASER_MODEL_LIKELIHOOD_FIELD_PROB){
-    ROS_INFO("Initializing likelihood field model; this can take some time on large maps...");
-    laser_->SetModelLikelihoodFieldProb(z_hit_, z_rand_, sigma_hit_,
-					laser_likelihood_max_dist_, 
-					do_beamskip_, beam_skip_distance_, 
-					beam_skip_threshold_, beam_skip_error_threshold_);
-    ROS_INFO("Done initializing likelihood field model.");
-  }
-  else
+  // Laser, unless the cached one of the map came back with it
+  if(laser_ == NULL)
   {
-    ROS_INFO("Initializing likelihood field model; this can take some time on large maps...");
-    laser_->SetModelLikelihoodField(z_hit_, z_rand_, sigma_hit_,
-                                    laser_likelihood_max_dist_);
-    ROS_INFO("Done initializing likelihood field model.");
+    laser_ = new AMCLLaser(max_beams_, map_);
+    ROS_ASSERT(laser_);
+    laser_->SetPoseCache(laser_pose_cache_xy_, laser_pose_cache_theta_);
+    laser_->SetAdaptiveBeams(laser_adaptive_beams_);
+    laser_->SetLikelihoodFieldCache(laser_likelihood_cache_dir_);
+    if(laser_likelihood_max_tiles_ > 0)
+      laser_->SetLikelihoodFieldTiles(laser_likelihood_tile_size_, laser_likelihood_max_tiles_);
+    if(laser_use_gpu_ && !laser_->SetUseGPU(true))
+      ROS_WARN_ONCE("No usable GPU, weighting the particles on the CPU");
+    if(laser_model_type_ == LASER_MODEL_BEAM)
+    {
+      if(laser_range_table_angles_ > 0)
+        ROS_INFO("Initializing beam model range table; this can take some time on large maps...");
+      laser_->SetModelBeam(z_hit_, z_short_, z_max_, z_rand_,
+                           sigma_hit_, lambda_short_, 0.0,
+                           laser_range_table_angles_);
+    }
+    else if(laser_model_type_ == LASER_MODEL_LIKELIHOOD_FIELD_PROB){
+      ROS_INFO("Initializing likelihood field model; this can take some time on large maps...");
+      laser_->SetModelLikelihoodFieldProb(z_hit_, z_rand_, sigma_hit_,
+                                          laser_likelihood_max_dist_,
+                                          do_beamskip_, beam_skip_distance_,
+                                          beam_skip_threshold_, beam_skip_error_threshold_);
+      ROS_INFO("Done initializing likelihood field model.");
+    }
+    else
+    {
+      ROS_INFO("Initializing likelihood field model; this can take some time on large maps...");
+      laser_->SetModelLikelihoodField(z_hit_, z_rand_, sigma_hit_,
+                                      laser_likelihood_max_dist_);
+      ROS_INFO("Done initializing likelihood field model.");
+    }
   }
 
   // In case the initial pose message arrived before the first map,
@@ -773,12 +1134,66 @@ AmclNode::freeMapDependentMemory()
     pf_free( pf_ );
     pf_ = NULL;
   }
+  clusters_msg_ = amcl::ParticleClusters();
   delete odom_;
   odom_ = NULL;
   delete laser_;
   laser_ = NULL;
 }
 
+void
+AmclNode::cacheMap()
+{
+  // only maps with a load time can be told apart when they come back
+  if(map_cache_size_ <= 0 || map_ == NULL || laser_ == NULL || map_info_.map_load_time.isZero())
+    return;
+
+  CachedMap cached;
+  cached.info = map_info_;
+  cached.map = map_;
+  cached.laser = laser_;
+  map_cache_.push_front(cached);
+  map_ = NULL;
+  laser_ = NULL;
+  while((int)map_cache_.size() > map_cache_size_)
+  {
+    map_free(map_cache_.back().map);
+    delete map_cache_.back().laser;
+    map_cache_.pop_back();
+  }
+}
+
+bool
+AmclNode::takeCachedMap(const nav_msgs::MapMetaData& info)
+{
+  for(std::list< CachedMap >::iterator it = map_cache_.begin(); it != map_cache_.end(); ++it)
+  {
+    if(it->info.map_load_time == info.map_load_time &&
+       it->info.width == info.width && it->info.height == info.height &&
+       it->info.resolution == info.resolution &&
+       it->info.origin.position.x == info.origin.position.x &&
+       it->info.origin.position.y == info.origin.position.y)
+    {
+      map_ = it->map;
+      laser_ = it->laser;
+      map_cache_.erase(it);
+      return true;
+    }
+  }
+  return false;
+}
+
+void
+AmclNode::clearMapCache()
+{
+  for(std::list< CachedMap >::iterator it = map_cache_.begin(); it != map_cache_.end(); ++it)
+  {
+    map_free(it->map);
+    delete it->laser;
+  }
+  map_cache_.clear();
+}
+
 /**
  * Convert an OccupancyGrid map message into the internal
  * representation.  This allocates a map_t and returns it.
@@ -812,8 +1227,26 @@ AmclNode::convertMap( const nav_msgs::OccupancyGrid& map_msg )
 
 AmclNode::~AmclNode()
 {
+  if(update_thread_)
+  {
+    {
+      boost::mutex::scoped_lock l(scan_queue_mutex_);
+      update_thread_shutdown_ = true;
+    }
+    scan_queue_cond_.notify_one();
+    update_thread_->join();
+    delete update_thread_;
+  }
   delete dsrv_;
+  clearPendingScans();
   freeMapDependentMemory();
+  clearMapCache();
+  if(nav_trace::Tracer::isEnabled())
+  {
+    nav_trace::Tracer::disable();
+    if(!nav_trace::Tracer::exportChromeTrace(trace_file_))
+      ROS_WARN("Could not write the trace to %s", trace_file_.c_str());
+  }
   delete laser_scan_filter_;
   delete laser_scan_sub_;
   delete tfb_;
@@ -852,11 +1285,12 @@ AmclNode::uniformPoseGenerator(void* arg)
 {
   map_t* map = (map_t*)arg;
 #if NEW_UNIFORM_SAMPLING
-  unsigned int rand_index = drand48() * free_space_indices.size();
-  std::pair<int,int> free_point = free_space_indices[rand_index];
+  int i = map->size_x / 2, j = map->size_y / 2;
+  if(map_pick_free(map, drand48(), &i, &j) < 0)
+    ROS_WARN_THROTTLE(1.0, "The map has no free space to sample from");
   pf_vector_t p;
-  p.v[0] = MAP_WXGX(map, free_point.first);
-  p.v[1] = MAP_WYGY(map, free_point.second);
+  p.v[0] = MAP_WXGX(map, i);
+  p.v[1] = MAP_WYGY(map, j);
   p.v[2] = drand48() * 2 * M_PI - M_PI;
 #else
   double min_x, max_x, min_y, max_y;
@@ -911,14 +1345,208 @@ AmclNode::nomotionUpdateCallback(std_srvs::Empty::Request& req,
 	return true;
 }
 
+bool
+AmclNode::dumpTraceCallback(std_srvs::Empty::Request& req,
+                            std_srvs::Empty::Response& res)
+{
+  if(!nav_trace::Tracer::exportChromeTrace(trace_file_))
+  {
+    ROS_ERROR("Could not write the trace to %s", trace_file_.c_str());
+    return false;
+  }
+  ROS_INFO("Wrote the trace to %s", trace_file_.c_str());
+  return true;
+}
+
+void
+AmclNode::applyPendingScans()
+{
+  AMCLLaser::UpdateSensors(pf_, pending_scans_);
+
+  statistics_beams_ = 0;
+  for(unsigned int i = 0; i < pending_scans_.size(); i++)
+    statistics_beams_ += usedBeams((AMCLLaser*)pending_scans_[i]->sensor,
+                                   pending_scans_[i]->range_count);
+
+  if(laser_adaptive_beams_)
+  {
+    for(unsigned int i = 0; i < pending_scans_.size(); i++)
+    {
+      int candidates, selected;
+      double score_fraction;
+      ((AMCLLaser*)pending_scans_[i]->sensor)->GetBeamStats(candidates, selected, score_fraction);
+      ROS_DEBUG("Fused scan %d: selected %d of %d beams, carrying %.1f%% of the beam score",
+                i, selected, candidates, 100.0 * score_fraction);
+    }
+  }
+
+  clearPendingScans();
+}
+
+void
+AmclNode::clearPendingScans()
+{
+  for(unsigned int i = 0; i < pending_scans_.size(); i++)
+    delete pending_scans_[i];
+  pending_scans_.clear();
+}
+
+ros::WallTime
+AmclNode::startStages()
+{
+  if(!statistics_enabled_)
+    return ros::WallTime();
+  for(int i = 0; i < STAGE_COUNT; i++)
+    update_stage_time_[i] = -1.0;
+  return ros::WallTime::now();
+}
+
+void
+AmclNode::endStage(Stage stage, ros::WallTime& start)
+{
+  if(!statistics_enabled_)
+    return;
+  ros::WallTime now = ros::WallTime::now();
+  update_stage_time_[stage] = std::max(update_stage_time_[stage], 0.0) + (now - start).toSec();
+  start = now;
+}
+
+void
+AmclNode::recordStatistics()
+{
+  static const char* stage_names[STAGE_COUNT] =
+    {"tf", "action", "sensor", "resample", "cluster", "publish"};
+
+  if(!statistics_enabled_)
+    return;
+
+  for(int i = 0; i < STAGE_COUNT; i++)
+    if(update_stage_time_[i] >= 0.0)
+      stage_times_[i].push_back(update_stage_time_[i]);
+  statistics_updates_++;
+
+  ros::WallTime now = ros::WallTime::now();
+  if(now - statistics_last_time_ < statistics_period_)
+    return;
+
+  amcl::Statistics msg;
+  msg.header.stamp = ros::Time::now();
+  msg.updates = statistics_updates_;
+  msg.particles = pf_->sets[pf_->current_set].sample_count;
+  msg.beams = statistics_beams_;
+  msg.stages.resize(STAGE_COUNT);
+  for(int i = 0; i < STAGE_COUNT; i++)
+  {
+    std::vector<double>& times = stage_times_[i];
+    amcl::StageStatistics& stage = msg.stages[i];
+    stage.name = stage_names[i];
+    stage.count = times.size();
+    if(times.empty())
+      continue;
+
+    std::sort(times.begin(), times.end());
+    double sum = 0.0;
+    for(unsigned int k = 0; k < times.size(); k++)
+      sum += times[k];
+    stage.mean = sum / times.size();
+    stage.median = times[times.size() / 2];
+    stage.p90 = times[std::min(times.size() - 1, times.size() * 90 / 100)];
+    stage.p99 = times[std::min(times.size() - 1, times.size() * 99 / 100)];
+    stage.max = times.back();
+    times.clear();
+  }
+  statistics_pub_.publish(msg);
+
+  statistics_updates_ = 0;
+  statistics_last_time_ = now;
+}
+
+// Number of beams the model of the laser takes from a scan
+int
+AmclNode::usedBeams(AMCLLaser* laser, int range_count)
+{
+  if(laser_adaptive_beams_ && pf_->sets[pf_->current_set].converged &&
+     laser_model_type_ != LASER_MODEL_BEAM)
+  {
+    int candidates, selected;
+    double score_fraction;
+    laser->GetBeamStats(candidates, selected, score_fraction);
+    return selected;
+  }
+  return std::min(max_beams_, range_count);
+}
+
 void
 AmclNode::laserReceived(const sensor_msgs::LaserScanConstPtr& laser_scan)
 {
+  NAV_TRACE_SCOPE("AmclNode::laserReceived");
   last_laser_received_ts_ = ros::Time::now();
+  if(!use_update_thread_)
+  {
+    processLaserScan(laser_scan);
+    return;
+  }
+
+  // Hand the scan to the update thread.  When the filter falls behind, the
+  // oldest scans are dropped rather than delaying the newer ones.
+  {
+    boost::mutex::scoped_lock l(scan_queue_mutex_);
+    scan_queue_.push_back(laser_scan);
+    while((int)scan_queue_.size() > update_queue_size_)
+    {
+      ROS_DEBUG("Filter update is behind, dropping a scan of %s",
+                scan_queue_.front()->header.frame_id.c_str());
+      scan_queue_.pop_front();
+    }
+  }
+  scan_queue_cond_.notify_one();
+}
+
+void
+AmclNode::updateThread()
+{
+  NAV_TRACE_THREAD("amcl_update");
+  while(true)
+  {
+    sensor_msgs::LaserScanConstPtr laser_scan;
+    {
+      boost::mutex::scoped_lock l(scan_queue_mutex_);
+      while(scan_queue_.empty() && !update_thread_shutdown_)
+        scan_queue_cond_.wait(l);
+      if(update_thread_shutdown_)
+        return;
+      laser_scan = scan_queue_.front();
+      scan_queue_.pop_front();
+    }
+    processLaserScan(laser_scan);
+  }
+}
+
+void
+AmclNode::publishTransform(const ros::TimerEvent& event)
+{
+  if(!tf_broadcast_)
+    return;
+
+  boost::mutex::scoped_lock l(latest_tf_mutex_);
+  if(!latest_tf_valid_)
+    return;
+  ros::Time transform_expiration = (ros::Time::now() + transform_tolerance_);
+  tf::StampedTransform tmp_tf_stamped(latest_tf_.inverse(),
+                                      transform_expiration,
+                                      global_frame_id_, odom_frame_id_);
+  this->tfb_->sendTransform(tmp_tf_stamped);
+}
+
+void
+AmclNode::processLaserScan(const sensor_msgs::LaserScanConstPtr& laser_scan)
+{
+  NAV_TRACE_SCOPE("AmclNode::processLaserScan");
   if( map_ == NULL ) {
     return;
   }
   boost::recursive_mutex::scoped_lock lr(configuration_mutex_);
+  ros::WallTime stage_start = startStages();
   int laser_index = -1;
 
   // Do we have the base->base_laser Tx yet?
@@ -972,6 +1600,7 @@ AmclNode::laserReceived(const sensor_msgs::LaserScanConstPtr& laser_scan)
     ROS_ERROR("Couldn't determine robot's pose associated with laser scan");
     return;
   }
+  endStage(STAGE_TF, stage_start);
 
 
   pf_vector_t delta = pf_vector_zero();
@@ -1029,16 +1658,20 @@ AmclNode::laserReceived(const sensor_msgs::LaserScanConstPtr& laser_scan)
 
     // Use the action data to update the filter
     odom_->UpdateAction(pf_, (AMCLSensorData*)&odata);
+    endStage(STAGE_ACTION, stage_start);
 
     // Pose at last filter update
     //this->pf_odom_pose = pose;
   }
 
   bool resampled = false;
+  bool sensor_updated = false;
+  // Kept past the update for the refinement of the published pose, the
+  // ranges stay NULL unless the scan went into the filter on its own
+  AMCLLaserData ldata;
   // If the robot has moved, update the filter
   if(lasers_update_[laser_index])
   {
-    AMCLLaserData ldata;
     ldata.sensor = lasers_[laser_index];
     ldata.range_count = laser_scan->ranges.size();
 
@@ -1070,6 +1703,7 @@ AmclNode::laserReceived(const sensor_msgs::LaserScanConstPtr& laser_scan)
 
     // wrapping angle to [-pi .. pi]
     angle_increment = fmod(angle_increment + 5*M_PI, 2*M_PI) - M_PI;
+    endStage(STAGE_TF, stage_start);
 
     ROS_DEBUG("Laser %d angles in base frame: min: %.3f inc: %.3f", laser_index, angle_min, angle_increment);
 
@@ -1099,38 +1733,93 @@ AmclNode::laserReceived(const sensor_msgs::LaserScanConstPtr& laser_scan)
               (i * angle_increment);
     }
 
-    lasers_[laser_index]->UpdateSensor(pf_, (AMCLSensorData*)&ldata);
+    if(laser_fusion_window_ > 0.0)
+    {
+      // A second scan of the same laser, or one that comes too late, closes
+      // the scans waiting for the other lasers
+      bool pending = false;
+      for(unsigned int i = 0; i < pending_scans_.size(); i++)
+        pending = pending || pending_scans_[i]->sensor == lasers_[laser_index];
+      if(!pending_scans_.empty() &&
+         (pending || (laser_scan->header.stamp - pending_scans_stamp_).toSec() > laser_fusion_window_))
+      {
+        applyPendingScans();
+        sensor_updated = true;
+      }
+
+      // Hand the scan over to the queue
+      if(pending_scans_.empty())
+        pending_scans_stamp_ = laser_scan->header.stamp;
+      AMCLLaserData* pending_data = new AMCLLaserData;
+      pending_data->sensor = ldata.sensor;
+      pending_data->range_count = ldata.range_count;
+      pending_data->range_max = ldata.range_max;
+      pending_data->ranges = ldata.ranges;
+      ldata.ranges = NULL;
+      pending_scans_.push_back(pending_data);
+
+      // Once every laser has a scan they all go into the filter together
+      if(pending_scans_.size() == lasers_.size())
+      {
+        applyPendingScans();
+        sensor_updated = true;
+      }
+    }
+    else
+    {
+      lasers_[laser_index]->UpdateSensor(pf_, (AMCLSensorData*)&ldata);
+      statistics_beams_ = usedBeams(lasers_[laser_index], ldata.range_count);
+
+      if(laser_adaptive_beams_)
+      {
+        int candidates, selected;
+        double score_fraction;
+        lasers_[laser_index]->GetBeamStats(candidates, selected, score_fraction);
+        ROS_DEBUG("Laser %d: selected %d of %d beams, carrying %.1f%% of the beam score",
+                  laser_index, selected, candidates, 100.0 * score_fraction);
+      }
+      sensor_updated = true;
+    }
+
+    endStage(STAGE_SENSOR, stage_start);
 
     lasers_update_[laser_index] = false;
 
     pf_odom_pose_ = pose;
+  }
+  // Scans that waited for the other lasers for too long go in on their own
+  else if(!pending_scans_.empty() &&
+          (laser_scan->header.stamp - pending_scans_stamp_).toSec() > laser_fusion_window_)
+  {
+    applyPendingScans();
+    sensor_updated = true;
+    endStage(STAGE_SENSOR, stage_start);
+  }
 
+  if(sensor_updated)
+  {
     // Resample the particles
     if(!(++resample_count_ % resample_interval_))
     {
       pf_update_resample(pf_);
       resampled = true;
+      endStage(STAGE_RESAMPLE, stage_start);
+      if(statistics_enabled_)
+        update_stage_time_[STAGE_CLUSTER] = pf_->cluster_time;
     }
 
     pf_sample_set_t* set = pf_->sets + pf_->current_set;
     ROS_DEBUG("Num samples: %d\n", set->sample_count);
 
-    // Publish the resulting cloud
+    // Publish the resulting cloud, only if someone listens, and at most
+    // particlecloud_max_poses of the particles, evenly spaced through the set
     // TODO: set maximum rate for publishing
-    if (!m_force_update) {
+    if (!m_force_update && particlecloud_pub_.getNumSubscribers() > 0) {
       geometry_msgs::PoseArray cloud_msg;
-      cloud_msg.header.stamp = ros::Time::now();
-      cloud_msg.header.frame_id = global_frame_id_;
-      cloud_msg.poses.resize(set->sample_count);
-      for(int i=0;i<set->sample_count;i++)
-      {
-        tf::poseTFToMsg(tf::Pose(tf::createQuaternionFromYaw(set->samples[i].pose.v[2]),
-                                 tf::Vector3(set->samples[i].pose.v[0],
-                                           set->samples[i].pose.v[1], 0)),
-                        cloud_msg.poses[i]);
-      }
+      fillParticleCloud(cloud_msg);
       particlecloud_pub_.publish(cloud_msg);
     }
+    endStage(STAGE_PUBLISH, stage_start);
   }
 
   if(resampled || force_publication)
@@ -1163,6 +1852,43 @@ AmclNode::laserReceived(const sensor_msgs::LaserScanConstPtr& laser_scan)
       }
     }
 
+    if(resampled)
+    {
+      amcl::ParticleClusters& clusters_msg = clusters_msg_;
+      clusters_msg.header.stamp = laser_scan->header.stamp;
+      clusters_msg.header.frame_id = global_frame_id_;
+      clusters_msg.particles = pf_->sets[pf_->current_set].sample_count;
+      clusters_msg.clusters.resize(hyps.size());
+      for(unsigned int h = 0; h < hyps.size(); h++)
+      {
+        amcl::ParticleCluster& cluster = clusters_msg.clusters[h];
+        cluster.weight = hyps[h].weight;
+        cluster.x = hyps[h].pf_pose_mean.v[0];
+        cluster.y = hyps[h].pf_pose_mean.v[1];
+        cluster.yaw = hyps[h].pf_pose_mean.v[2];
+        for(int i = 0; i < 3; i++)
+          for(int j = 0; j < 3; j++)
+            cluster.covariance[3*i+j] = hyps[h].pf_pose_cov.m[i][j];
+      }
+      if(particle_clusters_pub_.getNumSubscribers() > 0)
+        particle_clusters_pub_.publish(clusters_msg);
+    }
+
+    // Correct the best hypothesis by matching the scan against the map, so
+    // the published pose does not depend on a dense particle set
+    if(max_weight > 0.0 && laser_refine_iterations_ > 0 && ldata.ranges != NULL)
+    {
+      pf_vector_t refined = hyps[max_weight_hyp].pf_pose_mean;
+      if(lasers_[laser_index]->RefinePose(&ldata, &refined, laser_refine_iterations_))
+      {
+        ROS_DEBUG("Refined pose by %.3f %.3f %.3f",
+                  refined.v[0] - hyps[max_weight_hyp].pf_pose_mean.v[0],
+                  refined.v[1] - hyps[max_weight_hyp].pf_pose_mean.v[1],
+                  angle_diff(refined.v[2], hyps[max_weight_hyp].pf_pose_mean.v[2]));
+        hyps[max_weight_hyp].pf_pose_mean = refined;
+      }
+    }
+
     if(max_weight > 0.0)
     {
       ROS_DEBUG("Max weight pose: %.3f %.3f %.3f",
@@ -1243,9 +1969,12 @@ AmclNode::laserReceived(const sensor_msgs::LaserScanConstPtr& laser_scan)
         return;
       }
 
-      latest_tf_ = tf::Transform(tf::Quaternion(odom_to_map.getRotation()),
-                                 tf::Point(odom_to_map.getOrigin()));
-      latest_tf_valid_ = true;
+      {
+        boost::mutex::scoped_lock l(latest_tf_mutex_);
+        latest_tf_ = tf::Transform(tf::Quaternion(odom_to_map.getRotation()),
+                                   tf::Point(odom_to_map.getOrigin()));
+        latest_tf_valid_ = true;
+      }
 
       if (tf_broadcast_ == true)
       {
@@ -1264,6 +1993,7 @@ AmclNode::laserReceived(const sensor_msgs::LaserScanConstPtr& laser_scan)
     {
       ROS_ERROR("No pose!");
     }
+    endStage(STAGE_PUBLISH, stage_start);
   }
   else if(latest_tf_valid_)
   {
@@ -1304,6 +2034,8 @@ AmclNode::laserReceived(const sensor_msgs::LaserScanConstPtr& laser_scan)
     }
   }
 
+  if(sensor_updated)
+    recordStatistics();
 }
 
 double
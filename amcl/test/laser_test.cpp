@@ -0,0 +1,115 @@
+/*
+ * Unit tests of the laser model
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdlib>
+
+#include "map/map.h"
+#include "sensors/amcl_laser.h"
+
+using namespace amcl;
+
+// A 6m x 5m room around the origin with a box and a pillar in it, so no
+// pose but the true one matches a scan
+static map_t *roomMap()
+{
+  map_t *map = map_alloc();
+  map->size_x = 120;
+  map->size_y = 100;
+  map->scale = 0.05;
+  map->origin_x = 0.0;
+  map->origin_y = 0.0;
+  map->cells = (map_cell_t*)malloc(sizeof(map_cell_t) * map->size_x * map->size_y);
+  for(int j = 0; j < map->size_y; j++)
+  {
+    for(int i = 0; i < map->size_x; i++)
+    {
+      bool wall = i < 2 || j < 2 || i >= map->size_x - 2 || j >= map->size_y - 2;
+      bool box = i >= 20 && i < 40 && j >= 65 && j < 80;
+      bool pillar = i >= 90 && i < 94 && j >= 20 && j < 24;
+      map->cells[MAP_INDEX(map, i, j)].occ_state = wall || box || pillar ? +1 : -1;
+    }
+  }
+  return map;
+}
+
+// The scan of a laser at the robot origin from pose, all around
+static void simulateScan(map_t *map, const pf_vector_t& pose, AMCLLaserData& data)
+{
+  data.range_count = 180;
+  data.range_max = 10.0;
+  data.ranges = new double[data.range_count][2];
+  for(int k = 0; k < data.range_count; k++)
+  {
+    double bearing = -M_PI + 2 * M_PI * k / data.range_count;
+    data.ranges[k][0] = map_calc_range(map, pose.v[0], pose.v[1], pose.v[2] + bearing, 8.0);
+    data.ranges[k][1] = bearing;
+  }
+}
+
+static pf_vector_t makePose(double x, double y, double yaw)
+{
+  pf_vector_t pose = pf_vector_zero();
+  pose.v[0] = x;
+  pose.v[1] = y;
+  pose.v[2] = yaw;
+  return pose;
+}
+
+TEST(AMCLLaser, refinePoseConvergesToTheTruePose)
+{
+  map_t *map = roomMap();
+  AMCLLaser laser(30, map);
+  pf_vector_t laser_pose = pf_vector_zero();
+  laser.SetLaserPose(laser_pose);
+  laser.SetModelLikelihoodField(0.95, 0.05, 0.2, 1.0);
+
+  pf_vector_t truth = makePose(0.3, -0.2, 0.1);
+  AMCLLaserData data;
+  data.sensor = &laser;
+  simulateScan(map, truth, data);
+
+  // offsets of a few cells and a few degrees in every direction
+  double offsets[][3] = {{0.1, 0.0, 0.0}, {0.0, -0.1, 0.0}, {0.0, 0.0, 0.06},
+                         {-0.08, 0.06, -0.05}, {0.12, 0.1, 0.04}};
+  for(unsigned int o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++)
+  {
+    pf_vector_t pose = makePose(truth.v[0] + offsets[o][0], truth.v[1] + offsets[o][1],
+                                truth.v[2] + offsets[o][2]);
+    SCOPED_TRACE(o);
+    ASSERT_TRUE(laser.RefinePose(&data, &pose, 30));
+    // within a cell, the resolution of the map and of the ranges
+    EXPECT_NEAR(truth.v[0], pose.v[0], map->scale);
+    EXPECT_NEAR(truth.v[1], pose.v[1], map->scale);
+    EXPECT_NEAR(truth.v[2], pose.v[2], 0.02);
+  }
+
+  map_free(map);
+}
+
+TEST(AMCLLaser, refinePoseNeedsADistanceField)
+{
+  map_t *map = roomMap();
+  AMCLLaser laser(30, map);
+  pf_vector_t laser_pose = pf_vector_zero();
+  laser.SetLaserPose(laser_pose);
+  laser.SetModelBeam(0.95, 0.1, 0.05, 0.05, 0.2, 0.1, 0.0, 0);
+
+  AMCLLaserData data;
+  data.sensor = &laser;
+  simulateScan(map, makePose(0.3, -0.2, 0.1), data);
+  pf_vector_t pose = makePose(0.4, -0.2, 0.1);
+  EXPECT_FALSE(laser.RefinePose(&data, &pose, 30));
+  EXPECT_EQ(0.4, pose.v[0]);
+
+  map_free(map);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
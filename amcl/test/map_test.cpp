@@ -0,0 +1,199 @@
+/*
+ * Unit tests of the map library
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "map/map.h"
+
+// A map of scattered obstacles with some unknown cells, the same for a seed
+static map_t *randomMap(int size_x, int size_y, double scale, long seed)
+{
+  map_t *map = map_alloc();
+  map->size_x = size_x;
+  map->size_y = size_y;
+  map->scale = scale;
+  map->origin_x = 0.0;
+  map->origin_y = 0.0;
+  map->cells = (map_cell_t*)malloc(sizeof(map_cell_t) * size_x * size_y);
+  srand48(seed);
+  for(int i = 0; i < size_x * size_y; i++)
+  {
+    double u = drand48();
+    map->cells[i].occ_state = u < 0.03 ? +1 : (u < 0.08 ? 0 : -1);
+  }
+  return map;
+}
+
+static void copyOccupancy(map_t *to, const map_t *from)
+{
+  memcpy(to->cells, from->cells, sizeof(map_cell_t) * from->size_x * from->size_y);
+}
+
+// Changes the occupancy within the inclusive bounds: clears an obstacle,
+// adds some and marks one free cell unknown
+static void editRegion(map_t *map, int i0, int j0, int i1, int j1)
+{
+  for(int j = j0; j <= j1; j++)
+    for(int i = i0; i <= i1; i++)
+      if(map->cells[MAP_INDEX(map, i, j)].occ_state == +1)
+      {
+        map->cells[MAP_INDEX(map, i, j)].occ_state = -1;
+        j = j1;
+        break;
+      }
+  map->cells[MAP_INDEX(map, i0, j0)].occ_state = +1;
+  map->cells[MAP_INDEX(map, i1, j1)].occ_state = +1;
+  map->cells[MAP_INDEX(map, (i0 + i1) / 2, j1)].occ_state = +1;
+  map->cells[MAP_INDEX(map, i1, (j0 + j1) / 2)].occ_state = 0;
+}
+
+static void expectSameField(map_t *full, map_t *patched)
+{
+  for(int j = 0; j < full->size_y; j++)
+    for(int i = 0; i < full->size_x; i++)
+      ASSERT_EQ(map_dist_at(full, map_dist_index(full, i, j)),
+                map_dist_at(patched, map_dist_index(patched, i, j)))
+          << "cell " << i << ", " << j;
+}
+
+TEST(MapCspace, regionUpdateMatchesFullUpdate)
+{
+  const double max_occ_dist = 0.5;
+  // regions inside the map, at its corners and over all of it
+  int regions[][4] = {{30, 20, 36, 27}, {0, 0, 4, 3}, {74, 55, 79, 59},
+                      {50, 0, 79, 8}, {0, 0, 79, 59}, {40, 30, 40, 30}};
+  for(unsigned int r = 0; r < sizeof(regions) / sizeof(regions[0]); r++)
+  {
+    int *b = regions[r];
+    map_t *patched = randomMap(80, 60, 0.05, 42 + r);
+    map_update_cspace(patched, max_occ_dist);
+    editRegion(patched, b[0], b[1], b[2], b[3]);
+    unsigned int version = patched->occ_dist_version;
+    map_update_cspace_region(patched, b[0], b[1], b[2], b[3]);
+    EXPECT_NE(version, patched->occ_dist_version);
+
+    map_t *full = randomMap(80, 60, 0.05, 0);
+    copyOccupancy(full, patched);
+    map_update_cspace(full, max_occ_dist);
+
+    SCOPED_TRACE(r);
+    expectSameField(full, patched);
+    map_free(full);
+    map_free(patched);
+  }
+}
+
+TEST(MapCspace, regionUpdateMatchesFullUpdateWhenTiled)
+{
+  const double max_occ_dist = 0.4;
+  map_t *patched = randomMap(100, 70, 0.05, 7);
+  ASSERT_EQ(0, map_set_tiles(patched, max_occ_dist, 16, 1000));
+  ASSERT_GE(map_update_tiles(patched, 0, 0, 99, 69), 0);
+  editRegion(patched, 20, 30, 45, 41);
+  map_update_cspace_region(patched, 20, 30, 45, 41);
+  ASSERT_GE(map_update_tiles(patched, 0, 0, 99, 69), 0);
+
+  map_t *full = randomMap(100, 70, 0.05, 0);
+  copyOccupancy(full, patched);
+  map_update_cspace(full, max_occ_dist);
+
+  expectSameField(full, patched);
+  map_free(full);
+  map_free(patched);
+}
+
+// A walled room with three blocks in it
+static map_t *roomMap()
+{
+  map_t *map = randomMap(120, 90, 0.05, 0);
+  int blocks[][4] = {{0, 0, 119, 1}, {0, 88, 119, 89}, {0, 0, 1, 89}, {118, 0, 119, 89},
+                     {30, 20, 45, 35}, {70, 50, 90, 60}, {60, 10, 63, 40}};
+  for(int i = 0; i < map->size_x * map->size_y; i++)
+    map->cells[i].occ_state = -1;
+  for(unsigned int b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++)
+    for(int j = blocks[b][1]; j <= blocks[b][3]; j++)
+      for(int i = blocks[b][0]; i <= blocks[b][2]; i++)
+        map->cells[MAP_INDEX(map, i, j)].occ_state = +1;
+  return map;
+}
+
+TEST(MapRange, tableMatchesRaysAlongAxesAndDiagonals)
+{
+  map_t *map = roomMap();
+  ASSERT_EQ(0, map_update_ranges(map, 8));
+  for(int j = 0; j < map->size_y; j++)
+    for(int i = 0; i < map->size_x; i++)
+    {
+      if(map->cells[MAP_INDEX(map, i, j)].occ_state > -1)
+        continue;
+      double ox = MAP_WXGX(map, i), oy = MAP_WYGY(map, j);
+      for(int k = 0; k < 8; k++)
+      {
+        double oa = 2 * M_PI * k / 8;
+        // the table rounds to whole cells
+        ASSERT_NEAR(map_calc_range(map, ox, oy, oa, 8.0), map_lookup_range(map, ox, oy, oa, 8.0), map->scale / 2)
+            << "cell " << i << ", " << j << " direction " << k;
+      }
+    }
+  map_free(map);
+}
+
+TEST(MapRange, tableMatchesRaysInBetween)
+{
+  // The table follows lines through whole cells, which may pass up to half a
+  // cell from the ray of map_calc_range(), so rays grazing a corner can hit
+  // something else.  All others agree to a cell or two.
+  const int angles = 72;
+  map_t *map = roomMap();
+  ASSERT_EQ(0, map_update_ranges(map, angles));
+  int n = 0, close = 0;
+  double error = 0;
+  for(int j = 0; j < map->size_y; j++)
+    for(int i = 0; i < map->size_x; i++)
+    {
+      if(map->cells[MAP_INDEX(map, i, j)].occ_state > -1)
+        continue;
+      double ox = MAP_WXGX(map, i), oy = MAP_WYGY(map, j);
+      for(int k = 0; k < angles; k++)
+      {
+        double oa = 2 * M_PI * k / angles;
+        double d = fabs(map_calc_range(map, ox, oy, oa, 8.0) - map_lookup_range(map, ox, oy, oa, 8.0));
+        n++;
+        close += d <= 2 * map->scale;
+        error += d;
+      }
+    }
+  EXPECT_GT(close, 0.95 * n);
+  EXPECT_LT(error / n, map->scale);
+  map_free(map);
+}
+
+TEST(MapRange, lookupRoundsToTheNearestDirection)
+{
+  map_t *map = roomMap();
+  ASSERT_EQ(0, map_update_ranges(map, 8));
+  double ox = MAP_WXGX(map, 20), oy = MAP_WYGY(map, 27);
+
+  EXPECT_EQ(map_lookup_range(map, ox, oy, 0.0, 8.0), map_lookup_range(map, ox, oy, 0.3, 8.0));
+  EXPECT_EQ(map_lookup_range(map, ox, oy, 0.0, 8.0), map_lookup_range(map, ox, oy, 2 * M_PI - 0.3, 8.0));
+  EXPECT_EQ(map_lookup_range(map, ox, oy, M_PI / 2, 8.0), map_lookup_range(map, ox, oy, -3 * M_PI / 2, 8.0));
+  EXPECT_EQ(0.2, map_lookup_range(map, ox, oy, M_PI, 0.2));
+  EXPECT_EQ(0.0, map_lookup_range(map, -1.0, oy, 0.0, 8.0));
+
+  // without a table the rays are cast
+  ASSERT_EQ(0, map_update_ranges(map, 0));
+  EXPECT_TRUE(map->ranges == NULL);
+  EXPECT_EQ(map_calc_range(map, ox, oy, 0.3, 8.0), map_lookup_range(map, ox, oy, 0.3, 8.0));
+  map_free(map);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
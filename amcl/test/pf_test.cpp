@@ -0,0 +1,267 @@
+/*
+ * Unit tests of the particle filter library
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+#include "pf/pf.h"
+#include "pf/pf_kdtree.h"
+#include "pf/pf_pdf.h"
+
+/* The known answers of Philox4x32-10 published with Random123, for a zero,
+ * an all ones and a pi digits counter and key. */
+TEST(PfPdf, philoxKnownAnswers)
+{
+  const uint32_t counters[3][4] = {
+    { 0x00000000u, 0x00000000u, 0x00000000u, 0x00000000u },
+    { 0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu },
+    { 0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u } };
+  const uint64_t seeds[3] = {
+    0x0000000000000000ull, 0xffffffffffffffffull, 0x299f31d0a4093822ull };
+  const uint32_t answers[3][4] = {
+    { 0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u },
+    { 0x408f276du, 0x41c83b0eu, 0xa20bc7c6u, 0x6d5451fdu },
+    { 0xd16cfe09u, 0x94fdccebu, 0x5001e420u, 0x24126ea1u } };
+
+  for(int t = 0; t < 3; t++)
+  {
+    uint32_t r[4];
+    pf_ran_philox(pf_ran_key(seeds[t]), counters[t], r);
+    for(int i = 0; i < 4; i++)
+      EXPECT_EQ(answers[t][i], r[i]) << "vector " << t << " word " << i;
+  }
+}
+
+/* The Gaussian samples of a counter only depend on the key and the counter,
+ * and are standard normal over many counters. */
+TEST(PfPdf, philoxGaussians)
+{
+  pf_ran_key_t key = pf_ran_key(42);
+  double z[4], again[4];
+  pf_ran_gaussian4(key, 7, 3, z);
+  pf_ran_gaussian4(key, 7, 3, again);
+  for(int i = 0; i < 4; i++)
+    EXPECT_EQ(z[i], again[i]);
+  pf_ran_gaussian4(pf_ran_key(43), 7, 3, again);
+  EXPECT_NE(z[0], again[0]);
+
+  const int n = 20000;
+  double sum = 0.0, sum_sq = 0.0;
+  for(int c = 0; c < n; c++)
+  {
+    pf_ran_gaussian4(key, c, 0, z);
+    for(int i = 0; i < 4; i++)
+    {
+      sum += z[i];
+      sum_sq += z[i] * z[i];
+    }
+  }
+  double mean = sum / (4 * n);
+  EXPECT_NEAR(0.0, mean, 0.02);
+  EXPECT_NEAR(1.0, sum_sq / (4 * n) - mean * mean, 0.03);
+}
+
+/* Resamples a set whose sample i sits at x = i with the given weights and
+ * counts how often every sample was drawn. */
+static std::vector<int> resampleCounts(pf_resample_model_t model, const std::vector<double> &weights, long seed)
+{
+  int n = weights.size();
+  pf_t *pf = pf_alloc(n, n, 0.001, 0.1, NULL, NULL);
+  pf->resample_model = model;
+  pf_sample_set_t *set = pf->sets + pf->current_set;
+  for(int i = 0; i < n; i++)
+  {
+    set->x[i] = i;
+    set->y[i] = 0.0;
+    set->theta[i] = 0.0;
+    set->weight[i] = weights[i];
+  }
+
+  srand48(seed);
+  pf_update_resample(pf);
+
+  std::vector<int> counts(n, 0);
+  set = pf->sets + pf->current_set;
+  for(int i = 0; i < set->sample_count; i++)
+    counts[(int)lround(set->x[i])]++;
+  pf_free(pf);
+  return counts;
+}
+
+/* Every sample is drawn its expected number of times, rounded either way,
+ * and samples without weight never. */
+TEST(PfResample, systematicCountsFollowTheWeights)
+{
+  const int n = 1000;
+  std::vector<double> weights(n);
+  double total = 0.0;
+  srand48(5);
+  for(int i = 0; i < n; i++)
+  {
+    // a few heavy samples, many light ones and some without weight
+    double u = drand48();
+    weights[i] = u < 0.1 ? 0.0 : (u < 0.15 ? 20.0 * u : u);
+    total += weights[i];
+  }
+  for(int i = 0; i < n; i++)
+    weights[i] /= total;
+
+  for(long seed = 0; seed < 5; seed++)
+  {
+    std::vector<int> counts = resampleCounts(PF_RESAMPLE_SYSTEMATIC, weights, seed);
+    int drawn = 0;
+    for(int i = 0; i < n; i++)
+    {
+      double expected = n * weights[i];
+      EXPECT_GE(counts[i], (int)floor(expected - 1e-9)) << "sample " << i << " seed " << seed;
+      EXPECT_LE(counts[i], (int)ceil(expected + 1e-9)) << "sample " << i << " seed " << seed;
+      drawn += counts[i];
+    }
+    EXPECT_EQ(n, drawn);
+  }
+}
+
+/* The weights need not be normalized, and a single heavy sample takes all
+ * draws. */
+TEST(PfResample, systematicDrawsADominantSampleOnly)
+{
+  std::vector<double> weights(200, 0.0);
+  weights[17] = 3.0;
+  std::vector<int> counts = resampleCounts(PF_RESAMPLE_SYSTEMATIC, weights, 1);
+  EXPECT_EQ(200, counts[17]);
+
+  weights.assign(200, 0.5);
+  counts = resampleCounts(PF_RESAMPLE_SYSTEMATIC, weights, 2);
+  for(int i = 0; i < 200; i++)
+    EXPECT_EQ(1, counts[i]) << "sample " << i;
+}
+
+typedef std::vector<int> Key;
+
+static Key cellKey(pf_kdtree_t *tree, pf_vector_t pose)
+{
+  Key key(3);
+  for(int i = 0; i < 3; i++)
+    key[i] = (int)floor(pose.v[i] / tree->size[i]);
+  return key;
+}
+
+/* The recursive flood fill the histogram used to cluster with, over the
+ * 26-neighbourhood of every occupied cell. */
+static void floodFill(std::map<Key, int> &labels, const Key &key, int label)
+{
+  for(int i = 0; i < 3 * 3 * 3; i++)
+  {
+    Key nkey(3);
+    nkey[0] = key[0] + (i / 9) - 1;
+    nkey[1] = key[1] + ((i % 9) / 3) - 1;
+    nkey[2] = key[2] + ((i % 9) % 3) - 1;
+    std::map<Key, int>::iterator it = labels.find(nkey);
+    if(it == labels.end() || it->second >= 0)
+      continue;
+    it->second = label;
+    floodFill(labels, nkey, label);
+  }
+}
+
+/* Samples in blobs of various sizes, some of them touching, and a few
+ * scattered ones, on both sides of zero. */
+static std::vector<pf_vector_t> blobSamples(long seed)
+{
+  std::vector<pf_vector_t> poses;
+  srand48(seed);
+  for(int b = 0; b < 12; b++)
+  {
+    pf_vector_t center = pf_vector_zero();
+    center.v[0] = 20 * drand48() - 10;
+    center.v[1] = 20 * drand48() - 10;
+    center.v[2] = 2 * M_PI * drand48() - M_PI;
+    double radius = 2 * drand48();
+    for(int i = 0; i < 200; i++)
+    {
+      pf_vector_t pose = center;
+      pose.v[0] += radius * (2 * drand48() - 1);
+      pose.v[1] += radius * (2 * drand48() - 1);
+      pose.v[2] += radius * (2 * drand48() - 1);
+      poses.push_back(pose);
+    }
+  }
+  for(int i = 0; i < 300; i++)
+  {
+    pf_vector_t pose = pf_vector_zero();
+    pose.v[0] = 30 * drand48() - 15;
+    pose.v[1] = 30 * drand48() - 15;
+    pose.v[2] = 2 * M_PI * drand48() - M_PI;
+    poses.push_back(pose);
+  }
+  return poses;
+}
+
+/* The clusters of the hashed histogram partition the cells exactly as the
+ * flood fill did, with labels numbered from zero, and the values of a cell
+ * add up. */
+TEST(PfKdtree, clustersMatchTheFloodFill)
+{
+  for(long seed = 0; seed < 10; seed++)
+  {
+    std::vector<pf_vector_t> poses = blobSamples(seed);
+    pf_kdtree_t *tree = pf_kdtree_alloc(3 * poses.size());
+    std::map<Key, int> labels;
+    std::map<Key, double> values;
+    for(unsigned int i = 0; i < poses.size(); i++)
+    {
+      pf_kdtree_insert(tree, poses[i], 1.0 + i % 3);
+      labels[cellKey(tree, poses[i])] = -1;
+      values[cellKey(tree, poses[i])] += 1.0 + i % 3;
+    }
+    pf_kdtree_cluster(tree);
+    ASSERT_EQ((int)labels.size(), tree->leaf_count);
+
+    int cluster_count = 0;
+    for(std::map<Key, int>::iterator it = labels.begin(); it != labels.end(); ++it)
+      if(it->second < 0)
+      {
+        it->second = cluster_count;
+        floodFill(labels, it->first, cluster_count++);
+      }
+
+    // the labels may be numbered differently, but must map one to one
+    std::vector<int> to_reference(cluster_count, -1), from_reference(cluster_count, -1);
+    for(unsigned int i = 0; i < poses.size(); i++)
+    {
+      Key key = cellKey(tree, poses[i]);
+      int label = pf_kdtree_get_cluster(tree, poses[i]);
+      int reference = labels[key];
+      ASSERT_GE(label, 0);
+      ASSERT_LT(label, cluster_count);
+      if(to_reference[label] < 0 && from_reference[reference] < 0)
+      {
+        to_reference[label] = reference;
+        from_reference[reference] = label;
+      }
+      EXPECT_EQ(reference, to_reference[label]) << "sample " << i << " seed " << seed;
+      EXPECT_EQ(label, from_reference[reference]) << "sample " << i << " seed " << seed;
+      EXPECT_DOUBLE_EQ(values[key], pf_kdtree_get_prob(tree, poses[i]));
+    }
+    for(int c = 0; c < cluster_count; c++)
+      EXPECT_GE(to_reference[c], 0) << "cluster " << c << " seed " << seed;
+
+    // a cleared tree starts over
+    pf_kdtree_clear(tree);
+    EXPECT_EQ(0, tree->leaf_count);
+    EXPECT_EQ(-1, pf_kdtree_get_cluster(tree, poses[0]));
+    EXPECT_EQ(0.0, pf_kdtree_get_prob(tree, poses[0]));
+    pf_kdtree_free(tree);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,126 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author: TKruse
+ *********************************************************************/
+
+#ifndef COARSE_TO_FINE_TRAJECTORY_GENERATOR_H_
+#define COARSE_TO_FINE_TRAJECTORY_GENERATOR_H_
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include <base_local_planner/simple_trajectory_generator.h>
+
+namespace base_local_planner {
+
+/**
+ * generates the samples of a SimpleTrajectoryGenerator as a coarse grid, then
+ * refines around the best scored samples in finer grids.
+ *
+ * Each refinement level takes the top_k lowest cost samples of the previous
+ * level and samples a grid of refine_samples per dimension spanning one step
+ * of the previous grid around each of them, clipped to the dynamic window.
+ * The costs come back through reportCost, so a planner gets the finer
+ * samples after it scored the coarser ones.
+ */
+class CoarseToFineTrajectoryGenerator: public base_local_planner::SimpleTrajectoryGenerator {
+public:
+
+  CoarseToFineTrajectoryGenerator();
+
+  ~CoarseToFineTrajectoryGenerator() {}
+
+  /**
+   * @brief Same as SimpleTrajectoryGenerator::initialise, restarting at the coarse grid
+   */
+  void initialise(
+      const Eigen::Vector3f& pos,
+      const Eigen::Vector3f& vel,
+      const Eigen::Vector3f& goal,
+      base_local_planner::LocalPlannerLimits* limits,
+      const Eigen::Vector3f& vsamples,
+      const std::vector<Eigen::Vector3f>& additional_samples,
+      bool discretize_by_time = false);
+
+  /**
+   * @brief Same as SimpleTrajectoryGenerator::initialise, restarting at the coarse grid
+   */
+  void initialise(
+      const Eigen::Vector3f& pos,
+      const Eigen::Vector3f& vel,
+      const Eigen::Vector3f& goal,
+      base_local_planner::LocalPlannerLimits* limits,
+      const Eigen::Vector3f& vsamples,
+      bool discretize_by_time = false);
+
+  /**
+   * @brief Configure the refinement
+   * @param levels The number of refinement levels after the coarse grid, 0 disables refinement
+   * @param top_k The number of best samples of a level to refine around
+   * @param refine_samples The number of samples per dimension around each of them
+   */
+  void setCoarseToFine(int levels, int top_k, int refine_samples);
+
+  /**
+   * Whether this generator can create more trajectories, refining once the current level is scored
+   */
+  bool hasMoreTrajectories();
+
+  bool nextTrajectory(Trajectory &traj);
+
+  void reportCost(const Trajectory& traj, double cost);
+
+private:
+
+  /**
+   * Append the samples of the next level around the best candidates of the current one
+   * @return True if samples were added
+   */
+  bool refine();
+
+  int levels_, top_k_, fine_samples_;
+
+  int level_;
+  // sample step of the grid of the current level
+  Eigen::Vector3f step_;
+  // samples returned by nextTrajectory whose cost was not reported yet
+  std::deque<Eigen::Vector3f> pending_;
+  // valid samples of the current level with their costs
+  std::vector<std::pair<double, Eigen::Vector3f> > candidates_;
+};
+
+} /* namespace base_local_planner */
+#endif /* COARSE_TO_FINE_TRAJECTORY_GENERATOR_H_ */
@@ -40,6 +40,7 @@
 #include <base_local_planner/world_model.h>
 // For obstacle data access
 #include <costmap_2d/costmap_2d.h>
+#include <costmap_2d/cost_values.h>
 
 namespace base_local_planner {
   /**
@@ -73,7 +74,72 @@ namespace base_local_planner {
       virtual double footprintCost(const geometry_msgs::Point& position, const std::vector<geometry_msgs::Point>& footprint,
           double inscribed_radius, double circumscribed_radius);
 
+      /**
+       * @brief  Checks the footprint at a pose, using the precomputed footprint masks when they are enabled
+       * @param  x The x position of the robot in world coordinates
+       * @param  y The y position of the robot in world coordinates
+       * @param  theta The orientation of the robot
+       * @param  footprint_spec The specification of the footprint of the robot in robot coordinates
+       * @param  inscribed_radius The radius of the inscribed circle of the robot
+       * @param  circumscribed_radius The radius of the circumscribed circle of the robot
+       * @return Positive if all the points lie outside the footprint, negative otherwise
+       */
+      virtual double footprintCost(double x, double y, double theta, const std::vector<geometry_msgs::Point>& footprint_spec,
+          double inscribed_radius = 0.0, double circumscribed_radius = 0.0);
+
+      /**
+       * @brief  Enables the footprint mask cache. For each of the given number of headings the cells
+       * under the footprint outline are computed once, relative to the robot cell, so that a footprint
+       * check becomes a lookup of cell offsets. Each mask is the union of the outlines over sampled
+       * sub-cell positions of the robot and headings within its bin, so it errs on the conservative side
+       * of the exact rasterization.
+       * @param headings The number of discretized headings, 0 disables the cache
+       */
+      void setFootprintMasks(unsigned int headings);
+
+      /**
+       * @brief  Enables deciding footprint checks from the inflated cost of the robot cell. A cost of at
+       * least inscribed_cost is a collision. A cost below circumscribed_cost is legal and returned as the
+       * footprint cost, so only pass one if every lethal cell is inflated and no cell is unknown, as the
+       * inflation layer does with its no_unknown_space parameter. Everything else goes through the
+       * footprint check.
+       * @param inscribed_cost The lowest cost of cells within the inscribed radius of an obstacle, 0 to disable
+       * @param circumscribed_cost The cost below which cells are beyond the circumscribed radius of all obstacles, 0 to disable
+       */
+      void setInflationThresholds(unsigned char inscribed_cost, unsigned char circumscribed_cost);
+
+      /**
+       * @brief  Recomputes the footprint masks if they are enabled and the footprint or the costmap geometry
+       * changed. The checks call this themselves; call it up front to check footprints from several threads.
+       * @param footprint_spec The specification of the footprint of the robot in robot coordinates
+       */
+      void updateFootprintMasks(const std::vector<geometry_msgs::Point>& footprint_spec);
+
+      /**
+       * @brief  Checks the ring the footprint outline sweeps over a full turn in place, in one pass over
+       * cells computed once per footprint. The ring is padded to cover the rasterized outline at any
+       * heading and sub-cell position, so a legal result means every heading is legal for footprintCost.
+       * @param  x The x position of the robot in world coordinates
+       * @param  y The y position of the robot in world coordinates
+       * @param  footprint_spec The specification of the footprint of the robot in robot coordinates
+       * @param  margin How far the robot may move away from (x, y) during the turn, in meters; the ring is
+       * widened by it, rounded up to whole cells
+       * @return The highest cost in the ring, negative if it holds an obstacle or unknown space, leaves
+       * the map, or the footprint is not a polygon; the headings then have to be checked one by one
+       */
+      double sweptFootprintCost(double x, double y, const std::vector<geometry_msgs::Point>& footprint_spec,
+          double margin = 0.0);
+
     private:
+      /**
+       * @brief  Tries to decide a footprint check from the cost of the robot cell, see setInflationThresholds()
+       * @param cell_x The x position of the robot in cell coordinates
+       * @param cell_y The y position of the robot in cell coordinates
+       * @param cost Set to the footprint cost if the check is decided
+       * @return True if the check is decided, false if the footprint has to be checked
+       */
+      bool inflationCost(unsigned int cell_x, unsigned int cell_y, double& cost) const;
+
       /**
        * @brief  Rasterizes a line in the costmap grid and checks for collisions
        * @param x0 The x position of the first cell in grid coordinates
@@ -90,10 +156,40 @@ namespace base_local_planner {
        * @param y The y position of the point in cell coordinates 
        * @return A positive cost for a legal point... negative otherwise
        */
-      double pointCost(int x, int y);
+      inline double pointCost(int x, int y){
+        unsigned char cost = costmap_.getCost(x, y);
+        //if the cell is in an obstacle the path is invalid
+        if(cost == costmap_2d::LETHAL_OBSTACLE || cost == costmap_2d::NO_INFORMATION){
+          return -1;
+        }
+
+        return cost;
+      }
 
       const costmap_2d::Costmap2D& costmap_; ///< @brief Allows access of costmap obstacle information
 
+      /**
+       * @brief The cells under the footprint outline for one heading bin, relative to the robot cell
+       */
+      struct FootprintMask {
+        std::vector<int> offsets; ///< @brief Index offsets into the costmap array
+        int min_dx, max_dx, min_dy, max_dy; ///< @brief Extent of the mask in cells
+      };
+
+      unsigned int mask_headings_; ///< @brief Number of heading bins, 0 if the masks are disabled
+      std::vector<FootprintMask> masks_;
+      std::vector<geometry_msgs::Point> mask_footprint_; ///< @brief The footprint the masks were computed for
+      double mask_resolution_;
+      unsigned int mask_size_x_;
+
+      FootprintMask ring_; ///< @brief The cells swept by the outline over a full turn
+      std::vector<geometry_msgs::Point> ring_footprint_; ///< @brief The footprint the ring was computed for
+      double ring_resolution_;
+      unsigned int ring_size_x_;
+      int ring_margin_; ///< @brief The margin the ring was widened by, in cells
+
+      unsigned char inscribed_cost_, circumscribed_cost_; ///< @brief Thresholds on the robot cell cost, 0 if disabled
+
   };
 };
 #endif
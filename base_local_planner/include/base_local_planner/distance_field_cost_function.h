@@ -0,0 +1,106 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#ifndef DISTANCE_FIELD_COST_FUNCTION_H_
+#define DISTANCE_FIELD_COST_FUNCTION_H_
+
+#include <vector>
+
+#include <base_local_planner/trajectory_cost_function.h>
+
+#include <costmap_2d/costmap_2d.h>
+#include <geometry_msgs/Point.h>
+
+namespace base_local_planner {
+
+/**
+ * class DistanceFieldCostFunction
+ * @brief Alternative to the ObstacleCostFunction that checks a few circles
+ * covering the footprint against a distance field of the costmap.
+ *
+ * prepare() computes the Euclidean distance of every cell to the nearest
+ * lethal or unknown cell. A trajectory is rejected if any circle overlaps
+ * an obstacle, otherwise each pose costs more the closer its circles get
+ * to obstacles, up to max_clearance.
+ */
+class DistanceFieldCostFunction : public TrajectoryCostFunction {
+
+public:
+  DistanceFieldCostFunction(costmap_2d::Costmap2D* costmap);
+  ~DistanceFieldCostFunction() {}
+
+  bool prepare();
+  double scoreTrajectory(Trajectory &traj);
+
+  void setSumScores(bool score_sums){ sum_scores_=score_sums; }
+
+  // clearance in meters beyond which a pose costs nothing
+  void setMaxClearance(double max_clearance) { max_clearance_ = max_clearance; }
+  // number of circles along the longer side of the footprint
+  void setCircles(unsigned int num_circles);
+  void setFootprint(const std::vector<geometry_msgs::Point>& footprint_spec);
+
+  /**
+   * @brief Distance in meters from the center of a cell to the center of the nearest obstacle cell
+   */
+  double getDistance(unsigned int cell_x, unsigned int cell_y) const {
+    return distances_[cell_y * size_x_ + cell_x];
+  }
+
+  // helper functions, made static for easy unit testing
+  static void coverFootprint(const std::vector<geometry_msgs::Point>& footprint_spec, unsigned int num_circles,
+      std::vector<geometry_msgs::Point>& centers, double& radius);
+  static void distanceTransform(const double* f, double* d, int n, int* v, double* z);
+
+private:
+  costmap_2d::Costmap2D* costmap_;
+  std::vector<geometry_msgs::Point> footprint_spec_;
+  unsigned int num_circles_;
+  std::vector<geometry_msgs::Point> circle_centers_;
+  double circle_radius_;
+  double max_clearance_;
+  bool sum_scores_;
+
+  unsigned int size_x_, size_y_;
+  double resolution_;
+  std::vector<float> distances_;
+  // scratch storage of the distance transform
+  std::vector<double> squared_, f_, d_, z_;
+  std::vector<int> v_;
+};
+
+} /* namespace base_local_planner */
+#endif /* DISTANCE_FIELD_COST_FUNCTION_H_ */
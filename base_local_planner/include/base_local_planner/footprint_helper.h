@@ -66,6 +66,17 @@ public:
       const costmap_2d::Costmap2D&,
       bool fill);
 
+  /**
+   * @brief  Same as above, filling a vector of the caller so its memory can be reused from cycle to cycle
+   * @param  footprint_cells Will be cleared and filled with the cells of the footprint
+   */
+  void getFootprintCells(
+      const Eigen::Vector3f& pos,
+      const std::vector<geometry_msgs::Point>& footprint_spec,
+      const costmap_2d::Costmap2D&,
+      bool fill,
+      std::vector<base_local_planner::Position2DInt>& footprint_cells);
+
   /**
    * @brief  Use Bresenham's algorithm to trace a line between two points in a grid
    * @param  x0 The x coordinate of the first point
@@ -89,6 +89,14 @@ namespace base_local_planner {
    */
   void prunePlan(const tf::Stamped<tf::Pose>& global_pose, std::vector<geometry_msgs::PoseStamped>& plan, std::vector<geometry_msgs::PoseStamped>& global_plan);
 
+  /**
+   * @brief  Trim off parts of the plan that are far enough behind the robot, without copying the global plan
+   * @param global_pose The pose of the robot in the global frame
+   * @param plan The plan to be pruned, as transformed from the global plan starting at plan_start
+   * @param plan_start The index of the first pose of the global plan still ahead, advanced past the pruned poses
+   */
+  void prunePlan(const tf::Stamped<tf::Pose>& global_pose, std::vector<geometry_msgs::PoseStamped>& plan, unsigned int& plan_start);
+
   /**
    * @brief Filters the plan from the lookahead distance up to the end
    * @param plan The plan to be filtered up until lookahead
@@ -114,6 +122,19 @@ namespace base_local_planner {
       const std::string& global_frame,
       std::vector<geometry_msgs::PoseStamped>& transformed_plan);
 
+  /**
+   * @brief  Same as above, but ignores the poses of the global plan before plan_start
+   *
+   * The poses already in transformed_plan are overwritten, so passing the same vector every cycle reuses its storage.
+   */
+  bool transformGlobalPlan(const tf::TransformListener& tf,
+      const std::vector<geometry_msgs::PoseStamped>& global_plan,
+      unsigned int plan_start,
+      const tf::Stamped<tf::Pose>& global_robot_pose,
+      const costmap_2d::Costmap2D& costmap,
+      const std::string& global_frame,
+      std::vector<geometry_msgs::PoseStamped>& transformed_plan);
+
   /**
      * @brief  Returns last pose in plan
      * @param tf A reference to a transform listener
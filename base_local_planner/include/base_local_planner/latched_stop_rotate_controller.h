@@ -16,12 +16,19 @@
 
 #include <base_local_planner/local_planner_util.h>
 #include <base_local_planner/odometry_helper_ros.h>
+#include <base_local_planner/costmap_model.h>
 
 namespace base_local_planner {
 
 class LatchedStopRotateController {
 public:
   LatchedStopRotateController(const std::string& name = "");
+
+  /**
+   * @brief Construct without reading the parameters of a node
+   * @param latch_xy_goal_tolerance Whether to keep turning in place once the goal position has been reached
+   */
+  explicit LatchedStopRotateController(bool latch_xy_goal_tolerance);
   virtual ~LatchedStopRotateController();
 
   bool isPositionReached(LocalPlannerUtil* planner_util,
@@ -35,6 +42,19 @@ public:
     xy_tolerance_latch_ = false;
   }
 
+  /**
+   * @brief Lets commands that only turn the robot in place be cleared by the ring its footprint sweeps over a
+   * full turn, see CostmapModel::sweptFootprintCost(), instead of simulating them with obstacle_check. The
+   * ring is widened by how far the robot can drift while it stops translating. Commands the ring does not
+   * clear, and commands that translate, are still checked with obstacle_check.
+   * @param model The model to look the ring up in, NULL to always use obstacle_check
+   * @param footprint_spec The footprint of the robot in robot coordinates
+   */
+  void setSweptCheck(CostmapModel* model, const std::vector<geometry_msgs::Point>& footprint_spec) {
+    swept_model_ = model;
+    swept_footprint_ = footprint_spec;
+  }
+
   /**
    * @brief Stop the robot taking into account acceleration limits
    * @param  global_pose The pose of the robot in the global frame
@@ -85,6 +105,17 @@ private:
     return x < 0.0 ? -1.0 : 1.0;
   }
 
+  /**
+   * @brief Whether the ring of setSweptCheck() clears a command, false if it has to be simulated
+   */
+  bool sweptCheck(const tf::Stamped<tf::Pose>& global_pose,
+      const tf::Stamped<tf::Pose>& robot_vel,
+      Eigen::Vector3f acc_lim,
+      double vx, double vy);
+
+  CostmapModel* swept_model_;
+  std::vector<geometry_msgs::Point> swept_footprint_;
+
 
   // whether to latch at all, and whether in this turn we have already been in goal area
   bool latch_xy_goal_tolerance_, xy_tolerance_latch_;
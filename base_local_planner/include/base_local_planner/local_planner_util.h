@@ -66,13 +66,19 @@ private:
   tf::TransformListener* tf_;
 
 
-  std::vector<geometry_msgs::PoseStamped> global_plan_;
-
+  // shared with move_base, never changed
+  nav_core::PlanConstPtr global_plan_;
+  // the version move_base gave global_plan_, 0 for copied plans
+  unsigned int plan_version_;
+  // the index of the first pose of global_plan_ not pruned yet
+  unsigned int plan_start_;
 
   boost::mutex limits_configuration_mutex_;
   bool setup_;
   LocalPlannerLimits default_limits_;
   LocalPlannerLimits limits_;
+  // caps on max_trans_vel and max_rot_vel over the configured limits, negative if not set
+  double speed_limit_trans_, speed_limit_rot_;
   bool initialized_;
 
 public:
@@ -82,7 +88,8 @@ public:
    */
   void reconfigureCB(LocalPlannerLimits &config, bool restore_defaults);
 
-  LocalPlannerUtil() : initialized_(false) {}
+  LocalPlannerUtil() : global_plan_(new std::vector<geometry_msgs::PoseStamped>()), plan_version_(0), plan_start_(0),
+    setup_(false), speed_limit_trans_(-1.0), speed_limit_rot_(-1.0), initialized_(false) {}
 
   ~LocalPlannerUtil() {
   }
@@ -95,12 +102,28 @@ public:
 
   bool setPlan(const std::vector<geometry_msgs::PoseStamped>& orig_global_plan);
 
+  /**
+   * @brief Keep a reference to a shared plan, the progress along it is kept if the version did not change
+   */
+  bool setPlan(const nav_core::PlanConstPtr& plan, unsigned int version);
+
   bool getLocalPlan(tf::Stamped<tf::Pose>& global_pose, std::vector<geometry_msgs::PoseStamped>& transformed_plan);
 
   costmap_2d::Costmap2D* getCostmap();
 
+  /**
+   * @brief The configured limits with the speed caps applied
+   */
   LocalPlannerLimits getCurrentLimits();
 
+  /**
+   * @brief Cap the translational and rotational speed, both at once for the next getCurrentLimits(),
+   * without touching the configured limits, so reconfiguring keeps the caps and lifting them restores the configuration
+   * @param max_trans_vel The cap on max_trans_vel, negative lifts it
+   * @param max_rot_vel The cap on max_rot_vel, negative lifts it
+   */
+  void setSpeedLimit(double max_trans_vel, double max_rot_vel);
+
   std::string getGlobalFrame(){ return global_frame_; }
 };
 
@@ -54,10 +54,10 @@ namespace base_local_planner {
        */
       MapCell(const MapCell& mc);
 
-      unsigned int cx, cy; ///< @brief Cell index in the grid map
-
       double target_dist; ///< @brief Distance to planner's path
 
+      unsigned short cx, cy; ///< @brief Cell index in the grid map, narrow to keep the cell at 16 bytes
+
       bool target_mark; ///< @brief Marks for computing path/goal distances
 
       bool within_robot; ///< @brief Mark for cells within the robot footprint
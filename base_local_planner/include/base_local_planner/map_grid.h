@@ -107,9 +107,23 @@ namespace base_local_planner{
 
       /**
        * @brief reset path distance fields for all cells
+       *
+       * In incremental mode only the within_robot marks are cleared, the
+       * distances are kept to be updated by the next setTargetCells or setLocalGoal.
        */
       void resetPathDist();
 
+      /**
+       * @brief  Enable or disable updating the distances from the previous field
+       *
+       * When enabled, setTargetCells and setLocalGoal shift the previous field
+       * along with the costmap window and only recompute the cells affected by
+       * changed target cells, obstacles and cells entering the window. They fall
+       * back to a full propagation when the changes are too large.
+       * @param incremental Whether to update the distances incrementally
+       */
+      void setIncremental(bool incremental);
+
       /**
        * @brief  check if we need to resize
        * @param size_x The desired width
@@ -192,8 +206,62 @@ namespace base_local_planner{
 
     private:
 
+      /**
+       * @brief  Set the target distances from the given seed cells, incrementally if possible
+       * @param seeds The indices of the cells with distance 0
+       */
+      void propagateTargetDistance(const std::vector<unsigned int>& seeds, const costmap_2d::Costmap2D& costmap);
+
+      /**
+       * @brief  Update the previous field for the given seed cells and cell states
+       * @return False if the field has to be recomputed from scratch
+       */
+      bool updateTargetDistance(const std::vector<unsigned int>& seeds, const costmap_2d::Costmap2D& costmap);
+
+      /**
+       * @brief  Shift the previous field in place by whole cells, marking the cells entering the grid
+       */
+      void shiftField(int dx, int dy);
+
+      /**
+       * @brief  Reset the target distances without touching the within_robot marks
+       */
+      void clearField();
+
+      /**
+       * @brief  Drop the distance of a cell and queue its dependent neighbors for a support check
+       */
+      void invalidateCell(unsigned int index);
+
+      /**
+       * @brief  Collect the indices of the 4-neighbors of a cell
+       * @return The number of neighbors inside the grid
+       */
+      inline unsigned int getNeighbors(unsigned int index, unsigned int* neighbors) const;
+
+      /**
+       * @brief  Whether a cell propagates its distance to its neighbors under the new cell states
+       */
+      inline bool isExpanded(unsigned int index) const;
+
+      /**
+       * @brief  Queue a cell in the bucket of the given distance
+       */
+      inline void pushBucket(unsigned int index, double dist);
+
       std::vector<MapCell> map_; ///< @brief Storage for the MapCells
 
+      bool incremental_; ///< @brief Whether distances are updated from the previous field
+      bool field_valid_; ///< @brief Whether the stored field matches the cell states of the last propagation
+      double field_origin_x_, field_origin_y_, field_resolution_; ///< @brief The costmap window of the stored field
+      std::vector<unsigned char> cell_state_; ///< @brief Seed and obstacle flags of each cell at the last propagation
+      std::vector<unsigned char> new_cell_state_; ///< @brief Seed and obstacle flags of each cell for the current propagation
+      std::vector<unsigned char> cell_flags_; ///< @brief Scratch marks of the incremental update
+      std::vector<unsigned int> dirty_cells_; ///< @brief Cells whose distance or state changed in the incremental update
+      std::vector<unsigned int> seeds_; ///< @brief The seed cells of the last propagation, kept to reuse its memory
+      std::vector<geometry_msgs::PoseStamped> adjusted_plan_; ///< @brief The plan at the resolution of the grid, kept to reuse its memory
+      std::vector<std::vector<unsigned int> > buckets_; ///< @brief Cells queued by distance in the incremental update
+
   };
 };
 
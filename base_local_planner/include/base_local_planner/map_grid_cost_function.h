@@ -93,8 +93,13 @@ public:
    * Default is true. */
   void setStopOnFailure(bool stop_on_failure) {stop_on_failure_ = stop_on_failure;}
 
+  /** @brief If true, the distances are updated from those of the previous prepare call.
+   *
+   * Default is false. */
+  void setIncremental(bool incremental) {map_.setIncremental(incremental);}
+
   /**
-   * propagate distances
+   * propagate distances, unless the scale is 0
    */
   bool prepare();
 
@@ -63,6 +63,7 @@ namespace base_local_planner {
 
             /**
               * @brief Build and publish a PointCloud if the publish_cost_grid_pc parameter was true. Only include points for which the cost_function at (cx,cy) returns true.
+              * Nothing is computed while no one subscribes, and only every cost_cloud_stride-th cell in each direction is included.
               */
             void publishCostCloud(const costmap_2d::Costmap2D* costmap_p_);
 
@@ -72,6 +73,7 @@ namespace base_local_planner {
             ros::NodeHandle ns_nh_;
             pcl::PointCloud<MapGridCostPoint>* cost_cloud_;
             pcl_ros::Publisher<MapGridCostPoint> pub_;
+            int stride_; ///< @brief Cells between the points of the cloud, in each direction
     };
 };
 
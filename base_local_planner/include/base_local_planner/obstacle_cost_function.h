@@ -38,6 +38,10 @@
 #ifndef OBSTACLE_COST_FUNCTION_H_
 #define OBSTACLE_COST_FUNCTION_H_
 
+#include <map>
+
+#include <boost/thread/mutex.hpp>
+
 #include <base_local_planner/trajectory_cost_function.h>
 
 #include <base_local_planner/costmap_model.h>
@@ -63,6 +67,21 @@ public:
 
   void setParams(double max_trans_vel, double max_scaling_factor, double scaling_speed);
   void setFootprint(std::vector<geometry_msgs::Point> footprint_spec);
+  // number of headings for the footprint mask cache of the costmap model, 0 checks the exact footprint
+  void setFootprintMasks(unsigned int headings);
+  // robot cell costs that decide a footprint check without looking at the footprint, 0 to disable
+  void setInflationThresholds(unsigned char inscribed_cost, unsigned char circumscribed_cost);
+
+  /**
+   * @brief Remember the score of every trajectory, to skip scoring it again in later cycles while the robot stands
+   * still and the cells the trajectory sweeps did not change
+   *
+   * Changed cells of the costmap have to be reported with invalidateTrajectoryCache().
+   */
+  void setTrajectoryCache(bool enabled);
+  // drop the cached scores of trajectories that sweep a cell in [x0, xn) x [y0, yn)
+  void invalidateTrajectoryCache(unsigned int x0, unsigned int xn, unsigned int y0, unsigned int yn);
+  void clearTrajectoryCache();
 
   // helper functions, made static for easy unit testing
   static double getScalingFactor(Trajectory &traj, double scaling_speed, double max_trans_vel, double max_scaling_factor);
@@ -71,18 +90,82 @@ public:
       const double& y,
       const double& th,
       double scale,
-      std::vector<geometry_msgs::Point> footprint_spec,
+      const std::vector<geometry_msgs::Point>& footprint_spec,
       costmap_2d::Costmap2D* costmap,
       base_local_planner::WorldModel* world_model);
 
+  // same as above for a world model of a type known at compile time, the check is bound statically
+  // so it can be inlined; world_model must not be of a subclass of Model overriding footprintCost
+  template <class Model>
+  static double footprintCost(
+      const double& x,
+      const double& y,
+      const double& th,
+      double scale,
+      const std::vector<geometry_msgs::Point>& footprint_spec,
+      costmap_2d::Costmap2D* costmap,
+      Model* world_model) {
+    return occupancyCost(x, y, world_model->Model::footprintCost(x, y, th, footprint_spec), costmap);
+  }
+
 private:
+  // combine the footprint cost at a pose with the cost of the cell of the pose
+  static inline double occupancyCost(double x, double y, double footprint_cost, costmap_2d::Costmap2D* costmap) {
+    if (footprint_cost < 0) {
+      return -6.0;
+    }
+    unsigned int cell_x, cell_y;
+
+    //we won't allow trajectories that go off the map... shouldn't happen that often anyways
+    if ( ! costmap->worldToMapFast(x, y, cell_x, cell_y)) {
+      return -7.0;
+    }
+
+    return std::max(footprint_cost, double(costmap->getCost(cell_x, cell_y)));
+  }
+
+  struct CacheKey {
+    long xv, yv, thetav;
+    bool operator<(const CacheKey& other) const {
+      if (xv != other.xv) return xv < other.xv;
+      if (yv != other.yv) return yv < other.yv;
+      return thetav < other.thetav;
+    }
+  };
+
+  struct CachedTrajectory {
+    // the trajectory is only the same if it starts and ends at the same poses
+    double xv, yv, thetav;
+    unsigned int num_points;
+    double start_x, start_y, start_th;
+    double end_x, end_y, end_th;
+    // the cells the footprint may touch along the trajectory
+    int cx0, cxn, cy0, cyn;
+    double cost;
+    unsigned int last_used;
+  };
+
+  // velocities rounded to mm/s and mrad/s
+  static CacheKey cacheKey(const Trajectory &traj);
+  double sweepCost(Trajectory &traj, double scale);
+  bool lookupTrajectory(const Trajectory &traj, double& cost);
+  void storeTrajectory(const Trajectory &traj, double scale, double cost);
+
   costmap_2d::Costmap2D* costmap_;
   std::vector<geometry_msgs::Point> footprint_spec_;
-  base_local_planner::WorldModel* world_model_;
+  base_local_planner::CostmapModel* world_model_;
   double max_trans_vel_;
   bool sum_scores_;
   //footprint scaling with velocity;
   double max_scaling_factor_, scaling_speed_;
+
+  unsigned char inscribed_cost_, circumscribed_cost_;
+  bool cache_enabled_;
+  std::map<CacheKey, CachedTrajectory> cache_;
+  boost::mutex cache_mutex_;
+  unsigned int cache_cycle_;
+  double cache_origin_x_, cache_origin_y_, cache_resolution_;
+  double footprint_radius_;
 };
 
 } /* namespace base_local_planner */
@@ -79,10 +79,15 @@ private:
   //odom topic
   std::string odom_topic_;
 
+  /** @brief Read the twist of the latest odometry without locking, retrying while the callback writes it */
+  void readVel(double& x, double& y, double& th);
+
   // we listen on odometry on the odom topic
   ros::Subscriber odom_sub_;
-  nav_msgs::Odometry base_odom_;
-  boost::mutex odom_mutex_;
+  // the twist of the latest odometry, guarded by a sequence lock: vel_seq_ is odd while the callback writes,
+  // readers retry if it was odd or changed, so neither side ever waits for the other
+  double vel_x_, vel_y_, vel_th_;
+  unsigned int vel_seq_;
   // global tf frame id
   std::string frame_id_; ///< The frame_id associated this data
 };
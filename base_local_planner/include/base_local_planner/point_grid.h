@@ -37,7 +37,6 @@
 #ifndef POINT_GRID_H_
 #define POINT_GRID_H_
 #include <vector>
-#include <list>
 #include <cfloat>
 #include <geometry_msgs/Point.h>
 #include <costmap_2d/observation.h>
@@ -76,12 +75,22 @@ namespace base_local_planner {
       virtual ~PointGrid(){}
 
       /**
-       * @brief  Returns the points that lie within the cells contained in the specified range. Some of these points may be outside the range itself.
+       * @brief  Returns the non-empty cells contained in the specified range, their points are cellBegin() to cellEnd(). Some of these points may be outside the range itself.
        * @param  lower_left The lower left corner of the range search 
        * @param  upper_right The upper right corner of the range search
-       * @param points A vector of pointers to lists of the relevant points
+       * @param cells The indices of the relevant cells
        */
-      void getPointsInRange(const geometry_msgs::Point& lower_left, const geometry_msgs::Point& upper_right, std::vector< std::list<pcl::PointXYZ>* >& points);
+      void getCellsInRange(const geometry_msgs::Point& lower_left, const geometry_msgs::Point& upper_right, std::vector<unsigned int>& cells);
+
+      /**
+       * @brief  The first point of a cell returned by getCellsInRange()
+       */
+      pcl::PointXYZ* cellBegin(unsigned int index) { return &points_[0] + cell_starts_[index]; }
+
+      /**
+       * @brief  Past the last point of a cell returned by getCellsInRange()
+       */
+      pcl::PointXYZ* cellEnd(unsigned int index) { return &points_[0] + cell_ends_[index]; }
 
       /**
        * @brief  Checks if any points in the grid lie inside a convex footprint
@@ -316,6 +325,11 @@ namespace base_local_planner {
        */
       double getNearestInCell(pcl::PointXYZ& pt, unsigned int gx, unsigned int gy); 
 
+      /**
+       * @brief  Sort the points inserted since the last call into the cells, so all points of a cell are contiguous again
+       */
+      void rebuildCells();
+
       /**
        * @brief  Removes points from the grid that lie within the polygon
        * @param poly A specification of the polygon to clear from the grid 
@@ -347,11 +361,23 @@ namespace base_local_planner {
       geometry_msgs::Point origin_; ///< @brief The origin point of the grid
       unsigned int width_; ///< @brief The width of the grid in cells
       unsigned int height_; ///< @brief The height of the grid in cells
-      std::vector< std::list<pcl::PointXYZ> > cells_; ///< @brief Storage for the cells in the grid
+      /*
+       * The points are stored by cell in one array: the points of cell i are points_[cell_starts_[i]] up to
+       * points_[cell_ends_[i]]. Removing a point moves the last point of its cell into its place, leaving a gap
+       * before the next cell. Inserted points are kept in lists per cell in inserted_points_ until rebuildCells()
+       * copies every cell, followed by the points inserted into it, into a new array, which closes the gaps too.
+       */
+      std::vector<pcl::PointXYZ> points_; ///< @brief Storage for the points in the grid, grouped by cell
+      std::vector<unsigned int> cell_starts_; ///< @brief The index of the first point of each cell
+      std::vector<unsigned int> cell_ends_; ///< @brief The index past the last point of each cell
+      std::vector<pcl::PointXYZ> inserted_points_; ///< @brief The points inserted since the last rebuild
+      std::vector<int> inserted_next_; ///< @brief The next inserted point in the same cell, -1 for none
+      std::vector<int> inserted_heads_; ///< @brief The last inserted point of each cell, -1 for none
+      std::vector<pcl::PointXYZ> rebuild_points_; ///< @brief Storage for the next rebuild, swapped with points_
       double max_z_;  ///< @brief The height cutoff for adding points as obstacles
       double sq_obstacle_range_;  ///< @brief The square distance at which we no longer add obstacles to the grid
       double sq_min_separation_;  ///< @brief The minimum square distance required between points in the grid
-      std::vector< std::list<pcl::PointXYZ>* > points_;  ///< @brief The lists of points returned by a range search, made a member to save on memory allocation
+      std::vector<unsigned int> range_cells_;  ///< @brief The cells returned by a range search, made a member to save on memory allocation
   };
 };
 #endif
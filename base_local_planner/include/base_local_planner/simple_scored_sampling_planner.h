@@ -39,6 +39,9 @@
 #define SIMPLE_SCORED_SAMPLING_PLANNER_H_
 
 #include <vector>
+#include <algorithm>
+#include <boost/thread/mutex.hpp>
+#include <ros/time.h>
 #include <base_local_planner/trajectory.h>
 #include <base_local_planner/trajectory_cost_function.h>
 #include <base_local_planner/trajectory_sample_generator.h>
@@ -60,7 +63,7 @@ public:
 
   ~SimpleScoredSamplingPlanner() {}
 
-  SimpleScoredSamplingPlanner() {}
+  SimpleScoredSamplingPlanner() : max_samples_(-1), scoring_threads_(1), explored_endpoints_(false), explored_stride_(1) {}
 
   /**
    * Takes a list of generators and critics. Critics return costs > 0, or negative costs for invalid trajectories.
@@ -93,12 +96,56 @@ public:
    */
   bool findBestTrajectory(Trajectory& traj, std::vector<Trajectory>* all_explored = 0);
 
+  /**
+   * With more than one thread, each generator first generates all its samples, which are then
+   * scored on that many threads. The critics must allow concurrent calls of scoreTrajectory
+   * after prepare. The same trajectory is picked as when scoring on one thread, but the costs
+   * of trajectories that are cut short because they are worse than the best may differ.
+   */
+  void setScoringThreads(unsigned int threads) { scoring_threads_ = std::max(1u, threads); }
+
+  /**
+   * Once the deadline has passed and a valid trajectory was found, findBestTrajectory stops
+   * sampling and returns the best trajectory so far. A zero time (default) means no deadline.
+   */
+  void setDeadline(const ros::WallTime& deadline) { deadline_ = deadline; }
+
+  bool pastDeadline() const { return !deadline_.isZero() && ros::WallTime::now() > deadline_; }
+
+  /**
+   * Makes the trajectories collected in all_explored cheaper for visualization: only every
+   * stride-th sample is kept, and with endpoints_only only its velocities, cost and last point.
+   */
+  void setExploredSummary(bool endpoints_only, unsigned int stride) {
+    explored_endpoints_ = endpoints_only;
+    explored_stride_ = std::max(1u, stride);
+  }
+
 
 private:
+  /**
+   * Scores the generated samples in chunks until all are taken, pruning against the best
+   * cost this worker has seen.
+   */
+  void scoreWorker(unsigned int num_samples, boost::mutex* chunk_mutex, unsigned int* next_sample, bool* found_valid);
+
+  /**
+   * Adds the index-th sample to all_explored, as set by setExploredSummary
+   */
+  void addExplored(std::vector<Trajectory>& all_explored, const Trajectory& sample, double cost, int index) const;
+
   std::vector<TrajectorySampleGenerator*> gen_list_;
   std::vector<TrajectoryCostFunction*> critics_;
 
   int max_samples_;
+
+  unsigned int scoring_threads_;
+  ros::WallTime deadline_;
+  bool explored_endpoints_;
+  unsigned int explored_stride_;
+  Trajectory loop_traj_, best_traj_; ///< @brief Kept between cycles to reuse their point storage
+  std::vector<Trajectory> samples_; ///< @brief Generated trajectories, kept to reuse their storage
+  std::vector<double> sample_costs_;
 };
 
 
@@ -40,6 +40,7 @@
 
 #include <base_local_planner/trajectory_sample_generator.h>
 #include <base_local_planner/local_planner_limits.h>
+#include <base_local_planner/velocity_iterator.h>
 #include <Eigen/Core>
 
 namespace base_local_planner {
@@ -63,6 +64,9 @@ public:
 
   SimpleTrajectoryGenerator() {
     limits_ = NULL;
+    refine_samples_ = 0;
+    has_previous_cmd_ = false;
+    prioritize_samples_ = false;
   }
 
   ~SimpleTrajectoryGenerator() {}
@@ -82,7 +86,7 @@ public:
       const Eigen::Vector3f& goal,
       base_local_planner::LocalPlannerLimits* limits,
       const Eigen::Vector3f& vsamples,
-      std::vector<Eigen::Vector3f> additional_samples,
+      const std::vector<Eigen::Vector3f>& additional_samples,
       bool discretize_by_time = false);
 
   /**
@@ -115,6 +119,58 @@ public:
       bool use_dwa = false,
       double sim_period = 0.0);
 
+  /**
+   * @brief Add a finer grid of samples around the previous command to every initialise
+   *
+   * The finer grid spans one coarse sample step, centered on the command
+   * and clipped to the dynamic window, so fewer coarse samples reach the
+   * same resolution where the best command likely is.
+   * @param refine_samples The number of samples per dimension of the finer grid, 0 disables it
+   */
+  void setRefinement(int refine_samples) {
+    refine_samples_ = refine_samples;
+  }
+
+  /**
+   * @brief Set the command the finer grid is centered on, usually the last chosen one
+   */
+  void setPreviousCommand(const Eigen::Vector3f& cmd) {
+    previous_cmd_ = cmd;
+    has_previous_cmd_ = true;
+  }
+
+  void clearPreviousCommand() {
+    has_previous_cmd_ = false;
+  }
+
+  /**
+   * @brief Order the samples of every initialise by their distance to the previous command
+   *
+   * Without a previous command the current velocity is used. The distance is measured in
+   * coarse sample steps, so a search that is cut short has tried the most promising samples.
+   */
+  void setPrioritizeSamples(bool prioritize) {
+    prioritize_samples_ = prioritize;
+  }
+
+  /**
+   * @brief Generate the trajectory of a velocity sample from the state of the last initialise
+   */
+  bool generateSample(const Eigen::Vector3f& sample, base_local_planner::Trajectory& traj) {
+    return generateTrajectory(pos_, vel_, sample, traj);
+  }
+
+  /**
+   * @brief The dynamic window of the generic samples of the last initialise
+   */
+  const Eigen::Vector3f& getMinVelocity() const { return min_vel_; }
+  const Eigen::Vector3f& getMaxVelocity() const { return max_vel_; }
+
+  /**
+   * @brief The spacing of the generic samples of the last initialise, ignoring an inserted 0
+   */
+  Eigen::Vector3f getSampleStep() const;
+
   /**
    * Whether this generator can create more trajectories
    */
@@ -140,6 +196,16 @@ public:
 
 protected:
 
+  /**
+   * Add the samples of all combinations of the per dimension sample sets
+   */
+  void addSamples();
+
+  /**
+   * Sort the samples by their distance in sample steps to center, keeping the order of equal ones
+   */
+  void prioritizeSamples(const Eigen::Vector3f& center);
+
   unsigned int next_sample_index_;
   // to store sample params of each sample between init and generation
   std::vector<Eigen::Vector3f> sample_params_;
@@ -154,6 +220,20 @@ protected:
   double sim_time_, sim_granularity_, angular_sim_granularity_;
   bool use_dwa_;
   double sim_period_; // only for dwa
+
+  // sample sets of each dimension, refilled in place every cycle
+  VelocityIterator x_it_, y_it_, th_it_;
+
+  // the dynamic window of the generic samples and their number per dimension
+  Eigen::Vector3f min_vel_, max_vel_, vsamples_;
+
+  int refine_samples_;
+  bool has_previous_cmd_;
+  Eigen::Vector3f previous_cmd_;
+
+  bool prioritize_samples_;
+  std::vector<std::pair<float, unsigned int> > sample_order_; ///< @brief Scratch space for prioritizeSamples
+  std::vector<Eigen::Vector3f> ordered_params_;
 };
 
 } /* namespace base_local_planner */
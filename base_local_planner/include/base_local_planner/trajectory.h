@@ -108,6 +108,19 @@ namespace base_local_planner {
        */
       unsigned int getPointsSize() const;
 
+      /**
+       * @brief  Make room for a number of points, so that adding them does not allocate. The storage
+       * is kept by resetPoints(), so a trajectory that is reused only allocates when it grows.
+       * @param num_pts The number of points to make room for
+       */
+      void reservePoints(unsigned int num_pts);
+
+      /**
+       * @brief  Exchange velocities, cost and points with another trajectory without copying the points
+       * @param other The trajectory to swap with
+       */
+      void swap(Trajectory& other);
+
     private:
       std::vector<double> x_pts_; ///< @brief The x points in the trajectory
       std::vector<double> y_pts_; ///< @brief The y points in the trajectory
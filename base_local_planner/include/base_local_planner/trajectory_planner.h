@@ -56,6 +56,7 @@
 
 //for some datatypes
 #include <tf/transform_datatypes.h>
+#include <ros/time.h>
 
 //for creating a local cost grid
 #include <base_local_planner/map_cell.h>
@@ -203,6 +204,21 @@ namespace base_local_planner {
        */
       bool getCellCosts(int cx, int cy, float &path_cost, float &goal_cost, float &occ_cost, float &total_cost);
 
+      /**
+       * @brief  Update the path and goal distances from the previous cycle instead of recomputing them
+       * @param incremental Whether to update the distances incrementally
+       */
+      void setIncrementalDistances(bool incremental) {
+        path_map_.setIncremental(incremental);
+        goal_map_.setIncremental(incremental);
+      }
+
+      /**
+       * @brief  Set the time after which findBestPath stops trying forward samples once it has a valid one
+       * @param deadline The deadline, a zero time for none
+       */
+      void setDeadline(const ros::WallTime& deadline) { deadline_ = deadline; }
+
       /** @brief Set the footprint specification of the robot. */
       void setFootprint( std::vector<geometry_msgs::Point> footprint ) { footprint_spec_ = footprint; }
 
@@ -243,10 +259,27 @@ namespace base_local_planner {
        * @param acc_theta The theta acceleration limit of the robot
        * @param impossible_cost The cost value of a cell in the local map grid that is considered impassable
        * @param traj Will be set to the generated trajectory with its associated score 
+       * @param max_cost If not negative, the simulation stops with a cost of -3 as soon as the trajectory is known to cost more
        */
       void generateTrajectory(double x, double y, double theta, double vx, double vy, 
           double vtheta, double vx_samp, double vy_samp, double vtheta_samp, double acc_x, double acc_y,
-          double acc_theta, double impossible_cost, Trajectory& traj);
+          double acc_theta, double impossible_cost, Trajectory& traj, double max_cost = -1.0);
+
+      /**
+       * @brief  A velocity sample of the forward search, with its place in the regular sampling order
+       */
+      struct VelocitySample {
+        double vx, vtheta;
+        double priority; ///< @brief Samples with a lower priority are tried first
+        int order;
+
+        VelocitySample(double vx_samp, double vtheta_samp, double p, int o) :
+          vx(vx_samp), vtheta(vtheta_samp), priority(p), order(o) {}
+
+        bool operator<(const VelocitySample& other) const {
+          return priority < other.priority || (priority == other.priority && order < other.order);
+        }
+      };
 
       /**
        * @brief  Checks the legality of the robot footprint at a position and orientation using the world model
@@ -265,6 +298,7 @@ namespace base_local_planner {
       WorldModel& world_model_; ///< @brief The world model that the controller uses for collision detection
 
       std::vector<geometry_msgs::Point> footprint_spec_; ///< @brief The footprint specification of the robot
+      std::vector<base_local_planner::Position2DInt> footprint_cells_; ///< @brief The cells under the robot, kept to reuse its memory
 
       std::vector<geometry_msgs::PoseStamped> global_plan_; ///< @brief The global path for the robot to follow
 
@@ -296,6 +330,8 @@ namespace base_local_planner {
       double escape_x_, escape_y_, escape_theta_; ///< @brief Used to calculate the distance the robot has traveled before reseting escape booleans
 
       Trajectory traj_one, traj_two; ///< @brief Used for scoring trajectories
+      std::vector<VelocitySample> forward_samples_; ///< @brief The forward velocity samples of a cycle, in the order they are tried
+      ros::WallTime deadline_; ///< @brief When to stop trying forward samples, zero for never
 
       double heading_lookahead_; ///< @brief How far the robot should look ahead of itself when differentiating between different rotational velocities
       double oscillation_reset_dist_; ///< @brief The distance the robot must travel before it can explore rotational velocities that were unsuccessful in the past
@@ -309,6 +345,10 @@ namespace base_local_planner {
       bool dwa_;  ///< @brief Should we use the dynamic window approach?
       bool heading_scoring_; ///< @brief Should we score based on the rollout approach or the heading approach
       double heading_scoring_timestep_; ///< @brief How far to look ahead in time when we score a heading
+      std::vector<Position2DInt> heading_plan_cells_; ///< @brief The cells of the global plan inside the costmap, the far end first
+      std::vector<int> heading_targets_; ///< @brief Per cell, the index into heading_plan_cells_ of the first visible plan cell, -1 for none
+      std::vector<unsigned int> heading_target_cycles_; ///< @brief Per cell, the heading cycle heading_targets_ was computed in
+      unsigned int heading_cycle_; ///< @brief Counts the scoring cycles, so the visibility cache needs no clearing
       bool simple_attractor_;  ///< @brief Enables simple attraction to a goal point
 
       std::vector<double> y_vels_; ///< @brief Y velocities to explore
@@ -382,6 +422,11 @@ namespace base_local_planner {
       double lineCost(int x0, int x1, int y0, int y1);
       double pointCost(int x, int y);
       double headingDiff(int cell_x, int cell_y, double x, double y, double heading);
+
+      /**
+       * @brief  Invalidate the plan cells visible from each cell, for when the costmap or the plan changed
+       */
+      void startHeadingCycle();
   };
 };
 
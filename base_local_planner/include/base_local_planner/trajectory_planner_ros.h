@@ -116,6 +116,8 @@ namespace base_local_planner {
        */
       bool computeVelocityCommands(geometry_msgs::Twist& cmd_vel);
 
+      using nav_core::BaseLocalPlanner::computeVelocityCommands;
+
       /**
        * @brief  Set the plan that the controller is following
        * @param orig_global_plan The plan to pass to the controller
@@ -123,12 +125,26 @@ namespace base_local_planner {
        */
       bool setPlan(const std::vector<geometry_msgs::PoseStamped>& orig_global_plan);
 
+      /**
+       * @brief  Set the plan that the controller is following without copying it
+       * @param plan The plan to pass to the controller
+       * @param version The version of the plan, see nav_core::BaseLocalPlanner
+       * @return True if the plan was updated successfully, false otherwise
+       */
+      bool setPlan(const nav_core::PlanConstPtr& plan, unsigned int version);
+
       /**
        * @brief  Check if the goal pose has been achieved
        * @return True if achieved, false otherwise
        */
       bool isGoalReached();
 
+      /**
+       * @brief  Set the time by which the next computeVelocityCommands should return
+       * @param deadline Once it has passed, the best of the forward samples tried so far is used
+       */
+      void setControlDeadline(const ros::WallTime& deadline);
+
       /**
        * @brief  Generate and score a single trajectory
        * @param vx_samp The x velocity used to seed the trajectory
@@ -193,11 +209,13 @@ namespace base_local_planner {
         return x < 0.0 ? -1.0 : 1.0;
       }
 
-      WorldModel* world_model_; ///< @brief The world model that the controller will use
+      CostmapModel* world_model_; ///< @brief The world model that the controller will use
       TrajectoryPlanner* tc_; ///< @brief The trajectory controller
 
       costmap_2d::Costmap2DROS* costmap_ros_; ///< @brief The ROS wrapper for the costmap the controller will use
       costmap_2d::Costmap2D* costmap_; ///< @brief The costmap the controller will use
+      costmap_2d::Costmap2D costmap_snapshot_; ///< @brief The copy of the costmap for this cycle, if use_costmap_snapshot_
+      bool use_costmap_snapshot_;
       MapGridVisualizer map_viz_; ///< @brief The map grid visualizer for outputting the potential field generated by the cost function
       tf::TransformListener* tf_; ///< @brief Used for transforming point clouds
       std::string global_frame_; ///< @brief The frame in which the controller will run
@@ -206,7 +224,10 @@ namespace base_local_planner {
       std::string robot_base_frame_; ///< @brief Used as the base frame id of the robot
       double rot_stopped_velocity_, trans_stopped_velocity_;
       double xy_goal_tolerance_, yaw_goal_tolerance_, min_in_place_vel_th_;
-      std::vector<geometry_msgs::PoseStamped> global_plan_;
+      nav_core::PlanConstPtr global_plan_; ///< @brief Shared with move_base, never changed
+      unsigned int plan_version_; ///< @brief The version move_base gave global_plan_, 0 for copied plans
+      unsigned int plan_start_; ///< @brief The index of the first pose of global_plan_ not pruned yet
+      std::vector<geometry_msgs::PoseStamped> transformed_plan_; ///< @brief The part of the plan within the costmap, in the frame of the controller
       bool prune_plan_;
       boost::recursive_mutex odom_lock_;
 
@@ -216,6 +237,7 @@ namespace base_local_planner {
       bool rotating_to_goal_;
       bool reached_goal_;
       bool latch_xy_goal_tolerance_, xy_tolerance_latch_;
+      bool inflation_fast_path_; ///< @brief Decide collision checks from the inflated cost of the robot cell where possible
 
       ros::Publisher g_plan_pub_, l_plan_pub_;
 
@@ -59,6 +59,15 @@ public:
    */
   virtual bool nextTrajectory(Trajectory &traj) = 0;
 
+  /**
+   * @brief  Receive the cost of a trajectory returned by nextTrajectory
+   *
+   * Called in the order the trajectories were returned. Trajectories worse
+   * than the best so far may be cut short and reported with a partial cost.
+   * Generators that adapt to the scores may offer more trajectories afterwards.
+   */
+  virtual void reportCost(const Trajectory& traj, double cost) {}
+
   /**
    * @brief  Virtual destructor for the interface
    */
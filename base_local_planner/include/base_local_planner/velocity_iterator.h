@@ -46,9 +46,23 @@ namespace base_local_planner {
    */
   class VelocityIterator {
     public:
+      VelocityIterator():
+        current_index(0)
+      {
+      }
+
       VelocityIterator(double min, double max, int num_samples):
         current_index(0)
       {
+        setRange(min, max, num_samples);
+      }
+
+      /**
+       * @brief Refill the samples for a new range in place, keeping the storage
+       */
+      void setRange(double min, double max, int num_samples){
+        samples_.clear();
+        current_index = 0;
         if (min == max) {
           samples_.push_back(min);
         } else {
@@ -73,6 +87,10 @@ namespace base_local_planner {
         }
       }
 
+      unsigned int size() const {
+        return samples_.size();
+      }
+
       double getVelocity(){
         return samples_.at(current_index);
       }
@@ -121,6 +121,13 @@ namespace base_local_planner {
        */
       double pointCost(int x, int y);
 
+      /**
+       * @brief  Recompute which columns of the grid hold an obstacle, called after the grid changes
+       *
+       * The footprint checks read this mask instead of counting the bits of each column they cross.
+       */
+      void updateColumnMask();
+
       void removePointsInScanBoundry(const PlanarLaserScan& laser_scan, double raytrace_range);
 
       inline bool worldToMap3D(double wx, double wy, double wz, unsigned int& mx, unsigned int& my, unsigned int& mz){
@@ -172,6 +179,8 @@ namespace base_local_planner {
       double origin_z_;
       double max_z_;  ///< @brief The height cutoff for adding points as obstacles
       double sq_obstacle_range_;  ///< @brief The square distance at which we no longer add obstacles to the grid
+      std::vector<unsigned char> column_mask_;  ///< @brief One per column, set where the column is not free
+      std::vector<double> clear_ends_;  ///< @brief The cell coordinates of the ends of the rays of a scan
 
   };
 };
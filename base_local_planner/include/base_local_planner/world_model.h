@@ -62,7 +62,17 @@ namespace base_local_planner {
       virtual double footprintCost(const geometry_msgs::Point& position, const std::vector<geometry_msgs::Point>& footprint,
           double inscribed_radius, double circumscribed_radius) = 0;
 
-      double footprintCost(double x, double y, double theta, const std::vector<geometry_msgs::Point>& footprint_spec, double inscribed_radius = 0.0, double circumscribed_radius=0.0){
+      /**
+       * @brief  Checks a footprint given in robot coordinates at a given pose, subclasses may override this to skip building the oriented footprint
+       * @param  x The x position of the robot in world coordinates
+       * @param  y The y position of the robot in world coordinates
+       * @param  theta The orientation of the robot
+       * @param  footprint_spec The specification of the footprint of the robot in robot coordinates
+       * @param  inscribed_radius The radius of the inscribed circle of the robot, computed from footprint_spec when 0
+       * @param  circumscribed_radius The radius of the circumscribed circle of the robot
+       * @return Positive if all the points lie outside the footprint, negative otherwise
+       */
+      virtual double footprintCost(double x, double y, double theta, const std::vector<geometry_msgs::Point>& footprint_spec, double inscribed_radius = 0.0, double circumscribed_radius=0.0){
 
         double cos_th = cos(theta);
         double sin_th = sin(theta);
@@ -0,0 +1,166 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author: TKruse
+ *********************************************************************/
+
+#include <base_local_planner/coarse_to_fine_trajectory_generator.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace base_local_planner {
+
+namespace {
+  bool lowerCost(const std::pair<double, Eigen::Vector3f>& a, const std::pair<double, Eigen::Vector3f>& b) {
+    return a.first < b.first;
+  }
+}
+
+CoarseToFineTrajectoryGenerator::CoarseToFineTrajectoryGenerator() :
+    levels_(0), top_k_(1), fine_samples_(3), level_(0), step_(Eigen::Vector3f::Zero()) {}
+
+void CoarseToFineTrajectoryGenerator::initialise(
+    const Eigen::Vector3f& pos,
+    const Eigen::Vector3f& vel,
+    const Eigen::Vector3f& goal,
+    base_local_planner::LocalPlannerLimits* limits,
+    const Eigen::Vector3f& vsamples,
+    const std::vector<Eigen::Vector3f>& additional_samples,
+    bool discretize_by_time) {
+  initialise(pos, vel, goal, limits, vsamples, discretize_by_time);
+  sample_params_.insert(sample_params_.end(), additional_samples.begin(), additional_samples.end());
+}
+
+void CoarseToFineTrajectoryGenerator::initialise(
+    const Eigen::Vector3f& pos,
+    const Eigen::Vector3f& vel,
+    const Eigen::Vector3f& goal,
+    base_local_planner::LocalPlannerLimits* limits,
+    const Eigen::Vector3f& vsamples,
+    bool discretize_by_time) {
+  SimpleTrajectoryGenerator::initialise(pos, vel, goal, limits, vsamples, discretize_by_time);
+  level_ = 0;
+  pending_.clear();
+  candidates_.clear();
+  step_ = getSampleStep();
+}
+
+void CoarseToFineTrajectoryGenerator::setCoarseToFine(int levels, int top_k, int refine_samples) {
+  levels_ = levels;
+  top_k_ = std::max(1, top_k);
+  fine_samples_ = std::max(2, refine_samples);
+}
+
+bool CoarseToFineTrajectoryGenerator::hasMoreTrajectories() {
+  if (SimpleTrajectoryGenerator::hasMoreTrajectories()) {
+    return true;
+  }
+  // the current level is exhausted, refine once all of it is scored
+  while (level_ < levels_ && pending_.empty() && !candidates_.empty()) {
+    if (refine()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool CoarseToFineTrajectoryGenerator::nextTrajectory(Trajectory &traj) {
+  if (levels_ > 0 && SimpleTrajectoryGenerator::hasMoreTrajectories()) {
+    Eigen::Vector3f sample = sample_params_[next_sample_index_];
+    if (SimpleTrajectoryGenerator::nextTrajectory(traj)) {
+      pending_.push_back(sample);
+      return true;
+    }
+    return false;
+  }
+  return SimpleTrajectoryGenerator::nextTrajectory(traj);
+}
+
+void CoarseToFineTrajectoryGenerator::reportCost(const Trajectory& traj, double cost) {
+  if (pending_.empty()) {
+    return;
+  }
+  if (cost >= 0) {
+    candidates_.push_back(std::make_pair(cost, pending_.front()));
+  }
+  pending_.pop_front();
+}
+
+bool CoarseToFineTrajectoryGenerator::refine() {
+  ++level_;
+  unsigned int num_samples = sample_params_.size();
+  unsigned int k = std::min((unsigned int)top_k_, (unsigned int)candidates_.size());
+  std::partial_sort(candidates_.begin(), candidates_.begin() + k, candidates_.end(), lowerCost);
+
+  Eigen::Vector3f vel_samp;
+  for (unsigned int c = 0; c < k; ++c) {
+    const Eigen::Vector3f& center = candidates_[c].second;
+    VelocityIterator* its[3] = {&x_it_, &y_it_, &th_it_};
+    bool inside = true;
+    for (int i = 0; i < 3 && inside; ++i) {
+      double lower = std::max((double)min_vel_[i], center[i] - 0.5 * step_[i]);
+      double upper = std::min((double)max_vel_[i], center[i] + 0.5 * step_[i]);
+      // additional samples may lie outside of the window
+      inside = lower <= upper;
+      if (inside) {
+        its[i]->setRange(lower, upper, fine_samples_);
+      }
+    }
+    if (!inside) {
+      continue;
+    }
+    for(; !x_it_.isFinished(); x_it_++) {
+      vel_samp[0] = x_it_.getVelocity();
+      for(; !y_it_.isFinished(); y_it_++) {
+        vel_samp[1] = y_it_.getVelocity();
+        for(; !th_it_.isFinished(); th_it_++) {
+          vel_samp[2] = th_it_.getVelocity();
+          // the center has been scored already
+          if (vel_samp != center) {
+            sample_params_.push_back(vel_samp);
+          }
+        }
+        th_it_.reset();
+      }
+      y_it_.reset();
+    }
+  }
+
+  step_ /= fine_samples_ - 1;
+  candidates_.clear();
+  return sample_params_.size() > num_samples;
+}
+
+} /* namespace base_local_planner */
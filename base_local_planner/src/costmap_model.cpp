@@ -37,12 +37,207 @@
 #include <base_local_planner/line_iterator.h>
 #include <base_local_planner/costmap_model.h>
 #include <costmap_2d/cost_values.h>
+#include <costmap_2d/footprint.h>
+#include <angles/angles.h>
+#include <set>
 
 using namespace std;
 using namespace costmap_2d;
 
 namespace base_local_planner {
-  CostmapModel::CostmapModel(const Costmap2D& ma) : costmap_(ma) {}
+  CostmapModel::CostmapModel(const Costmap2D& ma) : costmap_(ma), mask_headings_(0),
+    mask_resolution_(0.0), mask_size_x_(0), ring_resolution_(0.0), ring_size_x_(0), ring_margin_(0),
+    inscribed_cost_(0), circumscribed_cost_(0) {}
+
+  void CostmapModel::setInflationThresholds(unsigned char inscribed_cost, unsigned char circumscribed_cost){
+    inscribed_cost_ = inscribed_cost;
+    circumscribed_cost_ = circumscribed_cost;
+  }
+
+  bool CostmapModel::inflationCost(unsigned int cell_x, unsigned int cell_y, double& cost) const {
+    unsigned char center_cost = costmap_.getCost(cell_x, cell_y);
+    if(inscribed_cost_ > 0 && center_cost >= inscribed_cost_ && center_cost != NO_INFORMATION){
+      cost = -1.0;
+      return true;
+    }
+    //whoever set circumscribed_cost vouches that no lethal or unknown cell is left uninflated
+    if(center_cost >= circumscribed_cost_)
+      return false;
+    cost = center_cost;
+    return true;
+  }
+
+  void CostmapModel::setFootprintMasks(unsigned int headings){
+    if(headings == mask_headings_)
+      return;
+    mask_headings_ = headings;
+    //force a rebuild on the next check
+    masks_.clear();
+    mask_footprint_.clear();
+  }
+
+  void CostmapModel::updateFootprintMasks(const std::vector<geometry_msgs::Point>& footprint_spec){
+    if(mask_headings_ == 0 || footprint_spec.size() < 3)
+      return;
+
+    double resolution = costmap_.getResolution();
+    unsigned int size_x = costmap_.getSizeInCellsX();
+    if(!masks_.empty() && resolution == mask_resolution_ && size_x == mask_size_x_
+        && footprint_spec.size() == mask_footprint_.size()){
+      bool same = true;
+      for(unsigned int i = 0; i < footprint_spec.size() && same; ++i)
+        same = footprint_spec[i].x == mask_footprint_[i].x && footprint_spec[i].y == mask_footprint_[i].y;
+      if(same)
+        return;
+    }
+
+    mask_footprint_ = footprint_spec;
+    mask_resolution_ = resolution;
+    mask_size_x_ = size_x;
+    masks_.resize(mask_headings_);
+
+    //positions of the robot within its cell, in cells, and headings within a bin we take the union over
+    const double fracs[] = {0.0, 0.5, 1.0 - 1e-6};
+    const double bin = 2 * M_PI / mask_headings_;
+    const double thetas[] = {-0.5 * bin, 0.0, 0.5 * bin};
+
+    std::vector<int> cx(footprint_spec.size()), cy(footprint_spec.size());
+    for(unsigned int h = 0; h < mask_headings_; ++h){
+      std::set<std::pair<int, int> > cells;
+      for(unsigned int t = 0; t < 3; ++t){
+        double theta = h * bin + thetas[t];
+        double cos_th = cos(theta);
+        double sin_th = sin(theta);
+        for(unsigned int fx = 0; fx < 3; ++fx){
+          for(unsigned int fy = 0; fy < 3; ++fy){
+            for(unsigned int i = 0; i < footprint_spec.size(); ++i){
+              cx[i] = (int)floor(fracs[fx] + (footprint_spec[i].x * cos_th - footprint_spec[i].y * sin_th) / resolution);
+              cy[i] = (int)floor(fracs[fy] + (footprint_spec[i].x * sin_th + footprint_spec[i].y * cos_th) / resolution);
+            }
+            for(unsigned int i = 0; i < footprint_spec.size(); ++i){
+              unsigned int j = (i + 1) % footprint_spec.size();
+              //keyed by row first so the offsets walk the costmap array in order
+              for(LineIterator line(cx[i], cy[i], cx[j], cy[j]); line.isValid(); line.advance())
+                cells.insert(std::make_pair(line.getY(), line.getX()));
+            }
+          }
+        }
+      }
+
+      FootprintMask& mask = masks_[h];
+      mask.offsets.clear();
+      mask.min_dx = mask.min_dy = 0;
+      mask.max_dx = mask.max_dy = 0;
+      for(std::set<std::pair<int, int> >::const_iterator it = cells.begin(); it != cells.end(); ++it){
+        mask.offsets.push_back(it->first * (int)size_x + it->second);
+        mask.min_dx = std::min(mask.min_dx, it->second);
+        mask.max_dx = std::max(mask.max_dx, it->second);
+        mask.min_dy = std::min(mask.min_dy, it->first);
+        mask.max_dy = std::max(mask.max_dy, it->first);
+      }
+    }
+  }
+
+  double CostmapModel::footprintCost(double x, double y, double theta, const std::vector<geometry_msgs::Point>& footprint_spec,
+      double inscribed_radius, double circumscribed_radius){
+    if(mask_headings_ == 0 || footprint_spec.size() < 3)
+      return WorldModel::footprintCost(x, y, theta, footprint_spec, inscribed_radius, circumscribed_radius);
+
+    unsigned int cell_x, cell_y;
+    if(!costmap_.worldToMapFast(x, y, cell_x, cell_y))
+      return -1.0;
+
+    double center_cost;
+    if(inflationCost(cell_x, cell_y, center_cost))
+      return center_cost;
+
+    updateFootprintMasks(footprint_spec);
+
+    double bin = 2 * M_PI / mask_headings_;
+    unsigned int h = (unsigned int)floor(angles::normalize_angle_positive(theta) / bin + 0.5) % mask_headings_;
+    const FootprintMask& mask = masks_[h];
+
+    //the exact check fails when a footprint corner is off the map, so the mask has to fit in it
+    int mx = cell_x, my = cell_y;
+    if(mx + mask.min_dx < 0 || my + mask.min_dy < 0
+        || mx + mask.max_dx >= (int)costmap_.getSizeInCellsX() || my + mask.max_dy >= (int)costmap_.getSizeInCellsY())
+      return -1.0;
+
+    const unsigned char* grid = costmap_.getCharMap() + costmap_.getIndex(cell_x, cell_y);
+    unsigned char footprint_cost = 0;
+    for(unsigned int i = 0; i < mask.offsets.size(); ++i){
+      unsigned char cost = grid[mask.offsets[i]];
+      if(cost == LETHAL_OBSTACLE || cost == NO_INFORMATION)
+        return -1.0;
+      if(cost > footprint_cost)
+        footprint_cost = cost;
+    }
+
+    return footprint_cost;
+  }
+
+  double CostmapModel::sweptFootprintCost(double x, double y, const std::vector<geometry_msgs::Point>& footprint_spec,
+      double margin){
+    if(footprint_spec.size() < 3)
+      return -1.0;
+
+    unsigned int cell_x, cell_y;
+    if(!costmap_.worldToMap(x, y, cell_x, cell_y))
+      return -1.0;
+
+    double resolution = costmap_.getResolution();
+    unsigned int size_x = costmap_.getSizeInCellsX();
+    int margin_cells = (int)ceil(std::max(0.0, margin) / resolution);
+
+    //decided for every heading alike, as long as the robot stays in its cell
+    double center_cost;
+    if(margin_cells == 0 && inflationCost(cell_x, cell_y, center_cost))
+      return center_cost;
+    bool same = !ring_.offsets.empty() && resolution == ring_resolution_ && size_x == ring_size_x_
+        && margin_cells == ring_margin_ && footprint_spec.size() == ring_footprint_.size();
+    for(unsigned int i = 0; i < footprint_spec.size() && same; ++i)
+      same = footprint_spec[i].x == ring_footprint_[i].x && footprint_spec[i].y == ring_footprint_[i].y;
+    if(!same){
+      ring_footprint_ = footprint_spec;
+      ring_resolution_ = resolution;
+      ring_size_x_ = size_x;
+      ring_margin_ = margin_cells;
+
+      //the outline stays between these distances from the robot, the rasterized lines within a cell of
+      //it and the robot within a cell diagonal of the center of its cell
+      double min_dist, max_dist;
+      costmap_2d::calculateMinAndMaxDistances(footprint_spec, min_dist, max_dist);
+      double inner = std::max(0.0, min_dist / resolution - 2.5 - margin_cells);
+      double outer = max_dist / resolution + 2.5 + margin_cells;
+      int extent = (int)ceil(outer);
+      ring_.offsets.clear();
+      ring_.min_dx = ring_.min_dy = -extent;
+      ring_.max_dx = ring_.max_dy = extent;
+      for(int dy = -extent; dy <= extent; ++dy){
+        for(int dx = -extent; dx <= extent; ++dx){
+          double dist = hypot(dx, dy);
+          if(dist >= inner && dist <= outer)
+            ring_.offsets.push_back(dy * (int)size_x + dx);
+        }
+      }
+    }
+
+    int mx = cell_x, my = cell_y;
+    if(mx + ring_.min_dx < 0 || my + ring_.min_dy < 0
+        || mx + ring_.max_dx >= (int)costmap_.getSizeInCellsX() || my + ring_.max_dy >= (int)costmap_.getSizeInCellsY())
+      return -1.0;
+
+    const unsigned char* grid = costmap_.getCharMap() + costmap_.getIndex(cell_x, cell_y);
+    unsigned char ring_cost = 0;
+    for(unsigned int i = 0; i < ring_.offsets.size(); ++i){
+      unsigned char cost = grid[ring_.offsets[i]];
+      if(cost == LETHAL_OBSTACLE || cost == NO_INFORMATION)
+        return -1.0;
+      if(cost > ring_cost)
+        ring_cost = cost;
+    }
+    return ring_cost;
+  }
 
   double CostmapModel::footprintCost(const geometry_msgs::Point& position, const std::vector<geometry_msgs::Point>& footprint, 
       double inscribed_radius, double circumscribed_radius){
@@ -63,6 +258,11 @@ namespace base_local_planner {
       return cost;
     }
 
+    //the inflated cost of the robot cell may already decide the check
+    double center_cost;
+    if(inflationCost(cell_x, cell_y, center_cost))
+      return center_cost;
+
     //now we really have to lay down the footprint in the costmap grid
     unsigned int x0, x1, y0, y1;
     double line_cost = 0.0;
@@ -127,15 +327,4 @@ namespace base_local_planner {
     return line_cost;
   }
 
-  double CostmapModel::pointCost(int x, int y){
-    unsigned char cost = costmap_.getCost(x, y);
-    //if the cell is in an obstacle the path is invalid
-    //if(cost == LETHAL_OBSTACLE){
-    if(cost == LETHAL_OBSTACLE || cost == NO_INFORMATION){
-      return -1;
-    }
-
-    return cost;
-  }
-
 }
@@ -0,0 +1,200 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <base_local_planner/distance_field_cost_function.h>
+#include <costmap_2d/cost_values.h>
+#include <algorithm>
+#include <cmath>
+#include <ros/console.h>
+
+namespace base_local_planner {
+
+// larger than any squared distance on a costmap, small enough to keep the parabola intersections finite
+static const double FAR = 1e20;
+
+DistanceFieldCostFunction::DistanceFieldCostFunction(costmap_2d::Costmap2D* costmap)
+    : costmap_(costmap), num_circles_(3), circle_radius_(0.0), max_clearance_(0.5), sum_scores_(false),
+      size_x_(0), size_y_(0), resolution_(0.0) {
+}
+
+void DistanceFieldCostFunction::setCircles(unsigned int num_circles) {
+  num_circles_ = std::max(1u, num_circles);
+  coverFootprint(footprint_spec_, num_circles_, circle_centers_, circle_radius_);
+}
+
+void DistanceFieldCostFunction::setFootprint(const std::vector<geometry_msgs::Point>& footprint_spec) {
+  footprint_spec_ = footprint_spec;
+  coverFootprint(footprint_spec_, num_circles_, circle_centers_, circle_radius_);
+}
+
+void DistanceFieldCostFunction::coverFootprint(const std::vector<geometry_msgs::Point>& footprint_spec,
+    unsigned int num_circles, std::vector<geometry_msgs::Point>& centers, double& radius) {
+  centers.clear();
+  radius = 0.0;
+  if (footprint_spec.empty()) {
+    return;
+  }
+  double min_x = footprint_spec[0].x, max_x = min_x;
+  double min_y = footprint_spec[0].y, max_y = min_y;
+  for (unsigned int i = 1; i < footprint_spec.size(); ++i) {
+    min_x = std::min(min_x, footprint_spec[i].x);
+    max_x = std::max(max_x, footprint_spec[i].x);
+    min_y = std::min(min_y, footprint_spec[i].y);
+    max_y = std::max(max_y, footprint_spec[i].y);
+  }
+
+  // equal circles through the corners of equal slices of the bounding box, along its longer side
+  bool along_x = max_x - min_x >= max_y - min_y;
+  double length = along_x ? max_x - min_x : max_y - min_y;
+  double width = along_x ? max_y - min_y : max_x - min_x;
+  double slice = length / num_circles;
+  radius = hypot(0.5 * slice, 0.5 * width);
+  for (unsigned int i = 0; i < num_circles; ++i) {
+    geometry_msgs::Point center;
+    double offset = (along_x ? min_x : min_y) + (i + 0.5) * slice;
+    center.x = along_x ? offset : 0.5 * (min_x + max_x);
+    center.y = along_x ? 0.5 * (min_y + max_y) : offset;
+    centers.push_back(center);
+  }
+}
+
+void DistanceFieldCostFunction::distanceTransform(const double* f, double* d, int n, int* v, double* z) {
+  // lower envelope of the parabolas rooted at every sample, see Felzenszwalb and Huttenlocher,
+  // "Distance Transforms of Sampled Functions"
+  int k = 0;
+  v[0] = 0;
+  z[0] = -FAR;
+  z[1] = FAR;
+  for (int q = 1; q < n; ++q) {
+    double s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+    while (s <= z[k]) {
+      --k;
+      s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+    }
+    ++k;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = FAR;
+  }
+  k = 0;
+  for (int q = 0; q < n; ++q) {
+    while (z[k + 1] < q) {
+      ++k;
+    }
+    d[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
+  }
+}
+
+bool DistanceFieldCostFunction::prepare() {
+  // nothing to do when the planner does not consult us
+  if (getScale() == 0) {
+    return true;
+  }
+  size_x_ = costmap_->getSizeInCellsX();
+  size_y_ = costmap_->getSizeInCellsY();
+  resolution_ = costmap_->getResolution();
+  unsigned int size = size_x_ * size_y_;
+  unsigned int n = std::max(size_x_, size_y_);
+  squared_.resize(size);
+  distances_.resize(size);
+  f_.resize(n);
+  d_.resize(n);
+  z_.resize(n + 1);
+  v_.resize(n);
+
+  // squared distances within each column, then combined along each row
+  const unsigned char* costs = costmap_->getCharMap();
+  for (unsigned int x = 0; x < size_x_; ++x) {
+    for (unsigned int y = 0; y < size_y_; ++y) {
+      unsigned char cost = costs[y * size_x_ + x];
+      f_[y] = (cost == costmap_2d::LETHAL_OBSTACLE || cost == costmap_2d::NO_INFORMATION) ? 0.0 : FAR;
+    }
+    distanceTransform(&f_[0], &d_[0], size_y_, &v_[0], &z_[0]);
+    for (unsigned int y = 0; y < size_y_; ++y) {
+      squared_[y * size_x_ + x] = d_[y];
+    }
+  }
+  for (unsigned int y = 0; y < size_y_; ++y) {
+    distanceTransform(&squared_[y * size_x_], &d_[0], size_x_, &v_[0], &z_[0]);
+    for (unsigned int x = 0; x < size_x_; ++x) {
+      distances_[y * size_x_ + x] = d_[x] >= FAR ? FAR : sqrt(d_[x]) * resolution_;
+    }
+  }
+  return true;
+}
+
+double DistanceFieldCostFunction::scoreTrajectory(Trajectory &traj) {
+  if (circle_centers_.empty()) {
+    ROS_ERROR("Footprint spec is empty, maybe missing call to setFootprint?");
+    return -9;
+  }
+  double cost = 0;
+  double px, py, pth;
+  for (unsigned int i = 0; i < traj.getPointsSize(); ++i) {
+    traj.getPoint(i, px, py, pth);
+    double cos_th = cos(pth);
+    double sin_th = sin(pth);
+    double min_clearance = max_clearance_;
+    for (unsigned int c = 0; c < circle_centers_.size(); ++c) {
+      const geometry_msgs::Point& center = circle_centers_[c];
+      unsigned int cell_x, cell_y;
+      //we won't allow trajectories that go off the map... shouldn't happen that often anyways
+      if (!costmap_->worldToMap(px + center.x * cos_th - center.y * sin_th,
+                                py + center.x * sin_th + center.y * cos_th, cell_x, cell_y)) {
+        return -7.0;
+      }
+      // an obstacle cell reaches up to half a cell towards the circle
+      double clearance = getDistance(cell_x, cell_y) - circle_radius_ - 0.5 * resolution_;
+      if (clearance < 0) {
+        return -6.0;
+      }
+      min_clearance = std::min(min_clearance, clearance);
+    }
+
+    // rises linearly to just below the inscribed cost as the clearance drops to 0
+    double p_cost = 0.0;
+    if (max_clearance_ > 0) {
+      p_cost = (costmap_2d::INSCRIBED_INFLATED_OBSTACLE - 1) * (1.0 - min_clearance / max_clearance_);
+    }
+    if (sum_scores_)
+      cost += p_cost;
+    else
+      cost = std::max(cost, p_cost);
+  }
+  return cost;
+}
+
+} /* namespace base_local_planner */
@@ -182,10 +182,21 @@ std::vector<base_local_planner::Position2DInt> FootprintHelper::getFootprintCell
     std::vector<geometry_msgs::Point> footprint_spec,
     const costmap_2d::Costmap2D& costmap,
     bool fill){
+  std::vector<base_local_planner::Position2DInt> footprint_cells;
+  getFootprintCells(pos, footprint_spec, costmap, fill, footprint_cells);
+  return footprint_cells;
+}
+
+void FootprintHelper::getFootprintCells(
+    const Eigen::Vector3f& pos,
+    const std::vector<geometry_msgs::Point>& footprint_spec,
+    const costmap_2d::Costmap2D& costmap,
+    bool fill,
+    std::vector<base_local_planner::Position2DInt>& footprint_cells){
   double x_i = pos[0];
   double y_i = pos[1];
   double theta_i = pos[2];
-  std::vector<base_local_planner::Position2DInt> footprint_cells;
+  footprint_cells.clear();
 
   //if we have no footprint... do nothing
   if (footprint_spec.size() <= 1) {
@@ -196,7 +207,7 @@ std::vector<base_local_planner::Position2DInt> FootprintHelper::getFootprintCell
       center.y = my;
       footprint_cells.push_back(center);
     }
-    return footprint_cells;
+    return;
   }
 
   //pre-compute cos and sin values
@@ -211,14 +222,14 @@ std::vector<base_local_planner::Position2DInt> FootprintHelper::getFootprintCell
     new_x = x_i + (footprint_spec[i].x * cos_th - footprint_spec[i].y * sin_th);
     new_y = y_i + (footprint_spec[i].x * sin_th + footprint_spec[i].y * cos_th);
     if(!costmap.worldToMap(new_x, new_y, x0, y0)) {
-      return footprint_cells;
+      return;
     }
 
     //find the cell coordinates of the second segment point
     new_x = x_i + (footprint_spec[i + 1].x * cos_th - footprint_spec[i + 1].y * sin_th);
     new_y = y_i + (footprint_spec[i + 1].x * sin_th + footprint_spec[i + 1].y * cos_th);
     if (!costmap.worldToMap(new_x, new_y, x1, y1)) {
-      return footprint_cells;
+      return;
     }
 
     getLineCells(x0, x1, y0, y1, footprint_cells);
@@ -228,12 +239,12 @@ std::vector<base_local_planner::Position2DInt> FootprintHelper::getFootprintCell
   new_x = x_i + (footprint_spec[last_index].x * cos_th - footprint_spec[last_index].y * sin_th);
   new_y = y_i + (footprint_spec[last_index].x * sin_th + footprint_spec[last_index].y * cos_th);
   if (!costmap.worldToMap(new_x, new_y, x0, y0)) {
-    return footprint_cells;
+    return;
   }
   new_x = x_i + (footprint_spec[0].x * cos_th - footprint_spec[0].y * sin_th);
   new_y = y_i + (footprint_spec[0].x * sin_th + footprint_spec[0].y * cos_th);
   if(!costmap.worldToMap(new_x, new_y, x1, y1)) {
-    return footprint_cells;
+    return;
   }
 
   getLineCells(x0, x1, y0, y1, footprint_cells);
@@ -241,8 +252,6 @@ std::vector<base_local_planner::Position2DInt> FootprintHelper::getFootprintCell
   if(fill) {
     getFillCells(footprint_cells);
   }
-
-  return footprint_cells;
 }
 
 } /* namespace base_local_planner */
@@ -67,6 +67,15 @@ namespace base_local_planner {
   }
 
   void prunePlan(const tf::Stamped<tf::Pose>& global_pose, std::vector<geometry_msgs::PoseStamped>& plan, std::vector<geometry_msgs::PoseStamped>& global_plan){
+    unsigned int plan_start = 0;
+    prunePlan(global_pose, plan, plan_start);
+    if (plan_start > 0)
+    {
+        global_plan.erase(global_plan.begin(), global_plan.begin() + plan_start);
+    }
+  }
+
+  void prunePlan(const tf::Stamped<tf::Pose>& global_pose, std::vector<geometry_msgs::PoseStamped>& plan, unsigned int& plan_start){
     double min_plan_sq_dist = 1e6;
     int current_waypoint_index = -1;
 
@@ -79,11 +88,11 @@ namespace base_local_planner {
         }
     }
 
-    //! Prune the plan
-    if (current_waypoint_index >= 0)
+    //! Prune the plan, the global plan only by moving past its start
+    if (current_waypoint_index > 0)
     {
-        plan = std::vector<geometry_msgs::PoseStamped>(plan.begin()+current_waypoint_index, plan.end());
-        global_plan = std::vector<geometry_msgs::PoseStamped>(global_plan.begin()+current_waypoint_index, global_plan.end());
+        plan.erase(plan.begin(), plan.begin() + current_waypoint_index);
+        plan_start += current_waypoint_index;
     }
   }
 
@@ -103,7 +112,7 @@ namespace base_local_planner {
           }
       }
 
-      new_plan = std::vector<geometry_msgs::PoseStamped>(plan.begin()+target_waypoint_index, plan.end());
+      new_plan.assign(plan.begin()+target_waypoint_index, plan.end());
 
   }
 
@@ -114,15 +123,27 @@ namespace base_local_planner {
       const costmap_2d::Costmap2D& costmap,
       const std::string& global_frame,
       std::vector<geometry_msgs::PoseStamped>& transformed_plan){
-    const geometry_msgs::PoseStamped& plan_pose = global_plan[0];
+    return transformGlobalPlan(tf, global_plan, 0, global_pose, costmap, global_frame, transformed_plan);
+  }
 
-    transformed_plan.clear();
+  bool transformGlobalPlan(
+      const tf::TransformListener& tf,
+      const std::vector<geometry_msgs::PoseStamped>& global_plan,
+      unsigned int plan_start,
+      const tf::Stamped<tf::Pose>& global_pose,
+      const costmap_2d::Costmap2D& costmap,
+      const std::string& global_frame,
+      std::vector<geometry_msgs::PoseStamped>& transformed_plan){
+    // the poses already in transformed_plan are overwritten, so their storage is reused
+    unsigned int transformed_size = 0;
 
     try {
-      if (!global_plan.size() > 0) {
+      if (plan_start >= global_plan.size()) {
         ROS_ERROR("Received plan with zero length");
+        transformed_plan.clear();
         return false;
       }
+      const geometry_msgs::PoseStamped& plan_pose = global_plan[plan_start];
 
       // get plan_to_global_transform from plan frame to global_frame
       tf::StampedTransform plan_to_global_transform;
@@ -138,7 +159,7 @@ namespace base_local_planner {
       double dist_threshold = std::max(costmap.getSizeInCellsX() * costmap.getResolution() / 2.0,
                                        costmap.getSizeInCellsY() * costmap.getResolution() / 2.0);
 
-      unsigned int i = 0;
+      unsigned int i = plan_start;
       double sq_dist_threshold = dist_threshold * dist_threshold;
       double sq_dist = 0;
 
@@ -154,7 +175,6 @@ namespace base_local_planner {
       }
 
       tf::Stamped<tf::Pose> tf_pose;
-      geometry_msgs::PoseStamped newer_pose;
 
       //now we'll transform until points are outside of our distance threshold
       while(i < (unsigned int)global_plan.size() && sq_dist <= sq_dist_threshold) {
@@ -163,9 +183,10 @@ namespace base_local_planner {
         tf_pose.setData(plan_to_global_transform * tf_pose);
         tf_pose.stamp_ = plan_to_global_transform.stamp_;
         tf_pose.frame_id_ = global_frame;
-        poseStampedTFToMsg(tf_pose, newer_pose);
-
-        transformed_plan.push_back(newer_pose);
+        if (transformed_size == transformed_plan.size()) {
+          transformed_plan.push_back(geometry_msgs::PoseStamped());
+        }
+        poseStampedTFToMsg(tf_pose, transformed_plan[transformed_size++]);
 
         double x_diff = robot_pose.getOrigin().x() - global_plan[i].pose.position.x;
         double y_diff = robot_pose.getOrigin().y() - global_plan[i].pose.position.y;
@@ -176,10 +197,12 @@ namespace base_local_planner {
     }
     catch(tf::LookupException& ex) {
       ROS_ERROR("No Transform available Error: %s\n", ex.what());
+      transformed_plan.clear();
       return false;
     }
     catch(tf::ConnectivityException& ex) {
       ROS_ERROR("Connectivity Error: %s\n", ex.what());
+      transformed_plan.clear();
       return false;
     }
     catch(tf::ExtrapolationException& ex) {
@@ -187,9 +210,11 @@ namespace base_local_planner {
       if (global_plan.size() > 0)
         ROS_ERROR("Global Frame: %s Plan Frame size %d: %s\n", global_frame.c_str(), (unsigned int)global_plan.size(), global_plan[0].header.frame_id.c_str());
 
+      transformed_plan.clear();
       return false;
     }
 
+    transformed_plan.resize(transformed_size);
     return true;
   }
 
@@ -24,10 +24,43 @@ LatchedStopRotateController::LatchedStopRotateController(const std::string& name
   private_nh.param("latch_xy_goal_tolerance", latch_xy_goal_tolerance_, false);
 
   rotating_to_goal_ = false;
+  swept_model_ = NULL;
+}
+
+LatchedStopRotateController::LatchedStopRotateController(bool latch_xy_goal_tolerance) {
+  latch_xy_goal_tolerance_ = latch_xy_goal_tolerance;
+
+  rotating_to_goal_ = false;
+  swept_model_ = NULL;
 }
 
 LatchedStopRotateController::~LatchedStopRotateController() {}
 
+bool LatchedStopRotateController::sweptCheck(const tf::Stamped<tf::Pose>& global_pose,
+    const tf::Stamped<tf::Pose>& robot_vel,
+    Eigen::Vector3f acc_lim,
+    double vx, double vy) {
+  if (swept_model_ == NULL || vx != 0.0 || vy != 0.0) {
+    return false;
+  }
+
+  //braking to a stop at the acceleration limits, the robot cannot get further than this
+  double drift[2];
+  double vel[2] = {robot_vel.getOrigin().getX(), robot_vel.getOrigin().getY()};
+  for (unsigned int i = 0; i < 2; ++i) {
+    if (vel[i] == 0.0) {
+      drift[i] = 0.0;
+    } else if (acc_lim[i] > 0.0) {
+      drift[i] = vel[i] * vel[i] / (2 * acc_lim[i]);
+    } else {
+      return false;
+    }
+  }
+
+  return swept_model_->sweptFootprintCost(global_pose.getOrigin().getX(), global_pose.getOrigin().getY(),
+      swept_footprint_, hypot(drift[0], drift[1])) >= 0.0;
+}
+
 
 /**
  * returns true if we have passed the goal position.
@@ -124,9 +157,10 @@ bool LatchedStopRotateController::stopWithAccLimits(const tf::Stamped<tf::Pose>&
 
   //we do want to check whether or not the command is valid
   double yaw = tf::getYaw(global_pose.getRotation());
-  bool valid_cmd = obstacle_check(Eigen::Vector3f(global_pose.getOrigin().getX(), global_pose.getOrigin().getY(), yaw),
-                                  Eigen::Vector3f(robot_vel.getOrigin().getX(), robot_vel.getOrigin().getY(), vel_yaw),
-                                  Eigen::Vector3f(vx, vy, vth));
+  bool valid_cmd = sweptCheck(global_pose, robot_vel, acc_lim, vx, vy)
+      || obstacle_check(Eigen::Vector3f(global_pose.getOrigin().getX(), global_pose.getOrigin().getY(), yaw),
+                        Eigen::Vector3f(robot_vel.getOrigin().getX(), robot_vel.getOrigin().getY(), vel_yaw),
+                        Eigen::Vector3f(vx, vy, vth));
 
   //if we have a valid command, we'll pass it on, otherwise we'll command all zeros
   if(valid_cmd){
@@ -179,9 +213,10 @@ bool LatchedStopRotateController::rotateToGoal(
   }
 
   //we still want to lay down the footprint of the robot and check if the action is legal
-  bool valid_cmd = obstacle_check(Eigen::Vector3f(global_pose.getOrigin().getX(), global_pose.getOrigin().getY(), yaw),
-      Eigen::Vector3f(robot_vel.getOrigin().getX(), robot_vel.getOrigin().getY(), vel_yaw),
-      Eigen::Vector3f( 0.0, 0.0, v_theta_samp));
+  bool valid_cmd = sweptCheck(global_pose, robot_vel, acc_lim, 0.0, 0.0)
+      || obstacle_check(Eigen::Vector3f(global_pose.getOrigin().getX(), global_pose.getOrigin().getY(), yaw),
+          Eigen::Vector3f(robot_vel.getOrigin().getX(), robot_vel.getOrigin().getY(), vel_yaw),
+          Eigen::Vector3f( 0.0, 0.0, v_theta_samp));
 
   if (valid_cmd) {
     ROS_DEBUG_NAMED("dwa_local_planner", "Moving to desired goal orientation, th cmd: %.2f, valid_cmd: %d", v_theta_samp, valid_cmd);
@@ -38,6 +38,7 @@
 #include <base_local_planner/local_planner_util.h>
 
 #include <base_local_planner/goal_functions.h>
+#include <algorithm>
 
 namespace base_local_planner {
 
@@ -76,14 +77,25 @@ costmap_2d::Costmap2D* LocalPlannerUtil::getCostmap() {
 
 LocalPlannerLimits LocalPlannerUtil::getCurrentLimits() {
   boost::mutex::scoped_lock l(limits_configuration_mutex_);
-  return limits_;
+  LocalPlannerLimits limits = limits_;
+  if(speed_limit_trans_ >= 0.0)
+    limits.max_trans_vel = std::min(limits.max_trans_vel, speed_limit_trans_);
+  if(speed_limit_rot_ >= 0.0)
+    limits.max_rot_vel = std::min(limits.max_rot_vel, speed_limit_rot_);
+  return limits;
+}
+
+void LocalPlannerUtil::setSpeedLimit(double max_trans_vel, double max_rot_vel) {
+  boost::mutex::scoped_lock l(limits_configuration_mutex_);
+  speed_limit_trans_ = max_trans_vel;
+  speed_limit_rot_ = max_rot_vel;
 }
 
 
 bool LocalPlannerUtil::getGoal(tf::Stamped<tf::Pose>& goal_pose) {
   //we assume the global goal is the last point in the global plan
   return base_local_planner::getGoalPose(*tf_,
-        global_plan_,
+        *global_plan_,
         global_frame_,
         goal_pose);
 }
@@ -95,9 +107,25 @@ bool LocalPlannerUtil::setPlan(const std::vector<geometry_msgs::PoseStamped>& or
   }
 
   //reset the global plan
-  global_plan_.clear();
+  global_plan_.reset(new std::vector<geometry_msgs::PoseStamped>(orig_global_plan));
+  plan_version_ = 0;
+  plan_start_ = 0;
+
+  return true;
+}
+
+bool LocalPlannerUtil::setPlan(const nav_core::PlanConstPtr& plan, unsigned int version) {
+  if(!initialized_){
+    ROS_ERROR("Planner utils have not been initialized, please call initialize() first");
+    return false;
+  }
+
+  if(version != 0 && version == plan_version_ && plan == global_plan_)
+    return true;
 
-  global_plan_ = orig_global_plan;
+  global_plan_ = plan;
+  plan_version_ = version;
+  plan_start_ = 0;
 
   return true;
 }
@@ -106,7 +134,8 @@ bool LocalPlannerUtil::getLocalPlan(tf::Stamped<tf::Pose>& global_pose, std::vec
   //get the global plan in our frame
   if(!base_local_planner::transformGlobalPlan(
       *tf_,
-      global_plan_,
+      *global_plan_,
+      plan_start_,
       global_pose,
       *costmap_,
       global_frame_,
@@ -117,7 +146,7 @@ bool LocalPlannerUtil::getLocalPlan(tf::Stamped<tf::Pose>& global_pose, std::vec
 
   //now we'll prune the plan based on the position of the robot
   if(limits_.prune_plan)
-    base_local_planner::prunePlan(global_pose, transformed_plan, global_plan_);
+    base_local_planner::prunePlan(global_pose, transformed_plan, plan_start_);
 
   return true;
 }
@@ -33,17 +33,31 @@
  *********************************************************************/
 #include <base_local_planner/map_grid.h>
 #include <costmap_2d/cost_values.h>
+#include <cmath>
+#include <cstdlib>
 using namespace std;
 
+namespace {
+  // flags of the seed and obstacle state of a cell
+  const unsigned char SEED_CELL = 1;
+  const unsigned char OBSTACLE_CELL = 2;
+  const unsigned char ENTERED_CELL = 4; ///< @brief The cell was outside the grid at the last propagation
+
+  // scratch marks of the incremental update
+  const unsigned char INVALID_CELL = 1;
+}
+
 namespace base_local_planner{
 
   MapGrid::MapGrid()
-    : size_x_(0), size_y_(0)
+    : size_x_(0), size_y_(0), incremental_(false), field_valid_(false),
+      field_origin_x_(0.0), field_origin_y_(0.0), field_resolution_(0.0)
   {
   }
 
   MapGrid::MapGrid(unsigned int size_x, unsigned int size_y) 
-    : size_x_(size_x), size_y_(size_y)
+    : size_x_(size_x), size_y_(size_y), incremental_(false), field_valid_(false),
+      field_origin_x_(0.0), field_origin_y_(0.0), field_resolution_(0.0)
   {
     commonInit();
   }
@@ -52,11 +66,17 @@ namespace base_local_planner{
     size_y_ = mg.size_y_;
     size_x_ = mg.size_x_;
     map_ = mg.map_;
+    incremental_ = mg.incremental_;
+    field_valid_ = false;
+    field_origin_x_ = field_origin_y_ = field_resolution_ = 0.0;
   }
 
   void MapGrid::commonInit(){
     //don't allow construction of zero size grid
     ROS_ASSERT(size_y_ != 0 && size_x_ != 0);
+    //cells store their coordinates in 16 bits
+    ROS_ASSERT(size_x_ <= std::numeric_limits<unsigned short>::max() &&
+        size_y_ <= std::numeric_limits<unsigned short>::max());
 
     map_.resize(size_y_ * size_x_);
 
@@ -78,6 +98,8 @@ namespace base_local_planner{
     size_y_ = mg.size_y_;
     size_x_ = mg.size_x_;
     map_ = mg.map_;
+    incremental_ = mg.incremental_;
+    field_valid_ = false;
     return *this;
   }
 
@@ -86,6 +108,9 @@ namespace base_local_planner{
       map_.resize(size_x * size_y);
 
     if(size_x_ != size_x || size_y_ != size_y){
+      ROS_ASSERT(size_x <= std::numeric_limits<unsigned short>::max() &&
+          size_y <= std::numeric_limits<unsigned short>::max());
+      field_valid_ = false;
       size_x_ = size_x;
       size_y_ = size_y;
 
@@ -105,7 +130,7 @@ namespace base_local_planner{
 
     //if the cell is an obstacle set the max path distance
     unsigned char cost = costmap.getCost(check_cell->cx, check_cell->cy);
-    if(! getCell(check_cell->cx, check_cell->cy).within_robot &&
+    if(! check_cell->within_robot &&
         (cost == costmap_2d::LETHAL_OBSTACLE ||
          cost == costmap_2d::INSCRIBED_INFLATED_OBSTACLE)){
       check_cell->target_dist = obstacleCosts();
@@ -122,6 +147,13 @@ namespace base_local_planner{
 
   //reset the path_dist and goal_dist fields for all cells
   void MapGrid::resetPathDist(){
+    if (incremental_ && field_valid_) {
+      //keep the distances for the incremental update
+      for(unsigned int i = 0; i < map_.size(); ++i) {
+        map_[i].within_robot = false;
+      }
+      return;
+    }
     for(unsigned int i = 0; i < map_.size(); ++i) {
       map_[i].target_dist = unreachableCellCosts();
       map_[i].target_mark = false;
@@ -129,6 +161,19 @@ namespace base_local_planner{
     }
   }
 
+  void MapGrid::clearField(){
+    field_valid_ = false;
+    for(unsigned int i = 0; i < map_.size(); ++i) {
+      map_[i].target_dist = unreachableCellCosts();
+      map_[i].target_mark = false;
+    }
+  }
+
+  void MapGrid::setIncremental(bool incremental){
+    incremental_ = incremental;
+    field_valid_ = false;
+  }
+
   void MapGrid::adjustPlanResolution(const std::vector<geometry_msgs::PoseStamped>& global_plan_in,
       std::vector<geometry_msgs::PoseStamped>& global_plan_out, double resolution) {
     if (global_plan_in.size() == 0) {
@@ -174,9 +219,12 @@ namespace base_local_planner{
 
     bool started_path = false;
 
-    queue<MapCell*> path_dist_queue;
+    //reused across cycles, so setting the target does not allocate
+    std::vector<unsigned int>& seeds = seeds_;
+    seeds.clear();
 
-    std::vector<geometry_msgs::PoseStamped> adjusted_global_plan;
+    std::vector<geometry_msgs::PoseStamped>& adjusted_global_plan = adjusted_plan_;
+    adjusted_global_plan.clear();
     adjustPlanResolution(global_plan, adjusted_global_plan, costmap.getResolution());
     if (adjusted_global_plan.size() != global_plan.size()) {
       ROS_DEBUG("Adjusted global plan resolution, added %zu points", adjusted_global_plan.size() - global_plan.size());
@@ -188,10 +236,7 @@ namespace base_local_planner{
       double g_y = adjusted_global_plan[i].pose.position.y;
       unsigned int map_x, map_y;
       if (costmap.worldToMap(g_x, g_y, map_x, map_y) && costmap.getCost(map_x, map_y) != costmap_2d::NO_INFORMATION) {
-        MapCell& current = getCell(map_x, map_y);
-        current.target_dist = 0.0;
-        current.target_mark = true;
-        path_dist_queue.push(&current);
+        seeds.push_back(getIndex(map_x, map_y));
         started_path = true;
       } else if (started_path) {
           break;
@@ -200,10 +245,13 @@ namespace base_local_planner{
     if (!started_path) {
       ROS_ERROR("None of the %d first of %zu (%zu) points of the global plan were in the local costmap and free",
           i, adjusted_global_plan.size(), global_plan.size());
+      if (incremental_) {
+        clearField();
+      }
       return;
     }
 
-    computeTargetDistance(path_dist_queue, costmap);
+    propagateTargetDistance(seeds, costmap);
   }
 
   //mark the point of the costmap as local goal where global_plan first leaves the area (or its last point)
@@ -215,7 +263,8 @@ namespace base_local_planner{
     int local_goal_y = -1;
     bool started_path = false;
 
-    std::vector<geometry_msgs::PoseStamped> adjusted_global_plan;
+    std::vector<geometry_msgs::PoseStamped>& adjusted_global_plan = adjusted_plan_;
+    adjusted_global_plan.clear();
     adjustPlanResolution(global_plan, adjusted_global_plan, costmap.getResolution());
 
     // skip global path points until we reach the border of the local map
@@ -235,19 +284,296 @@ namespace base_local_planner{
     }
     if (!started_path) {
       ROS_ERROR("None of the points of the global plan were in the local costmap, global plan points too far from robot");
+      if (incremental_) {
+        clearField();
+      }
       return;
     }
 
-    queue<MapCell*> path_dist_queue;
+    std::vector<unsigned int>& seeds = seeds_;
+    seeds.clear();
     if (local_goal_x >= 0 && local_goal_y >= 0) {
-      MapCell& current = getCell(local_goal_x, local_goal_y);
       costmap.mapToWorld(local_goal_x, local_goal_y, goal_x_, goal_y_);
+      seeds.push_back(getIndex(local_goal_x, local_goal_y));
+    }
+
+    propagateTargetDistance(seeds, costmap);
+  }
+
+  void MapGrid::propagateTargetDistance(const std::vector<unsigned int>& seeds, const costmap_2d::Costmap2D& costmap){
+    if (incremental_) {
+      //the states the cells are propagated under, as checked by updatePathCell
+      new_cell_state_.assign(map_.size(), 0);
+      for (unsigned int i = 0; i < map_.size(); ++i) {
+        unsigned char cost = costmap.getCost(map_[i].cx, map_[i].cy);
+        if (!map_[i].within_robot &&
+            (cost == costmap_2d::LETHAL_OBSTACLE || cost == costmap_2d::INSCRIBED_INFLATED_OBSTACLE)) {
+          new_cell_state_[i] = OBSTACLE_CELL;
+        }
+      }
+      for (unsigned int i = 0; i < seeds.size(); ++i) {
+        new_cell_state_[seeds[i]] |= SEED_CELL;
+      }
+
+      bool updated = field_valid_ && updateTargetDistance(seeds, costmap);
+      if (!updated) {
+        clearField();
+      }
+      cell_state_.swap(new_cell_state_);
+      field_origin_x_ = costmap.getOriginX();
+      field_origin_y_ = costmap.getOriginY();
+      field_resolution_ = costmap.getResolution();
+      field_valid_ = true;
+      if (updated) {
+        return;
+      }
+    }
+
+    queue<MapCell*> dist_queue;
+    for (unsigned int i = 0; i < seeds.size(); ++i) {
+      MapCell& current = map_[seeds[i]];
       current.target_dist = 0.0;
       current.target_mark = true;
-      path_dist_queue.push(&current);
+      dist_queue.push(&current);
+    }
+
+    computeTargetDistance(dist_queue, costmap);
+  }
+
+  void MapGrid::shiftField(int dx, int dy){
+    if (dx == 0 && dy == 0) {
+      return;
+    }
+    //cell (x, y) of the new window was cell (x + dx, y + dy) of the old one, move the overlap in place
+    //like Costmap2D::updateOrigin, walking so that no source cell is overwritten before it is moved
+    int step_x = dx >= 0 ? 1 : -1;
+    int step_y = dy >= 0 ? 1 : -1;
+    int y = step_y > 0 ? 0 : size_y_ - 1;
+    for (unsigned int i = 0; i < size_y_; ++i, y += step_y) {
+      int source_y = y + dy;
+      int x = step_x > 0 ? 0 : size_x_ - 1;
+      for (unsigned int j = 0; j < size_x_; ++j, x += step_x) {
+        int source_x = x + dx;
+        unsigned int index = getIndex(x, y);
+        if (source_x < 0 || source_x >= (int)size_x_ || source_y < 0 || source_y >= (int)size_y_) {
+          //newly exposed cells are reached by the update
+          map_[index].target_dist = unreachableCellCosts();
+          cell_state_[index] = ENTERED_CELL;
+        } else {
+          unsigned int source = getIndex(source_x, source_y);
+          map_[index].target_dist = map_[source].target_dist;
+          cell_state_[index] = cell_state_[source];
+        }
+        map_[index].target_mark = map_[index].target_dist < unreachableCellCosts();
+      }
+    }
+  }
+
+  inline unsigned int MapGrid::getNeighbors(unsigned int index, unsigned int* neighbors) const {
+    unsigned int count = 0;
+    const MapCell& cell = map_[index];
+    if (cell.cx > 0) {
+      neighbors[count++] = index - 1;
     }
+    if (cell.cx < size_x_ - 1) {
+      neighbors[count++] = index + 1;
+    }
+    if (cell.cy > 0) {
+      neighbors[count++] = index - size_x_;
+    }
+    if (cell.cy < size_y_ - 1) {
+      neighbors[count++] = index + size_x_;
+    }
+    return count;
+  }
+
+  inline bool MapGrid::isExpanded(unsigned int index) const {
+    if (new_cell_state_[index] & SEED_CELL) {
+      return true;
+    }
+    return !(new_cell_state_[index] & OBSTACLE_CELL) && !(cell_flags_[index] & INVALID_CELL) &&
+        map_[index].target_dist < map_.size();
+  }
+
+  inline void MapGrid::pushBucket(unsigned int index, double dist){
+    if (dist >= map_.size()) {
+      return;
+    }
+    unsigned int bucket = (unsigned int)dist;
+    if (bucket >= buckets_.size()) {
+      buckets_.resize(bucket + 1);
+    }
+    buckets_[bucket].push_back(index);
+  }
 
-    computeTargetDistance(path_dist_queue, costmap);
+  void MapGrid::invalidateCell(unsigned int index){
+    cell_flags_[index] |= INVALID_CELL;
+    dirty_cells_.push_back(index);
+    unsigned int neighbors[4];
+    unsigned int num_neighbors = getNeighbors(index, neighbors);
+    for (unsigned int j = 0; j < num_neighbors; ++j) {
+      unsigned int n = neighbors[j];
+      if (new_cell_state_[n] == 0 && map_[n].target_dist == map_[index].target_dist + 1) {
+        pushBucket(n, map_[n].target_dist);
+      }
+    }
+  }
+
+  bool MapGrid::updateTargetDistance(const std::vector<unsigned int>& seeds, const costmap_2d::Costmap2D& costmap){
+    if (cell_state_.size() != map_.size() || costmap.getResolution() != field_resolution_) {
+      return false;
+    }
+    //the costmap window only moves by whole cells
+    double shift_x = (costmap.getOriginX() - field_origin_x_) / field_resolution_;
+    double shift_y = (costmap.getOriginY() - field_origin_y_) / field_resolution_;
+    int dx = (int)floor(shift_x + 0.5);
+    int dy = (int)floor(shift_y + 0.5);
+    if (fabs(shift_x - dx) > 1e-3 || fabs(shift_y - dy) > 1e-3 ||
+        abs(dx) >= (int)size_x_ || abs(dy) >= (int)size_y_) {
+      return false;
+    }
+    shiftField(dx, dy);
+
+    unsigned int size = map_.size();
+    cell_flags_.assign(size, 0);
+    dirty_cells_.clear();
+    for (unsigned int d = 0; d < buckets_.size(); ++d) {
+      buckets_[d].clear();
+    }
+
+    //drop the distances of cells that can no longer hold them, and queue the ones that may have lost their support
+    unsigned int num_changes = 0;
+    bool kept_seed = false;
+    for (unsigned int i = 0; i < size; ++i) {
+      unsigned char old_state = cell_state_[i];
+      unsigned char new_state = new_cell_state_[i];
+      if (old_state == new_state) {
+        kept_seed = kept_seed || (new_state & SEED_CELL);
+        continue;
+      }
+      ++num_changes;
+      dirty_cells_.push_back(i);
+      if ((old_state & ENTERED_CELL) || (new_state & SEED_CELL)) {
+        continue;
+      }
+      MapCell& cell = map_[i];
+      bool was_expanded = (old_state & SEED_CELL) || (!(old_state & OBSTACLE_CELL) && cell.target_dist < size);
+      if (new_state & OBSTACLE_CELL) {
+        if (was_expanded) {
+          invalidateCell(i);
+        }
+      } else if (old_state & SEED_CELL) {
+        pushBucket(i, cell.target_dist);
+      } else {
+        //a freed obstacle gets reached from its neighbors
+        cell.target_dist = unreachableCellCosts();
+      }
+    }
+
+    //a field that moved along with its seeds is cheaper to recompute
+    if (num_changes > size / 4 || (!seeds.empty() && !kept_seed)) {
+      return false;
+    }
+
+    //the cells on the side the window moved away from lost the neighbors outside
+    if (dx != 0) {
+      unsigned int x = dx > 0 ? 0 : size_x_ - 1;
+      for (unsigned int y = 0; y < size_y_; ++y) {
+        dirty_cells_.push_back(getIndex(x, y));
+        pushBucket(getIndex(x, y), map_[getIndex(x, y)].target_dist);
+      }
+    }
+    if (dy != 0) {
+      unsigned int y = dy > 0 ? 0 : size_y_ - 1;
+      for (unsigned int x = 0; x < size_x_; ++x) {
+        dirty_cells_.push_back(getIndex(x, y));
+        pushBucket(getIndex(x, y), map_[getIndex(x, y)].target_dist);
+      }
+    }
+
+    //in order of distance, a cell keeps its distance only if a valid neighbor is one closer
+    unsigned int neighbors[4];
+    for (unsigned int d = 0; d < buckets_.size(); ++d) {
+      for (unsigned int k = 0; k < buckets_[d].size(); ++k) {
+        unsigned int i = buckets_[d][k];
+        if ((cell_flags_[i] & INVALID_CELL) || new_cell_state_[i] != 0 || map_[i].target_dist != d) {
+          continue;
+        }
+        bool supported = false;
+        unsigned int num_neighbors = getNeighbors(i, neighbors);
+        for (unsigned int j = 0; j < num_neighbors && !supported && d > 0; ++j) {
+          supported = isExpanded(neighbors[j]) && map_[neighbors[j]].target_dist == d - 1;
+        }
+        if (!supported) {
+          invalidateCell(i);
+        }
+      }
+      buckets_[d].clear();
+    }
+
+    //propagate from the seeds and the valid cells bordering the changes
+    unsigned int num_dirty = dirty_cells_.size();
+    for (unsigned int k = 0; k < num_dirty; ++k) {
+      unsigned int i = dirty_cells_[k];
+      if (cell_flags_[i] & INVALID_CELL) {
+        cell_flags_[i] = 0;
+        map_[i].target_dist = unreachableCellCosts();
+      }
+    }
+    for (unsigned int i = 0; i < seeds.size(); ++i) {
+      map_[seeds[i]].target_dist = 0.0;
+      pushBucket(seeds[i], 0.0);
+    }
+    for (unsigned int k = 0; k < num_dirty; ++k) {
+      unsigned int num_neighbors = getNeighbors(dirty_cells_[k], neighbors);
+      for (unsigned int j = 0; j < num_neighbors; ++j) {
+        if (isExpanded(neighbors[j])) {
+          pushBucket(neighbors[j], map_[neighbors[j]].target_dist);
+        }
+      }
+    }
+    for (unsigned int d = 0; d < buckets_.size(); ++d) {
+      for (unsigned int k = 0; k < buckets_[d].size(); ++k) {
+        unsigned int i = buckets_[d][k];
+        if (map_[i].target_dist != d) {
+          continue;
+        }
+        unsigned int num_neighbors = getNeighbors(i, neighbors);
+        for (unsigned int j = 0; j < num_neighbors; ++j) {
+          unsigned int n = neighbors[j];
+          if (new_cell_state_[n] == OBSTACLE_CELL || map_[n].target_dist <= d + 1) {
+            continue;
+          }
+          map_[n].target_dist = d + 1;
+          dirty_cells_.push_back(n);
+          pushBucket(n, d + 1);
+        }
+      }
+      buckets_[d].clear();
+    }
+
+    //obstacle cells next to a changed cell are marked if the wavefront reaches them
+    unsigned int cells[5];
+    for (unsigned int k = 0; k < dirty_cells_.size(); ++k) {
+      unsigned int num_cells = getNeighbors(dirty_cells_[k], cells);
+      cells[num_cells++] = dirty_cells_[k];
+      for (unsigned int j = 0; j < num_cells; ++j) {
+        unsigned int i = cells[j];
+        if (new_cell_state_[i] == OBSTACLE_CELL) {
+          unsigned int obstacle_neighbors[4];
+          unsigned int num_obstacle_neighbors = getNeighbors(i, obstacle_neighbors);
+          map_[i].target_dist = unreachableCellCosts();
+          for (unsigned int m = 0; m < num_obstacle_neighbors; ++m) {
+            if (isExpanded(obstacle_neighbors[m])) {
+              map_[i].target_dist = obstacleCosts();
+              break;
+            }
+          }
+        }
+        map_[i].target_mark = map_[i].target_dist < unreachableCellCosts();
+      }
+    }
+    return true;
   }
 
 
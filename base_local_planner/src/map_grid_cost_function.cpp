@@ -57,6 +57,10 @@ void MapGridCostFunction::setTargetPoses(std::vector<geometry_msgs::PoseStamped>
 }
 
 bool MapGridCostFunction::prepare() {
+  // the distances are only read when scoring, skip propagating them while the planner does not consult us
+  if (getScale() == 0) {
+    return true;
+  }
   map_.resetPathDist();
 
   if (is_local_goal_function_) {
@@ -96,7 +100,7 @@ double MapGridCostFunction::scoreTrajectory(Trajectory &traj) {
     }
 
     //we won't allow trajectories that go off the map... shouldn't happen that often anyways
-    if ( ! costmap_->worldToMap(px, py, cell_x, cell_y)) {
+    if ( ! costmap_->worldToMapFast(px, py, cell_x, cell_y)) {
       //we're off the map
       ROS_WARN("Off Map %f, %f", px, py);
       return -4.0;
@@ -33,6 +33,7 @@
  *********************************************************************/
 #include <base_local_planner/map_grid_visualizer.h>
 #include <base_local_planner/map_cell.h>
+#include <algorithm>
 #include <vector>
 
 #include <pcl_conversions/pcl_conversions.h>
@@ -50,9 +51,14 @@ namespace base_local_planner {
     cost_cloud_ = new pcl::PointCloud<MapGridCostPoint>;
     cost_cloud_->header.frame_id = frame_id;
     pub_.advertise(ns_nh_, "cost_cloud", 1);
+    ns_nh_.param("cost_cloud_stride", stride_, 1);
+    stride_ = std::max(stride_, 1);
   }
 
   void MapGridVisualizer::publishCostCloud(const costmap_2d::Costmap2D* costmap_p_) {
+    if (pub_.getNumSubscribers() == 0) {
+      return;
+    }
     unsigned int x_size = costmap_p_->getSizeInCellsX();
     unsigned int y_size = costmap_p_->getSizeInCellsY();
     double z_coord = 0.0;
@@ -63,8 +69,8 @@ namespace base_local_planner {
     header.stamp = ros::Time::now();
     cost_cloud_->header = pcl_conversions::toPCL(header);
     float path_cost, goal_cost, occ_cost, total_cost;
-    for (unsigned int cx = 0; cx < x_size; cx++) {
-      for (unsigned int cy = 0; cy < y_size; cy++) {
+    for (unsigned int cx = 0; cx < x_size; cx += stride_) {
+      for (unsigned int cy = 0; cy < y_size; cy += stride_) {
         costmap_p_->mapToWorld(cx, cy, x_coord, y_coord);
         if (cost_function_(cx, cy, path_cost, goal_cost, occ_cost, total_cost)) {
           pt.x = x_coord;
@@ -43,7 +43,9 @@
 namespace base_local_planner {
 
 ObstacleCostFunction::ObstacleCostFunction(costmap_2d::Costmap2D* costmap) 
-    : costmap_(costmap), sum_scores_(false) {
+    : costmap_(costmap), world_model_(NULL), sum_scores_(false), inscribed_cost_(0), circumscribed_cost_(0),
+      cache_enabled_(false), cache_cycle_(0), cache_origin_x_(0.0), cache_origin_y_(0.0), cache_resolution_(0.0),
+      footprint_radius_(0.0) {
   if (costmap != NULL) {
     world_model_ = new base_local_planner::CostmapModel(*costmap_);
   }
@@ -61,26 +63,121 @@ void ObstacleCostFunction::setParams(double max_trans_vel, double max_scaling_fa
   max_trans_vel_ = max_trans_vel;
   max_scaling_factor_ = max_scaling_factor;
   scaling_speed_ = scaling_speed;
+  clearTrajectoryCache();
 }
 
 void ObstacleCostFunction::setFootprint(std::vector<geometry_msgs::Point> footprint_spec) {
+  // called every cycle, only a different footprint changes the cached scores
+  bool changed = footprint_spec.size() != footprint_spec_.size();
+  for (unsigned int i = 0; !changed && i < footprint_spec.size(); ++i) {
+    changed = footprint_spec[i].x != footprint_spec_[i].x || footprint_spec[i].y != footprint_spec_[i].y;
+  }
+  if (!changed) {
+    return;
+  }
   footprint_spec_ = footprint_spec;
+  footprint_radius_ = 0.0;
+  for (unsigned int i = 0; i < footprint_spec_.size(); ++i) {
+    footprint_radius_ = std::max(footprint_radius_, hypot(footprint_spec_[i].x, footprint_spec_[i].y));
+  }
+  clearTrajectoryCache();
+}
+
+void ObstacleCostFunction::setFootprintMasks(unsigned int headings) {
+  if (world_model_ != NULL) {
+    world_model_->setFootprintMasks(headings);
+  }
+  clearTrajectoryCache();
+}
+
+void ObstacleCostFunction::setInflationThresholds(unsigned char inscribed_cost, unsigned char circumscribed_cost) {
+  if (inscribed_cost == inscribed_cost_ && circumscribed_cost == circumscribed_cost_) {
+    return;
+  }
+  inscribed_cost_ = inscribed_cost;
+  circumscribed_cost_ = circumscribed_cost;
+  if (world_model_ != NULL) {
+    world_model_->setInflationThresholds(inscribed_cost, circumscribed_cost);
+  }
+  clearTrajectoryCache();
+}
+
+void ObstacleCostFunction::setTrajectoryCache(bool enabled) {
+  cache_enabled_ = enabled;
+  clearTrajectoryCache();
+}
+
+void ObstacleCostFunction::clearTrajectoryCache() {
+  boost::mutex::scoped_lock lock(cache_mutex_);
+  cache_.clear();
+}
+
+void ObstacleCostFunction::invalidateTrajectoryCache(unsigned int x0, unsigned int xn, unsigned int y0, unsigned int yn) {
+  boost::mutex::scoped_lock lock(cache_mutex_);
+  std::map<CacheKey, CachedTrajectory>::iterator it = cache_.begin();
+  while (it != cache_.end()) {
+    const CachedTrajectory& entry = it->second;
+    if (entry.cx0 < (int)xn && (int)x0 <= entry.cxn && entry.cy0 < (int)yn && (int)y0 <= entry.cyn) {
+      cache_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
 }
 
 bool ObstacleCostFunction::prepare() {
+  // the footprint masks are only read while scoring, so trajectories can be scored concurrently
+  if (world_model_ != NULL) {
+    world_model_->updateFootprintMasks(footprint_spec_);
+  }
+
+  if (cache_enabled_) {
+    boost::mutex::scoped_lock lock(cache_mutex_);
+    // cells are cached by index, which a moved or resized costmap no longer matches
+    if (costmap_->getOriginX() != cache_origin_x_ || costmap_->getOriginY() != cache_origin_y_ ||
+        costmap_->getResolution() != cache_resolution_) {
+      cache_.clear();
+      cache_origin_x_ = costmap_->getOriginX();
+      cache_origin_y_ = costmap_->getOriginY();
+      cache_resolution_ = costmap_->getResolution();
+    }
+    // forget the trajectories the last cycle did not ask for
+    ++cache_cycle_;
+    std::map<CacheKey, CachedTrajectory>::iterator it = cache_.begin();
+    while (it != cache_.end()) {
+      if (it->second.last_used + 1 < cache_cycle_) {
+        cache_.erase(it++);
+      } else {
+        ++it;
+      }
+    }
+  }
   return true;
 }
 
 double ObstacleCostFunction::scoreTrajectory(Trajectory &traj) {
-  double cost = 0;
   double scale = getScalingFactor(traj, scaling_speed_, max_trans_vel_, max_scaling_factor_);
-  double px, py, pth;
   if (footprint_spec_.size() == 0) {
     // Bug, should never happen
     ROS_ERROR("Footprint spec is empty, maybe missing call to setFootprint?");
     return -9;
   }
 
+  double cost;
+  if (cache_enabled_ && traj.getPointsSize() > 0) {
+    if (lookupTrajectory(traj, cost)) {
+      return cost;
+    }
+    cost = sweepCost(traj, scale);
+    storeTrajectory(traj, scale, cost);
+    return cost;
+  }
+  return sweepCost(traj, scale);
+}
+
+double ObstacleCostFunction::sweepCost(Trajectory &traj, double scale) {
+  double cost = 0;
+  double px, py, pth;
   for (unsigned int i = 0; i < traj.getPointsSize(); ++i) {
     traj.getPoint(i, px, py, pth);
     double f_cost = footprintCost(px, py, pth,
@@ -93,7 +190,7 @@ double ObstacleCostFunction::scoreTrajectory(Trajectory &traj) {
     
     // Count cell costs instead of footprint costs for optimization
     unsigned int cell_x, cell_y;
-    costmap_->worldToMap(px, py, cell_x, cell_y);
+    costmap_->worldToMapFast(px, py, cell_x, cell_y);
     double c_cost = double(costmap_->getCost(cell_x, cell_y));
 
     if(sum_scores_)
@@ -106,6 +203,68 @@ double ObstacleCostFunction::scoreTrajectory(Trajectory &traj) {
   return cost;
 }
 
+ObstacleCostFunction::CacheKey ObstacleCostFunction::cacheKey(const Trajectory &traj) {
+  CacheKey key;
+  key.xv = lround(traj.xv_ * 1000.0);
+  key.yv = lround(traj.yv_ * 1000.0);
+  key.thetav = lround(traj.thetav_ * 1000.0);
+  return key;
+}
+
+bool ObstacleCostFunction::lookupTrajectory(const Trajectory &traj, double& cost) {
+  CacheKey key = cacheKey(traj);
+  double start_x, start_y, start_th, end_x, end_y, end_th;
+  traj.getPoint(0, start_x, start_y, start_th);
+  traj.getEndpoint(end_x, end_y, end_th);
+
+  boost::mutex::scoped_lock lock(cache_mutex_);
+  std::map<CacheKey, CachedTrajectory>::iterator it = cache_.find(key);
+  if (it == cache_.end()) {
+    return false;
+  }
+  CachedTrajectory& entry = it->second;
+  if (entry.xv != traj.xv_ || entry.yv != traj.yv_ || entry.thetav != traj.thetav_ ||
+      entry.num_points != traj.getPointsSize() ||
+      entry.start_x != start_x || entry.start_y != start_y || entry.start_th != start_th ||
+      entry.end_x != end_x || entry.end_y != end_y || entry.end_th != end_th) {
+    return false;
+  }
+  entry.last_used = cache_cycle_;
+  cost = entry.cost;
+  return true;
+}
+
+void ObstacleCostFunction::storeTrajectory(const Trajectory &traj, double scale, double cost) {
+  CacheKey key = cacheKey(traj);
+
+  CachedTrajectory entry;
+  entry.xv = traj.xv_;
+  entry.yv = traj.yv_;
+  entry.thetav = traj.thetav_;
+  entry.num_points = traj.getPointsSize();
+  traj.getPoint(0, entry.start_x, entry.start_y, entry.start_th);
+  traj.getEndpoint(entry.end_x, entry.end_y, entry.end_th);
+  entry.cost = cost;
+
+  // the footprint stays within its scaled radius around every point, plus a cell for rounding
+  double min_x = entry.start_x, max_x = min_x, min_y = entry.start_y, max_y = min_y;
+  double px, py, pth;
+  for (unsigned int i = 1; i < traj.getPointsSize(); ++i) {
+    traj.getPoint(i, px, py, pth);
+    min_x = std::min(min_x, px);
+    max_x = std::max(max_x, px);
+    min_y = std::min(min_y, py);
+    max_y = std::max(max_y, py);
+  }
+  double margin = footprint_radius_ * std::max(scale, 1.0) + costmap_->getResolution();
+  costmap_->worldToMapEnforceBounds(min_x - margin, min_y - margin, entry.cx0, entry.cy0);
+  costmap_->worldToMapEnforceBounds(max_x + margin, max_y + margin, entry.cxn, entry.cyn);
+
+  boost::mutex::scoped_lock lock(cache_mutex_);
+  entry.last_used = cache_cycle_;
+  cache_[key] = entry;
+}
+
 double ObstacleCostFunction::getScalingFactor(Trajectory &traj, double scaling_speed, double max_trans_vel, double max_scaling_factor) {
   double vmag = hypot(traj.xv_, traj.yv_);
 
@@ -125,27 +284,13 @@ double ObstacleCostFunction::footprintCost (
     const double& y,
     const double& th,
     double scale,
-    std::vector<geometry_msgs::Point> footprint_spec,
+    const std::vector<geometry_msgs::Point>& footprint_spec,
     costmap_2d::Costmap2D* costmap,
     base_local_planner::WorldModel* world_model) {
 
   //check if the footprint is legal
   // TODO: Cache inscribed radius
-  double footprint_cost = world_model->footprintCost(x, y, th, footprint_spec);
-
-  if (footprint_cost < 0) {
-    return -6.0;
-  }
-  unsigned int cell_x, cell_y;
-
-  //we won't allow trajectories that go off the map... shouldn't happen that often anyways
-  if ( ! costmap->worldToMap(x, y, cell_x, cell_y)) {
-    return -7.0;
-  }
-
-  double occ_cost = std::max(std::max(occ_cost, footprint_cost), double(costmap->getCost(cell_x, cell_y)));
-
-  return occ_cost;
+  return occupancyCost(x, y, world_model->footprintCost(x, y, th, footprint_spec), costmap);
 }
 
 } /* namespace base_local_planner */
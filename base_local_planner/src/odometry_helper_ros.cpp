@@ -38,7 +38,8 @@
 
 namespace base_local_planner {
 
-OdometryHelperRos::OdometryHelperRos(std::string odom_topic) {
+OdometryHelperRos::OdometryHelperRos(std::string odom_topic) :
+    vel_x_(0.0), vel_y_(0.0), vel_th_(0.0), vel_seq_(0) {
   setOdomTopic( odom_topic );
 }
 
@@ -46,32 +47,46 @@ void OdometryHelperRos::odomCallback(const nav_msgs::Odometry::ConstPtr& msg) {
     ROS_INFO_ONCE("odom received!");
 
   //we assume that the odometry is published in the frame of the base
-  boost::mutex::scoped_lock lock(odom_mutex_);
-  base_odom_.twist.twist.linear.x = msg->twist.twist.linear.x;
-  base_odom_.twist.twist.linear.y = msg->twist.twist.linear.y;
-  base_odom_.twist.twist.angular.z = msg->twist.twist.angular.z;
+  //callbacks of one subscription do not run concurrently, so this is the only writer
+  double x = msg->twist.twist.linear.x;
+  double y = msg->twist.twist.linear.y;
+  double th = msg->twist.twist.angular.z;
+  unsigned int seq = __atomic_load_n(&vel_seq_, __ATOMIC_RELAXED);
+  __atomic_store_n(&vel_seq_, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store(&vel_x_, &x, __ATOMIC_RELAXED);
+  __atomic_store(&vel_y_, &y, __ATOMIC_RELAXED);
+  __atomic_store(&vel_th_, &th, __ATOMIC_RELAXED);
+  __atomic_store_n(&vel_seq_, seq + 2, __ATOMIC_RELEASE);
 //  ROS_DEBUG_NAMED("dwa_local_planner", "In the odometry callback with velocity values: (%.2f, %.2f, %.2f)",
-//      base_odom_.twist.twist.linear.x, base_odom_.twist.twist.linear.y, base_odom_.twist.twist.angular.z);
+//      x, y, th);
 }
 
-//copy over the odometry information
+void OdometryHelperRos::readVel(double& x, double& y, double& th) {
+  unsigned int seq;
+  do {
+    seq = __atomic_load_n(&vel_seq_, __ATOMIC_ACQUIRE);
+    __atomic_load(&vel_x_, &x, __ATOMIC_RELAXED);
+    __atomic_load(&vel_y_, &y, __ATOMIC_RELAXED);
+    __atomic_load(&vel_th_, &th, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while ((seq & 1) || seq != __atomic_load_n(&vel_seq_, __ATOMIC_RELAXED));
+}
+
+//copy over the odometry information, only the twist is kept
 void OdometryHelperRos::getOdom(nav_msgs::Odometry& base_odom) {
-  boost::mutex::scoped_lock lock(odom_mutex_);
-  base_odom = base_odom_;
+  base_odom = nav_msgs::Odometry();
+  readVel(base_odom.twist.twist.linear.x, base_odom.twist.twist.linear.y, base_odom.twist.twist.angular.z);
 }
 
 
 void OdometryHelperRos::getRobotVel(tf::Stamped<tf::Pose>& robot_vel) {
   // Set current velocities from odometry
   geometry_msgs::Twist global_vel;
-  {
-    boost::mutex::scoped_lock lock(odom_mutex_);
-    global_vel.linear.x = base_odom_.twist.twist.linear.x;
-    global_vel.linear.y = base_odom_.twist.twist.linear.y;
-    global_vel.angular.z = base_odom_.twist.twist.angular.z;
+  readVel(global_vel.linear.x, global_vel.linear.y, global_vel.angular.z);
 
-    robot_vel.frame_id_ = base_odom_.child_frame_id;
-  }
+  // the velocity is in the frame of the base, which the callback does not keep
+  robot_vel.frame_id_ = "";
   robot_vel.setData(tf::Transform(tf::createQuaternionFromYaw(global_vel.angular.z), tf::Vector3(global_vel.linear.x, global_vel.linear.y, 0)));
   robot_vel.stamp_ = ros::Time();
 }
@@ -79,7 +79,9 @@ PointGrid::PointGrid(double size_x, double size_y, double resolution, geometry_m
   {
     width_ = (int) (size_x / resolution_);
     height_ = (int) (size_y / resolution_);
-    cells_.resize(width_ * height_);
+    cell_starts_.resize(width_ * height_, 0);
+    cell_ends_.resize(width_ * height_, 0);
+    inserted_heads_.resize(width_ * height_, -1);
   }
 
   double PointGrid::footprintCost(const geometry_msgs::Point& position, const std::vector<geometry_msgs::Point>& footprint, 
@@ -97,10 +99,10 @@ PointGrid::PointGrid(double size_x, double size_y, double resolution, geometry_m
 
     //This may return points that are still outside of the cirumscribed square because it returns the cells
     //contained by the range
-    getPointsInRange(c_lower_left, c_upper_right, points_);
+    getCellsInRange(c_lower_left, c_upper_right, range_cells_);
 
     //if there are no points in the circumscribed square... we don't have to check against the footprint
-    if(points_.empty())
+    if(range_cells_.empty())
       return 1.0;
 
     //compute the half-width of the inner square from the inscribed radius of the robot
@@ -115,22 +117,19 @@ PointGrid::PointGrid(double size_x, double size_y, double resolution, geometry_m
     i_upper_right.y = position.y + inner_square_radius;
 
     //if there are points, we have to do a more expensive check
-    for(unsigned int i = 0; i < points_.size(); ++i){
-      list<pcl::PointXYZ>* cell_points = points_[i];
-      if(cell_points != NULL){
-        for(list<pcl::PointXYZ>::iterator it = cell_points->begin(); it != cell_points->end(); ++it){
-          const pcl::PointXYZ& pt = *it;
-          //first, we'll check to make sure we're in the outer square
-          //printf("(%.2f, %.2f) ... l(%.2f, %.2f) ... u(%.2f, %.2f)\n", pt.x, pt.y, c_lower_left.x, c_lower_left.y, c_upper_right.x, c_upper_right.y);
-          if(pt.x > c_lower_left.x && pt.x < c_upper_right.x && pt.y > c_lower_left.y && pt.y < c_upper_right.y){
-            //do a quick check to see if the point lies in the inner square of the robot
-            if(pt.x > i_lower_left.x && pt.x < i_upper_right.x && pt.y > i_lower_left.y && pt.y < i_upper_right.y)
-              return -1.0;
-
-            //now we really have to do a full footprint check on the point
-            if(ptInPolygon(pt, footprint))
-              return -1.0;
-          }
+    for(unsigned int i = 0; i < range_cells_.size(); ++i){
+      for(const pcl::PointXYZ* it = cellBegin(range_cells_[i]); it != cellEnd(range_cells_[i]); ++it){
+        const pcl::PointXYZ& pt = *it;
+        //first, we'll check to make sure we're in the outer square
+        //printf("(%.2f, %.2f) ... l(%.2f, %.2f) ... u(%.2f, %.2f)\n", pt.x, pt.y, c_lower_left.x, c_lower_left.y, c_upper_right.x, c_upper_right.y);
+        if(pt.x > c_lower_left.x && pt.x < c_upper_right.x && pt.y > c_lower_left.y && pt.y < c_upper_right.y){
+          //do a quick check to see if the point lies in the inner square of the robot
+          if(pt.x > i_lower_left.x && pt.x < i_upper_right.x && pt.y > i_lower_left.y && pt.y < i_upper_right.y)
+            return -1.0;
+
+          //now we really have to do a full footprint check on the point
+          if(ptInPolygon(pt, footprint))
+            return -1.0;
         }
       }
     }
@@ -175,8 +174,12 @@ PointGrid::PointGrid(double size_x, double size_y, double resolution, geometry_m
     return true;
   }
 
-  void PointGrid::getPointsInRange(const geometry_msgs::Point& lower_left, const geometry_msgs::Point& upper_right, vector< list<pcl::PointXYZ>* >& points){
-    points.clear();
+  void PointGrid::getCellsInRange(const geometry_msgs::Point& lower_left, const geometry_msgs::Point& upper_right, vector<unsigned int>& cells){
+    cells.clear();
+
+    //the points of a cell have to be contiguous
+    if(!inserted_points_.empty())
+      rebuildCells();
 
     //compute the other corners of the box so we can get cells indicies for them
     geometry_msgs::Point upper_left, lower_right;
@@ -214,20 +217,16 @@ PointGrid::PointGrid(double size_x, double size_y, double resolution, geometry_m
      *  |                               |
      * (0, height) ----------------- (width, height)
      */
-    //get an iterator
-    vector< list<pcl::PointXYZ> >::iterator cell_iterator = cells_.begin() + lower_left_index;
     //printf("Index: %d, Width: %d, x_steps: %d, y_steps: %d\n", lower_left_index, width_, x_steps, y_steps);
+    unsigned int row_index = lower_left_index;
     for(unsigned int i = 0; i < y_steps; ++i){
-      for(unsigned int j = 0; j < x_steps; ++j){
-        list<pcl::PointXYZ>& cell = *cell_iterator;
-        //if the cell contains any points... we need to push them back to our list
-        if(!cell.empty()){
-          points.push_back(&cell);
+      for(unsigned int cell = row_index; cell < row_index + x_steps; ++cell){
+        //if the cell contains any points... we need to push it back to our list
+        if(cell_ends_[cell] != cell_starts_[cell]){
+          cells.push_back(cell);
         }
-        if(j < x_steps - 1)
-          cell_iterator++; //move a cell in the x direction
       }
-      cell_iterator += width_ - (x_steps - 1); //move down a row
+      row_index += width_; //move down a row
     }
   }
 
@@ -246,21 +245,49 @@ PointGrid::PointGrid(double size_x, double size_y, double resolution, geometry_m
     //get the associated index
     unsigned int pt_index = gridIndex(gx, gy);
 
-    //insert the point into the grid at the correct location
-    cells_[pt_index].push_back(pt);
-    //printf("Index: %d, size: %d\n", pt_index, cells_[pt_index].size());
+    //remember the point for the cell, it is sorted into place by the next rebuild
+    inserted_points_.push_back(pt);
+    inserted_next_.push_back(inserted_heads_[pt_index]);
+    inserted_heads_[pt_index] = inserted_points_.size() - 1;
   }
 
   double PointGrid::getNearestInCell(pcl::PointXYZ& pt, unsigned int gx, unsigned int gy){
     unsigned int index = gridIndex(gx, gy);
     double min_sq_dist = DBL_MAX;
     //loop through the points in the cell and find the minimum distance to the passed point
-    for(list<pcl::PointXYZ>::iterator it = cells_[index].begin(); it != cells_[index].end(); ++it){
-      min_sq_dist = min(min_sq_dist, sq_distance(pt, *it));
+    for(unsigned int i = cell_starts_[index]; i < cell_ends_[index]; ++i){
+      min_sq_dist = min(min_sq_dist, sq_distance(pt, points_[i]));
+    }
+    //including the ones inserted since the last rebuild
+    for(int i = inserted_heads_[index]; i >= 0; i = inserted_next_[i]){
+      min_sq_dist = min(min_sq_dist, sq_distance(pt, inserted_points_[i]));
     }
     return min_sq_dist;
   }
 
+  void PointGrid::rebuildCells(){
+    //copy the cells one after the other, each with its sorted points followed by the ones inserted into it
+    unsigned int total = inserted_points_.size();
+    for(unsigned int i = 0; i < cell_starts_.size(); ++i)
+      total += cell_ends_[i] - cell_starts_[i];
+    rebuild_points_.resize(total);
+
+    unsigned int next = 0;
+    for(unsigned int i = 0; i < cell_starts_.size(); ++i){
+      unsigned int start = next;
+      for(unsigned int j = cell_starts_[i]; j < cell_ends_[i]; ++j)
+        rebuild_points_[next++] = points_[j];
+      for(int j = inserted_heads_[i]; j >= 0; j = inserted_next_[j])
+        rebuild_points_[next++] = inserted_points_[j];
+      inserted_heads_[i] = -1;
+      cell_starts_[i] = start;
+      cell_ends_[i] = next;
+    }
+    points_.swap(rebuild_points_);
+
+    inserted_points_.clear();
+    inserted_next_.clear();
+  }
 
   double PointGrid::nearestNeighborDistance(pcl::PointXYZ& pt){
     //get the grid coordinates of the point
@@ -407,27 +434,25 @@ PointGrid::PointGrid(double size_x, double size_y, double resolution, geometry_m
       upper_right.y = max((double)upper_right.y, (double)laser_scan.cloud.points[i].y);
     }
 
-    getPointsInRange(lower_left, upper_right, points_);
+    getCellsInRange(lower_left, upper_right, range_cells_);
 
     //if there are no points in the containing square... we don't have to do anything
-    if(points_.empty())
+    if(range_cells_.empty())
       return;
 
-    //if there are points, we have to check them against the scan explicitly to remove them
-    for(unsigned int i = 0; i < points_.size(); ++i){
-      list<pcl::PointXYZ>* cell_points = points_[i];
-      if(cell_points != NULL){
-        list<pcl::PointXYZ>::iterator it = cell_points->begin();
-        while(it != cell_points->end()){
-          const pcl::PointXYZ& pt = *it;
-
-          //check if the point is in the polygon and if it is, erase it from the grid
-          if(ptInScan(pt, laser_scan)){
-            it = cell_points->erase(it);
-          }
-          else
-            it++;
+    //if there are points, we have to check them explicitly to remove them
+    for(unsigned int i = 0; i < range_cells_.size(); ++i){
+      unsigned int cell = range_cells_[i];
+      unsigned int j = cell_starts_[cell];
+      while(j < cell_ends_[cell]){
+        const pcl::PointXYZ& pt = points_[j];
+
+        //check if the point is in the scan and if it is, erase it from the grid by moving the last point of the cell here
+        if(ptInScan(pt, laser_scan)){
+          points_[j] = points_[--cell_ends_[cell]];
         }
+        else
+          j++;
       }
     }
   }
@@ -477,9 +502,11 @@ PointGrid::PointGrid(double size_x, double size_y, double resolution, geometry_m
   }
 
   void PointGrid::getPoints(pcl::PointCloud<pcl::PointXYZ>& cloud){
-    for(unsigned int i = 0; i < cells_.size(); ++i){
-      for(list<pcl::PointXYZ>::iterator it = cells_[i].begin(); it != cells_[i].end(); ++it){
-        cloud.push_back(*it);
+    if(!inserted_points_.empty())
+      rebuildCells();
+    for(unsigned int i = 0; i < cell_starts_.size(); ++i){
+      for(unsigned int j = cell_starts_[i]; j < cell_ends_[i]; ++j){
+        cloud.push_back(points_[j]);
       }
     }
   }
@@ -503,27 +530,25 @@ PointGrid::PointGrid(double size_x, double size_y, double resolution, geometry_m
     }
 
     ROS_DEBUG("Lower: (%.2f, %.2f), Upper: (%.2f, %.2f)\n", lower_left.x, lower_left.y, upper_right.x, upper_right.y);
-    getPointsInRange(lower_left, upper_right, points_);
+    getCellsInRange(lower_left, upper_right, range_cells_);
 
     //if there are no points in the containing square... we don't have to do anything
-    if(points_.empty())
+    if(range_cells_.empty())
       return;
 
-    //if there are points, we have to check them against the polygon explicitly to remove them
-    for(unsigned int i = 0; i < points_.size(); ++i){
-      list<pcl::PointXYZ>* cell_points = points_[i];
-      if(cell_points != NULL){
-        list<pcl::PointXYZ>::iterator it = cell_points->begin();
-        while(it != cell_points->end()){
-          const pcl::PointXYZ& pt = *it;
-
-          //check if the point is in the polygon and if it is, erase it from the grid
-          if(ptInPolygon(pt, poly)){
-            it = cell_points->erase(it);
-          }
-          else
-            it++;
+    //if there are points, we have to check them explicitly to remove them
+    for(unsigned int i = 0; i < range_cells_.size(); ++i){
+      unsigned int cell = range_cells_[i];
+      unsigned int j = cell_starts_[cell];
+      while(j < cell_ends_[cell]){
+        const pcl::PointXYZ& pt = points_[j];
+
+        //check if the point is in the polygon and if it is, erase it from the grid by moving the last point of the cell here
+        if(ptInPolygon(pt, poly)){
+          points_[j] = points_[--cell_ends_[cell]];
         }
+        else
+          j++;
       }
     }
   }
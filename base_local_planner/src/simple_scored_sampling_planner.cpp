@@ -36,8 +36,10 @@
  *********************************************************************/
 
 #include <base_local_planner/simple_scored_sampling_planner.h>
+#include <costmap_2d/executor.h>
 
 #include <ros/console.h>
+#include <boost/thread.hpp>
 
 namespace base_local_planner {
   
@@ -45,6 +47,27 @@ namespace base_local_planner {
     max_samples_ = max_samples;
     gen_list_ = gen_list;
     critics_ = critics;
+    scoring_threads_ = 1;
+    explored_endpoints_ = false;
+    explored_stride_ = 1;
+  }
+
+  void SimpleScoredSamplingPlanner::addExplored(std::vector<Trajectory>& all_explored, const Trajectory& sample, double cost, int index) const {
+    if (index % explored_stride_ != 0) {
+      return;
+    }
+    if (!explored_endpoints_) {
+      all_explored.push_back(sample);
+      all_explored.back().cost_ = cost;
+      return;
+    }
+    all_explored.push_back(Trajectory(sample.xv_, sample.yv_, sample.thetav_, sample.time_delta_, 0));
+    all_explored.back().cost_ = cost;
+    if (sample.getPointsSize() > 0) {
+      double x, y, th;
+      sample.getEndpoint(x, y, th);
+      all_explored.back().addPoint(x, y, th);
+    }
   }
 
   double SimpleScoredSamplingPlanner::scoreTrajectory(Trajectory& traj, double best_traj_cost) {
@@ -79,8 +102,6 @@ namespace base_local_planner {
   }
 
   bool SimpleScoredSamplingPlanner::findBestTrajectory(Trajectory& traj, std::vector<Trajectory>* all_explored) {
-    Trajectory loop_traj;
-    Trajectory best_traj;
     double loop_traj_cost, best_traj_cost = -1;
     bool gen_success;
     int count, count_valid;
@@ -96,41 +117,100 @@ namespace base_local_planner {
       count = 0;
       count_valid = 0;
       TrajectorySampleGenerator* gen_ = *loop_gen;
-      while (gen_->hasMoreTrajectories()) {
-        gen_success = gen_->nextTrajectory(loop_traj);
-        if (gen_success == false) {
-          // TODO use this for debugging
-          continue;
-        }
-        loop_traj_cost = scoreTrajectory(loop_traj, best_traj_cost);
-        if (all_explored != NULL) {
-          loop_traj.cost_ = loop_traj_cost;
-          all_explored->push_back(loop_traj);
+      if (scoring_threads_ > 1) {
+        // generate the samples up front, then score them concurrently, in batches for
+        // generators that offer more samples once they got the costs of the previous ones
+        while (gen_->hasMoreTrajectories()) {
+          unsigned int num_samples = 0;
+          while (gen_->hasMoreTrajectories()) {
+            if (num_samples == samples_.size()) {
+              samples_.resize(num_samples + 1);
+            }
+            if (gen_->nextTrajectory(samples_[num_samples]) == false) {
+              continue;
+            }
+            num_samples++;
+            if (max_samples_ > 0 && count + (int)num_samples >= max_samples_) {
+              break;
+            }
+          }
+
+          sample_costs_.resize(num_samples);
+          boost::mutex chunk_mutex;
+          unsigned int next_sample = 0;
+          bool found_valid = best_traj_cost >= 0;
+          costmap_2d::TaskGroup workers;
+          for (unsigned int t = 1; t < scoring_threads_; ++t) {
+            workers.run(boost::bind(&SimpleScoredSamplingPlanner::scoreWorker, this, num_samples, &chunk_mutex, &next_sample, &found_valid));
+          }
+          scoreWorker(num_samples, &chunk_mutex, &next_sample, &found_valid);
+          workers.wait();
+
+          // chunks are taken in order, so past the deadline only a prefix of the samples was scored
+          unsigned int num_scored = std::min(next_sample, num_samples);
+
+          // pick the first minimal cost, as the serial loop does
+          int best_sample = -1;
+          for (unsigned int i = 0; i < num_scored; ++i) {
+            loop_traj_cost = sample_costs_[i];
+            gen_->reportCost(samples_[i], loop_traj_cost);
+            if (all_explored != NULL) {
+              addExplored(*all_explored, samples_[i], loop_traj_cost, count);
+            }
+            if (loop_traj_cost >= 0) {
+              count_valid++;
+              if (best_traj_cost < 0 || loop_traj_cost < best_traj_cost) {
+                best_traj_cost = loop_traj_cost;
+                best_sample = i;
+              }
+            }
+            count++;
+          }
+          if (best_sample >= 0) {
+            best_traj_.swap(samples_[best_sample]);
+          }
+          if (max_samples_ > 0 && count >= max_samples_) {
+            break;
+          }
+          if (num_scored < num_samples) {
+            break;
+          }
         }
+      } else {
+        while (gen_->hasMoreTrajectories()) {
+          gen_success = gen_->nextTrajectory(loop_traj_);
+          if (gen_success == false) {
+            // TODO use this for debugging
+            continue;
+          }
+          loop_traj_cost = scoreTrajectory(loop_traj_, best_traj_cost);
+          gen_->reportCost(loop_traj_, loop_traj_cost);
+          if (all_explored != NULL) {
+            addExplored(*all_explored, loop_traj_, loop_traj_cost, count);
+          }
 
-        if (loop_traj_cost >= 0) {
-          count_valid++;
-          if (best_traj_cost < 0 || loop_traj_cost < best_traj_cost) {
-            best_traj_cost = loop_traj_cost;
-            best_traj = loop_traj;
+          if (loop_traj_cost >= 0) {
+            count_valid++;
+            if (best_traj_cost < 0 || loop_traj_cost < best_traj_cost) {
+              best_traj_cost = loop_traj_cost;
+              // the old best's storage is reused for the next sample
+              best_traj_.swap(loop_traj_);
+            }
+          }
+          count++;
+          if (max_samples_ > 0 && count >= max_samples_) {
+            break;
+          }        
+          if (best_traj_cost >= 0 && pastDeadline()) {
+            ROS_DEBUG("Deadline passed, returning the best of %d trajectories", count);
+            break;
           }
         }
-        count++;
-        if (max_samples_ > 0 && count >= max_samples_) {
-          break;
-        }        
       }
       if (best_traj_cost >= 0) {
-        traj.xv_ = best_traj.xv_;
-        traj.yv_ = best_traj.yv_;
-        traj.thetav_ = best_traj.thetav_;
+        // copied rather than swapped, so the buffers stay with the planner for the next cycle
+        traj = best_traj_;
         traj.cost_ = best_traj_cost;
-        traj.resetPoints();
-        double px, py, pth;
-        for (unsigned int i = 0; i < best_traj.getPointsSize(); i++) {
-          best_traj.getPoint(i, px, py, pth);
-          traj.addPoint(px, py, pth);
-        }
       }
       ROS_DEBUG("Evaluated %d trajectories, found %d valid", count, count_valid);
       if (best_traj_cost >= 0) {
@@ -141,5 +221,36 @@ namespace base_local_planner {
     return best_traj_cost >= 0;
   }
 
+  void SimpleScoredSamplingPlanner::scoreWorker(unsigned int num_samples, boost::mutex* chunk_mutex, unsigned int* next_sample, bool* found_valid) {
+    // chunks keep the lock rare, the order they are taken in does not change the result
+    const unsigned int chunk = 8;
+    double best_cost = -1;
+    while (true) {
+      unsigned int begin;
+      {
+        boost::mutex::scoped_lock lock(*chunk_mutex);
+        *found_valid = *found_valid || best_cost >= 0;
+        // stop handing out chunks once time is up and there is something to return
+        if (*found_valid && pastDeadline()) {
+          return;
+        }
+        begin = *next_sample;
+        *next_sample += chunk;
+      }
+      if (begin >= num_samples) {
+        return;
+      }
+      unsigned int end = std::min(begin + chunk, num_samples);
+      for (unsigned int i = begin; i < end; ++i) {
+        // a trajectory cut short against this worker's best is also worse than the overall best
+        double cost = scoreTrajectory(samples_[i], best_cost);
+        sample_costs_[i] = cost;
+        if (cost >= 0 && (best_cost < 0 || cost < best_cost)) {
+          best_cost = cost;
+        }
+      }
+    }
+  }
+
   
 }// namespace
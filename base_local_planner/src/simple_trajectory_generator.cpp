@@ -38,6 +38,7 @@
 #include <base_local_planner/simple_trajectory_generator.h>
 
 #include <cmath>
+#include <algorithm>
 
 #include <base_local_planner/velocity_iterator.h>
 
@@ -49,7 +50,7 @@ void SimpleTrajectoryGenerator::initialise(
     const Eigen::Vector3f& goal,
     base_local_planner::LocalPlannerLimits* limits,
     const Eigen::Vector3f& vsamples,
-    std::vector<Eigen::Vector3f> additional_samples,
+    const std::vector<Eigen::Vector3f>& additional_samples,
     bool discretize_by_time) {
   initialise(pos, vel, goal, limits, vsamples, discretize_by_time);
   // add static samples if any
@@ -76,6 +77,8 @@ void SimpleTrajectoryGenerator::initialise(
   limits_ = limits;
   next_sample_index_ = 0;
   sample_params_.clear();
+  min_vel_ = max_vel_ = vel;
+  vsamples_ = vsamples;
 
   double min_vel_x = limits->min_vel_x;
   double max_vel_x = limits->max_vel_x;
@@ -114,23 +117,84 @@ void SimpleTrajectoryGenerator::initialise(
       min_vel[2] = std::max(min_vel_th, vel[2] - acc_lim[2] * sim_period_);
     }
 
-    Eigen::Vector3f vel_samp = Eigen::Vector3f::Zero();
-    VelocityIterator x_it(min_vel[0], max_vel[0], vsamples[0]);
-    VelocityIterator y_it(min_vel[1], max_vel[1], vsamples[1]);
-    VelocityIterator th_it(min_vel[2], max_vel[2], vsamples[2]);
-    for(; !x_it.isFinished(); x_it++) {
-      vel_samp[0] = x_it.getVelocity();
-      for(; !y_it.isFinished(); y_it++) {
-        vel_samp[1] = y_it.getVelocity();
-        for(; !th_it.isFinished(); th_it++) {
-          vel_samp[2] = th_it.getVelocity();
-          //ROS_DEBUG("Sample %f, %f, %f", vel_samp[0], vel_samp[1], vel_samp[2]);
-          sample_params_.push_back(vel_samp);
+    min_vel_ = min_vel;
+    max_vel_ = max_vel;
+    x_it_.setRange(min_vel[0], max_vel[0], vsamples[0]);
+    y_it_.setRange(min_vel[1], max_vel[1], vsamples[1]);
+    th_it_.setRange(min_vel[2], max_vel[2], vsamples[2]);
+    addSamples();
+
+    if (refine_samples_ > 0 && has_previous_cmd_) {
+      // a finer grid of one coarse step around the previous command, as far as it is still reachable
+      bool reachable = true;
+      VelocityIterator* its[3] = {&x_it_, &y_it_, &th_it_};
+      Eigen::Vector3f step = getSampleStep();
+      for (int i = 0; i < 3; ++i) {
+        double half_step = 0.5 * step[i];
+        double lower = std::max((double)min_vel[i], previous_cmd_[i] - half_step);
+        double upper = std::min((double)max_vel[i], previous_cmd_[i] + half_step);
+        if (lower > upper) {
+          reachable = false;
+          break;
         }
-        th_it.reset();
+        its[i]->setRange(lower, upper, refine_samples_);
+      }
+      if (reachable) {
+        addSamples();
+      }
+    }
+
+    if (prioritize_samples_) {
+      prioritizeSamples(has_previous_cmd_ ? previous_cmd_ : vel);
+    }
+  }
+}
+
+void SimpleTrajectoryGenerator::prioritizeSamples(const Eigen::Vector3f& center) {
+  Eigen::Vector3f step = getSampleStep();
+  sample_order_.resize(sample_params_.size());
+  for (unsigned int i = 0; i < sample_params_.size(); ++i) {
+    float distance = 0;
+    for (int d = 0; d < 3; ++d) {
+      if (step[d] > 0) {
+        distance += std::fabs(sample_params_[i][d] - center[d]) / step[d];
       }
-      y_it.reset();
     }
+    // the index breaks ties, which keeps the sort stable
+    sample_order_[i] = std::make_pair(distance, i);
+  }
+  std::sort(sample_order_.begin(), sample_order_.end());
+
+  ordered_params_.resize(sample_params_.size());
+  for (unsigned int i = 0; i < sample_order_.size(); ++i) {
+    ordered_params_[i] = sample_params_[sample_order_[i].second];
+  }
+  sample_params_.swap(ordered_params_);
+}
+
+Eigen::Vector3f SimpleTrajectoryGenerator::getSampleStep() const {
+  Eigen::Vector3f step;
+  for (int i = 0; i < 3; ++i) {
+    step[i] = (max_vel_[i] - min_vel_[i]) / std::max(1.0f, vsamples_[i] - 1);
+  }
+  return step;
+}
+
+void SimpleTrajectoryGenerator::addSamples() {
+  sample_params_.reserve(sample_params_.size() + x_it_.size() * y_it_.size() * th_it_.size());
+  Eigen::Vector3f vel_samp = Eigen::Vector3f::Zero();
+  for(; !x_it_.isFinished(); x_it_++) {
+    vel_samp[0] = x_it_.getVelocity();
+    for(; !y_it_.isFinished(); y_it_++) {
+      vel_samp[1] = y_it_.getVelocity();
+      for(; !th_it_.isFinished(); th_it_++) {
+        vel_samp[2] = th_it_.getVelocity();
+        //ROS_DEBUG("Sample %f, %f, %f", vel_samp[0], vel_samp[1], vel_samp[2]);
+        sample_params_.push_back(vel_samp);
+      }
+      th_it_.reset();
+    }
+    y_it_.reset();
   }
 }
 
@@ -214,6 +278,7 @@ bool SimpleTrajectoryGenerator::generateTrajectory(
   //compute a timestep
   double dt = sim_time_ / num_steps;
   traj.time_delta_ = dt;
+  traj.reservePoints(num_steps);
 
   Eigen::Vector3f loop_vel;
   if (continued_acceleration_) {
@@ -230,11 +295,17 @@ bool SimpleTrajectoryGenerator::generateTrajectory(
     traj.thetav_ = sample_target_vel[2];
   }
 
+  //once the rotational velocity is at the sample, every step turns the robot by the same angle, so the
+  //orientation is rotated incrementally instead of taking cos and sin of the heading every step
+  double x = pos[0], y = pos[1], th = pos[2];
+  double cos_th = cos(th), sin_th = sin(th);
+  const double cos_step = cos(sample_target_vel[2] * dt), sin_step = sin(sample_target_vel[2] * dt);
+
   //simulate the trajectory and check for collisions, updating costs along the way
   for (int i = 0; i < num_steps; ++i) {
 
     //add the point to the trajectory so we can draw it later if we want
-    traj.addPoint(pos[0], pos[1], pos[2]);
+    traj.addPoint(x, y, th);
 
     if (continued_acceleration_) {
       //calculate velocities
@@ -242,8 +313,18 @@ bool SimpleTrajectoryGenerator::generateTrajectory(
       //ROS_WARN_NAMED("Generator", "Flag: %d, Loop_Vel %f, %f, %f", continued_acceleration_, loop_vel[0], loop_vel[1], loop_vel[2]);
     }
 
-    //update the position of the robot using the velocities passed in
-    pos = computeNewPositions(pos, loop_vel, dt);
+    //update the position of the robot using the velocities passed in, as computeNewPositions does
+    x += (loop_vel[0] * cos_th - loop_vel[1] * sin_th) * dt;
+    y += (loop_vel[0] * sin_th + loop_vel[1] * cos_th) * dt;
+    th += loop_vel[2] * dt;
+    if (loop_vel[2] == sample_target_vel[2]) {
+      double c = cos_th * cos_step - sin_th * sin_step;
+      sin_th = sin_th * cos_step + cos_th * sin_step;
+      cos_th = c;
+    } else {
+      cos_th = cos(th);
+      sin_th = sin(th);
+    }
 
   } // end for simulation steps
 
@@ -32,10 +32,11 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  *********************************************************************/
 #include <base_local_planner/trajectory.h>
+#include <algorithm>
 
 namespace base_local_planner {
   Trajectory::Trajectory()
-    : xv_(0.0), yv_(0.0), thetav_(0.0), cost_(-1.0)
+    : xv_(0.0), yv_(0.0), thetav_(0.0), cost_(-1.0), time_delta_(0.0)
   {
   }
 
@@ -77,4 +78,21 @@ namespace base_local_planner {
   unsigned int Trajectory::getPointsSize() const {
     return x_pts_.size();
   }
+
+  void Trajectory::reservePoints(unsigned int num_pts){
+    x_pts_.reserve(num_pts);
+    y_pts_.reserve(num_pts);
+    th_pts_.reserve(num_pts);
+  }
+
+  void Trajectory::swap(Trajectory& other){
+    std::swap(xv_, other.xv_);
+    std::swap(yv_, other.yv_);
+    std::swap(thetav_, other.thetav_);
+    std::swap(cost_, other.cost_);
+    std::swap(time_delta_, other.time_delta_);
+    x_pts_.swap(other.x_pts_);
+    y_pts_.swap(other.y_pts_);
+    th_pts_.swap(other.th_pts_);
+  }
 };
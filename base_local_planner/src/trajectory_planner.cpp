@@ -39,6 +39,7 @@
 #include <costmap_2d/footprint.h>
 #include <string>
 #include <sstream>
+#include <algorithm>
 #include <math.h>
 #include <angles/angles.h>
 
@@ -167,7 +168,7 @@ namespace base_local_planner{
     max_vel_x_(max_vel_x), min_vel_x_(min_vel_x),
     max_vel_th_(max_vel_th), min_vel_th_(min_vel_th), min_in_place_vel_th_(min_in_place_vel_th),
     backup_vel_(backup_vel),
-    dwa_(dwa), heading_scoring_(heading_scoring), heading_scoring_timestep_(heading_scoring_timestep),
+    dwa_(dwa), heading_scoring_(heading_scoring), heading_scoring_timestep_(heading_scoring_timestep), heading_cycle_(0),
     simple_attractor_(simple_attractor), y_vels_(y_vels), stop_time_buffer_(stop_time_buffer), sim_period_(sim_period)
   {
     //the robot is not stuck to begin with
@@ -216,7 +217,7 @@ namespace base_local_planner{
       double vx_samp, double vy_samp, double vtheta_samp,
       double acc_x, double acc_y, double acc_theta,
       double impossible_cost,
-      Trajectory& traj) {
+      Trajectory& traj, double max_cost) {
 
     // make sure the configuration doesn't change mid run
     boost::mutex::scoped_lock l(configuration_mutex_);
@@ -257,6 +258,11 @@ namespace base_local_planner{
     traj.thetav_ = vtheta_samp;
     traj.cost_ = -1.0;
 
+    //once the rotational velocity reached the sample, every step turns the robot by the same angle, so the
+    //orientation is rotated incrementally instead of taking cos and sin of the heading every step
+    double cos_th = cos(theta_i), sin_th = sin(theta_i);
+    const double cos_step = cos(vtheta_samp * dt), sin_step = sin(vtheta_samp * dt);
+
     //initialize the costs for the trajectory
     double path_dist = 0.0;
     double goal_dist = 0.0;
@@ -305,6 +311,13 @@ namespace base_local_planner{
 
       occ_cost = std::max(std::max(occ_cost, footprint_cost), double(costmap_.getCost(cell_x, cell_y)));
 
+      //the occupancy cost only grows along the trajectory and the other terms are not negative, so once
+      //it alone is above the bound this trajectory can't beat the one that set the bound
+      if (max_cost >= 0 && occdist_scale_ * occ_cost > max_cost) {
+        traj.cost_ = -3.0;
+        return;
+      }
+
       //do we want to follow blindly
       if (simple_attractor_) {
         goal_dist = (x_i - global_plan_[global_plan_.size() -1].pose.position.x) *
@@ -349,10 +362,18 @@ namespace base_local_planner{
       vy_i = computeNewVelocity(vy_samp, vy_i, acc_y, dt);
       vtheta_i = computeNewVelocity(vtheta_samp, vtheta_i, acc_theta, dt);
 
-      //calculate positions
-      x_i = computeNewXPosition(x_i, vx_i, vy_i, theta_i, dt);
-      y_i = computeNewYPosition(y_i, vx_i, vy_i, theta_i, dt);
+      //calculate positions, as computeNewXPosition and computeNewYPosition do
+      x_i += (vx_i * cos_th - vy_i * sin_th) * dt;
+      y_i += (vx_i * sin_th + vy_i * cos_th) * dt;
       theta_i = computeNewThetaPosition(theta_i, vtheta_i, dt);
+      if (vtheta_i == vtheta_samp) {
+        double c = cos_th * cos_step - sin_th * sin_step;
+        sin_th = sin_th * cos_step + cos_th * sin_step;
+        cos_th = c;
+      } else {
+        cos_th = cos(theta_i);
+        sin_th = sin(theta_i);
+      }
 
       //increment time
       time += dt;
@@ -368,32 +389,72 @@ namespace base_local_planner{
     traj.cost_ = cost;
   }
 
+  void TrajectoryPlanner::startHeadingCycle(){
+    if (!heading_scoring_) {
+      return;
+    }
+
+    unsigned int size = costmap_.getSizeInCellsX() * costmap_.getSizeInCellsY();
+    if (heading_target_cycles_.size() != size || ++heading_cycle_ == 0) {
+      heading_targets_.assign(size, -1);
+      heading_target_cycles_.assign(size, 0);
+      heading_cycle_ = 1;
+    }
+
+    //the plan is searched from its far end, so store it that way
+    heading_plan_cells_.clear();
+    Position2DInt cell;
+    unsigned int goal_cell_x, goal_cell_y;
+    for (int i = global_plan_.size() - 1; i >= 0; --i) {
+      if (costmap_.worldToMap(global_plan_[i].pose.position.x, global_plan_[i].pose.position.y, goal_cell_x, goal_cell_y)) {
+        cell.x = goal_cell_x;
+        cell.y = goal_cell_y;
+        heading_plan_cells_.push_back(cell);
+      }
+    }
+  }
+
   double TrajectoryPlanner::headingDiff(int cell_x, int cell_y, double x, double y, double heading){
     double heading_diff = DBL_MAX;
-    unsigned int goal_cell_x, goal_cell_y;
     const double v2_x = cos(heading);
     const double v2_y = sin(heading);
 
-    //find a clear line of sight from the robot's cell to a point on the path
-    for (int i = global_plan_.size() - 1; i >=0; --i) {
-      if (costmap_.worldToMap(global_plan_[i].pose.position.x, global_plan_[i].pose.position.y, goal_cell_x, goal_cell_y)) {
-        if (lineCost(cell_x, goal_cell_x, cell_y, goal_cell_y) >= 0) {
-          double gx, gy;
-          costmap_.mapToWorld(goal_cell_x, goal_cell_y, gx, gy);
-          double v1_x = gx - x;
-          double v1_y = gy - y;
-
-          double perp_dot = v1_x * v2_y - v1_y * v2_x;
-          double dot = v1_x * v2_x + v1_y * v2_y;
-
-          //get the signed angle
-          double vector_angle = atan2(perp_dot, dot);
-
-          heading_diff = fabs(vector_angle);
-          return heading_diff;
+    //the costmap and the plan stay the same during a cycle, so the plan point
+    //visible from a cell only needs to be ray-traced once per cycle
+    unsigned int index = costmap_.getIndex(cell_x, cell_y);
+    if (index >= heading_target_cycles_.size()) {
+      return heading_diff;
+    }
+    if (heading_target_cycles_[index] != heading_cycle_) {
+      //find a clear line of sight from the robot's cell to a point on the path
+      int target = -1;
+      for (unsigned int i = 0; i < heading_plan_cells_.size(); ++i) {
+        if (lineCost(cell_x, heading_plan_cells_[i].x, cell_y, heading_plan_cells_[i].y) >= 0) {
+          target = i;
+          break;
         }
       }
+      heading_targets_[index] = target;
+      heading_target_cycles_[index] = heading_cycle_;
+    }
+
+    int target = heading_targets_[index];
+    if (target < 0) {
+      return heading_diff;
     }
+
+    double gx, gy;
+    costmap_.mapToWorld(heading_plan_cells_[target].x, heading_plan_cells_[target].y, gx, gy);
+    double v1_x = gx - x;
+    double v1_y = gy - y;
+
+    double perp_dot = v1_x * v2_y - v1_y * v2_x;
+    double dot = v1_x * v2_x + v1_y * v2_y;
+
+    //get the signed angle
+    double vector_angle = atan2(perp_dot, dot);
+
+    heading_diff = fabs(vector_angle);
     return heading_diff;
   }
 
@@ -500,6 +561,8 @@ namespace base_local_planner{
       final_goal_position_valid_ = false;
     }
 
+    startHeadingCycle();
+
     if (compute_dists) {
       //reset the map for new operations
       path_map_.resetPathDist();
@@ -532,6 +595,7 @@ namespace base_local_planner{
       double vtheta, double vx_samp, double vy_samp, double vtheta_samp) {
     Trajectory t;
     double impossible_cost = path_map_.obstacleCosts();
+    startHeadingCycle();
     generateTrajectory(x, y, theta,
                        vx, vy, vtheta,
                        vx_samp, vy_samp, vtheta_samp,
@@ -595,35 +659,47 @@ namespace base_local_planner{
 
     //if we're performing an escape we won't allow moving forward
     if (!escaping_) {
-      //loop through all x velocities
+      //loop through all x velocities, first sampling the straight trajectory and next all theta trajectories
+      forward_samples_.clear();
+      double time_x = acc_x > 0 ? 1.0 / acc_x : 0.0, time_theta = acc_theta > 0 ? 1.0 / acc_theta : 0.0;
       for(int i = 0; i < vx_samples_; ++i) {
         vtheta_samp = 0;
-        //first sample the straight trajectory
-        generateTrajectory(x, y, theta, vx, vy, vtheta, vx_samp, vy_samp, vtheta_samp,
-            acc_x, acc_y, acc_theta, impossible_cost, *comp_traj);
+        forward_samples_.push_back(VelocitySample(vx_samp, vtheta_samp,
+              fabs(vx_samp - vx) * time_x + fabs(vtheta_samp - vtheta) * time_theta, forward_samples_.size()));
+
+        vtheta_samp = min_vel_theta;
+        for(int j = 0; j < vtheta_samples_ - 1; ++j){
+          forward_samples_.push_back(VelocitySample(vx_samp, vtheta_samp,
+                fabs(vx_samp - vx) * time_x + fabs(vtheta_samp - vtheta) * time_theta, forward_samples_.size()));
+          vtheta_samp += dvtheta;
+        }
+        vx_samp += dvx;
+      }
+      //samples that are quick to reach from the current velocity usually score well, trying them first
+      //tightens the bound the others are cut off at
+      std::sort(forward_samples_.begin(), forward_samples_.end());
+
+      //of equally good trajectories the one first in the regular order wins, whatever order they were tried in
+      int best_order = -1;
+      for(unsigned int k = 0; k < forward_samples_.size(); ++k){
+        const VelocitySample& sample = forward_samples_[k];
+        generateTrajectory(x, y, theta, vx, vy, vtheta, sample.vx, vy_samp, sample.vtheta,
+            acc_x, acc_y, acc_theta, impossible_cost, *comp_traj, best_traj->cost_);
 
         //if the new trajectory is better... let's take it
-        if(comp_traj->cost_ >= 0 && (comp_traj->cost_ < best_traj->cost_ || best_traj->cost_ < 0)){
+        if(comp_traj->cost_ >= 0 && (comp_traj->cost_ < best_traj->cost_ || best_traj->cost_ < 0
+              || (comp_traj->cost_ == best_traj->cost_ && sample.order < best_order))){
           swap = best_traj;
           best_traj = comp_traj;
           comp_traj = swap;
+          best_order = sample.order;
         }
 
-        vtheta_samp = min_vel_theta;
-        //next sample all theta trajectories
-        for(int j = 0; j < vtheta_samples_ - 1; ++j){
-          generateTrajectory(x, y, theta, vx, vy, vtheta, vx_samp, vy_samp, vtheta_samp,
-              acc_x, acc_y, acc_theta, impossible_cost, *comp_traj);
-
-          //if the new trajectory is better... let's take it
-          if(comp_traj->cost_ >= 0 && (comp_traj->cost_ < best_traj->cost_ || best_traj->cost_ < 0)){
-            swap = best_traj;
-            best_traj = comp_traj;
-            comp_traj = swap;
-          }
-          vtheta_samp += dvtheta;
+        //the samples are tried in priority order, so once time is up the best so far is a good answer
+        if(best_traj->cost_ >= 0 && !deadline_.isZero() && ros::WallTime::now() > deadline_){
+          ROS_DEBUG("Deadline passed after %u of %u forward samples", k + 1, (unsigned int)forward_samples_.size());
+          break;
         }
-        vx_samp += dvx;
       }
 
       //only explore y velocities with holonomic robots
@@ -633,7 +709,7 @@ namespace base_local_planner{
         vy_samp = 0.1;
         vtheta_samp = 0.0;
         generateTrajectory(x, y, theta, vx, vy, vtheta, vx_samp, vy_samp, vtheta_samp,
-            acc_x, acc_y, acc_theta, impossible_cost, *comp_traj);
+            acc_x, acc_y, acc_theta, impossible_cost, *comp_traj, best_traj->cost_);
 
         //if the new trajectory is better... let's take it
         if(comp_traj->cost_ >= 0 && (comp_traj->cost_ < best_traj->cost_ || best_traj->cost_ < 0)){
@@ -646,7 +722,7 @@ namespace base_local_planner{
         vy_samp = -0.1;
         vtheta_samp = 0.0;
         generateTrajectory(x, y, theta, vx, vy, vtheta, vx_samp, vy_samp, vtheta_samp,
-            acc_x, acc_y, acc_theta, impossible_cost, *comp_traj);
+            acc_x, acc_y, acc_theta, impossible_cost, *comp_traj, best_traj->cost_);
 
         //if the new trajectory is better... let's take it
         if(comp_traj->cost_ >= 0 && (comp_traj->cost_ < best_traj->cost_ || best_traj->cost_ < 0)){
@@ -927,14 +1003,16 @@ namespace base_local_planner{
     //reset the map for new operations
     path_map_.resetPathDist();
     goal_map_.resetPathDist();
+    startHeadingCycle();
 
     //temporarily remove obstacles that are within the footprint of the robot
-    std::vector<base_local_planner::Position2DInt> footprint_list =
-        footprint_helper_.getFootprintCells(
-            pos,
-            footprint_spec_,
-            costmap_,
-            true);
+    std::vector<base_local_planner::Position2DInt>& footprint_list = footprint_cells_;
+    footprint_helper_.getFootprintCells(
+        pos,
+        footprint_spec_,
+        costmap_,
+        true,
+        footprint_list);
 
     //mark cells within the initial footprint of the robot
     for (unsigned int i = 0; i < footprint_list.size(); ++i) {
@@ -48,6 +48,7 @@
 #include <pluginlib/class_list_macros.h>
 
 #include <base_local_planner/goal_functions.h>
+#include <nav_trace/trace.h>
 #include <nav_msgs/Path.h>
 
 
@@ -72,10 +73,10 @@ namespace base_local_planner {
   }
 
   TrajectoryPlannerROS::TrajectoryPlannerROS() :
-      world_model_(NULL), tc_(NULL), costmap_ros_(NULL), tf_(NULL), setup_(false), initialized_(false), odom_helper_("odom") {}
+      world_model_(NULL), tc_(NULL), costmap_ros_(NULL), use_costmap_snapshot_(false), tf_(NULL), global_plan_(new std::vector<geometry_msgs::PoseStamped>()), plan_version_(0), plan_start_(0), inflation_fast_path_(false), setup_(false), initialized_(false), odom_helper_("odom") {}
 
   TrajectoryPlannerROS::TrajectoryPlannerROS(std::string name, tf::TransformListener* tf, costmap_2d::Costmap2DROS* costmap_ros) :
-      world_model_(NULL), tc_(NULL), costmap_ros_(NULL), tf_(NULL), setup_(false), initialized_(false), odom_helper_("odom") {
+      world_model_(NULL), tc_(NULL), costmap_ros_(NULL), use_costmap_snapshot_(false), tf_(NULL), global_plan_(new std::vector<geometry_msgs::PoseStamped>()), plan_version_(0), plan_start_(0), inflation_fast_path_(false), setup_(false), initialized_(false), odom_helper_("odom") {
 
       //initialize the planner
       initialize(name, tf, costmap_ros);
@@ -109,6 +110,12 @@ namespace base_local_planner {
 
       //initialize the copy of the costmap the controller will use
       costmap_ = costmap_ros_->getCostmap();
+      //with a snapshot the controller works on a copy taken at the start of each cycle, without holding the costmap lock
+      private_nh.param("costmap_snapshot", use_costmap_snapshot_, false);
+      if (use_costmap_snapshot_) {
+        costmap_snapshot_.copyCostsFrom(*costmap_ros_->getCostmapSnapshot());
+        costmap_ = &costmap_snapshot_;
+      }
 
 
       global_frame_ = costmap_ros_->getGlobalFrameID();
@@ -229,7 +236,13 @@ namespace base_local_planner {
       private_nh.param("point_grid/grid_resolution", grid_resolution, 0.2);
 
       ROS_ASSERT_MSG(world_model_type == "costmap", "At this time, only costmap world models are supported by this controller");
+      int footprint_mask_headings;
+      private_nh.param("footprint_mask_headings", footprint_mask_headings, 0);
+      private_nh.param("inflation_fast_path", inflation_fast_path_, false);
+      bool incremental_distance_fields;
+      private_nh.param("incremental_distance_fields", incremental_distance_fields, false);
       world_model_ = new CostmapModel(*costmap_);
+      world_model_->setFootprintMasks(std::max(footprint_mask_headings, 0));
       std::vector<double> y_vels = loadYVels(private_nh);
 
       footprint_spec_ = costmap_ros_->getRobotFootprint();
@@ -239,6 +252,7 @@ namespace base_local_planner {
           gdist_scale, occdist_scale, heading_lookahead, oscillation_reset_dist, escape_reset_dist, escape_reset_theta, holonomic_robot,
           max_vel_x, min_vel_x, max_vel_th_, min_vel_th_, min_in_place_vel_th_, backup_vel,
           dwa, heading_scoring, heading_scoring_timestep, meter_scoring, simple_attractor, y_vels, stop_time_buffer, sim_period_, angular_sim_granularity);
+      tc_->setIncrementalDistances(incremental_distance_fields);
 
       map_viz_.initialize(name, global_frame_, boost::bind(&TrajectoryPlanner::getCellCosts, tc_, _1, _2, _3, _4, _5, _6));
       initialized_ = true;
@@ -366,8 +380,23 @@ namespace base_local_planner {
     }
 
     //reset the global plan
-    global_plan_.clear();
-    global_plan_ = orig_global_plan;
+    return setPlan(nav_core::PlanConstPtr(new std::vector<geometry_msgs::PoseStamped>(orig_global_plan)), 0);
+  }
+
+  bool TrajectoryPlannerROS::setPlan(const nav_core::PlanConstPtr& plan, unsigned int version){
+    if (! isInitialized()) {
+      ROS_ERROR("This planner has not been initialized, please call initialize() before using this planner");
+      return false;
+    }
+
+    //the same plan again, keep the progress along it
+    if (version != 0 && version == plan_version_ && plan == global_plan_) {
+      return true;
+    }
+
+    global_plan_ = plan;
+    plan_version_ = version;
+    plan_start_ = 0;
     
     //when we get a new plan, we also want to clear any latch we may have on goal tolerances
     xy_tolerance_latch_ = false;
@@ -377,27 +406,39 @@ namespace base_local_planner {
   }
 
   bool TrajectoryPlannerROS::computeVelocityCommands(geometry_msgs::Twist& cmd_vel){
+    NAV_TRACE_SCOPE("TrajectoryPlannerROS::computeVelocityCommands");
     if (! isInitialized()) {
       ROS_ERROR("This planner has not been initialized, please call initialize() before using this planner");
       return false;
     }
 
+    if (use_costmap_snapshot_) {
+      costmap_snapshot_.copyCostsFrom(*costmap_ros_->getCostmapSnapshot());
+    }
+
     std::vector<geometry_msgs::PoseStamped> local_plan;
     tf::Stamped<tf::Pose> global_pose;
     if (!costmap_ros_->getRobotPose(global_pose)) {
       return false;
     }
 
-    std::vector<geometry_msgs::PoseStamped> transformed_plan;
+    //reused across cycles, so transforming the plan does not allocate
+    std::vector<geometry_msgs::PoseStamped>& transformed_plan = transformed_plan_;
     //get the global plan in our frame
-    if (!transformGlobalPlan(*tf_, global_plan_, global_pose, *costmap_, global_frame_, transformed_plan)) {
+    if (!transformGlobalPlan(*tf_, *global_plan_, plan_start_, global_pose, *costmap_, global_frame_, transformed_plan)) {
       ROS_WARN("Could not transform the global plan to the frame of the controller");
       return false;
     }
 
+    //the inflation thresholds follow footprint and inflation changes
+    if (inflation_fast_path_) {
+      costmap_2d::LayeredCostmap* layered_costmap = costmap_ros_->getLayeredCostmap();
+      world_model_->setInflationThresholds(layered_costmap->getInscribedCost(), layered_costmap->getCircumscribedCost());
+    }
+
     //now we'll prune the plan based on the position of the robot
     if(prune_plan_)
-      prunePlan(global_pose, transformed_plan, global_plan_);
+      prunePlan(global_pose, transformed_plan, plan_start_);
 
     tf::Stamped<tf::Pose> drive_cmds;
     drive_cmds.frame_id_ = robot_base_frame_;
@@ -594,6 +635,12 @@ namespace base_local_planner {
     return -1.0;
   }
 
+  void TrajectoryPlannerROS::setControlDeadline(const ros::WallTime& deadline) {
+    if (tc_ != NULL) {
+      tc_->setDeadline(deadline);
+    }
+  }
+
   bool TrajectoryPlannerROS::isGoalReached() {
     if (! isInitialized()) {
       ROS_ERROR("This planner has not been initialized, please call initialize() before using this planner");
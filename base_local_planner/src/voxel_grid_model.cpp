@@ -44,7 +44,9 @@ namespace base_local_planner {
           double origin_x, double origin_y, double origin_z, double max_z, double obstacle_range) :
     obstacle_grid_(size_x, size_y, size_z), xy_resolution_(xy_resolution), z_resolution_(z_resolution), 
     origin_x_(origin_x), origin_y_(origin_y), origin_z_(origin_z),
-    max_z_(max_z), sq_obstacle_range_(obstacle_range * obstacle_range) {}
+    max_z_(max_z), sq_obstacle_range_(obstacle_range * obstacle_range) {
+    updateColumnMask();
+  }
 
   double VoxelGridModel::footprintCost(const geometry_msgs::Point& position, const std::vector<geometry_msgs::Point>& footprint, 
       double inscribed_radius, double circumscribed_radius){
@@ -171,14 +173,29 @@ namespace base_local_planner {
   }
 
   double VoxelGridModel::pointCost(int x, int y){
+    //cells outside of the grid are unknown, which counts as an obstacle
+    if(x < 0 || y < 0 || (unsigned int)x >= obstacle_grid_.sizeX() || (unsigned int)y >= obstacle_grid_.sizeY())
+      return -1;
+
     //if the cell is in an obstacle the path is invalid
-    if(obstacle_grid_.getVoxelColumn(x, y)){
+    if(column_mask_[y * obstacle_grid_.sizeX() + x]){
       return -1;
     }
 
     return 1;
   }
 
+  void VoxelGridModel::updateColumnMask(){
+    unsigned int size_x = obstacle_grid_.sizeX();
+    unsigned int size_y = obstacle_grid_.sizeY();
+    column_mask_.resize(size_x * size_y);
+    for(unsigned int j = 0; j < size_y; ++j){
+      for(unsigned int i = 0; i < size_x; ++i){
+        column_mask_[j * size_x + i] = obstacle_grid_.getVoxelColumn(i, j) != voxel_grid::FREE;
+      }
+    }
+  }
+
   void VoxelGridModel::updateWorld(const std::vector<geometry_msgs::Point>& footprint, 
       const vector<Observation>& observations, const vector<PlanarLaserScan>& laser_scans){
 
@@ -210,6 +227,8 @@ namespace base_local_planner {
 
     //remove the points that are in the footprint of the robot
     //removePointsInPolygon(footprint);
+
+    updateColumnMask();
   }
 
   void VoxelGridModel::removePointsInScanBoundry(const PlanarLaserScan& laser_scan, double raytrace_range){
@@ -224,6 +243,8 @@ namespace base_local_planner {
     if(!worldToMap3D(ox, oy, oz, sensor_x, sensor_y, sensor_z))
       return;
 
+    //all rays start at the sensor, so they are collected and cleared in one batch
+    clear_ends_.clear();
     for(unsigned int i = 0; i < laser_scan.cloud.points.size(); ++i){
       double wpx = laser_scan.cloud.points[i].x;
       double wpy = laser_scan.cloud.points[i].y;
@@ -261,9 +282,14 @@ namespace base_local_planner {
 
       unsigned int point_x, point_y, point_z;
       if(worldToMap3D(wpx, wpy, wpz, point_x, point_y, point_z)){
-        obstacle_grid_.clearVoxelLine(sensor_x, sensor_y, sensor_z, point_x, point_y, point_z);
+        clear_ends_.push_back(point_x);
+        clear_ends_.push_back(point_y);
+        clear_ends_.push_back(point_z);
       }
     }
+
+    if(!clear_ends_.empty())
+      obstacle_grid_.clearVoxelLines(sensor_x, sensor_y, sensor_z, &clear_ends_[0], clear_ends_.size() / 3);
   }
 
   void VoxelGridModel::getPoints(pcl::PointCloud<pcl::PointXYZ>& cloud){
@@ -0,0 +1,217 @@
+/*
+ * costmap_model_test.cpp
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <base_local_planner/costmap_model.h>
+#include <base_local_planner/obstacle_cost_function.h>
+#include <costmap_2d/costmap_2d.h>
+#include <costmap_2d/cost_values.h>
+
+namespace base_local_planner {
+
+static std::vector<geometry_msgs::Point> rectangleFootprint() {
+  std::vector<geometry_msgs::Point> footprint_spec;
+  geometry_msgs::Point pt;
+  pt.x = 0.6; pt.y = 0.3;
+  footprint_spec.push_back(pt);
+  pt.x = 0.6; pt.y = -0.3;
+  footprint_spec.push_back(pt);
+  pt.x = -0.4; pt.y = -0.3;
+  footprint_spec.push_back(pt);
+  pt.x = -0.4; pt.y = 0.3;
+  footprint_spec.push_back(pt);
+  return footprint_spec;
+}
+
+TEST(CostmapModelTest, footprintMasksAreConservative){
+  costmap_2d::Costmap2D costmap(100, 100, 0.05, 0.0, 0.0);
+  for (unsigned int i = 0; i < 100; ++i) {
+    costmap.setCost(i, 60, costmap_2d::LETHAL_OBSTACLE);
+    costmap.setCost(30, i, 100);
+  }
+
+  std::vector<geometry_msgs::Point> footprint_spec = rectangleFootprint();
+  CostmapModel exact(costmap);
+  CostmapModel masked(costmap);
+  masked.setFootprintMasks(64);
+
+  for (double x = 0.5; x < 4.5; x += 0.07) {
+    for (double y = 0.5; y < 4.5; y += 0.07) {
+      for (double th = -M_PI; th < M_PI; th += 0.3) {
+        double exact_cost = exact.footprintCost(x, y, th, footprint_spec);
+        double masked_cost = masked.footprintCost(x, y, th, footprint_spec);
+        if (exact_cost < 0) {
+          EXPECT_LT(masked_cost, 0);
+        } else if (masked_cost >= 0) {
+          EXPECT_GE(masked_cost, exact_cost);
+        }
+      }
+    }
+  }
+}
+
+TEST(CostmapModelTest, sweptFootprintIsConservative){
+  costmap_2d::Costmap2D costmap(100, 100, 0.05, 0.0, 0.0);
+  for (unsigned int i = 0; i < 100; ++i) {
+    costmap.setCost(i, 60, costmap_2d::LETHAL_OBSTACLE);
+    costmap.setCost(30, i, 100);
+  }
+
+  std::vector<geometry_msgs::Point> footprint_spec = rectangleFootprint();
+  CostmapModel model(costmap);
+
+  unsigned int legal = 0;
+  for (double x = 0.5; x < 4.5; x += 0.07) {
+    for (double y = 0.5; y < 4.5; y += 0.07) {
+      double swept_cost = model.sweptFootprintCost(x, y, footprint_spec);
+      if (swept_cost < 0)
+        continue;
+      ++legal;
+      for (double th = -M_PI; th < M_PI; th += 0.1) {
+        double cost = model.footprintCost(x, y, th, footprint_spec);
+        EXPECT_GE(cost, 0);
+        EXPECT_GE(swept_cost, cost);
+      }
+    }
+  }
+  //the ring has to clear most of the free space to be of use
+  EXPECT_GT(legal, 500u);
+}
+
+TEST(CostmapModelTest, sweptFootprintMarginCoversDrift){
+  costmap_2d::Costmap2D costmap(100, 100, 0.05, 0.0, 0.0);
+  for (unsigned int i = 0; i < 100; ++i) {
+    costmap.setCost(i, 60, costmap_2d::LETHAL_OBSTACLE);
+    costmap.setCost(30, i, 100);
+  }
+
+  std::vector<geometry_msgs::Point> footprint_spec = rectangleFootprint();
+  CostmapModel model(costmap);
+  const double margin = 0.12;
+
+  unsigned int legal = 0, legal_without_margin = 0;
+  for (double x = 0.7; x < 4.3; x += 0.07) {
+    for (double y = 0.7; y < 4.3; y += 0.07) {
+      if (model.sweptFootprintCost(x, y, footprint_spec) >= 0)
+        ++legal_without_margin;
+      if (model.sweptFootprintCost(x, y, footprint_spec, margin) < 0)
+        continue;
+      ++legal;
+      for (double a = 0.0; a < 2 * M_PI; a += 0.8) {
+        for (double th = -M_PI; th < M_PI; th += 0.2) {
+          EXPECT_GE(model.footprintCost(x + margin * cos(a), y + margin * sin(a), th, footprint_spec), 0);
+        }
+      }
+    }
+  }
+  EXPECT_GT(legal, 0u);
+  EXPECT_LT(legal, legal_without_margin);
+}
+
+TEST(CostmapModelTest, footprintMasksOffMap){
+  costmap_2d::Costmap2D costmap(100, 100, 0.05, 0.0, 0.0);
+  std::vector<geometry_msgs::Point> footprint_spec = rectangleFootprint();
+  CostmapModel masked(costmap);
+  masked.setFootprintMasks(16);
+
+  EXPECT_LT(masked.footprintCost(0.1, 2.5, 0.0, footprint_spec), 0);
+  EXPECT_LT(masked.footprintCost(-1.0, 2.5, 0.0, footprint_spec), 0);
+  EXPECT_EQ(0.0, masked.footprintCost(2.5, 2.5, 0.0, footprint_spec));
+}
+
+TEST(CostmapModelTest, inflationThresholds){
+  costmap_2d::Costmap2D costmap(100, 100, 0.05, 0.0, 0.0);
+  costmap.setCost(50, 50, costmap_2d::INSCRIBED_INFLATED_OBSTACLE);
+  costmap.setCost(20, 50, 100);
+  costmap.setCost(80, 50, 10);
+  costmap.setCost(80, 56, costmap_2d::LETHAL_OBSTACLE);
+  costmap.setCost(50, 20, 10);
+  costmap.setCost(50, 26, costmap_2d::NO_INFORMATION);
+  costmap.setCost(50, 80, 10);
+
+  std::vector<geometry_msgs::Point> footprint_spec = rectangleFootprint();
+  CostmapModel model(costmap);
+
+  //without thresholds only the outline counts
+  EXPECT_EQ(0.0, model.footprintCost(2.525, 2.525, 0.0, footprint_spec));
+  EXPECT_LT(model.footprintCost(4.025, 2.525, 0.0, footprint_spec), 0);
+
+  model.setInflationThresholds(costmap_2d::INSCRIBED_INFLATED_OBSTACLE, 50);
+  EXPECT_LT(model.footprintCost(2.525, 2.525, 0.0, footprint_spec), 0);
+  //a cost in the ambiguous band checks the outline
+  EXPECT_EQ(0.0, model.footprintCost(1.025, 2.525, 0.0, footprint_spec));
+  //a low cost is taken as the footprint cost
+  EXPECT_EQ(10.0, model.footprintCost(2.525, 4.025, 0.0, footprint_spec));
+  EXPECT_EQ(10.0, model.sweptFootprintCost(2.525, 4.025, footprint_spec));
+  //from the robot cell alone: the lethal and unknown cells under the outline, which the thresholds
+  //promise cannot exist uninflated, are never read
+  EXPECT_EQ(10.0, model.footprintCost(4.025, 2.525, 0.0, footprint_spec));
+  EXPECT_EQ(10.0, model.footprintCost(2.525, 1.025, 0.0, footprint_spec));
+  EXPECT_EQ(10.0, model.sweptFootprintCost(4.025, 2.525, footprint_spec));
+
+  //without the promise the outline is checked again
+  model.setInflationThresholds(costmap_2d::INSCRIBED_INFLATED_OBSTACLE, 0);
+  EXPECT_LT(model.footprintCost(4.025, 2.525, 0.0, footprint_spec), 0);
+  EXPECT_LT(model.footprintCost(2.525, 1.025, 0.0, footprint_spec), 0);
+  EXPECT_LT(model.sweptFootprintCost(4.025, 2.525, footprint_spec), 0);
+  EXPECT_LT(model.sweptFootprintCost(2.525, 1.025, footprint_spec), 0);
+}
+
+TEST(CostmapModelTest, staticFootprintCostMatchesVirtual){
+  costmap_2d::Costmap2D costmap(100, 100, 0.05, 0.0, 0.0);
+  for (unsigned int i = 0; i < 100; ++i) {
+    costmap.setCost(i, 60, costmap_2d::LETHAL_OBSTACLE);
+    costmap.setCost(30, i, 100);
+  }
+
+  std::vector<geometry_msgs::Point> footprint_spec = rectangleFootprint();
+  CostmapModel model(costmap);
+  WorldModel* world_model = &model;
+
+  for (double x = -0.5; x < 5.5; x += 0.13) {
+    for (double y = -0.5; y < 5.5; y += 0.13) {
+      for (double th = -M_PI; th < M_PI; th += 0.7) {
+        EXPECT_EQ(ObstacleCostFunction::footprintCost(x, y, th, 1.0, footprint_spec, &costmap, world_model),
+                  ObstacleCostFunction::footprintCost(x, y, th, 1.0, footprint_spec, &costmap, &model));
+      }
+    }
+  }
+}
+
+TEST(CostmapModelTest, trajectoryCacheFollowsChangedCells){
+  costmap_2d::Costmap2D costmap(100, 100, 0.05, 0.0, 0.0);
+  ObstacleCostFunction occ(&costmap);
+  occ.setParams(1.0, 0.0, 1.0);
+  occ.setFootprint(rectangleFootprint());
+  occ.setTrajectoryCache(true);
+  EXPECT_TRUE(occ.prepare());
+
+  Trajectory traj(0.5, 0.0, 0.0, 0.1, 0);
+  for (unsigned int i = 0; i < 10; ++i) {
+    traj.addPoint(1.0 + 0.05 * i, 2.5, 0.0);
+  }
+  EXPECT_EQ(0.0, occ.scoreTrajectory(traj));
+
+  //the cache answers until the changed cells are reported
+  costmap.setCost(32, 50, costmap_2d::LETHAL_OBSTACLE);
+  EXPECT_TRUE(occ.prepare());
+  EXPECT_EQ(0.0, occ.scoreTrajectory(traj));
+  occ.invalidateTrajectoryCache(80, 90, 80, 90);
+  EXPECT_EQ(0.0, occ.scoreTrajectory(traj));
+  occ.invalidateTrajectoryCache(32, 33, 50, 51);
+  EXPECT_LT(occ.scoreTrajectory(traj), 0);
+
+  //a trajectory from elsewhere is scored again
+  costmap.setCost(32, 50, costmap_2d::FREE_SPACE);
+  Trajectory shifted(0.5, 0.0, 0.0, 0.1, 0);
+  for (unsigned int i = 0; i < 10; ++i) {
+    shifted.addPoint(1.0 + 0.05 * i, 2.0, 0.0);
+  }
+  EXPECT_EQ(0.0, occ.scoreTrajectory(shifted));
+}
+
+}
@@ -0,0 +1,105 @@
+/*
+ * distance_field_cost_function_test.cpp
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include <base_local_planner/distance_field_cost_function.h>
+#include <costmap_2d/costmap_2d.h>
+#include <costmap_2d/cost_values.h>
+
+namespace base_local_planner {
+
+static std::vector<geometry_msgs::Point> rectangleFootprint() {
+  std::vector<geometry_msgs::Point> footprint_spec;
+  geometry_msgs::Point pt;
+  pt.x = 0.6; pt.y = 0.3;
+  footprint_spec.push_back(pt);
+  pt.x = 0.6; pt.y = -0.3;
+  footprint_spec.push_back(pt);
+  pt.x = -0.4; pt.y = -0.3;
+  footprint_spec.push_back(pt);
+  pt.x = -0.4; pt.y = 0.3;
+  footprint_spec.push_back(pt);
+  return footprint_spec;
+}
+
+TEST(DistanceFieldCostFunctionTest, distancesMatchBruteForce){
+  costmap_2d::Costmap2D costmap(40, 30, 0.1, 0.0, 0.0);
+  std::vector<std::pair<unsigned int, unsigned int> > obstacles;
+  srand(7);
+  for (unsigned int i = 0; i < 12; ++i) {
+    unsigned int x = rand() % 40, y = rand() % 30;
+    costmap.setCost(x, y, i % 3 ? costmap_2d::LETHAL_OBSTACLE : costmap_2d::NO_INFORMATION);
+    obstacles.push_back(std::make_pair(x, y));
+  }
+  //inflated cells are no obstacles
+  costmap.setCost(0, 0, costmap_2d::INSCRIBED_INFLATED_OBSTACLE);
+
+  DistanceFieldCostFunction dfcf(&costmap);
+  dfcf.setScale(1.0);
+  EXPECT_TRUE(dfcf.prepare());
+  for (unsigned int x = 0; x < 40; ++x) {
+    for (unsigned int y = 0; y < 30; ++y) {
+      double best = 1e9;
+      for (unsigned int i = 0; i < obstacles.size(); ++i) {
+        best = std::min(best, hypot((double)x - obstacles[i].first, (double)y - obstacles[i].second));
+      }
+      EXPECT_NEAR(best * 0.1, dfcf.getDistance(x, y), 1e-5);
+    }
+  }
+}
+
+TEST(DistanceFieldCostFunctionTest, circlesCoverFootprint){
+  std::vector<geometry_msgs::Point> footprint_spec = rectangleFootprint();
+  std::vector<geometry_msgs::Point> centers;
+  double radius;
+  DistanceFieldCostFunction::coverFootprint(footprint_spec, 3, centers, radius);
+  ASSERT_EQ(3u, centers.size());
+  for (double x = -0.4; x <= 0.6; x += 0.05) {
+    for (double y = -0.3; y <= 0.3; y += 0.05) {
+      bool covered = false;
+      for (unsigned int i = 0; i < centers.size(); ++i) {
+        covered = covered || hypot(x - centers[i].x, y - centers[i].y) <= radius + 1e-9;
+      }
+      EXPECT_TRUE(covered);
+    }
+  }
+}
+
+TEST(DistanceFieldCostFunctionTest, scoresClearance){
+  costmap_2d::Costmap2D costmap(100, 100, 0.05, 0.0, 0.0);
+  for (unsigned int i = 0; i < 100; ++i) {
+    costmap.setCost(i, 60, costmap_2d::LETHAL_OBSTACLE);
+  }
+  DistanceFieldCostFunction dfcf(&costmap);
+  dfcf.setFootprint(rectangleFootprint());
+  dfcf.setMaxClearance(0.5);
+  dfcf.setScale(1.0);
+  EXPECT_TRUE(dfcf.prepare());
+
+  Trajectory far(0.0, 0.0, 0.0, 0.1, 0);
+  far.addPoint(2.5, 1.0, 0.0);
+  EXPECT_EQ(0.0, dfcf.scoreTrajectory(far));
+
+  Trajectory near(0.0, 0.0, 0.0, 0.1, 0);
+  near.addPoint(2.5, 1.0, 0.0);
+  near.addPoint(2.5, 2.3, 0.0);
+  double near_cost = dfcf.scoreTrajectory(near);
+  EXPECT_GT(near_cost, 0.0);
+  EXPECT_LT(near_cost, costmap_2d::INSCRIBED_INFLATED_OBSTACLE);
+
+  Trajectory hit(0.0, 0.0, 0.0, 0.1, 0);
+  hit.addPoint(2.5, 2.8, 0.0);
+  EXPECT_LT(dfcf.scoreTrajectory(hit), 0);
+
+  Trajectory off(0.0, 0.0, 0.0, 0.1, 0);
+  off.addPoint(0.1, 1.0, 0.0);
+  EXPECT_LT(dfcf.scoreTrajectory(off), 0);
+}
+
+}
@@ -127,6 +127,15 @@ public:
     EXPECT_EQ(footprint[17].x, 2); EXPECT_EQ(footprint[17].y, 4);
     EXPECT_EQ(footprint[18].x, 2); EXPECT_EQ(footprint[18].y, 5);
     EXPECT_EQ(footprint[19].x, 2); EXPECT_EQ(footprint[19].y, 6);
+
+    //filling a reused vector gives the same cells, without the previous ones
+    std::vector<base_local_planner::Position2DInt> reused = footprint;
+    fh.getFootprintCells(pos, footprint_spec, map, true, reused);
+    footprint = fh.getFootprintCells(pos, footprint_spec, map, true);
+    ASSERT_EQ(footprint.size(), reused.size());
+    for (unsigned int i = 0; i < footprint.size(); ++i) {
+      EXPECT_EQ(footprint[i].x, reused[i].x); EXPECT_EQ(footprint[i].y, reused[i].y);
+    }
   }
 
 };
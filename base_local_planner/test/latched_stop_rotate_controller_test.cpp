@@ -0,0 +1,117 @@
+/*
+ * latched_stop_rotate_controller_test.cpp
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <base_local_planner/latched_stop_rotate_controller.h>
+#include <base_local_planner/costmap_model.h>
+#include <costmap_2d/costmap_2d.h>
+#include <costmap_2d/cost_values.h>
+
+namespace base_local_planner {
+
+static std::vector<geometry_msgs::Point> squareFootprint() {
+  std::vector<geometry_msgs::Point> footprint_spec;
+  geometry_msgs::Point pt;
+  pt.x = 0.3; pt.y = 0.3;
+  footprint_spec.push_back(pt);
+  pt.x = 0.3; pt.y = -0.3;
+  footprint_spec.push_back(pt);
+  pt.x = -0.3; pt.y = -0.3;
+  footprint_spec.push_back(pt);
+  pt.x = -0.3; pt.y = 0.3;
+  footprint_spec.push_back(pt);
+  return footprint_spec;
+}
+
+static bool countedCheck(unsigned int* calls, bool result, Eigen::Vector3f, Eigen::Vector3f, Eigen::Vector3f) {
+  ++*calls;
+  return result;
+}
+
+static tf::Stamped<tf::Pose> pose(double x, double y, double th) {
+  return tf::Stamped<tf::Pose>(tf::Pose(tf::createQuaternionFromYaw(th), tf::Point(x, y, 0.0)), ros::Time(), "map");
+}
+
+static LocalPlannerLimits rotationLimits() {
+  LocalPlannerLimits limits;
+  limits.max_rot_vel = 1.0;
+  limits.min_rot_vel = 0.4;
+  return limits;
+}
+
+TEST(LatchedStopRotateControllerTest, sweptRingClearsRotation){
+  // 5m x 5m, a wall at y = 3m
+  costmap_2d::Costmap2D costmap(100, 100, 0.05, 0.0, 0.0);
+  for (unsigned int i = 0; i < 100; ++i) {
+    costmap.setCost(i, 60, costmap_2d::LETHAL_OBSTACLE);
+  }
+  CostmapModel model(costmap);
+  LatchedStopRotateController controller(false);
+  LocalPlannerLimits limits = rotationLimits();
+  Eigen::Vector3f acc_lim(1.0, 1.0, 2.0);
+  geometry_msgs::Twist cmd_vel;
+  unsigned int calls = 0;
+
+  // without a swept check every rotation is simulated
+  EXPECT_FALSE(controller.rotateToGoal(pose(2.5, 1.5, 0.0), pose(0.0, 0.0, 0.0), 1.0, cmd_vel, acc_lim, 0.1, limits,
+      boost::bind(countedCheck, &calls, false, _1, _2, _3)));
+  EXPECT_EQ(1u, calls);
+  EXPECT_EQ(0.0, cmd_vel.angular.z);
+
+  // away from the wall the ring clears the rotation without simulating it
+  controller.setSweptCheck(&model, squareFootprint());
+  calls = 0;
+  EXPECT_TRUE(controller.rotateToGoal(pose(2.5, 1.5, 0.0), pose(0.0, 0.0, 0.0), 1.0, cmd_vel, acc_lim, 0.1, limits,
+      boost::bind(countedCheck, &calls, false, _1, _2, _3)));
+  EXPECT_EQ(0u, calls);
+  EXPECT_GT(cmd_vel.angular.z, 0.0);
+  EXPECT_EQ(0.0, cmd_vel.linear.x);
+  EXPECT_EQ(0.0, cmd_vel.linear.y);
+
+  // the ring of a robot next to the wall reaches into it, the rotation is simulated again
+  calls = 0;
+  EXPECT_TRUE(controller.rotateToGoal(pose(2.5, 2.7, 0.0), pose(0.0, 0.0, 0.0), -1.0, cmd_vel, acc_lim, 0.1, limits,
+      boost::bind(countedCheck, &calls, true, _1, _2, _3)));
+  EXPECT_EQ(1u, calls);
+  EXPECT_LT(cmd_vel.angular.z, 0.0);
+}
+
+TEST(LatchedStopRotateControllerTest, sweptRingClearsStopOnlyWithoutTranslation){
+  costmap_2d::Costmap2D costmap(100, 100, 0.05, 0.0, 0.0);
+  for (unsigned int i = 0; i < 100; ++i) {
+    costmap.setCost(i, 60, costmap_2d::LETHAL_OBSTACLE);
+  }
+  CostmapModel model(costmap);
+  LatchedStopRotateController controller(false);
+  controller.setSweptCheck(&model, squareFootprint());
+  Eigen::Vector3f acc_lim(1.0, 1.0, 2.0);
+  geometry_msgs::Twist cmd_vel;
+  unsigned int calls = 0;
+
+  // braking from 0.05m/s stops the translation within one period, the ring covers the drift
+  EXPECT_TRUE(controller.stopWithAccLimits(pose(2.5, 1.5, 0.0), pose(0.05, 0.0, 0.5), cmd_vel, acc_lim, 0.1,
+      boost::bind(countedCheck, &calls, false, _1, _2, _3)));
+  EXPECT_EQ(0u, calls);
+  EXPECT_EQ(0.0, cmd_vel.linear.x);
+  EXPECT_NEAR(0.3, cmd_vel.angular.z, 1e-6);
+
+  // a command that still translates is always simulated
+  EXPECT_FALSE(controller.stopWithAccLimits(pose(2.5, 1.5, 0.0), pose(0.5, 0.0, 0.0), cmd_vel, acc_lim, 0.1,
+      boost::bind(countedCheck, &calls, false, _1, _2, _3)));
+  EXPECT_EQ(1u, calls);
+  EXPECT_EQ(0.0, cmd_vel.linear.x);
+
+  // next to the wall the ring no longer clears the stop
+  calls = 0;
+  EXPECT_FALSE(controller.stopWithAccLimits(pose(2.5, 2.7, 0.0), pose(0.0, 0.05, 0.0), cmd_vel, acc_lim, 0.1,
+      boost::bind(countedCheck, &calls, false, _1, _2, _3)));
+  EXPECT_EQ(1u, calls);
+}
+
+}
@@ -5,9 +5,13 @@
  *      Author: tkruse
  */
 #include <queue>
+#include <cstdlib>
 
 #include <gtest/gtest.h>
 
+#include <costmap_2d/costmap_2d.h>
+#include <costmap_2d/cost_values.h>
+
 #include <base_local_planner/map_grid.h>
 #include <base_local_planner/map_cell.h>
 
@@ -159,4 +163,59 @@ TEST(MapGridTest, distancePropagation){
   EXPECT_EQ(18.0, mg(9, 9).target_dist);
 }
 
+TEST(MapGridTest, incrementalMatchesFull){
+  costmap_2d::Costmap2D costmap(40, 40, 0.1, 0.0, 0.0);
+  MapGrid full_path(40, 40), full_goal(40, 40);
+  MapGrid incremental_path(40, 40), incremental_goal(40, 40);
+  incremental_path.setIncremental(true);
+  incremental_goal.setIncremental(true);
+
+  std::vector<geometry_msgs::PoseStamped> global_plan;
+  for (int i = 0; i < 200; ++i) {
+    geometry_msgs::PoseStamped pose;
+    pose.pose.position.x = 0.5 + 0.04 * i;
+    pose.pose.position.y = 2.0 + sin(0.05 * i);
+    global_plan.push_back(pose);
+  }
+
+  srand(42);
+  double origin_x = 0.0, origin_y = 0.0;
+  for (int cycle = 0; cycle < 60; ++cycle) {
+    //advance the plan and move the window along by whole cells
+    global_plan.erase(global_plan.begin(), global_plan.begin() + 2);
+    if (cycle % 3 == 0) {
+      origin_x += 0.1 * (rand() % 3);
+      origin_y += 0.1 * (rand() % 3 - 1);
+      costmap.updateOrigin(origin_x, origin_y);
+    }
+    for (int i = 0; i < 6; ++i) {
+      unsigned char cost = rand() % 2 ? costmap_2d::LETHAL_OBSTACLE : costmap_2d::FREE_SPACE;
+      costmap.setCost(rand() % 40, rand() % 40, cost);
+    }
+
+    full_path.resetPathDist();
+    full_goal.resetPathDist();
+    incremental_path.resetPathDist();
+    incremental_goal.resetPathDist();
+    unsigned int robot_x = 5 + cycle % 4;
+    for (unsigned int x = robot_x; x < robot_x + 3; ++x) {
+      for (unsigned int y = 18; y < 21; ++y) {
+        full_path(x, y).within_robot = true;
+        incremental_path(x, y).within_robot = true;
+      }
+    }
+    full_path.setTargetCells(costmap, global_plan);
+    full_goal.setLocalGoal(costmap, global_plan);
+    incremental_path.setTargetCells(costmap, global_plan);
+    incremental_goal.setLocalGoal(costmap, global_plan);
+
+    for (unsigned int x = 0; x < 40; ++x) {
+      for (unsigned int y = 0; y < 40; ++y) {
+        ASSERT_EQ(full_path(x, y).target_dist, incremental_path(x, y).target_dist) << cycle << " " << x << " " << y;
+        ASSERT_EQ(full_goal(x, y).target_dist, incremental_goal(x, y).target_dist) << cycle << " " << x << " " << y;
+      }
+    }
+  }
+}
+
 }
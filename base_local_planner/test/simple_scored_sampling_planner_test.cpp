@@ -0,0 +1,216 @@
+/*
+ * simple_scored_sampling_planner_test.cpp
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include <base_local_planner/simple_scored_sampling_planner.h>
+#include <base_local_planner/coarse_to_fine_trajectory_generator.h>
+
+namespace base_local_planner {
+
+class GridGenerator : public TrajectorySampleGenerator {
+public:
+  GridGenerator(int samples) : samples_(samples), next_(0) {}
+
+  bool hasMoreTrajectories() {
+    return next_ < samples_;
+  }
+
+  bool nextTrajectory(Trajectory &traj) {
+    traj.resetPoints();
+    traj.xv_ = next_ % 20;
+    traj.thetav_ = next_ / 20;
+    traj.addPoint(traj.xv_, traj.thetav_, 0.0);
+    next_++;
+    // every seventh sample fails to generate
+    return next_ % 7 != 0;
+  }
+
+  int samples_, next_;
+};
+
+// costs with plenty of ties and invalid trajectories
+class WaveCritic : public TrajectoryCostFunction {
+public:
+  WaveCritic(double scale) : TrajectoryCostFunction(scale) {}
+
+  bool prepare() {
+    return true;
+  }
+
+  double scoreTrajectory(Trajectory &traj) {
+    if (((int)traj.xv_ + (int)traj.thetav_) % 11 == 0) {
+      return -1.0;
+    }
+    return std::floor(5.0 + 4.0 * std::sin(traj.xv_ * 0.7 + traj.thetav_ * 1.3));
+  }
+};
+
+class PlannerResult {
+public:
+  bool found;
+  Trajectory best;
+  std::vector<Trajectory> explored;
+};
+
+static PlannerResult runPlanner(unsigned int threads) {
+  GridGenerator generator(800);
+  WaveCritic first(1.0), second(0.5);
+  std::vector<TrajectorySampleGenerator*> generators;
+  generators.push_back(&generator);
+  std::vector<TrajectoryCostFunction*> critics;
+  critics.push_back(&first);
+  critics.push_back(&second);
+
+  SimpleScoredSamplingPlanner planner(generators, critics);
+  planner.setScoringThreads(threads);
+  PlannerResult result;
+  result.found = planner.findBestTrajectory(result.best, &result.explored);
+  return result;
+}
+
+TEST(SimpleScoredSamplingPlannerTest, parallelScoringPicksSerialBest){
+  PlannerResult serial = runPlanner(1);
+  ASSERT_TRUE(serial.found);
+
+  for (unsigned int threads = 2; threads <= 5; ++threads) {
+    PlannerResult parallel = runPlanner(threads);
+    ASSERT_TRUE(parallel.found);
+    EXPECT_EQ(serial.best.xv_, parallel.best.xv_);
+    EXPECT_EQ(serial.best.thetav_, parallel.best.thetav_);
+    EXPECT_EQ(serial.best.cost_, parallel.best.cost_);
+    ASSERT_EQ(serial.explored.size(), parallel.explored.size());
+    for (unsigned int i = 0; i < serial.explored.size(); ++i) {
+      EXPECT_EQ(serial.explored[i].xv_, parallel.explored[i].xv_);
+      EXPECT_EQ(serial.explored[i].cost_ < 0, parallel.explored[i].cost_ < 0);
+    }
+  }
+}
+
+TEST(SimpleScoredSamplingPlannerTest, deadlineReturnsBestSoFar){
+  for (unsigned int threads = 1; threads <= 3; threads += 2) {
+    GridGenerator generator(800);
+    WaveCritic critic(1.0);
+    std::vector<TrajectorySampleGenerator*> generators;
+    generators.push_back(&generator);
+    std::vector<TrajectoryCostFunction*> critics;
+    critics.push_back(&critic);
+
+    SimpleScoredSamplingPlanner planner(generators, critics);
+    planner.setScoringThreads(threads);
+    // already passed, so sampling stops as soon as there is a valid trajectory
+    planner.setDeadline(ros::WallTime::now() - ros::WallDuration(1.0));
+    Trajectory best;
+    std::vector<Trajectory> explored;
+    ASSERT_TRUE(planner.findBestTrajectory(best, &explored));
+    EXPECT_GE(best.cost_, 0);
+    EXPECT_LT(explored.size(), 800u);
+  }
+}
+
+// samples of several points each
+class LineGenerator : public GridGenerator {
+public:
+  LineGenerator(int samples) : GridGenerator(samples) {}
+
+  bool nextTrajectory(Trajectory &traj) {
+    bool valid = GridGenerator::nextTrajectory(traj);
+    traj.addPoint(traj.xv_ + 1.0, traj.thetav_, 0.5);
+    traj.addPoint(traj.xv_ + 2.0, traj.thetav_, 1.0);
+    return valid;
+  }
+};
+
+TEST(SimpleScoredSamplingPlannerTest, exploredSummaryKeepsEveryStrideEndpoint){
+  for (unsigned int threads = 1; threads <= 3; threads += 2) {
+    std::vector<Trajectory> full, summary;
+    for (int run = 0; run < 2; ++run) {
+      LineGenerator generator(200);
+      WaveCritic critic(1.0);
+      std::vector<TrajectorySampleGenerator*> generators;
+      generators.push_back(&generator);
+      std::vector<TrajectoryCostFunction*> critics;
+      critics.push_back(&critic);
+
+      SimpleScoredSamplingPlanner planner(generators, critics);
+      planner.setScoringThreads(threads);
+      if (run == 1) {
+        planner.setExploredSummary(true, 3);
+      }
+      Trajectory best;
+      ASSERT_TRUE(planner.findBestTrajectory(best, run == 0 ? &full : &summary));
+    }
+
+    ASSERT_EQ((full.size() + 2) / 3, summary.size());
+    for (unsigned int i = 0; i < summary.size(); ++i) {
+      const Trajectory& sample = full[3 * i];
+      EXPECT_EQ(sample.xv_, summary[i].xv_);
+      EXPECT_EQ(sample.thetav_, summary[i].thetav_);
+      EXPECT_EQ(sample.cost_ < 0, summary[i].cost_ < 0);
+      ASSERT_EQ(3u, sample.getPointsSize());
+      ASSERT_EQ(1u, summary[i].getPointsSize());
+      double x, y, th, end_x, end_y, end_th;
+      sample.getEndpoint(x, y, th);
+      summary[i].getPoint(0, end_x, end_y, end_th);
+      EXPECT_EQ(x, end_x);
+      EXPECT_EQ(y, end_y);
+      EXPECT_EQ(th, end_th);
+    }
+  }
+}
+
+// prefers one velocity in between the coarse samples
+class TargetVelocityCritic : public TrajectoryCostFunction {
+public:
+  TargetVelocityCritic() : TrajectoryCostFunction(1.0) {}
+
+  bool prepare() {
+    return true;
+  }
+
+  double scoreTrajectory(Trajectory &traj) {
+    return std::fabs(traj.xv_ - 0.63) + std::fabs(traj.thetav_ - 0.21);
+  }
+};
+
+static Trajectory runCoarseToFine(int levels, unsigned int threads, int* num_explored) {
+  LocalPlannerLimits limits(1.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 10.0, 10.0, 10.0, 10.0, 10.0, 0.1, 0.1);
+  CoarseToFineTrajectoryGenerator generator;
+  generator.setParameters(1.0, 0.1, 0.1, true, 0.2);
+  generator.setCoarseToFine(levels, 2, 3);
+  generator.initialise(Eigen::Vector3f::Zero(), Eigen::Vector3f(0.5, 0.0, 0.0), Eigen::Vector3f::Zero(),
+      &limits, Eigen::Vector3f(3, 1, 5));
+
+  TargetVelocityCritic critic;
+  std::vector<TrajectorySampleGenerator*> generators;
+  generators.push_back(&generator);
+  std::vector<TrajectoryCostFunction*> critics;
+  critics.push_back(&critic);
+  SimpleScoredSamplingPlanner planner(generators, critics);
+  planner.setScoringThreads(threads);
+
+  Trajectory best;
+  std::vector<Trajectory> explored;
+  EXPECT_TRUE(planner.findBestTrajectory(best, &explored));
+  *num_explored = explored.size();
+  return best;
+}
+
+TEST(SimpleScoredSamplingPlannerTest, coarseToFineRefinesAroundBest){
+  int coarse_explored, fine_explored, parallel_explored;
+  Trajectory coarse = runCoarseToFine(0, 1, &coarse_explored);
+  Trajectory fine = runCoarseToFine(3, 1, &fine_explored);
+  EXPECT_GT(fine_explored, coarse_explored);
+  EXPECT_LT(fine.cost_, 0.5 * coarse.cost_);
+
+  Trajectory parallel = runCoarseToFine(3, 3, &parallel_explored);
+  EXPECT_EQ(fine_explored, parallel_explored);
+  EXPECT_EQ(fine.xv_, parallel.xv_);
+  EXPECT_EQ(fine.thetav_, parallel.thetav_);
+}
+
+}
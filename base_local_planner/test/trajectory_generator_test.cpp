@@ -8,6 +8,7 @@
 #include <gtest/gtest.h>
 
 #include <vector>
+#include <algorithm>
 
 #include <base_local_planner/simple_trajectory_generator.h>
 
@@ -22,5 +23,41 @@ public:
 
   virtual void TestBody(){}
 };
+
+static std::vector<Eigen::Vector3f> generateSamples(SimpleTrajectoryGenerator& generator) {
+  std::vector<Eigen::Vector3f> samples;
+  Trajectory traj;
+  while (generator.hasMoreTrajectories()) {
+    if (generator.nextTrajectory(traj)) {
+      samples.push_back(Eigen::Vector3f(traj.xv_, traj.yv_, traj.thetav_));
+    }
+  }
+  return samples;
+}
+
+TEST(TrajectoryGeneratorTest, prioritizedSamplesStartAtPreviousCommand){
+  LocalPlannerLimits limits(1.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 10.0, 10.0, 10.0, 10.0, 10.0, 0.1, 0.1);
+  SimpleTrajectoryGenerator generator;
+  generator.setParameters(1.0, 0.1, 0.1, true, 0.2);
+  generator.initialise(Eigen::Vector3f::Zero(), Eigen::Vector3f(0.5, 0.0, 0.0), Eigen::Vector3f::Zero(),
+      &limits, Eigen::Vector3f(5, 1, 5));
+  std::vector<Eigen::Vector3f> regular = generateSamples(generator);
+
+  generator.setPrioritizeSamples(true);
+  generator.setPreviousCommand(Eigen::Vector3f(0.7, 0.0, 1.0));
+  generator.initialise(Eigen::Vector3f::Zero(), Eigen::Vector3f(0.5, 0.0, 0.0), Eigen::Vector3f::Zero(),
+      &limits, Eigen::Vector3f(5, 1, 5));
+  std::vector<Eigen::Vector3f> prioritized = generateSamples(generator);
+
+  // the same samples, the one closest to the previous command first and the farthest last
+  ASSERT_EQ(regular.size(), prioritized.size());
+  for (unsigned int i = 0; i < regular.size(); ++i) {
+    EXPECT_EQ(1, std::count(prioritized.begin(), prioritized.end(), regular[i]));
+  }
+  EXPECT_NEAR(0.75, prioritized.front()[0], 1e-5);
+  EXPECT_NEAR(1.0, prioritized.front()[2], 1e-5);
+  EXPECT_NEAR(0.0, prioritized.back()[0], 1e-5);
+  EXPECT_NEAR(-1.0, prioritized.back()[2], 1e-5);
+}
   
 }
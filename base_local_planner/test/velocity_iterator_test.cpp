@@ -175,4 +175,18 @@ TEST(VelocityIteratorTest, test_cranky) {
   }
 }
 
+TEST(VelocityIteratorTest, test_set_range) {
+  // refilling an iterator gives the samples of a new one
+  base_local_planner::VelocityIterator x_it(-30, 30, 4);
+  x_it++;
+  x_it.setRange(-10, 50, 4);
+  double expected[5] = {-10.0, 0.0, 10.0, 30.0, 50.0};
+  int i = 0;
+  for(; !x_it.isFinished(); x_it++) {
+    EXPECT_FLOAT_EQ(expected[i], x_it.getVelocity());
+    i++;
+  }
+  EXPECT_EQ(5, i);
+}
+
 } // namespace
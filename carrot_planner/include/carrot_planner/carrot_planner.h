@@ -89,7 +89,10 @@ namespace carrot_planner{
       costmap_2d::Costmap2DROS* costmap_ros_;
       double step_size_, min_dist_from_robot_;
       costmap_2d::Costmap2D* costmap_;
-      base_local_planner::WorldModel* world_model_; ///< @brief The world model that the controller will use
+      base_local_planner::CostmapModel* world_model_; ///< @brief The world model that the controller will use
+      bool inflation_precheck_; ///< @brief Decide the checks from the inflated cost of the robot cell where possible
+      bool binary_search_; ///< @brief Bisect for the legal target instead of walking back from the goal
+      std::vector<geometry_msgs::Point> footprint_; ///< @brief The footprint of the current plan
 
       /**
        * @brief  Checks the legality of the robot footprint at a position and orientation using the world model
@@ -100,6 +103,12 @@ namespace carrot_planner{
        */
       double footprintCost(double x_i, double y_i, double theta_i);
 
+      /**
+       * @brief  Checks the footprint at the point a fraction of the way from the start to the goal
+       */
+      bool legalAt(double scale, double start_x, double start_y, double start_yaw,
+          double diff_x, double diff_y, double diff_yaw);
+
       bool initialized_;
   };
 };  
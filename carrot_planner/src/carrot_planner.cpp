@@ -36,6 +36,8 @@
 *********************************************************************/
 #include <carrot_planner/carrot_planner.h>
 #include <pluginlib/class_list_macros.h>
+#include <nav_trace/trace.h>
+#include <algorithm>
 
 //register this planner as a BaseGlobalPlanner plugin
 PLUGINLIB_EXPORT_CLASS(carrot_planner::CarrotPlanner, nav_core::BaseGlobalPlanner)
@@ -60,6 +62,14 @@ namespace carrot_planner {
       private_nh.param("min_dist_from_robot", min_dist_from_robot_, 0.10);
       world_model_ = new base_local_planner::CostmapModel(*costmap_); 
 
+      //the footprint checks can look up cells precomputed for a number of headings instead of
+      //rasterizing the footprint, see CostmapModel::setFootprintMasks
+      int mask_headings;
+      private_nh.param("footprint_mask_headings", mask_headings, 0);
+      world_model_->setFootprintMasks(std::max(mask_headings, 0));
+      private_nh.param("inflation_precheck", inflation_precheck_, false);
+      private_nh.param("binary_search", binary_search_, false);
+
       initialized_ = true;
     }
     else
@@ -73,19 +83,25 @@ namespace carrot_planner {
       return -1.0;
     }
 
-    std::vector<geometry_msgs::Point> footprint = costmap_ros_->getRobotFootprint();
     //if we have no footprint... do nothing
-    if(footprint.size() < 3)
+    if(footprint_.size() < 3)
       return -1.0;
 
     //check if the footprint is legal
-    double footprint_cost = world_model_->footprintCost(x_i, y_i, theta_i, footprint);
+    double footprint_cost = world_model_->footprintCost(x_i, y_i, theta_i, footprint_);
     return footprint_cost;
   }
 
+  bool CarrotPlanner::legalAt(double scale, double start_x, double start_y, double start_yaw,
+      double diff_x, double diff_y, double diff_yaw){
+    return footprintCost(start_x + scale * diff_x, start_y + scale * diff_y,
+        angles::normalize_angle(start_yaw + scale * diff_yaw)) >= 0;
+  }
+
 
   bool CarrotPlanner::makePlan(const geometry_msgs::PoseStamped& start, 
       const geometry_msgs::PoseStamped& goal, std::vector<geometry_msgs::PoseStamped>& plan){
+    NAV_TRACE_SCOPE("CarrotPlanner::makePlan");
 
     if(!initialized_){
       ROS_ERROR("The planner has not been initialized, please call initialize() to use the planner");
@@ -96,6 +112,11 @@ namespace carrot_planner {
 
     plan.clear();
     costmap_ = costmap_ros_->getCostmap();
+    footprint_ = costmap_ros_->getRobotFootprint();
+    if(inflation_precheck_){
+      costmap_2d::LayeredCostmap* layered_costmap = costmap_ros_->getLayeredCostmap();
+      world_model_->setInflationThresholds(layered_costmap->getInscribedCost(), layered_costmap->getCircumscribedCost());
+    }
 
     if(goal.header.frame_id != costmap_ros_->getGlobalFrameID()){
       ROS_ERROR("This planner as configured will only accept goals in the %s frame, but a goal was sent in the %s frame.", 
@@ -131,6 +152,24 @@ namespace carrot_planner {
     double scale = 1.0;
     double dScale = 0.01;
 
+    //bisect between the start and the goal for a legal target next to an illegal one; this takes
+    //a handful of checks instead of up to a hundred, but where the line passes several obstacles
+    //the target may be short of the last legal point before the goal
+    if(binary_search_ && !legalAt(1.0, start_x, start_y, start_yaw, diff_x, diff_y, diff_yaw)
+        && legalAt(0.0, start_x, start_y, start_yaw, diff_x, diff_y, diff_yaw))
+    {
+      double legal = 0.0, illegal = 1.0;
+      while(illegal - legal > dScale)
+      {
+        double mid = 0.5 * (legal + illegal);
+        if(legalAt(mid, start_x, start_y, start_yaw, diff_x, diff_y, diff_yaw))
+          legal = mid;
+        else
+          illegal = mid;
+      }
+      scale = legal;
+    }
+
     while(!done)
     {
       if(scale < 0)
@@ -37,6 +37,7 @@
 #include <clear_costmap_recovery/clear_costmap_recovery.h>
 #include <pluginlib/class_list_macros.h>
 #include <vector>
+#include <algorithm>
 
 //register this planner as a RecoveryBehavior plugin
 PLUGINLIB_DECLARE_CLASS(clear_costmap_recovery, ClearCostmapRecovery, clear_costmap_recovery::ClearCostmapRecovery, nav_core::RecoveryBehavior)
@@ -135,18 +136,20 @@ void ClearCostmapRecovery::clearMap(boost::shared_ptr<costmap_2d::CostmapLayer>
   costmap->worldToMapNoBounds(start_point_x, start_point_y, start_x, start_y);
   costmap->worldToMapNoBounds(end_point_x, end_point_y, end_x, end_y);
 
-  unsigned char* grid = costmap->getCharMap();
-  for(int x=0; x<(int)costmap->getSizeInCellsX(); x++){
-    bool xrange = x>start_x && x<end_x;
-                   
-    for(int y=0; y<(int)costmap->getSizeInCellsY(); y++){
-      if(xrange && y>start_y && y<end_y)
-        continue;
-      int index = costmap->getIndex(x,y);
-      if(grid[index]!=NO_INFORMATION){
-        grid[index] = NO_INFORMATION;
-      }
-    }
+  //everything but the cells strictly inside the window is cleared, as rows below, above and beside it
+  int size_x = costmap->getSizeInCellsX(), size_y = costmap->getSizeInCellsY();
+  unsigned int keep_x0 = std::min(std::max(start_x + 1, 0), size_x);
+  unsigned int keep_xn = std::min(std::max(end_x, 0), size_x);
+  unsigned int keep_y0 = std::min(std::max(start_y + 1, 0), size_y);
+  unsigned int keep_yn = std::min(std::max(end_y, 0), size_y);
+  if(keep_x0 >= keep_xn || keep_y0 >= keep_yn){
+    costmap->setRegionCost(0, 0, size_x, size_y, NO_INFORMATION);
+  }
+  else{
+    costmap->setRegionCost(0, 0, size_x, keep_y0, NO_INFORMATION);
+    costmap->setRegionCost(0, keep_yn, size_x, size_y, NO_INFORMATION);
+    costmap->setRegionCost(0, keep_y0, keep_x0, keep_yn, NO_INFORMATION);
+    costmap->setRegionCost(keep_xn, keep_y0, size_x, keep_yn, NO_INFORMATION);
   }
 
   double ox = costmap->getOriginX(), oy = costmap->getOriginY();
@@ -0,0 +1,138 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2009, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of Willow Garage, Inc. nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*
+*********************************************************************/
+#include <clear_costmap_recovery/raytrace_clear_recovery.h>
+#include <pluginlib/class_list_macros.h>
+
+//register this planner as a RecoveryBehavior plugin
+PLUGINLIB_DECLARE_CLASS(clear_costmap_recovery, RaytraceClearRecovery, clear_costmap_recovery::RaytraceClearRecovery, nav_core::RecoveryBehavior)
+
+namespace clear_costmap_recovery {
+RaytraceClearRecovery::RaytraceClearRecovery(): global_costmap_(NULL), local_costmap_(NULL), 
+  tf_(NULL), initialized_(false), timeout_(1.0) {} 
+
+void RaytraceClearRecovery::initialize(std::string name, tf::TransformListener* tf,
+    costmap_2d::Costmap2DROS* global_costmap, costmap_2d::Costmap2DROS* local_costmap){
+  if(!initialized_){
+    name_ = name;
+    tf_ = tf;
+    global_costmap_ = global_costmap;
+    local_costmap_ = local_costmap;
+
+    //get some parameters from the parameter server
+    ros::NodeHandle private_nh("~/" + name_);
+
+    //how long to wait for the costmaps to update
+    private_nh.param("timeout", timeout_, 1.0);
+
+    std::vector<std::string> clearable_layers_default, clearable_layers;
+    clearable_layers_default.push_back( std::string("obstacles") );
+    private_nh.param("layer_names", clearable_layers, clearable_layers_default);
+
+    for(unsigned i=0; i < clearable_layers.size(); i++) {
+        ROS_INFO("Recovery behavior will raytrace layer %s", clearable_layers[i].c_str());
+        clearable_layers_.insert(clearable_layers[i]);
+    }
+
+    initialized_ = true;
+  }
+  else{
+    ROS_ERROR("You should not call initialize twice on this object, doing nothing");
+  }
+}
+
+void RaytraceClearRecovery::runBehavior(){
+  if(!initialized_){
+    ROS_ERROR("This object must be initialized before runBehavior is called");
+    return;
+  }
+
+  if(global_costmap_ == NULL || local_costmap_ == NULL){
+    ROS_ERROR("The costmaps passed to the RaytraceClearRecovery object cannot be NULL. Doing nothing.");
+    return;
+  }
+  ROS_WARN("Clearing the space the sensors see free to unstuck robot.");
+
+  std::vector<boost::shared_ptr<costmap_2d::ObstacleLayer> > requested;
+  request(global_costmap_, requested);
+  request(local_costmap_, requested);
+  if(requested.empty()){
+    ROS_WARN("None of the layers to clear is an enabled obstacle layer, nothing is cleared.");
+    return;
+  }
+
+  //the layers raytrace in their own update, the plan should only be made once they did
+  ros::Time deadline = ros::Time::now() + ros::Duration(timeout_);
+  ros::Rate r(20.0);
+  while(ros::ok()){
+    bool pending = false;
+    for(unsigned int i = 0; i < requested.size() && !pending; ++i)
+      pending = requested[i]->isFullRangeClearingPending();
+    if(!pending)
+      return;
+    if(ros::Time::now() > deadline){
+      ROS_WARN("The costmaps did not update within %.2f seconds, the space may not be cleared yet.", timeout_);
+      return;
+    }
+    r.sleep();
+  }
+}
+
+void RaytraceClearRecovery::request(costmap_2d::Costmap2DROS* costmap,
+    std::vector<boost::shared_ptr<costmap_2d::ObstacleLayer> >& requested){
+  std::vector<boost::shared_ptr<costmap_2d::Layer> >* plugins = costmap->getLayeredCostmap()->getPlugins();
+
+  for (std::vector<boost::shared_ptr<costmap_2d::Layer> >::iterator pluginp = plugins->begin(); pluginp != plugins->end(); ++pluginp) {
+    std::string name = (*pluginp)->getName();
+    int slash = name.rfind('/');
+    if( slash != std::string::npos ){
+        name = name.substr(slash+1);
+    }
+
+    if(clearable_layers_.count(name) == 0)
+      continue;
+
+    //only obstacle layers have observations to raytrace
+    boost::shared_ptr<costmap_2d::ObstacleLayer> layer = boost::dynamic_pointer_cast<costmap_2d::ObstacleLayer>(*pluginp);
+    if(!layer){
+      ROS_WARN("Layer %s is not an obstacle layer, it can't be raytraced.", name.c_str());
+      continue;
+    }
+    if(layer->requestFullRangeClearing())
+      requested.push_back(layer);
+  }
+}
+
+};
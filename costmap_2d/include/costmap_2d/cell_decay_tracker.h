@@ -0,0 +1,167 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_CELL_DECAY_TRACKER_H_
+#define COSTMAP_CELL_DECAY_TRACKER_H_
+
+#include <costmap_2d/costmap_2d.h>
+#include <cmath>
+#include <deque>
+#include <vector>
+
+namespace costmap_2d
+{
+
+/**
+ * @class CellDecayTracker
+ * @brief Keeps track of the cells holding a given cost so that they can be
+ * reset once they have not been updated for a fixed amount of time.
+ *
+ * Cells are kept in time-bucketed queues keyed by the time they were last
+ * written, so finding the expired cells costs time proportional to the
+ * number of tracked cells that are due, instead of the size of the map.
+ * Each cell is queued at most once; if a cell was written again after it was
+ * queued, it is moved to the bucket of its new timestamp when its old bucket
+ * comes due.
+ */
+class CellDecayTracker
+{
+public:
+  /**
+   * @brief  Constructor for a tracker
+   * @param  value The cost value of the cells that are tracked
+   * @param  bucket_duration The time span covered by one bucket, in seconds
+   */
+  CellDecayTracker(unsigned char value, double bucket_duration = 0.1);
+
+  /**
+   * @brief  Set the time after which a tracked cell expires, negative disables the tracker
+   * @param  timeout The timeout in seconds
+   */
+  void setTimeout(double timeout);
+
+  /**
+   * @brief  Whether or not the tracker has a valid timeout
+   */
+  bool isEnabled() const
+  {
+    return timeout_ >= 0.0;
+  }
+
+  /**
+   * @brief  Whether the tracker needs to be seeded with the cells of the map
+   *
+   * This is the case after the tracker gets enabled, because cells that were
+   * written while it was disabled were never queued.
+   */
+  bool needsSeeding() const
+  {
+    return isEnabled() && needs_seeding_;
+  }
+
+  /**
+   * @brief  Queue every stamped cell of the map holding the tracked value
+   *
+   * Cells that were never stamped (e.g. the default value after a reset) do not decay.
+   * @param  map The map the tracker is attached to
+   */
+  void seed(const Costmap2D& map);
+
+  /**
+   * @brief  Match the tracker to the size of the map, dropping all queued cells
+   * @param  size_x The x size of the map in cells
+   * @param  size_y The y size of the map in cells
+   */
+  void resize(unsigned int size_x, unsigned int size_y);
+
+  /**
+   * @brief  Drop all queued cells
+   */
+  void clear();
+
+  /**
+   * @brief  Queue a cell that was just written with the tracked value
+   * @param  index The index of the cell
+   * @param  stamp The time the cell was written, an earlier time is safe but a later one delays expiry
+   */
+  inline void push(unsigned int index, double stamp)
+  {
+    if (!isEnabled() || queued_[index])
+      return;
+    queued_[index] = true;
+    bucketFor(stamp).push_back(index);
+  }
+
+  /**
+   * @brief  Follow the data of the map when its origin is moved
+   * @param  dx The number of cells the origin moved in x
+   * @param  dy The number of cells the origin moved in y
+   */
+  void shift(int dx, int dy);
+
+  /**
+   * @brief  Collect the tracked cells that have not been written for longer than the timeout
+   * @param  map The map the tracker is attached to
+   * @param  now The current time
+   * @param  expired Will be extended with the indices of the expired cells, which are no longer tracked
+   */
+  void expire(const Costmap2D& map, double now, std::vector<unsigned int>& expired);
+
+  /**
+   * @brief  The number of cells that are currently queued
+   */
+  unsigned int size() const;
+
+private:
+  std::vector<unsigned int>& bucketFor(double stamp);
+
+  long bucketKey(double stamp) const
+  {
+    return (long)floor(stamp / bucket_duration_);
+  }
+
+  unsigned char value_;
+  double bucket_duration_;
+  double timeout_;
+  bool needs_seeding_;
+  unsigned int size_x_, size_y_;
+
+  std::deque<std::vector<unsigned int> > buckets_;
+  long first_key_; ///< @brief The key of the bucket at the front of buckets_
+  std::vector<bool> queued_; ///< @brief One flag per cell of the map, set while the cell is in a bucket
+};
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_CELL_DECAY_TRACKER_H_
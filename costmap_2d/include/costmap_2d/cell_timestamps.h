@@ -0,0 +1,230 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_CELL_TIMESTAMPS_H_
+#define COSTMAP_CELL_TIMESTAMPS_H_
+
+#include <stdint.h>
+#include <cstring>
+#include <limits>
+
+namespace costmap_2d
+{
+
+/**
+ * @class CellTimeStamps
+ * @brief Stores the time of the last update of every cell of a costmap.
+ *
+ * Timestamps are stored as 16 or 32 bit tick counters relative to an epoch,
+ * or not at all for maps that never look at them. A tick value of zero means
+ * the cell was never stamped. When a stamp no longer fits in the counter the
+ * epoch is moved forward and all stored ticks are rebased; stamps that fall
+ * before the new epoch are clamped to the oldest representable time.
+ */
+class CellTimeStamps
+{
+public:
+  /** @brief The storage used per cell, the value is the number of bytes per cell */
+  enum Precision
+  {
+    NONE = 0, TICKS_16 = 2, TICKS_32 = 4
+  };
+
+  /**
+   * @brief  Constructor
+   * @param  precision The storage used per cell
+   * @param  resolution The duration of one tick in seconds
+   */
+  CellTimeStamps(Precision precision = TICKS_32, double resolution = 0.001);
+
+  CellTimeStamps(const CellTimeStamps& stamps);
+
+  CellTimeStamps& operator=(const CellTimeStamps& stamps);
+
+  ~CellTimeStamps();
+
+  /**
+   * @brief  Change the storage used per cell, drops all stored stamps
+   * @param  precision The storage used per cell
+   * @param  resolution The duration of one tick in seconds
+   */
+  void setPrecision(Precision precision, double resolution);
+
+  Precision getPrecision() const
+  {
+    return precision_;
+  }
+
+  double getResolution() const
+  {
+    return resolution_;
+  }
+
+  /**
+   * @brief  Allocate storage for the given number of cells, all cells are unstamped afterwards
+   */
+  void resize(unsigned int size);
+
+  /**
+   * @brief  Release the storage
+   */
+  void release();
+
+  /**
+   * @brief  Mark all cells as unstamped
+   */
+  void reset();
+
+  /**
+   * @brief  Mark a range of cells as unstamped
+   * @param  index The first cell of the range
+   * @param  length The number of cells in the range
+   */
+  void reset(unsigned int index, unsigned int length);
+
+  /**
+   * @brief  Store the same encoded stamp for a range of cells
+   * @param  index The first cell of the range
+   * @param  length The number of cells in the range
+   * @param  tick The encoded stamp, see encode()
+   */
+  void fill(unsigned int index, unsigned int length, uint32_t tick);
+
+  /**
+   * @brief  Convert a time to the tick value that is stored for it
+   *
+   * May rebase the stored ticks, so ticks returned by earlier calls should not be used anymore.
+   * @param  stamp The time in seconds
+   * @return The tick value, rounded up so decoded stamps are never earlier than the real ones
+   */
+  uint32_t encode(double stamp);
+
+  /**
+   * @brief  Convert a tick value back to a time
+   * @return The time in seconds, NaN for unstamped cells
+   */
+  inline double decode(uint32_t tick) const
+  {
+    if (tick == 0)
+      return std::numeric_limits<double>::quiet_NaN();
+    return epoch_ + (tick - 1) * resolution_;
+  }
+
+  /**
+   * @brief  Store an encoded stamp for a cell
+   */
+  inline void setEncoded(unsigned int index, uint32_t tick)
+  {
+    if (precision_ == TICKS_32)
+      ticks32_[index] = tick;
+    else if (precision_ == TICKS_16)
+      ticks16_[index] = (uint16_t)tick;
+  }
+
+  /**
+   * @brief  Store a stamp for a cell
+   * @param  index The index of the cell
+   * @param  stamp The time in seconds
+   */
+  inline void set(unsigned int index, double stamp)
+  {
+    if (precision_ != NONE)
+      setEncoded(index, encode(stamp));
+  }
+
+  /**
+   * @brief  Get the encoded stamp of a cell, zero for unstamped cells
+   */
+  inline uint32_t getEncoded(unsigned int index) const
+  {
+    if (precision_ == TICKS_32)
+      return ticks32_[index];
+    else if (precision_ == TICKS_16)
+      return ticks16_[index];
+    return 0;
+  }
+
+  /**
+   * @brief  Get the stamp of a cell
+   * @return The time in seconds, NaN for unstamped cells or when no stamps are stored
+   */
+  inline double get(unsigned int index) const
+  {
+    if (precision_ == TICKS_32)
+      return decode(ticks32_[index]);
+    else if (precision_ == TICKS_16)
+      return decode(ticks16_[index]);
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+
+  /**
+   * @brief  Copy a region of the stamps of another map into this one
+   *
+   * If the source has a different precision or epoch the stamps are converted.
+   * See Costmap2D::copyMapRegion() for the meaning of the parameters.
+   */
+  void copyRegion(const CellTimeStamps& source, unsigned int sm_lower_left_x, unsigned int sm_lower_left_y,
+                  unsigned int sm_size_x, unsigned int dm_lower_left_x, unsigned int dm_lower_left_y,
+                  unsigned int dm_size_x, unsigned int region_size_x, unsigned int region_size_y);
+
+  /**
+   * @brief  Move the stamps in place, see Costmap2D::shiftMapRegion(), exposed cells are unstamped
+   */
+  void shift(unsigned int size_x, unsigned int size_y, int cell_ox, int cell_oy);
+
+private:
+  void allocate();
+
+  /**
+   * @brief  Move the epoch so that the given stamp fits, shifting all stored ticks
+   */
+  void rebase(double stamp);
+
+  uint32_t maxTick() const
+  {
+    return precision_ == TICKS_16 ? std::numeric_limits<uint16_t>::max() : std::numeric_limits<uint32_t>::max();
+  }
+
+  Precision precision_;
+  double resolution_;
+  double epoch_;
+  bool has_epoch_;
+  unsigned int size_;
+  uint16_t* ticks16_;
+  uint32_t* ticks32_;
+};
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_CELL_TIMESTAMPS_H_
@@ -0,0 +1,62 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_COST_COMBINATION_H_
+#define COSTMAP_COST_COMBINATION_H_
+
+namespace costmap_2d
+{
+
+/**
+ * Kernels that combine a row of layer cells into a row of master cells, used
+ * by the CostmapLayer::updateWith* methods. On x86 they process 16 cells per
+ * instruction with SSE2, elsewhere a branch free loop is left to the compiler.
+ */
+
+/** @brief master = max(master, layer), NO_INFORMATION in master is overwritten, in layer ignored */
+void combineMax(unsigned char* master, const unsigned char* layer, unsigned int length);
+
+/** @brief master = layer wherever layer is not NO_INFORMATION */
+void combineOverwrite(unsigned char* master, const unsigned char* layer, unsigned int length);
+
+/**
+ * @brief master = master + layer, capped below INSCRIBED_INFLATED_OBSTACLE.
+ *
+ * NO_INFORMATION in master is overwritten, in layer ignored.
+ */
+void combineAddition(unsigned char* master, const unsigned char* layer, unsigned int length);
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_COST_COMBINATION_H_
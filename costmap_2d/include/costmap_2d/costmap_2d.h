@@ -40,7 +40,10 @@
 
 #include <vector>
 #include <queue>
+#include <algorithm>
+#include <cstring>
 #include <geometry_msgs/Point.h>
+#include <costmap_2d/cell_timestamps.h>
 #include <boost/thread.hpp>
 
 namespace costmap_2d
@@ -97,6 +100,14 @@ public:
   bool copyCostmapWindow(const Costmap2D& map, double win_origin_x, double win_origin_y, double win_size_x,
                          double win_size_y);
 
+  /**
+   * @brief  Turn this costmap into a copy of the costmap passed in, reusing the storage if the geometry matches
+   *
+   * The caller has to hold the lock of the map passed in.
+   * @param map The costmap to copy
+   */
+  void copyCostsFrom(const Costmap2D& map);
+
   /**
    * @brief  Default constructor
    */
@@ -113,7 +124,10 @@ public:
    * @param my The y coordinate of the cell
    * @return The cost of the cell
    */
-  unsigned char getCost(unsigned int mx, unsigned int my) const;
+  inline unsigned char getCost(unsigned int mx, unsigned int my) const
+  {
+    return costmap_[getIndex(mx, my)];
+  }
 
   /**
    * @brief  Get the last update timestamp of the cell
@@ -131,6 +145,32 @@ public:
    */
   void setCost(unsigned int mx, unsigned int my, unsigned char cost);
 
+  /**
+   * @brief  Set the cost of a cell in the costmap, stamping it with a given time
+   *
+   * Use this when writing many cells in one update, so the clock is read once for all of them.
+   * @param mx The x coordinate of the cell
+   * @param my The y coordinate of the cell
+   * @param cost The cost to set the cell to
+   * @param stamp The update time of the cell (seconds)
+   */
+  void setCost(unsigned int mx, unsigned int my, unsigned char cost, double stamp);
+
+  /**
+   * @brief  Change how the last update timestamps of the cells are stored, drops all stored stamps
+   * @param precision The storage used per cell, CellTimeStamps::NONE disables the timestamps
+   * @param resolution The duration of one tick in seconds
+   */
+  void setTimeStampPrecision(CellTimeStamps::Precision precision, double resolution);
+
+  /**
+   * @brief  Whether this map keeps track of the last update timestamps of its cells
+   */
+  bool hasTimeStamps() const
+  {
+    return timestamps_.getPrecision() != CellTimeStamps::NONE;
+  }
+
   /**
    * @brief  Convert from map coordinates to world coordinates
    * @param  mx The x map coordinate
@@ -170,6 +210,43 @@ public:
    */
   void worldToMapEnforceBounds(double wx, double wy, int& mx, int& my) const;
 
+  /**
+   * @brief  Same as worldToMap(), but multiplies by the inverse of the resolution instead of dividing by it
+   *
+   * For the loops that convert a point at a time. A point within rounding error of a cell border may
+   * end up in the neighbouring cell of the one worldToMap() gives.
+   */
+  inline bool worldToMapFast(double wx, double wy, unsigned int& mx, unsigned int& my) const
+  {
+    double gx = (wx - origin_x_) * inverse_resolution_;
+    double gy = (wy - origin_y_) * inverse_resolution_;
+    if (!(gx >= 0.0 && gy >= 0.0 && gx < size_x_ && gy < size_y_))
+      return false;
+    mx = (unsigned int)gx;
+    my = (unsigned int)gy;
+    return true;
+  }
+
+  /** @brief Same as worldToMapNoBounds(), with the multiplication of worldToMapFast() */
+  inline void worldToMapNoBoundsFast(double wx, double wy, int& mx, int& my) const
+  {
+    mx = (int)((wx - origin_x_) * inverse_resolution_);
+    my = (int)((wy - origin_y_) * inverse_resolution_);
+  }
+
+  /**
+   * @brief  Convert a number of points to the indices of their cells at once, like worldToMapFast()
+   * @param  wx The x world coordinates of the points
+   * @param  wy The y world coordinates of the points
+   * @param  n The number of points
+   * @param  indices Set to the index of the cell of each point, -1 for the points outside of the map
+   * @return The number of points inside of the map
+   */
+  unsigned int worldToIndices(const double* wx, const double* wy, unsigned int n, int* indices) const;
+
+  /** @brief Convert a number of points to map coordinates at once, like worldToMapNoBoundsFast() */
+  void worldToMapNoBounds(const double* wx, const double* wy, unsigned int n, int* mx, int* my) const;
+
   /**
    * @brief  Given two map coordinates... compute the associated index
    * @param mx The x coordinate
@@ -259,6 +336,35 @@ public:
    */
   bool setConvexPolygonCost(const std::vector<geometry_msgs::Point>& polygon, unsigned char cost_value);
 
+  /**
+   * @brief  Sets the cost of a convex polygon to a desired value, stamping its cells with a given time
+   * @param polygon The polygon to perform the operation on
+   * @param cost_value The value to set costs to
+   * @param stamp The update time of the cells (seconds)
+   * @return True if the polygon was filled... false if it could not be filled
+   */
+  bool setConvexPolygonCost(const std::vector<geometry_msgs::Point>& polygon, unsigned char cost_value,
+                            double stamp);
+
+  /**
+   * @brief  Sets the cost of an axis aligned rectangle of cells, one row at a time
+   *
+   * Like setConvexPolygonCost(), the caller is responsible for holding the lock of the map.
+   * @param x0 The first column of the rectangle
+   * @param y0 The first row of the rectangle
+   * @param xn One past the last column of the rectangle, clamped to the map
+   * @param yn One past the last row of the rectangle, clamped to the map
+   * @param cost_value The value to set costs to
+   */
+  void setRegionCost(unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn, unsigned char cost_value);
+
+  /**
+   * @brief  Sets the cost of an axis aligned rectangle of cells, stamping them with a given time
+   * @param stamp The update time of the cells (seconds)
+   */
+  void setRegionCost(unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn, unsigned char cost_value,
+                     double stamp);
+
   /**
    * @brief  Get the map cells that make up the outline of a polygon
    * @param polygon The polygon in map coordinates to rasterize
@@ -273,6 +379,27 @@ public:
    */
   void convexFillCells(const std::vector<MapLocation>& polygon, std::vector<MapLocation>& polygon_cells);
 
+  /**
+   * @brief  Call an action for each row of the map cells that fill a convex polygon
+   *
+   * The cells are the ones of convexFillCells(), the cells on the outline of the
+   * polygon and the cells between them, but they come as one span per row,
+   * computed from the edges of the polygon without sorting or allocating.
+   * action(y, x0, xn) is called for the cells x0 <= x < xn of every row y the
+   * polygon covers, in increasing order of y.
+   * @param polygon The polygon in map coordinates to rasterize
+   * @param action The action to call for each row
+   */
+  template<class ActionType>
+    inline void convexFillSpans(const std::vector<MapLocation>& polygon, ActionType action)
+    {
+      unsigned int min_y;
+      if (!convexFillRows(polygon, min_y))
+        return;
+      for (unsigned int r = 0; r < fill_row_min_.size(); ++r)
+        action(min_y + r, fill_row_min_[r], fill_row_max_[r] + 1);
+    }
+
   /**
    * @brief  Move the origin of the costmap to a new location.... keeping data when it can
    * @param  new_origin_x The x coordinate of the new origin
@@ -336,6 +463,50 @@ protected:
       }
     }
 
+  /**
+   * @brief  Move the contents of a map in place, so that cell (x + cell_ox, y + cell_oy) ends up at (x, y)
+   *
+   * Only the strips that are exposed by the move are filled, the overlap is moved row by row.
+   * @param  map The map
+   * @param  size_x The x size of the map
+   * @param  size_y The y size of the map
+   * @param  cell_ox The number of cells to move the contents by in x
+   * @param  cell_oy The number of cells to move the contents by in y
+   * @param  fill_value The value of the exposed cells
+   */
+  template<typename data_type>
+    void shiftMapRegion(data_type* map, unsigned int size_x, unsigned int size_y, int cell_ox, int cell_oy,
+                        data_type fill_value)
+    {
+      if (cell_ox <= -int(size_x) || cell_ox >= int(size_x) || cell_oy <= -int(size_y) || cell_oy >= int(size_y))
+      {
+        std::fill(map, map + size_x * size_y, fill_value);
+        return;
+      }
+
+      //the columns of every row that keep data
+      unsigned int x0 = std::max(-cell_ox, 0);
+      unsigned int xn = size_x - std::max(cell_ox, 0);
+
+      //walk the rows so that no source row is overwritten before it is moved
+      int step = cell_oy >= 0 ? 1 : -1;
+      int y = step > 0 ? 0 : size_y - 1;
+      for (unsigned int i = 0; i < size_y; ++i, y += step)
+      {
+        data_type* row = map + y * size_x;
+        int source_y = y + cell_oy;
+        if (source_y < 0 || source_y >= int(size_y))
+        {
+          std::fill(row, row + size_x, fill_value);
+          continue;
+        }
+
+        memmove(row + x0, map + source_y * size_x + x0 + cell_ox, (xn - x0) * sizeof(data_type));
+        std::fill(row, row + x0, fill_value);
+        std::fill(row + xn, row + size_x, fill_value);
+      }
+    }
+
   /**
    * @brief  Deletes the costmap, static_map, and markers data structures
    */
@@ -423,35 +594,69 @@ private:
     return x > 0 ? 1.0 : -1.0;
   }
 
+  /**
+   * @brief  Set fill_row_min_ and fill_row_max_ to the extents of the rows of the outline of a convex polygon
+   * @param polygon The polygon in map coordinates
+   * @param min_y Will be set to the row of fill_row_min_[0]
+   * @return False if the polygon has less than three corners
+   */
+  bool convexFillRows(const std::vector<MapLocation>& polygon, unsigned int& min_y);
+
+  std::vector<unsigned int> fill_row_min_, fill_row_max_; ///< @brief Scratch space of convexFillRows()
+  std::vector<MapLocation> map_polygon_; ///< @brief Scratch space of setConvexPolygonCost()
+
   boost::shared_mutex* access_;
 protected:
   unsigned int size_x_;
   unsigned int size_y_;
   double resolution_;
+  double inverse_resolution_;  ///< @brief 1 / resolution_, for the fast conversions to map coordinates
   double origin_x_;
   double origin_y_;
   unsigned char* costmap_;
   unsigned char default_value_;
 
-  double* timestamps_; // Timestamp last update
+  CellTimeStamps timestamps_; // Timestamp last update
 
   class MarkCell
   {
   public:
-    MarkCell(unsigned char* costmap, double* timestamps, unsigned char value, double time) :
-        costmap_(costmap), timestamps_(timestamps), value_(value), time_(time)
+    MarkCell(unsigned char* costmap, CellTimeStamps& timestamps, unsigned char value, double time) :
+        costmap_(costmap), timestamps_(timestamps), value_(value), tick_(timestamps.encode(time))
     {
     }
     inline void operator()(unsigned int offset)
     {
       costmap_[offset] = value_;
-      timestamps_[offset] = time_;
+      timestamps_.setEncoded(offset, tick_);
     }
   private:
     unsigned char* costmap_;
-    double* timestamps_;
+    CellTimeStamps& timestamps_;
     unsigned char value_;
-    double time_;
+    uint32_t tick_;
+  };
+
+  class FillRow
+  {
+  public:
+    FillRow(unsigned char* costmap, CellTimeStamps& timestamps, unsigned int size_x, unsigned char value,
+            double time) :
+        costmap_(costmap), timestamps_(timestamps), size_x_(size_x), value_(value), tick_(timestamps.encode(time))
+    {
+    }
+    inline void operator()(unsigned int y, unsigned int x0, unsigned int xn)
+    {
+      unsigned int index = y * size_x_ + x0;
+      memset(costmap_ + index, value_, (xn - x0) * sizeof(unsigned char));
+      timestamps_.fill(index, xn - x0, tick_);
+    }
+  private:
+    unsigned char* costmap_;
+    CellTimeStamps& timestamps_;
+    unsigned int size_x_;
+    unsigned char value_;
+    uint32_t tick_;
   };
 
   class PolygonOutlineCells
@@ -475,6 +680,27 @@ protected:
     const unsigned char* char_map_;
     std::vector<MapLocation>& cells_;
   };
+
+  class PolygonFillCells
+  {
+  public:
+    PolygonFillCells(std::vector<MapLocation>& cells) :
+        cells_(cells)
+    {
+    }
+
+    //push every cell of the row back onto the list
+    inline void operator()(unsigned int y, unsigned int x0, unsigned int xn)
+    {
+      MapLocation loc;
+      loc.y = y;
+      for (loc.x = x0; loc.x < xn; ++loc.x)
+        cells_.push_back(loc);
+    }
+
+  private:
+    std::vector<MapLocation>& cells_;
+  };
 };
 }
 
@@ -41,7 +41,9 @@
 #include <costmap_2d/costmap_2d.h>
 #include <nav_msgs/OccupancyGrid.h>
 #include <map_msgs/OccupancyGridUpdate.h>
+#include <costmap_2d/CompressedGridUpdate.h>
 #include <tf/transform_datatypes.h>
+#include <boost/thread.hpp>
 
 namespace costmap_2d
 {
@@ -65,10 +67,12 @@ public:
   /** @brief Include the given bounds in the changed-rectangle. */
   void updateBounds(unsigned int x0, unsigned int xn, unsigned int y0, unsigned int yn)
   {
+    boost::mutex::scoped_lock lock(bounds_mutex_);
     x0_ = std::min(x0, x0_);
     xn_ = std::max(xn, xn_);
     y0_ = std::min(y0, y0_);
     yn_ = std::max(yn, yn_);
+    pending_ = true;
   }
 
   /**
@@ -76,6 +80,19 @@ public:
    */
   void publishCostmap();
 
+  /**
+   * @brief  Publish from a thread of its own instead of from the caller of publishCostmap()
+   *
+   * The thread publishes whenever updateBounds() was called since the last
+   * publication, at most at the given rate. Changes that arrive while a
+   * message is serialized are merged into the next one.
+   * @param frequency The maximum rate in Hz
+   */
+  void startPublishThread(double frequency);
+
+  /** @brief Stop the thread started by startPublishThread() */
+  void stopPublishThread();
+
   /**
    * @brief Check if the publisher is active
    * @return True if the frequency for the publisher is non-zero, false otherwise
@@ -89,18 +106,44 @@ private:
   /** @brief Prepare grid_ message for publication. */
   void prepareGrid();
 
+  /** @brief Translate costs to the values used in the messages, see cost_translation_table_. */
+  static void translateCosts(const unsigned char* costs, int8_t* values, unsigned int length);
+
   /** @brief Publish the latest full costmap to the new subscriber. */
   void onNewSubscription( const ros::SingleSubscriberPublisher& pub );
 
+  void publishLoop(double frequency);
+
+  /**
+   * @brief Publish a region of translated values that was just published uncompressed, as a delta against the previous frame.
+   *
+   * Every keyframe_interval_ frames, and whenever the map changes size, the whole map is sent instead.
+   */
+  void publishCompressed(const ros::Time& stamp, unsigned int x, unsigned int y, unsigned int width,
+                         unsigned int height, const int8_t* values);
+
   ros::NodeHandle* node;
   Costmap2D* costmap_;
   std::string global_frame_;
   unsigned int x0_, xn_, y0_, yn_;
+  bool pending_; ///< @brief Whether updateBounds() was called since the last publication
+  boost::mutex bounds_mutex_; ///< @brief Guards the changed-rectangle
+  boost::mutex publish_mutex_; ///< @brief Guards grid_ and snapshot_
+  boost::thread* publish_thread_;
+  bool publish_thread_shutdown_;
   bool active_;
   bool always_send_full_costmap_;
   ros::Publisher costmap_pub_;
   ros::Publisher costmap_update_pub_;
+  ros::Publisher compressed_pub_;
+  bool publish_compressed_;
+  int keyframe_interval_;
+  int frames_since_keyframe_;
+  uint32_t frame_;
+  std::vector<int8_t> last_sent_; ///< @brief The values of the whole map as the compressed subscribers know them
+  std::vector<int8_t> delta_;
   nav_msgs::OccupancyGrid grid_;
+  std::vector<unsigned char> snapshot_; ///< @brief Costs copied under the lock, translated after releasing it
   static char* cost_translation_table_; ///< Translate from 0-255 values in costmap to -1 to 100 values in message.
 };
 }
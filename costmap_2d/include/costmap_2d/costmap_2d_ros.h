@@ -41,8 +41,12 @@
 #include <costmap_2d/layered_costmap.h>
 #include <costmap_2d/layer.h>
 #include <costmap_2d/costmap_2d_publisher.h>
+#include <costmap_2d/costmap_recorder.h>
 #include <costmap_2d/Costmap2DConfig.h>
 #include <costmap_2d/footprint.h>
+#include <costmap_2d/footprint_spans.h>
+#include <costmap_2d/GetFootprintCosts.h>
+#include <geometry_msgs/Pose2D.h>
 #include <geometry_msgs/Polygon.h>
 #include <dynamic_reconfigure/server.h>
 #include <pluginlib/class_loader.h>
@@ -101,6 +105,12 @@ public:
    */
   void resume();
 
+  /**
+   * @brief  Keeps the layers taking in sensor data at idle_update_frequency, but stops computing and
+   * publishing the costmap until the next start(), which then only waits for one update
+   */
+  void idle();
+
   void updateMap();
 
   /**
@@ -116,11 +126,25 @@ public:
 
   /**
    * @brief Get the pose of the robot in the global frame of the costmap
+   *
+   * With the robot_pose_cache_time parameter set, a pose looked up at most
+   * that long ago is returned again without asking tf, so the callers within
+   * one cycle share a single lookup and see the same pose.
    * @param global_pose Will be set to the pose of the robot in the global frame of the costmap
    * @return True if the pose was set successfully, false otherwise
    */
   bool getRobotPose(tf::Stamped<tf::Pose>& global_pose) const;
 
+  /**
+   * @brief Get a copy of the master costmap as of the last update.
+   *
+   * The copy never changes, so it can be read without taking any lock. With
+   * the costmap_snapshots parameter set the update thread makes a new copy
+   * after every update and this never blocks; otherwise the copy is made here,
+   * under the costmap lock.
+   */
+  boost::shared_ptr<const Costmap2D> getCostmapSnapshot();
+
   /** @brief Return a pointer to the "master" costmap which receives updates from all the layers.
    *
    * Same as calling getLayeredCostmap()->getCostmap(). */
@@ -151,6 +175,14 @@ public:
       return layered_costmap_;
     }
 
+  /** @brief The fine rolling window composited over the costmap, NULL unless ~fine_window is set.
+   *
+   * See LayeredCostmap::setInnerCostmap(). */
+  LayeredCostmap* getFineLayeredCostmap()
+    {
+      return fine_costmap_;
+    }
+
   /** @brief Returns the current padded footprint as a geometry_msgs::Polygon. */
   geometry_msgs::Polygon getRobotFootprintPolygon()
   {
@@ -231,6 +263,18 @@ public:
    * getUnpaddedRobotFootprint(). */
   void setUnpaddedRobotFootprintPolygon( const geometry_msgs::Polygon& footprint );
 
+  /**
+   * @brief  The cost of the padded footprint at each of a number of poses, all under one lock of the costmap
+   *
+   * The footprint is rasterized once for each of ~footprint_cost_headings heading bins, see FootprintSpans,
+   * so every pose is checked at the center of its bin. Also offered as the ~get_footprint_costs service.
+   * @param  poses The poses of the robot in the global frame
+   * @param  costs Set to the highest cost under the footprint at each pose, -1 where it covers a lethal or
+   * unknown cell or leaves the costmap
+   * @return The index of the first pose with a negative cost, -1 if there is none
+   */
+  int getFootprintCosts(const std::vector<geometry_msgs::Pose2D>& poses, std::vector<double>& costs);
+
 protected:
   LayeredCostmap* layered_costmap_;
   std::string name_;
@@ -284,15 +328,88 @@ private:
   void reconfigureCB(costmap_2d::Costmap2DConfig &config, uint32_t level);
   void movementCB(const ros::TimerEvent &event);
   void mapUpdateLoop(double frequency);
+
+  /** @brief The rate for the update loop between min_update_frequency_ and the given full rate, scaled by the
+   * speed of the robot and the new obstacles of the last updates */
+  double adaptiveFrequency(double frequency);
+
+  /** @brief Copy the master costmap into the snapshot handed out by getCostmapSnapshot() */
+  void updateSnapshot();
+
+  /** @brief The file the checkpoint of the master grid or of a layer with the given name is kept in */
+  std::string checkpointPath(const std::string& name) const;
+
+  /** @brief Write the master grid and the grid of every CostmapLayer to checkpoint_directory_ */
+  void writeCheckpoints();
+
+  /** @brief Restore the grids written by writeCheckpoints(), once the map has a size */
+  void restoreCheckpoints();
+
+  /** @brief Queue the cells of the master grid and of every CostmapLayer that changed since the last frame to
+   * recorder_ */
+  void recordFrame();
+
+  /** @brief Collect the timing of the last update, and publish a summary on ~statistics once a statistics period
+   * passed */
+  void recordStatistics();
+
+  /** @brief Create the fine window of ~fine_window meters around the robot, with its own instances of the layers */
+  void createFineCostmap(ros::NodeHandle& private_nh, bool track_unknown_space, bool always_send_full_costmap);
+
+  /** @brief The layers of the costmap, followed by those of the fine window if there is one */
+  std::vector<boost::shared_ptr<Layer> > getAllPlugins();
+
+  bool footprintCostsService(costmap_2d::GetFootprintCosts::Request& req,
+                             costmap_2d::GetFootprintCosts::Response& resp);
   bool map_update_thread_shutdown_;
   bool stop_updates_, initialized_, stopped_, robot_stopped_;
   boost::thread* map_update_thread_;  ///< @brief A thread for updating the map
   ros::Timer timer_;
   ros::Time last_publish_;
   ros::Duration publish_cycle;
+  bool publish_thread_;  ///< @brief Whether the publisher runs in a thread of its own
+  bool costmap_snapshots_;  ///< @brief Whether the update thread keeps a snapshot of the costmap
+  bool update_on_observations_;  ///< @brief Whether the update loop waits for observations instead of a fixed rate
+  int update_min_observations_;  ///< @brief The number of observations that wake up the update loop
+  bool adaptive_update_;  ///< @brief Whether the update loop slows down while the robot and its surroundings are still
+  double min_update_frequency_;  ///< @brief The rate of the adaptive update loop while nothing moves
+  double update_full_speed_, update_full_angular_speed_;  ///< @brief The speeds from which the full rate is used
+  int update_full_new_obstacles_;  ///< @brief The new obstacle cells of an update from which the full rate is used
+  double robot_speed_, robot_angular_speed_;  ///< @brief As measured by movementCB(), infinite if the pose is unknown
+  double obstacle_activity_;  ///< @brief The share of the full rate due to new obstacles, halved every update
+  bool idle_;  ///< @brief Whether the costmap is idle, see idle()
+  double idle_update_frequency_;  ///< @brief The rate at which the layers take in sensor data while idle
+  std::string checkpoint_directory_;  ///< @brief Where the grids are checkpointed, empty to disable checkpoints
+  double checkpoint_period_;  ///< @brief The time between checkpoints in seconds
+  double checkpoint_max_age_;  ///< @brief Older checkpoints are not restored
+  ros::Time last_checkpoint_;
+  bool checkpoints_restored_;  ///< @brief Whether the checkpoints were restored, or there is nothing to restore
+  boost::shared_ptr<CostmapRecorder> recorder_;  ///< @brief Logs the changes of the grids, NULL unless enabled
+  unsigned int record_bounds_user_;  ///< @brief The id of recordFrame() for LayeredCostmap::takeChangedBounds()
+
+  // With a statistics_rate the wall time of every stage of the updates is
+  // collected, and summarized on ~statistics at that rate.
+  bool statistics_enabled_;
+  ros::WallDuration statistics_period_;
+  ros::WallTime statistics_last_time_;
+  ros::Publisher statistics_pub_;
+  std::vector<std::vector<double> > stage_times_;  ///< @brief Per stage, in the order of UpdateStatistics
+  unsigned int statistics_updates_;
+  double statistics_cells_;  ///< @brief The cells of the update windows of all updates
+  unsigned int statistics_max_cells_;
+  double pose_cache_time_;  ///< @brief How long a looked up robot pose is reused in seconds, 0 to disable the cache
+  mutable boost::mutex pose_cache_mutex_;  ///< @brief Guards the cached pose
+  mutable tf::Stamped<tf::Pose> cached_pose_;
+  mutable ros::Time pose_cache_lookup_;  ///< @brief When cached_pose_ was looked up
+  mutable bool pose_cached_;
+  boost::mutex snapshot_mutex_;  ///< @brief Guards the snapshot pointers, never held while copying
+  boost::shared_ptr<Costmap2D> snapshot_;  ///< @brief The snapshot handed out to readers
+  boost::shared_ptr<Costmap2D> spare_snapshot_;  ///< @brief The previous snapshot, reused once no reader holds it
   pluginlib::ClassLoader<Layer> plugin_loader_;
   tf::Stamped<tf::Pose> old_pose_;
   Costmap2DPublisher* publisher_;
+  LayeredCostmap* fine_costmap_;
+  Costmap2DPublisher* fine_publisher_;
   dynamic_reconfigure::Server<costmap_2d::Costmap2DConfig> *dsrv_;
 
   boost::recursive_mutex configuration_mutex_;
@@ -302,6 +419,10 @@ private:
   std::vector<geometry_msgs::Point> unpadded_footprint_;
   std::vector<geometry_msgs::Point> padded_footprint_;
   float footprint_padding_;
+  ros::ServiceServer footprint_costs_srv_;
+  boost::mutex footprint_spans_mutex_;  ///< @brief Guards footprint_spans_
+  FootprintSpans footprint_spans_;  ///< @brief The padded footprint per heading bin, for getFootprintCosts()
+  int footprint_cost_headings_;
   costmap_2d::Costmap2DConfig old_config_;
   double map_update_frequency_;
 };
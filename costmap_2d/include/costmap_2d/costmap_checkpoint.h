@@ -0,0 +1,78 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_COSTMAP_CHECKPOINT_H_
+#define COSTMAP_COSTMAP_CHECKPOINT_H_
+
+#include <string>
+#include <costmap_2d/costmap_2d.h>
+
+namespace costmap_2d
+{
+
+/**
+ * @brief  Write the costs of a map to a checkpoint file
+ *
+ * The file holds a header with the name, frame, stamp, size, resolution and origin of the map, followed by
+ * the costs. It is written through a memory mapping of a temporary file that is then renamed over the
+ * checkpoint, so readers never see a partly written checkpoint. The caller must hold the lock of the map.
+ * @param  path The file to write
+ * @param  name The name of the map, a checkpoint is only restored into a map of the same name
+ * @param  frame The global frame of the map
+ * @param  stamp The time of the checkpoint in seconds
+ * @param  map The map to write
+ * @return False if the file could not be written
+ */
+bool writeCheckpoint(const std::string& path, const std::string& name, const std::string& frame, double stamp,
+                     const Costmap2D& map);
+
+/**
+ * @brief  Restore the costs of a map from a checkpoint file written by writeCheckpoint()
+ *
+ * The checkpoint must have the same name, frame and resolution as the map and its origin must be a whole
+ * number of cells away from the origin of the map. The part of the checkpoint that overlaps the map is
+ * copied, the rest of the map is left alone. The caller must hold the lock of the map.
+ * @param  path The file to read
+ * @param  name The name of the map
+ * @param  frame The global frame of the map
+ * @param  min_stamp Checkpoints from before this time in seconds are not restored
+ * @param  map The map to restore into
+ * @return False if there is no checkpoint or it does not fit the map
+ */
+bool readCheckpoint(const std::string& path, const std::string& name, const std::string& frame, double min_stamp,
+                    Costmap2D& map);
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_COSTMAP_CHECKPOINT_H_
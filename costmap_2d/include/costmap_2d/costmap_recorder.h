@@ -0,0 +1,249 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_COSTMAP_RECORDER_H_
+#define COSTMAP_COSTMAP_RECORDER_H_
+
+#include <costmap_2d/costmap_2d.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <stdint.h>
+#include <stdio.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace costmap_2d
+{
+
+/**
+ * @class CostmapRecorder
+ * @brief Logs the changes of named grids cycle by cycle to a bounded ring of files on disk
+ *
+ * record() only copies the changed rectangle of a grid into a queue. A
+ * thread of the recorder encodes it as the run length encoded xor against
+ * the previous frame of the grid, so unchanged cells cost next to nothing,
+ * and appends it to the current segment file. Once a segment holds
+ * segment_bytes a new one is started with a keyframe of every grid, and the
+ * oldest segments beyond max_segments are removed, so the log always starts
+ * with keyframes. CostmapLogReader rebuilds the grids from it.
+ */
+class CostmapRecorder
+{
+public:
+  /**
+   * @param  directory The directory of the segment files, created if it does not exist
+   * @param  segment_bytes A new segment is started once the current one is this large
+   * @param  max_segments The number of segments kept
+   * @param  keyframe_period A grid is also written whole after this many deltas of it, 0 only in new segments
+   */
+  CostmapRecorder(const std::string& directory, size_t segment_bytes, unsigned int max_segments,
+                  unsigned int keyframe_period);
+
+  /** @brief Writes what is still queued */
+  ~CostmapRecorder();
+
+  /**
+   * @brief  Queue the cells of a rectangle of a grid as the next frame of it
+   *
+   * The rectangle must hold all cells that changed since the last frame of
+   * the grid. The whole grid is copied instead when its size, resolution or
+   * origin changed, or a frame of it was dropped. The caller must hold the
+   * lock of the grid.
+   * @param  name The name of the grid
+   * @param  stamp The time of the frame in seconds
+   * @return False if the queue was full and the frame was dropped
+   */
+  bool record(const std::string& name, double stamp, const Costmap2D& grid, unsigned int x0, unsigned int xn,
+              unsigned int y0, unsigned int yn);
+
+  /** @brief Wait until every queued frame was written */
+  void flush();
+
+  /** @brief The bytes written to the segments so far, including removed ones */
+  size_t getBytesWritten();
+
+private:
+  /** @brief A frame on its way to the writer thread */
+  struct Frame
+  {
+    std::string name;
+    double stamp;
+    uint32_t size_x, size_y;
+    double resolution, origin_x, origin_y;
+    uint32_t x0, xn, y0, yn;
+    std::vector<unsigned char> cells; ///< @brief The cells of the rectangle, row after row
+  };
+
+  /** @brief The last frame of a grid as the writer wrote it */
+  struct GridState
+  {
+    GridState() :
+        deltas(0)
+    {
+    }
+
+    Frame geometry; ///< @brief The geometry of the grid, without cells
+    std::vector<unsigned char> cells; ///< @brief All cells of the grid
+    unsigned int deltas; ///< @brief The deltas written since the last keyframe
+  };
+
+  /** @brief The geometry of the last frame record() queued of a grid */
+  struct RecordState
+  {
+    RecordState() :
+        size_x(0), size_y(0), resolution(0.0), origin_x(0.0), origin_y(0.0), whole(true)
+    {
+    }
+
+    uint32_t size_x, size_y;
+    double resolution, origin_x, origin_y;
+    bool whole; ///< @brief Whether the next frame must hold the whole grid
+  };
+
+  void writeLoop();
+
+  /** @brief Apply a frame to the state of its grid and write it, as a keyframe if it has to be */
+  void writeFrame(const Frame& frame);
+
+  /** @brief Write a record of a grid, the cells are the keyframe or delta of the rectangle of the geometry */
+  void writeRecord(const Frame& geometry, bool keyframe, const std::vector<unsigned char>& cells);
+
+  /** @brief Close the current segment, remove the oldest ones and start the next with keyframes of every grid */
+  void startSegment();
+
+  std::string directory_;
+  size_t segment_bytes_;
+  unsigned int max_segments_, keyframe_period_;
+
+  boost::mutex queue_mutex_;
+  boost::condition_variable queue_condition_; ///< @brief Signals frames to the writer and their writing to flush()
+  std::deque<boost::shared_ptr<Frame> > queue_;
+  std::vector<boost::shared_ptr<Frame> > spare_frames_; ///< @brief Written frames, reused so their cells need no allocation
+  std::map<std::string, RecordState> record_states_;
+  bool writing_; ///< @brief Whether the writer holds a frame taken from the queue
+  bool shutdown_;
+  size_t bytes_written_;
+
+  // only touched by the writer thread
+  std::map<std::string, GridState> grids_;
+  FILE* segment_;
+  size_t segment_size_;
+  unsigned int segment_index_;
+  size_t written_; ///< @brief Copied to bytes_written_ after every frame
+  std::vector<unsigned char> delta_;
+  std::vector<uint8_t> encoded_;
+
+  boost::thread writer_;
+};
+
+/**
+ * @class CostmapLogReader
+ * @brief Reads back the log of a CostmapRecorder frame by frame, rebuilding the grids
+ */
+class CostmapLogReader
+{
+public:
+  CostmapLogReader();
+  ~CostmapLogReader();
+
+  /**
+   * @brief  Open the log in a directory, oldest segment first
+   * @return False if there is no segment
+   */
+  bool open(const std::string& directory);
+
+  /**
+   * @brief  Read the next frame and apply it to its grid
+   *
+   * Deltas of a grid before its first keyframe are skipped.
+   * @return False at the end of the log, or where it is corrupt
+   */
+  bool next();
+
+  /** @brief The name of the grid of the last frame */
+  const std::string& getName() const
+  {
+    return name_;
+  }
+
+  /** @brief The time of the last frame in seconds */
+  double getStamp() const
+  {
+    return stamp_;
+  }
+
+  /** @brief Whether the last frame was a keyframe */
+  bool isKeyframe() const
+  {
+    return keyframe_;
+  }
+
+  /** @brief The cells the last frame changed */
+  unsigned int getChangedCells() const
+  {
+    return changed_cells_;
+  }
+
+  /** @brief The bytes the last frame took in the log */
+  size_t getFrameBytes() const
+  {
+    return frame_bytes_;
+  }
+
+  /** @brief The grid of a name as of the last frame, NULL before its first keyframe */
+  const Costmap2D* getGrid(const std::string& name) const;
+
+private:
+  /** @brief Open the next segment, false if there is none */
+  bool nextSegment();
+
+  std::vector<std::string> segments_;
+  unsigned int next_segment_;
+  FILE* segment_;
+  std::map<std::string, Costmap2D> grids_;
+
+  std::string name_;
+  double stamp_;
+  bool keyframe_;
+  unsigned int changed_cells_;
+  size_t frame_bytes_;
+  std::vector<uint8_t> encoded_;
+  std::vector<unsigned char> cells_;
+};
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_COSTMAP_RECORDER_H_
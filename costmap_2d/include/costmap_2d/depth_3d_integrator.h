@@ -8,6 +8,17 @@
 #include <pcl/point_types.h>
 #include <pcl/point_cloud.h>
 
+#include <opencv2/core/core.hpp>
+
+#include <boost/thread.hpp>
+
+#include <ros/node_handle.h>
+
+#include <costmap_2d/depth_slope_kernel.h>
+#include <costmap_2d/ring_buffer.h>
+
+#include <vector>
+
 class Depth3DIntegrator
 {
 
@@ -17,18 +28,81 @@ public:
 
     ~Depth3DIntegrator();
 
-    bool initialize(const std::string& rgbd_topic, const std::string& map_frame);
+    // Reads the params of the integrator from 'nh':
+    //  - threaded: images are processed by a worker thread and update() only hands out the latest result
+    //  - num_threads: the sampled columns of an image are split over this many threads
+    //  - depth_buffer_size: in threaded mode, the number of received images waiting for the worker. When the
+    //    worker falls behind the oldest one is dropped.
+    bool initialize(const std::string& rgbd_topic, const std::string& map_frame,
+                    const ros::NodeHandle& nh = ros::NodeHandle("~"));
 
     bool isInitialized() const { return initialized_; }
 
+    // Fills 'cloud' with the obstacle points of the next image. In threaded mode this never blocks on image
+    // processing, it returns the cloud of the most recently processed image if it was not handed out yet.
     bool update(pcl::PointCloud<pcl::PointXYZ>& cloud);
 
 private:
 
+    struct ColumnResult
+    {
+        bool valid;
+        geo::Vector3 p_floor_closest;
+    };
+
+    // The inputs shared by all threads that process the columns of an image
+    struct ColumnTask
+    {
+        std::vector<const float*> rows;
+        std::vector<int> columns;   // The x coordinates of the sampled columns
+
+        // Visualization, only set when the columns are processed by a single thread
+        cv::Mat* obstacle_map;
+        cv::Mat* slope_img;
+    };
+
+    bool processImage(const rgbd::ImageConstPtr& image, const geo::Pose3D& sensor_pose,
+                      pcl::PointCloud<pcl::PointXYZ>& cloud);
+
+    // Finds the closest obstacle in the sampled columns [begin, end) of the task
+    void processColumns(const ColumnTask& task, int begin, int end, std::vector<ColumnResult>& results) const;
+
+    // Moves the images of the ImageBuffer into the depth ring buffer, in threaded mode
+    void receiveLoop();
+
+    void workerLoop();
+
     ImageBuffer image_buffer_;
 
+    // Keeps the ray directions of the camera between images, only used by the thread that processes images
+    costmap_2d::DepthSlopeKernel kernel_;
+
     bool initialized_;
 
+    // Worker thread
+
+    struct DepthFrame
+    {
+        rgbd::ImageConstPtr image;
+        geo::Pose3D sensor_pose;
+    };
+
+    bool threaded_;
+
+    int num_threads_;
+
+    costmap_2d::RingBuffer<DepthFrame> depth_buffer_;
+
+    boost::thread* receiver_;
+
+    boost::thread* worker_;
+
+    boost::mutex cloud_mutex_;
+
+    pcl::PointCloud<pcl::PointXYZ> latest_cloud_;
+
+    bool has_new_cloud_;
+
     // Params
 
     std::string map_frame_;
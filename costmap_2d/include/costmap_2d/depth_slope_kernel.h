@@ -0,0 +1,182 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_DEPTH_SLOPE_KERNEL_H_
+#define COSTMAP_DEPTH_SLOPE_KERNEL_H_
+
+#include <algorithm>
+#include <vector>
+
+#ifdef __GNUC__
+#define COSTMAP_RESTRICT __restrict__
+#else
+#define COSTMAP_RESTRICT
+#endif
+
+namespace costmap_2d
+{
+
+/**
+ * @class DepthSlopeKernel
+ * @brief Finds the closest obstacle in the columns of a depth image
+ *
+ * A pixel is an obstacle if it is higher than the obstacle height above the floor, or if it is lower
+ * and the least-squares slope of height over distance in a window of rows around it is steep.
+ * The ray direction of every pixel is computed once per camera model and kept column by column,
+ * all per-pixel work is done in single precision on arrays so the loops vectorize.
+ */
+class DepthSlopeKernel
+{
+public:
+  /** @brief Buffers used while processing a column, one per thread */
+  struct Scratch
+  {
+    std::vector<float> depth, x, y, z;    ///< @brief The depth and floor frame position of each row
+    std::vector<float> sum_y, sum_z, sum_yz, sum_yy;
+    std::vector<unsigned char> labels;    ///< @brief OBSTACLE_HEIGHT, OBSTACLE_SLOPE or zero for each row
+  };
+
+  enum Label
+  {
+    OBSTACLE_HEIGHT = 1, OBSTACLE_SLOPE = 2
+  };
+
+  DepthSlopeKernel();
+
+  /**
+   * @brief  Compute the ray directions of the pixels if the camera model changed
+   * @param  camera Anything with a project2Dto3D(x, y) that returns the ray of a pixel as a point with x, y and z
+   * @return True if the rays were recomputed
+   */
+  template <class Camera>
+  bool setCamera(const Camera& camera, int width, int height)
+  {
+    // the projection is affine in x and in y, so two opposite corners identify the camera model
+    float corners[6];
+    copyPoint(camera.project2Dto3D(0, 0), corners);
+    copyPoint(camera.project2Dto3D(width - 1, height - 1), corners + 3);
+    if (width == width_ && height == height_ && std::equal(corners, corners + 6, corners_))
+      return false;
+
+    width_ = width;
+    height_ = height;
+    std::copy(corners, corners + 6, corners_);
+    ray_x_.resize(width * height);
+    ray_y_.resize(width * height);
+    ray_z_.resize(width * height);
+    for (int x = 0; x < width; ++x)
+    {
+      for (int y = 0; y < height; ++y)
+      {
+        float ray[3];
+        copyPoint(camera.project2Dto3D(x, y), ray);
+        unsigned int i = x * height + y;
+        ray_x_[i] = ray[0];
+        ray_y_[i] = ray[1];
+        ray_z_[i] = ray[2];
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief  Set the pose of the camera relative to the floor frame
+   * @param  rotation The rotation matrix, row by row
+   * @param  translation The position of the camera
+   */
+  void setPose(const double rotation[9], const double translation[3]);
+
+  /**
+   * @brief  Set the classification parameters
+   * @param  window_size The number of rows in the slope window
+   * @param  slope_threshold The slope above which a floor pixel is an obstacle
+   * @param  obstacle_height The height above which a pixel is an obstacle
+   */
+  void setParameters(int window_size, float slope_threshold, float obstacle_height);
+
+  /**
+   * @brief  Find the obstacle in a column that is closest in y
+   *
+   * Only reads the kernel, so several threads can process columns at once with their own scratch buffers.
+   * @param  rows The rows of the depth image, zero and NaN mark missing depth
+   * @param  x The column to process
+   * @param  scratch Holds the positions and labels of all rows of the column afterwards
+   * @param  closest Set to the floor frame position of the closest obstacle
+   * @return False if the column has no obstacle
+   */
+  bool processColumn(const float* const* rows, int x, Scratch& scratch, float closest[3]) const;
+
+  int width() const
+  {
+    return width_;
+  }
+
+  int height() const
+  {
+    return height_;
+  }
+
+private:
+  template <class Point>
+  static void copyPoint(const Point& point, float* out)
+  {
+    out[0] = point.x;
+    out[1] = point.y;
+    out[2] = point.z;
+  }
+
+  /** @brief Transform the pixels of a column with depth d along the rays r into the floor frame */
+  void toFloorFrame(const float* COSTMAP_RESTRICT d, const float* COSTMAP_RESTRICT rx,
+                    const float* COSTMAP_RESTRICT ry, const float* COSTMAP_RESTRICT rz, int height,
+                    float* COSTMAP_RESTRICT px, float* COSTMAP_RESTRICT py, float* COSTMAP_RESTRICT pz) const;
+
+  /** @brief Label the obstacles of a column from the floor frame heights and the running sums */
+  void labelObstacles(const float* COSTMAP_RESTRICT d, const float* COSTMAP_RESTRICT pz,
+                      const float* COSTMAP_RESTRICT sy, const float* COSTMAP_RESTRICT sz,
+                      const float* COSTMAP_RESTRICT syz, const float* COSTMAP_RESTRICT syy, int height,
+                      unsigned char* COSTMAP_RESTRICT labels) const;
+
+  int width_, height_;
+  float corners_[6];
+  std::vector<float> ray_x_, ray_y_, ray_z_;  ///< @brief The ray of pixel (x, y) is at index x * height + y
+
+  float rotation_[9], translation_[3];
+
+  int window_size_;
+  float slope_threshold_, obstacle_height_;
+};
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_DEPTH_SLOPE_KERNEL_H_
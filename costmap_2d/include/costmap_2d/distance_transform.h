@@ -0,0 +1,86 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_DISTANCE_TRANSFORM_H_
+#define COSTMAP_DISTANCE_TRANSFORM_H_
+
+#include <vector>
+
+namespace costmap_2d
+{
+
+/**
+ * @class DistanceTransform
+ * @brief Exact squared Euclidean distance transform of a grid in linear time
+ *
+ * Implements the separable lower envelope algorithm of Felzenszwalb and
+ * Huttenlocher ("Distance Transforms of Sampled Functions"): one pass along
+ * the rows followed by one pass along the columns, each linear in the number
+ * of cells. The scratch buffers are kept between calls.
+ */
+class DistanceTransform
+{
+public:
+  /** @brief Value of cells that are not a source */
+  static const float INF;
+
+  /**
+   * @brief  Compute the generalized distance transform of a grid in place
+   *
+   * On input each cell of the grid holds an offset f(q), INF for cells that are
+   * not a source (plain sources have an offset of 0). On output each cell p
+   * holds min over q of ((p - q)^2 + f(q)), in squared cells.
+   * @param  grid The grid, row major
+   * @param  size_x The x size of the grid in cells
+   * @param  size_y The y size of the grid in cells
+   */
+  void compute(float* grid, unsigned int size_x, unsigned int size_y);
+
+private:
+  /**
+   * @brief  Transform one row or column of the grid
+   * @param  data The first cell of the row or column
+   * @param  n The number of cells
+   * @param  stride The distance between two consecutive cells in the grid
+   */
+  void transform1D(float* data, unsigned int n, unsigned int stride);
+
+  std::vector<double> f_; ///< @brief Input of the current row or column
+  std::vector<double> z_; ///< @brief Boundaries between the parabolas of the lower envelope
+  std::vector<unsigned int> v_; ///< @brief Locations of the parabolas of the lower envelope
+};
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_DISTANCE_TRANSFORM_H_
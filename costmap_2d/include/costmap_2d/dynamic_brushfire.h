@@ -0,0 +1,143 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_DYNAMIC_BRUSHFIRE_H_
+#define COSTMAP_DYNAMIC_BRUSHFIRE_H_
+
+#include <vector>
+
+namespace costmap_2d
+{
+
+/**
+ * @class DynamicBrushfire
+ * @brief Distances to the nearest obstacle cell, updated incrementally as obstacles come and go
+ *
+ * Implements the dynamic brushfire of Lau, Sprunk and Burgard ("Improved
+ * Updating of Euclidean Distance Maps and Voronoi Diagrams"). Each cell keeps
+ * its nearest obstacle cell. Inserting an obstacle starts a lower wave over
+ * the cells that get closer to it, removing one starts a raise wave that
+ * clears the cells it was nearest to, followed by a lower wave from the
+ * obstacles around them. update() only visits the cells whose distance
+ * changes and their neighbors. Distances beyond a maximum are not tracked.
+ *
+ * The waves pass on the nearest obstacle between 8-connected neighbors, so
+ * like any brushfire a distance can be slightly larger than the exact one.
+ */
+class DynamicBrushfire
+{
+public:
+  /** @brief The obstacle of cells without one within the maximum distance */
+  static const unsigned int NONE;
+
+  DynamicBrushfire() :
+      size_x_(0), size_y_(0), max_distance_(0), current_level_(0)
+  {
+  }
+
+  /**
+   * @brief  Start over with a grid without obstacles
+   * @param  size_x The x size of the grid in cells
+   * @param  size_y The y size of the grid in cells
+   * @param  max_squared_distance Cells further than this from all obstacles, in squared cells, have none
+   */
+  void reset(unsigned int size_x, unsigned int size_y, unsigned int max_squared_distance);
+
+  /** @brief Make a cell an obstacle, takes effect on the next update() */
+  void setObstacle(unsigned int index);
+
+  /** @brief Make a cell free, takes effect on the next update() */
+  void removeObstacle(unsigned int index);
+
+  /** @brief Process the waves started since the last update() */
+  void update();
+
+  bool isObstacle(unsigned int index) const
+  {
+    return occupied_[index];
+  }
+
+  /** @brief The index of the nearest obstacle cell of a cell, or NONE */
+  unsigned int getObstacle(unsigned int index) const
+  {
+    return obstacle_[index];
+  }
+
+  /** @brief The squared distance in cells to the nearest obstacle, only valid if getObstacle() is not NONE */
+  unsigned int getSquaredDistance(unsigned int index) const
+  {
+    return distance_[index];
+  }
+
+  unsigned int getSizeX() const
+  {
+    return size_x_;
+  }
+
+  unsigned int getSizeY() const
+  {
+    return size_y_;
+  }
+
+  unsigned int getMaxSquaredDistance() const
+  {
+    return max_distance_;
+  }
+
+private:
+  /** @brief Queue a cell in the bucket of a squared distance, or the current one if that is closer */
+  void enqueue(unsigned int index, unsigned int level);
+
+  /** @brief Clear the neighbors whose obstacle is gone, queue the others to lower from */
+  void raise(unsigned int index);
+
+  /** @brief Hand the obstacle of a cell on to the neighbors it is closer to */
+  void lower(unsigned int index);
+
+  unsigned int size_x_, size_y_;
+  unsigned int max_distance_; ///< @brief The maximum squared distance that is tracked
+
+  std::vector<unsigned int> obstacle_; ///< @brief Per cell, the index of its nearest obstacle
+  std::vector<unsigned int> distance_; ///< @brief Per cell, the squared distance to obstacle_
+  std::vector<unsigned char> occupied_; ///< @brief Per cell, whether it is an obstacle
+  std::vector<unsigned char> raising_; ///< @brief Per cell, whether it is queued to pass on a raise wave
+
+  /** The queue, bucketed by squared distance. The buckets are kept between updates so their storage is reused. */
+  std::vector<std::vector<unsigned int> > buckets_;
+  unsigned int current_level_; ///< @brief The bucket that is being processed
+};
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_DYNAMIC_BRUSHFIRE_H_
@@ -0,0 +1,182 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_EXECUTOR_H_
+#define COSTMAP_EXECUTOR_H_
+
+#include <deque>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace costmap_2d
+{
+
+class TaskGroup;
+
+/**
+ * @class Executor
+ * @brief A work stealing pool of threads shared by the parallel parts of the navigation stack.
+ *
+ * Every worker owns a queue of tasks. A worker runs the newest task of its own
+ * queue first and steals the oldest task of another queue when its own is
+ * empty. Tasks are submitted through a TaskGroup, whose wait() runs the tasks
+ * of the group that no worker has taken yet on the waiting thread, so a pool
+ * without workers still runs everything, just sequentially.
+ *
+ * The costmaps, the local planners and the global planners of a process all
+ * use global(), so they never have more threads busy than the pool has workers
+ * plus the threads waiting on their groups.
+ */
+class Executor
+{
+public:
+  typedef boost::function<void()> Task;
+
+  /**
+   * @brief  Constructor
+   * @param  threads The number of worker threads
+   * @param  pin Whether worker i is bound to cpu i, modulo the number of cpus
+   */
+  explicit Executor(unsigned int threads, bool pin = false);
+
+  /** @brief  Stops the workers, the groups using the executor must have been waited for */
+  ~Executor();
+
+  unsigned int getThreads() const
+  {
+    return workers_.size();
+  }
+
+  /**
+   * @brief  The executor shared by the process, created on first use.
+   *
+   * Unless configureGlobal() was called first, it has one worker less than
+   * the machine has cpus, since the thread waiting on a group works too.
+   */
+  static Executor& global();
+
+  /**
+   * @brief  Set the size of the shared executor, must be called before its first use
+   * @param  threads The number of worker threads
+   * @param  pin Whether to bind the workers to cpus
+   * @return False if the shared executor was already created, it is left unchanged then
+   */
+  static bool configureGlobal(unsigned int threads, bool pin = false);
+
+private:
+  friend class TaskGroup;
+
+  struct Job
+  {
+    Task task;
+    TaskGroup* group;
+  };
+
+  struct Queue
+  {
+    boost::mutex mutex;
+    std::deque<Job> jobs;
+  };
+
+  void submit(const Task& task, TaskGroup* group);
+
+  /**
+   * @brief  Take one task and run it
+   * @param  group Only take a task of this group, or any task if NULL
+   * @param  own The queue of the calling worker, which is taken from the back
+   * @return False if there was no task to take
+   */
+  bool runOne(TaskGroup* group, int own);
+
+  bool take(Queue& queue, TaskGroup* group, bool newest, Job* job);
+
+  void workerLoop(unsigned int index);
+
+  /** @brief The index of the queue owned by the calling thread, or -1 if it is not a worker of this executor */
+  int ownQueue() const;
+
+  std::vector<Queue*> queues_;
+  std::vector<boost::thread*> workers_;
+
+  boost::mutex idle_mutex_;
+  boost::condition_variable idle_;
+  unsigned int queued_;
+  unsigned int next_queue_;
+  bool stop_;
+};
+
+/**
+ * @class TaskGroup
+ * @brief A set of tasks run on an Executor that can be waited for as a whole.
+ *
+ * The typical use replaces a thread group that is joined right away: run() all
+ * parts but the first, do the first part on the calling thread, then wait().
+ */
+class TaskGroup
+{
+public:
+  explicit TaskGroup(Executor& executor = Executor::global());
+
+  /** @brief  Waits for the tasks that are still pending */
+  ~TaskGroup();
+
+  /** @brief  Queue a task, it may run on any worker or in wait() */
+  void run(const Executor::Task& task);
+
+  /**
+   * @brief  Return once every task of the group has finished.
+   *
+   * Tasks of the group that were not started yet are run on the calling
+   * thread. It never runs tasks of other groups, which might need a lock the
+   * caller is holding.
+   */
+  void wait();
+
+private:
+  friend class Executor;
+
+  void finished();
+
+  Executor& executor_;
+  boost::mutex mutex_;
+  boost::condition_variable done_;
+  unsigned int pending_;
+};
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_EXECUTOR_H_
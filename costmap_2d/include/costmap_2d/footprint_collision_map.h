@@ -0,0 +1,127 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_FOOTPRINT_COLLISION_MAP_H_
+#define COSTMAP_FOOTPRINT_COLLISION_MAP_H_
+
+#include <costmap_2d/costmap_2d.h>
+#include <costmap_2d/footprint_spans.h>
+#include <geometry_msgs/Point.h>
+#include <stdint.h>
+#include <vector>
+
+namespace costmap_2d
+{
+
+/**
+ * @class FootprintCollisionMap
+ * @brief Whether the footprint collides at each cell of a grid, one bit per cell and heading bin
+ *
+ * The footprint is rasterized per heading bin like FootprintSpans. A robot
+ * cell collides in a bin if one of the cells under the footprint there holds
+ * an obstacle, obstacles outside of the grid are not known. The bits are
+ * computed from the runs of obstacle cells of each row, so an update costs
+ * the number of runs times the spans of all bins, not the footprint area per cell.
+ */
+class FootprintCollisionMap
+{
+public:
+  FootprintCollisionMap();
+
+  /**
+   * @brief  Rasterize the footprint, the next update() recomputes the whole grid
+   * @param  footprint The footprint in robot coordinates
+   * @param  resolution The resolution of the grid
+   * @param  headings The number of heading bins
+   */
+  void setFootprint(const std::vector<geometry_msgs::Point>& footprint, double resolution, unsigned int headings);
+
+  /** @brief Match the size of the grid, the next update() recomputes the whole grid */
+  void resize(unsigned int size_x, unsigned int size_y);
+
+  /**
+   * @brief  Recompute the robot cells of an area from the obstacle cells of a grid
+   *
+   * Obstacles changed at a cell change the robot cells up to getReach() cells
+   * around it, so the area should be grown by that much.
+   * @param  grid The grid, with the size given to resize()
+   * @param  obstacle The cost of the obstacle cells
+   */
+  void update(const Costmap2D& grid, unsigned char obstacle, int min_i, int min_j, int max_i, int max_j);
+
+  /** @brief The farthest a cell under the footprint is from the robot cell along x or y, in cells */
+  int getReach() const
+  {
+    return reach_;
+  }
+
+  unsigned int getNumBins() const
+  {
+    return spans_.getNumBins();
+  }
+
+  /** @brief The heading bin of a yaw, setFootprint() must have been called */
+  unsigned int getBin(double yaw) const
+  {
+    return spans_.getBin(yaw);
+  }
+
+  /** @brief Whether the footprint collides at a cell in a heading bin */
+  bool collides(unsigned int mx, unsigned int my, unsigned int bin) const
+  {
+    return (bits_[(bin * size_y_ + my) * words_per_row_ + (mx >> 6)] >> (mx & 63)) & 1;
+  }
+
+  /** @brief Whether the footprint collides at a cell at a heading, setFootprint() must have been called */
+  bool collides(unsigned int mx, unsigned int my, double yaw) const
+  {
+    return collides(mx, my, getBin(yaw));
+  }
+
+private:
+  /** @brief Set or clear the bits x0 <= x < xn of a row of a bin */
+  void setBits(unsigned int bin, int y, int x0, int xn, bool value);
+
+  FootprintSpans spans_;
+  int reach_;
+  int min_dy_, max_dy_, min_dx_, max_dx_; ///< @brief The extents of the spans of all bins, xn exclusive
+
+  unsigned int size_x_, size_y_, words_per_row_;
+  std::vector<uint64_t> bits_; ///< @brief Rows of words, bin after bin
+  bool stale_; ///< @brief Whether the next update() has to recompute the whole grid
+};
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_FOOTPRINT_COLLISION_MAP_H_
@@ -41,6 +41,7 @@
 #include <costmap_2d/layer.h>
 #include <costmap_2d/layered_costmap.h>
 #include <costmap_2d/costmap_math.h>
+#include <costmap_2d/footprint_spans.h>
 #include <costmap_2d/GenericPluginConfig.h>
 #include <dynamic_reconfigure/server.h>
 #include <nav_msgs/OccupancyGrid.h>
@@ -52,7 +53,7 @@ namespace costmap_2d
 class FootprintLayer : public Layer
 {
 public:
-  FootprintLayer() : scale_(1.0) {}
+  FootprintLayer() : scale_(1.0), headings_(0), robot_x_(0.0), robot_y_(0.0), robot_yaw_(0.0) {}
   void setScale(double scale) { scale_ = scale; }
 
   virtual void onInitialize();
@@ -61,6 +62,13 @@ public:
   virtual void updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y, double* max_x,
                              double* max_y);
   virtual void updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
+  virtual bool isBoundsIndependent() const
+  {
+    return true;
+  }
+
+  /** @brief The footprint polygon at the pose of the last updateBounds() call. */
+  const geometry_msgs::PolygonStamped& getTransformedFootprint() const { return footprint_; }
 
 private:
   geometry_msgs::PolygonStamped footprint_; ///< Storage for polygon being published.
@@ -69,6 +77,10 @@ private:
   ros::Publisher footprint_pub_;
   dynamic_reconfigure::Server<costmap_2d::GenericPluginConfig> *dsrv_;
   double scale_;
+
+  unsigned int headings_; ///< @brief The heading bins of spans_, 0 fills the exact polygon instead
+  FootprintSpans spans_; ///< @brief The cells under the footprint per heading bin
+  double robot_x_, robot_y_, robot_yaw_; ///< @brief The pose of the last updateBounds() call
 };
 }
 #endif
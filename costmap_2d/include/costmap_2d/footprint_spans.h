@@ -0,0 +1,140 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_FOOTPRINT_SPANS_H_
+#define COSTMAP_FOOTPRINT_SPANS_H_
+
+#include <costmap_2d/costmap_2d.h>
+#include <geometry_msgs/Point.h>
+#include <vector>
+
+namespace costmap_2d
+{
+
+/**
+ * @class FootprintSpans
+ * @brief The cells under a convex footprint for a number of headings, as row spans relative to the robot cell
+ *
+ * For each heading bin the footprint, rotated to the center of the bin with
+ * the robot at the center of its cell, is rasterized once like
+ * Costmap2D::convexFillCells(): the cells on its outline and the cells
+ * between them. Filling the footprint at a pose then only sets the cost of
+ * a few rows of cells, without allocating or sorting anything.
+ */
+class FootprintSpans
+{
+public:
+  /** @brief The cells dx0 <= dx < dxn of the row dy, relative to the robot cell */
+  struct RowSpan
+  {
+    int dy, dx0, dxn;
+  };
+
+  FootprintSpans() :
+      scale_(0.0), resolution_(0.0)
+  {
+  }
+
+  /**
+   * @brief  Rasterize the footprint for every heading, unless nothing changed since the last call
+   * @param  footprint The footprint in robot coordinates
+   * @param  scale The factor the footprint is scaled by
+   * @param  resolution The resolution of the grid the spans are for
+   * @param  headings The number of heading bins
+   */
+  void update(const std::vector<geometry_msgs::Point>& footprint, double scale, double resolution,
+              unsigned int headings);
+
+  /** @brief The spans of the heading bin of a yaw, update() must have been called */
+  const std::vector<RowSpan>& getSpans(double yaw) const
+  {
+    return spans_[getBin(yaw)];
+  }
+
+  /** @brief The number of heading bins, 0 before update() */
+  unsigned int getNumBins() const
+  {
+    return spans_.size();
+  }
+
+  /** @brief The heading bin of a yaw, update() must have been called */
+  unsigned int getBin(double yaw) const;
+
+  /** @brief The spans of a heading bin, sorted by dy */
+  const std::vector<RowSpan>& getBinSpans(unsigned int bin) const
+  {
+    return spans_[bin];
+  }
+
+  /**
+   * @brief  Set the cost of the cells under the footprint at a pose, the ones outside of the grid are left out
+   *
+   * The caller is responsible for holding the lock of the grid.
+   * @param  grid The grid, with the resolution given to update()
+   * @param  x The x position of the robot in world coordinates
+   * @param  y The y position of the robot in world coordinates
+   * @param  yaw The heading of the robot
+   * @param  cost_value The value to set costs to
+   * @param  stamp The update time of the cells (seconds)
+   */
+  void setCost(Costmap2D& grid, double x, double y, double yaw, unsigned char cost_value, double stamp) const;
+
+  /**
+   * @brief  The highest cost of the cells under the footprint at a pose
+   *
+   * The caller is responsible for holding the lock of the grid.
+   * @param  grid The grid, with the resolution given to update()
+   * @param  x The x position of the robot in world coordinates
+   * @param  y The y position of the robot in world coordinates
+   * @param  yaw The heading of the robot
+   * @return The cost, -1 if a cell is lethal or unknown, the footprint leaves the grid or update() was not called
+   */
+  double getCost(const Costmap2D& grid, double x, double y, double yaw) const;
+
+private:
+  /** @brief Rasterize the footprint rotated by yaw into spans */
+  void rasterize(double yaw, std::vector<RowSpan>& spans);
+
+  /** @brief Add the cells of a line between two cells to the extents of the rows in row_min_ and row_max_ */
+  void addLine(int x0, int y0, int x1, int y1, int min_y);
+
+  std::vector<geometry_msgs::Point> footprint_; ///< @brief The footprint the spans were computed for
+  double scale_, resolution_;
+  std::vector<std::vector<RowSpan> > spans_; ///< @brief Per heading bin
+  std::vector<int> row_min_, row_max_; ///< @brief Scratch space of rasterize()
+};
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_FOOTPRINT_SPANS_H_
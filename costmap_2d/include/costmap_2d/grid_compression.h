@@ -0,0 +1,166 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_GRID_COMPRESSION_H_
+#define COSTMAP_GRID_COMPRESSION_H_
+
+#include <stdint.h>
+#include <vector>
+#include <nav_msgs/OccupancyGrid.h>
+#include <costmap_2d/CompressedGridUpdate.h>
+#include <costmap_2d/VoxelGrid.h>
+#include <costmap_2d/VoxelGridUpdate.h>
+
+namespace costmap_2d
+{
+
+/**
+ * @brief  Run length encode a buffer
+ *
+ * A control byte c below 128 is followed by c + 1 literal bytes, a control
+ * byte of 128 or more by a single byte that is repeated c - 125 times.
+ * @param  data The buffer
+ * @param  length The number of bytes in the buffer
+ * @param  encoded Is filled with the encoded bytes
+ */
+void encodeRunLength(const int8_t* data, unsigned int length, std::vector<uint8_t>& encoded);
+
+/**
+ * @brief  Decode a buffer encoded with encodeRunLength()
+ * @param  encoded The encoded bytes
+ * @param  data The decoded bytes are written here
+ * @param  length The number of bytes expected
+ * @return False if the encoded bytes are malformed or do not decode to exactly length bytes
+ */
+bool decodeRunLength(const std::vector<uint8_t>& encoded, int8_t* data, unsigned int length);
+
+/**
+ * @class CompressedGridDecoder
+ * @brief Rebuilds the map from the CompressedGridUpdate messages of a Costmap2DPublisher
+ */
+class CompressedGridDecoder
+{
+public:
+  CompressedGridDecoder();
+
+  /**
+   * @brief  Apply an update to the map
+   * @return False if the update could not be applied, the map stays invalid until the next keyframe
+   */
+  bool update(const CompressedGridUpdate& update);
+
+  /** @brief Whether the map is complete, it is after the first keyframe as long as no update was missed */
+  bool isValid() const
+  {
+    return valid_;
+  }
+
+  const nav_msgs::OccupancyGrid& getGrid() const
+  {
+    return grid_;
+  }
+
+private:
+  nav_msgs::OccupancyGrid grid_;
+  std::vector<int8_t> region_;
+  uint32_t frame_;
+  bool valid_;
+};
+
+/**
+ * @brief  Collapse runs of identical voxel columns
+ *
+ * Every run is written as its length followed by the words of the column.
+ * @param  words The columns, words_per_column words each
+ * @param  columns The number of columns
+ * @param  words_per_column 1 for grids of up to 16 voxels high, 2 above
+ * @param  encoded Is filled with the encoded words
+ */
+void encodeColumnRuns(const uint32_t* words, unsigned int columns, unsigned int words_per_column,
+                      std::vector<uint32_t>& encoded);
+
+/**
+ * @brief  Decode columns encoded with encodeColumnRuns()
+ * @return False if the encoded words are malformed or do not decode to exactly the given number of columns
+ */
+bool decodeColumnRuns(const std::vector<uint32_t>& encoded, unsigned int words_per_column, uint32_t* words,
+                      unsigned int columns);
+
+/**
+ * @brief  Move the columns of a grid in the layout of VoxelGrid as voxel_grid::VoxelGrid::shift() moves them
+ *
+ * The column at (x, y) afterwards is the one that was at (x + cell_ox, y + cell_oy), columns that were
+ * outside the grid become unknown.
+ * @param  words The columns of the grid, words_per_column words each
+ * @param  words_per_column 1 for grids of up to 16 voxels high, 2 above
+ */
+void shiftVoxelColumns(std::vector<uint32_t>& words, unsigned int size_x, unsigned int size_y,
+                       unsigned int words_per_column, int cell_ox, int cell_oy);
+
+/**
+ * @class VoxelGridDecoder
+ * @brief Rebuilds the voxel grid from the VoxelGridUpdate messages of a VoxelLayer
+ */
+class VoxelGridDecoder
+{
+public:
+  VoxelGridDecoder();
+
+  /**
+   * @brief  Apply an update to the grid
+   * @return False if the update could not be applied, the grid stays invalid until the next keyframe
+   */
+  bool update(const VoxelGridUpdate& update);
+
+  /** @brief Whether the grid is complete, it is after the first keyframe as long as no update was missed */
+  bool isValid() const
+  {
+    return valid_;
+  }
+
+  const VoxelGrid& getGrid() const
+  {
+    return grid_;
+  }
+
+private:
+  VoxelGrid grid_;
+  std::vector<uint32_t> region_;
+  uint32_t frame_;
+  bool valid_;
+};
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_GRID_COMPRESSION_H_
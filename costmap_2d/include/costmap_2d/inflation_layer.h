@@ -41,21 +41,25 @@
 #include <costmap_2d/layer.h>
 #include <costmap_2d/layered_costmap.h>
 #include <costmap_2d/InflationPluginConfig.h>
+#include <costmap_2d/dynamic_brushfire.h>
+#include <costmap_2d/footprint_collision_map.h>
 #include <dynamic_reconfigure/server.h>
-#include <queue>
+#include <vector>
 
 namespace costmap_2d
 {
 /**
  * @class CellData
  * @brief Storage for cell information used during obstacle inflation
+ *
+ * The distance to the obstacle is not stored, it is given by the bucket of the
+ * inflation queue the cell is in.
  */
 class CellData
 {
 public:
   /**
    * @brief  Constructor for a CellData objects
-   * @param  d The distance to the nearest obstacle, used for ordering in the priority queue
    * @param  i The index of the cell in the cost map
    * @param  x The x coordinate of the cell in the cost map
    * @param  y The y coordinate of the cell in the cost map
@@ -63,47 +67,82 @@ public:
    * @param  sy The y coordinate of the closest obstacle cell in the costmap
    * @return
    */
-  CellData(double d, double i, unsigned int x, unsigned int y, unsigned int sx, unsigned int sy) :
-      distance_(d), index_(i), x_(x), y_(y), src_x_(sx), src_y_(sy)
+  CellData(unsigned int i, unsigned int x, unsigned int y, unsigned int sx, unsigned int sy) :
+      index_(i), x_(x), y_(y), src_x_(sx), src_y_(sy)
   {
   }
-  double distance_;
   unsigned int index_;
   unsigned int x_, y_;
   unsigned int src_x_, src_y_;
 };
 
 /**
- * @brief Provide an ordering between CellData objects in the priority queue
- * @return We want the lowest distance to have the highest priority... so this returns true if a has higher priority than b
+ * @class InflationWorkspace
+ * @brief The state of one inflation pass, one per thread that inflates
  */
-inline bool operator<(const CellData &a, const CellData &b)
+class InflationWorkspace
 {
-  return a.distance_ > b.distance_;
-}
+public:
+  InflationWorkspace() :
+      current_level_(0), seen_generation_(0)
+  {
+  }
+
+  /**
+   * @brief  Prepare for a pass over a grid, marking all cells as unseen
+   * @param  num_cells The number of cells of the grid
+   * @param  num_levels The number of distance buckets needed
+   */
+  void begin(unsigned int num_cells, unsigned int num_levels);
+
+  /**
+   * The inflation queue, bucketed by the squared distance in cells between a
+   * cell and its obstacle. The buckets are kept between updates so their
+   * storage is reused.
+   */
+  std::vector<std::vector<CellData> > inflation_cells_;
+  unsigned int current_level_; ///< @brief The bucket that is being processed
+
+  /**
+   * A cell was visited in this pass if its entry equals seen_generation_.
+   * Bumping the generation marks the whole grid as unseen, so it only needs to
+   * be cleared when the counter wraps around.
+   */
+  std::vector<uint16_t> seen_;
+  uint16_t seen_generation_;
+
+  std::vector<unsigned char> tile_; ///< @brief Copy of the tile being inflated, for tiled inflation
+};
 
 class InflationLayer : public Layer
 {
 public:
   InflationLayer();
 
-  virtual ~InflationLayer()
-  {
-    deleteKernels();
-    if(dsrv_)
-        delete dsrv_;
-  }
+  virtual ~InflationLayer();
 
   virtual void onInitialize();
   virtual void updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y, double* max_x,
                              double* max_y);
   virtual void updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
+
+  /** @brief The incremental inflation grows the bounds of the layers before it by the inflation radius */
+  virtual bool isBoundsIndependent() const
+  {
+    return !incremental_;
+  }
   virtual bool isDiscretized()
   {
     return true;
   }
   virtual void matchSize();
 
+  /** @brief Whether tiles inside the rectangle still wait for their inflation, see ~lazy_radius */
+  virtual bool hasDeferred(int min_i, int min_j, int max_i, int max_j);
+
+  /** @brief Inflate the tiles inside the rectangle that still wait for it */
+  virtual void completeDeferred(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
+
   virtual void reset() { onInitialize(); }
 
   /** @brief  Given a distance, compute a cost.
@@ -126,67 +165,148 @@ public:
     return cost;
   }
 
+  /**
+   * @brief  Whether the footprint collides at each cell of the master grid per heading bin, NULL unless
+   * ~footprint_collision_headings is set and use_footprint is on
+   *
+   * Only valid while holding the lock of the master grid, the map is updated with its costs.
+   */
+  const FootprintCollisionMap* getCollisionMap() const
+  {
+    return use_footprint_ && collision_headings_ > 0 ? &collision_map_ : NULL;
+  }
+
 protected:
   virtual void onFootprintChanged();
   boost::shared_mutex* access_;
 
+  double inflation_radius_, dilation_radius_, cost_scaling_factor_;
+  unsigned char target_cell_value_, dilation_cell_value_;
+  bool use_footprint_;
+
+  unsigned int cell_inflation_radius_;
+
+  double resolution_;
+
 private:
   /**
-   * @brief  Lookup pre-computed distances
-   * @param mx The x coordinate of the current cell
-   * @param my The y coordinate of the current cell
-   * @param src_x The x coordinate of the source cell
-   * @param src_y The y coordinate of the source cell
+   * @brief  Lookup pre-computed costs
+   * @param dx The x distance in cells between the current cell and the source cell
+   * @param dy The y distance in cells between the current cell and the source cell
    * @return
    */
-  inline double distanceLookup(int mx, int my, int src_x, int src_y)
+  inline unsigned char costLookup(unsigned int dx, unsigned int dy) const
   {
-    unsigned int dx = abs(mx - src_x);
-    unsigned int dy = abs(my - src_y);
-    return cached_distances_[dx][dy];
+    return cached_costs_[dx * cache_size_ + dy];
   }
 
+  void computeCaches();
+
+  /** @brief Tell the layered costmap which robot cell costs decide a footprint check */
+  void updateInflationThresholds();
+
   /**
-   * @brief  Lookup pre-computed costs
-   * @param mx The x coordinate of the current cell
-   * @param my The y coordinate of the current cell
-   * @param src_x The x coordinate of the source cell
-   * @param src_y The y coordinate of the source cell
-   * @return
+   * @brief  Inflate the target cells of an area of a grid
+   *
+   * The inflation may spread up to cell_inflation_radius_ outside of the area.
+   * @param ws The workspace to use
+   * @param grid The grid to inflate
+   * @param size_x The x size of the grid
+   * @param size_y The y size of the grid
+   * @param min_i The lower x bound of the area holding the target cells
+   * @param min_j The lower y bound of the area holding the target cells
+   * @param max_i The upper x bound of the area holding the target cells, exclusive
+   * @param max_j The upper y bound of the area holding the target cells, exclusive
    */
-  inline unsigned char costLookup(int mx, int my, int src_x, int src_y)
-  {
-    unsigned int dx = abs(mx - src_x);
-    unsigned int dy = abs(my - src_y);
-    return cached_costs_[dx][dy];
-  }
+  void inflate_area(InflationWorkspace& ws, unsigned char* grid, unsigned int size_x, unsigned int size_y,
+                    int min_i, int min_j, int max_i, int max_j);
 
-  void computeCaches();
-  void deleteKernels();
-  void inflate_area(int min_i, int min_j, int max_i, int max_j, unsigned char* master_grid);
+  /**
+   * @brief  Inflate an area of the master grid split into tiles, processed by tile_workspaces_.size() threads
+   *
+   * Each tile is inflated on a copy of the tile grown by two inflation radii,
+   * then its own cells are written back. See inflate_area() for the parameters.
+   */
+  void inflateTiled(unsigned char* master_array, unsigned int size_x, unsigned int size_y, int min_i, int min_j,
+                    int max_i, int max_j);
+
+  /**
+   * @brief  Worker of inflateTiled(), takes tiles until there are none left
+   */
+  void inflateTiles(InflationWorkspace* ws, unsigned char* master_array, unsigned int size_x, unsigned int size_y,
+                    int min_i, int min_j, int max_i, int max_j);
+
+  /**
+   * @brief  Inflate the cells of an area within lazy_radius_ of the robot, the tiles of the rest wait in lazy_tiles_
+   *
+   * See inflate_area() for the parameters.
+   */
+  void inflateLazily(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
+
+  /** @brief Inflate the cells of a tile of lazy_tiles_ from the target cells within the inflation radius of it */
+  void inflateLazyTile(unsigned char* master_array, unsigned int size_x, unsigned int size_y, unsigned int tile);
+
+  /** @brief The cells of the waiting tile closest to the robot, false if no tile waits */
+  bool nearestLazyTile(unsigned int* x0, unsigned int* xn, unsigned int* y0, unsigned int* yn);
+
+  /** @brief Worker thread of the lazy inflation, inflates the waiting tiles nearest to the robot first */
+  void warmTiles();
+
+  /**
+   * @brief  Inflate an area of the master grid from the distances kept by brushfire_
+   *
+   * Only the target cells that appeared or disappeared since the last update
+   * start waves in brushfire_, the costs of the area are then looked up from
+   * the nearest target cell of each cell. The area must hold all cells within
+   * the inflation radius of the changed target cells, see updateBounds().
+   */
+  void inflateIncrementally(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
 
   unsigned int cellDistance(double world_dist)
   {
     return layered_costmap_->getCostmap()->cellDistance(world_dist);
   }
 
-  inline void enqueue(unsigned char* grid, unsigned int index, unsigned int mx, unsigned int my, unsigned int src_x,
-                      unsigned int src_y);
+  inline void enqueue(InflationWorkspace& ws, unsigned char* grid, unsigned int index, unsigned int mx,
+                      unsigned int my, unsigned int src_x, unsigned int src_y);
 
-  double inflation_radius_, dilation_radius_, cost_scaling_factor_;
-  unsigned char target_cell_value_, dilation_cell_value_;
-  bool use_footprint_;
+  unsigned int cache_size_; ///< @brief The width of the cost kernel, one cell more than the inflation radius
 
-  unsigned int cell_inflation_radius_;
-  unsigned int cached_cell_inflation_radius_;
-  std::priority_queue<CellData> inflation_queue_;
+  InflationWorkspace workspace_; ///< @brief Used by the serial inflation
 
-  double resolution_;
+  std::vector<InflationWorkspace> tile_workspaces_; ///< @brief One per thread of the tiled inflation
+  unsigned int tile_size_; ///< @brief The width of the tiles of the tiled inflation in cells
+  unsigned int min_tiled_cells_; ///< @brief Areas with fewer cells are inflated serially
+
+  std::vector<unsigned char> snapshot_; ///< @brief The master grid before the tiled inflation
 
-  bool* seen_;
+  unsigned int collision_headings_; ///< @brief The heading bins of collision_map_, 0 if it is not kept
+  FootprintCollisionMap collision_map_; ///< @brief Whether the footprint hits a target cell, per cell and heading
 
-  unsigned char** cached_costs_;
-  double** cached_distances_;
+  double lazy_radius_; ///< @brief Only cells within it of the robot are inflated by updates, 0 inflates all
+  bool no_unknown_space_; ///< @brief Whether the layers promise to leave no unknown cell in the master grid
+  unsigned int lazy_tile_size_; ///< @brief The width of the tiles of the lazy inflation in cells
+  std::vector<unsigned char> lazy_tiles_; ///< @brief Per tile of the master grid, whether it waits for inflation
+  unsigned int lazy_tiles_x_, lazy_tiles_y_, lazy_tile_count_; ///< @brief The tiles per row and column, and waiting
+  double robot_x_, robot_y_; ///< @brief The position of the robot at the last updateBounds()
+  int robot_mx_, robot_my_; ///< @brief The cell of the robot at the last update of the costs
+  boost::thread* warm_thread_;
+  boost::mutex warm_mutex_;
+  boost::condition_variable warm_condition_;
+  bool warm_pending_, warm_shutdown_; ///< @brief Guarded by warm_mutex_
+
+  bool incremental_; ///< @brief Whether the inflation is kept up to date by brushfire_
+  DynamicBrushfire brushfire_; ///< @brief The nearest target cell of each cell of the master grid
+  double brushfire_origin_x_, brushfire_origin_y_; ///< @brief The origin of the master grid brushfire_ was built for
+  boost::mutex tile_mutex_;
+  unsigned int next_tile_; ///< @brief The next tile to be taken by a worker of the tiled inflation
+
+  /**
+   * Costs by x and y distance to the obstacle, stored in one block. Distances
+   * are compared as integer squared distances in cells, so no distance kernel
+   * is needed.
+   */
+  std::vector<unsigned char> cached_costs_;
 
   dynamic_reconfigure::Server<costmap_2d::InflationPluginConfig> *dsrv_;
   void reconfigureCB(costmap_2d::InflationPluginConfig &config, uint32_t level);
@@ -0,0 +1,73 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef INFLATION_FULL_COSTMAP_PLUGIN_H_
+#define INFLATION_FULL_COSTMAP_PLUGIN_H_
+#include <costmap_2d/inflation_layer.h>
+#include <costmap_2d/distance_transform.h>
+#include <vector>
+
+namespace costmap_2d
+{
+/**
+ * @class InflationLayerFull
+ * @brief Inflates all costs of the master grid, not only the lethal obstacles
+ *
+ * A cell with cost c is treated as if it lay at the distance d(c) from an
+ * obstacle at which the inflation curve of InflationLayer drops to c. Every
+ * cell p then gets the cost of the effective distance
+ * sqrt(min over q of (|p - q|^2 + d(c_q)^2)), which is computed for the
+ * whole update window with one linear time distance transform.
+ */
+class InflationLayerFull : public InflationLayer
+{
+public:
+  InflationLayerFull()
+  {
+  }
+
+  virtual void updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
+
+private:
+  /**
+   * @brief  Compute the squared distance offset of every cost value, INF for costs that are not inflated
+   */
+  void computeCostOffsets();
+
+  float cost_offsets_[256];
+  std::vector<float> distances_;
+  DistanceTransform distance_transform_;
+};
+}
+#endif
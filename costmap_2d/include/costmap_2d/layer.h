@@ -57,6 +57,46 @@ public:
                              double* max_x, double* max_y) {}
   virtual void updateCosts(Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j) {}
 
+  /** @brief Whether updateBounds() may run concurrently with the updateBounds() of other layers.
+   *
+   * Return true only if updateBounds() touches nothing but the state of this
+   * layer and only ever grows the bounds it is given, without reading them.
+   * LayeredCostmap then starts such a layer from empty bounds, so disjoint
+   * updates of different layers are kept apart, and can run it concurrently
+   * with other independent layers. Layers that return false wait for all the
+   * layers before them and everything inside their bounds is recomputed. */
+  virtual bool isBoundsIndependent() const { return false; }
+
+  /** @brief Whether the costs of this layer can be merged band by band of rows.
+   *
+   * Return true only if updateTile() changes nothing but the cells inside the
+   * rectangle it is given, and each of them only depends on the same cell of
+   * the master grid. LayeredCostmap may then run consecutive tileable layers
+   * over one band of the window after the other, so the band stays in cache
+   * across the layers, instead of running each over the whole window. */
+  virtual bool isTileable() const { return false; }
+
+  /** @brief Called once for the whole window before the updateTile() calls of a
+   * tileable layer, for the work that is not per cell. Must not touch the master grid. */
+  virtual void prepareTiles(int min_i, int min_j, int max_i, int max_j) {}
+
+  /** @brief Merge the costs of a band of the window into the master grid, see isTileable() */
+  virtual void updateTile(Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j)
+  {
+    updateCosts(master_grid, min_i, min_j, max_i, max_j);
+  }
+
+  /** @brief Whether this layer deferred costs of cells inside a rectangle of the master grid.
+   *
+   * A layer may leave the costs of cells far from the robot for later, to get
+   * the costmap current sooner. Users that read such cells call
+   * LayeredCostmap::completeDeferred() first. */
+  virtual bool hasDeferred(int min_i, int min_j, int max_i, int max_j) { return false; }
+
+  /** @brief Write the costs this layer deferred inside a rectangle into the master grid, see hasDeferred().
+   * Called with the lock of the master grid held. */
+  virtual void completeDeferred(Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j) {}
+
   virtual void deactivate() {}   // stop publishers
   virtual void activate() {}     // restart publishers if they've been stopped
 
@@ -41,13 +41,55 @@
 #include <costmap_2d/cost_values.h>
 #include <costmap_2d/layer.h>
 #include <costmap_2d/costmap_2d.h>
+#include <ros/time.h>
+#include <limits>
 #include <vector>
 #include <string>
+#include <boost/thread.hpp>
 
 namespace costmap_2d
 {
 class Layer;
 
+/**
+ * @class MapRegion
+ * @brief A rectangle of cells, [x0, xn) x [y0, yn)
+ */
+class MapRegion
+{
+public:
+  MapRegion(unsigned int x0, unsigned int xn, unsigned int y0, unsigned int yn) :
+      x0(x0), xn(xn), y0(y0), yn(yn)
+  {
+  }
+
+  double area() const
+  {
+    return double(xn - x0) * (yn - y0);
+  }
+
+  unsigned int x0, xn, y0, yn;
+};
+
+/**
+ * @class UpdateTiming
+ * @brief The wall times of the stages of one LayeredCostmap::updateMap(), in seconds
+ */
+class UpdateTiming
+{
+public:
+  UpdateTiming() :
+      lock_wait(0.0), total(0.0), cells(0)
+  {
+  }
+
+  std::vector<double> bounds; ///< @brief Per plugin, updateBounds()
+  std::vector<double> costs; ///< @brief Per plugin, updateCosts() over all update windows
+  double lock_wait; ///< @brief Waiting for the lock of the master grid
+  double total; ///< @brief All of updateMap()
+  unsigned int cells; ///< @brief The cells of all update windows
+};
+
 /**
  * @class LayeredCostmap
  * @brief Instantiates different layer plugins and aggregates them into one score
@@ -71,6 +113,15 @@ public:
    */
   void updateMap(double robot_x, double robot_y, double robot_yaw);
 
+  /**
+   * @brief  Let updateMap() only update the layers, without computing the costs of the master grid.
+   *
+   * The bounds the layers report meanwhile are kept and updated by the first update after the costs
+   * are resumed, so the layers take in their observations at little cost while nobody reads the grid.
+   * Applies to the inner costmap as well. Call this from the thread that calls updateMap().
+   */
+  void setCostsSuspended(bool suspended);
+
   std::string getGlobalFrameID() const
   {
     return global_frame_;
@@ -119,6 +170,14 @@ public:
     return size_locked_;
   }
 
+  /** @brief The disjoint rectangles of cells that were updated by the last updateMap().
+   *
+   * getBounds() returns the rectangle around all of them. */
+  const std::vector<MapRegion>& getUpdatedRegions() const
+  {
+    return regions_;
+  }
+
   void getBounds(unsigned int* x0, unsigned int* xn, unsigned int* y0, unsigned int* yn)
   {
     *x0 = bx0_;
@@ -127,11 +186,92 @@ public:
     *yn = byn_;
   }
 
+  /** @brief Get the rectangle around all the cells updated since the last call, and start over.
+   *
+   * Unlike getBounds() this spans any number of updates, so a single user that keeps something derived from the
+   * master grid can bring it up to date whenever it gets to it. Resizing the map, or rolling it, changes all of it.
+   * @return False if no cell changed */
+  bool takeChangedBounds(unsigned int* x0, unsigned int* xn, unsigned int* y0, unsigned int* yn)
+  {
+    return takeChangedBounds(0, x0, xn, y0, yn);
+  }
+
+  /** @brief Register another user of takeChangedBounds(), which gets changed bounds of its own
+   * @return The id to pass to takeChangedBounds(), the user of the overload without one has id 0 */
+  unsigned int addChangedBoundsUser();
+
+  /** @brief Like takeChangedBounds(), for the user with the given id, see addChangedBoundsUser() */
+  bool takeChangedBounds(unsigned int user, unsigned int* x0, unsigned int* xn, unsigned int* y0, unsigned int* yn);
+
   bool isInitialized()
   {
       return initialized_;
   }
 
+  /** @brief Set the number of threads used to run updateBounds() of
+   * independent layers (see Layer::isBoundsIndependent()), 1 updates
+   * all layers sequentially. */
+  void setUpdateThreads(unsigned int threads)
+  {
+    update_threads_ = std::max(1u, threads);
+  }
+
+  /** @brief Set the number of cells of the bands in which runs of tileable
+   * layers (see Layer::isTileable()) merge their costs, so a band stays in
+   * cache across all the layers of a run. 0 runs every layer over the whole
+   * window. */
+  void setTileCells(unsigned int cells)
+  {
+    tile_cells_ = cells;
+  }
+
+  /** @brief Measure the stages of every updateMap(), see getLastTiming(). Off by default, then it costs a branch
+   * per stage. */
+  void setTiming(bool enabled)
+  {
+    timing_enabled_ = enabled;
+  }
+
+  /** @brief Get the timing of the last updateMap() that was measured
+   * @return False if none was */
+  bool getLastTiming(UpdateTiming& timing)
+  {
+    boost::mutex::scoped_lock lock(timing_mutex_);
+    timing = last_timing_;
+    return last_timing_.total > 0.0;
+  }
+
+  /** @brief Write the costs layers deferred inside a rectangle of cells into the master grid, see
+   * Layer::hasDeferred(). Takes the lock of the master grid if there are any, so it must not be held. */
+  void completeDeferred(unsigned int x0, unsigned int xn, unsigned int y0, unsigned int yn);
+
+  /** @brief Like completeDeferred(), for the whole master grid */
+  void completeDeferred()
+  {
+    completeDeferred(0, std::numeric_limits<unsigned int>::max(), 0, std::numeric_limits<unsigned int>::max());
+  }
+
+  /** @brief Like completeDeferred(), for one layer only, which does not need to be one of the plugins any more */
+  void completeDeferred(Layer& layer, unsigned int x0, unsigned int xn, unsigned int y0, unsigned int yn);
+
+  /** @brief Called by layers when new data arrived, wakes up an update loop in waitForUpdateRequest(). */
+  void requestUpdate();
+
+  /**
+   * @brief Wait until layers requested an update, or the timeout passed.
+   * @param min_requests The number of requestUpdate() calls to wait for
+   * @param timeout The maximum time to wait in seconds
+   * @return True if enough requests arrived, false on timeout. The requests are consumed either way.
+   */
+  bool waitForUpdateRequest(unsigned int min_requests, double timeout);
+
+  /** @brief Called by layers from updateBounds() with the number of cells that turned into obstacles,
+   * a measure of how much is going on around the robot for update loops that adapt their rate. */
+  void addNewObstacles(unsigned int cells);
+
+  /** @brief The number of cells reported by addNewObstacles() since the last call */
+  unsigned int takeNewObstacles();
+
   /** @brief Updates the stored footprint, updates the circumscribed
    * and inscribed radii, and calls onFootprintChanged() in all
    * layers. */
@@ -154,9 +294,85 @@ public:
    * This is updated by setFootprint(). */
   double getInscribedRadius() { return inscribed_radius_; }
 
+  /** @brief Set by the inflation layer: a robot cell cost of at least
+   * inscribed_cost puts an obstacle within the inscribed radius, a cost
+   * below circumscribed_cost keeps obstacles and unknown space out of the
+   * circumscribed radius. A threshold of 0 means the costs do not tell. */
+  void setInflationThresholds(unsigned char inscribed_cost, unsigned char circumscribed_cost)
+  {
+    inscribed_cost_ = inscribed_cost;
+    circumscribed_cost_ = circumscribed_cost;
+  }
+
+  /** @brief The inscribed cost set with setInflationThresholds(), 0 if unknown. */
+  unsigned char getInscribedCost() { return inscribed_cost_; }
+
+  /** @brief The circumscribed cost set with setInflationThresholds(), 0 if unknown. */
+  unsigned char getCircumscribedCost() { return circumscribed_cost_; }
+
+  /** @brief Composite a finer rolling costmap over this one.
+   *
+   * Every updateMap() then updates the inner costmap first. The cells of this
+   * costmap under the inner window, and under the window of the previous
+   * update, are recomputed by the layers of this costmap, then each cell under
+   * the window gets the highest cost of the inner cells in it, unless the inner
+   * costmap knows none of them. Planners and publishers of this costmap so see
+   * what the inner costmap found near the robot, at the coarse resolution,
+   * getCompositeCost() gives it at the fine one. The inner costmap is not
+   * owned, NULL detaches it. */
+  void setInnerCostmap(LayeredCostmap* inner);
+
+  LayeredCostmap* getInnerCostmap()
+  {
+    return inner_;
+  }
+
+  /** @brief The cost at a point of the composite: of the inner costmap if it knows the cell, else of this one,
+   * NO_INFORMATION outside of both. Takes the locks of both grids. */
+  unsigned char getCompositeCost(double wx, double wy);
+
 private:
   void updateUsingPlugins(std::vector<boost::shared_ptr<Layer> > &plugins);
 
+  /** @brief Add the bounds of a layer to the dirty rectangles and grow the overall bounds by them */
+  void addBounds(double minx, double miny, double maxx, double maxy);
+
+  /** @brief Reduce suspended_bounds_ to the one rectangle around them */
+  void mergeSuspendedBounds();
+
+  /** @brief Merge the rectangles that overlap, or would not cover more cells merged */
+  static void mergeRegions(std::vector<MapRegion>& regions);
+
+  /** @brief The time a stage of the update starts, if the update is timed */
+  ros::WallTime startStage() const
+  {
+    return timing_enabled_ ? ros::WallTime::now() : ros::WallTime();
+  }
+
+  /** @brief Add the time since start to a stage of timing_, if the update is timed */
+  void endStage(double& stage, const ros::WallTime& start) const
+  {
+    if (timing_enabled_)
+      stage += (ros::WallTime::now() - start).toSec();
+  }
+
+  /** @brief Finish the timing of an update that started at update_start and make it the last one */
+  void recordTiming(const ros::WallTime& update_start);
+
+  /** @brief Give the cells under the inner window the highest known cost of the inner cells in them */
+  void poolInnerCostmap();
+
+  /** @brief Run updateCosts() of all layers on a region, runs of tileable layers band by band */
+  void updateCostsTiled(const MapRegion& region);
+
+  /** @brief Run updateBounds() of a batch of independent layers, concurrently if there are threads for it */
+  void updateBoundsConcurrently(std::vector<Layer*>& batch, unsigned int first_plugin, double robot_x, double robot_y,
+                                double robot_yaw);
+
+  /** @brief Worker of updateBoundsConcurrently(), takes layers of the batch until there are none left */
+  void updateBoundsWorker(std::vector<Layer*>* batch, unsigned int first_plugin, std::vector<double>* bounds,
+                          double robot_x, double robot_y, double robot_yaw);
+
   Costmap2D costmap_;
   std::string global_frame_;
 
@@ -165,13 +381,46 @@ private:
   bool current_;
   double minx_, miny_, maxx_, maxy_;
   unsigned int bx0_, bxn_, by0_, byn_;
+  std::vector<double> layer_bounds_; ///< @brief The bounds of the layers in this update, min_x, min_y, max_x, max_y
+  std::vector<MapRegion> regions_;
+
+  boost::mutex changed_mutex_;
+  std::vector<unsigned int> changed_; ///< @brief Per user, x0, xn, y0 and yn of the cells changed since its last takeChangedBounds()
+
+  /** @brief Grow the changed bounds by a rectangle of cells */
+  void addChangedBounds(unsigned int x0, unsigned int xn, unsigned int y0, unsigned int yn);
 
   std::vector<boost::shared_ptr<Layer> > plugins_;
 
   bool initialized_;
   bool size_locked_;
   double circumscribed_radius_, inscribed_radius_;
+  unsigned char inscribed_cost_, circumscribed_cost_;
   std::vector<geometry_msgs::Point> footprint_;
+
+  unsigned int update_threads_;
+  unsigned int tile_cells_; ///< @brief The cells of a band of tileable layers, 0 if not tiled
+
+  bool timing_enabled_;
+  UpdateTiming timing_; ///< @brief The timing of the update in progress
+  boost::mutex timing_mutex_;
+  UpdateTiming last_timing_; ///< @brief The timing of the last update, guarded by timing_mutex_
+  boost::mutex batch_mutex_;
+  unsigned int next_layer_; ///< @brief The next layer of the batch to be taken by a worker
+
+  boost::mutex request_mutex_;
+  boost::condition_variable request_condition_;
+  unsigned int update_requests_; ///< @brief The number of requestUpdate() calls since the last wait
+  unsigned int new_obstacles_; ///< @brief The cells reported by addNewObstacles() since the last take, under request_mutex_
+
+  bool costs_suspended_; ///< @brief Whether updateMap() only updates the layers, see setCostsSuspended()
+  std::vector<double> suspended_bounds_; ///< @brief min_x, min_y, max_x, max_y of the bounds reported while suspended
+
+  LayeredCostmap* inner_;
+  bool inner_pooled_; ///< @brief Whether the last update pooled the inner costmap, within inner_bounds_
+  double inner_bounds_[4]; ///< @brief min_x, min_y, max_x, max_y of the window pooled by the last update
+  std::vector<int> inner_pool_; ///< @brief Per cell under the window, the highest known inner cost or -1
+  std::vector<int> inner_columns_; ///< @brief Per inner column, the column of inner_pool_ it falls in or -1
 };
 }
 ;
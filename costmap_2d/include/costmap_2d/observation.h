@@ -35,6 +35,7 @@
 #include <geometry_msgs/Point.h>
 #include <pcl/point_types.h>
 #include <pcl/point_cloud.h>
+#include <boost/shared_ptr.hpp>
 
 namespace costmap_2d
 {
@@ -43,6 +44,8 @@ namespace costmap_2d
  * @brief Stores an observation in terms of a point cloud and the origin of the source
  * @note Tried to make members and constructor arguments const but the compiler would not accept the default
  * assignment operator for vector insertion!
+ *
+ * Copies of an observation share its cloud, the cloud of a buffered observation is not changed anymore.
  */
 class Observation
 {
@@ -51,13 +54,12 @@ public:
    * @brief  Creates an empty observation
    */
   Observation() :
-    cloud_(new pcl::PointCloud<pcl::PointXYZ>()), obstacle_range_(0.0), raytrace_range_(0.0)
+    cloud_(new pcl::PointCloud<pcl::PointXYZ>()), obstacle_range_(0.0), raytrace_range_(0.0), sector_angle_(0.0)
   {
   }
 
   virtual ~Observation()
   {
-    delete cloud_;
   }
 
   /**
@@ -69,17 +71,8 @@ public:
    */
   Observation(geometry_msgs::Point& origin, pcl::PointCloud<pcl::PointXYZ> cloud, double obstacle_range,
               double raytrace_range) :
-      origin_(origin), cloud_(new pcl::PointCloud<pcl::PointXYZ>(cloud)), obstacle_range_(obstacle_range), raytrace_range_(raytrace_range)
-  {
-  }
-
-  /**
-   * @brief  Copy constructor
-   * @param obs The observation to copy
-   */
-  Observation(const Observation& obs) :
-      origin_(obs.origin_), cloud_(new pcl::PointCloud<pcl::PointXYZ>(*(obs.cloud_))), obstacle_range_(obs.obstacle_range_), raytrace_range_(
-          obs.raytrace_range_)
+      origin_(origin), cloud_(new pcl::PointCloud<pcl::PointXYZ>(cloud)), obstacle_range_(obstacle_range), raytrace_range_(raytrace_range),
+      sector_angle_(0.0)
   {
   }
 
@@ -89,13 +82,19 @@ public:
    * @param obstacle_range The range out to which an observation should be able to insert obstacles
    */
   Observation(pcl::PointCloud<pcl::PointXYZ> cloud, double obstacle_range) :
-      cloud_(new pcl::PointCloud<pcl::PointXYZ>(cloud)), obstacle_range_(obstacle_range), raytrace_range_(0.0)
+      cloud_(new pcl::PointCloud<pcl::PointXYZ>(cloud)), obstacle_range_(obstacle_range), raytrace_range_(0.0), sector_angle_(0.0)
   {
   }
 
   geometry_msgs::Point origin_;
-  pcl::PointCloud<pcl::PointXYZ>* cloud_;
+  boost::shared_ptr<pcl::PointCloud<pcl::PointXYZ> > cloud_;
   double obstacle_range_, raytrace_range_;
+
+  /**
+   * The largest angle between consecutive points of an ordered planar scan that are cleared
+   * as one sector, 0 if the points are cleared one ray at a time
+   */
+  double sector_angle_;
 };
 
 }
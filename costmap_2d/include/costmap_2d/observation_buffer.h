@@ -37,8 +37,8 @@
 #ifndef COSTMAP_OBSERVATION_BUFFER_H_
 #define COSTMAP_OBSERVATION_BUFFER_H_
 
+#include <deque>
 #include <vector>
-#include <list>
 #include <string>
 #include <ros/time.h>
 #include <costmap_2d/observation.h>
@@ -48,6 +48,7 @@
 //PCL Stuff
 #include <pcl/point_cloud.h>
 #include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/LaserScan.h>
 
 // Thread support
 #include <boost/thread.hpp>
@@ -108,8 +109,56 @@ public:
    */
   void bufferCloud(const pcl::PointCloud<pcl::PointXYZ>& cloud);
 
+  /**
+   * @brief  Projects a LaserScan straight into the global frame and buffers it
+   *
+   * Beam directions are cached between scans with the same angles and beam count.
+   * <b>Note: The burden is on the user to make sure the transform is available... ie they should use a MessageNotifier</b>
+   * @param  scan The scan to be buffered, ranges outside [range_min, range_max) are dropped
+   * @param  inf_is_valid Whether positive infinite ranges mean nothing was seen within range_max
+   */
+  void bufferScan(const sensor_msgs::LaserScan& scan, bool inf_is_valid);
+
+  /**
+   * @brief  Buffers a cloud, right away or once its transform is needed, see setDeferredTransforms()
+   * @param  cloud The cloud to be buffered
+   */
+  void bufferCloud(const sensor_msgs::PointCloud2ConstPtr& cloud);
+
+  /**
+   * @brief  Buffers a scan, right away or once its transform is needed, see setDeferredTransforms()
+   * @param  scan The scan to be buffered
+   * @param  inf_is_valid Whether positive infinite ranges mean nothing was seen within range_max
+   */
+  void bufferScan(const sensor_msgs::LaserScanConstPtr& scan, bool inf_is_valid);
+
+  /**
+   * @brief  Keep the messages given as pointers in the frame of the sensor, and only transform them when
+   * getObservations() is called
+   *
+   * The callbacks then do not wait for tf, so the messages need no tf::MessageFilter in front of the
+   * buffer. Messages whose transform is not there yet stay queued until it is, for at most the larger of
+   * the tf tolerance and the observation persistence.
+   * @param  deferred Whether to defer the transforms
+   */
+  void setDeferredTransforms(bool deferred)
+  {
+    deferred_transforms_ = deferred;
+  }
+
+  /**
+   * @brief  Mark the observations of this buffer as ordered planar scans
+   * @param  sector_angle The largest angle between consecutive points that are cleared as one sector, 0 to disable
+   */
+  void setSectorAngle(double sector_angle)
+  {
+    sector_angle_ = sector_angle;
+  }
+
   /**
    * @brief  Pushes copies of all current observations onto the end of the vector passed in
+   *
+   * The copies share the clouds with the buffer, no points are copied.
    * @param  observations The vector to be filled
    */
   void getObservations(std::vector<Observation>& observations);
@@ -143,22 +192,60 @@ public:
 
 private:
   /**
-   * @brief  Removes any stale observations from the buffer list
+   * @brief  Removes any stale observations from the buffer list, from the oldest one on until one is fresh
    */
   void purgeStaleObservations();
 
+  /** @brief  Bound the deferred messages after one was queued */
+  void deferMessage();
+
+  /** @brief  Buffer the deferred messages in the order they arrived, as far as their transforms are available */
+  void transformPending();
+
+  /**
+   * @brief  Take a slot in front of the newest observation, its cloud is empty
+   *
+   * The cloud of the slot is reused if no copy of the observation that last used the slot is around anymore.
+   */
+  Observation& pushObservation();
+
+  /** @brief  Give up the newest observation */
+  void popObservation();
+
+  /** @brief  The i-th newest observation */
+  Observation& getObservation(unsigned int i)
+  {
+    return observations_[(first_observation_ + i) % observations_.size()];
+  }
+
   tf::TransformListener& tf_;
   const ros::Duration observation_keep_time_;
   const ros::Duration expected_update_rate_;
   ros::Time last_updated_;
   std::string global_frame_;
   std::string sensor_frame_;
-  std::list<Observation> observation_list_;
+  std::vector<Observation> observations_; ///< @brief A ring of slots, the newest observation first
+  unsigned int first_observation_, observation_count_;
   std::string topic_name_;
   double min_obstacle_height_, max_obstacle_height_;
   boost::recursive_mutex lock_; ///< @brief A lock for accessing data in callbacks safely
   double obstacle_range_, raytrace_range_;
+  double sector_angle_;
   double tf_tolerance_;
+
+  /** @brief A message waiting for its transform, either a cloud or a scan */
+  struct PendingMessage
+  {
+    sensor_msgs::PointCloud2ConstPtr cloud;
+    sensor_msgs::LaserScanConstPtr scan;
+    bool inf_is_valid;
+  };
+
+  bool deferred_transforms_;
+  std::deque<PendingMessage> pending_; ///< @brief The deferred messages, oldest first
+
+  std::vector<double> scan_cos_, scan_sin_; ///< @brief Beam directions of the last scan
+  double scan_angle_min_, scan_angle_increment_;
 };
 }
 #endif
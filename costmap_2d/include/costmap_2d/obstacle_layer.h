@@ -38,6 +38,7 @@
 #ifndef OBSTACLE_COSTMAP_PLUGIN_H_
 #define OBSTACLE_COSTMAP_PLUGIN_H_
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 #include <costmap_2d/costmap_layer.h>
 #include <costmap_2d/layered_costmap.h>
 #include <costmap_2d/observation_buffer.h>
@@ -54,13 +55,17 @@
 #include <dynamic_reconfigure/server.h>
 #include <costmap_2d/ObstaclePluginConfig.h>
 #include <costmap_2d/footprint_layer.h>
+#include <costmap_2d/cell_decay_tracker.h>
 
 namespace costmap_2d
 {
 class ObstacleLayer : public CostmapLayer
 {
 public:
-  ObstacleLayer()
+  ObstacleLayer() :
+      free_to_default_time_(-1.0), occupied_to_default_time_(-1.0), free_decay_(FREE_SPACE),
+      occupied_decay_(LETHAL_OBSTACLE), pass_(0), raytrace_threads_(1),
+      footprint_clearing_in_costs_(true), full_range_clearing_(false)
   {
     costmap_ = NULL; // this is the unsigned char* member of parent class Costmap2D.
   }
@@ -70,10 +75,22 @@ public:
   virtual void updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y, double* max_x,
                              double* max_y);
   virtual void updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
+  virtual bool isBoundsIndependent() const
+  {
+    return true;
+  }
+  virtual bool isTileable() const
+  {
+    return true;
+  }
+  virtual void prepareTiles(int min_i, int min_j, int max_i, int max_j);
+  virtual void updateTile(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
 
   virtual void activate();
   virtual void deactivate();
   virtual void reset();
+  virtual void matchSize();
+  virtual void updateOrigin(double new_origin_x, double new_origin_y);
 
   /**
    * @brief  A callback to handle buffering LaserScan messages
@@ -107,16 +124,131 @@ public:
   void pointCloud2Callback(const sensor_msgs::PointCloud2ConstPtr& message,
                            const boost::shared_ptr<costmap_2d::ObservationBuffer>& buffer);
 
+  /**
+   * @brief  Ask the next update to raytrace the latest clearing observations out to the full length of
+   * their rays, whatever their raytrace range, so that only space the sensors see free is cleared
+   * @return False if the layer is disabled and would not do it
+   */
+  bool requestFullRangeClearing();
+
+  /**
+   * @brief  Whether a full range clearing was requested and has not been done by an update yet
+   */
+  bool isFullRangeClearingPending();
+
   // for testing purposes
   void addStaticObservation(costmap_2d::Observation& obs, bool marking, bool clearing);
   void clearStaticObservations(bool marking, bool clearing);
 
 protected:
 
+  /**
+   * @brief  Reset the free and occupied cells that have not been updated for too long to NO_INFORMATION
+   */
   void checkTimeStamps(double* min_x, double* min_y, double* max_x, double* max_y);
   double free_to_default_time_;
   double occupied_to_default_time_;
 
+  /**
+   * @brief  Queue the cells covered by the footprint, which the footprint layer just cleared
+   */
+  void trackFootprintCells(double stamp);
+
+  CellDecayTracker free_decay_; ///< @brief Tracks the free cells for free_to_default_time_
+  CellDecayTracker occupied_decay_; ///< @brief Tracks the lethal cells for occupied_to_default_time_
+  std::vector<unsigned int> expired_cells_;
+
+  /**
+   * @brief  Functor that marks a cell like MarkCell and queues it in a decay tracker
+   */
+  class TrackedMarkCell
+  {
+  public:
+    TrackedMarkCell(unsigned char* costmap, CellTimeStamps& timestamps, unsigned char value, double time,
+                    CellDecayTracker& tracker) :
+        marker_(costmap, timestamps, value, time), tracker_(tracker), time_(time)
+    {
+    }
+    inline void operator()(unsigned int offset)
+    {
+      marker_(offset);
+      tracker_.push(offset, time_);
+    }
+  private:
+    MarkCell marker_;
+    CellDecayTracker& tracker_;
+    double time_;
+  };
+
+  /**
+   * @brief  Applies an action to the cells a ray passes that were not visited in the current pass yet
+   */
+  template<class ActionType>
+  class MarkUnvisitedCell
+  {
+  public:
+    MarkUnvisitedCell(ObstacleLayer& layer, ActionType& action) :
+        layer_(layer), action_(action)
+    {
+    }
+    inline void operator()(unsigned int offset)
+    {
+      if (layer_.firstVisit(offset))
+        action_(offset);
+    }
+  private:
+    ObstacleLayer& layer_;
+    ActionType& action_;
+  };
+
+  /** @brief A ray of a clearing observation in map coordinates */
+  struct ClearingRay
+  {
+    unsigned int x0, y0, x1, y1, max_length;
+  };
+
+  /**
+   * @brief  Clears the cells of a ray with an index in [begin, end), optionally collecting them for the decay tracker
+   */
+  class ClearCellInBand
+  {
+  public:
+    ClearCellInBand(unsigned char* costmap, CellTimeStamps& timestamps, uint32_t tick, unsigned int begin,
+                    unsigned int end, std::vector<unsigned int>* cleared) :
+        costmap_(costmap), timestamps_(timestamps), tick_(tick), begin_(begin), end_(end), cleared_(cleared)
+    {
+    }
+    inline void operator()(unsigned int offset)
+    {
+      if (offset < begin_ || offset >= end_)
+        return;
+      costmap_[offset] = FREE_SPACE;
+      timestamps_.setEncoded(offset, tick_);
+      if (cleared_)
+        cleared_->push_back(offset);
+    }
+  private:
+    unsigned char* costmap_;
+    CellTimeStamps& timestamps_;
+    uint32_t tick_;
+    unsigned int begin_, end_;
+    std::vector<unsigned int>* cleared_;
+  };
+
+  /** @brief The cells a share of the marking points falls into and the world bounds of those points */
+  struct MarkBatch
+  {
+    std::vector<unsigned int> cells;
+    double min_x, min_y, max_x, max_y;
+  };
+
+  /** @brief The end of a ray of a planar scan in map coordinates, see raytraceFreespace() */
+  struct SectorPoint
+  {
+    double x, y, angle;
+    unsigned int cell_x, cell_y;
+  };
+
   virtual void setupDynamicReconfigure(ros::NodeHandle& nh);
 
   /**
@@ -147,6 +279,88 @@ protected:
   void updateRaytraceBounds(double ox, double oy, double wx, double wy, double range, double* min_x, double* min_y,
 			    double* max_x, double* max_y);
 
+  /**
+   * @brief  Clip a ray from the origin of a sensor to the map
+   * @param ox The x origin of the ray in world coordinates
+   * @param oy The y origin of the ray in world coordinates
+   * @param wx The x end of the ray in world coordinates, moved onto the map if needed
+   * @param wy The y end of the ray in world coordinates, moved onto the map if needed
+   * @param x1 Will be set to the x map coordinate of the end
+   * @param y1 Will be set to the y map coordinate of the end
+   * @return False if the end could not be moved onto the map
+   */
+  bool clipRayEnd(double ox, double oy, double& wx, double& wy, unsigned int& x1, unsigned int& y1) const;
+
+  /**
+   * @brief  Clip the rays of a clearing observation to the map and append them to a list, see raytraceFreespace()
+   */
+  void collectClearingRays(const costmap_2d::Observation& clearing_observation, std::vector<ClearingRay>& rays,
+                           double* min_x, double* min_y, double* max_x, double* max_y);
+
+  /**
+   * @brief  Clear the space of all clearing observations with raytrace_threads_ threads
+   *
+   * Every thread walks the rays passing its band of rows and only writes cells inside the band, so each
+   * cell gets the same writes in the same order as with one thread.
+   */
+  void raytraceFreespaceParallel(const std::vector<costmap_2d::Observation>& clearing_observations, double* min_x,
+                                 double* min_y, double* max_x, double* max_y);
+
+  /**
+   * @brief  Clear the cells of the rows [first_row, end_row) that lie on the given rays
+   * @param cleared If not NULL, the indices of the cleared cells are appended to it
+   */
+  void raytraceBand(const std::vector<ClearingRay>& rays, uint32_t tick, unsigned int first_row,
+                    unsigned int end_row, std::vector<unsigned int>* cleared);
+
+  /**
+   * @brief  Mark the points of the marking observations as lethal obstacles
+   *
+   * The points are filtered and converted to cells by raytrace_threads_ threads, each taking a
+   * consecutive share of them. The cells are then marked on this thread in the order of the points,
+   * so the result is the same as with one thread.
+   */
+  void markObstacles(const std::vector<costmap_2d::Observation>& observations, double mark_time, double* min_x,
+                     double* min_y, double* max_x, double* max_y);
+
+  /**
+   * @brief  Collect the cells of the marking points with a position in [first, end) of all points of the observations
+   */
+  void collectMarks(const std::vector<costmap_2d::Observation>* observations, unsigned int first, unsigned int end,
+                    MarkBatch* batch) const;
+
+  /**
+   * @brief  Clear the cells whose centers lie in a triangle, given in map coordinates
+   *
+   * Used for the wedge between two consecutive beams of a planar scan, cells visited before in the
+   * current pass are skipped.
+   */
+  void fillSector(TrackedMarkCell& marker, double x0, double y0, double x1, double y1, double x2, double y2);
+
+  /**
+   * @brief  Start a new pass of firstVisit(), all cells count as unvisited afterwards
+   */
+  void beginCellPass();
+
+  /**
+   * @brief  Whether a cell is visited for the first time in this pass
+   *
+   * Used to handle the many points of dense clouds that fall into the same cell only once.
+   */
+  inline bool firstVisit(unsigned int index)
+  {
+    if (cell_pass_[index] == pass_)
+      return false;
+    cell_pass_[index] = pass_;
+    return true;
+  }
+
+  std::vector<unsigned char> cell_pass_; ///< @brief The last pass that visited each cell
+  unsigned char pass_;
+
+  unsigned int raytrace_threads_; ///< @brief The number of threads used to raytrace, 1 traces on the update thread
+  std::vector<MarkBatch> mark_batches_; ///< @brief The marking work of each thread, kept to reuse its memory
+
   /** @brief Overridden from superclass Layer to pass new footprint into footprint_layer_. */
   virtual void onFootprintChanged();
 
@@ -155,6 +369,8 @@ protected:
 
   laser_geometry::LaserProjection projector_; ///< @brief Used to project laser scans into point clouds
 
+  std::vector<boost::shared_ptr<ros::CallbackQueue> > observation_queues_; ///< @brief Callback queues of the sources that do not use the global one
+  std::vector<boost::shared_ptr<ros::AsyncSpinner> > observation_spinners_; ///< @brief Threads serving observation_queues_
   std::vector<boost::shared_ptr<message_filters::SubscriberBase> > observation_subscribers_; ///< @brief Used for the observation message filters
   std::vector<boost::shared_ptr<tf::MessageFilterBase> > observation_notifiers_; ///< @brief Used to make sure that transforms are available for each sensor
   std::vector<boost::shared_ptr<costmap_2d::ObservationBuffer> > observation_buffers_; ///< @brief Used to store observations from various sensors
@@ -168,9 +384,13 @@ protected:
   dynamic_reconfigure::Server<costmap_2d::ObstaclePluginConfig> *dsrv_;
 
   FootprintLayer footprint_layer_; ///< @brief clears the footprint in this obstacle layer.
+  bool footprint_clearing_in_costs_; ///< @brief Whether updateCosts() clears the footprint before merging
   
   int combination_method_;
 
+  boost::mutex full_range_mutex_;
+  bool full_range_clearing_; ///< @brief Whether the next update raytraces without the raytrace range
+
 private:
   void reconfigureCB(costmap_2d::ObstaclePluginConfig &config, uint32_t level);
 };
@@ -0,0 +1,141 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_RING_BUFFER_H_
+#define COSTMAP_RING_BUFFER_H_
+
+#include <algorithm>
+#include <vector>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace costmap_2d
+{
+
+/**
+ * @class RingBuffer
+ * @brief A bounded queue between one producing and one consuming thread that overwrites its oldest entry when full.
+ *
+ * A slow consumer therefore always works on the newest entries, and the
+ * producer never waits for it.
+ */
+template <class T>
+class RingBuffer
+{
+public:
+  /** @param  capacity The number of entries kept, at least one */
+  explicit RingBuffer(unsigned int capacity = 1) :
+      entries_(capacity > 0 ? capacity : 1), begin_(0), size_(0), dropped_(0)
+  {
+  }
+
+  /**
+   * @brief  Add an entry, dropping the oldest one if the buffer is full
+   * @return False if an entry was dropped
+   */
+  bool push(const T& entry)
+  {
+    bool kept = true;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (size_ == entries_.size())
+      {
+        begin_ = (begin_ + 1) % entries_.size();
+        --size_;
+        ++dropped_;
+        kept = false;
+      }
+      entries_[(begin_ + size_) % entries_.size()] = entry;
+      ++size_;
+    }
+    not_empty_.notify_one();
+    return kept;
+  }
+
+  /**
+   * @brief  Take the oldest entry, waiting up to timeout_ms for one to arrive
+   * @return False if the buffer was still empty
+   */
+  bool pop(T& entry, unsigned int timeout_ms = 0)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (size_ == 0 && timeout_ms > 0)
+      not_empty_.timed_wait(lock, boost::posix_time::milliseconds(timeout_ms));
+    if (size_ == 0)
+      return false;
+
+    // swap instead of copy, entries such as images or clouds can be large
+    std::swap(entry, entries_[begin_]);
+    entries_[begin_] = T();
+    begin_ = (begin_ + 1) % entries_.size();
+    --size_;
+    return true;
+  }
+
+  /** @brief  Drop every entry and keep up to capacity entries from now on */
+  void reset(unsigned int capacity)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    entries_.assign(capacity > 0 ? capacity : 1, T());
+    begin_ = size_ = 0;
+  }
+
+  unsigned int size() const
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return size_;
+  }
+
+  unsigned int capacity() const
+  {
+    return entries_.size();
+  }
+
+  /** @brief  The number of entries overwritten before they were taken */
+  unsigned int dropped() const
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return dropped_;
+  }
+
+private:
+  mutable boost::mutex mutex_;
+  boost::condition_variable not_empty_;
+  std::vector<T> entries_;
+  unsigned int begin_, size_, dropped_;
+};
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_RING_BUFFER_H_
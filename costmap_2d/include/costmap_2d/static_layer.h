@@ -40,11 +40,15 @@
 #include <ros/ros.h>
 #include <costmap_2d/costmap_layer.h>
 #include <costmap_2d/layered_costmap.h>
+#include <costmap_2d/static_map_cache.h>
 #include <costmap_2d/GenericPluginConfig.h>
 #include <dynamic_reconfigure/server.h>
 #include <nav_msgs/OccupancyGrid.h>
+#include <nav_msgs/MapMetaData.h>
 #include <map_msgs/OccupancyGridUpdate.h>
 #include <message_filters/subscriber.h>
+#include <list>
+#include <utility>
 
 namespace costmap_2d
 {
@@ -61,6 +65,17 @@ public:
   virtual void updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y, double* max_x,
                              double* max_y);
   virtual void updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
+  virtual bool isBoundsIndependent() const
+  {
+    return true;
+  }
+  virtual bool isTileable() const
+  {
+    return true;
+  }
+
+  /** @brief The layer keeps no grid of the size of the master, its costs are in grid_ */
+  virtual void matchSize() {}
 
 private:
   /**
@@ -71,21 +86,45 @@ private:
    */
   void incomingMap(const nav_msgs::OccupancyGridConstPtr& new_map);
   void incomingUpdate(const map_msgs::OccupancyGridUpdateConstPtr& update);
+
+  /** @brief Read the map from map_segment_ once the map metadata announces it */
+  void incomingMetaData(const nav_msgs::MapMetaDataConstPtr& meta_data);
   void reconfigureCB(costmap_2d::GenericPluginConfig &config, uint32_t level);
 
   unsigned char interpretValue(unsigned char value);
 
+  /** @brief Fill cost_lut_ with interpretValue() of every map value, needed after the parameters change */
+  void updateCostLut();
+
+  /** @brief Make grid_ a copy only this layer holds, so it can be changed by map updates */
+  StaticGrid& writableGrid();
+
+  /** @brief Keep grid_ in map_cache_ before it is replaced by the grid of another map. Called with lock_ held. */
+  void cacheGrid();
+
+  /** @brief Take the grid of a map seen before out of map_cache_, an empty pointer if it is not there.
+   * Called with lock_ held. */
+  StaticGridConstPtr takeCachedGrid(const nav_msgs::MapMetaData& info);
+
   std::string global_frame_; ///< @brief The global frame for the costmap
   bool subscribe_to_updates_;
+  std::string map_segment_; ///< @brief The shared memory segment the map is read from instead of the map topic
   bool map_received_;
   bool has_updated_data_;
   unsigned int x_,y_,width_,height_;
   bool track_unknown_space_;
   bool use_maximum_;
+  double resolution_; ///< @brief The resolution of the master grid if coarser than the map, 0 for that of the map
   bool trinary_costmap_;
   ros::Subscriber map_sub_, map_update_sub_;
 
   unsigned char lethal_threshold_, unknown_cost_value_;
+  unsigned char cost_lut_[256]; ///< @brief The cost of every value of the incoming map
+  StaticGridConstPtr grid_; ///< @brief The costs of the map, shared with the static layers of other costmaps
+  boost::shared_ptr<StaticGrid> own_grid_; ///< @brief Same as grid_ once a map update made it a private copy
+  ros::Time map_load_time_; ///< @brief The load time of the map of grid_
+  int map_cache_size_; ///< @brief How many grids of replaced maps are kept for when the map server switches back
+  std::list<std::pair<ros::Time, StaticGridConstPtr> > map_cache_; ///< @brief Most recently replaced first
 
   mutable boost::recursive_mutex lock_;
   dynamic_reconfigure::Server<costmap_2d::GenericPluginConfig> *dsrv_;
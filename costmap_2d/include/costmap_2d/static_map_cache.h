@@ -0,0 +1,102 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_STATIC_MAP_CACHE_H_
+#define COSTMAP_STATIC_MAP_CACHE_H_
+
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <nav_msgs/OccupancyGrid.h>
+
+namespace costmap_2d
+{
+
+/**
+ * @class StaticGrid
+ * @brief The costs of a static map together with its geometry
+ */
+class StaticGrid
+{
+public:
+  StaticGrid() : size_x(0), size_y(0), resolution(0.0), origin_x(0.0), origin_y(0.0) {}
+
+  /** @brief Convert world coordinates to the cell they fall into, false if outside of the grid */
+  bool worldToMap(double wx, double wy, unsigned int& mx, unsigned int& my) const;
+
+  /** @brief The highest known cost of the cells within half_cell of a point, NO_INFORMATION if none is known.
+   * A coarser grid samples with it so that a wall thinner than its cells is not missed. */
+  unsigned char pooledCost(double wx, double wy, double half_cell) const;
+
+  /** @brief Whether the grid covers exactly the same cells as another one */
+  bool sameGeometry(unsigned int other_size_x, unsigned int other_size_y, double other_resolution,
+                    double other_origin_x, double other_origin_y) const
+  {
+    return size_x == other_size_x && size_y == other_size_y && resolution == other_resolution
+        && origin_x == other_origin_x && origin_y == other_origin_y;
+  }
+
+  unsigned int size_x, size_y;
+  double resolution, origin_x, origin_y;
+  std::vector<unsigned char> costs;  ///< @brief Row major, like the costs of a Costmap2D
+};
+
+typedef boost::shared_ptr<const StaticGrid> StaticGridConstPtr;
+
+/**
+ * @brief  Convert a map to costs, sharing the result with every other caller in the process that converts
+ * the same map message with the same lookup table
+ *
+ * Every costmap of a node subscribes to the map topic, and roscpp hands all of them the same message, so
+ * the converted grid is only built and held once as long as any of them keeps it.
+ * @param  map The map message
+ * @param  cost_lut The cost of each of the 256 values of the map
+ * @return The converted grid, never to be modified
+ */
+StaticGridConstPtr convertStaticMap(const nav_msgs::OccupancyGridConstPtr& map, const unsigned char* cost_lut);
+
+/**
+ * @brief  Get the map a map_server on this host wrote to a shared memory segment
+ *
+ * Callers in the same process asking for the same segment and load time get the same message, so
+ * convertStaticMap() shares its conversion among them as for messages received on a topic.
+ * @param  segment The name of the segment, the ~map_segment parameter of the map_server
+ * @param  load_time The load time of the map, from the map metadata
+ * @return The map, or an empty pointer if the segment does not hold that map
+ */
+nav_msgs::OccupancyGridConstPtr readStaticMapSegment(const std::string& segment, const ros::Time& load_time);
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_STATIC_MAP_CACHE_H_
@@ -42,6 +42,7 @@
 #include <costmap_2d/layered_costmap.h>
 #include <costmap_2d/observation_buffer.h>
 #include <costmap_2d/VoxelGrid.h>
+#include <costmap_2d/VoxelGridUpdate.h>
 #include <nav_msgs/OccupancyGrid.h>
 #include <sensor_msgs/LaserScan.h>
 #include <laser_geometry/laser_geometry.h>
@@ -61,7 +62,9 @@ class VoxelLayer : public ObstacleLayer
 {
 public:
   VoxelLayer() :
-      voxel_grid_(0, 0, 0)
+      voxel_grid_(0, 0, 0), publish_voxel_updates_(false), voxel_keyframe_interval_(50), voxel_frames_since_keyframe_(0),
+      voxel_frame_(0), voxel_sent_origin_x_(0.0), voxel_sent_origin_y_(0.0), voxel_dirty_min_x_(1e30),
+      voxel_dirty_min_y_(1e30), voxel_dirty_max_x_(-1e30), voxel_dirty_max_y_(-1e30)
   {
     costmap_ = NULL; // this is the unsigned char* member of parent class's parent class Costmap2D.
   }
@@ -84,19 +87,64 @@ public:
 protected:
   virtual void setupDynamicReconfigure(ros::NodeHandle& nh);
 
+  voxel_grid::VoxelGrid voxel_grid_;
+
 private:
   void reconfigureCB(costmap_2d::VoxelPluginConfig &config, uint32_t level);
   void clearNonLethal(double wx, double wy, double w_size_x, double w_size_y, bool clear_no_info);
   virtual void raytraceFreespace(const costmap_2d::Observation& clearing_observation, double* min_x, double* min_y,
                                  double* max_x, double* max_y);
 
+  /** @brief A ray of a clearing observation in voxel coordinates */
+  struct VoxelRay
+  {
+    double x0, y0, z0, x1, y1, z1;
+    unsigned int max_length;
+  };
+
+  /**
+   * @brief  Clip the rays of a clearing observation to the grid and append them to a list
+   */
+  void collectVoxelRays(const costmap_2d::Observation& clearing_observation, std::vector<VoxelRay>& rays,
+                        double* min_x, double* min_y, double* max_x, double* max_y);
+
+  /**
+   * @brief  Clear the voxels on the given rays that lie in the rows [first_row, end_row) of the grid
+   *
+   * Threads owning disjoint bands of rows can clear the same rays at once, each column sees the same
+   * updates in the same order as with one thread. The costs of the columns the rays crossed are written
+   * after all rays were walked, once per column.
+   */
+  void clearVoxelRays(const std::vector<VoxelRay>& rays, unsigned int first_row, unsigned int end_row);
+
   dynamic_reconfigure::Server<costmap_2d::VoxelPluginConfig> *dsrv_;
 
+  /**
+   * @brief  Publish the columns within the given bounds as a delta against the previous update
+   *
+   * Columns changed outside of updateBounds(), see markVoxelsDirty(), are sent as well. Every
+   * voxel_keyframe_interval_ updates, and whenever the grid changes size or is reset, the whole grid is sent instead.
+   */
+  void publishVoxelUpdate(double min_x, double min_y, double max_x, double max_y);
+
+  /**
+   * @brief  Include a region that changed outside of updateBounds() in the next voxel update
+   */
+  void markVoxelsDirty(double min_x, double min_y, double max_x, double max_y);
+
   bool publish_voxel_;
   ros::Publisher voxel_pub_;
-  voxel_grid::VoxelGrid voxel_grid_;
+  bool publish_voxel_updates_;
+  ros::Publisher voxel_updates_pub_;
+  int voxel_keyframe_interval_, voxel_frames_since_keyframe_;
+  uint32_t voxel_frame_;
+  std::vector<uint32_t> voxel_sent_; ///< @brief The columns of the whole grid as the update subscribers know them
+  std::vector<uint32_t> voxel_region_, voxel_encoded_;
+  double voxel_sent_origin_x_, voxel_sent_origin_y_;
+  double voxel_dirty_min_x_, voxel_dirty_min_y_, voxel_dirty_max_x_, voxel_dirty_max_y_;
   double z_resolution_, origin_z_;
   unsigned int unknown_threshold_, mark_threshold_, size_z_;
+  std::vector<unsigned char> column_mask_; ///< @brief The columns crossed by the rays being cleared, zero otherwise
   ros::Publisher clearing_endpoints_pub_;
   sensor_msgs::PointCloud clearing_endpoints_;
 
@@ -1,4 +1,5 @@
 #include "costmap_2d/depth_3d_integrator.h"
+#include "costmap_2d/executor.h"
 
 #include <rgbd/Image.h>
 #include <rgbd/View.h>
@@ -7,6 +8,12 @@
 
 #include <geolib/ros/tf_conversions.h>
 
+#include <ros/console.h>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+
 // ----------------------------------------------------------------------------------------------------
 
 // Decomposes 'pose' into a (X, Y, YAW) and (Z, ROLL, PITCH) component
@@ -26,7 +33,8 @@ void decomposePose(const geo::Pose3D& pose, geo::Pose3D& pose_xya, geo::Pose3D&
 
 // ----------------------------------------------------------------------------------------------------
 
-Depth3DIntegrator::Depth3DIntegrator() : initialized_(false)
+Depth3DIntegrator::Depth3DIntegrator() : initialized_(false), threaded_(false), num_threads_(1), receiver_(0),
+    worker_(0), has_new_cloud_(false)
 {
 }
 
@@ -34,11 +42,25 @@ Depth3DIntegrator::Depth3DIntegrator() : initialized_(false)
 
 Depth3DIntegrator::~Depth3DIntegrator()
 {
+    if (receiver_)
+    {
+        receiver_->interrupt();
+        receiver_->join();
+        delete receiver_;
+    }
+
+    if (worker_)
+    {
+        worker_->interrupt();
+        worker_->join();
+        delete worker_;
+    }
 }
 
 // ----------------------------------------------------------------------------------------------------
 
-bool Depth3DIntegrator::initialize(const std::string& rgbd_topic, const std::string& map_frame)
+bool Depth3DIntegrator::initialize(const std::string& rgbd_topic, const std::string& map_frame,
+                                   const ros::NodeHandle& nh)
 {
     image_buffer_.initialize(rgbd_topic);
 
@@ -50,8 +72,21 @@ bool Depth3DIntegrator::initialize(const std::string& rgbd_topic, const std::str
 
     map_frame_ = map_frame;
 
+    int num_threads, depth_buffer_size;
+    nh.param("threaded", threaded_, false);
+    nh.param("num_threads", num_threads, 1);
+    nh.param("depth_buffer_size", depth_buffer_size, 2);
+    num_threads_ = std::max(1, num_threads);
+
     initialized_ = true;
 
+    if (threaded_ && !worker_)
+    {
+        depth_buffer_.reset(std::max(1, depth_buffer_size));
+        receiver_ = new boost::thread(boost::bind(&Depth3DIntegrator::receiveLoop, this));
+        worker_ = new boost::thread(boost::bind(&Depth3DIntegrator::workerLoop, this));
+    }
+
     return true;
 }
 
@@ -64,7 +99,17 @@ bool Depth3DIntegrator::update(pcl::PointCloud<pcl::PointXYZ>& cloud)
 
     cloud.clear();
 
-    bool visualize = false;
+    if (threaded_)
+    {
+        // Hand out the latest result of the worker, never wait for it
+        boost::mutex::scoped_lock lock(cloud_mutex_);
+        if (!has_new_cloud_)
+            return false;
+
+        cloud.swap(latest_cloud_);
+        has_new_cloud_ = false;
+        return true;
+    }
 
     rgbd::ImageConstPtr image;
 
@@ -72,12 +117,76 @@ bool Depth3DIntegrator::update(pcl::PointCloud<pcl::PointXYZ>& cloud)
     if (!image_buffer_.nextImage(map_frame_, image, sensor_pose))
         return false;
 
+    return processImage(image, sensor_pose, cloud);
+}
+
+// ----------------------------------------------------------------------------------------------------
+
+void Depth3DIntegrator::receiveLoop()
+{
+    while (!boost::this_thread::interruption_requested())
+    {
+        DepthFrame frame;
+        if (!image_buffer_.nextImage(map_frame_, frame.image, frame.sensor_pose))
+        {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+            continue;
+        }
+
+        // Receiving never waits for the worker, a full buffer drops its oldest image
+        if (!depth_buffer_.push(frame))
+            ROS_DEBUG_THROTTLE(5.0, "Depth3DIntegrator dropped %u depth images", depth_buffer_.dropped());
+    }
+}
+
+// ----------------------------------------------------------------------------------------------------
+
+void Depth3DIntegrator::workerLoop()
+{
+    pcl::PointCloud<pcl::PointXYZ> cloud;
+    while (!boost::this_thread::interruption_requested())
+    {
+        DepthFrame frame;
+        if (!depth_buffer_.pop(frame, 5))
+            continue;
+
+        processImage(frame.image, frame.sensor_pose, cloud);
+
+        // A result that was not handed out yet is replaced, the layer only wants the latest one
+        boost::mutex::scoped_lock lock(cloud_mutex_);
+        latest_cloud_.swap(cloud);
+        has_new_cloud_ = true;
+    }
+}
+
+// ----------------------------------------------------------------------------------------------------
+
+bool Depth3DIntegrator::processImage(const rgbd::ImageConstPtr& image, const geo::Pose3D& sensor_pose,
+                                     pcl::PointCloud<pcl::PointXYZ>& cloud)
+{
+    cloud.clear();
+
+    bool visualize = false;
+
     // - - - - - - - - - - - - - - - - - - - - - - -
 
     geo::Pose3D sensor_pose_xya;
     geo::Pose3D sensor_pose_zrp;
     decomposePose(sensor_pose, sensor_pose_xya, sensor_pose_zrp);
 
+    // The columns of the rotation are the images of the axes
+    geo::Vec3 axes[3] = { sensor_pose_zrp.R * geo::Vec3(1, 0, 0), sensor_pose_zrp.R * geo::Vec3(0, 1, 0),
+                          sensor_pose_zrp.R * geo::Vec3(0, 0, 1) };
+    double rotation[9], translation[3] = { sensor_pose_zrp.t.x, sensor_pose_zrp.t.y, sensor_pose_zrp.t.z };
+    for(int j = 0; j < 3; ++j)
+    {
+        rotation[j] = axes[j].x;
+        rotation[3 + j] = axes[j].y;
+        rotation[6 + j] = axes[j].z;
+    }
+    kernel_.setPose(rotation, translation);
+    kernel_.setParameters(slope_window_size_, slope_threshold_, 0.2);
+
     // - - - - - - - - - - - - - - - - - - - - - - -
 
     cv::Mat depth = image->getDepthImage();
@@ -85,109 +194,55 @@ bool Depth3DIntegrator::update(pcl::PointCloud<pcl::PointXYZ>& cloud)
     int width = depth.cols;
     int height = depth.rows;
 
+    // The rays are only recomputed when the camera model changes
     rgbd::View view(*image, width);
-    const geo::DepthCamera& rasterizer = view.getRasterizer();
+    kernel_.setCamera(view.getRasterizer(), width, height);
+
+    ColumnTask task;
+    task.rows.resize(height);
+    for(int y = 0; y < height; ++y)
+        task.rows[y] = depth.ptr<float>(y);
 
     cv::Mat obstacle_map, bla;
+    task.obstacle_map = 0;
+    task.slope_img = 0;
     if (visualize)
     {
         obstacle_map = cv::Mat(500, 500, CV_32FC1, 0.0);
         bla = depth.clone();
+        task.obstacle_map = &obstacle_map;
+        task.slope_img = &bla;
     }
 
-    cv::Mat buffer(height, 1, CV_64FC4, 0.0);
-    std::vector<geo::Vector3> p_floors(height);
-
     double x_step = 1;
     if (num_samples_ > 0 && num_samples_ < depth.cols)
         x_step = (double)depth.cols / num_samples_;
 
     for(double x = 0; x < width; x += x_step)
-    {
-        geo::Vector3 p_floor_closest(1e6, 1e6, 0);
-
-        buffer.at<cv::Vec4d>(0, 0) = cv::Vec4d(0, 0, 0, 0);
-
-        for(int y = 1; y < height; ++y)
-        {
-            float d = depth.at<float>(y, x);
-            if (d == 0 || d != d)
-            {
-                buffer.at<cv::Vec4d>(y, 0) = buffer.at<cv::Vec4d>(y - 1, 0);
-                continue;
-            }
+        task.columns.push_back((int)x);
 
-            geo::Vector3 p_sensor = rasterizer.project2Dto3D(x, y) * d;
-            p_floors[y] = sensor_pose_zrp * p_sensor;
-            const geo::Vector3& p_floor = p_floors[y];
-
-            if (p_floor.z > 0.2)
-            {
-                if (p_floor.y < p_floor_closest.y)
-                    p_floor_closest = p_floor;
-
-                if (visualize)
-                {
-                    cv::Point2i p(p_floor.x * 50 + obstacle_map.rows / 2,
-                                  obstacle_map.cols / 2 - p_floor.y * 50);
-                    if (p.x >= 0 && p.x < obstacle_map.cols && p.y >= 0 && p.y < obstacle_map.rows)
-                        obstacle_map.at<float>(p) = 0.5;
-                }
-            }
-
-            //            x_sum_ += x;
-            //            y_sum_ += y;
-            //            xy_sum_ += x * y;
-            //            x2_sum_ += x * x;
-
-            buffer.at<cv::Vec4d>(y, 0) = buffer.at<cv::Vec4d>(y - 1, 0)
-                        + cv::Vec4d(p_floor.y, p_floor.z, p_floor.y * p_floor.z, p_floor.y * p_floor.y);
-        }
-
-        for(int y = slope_window_size_; y < height - slope_window_size_; ++y)
-        {
-            float d = depth.at<float>(y, x);
-            if (d == 0 || d != d)
-                continue;
+    // - - - - - - - - - - - - - - - - - - - - - - -
 
-            const geo::Vector3& p_floor = p_floors[y];
+    // Split the columns over the threads, the visualization is drawn by a single thread
+    int num_columns = task.columns.size();
+    int num_threads = visualize ? 1 : std::max(1, std::min(num_threads_, num_columns));
+    std::vector<ColumnResult> results(num_columns);
 
-            if (p_floor.z < 0.2)
-            {
-//                const cv::Vec4d& bm = buffer.at<cv::Vec4d>(y, 0);
-
-//                double c1, s1;
-//                cv::Vec4d b1 = bm - buffer.at<cv::Vec4d>(y - slope_window_size_, 0);
-//                s1 = (slope_window_size_ * b1[2] - b1[0] * b1[1]) / (slope_window_size_ * b1[3] - b1[0] * b1[0]);
-                //            c1 = b1[1] / slope_window_size_ - s1 * (b1[0] / slope_window_size_);
-
-                double c2, s2;
-                cv::Vec4d b2 = buffer.at<cv::Vec4d>(y + slope_window_size_ / 2, 0)
-                        - buffer.at<cv::Vec4d>(y - slope_window_size_ / 2, 0);
-                s2 = (slope_window_size_ * b2[2] - b2[0] * b2[1]) / (slope_window_size_ * b2[3] - b2[0] * b2[0]);
-                //            c2 = b2[1] / slope_window_size_ - s1 * (b2[0] / slope_window_size_);
-
-//                if (std::abs(s1) > 1 && std::abs(s2) < 1)
-                if (std::abs(s2) > slope_threshold_)
-                {
-                    if (p_floor.y < p_floor_closest.y)
-                        p_floor_closest = p_floor;
-
-                    if (visualize)
-                    {
-                        bla.at<float>(y, x) = 10;
-                        cv::Point2i p(p_floor.x * 50 + obstacle_map.rows / 2,
-                                      obstacle_map.cols / 2 - p_floor.y * 50);
-                        if (p.x >= 0 && p.x < obstacle_map.cols && p.y >= 0 && p.y < obstacle_map.rows)
-                            obstacle_map.at<float>(p) = 1;
-                    }
-                }
-            }
-        }
+    costmap_2d::TaskGroup workers;
+    for(int t = 1; t < num_threads; ++t)
+    {
+        workers.run(boost::bind(&Depth3DIntegrator::processColumns, this, boost::cref(task),
+                                t * num_columns / num_threads, (t + 1) * num_columns / num_threads,
+                                boost::ref(results)));
+    }
+    processColumns(task, 0, num_columns / num_threads, results);
+    workers.wait();
 
-        if (p_floor_closest.y < max_distance_ && p_floor_closest.y > min_distance_)
+    for(int i = 0; i < num_columns; ++i)
+    {
+        if (results[i].valid)
         {
-            geo::Vec3 p_map = sensor_pose_xya * p_floor_closest;
+            geo::Vec3 p_map = sensor_pose_xya * results[i].p_floor_closest;
             cloud.push_back(pcl::PointXYZ(p_map.x, p_map.y, p_map.z));
         }
     }
@@ -204,3 +259,41 @@ bool Depth3DIntegrator::update(pcl::PointCloud<pcl::PointXYZ>& cloud)
 
 // ----------------------------------------------------------------------------------------------------
 
+void Depth3DIntegrator::processColumns(const ColumnTask& task, int begin, int end,
+                                       std::vector<ColumnResult>& results) const
+{
+    cv::Mat* obstacle_map = task.obstacle_map;
+
+    costmap_2d::DepthSlopeKernel::Scratch scratch;
+
+    for(int i = begin; i < end; ++i)
+    {
+        int x = task.columns[i];
+
+        float closest[3] = { 0, 0, 0 };
+        bool found = kernel_.processColumn(&task.rows[0], x, scratch, closest);
+
+        results[i].valid = found && closest[1] < max_distance_ && closest[1] > min_distance_;
+        results[i].p_floor_closest = geo::Vector3(closest[0], closest[1], closest[2]);
+
+        if (obstacle_map)
+        {
+            for(int y = 0; y < kernel_.height(); ++y)
+            {
+                if (!scratch.labels[y])
+                    continue;
+
+                if (scratch.labels[y] == costmap_2d::DepthSlopeKernel::OBSTACLE_SLOPE)
+                    task.slope_img->at<float>(y, x) = 10;
+
+                cv::Point2i p(scratch.x[y] * 50 + obstacle_map->rows / 2,
+                              obstacle_map->cols / 2 - scratch.y[y] * 50);
+                if (p.x >= 0 && p.x < obstacle_map->cols && p.y >= 0 && p.y < obstacle_map->rows)
+                    obstacle_map->at<float>(p) =
+                            scratch.labels[y] == costmap_2d::DepthSlopeKernel::OBSTACLE_SLOPE ? 1 : 0.5;
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------------------------------
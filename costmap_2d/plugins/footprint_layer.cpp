@@ -16,6 +16,11 @@ namespace costmap_2d
 
     footprint_pub_ = nh.advertise<geometry_msgs::PolygonStamped>( "footprint_stamped", 1 );
 
+    // with heading bins the footprint is filled from row spans computed once per bin
+    int headings;
+    nh.param("footprint_headings", headings, 0);
+    headings_ = std::max(0, headings);
+
     dsrv_ = new dynamic_reconfigure::Server<costmap_2d::GenericPluginConfig>(nh);
     dynamic_reconfigure::Server<costmap_2d::GenericPluginConfig>::CallbackType cb = boost::bind(&FootprintLayer::reconfigureCB, this, _1, _2);
     dsrv_->setCallback(cb);
@@ -37,6 +42,10 @@ namespace costmap_2d
   void FootprintLayer::updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y, double* max_x, double* max_y)
   {
     if(!enabled_) return;
+    robot_x_ = robot_x;
+    robot_y_ = robot_y;
+    robot_yaw_ = robot_yaw;
+
     //update transformed polygon
     footprint_.header.stamp = ros::Time::now();
     footprint_.polygon.points.clear();
@@ -65,8 +74,14 @@ namespace costmap_2d
   void FootprintLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j)
   {
     if(!enabled_) return;
+    if(headings_ > 0)
+    {
+      spans_.update(getFootprint(), scale_, master_grid.getResolution(), headings_);
+      spans_.setCost(master_grid, robot_x_, robot_y_, robot_yaw_, costmap_2d::FREE_SPACE, footprint_.header.stamp.toSec());
+      return;
+    }
     std::vector<geometry_msgs::Point> footprint_points = costmap_2d::toPointVector(footprint_.polygon);
-    master_grid.setConvexPolygonCost(footprint_points, costmap_2d::FREE_SPACE);
+    master_grid.setConvexPolygonCost(footprint_points, costmap_2d::FREE_SPACE, footprint_.header.stamp.toSec());
   }
 }
 
@@ -1,6 +1,7 @@
 #include<costmap_2d/inflation_layer.h>
 #include<costmap_2d/costmap_math.h>
 #include<costmap_2d/footprint.h>
+#include <costmap_2d/executor.h>
 #include <pluginlib/class_list_macros.h>
 
 PLUGINLIB_EXPORT_CLASS(costmap_2d::InflationLayer, costmap_2d::Layer)
@@ -16,21 +17,80 @@ InflationLayer::InflationLayer()
   , dilation_cell_value_ (0)
   , use_footprint_(true)
   , cell_inflation_radius_(0)
-  , cached_cell_inflation_radius_(0)
+  , resolution_(0)
+  , cache_size_(0)
+  , tile_size_(256)
+  , min_tiled_cells_(512 * 512)
+  , collision_headings_(0)
+  , lazy_radius_(0)
+  , no_unknown_space_(false)
+  , lazy_tile_size_(128)
+  , lazy_tiles_x_(0)
+  , lazy_tiles_y_(0)
+  , lazy_tile_count_(0)
+  , robot_x_(0)
+  , robot_y_(0)
+  , robot_mx_(0)
+  , robot_my_(0)
+  , warm_thread_(NULL)
+  , warm_pending_(false)
+  , warm_shutdown_(false)
+  , next_tile_(0)
+  , incremental_(false)
+  , brushfire_origin_x_(0)
+  , brushfire_origin_y_(0)
   , dsrv_(NULL)
 {
   access_ = new boost::shared_mutex();
 }
 
+InflationLayer::~InflationLayer()
+{
+  if (warm_thread_)
+  {
+    {
+      boost::mutex::scoped_lock lock(warm_mutex_);
+      warm_shutdown_ = true;
+    }
+    warm_condition_.notify_all();
+    warm_thread_->join();
+    delete warm_thread_;
+  }
+  if(dsrv_)
+      delete dsrv_;
+}
+
 void InflationLayer::onInitialize()
 {
   {
     boost::unique_lock < boost::shared_mutex > lock(*access_);
     ros::NodeHandle nh("~/" + name_), g_nh;
     current_ = true;
-    seen_ = NULL;
     need_reinflation_ = false;
 
+    int inflation_threads;
+    nh.param("inflation_threads", inflation_threads, 1);
+    tile_workspaces_.resize(std::max(1, inflation_threads));
+
+    nh.param("incremental", incremental_, false);
+
+    int collision_headings;
+    nh.param("footprint_collision_headings", collision_headings, 0);
+    collision_headings_ = std::max(0, collision_headings);
+
+    // a large static map is inflated near the robot first, the rest by a worker thread or when it is read
+    nh.param("lazy_radius", lazy_radius_, 0.0);
+    if (lazy_radius_ > 0 && (incremental_ || layered_costmap_->isRolling()))
+    {
+      ROS_WARN("The lazy inflation is only for a static global costmap without incremental inflation, disabling it");
+      lazy_radius_ = 0;
+    }
+    if (lazy_radius_ > 0 && !warm_thread_)
+      warm_thread_ = new boost::thread(boost::bind(&InflationLayer::warmTiles, this));
+
+    // unknown cells are not inflated, a low cost only proves a footprint clear when there are none
+    nh.param("no_unknown_space", no_unknown_space_, false);
+
     dynamic_reconfigure::Server<costmap_2d::InflationPluginConfig>::CallbackType cb = boost::bind(
         &InflationLayer::reconfigureCB, this, _1, _2);
 
@@ -68,6 +128,7 @@ void InflationLayer::reconfigureCB(costmap_2d::InflationPluginConfig &config, ui
     enabled_ = config.enabled;
     need_reinflation_ = true;
   }
+  updateInflationThresholds();
 }
 
 void InflationLayer::matchSize()
@@ -79,14 +140,28 @@ void InflationLayer::matchSize()
   computeCaches();
 
   unsigned int size_x = costmap->getSizeInCellsX(), size_y = costmap->getSizeInCellsY();
-  if (seen_)
-    delete seen_;
-  seen_ = new bool[size_x * size_y];
+  workspace_.seen_.assign(size_x * size_y, 0);
+  workspace_.seen_generation_ = 0;
+
+  // the next update inflates the whole new grid anyway
+  lazy_tiles_x_ = (size_x + lazy_tile_size_ - 1) / lazy_tile_size_;
+  lazy_tiles_y_ = (size_y + lazy_tile_size_ - 1) / lazy_tile_size_;
+  lazy_tiles_.assign(lazy_tiles_x_ * lazy_tiles_y_, 0);
+  lazy_tile_count_ = 0;
+
+  if (collision_headings_ > 0)
+  {
+    collision_map_.resize(size_x, size_y);
+    collision_map_.setFootprint(layered_costmap_->getFootprint(), resolution_, collision_headings_);
+  }
 }
 
 void InflationLayer::updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x,
                                            double* min_y, double* max_x, double* max_y)
 {
+  robot_x_ = robot_x;
+  robot_y_ = robot_y;
+
   if (layered_costmap_->isRolling())
   {
       *min_x = *min_y = -1e6;
@@ -104,6 +179,17 @@ void InflationLayer::updateBounds(double robot_x, double robot_y, double robot_y
     *max_y = std::numeric_limits<float>::max();
     need_reinflation_ = false;
   }
+
+  // target cells only change inside the bounds of the layers before, the costs up to the inflation radius around
+  // them may go down as well as up
+  if (incremental_ && *min_x <= *max_x && *min_y <= *max_y)
+  {
+    double margin = inflation_radius_ + resolution_;
+    *min_x -= margin;
+    *min_y -= margin;
+    *max_x += margin;
+    *max_y += margin;
+  }
 }
 
 void InflationLayer::onFootprintChanged()
@@ -118,6 +204,9 @@ void InflationLayer::onFootprintChanged()
     ROS_DEBUG( "InflationLayer::onFootprintChanged(): num footprint points: %lu, inscribed_radius_ = %.3f, inflation_radius_ = %.3f",
              layered_costmap_->getFootprint().size(), dilation_radius_, inflation_radius_ );
   }
+  if (collision_headings_ > 0)
+    collision_map_.setFootprint(layered_costmap_->getFootprint(), resolution_, collision_headings_);
+  updateInflationThresholds();
 }
 
 void InflationLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i,
@@ -127,14 +216,24 @@ void InflationLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i,
   if (!enabled_)
     return;
 
-  //make sure the inflation queue is empty at the beginning of the cycle (should always be true)
-  ROS_ASSERT_MSG(inflation_queue_.empty(), "The inflation queue must be empty at the beginning of inflation");
+  // the inflation leaves the target cells as they are, so the collisions can be found before it. The robot cells
+  // whose footprint reaches a changed target cell are the ones within its reach of the area
+  if (use_footprint_ && collision_headings_ > 0)
+  {
+    int reach = collision_map_.getReach();
+    collision_map_.update(master_grid, target_cell_value_, min_i - reach, min_j - reach, max_i + reach,
+                          max_j + reach);
+  }
+
+  if (incremental_)
+  {
+    inflateIncrementally(master_grid, min_i, min_j, max_i, max_j);
+    return;
+  }
 
   unsigned char* master_array = master_grid.getCharMap();
   unsigned int size_x = master_grid.getSizeInCellsX(), size_y = master_grid.getSizeInCellsY();
 
-  memset(seen_, false, size_x * size_y * sizeof(bool));
-
   // We need to include in the inflation cells outside the bounding
   // box min_i...max_j, by the amount cell_inflation_radius_.  Cells
   // up to that distance outside the box can still influence the costs
@@ -149,47 +248,365 @@ void InflationLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i,
   max_i = std::min( int( size_x  ), max_i );
   max_j = std::min( int( size_y  ), max_j );
 
+  if (lazy_radius_ > 0)
+  {
+    inflateLazily(master_grid, min_i, min_j, max_i, max_j);
+    return;
+  }
+
+  // large areas (e.g. a new static map or a reinflation) are split over several threads
+  unsigned int padded_x = max_i - min_i + 2 * cell_inflation_radius_;
+  unsigned int padded_y = max_j - min_j + 2 * cell_inflation_radius_;
+  if (tile_workspaces_.size() > 1 && max_i > min_i && max_j > min_j
+      && (padded_x > tile_size_ || padded_y > tile_size_)
+      && padded_x * padded_y >= min_tiled_cells_)
+  {
+    inflateTiled(master_array, size_x, size_y, min_i, min_j, max_i, max_j);
+    return;
+  }
+
+  inflate_area(workspace_, master_array, size_x, size_y, min_i, min_j, max_i, max_j);
+}
+
+void InflationWorkspace::begin(unsigned int num_cells, unsigned int num_levels)
+{
+  //every squared distance within the inflation radius needs a bucket
+  if (inflation_cells_.size() < num_levels)
+    inflation_cells_.resize(num_levels);
+
+  //new cells are zero, which is never a current generation
+  if (seen_.size() < num_cells)
+    seen_.resize(num_cells, 0);
+  if (++seen_generation_ == 0)
+  {
+    std::fill(seen_.begin(), seen_.end(), 0);
+    seen_generation_ = 1;
+  }
+}
+
+void InflationLayer::inflate_area(InflationWorkspace& ws, unsigned char* grid, unsigned int size_x,
+                                  unsigned int size_y, int min_i, int min_j, int max_i, int max_j)
+{
+  ws.begin(size_x * size_y, cell_inflation_radius_ * cell_inflation_radius_ + 1);
+
   for (int j = min_j; j < max_j; j++)
   {
     for (int i = min_i; i < max_i; i++)
     {
-      int index = master_grid.getIndex(i, j);
-      unsigned char cost = master_array[index];
+      int index = j * size_x + i;
+      unsigned char cost = grid[index];
       if (cost == target_cell_value_)
       {
-        enqueue(master_array, index, i, j, i, j);
+        enqueue(ws, grid, index, i, j, i, j);
       }
     }
   }
 
-  while (!inflation_queue_.empty())
+  //process the buckets in order of increasing distance, cells may still be added to the current bucket
+  for (ws.current_level_ = 0; ws.current_level_ < ws.inflation_cells_.size(); ++ws.current_level_)
+  {
+    std::vector<CellData>& bucket = ws.inflation_cells_[ws.current_level_];
+    for (unsigned int k = 0; k < bucket.size(); ++k)
+    {
+      //copy the cell info, enqueue may grow the bucket
+      const CellData current_cell = bucket[k];
+
+      unsigned int index = current_cell.index_;
+      unsigned int mx = current_cell.x_;
+      unsigned int my = current_cell.y_;
+      unsigned int sx = current_cell.src_x_;
+      unsigned int sy = current_cell.src_y_;
+
+      //attempt to put the neighbors of the current cell onto the queue
+      if (mx > 0)
+        enqueue(ws, grid, index - 1, mx - 1, my, sx, sy);
+      if (my > 0)
+        enqueue(ws, grid, index - size_x, mx, my - 1, sx, sy);
+      if (mx < size_x - 1)
+        enqueue(ws, grid, index + 1, mx + 1, my, sx, sy);
+      if (my < size_y - 1)
+        enqueue(ws, grid, index + size_x, mx, my + 1, sx, sy);
+    }
+    //keeps the capacity for the next update
+    bucket.clear();
+  }
+  ws.current_level_ = 0;
+}
+
+void InflationLayer::inflateTiled(unsigned char* master_array, unsigned int size_x, unsigned int size_y, int min_i,
+                                  int min_j, int max_i, int max_j)
+{
+  //the workers read the tiles from a copy, so they never see cells another worker already inflated
+  snapshot_.assign(master_array, master_array + size_x * size_y);
+  next_tile_ = 0;
+
+  TaskGroup workers;
+  for (unsigned int t = 1; t < tile_workspaces_.size(); ++t)
+  {
+    workers.run(boost::bind(&InflationLayer::inflateTiles, this, &tile_workspaces_[t], master_array, size_x, size_y,
+                            min_i, min_j, max_i, max_j));
+  }
+  inflateTiles(&tile_workspaces_[0], master_array, size_x, size_y, min_i, min_j, max_i, max_j);
+  workers.wait();
+}
+
+void InflationLayer::inflateTiles(InflationWorkspace* ws, unsigned char* master_array, unsigned int size_x,
+                                  unsigned int size_y, int min_i, int min_j, int max_i, int max_j)
+{
+  int radius = cell_inflation_radius_;
+
+  //the inflation of the area reaches up to one radius outside of it
+  int out_min_i = std::max(0, min_i - radius);
+  int out_min_j = std::max(0, min_j - radius);
+  int out_max_i = std::min(int(size_x), max_i + radius);
+  int out_max_j = std::min(int(size_y), max_j + radius);
+  unsigned int tiles_x = (out_max_i - out_min_i + tile_size_ - 1) / tile_size_;
+  unsigned int tiles_y = (out_max_j - out_min_j + tile_size_ - 1) / tile_size_;
+
+  while (true)
   {
-    //get the highest priority cell and pop it off the priority queue
-    const CellData& current_cell = inflation_queue_.top();
-
-    unsigned int index = current_cell.index_;
-    unsigned int mx = current_cell.x_;
-    unsigned int my = current_cell.y_;
-    unsigned int sx = current_cell.src_x_;
-    unsigned int sy = current_cell.src_y_;
-
-    //pop once we have our cell info
-    inflation_queue_.pop();
-
-    //attempt to put the neighbors of the current cell onto the queue
-    if (mx > 0)
-      enqueue(master_array, index - 1, mx - 1, my, sx, sy);
-    if (my > 0)
-      enqueue(master_array, index - size_x, mx, my - 1, sx, sy);
-    if (mx < size_x - 1)
-      enqueue(master_array, index + 1, mx + 1, my, sx, sy);
-    if (my < size_y - 1)
-      enqueue(master_array, index + size_x, mx, my + 1, sx, sy);
+    unsigned int tile;
+    {
+      boost::mutex::scoped_lock lock(tile_mutex_);
+      tile = next_tile_++;
+    }
+    if (tile >= tiles_x * tiles_y)
+      return;
+
+    //the cells of this tile
+    int core_min_i = out_min_i + (tile % tiles_x) * tile_size_;
+    int core_min_j = out_min_j + (tile / tiles_x) * tile_size_;
+    int core_max_i = std::min(out_max_i, core_min_i + int(tile_size_));
+    int core_max_j = std::min(out_max_j, core_min_j + int(tile_size_));
+
+    //the obstacles that reach the tile, and the cells their inflation passes through on the way
+    int tile_min_i = std::max(0, core_min_i - 2 * radius);
+    int tile_min_j = std::max(0, core_min_j - 2 * radius);
+    int tile_max_i = std::min(int(size_x), core_max_i + 2 * radius);
+    int tile_max_j = std::min(int(size_y), core_max_j + 2 * radius);
+    unsigned int tile_size_x = tile_max_i - tile_min_i, tile_size_y = tile_max_j - tile_min_j;
+
+    ws->tile_.resize(tile_size_x * tile_size_y);
+    for (int j = tile_min_j; j < tile_max_j; ++j)
+    {
+      memcpy(&ws->tile_[(j - tile_min_j) * tile_size_x], &snapshot_[j * size_x + tile_min_i], tile_size_x);
+    }
+
+    inflate_area(*ws, &ws->tile_[0], tile_size_x, tile_size_y, std::max(min_i, tile_min_i) - tile_min_i,
+                 std::max(min_j, tile_min_j) - tile_min_j, std::min(max_i, tile_max_i) - tile_min_i,
+                 std::min(max_j, tile_max_j) - tile_min_j);
+
+    for (int j = core_min_j; j < core_max_j; ++j)
+    {
+      memcpy(&master_array[j * size_x + core_min_i],
+             &ws->tile_[(j - tile_min_j) * tile_size_x + core_min_i - tile_min_i], core_max_i - core_min_i);
+    }
+  }
+}
+
+void InflationLayer::inflateLazily(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j)
+{
+  unsigned char* master_array = master_grid.getCharMap();
+  unsigned int size_x = master_grid.getSizeInCellsX(), size_y = master_grid.getSizeInCellsY();
+  int radius = cell_inflation_radius_;
+
+  // the cells near the robot are inflated now, from the target cells that reach them
+  master_grid.worldToMapEnforceBounds(robot_x_, robot_y_, robot_mx_, robot_my_);
+  int warm = cellDistance(lazy_radius_);
+  int warm_min_i = std::max(min_i, robot_mx_ - warm), warm_max_i = std::min(max_i, robot_mx_ + warm + 1);
+  int warm_min_j = std::max(min_j, robot_my_ - warm), warm_max_j = std::min(max_j, robot_my_ + warm + 1);
+  if (warm_min_i < warm_max_i && warm_min_j < warm_max_j)
+    inflate_area(workspace_, master_array, size_x, size_y, std::max(min_i, warm_min_i - radius),
+                 std::max(min_j, warm_min_j - radius), std::min(max_i, warm_max_i + radius),
+                 std::min(max_j, warm_max_j + radius));
+
+  // the tiles of the rest wait, inflating one of them again only raises costs to what they would be anyway
+  for (unsigned int tj = min_j / lazy_tile_size_; tj * lazy_tile_size_ < (unsigned int)max_j; ++tj)
+  {
+    for (unsigned int ti = min_i / lazy_tile_size_; ti * lazy_tile_size_ < (unsigned int)max_i; ++ti)
+    {
+      int x0 = ti * lazy_tile_size_, y0 = tj * lazy_tile_size_;
+      int xn = std::min(size_x, x0 + lazy_tile_size_), yn = std::min(size_y, y0 + lazy_tile_size_);
+      if (x0 >= warm_min_i && xn <= warm_max_i && y0 >= warm_min_j && yn <= warm_max_j)
+        continue;
+
+      unsigned char& waiting = lazy_tiles_[tj * lazy_tiles_x_ + ti];
+      if (!waiting)
+      {
+        waiting = 1;
+        ++lazy_tile_count_;
+      }
+    }
+  }
+
+  if (lazy_tile_count_ > 0)
+  {
+    boost::mutex::scoped_lock lock(warm_mutex_);
+    warm_pending_ = true;
+    warm_condition_.notify_one();
+  }
+}
+
+void InflationLayer::inflateLazyTile(unsigned char* master_array, unsigned int size_x, unsigned int size_y,
+                                     unsigned int tile)
+{
+  int radius = cell_inflation_radius_;
+  int x0 = (tile % lazy_tiles_x_) * lazy_tile_size_, y0 = (tile / lazy_tiles_x_) * lazy_tile_size_;
+  inflate_area(workspace_, master_array, size_x, size_y, std::max(0, x0 - radius), std::max(0, y0 - radius),
+               std::min(int(size_x), x0 + int(lazy_tile_size_) + radius),
+               std::min(int(size_y), y0 + int(lazy_tile_size_) + radius));
+  lazy_tiles_[tile] = 0;
+  --lazy_tile_count_;
+}
+
+bool InflationLayer::hasDeferred(int min_i, int min_j, int max_i, int max_j)
+{
+  boost::shared_lock < boost::shared_mutex > lock(*access_);
+  if (lazy_tile_count_ == 0)
+    return false;
+
+  unsigned int tj_n = std::min(lazy_tiles_y_, (max_j + lazy_tile_size_ - 1) / lazy_tile_size_);
+  unsigned int ti_n = std::min(lazy_tiles_x_, (max_i + lazy_tile_size_ - 1) / lazy_tile_size_);
+  for (unsigned int tj = min_j / lazy_tile_size_; tj < tj_n; ++tj)
+    for (unsigned int ti = min_i / lazy_tile_size_; ti < ti_n; ++ti)
+      if (lazy_tiles_[tj * lazy_tiles_x_ + ti])
+        return true;
+  return false;
+}
+
+void InflationLayer::completeDeferred(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i,
+                                      int max_j)
+{
+  boost::unique_lock < boost::shared_mutex > lock(*access_);
+  unsigned char* master_array = master_grid.getCharMap();
+  unsigned int size_x = master_grid.getSizeInCellsX(), size_y = master_grid.getSizeInCellsY();
+  if (lazy_tile_count_ == 0 || lazy_tiles_x_ * lazy_tile_size_ < size_x || lazy_tiles_y_ * lazy_tile_size_ < size_y)
+    return;
+
+  unsigned int tj_n = std::min(lazy_tiles_y_, (max_j + lazy_tile_size_ - 1) / lazy_tile_size_);
+  unsigned int ti_n = std::min(lazy_tiles_x_, (max_i + lazy_tile_size_ - 1) / lazy_tile_size_);
+  for (unsigned int tj = min_j / lazy_tile_size_; tj < tj_n; ++tj)
+    for (unsigned int ti = min_i / lazy_tile_size_; ti < ti_n; ++ti)
+      if (lazy_tiles_[tj * lazy_tiles_x_ + ti])
+        inflateLazyTile(master_array, size_x, size_y, tj * lazy_tiles_x_ + ti);
+}
+
+bool InflationLayer::nearestLazyTile(unsigned int* x0, unsigned int* xn, unsigned int* y0, unsigned int* yn)
+{
+  boost::shared_lock < boost::shared_mutex > lock(*access_);
+  long best_distance = -1;
+  for (unsigned int tj = 0; tj < lazy_tiles_y_ && lazy_tile_count_ > 0; ++tj)
+  {
+    for (unsigned int ti = 0; ti < lazy_tiles_x_; ++ti)
+    {
+      if (!lazy_tiles_[tj * lazy_tiles_x_ + ti])
+        continue;
+      long dx = long(ti * lazy_tile_size_ + lazy_tile_size_ / 2) - robot_mx_;
+      long dy = long(tj * lazy_tile_size_ + lazy_tile_size_ / 2) - robot_my_;
+      if (best_distance >= 0 && dx * dx + dy * dy >= best_distance)
+        continue;
+      best_distance = dx * dx + dy * dy;
+      *x0 = ti * lazy_tile_size_;
+      *y0 = tj * lazy_tile_size_;
+    }
+  }
+  if (best_distance < 0)
+  {
+    // updates that defer tiles again hold the layer lock, so they set the flag after this
+    boost::mutex::scoped_lock warm_lock(warm_mutex_);
+    warm_pending_ = false;
+    return false;
+  }
+  *xn = *x0 + lazy_tile_size_;
+  *yn = *y0 + lazy_tile_size_;
+  return true;
+}
+
+void InflationLayer::warmTiles()
+{
+  while (true)
+  {
+    {
+      boost::mutex::scoped_lock lock(warm_mutex_);
+      while (!warm_pending_ && !warm_shutdown_)
+        warm_condition_.wait(lock);
+      if (warm_shutdown_)
+        return;
+    }
+
+    // one tile at a time, so updates and users of the costmap get the lock in between
+    unsigned int x0, xn, y0, yn;
+    if (nearestLazyTile(&x0, &xn, &y0, &yn))
+      layered_costmap_->completeDeferred(*this, x0, xn, y0, yn);
+  }
+}
+
+void InflationLayer::inflateIncrementally(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i,
+                                          int max_j)
+{
+  unsigned char* master_array = master_grid.getCharMap();
+  unsigned int size_x = master_grid.getSizeInCellsX(), size_y = master_grid.getSizeInCellsY();
+  min_i = std::max(0, min_i);
+  min_j = std::max(0, min_j);
+  max_i = std::min(int(size_x), max_i);
+  max_j = std::min(int(size_y), max_j);
+
+  // target cells can only have changed inside the area, unless the brushfire has to start over,
+  // which it does whenever the grid it was built for moved
+  int scan_min_i = min_i, scan_min_j = min_j, scan_max_i = max_i, scan_max_j = max_j;
+  if (brushfire_.getSizeX() != size_x || brushfire_.getSizeY() != size_y
+      || brushfire_.getMaxSquaredDistance() != cell_inflation_radius_ * cell_inflation_radius_
+      || brushfire_origin_x_ != master_grid.getOriginX() || brushfire_origin_y_ != master_grid.getOriginY())
+  {
+    brushfire_.reset(size_x, size_y, cell_inflation_radius_ * cell_inflation_radius_);
+    brushfire_origin_x_ = master_grid.getOriginX();
+    brushfire_origin_y_ = master_grid.getOriginY();
+    scan_min_i = scan_min_j = 0;
+    scan_max_i = size_x;
+    scan_max_j = size_y;
+  }
+
+  for (int j = scan_min_j; j < scan_max_j; j++)
+  {
+    for (int i = scan_min_i; i < scan_max_i; i++)
+    {
+      unsigned int index = j * size_x + i;
+      bool target = master_array[index] == target_cell_value_;
+      if (target == brushfire_.isObstacle(index))
+        continue;
+
+      if (target)
+        brushfire_.setObstacle(index);
+      else
+        brushfire_.removeObstacle(index);
+    }
+  }
+  brushfire_.update();
+
+  for (int j = min_j; j < max_j; j++)
+  {
+    for (int i = min_i; i < max_i; i++)
+    {
+      unsigned int index = j * size_x + i;
+      unsigned int obstacle = brushfire_.getObstacle(index);
+      unsigned char old_cost = master_array[index];
+      if (obstacle == DynamicBrushfire::NONE || old_cost == target_cell_value_ || old_cost == LETHAL_OBSTACLE)
+        continue;
+
+      unsigned int dx = abs(i - int(obstacle % size_x));
+      unsigned int dy = abs(j - int(obstacle / size_x));
+      unsigned char cost = costLookup(dx, dy);
+      if (old_cost == costmap_2d::NO_INFORMATION && cost >= costmap_2d::INSCRIBED_INFLATED_OBSTACLE)
+        master_array[index] = cost;
+      else
+        master_array[index] = std::max(old_cost, cost);
+    }
   }
 }
 
 /**
  * @brief  Given an index of a cell in the costmap, place it into a priority queue for obstacle inflation
+ * @param  ws The workspace holding the queue
  * @param  grid The costmap
  * @param  index The index of the cell
  * @param  mx The x coordinate of the cell (can be computed from the index, but saves time to store it)
@@ -197,24 +614,24 @@ void InflationLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i,
  * @param  src_x The x index of the obstacle point inflation started at
  * @param  src_y The y index of the obstacle point inflation started at
  */
-inline void InflationLayer::enqueue(unsigned char* grid, unsigned int index, unsigned int mx, unsigned int my,
-                                            unsigned int src_x, unsigned int src_y)
+inline void InflationLayer::enqueue(InflationWorkspace& ws, unsigned char* grid, unsigned int index, unsigned int mx,
+                                    unsigned int my, unsigned int src_x, unsigned int src_y)
 {
 
   //set the cost of the cell being inserted
-  if (!seen_[index])
+  if (ws.seen_[index] != ws.seen_generation_)
   {
-    seen_[index] = true;
-
-    //we compute our distance table one cell further than the inflation radius dictates so we can make the check below
-    double distance = distanceLookup(mx, my, src_x, src_y);
+    ws.seen_[index] = ws.seen_generation_;
+    unsigned int dx = abs(int(mx) - int(src_x));
+    unsigned int dy = abs(int(my) - int(src_y));
+    unsigned int squared_distance = dx * dx + dy * dy;
 
     //we only want to put the cell in the queue if it is within the inflation radius of the obstacle point
-    if (distance > cell_inflation_radius_)
+    if (squared_distance > cell_inflation_radius_ * cell_inflation_radius_)
       return;
 
     //assign the cost associated with the distance from an obstacle to the cell
-    unsigned char cost = costLookup(mx, my, src_x, src_y);
+    unsigned char cost = costLookup(dx, dy);
     unsigned char old_cost = grid[index];
 
     if (old_cost != target_cell_value_ && old_cost == LETHAL_OBSTACLE)
@@ -228,67 +645,51 @@ inline void InflationLayer::enqueue(unsigned char* grid, unsigned int index, uns
         grid[index] = std::max(old_cost, cost);
     }
 
-    //push the cell data onto the queue and mark
-    CellData data(distance, index, mx, my, src_x, src_y);
-    inflation_queue_.push(data);
+    //push the cell data into the bucket of its squared distance, cells closer than the bucket that is
+    //being processed go into the current bucket so they are not lost
+    unsigned int level = std::max(squared_distance, ws.current_level_);
+    ws.inflation_cells_[level].push_back(CellData(index, mx, my, src_x, src_y));
   }
 }
 
 void InflationLayer::computeCaches()
 {
-  if(cell_inflation_radius_ == 0)
-    return;
-
-  //based on the inflation radius... compute distance and cost caches
-  if(cell_inflation_radius_ != cached_cell_inflation_radius_)
-  {
-    if(cached_cell_inflation_radius_ > 0)
-      deleteKernels();
+  //based on the inflation radius... compute the cost cache, one cell further than the radius so neighbors of
+  //cells on the radius can be looked up
+  cache_size_ = cell_inflation_radius_ + 2;
+  cached_costs_.resize(cache_size_ * cache_size_);
 
-    cached_costs_ = new unsigned char*[cell_inflation_radius_ + 2];
-    cached_distances_ = new double*[cell_inflation_radius_ + 2];
-
-    for (unsigned int i = 0; i <= cell_inflation_radius_ + 1; ++i)
-    {
-      cached_costs_[i] = new unsigned char[cell_inflation_radius_ + 2];
-      cached_distances_[i] = new double[cell_inflation_radius_ + 2];
-      for (unsigned int j = 0; j <= cell_inflation_radius_ + 1; ++j)
-      {
-        cached_distances_[i][j] = hypot(i, j);
-      }
-    }
+  //keep the halos of the tiled inflation small compared to the tiles
+  tile_size_ = std::max(256u, 4 * cell_inflation_radius_);
 
-    cached_cell_inflation_radius_ = cell_inflation_radius_;
-  }
-
-  for (unsigned int i = 0; i <= cell_inflation_radius_ + 1; ++i)
+  for (unsigned int i = 0; i < cache_size_; ++i)
   {
-    for (unsigned int j = 0; j <= cell_inflation_radius_ + 1; ++j)
+    for (unsigned int j = 0; j < cache_size_; ++j)
     {
-      cached_costs_[i][j] = computeCost(cached_distances_[i][j]);
+      cached_costs_[i * cache_size_ + j] = computeCost(hypot(i, j));
     }
   }
+  updateInflationThresholds();
 }
 
-void InflationLayer::deleteKernels()
+void InflationLayer::updateInflationThresholds()
 {
-  if (cached_distances_ != NULL)
+  unsigned char inscribed_cost = 0, circumscribed_cost = 0;
+  if (enabled_ && resolution_ > 0)
   {
-    for (unsigned int i = 0; i <= cached_cell_inflation_radius_ + 1; ++i)
-    {
-      delete[] cached_distances_[i];
-    }
-    delete[] cached_distances_;
-  }
-
-  if (cached_costs_ != NULL)
-  {
-    for (unsigned int i = 0; i <= cached_cell_inflation_radius_ + 1; ++i)
-    {
-      delete[] cached_costs_[i];
-    }
-    delete[] cached_costs_;
+    //only cells within the dilation radius of a target cell get the dilation value, the falloff stays below it
+    if (dilation_radius_ > 0 && dilation_radius_ <= layered_costmap_->getInscribedRadius()
+        && dilation_cell_value_ <= target_cell_value_)
+      inscribed_cost = dilation_cell_value_;
+
+    //two cells of margin for the offset of the robot in its cell and the rasterization of the footprint;
+    //every lethal cell has to be inflated right away, and no cell may be unknown
+    double distance = layered_costmap_->getCircumscribedRadius() + 2 * resolution_;
+    if (layered_costmap_->getCircumscribedRadius() > 0 && distance <= inflation_radius_ && no_unknown_space_
+        && lazy_radius_ == 0 && target_cell_value_ == LETHAL_OBSTACLE)
+      circumscribed_cost = computeCost(distance / resolution_);
   }
+  layered_costmap_->setInflationThresholds(inscribed_cost, circumscribed_cost);
 }
 
 } // end namespace costmap_2d
@@ -0,0 +1,98 @@
+#include<costmap_2d/inflation_layer_full.h>
+#include <pluginlib/class_list_macros.h>
+
+PLUGINLIB_EXPORT_CLASS(costmap_2d::InflationLayerFull, costmap_2d::Layer)
+
+namespace costmap_2d
+{
+
+void InflationLayerFull::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i,
+                                     int max_j)
+{
+  boost::unique_lock < boost::shared_mutex > lock(*access_);
+  if (!enabled_ || cell_inflation_radius_ == 0)
+    return;
+
+  unsigned char* master_array = master_grid.getCharMap();
+  unsigned int size_x = master_grid.getSizeInCellsX(), size_y = master_grid.getSizeInCellsY();
+
+  // Costs up to cell_inflation_radius_ outside the bounding box can
+  // still influence the costs stored in cells inside the box.
+  int win_min_i = std::max(0, min_i - int(cell_inflation_radius_));
+  int win_min_j = std::max(0, min_j - int(cell_inflation_radius_));
+  int win_max_i = std::min(int(size_x), max_i + int(cell_inflation_radius_));
+  int win_max_j = std::min(int(size_y), max_j + int(cell_inflation_radius_));
+  min_i = std::max(0, min_i);
+  min_j = std::max(0, min_j);
+  max_i = std::min(int(size_x), max_i);
+  max_j = std::min(int(size_y), max_j);
+  if (win_min_i >= win_max_i || win_min_j >= win_max_j)
+    return;
+
+  computeCostOffsets();
+
+  unsigned int win_size_x = win_max_i - win_min_i, win_size_y = win_max_j - win_min_j;
+  distances_.resize(win_size_x * win_size_y);
+  for (int j = win_min_j; j < win_max_j; j++)
+  {
+    const unsigned char* row = master_array + master_grid.getIndex(win_min_i, j);
+    float* distances = &distances_[(j - win_min_j) * win_size_x];
+    for (unsigned int i = 0; i < win_size_x; i++)
+      distances[i] = cost_offsets_[row[i]];
+  }
+
+  distance_transform_.compute(&distances_[0], win_size_x, win_size_y);
+
+  // only the cells inside the bounding box see all the costs that influence them
+  double max_distance = (double)cell_inflation_radius_ * cell_inflation_radius_;
+  for (int j = min_j; j < max_j; j++)
+  {
+    for (int i = min_i; i < max_i; i++)
+    {
+      double distance = distances_[(j - win_min_j) * win_size_x + (i - win_min_i)];
+      if (distance > max_distance)
+        continue;
+
+      unsigned int index = master_grid.getIndex(i, j);
+      unsigned char old_cost = master_array[index];
+      if (old_cost == LETHAL_OBSTACLE || old_cost == target_cell_value_)
+        continue;
+
+      unsigned char cost = computeCost(sqrt(distance));
+      if (old_cost == costmap_2d::NO_INFORMATION && cost >= costmap_2d::INSCRIBED_INFLATED_OBSTACLE)
+        master_array[index] = cost;
+      else if (old_cost != costmap_2d::NO_INFORMATION)
+        master_array[index] = std::max(old_cost, cost);
+    }
+  }
+}
+
+void InflationLayerFull::computeCostOffsets()
+{
+  for (unsigned int cost = 0; cost < 256; ++cost)
+  {
+    double distance;
+    if (cost == FREE_SPACE || cost == NO_INFORMATION)
+      distance = std::numeric_limits<double>::infinity();
+    else if (cost >= target_cell_value_)
+      distance = 0.0;
+    else if (cost >= dilation_cell_value_)
+      distance = dilation_radius_ / resolution_;
+    else if (cost_scaling_factor_ <= 0.0)
+      distance = cell_inflation_radius_;
+    else
+    {
+      // invert the exponential decay of computeCost()
+      double euclidean_distance = dilation_radius_
+          + log((dilation_cell_value_ - 1) / (double)cost) / cost_scaling_factor_;
+      distance = euclidean_distance / resolution_;
+    }
+
+    if (distance > cell_inflation_radius_)
+      cost_offsets_[cost] = DistanceTransform::INF;
+    else
+      cost_offsets_[cost] = distance * distance;
+  }
+}
+
+} // end namespace costmap_2d
@@ -1,7 +1,11 @@
 #include<costmap_2d/obstacle_layer.h>
 #include<costmap_2d/costmap_math.h>
+#include <costmap_2d/executor.h>
 
 #include <pluginlib/class_list_macros.h>
+#include <algorithm>
+#include <limits>
+
 PLUGINLIB_EXPORT_CLASS(costmap_2d::ObstacleLayer, costmap_2d::Layer)
 
 using costmap_2d::NO_INFORMATION;
@@ -26,6 +30,32 @@ void ObstacleLayer::onInitialize()
   else
     default_value_ = FREE_SPACE;
 
+  // the decay of free and occupied cells needs the time stamps, 0 bits drops them altogether
+  int timestamp_bits;
+  nh.param("timestamp_bits", timestamp_bits, 32);
+  CellTimeStamps::Precision precision = CellTimeStamps::TICKS_32;
+  if (timestamp_bits == 0)
+    precision = CellTimeStamps::NONE;
+  else if (timestamp_bits == 16)
+    precision = CellTimeStamps::TICKS_16;
+  else if (timestamp_bits != 32)
+    ROS_WARN("timestamp_bits must be 0, 16 or 32, not %d. Using 32 bits.", timestamp_bits);
+
+  double timestamp_resolution;
+  nh.param("timestamp_resolution", timestamp_resolution, precision == CellTimeStamps::TICKS_16 ? 0.1 : 0.001);
+  if (timestamp_resolution <= 0.0)
+  {
+    ROS_WARN("timestamp_resolution must be positive, using 0.001 seconds");
+    timestamp_resolution = 0.001;
+  }
+  setTimeStampPrecision(precision, timestamp_resolution);
+
+  // clearing rays can be split over several threads, each owning a band of rows of the map, and
+  // the points of the marking observations are converted to cells on the same number of threads
+  int raytrace_threads;
+  nh.param("raytrace_threads", raytrace_threads, 1);
+  raytrace_threads_ = std::max(1, raytrace_threads);
+
   ObstacleLayer::matchSize();
   current_ = true;
 
@@ -62,6 +92,16 @@ void ObstacleLayer::onInitialize()
     source_node.param("clearing", clearing, false);
     source_node.param("marking", marking, true);
 
+    bool deferred_transform;
+    source_node.param("deferred_transform", deferred_transform, false);
+
+    double sector_clearing_angle;
+    source_node.param("sector_clearing_angle", sector_clearing_angle, 0.0);
+
+    //a source can get its own callback queue and threads, so that it neither waits for nor delays other sensors
+    int callback_threads;
+    source_node.param("callback_threads", callback_threads, 0);
+
     if (!(data_type == "PointCloud2" || data_type == "PointCloud" || data_type == "LaserScan"))
     {
       ROS_FATAL("Only topics that use point clouds or laser scans are currently supported");
@@ -94,6 +134,20 @@ void ObstacleLayer::onInitialize()
                                      max_obstacle_height, obstacle_range, raytrace_range, *tf_, global_frame_,
                                      sensor_frame, transform_tolerance)));
 
+    //accept the messages as they come and transform them when the update reads them, instead of holding
+    //them back in a tf filter until their transform is there
+    if (deferred_transform)
+      observation_buffers_.back()->setDeferredTransforms(true);
+
+    //consecutive beams of a planar scan can be cleared as one sector
+    if (sector_clearing_angle > 0.0)
+    {
+      if (data_type == "LaserScan")
+        observation_buffers_.back()->setSectorAngle(sector_clearing_angle);
+      else
+        ROS_WARN("obstacle_layer: sector_clearing_angle option is only applicable to LaserScan observations.");
+    }
+
     //check if we'll add this buffer to our marking observation buffers
     if (marking)
       marking_buffers_.push_back(observation_buffers_.back());
@@ -106,69 +160,90 @@ void ObstacleLayer::onInitialize()
         "Created an observation buffer for source %s, topic %s, global frame: %s, expected update rate: %.2f, observation persistence: %.2f",
         source.c_str(), topic.c_str(), global_frame_.c_str(), expected_update_rate, observation_keep_time);
 
-    //create a callback for the topic
+    ros::NodeHandle source_nh(g_nh);
+    if (callback_threads > 0)
+    {
+      observation_queues_.push_back(boost::shared_ptr<ros::CallbackQueue>(new ros::CallbackQueue()));
+      source_nh.setCallbackQueue(observation_queues_.back().get());
+    }
+
+    //create a callback for the topic, deferred sources skip the tf filter as the buffer waits for the transforms
     if (data_type == "LaserScan")
     {
       boost::shared_ptr < message_filters::Subscriber<sensor_msgs::LaserScan>
-          > sub(new message_filters::Subscriber<sensor_msgs::LaserScan>(g_nh, topic, 50));
-
-      boost::shared_ptr < tf::MessageFilter<sensor_msgs::LaserScan>
-          > filter(new tf::MessageFilter<sensor_msgs::LaserScan>(*sub, *tf_, global_frame_, 50));
+          > sub(new message_filters::Subscriber<sensor_msgs::LaserScan>(source_nh, topic, 50));
 
+      boost::function<void(const sensor_msgs::LaserScanConstPtr&)> callback;
       if (inf_is_valid)
-      {
-        filter->registerCallback(
-            boost::bind(&ObstacleLayer::laserScanValidInfCallback, this, _1, observation_buffers_.back()));
-      }
+        callback = boost::bind(&ObstacleLayer::laserScanValidInfCallback, this, _1, observation_buffers_.back());
+      else
+        callback = boost::bind(&ObstacleLayer::laserScanCallback, this, _1, observation_buffers_.back());
+
+      if (deferred_transform)
+        sub->registerCallback(callback);
       else
       {
-        filter->registerCallback(
-            boost::bind(&ObstacleLayer::laserScanCallback, this, _1, observation_buffers_.back()));
+        boost::shared_ptr < tf::MessageFilter<sensor_msgs::LaserScan>
+            > filter(new tf::MessageFilter<sensor_msgs::LaserScan>(*sub, *tf_, global_frame_, 50, source_nh));
+        filter->registerCallback(callback);
+        filter->setTolerance(ros::Duration(0.05));
+        observation_notifiers_.push_back(filter);
       }
 
       observation_subscribers_.push_back(sub);
-      observation_notifiers_.push_back(filter);
-
-      observation_notifiers_.back()->setTolerance(ros::Duration(0.05));
     }
     else if (data_type == "PointCloud")
     {
       boost::shared_ptr < message_filters::Subscriber<sensor_msgs::PointCloud>
-          > sub(new message_filters::Subscriber<sensor_msgs::PointCloud>(g_nh, topic, 50));
+          > sub(new message_filters::Subscriber<sensor_msgs::PointCloud>(source_nh, topic, 50));
 
       if( inf_is_valid )
       {
        ROS_WARN("obstacle_layer: inf_is_valid option is not applicable to PointCloud observations.");
       }
 
-      boost::shared_ptr < tf::MessageFilter<sensor_msgs::PointCloud>
-          > filter(new tf::MessageFilter<sensor_msgs::PointCloud>(*sub, *tf_, global_frame_, 50));
-      filter->registerCallback(
-          boost::bind(&ObstacleLayer::pointCloudCallback, this, _1, observation_buffers_.back()));
+      boost::function<void(const sensor_msgs::PointCloudConstPtr&)> callback = boost::bind(
+          &ObstacleLayer::pointCloudCallback, this, _1, observation_buffers_.back());
+
+      if (deferred_transform)
+        sub->registerCallback(callback);
+      else
+      {
+        boost::shared_ptr < tf::MessageFilter<sensor_msgs::PointCloud>
+            > filter(new tf::MessageFilter<sensor_msgs::PointCloud>(*sub, *tf_, global_frame_, 50, source_nh));
+        filter->registerCallback(callback);
+        observation_notifiers_.push_back(filter);
+      }
 
       observation_subscribers_.push_back(sub);
-      observation_notifiers_.push_back(filter);
     }
     else
     {
       boost::shared_ptr < message_filters::Subscriber<sensor_msgs::PointCloud2>
-          > sub(new message_filters::Subscriber<sensor_msgs::PointCloud2>(g_nh, topic, 50));
+          > sub(new message_filters::Subscriber<sensor_msgs::PointCloud2>(source_nh, topic, 50));
 
       if( inf_is_valid )
       {
        ROS_WARN("obstacle_layer: inf_is_valid option is not applicable to PointCloud observations.");
       }
 
-      boost::shared_ptr < tf::MessageFilter<sensor_msgs::PointCloud2>
-          > filter(new tf::MessageFilter<sensor_msgs::PointCloud2>(*sub, *tf_, global_frame_, 50));
-      filter->registerCallback(
-          boost::bind(&ObstacleLayer::pointCloud2Callback, this, _1, observation_buffers_.back()));
+      boost::function<void(const sensor_msgs::PointCloud2ConstPtr&)> callback = boost::bind(
+          &ObstacleLayer::pointCloud2Callback, this, _1, observation_buffers_.back());
+
+      if (deferred_transform)
+        sub->registerCallback(callback);
+      else
+      {
+        boost::shared_ptr < tf::MessageFilter<sensor_msgs::PointCloud2>
+            > filter(new tf::MessageFilter<sensor_msgs::PointCloud2>(*sub, *tf_, global_frame_, 50, source_nh));
+        filter->registerCallback(callback);
+        observation_notifiers_.push_back(filter);
+      }
 
       observation_subscribers_.push_back(sub);
-      observation_notifiers_.push_back(filter);
     }
 
-    if (sensor_frame != "")
+    if (sensor_frame != "" && !deferred_transform)
     {
       std::vector < std::string > target_frames;
       target_frames.push_back(global_frame_);
@@ -176,6 +251,15 @@ void ObstacleLayer::onInitialize()
       observation_notifiers_.back()->setTargetFrames(target_frames);
     }
 
+    //start serving the queue only once the callbacks are in place
+    if (callback_threads > 0)
+    {
+      observation_spinners_.push_back(
+          boost::shared_ptr<ros::AsyncSpinner>(new ros::AsyncSpinner(callback_threads, observation_queues_.back().get())));
+      observation_spinners_.back()->start();
+      ROS_INFO("    Source %s runs on its own callback queue with %d thread(s)", source.c_str(), callback_threads);
+    }
+
   }
 
   setupDynamicReconfigure(nh);
@@ -192,6 +276,9 @@ void ObstacleLayer::setupDynamicReconfigure(ros::NodeHandle& nh)
 
 ObstacleLayer::~ObstacleLayer()
 {
+    //no sensor callbacks may run while the layer goes away
+    for (unsigned int i = 0; i < observation_spinners_.size(); ++i)
+      observation_spinners_[i]->stop();
     if(dsrv_)
         delete dsrv_;
 }
@@ -208,69 +295,28 @@ void ObstacleLayer::reconfigureCB(costmap_2d::ObstaclePluginConfig &config, uint
 void ObstacleLayer::laserScanCallback(const sensor_msgs::LaserScanConstPtr& message,
                                       const boost::shared_ptr<ObservationBuffer>& buffer)
 {
-  //project the laser into a point cloud
-  sensor_msgs::PointCloud2 cloud;
-  cloud.header = message->header;
-
-  //project the scan into a point cloud
-  try
-  {
-    projector_.transformLaserScanToPointCloud(message->header.frame_id, *message, cloud, *tf_);
-  }
-  catch (tf::TransformException &ex)
-  {
-    ROS_WARN("High fidelity enabled, but TF returned a transform exception to frame %s: %s", global_frame_.c_str(),
-             ex.what());
-    projector_.projectLaser(*message, cloud);
-  }
-
-  //buffer the point cloud
+  //project the scan straight into the buffer
   buffer->lock();
-  buffer->bufferCloud(cloud);
+  buffer->bufferScan(message, false);
   buffer->unlock();
+  layered_costmap_->requestUpdate();
 }
 
-void ObstacleLayer::laserScanValidInfCallback(const sensor_msgs::LaserScanConstPtr& raw_message, 
+void ObstacleLayer::laserScanValidInfCallback(const sensor_msgs::LaserScanConstPtr& message,
                                               const boost::shared_ptr<ObservationBuffer>& buffer){
-  // Filter positive infinities ("Inf"s) to max_range.
-  float epsilon = 0.0001; // a tenth of a millimeter
-  sensor_msgs::LaserScan message = *raw_message;
-  for( size_t i = 0; i < message.ranges.size(); i++ )
-  {
-    float range = message.ranges[ i ];
-    if( !std::isfinite( range ) && range > 0 )
-    {
-      message.ranges[ i ] = message.range_max - epsilon;
-    }
-  }
-
-  //project the laser into a point cloud
-  sensor_msgs::PointCloud2 cloud;
-  cloud.header = message.header;
-
-  //project the scan into a point cloud
-  try
-  {
-    projector_.transformLaserScanToPointCloud(message.header.frame_id, message, cloud, *tf_);
-  }
-  catch (tf::TransformException &ex)
-  {
-    ROS_WARN ("High fidelity enabled, but TF returned a transform exception to frame %s: %s", global_frame_.c_str (), ex.what ());
-    projector_.projectLaser(message, cloud);
-  }
-
-  //buffer the point cloud
+  //positive infinities ("Inf"s) are projected to max_range by the buffer
   buffer->lock();
-  buffer->bufferCloud(cloud);
+  buffer->bufferScan(message, true);
   buffer->unlock();
+  layered_costmap_->requestUpdate();
 }
 
 void ObstacleLayer::pointCloudCallback(const sensor_msgs::PointCloudConstPtr& message,
                                                const boost::shared_ptr<ObservationBuffer>& buffer)
 {
-  sensor_msgs::PointCloud2 cloud2;
+  sensor_msgs::PointCloud2Ptr cloud2(new sensor_msgs::PointCloud2());
 
-  if (!sensor_msgs::convertPointCloudToPointCloud2(*message, cloud2))
+  if (!sensor_msgs::convertPointCloudToPointCloud2(*message, *cloud2))
   {
     ROS_ERROR("Failed to convert a PointCloud to a PointCloud2, dropping message");
     return;
@@ -280,6 +326,7 @@ void ObstacleLayer::pointCloudCallback(const sensor_msgs::PointCloudConstPtr& me
   buffer->lock();
   buffer->bufferCloud(cloud2);
   buffer->unlock();
+  layered_costmap_->requestUpdate();
 }
 
 void ObstacleLayer::pointCloud2Callback(const sensor_msgs::PointCloud2ConstPtr& message,
@@ -287,36 +334,70 @@ void ObstacleLayer::pointCloud2Callback(const sensor_msgs::PointCloud2ConstPtr&
 {
   //buffer the point cloud
   buffer->lock();
-  buffer->bufferCloud(*message);
+  buffer->bufferCloud(message);
   buffer->unlock();
+  layered_costmap_->requestUpdate();
 }
 
 void ObstacleLayer::checkTimeStamps(double* min_x, double* min_y, double* max_x, double* max_y)
 {
-    if (free_to_default_time_ < 0 && occupied_to_default_time_ < 0)
-        return;
+  // the reconfigure callback runs in another thread, so the trackers pick up new timeouts here
+  free_decay_.setTimeout(free_to_default_time_);
+  occupied_decay_.setTimeout(occupied_to_default_time_);
 
-    double wx, wy;
-    for (unsigned int mx = 0; mx < getSizeInCellsX(); ++mx)
-    {
-        for (unsigned int my = 0; my < getSizeInCellsY(); ++my)
-        {
-            unsigned char value = getCost(mx, my);
-
-            if (value == FREE_SPACE || value == LETHAL_OBSTACLE)
-            {
-                double dt = ros::Time::now().toSec() - getTimeStamp(mx, my);
-
-                if ( (dt > free_to_default_time_ && value == FREE_SPACE) ||
-                     (dt > occupied_to_default_time_ && value == LETHAL_OBSTACLE) )
-                {
-                    setCost(mx, my, NO_INFORMATION);
-                    mapToWorld(mx, my, wx, wy);
-                    touch(wx, wy, min_x, min_y, max_x, max_y);
-                }
-            }
-        }
-    }
+  if (!free_decay_.isEnabled() && !occupied_decay_.isEnabled())
+    return;
+
+  if (!hasTimeStamps())
+  {
+    ROS_WARN_ONCE("%s keeps no cell time stamps (timestamp_bits is 0), cells will not decay", name_.c_str());
+    free_decay_.setTimeout(-1.0);
+    occupied_decay_.setTimeout(-1.0);
+    return;
+  }
+
+  double now = ros::Time::now().toSec();
+
+  // cells written while a tracker was disabled were never queued
+  if (free_decay_.needsSeeding())
+    free_decay_.seed(*this);
+  if (occupied_decay_.needsSeeding())
+    occupied_decay_.seed(*this);
+
+  expired_cells_.clear();
+  free_decay_.expire(*this, now, expired_cells_);
+  occupied_decay_.expire(*this, now, expired_cells_);
+
+  unsigned int mx, my;
+  double wx, wy;
+  for (unsigned int i = 0; i < expired_cells_.size(); ++i)
+  {
+    indexToCells(expired_cells_[i], mx, my);
+    setCost(mx, my, NO_INFORMATION, now);
+    mapToWorld(mx, my, wx, wy);
+    touch(wx, wy, min_x, min_y, max_x, max_y);
+  }
+}
+
+void ObstacleLayer::trackFootprintCells(double stamp)
+{
+  const std::vector<geometry_msgs::Point32>& polygon = footprint_layer_.getTransformedFootprint().polygon.points;
+
+  std::vector<MapLocation> map_polygon;
+  for (unsigned int i = 0; i < polygon.size(); ++i)
+  {
+    MapLocation loc;
+    if (!worldToMap(polygon[i].x, polygon[i].y, loc.x, loc.y))
+      return;
+    map_polygon.push_back(loc);
+  }
+
+  std::vector<MapLocation> polygon_cells;
+  convexFillCells(map_polygon, polygon_cells);
+  for (unsigned int i = 0; i < polygon_cells.size(); ++i)
+  {
+    free_decay_.push(getIndex(polygon_cells[i].x, polygon_cells[i].y), stamp);
+  }
 }
 
 void ObstacleLayer::updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x,
@@ -330,6 +411,7 @@ void ObstacleLayer::updateBounds(double robot_x, double robot_y, double robot_ya
 
   checkTimeStamps(min_x, min_y, max_x, max_y);
 
+  double mark_time = ros::Time::now().toSec();
   bool current = true;
   std::vector<Observation> observations, clearing_observations;
 
@@ -342,67 +424,65 @@ void ObstacleLayer::updateBounds(double robot_x, double robot_y, double robot_ya
   //update the global current status
   current_ = current;
 
-  //raytrace freespace
-  for (unsigned int i = 0; i < clearing_observations.size(); ++i)
+  //a requested full range clearing lets the rays reach across the whole map, once
+  bool full_range;
   {
-    raytraceFreespace(clearing_observations[i], min_x, min_y, max_x, max_y);
+    boost::mutex::scoped_lock lock(full_range_mutex_);
+    full_range = full_range_clearing_;
+    full_range_clearing_ = false;
   }
-
-  //place the new obstacles into a priority queue... each with a priority of zero to begin with
-  for (std::vector<Observation>::const_iterator it = observations.begin(); it != observations.end(); ++it)
+  if (full_range)
   {
-    const Observation& obs = *it;
-
-    const pcl::PointCloud<pcl::PointXYZ>& cloud = *(obs.cloud_);
-
-    double sq_obstacle_range = obs.obstacle_range_ * obs.obstacle_range_;
+    double map_diagonal = hypot(getSizeInMetersX(), getSizeInMetersY());
+    for (unsigned int i = 0; i < clearing_observations.size(); ++i)
+      clearing_observations[i].raytrace_range_ = std::max(clearing_observations[i].raytrace_range_, map_diagonal);
+  }
 
-    for (unsigned int i = 0; i < cloud.points.size(); ++i)
+  //raytrace freespace, all clearing is done before any marking
+  if (raytrace_threads_ > 1)
+    raytraceFreespaceParallel(clearing_observations, min_x, min_y, max_x, max_y);
+  else
+  {
+    for (unsigned int i = 0; i < clearing_observations.size(); ++i)
     {
-      double px = cloud.points[i].x, py = cloud.points[i].y, pz = cloud.points[i].z;
-
-      //if the obstacle is too high or too far away from the robot we won't add it
-      if (pz > max_obstacle_height_)
-      {
-        ROS_DEBUG("The point is too high");
-        continue;
-      }
-
-      //compute the squared distance from the hitpoint to the pointcloud's origin
-      double sq_dist = (px - obs.origin_.x) * (px - obs.origin_.x) + (py - obs.origin_.y) * (py - obs.origin_.y)
-          + (pz - obs.origin_.z) * (pz - obs.origin_.z);
-
-      //if the point is far enough away... we won't consider it
-      if (sq_dist >= sq_obstacle_range)
-      {
-        ROS_DEBUG("The point is too far away");
-        continue;
-      }
-
-      //now we need to compute the map coordinates for the observation
-      unsigned int mx, my;
-      if (!worldToMap(px, py, mx, my))
-      {
-        ROS_DEBUG("Computing map coords failed");
-        continue;
-      }
-
-      setCost(mx, my, LETHAL_OBSTACLE);
-      touch(px, py, min_x, min_y, max_x, max_y);
+      raytraceFreespace(clearing_observations[i], min_x, min_y, max_x, max_y);
     }
   }
 
+  //place the new obstacles into a priority queue... each with a priority of zero to begin with
+  markObstacles(observations, mark_time, min_x, min_y, max_x, max_y);
+
   footprint_layer_.updateBounds(robot_x, robot_y, robot_yaw, min_x, min_y, max_x, max_y);
 }
 
 void ObstacleLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j)
+{
+  if (!enabled_)
+    return;
+
+  prepareTiles(min_i, min_j, max_i, max_j);
+  updateTile(master_grid, min_i, min_j, max_i, max_j);
+}
+
+void ObstacleLayer::prepareTiles(int min_i, int min_j, int max_i, int max_j)
 {
   if (!enabled_)
     return;
 
   // The footprint layer clears the footprint in this ObstacleLayer
   // before we merge this obstacle layer into the master_grid.
-  footprint_layer_.updateCosts(*this, min_i, min_j, max_i, max_j);
+  if (footprint_clearing_in_costs_)
+  {
+    footprint_layer_.updateCosts(*this, min_i, min_j, max_i, max_j);
+    if (free_decay_.isEnabled())
+      trackFootprintCells(footprint_layer_.getTransformedFootprint().header.stamp.toSec());
+  }
+}
+
+void ObstacleLayer::updateTile(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j)
+{
+  if (!enabled_)
+    return;
 
   if(combination_method_==0)
     updateWithOverwrite(master_grid, min_i, min_j, max_i, max_j);
@@ -441,6 +521,21 @@ bool ObstacleLayer::getMarkingObservations(std::vector<Observation>& marking_obs
   return current;
 }
 
+bool ObstacleLayer::requestFullRangeClearing()
+{
+  if (!enabled_)
+    return false;
+  boost::mutex::scoped_lock lock(full_range_mutex_);
+  full_range_clearing_ = true;
+  return true;
+}
+
+bool ObstacleLayer::isFullRangeClearingPending()
+{
+  boost::mutex::scoped_lock lock(full_range_mutex_);
+  return full_range_clearing_;
+}
+
 bool ObstacleLayer::getClearingObservations(std::vector<Observation>& clearing_observations) const
 {
   bool current = true;
@@ -457,12 +552,21 @@ bool ObstacleLayer::getClearingObservations(std::vector<Observation>& clearing_o
   return current;
 }
 
+/**
+ * @brief  The absolute angle between two directions given in [-pi, pi]
+ */
+static inline double angleBetween(double a, double b)
+{
+  double d = fabs(a - b);
+  return d > M_PI ? 2 * M_PI - d : d;
+}
+
 void ObstacleLayer::raytraceFreespace(const Observation& clearing_observation, double* min_x, double* min_y,
                                               double* max_x, double* max_y)
 {
   double ox = clearing_observation.origin_.x;
   double oy = clearing_observation.origin_.y;
-  pcl::PointCloud < pcl::PointXYZ > cloud = *(clearing_observation.cloud_);
+  const pcl::PointCloud < pcl::PointXYZ > &cloud = *(clearing_observation.cloud_);
 
   //get the map coordinates of the origin of the sensor
   unsigned int x0, y0;
@@ -474,66 +578,377 @@ void ObstacleLayer::raytraceFreespace(const Observation& clearing_observation, d
     return;
   }
 
-  //we can pre-compute the enpoints of the map outside of the inner loop... we'll need these later
+  touch(ox, oy, min_x, min_y, max_x, max_y);
+
+  //all the rays of one observation are stamped with the same time
+  unsigned int cell_raytrace_range = cellDistance(clearing_observation.raytrace_range_);
+  TrackedMarkCell marker(costmap_, timestamps_, FREE_SPACE, ros::Time::now().toSec(), free_decay_);
+
+  //rays from the origin cell to the same end cell are the same line, each is traced once
+  beginCellPass();
+
+  //with sector clearing the endpoints are collected and the wedges between them are filled afterwards
+  bool sectors = clearing_observation.sector_angle_ > 0.0;
+  std::vector<SectorPoint> sector_points;
+  if (sectors)
+    sector_points.reserve(cloud.points.size());
+
+  //for each point in the cloud, we want to trace a line from the origin and clear obstacles along it
+  for (unsigned int i = 0; i < cloud.points.size(); ++i)
+  {
+    double wx = cloud.points[i].x;
+    double wy = cloud.points[i].y;
+    unsigned int x1, y1;
+    if (!clipRayEnd(ox, oy, wx, wy, x1, y1))
+      continue;
+
+    updateRaytraceBounds(ox, oy, wx, wy, clearing_observation.raytrace_range_, min_x, min_y, max_x, max_y);
+    if (sectors)
+    {
+      //cells hit by the scan are not cleared, just like raytraceLine() stops in front of them
+      double range = hypot(wx - ox, wy - oy);
+      if (range > clearing_observation.raytrace_range_)
+      {
+        double t = clearing_observation.raytrace_range_ / range;
+        wx = ox + (wx - ox) * t;
+        wy = oy + (wy - oy) * t;
+      }
+      else
+        firstVisit(getIndex(x1, y1));
+
+      SectorPoint point;
+      point.x = (wx - origin_x_) / resolution_;
+      point.y = (wy - origin_y_) / resolution_;
+      point.angle = atan2(wy - oy, wx - ox);
+      point.cell_x = x1;
+      point.cell_y = y1;
+      sector_points.push_back(point);
+      continue;
+    }
+
+    if (!firstVisit(getIndex(x1, y1)))
+      continue;
+
+    //and finally... we can execute our trace to clear obstacles along that line
+    raytraceLine(marker, x0, y0, x1, y1, cell_raytrace_range);
+  }
+
+  if (!sectors)
+    return;
+
+  double sx = (ox - origin_x_) / resolution_;
+  double sy = (oy - origin_y_) / resolution_;
+  unsigned int origin_index = getIndex(x0, y0);
+  if (firstVisit(origin_index))
+    marker(origin_index);
+
+  for (unsigned int i = 0; i < sector_points.size(); ++i)
+  {
+    const SectorPoint& point = sector_points[i];
+    bool joins_previous = i > 0
+        && angleBetween(point.angle, sector_points[i - 1].angle) <= clearing_observation.sector_angle_;
+    bool joins_next = i + 1 < sector_points.size()
+        && angleBetween(sector_points[i + 1].angle, point.angle) <= clearing_observation.sector_angle_;
+
+    //the rays on the border of a sector are traced so the cells along it are cleared like before
+    if (!joins_previous || !joins_next)
+    {
+      MarkUnvisitedCell<TrackedMarkCell> unvisited(*this, marker);
+      raytraceLine(unvisited, x0, y0, point.cell_x, point.cell_y, cell_raytrace_range);
+    }
+
+    if (joins_previous)
+      fillSector(marker, sx, sy, sector_points[i - 1].x, sector_points[i - 1].y, point.x, point.y);
+  }
+}
+
+bool ObstacleLayer::clipRayEnd(double ox, double oy, double& wx, double& wy, unsigned int& x1, unsigned int& y1) const
+{
+  //the endpoints of the map
   double origin_x = origin_x_, origin_y = origin_y_;
   double map_end_x = origin_x + size_x_ * resolution_;
   double map_end_y = origin_y + size_y_ * resolution_;
 
+  //now we also need to make sure that the enpoint we're raytracing
+  //to isn't off the costmap and scale if necessary
+  double a = wx - ox;
+  double b = wy - oy;
+
+  //the minimum value to raytrace from is the origin
+  if (wx < origin_x)
+  {
+    double t = (origin_x - ox) / a;
+    wx = origin_x;
+    wy = oy + b * t;
+  }
+  if (wy < origin_y)
+  {
+    double t = (origin_y - oy) / b;
+    wx = ox + a * t;
+    wy = origin_y;
+  }
+
+  //the maximum value to raytrace to is the end of the map
+  if (wx > map_end_x)
+  {
+    double t = (map_end_x - ox) / a;
+    wx = map_end_x - .001;
+    wy = oy + b * t;
+  }
+  if (wy > map_end_y)
+  {
+    double t = (map_end_y - oy) / b;
+    wx = ox + a * t;
+    wy = map_end_y - .001;
+  }
+
+  //now that the vector is scaled correctly... we'll get the map coordinates of its endpoint
+  //and check for legality just in case
+  return worldToMapFast(wx, wy, x1, y1);
+}
+
+void ObstacleLayer::collectClearingRays(const Observation& clearing_observation, std::vector<ClearingRay>& rays,
+                                        double* min_x, double* min_y, double* max_x, double* max_y)
+{
+  double ox = clearing_observation.origin_.x;
+  double oy = clearing_observation.origin_.y;
+  const pcl::PointCloud < pcl::PointXYZ > &cloud = *(clearing_observation.cloud_);
+
+  ClearingRay ray;
+  if (!worldToMap(ox, oy, ray.x0, ray.y0))
+  {
+    ROS_WARN_THROTTLE(
+        1.0, "The origin for the sensor at (%.2f, %.2f) is out of map bounds. So, the costmap cannot raytrace for it.",
+        ox, oy);
+    return;
+  }
 
   touch(ox, oy, min_x, min_y, max_x, max_y);
+  ray.max_length = cellDistance(clearing_observation.raytrace_range_);
 
-  //for each point in the cloud, we want to trace a line from the origin and clear obstacles along it
+  //rays to the same end cell are collected once, the same as in raytraceFreespace()
+  beginCellPass();
   for (unsigned int i = 0; i < cloud.points.size(); ++i)
   {
     double wx = cloud.points[i].x;
     double wy = cloud.points[i].y;
+    if (!clipRayEnd(ox, oy, wx, wy, ray.x1, ray.y1))
+      continue;
+
+    updateRaytraceBounds(ox, oy, wx, wy, clearing_observation.raytrace_range_, min_x, min_y, max_x, max_y);
+    if (firstVisit(getIndex(ray.x1, ray.y1)))
+      rays.push_back(ray);
+  }
+}
+
+void ObstacleLayer::raytraceFreespaceParallel(const std::vector<Observation>& clearing_observations, double* min_x,
+                                              double* min_y, double* max_x, double* max_y)
+{
+  std::vector<ClearingRay> rays;
+  std::vector<unsigned int> sector_observations;
+  for (unsigned int i = 0; i < clearing_observations.size(); ++i)
+  {
+    if (clearing_observations[i].sector_angle_ > 0.0)
+      sector_observations.push_back(i);
+    else
+      collectClearingRays(clearing_observations[i], rays, min_x, min_y, max_x, max_y);
+  }
+
+  //all rays are stamped with the same time, so every band writes the same values in the same order
+  //as a single thread would, the decay tracker is fed afterwards since it is not thread safe
+  double stamp = ros::Time::now().toSec();
+  uint32_t tick = timestamps_.encode(stamp);
+  unsigned int bands = std::min(raytrace_threads_, size_y_);
+  std::vector<std::vector<unsigned int> > cleared(bands);
+  bool track = free_decay_.isEnabled();
+
+  TaskGroup workers;
+  for (unsigned int band = 1; band < bands; ++band)
+  {
+    workers.run(
+        boost::bind(&ObstacleLayer::raytraceBand, this, boost::cref(rays), tick, band * size_y_ / bands,
+                    (band + 1) * size_y_ / bands, track ? &cleared[band] : NULL));
+  }
+  if (bands > 0)
+    raytraceBand(rays, tick, 0, size_y_ / bands, track ? &cleared[0] : NULL);
+  workers.wait();
+
+  for (unsigned int band = 0; band < cleared.size(); ++band)
+  {
+    for (unsigned int i = 0; i < cleared[band].size(); ++i)
+      free_decay_.push(cleared[band][i], stamp);
+  }
+
+  //sector clearing shares the pass of firstVisit() between cells, it runs on this thread
+  for (unsigned int i = 0; i < sector_observations.size(); ++i)
+  {
+    raytraceFreespace(clearing_observations[sector_observations[i]], min_x, min_y, max_x, max_y);
+  }
+}
+
+void ObstacleLayer::raytraceBand(const std::vector<ClearingRay>& rays, uint32_t tick, unsigned int first_row,
+                                 unsigned int end_row, std::vector<unsigned int>* cleared)
+{
+  ClearCellInBand clear(costmap_, timestamps_, tick, first_row * size_x_, end_row * size_x_, cleared);
+  for (unsigned int i = 0; i < rays.size(); ++i)
+  {
+    const ClearingRay& ray = rays[i];
+
+    //rays that do not reach the band are not walked at all
+    if (std::max(ray.y0, ray.y1) < first_row || std::min(ray.y0, ray.y1) >= end_row)
+      continue;
+    raytraceLine(clear, ray.x0, ray.y0, ray.x1, ray.y1, ray.max_length);
+  }
+}
+
+void ObstacleLayer::markObstacles(const std::vector<Observation>& observations, double mark_time, double* min_x,
+                                  double* min_y, double* max_x, double* max_y)
+{
+  unsigned int num_points = 0;
+  for (unsigned int i = 0; i < observations.size(); ++i)
+    num_points += observations[i].cloud_->points.size();
+
+  //few points are not worth waking the threads for
+  unsigned int batches = std::max(1u, std::min(raytrace_threads_, num_points / 1024));
+  mark_batches_.resize(batches);
 
-    //now we also need to make sure that the enpoint we're raytracing
-    //to isn't off the costmap and scale if necessary
-    double a = wx - ox;
-    double b = wy - oy;
+  TaskGroup workers;
+  for (unsigned int batch = 1; batch < batches; ++batch)
+  {
+    workers.run(
+        boost::bind(&ObstacleLayer::collectMarks, this, &observations, (unsigned int)((uint64_t)batch * num_points / batches),
+                    (unsigned int)((uint64_t)(batch + 1) * num_points / batches), &mark_batches_[batch]));
+  }
+  collectMarks(&observations, 0, num_points / batches, &mark_batches_[0]);
+  workers.wait();
+
+  beginCellPass();
+  unsigned int new_obstacles = 0;
+  for (unsigned int batch = 0; batch < batches; ++batch)
+  {
+    const MarkBatch& marks = mark_batches_[batch];
+    if (marks.cells.empty())
+      continue;
+    touch(marks.min_x, marks.min_y, min_x, min_y, max_x, max_y);
+    touch(marks.max_x, marks.max_y, min_x, min_y, max_x, max_y);
 
-    //the minimum value to raytrace from is the origin
-    if (wx < origin_x)
+    for (unsigned int i = 0; i < marks.cells.size(); ++i)
     {
-      double t = (origin_x - ox) / a;
-      wx = origin_x;
-      wy = oy + b * t;
+      unsigned int index = marks.cells[i];
+      if (!firstVisit(index))
+        continue;
+
+      if (costmap_[index] != LETHAL_OBSTACLE)
+        new_obstacles++;
+      costmap_[index] = LETHAL_OBSTACLE;
+      timestamps_.set(index, mark_time);
+      occupied_decay_.push(index, mark_time);
     }
-    if (wy < origin_y)
+  }
+  if (new_obstacles > 0)
+    layered_costmap_->addNewObstacles(new_obstacles);
+}
+
+void ObstacleLayer::collectMarks(const std::vector<Observation>* observations, unsigned int first, unsigned int end,
+                                 MarkBatch* batch) const
+{
+  batch->cells.clear();
+  batch->min_x = batch->min_y = std::numeric_limits<double>::max();
+  batch->max_x = batch->max_y = -std::numeric_limits<double>::max();
+
+  unsigned int offset = 0;
+  for (std::vector<Observation>::const_iterator it = observations->begin(); it != observations->end() && offset < end;
+       ++it)
+  {
+    const Observation& obs = *it;
+
+    const pcl::PointCloud<pcl::PointXYZ>& cloud = *(obs.cloud_);
+    unsigned int size = cloud.points.size();
+    if (offset + size <= first)
     {
-      double t = (origin_y - oy) / b;
-      wx = ox + a * t;
-      wy = origin_y;
+      offset += size;
+      continue;
     }
 
-    //the maximum value to raytrace to is the end of the map
-    if (wx > map_end_x)
+    double sq_obstacle_range = obs.obstacle_range_ * obs.obstacle_range_;
+
+    unsigned int begin_point = first > offset ? first - offset : 0;
+    unsigned int end_point = std::min(size, end - offset);
+    for (unsigned int i = begin_point; i < end_point; ++i)
     {
-      double t = (map_end_x - ox) / a;
-      wx = map_end_x - .001;
-      wy = oy + b * t;
+      double px = cloud.points[i].x, py = cloud.points[i].y, pz = cloud.points[i].z;
+
+      //if the obstacle is too high or too far away from the robot we won't add it
+      if (pz > max_obstacle_height_)
+      {
+        ROS_DEBUG("The point is too high");
+        continue;
+      }
+
+      //compute the squared distance from the hitpoint to the pointcloud's origin
+      double sq_dist = (px - obs.origin_.x) * (px - obs.origin_.x) + (py - obs.origin_.y) * (py - obs.origin_.y)
+          + (pz - obs.origin_.z) * (pz - obs.origin_.z);
+
+      //if the point is far enough away... we won't consider it
+      if (sq_dist >= sq_obstacle_range)
+      {
+        ROS_DEBUG("The point is too far away");
+        continue;
+      }
+
+      //now we need to compute the map coordinates for the observation
+      unsigned int mx, my;
+      if (!worldToMapFast(px, py, mx, my))
+      {
+        ROS_DEBUG("Computing map coords failed");
+        continue;
+      }
+
+      batch->min_x = std::min(px, batch->min_x);
+      batch->min_y = std::min(py, batch->min_y);
+      batch->max_x = std::max(px, batch->max_x);
+      batch->max_y = std::max(py, batch->max_y);
+      batch->cells.push_back(getIndex(mx, my));
     }
-    if (wy > map_end_y)
+    offset += size;
+  }
+}
+
+void ObstacleLayer::fillSector(TrackedMarkCell& marker, double x0, double y0, double x1, double y1, double x2,
+                               double y2)
+{
+  double ys[3] = {y0, y1, y2};
+  double xs[3] = {x0, x1, x2};
+  double low = std::min(y0, std::min(y1, y2));
+  double high = std::max(y0, std::max(y1, y2));
+
+  //walk the rows whose centers lie in the triangle and clear the cells of their span
+  int first_row = std::max(0, (int)ceil(low - 0.5));
+  int last_row = std::min((int)size_y_ - 1, (int)floor(high - 0.5));
+  for (int row = first_row; row <= last_row; ++row)
+  {
+    double yc = row + 0.5;
+    double left = std::numeric_limits<double>::max(), right = -std::numeric_limits<double>::max();
+    for (unsigned int j = 0; j < 3; ++j)
     {
-      double t = (map_end_y - oy) / b;
-      wx = ox + a * t;
-      wy = map_end_y - .001;
+      unsigned int k = (j + 1) % 3;
+      if ((ys[j] <= yc) == (ys[k] <= yc))
+        continue;
+      double x = xs[j] + (yc - ys[j]) * (xs[k] - xs[j]) / (ys[k] - ys[j]);
+      left = std::min(left, x);
+      right = std::max(right, x);
     }
-
-    //now that the vector is scaled correctly... we'll get the map coordinates of its endpoint
-    unsigned int x1, y1;
-
-    //check for legality just in case
-    if (!worldToMap(wx, wy, x1, y1))
+    if (left > right)
       continue;
 
-    unsigned int cell_raytrace_range = cellDistance(clearing_observation.raytrace_range_);
-    MarkCell marker(costmap_, timestamps_, FREE_SPACE, ros::Time::now().toSec());
-    //and finally... we can execute our trace to clear obstacles along that line
-    raytraceLine(marker, x0, y0, x1, y1, cell_raytrace_range);
-
-    updateRaytraceBounds(ox, oy, wx, wy, clearing_observation.raytrace_range_, min_x, min_y, max_x, max_y);
+    int first_col = std::max(0, (int)ceil(left - 0.5));
+    int last_col = std::min((int)size_x_ - 1, (int)floor(right - 0.5));
+    for (int col = first_col; col <= last_col; ++col)
+    {
+      unsigned int index = getIndex(col, row);
+      if (firstVisit(index))
+        marker(index);
+    }
   }
 }
 
@@ -561,6 +976,22 @@ void ObstacleLayer::deactivate()
   }
 }
 
+void ObstacleLayer::beginCellPass()
+{
+  if (cell_pass_.size() != size_x_ * size_y_)
+  {
+    cell_pass_.assign(size_x_ * size_y_, 0);
+    pass_ = 0;
+  }
+
+  //when the counter wraps around old marks would look current, so they are cleared
+  if (++pass_ == 0)
+  {
+    std::fill(cell_pass_.begin(), cell_pass_.end(), 0);
+    pass_ = 1;
+  }
+}
+
 void ObstacleLayer::updateRaytraceBounds(double ox, double oy, double wx, double wy, double range, double* min_x, double* min_y,
 					 double* max_x, double* max_y)
 {
@@ -575,10 +1006,31 @@ void ObstacleLayer::reset()
 {
     deactivate();
     resetMaps();
+    free_decay_.clear();
+    occupied_decay_.clear();
     current_ = true;
     activate();
 }
 
+void ObstacleLayer::matchSize()
+{
+  CostmapLayer::matchSize();
+  free_decay_.resize(size_x_, size_y_);
+  occupied_decay_.resize(size_x_, size_y_);
+}
+
+void ObstacleLayer::updateOrigin(double new_origin_x, double new_origin_y)
+{
+  int cell_ox = int((new_origin_x - origin_x_) / resolution_);
+  int cell_oy = int((new_origin_y - origin_y_) / resolution_);
+
+  Costmap2D::updateOrigin(new_origin_x, new_origin_y);
+
+  // the queued indices have to follow the data
+  free_decay_.shift(cell_ox, cell_oy);
+  occupied_decay_.shift(cell_ox, cell_oy);
+}
+
 void ObstacleLayer::onFootprintChanged()
 {
   footprint_layer_.onFootprintChanged();
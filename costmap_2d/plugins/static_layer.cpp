@@ -1,5 +1,6 @@
 #include<costmap_2d/static_layer.h>
 #include<costmap_2d/costmap_math.h>
+#include<costmap_2d/cost_combination.h>
 #include <pluginlib/class_list_macros.h>
 
 PLUGINLIB_EXPORT_CLASS(costmap_2d::StaticLayer, costmap_2d::Layer)
@@ -11,6 +12,74 @@ using costmap_2d::FREE_SPACE;
 namespace costmap_2d
 {
 
+namespace
+{
+
+// How the resampled cost of a master cell is combined with it, the cost is never NO_INFORMATION
+
+struct OverwriteCost
+{
+  static unsigned char combine(unsigned char master, unsigned char cost)
+  {
+    return cost;
+  }
+};
+
+// use_maximum while tracking unknown space: only obstacles overwrite unknown master cells
+struct MaxKeepUnknown
+{
+  static unsigned char combine(unsigned char master, unsigned char cost)
+  {
+    return cost == LETHAL_OBSTACLE ? cost : std::max(cost, master);
+  }
+};
+
+// use_maximum without tracking unknown space: unknown master cells take the cost
+struct MaxOverwriteUnknown
+{
+  static unsigned char combine(unsigned char master, unsigned char cost)
+  {
+    return master == NO_INFORMATION ? cost : std::max(cost, master);
+  }
+};
+
+// Combine the map into a master grid of another geometry, row by row. A master cell covering several map
+// cells takes the highest of them if Pooled, else the map cell under its center.
+template <class Combination, bool Pooled>
+void resampleCosts(const StaticGrid& grid, Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j)
+{
+  unsigned char* master = master_grid.getCharMap();
+  double half_cell = master_grid.getResolution() / 2;
+  unsigned int mx, my;
+  double wx, wy;
+  for (int j = min_j; j < max_j; ++j)
+  {
+    unsigned char* row = master + master_grid.getIndex(0, j);
+    for (int i = min_i; i < max_i; ++i)
+    {
+      master_grid.mapToWorld(i, j, wx, wy);
+      if (!grid.worldToMap(wx, wy, mx, my))
+        continue;
+      unsigned char cost = Pooled ? grid.pooledCost(wx, wy, half_cell) : grid.costs[my * grid.size_x + mx];
+      if (cost != NO_INFORMATION)
+        row[i] = Combination::combine(row[i], cost);
+    }
+  }
+}
+
+// Pick the sampling once for a combination
+template <class Combination>
+void resampleCosts(const StaticGrid& grid, Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j)
+{
+  // a master cell covering several map cells must not miss a thin wall between their centers
+  if (master_grid.getResolution() > grid.resolution)
+    resampleCosts<Combination, true>(grid, master_grid, min_i, min_j, max_i, max_j);
+  else
+    resampleCosts<Combination, false>(grid, master_grid, min_i, min_j, max_i, max_j);
+}
+
+}  // namespace
+
 StaticLayer::StaticLayer() : dsrv_(NULL) {}
 
 StaticLayer::~StaticLayer()
@@ -24,14 +93,20 @@ void StaticLayer::onInitialize()
   ros::NodeHandle nh("~/" + name_), g_nh;
   current_ = true;
 
+  // the static map does not decay, so there is no need to stamp its cells
+  setTimeStampPrecision(CellTimeStamps::NONE, 0.0);
+
   global_frame_ = layered_costmap_->getGlobalFrameID();
 
   std::string map_topic;
   nh.param("map_topic", map_topic, std::string("map"));
   nh.param("subscribe_to_updates", subscribe_to_updates_, false);
+  nh.param("map_segment", map_segment_, std::string(""));
   
   nh.param("track_unknown_space", track_unknown_space_, true);
   nh.param("use_maximum", use_maximum_, false);
+  nh.param("resolution", resolution_, 0.0);
+  nh.param("map_cache_size", map_cache_size_, 0);
 
   int temp_lethal_threshold, temp_unknown_cost_value;
   nh.param("lethal_cost_threshold", temp_lethal_threshold, int(100));
@@ -40,9 +115,14 @@ void StaticLayer::onInitialize()
 
   lethal_threshold_ = std::max(std::min(temp_lethal_threshold, 100), 0);
   unknown_cost_value_ = temp_unknown_cost_value;
+  updateCostLut();
+
   //we'll subscribe to the latched topic that the map server uses
   ROS_INFO("Requesting the map...");
-  map_sub_ = g_nh.subscribe(map_topic, 1, &StaticLayer::incomingMap, this);
+  if (map_segment_.empty())
+    map_sub_ = g_nh.subscribe(map_topic, 1, &StaticLayer::incomingMap, this);
+  else
+    map_sub_ = g_nh.subscribe(map_topic + "_metadata", 1, &StaticLayer::incomingMetaData, this);
   map_received_ = false;
   has_updated_data_ = false;
 
@@ -53,7 +133,7 @@ void StaticLayer::onInitialize()
     r.sleep();
   }
 
-  ROS_INFO("Received a %d X %d map at %f m/pix", getSizeInCellsX(), getSizeInCellsY(), getResolution());
+  ROS_INFO("Received a %d X %d map at %f m/pix", grid_->size_x, grid_->size_y, grid_->resolution);
   
   if(subscribe_to_updates_)
   {
@@ -77,10 +157,11 @@ void StaticLayer::reconfigureCB(costmap_2d::GenericPluginConfig &config, uint32_
   if (config.enabled != enabled_)
   {
     enabled_ = config.enabled;
+    boost::recursive_mutex::scoped_lock lock(lock_);
     has_updated_data_ = true;
     x_ = y_ = 0;
-    width_ = size_x_;
-    height_ = size_y_;
+    width_ = grid_ ? grid_->size_x : 0;
+    height_ = grid_ ? grid_->size_y : 0;
   }
 }
 
@@ -100,59 +181,128 @@ unsigned char StaticLayer::interpretValue(unsigned char value)
   return scale * LETHAL_OBSTACLE;
 }
 
+void StaticLayer::updateCostLut()
+{
+  for (unsigned int value = 0; value < 256; ++value)
+    cost_lut_[value] = interpretValue(value);
+}
+
 void StaticLayer::incomingMap(const nav_msgs::OccupancyGridConstPtr& new_map)
 {
   unsigned int size_x = new_map->info.width, size_y = new_map->info.height;
 
   ROS_DEBUG("Received a %d X %d map at %f m/pix", size_x, size_y, new_map->info.resolution);
 
+  // a coarser resolution keeps the extent of the map with fewer cells, each holding the highest cost under it
+  double resolution = new_map->info.resolution;
+  unsigned int master_x = size_x, master_y = size_y;
+  if (resolution_ > resolution)
+  {
+    master_x = (unsigned int)ceil(size_x * resolution / resolution_);
+    master_y = (unsigned int)ceil(size_y * resolution / resolution_);
+    resolution = resolution_;
+  }
+
   // resize costmap if size, resolution or origin do not match
   Costmap2D* master = layered_costmap_->getCostmap();
-  if (!layered_costmap_->isRolling() && (master->getSizeInCellsX() != size_x ||
-      master->getSizeInCellsY() != size_y ||
-      master->getResolution() != new_map->info.resolution ||
+  if (!layered_costmap_->isRolling() && (master->getSizeInCellsX() != master_x ||
+      master->getSizeInCellsY() != master_y ||
+      master->getResolution() != resolution ||
       master->getOriginX() != new_map->info.origin.position.x ||
       master->getOriginY() != new_map->info.origin.position.y ||
       !layered_costmap_->isSizeLocked()))
   {
-    ROS_INFO("Resizing costmap to %d X %d at %f m/pix", size_x, size_y, new_map->info.resolution);
-    layered_costmap_->resizeMap(size_x, size_y, new_map->info.resolution, new_map->info.origin.position.x,
+    ROS_INFO("Resizing costmap to %d X %d at %f m/pix", master_x, master_y, resolution);
+    layered_costmap_->resizeMap(master_x, master_y, resolution, new_map->info.origin.position.x,
                                 new_map->info.origin.position.y, true);
-  }else if(size_x_ != size_x || size_y_ != size_y ||
-      resolution_ != new_map->info.resolution ||
-      origin_x_ != new_map->info.origin.position.x ||
-      origin_y_ != new_map->info.origin.position.y){
-    resizeMap(size_x, size_y, new_map->info.resolution, new_map->info.origin.position.x, new_map->info.origin.position.y);
   }
 
-  unsigned int index = 0;
-
-  //initialize the costmap with static data
-  for (unsigned int i = 0; i < size_y; ++i)
+  // the converted map is shared with the static layers of the other costmaps of this node, and
+  // a map the map server switches back to is not converted again
+  boost::recursive_mutex::scoped_lock lock(lock_);
+  StaticGridConstPtr grid = takeCachedGrid(new_map->info);
+  if (!grid)
   {
-    for (unsigned int j = 0; j < size_x; ++j)
-    {
-      unsigned char value = new_map->data[index];
-      setCost(j, i, interpretValue(value));
-      ++index;
-    }
+    lock.unlock();
+    grid = convertStaticMap(new_map, cost_lut_);
+    lock.lock();
   }
+
+  cacheGrid();
+  grid_ = grid;
+  map_load_time_ = new_map->info.map_load_time;
+  own_grid_.reset();
   x_ = y_ = 0;
-  width_ = size_x_;
-  height_ = size_y_;
+  width_ = size_x;
+  height_ = size_y;
   map_received_ = true;
   has_updated_data_ = true;
 }
 
+void StaticLayer::cacheGrid()
+{
+  // only maps with a load time can be told apart when they come back
+  if (map_cache_size_ <= 0 || !grid_ || map_load_time_.isZero())
+    return;
+
+  map_cache_.push_front(std::make_pair(map_load_time_, grid_));
+  if (map_cache_.size() > (size_t)map_cache_size_)
+    map_cache_.pop_back();
+}
+
+StaticGridConstPtr StaticLayer::takeCachedGrid(const nav_msgs::MapMetaData& info)
+{
+  for (std::list<std::pair<ros::Time, StaticGridConstPtr> >::iterator it = map_cache_.begin();
+       it != map_cache_.end(); ++it)
+  {
+    if (it->first == info.map_load_time && it->second->sameGeometry(info.width, info.height, info.resolution,
+                                                                     info.origin.position.x, info.origin.position.y))
+    {
+      StaticGridConstPtr grid = it->second;
+      map_cache_.erase(it);
+      return grid;
+    }
+  }
+  return StaticGridConstPtr();
+}
+
+void StaticLayer::incomingMetaData(const nav_msgs::MapMetaDataConstPtr& meta_data)
+{
+  nav_msgs::OccupancyGridConstPtr map = readStaticMapSegment(map_segment_, meta_data->map_load_time);
+  if (!map)
+  {
+    ROS_WARN("The shared memory segment %s does not hold the announced map", map_segment_.c_str());
+    return;
+  }
+  incomingMap(map);
+}
+
+StaticGrid& StaticLayer::writableGrid()
+{
+  if (!own_grid_)
+  {
+    own_grid_.reset(new StaticGrid(*grid_));
+    grid_ = own_grid_;
+  }
+  return *own_grid_;
+}
+
 void StaticLayer::incomingUpdate(const map_msgs::OccupancyGridUpdateConstPtr& update)
 {
+    boost::recursive_mutex::scoped_lock lock(lock_);
+    if (!grid_)
+      return;
+
+    StaticGrid& grid = writableGrid();
     unsigned int di = 0;
     for (unsigned int y = 0; y < update->height ; y++)
     {
-        unsigned int index_base = (update->y + y) * update->width;
         for (unsigned int x = 0; x < update->width ; x++)
         {
-            setCost(x, y, update->data[di++]);
+            unsigned int mx = update->x + x, my = update->y + y;
+            unsigned char value = (unsigned char)update->data[di++];
+            if (mx < grid.size_x && my < grid.size_y)
+              grid.costs[my * grid.size_x + mx] = cost_lut_[value];
         }
     }
     x_ = update->x;
@@ -191,13 +341,16 @@ void StaticLayer::updateBounds(double robot_x, double robot_y, double robot_yaw,
     
   useExtraBounds(min_x, min_y, max_x, max_y);
 
+  boost::recursive_mutex::scoped_lock lock(lock_);
   double wx, wy;
   
-  mapToWorld(x_, y_, wx, wy);
+  wx = grid_->origin_x + (x_ + 0.5) * grid_->resolution;
+  wy = grid_->origin_y + (y_ + 0.5) * grid_->resolution;
   *min_x = std::min(wx, *min_x);
   *min_y = std::min(wy, *min_y);
   
-  mapToWorld(x_ + width_, y_ + height_, wx, wy);
+  wx = grid_->origin_x + (x_ + width_ + 0.5) * grid_->resolution;
+  wy = grid_->origin_y + (y_ + height_ + 0.5) * grid_->resolution;
   *max_x = std::max(wx, *max_x);
   *max_y = std::max(wy, *max_y);
   
@@ -210,50 +363,39 @@ void StaticLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int
   if (!enabled_)
     return;
 
-  if (!map_received_)
+  if (!map_received_ || max_i <= min_i)
     return;
 
-  if (!layered_costmap_->isRolling())
+  // map updates change a grid only this layer holds in place, so it is read under the lock
+  boost::recursive_mutex::scoped_lock lock(lock_);
+  const StaticGridConstPtr& grid = grid_;
+
+  if (!layered_costmap_->isRolling() && grid->sameGeometry(master_grid.getSizeInCellsX(), master_grid.getSizeInCellsY(),
+      master_grid.getResolution(), master_grid.getOriginX(), master_grid.getOriginY()))
   {
-    if(!use_maximum_)
-      updateWithTrueOverwrite(master_grid, min_i, min_j, max_i, max_j);
+    unsigned char* master = master_grid.getCharMap();
+    const unsigned char* costs = &grid->costs[0];
+    unsigned int span = master_grid.getSizeInCellsX();
+    if (!use_maximum_)
+    {
+      for (int j = min_j; j < max_j; j++)
+        memcpy(master + span * j + min_i, costs + span * j + min_i, max_i - min_i);
+    }
     else
-      updateWithMax(master_grid, min_i, min_j, max_i, max_j);
+    {
+      for (int j = min_j; j < max_j; j++)
+        combineMax(master + span * j + min_i, costs + span * j + min_i, max_i - min_i);
+    }
   }
   else
   {
-    unsigned int mx, my;
-    double wx, wy;
-    for (unsigned int i = min_i; i < max_i; ++i)
-    {
-      for (unsigned int j = min_j; j < max_j; ++j)
-      {
-        layered_costmap_->getCostmap()->mapToWorld(i, j, wx, wy);
-        if (worldToMap(wx, wy, mx, my))
-        {
-          unsigned char cost = getCost(mx, my);
-          if (cost == NO_INFORMATION)
-              continue;
-
-          if(!use_maximum_)
-            master_grid.setCost(i, j, cost);
-          else
-          {
-            unsigned char old_cost = master_grid.getCost(i, j);
-			if (track_unknown_space_)
-			  if (cost == LETHAL_OBSTACLE)
-			    master_grid.setCost(i, j, cost);
-		      else
-			    master_grid.setCost(i, j, std::max(cost, old_cost));
-			else
-			  if (old_cost == NO_INFORMATION)
-			    master_grid.setCost(i, j, cost);
-		      else
-			    master_grid.setCost(i, j, std::max(cost, old_cost));
-          }
-        }
-      }
-    }
+    // the combination is picked once, so the loop over the cells does not branch on the parameters
+    if (!use_maximum_)
+      resampleCosts<OverwriteCost>(*grid, master_grid, min_i, min_j, max_i, max_j);
+    else if (track_unknown_space_)
+      resampleCosts<MaxKeepUnknown>(*grid, master_grid, min_i, min_j, max_i, max_j);
+    else
+      resampleCosts<MaxOverwriteUnknown>(*grid, master_grid, min_i, min_j, max_i, max_j);
   }
 }
 
@@ -1,8 +1,9 @@
 #include <costmap_2d/voxel_layer.h>
+#include <costmap_2d/grid_compression.h>
+#include <costmap_2d/executor.h>
 #include <pluginlib/class_list_macros.h>
 #include <pcl_conversions/pcl_conversions.h>
 
-#define VOXEL_BITS 16
 PLUGINLIB_EXPORT_CLASS(costmap_2d::VoxelLayer, costmap_2d::Layer)
 
 using costmap_2d::NO_INFORMATION;
@@ -15,15 +16,36 @@ using costmap_2d::Observation;
 namespace costmap_2d
 {
 
+/** @brief Whether clearNonLethal() clears a cell with the given cost */
+static inline bool isClearable(unsigned char cost, bool clear_no_info)
+{
+  return cost != LETHAL_OBSTACLE && (clear_no_info || cost != NO_INFORMATION);
+}
+
 void VoxelLayer::onInitialize()
 {
-  ObstacleLayer::onInitialize();
   ros::NodeHandle private_nh("~/" + name_);
 
+  // sparse grids only allocate the columns that were observed, the storage has to be chosen before sizing the grid
+  bool sparse_voxels;
+  private_nh.param("sparse_voxels", sparse_voxels, false);
+  voxel_grid_.setSparse(sparse_voxels);
+
+  ObstacleLayer::onInitialize();
+
+  // the voxel layer never decays its cells, so it does not need to stamp them
+  setTimeStampPrecision(CellTimeStamps::NONE, 0.0);
+
   private_nh.param("publish_voxel_map", publish_voxel_, false);
   if (publish_voxel_)
     voxel_pub_ = private_nh.advertise < costmap_2d::VoxelGrid > ("voxel_grid", 1);
 
+  // deltas of the updated region, with a keyframe of the whole grid every so often
+  private_nh.param("publish_voxel_updates", publish_voxel_updates_, false);
+  private_nh.param("voxel_keyframe_interval", voxel_keyframe_interval_, 50);
+  if (publish_voxel_updates_)
+    voxel_updates_pub_ = private_nh.advertise < costmap_2d::VoxelGridUpdate > ("voxel_grid_updates", 1);
+
   clearing_endpoints_pub_ = private_nh.advertise<sensor_msgs::PointCloud>( "clearing_endpoints", 1 );
 }
 
@@ -48,10 +70,12 @@ void VoxelLayer::reconfigureCB(costmap_2d::VoxelPluginConfig &config, uint32_t l
   size_z_ = config.z_voxels;
   origin_z_ = config.origin_z;
   z_resolution_ = config.z_resolution;
-  unknown_threshold_ = config.unknown_threshold + (VOXEL_BITS - size_z_);
   mark_threshold_ = config.mark_threshold;
   combination_method_ = config.combination_method;
   matchSize();
+
+  //the grid picks its column type for the height, the bits above the grid count as unknown
+  unknown_threshold_ = config.unknown_threshold + (voxel_grid_.columnHeight() - voxel_grid_.sizeZ());
 }
 
 void VoxelLayer::matchSize()
@@ -59,6 +83,7 @@ void VoxelLayer::matchSize()
   ObstacleLayer::matchSize();
   voxel_grid_.resize(size_x_, size_y_, size_z_);
   ROS_ASSERT(voxel_grid_.sizeX() == size_x_ && voxel_grid_.sizeY() == size_y_);
+  column_mask_.assign(size_x_ * size_y_, 0);
 }
 
 void VoxelLayer::reset()
@@ -66,6 +91,8 @@ void VoxelLayer::reset()
   deactivate();
   resetMaps();
   voxel_grid_.reset();
+  // the subscribers of the updates get the cleared grid as a keyframe
+  voxel_sent_.clear();
   activate();
 }
 
@@ -90,12 +117,39 @@ void VoxelLayer::updateBounds(double robot_x, double robot_y, double robot_yaw,
   //update the global current status
   current_ = current;
 
-  //raytrace freespace
-  for (unsigned int i = 0; i < clearing_observations.size(); ++i)
+  //raytrace freespace, all clearing is done before any marking
+  if (raytrace_threads_ > 1)
   {
-    raytraceFreespace(clearing_observations[i], min_x, min_y, max_x, max_y);
+    std::vector<VoxelRay> rays;
+    for (unsigned int i = 0; i < clearing_observations.size(); ++i)
+    {
+      collectVoxelRays(clearing_observations[i], rays, min_x, min_y, max_x, max_y);
+    }
+
+    //each thread owns a band of rows of the grid and walks the rays that pass it
+    unsigned int bands = std::min(raytrace_threads_, size_y_);
+    TaskGroup workers;
+    for (unsigned int band = 1; band < bands; ++band)
+    {
+      workers.run(
+          boost::bind(&VoxelLayer::clearVoxelRays, this, boost::cref(rays), band * size_y_ / bands,
+                      (band + 1) * size_y_ / bands));
+    }
+    if (bands > 0)
+      clearVoxelRays(rays, 0, size_y_ / bands);
+    workers.wait();
+  }
+  else
+  {
+    for (unsigned int i = 0; i < clearing_observations.size(); ++i)
+    {
+      raytraceFreespace(clearing_observations[i], min_x, min_y, max_x, max_y);
+    }
   }
 
+  double mark_time = ros::Time::now().toSec();
+
+  unsigned int new_obstacles = 0;
   //place the new obstacles into a priority queue... each with a priority of zero to begin with
   for (std::vector<Observation>::const_iterator it = observations.begin(); it != observations.end(); ++it)
   {
@@ -135,21 +189,28 @@ void VoxelLayer::updateBounds(double robot_x, double robot_y, double robot_yaw,
       //mark the cell in the voxel grid and check if we should also mark it in the costmap
       if (voxel_grid_.markVoxelInMap(mx, my, mz, mark_threshold_))
       {
-        setCost(mx, my, LETHAL_OBSTACLE);
+        if (getCost(mx, my) != LETHAL_OBSTACLE)
+          new_obstacles++;
+        setCost(mx, my, LETHAL_OBSTACLE, mark_time);
         touch((double)cloud.points[i].x, (double)cloud.points[i].y, min_x, min_y, max_x, max_y);
       }
     }
   }
 
-  if (publish_voxel_)
+  if (new_obstacles > 0)
+    layered_costmap_->addNewObstacles(new_obstacles);
+
+  if (publish_voxel_updates_)
+    publishVoxelUpdate(*min_x, *min_y, *max_x, *max_y);
+
+  if (publish_voxel_ && voxel_pub_.getNumSubscribers() > 0)
   {
     costmap_2d::VoxelGrid grid_msg;
-    unsigned int size = voxel_grid_.sizeX() * voxel_grid_.sizeY();
     grid_msg.size_x = voxel_grid_.sizeX();
     grid_msg.size_y = voxel_grid_.sizeY();
     grid_msg.size_z = voxel_grid_.sizeZ();
-    grid_msg.data.resize(size);
-    memcpy(&grid_msg.data[0], voxel_grid_.getData(), size * sizeof(unsigned int));
+    grid_msg.data.resize(voxel_grid_.dataWords());
+    voxel_grid_.copyData(&grid_msg.data[0]);
 
     grid_msg.origin.x = origin_x_;
     grid_msg.origin.y = origin_y_;
@@ -166,6 +227,105 @@ void VoxelLayer::updateBounds(double robot_x, double robot_y, double robot_yaw,
   footprint_layer_.updateBounds(robot_x, robot_y, robot_yaw, min_x, min_y, max_x, max_y);
 }
 
+void VoxelLayer::publishVoxelUpdate(double min_x, double min_y, double max_x, double max_y)
+{
+  // regions that changed outside of updateBounds() are sent along
+  min_x = std::min(min_x, voxel_dirty_min_x_);
+  min_y = std::min(min_y, voxel_dirty_min_y_);
+  max_x = std::max(max_x, voxel_dirty_max_x_);
+  max_y = std::max(max_y, voxel_dirty_max_y_);
+  voxel_dirty_min_x_ = voxel_dirty_min_y_ = 1e30;
+  voxel_dirty_max_x_ = voxel_dirty_max_y_ = -1e30;
+
+  // without subscribers nobody keeps track of the frames, the next one that subscribes needs a keyframe
+  if (voxel_updates_pub_.getNumSubscribers() == 0)
+  {
+    voxel_sent_.clear();
+    return;
+  }
+
+  const unsigned int size_x = voxel_grid_.sizeX(), size_y = voxel_grid_.sizeY();
+  const unsigned int columns = size_x * size_y;
+  if (columns == 0)
+    return;
+  const unsigned int words_per_column = voxel_grid_.dataWords() / columns;
+
+  // updateOrigin() moves the sent columns along with the grid, so only a grid that is new to them needs a keyframe
+  unsigned int x = 0, y = 0, width = size_x, height = size_y;
+  bool keyframe = voxel_sent_.size() != voxel_grid_.dataWords() || voxel_sent_origin_x_ != origin_x_
+      || voxel_sent_origin_y_ != origin_y_ || ++voxel_frames_since_keyframe_ >= voxel_keyframe_interval_;
+  if (!keyframe)
+  {
+    // nothing changed outside the bounds of this update
+    if (min_x > max_x || min_y > max_y)
+      return;
+    int x0, y0, x1, y1;
+    worldToMapEnforceBounds(min_x, min_y, x0, y0);
+    worldToMapEnforceBounds(max_x, max_y, x1, y1);
+    x = x0;
+    y = y0;
+    width = x1 - x0 + 1;
+    height = y1 - y0 + 1;
+  }
+
+  voxel_region_.resize(width * height * words_per_column);
+  voxel_grid_.copyData(&voxel_region_[0], x, y, width, height);
+
+  costmap_2d::VoxelGridUpdate update;
+  update.header.frame_id = global_frame_;
+  update.header.stamp = ros::Time::now();
+  update.frame = voxel_frame_++;
+  update.keyframe = keyframe;
+  update.origin.x = origin_x_;
+  update.origin.y = origin_y_;
+  update.origin.z = origin_z_;
+  update.resolutions.x = resolution_;
+  update.resolutions.y = resolution_;
+  update.resolutions.z = z_resolution_;
+  update.size_x = size_x;
+  update.size_y = size_y;
+  update.size_z = voxel_grid_.sizeZ();
+  update.x = x;
+  update.y = y;
+  update.width = width;
+  update.height = height;
+
+  if (keyframe)
+  {
+    voxel_sent_ = voxel_region_;
+    voxel_sent_origin_x_ = origin_x_;
+    voxel_sent_origin_y_ = origin_y_;
+    voxel_frames_since_keyframe_ = 0;
+  }
+  else
+  {
+    // unchanged columns become zeros, which collapse into long runs
+    const unsigned int row_words = width * words_per_column;
+    for (unsigned int j = 0; j < height; ++j)
+    {
+      uint32_t* sent = &voxel_sent_[((y + j) * size_x + x) * words_per_column];
+      uint32_t* row = &voxel_region_[j * row_words];
+      for (unsigned int i = 0; i < row_words; ++i)
+      {
+        uint32_t value = row[i];
+        row[i] ^= sent[i];
+        sent[i] = value;
+      }
+    }
+  }
+  encodeColumnRuns(&voxel_region_[0], width * height, words_per_column, update.data);
+
+  voxel_updates_pub_.publish(update);
+}
+
+void VoxelLayer::markVoxelsDirty(double min_x, double min_y, double max_x, double max_y)
+{
+  voxel_dirty_min_x_ = std::min(voxel_dirty_min_x_, min_x);
+  voxel_dirty_min_y_ = std::min(voxel_dirty_min_y_, min_y);
+  voxel_dirty_max_x_ = std::max(voxel_dirty_max_x_, max_x);
+  voxel_dirty_max_y_ = std::max(voxel_dirty_max_y_, max_y);
+}
+
 void VoxelLayer::clearNonLethal(double wx, double wy, double w_size_x, double w_size_y, bool clear_no_info)
 {
   //get the cell coordinates of the center point of the window
@@ -186,39 +346,79 @@ void VoxelLayer::clearNonLethal(double wx, double wy, double w_size_x, double w_
   end_x = std::min(origin_x_ + getSizeInMetersX(), end_x);
   end_y = std::min(origin_y_ + getSizeInMetersY(), end_y);
 
-  //get the map coordinates of the bounds of the window
-  unsigned int map_sx, map_sy, map_ex, map_ey;
+  //get the map coordinates of the bounds of the window, the far edge of the map is part of the window
+  int map_sx, map_sy, map_ex, map_ey;
+  worldToMapEnforceBounds(start_x, start_y, map_sx, map_sy);
+  worldToMapEnforceBounds(end_x, end_y, map_ex, map_ey);
 
-  //check for legality just in case
-  if (!worldToMap(start_x, start_y, map_sx, map_sy) || !worldToMap(end_x, end_y, map_ex, map_ey))
-    return;
+  //the voxel updates do not see this change through updateBounds()
+  markVoxelsDirty(start_x, start_y, end_x, end_y);
 
-  //we know that we want to clear all non-lethal obstacles in this window to get it ready for inflation
-  unsigned int index = getIndex(map_sx, map_sy);
-  unsigned char* current = &costmap_[index];
-  for (unsigned int j = map_sy; j <= map_ey; ++j)
+  //we know that we want to clear all non-lethal obstacles in this window to get it ready for inflation,
+  //lethal obstacles split the rows into runs that are cleared at once in the costmap and the voxel grid
+  unsigned int width = map_ex - map_sx + 1;
+  for (int j = map_sy; j <= map_ey; ++j)
   {
-    for (unsigned int i = map_sx; i <= map_ex; ++i)
+    unsigned int row = getIndex(map_sx, j);
+    unsigned char* current = costmap_ + row;
+    unsigned int i = 0;
+    while (i < width)
     {
-      //if the cell is a lethal obstacle... we'll keep it and queue it, otherwise... we'll clear it
-      if (*current != LETHAL_OBSTACLE)
+      while (i < width && !isClearable(current[i], clear_no_info))
+        ++i;
+      unsigned int run_start = i;
+      while (i < width && isClearable(current[i], clear_no_info))
+        ++i;
+
+      if (i > run_start)
       {
-        if (clear_no_info || *current != NO_INFORMATION)
-        {
-          *current = FREE_SPACE;
-          voxel_grid_.clearVoxelColumn(index);
-        }
+        memset(current + run_start, FREE_SPACE, i - run_start);
+        voxel_grid_.clearVoxelColumns(row + run_start, i - run_start);
       }
-      current++;
-      index++;
     }
-    current += size_x_ - (map_ex - map_sx) - 1;
-    index += size_x_ - (map_ex - map_sx) - 1;
   }
 }
 
 void VoxelLayer::raytraceFreespace(const Observation& clearing_observation, double* min_x, double* min_y,
                                            double* max_x, double* max_y)
+{
+  std::vector<VoxelRay> rays;
+  collectVoxelRays(clearing_observation, rays, min_x, min_y, max_x, max_y);
+  clearVoxelRays(rays, 0, size_y_);
+}
+
+void VoxelLayer::clearVoxelRays(const std::vector<VoxelRay>& rays, unsigned int first_row, unsigned int end_row)
+{
+  unsigned int first_index = first_row * size_x_, end_index = end_row * size_x_;
+  unsigned int min_x = size_x_, max_x = 0, min_y = end_row, max_y = first_row;
+  for (unsigned int i = 0; i < rays.size(); ++i)
+  {
+    const VoxelRay& ray = rays[i];
+
+    //rays that do not reach the band are not walked at all
+    unsigned int ray_min_y = std::min((unsigned int)ray.y0, (unsigned int)ray.y1);
+    unsigned int ray_max_y = std::max((unsigned int)ray.y0, (unsigned int)ray.y1);
+    if (ray_max_y < first_row || ray_min_y >= end_row)
+      continue;
+
+    //the columns are only noted here, and their costs written once per column below
+    voxel_grid_.clearVoxelLineMasked(ray.x0, ray.y0, ray.z0, ray.x1, ray.y1, ray.z1, &column_mask_[0],
+                                     ray.max_length, first_index, end_index);
+    min_x = std::min(min_x, std::min((unsigned int)ray.x0, (unsigned int)ray.x1));
+    max_x = std::max(max_x, std::max((unsigned int)ray.x0, (unsigned int)ray.x1));
+    min_y = std::min(min_y, std::max(ray_min_y, first_row));
+    max_y = std::max(max_y, std::min(ray_max_y, end_row - 1));
+  }
+
+  for (unsigned int y = min_y; y <= max_y && min_x <= max_x; ++y)
+  {
+    voxel_grid_.projectColumns(y * size_x_ + min_x, max_x - min_x + 1, costmap_, &column_mask_[0],
+                               unknown_threshold_, mark_threshold_, FREE_SPACE, NO_INFORMATION);
+  }
+}
+
+void VoxelLayer::collectVoxelRays(const Observation& clearing_observation, std::vector<VoxelRay>& rays,
+                                  double* min_x, double* min_y, double* max_x, double* max_y)
 {
   if (clearing_observation.cloud_->points.size() == 0)
     return;
@@ -303,15 +503,14 @@ void VoxelLayer::raytraceFreespace(const Observation& clearing_observation, doub
     wpy = oy + b * t;
     wpz = oz + c * t;
 
-    double point_x, point_y, point_z;
-    if (worldToMap3DFloat(wpx, wpy, wpz, point_x, point_y, point_z))
+    VoxelRay ray;
+    if (worldToMap3DFloat(wpx, wpy, wpz, ray.x1, ray.y1, ray.z1))
     {
-      unsigned int cell_raytrace_range = cellDistance(clearing_observation.raytrace_range_);
-
-      //voxel_grid_.markVoxelLine(sensor_x, sensor_y, sensor_z, point_x, point_y, point_z);
-      voxel_grid_.clearVoxelLineInMap(sensor_x, sensor_y, sensor_z, point_x, point_y, point_z, costmap_,
-                                      unknown_threshold_, mark_threshold_, FREE_SPACE, NO_INFORMATION,
-                                      cell_raytrace_range);
+      ray.x0 = sensor_x;
+      ray.y0 = sensor_y;
+      ray.z0 = sensor_z;
+      ray.max_length = cellDistance(clearing_observation.raytrace_range_);
+      rays.push_back(ray);
 
       updateRaytraceBounds(ox, oy, wpx, wpy, clearing_observation.raytrace_range_, min_x, min_y, max_x, max_y);
 
@@ -349,49 +548,27 @@ void VoxelLayer::updateOrigin(double new_origin_x, double new_origin_y)
   new_grid_ox = origin_x_ + cell_ox * resolution_;
   new_grid_oy = origin_y_ + cell_oy * resolution_;
 
-  //To save casting from unsigned int to int a bunch of times
-  int size_x = size_x_;
-  int size_y = size_y_;
-
-  //we need to compute the overlap of the new and existing windows
-  int lower_left_x, lower_left_y, upper_right_x, upper_right_y;
-  lower_left_x = std::min(std::max(cell_ox, 0), size_x);
-  lower_left_y = std::min(std::max(cell_oy, 0), size_y);
-  upper_right_x = std::min(std::max(cell_ox + size_x, 0), size_x);
-  upper_right_y = std::min(std::max(cell_oy + size_y, 0), size_y);
-
-  unsigned int cell_size_x = upper_right_x - lower_left_x;
-  unsigned int cell_size_y = upper_right_y - lower_left_y;
-
-  //we need a map to store the obstacles in the window temporarily
-  unsigned char* local_map = new unsigned char[cell_size_x * cell_size_y];
-  unsigned int* local_voxel_map = new unsigned int[cell_size_x * cell_size_y];
-  unsigned int* voxel_map = voxel_grid_.getData();
+  //move the overlap of the old and new window in place, exposed columns become unknown
+  {
+    boost::unique_lock < boost::shared_mutex > lock(*access_);
+    shiftMapRegion(costmap_, size_x_, size_y_, cell_ox, cell_oy, default_value_);
+    voxel_grid_.shift(cell_ox, cell_oy);
+  }
 
-  //copy the local window in the costmap to the local map
-  copyMapRegion(costmap_, lower_left_x, lower_left_y, size_x_, local_map, 0, 0, cell_size_x, cell_size_x, cell_size_y);
-  copyMapRegion(voxel_map, lower_left_x, lower_left_y, size_x_, local_voxel_map, 0, 0, cell_size_x, cell_size_x,
-                cell_size_y);
-
-  //we'll reset our maps to unknown space if appropriate
-  resetMaps();
+  //the subscribers of the voxel updates move their columns the same way when they see the new origin
+  bool sent_in_sync = voxel_sent_.size() == voxel_grid_.dataWords() && voxel_sent_origin_x_ == origin_x_
+      && voxel_sent_origin_y_ == origin_y_;
 
   //update the origin with the appropriate world coordinates
   origin_x_ = new_grid_ox;
   origin_y_ = new_grid_oy;
 
-  //compute the starting cell location for copying data back in
-  int start_x = lower_left_x - cell_ox;
-  int start_y = lower_left_y - cell_oy;
-
-  //now we want to copy the overlapping information back into the map, but in its new location
-  copyMapRegion(local_map, 0, 0, cell_size_x, costmap_, start_x, start_y, size_x_, cell_size_x, cell_size_y);
-  copyMapRegion(local_voxel_map, 0, 0, cell_size_x, voxel_map, start_x, start_y, size_x_, cell_size_x, cell_size_y);
-
-  //make sure to clean up
-  delete[] local_map;
-  delete[] local_voxel_map;
-
+  if (sent_in_sync && size_x_ * size_y_ > 0)
+  {
+    shiftVoxelColumns(voxel_sent_, size_x_, size_y_, voxel_grid_.dataWords() / (size_x_ * size_y_), cell_ox, cell_oy);
+    voxel_sent_origin_x_ = origin_x_;
+    voxel_sent_origin_y_ = origin_y_;
+  }
 }
 
 }
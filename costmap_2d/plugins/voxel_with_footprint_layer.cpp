@@ -0,0 +1,55 @@
+#include <costmap_2d/voxel_with_footprint_layer.h>
+#include <pluginlib/class_list_macros.h>
+
+PLUGINLIB_EXPORT_CLASS(costmap_2d::VoxelWithFootprintLayer, costmap_2d::Layer)
+
+namespace costmap_2d
+{
+
+void VoxelWithFootprintLayer::onInitialize()
+{
+  VoxelLayer::onInitialize();
+
+  // the footprint is cleared in the voxel grid, not again when merging the costs
+  footprint_clearing_in_costs_ = false;
+}
+
+void VoxelWithFootprintLayer::updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x,
+                                           double* min_y, double* max_x, double* max_y)
+{
+  VoxelLayer::updateBounds(robot_x, robot_y, robot_yaw, min_x, min_y, max_x, max_y);
+  if (!enabled_)
+    return;
+
+  // the footprint layer has moved the footprint to the robot pose and added it to the bounds
+  clearFootprint();
+}
+
+void VoxelWithFootprintLayer::clearFootprint()
+{
+  const std::vector<geometry_msgs::Point32>& polygon = footprint_layer_.getTransformedFootprint().polygon.points;
+
+  std::vector<MapLocation> map_polygon;
+  for (unsigned int i = 0; i < polygon.size(); ++i)
+  {
+    MapLocation loc;
+    if (!worldToMap(polygon[i].x, polygon[i].y, loc.x, loc.y))
+      return;
+    map_polygon.push_back(loc);
+  }
+
+  footprint_cells_.clear();
+  convexFillCells(map_polygon, footprint_cells_);
+
+  double stamp = footprint_layer_.getTransformedFootprint().header.stamp.toSec();
+  for (unsigned int i = 0; i < footprint_cells_.size(); ++i)
+  {
+    unsigned int index = getIndex(footprint_cells_[i].x, footprint_cells_[i].y);
+    voxel_grid_.clearVoxelColumn(index);
+    setCost(footprint_cells_[i].x, footprint_cells_[i].y, FREE_SPACE, stamp);
+    if (free_decay_.isEnabled())
+      free_decay_.push(index, stamp);
+  }
+}
+
+}  // namespace costmap_2d
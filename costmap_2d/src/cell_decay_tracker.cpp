@@ -0,0 +1,229 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/cell_decay_tracker.h>
+
+namespace costmap_2d
+{
+
+// Keys further away than this from the queued ones are clamped, so that a
+// jump in (simulated) time does not make us allocate an absurd number of buckets.
+static const long MAX_BUCKET_SPAN = 100000;
+
+CellDecayTracker::CellDecayTracker(unsigned char value, double bucket_duration) :
+    value_(value), bucket_duration_(bucket_duration), timeout_(-1.0), needs_seeding_(false), size_x_(0), size_y_(0),
+    first_key_(0)
+{
+}
+
+void CellDecayTracker::setTimeout(double timeout)
+{
+  if (timeout < 0.0)
+  {
+    clear();
+    needs_seeding_ = false;
+  }
+  else if (!isEnabled())
+  {
+    needs_seeding_ = true;
+  }
+  timeout_ = timeout;
+}
+
+void CellDecayTracker::resize(unsigned int size_x, unsigned int size_y)
+{
+  size_x_ = size_x;
+  size_y_ = size_y;
+  buckets_.clear();
+  queued_.assign(size_x * size_y, false);
+}
+
+void CellDecayTracker::clear()
+{
+  for (unsigned int b = 0; b < buckets_.size(); ++b)
+  {
+    const std::vector<unsigned int>& bucket = buckets_[b];
+    for (unsigned int i = 0; i < bucket.size(); ++i)
+      queued_[bucket[i]] = false;
+  }
+  buckets_.clear();
+}
+
+void CellDecayTracker::seed(const Costmap2D& map)
+{
+  clear();
+  needs_seeding_ = false;
+  if (!isEnabled())
+    return;
+
+  for (unsigned int my = 0; my < map.getSizeInCellsY(); ++my)
+  {
+    for (unsigned int mx = 0; mx < map.getSizeInCellsX(); ++mx)
+    {
+      if (map.getCost(mx, my) != value_)
+        continue;
+
+      double cell_stamp = map.getTimeStamp(mx, my);
+      if (std::isfinite(cell_stamp))
+        push(map.getIndex(mx, my), cell_stamp);
+    }
+  }
+}
+
+std::vector<unsigned int>& CellDecayTracker::bucketFor(double stamp)
+{
+  long key = std::isfinite(stamp) ? bucketKey(stamp) : first_key_;
+  if (buckets_.empty())
+  {
+    first_key_ = key;
+    buckets_.push_back(std::vector<unsigned int>());
+    return buckets_.back();
+  }
+
+  long last_key = first_key_ + (long)buckets_.size() - 1;
+  if (key < first_key_)
+  {
+    if (first_key_ - key > MAX_BUCKET_SPAN)
+      return buckets_.front();
+    while (key < first_key_)
+    {
+      buckets_.push_front(std::vector<unsigned int>());
+      --first_key_;
+    }
+    return buckets_.front();
+  }
+
+  if (key > last_key)
+  {
+    if (key - last_key > MAX_BUCKET_SPAN)
+      return buckets_.back();
+    buckets_.resize(buckets_.size() + (key - last_key));
+    return buckets_.back();
+  }
+
+  return buckets_[key - first_key_];
+}
+
+void CellDecayTracker::shift(int dx, int dy)
+{
+  if (dx == 0 && dy == 0)
+    return;
+
+  // clear all flags first, bucket entries can map onto indices that are still to be visited
+  for (unsigned int b = 0; b < buckets_.size(); ++b)
+  {
+    const std::vector<unsigned int>& bucket = buckets_[b];
+    for (unsigned int i = 0; i < bucket.size(); ++i)
+      queued_[bucket[i]] = false;
+  }
+
+  int size_x = size_x_, size_y = size_y_;
+  for (unsigned int b = 0; b < buckets_.size(); ++b)
+  {
+    std::vector<unsigned int>& bucket = buckets_[b];
+    unsigned int kept = 0;
+    for (unsigned int i = 0; i < bucket.size(); ++i)
+    {
+      int x = bucket[i] % size_x_ - dx;
+      int y = bucket[i] / size_x_ - dy;
+      if (x < 0 || y < 0 || x >= size_x || y >= size_y)
+        continue;
+
+      unsigned int index = y * size_x_ + x;
+      queued_[index] = true;
+      bucket[kept++] = index;
+    }
+    bucket.resize(kept);
+  }
+}
+
+void CellDecayTracker::expire(const Costmap2D& map, double now, std::vector<unsigned int>& expired)
+{
+  if (!isEnabled())
+    return;
+
+  std::vector<unsigned int> due;
+  while (!buckets_.empty())
+  {
+    // nothing in the front bucket can be expired before its start time is older than the timeout
+    if (now - first_key_ * bucket_duration_ <= timeout_)
+      break;
+
+    due.clear();
+    due.swap(buckets_.front());
+
+    unsigned int mx, my;
+    for (unsigned int i = 0; i < due.size(); ++i)
+    {
+      unsigned int index = due[i];
+      map.indexToCells(index, mx, my);
+
+      // the cell got a different value since it was queued, whoever wrote it is responsible for it now
+      if (map.getCost(mx, my) != value_)
+      {
+        queued_[index] = false;
+        continue;
+      }
+
+      double stamp = map.getTimeStamp(mx, my);
+      if (!(now - stamp <= timeout_))
+      {
+        queued_[index] = false;
+        expired.push_back(index);
+      }
+      else
+      {
+        // the cell was refreshed after it was queued, move it to the bucket of its latest update
+        bucketFor(stamp).push_back(index);
+      }
+    }
+
+    // refreshed cells that ended up in the same bucket are not due yet
+    if (!buckets_.front().empty())
+      break;
+
+    buckets_.pop_front();
+    ++first_key_;
+  }
+}
+
+unsigned int CellDecayTracker::size() const
+{
+  unsigned int size = 0;
+  for (unsigned int b = 0; b < buckets_.size(); ++b)
+    size += buckets_[b].size();
+  return size;
+}
+
+}  // namespace costmap_2d
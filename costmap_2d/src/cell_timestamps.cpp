@@ -0,0 +1,287 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/cell_timestamps.h>
+#include <algorithm>
+#include <cmath>
+
+namespace costmap_2d
+{
+
+template<typename data_type>
+static void copyRegionOf(const data_type* source_map, unsigned int sm_lower_left_x, unsigned int sm_lower_left_y,
+                         unsigned int sm_size_x, data_type* dest_map, unsigned int dm_lower_left_x,
+                         unsigned int dm_lower_left_y, unsigned int dm_size_x, unsigned int region_size_x,
+                         unsigned int region_size_y)
+{
+  const data_type* sm_index = source_map + (sm_lower_left_y * sm_size_x + sm_lower_left_x);
+  data_type* dm_index = dest_map + (dm_lower_left_y * dm_size_x + dm_lower_left_x);
+
+  for (unsigned int i = 0; i < region_size_y; ++i)
+  {
+    memcpy(dm_index, sm_index, region_size_x * sizeof(data_type));
+    sm_index += sm_size_x;
+    dm_index += dm_size_x;
+  }
+}
+
+template<typename data_type>
+static void shiftRegionOf(data_type* map, unsigned int size_x, unsigned int size_y, int cell_ox, int cell_oy)
+{
+  if (cell_ox <= -int(size_x) || cell_ox >= int(size_x) || cell_oy <= -int(size_y) || cell_oy >= int(size_y))
+  {
+    memset(map, 0, size_x * size_y * sizeof(data_type));
+    return;
+  }
+
+  unsigned int x0 = std::max(-cell_ox, 0);
+  unsigned int xn = size_x - std::max(cell_ox, 0);
+
+  int step = cell_oy >= 0 ? 1 : -1;
+  int y = step > 0 ? 0 : size_y - 1;
+  for (unsigned int i = 0; i < size_y; ++i, y += step)
+  {
+    data_type* row = map + y * size_x;
+    int source_y = y + cell_oy;
+    if (source_y < 0 || source_y >= int(size_y))
+    {
+      memset(row, 0, size_x * sizeof(data_type));
+      continue;
+    }
+
+    memmove(row + x0, map + source_y * size_x + x0 + cell_ox, (xn - x0) * sizeof(data_type));
+    memset(row, 0, x0 * sizeof(data_type));
+    memset(row + xn, 0, (size_x - xn) * sizeof(data_type));
+  }
+}
+
+CellTimeStamps::CellTimeStamps(Precision precision, double resolution) :
+    precision_(precision), resolution_(resolution), epoch_(0.0), has_epoch_(false), size_(0), ticks16_(NULL),
+    ticks32_(NULL)
+{
+}
+
+CellTimeStamps::CellTimeStamps(const CellTimeStamps& stamps) :
+    precision_(NONE), resolution_(stamps.resolution_), epoch_(0.0), has_epoch_(false), size_(0), ticks16_(NULL),
+    ticks32_(NULL)
+{
+  *this = stamps;
+}
+
+CellTimeStamps& CellTimeStamps::operator=(const CellTimeStamps& stamps)
+{
+  if (this == &stamps)
+    return *this;
+
+  release();
+  precision_ = stamps.precision_;
+  resolution_ = stamps.resolution_;
+  epoch_ = stamps.epoch_;
+  has_epoch_ = stamps.has_epoch_;
+  size_ = stamps.size_;
+  allocate();
+
+  if (precision_ == TICKS_32)
+    memcpy(ticks32_, stamps.ticks32_, size_ * sizeof(uint32_t));
+  else if (precision_ == TICKS_16)
+    memcpy(ticks16_, stamps.ticks16_, size_ * sizeof(uint16_t));
+  return *this;
+}
+
+CellTimeStamps::~CellTimeStamps()
+{
+  release();
+}
+
+void CellTimeStamps::setPrecision(Precision precision, double resolution)
+{
+  release();
+  precision_ = precision;
+  resolution_ = resolution;
+  has_epoch_ = false;
+  allocate();
+  reset();
+}
+
+void CellTimeStamps::resize(unsigned int size)
+{
+  release();
+  size_ = size;
+  allocate();
+  reset();
+}
+
+void CellTimeStamps::allocate()
+{
+  if (precision_ == TICKS_32)
+    ticks32_ = new uint32_t[size_];
+  else if (precision_ == TICKS_16)
+    ticks16_ = new uint16_t[size_];
+}
+
+void CellTimeStamps::release()
+{
+  delete[] ticks16_;
+  delete[] ticks32_;
+  ticks16_ = NULL;
+  ticks32_ = NULL;
+}
+
+void CellTimeStamps::reset()
+{
+  reset(0, size_);
+}
+
+void CellTimeStamps::reset(unsigned int index, unsigned int length)
+{
+  if (precision_ == TICKS_32)
+    memset(ticks32_ + index, 0, length * sizeof(uint32_t));
+  else if (precision_ == TICKS_16)
+    memset(ticks16_ + index, 0, length * sizeof(uint16_t));
+}
+
+void CellTimeStamps::fill(unsigned int index, unsigned int length, uint32_t tick)
+{
+  if (precision_ == TICKS_32)
+    std::fill(ticks32_ + index, ticks32_ + index + length, tick);
+  else if (precision_ == TICKS_16)
+    std::fill(ticks16_ + index, ticks16_ + index + length, (uint16_t)tick);
+}
+
+uint32_t CellTimeStamps::encode(double stamp)
+{
+  if (precision_ == NONE)
+    return 0;
+
+  if (!has_epoch_)
+  {
+    epoch_ = stamp;
+    has_epoch_ = true;
+  }
+
+  double offset = (stamp - epoch_) / resolution_;
+
+  // stamps from before the epoch (or garbage) are as old as it gets
+  if (!(offset >= 0.0))
+    return 1;
+
+  double tick = ceil(offset) + 1.0;
+  if (tick > maxTick())
+  {
+    rebase(stamp);
+    tick = ceil((stamp - epoch_) / resolution_) + 1.0;
+  }
+  return (uint32_t)tick;
+}
+
+void CellTimeStamps::rebase(double stamp)
+{
+  // keep the most recent half of the representable range
+  double shift = floor((stamp - epoch_) / resolution_) - maxTick() / 2;
+  epoch_ += shift * resolution_;
+
+  if (precision_ == TICKS_32)
+  {
+    for (unsigned int i = 0; i < size_; ++i)
+    {
+      if (ticks32_[i] == 0)
+        continue;
+      // cells older than the new epoch are clamped to the oldest stamp
+      ticks32_[i] = ticks32_[i] > shift ? (uint32_t)(ticks32_[i] - shift) : 1;
+    }
+  }
+  else if (precision_ == TICKS_16)
+  {
+    for (unsigned int i = 0; i < size_; ++i)
+    {
+      if (ticks16_[i] == 0)
+        continue;
+      ticks16_[i] = ticks16_[i] > shift ? (uint16_t)(ticks16_[i] - shift) : 1;
+    }
+  }
+}
+
+void CellTimeStamps::copyRegion(const CellTimeStamps& source, unsigned int sm_lower_left_x,
+                                unsigned int sm_lower_left_y, unsigned int sm_size_x, unsigned int dm_lower_left_x,
+                                unsigned int dm_lower_left_y, unsigned int dm_size_x, unsigned int region_size_x,
+                                unsigned int region_size_y)
+{
+  if (precision_ == NONE)
+    return;
+
+  // without an epoch we do not hold any stamps yet, so we can take over the one of the source
+  if (!has_epoch_ && source.has_epoch_ && source.precision_ == precision_ && source.resolution_ == resolution_)
+  {
+    epoch_ = source.epoch_;
+    has_epoch_ = true;
+  }
+
+  bool same_ticks = source.precision_ == precision_ && source.resolution_ == resolution_
+      && (!source.has_epoch_ || source.epoch_ == epoch_);
+
+  if (same_ticks && precision_ == TICKS_32)
+  {
+    copyRegionOf(source.ticks32_, sm_lower_left_x, sm_lower_left_y, sm_size_x, ticks32_, dm_lower_left_x,
+                 dm_lower_left_y, dm_size_x, region_size_x, region_size_y);
+    return;
+  }
+  if (same_ticks && precision_ == TICKS_16)
+  {
+    copyRegionOf(source.ticks16_, sm_lower_left_x, sm_lower_left_y, sm_size_x, ticks16_, dm_lower_left_x,
+                 dm_lower_left_y, dm_size_x, region_size_x, region_size_y);
+    return;
+  }
+
+  // different representations, convert cell by cell
+  for (unsigned int j = 0; j < region_size_y; ++j)
+  {
+    unsigned int sm_index = (sm_lower_left_y + j) * sm_size_x + sm_lower_left_x;
+    unsigned int dm_index = (dm_lower_left_y + j) * dm_size_x + dm_lower_left_x;
+    for (unsigned int i = 0; i < region_size_x; ++i, ++sm_index, ++dm_index)
+    {
+      uint32_t tick = source.getEncoded(sm_index);
+      setEncoded(dm_index, tick == 0 ? 0 : encode(source.decode(tick)));
+    }
+  }
+}
+
+void CellTimeStamps::shift(unsigned int size_x, unsigned int size_y, int cell_ox, int cell_oy)
+{
+  if (precision_ == TICKS_32)
+    shiftRegionOf(ticks32_, size_x, size_y, cell_ox, cell_oy);
+  else if (precision_ == TICKS_16)
+    shiftRegionOf(ticks16_, size_x, size_y, cell_ox, cell_oy);
+}
+
+}  // namespace costmap_2d
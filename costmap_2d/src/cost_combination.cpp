@@ -0,0 +1,127 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/cost_combination.h>
+#include <costmap_2d/cost_values.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace costmap_2d
+{
+
+static const unsigned char MAX_SUM = INSCRIBED_INFLATED_OBSTACLE - 1;
+
+static inline unsigned char maxCell(unsigned char master, unsigned char layer)
+{
+  unsigned char larger = master == NO_INFORMATION || master < layer ? layer : master;
+  return layer == NO_INFORMATION ? master : larger;
+}
+
+static inline unsigned char overwriteCell(unsigned char master, unsigned char layer)
+{
+  return layer == NO_INFORMATION ? master : layer;
+}
+
+static inline unsigned char additionCell(unsigned char master, unsigned char layer)
+{
+  unsigned int sum = master + layer;
+  unsigned char capped = sum > MAX_SUM ? MAX_SUM : sum;
+  unsigned char value = master == NO_INFORMATION ? layer : capped;
+  return layer == NO_INFORMATION ? master : value;
+}
+
+#ifdef __SSE2__
+// chooses a where the mask is set, b elsewhere
+static inline __m128i select(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+#endif
+
+void combineMax(unsigned char* master, const unsigned char* layer, unsigned int length)
+{
+  unsigned int i = 0;
+#ifdef __SSE2__
+  const __m128i unknown = _mm_set1_epi8((char)NO_INFORMATION);
+  for (; i + 16 <= length; i += 16)
+  {
+    __m128i m = _mm_loadu_si128((const __m128i*)(master + i));
+    __m128i l = _mm_loadu_si128((const __m128i*)(layer + i));
+    __m128i larger = select(_mm_cmpeq_epi8(m, unknown), l, _mm_max_epu8(m, l));
+    _mm_storeu_si128((__m128i*)(master + i), select(_mm_cmpeq_epi8(l, unknown), m, larger));
+  }
+#endif
+  for (; i < length; ++i)
+    master[i] = maxCell(master[i], layer[i]);
+}
+
+void combineOverwrite(unsigned char* master, const unsigned char* layer, unsigned int length)
+{
+  unsigned int i = 0;
+#ifdef __SSE2__
+  const __m128i unknown = _mm_set1_epi8((char)NO_INFORMATION);
+  for (; i + 16 <= length; i += 16)
+  {
+    __m128i m = _mm_loadu_si128((const __m128i*)(master + i));
+    __m128i l = _mm_loadu_si128((const __m128i*)(layer + i));
+    _mm_storeu_si128((__m128i*)(master + i), select(_mm_cmpeq_epi8(l, unknown), m, l));
+  }
+#endif
+  for (; i < length; ++i)
+    master[i] = overwriteCell(master[i], layer[i]);
+}
+
+void combineAddition(unsigned char* master, const unsigned char* layer, unsigned int length)
+{
+  unsigned int i = 0;
+#ifdef __SSE2__
+  const __m128i unknown = _mm_set1_epi8((char)NO_INFORMATION);
+  const __m128i max_sum = _mm_set1_epi8((char)MAX_SUM);
+  for (; i + 16 <= length; i += 16)
+  {
+    __m128i m = _mm_loadu_si128((const __m128i*)(master + i));
+    __m128i l = _mm_loadu_si128((const __m128i*)(layer + i));
+    // the saturated sum is above the cap whenever the real one is
+    __m128i sum = _mm_min_epu8(_mm_adds_epu8(m, l), max_sum);
+    __m128i value = select(_mm_cmpeq_epi8(m, unknown), l, sum);
+    _mm_storeu_si128((__m128i*)(master + i), select(_mm_cmpeq_epi8(l, unknown), m, value));
+  }
+#endif
+  for (; i < length; ++i)
+    master[i] = additionCell(master[i], layer[i]);
+}
+
+}  // namespace costmap_2d
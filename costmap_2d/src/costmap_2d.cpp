@@ -45,8 +45,9 @@ namespace costmap_2d
 Costmap2D::Costmap2D(unsigned int cells_size_x, unsigned int cells_size_y, double resolution,
                      double origin_x, double origin_y, unsigned char default_value) :
     size_x_(cells_size_x), size_y_(cells_size_y), resolution_(resolution), origin_x_(origin_x), 
-    origin_y_(origin_y), costmap_(NULL), timestamps_(NULL), default_value_(default_value)
+    origin_y_(origin_y), costmap_(NULL), default_value_(default_value)
 {
+  inverse_resolution_ = resolution_ > 0.0 ? 1.0 / resolution_ : 0.0;
   access_ = new boost::shared_mutex();
 
   //create the costmap
@@ -59,14 +60,15 @@ void Costmap2D::deleteMaps()
   //clean up data
   boost::unique_lock < boost::shared_mutex > lock(*access_);
   delete[] costmap_;
-  delete[] timestamps_;
+  costmap_ = NULL;
+  timestamps_.release();
 }
 
 void Costmap2D::initMaps(unsigned int size_x, unsigned int size_y)
 {
   boost::unique_lock < boost::shared_mutex > lock(*access_);
   costmap_ = new unsigned char[size_x * size_y];
-  timestamps_ = new double[size_x * size_y];
+  timestamps_.resize(size_x * size_y);
 }
 
 void Costmap2D::resizeMap(unsigned int size_x, unsigned int size_y, double resolution,
@@ -75,6 +77,7 @@ void Costmap2D::resizeMap(unsigned int size_x, unsigned int size_y, double resol
   size_x_ = size_x;
   size_y_ = size_y;
   resolution_ = resolution;
+  inverse_resolution_ = resolution_ > 0.0 ? 1.0 / resolution_ : 0.0;
   origin_x_ = origin_x;
   origin_y_ = origin_y;
 
@@ -88,7 +91,7 @@ void Costmap2D::resetMaps()
 {
   boost::unique_lock < boost::shared_mutex > lock(*access_);
   memset(costmap_, default_value_, size_x_ * size_y_ * sizeof(unsigned char));
-  memset(timestamps_, -1.0, size_x_ * size_y_ * sizeof(double));
+  timestamps_.reset();
 }
 
 void Costmap2D::resetMap(unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn)
@@ -98,7 +101,7 @@ void Costmap2D::resetMap(unsigned int x0, unsigned int y0, unsigned int xn, unsi
   for (unsigned int y = y0 * size_x_ + x0; y < yn * size_x_ + x0; y += size_x_)
   {
     memset(costmap_ + y, default_value_, len * sizeof(unsigned char));
-    memset(timestamps_ + y, -1.0, len * sizeof(double));
+    timestamps_.reset(y, len);
   }
 }
 
@@ -127,15 +130,17 @@ bool Costmap2D::copyCostmapWindow(const Costmap2D& map, double win_origin_x, dou
   size_x_ = upper_right_x - lower_left_x;
   size_y_ = upper_right_y - lower_left_y;
   resolution_ = map.resolution_;
+  inverse_resolution_ = map.inverse_resolution_;
   origin_x_ = win_origin_x;
   origin_y_ = win_origin_y;
 
   //initialize our various maps and reset markers for inflation
+  timestamps_.setPrecision(map.timestamps_.getPrecision(), map.timestamps_.getResolution());
   initMaps(size_x_, size_y_);
 
   //copy the window of the static map and the costmap that we're taking
   copyMapRegion(map.costmap_, lower_left_x, lower_left_y, map.size_x_, costmap_, 0, 0, size_x_, size_x_, size_y_);
-  copyMapRegion(map.timestamps_, lower_left_x, lower_left_y, map.size_x_, timestamps_, 0, 0, size_x_, size_x_, size_y_);
+  timestamps_.copyRegion(map.timestamps_, lower_left_x, lower_left_y, map.size_x_, 0, 0, size_x_, size_x_, size_y_);
   return true;
 }
 
@@ -152,29 +157,31 @@ Costmap2D& Costmap2D::operator=(const Costmap2D& map)
   size_x_ = map.size_x_;
   size_y_ = map.size_y_;
   resolution_ = map.resolution_;
+  inverse_resolution_ = map.inverse_resolution_;
   origin_x_ = map.origin_x_;
   origin_y_ = map.origin_y_;
 
   //initialize our various maps
   initMaps(size_x_, size_y_);
 
-  //copy the cost map
+  //copy the cost map, the time stamps take over the precision and epoch of the source
   memcpy(costmap_, map.costmap_, size_x_ * size_y_ * sizeof(unsigned char));
-  memcpy(timestamps_, map.timestamps_, size_x_ * size_y_ * sizeof(double));
+  timestamps_ = map.timestamps_;
 
   return *this;
 }
 
 Costmap2D::Costmap2D(const Costmap2D& map) :
-    costmap_(NULL),
-    timestamps_(NULL)
+    costmap_(NULL)
 {
+  access_ = new boost::shared_mutex();
   *this = map;
 }
 
 //just initialize everything to NULL by default
 Costmap2D::Costmap2D() :
-    size_x_(0), size_y_(0), resolution_(0.0), origin_x_(0.0), origin_y_(0.0), costmap_(NULL), timestamps_(NULL)
+    size_x_(0), size_y_(0), resolution_(0.0), inverse_resolution_(0.0), origin_x_(0.0), origin_y_(0.0),
+    costmap_(NULL)
 {
   access_ = new boost::shared_mutex();
 }
@@ -182,6 +189,21 @@ Costmap2D::Costmap2D() :
 Costmap2D::~Costmap2D()
 {
   deleteMaps();
+  delete access_;
+}
+
+void Costmap2D::copyCostsFrom(const Costmap2D& map)
+{
+  if (map.size_x_ != size_x_ || map.size_y_ != size_y_ || map.resolution_ != resolution_
+      || map.origin_x_ != origin_x_ || map.origin_y_ != origin_y_)
+  {
+    *this = map;
+    return;
+  }
+
+  boost::unique_lock < boost::shared_mutex > lock(*access_);
+  memcpy(costmap_, map.costmap_, size_x_ * size_y_ * sizeof(unsigned char));
+  timestamps_ = map.timestamps_;
 }
 
 unsigned int Costmap2D::cellDistance(double world_dist)
@@ -195,20 +217,30 @@ unsigned char* Costmap2D::getCharMap() const
   return costmap_;
 }
 
-unsigned char Costmap2D::getCost(unsigned int mx, unsigned int my) const
-{
-  return costmap_[getIndex(mx, my)];
-}
-
 double Costmap2D::getTimeStamp(unsigned int mx, unsigned int my) const
 {
-  return timestamps_[getIndex(mx, my)];
+  return timestamps_.get(getIndex(mx, my));
 }
 
 void Costmap2D::setCost(unsigned int mx, unsigned int my, unsigned char cost)
 {
   costmap_[getIndex(mx, my)] = cost;
-  timestamps_[getIndex(mx, my)] = ros::Time::now().toSec();
+  if (hasTimeStamps())
+    timestamps_.set(getIndex(mx, my), ros::Time::now().toSec());
+}
+
+void Costmap2D::setCost(unsigned int mx, unsigned int my, unsigned char cost, double stamp)
+{
+  unsigned int index = getIndex(mx, my);
+  costmap_[index] = cost;
+  timestamps_.set(index, stamp);
+}
+
+void Costmap2D::setTimeStampPrecision(CellTimeStamps::Precision precision, double resolution)
+{
+  boost::unique_lock < boost::shared_mutex > lock(*access_);
+  timestamps_.setPrecision(precision, resolution);
+  timestamps_.resize(size_x_ * size_y_);
 }
 
 void Costmap2D::mapToWorld(unsigned int mx, unsigned int my, double& wx, double& wy) const
@@ -237,6 +269,37 @@ void Costmap2D::worldToMapNoBounds(double wx, double wy, int& mx, int& my) const
   my = (int)((wy - origin_y_) / resolution_);
 }
 
+unsigned int Costmap2D::worldToIndices(const double* wx, const double* wy, unsigned int n, int* indices) const
+{
+  const double ox = origin_x_, oy = origin_y_, inverse = inverse_resolution_;
+  const double size_x = size_x_, size_y = size_y_;
+  const int stride = size_x_;
+  unsigned int inside = 0;
+  for (unsigned int k = 0; k < n; ++k)
+  {
+    double gx = (wx[k] - ox) * inverse;
+    double gy = (wy[k] - oy) * inverse;
+    if (gx >= 0.0 && gx < size_x && gy >= 0.0 && gy < size_y)
+    {
+      indices[k] = (int)gx + (int)gy * stride;
+      ++inside;
+    }
+    else
+      indices[k] = -1;
+  }
+  return inside;
+}
+
+void Costmap2D::worldToMapNoBounds(const double* wx, const double* wy, unsigned int n, int* mx, int* my) const
+{
+  const double ox = origin_x_, oy = origin_y_, inverse = inverse_resolution_;
+  for (unsigned int k = 0; k < n; ++k)
+  {
+    mx[k] = (int)((wx[k] - ox) * inverse);
+    my[k] = (int)((wy[k] - oy) * inverse);
+  }
+}
+
 void Costmap2D::worldToMapEnforceBounds(double wx, double wy, int& mx, int& my) const
 {
   // Here we avoid doing any math to wx,wy before comparing them to
@@ -282,52 +345,28 @@ void Costmap2D::updateOrigin(double new_origin_x, double new_origin_y)
   new_grid_ox = origin_x_ + cell_ox * resolution_;
   new_grid_oy = origin_y_ + cell_oy * resolution_;
 
-  //To save casting from unsigned int to int a bunch of times
-  int size_x = size_x_;
-  int size_y = size_y_;
-
-  //we need to compute the overlap of the new and existing windows
-  int lower_left_x, lower_left_y, upper_right_x, upper_right_y;
-  lower_left_x = min(max(cell_ox, 0), size_x);
-  lower_left_y = min(max(cell_oy, 0), size_y);
-  upper_right_x = min(max(cell_ox + size_x, 0), size_x);
-  upper_right_y = min(max(cell_oy + size_y, 0), size_y);
-
-  unsigned int cell_size_x = upper_right_x - lower_left_x;
-  unsigned int cell_size_y = upper_right_y - lower_left_y;
-
-  //we need a map to store the obstacles in the window temporarily
-  unsigned char* local_map = new unsigned char[cell_size_x * cell_size_y];
-  double* local_map_timestamps = new double[cell_size_x * cell_size_y];
-
-  //copy the local window in the costmap to the local map
-  copyMapRegion(costmap_, lower_left_x, lower_left_y, size_x_, local_map, 0, 0, cell_size_x, cell_size_x, cell_size_y);
-  copyMapRegion(timestamps_, lower_left_x, lower_left_y, size_x_, local_map_timestamps, 0, 0, cell_size_x, cell_size_x, cell_size_y);
-
-  //now we'll set the costmap to be completely unknown if we track unknown space
-  resetMaps();
+  //move the overlap of the old and new window in place, only the exposed strips are reset
+  {
+    boost::unique_lock < boost::shared_mutex > lock(*access_);
+    shiftMapRegion(costmap_, size_x_, size_y_, cell_ox, cell_oy, default_value_);
+    timestamps_.shift(size_x_, size_y_, cell_ox, cell_oy);
+  }
 
   //update the origin with the appropriate world coordinates
   origin_x_ = new_grid_ox;
   origin_y_ = new_grid_oy;
-
-  //compute the starting cell location for copying data back in
-  int start_x = lower_left_x - cell_ox;
-  int start_y = lower_left_y - cell_oy;
-
-  //now we want to copy the overlapping information back into the map, but in its new location
-  copyMapRegion(local_map, 0, 0, cell_size_x, costmap_, start_x, start_y, size_x_, cell_size_x, cell_size_y);
-  copyMapRegion(local_map_timestamps, 0, 0, cell_size_x, timestamps_, start_x, start_y, size_x_, cell_size_x, cell_size_y);
-
-  //make sure to clean up
-  delete[] local_map;
-  delete[] local_map_timestamps;
 }
 
 bool Costmap2D::setConvexPolygonCost(const std::vector<geometry_msgs::Point>& polygon, unsigned char cost_value)
+{
+  return setConvexPolygonCost(polygon, cost_value, hasTimeStamps() ? ros::Time::now().toSec() : 0.0);
+}
+
+bool Costmap2D::setConvexPolygonCost(const std::vector<geometry_msgs::Point>& polygon, unsigned char cost_value,
+                                     double stamp)
 {
   //we assume the polygon is given in the global_frame... we need to transform it to map coordinates
-  std::vector<MapLocation> map_polygon;
+  map_polygon_.clear();
   for (unsigned int i = 0; i < polygon.size(); ++i)
   {
     MapLocation loc;
@@ -336,22 +375,35 @@ bool Costmap2D::setConvexPolygonCost(const std::vector<geometry_msgs::Point>& po
       // ("Polygon lies outside map bounds, so we can't fill it");
       return false;
     }
-    map_polygon.push_back(loc);
+    map_polygon_.push_back(loc);
   }
 
-  std::vector<MapLocation> polygon_cells;
+  //set the cost of the cells that fill the polygon, one row at a time
+  convexFillSpans(map_polygon_, FillRow(costmap_, timestamps_, size_x_, cost_value, stamp));
+  return true;
+}
+
+void Costmap2D::setRegionCost(unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn,
+                              unsigned char cost_value)
+{
+  setRegionCost(x0, y0, xn, yn, cost_value, hasTimeStamps() ? ros::Time::now().toSec() : 0.0);
+}
 
-  //get the cells that fill the polygon
-  convexFillCells(map_polygon, polygon_cells);
+void Costmap2D::setRegionCost(unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn,
+                              unsigned char cost_value, double stamp)
+{
+  xn = std::min(xn, size_x_);
+  yn = std::min(yn, size_y_);
+  if (x0 >= xn || y0 >= yn)
+    return;
 
-  //set the cost of those cells
-  for (unsigned int i = 0; i < polygon_cells.size(); ++i)
+  unsigned int len = xn - x0;
+  uint32_t tick = timestamps_.encode(stamp);
+  for (unsigned int index = y0 * size_x_ + x0; index < yn * size_x_; index += size_x_)
   {
-    unsigned int index = getIndex(polygon_cells[i].x, polygon_cells[i].y);
-    costmap_[index] = cost_value;
-    timestamps_[index] = ros::Time::now().toSec();
+    memset(costmap_ + index, cost_value, len * sizeof(unsigned char));
+    timestamps_.fill(index, len, tick);
   }
-  return true;
 }
 
 void Costmap2D::polygonOutlineCells(const std::vector<MapLocation>& polygon, std::vector<MapLocation>& polygon_cells)
@@ -370,75 +422,62 @@ void Costmap2D::polygonOutlineCells(const std::vector<MapLocation>& polygon, std
 }
 
 void Costmap2D::convexFillCells(const std::vector<MapLocation>& polygon, std::vector<MapLocation>& polygon_cells)
+{
+  convexFillSpans(polygon, PolygonFillCells(polygon_cells));
+}
+
+bool Costmap2D::convexFillRows(const std::vector<MapLocation>& polygon, unsigned int& min_y)
 {
   //we need a minimum polygon of a triangle
   if (polygon.size() < 3)
-    return;
-
-  //first get the cells that make up the outline of the polygon
-  polygonOutlineCells(polygon, polygon_cells);
+    return false;
 
-  //quick bubble sort to sort points by x
-  MapLocation swap;
-  unsigned int i = 0;
-  while (i < polygon_cells.size() - 1)
+  min_y = polygon[0].y;
+  unsigned int max_y = polygon[0].y;
+  for (unsigned int i = 1; i < polygon.size(); ++i)
   {
-    if (polygon_cells[i].x > polygon_cells[i + 1].x)
-    {
-      swap = polygon_cells[i];
-      polygon_cells[i] = polygon_cells[i + 1];
-      polygon_cells[i + 1] = swap;
-
-      if (i > 0)
-        --i;
-    }
-    else
-      ++i;
+    min_y = std::min(min_y, polygon[i].y);
+    max_y = std::max(max_y, polygon[i].y);
   }
+  fill_row_min_.assign(max_y - min_y + 1, UINT_MAX);
+  fill_row_max_.assign(max_y - min_y + 1, 0);
 
-  i = 0;
-  MapLocation min_pt;
-  MapLocation max_pt;
-  unsigned int min_x = polygon_cells[0].x;
-  unsigned int max_x = polygon_cells[polygon_cells.size() - 1].x;
-
-  //walk through each column and mark cells inside the polygon
-  for (unsigned int x = min_x; x <= max_x; ++x)
+  //walk the edges with the same steps as raytraceLine() in polygonOutlineCells(), keeping the extent of each row
+  for (unsigned int i = 0; i < polygon.size(); ++i)
   {
-    if (i >= polygon_cells.size() - 1)
-      break;
-
-    if (polygon_cells[i].y < polygon_cells[i + 1].y)
-    {
-      min_pt = polygon_cells[i];
-      max_pt = polygon_cells[i + 1];
-    }
-    else
-    {
-      min_pt = polygon_cells[i + 1];
-      max_pt = polygon_cells[i];
-    }
-
-    i += 2;
-    while (i < polygon_cells.size() && polygon_cells[i].x == x)
+    const MapLocation& p0 = polygon[i];
+    const MapLocation& p1 = polygon[(i + 1) % polygon.size()];
+    int dx = p1.x - p0.x;
+    int dy = p1.y - p0.y;
+    unsigned int abs_dx = abs(dx);
+    unsigned int abs_dy = abs(dy);
+    bool x_major = abs_dx >= abs_dy;
+    unsigned int abs_da = x_major ? abs_dx : abs_dy;
+    unsigned int abs_db = x_major ? abs_dy : abs_dx;
+    int step_x = sign(dx);
+    int step_y = sign(dy);
+
+    unsigned int x = p0.x, y = p0.y;
+    int error_b = abs_da / 2;
+    for (unsigned int j = 0; j <= abs_da; ++j)
     {
-      if (polygon_cells[i].y < min_pt.y)
-        min_pt = polygon_cells[i];
-      else if (polygon_cells[i].y > max_pt.y)
-        max_pt = polygon_cells[i];
-      ++i;
-    }
-
-    MapLocation pt;
-    //loop though cells in the column
-    for (unsigned int y = min_pt.y; y < max_pt.y; ++y)
-    {
-      pt.x = x;
-      pt.y = y;
-      polygon_cells.push_back(pt);
-
+      unsigned int r = y - min_y;
+      fill_row_min_[r] = std::min(fill_row_min_[r], x);
+      fill_row_max_[r] = std::max(fill_row_max_[r], x);
+      if (j == abs_da)
+        break;
+
+      error_b += abs_db;
+      bool step_b = (unsigned int)error_b >= abs_da;
+      if (step_b)
+        error_b -= abs_da;
+      if (x_major || step_b)
+        x += step_x;
+      if (!x_major || step_b)
+        y += step_y;
     }
   }
+  return true;
 }
 
 unsigned int Costmap2D::getSizeInCellsX() const
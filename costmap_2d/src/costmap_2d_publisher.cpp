@@ -38,6 +38,11 @@
 #include <boost/bind.hpp>
 #include <costmap_2d/costmap_2d_publisher.h>
 #include <costmap_2d/cost_values.h>
+#include <costmap_2d/grid_compression.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace costmap_2d
 {
@@ -45,11 +50,18 @@ namespace costmap_2d
 char* Costmap2DPublisher::cost_translation_table_ = NULL;
 
 Costmap2DPublisher::Costmap2DPublisher(ros::NodeHandle * ros_node, Costmap2D* costmap, std::string global_frame, std::string topic_name, bool always_send_full_costmap) :
-    node(ros_node), costmap_(costmap), global_frame_(global_frame), active_(false), always_send_full_costmap_(always_send_full_costmap)
+    node(ros_node), costmap_(costmap), global_frame_(global_frame), x0_(0), xn_(0), y0_(0), yn_(0), pending_(false),
+    publish_thread_(NULL), publish_thread_shutdown_(false), active_(false),
+    always_send_full_costmap_(always_send_full_costmap), frames_since_keyframe_(0), frame_(0)
 {
   costmap_pub_ = ros_node->advertise<nav_msgs::OccupancyGrid>( topic_name, 1, boost::bind( &Costmap2DPublisher::onNewSubscription, this, _1 ));
   costmap_update_pub_ = ros_node->advertise<map_msgs::OccupancyGridUpdate>( topic_name + "_updates", 1 );
 
+  ros_node->param("publish_compressed", publish_compressed_, false);
+  ros_node->param("compressed_keyframe_interval", keyframe_interval_, 50);
+  if (publish_compressed_)
+    compressed_pub_ = ros_node->advertise<costmap_2d::CompressedGridUpdate>( topic_name + "_compressed", 1 );
+
   if( cost_translation_table_ == NULL )
   {
     cost_translation_table_ = new char[256];
@@ -71,84 +83,248 @@ Costmap2DPublisher::Costmap2DPublisher(ros::NodeHandle * ros_node, Costmap2D* co
 
 Costmap2DPublisher::~Costmap2DPublisher()
 {
+  stopPublishThread();
+}
+
+void Costmap2DPublisher::startPublishThread(double frequency)
+{
+  stopPublishThread();
+  publish_thread_shutdown_ = false;
+  publish_thread_ = new boost::thread(boost::bind(&Costmap2DPublisher::publishLoop, this, frequency));
+}
+
+void Costmap2DPublisher::stopPublishThread()
+{
+  if (publish_thread_ == NULL)
+    return;
+  publish_thread_shutdown_ = true;
+  publish_thread_->join();
+  delete publish_thread_;
+  publish_thread_ = NULL;
+}
+
+void Costmap2DPublisher::publishLoop(double frequency)
+{
+  ros::NodeHandle nh;
+  ros::Rate r(frequency);
+  while (nh.ok() && !publish_thread_shutdown_)
+  {
+    bool pending;
+    {
+      boost::mutex::scoped_lock lock(bounds_mutex_);
+      pending = pending_;
+    }
+    if (pending)
+      publishCostmap();
+    r.sleep();
+  }
 }
 
 void Costmap2DPublisher::onNewSubscription( const ros::SingleSubscriberPublisher& pub )
 {
+  boost::mutex::scoped_lock lock(publish_mutex_);
   prepareGrid();
   pub.publish( grid_ );
 }
 
+void Costmap2DPublisher::translateCosts(const unsigned char* costs, int8_t* values, unsigned int length)
+{
+  unsigned int i = 0;
+#ifdef __SSE2__
+  // the regular costs are scaled as in the table, 1 + (97 * (cost - 1)) / 251, where the division
+  // is a multiplication by 2^22 / 251 rounded up, exact for all costs; the special values are selected in
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi16(1);
+  const __m128i scale = _mm_set1_epi16(97);
+  const __m128i divisor = _mm_set1_epi16(16711);
+  const __m128i inscribed = _mm_set1_epi8((char)INSCRIBED_INFLATED_OBSTACLE);
+  const __m128i lethal = _mm_set1_epi8((char)LETHAL_OBSTACLE);
+  const __m128i unknown = _mm_set1_epi8((char)NO_INFORMATION);
+  for (; i + 16 <= length; i += 16)
+  {
+    __m128i c = _mm_loadu_si128((const __m128i*)(costs + i));
+
+    __m128i lo = _mm_mullo_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(c, zero), one), scale);
+    __m128i hi = _mm_mullo_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(c, zero), one), scale);
+    lo = _mm_add_epi16(_mm_srli_epi16(_mm_mulhi_epu16(lo, divisor), 6), one);
+    hi = _mm_add_epi16(_mm_srli_epi16(_mm_mulhi_epu16(hi, divisor), 6), one);
+    __m128i v = _mm_packus_epi16(lo, hi);
+
+    __m128i mask = _mm_cmpeq_epi8(c, zero);
+    v = _mm_andnot_si128(mask, v);
+    mask = _mm_cmpeq_epi8(c, inscribed);
+    v = _mm_or_si128(_mm_and_si128(mask, _mm_set1_epi8(99)), _mm_andnot_si128(mask, v));
+    mask = _mm_cmpeq_epi8(c, lethal);
+    v = _mm_or_si128(_mm_and_si128(mask, _mm_set1_epi8(100)), _mm_andnot_si128(mask, v));
+    v = _mm_or_si128(v, _mm_cmpeq_epi8(c, unknown));
+
+    _mm_storeu_si128((__m128i*)(values + i), v);
+  }
+#endif
+  for (; i < length; i++)
+  {
+    values[i] = cost_translation_table_[costs[i]];
+  }
+}
+
 // prepare grid_ message for publication.
 void Costmap2DPublisher::prepareGrid()
 {
-  boost::shared_lock < boost::shared_mutex > lock(*(costmap_->getLock()));
-  double resolution = costmap_->getResolution();
-
-  grid_.header.frame_id = global_frame_;
-  grid_.header.stamp = ros::Time::now();
-  grid_.info.resolution = resolution;
+  {
+    boost::shared_lock < boost::shared_mutex > lock(*(costmap_->getLock()));
+    double resolution = costmap_->getResolution();
 
-  grid_.info.width = costmap_->getSizeInCellsX();
-  grid_.info.height = costmap_->getSizeInCellsY();
+    grid_.header.frame_id = global_frame_;
+    grid_.header.stamp = ros::Time::now();
+    grid_.info.resolution = resolution;
 
-  double wx, wy;
-  costmap_->mapToWorld(0, 0, wx, wy);
-  grid_.info.origin.position.x = wx - resolution / 2;
-  grid_.info.origin.position.y = wy - resolution / 2;
-  grid_.info.origin.position.z = 0.0;
-  grid_.info.origin.orientation.w = 1.0;
+    grid_.info.width = costmap_->getSizeInCellsX();
+    grid_.info.height = costmap_->getSizeInCellsY();
 
-  grid_.data.resize(grid_.info.width * grid_.info.height);
+    double wx, wy;
+    costmap_->mapToWorld(0, 0, wx, wy);
+    grid_.info.origin.position.x = wx - resolution / 2;
+    grid_.info.origin.position.y = wy - resolution / 2;
+    grid_.info.origin.position.z = 0.0;
+    grid_.info.origin.orientation.w = 1.0;
 
-  unsigned char* data = costmap_->getCharMap();
-  for (unsigned int i = 0; i < grid_.data.size(); i++)
-  {
-    grid_.data[i] = cost_translation_table_[ data[ i ]];
+    snapshot_.resize(grid_.info.width * grid_.info.height);
+    if (!snapshot_.empty())
+      memcpy(&snapshot_[0], costmap_->getCharMap(), snapshot_.size());
   }
+
+  grid_.data.resize(snapshot_.size());
+  if (!snapshot_.empty())
+    translateCosts(&snapshot_[0], &grid_.data[0], snapshot_.size());
 }
 
 void Costmap2DPublisher::publishCostmap()
 {
+  boost::mutex::scoped_lock publish_lock(publish_mutex_);
+
+  // take the changed-rectangle, changes from now on go into the next publication
+  unsigned int x0, xn, y0, yn;
+  {
+    boost::mutex::scoped_lock lock(bounds_mutex_);
+    x0 = x0_;
+    xn = xn_;
+    y0 = y0_;
+    yn = yn_;
+    xn_ = yn_ = 0;
+    x0_ = costmap_->getSizeInCellsX();
+    y0_ = costmap_->getSizeInCellsY();
+    pending_ = false;
+  }
+
   double resolution = costmap_->getResolution();
 
-  if (always_send_full_costmap_ || grid_.info.resolution != resolution || grid_.info.width != costmap_->getSizeInCellsX())
+  if (always_send_full_costmap_ || grid_.info.resolution != resolution || grid_.info.width != costmap_->getSizeInCellsX()
+      || grid_.info.height != costmap_->getSizeInCellsY())
   {
     prepareGrid();
     if (costmap_pub_.getNumSubscribers() > 0) {
       costmap_pub_.publish( grid_ );
     }
+    if (!grid_.data.empty())
+      publishCompressed(grid_.header.stamp, 0, 0, grid_.info.width, grid_.info.height, &grid_.data[0]);
   }
-  else if (x0_ < xn_)
+  else if (x0 < xn && y0 < yn)
   {
-    boost::shared_lock < boost::shared_mutex > lock(*(costmap_->getLock()));
     // Publish Just an Update
     map_msgs::OccupancyGridUpdate update;
-    update.header.stamp = ros::Time::now();
     update.header.frame_id = global_frame_;
-    update.x = x0_;
-    update.y = y0_;
-    update.width = xn_ - x0_;
-    update.height = yn_ - y0_;
-    update.data.resize(update.width * update.height);
-
-    unsigned int i = 0;
-    for (unsigned int y = y0_; y < yn_; y++)
+    update.x = x0;
+    update.y = y0;
+    update.width = xn - x0;
+    update.height = yn - y0;
+    snapshot_.resize(update.width * update.height);
+
     {
-      for (unsigned int x = x0_; x < xn_; x++)
+      boost::shared_lock < boost::shared_mutex > lock(*(costmap_->getLock()));
+      // the map may have been resized since the rectangle was taken
+      if (xn > costmap_->getSizeInCellsX() || yn > costmap_->getSizeInCellsY())
+        return;
+
+      update.header.stamp = ros::Time::now();
+      unsigned char* data = costmap_->getCharMap();
+      for (unsigned int y = y0; y < yn; y++)
       {
-        unsigned char cost = costmap_->getCost(x, y);
-        update.data[i++] = cost_translation_table_[ cost ];
+        memcpy(&snapshot_[(y - y0) * update.width], data + costmap_->getIndex(x0, y), update.width);
       }
     }
+
+    update.data.resize(snapshot_.size());
+    translateCosts(&snapshot_[0], &update.data[0], snapshot_.size());
     if (costmap_update_pub_.getNumSubscribers() > 0) {
       costmap_update_pub_.publish(update);
     }
+    publishCompressed(update.header.stamp, update.x, update.y, update.width, update.height, &update.data[0]);
+  }
+}
+
+void Costmap2DPublisher::publishCompressed(const ros::Time& stamp, unsigned int x, unsigned int y,
+                                           unsigned int width, unsigned int height, const int8_t* values)
+{
+  if (!publish_compressed_)
+    return;
+
+  // without subscribers nobody keeps track of the frames, the next one that subscribes needs a keyframe
+  if (compressed_pub_.getNumSubscribers() == 0)
+  {
+    last_sent_.clear();
+    return;
+  }
+
+  const unsigned int size_x = grid_.info.width, size_y = grid_.info.height;
+  bool keyframe = last_sent_.size() != size_x * size_y || ++frames_since_keyframe_ >= keyframe_interval_;
+  if (keyframe && (width != size_x || height != size_y))
+  {
+    // a keyframe covers the whole map, grid_ has the same size as the map, see publishCostmap()
+    prepareGrid();
+    if (grid_.info.width != size_x || grid_.info.height != size_y)
+      return;
+    values = &grid_.data[0];
+    x = y = 0;
+    width = size_x;
+    height = size_y;
+  }
+
+  costmap_2d::CompressedGridUpdate update;
+  update.header.stamp = stamp;
+  update.header.frame_id = global_frame_;
+  update.info = grid_.info;
+  update.frame = frame_++;
+  update.keyframe = keyframe;
+  update.x = x;
+  update.y = y;
+  update.width = width;
+  update.height = height;
+
+  if (keyframe)
+  {
+    last_sent_.assign(values, values + width * height);
+    encodeRunLength(values, width * height, update.data);
+    frames_since_keyframe_ = 0;
+  }
+  else
+  {
+    // unchanged cells become zeros, which compress into long runs
+    delta_.resize(width * height);
+    for (unsigned int j = 0; j < height; ++j)
+    {
+      int8_t* sent = &last_sent_[(y + j) * size_x + x];
+      const int8_t* row = values + j * width;
+      int8_t* delta = &delta_[j * width];
+      for (unsigned int i = 0; i < width; ++i)
+      {
+        delta[i] = row[i] ^ sent[i];
+        sent[i] = row[i];
+      }
+    }
+    encodeRunLength(&delta_[0], delta_.size(), update.data);
   }
 
-  xn_ = yn_ = 0;
-  x0_ = costmap_->getSizeInCellsX();
-  y0_ = costmap_->getSizeInCellsY();
+  compressed_pub_.publish(update);
 }
 
 } // end namespace costmap_2d
@@ -0,0 +1,103 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/costmap_recorder.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+/**
+ * Replays the log a costmap recorded with ~record_directory, printing a line per frame:
+ * the time, the grid, whether it is a keyframe, the cells it changed and the bytes it took.
+ * Given a grid, a time and a file, the grid as of that time is also written as a pgm image.
+ */
+int main(int argc, char** argv)
+{
+  if (argc != 2 && argc != 5)
+  {
+    fprintf(stderr, "usage: %s <log directory> [<grid> <time> <pgm file>]\n", argv[0]);
+    return 1;
+  }
+
+  costmap_2d::CostmapLogReader reader;
+  if (!reader.open(argv[1]))
+  {
+    fprintf(stderr, "No costmap log in %s\n", argv[1]);
+    return 1;
+  }
+
+  std::string grid_name = argc == 5 ? argv[2] : "";
+  double stamp = argc == 5 ? atof(argv[3]) : 0.0;
+  costmap_2d::Costmap2D snapshot;
+  bool have_snapshot = false;
+
+  unsigned int frames = 0;
+  size_t bytes = 0;
+  while (reader.next())
+  {
+    printf("%.3f %s %s %u cells %lu bytes\n", reader.getStamp(), reader.getName().c_str(),
+           reader.isKeyframe() ? "keyframe" : "delta", reader.getChangedCells(), (unsigned long)reader.getFrameBytes());
+    ++frames;
+    bytes += reader.getFrameBytes();
+    if (reader.getName() == grid_name && reader.getStamp() <= stamp)
+    {
+      snapshot = *reader.getGrid(grid_name);
+      have_snapshot = true;
+    }
+  }
+  printf("%u frames, %lu bytes\n", frames, (unsigned long)bytes);
+
+  if (argc != 5)
+    return 0;
+  if (!have_snapshot)
+  {
+    fprintf(stderr, "No frame of %s up to %.3f\n", grid_name.c_str(), stamp);
+    return 1;
+  }
+
+  // the rows of an image go down, those of the grid up
+  FILE* image = fopen(argv[4], "wb");
+  if (image == NULL)
+  {
+    fprintf(stderr, "Could not write %s\n", argv[4]);
+    return 1;
+  }
+  unsigned int size_x = snapshot.getSizeInCellsX(), size_y = snapshot.getSizeInCellsY();
+  fprintf(image, "P5\n# resolution %.3f origin %.3f %.3f\n%u %u\n255\n", snapshot.getResolution(),
+          snapshot.getOriginX(), snapshot.getOriginY(), size_x, size_y);
+  for (unsigned int y = size_y; y > 0; --y)
+    fwrite(snapshot.getCharMap() + snapshot.getIndex(0, y - 1), 1, size_x, image);
+  fclose(image);
+  return 0;
+}
@@ -38,10 +38,14 @@
 #include "costmap_2d/array_parser.h"
 #include <costmap_2d/layered_costmap.h>
 #include <costmap_2d/costmap_2d_ros.h>
+#include <costmap_2d/costmap_layer.h>
+#include <costmap_2d/costmap_checkpoint.h>
+#include <costmap_2d/UpdateStatistics.h>
 #include <cstdio>
 #include <string>
 #include <algorithm>
 #include <vector>
+#include <limits>
 
 
 using namespace std;
@@ -64,7 +68,7 @@ Costmap2DROS::Costmap2DROS(std::string name, tf::TransformListener& tf) :
     layered_costmap_(NULL), name_(name), tf_(tf), stop_updates_(false), initialized_(true), stopped_(false), robot_stopped_(
         false), map_update_thread_(NULL), last_publish_(0), plugin_loader_("costmap_2d",
                                                                            "costmap_2d::Layer"), publisher_(
-        NULL)
+        NULL), fine_costmap_(NULL), fine_publisher_(NULL)
 {
   ros::NodeHandle private_nh("~/" + name);
   ros::NodeHandle g_nh;
@@ -105,6 +109,14 @@ Costmap2DROS::Costmap2DROS(std::string name, tf::TransformListener& tf) :
 
   layered_costmap_ = new LayeredCostmap(global_frame_, rolling_window, track_unknown_space);
 
+  int update_threads;
+  private_nh.param("update_threads", update_threads, 1);
+  layered_costmap_->setUpdateThreads(std::max(1, update_threads));
+
+  int update_tile_cells;
+  private_nh.param("update_tile_cells", update_tile_cells, 0);
+  layered_costmap_->setTileCells(std::max(0, update_tile_cells));
+
   if (!private_nh.hasParam("plugins"))
   {
     resetOldParameters(private_nh);
@@ -126,6 +138,9 @@ Costmap2DROS::Costmap2DROS(std::string name, tf::TransformListener& tf) :
     }
   }
 
+  // a fine rolling window around the robot composited over this costmap, see LayeredCostmap::setInnerCostmap()
+  createFineCostmap(private_nh, track_unknown_space, always_send_full_costmap);
+
   // subscribe to the footprint topic
   std::string topic_param, topic;
   if(!private_nh.searchParam("footprint_topic", topic_param))
@@ -139,6 +154,68 @@ Costmap2DROS::Costmap2DROS(std::string name, tf::TransformListener& tf) :
   readFootprintFromParams( private_nh );
 
   publisher_ = new Costmap2DPublisher(&private_nh, layered_costmap_->getCostmap(), global_frame_, "costmap", always_send_full_costmap);
+  private_nh.param("publish_thread", publish_thread_, false);
+  private_nh.param("costmap_snapshots", costmap_snapshots_, false);
+
+  // wake up the update loop when observations arrive instead of at a fixed rate
+  private_nh.param("update_on_observations", update_on_observations_, false);
+  private_nh.param("update_min_observations", update_min_observations_, 1);
+
+  // slow the update loop down while the robot stands and nothing new shows up around it
+  private_nh.param("adaptive_update", adaptive_update_, false);
+  private_nh.param("min_update_frequency", min_update_frequency_, 1.0);
+  private_nh.param("update_full_speed", update_full_speed_, 0.5);
+  private_nh.param("update_full_angular_speed", update_full_angular_speed_, 1.0);
+  private_nh.param("update_full_new_obstacles", update_full_new_obstacles_, 50);
+  robot_speed_ = robot_angular_speed_ = std::numeric_limits<double>::infinity();
+  obstacle_activity_ = 0.0;
+
+  // while idle, see idle(), the layers take in sensor data at this rate and nothing is computed or published
+  private_nh.param("idle_update_frequency", idle_update_frequency_, 0.5);
+  idle_ = false;
+
+  // periodically save the grids so a restarted node does not start from empty layers
+  private_nh.param("checkpoint_directory", checkpoint_directory_, std::string(""));
+  private_nh.param("checkpoint_period", checkpoint_period_, 5.0);
+  private_nh.param("checkpoint_max_age", checkpoint_max_age_, 60.0);
+  checkpoints_restored_ = checkpoint_directory_.empty();
+
+  // log the changes of the grids to a ring of files, see costmap_2d_replay
+  std::string record_directory;
+  private_nh.param("record_directory", record_directory, std::string(""));
+  if (!record_directory.empty())
+  {
+    double segment_size;
+    int segments, keyframe_period;
+    private_nh.param("record_segment_size", segment_size, 16.0);
+    private_nh.param("record_segments", segments, 8);
+    private_nh.param("record_keyframe_period", keyframe_period, 600);
+    recorder_.reset(new CostmapRecorder(record_directory, segment_size * 1024 * 1024, std::max(1, segments),
+                                        std::max(0, keyframe_period)));
+    record_bounds_user_ = layered_costmap_->addChangedBoundsUser();
+  }
+
+  // reuse a looked up robot pose for this long instead of asking tf on every call
+  private_nh.param("robot_pose_cache_time", pose_cache_time_, 0.0);
+  pose_cached_ = false;
+
+  double statistics_rate;
+  private_nh.param("statistics_rate", statistics_rate, 0.0);
+  statistics_enabled_ = statistics_rate > 0.0;
+  statistics_updates_ = statistics_max_cells_ = 0;
+  statistics_cells_ = 0.0;
+  if (statistics_enabled_)
+  {
+    statistics_period_ = ros::WallDuration(1.0 / statistics_rate);
+    statistics_pub_ = private_nh.advertise<costmap_2d::UpdateStatistics>("statistics", 1, true);
+    statistics_last_time_ = ros::WallTime::now();
+  }
+  layered_costmap_->setTiming(statistics_enabled_);
+
+  // batch footprint checks for whole routes, see getFootprintCosts()
+  private_nh.param("footprint_cost_headings", footprint_cost_headings_, 72);
+  footprint_cost_headings_ = std::max(1, footprint_cost_headings_);
+  footprint_costs_srv_ = private_nh.advertiseService("get_footprint_costs", &Costmap2DROS::footprintCostsService, this);
 
   // create a thread to handle updating the map
   stop_updates_ = false;
@@ -155,6 +232,61 @@ Costmap2DROS::Costmap2DROS(std::string name, tf::TransformListener& tf) :
   dsrv_->setCallback(cb);
 }
 
+void Costmap2DROS::createFineCostmap(ros::NodeHandle& private_nh, bool track_unknown_space,
+                                     bool always_send_full_costmap)
+{
+  double fine_window, fine_resolution;
+  private_nh.param("fine_window", fine_window, 0.0);
+  private_nh.param("fine_resolution", fine_resolution, 0.05);
+  if (fine_window <= 0.0 || fine_resolution <= 0.0)
+    return;
+
+  // the window has the same layers unless ~fine_plugins lists others, they read their parameters from
+  // ~fine/<layer>, which start out as a copy of ~<layer>
+  XmlRpc::XmlRpcValue my_list;
+  if ((!private_nh.getParam("fine_plugins", my_list) && !private_nh.getParam("plugins", my_list))
+      || my_list.getType() != XmlRpc::XmlRpcValue::TypeArray)
+  {
+    ROS_WARN("The fine window of the %s costmap has no layers, not creating it", name_.c_str());
+    return;
+  }
+
+  fine_costmap_ = new LayeredCostmap(global_frame_, true, track_unknown_space);
+  int update_threads, update_tile_cells;
+  private_nh.param("update_threads", update_threads, 1);
+  private_nh.param("update_tile_cells", update_tile_cells, 0);
+  fine_costmap_->setUpdateThreads(std::max(1, update_threads));
+  fine_costmap_->setTileCells(std::max(0, update_tile_cells));
+
+  ros::NodeHandle fine_nh(private_nh, "fine");
+  for (int32_t i = 0; i < my_list.size(); ++i)
+  {
+    std::string pname = static_cast<std::string>(my_list[i]["name"]);
+    std::string type = static_cast<std::string>(my_list[i]["type"]);
+    if (!fine_nh.hasParam(pname))
+      move_parameter(private_nh, fine_nh, pname, false);
+    ROS_INFO("Using plugin \"%s\" in the fine window", pname.c_str());
+
+    boost::shared_ptr<Layer> plugin = plugin_loader_.createInstance(type);
+    fine_costmap_->addPlugin(plugin);
+    plugin->initialize(fine_costmap_, name_ + "/fine/" + pname, &tf_);
+  }
+
+  unsigned int cells = (unsigned int)(fine_window / fine_resolution);
+  fine_costmap_->resizeMap(cells, cells, fine_resolution, 0.0, 0.0, true);
+  layered_costmap_->setInnerCostmap(fine_costmap_);
+  fine_publisher_ = new Costmap2DPublisher(&private_nh, fine_costmap_->getCostmap(), global_frame_, "fine_costmap",
+                                           always_send_full_costmap);
+}
+
+std::vector<boost::shared_ptr<Layer> > Costmap2DROS::getAllPlugins()
+{
+  std::vector<boost::shared_ptr<Layer> > plugins = *layered_costmap_->getPlugins();
+  if (fine_costmap_ != NULL)
+    plugins.insert(plugins.end(), fine_costmap_->getPlugins()->begin(), fine_costmap_->getPlugins()->end());
+  return plugins;
+}
+
 void Costmap2DROS::setUnpaddedRobotFootprintPolygon( const geometry_msgs::Polygon& footprint )
 {
   setUnpaddedRobotFootprint( toPointVector( footprint ));
@@ -170,8 +302,12 @@ Costmap2DROS::~Costmap2DROS()
   }
   if (publisher_ != NULL)
     delete publisher_;
+  if (fine_publisher_ != NULL)
+    delete fine_publisher_;
 
   delete layered_costmap_;
+  if (fine_costmap_ != NULL)
+    delete fine_costmap_;
   delete dsrv_;
 }
 
@@ -268,6 +404,15 @@ void Costmap2DROS::reconfigureCB(costmap_2d::Costmap2DConfig &config, uint32_t l
   else
     publish_cycle = ros::Duration(-1);
 
+  if (publish_thread_ && map_publish_frequency > 0)
+    publisher_->startPublishThread(map_publish_frequency);
+  else
+    publisher_->stopPublishThread();
+  if (fine_publisher_ != NULL && publish_thread_ && map_publish_frequency > 0)
+    fine_publisher_->startPublishThread(map_publish_frequency);
+  else if (fine_publisher_ != NULL)
+    fine_publisher_->stopPublishThread();
+
   // find size parameters
   double map_width_meters = config.width, map_height_meters = config.height, resolution = config.resolution, origin_x =
              config.origin_x,
@@ -507,6 +652,8 @@ void Costmap2DROS::setUnpaddedRobotFootprint( const std::vector<geometry_msgs::P
   }
 
   layered_costmap_->setFootprint( padded_footprint_ );
+  if (fine_costmap_ != NULL)
+    fine_costmap_->setFootprint( padded_footprint_ );
 }
 
 void Costmap2DROS::movementCB(const ros::TimerEvent &event)
@@ -520,9 +667,19 @@ void Costmap2DROS::movementCB(const ros::TimerEvent &event)
   {
     ROS_WARN_THROTTLE(1.0, "Could not get robot pose, cancelling reconfiguration");
     robot_stopped_ = false;
+    robot_speed_ = robot_angular_speed_ = std::numeric_limits<double>::infinity();
+    return;
   }
+
+  double dt = (event.current_real - event.last_real).toSec();
+  if (dt > 0.0)
+  {
+    robot_speed_ = (old_pose_.getOrigin() - new_pose.getOrigin()).length() / dt;
+    robot_angular_speed_ = fabs(old_pose_.getRotation().angle(new_pose.getRotation())) / dt;
+  }
+
   //make sure that the robot is not moving
-  else if (fabs((old_pose_.getOrigin() - new_pose.getOrigin()).length()) < 1e-3
+  if (fabs((old_pose_.getOrigin() - new_pose.getOrigin()).length()) < 1e-3
       && fabs(old_pose_.getRotation().angle(new_pose.getRotation())) < 1e-3)
   {
     old_pose_ = new_pose;
@@ -550,6 +707,29 @@ void Costmap2DROS::mapUpdateLoop(double frequency)
     gettimeofday(&start, NULL);
 
     updateMap();
+    if (idle_)
+    {
+      // wait in steps of the full rate, so start() does not wait for the rest of an idle period
+      ros::WallTime cycle_start = ros::WallTime(start.tv_sec, start.tv_usec * 1000);
+      ros::WallDuration step(1 / frequency);
+      while (nh.ok() && !map_update_thread_shutdown_ && idle_)
+      {
+        ros::WallDuration remaining = cycle_start + ros::WallDuration(1 / std::max(idle_update_frequency_, 1e-3))
+            - ros::WallTime::now();
+        if (remaining <= ros::WallDuration(0))
+          break;
+        std::min(remaining, step).sleep();
+      }
+      continue;
+    }
+    recordStatistics();
+    if (costmap_snapshots_ && layered_costmap_->isInitialized())
+      updateSnapshot();
+    if (!checkpoint_directory_.empty() && checkpoint_period_ > 0 && layered_costmap_->isInitialized()
+        && last_checkpoint_ + ros::Duration(checkpoint_period_) < ros::Time::now())
+      writeCheckpoints();
+    if (recorder_ && layered_costmap_->isInitialized())
+      recordFrame();
 
     gettimeofday(&end, NULL);
     start_t = start.tv_sec + double(start.tv_usec) / 1e6;
@@ -561,14 +741,48 @@ void Costmap2DROS::mapUpdateLoop(double frequency)
       unsigned int x0, y0, xn, yn;
       layered_costmap_->getBounds(&x0, &xn, &y0, &yn);
       publisher_->updateBounds(x0, xn, y0, yn);
+      if (fine_publisher_ != NULL)
+      {
+        fine_costmap_->getBounds(&x0, &xn, &y0, &yn);
+        fine_publisher_->updateBounds(x0, xn, y0, yn);
+      }
 
       ros::Time now = ros::Time::now();
-      if (last_publish_ + publish_cycle < now)
+      if (!publish_thread_ && last_publish_ + publish_cycle < now)
       {
         publisher_->publishCostmap();
+        if (fine_publisher_ != NULL)
+          fine_publisher_->publishCostmap();
         last_publish_ = now;
       }
     }
+    if (update_on_observations_)
+    {
+      // the update frequency only bounds the time between updates when no observations arrive
+      layered_costmap_->waitForUpdateRequest(std::max(1, update_min_observations_), 1 / frequency);
+      continue;
+    }
+    if (adaptive_update_)
+    {
+      // new obstacles keep the rate up for a few updates, as long as they keep showing up
+      double new_obstacles = layered_costmap_->takeNewObstacles();
+      if (update_full_new_obstacles_ > 0)
+        obstacle_activity_ = std::max(new_obstacles / update_full_new_obstacles_, obstacle_activity_ / 2);
+
+      // wait in steps of the full rate, so the loop speeds up within one of them once the robot starts moving
+      ros::WallTime cycle_start = ros::WallTime(start.tv_sec, start.tv_usec * 1000);
+      ros::WallDuration step(1 / frequency);
+      while (nh.ok() && !map_update_thread_shutdown_)
+      {
+        ros::WallDuration remaining = cycle_start + ros::WallDuration(1 / adaptiveFrequency(frequency))
+            - ros::WallTime::now();
+        if (remaining <= ros::WallDuration(0))
+          break;
+        std::min(remaining, step).sleep();
+      }
+      continue;
+    }
+
     r.sleep();
     // make sure to sleep for the remainder of our cycle time
     if (r.cycleTime() > ros::Duration(1 / frequency))
@@ -577,23 +791,237 @@ void Costmap2DROS::mapUpdateLoop(double frequency)
   }
 }
 
+double Costmap2DROS::adaptiveFrequency(double frequency)
+{
+  double min_frequency = std::min(std::max(min_update_frequency_, 1e-3), frequency);
+  double activity = obstacle_activity_;
+  if (update_full_speed_ > 0)
+    activity = std::max(activity, robot_speed_ / update_full_speed_);
+  if (update_full_angular_speed_ > 0)
+    activity = std::max(activity, robot_angular_speed_ / update_full_angular_speed_);
+  activity = std::min(1.0, activity);
+  return min_frequency + activity * (frequency - min_frequency);
+}
+
 void Costmap2DROS::updateMap()
 {
   if (!stop_updates_)
   {
+    // an update started while idle does not count as the one start() waits for
+    bool idle = idle_;
     //get global pose
     tf::Stamped < tf::Pose > pose;
     if (getRobotPose (pose))
     {
+      if (!checkpoints_restored_)
+        restoreCheckpoints();
+      layered_costmap_->setCostsSuspended(idle);
       layered_costmap_->updateMap(pose.getOrigin().x(), pose.getOrigin().y(), tf::getYaw(pose.getRotation()));
-      initialized_ = true;
+      if (!idle)
+        initialized_ = true;
     }
   }
 }
 
-void Costmap2DROS::start()
+void Costmap2DROS::recordStatistics()
+{
+  UpdateTiming timing;
+  if (!statistics_enabled_ || !layered_costmap_->getLastTiming(timing))
+    return;
+
+  std::vector<boost::shared_ptr<Layer> >* plugins = layered_costmap_->getPlugins();
+  stage_times_.resize(2 + 2 * plugins->size());
+  stage_times_[0].push_back(timing.total);
+  stage_times_[1].push_back(timing.lock_wait);
+  for (unsigned int i = 0; i < timing.bounds.size() && 2 * i + 3 < stage_times_.size(); ++i)
+  {
+    stage_times_[2 * i + 2].push_back(timing.bounds[i]);
+    stage_times_[2 * i + 3].push_back(timing.costs[i]);
+  }
+  statistics_updates_++;
+  statistics_cells_ += timing.cells;
+  statistics_max_cells_ = std::max(statistics_max_cells_, timing.cells);
+
+  ros::WallTime now = ros::WallTime::now();
+  if (now - statistics_last_time_ < statistics_period_)
+    return;
+
+  costmap_2d::UpdateStatistics msg;
+  msg.header.stamp = ros::Time::now();
+  msg.header.frame_id = global_frame_;
+  msg.updates = statistics_updates_;
+  msg.mean_cells = statistics_cells_ / statistics_updates_;
+  msg.max_cells = statistics_max_cells_;
+  msg.stages.resize(stage_times_.size());
+  for (unsigned int i = 0; i < stage_times_.size(); ++i)
+  {
+    std::vector<double>& times = stage_times_[i];
+    costmap_2d::StageStatistics& stage = msg.stages[i];
+    if (i == 0)
+      stage.name = "update";
+    else if (i == 1)
+      stage.name = "lock";
+    else
+      stage.name = (*plugins)[(i - 2) / 2]->getName() + (i % 2 == 0 ? "/bounds" : "/costs");
+    stage.count = times.size();
+    if (times.empty())
+      continue;
+
+    std::sort(times.begin(), times.end());
+    double sum = 0.0;
+    for (unsigned int k = 0; k < times.size(); k++)
+      sum += times[k];
+    stage.mean = sum / times.size();
+    stage.median = times[times.size() / 2];
+    stage.p90 = times[std::min(times.size() - 1, times.size() * 90 / 100)];
+    stage.p99 = times[std::min(times.size() - 1, times.size() * 99 / 100)];
+    stage.max = times.back();
+    times.clear();
+  }
+  statistics_pub_.publish(msg);
+
+  statistics_updates_ = statistics_max_cells_ = 0;
+  statistics_cells_ = 0.0;
+  statistics_last_time_ = now;
+}
+
+void Costmap2DROS::updateSnapshot()
+{
+  // readers only ever get snapshot_, so once nobody holds the spare anymore nobody can get it either
+  boost::shared_ptr<Costmap2D> snapshot;
+  {
+    boost::mutex::scoped_lock lock(snapshot_mutex_);
+    if (spare_snapshot_ && spare_snapshot_.unique())
+      snapshot = spare_snapshot_;
+    spare_snapshot_.reset();
+  }
+
+  Costmap2D* master = layered_costmap_->getCostmap();
+  {
+    boost::shared_lock < boost::shared_mutex > lock(*(master->getLock()));
+    if (snapshot)
+      snapshot->copyCostsFrom(*master);
+    else
+      snapshot.reset(new Costmap2D(*master));
+  }
+
+  boost::mutex::scoped_lock lock(snapshot_mutex_);
+  spare_snapshot_ = snapshot_;
+  snapshot_ = snapshot;
+}
+
+std::string Costmap2DROS::checkpointPath(const std::string& name) const
+{
+  std::string file = name;
+  std::replace(file.begin(), file.end(), '/', '_');
+  return checkpoint_directory_ + "/" + file + ".checkpoint";
+}
+
+void Costmap2DROS::writeCheckpoints()
+{
+  last_checkpoint_ = ros::Time::now();
+  double stamp = last_checkpoint_.toSec();
+
+  // the grids are copied under their locks, the files are written without holding them
+  std::vector<std::pair<std::string, Costmap2D*> > grids;
+  grids.push_back(std::make_pair(name_, layered_costmap_->getCostmap()));
+  std::vector < boost::shared_ptr<Layer> > *plugins = layered_costmap_->getPlugins();
+  for (vector<boost::shared_ptr<Layer> >::iterator plugin = plugins->begin(); plugin != plugins->end(); ++plugin)
+  {
+    boost::shared_ptr<CostmapLayer> layer = boost::dynamic_pointer_cast<CostmapLayer>(*plugin);
+    if (layer)
+      grids.push_back(std::make_pair(layer->getName(), (Costmap2D*)layer.get()));
+  }
+
+  for (unsigned int i = 0; i < grids.size(); ++i)
+  {
+    Costmap2D copy;
+    {
+      boost::shared_lock < boost::shared_mutex > lock(*(grids[i].second->getLock()));
+      copy = *grids[i].second;
+    }
+    if (!writeCheckpoint(checkpointPath(grids[i].first), grids[i].first, global_frame_, stamp, copy))
+      ROS_WARN_THROTTLE(60.0, "Could not write the checkpoint of %s to %s", grids[i].first.c_str(),
+                        checkpoint_directory_.c_str());
+  }
+}
+
+void Costmap2DROS::recordFrame()
+{
+  // the layers only change within the bounds of the master grid
+  unsigned int x0, xn, y0, yn;
+  if (!layered_costmap_->takeChangedBounds(record_bounds_user_, &x0, &xn, &y0, &yn))
+    return;
+
+  double stamp = ros::Time::now().toSec();
+  std::vector<std::pair<std::string, Costmap2D*> > grids;
+  grids.push_back(std::make_pair(name_, layered_costmap_->getCostmap()));
+  std::vector < boost::shared_ptr<Layer> > *plugins = layered_costmap_->getPlugins();
+  for (vector<boost::shared_ptr<Layer> >::iterator plugin = plugins->begin(); plugin != plugins->end(); ++plugin)
+  {
+    boost::shared_ptr<CostmapLayer> layer = boost::dynamic_pointer_cast<CostmapLayer>(*plugin);
+    if (layer)
+      grids.push_back(std::make_pair(layer->getName(), (Costmap2D*)layer.get()));
+  }
+
+  for (unsigned int i = 0; i < grids.size(); ++i)
+  {
+    boost::shared_lock < boost::shared_mutex > lock(*(grids[i].second->getLock()));
+    if (!recorder_->record(grids[i].first, stamp, *grids[i].second, x0, xn, y0, yn))
+      ROS_WARN_THROTTLE(60.0, "The costmap recorder falls behind, dropped a frame of %s", grids[i].first.c_str());
+  }
+}
+
+void Costmap2DROS::restoreCheckpoints()
 {
+  // wait for the layers to know the size of the map
+  Costmap2D* master = layered_costmap_->getCostmap();
+  if (master->getSizeInCellsX() == 0 || master->getSizeInCellsY() == 0)
+    return;
+  checkpoints_restored_ = true;
+
+  double min_stamp = ros::Time::now().toSec() - checkpoint_max_age_;
   std::vector < boost::shared_ptr<Layer> > *plugins = layered_costmap_->getPlugins();
+  for (vector<boost::shared_ptr<Layer> >::iterator plugin = plugins->begin(); plugin != plugins->end(); ++plugin)
+  {
+    boost::shared_ptr<CostmapLayer> layer = boost::dynamic_pointer_cast<CostmapLayer>(*plugin);
+    if (!layer)
+      continue;
+
+    boost::unique_lock < boost::shared_mutex > lock(*(layer->getLock()));
+    if (readCheckpoint(checkpointPath(layer->getName()), layer->getName(), global_frame_, min_stamp, *layer))
+    {
+      ROS_INFO("Restored %s from its checkpoint", layer->getName().c_str());
+      // make the next update merge the whole layer into the master grid
+      double ox = layer->getOriginX(), oy = layer->getOriginY();
+      layer->addExtraBounds(ox, oy, ox + layer->getSizeInMetersX(), oy + layer->getSizeInMetersY());
+    }
+  }
+
+  // the master grid is usable right away, before the first update has inflated the restored layers
+  boost::unique_lock < boost::shared_mutex > lock(*(master->getLock()));
+  if (readCheckpoint(checkpointPath(name_), name_, global_frame_, min_stamp, *master))
+    ROS_INFO("Restored the %s costmap from its checkpoint", name_.c_str());
+}
+
+boost::shared_ptr<const Costmap2D> Costmap2DROS::getCostmapSnapshot()
+{
+  if (costmap_snapshots_)
+  {
+    boost::mutex::scoped_lock lock(snapshot_mutex_);
+    if (snapshot_)
+      return snapshot_;
+  }
+
+  // no snapshot is kept, or the first one has not been made yet
+  Costmap2D* master = layered_costmap_->getCostmap();
+  boost::shared_lock < boost::shared_mutex > lock(*(master->getLock()));
+  return boost::shared_ptr<const Costmap2D>(new Costmap2D(*master));
+}
+
+void Costmap2DROS::start()
+{
+  std::vector < boost::shared_ptr<Layer> > all_plugins = getAllPlugins(), *plugins = &all_plugins;
   // check if we're stopped or just paused
   if (stopped_)
   {
@@ -606,6 +1034,12 @@ void Costmap2DROS::start()
     stopped_ = false;
   }
   stop_updates_ = false;
+  if (idle_)
+  {
+    // the layers kept up while idle, so the first update brings the costmap up to date
+    initialized_ = false;
+    idle_ = false;
+  }
 
   // block until the costmap is re-initialized.. meaning one update cycle has run
   ros::Rate r(100.0);
@@ -616,7 +1050,7 @@ void Costmap2DROS::start()
 void Costmap2DROS::stop()
 {
   stop_updates_ = true;
-  std::vector < boost::shared_ptr<Layer> > *plugins = layered_costmap_->getPlugins();
+  std::vector < boost::shared_ptr<Layer> > all_plugins = getAllPlugins(), *plugins = &all_plugins;
   // unsubscribe from topics
   for (vector<boost::shared_ptr<Layer> >::iterator plugin = plugins->begin(); plugin != plugins->end();
       ++plugin)
@@ -627,6 +1061,15 @@ void Costmap2DROS::stop()
   stopped_ = true;
 }
 
+void Costmap2DROS::idle()
+{
+  // the layers stay subscribed, only a stopped costmap is restarted by start()
+  if (stopped_)
+    return;
+  idle_ = true;
+  stop_updates_ = false;
+}
+
 void Costmap2DROS::pause()
 {
   stop_updates_ = true;
@@ -648,7 +1091,12 @@ void Costmap2DROS::resetLayers()
 {
   Costmap2D* top = layered_costmap_->getCostmap();
   top->resetMap(0, 0, top->getSizeInCellsX(), top->getSizeInCellsY());
-  std::vector < boost::shared_ptr<Layer> > *plugins = layered_costmap_->getPlugins();
+  if (fine_costmap_ != NULL)
+  {
+    Costmap2D* fine = fine_costmap_->getCostmap();
+    fine->resetMap(0, 0, fine->getSizeInCellsX(), fine->getSizeInCellsY());
+  }
+  std::vector < boost::shared_ptr<Layer> > all_plugins = getAllPlugins(), *plugins = &all_plugins;
   for (vector<boost::shared_ptr<Layer> >::iterator plugin = plugins->begin(); plugin != plugins->end();
       ++plugin)
   {
@@ -658,13 +1106,26 @@ void Costmap2DROS::resetLayers()
 
 bool Costmap2DROS::getRobotPose(tf::Stamped<tf::Pose>& global_pose) const
 {
+  ros::Time current_time = ros::Time::now(); // save time for checking tf delay later
+
+  // a pose looked up less than robot_pose_cache_time ago is handed out again
+  if (pose_cache_time_ > 0.0)
+  {
+    boost::mutex::scoped_lock lock(pose_cache_mutex_);
+    if (pose_cached_ && current_time >= pose_cache_lookup_
+        && (current_time - pose_cache_lookup_).toSec() <= pose_cache_time_
+        && current_time.toSec() - cached_pose_.stamp_.toSec() <= transform_tolerance_)
+    {
+      global_pose = cached_pose_;
+      return true;
+    }
+  }
 
   global_pose.setIdentity();
   tf::Stamped < tf::Pose > robot_pose;
   robot_pose.setIdentity();
   robot_pose.frame_id_ = robot_base_frame_;
   robot_pose.stamp_ = ros::Time();
-  ros::Time current_time = ros::Time::now(); // save time for checking tf delay later
 
   //get the global pose of the robot
   try
@@ -695,6 +1156,13 @@ bool Costmap2DROS::getRobotPose(tf::Stamped<tf::Pose>& global_pose) const
     return false;
   }
 
+  if (pose_cache_time_ > 0.0)
+  {
+    boost::mutex::scoped_lock lock(pose_cache_mutex_);
+    cached_pose_ = global_pose;
+    pose_cache_lookup_ = current_time;
+    pose_cached_ = true;
+  }
   return true;
 }
 
@@ -719,4 +1187,31 @@ void Costmap2DROS::getOrientedFootprint(double x, double y, double theta, std::v
   }
 }
 
+int Costmap2DROS::getFootprintCosts(const std::vector<geometry_msgs::Pose2D>& poses, std::vector<double>& costs)
+{
+  costs.assign(poses.size(), -1.0);
+  std::vector<geometry_msgs::Point> footprint = getRobotFootprint();
+
+  boost::mutex::scoped_lock spans_lock(footprint_spans_mutex_);
+  Costmap2D* costmap = layered_costmap_->getCostmap();
+  boost::shared_lock<boost::shared_mutex> lock(*(costmap->getLock()));
+  footprint_spans_.update(footprint, 1.0, costmap->getResolution(), footprint_cost_headings_);
+
+  int first_collision = -1;
+  for (unsigned int i = 0; i < poses.size(); ++i)
+  {
+    costs[i] = footprint_spans_.getCost(*costmap, poses[i].x, poses[i].y, poses[i].theta);
+    if (costs[i] < 0 && first_collision < 0)
+      first_collision = i;
+  }
+  return first_collision;
+}
+
+bool Costmap2DROS::footprintCostsService(costmap_2d::GetFootprintCosts::Request& req,
+                                         costmap_2d::GetFootprintCosts::Response& resp)
+{
+  resp.first_collision = getFootprintCosts(req.poses, resp.costs);
+  return true;
+}
+
 } // namespace layered_costmap
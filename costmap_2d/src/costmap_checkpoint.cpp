@@ -0,0 +1,189 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/costmap_checkpoint.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace costmap_2d
+{
+
+static const char CHECKPOINT_MAGIC[8] = { 'C', 'M', 'A', 'P', 'C', 'K', 'P', 'T' };
+static const uint32_t CHECKPOINT_VERSION = 1;
+
+struct CheckpointHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t size_x, size_y;
+  uint32_t reserved;
+  double resolution;
+  double origin_x, origin_y;
+  double stamp;
+  char name[128];
+  char frame[64];
+};
+
+/**
+ * @brief  Copy a string into a fixed size field, false if it does not fit with its terminator
+ */
+static bool copyField(char* field, size_t size, const std::string& value)
+{
+  if (value.size() >= size)
+    return false;
+  memset(field, 0, size);
+  memcpy(field, value.c_str(), value.size());
+  return true;
+}
+
+static bool matchField(const char* field, size_t size, const std::string& value)
+{
+  return strnlen(field, size) == value.size() && value.compare(0, value.size(), field, value.size()) == 0;
+}
+
+bool writeCheckpoint(const std::string& path, const std::string& name, const std::string& frame, double stamp,
+                     const Costmap2D& map)
+{
+  CheckpointHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+  header.version = CHECKPOINT_VERSION;
+  header.size_x = map.getSizeInCellsX();
+  header.size_y = map.getSizeInCellsY();
+  header.resolution = map.getResolution();
+  header.origin_x = map.getOriginX();
+  header.origin_y = map.getOriginY();
+  header.stamp = stamp;
+  if (!copyField(header.name, sizeof(header.name), name) || !copyField(header.frame, sizeof(header.frame), frame))
+    return false;
+
+  size_t cells = (size_t)header.size_x * header.size_y;
+  size_t length = sizeof(header) + cells;
+
+  std::string tmp_path = path + ".tmp";
+  int fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return false;
+  if (ftruncate(fd, length) != 0)
+  {
+    close(fd);
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  void* data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+  {
+    unlink(tmp_path.c_str());
+    return false;
+  }
+
+  memcpy(data, &header, sizeof(header));
+  memcpy((char*)data + sizeof(header), map.getCharMap(), cells);
+  bool synced = msync(data, length, MS_SYNC) == 0;
+  munmap(data, length);
+
+  if (!synced || rename(tmp_path.c_str(), path.c_str()) != 0)
+  {
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool readCheckpoint(const std::string& path, const std::string& name, const std::string& frame, double min_stamp,
+                    Costmap2D& map)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CheckpointHeader))
+  {
+    close(fd);
+    return false;
+  }
+  size_t length = st.st_size;
+  void* data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+
+  CheckpointHeader header;
+  memcpy(&header, data, sizeof(header));
+  const unsigned char* costs = (const unsigned char*)data + sizeof(header);
+
+  bool valid = memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) == 0
+      && header.version == CHECKPOINT_VERSION
+      && length == sizeof(header) + (size_t)header.size_x * header.size_y
+      && matchField(header.name, sizeof(header.name), name)
+      && matchField(header.frame, sizeof(header.frame), frame)
+      && header.stamp >= min_stamp
+      && fabs(header.resolution - map.getResolution()) < 1e-6 * map.getResolution();
+
+  // the checkpoint must line up with the cells of the map
+  double resolution = map.getResolution();
+  double offset_x = (header.origin_x - map.getOriginX()) / resolution;
+  double offset_y = (header.origin_y - map.getOriginY()) / resolution;
+  int cell_ox = (int)floor(offset_x + 0.5);
+  int cell_oy = (int)floor(offset_y + 0.5);
+  valid = valid && fabs(offset_x - cell_ox) < 1e-3 && fabs(offset_y - cell_oy) < 1e-3;
+
+  if (valid)
+  {
+    // the overlap in the cells of the map
+    int x0 = std::max(0, cell_ox), y0 = std::max(0, cell_oy);
+    int xn = std::min((int)map.getSizeInCellsX(), cell_ox + (int)header.size_x);
+    int yn = std::min((int)map.getSizeInCellsY(), cell_oy + (int)header.size_y);
+    unsigned char* grid = map.getCharMap();
+    for (int y = y0; y < yn; ++y)
+    {
+      if (x0 >= xn)
+        break;
+      memcpy(grid + map.getIndex(x0, y), costs + (size_t)(y - cell_oy) * header.size_x + (x0 - cell_ox), xn - x0);
+    }
+  }
+
+  munmap(data, length);
+  return valid;
+}
+
+}  // namespace costmap_2d
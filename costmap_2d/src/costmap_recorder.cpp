@@ -0,0 +1,474 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/costmap_recorder.h>
+#include <costmap_2d/grid_compression.h>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace costmap_2d
+{
+
+static const char SEGMENT_MAGIC[8] = { 'C', 'M', 'A', 'P', 'L', 'O', 'G', '1' };
+static const char RECORD_MAGIC[4] = { 'C', 'M', 'R', 'F' };
+static const char SEGMENT_PREFIX[] = "costmap_log_";
+static const unsigned int MAX_QUEUED_FRAMES = 32;
+
+struct RecordHeader
+{
+  char magic[4];
+  uint8_t keyframe;
+  uint8_t name_length;
+  uint16_t reserved;
+  uint32_t size_x, size_y;
+  uint32_t x0, xn, y0, yn;
+  uint32_t encoded_length;
+  uint32_t reserved2;
+  double resolution, origin_x, origin_y;
+  double stamp;
+};
+
+/**
+ * @brief  The segment files in a directory, oldest first
+ */
+static std::vector<std::string> listSegments(const std::string& directory)
+{
+  std::vector<std::string> segments;
+  DIR* dir = opendir(directory.c_str());
+  if (dir == NULL)
+    return segments;
+  size_t prefix_length = strlen(SEGMENT_PREFIX);
+  while (struct dirent* entry = readdir(dir))
+  {
+    if (strncmp(entry->d_name, SEGMENT_PREFIX, prefix_length) == 0)
+      segments.push_back(entry->d_name);
+  }
+  closedir(dir);
+  // the indices are zero padded, so the names sort by age
+  std::sort(segments.begin(), segments.end());
+  return segments;
+}
+
+static bool sameGeometry(uint32_t size_x, uint32_t size_y, double resolution, double origin_x, double origin_y,
+                         const Costmap2D& grid)
+{
+  return size_x == grid.getSizeInCellsX() && size_y == grid.getSizeInCellsY() && resolution == grid.getResolution()
+      && origin_x == grid.getOriginX() && origin_y == grid.getOriginY();
+}
+
+CostmapRecorder::CostmapRecorder(const std::string& directory, size_t segment_bytes, unsigned int max_segments,
+                                 unsigned int keyframe_period) :
+    directory_(directory), segment_bytes_(segment_bytes), max_segments_(std::max(1u, max_segments)),
+    keyframe_period_(keyframe_period), writing_(false), shutdown_(false), bytes_written_(0), segment_(NULL),
+    segment_size_(0), segment_index_(0), written_(0)
+{
+  mkdir(directory_.c_str(), 0755);
+
+  // continue after the segments of an earlier run, they are removed as the ring goes round
+  std::vector<std::string> segments = listSegments(directory_);
+  if (!segments.empty())
+    segment_index_ = strtoul(segments.back().c_str() + strlen(SEGMENT_PREFIX), NULL, 10) + 1;
+
+  writer_ = boost::thread(boost::bind(&CostmapRecorder::writeLoop, this));
+}
+
+CostmapRecorder::~CostmapRecorder()
+{
+  {
+    boost::mutex::scoped_lock lock(queue_mutex_);
+    shutdown_ = true;
+  }
+  queue_condition_.notify_all();
+  writer_.join();
+  if (segment_)
+    fclose(segment_);
+}
+
+bool CostmapRecorder::record(const std::string& name, double stamp, const Costmap2D& grid, unsigned int x0,
+                             unsigned int xn, unsigned int y0, unsigned int yn)
+{
+  boost::shared_ptr<Frame> frame;
+  {
+    boost::mutex::scoped_lock lock(queue_mutex_);
+    RecordState& state = record_states_[name];
+
+    // the writer can only apply a rectangle to a grid it knows the rest of
+    if (!sameGeometry(state.size_x, state.size_y, state.resolution, state.origin_x, state.origin_y, grid))
+      state.whole = true;
+    state.size_x = grid.getSizeInCellsX();
+    state.size_y = grid.getSizeInCellsY();
+    state.resolution = grid.getResolution();
+    state.origin_x = grid.getOriginX();
+    state.origin_y = grid.getOriginY();
+
+    if (queue_.size() >= MAX_QUEUED_FRAMES)
+    {
+      state.whole = true;
+      return false;
+    }
+    if (state.whole)
+    {
+      x0 = y0 = 0;
+      xn = state.size_x;
+      yn = state.size_y;
+      state.whole = false;
+    }
+    xn = std::min(xn, state.size_x);
+    yn = std::min(yn, state.size_y);
+    if (x0 >= xn || y0 >= yn)
+      return true;
+
+    if (spare_frames_.empty())
+      frame.reset(new Frame);
+    else
+    {
+      frame = spare_frames_.back();
+      spare_frames_.pop_back();
+    }
+  }
+
+  // only the copy happens on the thread of the caller
+  frame->name = name;
+  frame->stamp = stamp;
+  frame->size_x = grid.getSizeInCellsX();
+  frame->size_y = grid.getSizeInCellsY();
+  frame->resolution = grid.getResolution();
+  frame->origin_x = grid.getOriginX();
+  frame->origin_y = grid.getOriginY();
+  frame->x0 = x0;
+  frame->xn = xn;
+  frame->y0 = y0;
+  frame->yn = yn;
+  unsigned int width = xn - x0;
+  frame->cells.resize(width * (yn - y0));
+  const unsigned char* costs = grid.getCharMap();
+  for (unsigned int y = y0; y < yn; ++y)
+    memcpy(&frame->cells[(y - y0) * width], costs + grid.getIndex(x0, y), width);
+
+  {
+    boost::mutex::scoped_lock lock(queue_mutex_);
+    queue_.push_back(frame);
+  }
+  queue_condition_.notify_all();
+  return true;
+}
+
+void CostmapRecorder::flush()
+{
+  boost::mutex::scoped_lock lock(queue_mutex_);
+  while (!queue_.empty() || writing_)
+    queue_condition_.wait(lock);
+}
+
+size_t CostmapRecorder::getBytesWritten()
+{
+  boost::mutex::scoped_lock lock(queue_mutex_);
+  return bytes_written_;
+}
+
+void CostmapRecorder::writeLoop()
+{
+  while (true)
+  {
+    boost::shared_ptr<Frame> frame;
+    {
+      boost::mutex::scoped_lock lock(queue_mutex_);
+      while (queue_.empty() && !shutdown_)
+        queue_condition_.wait(lock);
+      if (queue_.empty())
+        return;
+      frame = queue_.front();
+      queue_.pop_front();
+      writing_ = true;
+    }
+
+    writeFrame(*frame);
+    bool idle;
+    {
+      boost::mutex::scoped_lock lock(queue_mutex_);
+      idle = queue_.empty();
+    }
+    if (idle && segment_)
+      fflush(segment_);
+
+    {
+      boost::mutex::scoped_lock lock(queue_mutex_);
+      writing_ = false;
+      bytes_written_ = written_;
+      spare_frames_.push_back(frame);
+    }
+    queue_condition_.notify_all();
+  }
+}
+
+void CostmapRecorder::writeFrame(const Frame& frame)
+{
+  if (segment_ == NULL || segment_size_ >= segment_bytes_)
+    startSegment();
+
+  GridState& grid = grids_[frame.name];
+  const Frame& geometry = grid.geometry;
+  bool whole = frame.x0 == 0 && frame.y0 == 0 && frame.xn == frame.size_x && frame.yn == frame.size_y;
+  bool changed = grid.cells.empty() || geometry.size_x != frame.size_x || geometry.size_y != frame.size_y
+      || geometry.resolution != frame.resolution || geometry.origin_x != frame.origin_x
+      || geometry.origin_y != frame.origin_y;
+  if (changed && !whole)
+    return;
+
+  grid.geometry.name = frame.name;
+  grid.geometry.size_x = frame.size_x;
+  grid.geometry.size_y = frame.size_y;
+  grid.geometry.resolution = frame.resolution;
+  grid.geometry.origin_x = frame.origin_x;
+  grid.geometry.origin_y = frame.origin_y;
+  grid.geometry.stamp = frame.stamp;
+  grid.cells.resize(frame.size_x * frame.size_y);
+
+  if (changed || (keyframe_period_ > 0 && grid.deltas >= keyframe_period_))
+  {
+    for (unsigned int y = frame.y0; y < frame.yn; ++y)
+      memcpy(&grid.cells[y * frame.size_x + frame.x0], &frame.cells[(y - frame.y0) * (frame.xn - frame.x0)],
+             frame.xn - frame.x0);
+    grid.geometry.x0 = grid.geometry.y0 = 0;
+    grid.geometry.xn = frame.size_x;
+    grid.geometry.yn = frame.size_y;
+    writeRecord(grid.geometry, true, grid.cells);
+    grid.deltas = 0;
+    return;
+  }
+
+  // the xor against the last frame is zero wherever nothing changed, which the run length encoding collapses
+  unsigned int width = frame.xn - frame.x0;
+  delta_.resize(frame.cells.size());
+  for (unsigned int y = frame.y0; y < frame.yn; ++y)
+  {
+    unsigned char* cell = &grid.cells[y * frame.size_x + frame.x0];
+    const unsigned char* cost = &frame.cells[(y - frame.y0) * width];
+    unsigned char* delta = &delta_[(y - frame.y0) * width];
+    for (unsigned int x = 0; x < width; ++x)
+    {
+      delta[x] = cell[x] ^ cost[x];
+      cell[x] = cost[x];
+    }
+  }
+  Frame window = grid.geometry;
+  window.x0 = frame.x0;
+  window.xn = frame.xn;
+  window.y0 = frame.y0;
+  window.yn = frame.yn;
+  writeRecord(window, false, delta_);
+  ++grid.deltas;
+}
+
+void CostmapRecorder::writeRecord(const Frame& geometry, bool keyframe, const std::vector<unsigned char>& cells)
+{
+  if (segment_ == NULL)
+    return;
+
+  encodeRunLength((const int8_t*)&cells[0], cells.size(), encoded_);
+
+  RecordHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, RECORD_MAGIC, sizeof(header.magic));
+  header.keyframe = keyframe;
+  header.name_length = std::min<size_t>(geometry.name.size(), 255);
+  header.size_x = geometry.size_x;
+  header.size_y = geometry.size_y;
+  header.x0 = geometry.x0;
+  header.xn = geometry.xn;
+  header.y0 = geometry.y0;
+  header.yn = geometry.yn;
+  header.encoded_length = encoded_.size();
+  header.resolution = geometry.resolution;
+  header.origin_x = geometry.origin_x;
+  header.origin_y = geometry.origin_y;
+  header.stamp = geometry.stamp;
+
+  fwrite(&header, sizeof(header), 1, segment_);
+  fwrite(geometry.name.c_str(), 1, header.name_length, segment_);
+  if (!encoded_.empty())
+    fwrite(&encoded_[0], 1, encoded_.size(), segment_);
+  size_t bytes = sizeof(header) + header.name_length + encoded_.size();
+  segment_size_ += bytes;
+  written_ += bytes;
+}
+
+void CostmapRecorder::startSegment()
+{
+  if (segment_)
+    fclose(segment_);
+
+  char file[64];
+  snprintf(file, sizeof(file), "%s%08u", SEGMENT_PREFIX, segment_index_++);
+  segment_ = fopen((directory_ + "/" + file).c_str(), "wb");
+  segment_size_ = 0;
+  if (segment_ == NULL)
+    return;
+  fwrite(SEGMENT_MAGIC, 1, sizeof(SEGMENT_MAGIC), segment_);
+  segment_size_ += sizeof(SEGMENT_MAGIC);
+  written_ += sizeof(SEGMENT_MAGIC);
+
+  std::vector<std::string> segments = listSegments(directory_);
+  for (unsigned int i = 0; i + max_segments_ < segments.size(); ++i)
+    unlink((directory_ + "/" + segments[i]).c_str());
+
+  // every segment starts with keyframes, so the ring can lose the ones before it
+  for (std::map<std::string, GridState>::iterator it = grids_.begin(); it != grids_.end(); ++it)
+  {
+    if (it->second.cells.empty())
+      continue;
+    writeRecord(it->second.geometry, true, it->second.cells);
+    it->second.deltas = 0;
+  }
+}
+
+CostmapLogReader::CostmapLogReader() :
+    next_segment_(0), segment_(NULL), stamp_(0.0), keyframe_(false), changed_cells_(0), frame_bytes_(0)
+{
+}
+
+CostmapLogReader::~CostmapLogReader()
+{
+  if (segment_)
+    fclose(segment_);
+}
+
+bool CostmapLogReader::open(const std::string& directory)
+{
+  segments_ = listSegments(directory);
+  for (unsigned int i = 0; i < segments_.size(); ++i)
+    segments_[i] = directory + "/" + segments_[i];
+  next_segment_ = 0;
+  grids_.clear();
+  return nextSegment();
+}
+
+bool CostmapLogReader::nextSegment()
+{
+  if (segment_)
+    fclose(segment_);
+  segment_ = NULL;
+
+  while (next_segment_ < segments_.size())
+  {
+    segment_ = fopen(segments_[next_segment_++].c_str(), "rb");
+    char magic[sizeof(SEGMENT_MAGIC)];
+    if (segment_ && fread(magic, 1, sizeof(magic), segment_) == sizeof(magic)
+        && memcmp(magic, SEGMENT_MAGIC, sizeof(magic)) == 0)
+      return true;
+    if (segment_)
+      fclose(segment_);
+    segment_ = NULL;
+  }
+  return false;
+}
+
+bool CostmapLogReader::next()
+{
+  while (segment_ || nextSegment())
+  {
+    // a segment ends where a whole record does not follow, the last one may have been cut off by a crash
+    RecordHeader header;
+    char name[256];
+    if (fread(&header, sizeof(header), 1, segment_) != 1
+        || memcmp(header.magic, RECORD_MAGIC, sizeof(header.magic)) != 0
+        || fread(name, 1, header.name_length, segment_) != header.name_length
+        || header.xn > header.size_x || header.yn > header.size_y || header.x0 >= header.xn
+        || header.y0 >= header.yn)
+    {
+      nextSegment();
+      continue;
+    }
+    encoded_.resize(header.encoded_length);
+    unsigned int width = header.xn - header.x0, height = header.yn - header.y0;
+    cells_.resize(width * height);
+    if ((header.encoded_length > 0 && fread(&encoded_[0], 1, header.encoded_length, segment_) != header.encoded_length)
+        || !decodeRunLength(encoded_, (int8_t*)&cells_[0], cells_.size()))
+    {
+      nextSegment();
+      continue;
+    }
+
+    name_.assign(name, header.name_length);
+    stamp_ = header.stamp;
+    keyframe_ = header.keyframe;
+    frame_bytes_ = sizeof(header) + header.name_length + header.encoded_length;
+
+    std::map<std::string, Costmap2D>::iterator it = grids_.find(name_);
+    if (keyframe_)
+    {
+      if (it == grids_.end())
+        it = grids_.insert(std::make_pair(name_, Costmap2D())).first;
+      Costmap2D& grid = it->second;
+      if (!sameGeometry(header.size_x, header.size_y, header.resolution, header.origin_x, header.origin_y, grid))
+        grid.resizeMap(header.size_x, header.size_y, header.resolution, header.origin_x, header.origin_y);
+      memcpy(grid.getCharMap(), &cells_[0], cells_.size());
+      changed_cells_ = cells_.size();
+      return true;
+    }
+
+    // deltas only apply to the grid they were taken of
+    if (it == grids_.end()
+        || !sameGeometry(header.size_x, header.size_y, header.resolution, header.origin_x, header.origin_y, it->second))
+      continue;
+    unsigned char* costs = it->second.getCharMap();
+    changed_cells_ = 0;
+    for (unsigned int y = 0; y < height; ++y)
+    {
+      unsigned char* cell = costs + it->second.getIndex(header.x0, header.y0 + y);
+      const unsigned char* delta = &cells_[y * width];
+      for (unsigned int x = 0; x < width; ++x)
+      {
+        cell[x] ^= delta[x];
+        changed_cells_ += delta[x] != 0;
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+const Costmap2D* CostmapLogReader::getGrid(const std::string& name) const
+{
+  std::map<std::string, Costmap2D>::const_iterator it = grids_.find(name);
+  return it == grids_.end() ? NULL : &it->second;
+}
+
+}  // namespace costmap_2d
@@ -0,0 +1,182 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/depth_slope_kernel.h>
+#include <cmath>
+
+namespace costmap_2d
+{
+
+DepthSlopeKernel::DepthSlopeKernel() :
+    width_(0), height_(0), window_size_(30), slope_threshold_(1.0), obstacle_height_(0.2)
+{
+  std::fill(corners_, corners_ + 6, 0.0f);
+  std::fill(rotation_, rotation_ + 9, 0.0f);
+  rotation_[0] = rotation_[4] = rotation_[8] = 1.0f;
+  std::fill(translation_, translation_ + 3, 0.0f);
+}
+
+void DepthSlopeKernel::setPose(const double rotation[9], const double translation[3])
+{
+  std::copy(rotation, rotation + 9, rotation_);
+  std::copy(translation, translation + 3, translation_);
+}
+
+void DepthSlopeKernel::setParameters(int window_size, float slope_threshold, float obstacle_height)
+{
+  window_size_ = window_size;
+  slope_threshold_ = slope_threshold;
+  obstacle_height_ = obstacle_height;
+}
+
+bool DepthSlopeKernel::processColumn(const float* const* rows, int x, Scratch& scratch, float closest[3]) const
+{
+  int height = height_;
+  scratch.depth.resize(height);
+  scratch.x.resize(height);
+  scratch.y.resize(height);
+  scratch.z.resize(height);
+  scratch.sum_y.resize(height);
+  scratch.sum_z.resize(height);
+  scratch.sum_yz.resize(height);
+  scratch.sum_yy.resize(height);
+  scratch.labels.resize(height);
+
+  float* d = &scratch.depth[0];
+  float* px = &scratch.x[0];
+  float* py = &scratch.y[0];
+  float* pz = &scratch.z[0];
+  unsigned char* labels = &scratch.labels[0];
+
+  // gather the column, missing depth becomes zero
+  for (int y = 0; y < height; ++y)
+  {
+    float v = rows[y][x];
+    d[y] = v == v ? v : 0.0f;
+  }
+
+  toFloorFrame(d, &ray_x_[x * height], &ray_y_[x * height], &ray_z_[x * height], height, px, py, pz);
+
+  // running sums over the pixels with depth, the first row is not used
+  float* sy = &scratch.sum_y[0];
+  float* sz = &scratch.sum_z[0];
+  float* syz = &scratch.sum_yz[0];
+  float* syy = &scratch.sum_yy[0];
+  float run_y = 0.0f, run_z = 0.0f, run_yz = 0.0f, run_yy = 0.0f;
+  sy[0] = sz[0] = syz[0] = syy[0] = 0.0f;
+  for (int y = 1; y < height; ++y)
+  {
+    // the sums are kept in registers, reading them back from the arrays would stall on every row
+    float m = d[y] != 0.0f ? 1.0f : 0.0f;
+    run_y += m * py[y];
+    run_z += m * pz[y];
+    run_yz += m * py[y] * pz[y];
+    run_yy += m * py[y] * py[y];
+    sy[y] = run_y;
+    sz[y] = run_z;
+    syz[y] = run_yz;
+    syy[y] = run_yy;
+  }
+
+  labelObstacles(d, pz, sy, sz, syz, syy, height, labels);
+
+  int best = -1;
+  float best_y = 1e6f;
+  for (int y = 1; y < height; ++y)
+  {
+    if (labels[y] && py[y] < best_y)
+    {
+      best = y;
+      best_y = py[y];
+    }
+  }
+
+  if (best < 0)
+    return false;
+
+  closest[0] = px[best];
+  closest[1] = py[best];
+  closest[2] = pz[best];
+  return true;
+}
+
+void DepthSlopeKernel::toFloorFrame(const float* COSTMAP_RESTRICT d, const float* COSTMAP_RESTRICT rx,
+                                    const float* COSTMAP_RESTRICT ry, const float* COSTMAP_RESTRICT rz, int height,
+                                    float* COSTMAP_RESTRICT px, float* COSTMAP_RESTRICT py,
+                                    float* COSTMAP_RESTRICT pz) const
+{
+  // pixels without depth end up at the camera, the pose is kept in locals so it stays in registers
+  float r0 = rotation_[0], r1 = rotation_[1], r2 = rotation_[2];
+  float r3 = rotation_[3], r4 = rotation_[4], r5 = rotation_[5];
+  float r6 = rotation_[6], r7 = rotation_[7], r8 = rotation_[8];
+  float t0 = translation_[0], t1 = translation_[1], t2 = translation_[2];
+  for (int y = 0; y < height; ++y)
+  {
+    float cx = rx[y] * d[y], cy = ry[y] * d[y], cz = rz[y] * d[y];
+    px[y] = r0 * cx + r1 * cy + r2 * cz + t0;
+    py[y] = r3 * cx + r4 * cy + r5 * cz + t1;
+    pz[y] = r6 * cx + r7 * cy + r8 * cz + t2;
+  }
+}
+
+void DepthSlopeKernel::labelObstacles(const float* COSTMAP_RESTRICT d, const float* COSTMAP_RESTRICT pz,
+                                      const float* COSTMAP_RESTRICT sy, const float* COSTMAP_RESTRICT sz,
+                                      const float* COSTMAP_RESTRICT syz, const float* COSTMAP_RESTRICT syy,
+                                      int height, unsigned char* COSTMAP_RESTRICT labels) const
+{
+  float obstacle_height = obstacle_height_, slope_threshold = slope_threshold_;
+  labels[0] = 0;
+  for (int y = 1; y < height; ++y)
+    labels[y] = ((d[y] != 0.0f) & (pz[y] > obstacle_height)) * OBSTACLE_HEIGHT;
+
+  // the least-squares slope of z over y in the window centered on each floor pixel, compared without
+  // dividing: |num / den| > threshold is |num| > threshold * |den|; the conditions are combined with
+  // bitwise operators so the loops have no branches
+  float n = window_size_;
+  int half = window_size_ / 2;
+  for (int y = window_size_; y < height - window_size_; ++y)
+  {
+    float a = sy[y + half] - sy[y - half];
+    float b = sz[y + half] - sz[y - half];
+    float ab = syz[y + half] - syz[y - half];
+    float aa = syy[y + half] - syy[y - half];
+    float num = n * ab - a * b;
+    float den = n * aa - a * a;
+    int steep = std::fabs(num) > slope_threshold * std::fabs(den);
+    int floor = (d[y] != 0.0f) & (pz[y] < obstacle_height);
+    labels[y] |= (steep & floor) * OBSTACLE_SLOPE;
+  }
+}
+
+}  // namespace costmap_2d
@@ -0,0 +1,101 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/distance_transform.h>
+#include <limits>
+
+namespace costmap_2d
+{
+
+const float DistanceTransform::INF = std::numeric_limits<float>::infinity();
+
+void DistanceTransform::compute(float* grid, unsigned int size_x, unsigned int size_y)
+{
+  if (size_x == 0 || size_y == 0)
+    return;
+
+  for (unsigned int y = 0; y < size_y; ++y)
+    transform1D(grid + y * size_x, size_x, 1);
+
+  for (unsigned int x = 0; x < size_x; ++x)
+    transform1D(grid + x, size_y, size_x);
+}
+
+void DistanceTransform::transform1D(float* data, unsigned int n, unsigned int stride)
+{
+  f_.resize(n);
+  z_.resize(n + 1);
+  v_.resize(n);
+
+  for (unsigned int q = 0; q < n; ++q)
+    f_[q] = data[q * stride];
+
+  // build the lower envelope of the parabolas rooted at the finite cells
+  int k = -1;
+  for (unsigned int q = 0; q < n; ++q)
+  {
+    if (f_[q] == INF)
+      continue;
+
+    double s = 0.0;
+    while (k >= 0)
+    {
+      unsigned int p = v_[k];
+      s = ((f_[q] + (double)q * q) - (f_[p] + (double)p * p)) / (2.0 * q - 2.0 * p);
+      if (s > z_[k])
+        break;
+      --k;
+    }
+
+    ++k;
+    v_[k] = q;
+    z_[k] = k == 0 ? -std::numeric_limits<double>::infinity() : s;
+    z_[k + 1] = std::numeric_limits<double>::infinity();
+  }
+
+  // no sources, everything stays unreachable
+  if (k < 0)
+    return;
+
+  k = 0;
+  for (unsigned int q = 0; q < n; ++q)
+  {
+    while (z_[k + 1] < q)
+      ++k;
+    double d = (double)q - v_[k];
+    data[q * stride] = d * d + f_[v_[k]];
+  }
+}
+
+}  // namespace costmap_2d
@@ -0,0 +1,160 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/dynamic_brushfire.h>
+#include <algorithm>
+#include <limits>
+
+namespace costmap_2d
+{
+
+const unsigned int DynamicBrushfire::NONE = std::numeric_limits<unsigned int>::max();
+
+void DynamicBrushfire::reset(unsigned int size_x, unsigned int size_y, unsigned int max_squared_distance)
+{
+  size_x_ = size_x;
+  size_y_ = size_y;
+  max_distance_ = max_squared_distance;
+
+  obstacle_.assign(size_x * size_y, NONE);
+  distance_.assign(size_x * size_y, std::numeric_limits<unsigned int>::max());
+  occupied_.assign(size_x * size_y, 0);
+  raising_.assign(size_x * size_y, 0);
+
+  //every squared distance that is tracked needs a bucket
+  buckets_.resize(max_squared_distance + 1);
+  for (unsigned int i = 0; i < buckets_.size(); ++i)
+    buckets_[i].clear();
+  current_level_ = 0;
+}
+
+void DynamicBrushfire::setObstacle(unsigned int index)
+{
+  if (occupied_[index])
+    return;
+
+  occupied_[index] = 1;
+  obstacle_[index] = index;
+  distance_[index] = 0;
+  raising_[index] = 0;
+  enqueue(index, 0);
+}
+
+void DynamicBrushfire::removeObstacle(unsigned int index)
+{
+  if (!occupied_[index])
+    return;
+
+  occupied_[index] = 0;
+  obstacle_[index] = NONE;
+  distance_[index] = std::numeric_limits<unsigned int>::max();
+  raising_[index] = 1;
+  enqueue(index, 0);
+}
+
+void DynamicBrushfire::update()
+{
+  //process the buckets in order of increasing distance, cells may still be added to the current bucket
+  for (current_level_ = 0; current_level_ < buckets_.size(); ++current_level_)
+  {
+    std::vector<unsigned int>& bucket = buckets_[current_level_];
+    for (unsigned int k = 0; k < bucket.size(); ++k)
+    {
+      unsigned int index = bucket[k];
+      if (raising_[index])
+        raise(index);
+      else if (obstacle_[index] != NONE && occupied_[obstacle_[index]])
+        lower(index);
+    }
+    //keeps the capacity for the next update
+    bucket.clear();
+  }
+  current_level_ = 0;
+}
+
+inline void DynamicBrushfire::enqueue(unsigned int index, unsigned int level)
+{
+  buckets_[std::max(level, current_level_)].push_back(index);
+}
+
+void DynamicBrushfire::raise(unsigned int index)
+{
+  unsigned int x = index % size_x_, y = index / size_x_;
+  for (unsigned int ny = std::max(y, 1u) - 1; ny <= std::min(y + 1, size_y_ - 1); ++ny)
+  {
+    for (unsigned int nx = std::max(x, 1u) - 1; nx <= std::min(x + 1, size_x_ - 1); ++nx)
+    {
+      unsigned int n = ny * size_x_ + nx;
+      if (obstacle_[n] == NONE || raising_[n])
+        continue;
+
+      //the queue key is the old distance, so the raise wave stays ahead of the lower waves behind it
+      enqueue(n, distance_[n]);
+      if (!occupied_[obstacle_[n]])
+      {
+        obstacle_[n] = NONE;
+        distance_[n] = std::numeric_limits<unsigned int>::max();
+        raising_[n] = 1;
+      }
+    }
+  }
+  raising_[index] = 0;
+}
+
+void DynamicBrushfire::lower(unsigned int index)
+{
+  unsigned int obstacle = obstacle_[index];
+  int ox = obstacle % size_x_, oy = obstacle / size_x_;
+  unsigned int x = index % size_x_, y = index / size_x_;
+  for (unsigned int ny = std::max(y, 1u) - 1; ny <= std::min(y + 1, size_y_ - 1); ++ny)
+  {
+    for (unsigned int nx = std::max(x, 1u) - 1; nx <= std::min(x + 1, size_x_ - 1); ++nx)
+    {
+      unsigned int n = ny * size_x_ + nx;
+      if (raising_[n])
+        continue;
+
+      int dx = int(nx) - ox, dy = int(ny) - oy;
+      unsigned int distance = dx * dx + dy * dy;
+      if (distance < distance_[n] && distance <= max_distance_)
+      {
+        obstacle_[n] = obstacle;
+        distance_[n] = distance;
+        enqueue(n, distance);
+      }
+    }
+  }
+}
+
+}  // namespace costmap_2d
@@ -0,0 +1,290 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/executor.h>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/thread/tss.hpp>
+#include <ros/console.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace costmap_2d
+{
+
+namespace
+{
+
+struct WorkerIdentity
+{
+  const Executor* executor;
+  int queue;
+};
+
+//lets a task that runs more tasks queue them on its own worker, where they stay in cache
+boost::thread_specific_ptr<WorkerIdentity> current_worker;
+
+boost::mutex global_mutex;
+Executor* global_executor = NULL;
+
+}  // namespace
+
+Executor::Executor(unsigned int threads, bool pin) :
+    queued_(0), next_queue_(0), stop_(false)
+{
+  //a pool without workers still needs a queue, the waiting threads run the tasks then
+  for (unsigned int i = 0; i < std::max(threads, 1u); ++i)
+    queues_.push_back(new Queue());
+
+  unsigned int cpus = boost::thread::hardware_concurrency();
+  for (unsigned int i = 0; i < threads; ++i)
+  {
+    boost::thread* worker = new boost::thread(boost::bind(&Executor::workerLoop, this, i));
+#ifdef __linux__
+    if (pin && cpus > 0)
+    {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(i % cpus, &set);
+      if (pthread_setaffinity_np(worker->native_handle(), sizeof(set), &set) != 0)
+        ROS_WARN("Could not bind navigation worker %u to cpu %u", i, i % cpus);
+    }
+#else
+    if (pin && i == 0)
+      ROS_WARN("Binding navigation workers to cpus is not supported on this platform");
+#endif
+    workers_.push_back(worker);
+  }
+}
+
+Executor::~Executor()
+{
+  {
+    boost::mutex::scoped_lock lock(idle_mutex_);
+    stop_ = true;
+  }
+  idle_.notify_all();
+  for (unsigned int i = 0; i < workers_.size(); ++i)
+  {
+    workers_[i]->join();
+    delete workers_[i];
+  }
+  for (unsigned int i = 0; i < queues_.size(); ++i)
+    delete queues_[i];
+}
+
+Executor& Executor::global()
+{
+  boost::mutex::scoped_lock lock(global_mutex);
+  if (global_executor == NULL)
+  {
+    unsigned int cpus = boost::thread::hardware_concurrency();
+    //never destroyed, so no worker outlives the statics it might still use at exit
+    global_executor = new Executor(cpus > 1 ? cpus - 1 : 0);
+  }
+  return *global_executor;
+}
+
+bool Executor::configureGlobal(unsigned int threads, bool pin)
+{
+  boost::mutex::scoped_lock lock(global_mutex);
+  if (global_executor != NULL)
+    return false;
+  global_executor = new Executor(threads, pin);
+  return true;
+}
+
+void Executor::submit(const Task& task, TaskGroup* group)
+{
+  Job job;
+  job.task = task;
+  job.group = group;
+
+  int own = ownQueue();
+  unsigned int index;
+  if (own >= 0)
+    index = own;
+  else
+  {
+    boost::mutex::scoped_lock lock(idle_mutex_);
+    index = next_queue_++ % queues_.size();
+  }
+
+  {
+    Queue& queue = *queues_[index];
+    boost::mutex::scoped_lock lock(queue.mutex);
+    queue.jobs.push_back(job);
+  }
+  {
+    boost::mutex::scoped_lock lock(idle_mutex_);
+    ++queued_;
+  }
+  idle_.notify_one();
+}
+
+bool Executor::take(Queue& queue, TaskGroup* group, bool newest, Job* job)
+{
+  boost::mutex::scoped_lock lock(queue.mutex);
+  if (queue.jobs.empty())
+    return false;
+
+  if (group == NULL)
+  {
+    if (newest)
+    {
+      *job = queue.jobs.back();
+      queue.jobs.pop_back();
+    }
+    else
+    {
+      *job = queue.jobs.front();
+      queue.jobs.pop_front();
+    }
+    return true;
+  }
+
+  for (std::deque<Job>::iterator it = queue.jobs.begin(); it != queue.jobs.end(); ++it)
+  {
+    if (it->group == group)
+    {
+      *job = *it;
+      queue.jobs.erase(it);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Executor::runOne(TaskGroup* group, int own)
+{
+  unsigned int n = queues_.size();
+  unsigned int first = own >= 0 ? own : 0;
+  Job job;
+  bool found = false;
+  for (unsigned int k = 0; k < n && !found; ++k)
+  {
+    unsigned int index = (first + k) % n;
+    found = take(*queues_[index], group, (int)index == own, &job);
+  }
+  if (!found)
+    return false;
+
+  {
+    boost::mutex::scoped_lock lock(idle_mutex_);
+    --queued_;
+  }
+  job.task();
+  if (job.group != NULL)
+    job.group->finished();
+  return true;
+}
+
+void Executor::workerLoop(unsigned int index)
+{
+  WorkerIdentity* identity = new WorkerIdentity();
+  identity->executor = this;
+  identity->queue = index;
+  current_worker.reset(identity);
+
+  while (true)
+  {
+    if (runOne(NULL, index))
+      continue;
+
+    boost::mutex::scoped_lock lock(idle_mutex_);
+    while (queued_ == 0 && !stop_)
+      idle_.wait(lock);
+    if (stop_)
+      return;
+  }
+}
+
+int Executor::ownQueue() const
+{
+  WorkerIdentity* identity = current_worker.get();
+  if (identity == NULL || identity->executor != this)
+    return -1;
+  return identity->queue;
+}
+
+TaskGroup::TaskGroup(Executor& executor) :
+    executor_(executor), pending_(0)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+  wait();
+}
+
+void TaskGroup::run(const Executor::Task& task)
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    ++pending_;
+  }
+  executor_.submit(task, this);
+}
+
+void TaskGroup::wait()
+{
+  int own = executor_.ownQueue();
+  while (true)
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (pending_ == 0)
+        return;
+    }
+
+    if (executor_.runOne(this, own))
+      continue;
+
+    //the rest is running on workers, look again now and then in case one of them queues more
+    boost::mutex::scoped_lock lock(mutex_);
+    if (pending_ > 0)
+      done_.timed_wait(lock, boost::posix_time::milliseconds(1));
+  }
+}
+
+void TaskGroup::finished()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if (--pending_ == 0)
+    done_.notify_all();
+}
+
+}  // namespace costmap_2d
@@ -0,0 +1,167 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/footprint_collision_map.h>
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+namespace costmap_2d
+{
+
+FootprintCollisionMap::FootprintCollisionMap() :
+    reach_(0), min_dy_(0), max_dy_(0), min_dx_(0), max_dx_(0), size_x_(0), size_y_(0), words_per_row_(0),
+    stale_(true)
+{
+}
+
+void FootprintCollisionMap::setFootprint(const std::vector<geometry_msgs::Point>& footprint, double resolution,
+                                         unsigned int headings)
+{
+  spans_.update(footprint, 1.0, resolution, headings);
+
+  min_dy_ = min_dx_ = std::numeric_limits<int>::max();
+  max_dy_ = max_dx_ = std::numeric_limits<int>::min();
+  reach_ = 0;
+  for (unsigned int bin = 0; bin < spans_.getNumBins(); ++bin)
+  {
+    const std::vector<FootprintSpans::RowSpan>& spans = spans_.getBinSpans(bin);
+    for (unsigned int s = 0; s < spans.size(); ++s)
+    {
+      min_dy_ = std::min(min_dy_, spans[s].dy);
+      max_dy_ = std::max(max_dy_, spans[s].dy);
+      min_dx_ = std::min(min_dx_, spans[s].dx0);
+      max_dx_ = std::max(max_dx_, spans[s].dxn);
+      reach_ = std::max(reach_, std::max(abs(spans[s].dy), std::max(abs(spans[s].dx0), abs(spans[s].dxn - 1))));
+    }
+  }
+  if (min_dy_ > max_dy_)
+    min_dy_ = max_dy_ = min_dx_ = max_dx_ = 0;
+
+  bits_.assign(spans_.getNumBins() * size_y_ * words_per_row_, 0);
+  stale_ = true;
+}
+
+void FootprintCollisionMap::resize(unsigned int size_x, unsigned int size_y)
+{
+  size_x_ = size_x;
+  size_y_ = size_y;
+  words_per_row_ = (size_x + 63) / 64;
+  bits_.assign(spans_.getNumBins() * size_y_ * words_per_row_, 0);
+  stale_ = true;
+}
+
+void FootprintCollisionMap::update(const Costmap2D& grid, unsigned char obstacle, int min_i, int min_j, int max_i,
+                                   int max_j)
+{
+  if (grid.getSizeInCellsX() != size_x_ || grid.getSizeInCellsY() != size_y_)
+    resize(grid.getSizeInCellsX(), grid.getSizeInCellsY());
+  if (stale_)
+  {
+    min_i = min_j = 0;
+    max_i = size_x_;
+    max_j = size_y_;
+    stale_ = false;
+  }
+  min_i = std::max(0, min_i);
+  min_j = std::max(0, min_j);
+  max_i = std::min(int(size_x_), max_i);
+  max_j = std::min(int(size_y_), max_j);
+  if (min_i >= max_i || min_j >= max_j)
+    return;
+
+  unsigned int bins = spans_.getNumBins();
+  for (unsigned int bin = 0; bin < bins; ++bin)
+    for (int y = min_j; y < max_j; ++y)
+      setBits(bin, y, min_i, max_i, false);
+
+  // an obstacle at c is under the span dx0 <= dx < dxn of the robot cells c - dxn < x <= c - dx0, so only
+  // the obstacles within the extents of the spans around the area matter
+  int row0 = std::max(0, min_j + min_dy_), rown = std::min(int(size_y_), max_j + max_dy_);
+  int col0 = std::max(0, min_i + min_dx_), coln = std::min(int(size_x_), max_i + max_dx_ - 1);
+  const unsigned char* costs = grid.getCharMap();
+  for (int row = row0; row < rown; ++row)
+  {
+    const unsigned char* cell = costs + row * size_x_;
+    int x = col0;
+    while (x < coln)
+    {
+      if (cell[x] != obstacle)
+      {
+        ++x;
+        continue;
+      }
+      int run0 = x;
+      while (x < coln && cell[x] == obstacle)
+        ++x;
+
+      for (unsigned int bin = 0; bin < bins; ++bin)
+      {
+        const std::vector<FootprintSpans::RowSpan>& spans = spans_.getBinSpans(bin);
+        for (unsigned int s = 0; s < spans.size(); ++s)
+        {
+          int y = row - spans[s].dy;
+          if (y < min_j || y >= max_j)
+            continue;
+          setBits(bin, y, std::max(min_i, run0 - spans[s].dxn + 1), std::min(max_i, x - spans[s].dx0), true);
+        }
+      }
+    }
+  }
+}
+
+void FootprintCollisionMap::setBits(unsigned int bin, int y, int x0, int xn, bool value)
+{
+  if (x0 >= xn)
+    return;
+
+  uint64_t* row = &bits_[(bin * size_y_ + y) * words_per_row_];
+  unsigned int first = x0 >> 6, last = (xn - 1) >> 6;
+  uint64_t first_mask = ~uint64_t(0) << (x0 & 63);
+  uint64_t last_mask = ~uint64_t(0) >> (63 - ((xn - 1) & 63));
+  for (unsigned int w = first; w <= last; ++w)
+  {
+    uint64_t mask = ~uint64_t(0);
+    if (w == first)
+      mask &= first_mask;
+    if (w == last)
+      mask &= last_mask;
+    if (value)
+      row[w] |= mask;
+    else
+      row[w] &= ~mask;
+  }
+}
+
+}  // namespace costmap_2d
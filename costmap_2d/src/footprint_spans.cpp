@@ -0,0 +1,198 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/footprint_spans.h>
+#include <costmap_2d/cost_values.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+namespace costmap_2d
+{
+
+void FootprintSpans::update(const std::vector<geometry_msgs::Point>& footprint, double scale, double resolution,
+                            unsigned int headings)
+{
+  bool same = spans_.size() == headings && scale == scale_ && resolution == resolution_
+      && footprint.size() == footprint_.size();
+  for (unsigned int i = 0; same && i < footprint.size(); ++i)
+    same = footprint[i].x == footprint_[i].x && footprint[i].y == footprint_[i].y;
+  if (same)
+    return;
+
+  footprint_ = footprint;
+  scale_ = scale;
+  resolution_ = resolution;
+  spans_.resize(headings);
+  for (unsigned int h = 0; h < headings; ++h)
+    rasterize(2 * M_PI * h / headings, spans_[h]);
+}
+
+unsigned int FootprintSpans::getBin(double yaw) const
+{
+  double bin = 2 * M_PI / spans_.size();
+  double angle = fmod(yaw, 2 * M_PI);
+  if (angle < 0)
+    angle += 2 * M_PI;
+  return (unsigned int)floor(angle / bin + 0.5) % spans_.size();
+}
+
+void FootprintSpans::setCost(Costmap2D& grid, double x, double y, double yaw, unsigned char cost_value,
+                             double stamp) const
+{
+  if (spans_.empty())
+    return;
+
+  int mx, my;
+  grid.worldToMapNoBoundsFast(x, y, mx, my);
+  int size_x = grid.getSizeInCellsX(), size_y = grid.getSizeInCellsY();
+
+  const std::vector<RowSpan>& spans = getSpans(yaw);
+  for (unsigned int i = 0; i < spans.size(); ++i)
+  {
+    int row = my + spans[i].dy;
+    int x0 = std::max(0, mx + spans[i].dx0), xn = std::min(size_x, mx + spans[i].dxn);
+    if (row < 0 || row >= size_y || x0 >= xn)
+      continue;
+    grid.setRegionCost(x0, row, xn, row + 1, cost_value, stamp);
+  }
+}
+
+double FootprintSpans::getCost(const Costmap2D& grid, double x, double y, double yaw) const
+{
+  if (spans_.empty())
+    return -1.0;
+
+  int mx, my;
+  grid.worldToMapNoBoundsFast(x, y, mx, my);
+  int size_x = grid.getSizeInCellsX(), size_y = grid.getSizeInCellsY();
+  const unsigned char* costs = grid.getCharMap();
+
+  const std::vector<RowSpan>& spans = getSpans(yaw);
+  unsigned char footprint_cost = 0;
+  for (unsigned int i = 0; i < spans.size(); ++i)
+  {
+    int row = my + spans[i].dy;
+    int x0 = mx + spans[i].dx0, xn = mx + spans[i].dxn;
+    if (row < 0 || row >= size_y || x0 < 0 || xn > size_x)
+      return -1.0;
+    const unsigned char* cell = costs + row * size_x;
+    for (int cx = x0; cx < xn; ++cx)
+    {
+      if (cell[cx] == LETHAL_OBSTACLE || cell[cx] == NO_INFORMATION)
+        return -1.0;
+      footprint_cost = std::max(footprint_cost, cell[cx]);
+    }
+  }
+  return footprint_cost;
+}
+
+void FootprintSpans::rasterize(double yaw, std::vector<RowSpan>& spans)
+{
+  spans.clear();
+  if (footprint_.size() < 3)
+    return;
+
+  // the cells of the corners, with the robot at the center of cell 0, 0
+  double cos_th = cos(yaw), sin_th = sin(yaw);
+  std::vector<int> cx(footprint_.size()), cy(footprint_.size());
+  int min_y = std::numeric_limits<int>::max(), max_y = std::numeric_limits<int>::min();
+  for (unsigned int i = 0; i < footprint_.size(); ++i)
+  {
+    double px = scale_ * footprint_[i].x, py = scale_ * footprint_[i].y;
+    cx[i] = (int)floor(0.5 + (px * cos_th - py * sin_th) / resolution_);
+    cy[i] = (int)floor(0.5 + (px * sin_th + py * cos_th) / resolution_);
+    min_y = std::min(min_y, cy[i]);
+    max_y = std::max(max_y, cy[i]);
+  }
+
+  row_min_.assign(max_y - min_y + 1, std::numeric_limits<int>::max());
+  row_max_.assign(max_y - min_y + 1, std::numeric_limits<int>::min());
+  for (unsigned int i = 0; i < footprint_.size(); ++i)
+  {
+    unsigned int j = (i + 1) % footprint_.size();
+    addLine(cx[i], cy[i], cx[j], cy[j], min_y);
+  }
+
+  // the footprint is convex, so every row between the outline cells is one span
+  for (unsigned int r = 0; r < row_min_.size(); ++r)
+  {
+    if (row_min_[r] > row_max_[r])
+      continue;
+    RowSpan span;
+    span.dy = min_y + r;
+    span.dx0 = row_min_[r];
+    span.dxn = row_max_[r] + 1;
+    spans.push_back(span);
+  }
+}
+
+void FootprintSpans::addLine(int x0, int y0, int x1, int y1, int min_y)
+{
+  // Bresenham, one cell per step along the major axis
+  int dx = abs(x1 - x0), dy = abs(y1 - y0);
+  int sx = x1 > x0 ? 1 : -1, sy = y1 > y0 ? 1 : -1;
+  int x = x0, y = y0;
+  int error = 0;
+  bool x_major = dx >= dy;
+  int steps = x_major ? dx : dy;
+  for (int i = 0; i <= steps; ++i)
+  {
+    row_min_[y - min_y] = std::min(row_min_[y - min_y], x);
+    row_max_[y - min_y] = std::max(row_max_[y - min_y], x);
+    if (x_major)
+    {
+      x += sx;
+      error += dy;
+      if (2 * error >= dx)
+      {
+        y += sy;
+        error -= dx;
+      }
+    }
+    else
+    {
+      y += sy;
+      error += dx;
+      if (2 * error >= dy)
+      {
+        x += sx;
+        error -= dy;
+      }
+    }
+  }
+}
+
+}  // namespace costmap_2d
@@ -0,0 +1,324 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/grid_compression.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <voxel_grid/voxel_grid.h>
+
+namespace costmap_2d
+{
+
+static const unsigned int MAX_LITERALS = 128;
+static const unsigned int MIN_RUN = 3;
+static const unsigned int MAX_RUN = 130;
+
+void encodeRunLength(const int8_t* data, unsigned int length, std::vector<uint8_t>& encoded)
+{
+  encoded.clear();
+  unsigned int literals = 0;  // literal bytes waiting in front of i
+  unsigned int i = 0;
+  while (i < length)
+  {
+    unsigned int run = 1;
+    while (i + run < length && run < MAX_RUN && data[i + run] == data[i])
+      ++run;
+
+    if (run >= MIN_RUN || literals >= MAX_LITERALS || i + run == length)
+    {
+      if (run < MIN_RUN)
+      {
+        literals += run;
+        i += run;
+        run = 0;
+      }
+      // flush the literals, at most MAX_LITERALS of them are ever waiting
+      while (literals > 0)
+      {
+        unsigned int count = std::min(literals, MAX_LITERALS);
+        encoded.push_back(count - 1);
+        encoded.insert(encoded.end(), (const uint8_t*)data + i - literals, (const uint8_t*)data + i - literals + count);
+        literals -= count;
+      }
+      if (run > 0)
+      {
+        encoded.push_back(run + 125);
+        encoded.push_back((uint8_t)data[i]);
+        i += run;
+      }
+    }
+    else
+    {
+      literals += run;
+      i += run;
+    }
+  }
+}
+
+bool decodeRunLength(const std::vector<uint8_t>& encoded, int8_t* data, unsigned int length)
+{
+  unsigned int out = 0;
+  unsigned int i = 0;
+  while (i < encoded.size())
+  {
+    unsigned int control = encoded[i++];
+    if (control < MAX_LITERALS)
+    {
+      unsigned int count = control + 1;
+      if (i + count > encoded.size() || out + count > length)
+        return false;
+      memcpy(data + out, &encoded[i], count);
+      i += count;
+      out += count;
+    }
+    else
+    {
+      unsigned int count = control - 125;
+      if (i >= encoded.size() || out + count > length)
+        return false;
+      memset(data + out, encoded[i++], count);
+      out += count;
+    }
+  }
+  return out == length;
+}
+
+CompressedGridDecoder::CompressedGridDecoder() :
+    frame_(0), valid_(false)
+{
+}
+
+bool CompressedGridDecoder::update(const CompressedGridUpdate& update)
+{
+  bool same_map = grid_.info.width == update.info.width && grid_.info.height == update.info.height
+      && grid_.info.resolution == update.info.resolution;
+  if (!update.keyframe && (!valid_ || !same_map || update.frame != frame_ + 1))
+  {
+    valid_ = false;
+    return false;
+  }
+
+  if (update.x + update.width > update.info.width || update.y + update.height > update.info.height)
+  {
+    valid_ = false;
+    return false;
+  }
+
+  region_.resize(update.width * update.height);
+  if (!decodeRunLength(update.data, region_.empty() ? NULL : &region_[0], region_.size()))
+  {
+    valid_ = false;
+    return false;
+  }
+
+  if (!same_map)
+    grid_.data.assign(update.info.width * update.info.height, -1);
+  grid_.header = update.header;
+  grid_.info = update.info;
+
+  for (unsigned int y = 0; y < update.height; ++y)
+  {
+    int8_t* row = &grid_.data[(update.y + y) * update.info.width + update.x];
+    const int8_t* values = &region_[y * update.width];
+    for (unsigned int x = 0; x < update.width; ++x)
+    {
+      row[x] = update.keyframe ? values[x] : row[x] ^ values[x];
+    }
+  }
+
+  frame_ = update.frame;
+  valid_ = true;
+  return true;
+}
+
+void encodeColumnRuns(const uint32_t* words, unsigned int columns, unsigned int words_per_column,
+                      std::vector<uint32_t>& encoded)
+{
+  encoded.clear();
+  unsigned int i = 0;
+  while (i < columns)
+  {
+    const uint32_t* column = words + i * words_per_column;
+    unsigned int run = 1;
+    while (i + run < columns && std::equal(column, column + words_per_column, words + (i + run) * words_per_column))
+      ++run;
+
+    encoded.push_back(run);
+    encoded.insert(encoded.end(), column, column + words_per_column);
+    i += run;
+  }
+}
+
+bool decodeColumnRuns(const std::vector<uint32_t>& encoded, unsigned int words_per_column, uint32_t* words,
+                      unsigned int columns)
+{
+  unsigned int out = 0;
+  unsigned int i = 0;
+  while (i < encoded.size())
+  {
+    unsigned int run = encoded[i++];
+    if (run == 0 || i + words_per_column > encoded.size() || out + run > columns)
+      return false;
+    for (unsigned int r = 0; r < run; ++r, ++out)
+      std::copy(encoded.begin() + i, encoded.begin() + i + words_per_column, words + out * words_per_column);
+    i += words_per_column;
+  }
+  return out == columns;
+}
+
+void shiftVoxelColumns(std::vector<uint32_t>& words, unsigned int size_x, unsigned int size_y,
+                       unsigned int words_per_column, int cell_ox, int cell_oy)
+{
+  if (cell_ox == 0 && cell_oy == 0)
+    return;
+
+  // an unknown column, split into words as VoxelGrid::copyData() does
+  uint32_t unknown[2];
+  if (words_per_column == 1)
+  {
+    unknown[0] = voxel_grid::ColumnTraits<uint32_t>::unknownColumn();
+  }
+  else
+  {
+    uint64_t column = voxel_grid::ColumnTraits<uint64_t>::unknownColumn();
+    unknown[0] = (uint32_t)column;
+    unknown[1] = (uint32_t)(column >> 32);
+  }
+
+  // the columns of every row that keep data, none if the grid moves by its size or more
+  bool overlap = cell_ox > -int(size_x) && cell_ox < int(size_x) && cell_oy > -int(size_y) && cell_oy < int(size_y);
+  unsigned int x0 = overlap ? std::max(-cell_ox, 0) : 0;
+  unsigned int xn = overlap ? size_x - std::max(cell_ox, 0) : 0;
+
+  // walk the rows so that no source row is overwritten before it is moved
+  int step = cell_oy >= 0 ? 1 : -1;
+  int y = step > 0 ? 0 : size_y - 1;
+  for (unsigned int i = 0; i < size_y; ++i, y += step)
+  {
+    uint32_t* row = &words[y * size_x * words_per_column];
+    int source_y = y + cell_oy;
+    unsigned int keep_x0 = x0, keep_xn = xn;
+    if (!overlap || source_y < 0 || source_y >= int(size_y))
+      keep_x0 = keep_xn = size_x;
+    else
+      memmove(row + keep_x0 * words_per_column, &words[(source_y * size_x + keep_x0 + cell_ox) * words_per_column],
+              (keep_xn - keep_x0) * words_per_column * sizeof(uint32_t));
+
+    for (unsigned int x = 0; x < size_x; ++x)
+    {
+      if (x >= keep_x0 && x < keep_xn)
+        continue;
+      std::copy(unknown, unknown + words_per_column, row + x * words_per_column);
+    }
+  }
+}
+
+VoxelGridDecoder::VoxelGridDecoder() :
+    frame_(0), valid_(false)
+{
+}
+
+bool VoxelGridDecoder::update(const VoxelGridUpdate& update)
+{
+  bool same_size = grid_.size_x == update.size_x && grid_.size_y == update.size_y && grid_.size_z == update.size_z
+      && grid_.origin.z == update.origin.z && grid_.resolutions.x == update.resolutions.x
+      && grid_.resolutions.y == update.resolutions.y;
+  if (!update.keyframe && (!valid_ || !same_size || update.frame != frame_ + 1))
+  {
+    valid_ = false;
+    return false;
+  }
+
+  // a rolling grid moves by whole cells between frames, the columns move along before the delta applies
+  int cell_ox = 0, cell_oy = 0;
+  if (!update.keyframe && (update.origin.x != grid_.origin.x || update.origin.y != grid_.origin.y))
+  {
+    double dx = (update.origin.x - grid_.origin.x) / update.resolutions.x;
+    double dy = (update.origin.y - grid_.origin.y) / update.resolutions.y;
+    double cells_x = floor(dx + 0.5), cells_y = floor(dy + 0.5);
+    if (!(fabs(dx - cells_x) <= 0.1 && fabs(dy - cells_y) <= 0.1))
+    {
+      valid_ = false;
+      return false;
+    }
+    // moving by the size of the grid or more leaves no column in place
+    cell_ox = (int)std::max(-(double)update.size_x, std::min((double)update.size_x, cells_x));
+    cell_oy = (int)std::max(-(double)update.size_y, std::min((double)update.size_y, cells_y));
+  }
+
+  if (update.x + update.width > update.size_x || update.y + update.height > update.size_y)
+  {
+    valid_ = false;
+    return false;
+  }
+
+  // one word per column, or two if size_z is larger than 16, as in VoxelGrid
+  unsigned int words_per_column = update.size_z > 16 ? 2 : 1;
+  region_.resize(update.width * update.height * words_per_column);
+  if (!decodeColumnRuns(update.data, words_per_column, region_.empty() ? NULL : &region_[0],
+                        update.width * update.height))
+  {
+    valid_ = false;
+    return false;
+  }
+
+  if (!same_size || grid_.data.size() != update.size_x * update.size_y * words_per_column)
+    grid_.data.assign(update.size_x * update.size_y * words_per_column, 0);
+  else
+    shiftVoxelColumns(grid_.data, update.size_x, update.size_y, words_per_column, cell_ox, cell_oy);
+  grid_.header = update.header;
+  grid_.origin = update.origin;
+  grid_.resolutions = update.resolutions;
+  grid_.size_x = update.size_x;
+  grid_.size_y = update.size_y;
+  grid_.size_z = update.size_z;
+
+  unsigned int row_words = update.width * words_per_column;
+  for (unsigned int y = 0; y < update.height; ++y)
+  {
+    uint32_t* row = &grid_.data[((update.y + y) * update.size_x + update.x) * words_per_column];
+    const uint32_t* values = &region_[y * row_words];
+    for (unsigned int i = 0; i < row_words; ++i)
+    {
+      row[i] = update.keyframe ? values[i] : row[i] ^ values[i];
+    }
+  }
+
+  frame_ = update.frame;
+  valid_ = true;
+  return true;
+}
+
+}  // namespace costmap_2d
@@ -37,22 +37,34 @@
  *********************************************************************/
 #include <costmap_2d/layered_costmap.h>
 #include <costmap_2d/footprint.h>
+#include <costmap_2d/executor.h>
+#include <nav_trace/trace.h>
 #include <cstdio>
 #include <string>
 #include <algorithm>
 #include <vector>
+#include <limits>
+#include <cmath>
 
 using namespace std;
 
 namespace costmap_2d
 {
 LayeredCostmap::LayeredCostmap(string global_frame, bool rolling_window, bool track_unknown) :
-    costmap_(), global_frame_(global_frame), rolling_window_(rolling_window), initialized_(false), size_locked_(false)
+    costmap_(), global_frame_(global_frame), rolling_window_(rolling_window), initialized_(false), size_locked_(false),
+    circumscribed_radius_(0.0), inscribed_radius_(0.0), inscribed_cost_(0), circumscribed_cost_(0),
+    update_threads_(1), tile_cells_(0), timing_enabled_(false), next_layer_(0), update_requests_(0), new_obstacles_(0),
+    costs_suspended_(false), inner_(NULL), inner_pooled_(false)
 {
+  addChangedBoundsUser();
+
   if (track_unknown)
     costmap_.setDefaultValue(255);
   else
     costmap_.setDefaultValue(0);
+
+  // the layers keep their own time stamps, the master grid is only ever read for its costs
+  costmap_.setTimeStampPrecision(CellTimeStamps::NONE, 0.0);
 }
 
 LayeredCostmap::~LayeredCostmap()
@@ -73,10 +85,12 @@ void LayeredCostmap::resizeMap(unsigned int size_x, unsigned int size_y, double
   {
     (*plugin)->matchSize();
   }
+  addChangedBounds(0, size_x, 0, size_y);
 }
 
 void LayeredCostmap::updateMap(double robot_x, double robot_y, double robot_yaw)
 {
+  NAV_TRACE_SCOPE("LayeredCostmap::updateMap");
 
   // if we're using a rolling buffer costmap... we need to update the origin using the robot's position
   if (rolling_window_)
@@ -84,52 +98,505 @@ void LayeredCostmap::updateMap(double robot_x, double robot_y, double robot_yaw)
     double new_origin_x = robot_x - costmap_.getSizeInMetersX() / 2;
     double new_origin_y = robot_y - costmap_.getSizeInMetersY() / 2;
     costmap_.updateOrigin(new_origin_x, new_origin_y);
+    addChangedBounds(0, costmap_.getSizeInCellsX(), 0, costmap_.getSizeInCellsY());
   }
 
+  if (inner_ != NULL)
+    inner_->updateMap(robot_x, robot_y, robot_yaw);
+
   if (plugins_.size() == 0)
     return;
 
+  // the slots are there even if the update is not timed, the stages take them either way
+  ros::WallTime update_start = startStage();
+  timing_.bounds.resize(plugins_.size());
+  timing_.costs.resize(plugins_.size());
+  if (timing_enabled_)
+  {
+    std::fill(timing_.bounds.begin(), timing_.bounds.end(), 0.0);
+    std::fill(timing_.costs.begin(), timing_.costs.end(), 0.0);
+    timing_.lock_wait = timing_.total = 0.0;
+    timing_.cells = 0;
+  }
+
   minx_ = miny_ = 1e30;
   maxx_ = maxy_ = -1e30;
+  layer_bounds_.clear();
 
+  // consecutive independent layers are updated together, the others wait for all the layers before them
+  std::vector<Layer*> batch;
   for (vector<boost::shared_ptr<Layer> >::iterator plugin = plugins_.begin(); plugin != plugins_.end();
       ++plugin)
   {
-    (*plugin)->updateBounds(robot_x, robot_y, robot_yaw, &minx_, &miny_, &maxx_, &maxy_);
+    unsigned int index = plugin - plugins_.begin();
+    if ((*plugin)->isBoundsIndependent())
+    {
+      batch.push_back(plugin->get());
+      continue;
+    }
+    updateBoundsConcurrently(batch, index - batch.size(), robot_x, robot_y, robot_yaw);
+
+    // a dependent layer sees the bounds of the layers before it and may update anything inside them,
+    // so everything it returns is dirty
+    double minx = minx_, miny = miny_, maxx = maxx_, maxy = maxy_;
+    ros::WallTime start = startStage();
+    (*plugin)->updateBounds(robot_x, robot_y, robot_yaw, &minx, &miny, &maxx, &maxy);
+    endStage(timing_.bounds[index], start);
+    addBounds(minx, miny, maxx, maxy);
   }
+  updateBoundsConcurrently(batch, plugins_.size() - batch.size(), robot_x, robot_y, robot_yaw);
 
-  int x0, xn, y0, yn;
-  costmap_.worldToMapEnforceBounds(minx_, miny_, x0, y0);
-  costmap_.worldToMapEnforceBounds(maxx_, maxy_, xn, yn);
+  // the layers are up to date, their costs wait for the first update after the suspension
+  if (costs_suspended_)
+  {
+    suspended_bounds_.insert(suspended_bounds_.end(), layer_bounds_.begin(), layer_bounds_.end());
+    mergeSuspendedBounds();
+    recordTiming(update_start);
+    return;
+  }
+  for (unsigned int i = 0; i < suspended_bounds_.size(); i += 4)
+    addBounds(suspended_bounds_[i], suspended_bounds_[i + 1], suspended_bounds_[i + 2], suspended_bounds_[i + 3]);
+  suspended_bounds_.clear();
 
-  x0 = std::max(0, x0);
-  xn = std::min(int(costmap_.getSizeInCellsX()), xn + 1);
-  y0 = std::max(0, y0);
-  yn = std::min(int(costmap_.getSizeInCellsY()), yn + 1);
+  // the layers restore the cells pooled by the last update, and those under the window now, which are pooled again
+  if (inner_pooled_)
+    addBounds(inner_bounds_[0], inner_bounds_[1], inner_bounds_[2], inner_bounds_[3]);
+  bool pool = inner_ != NULL && inner_->isInitialized();
+  if (pool)
+  {
+    Costmap2D* inner = inner_->getCostmap();
+    inner_bounds_[0] = inner->getOriginX();
+    inner_bounds_[1] = inner->getOriginY();
+    inner_bounds_[2] = inner->getOriginX() + inner->getSizeInMetersX();
+    inner_bounds_[3] = inner->getOriginY() + inner->getSizeInMetersY();
+    addBounds(inner_bounds_[0], inner_bounds_[1], inner_bounds_[2], inner_bounds_[3]);
+  }
+  inner_pooled_ = pool;
 
-  ROS_DEBUG("Updating area x: [%d, %d] y: [%d, %d]", x0, xn, y0, yn);
+  // the dirty rectangles in cells, disjoint ones are updated separately
+  regions_.clear();
+  for (unsigned int i = 0; i < layer_bounds_.size(); i += 4)
+  {
+    if (layer_bounds_[i] > layer_bounds_[i + 2] || layer_bounds_[i + 1] > layer_bounds_[i + 3])
+      continue;
+
+    int x0, xn, y0, yn;
+    costmap_.worldToMapEnforceBounds(layer_bounds_[i], layer_bounds_[i + 1], x0, y0);
+    costmap_.worldToMapEnforceBounds(layer_bounds_[i + 2], layer_bounds_[i + 3], xn, yn);
+
+    x0 = std::max(0, x0);
+    xn = std::min(int(costmap_.getSizeInCellsX()), xn + 1);
+    y0 = std::max(0, y0);
+    yn = std::min(int(costmap_.getSizeInCellsY()), yn + 1);
+
+    if (xn <= x0 || yn <= y0)
+      continue;
+    regions_.push_back(MapRegion(x0, xn, y0, yn));
+  }
+  mergeRegions(regions_);
 
-  if (xn < x0 || yn < y0)
+  if (regions_.empty())
+  {
+    recordTiming(update_start);
     return;
+  }
+
+  bx0_ = by0_ = std::numeric_limits<unsigned int>::max();
+  bxn_ = byn_ = 0;
+  for (unsigned int i = 0; i < regions_.size(); ++i)
+  {
+    const MapRegion& region = regions_[i];
+    ROS_DEBUG("Updating area x: [%d, %d] y: [%d, %d]", region.x0, region.xn, region.y0, region.yn);
+
+    costmap_.resetMap(region.x0, region.y0, region.xn, region.yn);
+    if (timing_enabled_)
+      timing_.cells += (region.xn - region.x0) * (region.yn - region.y0);
+
+    {
+      ros::WallTime start = startStage();
+      boost::unique_lock < boost::shared_mutex > lock(*(costmap_.getLock()));
+      endStage(timing_.lock_wait, start);
+      if (tile_cells_ == 0)
+      {
+        for (unsigned int i = 0; i < plugins_.size(); ++i)
+        {
+          start = startStage();
+          plugins_[i]->updateCosts(costmap_, region.x0, region.y0, region.xn, region.yn);
+          endStage(timing_.costs[i], start);
+        }
+      }
+      else
+        updateCostsTiled(region);
+    }
+
+    bx0_ = std::min(bx0_, region.x0);
+    bxn_ = std::max(bxn_, region.xn);
+    by0_ = std::min(by0_, region.y0);
+    byn_ = std::max(byn_, region.yn);
+  }
+  if (pool)
+    poolInnerCostmap();
+  addChangedBounds(bx0_, bxn_, by0_, byn_);
 
-  costmap_.resetMap(x0, y0, xn, yn);
+  initialized_ = true;
+  recordTiming(update_start);
+}
 
+void LayeredCostmap::setCostsSuspended(bool suspended)
+{
+  costs_suspended_ = suspended;
+  if (inner_ != NULL)
+    inner_->setCostsSuspended(suspended);
+}
+
+void LayeredCostmap::mergeSuspendedBounds()
+{
+  // a long suspension must not pile up bounds, so they are kept as a single rectangle
+  if (suspended_bounds_.size() <= 4)
+    return;
+  double minx = 1e30, miny = 1e30, maxx = -1e30, maxy = -1e30;
+  for (unsigned int i = 0; i < suspended_bounds_.size(); i += 4)
   {
-    boost::unique_lock < boost::shared_mutex > lock(*(costmap_.getLock()));
-    for (vector<boost::shared_ptr<Layer> >::iterator plugin = plugins_.begin(); plugin != plugins_.end();
-        ++plugin)
+    if (suspended_bounds_[i] > suspended_bounds_[i + 2] || suspended_bounds_[i + 1] > suspended_bounds_[i + 3])
+      continue;
+    minx = std::min(minx, suspended_bounds_[i]);
+    miny = std::min(miny, suspended_bounds_[i + 1]);
+    maxx = std::max(maxx, suspended_bounds_[i + 2]);
+    maxy = std::max(maxy, suspended_bounds_[i + 3]);
+  }
+  suspended_bounds_.resize(4);
+  suspended_bounds_[0] = minx;
+  suspended_bounds_[1] = miny;
+  suspended_bounds_[2] = maxx;
+  suspended_bounds_[3] = maxy;
+}
+
+void LayeredCostmap::setInnerCostmap(LayeredCostmap* inner)
+{
+  inner_ = inner;
+}
+
+unsigned char LayeredCostmap::getCompositeCost(double wx, double wy)
+{
+  unsigned int mx, my;
+  if (inner_ != NULL)
+  {
+    Costmap2D* inner = inner_->getCostmap();
+    boost::shared_lock < boost::shared_mutex > lock(*(inner->getLock()));
+    if (inner->worldToMap(wx, wy, mx, my) && inner->getCost(mx, my) != NO_INFORMATION)
+      return inner->getCost(mx, my);
+  }
+
+  boost::shared_lock < boost::shared_mutex > lock(*(costmap_.getLock()));
+  if (costmap_.worldToMap(wx, wy, mx, my))
+    return costmap_.getCost(mx, my);
+  return NO_INFORMATION;
+}
+
+void LayeredCostmap::poolInnerCostmap()
+{
+  Costmap2D* inner = inner_->getCostmap();
+  boost::shared_lock < boost::shared_mutex > inner_lock(*(inner->getLock()));
+  boost::unique_lock < boost::shared_mutex > lock(*(costmap_.getLock()));
+
+  int x0, y0, xn, yn;
+  costmap_.worldToMapEnforceBounds(inner_bounds_[0], inner_bounds_[1], x0, y0);
+  costmap_.worldToMapEnforceBounds(inner_bounds_[2], inner_bounds_[3], xn, yn);
+  int width = xn - x0 + 1, height = yn - y0 + 1;
+  if (width <= 0 || height <= 0)
+    return;
+
+  // every inner cell falls in the cell of this costmap its center is in
+  unsigned int inner_x = inner->getSizeInCellsX(), inner_y = inner->getSizeInCellsY();
+  double scale = inner->getResolution() / costmap_.getResolution();
+  double offset_x = (inner->getOriginX() - costmap_.getOriginX()) / costmap_.getResolution() - x0;
+  double offset_y = (inner->getOriginY() - costmap_.getOriginY()) / costmap_.getResolution() - y0;
+  inner_columns_.resize(inner_x);
+  for (unsigned int i = 0; i < inner_x; ++i)
+  {
+    int column = (int)floor(offset_x + (i + 0.5) * scale);
+    inner_columns_[i] = column >= 0 && column < width ? column : -1;
+  }
+
+  inner_pool_.assign(width * height, -1);
+  const unsigned char* inner_costs = inner->getCharMap();
+  for (unsigned int j = 0; j < inner_y; ++j)
+  {
+    int row = (int)floor(offset_y + (j + 0.5) * scale);
+    if (row < 0 || row >= height)
+      continue;
+    int* pool = &inner_pool_[row * width];
+    const unsigned char* costs = inner_costs + j * inner_x;
+    for (unsigned int i = 0; i < inner_x; ++i)
     {
-      (*plugin)->updateCosts(costmap_, x0, y0, xn, yn);
+      if (inner_columns_[i] < 0 || costs[i] == NO_INFORMATION)
+        continue;
+      pool[inner_columns_[i]] = std::max(pool[inner_columns_[i]], (int)costs[i]);
     }
   }
 
-  bx0_ = x0;
-  bxn_ = xn;
-  by0_ = y0;
-  byn_ = yn;
+  unsigned char* master = costmap_.getCharMap();
+  unsigned int size_x = costmap_.getSizeInCellsX();
+  for (int row = 0; row < height; ++row)
+  {
+    for (int column = 0; column < width; ++column)
+    {
+      int cost = inner_pool_[row * width + column];
+      if (cost >= 0)
+        master[(y0 + row) * size_x + x0 + column] = cost;
+    }
+  }
+}
 
-  initialized_ = true;
+void LayeredCostmap::recordTiming(const ros::WallTime& update_start)
+{
+  if (!timing_enabled_)
+    return;
 
+  timing_.total = (ros::WallTime::now() - update_start).toSec();
+  boost::mutex::scoped_lock lock(timing_mutex_);
+  std::swap(timing_, last_timing_);
+}
+
+void LayeredCostmap::updateCostsTiled(const MapRegion& region)
+{
+  // as many rows as fit in a tile, at least one
+  unsigned int rows = std::max(1u, tile_cells_ / (region.xn - region.x0));
+
+  // the indices of a run of consecutive tileable layers
+  vector<unsigned int> run;
+  for (unsigned int plugin = 0; ; ++plugin)
+  {
+    if (plugin < plugins_.size() && plugins_[plugin]->isTileable())
+    {
+      run.push_back(plugin);
+      continue;
+    }
+
+    // a run of tileable layers goes over the window band by band, all of them on each band
+    ros::WallTime start;
+    if (run.size() == 1)
+    {
+      start = startStage();
+      plugins_[run[0]]->updateCosts(costmap_, region.x0, region.y0, region.xn, region.yn);
+      endStage(timing_.costs[run[0]], start);
+    }
+    else if (!run.empty())
+    {
+      for (unsigned int i = 0; i < run.size(); ++i)
+      {
+        start = startStage();
+        plugins_[run[i]]->prepareTiles(region.x0, region.y0, region.xn, region.yn);
+        endStage(timing_.costs[run[i]], start);
+      }
+      for (unsigned int y = region.y0; y < region.yn; y += rows)
+      {
+        unsigned int yn = std::min(region.yn, y + rows);
+        for (unsigned int i = 0; i < run.size(); ++i)
+        {
+          start = startStage();
+          plugins_[run[i]]->updateTile(costmap_, region.x0, y, region.xn, yn);
+          endStage(timing_.costs[run[i]], start);
+        }
+      }
+    }
+    run.clear();
+
+    if (plugin == plugins_.size())
+      break;
+    start = startStage();
+    plugins_[plugin]->updateCosts(costmap_, region.x0, region.y0, region.xn, region.yn);
+    endStage(timing_.costs[plugin], start);
+  }
+}
+
+void LayeredCostmap::completeDeferred(unsigned int x0, unsigned int xn, unsigned int y0, unsigned int yn)
+{
+  for (unsigned int i = 0; i < plugins_.size(); ++i)
+    completeDeferred(*plugins_[i], x0, xn, y0, yn);
+}
+
+void LayeredCostmap::completeDeferred(Layer& layer, unsigned int x0, unsigned int xn, unsigned int y0,
+                                      unsigned int yn)
+{
+  boost::upgrade_lock<boost::shared_mutex> lock(*(costmap_.getLock()));
+  xn = std::min(xn, costmap_.getSizeInCellsX());
+  yn = std::min(yn, costmap_.getSizeInCellsY());
+  if (x0 >= xn || y0 >= yn || !layer.hasDeferred(x0, y0, xn, yn))
+    return;
+
+  boost::upgrade_to_unique_lock<boost::shared_mutex> unique_lock(lock);
+  layer.completeDeferred(costmap_, x0, y0, xn, yn);
+  addChangedBounds(x0, xn, y0, yn);
+}
+
+unsigned int LayeredCostmap::addChangedBoundsUser()
+{
+  boost::mutex::scoped_lock lock(changed_mutex_);
+  unsigned int user = changed_.size() / 4;
+  changed_.push_back(std::numeric_limits<unsigned int>::max());
+  changed_.push_back(0);
+  changed_.push_back(std::numeric_limits<unsigned int>::max());
+  changed_.push_back(0);
+  return user;
+}
+
+bool LayeredCostmap::takeChangedBounds(unsigned int user, unsigned int* x0, unsigned int* xn, unsigned int* y0,
+                                       unsigned int* yn)
+{
+  boost::mutex::scoped_lock lock(changed_mutex_);
+  unsigned int* changed = &changed_[4 * user];
+  if (changed[1] <= changed[0] || changed[3] <= changed[2])
+    return false;
+
+  *x0 = changed[0];
+  *xn = changed[1];
+  *y0 = changed[2];
+  *yn = changed[3];
+  changed[0] = changed[2] = std::numeric_limits<unsigned int>::max();
+  changed[1] = changed[3] = 0;
+  return true;
+}
+
+void LayeredCostmap::addChangedBounds(unsigned int x0, unsigned int xn, unsigned int y0, unsigned int yn)
+{
+  boost::mutex::scoped_lock lock(changed_mutex_);
+  for (unsigned int i = 0; i < changed_.size(); i += 4)
+  {
+    changed_[i] = std::min(changed_[i], x0);
+    changed_[i + 1] = std::max(changed_[i + 1], xn);
+    changed_[i + 2] = std::min(changed_[i + 2], y0);
+    changed_[i + 3] = std::max(changed_[i + 3], yn);
+  }
+}
+
+void LayeredCostmap::requestUpdate()
+{
+  boost::mutex::scoped_lock lock(request_mutex_);
+  ++update_requests_;
+  request_condition_.notify_all();
+}
+
+bool LayeredCostmap::waitForUpdateRequest(unsigned int min_requests, double timeout)
+{
+  boost::mutex::scoped_lock lock(request_mutex_);
+  boost::system_time deadline = boost::get_system_time() + boost::posix_time::microseconds(int64_t(timeout * 1e6));
+  while (update_requests_ < min_requests)
+  {
+    if (!request_condition_.timed_wait(lock, deadline))
+      break;
+  }
+  bool requested = update_requests_ >= min_requests;
+  update_requests_ = 0;
+  return requested;
+}
+
+void LayeredCostmap::addNewObstacles(unsigned int cells)
+{
+  boost::mutex::scoped_lock lock(request_mutex_);
+  new_obstacles_ += cells;
+}
+
+unsigned int LayeredCostmap::takeNewObstacles()
+{
+  boost::mutex::scoped_lock lock(request_mutex_);
+  unsigned int cells = new_obstacles_;
+  new_obstacles_ = 0;
+  return cells;
+}
+
+void LayeredCostmap::addBounds(double minx, double miny, double maxx, double maxy)
+{
+  layer_bounds_.push_back(minx);
+  layer_bounds_.push_back(miny);
+  layer_bounds_.push_back(maxx);
+  layer_bounds_.push_back(maxy);
+
+  minx_ = std::min(minx_, minx);
+  miny_ = std::min(miny_, miny);
+  maxx_ = std::max(maxx_, maxx);
+  maxy_ = std::max(maxy_, maxy);
+}
+
+void LayeredCostmap::mergeRegions(std::vector<MapRegion>& regions)
+{
+  // merge until no pair is worth merging anymore, there are only a few rectangles per update
+  bool merged = true;
+  while (merged)
+  {
+    merged = false;
+    for (unsigned int i = 0; i < regions.size() && !merged; ++i)
+    {
+      for (unsigned int j = i + 1; j < regions.size(); ++j)
+      {
+        MapRegion& a = regions[i];
+        const MapRegion& b = regions[j];
+        MapRegion both(std::min(a.x0, b.x0), std::max(a.xn, b.xn), std::min(a.y0, b.y0), std::max(a.yn, b.yn));
+
+        // overlapping or touching rectangles are always merged, others only if their union wastes no area
+        bool touching = a.x0 <= b.xn && b.x0 <= a.xn && a.y0 <= b.yn && b.y0 <= a.yn;
+        if (touching || both.area() <= a.area() + b.area())
+        {
+          a = both;
+          regions.erase(regions.begin() + j);
+          merged = true;
+          break;
+        }
+      }
+    }
+  }
+}
+
+void LayeredCostmap::updateBoundsConcurrently(std::vector<Layer*>& batch, unsigned int first_plugin, double robot_x,
+                                              double robot_y, double robot_yaw)
+{
+  if (batch.empty())
+    return;
+
+  // every layer starts from empty bounds, stored as min_x, min_y, max_x, max_y
+  std::vector<double> bounds(4 * batch.size());
+  for (unsigned int i = 0; i < batch.size(); ++i)
+  {
+    bounds[4 * i] = bounds[4 * i + 1] = 1e30;
+    bounds[4 * i + 2] = bounds[4 * i + 3] = -1e30;
+  }
+
+  next_layer_ = 0;
+  TaskGroup workers;
+  for (unsigned int t = 1; t < std::min(update_threads_, (unsigned int)batch.size()); ++t)
+  {
+    workers.run(boost::bind(&LayeredCostmap::updateBoundsWorker, this, &batch, first_plugin, &bounds, robot_x,
+                            robot_y, robot_yaw));
+  }
+  updateBoundsWorker(&batch, first_plugin, &bounds, robot_x, robot_y, robot_yaw);
+  workers.wait();
+
+  for (unsigned int i = 0; i < batch.size(); ++i)
+  {
+    addBounds(bounds[4 * i], bounds[4 * i + 1], bounds[4 * i + 2], bounds[4 * i + 3]);
+  }
+  batch.clear();
+}
+
+void LayeredCostmap::updateBoundsWorker(std::vector<Layer*>* batch, unsigned int first_plugin,
+                                        std::vector<double>* bounds, double robot_x, double robot_y, double robot_yaw)
+{
+  while (true)
+  {
+    unsigned int i;
+    {
+      boost::mutex::scoped_lock lock(batch_mutex_);
+      i = next_layer_++;
+    }
+    if (i >= batch->size())
+      return;
+
+    double* b = &(*bounds)[4 * i];
+    ros::WallTime start = startStage();
+    (*batch)[i]->updateBounds(robot_x, robot_y, robot_yaw, &b[0], &b[1], &b[2], &b[3]);
+    // every worker has slots of its own
+    endStage(timing_.bounds[first_plugin + i], start);
+  }
 }
 
 bool LayeredCostmap::isCurrent()
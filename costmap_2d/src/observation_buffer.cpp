@@ -43,6 +43,9 @@
 
 #include <pcl_conversions/pcl_conversions.h>
 
+#include <cstring>
+#include <cmath>
+
 using namespace std;
 using namespace tf;
 
@@ -53,9 +56,10 @@ ObservationBuffer::ObservationBuffer(string topic_name, double observation_keep_
                                      double raytrace_range, TransformListener& tf, string global_frame,
                                      string sensor_frame, double tf_tolerance) :
     tf_(tf), observation_keep_time_(observation_keep_time), expected_update_rate_(expected_update_rate), last_updated_(
-        ros::Time::now()), global_frame_(global_frame), sensor_frame_(sensor_frame), topic_name_(topic_name), min_obstacle_height_(
-        min_obstacle_height), max_obstacle_height_(max_obstacle_height), obstacle_range_(obstacle_range), raytrace_range_(
-        raytrace_range), tf_tolerance_(tf_tolerance)
+        ros::Time::now()), global_frame_(global_frame), sensor_frame_(sensor_frame), first_observation_(0), observation_count_(
+        0), topic_name_(topic_name), min_obstacle_height_(min_obstacle_height), max_obstacle_height_(max_obstacle_height), obstacle_range_(
+        obstacle_range), raytrace_range_(raytrace_range), sector_angle_(0.0), tf_tolerance_(tf_tolerance), deferred_transforms_(
+        false), scan_angle_min_(0.0), scan_angle_increment_(0.0)
 {
 }
 
@@ -76,12 +80,11 @@ bool ObservationBuffer::setGlobalFrame(const std::string new_global_frame)
     return false;
   }
 
-  list<Observation>::iterator obs_it;
-  for (obs_it = observation_list_.begin(); obs_it != observation_list_.end(); ++obs_it)
+  for (unsigned int i = 0; i < observation_count_; ++i)
   {
     try
     {
-      Observation& obs = *obs_it;
+      Observation& obs = getObservation(i);
 
       geometry_msgs::PointStamped origin;
       origin.header.frame_id = global_frame_;
@@ -92,8 +95,15 @@ bool ObservationBuffer::setGlobalFrame(const std::string new_global_frame)
       tf_.transformPoint(new_global_frame, origin, origin);
       obs.origin_ = origin.point;
 
-      //we also need to transform the cloud of the observation to the new global frame
-      pcl_ros::transformPointCloud(new_global_frame, *obs.cloud_, *obs.cloud_, tf_);
+      //we also need to transform the cloud of the observation to the new global frame, copies of it keep the old one
+      if (obs.cloud_.unique())
+        pcl_ros::transformPointCloud(new_global_frame, *obs.cloud_, *obs.cloud_, tf_);
+      else
+      {
+        boost::shared_ptr<pcl::PointCloud<pcl::PointXYZ> > cloud(new pcl::PointCloud<pcl::PointXYZ>());
+        pcl_ros::transformPointCloud(new_global_frame, *obs.cloud_, *cloud, tf_);
+        obs.cloud_ = cloud;
+      }
 
     }
     catch (TransformException& ex)
@@ -111,20 +121,227 @@ bool ObservationBuffer::setGlobalFrame(const std::string new_global_frame)
 
 void ObservationBuffer::bufferCloud(const sensor_msgs::PointCloud2& cloud)
 {
+  //find the coordinates in the message, clouds that do not have them as floats take the slow path through pcl
+  int x_offset = -1, y_offset = -1, z_offset = -1;
+  for (unsigned int i = 0; i < cloud.fields.size(); ++i)
+  {
+    const sensor_msgs::PointField& field = cloud.fields[i];
+    if (field.datatype != sensor_msgs::PointField::FLOAT32 || field.offset + sizeof(float) > cloud.point_step)
+      continue;
+    if (field.name == "x")
+      x_offset = field.offset;
+    else if (field.name == "y")
+      y_offset = field.offset;
+    else if (field.name == "z")
+      z_offset = field.offset;
+  }
+
+  if (x_offset < 0 || y_offset < 0 || z_offset < 0 || cloud.is_bigendian
+      || cloud.data.size() < size_t(cloud.row_step) * cloud.height || cloud.point_step * cloud.width > cloud.row_step)
+  {
+    try
+    {
+      pcl::PCLPointCloud2 pcl_pc2;
+      pcl_conversions::toPCL(cloud, pcl_pc2);
+      // Actually convert the PointCloud2 message into a type we can reason about
+      pcl::PointCloud < pcl::PointXYZ > pcl_cloud;
+      pcl::fromPCLPointCloud2(pcl_pc2, pcl_cloud);
+      bufferCloud (pcl_cloud);
+    }
+    catch (pcl::PCLException& ex)
+    {
+      ROS_ERROR("Failed to convert a message to a pcl type, dropping observation: %s", ex.what());
+    }
+    return;
+  }
+
+  //create a new observation on the list to be populated
+  Observation& observation = pushObservation();
+
+  //check whether the origin frame has been set explicitly or whether we should get it from the cloud
+  string origin_frame = sensor_frame_ == "" ? cloud.header.frame_id : sensor_frame_;
+
   try
   {
-    pcl::PCLPointCloud2 pcl_pc2;
-    pcl_conversions::toPCL(cloud, pcl_pc2);
-    // Actually convert the PointCloud2 message into a type we can reason about
-    pcl::PointCloud < pcl::PointXYZ > pcl_cloud;
-    pcl::fromPCLPointCloud2(pcl_pc2, pcl_cloud);
-    bufferCloud (pcl_cloud);
+    tf::StampedTransform transform;
+    tf_.lookupTransform(global_frame_, cloud.header.frame_id, cloud.header.stamp, transform);
+    const tf::Matrix3x3& basis = transform.getBasis();
+    const tf::Vector3& offset = transform.getOrigin();
+
+    //given these observations come from sensors... we'll need to store the origin pt of the sensor, which is
+    //the origin of the transform unless the sensor has a frame of its own
+    if (origin_frame == cloud.header.frame_id)
+    {
+      observation.origin_.x = offset.x();
+      observation.origin_.y = offset.y();
+      observation.origin_.z = offset.z();
+    }
+    else
+    {
+      Stamped < tf::Vector3 > local_origin(tf::Vector3(0, 0, 0), cloud.header.stamp, origin_frame);
+      Stamped < tf::Vector3 > global_origin;
+      tf_.transformPoint(global_frame_, local_origin, global_origin);
+      observation.origin_.x = global_origin.getX();
+      observation.origin_.y = global_origin.getY();
+      observation.origin_.z = global_origin.getZ();
+    }
+
+    //make sure to pass on the raytrace/obstacle range of the observation buffer to the observations the costmap will see
+    observation.raytrace_range_ = raytrace_range_;
+    observation.obstacle_range_ = obstacle_range_;
+
+    //transform the points straight out of the message, keeping those that are within our height bounds
+    pcl::PointCloud < pcl::PointXYZ > &observation_cloud = *(observation.cloud_);
+    observation_cloud.points.resize(cloud.width * cloud.height);
+    unsigned int point_count = 0;
+
+    for (unsigned int row = 0; row < cloud.height; ++row)
+    {
+      const unsigned char* point = &cloud.data[row * cloud.row_step];
+      for (unsigned int col = 0; col < cloud.width; ++col, point += cloud.point_step)
+      {
+        float x, y, z;
+        memcpy(&x, point + x_offset, sizeof(float));
+        memcpy(&y, point + y_offset, sizeof(float));
+        memcpy(&z, point + z_offset, sizeof(float));
+
+        //the height decides whether the point is kept, invalid points fail the comparison
+        double global_z = basis[2].x() * x + basis[2].y() * y + basis[2].z() * z + offset.z();
+        if (global_z <= max_obstacle_height_ && global_z >= min_obstacle_height_)
+        {
+          pcl::PointXYZ& p = observation_cloud.points[point_count++];
+          p.x = basis[0].x() * x + basis[0].y() * y + basis[0].z() * z + offset.x();
+          p.y = basis[1].x() * x + basis[1].y() * y + basis[1].z() * z + offset.y();
+          p.z = global_z;
+        }
+      }
+    }
+
+    //resize the cloud for the number of legal points
+    observation_cloud.points.resize(point_count);
+    pcl_conversions::toPCL(cloud.header, observation_cloud.header);
+    observation_cloud.header.frame_id = global_frame_;
   }
-  catch (pcl::PCLException& ex)
+  catch (TransformException& ex)
   {
-    ROS_ERROR("Failed to convert a message to a pcl type, dropping observation: %s", ex.what());
+    //if an exception occurs, we need to remove the empty observation from the list
+    popObservation();
+    ROS_ERROR("TF Exception that should never happen for sensor frame: %s, cloud frame: %s, %s", sensor_frame_.c_str(),
+              cloud.header.frame_id.c_str(), ex.what());
     return;
   }
+
+  //if the update was successful, we want to update the last updated time
+  last_updated_ = ros::Time::now();
+
+  //we'll also remove any stale observations from the list
+  purgeStaleObservations();
+}
+
+void ObservationBuffer::bufferScan(const sensor_msgs::LaserScan& scan, bool inf_is_valid)
+{
+  //the beam directions only change when the scanner configuration does
+  unsigned int beam_count = scan.ranges.size();
+  if (scan_cos_.size() != beam_count || scan_angle_min_ != scan.angle_min
+      || scan_angle_increment_ != scan.angle_increment)
+  {
+    scan_cos_.resize(beam_count);
+    scan_sin_.resize(beam_count);
+    for (unsigned int i = 0; i < beam_count; ++i)
+    {
+      double angle = scan.angle_min + i * scan.angle_increment;
+      scan_cos_[i] = cos(angle);
+      scan_sin_[i] = sin(angle);
+    }
+    scan_angle_min_ = scan.angle_min;
+    scan_angle_increment_ = scan.angle_increment;
+  }
+
+  //create a new observation on the list to be populated
+  Observation& observation = pushObservation();
+
+  //check whether the origin frame has been set explicitly or whether we should get it from the scan
+  string origin_frame = sensor_frame_ == "" ? scan.header.frame_id : sensor_frame_;
+
+  try
+  {
+    tf::StampedTransform transform;
+    tf_.lookupTransform(global_frame_, scan.header.frame_id, scan.header.stamp, transform);
+    const tf::Matrix3x3& basis = transform.getBasis();
+    const tf::Vector3& offset = transform.getOrigin();
+
+    //given these observations come from sensors... we'll need to store the origin pt of the sensor, which is
+    //the origin of the transform unless the sensor has a frame of its own
+    if (origin_frame == scan.header.frame_id)
+    {
+      observation.origin_.x = offset.x();
+      observation.origin_.y = offset.y();
+      observation.origin_.z = offset.z();
+    }
+    else
+    {
+      Stamped < tf::Vector3 > local_origin(tf::Vector3(0, 0, 0), scan.header.stamp, origin_frame);
+      Stamped < tf::Vector3 > global_origin;
+      tf_.transformPoint(global_frame_, local_origin, global_origin);
+      observation.origin_.x = global_origin.getX();
+      observation.origin_.y = global_origin.getY();
+      observation.origin_.z = global_origin.getZ();
+    }
+
+    //make sure to pass on the raytrace/obstacle range of the observation buffer to the observations the costmap will see
+    observation.raytrace_range_ = raytrace_range_;
+    observation.obstacle_range_ = obstacle_range_;
+
+    //a positive infinity reads as nothing seen up to just short of the maximum range
+    const float inf_range = scan.range_max - 0.0001;
+
+    pcl::PointCloud < pcl::PointXYZ > &observation_cloud = *(observation.cloud_);
+    observation_cloud.points.resize(beam_count);
+    unsigned int point_count = 0;
+
+    for (unsigned int i = 0; i < beam_count; ++i)
+    {
+      float range = scan.ranges[i];
+      if (inf_is_valid && !std::isfinite(range) && range > 0)
+        range = inf_range;
+
+      //the same beams laser_geometry keeps, invalid ranges fail the comparison
+      if (!(range < scan.range_max && range >= scan.range_min))
+        continue;
+
+      //the beam lies in the xy plane of the scanner
+      double x = range * scan_cos_[i];
+      double y = range * scan_sin_[i];
+
+      double global_z = basis[2].x() * x + basis[2].y() * y + offset.z();
+      if (global_z <= max_obstacle_height_ && global_z >= min_obstacle_height_)
+      {
+        pcl::PointXYZ& p = observation_cloud.points[point_count++];
+        p.x = basis[0].x() * x + basis[0].y() * y + offset.x();
+        p.y = basis[1].x() * x + basis[1].y() * y + offset.y();
+        p.z = global_z;
+      }
+    }
+
+    //resize the cloud for the number of legal points
+    observation_cloud.points.resize(point_count);
+    pcl_conversions::toPCL(scan.header, observation_cloud.header);
+    observation_cloud.header.frame_id = global_frame_;
+  }
+  catch (TransformException& ex)
+  {
+    //if an exception occurs, we need to remove the empty observation from the list
+    popObservation();
+    ROS_ERROR("TF Exception that should never happen for sensor frame: %s, scan frame: %s, %s", sensor_frame_.c_str(),
+              scan.header.frame_id.c_str(), ex.what());
+    return;
+  }
+
+  //if the update was successful, we want to update the last updated time
+  last_updated_ = ros::Time::now();
+
+  //we'll also remove any stale observations from the list
+  purgeStaleObservations();
 }
 
 void ObservationBuffer::bufferCloud(const pcl::PointCloud<pcl::PointXYZ>& cloud)
@@ -132,7 +349,7 @@ void ObservationBuffer::bufferCloud(const pcl::PointCloud<pcl::PointXYZ>& cloud)
   Stamped < tf::Vector3 > global_origin;
 
   //create a new observation on the list to be populated
-  observation_list_.push_front(Observation());
+  Observation& observation = pushObservation();
 
   //check whether the origin frame has been set explicitly or whether we should get it from the cloud
   string origin_frame = sensor_frame_ == "" ? cloud.header.frame_id : sensor_frame_;
@@ -142,13 +359,13 @@ void ObservationBuffer::bufferCloud(const pcl::PointCloud<pcl::PointXYZ>& cloud)
     //given these observations come from sensors... we'll need to store the origin pt of the sensor
     Stamped < tf::Vector3 > local_origin(tf::Vector3(0, 0, 0), pcl_conversions::fromPCL(cloud.header).stamp, origin_frame);
     tf_.transformPoint(global_frame_, local_origin, global_origin);
-    observation_list_.front().origin_.x = global_origin.getX();
-    observation_list_.front().origin_.y = global_origin.getY();
-    observation_list_.front().origin_.z = global_origin.getZ();
+    observation.origin_.x = global_origin.getX();
+    observation.origin_.y = global_origin.getY();
+    observation.origin_.z = global_origin.getZ();
 
     //make sure to pass on the raytrace/obstacle range of the observation buffer to the observations the costmap will see
-    observation_list_.front().raytrace_range_ = raytrace_range_;
-    observation_list_.front().obstacle_range_ = obstacle_range_;
+    observation.raytrace_range_ = raytrace_range_;
+    observation.obstacle_range_ = obstacle_range_;
 
     pcl::PointCloud < pcl::PointXYZ > global_frame_cloud;
 
@@ -157,7 +374,7 @@ void ObservationBuffer::bufferCloud(const pcl::PointCloud<pcl::PointXYZ>& cloud)
     global_frame_cloud.header.stamp = cloud.header.stamp;
 
     //now we need to remove observations from the cloud that are below or above our height thresholds
-    pcl::PointCloud < pcl::PointXYZ > &observation_cloud = *(observation_list_.front().cloud_);
+    pcl::PointCloud < pcl::PointXYZ > &observation_cloud = *(observation.cloud_);
     unsigned int cloud_size = global_frame_cloud.points.size();
     observation_cloud.points.resize(cloud_size);
     unsigned int point_count = 0;
@@ -180,7 +397,7 @@ void ObservationBuffer::bufferCloud(const pcl::PointCloud<pcl::PointXYZ>& cloud)
   catch (TransformException& ex)
   {
     //if an exception occurs, we need to remove the empty observation from the list
-    observation_list_.pop_front();
+    popObservation();
     ROS_ERROR("TF Exception that should never happen for sensor frame: %s, cloud frame: %s, %s", sensor_frame_.c_str(),
               cloud.header.frame_id.c_str(), ex.what());
     return;
@@ -194,44 +411,151 @@ void ObservationBuffer::bufferCloud(const pcl::PointCloud<pcl::PointXYZ>& cloud)
 
 }
 
+void ObservationBuffer::bufferCloud(const sensor_msgs::PointCloud2ConstPtr& cloud)
+{
+  if (!deferred_transforms_)
+  {
+    bufferCloud(*cloud);
+    return;
+  }
+
+  PendingMessage pending;
+  pending.cloud = cloud;
+  pending.inf_is_valid = false;
+  pending_.push_back(pending);
+  deferMessage();
+}
+
+void ObservationBuffer::bufferScan(const sensor_msgs::LaserScanConstPtr& scan, bool inf_is_valid)
+{
+  if (!deferred_transforms_)
+  {
+    bufferScan(*scan, inf_is_valid);
+    return;
+  }
+
+  PendingMessage pending;
+  pending.scan = scan;
+  pending.inf_is_valid = inf_is_valid;
+  pending_.push_back(pending);
+  deferMessage();
+}
+
+void ObservationBuffer::deferMessage()
+{
+  //the same bound as the queue of the tf filter the message skipped
+  if (pending_.size() > 50)
+  {
+    ROS_WARN_THROTTLE(1.0, "Too many %s observations wait for their transform, dropping the oldest", topic_name_.c_str());
+    pending_.pop_front();
+  }
+
+  //last_updated_ is left to bufferCloud() and bufferScan(), so a sensor whose
+  //transforms never arrive is not current
+}
+
+void ObservationBuffer::transformPending()
+{
+  ros::Duration max_wait(std::max(tf_tolerance_, observation_keep_time_.toSec()));
+  ros::Time now = ros::Time::now();
+  while (!pending_.empty())
+  {
+    const PendingMessage& pending = pending_.front();
+    const std_msgs::Header& header = pending.cloud ? pending.cloud->header : pending.scan->header;
+    string origin_frame = sensor_frame_ == "" ? header.frame_id : sensor_frame_;
+
+    if (!tf_.canTransform(global_frame_, header.frame_id, header.stamp)
+        || !tf_.canTransform(global_frame_, origin_frame, header.stamp))
+    {
+      //the messages after this one need later transforms, so they wait as well
+      if (now - header.stamp <= max_wait)
+        return;
+      ROS_WARN_THROTTLE(1.0, "No transform from %s to %s for a %s observation after %.2f seconds, dropping it",
+                        header.frame_id.c_str(), global_frame_.c_str(), topic_name_.c_str(), max_wait.toSec());
+    }
+    else if (pending.cloud)
+      bufferCloud(*pending.cloud);
+    else
+      bufferScan(*pending.scan, pending.inf_is_valid);
+    pending_.pop_front();
+  }
+}
+
 //returns a copy of the observations
 void ObservationBuffer::getObservations(vector<Observation>& observations)
 {
+  //the deferred messages are transformed now that they are needed
+  transformPending();
+
   //first... let's make sure that we don't have any stale observations
   purgeStaleObservations();
 
-  //now we'll just copy the observations for the caller
-  list<Observation>::iterator obs_it;
-  for (obs_it = observation_list_.begin(); obs_it != observation_list_.end(); ++obs_it)
+  //now we'll just copy the observations for the caller, they share the clouds
+  observations.reserve(observations.size() + observation_count_);
+  for (unsigned int i = 0; i < observation_count_; ++i)
   {
-    observations.push_back(*obs_it);
+    observations.push_back(getObservation(i));
   }
 
 }
 
+Observation& ObservationBuffer::pushObservation()
+{
+  //all slots are taken, grow the ring, this only happens until the buffer settled
+  if (observation_count_ == observations_.size())
+  {
+    vector<Observation> observations(std::max<size_t>(4, 2 * observations_.size()));
+    for (unsigned int i = 0; i < observation_count_; ++i)
+    {
+      observations[i] = getObservation(i);
+    }
+    observations_.swap(observations);
+    first_observation_ = 0;
+  }
+
+  first_observation_ = (first_observation_ + observations_.size() - 1) % observations_.size();
+  ++observation_count_;
+
+  Observation& observation = observations_[first_observation_];
+  if (observation.cloud_ && observation.cloud_.unique())
+  {
+    //nobody holds the cloud anymore, reuse its storage
+    observation.cloud_->points.clear();
+    observation.cloud_->header = pcl::PCLHeader();
+  }
+  else
+    observation.cloud_.reset(new pcl::PointCloud<pcl::PointXYZ>());
+  observation.origin_ = geometry_msgs::Point();
+  observation.obstacle_range_ = observation.raytrace_range_ = 0.0;
+  observation.sector_angle_ = sector_angle_;
+  return observation;
+}
+
+void ObservationBuffer::popObservation()
+{
+  first_observation_ = (first_observation_ + 1) % observations_.size();
+  --observation_count_;
+}
+
 void ObservationBuffer::purgeStaleObservations()
 {
-  if (!observation_list_.empty())
+  if (observation_count_ > 0)
   {
-    list<Observation>::iterator obs_it = observation_list_.begin();
     //if we're keeping observations for no time... then we'll only keep one observation
     if (observation_keep_time_ == ros::Duration(0.0))
     {
-      observation_list_.erase(++obs_it, observation_list_.end());
+      observation_count_ = 1;
       return;
     }
 
-    //otherwise... we'll have to loop through the observations to see which ones are stale
-    for (obs_it = observation_list_.begin(); obs_it != observation_list_.end(); ++obs_it)
+    //otherwise... the observations are in the order they arrived, so the stale ones are dropped from the
+    //oldest end until the first one that is still fresh, without looking at the others
+    while (observation_count_ > 0)
     {
-      Observation& obs = *obs_it;
-      //check if the observation is out of date... and if it is, remove it and those that follow from the list
-      ros::Duration time_diff = last_updated_ - pcl_conversions::fromPCL(obs.cloud_->header).stamp;
-      if ((last_updated_ - pcl_conversions::fromPCL(obs.cloud_->header).stamp) > observation_keep_time_)
-      {
-        observation_list_.erase(obs_it, observation_list_.end());
+      const Observation& obs = getObservation(observation_count_ - 1);
+      if ((last_updated_ - pcl_conversions::fromPCL(obs.cloud_->header).stamp) <= observation_keep_time_)
         return;
-      }
+      --observation_count_;
     }
   }
 }
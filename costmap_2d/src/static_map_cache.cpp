@@ -0,0 +1,177 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/static_map_cache.h>
+#include <costmap_2d/cost_values.h>
+#include <map_server/map_segment.h>
+#include <algorithm>
+#include <boost/thread/mutex.hpp>
+#include <boost/weak_ptr.hpp>
+#include <cmath>
+#include <cstring>
+#include <list>
+
+namespace costmap_2d
+{
+
+bool StaticGrid::worldToMap(double wx, double wy, unsigned int& mx, unsigned int& my) const
+{
+  if (wx < origin_x || wy < origin_y)
+    return false;
+
+  mx = (int)((wx - origin_x) / resolution);
+  my = (int)((wy - origin_y) / resolution);
+  return mx < size_x && my < size_y;
+}
+
+unsigned char StaticGrid::pooledCost(double wx, double wy, double half_cell) const
+{
+  int min_x = std::max(0, (int)floor((wx - half_cell - origin_x) / resolution));
+  int min_y = std::max(0, (int)floor((wy - half_cell - origin_y) / resolution));
+  int max_x = std::min((int)size_x, (int)ceil((wx + half_cell - origin_x) / resolution));
+  int max_y = std::min((int)size_y, (int)ceil((wy + half_cell - origin_y) / resolution));
+
+  // the cell is only unknown if none of the cells in it is known
+  unsigned char cost = NO_INFORMATION;
+  bool known = false;
+  for (int y = min_y; y < max_y; ++y)
+  {
+    const unsigned char* row = &costs[y * size_x];
+    for (int x = min_x; x < max_x; ++x)
+    {
+      if (row[x] == NO_INFORMATION)
+        continue;
+      cost = known ? std::max(cost, row[x]) : row[x];
+      known = true;
+    }
+  }
+  return cost;
+}
+
+namespace
+{
+
+struct CachedGrid
+{
+  boost::weak_ptr<const nav_msgs::OccupancyGrid> map;
+  unsigned char cost_lut[256];
+  boost::weak_ptr<const StaticGrid> grid;
+};
+
+boost::mutex cache_mutex;
+std::list<CachedGrid> cache;
+
+struct CachedSegment
+{
+  std::string segment;
+  ros::Time load_time;
+  boost::weak_ptr<const nav_msgs::OccupancyGrid> map;
+};
+
+boost::mutex segment_mutex;
+std::list<CachedSegment> segments;
+
+}  // namespace
+
+StaticGridConstPtr convertStaticMap(const nav_msgs::OccupancyGridConstPtr& map, const unsigned char* cost_lut)
+{
+  {
+    boost::mutex::scoped_lock lock(cache_mutex);
+    std::list<CachedGrid>::iterator it = cache.begin();
+    while (it != cache.end())
+    {
+      StaticGridConstPtr grid = it->grid.lock();
+      if (!grid || it->map.expired())
+      {
+        it = cache.erase(it);
+        continue;
+      }
+      if (it->map.lock() == map && memcmp(it->cost_lut, cost_lut, sizeof(it->cost_lut)) == 0)
+        return grid;
+      ++it;
+    }
+  }
+
+  // convert outside of the lock, two layers converting the same map at once only costs some time
+  boost::shared_ptr<StaticGrid> grid(new StaticGrid());
+  grid->size_x = map->info.width;
+  grid->size_y = map->info.height;
+  grid->resolution = map->info.resolution;
+  grid->origin_x = map->info.origin.position.x;
+  grid->origin_y = map->info.origin.position.y;
+  grid->costs.resize(grid->size_x * grid->size_y, NO_INFORMATION);
+  const unsigned char* data = reinterpret_cast<const unsigned char*>(map->data.data());
+  unsigned int cells = std::min(grid->costs.size(), map->data.size());
+  for (unsigned int i = 0; i < cells; ++i)
+    grid->costs[i] = cost_lut[data[i]];
+
+  CachedGrid cached;
+  cached.map = map;
+  memcpy(cached.cost_lut, cost_lut, sizeof(cached.cost_lut));
+  cached.grid = grid;
+  boost::mutex::scoped_lock lock(cache_mutex);
+  cache.push_back(cached);
+  return grid;
+}
+
+nav_msgs::OccupancyGridConstPtr readStaticMapSegment(const std::string& segment, const ros::Time& load_time)
+{
+  boost::mutex::scoped_lock lock(segment_mutex);
+  std::list<CachedSegment>::iterator it = segments.begin();
+  while (it != segments.end())
+  {
+    nav_msgs::OccupancyGridConstPtr map = it->map.lock();
+    if (!map)
+    {
+      it = segments.erase(it);
+      continue;
+    }
+    if (it->segment == segment && it->load_time == load_time)
+      return map;
+    ++it;
+  }
+
+  nav_msgs::OccupancyGridPtr map(new nav_msgs::OccupancyGrid());
+  if (!map_server::readMapSegment(segment, *map) || map->info.map_load_time != load_time)
+    return nav_msgs::OccupancyGridConstPtr();
+
+  CachedSegment cached;
+  cached.segment = segment;
+  cached.load_time = load_time;
+  cached.map = map;
+  segments.push_back(cached);
+  return map;
+}
+
+}  // namespace costmap_2d
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2013, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <ros/time.h>
+
+#include <costmap_2d/cell_decay_tracker.h>
+#include <costmap_2d/cost_values.h>
+
+using namespace costmap_2d;
+
+TEST(cell_decay_tracker, expires_after_timeout)
+{
+  Costmap2D map(10, 10, 1.0, 0.0, 0.0, NO_INFORMATION);
+  CellDecayTracker tracker(FREE_SPACE);
+  tracker.resize(10, 10);
+  tracker.setTimeout(1.0);
+  tracker.seed(map);
+  EXPECT_EQ(0, tracker.size());
+
+  double stamp = ros::Time::now().toSec();
+  map.setCost(3, 4, FREE_SPACE);
+  tracker.push(map.getIndex(3, 4), stamp);
+  // pushing twice keeps a single entry
+  tracker.push(map.getIndex(3, 4), stamp);
+  EXPECT_EQ(1, tracker.size());
+
+  std::vector<unsigned int> expired;
+  tracker.expire(map, stamp + 0.5, expired);
+  EXPECT_TRUE(expired.empty());
+
+  tracker.expire(map, stamp + 2.0, expired);
+  ASSERT_EQ(1, expired.size());
+  EXPECT_EQ(map.getIndex(3, 4), expired[0]);
+  EXPECT_EQ(0, tracker.size());
+}
+
+TEST(cell_decay_tracker, ignores_rewritten_cells)
+{
+  Costmap2D map(10, 10, 1.0, 0.0, 0.0, NO_INFORMATION);
+  CellDecayTracker tracker(LETHAL_OBSTACLE);
+  tracker.resize(10, 10);
+  tracker.setTimeout(1.0);
+  tracker.seed(map);
+
+  double stamp = ros::Time::now().toSec();
+  map.setCost(1, 1, LETHAL_OBSTACLE);
+  tracker.push(map.getIndex(1, 1), stamp - 5.0);
+  map.setCost(2, 2, LETHAL_OBSTACLE);
+  tracker.push(map.getIndex(2, 2), stamp - 5.0);
+
+  // (1, 1) was cleared by someone else, (2, 2) is still lethal but its stamp is recent
+  map.setCost(1, 1, FREE_SPACE);
+
+  std::vector<unsigned int> expired;
+  tracker.expire(map, stamp + 0.5, expired);
+  EXPECT_TRUE(expired.empty());
+  EXPECT_EQ(1, tracker.size());
+
+  tracker.expire(map, stamp + 1.5, expired);
+  ASSERT_EQ(1, expired.size());
+  EXPECT_EQ(map.getIndex(2, 2), expired[0]);
+}
+
+TEST(cell_decay_tracker, disabled_and_seeding)
+{
+  Costmap2D map(10, 10, 1.0, 0.0, 0.0, NO_INFORMATION);
+  map.setCost(5, 5, FREE_SPACE);
+  map.setCost(6, 5, FREE_SPACE);
+
+  CellDecayTracker tracker(FREE_SPACE);
+  tracker.resize(10, 10);
+  tracker.push(map.getIndex(5, 5), 0.0);
+  EXPECT_EQ(0, tracker.size());
+  EXPECT_FALSE(tracker.needsSeeding());
+
+  tracker.setTimeout(1.0);
+  EXPECT_TRUE(tracker.needsSeeding());
+  tracker.seed(map);
+  EXPECT_FALSE(tracker.needsSeeding());
+  EXPECT_EQ(2, tracker.size());
+
+  tracker.setTimeout(-1.0);
+  EXPECT_EQ(0, tracker.size());
+}
+
+TEST(cell_decay_tracker, shift)
+{
+  Costmap2D map(10, 10, 1.0, 0.0, 0.0, NO_INFORMATION);
+  CellDecayTracker tracker(FREE_SPACE);
+  tracker.resize(10, 10);
+  tracker.setTimeout(1.0);
+  tracker.seed(map);
+
+  tracker.push(map.getIndex(0, 0), 0.0);
+  tracker.push(map.getIndex(5, 5), 0.0);
+
+  // the origin moves by one cell diagonally, (0, 0) falls off the map
+  map.setCost(4, 4, FREE_SPACE);
+  tracker.shift(1, 1);
+  EXPECT_EQ(1, tracker.size());
+
+  std::vector<unsigned int> expired;
+  tracker.expire(map, ros::Time::now().toSec() + 2.0, expired);
+  ASSERT_EQ(1, expired.size());
+  EXPECT_EQ(map.getIndex(4, 4), expired[0]);
+}
+
+int main(int argc, char** argv)
+{
+  ros::Time::init();
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <gtest/gtest.h>
+#include <cmath>
+
+#include <costmap_2d/cell_timestamps.h>
+
+using namespace costmap_2d;
+
+TEST(cell_timestamps, round_trip)
+{
+  CellTimeStamps stamps(CellTimeStamps::TICKS_32, 0.001);
+  stamps.resize(4);
+  EXPECT_TRUE(std::isnan(stamps.get(0)));
+
+  stamps.set(0, 1000.0);
+  stamps.set(1, 1000.0004);
+  stamps.set(2, 1012.5);
+  EXPECT_DOUBLE_EQ(1000.0, stamps.get(0));
+  // stamps are rounded up to the next tick
+  EXPECT_NEAR(1000.001, stamps.get(1), 1e-9);
+  EXPECT_NEAR(1012.5, stamps.get(2), 1e-6);
+  EXPECT_TRUE(std::isnan(stamps.get(3)));
+
+  stamps.reset(1, 2);
+  EXPECT_DOUBLE_EQ(1000.0, stamps.get(0));
+  EXPECT_TRUE(std::isnan(stamps.get(1)));
+  EXPECT_TRUE(std::isnan(stamps.get(2)));
+}
+
+TEST(cell_timestamps, rebase)
+{
+  // 16 bit ticks of 0.1s cover a bit more than 6500s
+  CellTimeStamps stamps(CellTimeStamps::TICKS_16, 0.1);
+  stamps.resize(3);
+  stamps.set(0, 0.0);
+  stamps.set(1, 5000.0);
+  stamps.set(2, 7000.0);
+
+  EXPECT_NEAR(7000.0, stamps.get(2), 1e-6);
+  EXPECT_NEAR(5000.0, stamps.get(1), 1e-6);
+  // too old for the new epoch, clamped to the oldest representable stamp
+  EXPECT_LT(stamps.get(0), 5000.0);
+  EXPECT_GT(stamps.get(0), 0.0);
+}
+
+TEST(cell_timestamps, none)
+{
+  CellTimeStamps stamps(CellTimeStamps::NONE, 0.0);
+  stamps.resize(2);
+  stamps.set(0, 10.0);
+  EXPECT_TRUE(std::isnan(stamps.get(0)));
+}
+
+TEST(cell_timestamps, copy_region)
+{
+  CellTimeStamps source(CellTimeStamps::TICKS_32, 0.001);
+  source.resize(4 * 4);
+  source.set(5, 20.0);
+  source.set(6, 21.0);
+
+  // same representation, copied as is
+  CellTimeStamps same(CellTimeStamps::TICKS_32, 0.001);
+  same.resize(2 * 2);
+  same.copyRegion(source, 1, 1, 4, 0, 0, 2, 2, 1);
+  EXPECT_DOUBLE_EQ(20.0, same.get(0));
+  EXPECT_DOUBLE_EQ(21.0, same.get(1));
+  EXPECT_TRUE(std::isnan(same.get(2)));
+
+  // different representation, converted
+  CellTimeStamps coarse(CellTimeStamps::TICKS_16, 0.1);
+  coarse.resize(2 * 2);
+  coarse.copyRegion(source, 1, 1, 4, 0, 1, 2, 2, 1);
+  EXPECT_TRUE(std::isnan(coarse.get(0)));
+  EXPECT_NEAR(20.0, coarse.get(2), 1e-6);
+  EXPECT_NEAR(21.0, coarse.get(3), 1e-6);
+}
+
+TEST(cell_timestamps, shift)
+{
+  CellTimeStamps stamps(CellTimeStamps::TICKS_16, 0.1);
+  stamps.resize(3 * 3);
+  stamps.set(4, 10.0);
+  stamps.set(8, 11.0);
+
+  // the window moves one cell up and right, the center ends up in the lower left corner
+  stamps.shift(3, 3, 1, 1);
+  EXPECT_NEAR(10.0, stamps.get(0), 1e-6);
+  EXPECT_NEAR(11.0, stamps.get(4), 1e-6);
+  EXPECT_TRUE(std::isnan(stamps.get(2)));
+  EXPECT_TRUE(std::isnan(stamps.get(8)));
+
+  // and back, the exposed cells are unstamped
+  stamps.shift(3, 3, -1, -1);
+  EXPECT_NEAR(10.0, stamps.get(4), 1e-6);
+  EXPECT_NEAR(11.0, stamps.get(8), 1e-6);
+  EXPECT_TRUE(std::isnan(stamps.get(0)));
+}
+
+TEST(cell_timestamps, fill)
+{
+  CellTimeStamps stamps(CellTimeStamps::TICKS_16, 0.1);
+  stamps.resize(3 * 3);
+
+  stamps.fill(3, 3, stamps.encode(5.0));
+  EXPECT_TRUE(std::isnan(stamps.get(2)));
+  EXPECT_NEAR(5.0, stamps.get(3), 1e-6);
+  EXPECT_NEAR(5.0, stamps.get(5), 1e-6);
+  EXPECT_TRUE(std::isnan(stamps.get(6)));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <set>
+#include <vector>
+
+#include <costmap_2d/cost_values.h>
+#include <costmap_2d/costmap_2d.h>
+
+using namespace costmap_2d;
+
+namespace
+{
+
+typedef std::set<std::pair<unsigned int, unsigned int> > CellSet;
+
+struct GatherSpans
+{
+  GatherSpans(std::vector<unsigned int>& rows, CellSet& cells) :
+      rows_(rows), cells_(cells)
+  {
+  }
+  void operator()(unsigned int y, unsigned int x0, unsigned int xn)
+  {
+    EXPECT_LT(x0, xn);
+    rows_.push_back(y);
+    for (unsigned int x = x0; x < xn; ++x)
+      cells_.insert(std::make_pair(x, y));
+  }
+  std::vector<unsigned int>& rows_;
+  CellSet& cells_;
+};
+
+// the corners lie on an ellipse in counterclockwise order, so the polygon is convex
+std::vector<MapLocation> randomPolygon(unsigned int corners)
+{
+  std::vector<double> angles(corners);
+  for (unsigned int i = 0; i < corners; ++i)
+    angles[i] = 2 * M_PI * rand() / RAND_MAX;
+  std::sort(angles.begin(), angles.end());
+
+  double cx = 20 + rand() % 60, cy = 20 + rand() % 60;
+  double rx = 1 + rand() % 19, ry = 1 + rand() % 19;
+  std::vector<MapLocation> polygon(corners);
+  for (unsigned int i = 0; i < corners; ++i)
+  {
+    polygon[i].x = (unsigned int)floor(cx + rx * cos(angles[i]) + 0.5);
+    polygon[i].y = (unsigned int)floor(cy + ry * sin(angles[i]) + 0.5);
+  }
+  return polygon;
+}
+
+// whether a cell is strictly inside the polygon
+bool inside(const std::vector<MapLocation>& polygon, unsigned int x, unsigned int y)
+{
+  bool positive = true, negative = true;
+  for (unsigned int i = 0; i < polygon.size(); ++i)
+  {
+    const MapLocation& a = polygon[i];
+    const MapLocation& b = polygon[(i + 1) % polygon.size()];
+    double cross = (double(b.x) - a.x) * (double(y) - a.y) - (double(b.y) - a.y) * (double(x) - a.x);
+    positive = positive && cross > 0;
+    negative = negative && cross < 0;
+  }
+  return positive || negative;
+}
+
+}  // namespace
+
+TEST(convex_fill, spans_cover_outline_and_inside)
+{
+  srand(11);
+  Costmap2D grid(100, 100, 0.05, 0.0, 0.0);
+  for (unsigned int trial = 0; trial < 200; ++trial)
+  {
+    std::vector<MapLocation> polygon = randomPolygon(3 + trial % 6);
+
+    std::vector<unsigned int> rows;
+    CellSet cells;
+    grid.convexFillSpans(polygon, GatherSpans(rows, cells));
+
+    // one span per row, rows in increasing order without gaps
+    ASSERT_FALSE(rows.empty());
+    for (unsigned int i = 1; i < rows.size(); ++i)
+      EXPECT_EQ(rows[i - 1] + 1, rows[i]);
+
+    std::vector<MapLocation> outline;
+    grid.polygonOutlineCells(polygon, outline);
+    for (unsigned int i = 0; i < outline.size(); ++i)
+      EXPECT_TRUE(cells.count(std::make_pair(outline[i].x, outline[i].y)));
+
+    for (unsigned int y = 0; y < grid.getSizeInCellsY(); ++y)
+      for (unsigned int x = 0; x < grid.getSizeInCellsX(); ++x)
+        if (inside(polygon, x, y))
+        {
+          EXPECT_TRUE(cells.count(std::make_pair(x, y)));
+        }
+
+    // and nothing beyond the outline in any row
+    for (CellSet::const_iterator it = cells.begin(); it != cells.end(); ++it)
+    {
+      bool left = false, right = false;
+      for (unsigned int i = 0; i < outline.size(); ++i)
+      {
+        left = left || (outline[i].y == it->second && outline[i].x <= it->first);
+        right = right || (outline[i].y == it->second && outline[i].x >= it->first);
+      }
+      EXPECT_TRUE(left && right);
+    }
+  }
+}
+
+TEST(convex_fill, set_convex_polygon_cost)
+{
+  srand(12);
+  Costmap2D grid(100, 100, 1.0, 0.0, 0.0);
+  for (unsigned int trial = 0; trial < 50; ++trial)
+  {
+    std::vector<MapLocation> polygon = randomPolygon(3 + trial % 6);
+    std::vector<geometry_msgs::Point> world(polygon.size());
+    for (unsigned int i = 0; i < polygon.size(); ++i)
+      grid.mapToWorld(polygon[i].x, polygon[i].y, world[i].x, world[i].y);
+
+    grid.resetMap(0, 0, grid.getSizeInCellsX(), grid.getSizeInCellsY());
+    ASSERT_TRUE(grid.setConvexPolygonCost(world, LETHAL_OBSTACLE, 0.0));
+
+    std::vector<MapLocation> expected;
+    grid.convexFillCells(polygon, expected);
+    CellSet expected_set;
+    for (unsigned int i = 0; i < expected.size(); ++i)
+      expected_set.insert(std::make_pair(expected[i].x, expected[i].y));
+    EXPECT_EQ(expected.size(), expected_set.size());
+
+    for (unsigned int y = 0; y < grid.getSizeInCellsY(); ++y)
+      for (unsigned int x = 0; x < grid.getSizeInCellsX(); ++x)
+        EXPECT_EQ(expected_set.count(std::make_pair(x, y)) ? LETHAL_OBSTACLE : 0, grid.getCost(x, y));
+  }
+
+  // a polygon with a corner off the map is not filled
+  std::vector<geometry_msgs::Point> world(3);
+  world[0].x = 10.0; world[0].y = 10.0;
+  world[1].x = 150.0; world[1].y = 10.0;
+  world[2].x = 10.0; world[2].y = 20.0;
+  EXPECT_FALSE(grid.setConvexPolygonCost(world, LETHAL_OBSTACLE, 0.0));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
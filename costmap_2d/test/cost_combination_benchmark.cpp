@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <costmap_2d/cost_combination.h>
+#include <costmap_2d/cost_values.h>
+#include <sys/time.h>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace costmap_2d;
+
+// the per cell loops the kernels replaced
+static void referenceMax(unsigned char* master, const unsigned char* layer, unsigned int length)
+{
+  for (unsigned int i = 0; i < length; ++i)
+  {
+    if (layer[i] == NO_INFORMATION)
+      continue;
+    if (master[i] == NO_INFORMATION || master[i] < layer[i])
+      master[i] = layer[i];
+  }
+}
+
+static void referenceOverwrite(unsigned char* master, const unsigned char* layer, unsigned int length)
+{
+  for (unsigned int i = 0; i < length; ++i)
+  {
+    if (layer[i] != NO_INFORMATION)
+      master[i] = layer[i];
+  }
+}
+
+static void referenceAddition(unsigned char* master, const unsigned char* layer, unsigned int length)
+{
+  for (unsigned int i = 0; i < length; ++i)
+  {
+    if (layer[i] == NO_INFORMATION)
+      continue;
+    if (master[i] == NO_INFORMATION)
+      master[i] = layer[i];
+    else
+    {
+      int sum = master[i] + layer[i];
+      master[i] = sum >= INSCRIBED_INFLATED_OBSTACLE ? INSCRIBED_INFLATED_OBSTACLE - 1 : sum;
+    }
+  }
+}
+
+typedef void (*Kernel)(unsigned char*, const unsigned char*, unsigned int);
+
+static std::vector<unsigned char> randomCosts(unsigned int length)
+{
+  std::vector<unsigned char> costs(length);
+  for (unsigned int i = 0; i < length; ++i)
+  {
+    int r = rand() % 8;
+    costs[i] = r == 0 ? NO_INFORMATION : r == 1 ? LETHAL_OBSTACLE : rand() % 256;
+  }
+  return costs;
+}
+
+static double seconds()
+{
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// time a kernel on a 2000x2000 map
+static double timeKernel(Kernel kernel)
+{
+  const unsigned int size = 2000, repetitions = 20;
+  std::vector<unsigned char> master = randomCosts(size * size);
+  std::vector<unsigned char> layer = randomCosts(size * size);
+
+  double start = seconds();
+  for (unsigned int r = 0; r < repetitions; ++r)
+  {
+    for (unsigned int y = 0; y < size; ++y)
+      kernel(&master[y * size], &layer[y * size], size);
+  }
+  return (seconds() - start) / repetitions;
+}
+
+// Compares the combination kernels with the per cell loops they replaced
+int main(int argc, char** argv)
+{
+  const char* names[] = {"max", "overwrite", "addition"};
+  Kernel kernels[] = {combineMax, combineOverwrite, combineAddition};
+  Kernel references[] = {referenceMax, referenceOverwrite, referenceAddition};
+  srand(42);
+  for (unsigned int k = 0; k < 3; ++k)
+  {
+    double reference = timeKernel(references[k]);
+    double kernel = timeKernel(kernels[k]);
+    printf("%-9s per cell %.2f ms, kernel %.2f ms, speedup %.1fx\n", names[k], reference * 1e3, kernel * 1e3,
+           reference / kernel);
+  }
+  return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <vector>
+
+#include <costmap_2d/cost_combination.h>
+#include <costmap_2d/cost_values.h>
+
+using namespace costmap_2d;
+
+// the per cell loops the kernels replaced
+static void referenceMax(unsigned char* master, const unsigned char* layer, unsigned int length)
+{
+  for (unsigned int i = 0; i < length; ++i)
+  {
+    if (layer[i] == NO_INFORMATION)
+      continue;
+    if (master[i] == NO_INFORMATION || master[i] < layer[i])
+      master[i] = layer[i];
+  }
+}
+
+static void referenceOverwrite(unsigned char* master, const unsigned char* layer, unsigned int length)
+{
+  for (unsigned int i = 0; i < length; ++i)
+  {
+    if (layer[i] != NO_INFORMATION)
+      master[i] = layer[i];
+  }
+}
+
+static void referenceAddition(unsigned char* master, const unsigned char* layer, unsigned int length)
+{
+  for (unsigned int i = 0; i < length; ++i)
+  {
+    if (layer[i] == NO_INFORMATION)
+      continue;
+    if (master[i] == NO_INFORMATION)
+      master[i] = layer[i];
+    else
+    {
+      int sum = master[i] + layer[i];
+      master[i] = sum >= INSCRIBED_INFLATED_OBSTACLE ? INSCRIBED_INFLATED_OBSTACLE - 1 : sum;
+    }
+  }
+}
+
+typedef void (*Kernel)(unsigned char*, const unsigned char*, unsigned int);
+
+// costs with plenty of NO_INFORMATION and values around the addition cap
+static std::vector<unsigned char> randomCosts(unsigned int length)
+{
+  std::vector<unsigned char> costs(length);
+  for (unsigned int i = 0; i < length; ++i)
+  {
+    int r = rand() % 8;
+    costs[i] = r == 0 ? NO_INFORMATION : r == 1 ? LETHAL_OBSTACLE : rand() % 256;
+  }
+  return costs;
+}
+
+static void expectSame(Kernel kernel, Kernel reference)
+{
+  srand(42);
+  // odd lengths and offsets exercise the unaligned head and the scalar tail
+  for (unsigned int length = 0; length < 100; ++length)
+  {
+    for (unsigned int offset = 0; offset < 3; ++offset)
+    {
+      std::vector<unsigned char> master = randomCosts(length + offset);
+      std::vector<unsigned char> layer = randomCosts(length + offset);
+      std::vector<unsigned char> expected = master;
+
+      reference(&expected[0] + offset, &layer[0] + offset, length);
+      kernel(&master[0] + offset, &layer[0] + offset, length);
+      ASSERT_EQ(expected, master) << "length " << length << " offset " << offset;
+    }
+  }
+}
+
+TEST(cost_combination, max)
+{
+  expectSame(combineMax, referenceMax);
+}
+
+TEST(cost_combination, overwrite)
+{
+  expectSame(combineOverwrite, referenceOverwrite);
+}
+
+TEST(cost_combination, addition)
+{
+  expectSame(combineAddition, referenceAddition);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * Replays observations into a LayeredCostmap with an obstacle or voxel layer
+ * and an inflation layer, and reports the time of the update cycles and the
+ * memory used for a range of map sizes and resolutions.
+ *
+ * No ROS master is needed. Without one the layers run with their default
+ * parameters, with one their parameters are read from the private namespace
+ * of the benchmark as usual (~obstacles/..., ~inflation/...).
+ *
+ * The observations are read from a log with -l, one observation per line in
+ * the frame of the map:
+ *
+ *   robot_x robot_y robot_yaw origin_x origin_y origin_z n x_1 y_1 z_1 ... x_n y_n z_n
+ *
+ * Without a log a robot drives around a world of random boxes with a planar
+ * laser. -w writes these observations to a log, to compare runs on exactly
+ * the same data.
+ *
+ * Usage: costmap_benchmark [-l log] [-w log] [-c cycles] [-s sizes] [-r resolutions] [-voxel] [-rolling]
+ *                          [-noinflation]
+ * sizes and resolutions are comma separated lists, in meters.
+ */
+#include <costmap_2d/layered_costmap.h>
+#include <costmap_2d/obstacle_layer.h>
+#include <costmap_2d/voxel_layer.h>
+#include <costmap_2d/inflation_layer.h>
+#include <tf/transform_listener.h>
+#include <ros/ros.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct LoggedObservation
+{
+  double robot_x, robot_y, robot_yaw;
+  geometry_msgs::Point origin;
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+};
+
+static std::vector<double> parseList(const char* list)
+{
+  std::vector<double> values;
+  std::stringstream ss(list);
+  std::string value;
+  while (std::getline(ss, value, ','))
+    values.push_back(atof(value.c_str()));
+  return values;
+}
+
+static bool readLog(const char* path, std::vector<LoggedObservation>& observations)
+{
+  std::ifstream in(path);
+  if (!in)
+    return false;
+
+  std::string line;
+  while (std::getline(in, line))
+  {
+    std::istringstream ss(line);
+    LoggedObservation obs;
+    unsigned int n;
+    if (!(ss >> obs.robot_x >> obs.robot_y >> obs.robot_yaw >> obs.origin.x >> obs.origin.y >> obs.origin.z >> n))
+      continue;
+    obs.cloud.points.resize(n);
+    for (unsigned int i = 0; i < n; ++i)
+      ss >> obs.cloud.points[i].x >> obs.cloud.points[i].y >> obs.cloud.points[i].z;
+    if (ss)
+      observations.push_back(obs);
+  }
+  return true;
+}
+
+static void writeLog(const char* path, const std::vector<LoggedObservation>& observations)
+{
+  FILE* out = fopen(path, "w");
+  if (!out)
+  {
+    fprintf(stderr, "Cannot write %s\n", path);
+    return;
+  }
+  for (unsigned int k = 0; k < observations.size(); ++k)
+  {
+    const LoggedObservation& obs = observations[k];
+    fprintf(out, "%.3f %.3f %.4f %.3f %.3f %.3f %u", obs.robot_x, obs.robot_y, obs.robot_yaw, obs.origin.x,
+            obs.origin.y, obs.origin.z, (unsigned int)obs.cloud.points.size());
+    for (unsigned int i = 0; i < obs.cloud.points.size(); ++i)
+      fprintf(out, " %.3f %.3f %.3f", obs.cloud.points[i].x, obs.cloud.points[i].y, obs.cloud.points[i].z);
+    fprintf(out, "\n");
+  }
+  fclose(out);
+}
+
+/**
+ * A robot driving on a circle around the origin through a square world of random boxes, scanning with a planar
+ * laser. The world is a grid of 0.1 m cells the beams are marched through.
+ */
+static std::vector<LoggedObservation> simulate(unsigned int cycles, double world_size, double radius)
+{
+  const double cell = 0.1, range = 10.0, height = 0.3;
+  const unsigned int beams = 360;
+  unsigned int size = world_size / cell;
+  std::vector<unsigned char> world(size * size, 0);
+  srand(1);
+  for (unsigned int b = 0; b < world_size * world_size / 20; ++b)
+  {
+    unsigned int x0 = rand() % size, y0 = rand() % size, w = 2 + rand() % 10, h = 2 + rand() % 10;
+    for (unsigned int y = y0; y < std::min(size, y0 + h); ++y)
+      for (unsigned int x = x0; x < std::min(size, x0 + w); ++x)
+        world[y * size + x] = 1;
+  }
+
+  std::vector<LoggedObservation> observations(cycles);
+  for (unsigned int k = 0; k < cycles; ++k)
+  {
+    LoggedObservation& obs = observations[k];
+    double angle = 2 * M_PI * k / cycles;
+    obs.robot_x = radius * cos(angle);
+    obs.robot_y = radius * sin(angle);
+    obs.robot_yaw = angle + M_PI / 2;
+    obs.origin.x = obs.robot_x;
+    obs.origin.y = obs.robot_y;
+    obs.origin.z = height;
+
+    for (unsigned int i = 0; i < beams; ++i)
+    {
+      double beam = obs.robot_yaw + 2 * M_PI * i / beams;
+      for (double r = cell / 2; r < range; r += cell / 2)
+      {
+        double x = obs.robot_x + r * cos(beam), y = obs.robot_y + r * sin(beam);
+        int wx = (x + world_size / 2) / cell, wy = (y + world_size / 2) / cell;
+        if (wx < 0 || wy < 0 || wx >= int(size) || wy >= int(size))
+          break;
+        if (world[wy * size + wx])
+        {
+          obs.cloud.points.push_back(pcl::PointXYZ(x, y, height));
+          break;
+        }
+      }
+    }
+  }
+  return observations;
+}
+
+/** @brief The resident set size and its peak in MB, from /proc */
+static void memoryUsage(double& rss, double& peak)
+{
+  rss = peak = 0.0;
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line))
+  {
+    if (line.compare(0, 6, "VmRSS:") == 0)
+      rss = atof(line.c_str() + 6) / 1024;
+    else if (line.compare(0, 6, "VmHWM:") == 0)
+      peak = atof(line.c_str() + 6) / 1024;
+  }
+}
+
+static void printStage(const char* name, std::vector<double>& times)
+{
+  std::sort(times.begin(), times.end());
+  double sum = 0.0;
+  for (unsigned int k = 0; k < times.size(); ++k)
+    sum += times[k];
+  printf("  %-24s mean %8.3f ms  median %8.3f ms  p90 %8.3f ms  max %8.3f ms\n", name, sum / times.size() * 1e3,
+         times[times.size() / 2] * 1e3, times[std::min(times.size() - 1, times.size() * 90 / 100)] * 1e3,
+         times.back() * 1e3);
+}
+
+static void benchmark(const std::vector<LoggedObservation>& observations, unsigned int cycles, double size,
+                      double resolution, bool voxel, bool rolling, bool inflation, tf::TransformListener& tf)
+{
+  costmap_2d::LayeredCostmap layers("map", rolling, false);
+  layers.resizeMap(size / resolution, size / resolution, resolution, -size / 2, -size / 2);
+  layers.setTiming(true);
+
+  costmap_2d::ObstacleLayer* olayer = voxel ? new costmap_2d::VoxelLayer() : new costmap_2d::ObstacleLayer();
+  layers.addPlugin(boost::shared_ptr<costmap_2d::Layer>(olayer));
+  olayer->initialize(&layers, "obstacles", &tf);
+  if (inflation)
+  {
+    costmap_2d::InflationLayer* ilayer = new costmap_2d::InflationLayer();
+    layers.addPlugin(boost::shared_ptr<costmap_2d::Layer>(ilayer));
+    ilayer->initialize(&layers, "inflation", &tf);
+  }
+
+  std::vector<geometry_msgs::Point> footprint(4);
+  footprint[0].x = footprint[1].x = 0.3;
+  footprint[2].x = footprint[3].x = -0.3;
+  footprint[0].y = footprint[3].y = 0.3;
+  footprint[1].y = footprint[2].y = -0.3;
+  layers.setFootprint(footprint);
+
+  double rss_setup, peak;
+  memoryUsage(rss_setup, peak);
+
+  std::vector<boost::shared_ptr<costmap_2d::Layer> >* plugins = layers.getPlugins();
+  std::vector<double> totals;
+  std::vector<std::vector<double> > bounds(plugins->size()), costs(plugins->size());
+  double cells = 0.0;
+  for (unsigned int k = 0; k < cycles; ++k)
+  {
+    const LoggedObservation& logged = observations[k % observations.size()];
+    geometry_msgs::Point origin = logged.origin;
+    costmap_2d::Observation obs(origin, logged.cloud, 100.0, 100.0);
+    olayer->clearStaticObservations(true, true);
+    olayer->addStaticObservation(obs, true, true);
+
+    layers.updateMap(logged.robot_x, logged.robot_y, logged.robot_yaw);
+
+    costmap_2d::UpdateTiming timing;
+    if (!layers.getLastTiming(timing))
+      continue;
+    totals.push_back(timing.total);
+    cells += timing.cells;
+    for (unsigned int i = 0; i < plugins->size(); ++i)
+    {
+      bounds[i].push_back(timing.bounds[i]);
+      costs[i].push_back(timing.costs[i]);
+    }
+  }
+
+  double rss;
+  memoryUsage(rss, peak);
+  printf("%.1f m at %.3f m (%u x %u cells)%s: %u cycles, %.0f cells updated per cycle\n", size, resolution,
+         layers.getCostmap()->getSizeInCellsX(), layers.getCostmap()->getSizeInCellsY(), rolling ? ", rolling" : "",
+         cycles, totals.empty() ? 0.0 : cells / totals.size());
+  if (totals.empty())
+    return;
+  printStage("update", totals);
+  for (unsigned int i = 0; i < plugins->size(); ++i)
+  {
+    std::string name = (*plugins)[i]->getName();
+    printStage((name + "/bounds").c_str(), bounds[i]);
+    printStage((name + "/costs").c_str(), costs[i]);
+  }
+  printf("  memory: %.1f MB after setup, %.1f MB after the cycles, %.1f MB peak\n", rss_setup, rss, peak);
+}
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "costmap_benchmark", ros::init_options::AnonymousName | ros::init_options::NoRosout);
+  // without a master, calls to it fail right away and the layers keep their defaults
+  if (!ros::master::check())
+    ros::master::setRetryTimeout(ros::WallDuration(0.001));
+
+  const char* log = NULL;
+  const char* write_log = NULL;
+  unsigned int cycles = 200;
+  std::vector<double> sizes = parseList("20,50,100");
+  std::vector<double> resolutions = parseList("0.05,0.1");
+  bool voxel = false, rolling = false, inflation = true;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-l") && i + 1 < argc)
+      log = argv[++i];
+    else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+      write_log = argv[++i];
+    else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+      cycles = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+      sizes = parseList(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      resolutions = parseList(argv[++i]);
+    else if (!strcmp(argv[i], "-voxel"))
+      voxel = true;
+    else if (!strcmp(argv[i], "-rolling"))
+      rolling = true;
+    else if (!strcmp(argv[i], "-noinflation"))
+      inflation = false;
+    else
+    {
+      fprintf(stderr, "Usage: %s [-l log] [-w log] [-c cycles] [-s sizes] [-r resolutions] [-voxel] [-rolling] "
+              "[-noinflation]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  std::vector<LoggedObservation> observations;
+  if (log)
+  {
+    if (!readLog(log, observations) || observations.empty())
+    {
+      fprintf(stderr, "No observations in %s\n", log);
+      return 1;
+    }
+  }
+  else
+  {
+    // the robot stays inside the smallest map
+    observations = simulate(cycles, *std::max_element(sizes.begin(), sizes.end()),
+                            *std::min_element(sizes.begin(), sizes.end()) / 4);
+  }
+  if (write_log)
+    writeLog(write_log, observations);
+
+  tf::TransformListener tf;
+  for (unsigned int s = 0; s < sizes.size(); ++s)
+    for (unsigned int r = 0; r < resolutions.size(); ++r)
+      benchmark(observations, cycles, sizes[s], resolutions[r], voxel, rolling, inflation, tf);
+  return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <unistd.h>
+
+#include <costmap_2d/costmap_checkpoint.h>
+
+using namespace costmap_2d;
+
+static std::string checkpointPath()
+{
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/costmap_checkpoint_test_%d", (int)getpid());
+  return path;
+}
+
+TEST(costmap_checkpoint, round_trip)
+{
+  std::string path = checkpointPath();
+  Costmap2D map(10, 8, 0.5, 1.0, 2.0);
+  map.setCost(3, 4, 254);
+  map.setCost(9, 7, 100);
+  ASSERT_TRUE(writeCheckpoint(path, "local_costmap/obstacles", "odom", 10.0, map));
+
+  Costmap2D restored(10, 8, 0.5, 1.0, 2.0);
+  ASSERT_TRUE(readCheckpoint(path, "local_costmap/obstacles", "odom", 5.0, restored));
+  EXPECT_EQ(254, restored.getCost(3, 4));
+  EXPECT_EQ(100, restored.getCost(9, 7));
+  EXPECT_EQ(0, restored.getCost(0, 0));
+
+  // wrong name, frame, age or resolution
+  EXPECT_FALSE(readCheckpoint(path, "global_costmap/obstacles", "odom", 5.0, restored));
+  EXPECT_FALSE(readCheckpoint(path, "local_costmap/obstacles", "map", 5.0, restored));
+  EXPECT_FALSE(readCheckpoint(path, "local_costmap/obstacles", "odom", 15.0, restored));
+  Costmap2D coarse(10, 8, 1.0, 1.0, 2.0);
+  EXPECT_FALSE(readCheckpoint(path, "local_costmap/obstacles", "odom", 5.0, coarse));
+
+  unlink(path.c_str());
+  EXPECT_FALSE(readCheckpoint(path, "local_costmap/obstacles", "odom", 5.0, restored));
+}
+
+TEST(costmap_checkpoint, moved_origin)
+{
+  std::string path = checkpointPath();
+  Costmap2D map(10, 8, 0.5, 1.0, 2.0);
+  map.setCost(3, 4, 254);
+  map.setCost(0, 0, 100);
+  ASSERT_TRUE(writeCheckpoint(path, "obstacles", "odom", 10.0, map));
+
+  // the window moved two cells right and one up, the corner cell falls off
+  Costmap2D moved(10, 8, 0.5, 2.0, 2.5);
+  moved.setCost(9, 7, 50);
+  ASSERT_TRUE(readCheckpoint(path, "obstacles", "odom", 0.0, moved));
+  EXPECT_EQ(254, moved.getCost(1, 3));
+  EXPECT_EQ(0, moved.getCost(7, 6));
+  EXPECT_EQ(50, moved.getCost(9, 7));
+
+  // off by half a cell
+  Costmap2D shifted(10, 8, 0.5, 1.25, 2.0);
+  EXPECT_FALSE(readCheckpoint(path, "obstacles", "odom", 0.0, shifted));
+  unlink(path.c_str());
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
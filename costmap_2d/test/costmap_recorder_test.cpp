@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <unistd.h>
+
+#include <costmap_2d/costmap_recorder.h>
+
+using namespace costmap_2d;
+
+static std::string logDirectory(const char* test)
+{
+  char path[96];
+  snprintf(path, sizeof(path), "/tmp/costmap_recorder_test_%s_%d", test, (int)getpid());
+  return path;
+}
+
+static void removeDirectory(const std::string& path)
+{
+  DIR* dir = opendir(path.c_str());
+  if (dir == NULL)
+    return;
+  while (struct dirent* entry = readdir(dir))
+  {
+    if (entry->d_name[0] != '.')
+      unlink((path + "/" + entry->d_name).c_str());
+  }
+  closedir(dir);
+  rmdir(path.c_str());
+}
+
+static unsigned int countSegments(const std::string& path)
+{
+  unsigned int count = 0;
+  DIR* dir = opendir(path.c_str());
+  while (struct dirent* entry = readdir(dir))
+    count += strncmp(entry->d_name, "costmap_log_", 12) == 0;
+  closedir(dir);
+  return count;
+}
+
+static void expectSameCosts(const Costmap2D& expected, const Costmap2D& actual)
+{
+  ASSERT_EQ(expected.getSizeInCellsX(), actual.getSizeInCellsX());
+  ASSERT_EQ(expected.getSizeInCellsY(), actual.getSizeInCellsY());
+  EXPECT_EQ(expected.getOriginX(), actual.getOriginX());
+  EXPECT_EQ(0, memcmp(expected.getCharMap(), actual.getCharMap(),
+                      expected.getSizeInCellsX() * expected.getSizeInCellsY()));
+}
+
+TEST(costmap_recorder, replays_the_timeline)
+{
+  std::string path = logDirectory("timeline");
+  Costmap2D master(60, 40, 0.1, 0.0, 0.0), layer(60, 40, 0.1, 0.0, 0.0);
+  std::vector<Costmap2D> masters;
+  {
+    CostmapRecorder recorder(path, 1 << 20, 4, 5);
+    srand(1);
+    for (unsigned int frame = 0; frame < 20; ++frame)
+    {
+      // every frame changes a few cells within a window
+      unsigned int x0 = rand() % 50, y0 = rand() % 30;
+      for (unsigned int i = 0; i < 10; ++i)
+      {
+        master.setCost(x0 + rand() % 10, y0 + rand() % 10, rand() % 256);
+        layer.setCost(x0 + rand() % 10, y0 + rand() % 10, rand() % 256);
+      }
+      ASSERT_TRUE(recorder.record("master", frame, master, x0, x0 + 10, y0, y0 + 10));
+      ASSERT_TRUE(recorder.record("master/obstacles", frame, layer, x0, x0 + 10, y0, y0 + 10));
+      masters.push_back(master);
+      recorder.flush();
+    }
+  }
+
+  CostmapLogReader reader;
+  ASSERT_TRUE(reader.open(path));
+  unsigned int master_frames = 0;
+  while (reader.next())
+  {
+    if (reader.getName() != "master")
+      continue;
+    ASSERT_LT(master_frames, masters.size());
+    EXPECT_EQ(master_frames, reader.getStamp());
+    expectSameCosts(masters[master_frames], *reader.getGrid("master"));
+    ++master_frames;
+  }
+  EXPECT_EQ(20u, master_frames);
+  expectSameCosts(layer, *reader.getGrid("master/obstacles"));
+  removeDirectory(path);
+}
+
+TEST(costmap_recorder, keyframe_after_moving)
+{
+  std::string path = logDirectory("moving");
+  Costmap2D grid(30, 30, 0.1, 0.0, 0.0);
+  {
+    CostmapRecorder recorder(path, 1 << 20, 4, 0);
+    grid.setCost(5, 5, 254);
+    recorder.record("local", 0.0, grid, 5, 6, 5, 6);
+    // a rolling window moves, the rectangle is not enough then
+    grid.updateOrigin(0.5, 0.0);
+    grid.setCost(20, 20, 100);
+    recorder.record("local", 1.0, grid, 20, 21, 20, 21);
+  }
+
+  CostmapLogReader reader;
+  ASSERT_TRUE(reader.open(path));
+  ASSERT_TRUE(reader.next());
+  EXPECT_TRUE(reader.isKeyframe());
+  ASSERT_TRUE(reader.next());
+  EXPECT_TRUE(reader.isKeyframe());
+  expectSameCosts(grid, *reader.getGrid("local"));
+  EXPECT_FALSE(reader.next());
+  removeDirectory(path);
+}
+
+TEST(costmap_recorder, bounded_ring)
+{
+  std::string path = logDirectory("ring");
+  Costmap2D grid(100, 100, 0.1, 0.0, 0.0);
+  {
+    CostmapRecorder recorder(path, 4096, 3, 0);
+    srand(2);
+    for (unsigned int frame = 0; frame < 200; ++frame)
+    {
+      for (unsigned int i = 0; i < 50; ++i)
+        grid.setCost(rand() % 100, rand() % 100, rand() % 256);
+      recorder.record("master", frame, grid, 0, 100, 0, 100);
+      recorder.flush();
+      EXPECT_LE(countSegments(path), 3u);
+    }
+  }
+
+  // the oldest segments are gone, the rest still starts with a keyframe and ends with the last frame
+  CostmapLogReader reader;
+  ASSERT_TRUE(reader.open(path));
+  ASSERT_TRUE(reader.next());
+  EXPECT_TRUE(reader.isKeyframe());
+  EXPECT_GT(reader.getStamp(), 0.0);
+  while (reader.next())
+  {
+  }
+  EXPECT_EQ(199.0, reader.getStamp());
+  expectSameCosts(grid, *reader.getGrid("master"));
+  removeDirectory(path);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <costmap_2d/depth_slope_kernel.h>
+#include <sys/time.h>
+#include <cstdio>
+#include "synthetic_depth.h"
+
+using costmap_2d::DepthSlopeKernel;
+
+static double seconds()
+{
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + t.tv_usec / 1e6;
+}
+
+// Measures the classification throughput per pixel, so the numbers do not depend on how many columns are sampled
+int main(int argc, char** argv)
+{
+  int width = 640, height = 480, repetitions = 20;
+  ForwardCamera camera(width, height, 525.0);
+  CameraPose pose(0.5, 0.3);
+  std::vector<float> depth = renderWall(camera, pose, width, height, 1.5);
+  std::vector<const float*> rows(height);
+  for (int y = 0; y < height; ++y)
+    rows[y] = &depth[y * width];
+
+  DepthSlopeKernel kernel;
+  kernel.setPose(pose.rotation, pose.translation);
+
+  double start = seconds();
+  kernel.setCamera(camera, width, height);
+  printf("Ray directions, once per camera model: %.6f s\n", seconds() - start);
+
+  double pixels = (double)width * height * repetitions;
+  double closest_ref[3];
+  start = seconds();
+  for (int r = 0; r < repetitions; ++r)
+  {
+    for (int x = 0; x < width; ++x)
+      referenceClosest(depth, camera, pose, width, height, x, 30, 1.0, closest_ref);
+  }
+  double t_ref = seconds() - start;
+  printf("Scalar double: %.2f ns per pixel, %.1f Mpixel/s\n", t_ref / pixels * 1e9, pixels / t_ref / 1e6);
+
+  DepthSlopeKernel::Scratch scratch;
+  float closest[3];
+  start = seconds();
+  for (int r = 0; r < repetitions; ++r)
+  {
+    for (int x = 0; x < width; ++x)
+      kernel.processColumn(&rows[0], x, scratch, closest);
+  }
+  double t_kernel = seconds() - start;
+  printf("Kernel: %.2f ns per pixel, %.1f Mpixel/s\n", t_kernel / pixels * 1e9, pixels / t_kernel / 1e6);
+  return 0;
+}
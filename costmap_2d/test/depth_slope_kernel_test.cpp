@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <costmap_2d/depth_slope_kernel.h>
+#include <gtest/gtest.h>
+#include "synthetic_depth.h"
+
+using namespace costmap_2d;
+
+TEST(depth_slope_kernel, matches_reference)
+{
+  int width = 160, height = 120;
+  ForwardCamera camera(width, height, 100.0);
+  CameraPose pose(0.5, 0.3);
+  std::vector<float> depth = renderWall(camera, pose, width, height, 1.5);
+  std::vector<const float*> rows(height);
+  for (int y = 0; y < height; ++y)
+    rows[y] = &depth[y * width];
+
+  DepthSlopeKernel kernel;
+  kernel.setPose(pose.rotation, pose.translation);
+  kernel.setParameters(30, 1.0, 0.2);
+  EXPECT_TRUE(kernel.setCamera(camera, width, height));
+  EXPECT_FALSE(kernel.setCamera(camera, width, height));
+
+  DepthSlopeKernel::Scratch scratch;
+  for (int x = 0; x < width; ++x)
+  {
+    float closest[3];
+    double expected[3];
+    ASSERT_TRUE(referenceClosest(depth, camera, pose, width, height, x, 30, 1.0, expected));
+    ASSERT_TRUE(kernel.processColumn(&rows[0], x, scratch, closest));
+    EXPECT_NEAR(expected[1], closest[1], 1e-4);
+
+    // the wall pixels are all equally close, so only check that the obstacle is on the wall or the floor
+    EXPECT_TRUE(std::abs(closest[1] - 1.5) < 1e-3 || std::abs(closest[2]) < 1e-3);
+
+    // the foot of the wall is found through the slope of the floor points next to it
+    EXPECT_LE(closest[1], 1.5 + 1e-4);
+    EXPECT_GT(closest[1], 1.3);
+  }
+}
+
+TEST(depth_slope_kernel, camera_change)
+{
+  ForwardCamera camera(40, 30, 50.0), zoomed(40, 30, 80.0);
+  DepthSlopeKernel kernel;
+  EXPECT_TRUE(kernel.setCamera(camera, 40, 30));
+  EXPECT_TRUE(kernel.setCamera(zoomed, 40, 30));
+  EXPECT_TRUE(kernel.setCamera(zoomed, 20, 30));
+  EXPECT_EQ(20, kernel.width());
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
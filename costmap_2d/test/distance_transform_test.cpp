@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <vector>
+
+#include <costmap_2d/distance_transform.h>
+
+using namespace costmap_2d;
+
+TEST(distance_transform, single_source)
+{
+  std::vector<float> grid(7 * 5, DistanceTransform::INF);
+  grid[2 * 7 + 3] = 0.0;
+
+  DistanceTransform dt;
+  dt.compute(&grid[0], 7, 5);
+
+  for (int y = 0; y < 5; ++y)
+    for (int x = 0; x < 7; ++x)
+      EXPECT_FLOAT_EQ((x - 3) * (x - 3) + (y - 2) * (y - 2), grid[y * 7 + x]);
+}
+
+TEST(distance_transform, no_source)
+{
+  std::vector<float> grid(4 * 4, DistanceTransform::INF);
+  DistanceTransform dt;
+  dt.compute(&grid[0], 4, 4);
+  for (unsigned int i = 0; i < grid.size(); ++i)
+    EXPECT_EQ(DistanceTransform::INF, grid[i]);
+}
+
+TEST(distance_transform, matches_brute_force)
+{
+  const int size_x = 23, size_y = 17;
+  std::vector<float> input(size_x * size_y, DistanceTransform::INF);
+  srand(42);
+  for (int i = 0; i < 30; ++i)
+    input[rand() % input.size()] = rand() % 20;
+
+  std::vector<float> grid = input;
+  DistanceTransform dt;
+  dt.compute(&grid[0], size_x, size_y);
+
+  for (int py = 0; py < size_y; ++py)
+  {
+    for (int px = 0; px < size_x; ++px)
+    {
+      float best = DistanceTransform::INF;
+      for (int qy = 0; qy < size_y; ++qy)
+        for (int qx = 0; qx < size_x; ++qx)
+          if (input[qy * size_x + qx] != DistanceTransform::INF)
+            best = std::min(best, (float)((px - qx) * (px - qx) + (py - qy) * (py - qy)) + input[qy * size_x + qx]);
+      EXPECT_FLOAT_EQ(best, grid[py * size_x + px]);
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
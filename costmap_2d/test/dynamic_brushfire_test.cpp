@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include <costmap_2d/dynamic_brushfire.h>
+
+using namespace costmap_2d;
+
+namespace
+{
+
+const unsigned int SIZE_X = 40, SIZE_Y = 30, MAX_DISTANCE = 64;
+
+/** @brief The exact squared distance to the nearest obstacle of each cell, or NONE beyond the maximum */
+std::vector<unsigned int> bruteForce(const std::vector<bool>& obstacles)
+{
+  std::vector<unsigned int> distances(obstacles.size(), DynamicBrushfire::NONE);
+  for (unsigned int p = 0; p < obstacles.size(); ++p)
+  {
+    for (unsigned int q = 0; q < obstacles.size(); ++q)
+    {
+      if (!obstacles[q])
+        continue;
+      int dx = int(p % SIZE_X) - int(q % SIZE_X), dy = int(p / SIZE_X) - int(q / SIZE_X);
+      unsigned int distance = dx * dx + dy * dy;
+      if (distance <= MAX_DISTANCE && (distances[p] == DynamicBrushfire::NONE || distance < distances[p]))
+        distances[p] = distance;
+    }
+  }
+  return distances;
+}
+
+/** @brief Check the distances of the brushfire against the exact ones */
+void expectDistances(const DynamicBrushfire& brushfire, const std::vector<bool>& obstacles)
+{
+  std::vector<unsigned int> exact = bruteForce(obstacles);
+  for (unsigned int p = 0; p < obstacles.size(); ++p)
+  {
+    ASSERT_EQ(obstacles[p], brushfire.isObstacle(p));
+    unsigned int obstacle = brushfire.getObstacle(p);
+    if (obstacle == DynamicBrushfire::NONE)
+    {
+      // the waves may stop short of the maximum distance by a fraction of a cell
+      if (exact[p] != DynamicBrushfire::NONE)
+      {
+        EXPECT_GT((sqrt(exact[p]) + 1.0) * (sqrt(exact[p]) + 1.0), MAX_DISTANCE) << "cell " << p;
+      }
+      continue;
+    }
+
+    // the obstacle is real and the distance is the one to it
+    ASSERT_TRUE(obstacles[obstacle]);
+    int dx = int(p % SIZE_X) - int(obstacle % SIZE_X), dy = int(p / SIZE_X) - int(obstacle / SIZE_X);
+    unsigned int distance = brushfire.getSquaredDistance(p);
+    EXPECT_EQ(unsigned(dx * dx + dy * dy), distance);
+    EXPECT_LE(distance, MAX_DISTANCE);
+
+    ASSERT_NE(DynamicBrushfire::NONE, exact[p]);
+    EXPECT_GE(distance, exact[p]);
+    EXPECT_LT(sqrt(distance) - sqrt(exact[p]), 0.5) << "cell " << p;
+  }
+}
+
+}  // namespace
+
+TEST(dynamic_brushfire, single_obstacle)
+{
+  DynamicBrushfire brushfire;
+  brushfire.reset(SIZE_X, SIZE_Y, MAX_DISTANCE);
+  brushfire.setObstacle(12 * SIZE_X + 20);
+  brushfire.update();
+
+  for (unsigned int y = 0; y < SIZE_Y; ++y)
+  {
+    for (unsigned int x = 0; x < SIZE_X; ++x)
+    {
+      unsigned int distance = (x - 20) * (x - 20) + (y - 12) * (y - 12);
+      if (distance <= MAX_DISTANCE)
+      {
+        EXPECT_EQ(distance, brushfire.getSquaredDistance(y * SIZE_X + x));
+      }
+      else
+      {
+        EXPECT_EQ(DynamicBrushfire::NONE, brushfire.getObstacle(y * SIZE_X + x));
+      }
+    }
+  }
+
+  brushfire.removeObstacle(12 * SIZE_X + 20);
+  brushfire.update();
+  for (unsigned int p = 0; p < SIZE_X * SIZE_Y; ++p)
+    EXPECT_EQ(DynamicBrushfire::NONE, brushfire.getObstacle(p));
+}
+
+TEST(dynamic_brushfire, incremental_matches_brute_force)
+{
+  srand(42);
+  std::vector<bool> obstacles(SIZE_X * SIZE_Y, false);
+  DynamicBrushfire brushfire;
+  brushfire.reset(SIZE_X, SIZE_Y, MAX_DISTANCE);
+
+  for (unsigned int round = 0; round < 20; ++round)
+  {
+    // add some obstacles, and remove some of the ones there are
+    for (unsigned int p = 0; p < obstacles.size(); ++p)
+    {
+      if (obstacles[p] && rand() % 3 == 0)
+      {
+        obstacles[p] = false;
+        brushfire.removeObstacle(p);
+      }
+      else if (!obstacles[p] && rand() % 60 == 0)
+      {
+        obstacles[p] = true;
+        brushfire.setObstacle(p);
+      }
+    }
+    brushfire.update();
+    expectDistances(brushfire, obstacles);
+  }
+}
+
+TEST(dynamic_brushfire, wall_removal)
+{
+  std::vector<bool> obstacles(SIZE_X * SIZE_Y, false);
+  DynamicBrushfire brushfire;
+  brushfire.reset(SIZE_X, SIZE_Y, MAX_DISTANCE);
+  for (unsigned int y = 0; y < SIZE_Y; ++y)
+  {
+    obstacles[y * SIZE_X + 10] = obstacles[y * SIZE_X + 25] = true;
+    brushfire.setObstacle(y * SIZE_X + 10);
+    brushfire.setObstacle(y * SIZE_X + 25);
+  }
+  brushfire.update();
+  expectDistances(brushfire, obstacles);
+
+  // the cells between the walls fall back to the other wall
+  for (unsigned int y = 0; y < SIZE_Y; ++y)
+  {
+    obstacles[y * SIZE_X + 10] = false;
+    brushfire.removeObstacle(y * SIZE_X + 10);
+  }
+  brushfire.update();
+  expectDistances(brushfire, obstacles);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <gtest/gtest.h>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+#include <costmap_2d/executor.h>
+
+using namespace costmap_2d;
+
+static void count(boost::mutex* mutex, int* counter)
+{
+  boost::mutex::scoped_lock lock(*mutex);
+  ++*counter;
+}
+
+static void fill(std::vector<int>* values, unsigned int begin, unsigned int end)
+{
+  for (unsigned int i = begin; i < end; ++i)
+    (*values)[i] = i;
+}
+
+static void spawn(Executor* executor, boost::mutex* mutex, int* counter)
+{
+  TaskGroup group(*executor);
+  for (int i = 0; i < 8; ++i)
+    group.run(boost::bind(count, mutex, counter));
+  group.wait();
+}
+
+TEST(executor, runs_every_task)
+{
+  for (unsigned int threads = 0; threads < 4; ++threads)
+  {
+    Executor executor(threads);
+    EXPECT_EQ(threads, executor.getThreads());
+
+    std::vector<int> values(1000, -1);
+    TaskGroup group(executor);
+    for (unsigned int part = 1; part < 10; ++part)
+      group.run(boost::bind(fill, &values, part * 100, (part + 1) * 100));
+    fill(&values, 0, 100);
+    group.wait();
+
+    for (unsigned int i = 0; i < values.size(); ++i)
+      ASSERT_EQ((int)i, values[i]);
+  }
+}
+
+TEST(executor, nested_groups)
+{
+  // a task that waits for a group of its own must not block the pool, even without workers
+  for (unsigned int threads = 0; threads < 3; ++threads)
+  {
+    Executor executor(threads);
+    boost::mutex mutex;
+    int counter = 0;
+    {
+      TaskGroup group(executor);
+      for (int i = 0; i < 4; ++i)
+        group.run(boost::bind(spawn, &executor, &mutex, &counter));
+    }
+    EXPECT_EQ(32, counter);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <vector>
+
+#include <costmap_2d/cost_values.h>
+#include <costmap_2d/footprint_collision_map.h>
+
+using namespace costmap_2d;
+
+namespace
+{
+
+std::vector<geometry_msgs::Point> makeCart()
+{
+  // a long, narrow cart: 1.2m by 0.4m
+  std::vector<geometry_msgs::Point> footprint(4);
+  footprint[0].x = 0.6;
+  footprint[0].y = 0.2;
+  footprint[1].x = -0.6;
+  footprint[1].y = 0.2;
+  footprint[2].x = -0.6;
+  footprint[2].y = -0.2;
+  footprint[3].x = 0.6;
+  footprint[3].y = -0.2;
+  return footprint;
+}
+
+/** @brief Whether an obstacle in the grid is under the spans of a bin at a cell */
+bool bruteForceCollides(const Costmap2D& grid, const FootprintSpans& spans, unsigned int bin, int mx, int my)
+{
+  const std::vector<FootprintSpans::RowSpan>& row_spans = spans.getBinSpans(bin);
+  for (unsigned int s = 0; s < row_spans.size(); ++s)
+  {
+    int y = my + row_spans[s].dy;
+    for (int x = mx + row_spans[s].dx0; x < mx + row_spans[s].dxn; ++x)
+    {
+      if (x >= 0 && y >= 0 && x < int(grid.getSizeInCellsX()) && y < int(grid.getSizeInCellsY())
+          && grid.getCost(x, y) == LETHAL_OBSTACLE)
+        return true;
+    }
+  }
+  return false;
+}
+
+void expectMatchesBruteForce(const Costmap2D& grid, const FootprintCollisionMap& map, const FootprintSpans& spans)
+{
+  for (unsigned int bin = 0; bin < map.getNumBins(); ++bin)
+    for (unsigned int y = 0; y < grid.getSizeInCellsY(); ++y)
+      for (unsigned int x = 0; x < grid.getSizeInCellsX(); ++x)
+        ASSERT_EQ(bruteForceCollides(grid, spans, bin, x, y), map.collides(x, y, bin))
+            << "bin " << bin << " cell " << x << ", " << y;
+}
+
+}  // namespace
+
+TEST(footprint_collision_map, matches_brute_force)
+{
+  Costmap2D grid(150, 70, 0.05, 0.0, 0.0);
+  srand(7);
+  for (unsigned int i = 0; i < 200; ++i)
+    grid.setCost(rand() % 150, rand() % 70, LETHAL_OBSTACLE);
+
+  FootprintSpans spans;
+  spans.update(makeCart(), 1.0, 0.05, 16);
+  FootprintCollisionMap map;
+  map.setFootprint(makeCart(), 0.05, 16);
+  map.update(grid, LETHAL_OBSTACLE, 0, 0, 0, 0);  // the first update covers the whole grid
+  expectMatchesBruteForce(grid, map, spans);
+
+  // move some obstacles and only update around them
+  for (unsigned int i = 0; i < 20; ++i)
+  {
+    int x = 40 + rand() % 20, y = 20 + rand() % 20;
+    grid.setCost(x, y, grid.getCost(x, y) == LETHAL_OBSTACLE ? FREE_SPACE : LETHAL_OBSTACLE);
+  }
+  int reach = map.getReach();
+  map.update(grid, LETHAL_OBSTACLE, 40 - reach, 20 - reach, 60 + reach, 40 + reach);
+  expectMatchesBruteForce(grid, map, spans);
+}
+
+TEST(footprint_collision_map, narrow_aisle)
+{
+  // an aisle 0.6m wide along x between two walls, wider than the cart but narrower than its length
+  Costmap2D grid(100, 40, 0.05, 0.0, 0.0);
+  for (unsigned int x = 0; x < 100; ++x)
+  {
+    grid.setCost(x, 8, LETHAL_OBSTACLE);
+    grid.setCost(x, 21, LETHAL_OBSTACLE);
+  }
+
+  FootprintCollisionMap map;
+  map.setFootprint(makeCart(), 0.05, 8);
+  map.update(grid, LETHAL_OBSTACLE, 0, 0, 100, 40);
+
+  // the cart fits along the aisle in both directions, but not across it
+  EXPECT_FALSE(map.collides(50, 14, 0.0));
+  EXPECT_FALSE(map.collides(50, 14, M_PI));
+  EXPECT_TRUE(map.collides(50, 14, M_PI / 2));
+  EXPECT_TRUE(map.collides(50, 14, M_PI / 4));
+  // and not off center
+  EXPECT_TRUE(map.collides(50, 11, 0.0));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdlib>
+#include <set>
+#include <vector>
+
+#include <costmap_2d/cost_values.h>
+#include <costmap_2d/footprint_spans.h>
+
+using namespace costmap_2d;
+
+namespace
+{
+
+std::vector<geometry_msgs::Point> makeFootprint(const double* xy, unsigned int n)
+{
+  std::vector<geometry_msgs::Point> footprint(n);
+  for (unsigned int i = 0; i < n; ++i)
+  {
+    footprint[i].x = xy[2 * i];
+    footprint[i].y = xy[2 * i + 1];
+  }
+  return footprint;
+}
+
+/** @brief The cells the exact polygon fill of the costmap sets, for the robot at the center of a cell */
+std::set<std::pair<int, int> > exactCells(Costmap2D& grid, const std::vector<geometry_msgs::Point>& footprint,
+                                          unsigned int mx, unsigned int my, double yaw)
+{
+  double x, y;
+  grid.mapToWorld(mx, my, x, y);
+  std::vector<MapLocation> polygon(footprint.size());
+  for (unsigned int i = 0; i < footprint.size(); ++i)
+  {
+    double px = x + footprint[i].x * cos(yaw) - footprint[i].y * sin(yaw);
+    double py = y + footprint[i].x * sin(yaw) + footprint[i].y * cos(yaw);
+    grid.worldToMap(px, py, polygon[i].x, polygon[i].y);
+  }
+  std::vector<MapLocation> cells;
+  grid.convexFillCells(polygon, cells);
+
+  std::set<std::pair<int, int> > result;
+  for (unsigned int i = 0; i < cells.size(); ++i)
+    result.insert(std::make_pair(int(cells[i].x), int(cells[i].y)));
+  return result;
+}
+
+std::set<std::pair<int, int> > spanCells(Costmap2D& grid, const FootprintSpans& spans, unsigned int mx,
+                                         unsigned int my, double yaw)
+{
+  double x, y;
+  grid.mapToWorld(mx, my, x, y);
+  grid.resetMap(0, 0, grid.getSizeInCellsX(), grid.getSizeInCellsY());
+  spans.setCost(grid, x, y, yaw, LETHAL_OBSTACLE, 0.0);
+
+  std::set<std::pair<int, int> > result;
+  for (unsigned int j = 0; j < grid.getSizeInCellsY(); ++j)
+    for (unsigned int i = 0; i < grid.getSizeInCellsX(); ++i)
+      if (grid.getCost(i, j) == LETHAL_OBSTACLE)
+        result.insert(std::make_pair(int(i), int(j)));
+  return result;
+}
+
+}  // namespace
+
+TEST(footprint_spans, square)
+{
+  const double xy[] = {0.25, 0.25, 0.25, -0.25, -0.25, -0.25, -0.25, 0.25};
+  Costmap2D grid(40, 40, 0.05, 0.0, 0.0);
+  FootprintSpans spans;
+  spans.update(makeFootprint(xy, 4), 1.0, 0.05, 4);
+
+  // the corners are 5 cells from the robot cell
+  std::set<std::pair<int, int> > cells = spanCells(grid, spans, 20, 20, 0.0);
+  EXPECT_EQ(11u * 11u, cells.size());
+  EXPECT_TRUE(cells.count(std::make_pair(15, 15)));
+  EXPECT_TRUE(cells.count(std::make_pair(25, 25)));
+
+  // half way to the next heading still uses the square at 0
+  EXPECT_EQ(cells, spanCells(grid, spans, 20, 20, M_PI / 4 - 0.01));
+}
+
+TEST(footprint_spans, matches_polygon_fill)
+{
+  const double xy[] = {0.4, 0.0, 0.2, 0.3, -0.3, 0.25, -0.35, -0.2, 0.1, -0.3};
+  std::vector<geometry_msgs::Point> footprint = makeFootprint(xy, 5);
+  Costmap2D grid(60, 60, 0.05, 0.0, 0.0);
+  FootprintSpans spans;
+  const unsigned int headings = 36;
+  spans.update(footprint, 1.0, 0.05, headings);
+
+  // at the headings of the bins the spans hold the same cells as the polygon fill
+  for (unsigned int h = 0; h < headings; ++h)
+  {
+    double yaw = 2 * M_PI * h / headings;
+    EXPECT_EQ(exactCells(grid, footprint, 30, 30, yaw), spanCells(grid, spans, 30, 30, yaw)) << "heading " << h;
+  }
+}
+
+TEST(footprint_spans, clipped_to_grid)
+{
+  const double xy[] = {0.25, 0.25, 0.25, -0.25, -0.25, -0.25, -0.25, 0.25};
+  Costmap2D grid(20, 20, 0.05, 0.0, 0.0);
+  FootprintSpans spans;
+  spans.update(makeFootprint(xy, 4), 1.0, 0.05, 8);
+
+  // the robot in the corner of the grid only sets the cells inside it
+  EXPECT_EQ(6u * 6u, spanCells(grid, spans, 0, 0, 0.0).size());
+  EXPECT_EQ(6u * 6u, spanCells(grid, spans, 19, 19, 0.0).size());
+}
+
+TEST(footprint_spans, cost)
+{
+  const double xy[] = {0.25, 0.25, 0.25, -0.25, -0.25, -0.25, -0.25, 0.25};
+  Costmap2D grid(40, 40, 0.05, 0.0, 0.0);
+  FootprintSpans spans;
+  double x, y;
+  grid.mapToWorld(20, 20, x, y);
+  EXPECT_EQ(-1.0, spans.getCost(grid, x, y, 0.0));
+
+  spans.update(makeFootprint(xy, 4), 1.0, 0.05, 4);
+  EXPECT_EQ(0.0, spans.getCost(grid, x, y, 0.0));
+
+  // the highest cost under the footprint, also inside of its outline
+  grid.setCost(22, 18, 100);
+  grid.setCost(25, 20, 50);
+  EXPECT_EQ(100.0, spans.getCost(grid, x, y, 0.0));
+  grid.setCost(26, 20, LETHAL_OBSTACLE);
+  EXPECT_EQ(100.0, spans.getCost(grid, x, y, 0.0));
+  grid.setCost(21, 21, LETHAL_OBSTACLE);
+  EXPECT_EQ(-1.0, spans.getCost(grid, x, y, 0.0));
+  grid.setCost(21, 21, NO_INFORMATION);
+  EXPECT_EQ(-1.0, spans.getCost(grid, x, y, 0.0));
+
+  // a footprint partly off the grid is not legal
+  grid.mapToWorld(2, 20, x, y);
+  EXPECT_EQ(-1.0, spans.getCost(grid, x, y, 0.0));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <vector>
+
+#include <costmap_2d/grid_compression.h>
+#include <voxel_grid/voxel_grid.h>
+
+using namespace costmap_2d;
+
+static void expectRoundTrip(const std::vector<int8_t>& data)
+{
+  std::vector<uint8_t> encoded;
+  encodeRunLength(data.empty() ? NULL : &data[0], data.size(), encoded);
+
+  std::vector<int8_t> decoded(data.size());
+  ASSERT_TRUE(decodeRunLength(encoded, decoded.empty() ? NULL : &decoded[0], decoded.size()));
+  EXPECT_EQ(data, decoded);
+}
+
+TEST(grid_compression, round_trip)
+{
+  expectRoundTrip(std::vector<int8_t>());
+  expectRoundTrip(std::vector<int8_t>(1, 5));
+  expectRoundTrip(std::vector<int8_t>(1000, -1));
+
+  // runs of every length next to literals of every length, crossing the limits of both
+  srand(42);
+  for (unsigned int t = 0; t < 200; ++t)
+  {
+    std::vector<int8_t> data;
+    while (data.size() < 2000)
+    {
+      unsigned int length = 1 + rand() % 300;
+      bool run = rand() % 2;
+      int8_t value = rand() % 101;
+      for (unsigned int i = 0; i < length; ++i)
+        data.push_back(run ? value : int8_t(rand() % 3));
+    }
+    expectRoundTrip(data);
+  }
+}
+
+TEST(grid_compression, compresses_runs)
+{
+  std::vector<int8_t> data(10000, 0);
+  data[5000] = 100;
+  std::vector<uint8_t> encoded;
+  encodeRunLength(&data[0], data.size(), encoded);
+  EXPECT_LT(encoded.size(), 200u);
+}
+
+TEST(grid_compression, malformed)
+{
+  std::vector<int8_t> decoded(4);
+  std::vector<uint8_t> encoded;
+
+  // a literal block that is cut short
+  encoded.push_back(3);
+  encoded.push_back(1);
+  EXPECT_FALSE(decodeRunLength(encoded, &decoded[0], decoded.size()));
+
+  // a run that is longer than the output
+  encoded.clear();
+  encoded.push_back(130);
+  encoded.push_back(1);
+  EXPECT_FALSE(decodeRunLength(encoded, &decoded[0], decoded.size()));
+}
+
+static CompressedGridUpdate makeUpdate(uint32_t frame, bool keyframe, unsigned int x, unsigned int y,
+                                       unsigned int width, unsigned int height, const std::vector<int8_t>& values)
+{
+  CompressedGridUpdate update;
+  update.info.width = 4;
+  update.info.height = 3;
+  update.info.resolution = 0.5;
+  update.frame = frame;
+  update.keyframe = keyframe;
+  update.x = x;
+  update.y = y;
+  update.width = width;
+  update.height = height;
+  encodeRunLength(&values[0], values.size(), update.data);
+  return update;
+}
+
+TEST(grid_compression, decoder)
+{
+  CompressedGridDecoder decoder;
+
+  // deltas before the first keyframe are rejected
+  EXPECT_FALSE(decoder.update(makeUpdate(0, false, 0, 0, 1, 1, std::vector<int8_t>(1, 0))));
+  EXPECT_FALSE(decoder.isValid());
+
+  std::vector<int8_t> map(12, -1);
+  map[5] = 100;
+  ASSERT_TRUE(decoder.update(makeUpdate(1, true, 0, 0, 4, 3, map)));
+  EXPECT_EQ(map, decoder.getGrid().data);
+
+  // cell (1, 1) is cleared and (2, 1) becomes lethal
+  std::vector<int8_t> delta(2);
+  delta[0] = 100 ^ 0;
+  delta[1] = -1 ^ 100;
+  ASSERT_TRUE(decoder.update(makeUpdate(2, false, 1, 1, 2, 1, delta)));
+  map[5] = 0;
+  map[6] = 100;
+  EXPECT_EQ(map, decoder.getGrid().data);
+
+  // a missed frame invalidates the map until the next keyframe
+  EXPECT_FALSE(decoder.update(makeUpdate(4, false, 1, 1, 2, 1, delta)));
+  EXPECT_FALSE(decoder.isValid());
+  ASSERT_TRUE(decoder.update(makeUpdate(5, true, 0, 0, 4, 3, map)));
+  EXPECT_TRUE(decoder.isValid());
+}
+
+TEST(grid_compression, column_runs)
+{
+  // two words per column, the middle run covers a row boundary
+  uint32_t words[] = {1, 2, 1, 2, 7, 0, 7, 0, 7, 0, 1, 2};
+  std::vector<uint32_t> encoded;
+  encodeColumnRuns(words, 6, 2, encoded);
+  ASSERT_EQ(9u, encoded.size());
+  EXPECT_EQ(2u, encoded[0]);
+  EXPECT_EQ(3u, encoded[3]);
+
+  std::vector<uint32_t> decoded(12);
+  ASSERT_TRUE(decodeColumnRuns(encoded, 2, &decoded[0], 6));
+  EXPECT_EQ(std::vector<uint32_t>(words, words + 12), decoded);
+
+  // too many or too few columns, and truncated runs are rejected
+  EXPECT_FALSE(decodeColumnRuns(encoded, 2, &decoded[0], 5));
+  EXPECT_FALSE(decodeColumnRuns(std::vector<uint32_t>(encoded.begin(), encoded.begin() + 6), 2, &decoded[0], 6));
+  encoded.pop_back();
+  EXPECT_FALSE(decodeColumnRuns(encoded, 2, &decoded[0], 6));
+}
+
+static VoxelGridUpdate makeVoxelUpdate(uint32_t frame, bool keyframe, uint32_t x, uint32_t y, uint32_t width,
+                                       uint32_t height, const std::vector<uint32_t>& columns)
+{
+  VoxelGridUpdate update;
+  update.frame = frame;
+  update.keyframe = keyframe;
+  update.size_x = 4;
+  update.size_y = 3;
+  update.size_z = 10;
+  update.x = x;
+  update.y = y;
+  update.width = width;
+  update.height = height;
+  encodeColumnRuns(&columns[0], columns.size(), 1, update.data);
+  return update;
+}
+
+TEST(grid_compression, voxel_decoder)
+{
+  VoxelGridDecoder decoder;
+  EXPECT_FALSE(decoder.update(makeVoxelUpdate(0, false, 0, 0, 1, 1, std::vector<uint32_t>(1, 0))));
+
+  std::vector<uint32_t> grid(12, 0xffff0000);
+  grid[5] = 0xfffe0001;
+  ASSERT_TRUE(decoder.update(makeVoxelUpdate(1, true, 0, 0, 4, 3, grid)));
+  EXPECT_EQ(grid, decoder.getGrid().data);
+  EXPECT_EQ(4u, decoder.getGrid().size_x);
+
+  // column (1, 1) is cleared, (2, 1) gets a mark
+  std::vector<uint32_t> delta(2);
+  delta[0] = 0xfffe0001 ^ 0xfffe0000;
+  delta[1] = 0xffff0000 ^ 0xfffd0002;
+  ASSERT_TRUE(decoder.update(makeVoxelUpdate(2, false, 1, 1, 2, 1, delta)));
+  grid[5] = 0xfffe0000;
+  grid[6] = 0xfffd0002;
+  EXPECT_EQ(grid, decoder.getGrid().data);
+
+  // a missed frame or a region outside the grid invalidates it until the next keyframe
+  EXPECT_FALSE(decoder.update(makeVoxelUpdate(4, false, 1, 1, 2, 1, delta)));
+  EXPECT_FALSE(decoder.isValid());
+  ASSERT_TRUE(decoder.update(makeVoxelUpdate(5, true, 0, 0, 4, 3, grid)));
+  EXPECT_FALSE(decoder.update(makeVoxelUpdate(6, false, 3, 1, 2, 1, delta)));
+}
+
+static void expectShiftMatchesVoxelGrid(unsigned int size_z, int cell_ox, int cell_oy)
+{
+  voxel_grid::VoxelGrid grid(5, 4, size_z);
+  for (unsigned int j = 0; j < 4; ++j)
+    for (unsigned int i = 0; i < 5; ++i)
+      if ((i + 2 * j) % 3 != 0)
+        grid.markVoxel(i, j, (i + j) % size_z);
+  std::vector<uint32_t> words(grid.dataWords());
+  grid.copyData(&words[0]);
+
+  grid.shift(cell_ox, cell_oy);
+  std::vector<uint32_t> expected(grid.dataWords());
+  grid.copyData(&expected[0]);
+
+  shiftVoxelColumns(words, 5, 4, grid.dataWords() / 20, cell_ox, cell_oy);
+  EXPECT_EQ(expected, words) << "size_z " << size_z << " shift " << cell_ox << ", " << cell_oy;
+}
+
+TEST(grid_compression, shift_voxel_columns)
+{
+  const int shifts[7][2] = { { 0, 0 }, { 1, 0 }, { -2, 1 }, { 3, -3 }, { 0, 2 }, { 5, 0 }, { -1, -7 } };
+  for (unsigned int k = 0; k < 7; ++k)
+  {
+    expectShiftMatchesVoxelGrid(10, shifts[k][0], shifts[k][1]);
+    expectShiftMatchesVoxelGrid(20, shifts[k][0], shifts[k][1]);
+  }
+}
+
+TEST(grid_compression, voxel_decoder_follows_origin)
+{
+  VoxelGridDecoder decoder;
+  std::vector<uint32_t> grid(12, 0xffff0000);
+  grid[5] = 0xfffe0001;
+  grid[10] = 0xfffb0004;
+  VoxelGridUpdate keyframe = makeVoxelUpdate(0, true, 0, 0, 4, 3, grid);
+  keyframe.resolutions.x = keyframe.resolutions.y = 0.5;
+  ASSERT_TRUE(decoder.update(keyframe));
+
+  // the grid moves by one column to the right and one row up, (1, 0) gets a mark
+  std::vector<uint32_t> delta(1, 0xffff0000 ^ 0xfffd0002);
+  VoxelGridUpdate moved = makeVoxelUpdate(1, false, 1, 0, 1, 1, delta);
+  moved.resolutions = keyframe.resolutions;
+  moved.origin.x = 0.5;
+  moved.origin.y = 0.5;
+  ASSERT_TRUE(decoder.update(moved));
+
+  std::vector<uint32_t> expected(grid);
+  shiftVoxelColumns(expected, 4, 3, 1, 1, 1);
+  EXPECT_EQ(0xfffb0004, expected[5]);
+  EXPECT_EQ(voxel_grid::ColumnTraits<uint32_t>::unknownColumn(), expected[11]);
+  expected[1] = 0xfffd0002;
+  EXPECT_EQ(expected, decoder.getGrid().data);
+
+  // an origin that is not a whole number of cells away can not be followed
+  moved = makeVoxelUpdate(2, false, 1, 0, 1, 1, delta);
+  moved.resolutions = keyframe.resolutions;
+  moved.origin.x = 0.75;
+  EXPECT_FALSE(decoder.update(moved));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
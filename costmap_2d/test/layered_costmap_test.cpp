@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <gtest/gtest.h>
+#include <costmap_2d/cost_values.h>
+#include <costmap_2d/layer.h>
+#include <costmap_2d/layered_costmap.h>
+
+using namespace costmap_2d;
+
+// Gives every cell of the costmap the same cost, but marks all of it dirty only on the first update
+class UniformLayer : public Layer
+{
+public:
+  explicit UniformLayer(unsigned char cost) : cost_(cost), first_(true) {}
+
+  virtual void updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y,
+                            double* max_x, double* max_y)
+  {
+    if (!first_)
+      return;
+    first_ = false;
+    *min_x = *min_y = -1e30;
+    *max_x = *max_y = 1e30;
+  }
+
+  virtual void updateCosts(Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j)
+  {
+    for (int j = min_j; j < max_j; ++j)
+      for (int i = min_i; i < max_i; ++i)
+        master_grid.setCost(i, j, cost_);
+  }
+
+private:
+  unsigned char cost_;
+  bool first_;
+};
+
+// Knows the free space left of free_below and right of free_above and one lethal point, everything else stays
+// unknown
+class SparseLayer : public Layer
+{
+public:
+  SparseLayer(double free_below, double free_above, double obstacle_x, double obstacle_y) :
+      free_below_(free_below), free_above_(free_above), obstacle_x_(obstacle_x), obstacle_y_(obstacle_y) {}
+
+  virtual void updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y,
+                            double* max_x, double* max_y)
+  {
+    Costmap2D* costmap = layered_costmap_->getCostmap();
+    *min_x = std::min(*min_x, costmap->getOriginX());
+    *min_y = std::min(*min_y, costmap->getOriginY());
+    *max_x = std::max(*max_x, costmap->getOriginX() + costmap->getSizeInMetersX());
+    *max_y = std::max(*max_y, costmap->getOriginY() + costmap->getSizeInMetersY());
+  }
+
+  virtual void updateCosts(Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j)
+  {
+    double wx, wy;
+    for (int j = min_j; j < max_j; ++j)
+    {
+      for (int i = min_i; i < max_i; ++i)
+      {
+        master_grid.mapToWorld(i, j, wx, wy);
+        if (wx < free_below_ || wx > free_above_)
+          master_grid.setCost(i, j, FREE_SPACE);
+      }
+    }
+    unsigned int mx, my;
+    if (master_grid.worldToMap(obstacle_x_, obstacle_y_, mx, my))
+      master_grid.setCost(mx, my, LETHAL_OBSTACLE);
+  }
+
+private:
+  double free_below_, free_above_, obstacle_x_, obstacle_y_;
+};
+
+// A 10m costmap at 0.5m with a rolling 2m window at 0.05m over it
+class InnerCostmapTest : public testing::Test
+{
+protected:
+  InnerCostmapTest() : outer_("map", false, true), inner_("map", true, true)
+  {
+    outer_.resizeMap(20, 20, 0.5, 0.0, 0.0);
+    inner_.resizeMap(40, 40, 0.05, 0.0, 0.0);
+    addLayer(outer_, new UniformLayer(100));
+    addLayer(inner_, new SparseLayer(5.0, 8.0, 5.32, 5.32));
+    outer_.setInnerCostmap(&inner_);
+  }
+
+  static void addLayer(LayeredCostmap& costmap, Layer* layer)
+  {
+    boost::shared_ptr<Layer> plugin(layer);
+    costmap.addPlugin(plugin);
+    plugin->initialize(&costmap, "test", NULL);
+  }
+
+  unsigned char outerCost(double wx, double wy)
+  {
+    unsigned int mx, my;
+    EXPECT_TRUE(outer_.getCostmap()->worldToMap(wx, wy, mx, my));
+    return outer_.getCostmap()->getCost(mx, my);
+  }
+
+  LayeredCostmap outer_, inner_;
+};
+
+TEST_F(InnerCostmapTest, pools_fine_obstacles_and_keeps_unknown_cells)
+{
+  // the window spans [4.1, 6.1)
+  outer_.updateMap(5.1, 5.1, 0.0);
+  ASSERT_TRUE(inner_.isInitialized());
+
+  // a single fine obstacle makes its whole coarse cell lethal
+  EXPECT_EQ(LETHAL_OBSTACLE, outerCost(5.1, 5.1));
+  // fine free space makes the coarse cell free
+  EXPECT_EQ(FREE_SPACE, outerCost(4.6, 4.6));
+  // where the inner costmap knows nothing the coarse cost stays
+  EXPECT_EQ(100, outerCost(5.75, 4.25));
+  // and outside of the window
+  EXPECT_EQ(100, outerCost(2.0, 2.0));
+
+  // the composite has the fine cost where it is known, else the coarse one
+  EXPECT_EQ(LETHAL_OBSTACLE, outer_.getCompositeCost(5.32, 5.32));
+  EXPECT_EQ(FREE_SPACE, outer_.getCompositeCost(4.6, 5.3));
+  EXPECT_EQ(LETHAL_OBSTACLE, outer_.getCompositeCost(5.1, 5.1));
+  EXPECT_EQ(100, outer_.getCompositeCost(5.75, 4.25));
+  EXPECT_EQ(100, outer_.getCompositeCost(2.0, 2.0));
+  EXPECT_EQ(NO_INFORMATION, outer_.getCompositeCost(-1.0, 2.0));
+}
+
+TEST_F(InnerCostmapTest, restores_pooled_cells_when_the_window_moves)
+{
+  outer_.updateMap(5.1, 5.1, 0.0);
+  ASSERT_EQ(LETHAL_OBSTACLE, outerCost(5.1, 5.1));
+  ASSERT_EQ(FREE_SPACE, outerCost(4.6, 4.6));
+
+  // the window moves to [7.1, 9.1), the outer layer does not mark anything dirty itself
+  outer_.updateMap(8.1, 8.1, 0.0);
+  EXPECT_EQ(100, outerCost(5.1, 5.1));
+  EXPECT_EQ(100, outerCost(4.6, 4.6));
+  EXPECT_EQ(100, outer_.getCompositeCost(5.32, 5.32));
+  EXPECT_EQ(FREE_SPACE, outerCost(8.75, 8.25));
+  EXPECT_EQ(100, outerCost(7.75, 8.25));
+
+  // detached, the next update restores the cells of the last window too
+  outer_.setInnerCostmap(NULL);
+  outer_.updateMap(8.1, 8.1, 0.0);
+  EXPECT_EQ(100, outerCost(8.75, 8.25));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
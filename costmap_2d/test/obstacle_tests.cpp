@@ -147,6 +147,50 @@ TEST(costmap, testRaytracing2){
   ASSERT_EQ(79, countValues(*(layers.getCostmap()), costmap_2d::FREE_SPACE));
 }
 
+/**
+ * Test for clearing past the raytrace range on request
+ */
+TEST(costmap, testFullRangeClearing){
+  tf::TransformListener tf;
+  LayeredCostmap layers("frame", false, false);
+  addStaticLayer(layers, tf);
+  ObstacleLayer* olayer = addObstacleLayer(layers, tf);
+  layers.updateMap(0, 0, 0);
+
+  for(int i = 0; i < olayer->getSizeInCellsY(); ++i)
+  {
+    olayer->setCost(i, i, LETHAL_OBSTACLE);
+  }
+
+  // A clearing observation along the diagonal that only reaches 2 meters
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  cloud.points.resize(1);
+  cloud.points[0].x = 9.5;
+  cloud.points[0].y = 9.5;
+  cloud.points[0].z = MAX_Z/2;
+  geometry_msgs::Point p;
+  p.x = 0.5;
+  p.y = 0.5;
+  p.z = MAX_Z/2;
+  Observation obs(p, cloud, 100.0, 2.0);
+  olayer->addStaticObservation(obs, false, true);
+
+  // Only <0,0> and <1,1> are within range
+  layers.updateMap(0, 0, 0);
+  ASSERT_EQ(8, countValues(*olayer, LETHAL_OBSTACLE));
+
+  // A requested clearing traces the whole ray, once
+  ASSERT_TRUE(olayer->requestFullRangeClearing());
+  ASSERT_TRUE(olayer->isFullRangeClearingPending());
+  layers.updateMap(0, 0, 0);
+  ASSERT_FALSE(olayer->isFullRangeClearingPending());
+  ASSERT_EQ(0, countValues(*olayer, LETHAL_OBSTACLE));
+
+  olayer->setCost(5, 5, LETHAL_OBSTACLE);
+  layers.updateMap(0, 0, 0);
+  ASSERT_EQ(1, countValues(*olayer, LETHAL_OBSTACLE));
+}
+
 /**
  * Test for wave interference
  */
@@ -244,6 +288,93 @@ TEST(costmap, testMultipleAdditions){
 
 }
 
+/**
+ * Verify that merging the layers band by band gives the same costs as merging each over the whole window
+ */
+TEST(costmap, testTiledUpdate){
+  tf::TransformListener tf;
+  LayeredCostmap layers("frame", false, false);
+  addStaticLayer(layers, tf);
+  ObstacleLayer* olayer = addObstacleLayer(layers, tf);
+  addInflationLayer(layers, tf);
+
+  LayeredCostmap tiled("frame", false, false);
+  tiled.setTileCells(25);
+  addStaticLayer(tiled, tf);
+  ObstacleLayer* tiled_olayer = addObstacleLayer(tiled, tf);
+  addInflationLayer(tiled, tf);
+
+  addObservation(olayer, 4.0, 5.0);
+  addObservation(olayer, 7.0, 2.0);
+  addObservation(tiled_olayer, 4.0, 5.0);
+  addObservation(tiled_olayer, 7.0, 2.0);
+  layers.updateMap(0,0,0);
+  tiled.updateMap(0,0,0);
+
+  Costmap2D* costmap = layers.getCostmap();
+  Costmap2D* tiled_costmap = tiled.getCostmap();
+  for (unsigned int j = 0; j < costmap->getSizeInCellsY(); j++)
+    for (unsigned int i = 0; i < costmap->getSizeInCellsX(); i++)
+      ASSERT_EQ(costmap->getCost(i, j), tiled_costmap->getCost(i, j));
+}
+
+/**
+ * Test that only the cells that turn into obstacles are reported as new
+ */
+TEST(costmap, testNewObstacles){
+  tf::TransformListener tf;
+  LayeredCostmap layers("frame", false, false);
+  addStaticLayer(layers, tf);
+  ObstacleLayer* olayer = addObstacleLayer(layers, tf);
+
+  addObservation(olayer, 4.0, 5.0);
+  addObservation(olayer, 7.0, 2.0);
+  layers.updateMap(0,0,0);
+  ASSERT_EQ(2u, layers.takeNewObstacles());
+  ASSERT_EQ(0u, layers.takeNewObstacles());
+
+  // an obstacle seen again is not new
+  addObservation(olayer, 4.0, 5.0);
+  layers.updateMap(0,0,0);
+  ASSERT_EQ(0u, layers.takeNewObstacles());
+}
+
+/**
+ * Test that the costs of updates with suspended costs are computed once they are resumed
+ */
+TEST(costmap, testSuspendedCosts){
+  tf::TransformListener tf;
+  LayeredCostmap layers("frame", false, false);
+  addStaticLayer(layers, tf);
+  ObstacleLayer* olayer = addObstacleLayer(layers, tf);
+  addInflationLayer(layers, tf);
+
+  LayeredCostmap suspended("frame", false, false);
+  addStaticLayer(suspended, tf);
+  ObstacleLayer* suspended_olayer = addObstacleLayer(suspended, tf);
+  addInflationLayer(suspended, tf);
+
+  addObservation(olayer, 4.0, 5.0);
+  layers.updateMap(0,0,0);
+
+  addObservation(suspended_olayer, 4.0, 5.0);
+  suspended.setCostsSuspended(true);
+  suspended.updateMap(0,0,0);
+  unsigned int mx, my;
+  ASSERT_TRUE(suspended.getCostmap()->worldToMap(4.0, 5.0, mx, my));
+  ASSERT_NE(LETHAL_OBSTACLE, suspended.getCostmap()->getCost(mx, my));
+
+  // the update after resuming reports no bounds of its own
+  suspended_olayer->clearStaticObservations(true, true);
+  suspended.setCostsSuspended(false);
+  suspended.updateMap(0,0,0);
+
+  Costmap2D* costmap = layers.getCostmap();
+  Costmap2D* suspended_costmap = suspended.getCostmap();
+  for (unsigned int j = 0; j < costmap->getSizeInCellsY(); j++)
+    for (unsigned int i = 0; i < costmap->getSizeInCellsX(); i++)
+      ASSERT_EQ(costmap->getCost(i, j), suspended_costmap->getCost(i, j));
+}
 
 int main(int argc, char** argv){
   ros::init(argc, argv, "obstacle_tests");
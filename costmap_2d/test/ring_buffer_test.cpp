@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <gtest/gtest.h>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <costmap_2d/ring_buffer.h>
+
+using namespace costmap_2d;
+
+TEST(ring_buffer, keeps_the_order)
+{
+  RingBuffer<int> buffer(3);
+  EXPECT_TRUE(buffer.push(1));
+  EXPECT_TRUE(buffer.push(2));
+  EXPECT_EQ(2u, buffer.size());
+
+  int value = 0;
+  ASSERT_TRUE(buffer.pop(value));
+  EXPECT_EQ(1, value);
+  EXPECT_TRUE(buffer.push(3));
+  EXPECT_TRUE(buffer.push(4));
+  ASSERT_TRUE(buffer.pop(value));
+  EXPECT_EQ(2, value);
+  ASSERT_TRUE(buffer.pop(value));
+  EXPECT_EQ(3, value);
+  ASSERT_TRUE(buffer.pop(value));
+  EXPECT_EQ(4, value);
+  EXPECT_FALSE(buffer.pop(value));
+  EXPECT_EQ(0u, buffer.dropped());
+}
+
+TEST(ring_buffer, drops_the_oldest_when_full)
+{
+  RingBuffer<int> buffer(2);
+  buffer.push(1);
+  buffer.push(2);
+  EXPECT_FALSE(buffer.push(3));
+  EXPECT_FALSE(buffer.push(4));
+  EXPECT_EQ(2u, buffer.size());
+  EXPECT_EQ(2u, buffer.dropped());
+
+  int value = 0;
+  ASSERT_TRUE(buffer.pop(value));
+  EXPECT_EQ(3, value);
+  ASSERT_TRUE(buffer.pop(value));
+  EXPECT_EQ(4, value);
+}
+
+TEST(ring_buffer, zero_capacity_keeps_the_latest)
+{
+  RingBuffer<int> buffer(0);
+  EXPECT_EQ(1u, buffer.capacity());
+  buffer.push(1);
+  buffer.push(2);
+
+  int value = 0;
+  ASSERT_TRUE(buffer.pop(value));
+  EXPECT_EQ(2, value);
+  EXPECT_FALSE(buffer.pop(value, 10));
+}
+
+TEST(ring_buffer, hands_entries_out_whole)
+{
+  // the entries are swapped out, the buffer must not keep a part of them
+  RingBuffer<std::vector<float> > buffer(2);
+  buffer.push(std::vector<float>(640, 1.0f));
+
+  std::vector<float> image(10, 0.0f);
+  ASSERT_TRUE(buffer.pop(image));
+  EXPECT_EQ(std::vector<float>(640, 1.0f), image);
+  EXPECT_FALSE(buffer.pop(image));
+  EXPECT_EQ(640u, image.size());
+}
+
+TEST(ring_buffer, reset_changes_the_capacity)
+{
+  RingBuffer<int> buffer(1);
+  buffer.push(1);
+  buffer.reset(3);
+  EXPECT_EQ(3u, buffer.capacity());
+  EXPECT_EQ(0u, buffer.size());
+  EXPECT_TRUE(buffer.push(2));
+  EXPECT_TRUE(buffer.push(3));
+  EXPECT_TRUE(buffer.push(4));
+  EXPECT_FALSE(buffer.push(5));
+
+  int value = 0;
+  ASSERT_TRUE(buffer.pop(value));
+  EXPECT_EQ(3, value);
+}
+
+static void produce(RingBuffer<int>* buffer, int count)
+{
+  for (int i = 0; i < count; ++i)
+    buffer->push(i);
+}
+
+TEST(ring_buffer, waits_for_the_producer)
+{
+  RingBuffer<int> buffer(4);
+  const int count = 10000;
+  boost::thread producer(boost::bind(produce, &buffer, count));
+
+  // every entry taken is newer than the previous one, and the ones skipped were dropped
+  int last = -1, taken = 0, value = 0;
+  while (last < count - 1 && buffer.pop(value, 1000))
+  {
+    EXPECT_GT(value, last);
+    last = value;
+    ++taken;
+  }
+  producer.join();
+  EXPECT_EQ(count - 1, last);
+  EXPECT_EQ(count, taken + (int)buffer.dropped());
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <gtest/gtest.h>
+#include <costmap_2d/cost_values.h>
+#include <costmap_2d/static_map_cache.h>
+#include <cstdlib>
+
+using namespace costmap_2d;
+
+// a 2m map at 0.05m, free but for a wall one cell thin
+static StaticGrid wallGrid(unsigned int wall_x)
+{
+  StaticGrid grid;
+  grid.size_x = grid.size_y = 40;
+  grid.resolution = 0.05;
+  grid.costs.assign(40 * 40, FREE_SPACE);
+  for (unsigned int y = 0; y < 40; ++y)
+    grid.costs[y * 40 + wall_x] = LETHAL_OBSTACLE;
+  return grid;
+}
+
+TEST(static_map_cache, pooled_cost_keeps_a_thin_wall)
+{
+  // every wall position falls between the centers of the 0.2m cells at some point
+  for (unsigned int wall_x = 0; wall_x < 40; ++wall_x)
+  {
+    StaticGrid grid = wallGrid(wall_x);
+    for (unsigned int i = 0; i < 10; ++i)
+    {
+      double wx = (i + 0.5) * 0.2;
+      // a neighbor may take the wall too where the cells share an edge, which only errs on the safe side
+      int distance = std::abs((int)(wall_x / 4) - (int)i);
+      if (distance == 0)
+        EXPECT_EQ(LETHAL_OBSTACLE, grid.pooledCost(wx, 1.0, 0.1)) << "wall " << wall_x << ", cell " << i;
+      else if (distance > 1)
+        EXPECT_EQ(FREE_SPACE, grid.pooledCost(wx, 1.0, 0.1)) << "wall " << wall_x << ", cell " << i;
+    }
+  }
+
+  // sampling the center of the cell alone misses it
+  StaticGrid grid = wallGrid(17);
+  unsigned int mx, my;
+  ASSERT_TRUE(grid.worldToMap(0.9, 1.0, mx, my));
+  EXPECT_EQ(FREE_SPACE, grid.costs[my * grid.size_x + mx]);
+  EXPECT_EQ(LETHAL_OBSTACLE, grid.pooledCost(0.9, 1.0, 0.1));
+}
+
+TEST(static_map_cache, pooled_cost_ignores_unknown_cells)
+{
+  StaticGrid grid = wallGrid(17);
+  for (unsigned int y = 0; y < 40; ++y)
+    for (unsigned int x = 0; x < 8; ++x)
+      grid.costs[y * 40 + x] = NO_INFORMATION;
+  grid.costs[20 * 40 + 5] = 100;
+
+  // only unknown cells
+  EXPECT_EQ(NO_INFORMATION, grid.pooledCost(0.1, 0.3, 0.1));
+  // an unknown cell does not hide a known one
+  EXPECT_EQ(100, grid.pooledCost(0.3, 1.0, 0.1));
+  // partly outside of the map
+  EXPECT_EQ(FREE_SPACE, grid.pooledCost(1.95, 1.95, 0.1));
+  EXPECT_EQ(NO_INFORMATION, grid.pooledCost(-1.0, 1.0, 0.1));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef COSTMAP_2D_TEST_SYNTHETIC_DEPTH_H_
+#define COSTMAP_2D_TEST_SYNTHETIC_DEPTH_H_
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+struct RayPoint
+{
+  double x, y, z;
+};
+
+/** @brief A pinhole camera that looks along y with z up, like the floor frame */
+struct ForwardCamera
+{
+  ForwardCamera(int width, int height, double focal_length) :
+      cx(width / 2.0), cy(height / 2.0), f(focal_length)
+  {
+  }
+
+  RayPoint project2Dto3D(int x, int y) const
+  {
+    RayPoint ray = { (x - cx) / f, 1.0, (cy - y) / f };
+    return ray;
+  }
+
+  double cx, cy, f;
+};
+
+/** @brief A camera pose relative to the floor frame, pitched down around x */
+struct CameraPose
+{
+  CameraPose(double height, double pitch)
+  {
+    double r[9] = { 1, 0, 0, 0, std::cos(pitch), std::sin(pitch), 0, -std::sin(pitch), std::cos(pitch) };
+    std::copy(r, r + 9, rotation);
+    translation[0] = translation[1] = 0;
+    translation[2] = height;
+  }
+
+  RayPoint transform(const RayPoint& p) const
+  {
+    const double* r = rotation;
+    RayPoint q = { r[0] * p.x + r[1] * p.y + r[2] * p.z + translation[0],
+                   r[3] * p.x + r[4] * p.y + r[5] * p.z + translation[1],
+                   r[6] * p.x + r[7] * p.y + r[8] * p.z + translation[2] };
+    return q;
+  }
+
+  double rotation[9], translation[3];
+};
+
+/**
+ * @brief  Render the depth image of a floor with a wall across it at wall_distance
+ *
+ * Every seventh pixel of the top half has no depth.
+ */
+inline std::vector<float> renderWall(const ForwardCamera& camera, const CameraPose& pose, int width, int height,
+                                     double wall_distance)
+{
+  std::vector<float> depth(width * height);
+  for (int y = 0; y < height; ++y)
+  {
+    for (int x = 0; x < width; ++x)
+    {
+      RayPoint ray = camera.project2Dto3D(x, y);
+      RayPoint end = pose.transform(ray);
+      double dy = end.y - pose.translation[1], dz = end.z - pose.translation[2];
+      double d = std::numeric_limits<double>::quiet_NaN();
+      if (dy > 0)
+        d = wall_distance / dy;
+      if (dz < 0 && !(pose.translation[2] / -dz > d))
+        d = pose.translation[2] / -dz;
+      if (y < height / 2 && (x + y) % 7 == 0)
+        d = std::numeric_limits<double>::quiet_NaN();
+      depth[y * width + x] = d;
+    }
+  }
+  return depth;
+}
+
+/**
+ * @brief  The classification of Depth3DIntegrator before it used DepthSlopeKernel, in double precision
+ * @return False if the column has no obstacle
+ */
+inline bool referenceClosest(const std::vector<float>& depth, const ForwardCamera& camera, const CameraPose& pose,
+                             int width, int height, int x, int window, double threshold, double closest[3])
+{
+  std::vector<RayPoint> p(height);
+  std::vector<double> sy(height, 0), sz(height, 0), syz(height, 0), syy(height, 0);
+  closest[1] = 1e6;
+  for (int y = 1; y < height; ++y)
+  {
+    float d = depth[y * width + x];
+    sy[y] = sy[y - 1];
+    sz[y] = sz[y - 1];
+    syz[y] = syz[y - 1];
+    syy[y] = syy[y - 1];
+    if (d == 0 || d != d)
+      continue;
+
+    RayPoint ray = camera.project2Dto3D(x, y);
+    RayPoint ray_d = { ray.x * d, ray.y * d, ray.z * d };
+    p[y] = pose.transform(ray_d);
+    if (p[y].z > 0.2 && p[y].y < closest[1])
+    {
+      closest[0] = p[y].x;
+      closest[1] = p[y].y;
+      closest[2] = p[y].z;
+    }
+    sy[y] += p[y].y;
+    sz[y] += p[y].z;
+    syz[y] += p[y].y * p[y].z;
+    syy[y] += p[y].y * p[y].y;
+  }
+
+  for (int y = window; y < height - window; ++y)
+  {
+    float d = depth[y * width + x];
+    if (d == 0 || d != d || p[y].z >= 0.2)
+      continue;
+
+    double a = sy[y + window / 2] - sy[y - window / 2];
+    double b = sz[y + window / 2] - sz[y - window / 2];
+    double ab = syz[y + window / 2] - syz[y - window / 2];
+    double aa = syy[y + window / 2] - syy[y - window / 2];
+    double slope = (window * ab - a * b) / (window * aa - a * a);
+    if (std::abs(slope) > threshold && p[y].y < closest[1])
+    {
+      closest[0] = p[y].x;
+      closest[1] = p[y].y;
+      closest[2] = p[y].z;
+    }
+  }
+  return closest[1] < 1e6;
+}
+
+#endif  // COSTMAP_2D_TEST_SYNTHETIC_DEPTH_H_
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <costmap_2d/costmap_2d.h>
+#include <sys/time.h>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using costmap_2d::Costmap2D;
+
+static double seconds()
+{
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + t.tv_usec / 1e6;
+}
+
+// Compares the conversions of world points to cells, over points spread over the map and somewhat beyond
+int main(int argc, char** argv)
+{
+  const unsigned int n = 1 << 16, repetitions = 200;
+  Costmap2D grid(2000, 2000, 0.05, -50.0, -50.0);
+  std::vector<double> wx(n), wy(n);
+  srand(1);
+  for (unsigned int k = 0; k < n; ++k)
+  {
+    wx[k] = -55.0 + 110.0 * rand() / RAND_MAX;
+    wy[k] = -55.0 + 110.0 * rand() / RAND_MAX;
+  }
+  std::vector<int> indices(n), mx(n), my(n);
+  double points = (double)n * repetitions;
+
+  // the sums keep the compiler from dropping the loops
+  long sum = 0;
+  double start = seconds();
+  for (unsigned int r = 0; r < repetitions; ++r)
+  {
+    for (unsigned int k = 0; k < n; ++k)
+    {
+      unsigned int x, y;
+      sum += grid.worldToMap(wx[k], wy[k], x, y) ? grid.getIndex(x, y) : -1;
+    }
+  }
+  double t = seconds() - start;
+  printf("worldToMap:             %.2f ns per point (%ld)\n", t / points * 1e9, sum);
+
+  sum = 0;
+  start = seconds();
+  for (unsigned int r = 0; r < repetitions; ++r)
+  {
+    for (unsigned int k = 0; k < n; ++k)
+    {
+      unsigned int x, y;
+      sum += grid.worldToMapFast(wx[k], wy[k], x, y) ? grid.getIndex(x, y) : -1;
+    }
+  }
+  t = seconds() - start;
+  printf("worldToMapFast:         %.2f ns per point (%ld)\n", t / points * 1e9, sum);
+
+  sum = 0;
+  start = seconds();
+  for (unsigned int r = 0; r < repetitions; ++r)
+  {
+    grid.worldToIndices(&wx[0], &wy[0], n, &indices[0]);
+    sum += indices[r % n];
+  }
+  t = seconds() - start;
+  printf("worldToIndices:         %.2f ns per point (%ld)\n", t / points * 1e9, sum);
+
+  sum = 0;
+  start = seconds();
+  for (unsigned int r = 0; r < repetitions; ++r)
+  {
+    for (unsigned int k = 0; k < n; ++k)
+    {
+      int x, y;
+      grid.worldToMapNoBounds(wx[k], wy[k], x, y);
+      sum += x + y;
+    }
+  }
+  t = seconds() - start;
+  printf("worldToMapNoBounds:     %.2f ns per point (%ld)\n", t / points * 1e9, sum);
+
+  sum = 0;
+  start = seconds();
+  for (unsigned int r = 0; r < repetitions; ++r)
+  {
+    grid.worldToMapNoBounds(&wx[0], &wy[0], n, &mx[0], &my[0]);
+    sum += mx[r % n] + my[r % n];
+  }
+  t = seconds() - start;
+  printf("worldToMapNoBounds (n): %.2f ns per point (%ld)\n", t / points * 1e9, sum);
+  return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <gtest/gtest.h>
+#include <costmap_2d/costmap_2d.h>
+#include <cstdlib>
+#include <vector>
+
+using costmap_2d::Costmap2D;
+
+TEST(world_to_map, fast_matches_division)
+{
+  Costmap2D grid(200, 150, 0.05, -3.2, 1.7);
+  srand(42);
+  for (int k = 0; k < 10000; ++k)
+  {
+    // away from the cell borders both give the same cell
+    int cx = rand() % 240 - 20, cy = rand() % 190 - 20;
+    double fx = 0.01 + 0.98 * rand() / RAND_MAX, fy = 0.01 + 0.98 * rand() / RAND_MAX;
+    double wx = -3.2 + (cx + fx) * 0.05, wy = 1.7 + (cy + fy) * 0.05;
+
+    unsigned int mx, my, fast_mx, fast_my;
+    bool inside = grid.worldToMap(wx, wy, mx, my);
+    ASSERT_EQ(inside, grid.worldToMapFast(wx, wy, fast_mx, fast_my));
+    if (inside)
+    {
+      EXPECT_EQ(mx, fast_mx);
+      EXPECT_EQ(my, fast_my);
+    }
+
+    int nx, ny, fast_nx, fast_ny;
+    grid.worldToMapNoBounds(wx, wy, nx, ny);
+    grid.worldToMapNoBoundsFast(wx, wy, fast_nx, fast_ny);
+    EXPECT_EQ(nx, fast_nx);
+    EXPECT_EQ(ny, fast_ny);
+  }
+}
+
+TEST(world_to_map, batch)
+{
+  Costmap2D grid(100, 80, 0.1, 1.0, -2.0);
+  const double wx[] = {1.05, 10.95, 0.99, 5.0, 11.0, 3.33};
+  const double wy[] = {-1.95, 5.95, 0.0, -2.01, 0.0, 1.27};
+  const unsigned int n = 6;
+
+  std::vector<int> indices(n);
+  EXPECT_EQ(3u, grid.worldToIndices(wx, wy, n, &indices[0]));
+  for (unsigned int k = 0; k < n; ++k)
+  {
+    unsigned int mx, my;
+    if (grid.worldToMapFast(wx[k], wy[k], mx, my))
+      EXPECT_EQ(int(grid.getIndex(mx, my)), indices[k]);
+    else
+      EXPECT_EQ(-1, indices[k]);
+  }
+
+  std::vector<int> mx(n), my(n);
+  grid.worldToMapNoBounds(wx, wy, n, &mx[0], &my[0]);
+  for (unsigned int k = 0; k < n; ++k)
+  {
+    int x, y;
+    grid.worldToMapNoBoundsFast(wx[k], wy[k], x, y);
+    EXPECT_EQ(x, mx[k]);
+    EXPECT_EQ(y, my[k]);
+  }
+}
+
+TEST(world_to_map, follows_resize)
+{
+  Costmap2D grid(10, 10, 1.0, 0.0, 0.0);
+  grid.resizeMap(100, 100, 0.1, 0.0, 0.0);
+  unsigned int mx, my;
+  ASSERT_TRUE(grid.worldToMapFast(5.05, 2.55, mx, my));
+  EXPECT_EQ(50u, mx);
+  EXPECT_EQ(25u, my);
+
+  Costmap2D copy;
+  copy = grid;
+  ASSERT_TRUE(copy.worldToMapFast(5.05, 2.55, mx, my));
+  EXPECT_EQ(50u, mx);
+  EXPECT_EQ(25u, my);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -49,11 +49,12 @@
 #include <base_local_planner/trajectory.h>
 #include <base_local_planner/local_planner_limits.h>
 #include <base_local_planner/local_planner_util.h>
-#include <base_local_planner/simple_trajectory_generator.h>
+#include <base_local_planner/coarse_to_fine_trajectory_generator.h>
 
 #include <base_local_planner/oscillation_cost_function.h>
 #include <base_local_planner/map_grid_cost_function.h>
 #include <base_local_planner/obstacle_cost_function.h>
+#include <base_local_planner/distance_field_cost_function.h>
 #include <base_local_planner/occupancy_velocity_cost_function.h>
 #include <base_local_planner/alignment_cost_function.h>
 #include <base_local_planner/cmd_vel_cost_function.h>
@@ -109,6 +110,37 @@ namespace dwa_local_planner {
        */
       base_local_planner::Trajectory findBestPath(tf::Stamped<tf::Pose> robot_pose, tf::Stamped<tf::Pose> robot_vel, tf::Stamped<tf::Pose> goal_pose, std::vector<geometry_msgs::Point> footprint_spec);
 
+      /**
+       * @brief Check whether a command is legal, scored with the cost functions of the last findBestPath
+       * @param pos The current position of the robot
+       * @param vel The current velocity of the robot
+       * @param vel_samples The command to check
+       * @return True if the trajectory of the command has a cost >= 0
+       */
+      bool checkTrajectory(Eigen::Vector3f pos, Eigen::Vector3f vel, Eigen::Vector3f vel_samples);
+
+      /**
+       * @brief Passes the inflation thresholds of the costmap to the obstacle costs, if the inflation fast path is enabled
+       * @param inscribed_cost The lowest cost of cells within the inscribed radius of an obstacle
+       * @param circumscribed_cost The cost below which cells are beyond the circumscribed radius of all obstacles
+       */
+      void setInflationThresholds(unsigned char inscribed_cost, unsigned char circumscribed_cost);
+
+      /**
+       * @brief Drop the cached obstacle scores of trajectories that sweep changed cells of the costmap
+       */
+      void invalidateTrajectoryCache(unsigned int x0, unsigned int xn, unsigned int y0, unsigned int yn);
+
+      /**
+       * @brief Set the time after which findBestPath returns the best trajectory found so far, zero for none
+       *
+       * With a deadline the samples closest to the last command are scored first.
+       */
+      void setDeadline(const ros::WallTime& deadline) {
+        scored_sampling_planner_.setDeadline(deadline);
+        generator_.setPrioritizeSamples(!deadline.isZero());
+      }
+
       inline double getSimPeriod() { return sim_period_; }
       inline double getSimTime() { return sim_time_; }
 
@@ -129,10 +161,20 @@ namespace dwa_local_planner {
       double switch_goal_distance_;
 
       //! Trajectory generation
-      base_local_planner::SimpleTrajectoryGenerator generator_;
+      base_local_planner::CoarseToFineTrajectoryGenerator generator_;
       Eigen::Vector3f vsamples_;
       double sim_period_, sim_time_;
 
+      //! Local search over the command after sampling
+      void refineTrajectory(base_local_planner::Trajectory& traj);
+      bool tryCommand(const Eigen::Vector3f& cmd, Eigen::Vector3f& best_cmd, double& best_cost);
+      int refine_iterations_;
+      bool use_dwa_;
+      bool has_last_cmd_;
+      Eigen::Vector3f last_cmd_;
+      base_local_planner::Trajectory refine_traj_, refine_best_traj_;
+      base_local_planner::Trajectory check_traj_;
+
       //! Cost functions with parameters
       //base_local_planner::ObstacleCostFunction obstacle_costs_; /// <@brief discards trajectories that move into obstacles
       base_local_planner::OccupancyVelocityCostFunction occ_vel_costs_; /// <@brief discards trajectories that on which the velocity is not allowed
@@ -143,6 +185,7 @@ namespace dwa_local_planner {
       double arrive_plan_scale_;
 
       base_local_planner::MapGridCostFunction goal_costs_; /// <@brief prefers trajectories that go towards (local) goal, based on wave propagation
+      std::vector<geometry_msgs::PoseStamped> local_plan_from_lookahead_; /// <@brief the target of goal_costs_, kept to reuse its memory
       double align_goal_scale_;
       double default_goal_scale_;
       double arrive_goal_scale_;
@@ -164,6 +207,10 @@ namespace dwa_local_planner {
       double align_obstacle_scale_;
       double default_obstacle_scale_;
       double arrive_obstacle_scale_;
+      bool inflation_fast_path_;
+
+      base_local_planner::DistanceFieldCostFunction distance_field_costs_; /// <@brief replaces obstacle_costs_ when enabled
+      bool use_distance_field_;
 
       //! Scored sampling planner which evaluates the trajectories generation by the SimpleTrajectoryGenerator with use of costfunctions
       base_local_planner::SimpleScoredSamplingPlanner scored_sampling_planner_;
@@ -92,6 +92,8 @@ namespace dwa_local_planner {
         */
         bool computeVelocityCommands(geometry_msgs::Twist& cmd_vel);
 
+        using nav_core::BaseLocalPlanner::computeVelocityCommands;
+
         /**
         * @brief  Set the plan that the controller is following
         * @param orig_global_plan The plan to pass to the controller
@@ -99,12 +101,34 @@ namespace dwa_local_planner {
         */
         bool setPlan(const std::vector<geometry_msgs::PoseStamped>& orig_global_plan);
 
+        /**
+        * @brief  Set the plan that the controller is following without copying it
+        * @param plan The plan to pass to the controller
+        * @param version The version of the plan, see nav_core::BaseLocalPlanner
+        * @return True if the plan was updated successfully, false otherwise
+        */
+        bool setPlan(const nav_core::PlanConstPtr& plan, unsigned int version);
+
         /**
         * @brief  Check if the goal pose has been achieved
         * @return True if achieved, false otherwise
         */
         bool isGoalReached();
 
+        /**
+        * @brief  Set the time by which the next computeVelocityCommands should return
+        * @param deadline Once it has passed, the best trajectory sampled so far is used
+        */
+        void setControlDeadline(const ros::WallTime& deadline);
+
+        /**
+        * @brief  Cap the speed below the configured limits, taking effect at the next control cycle
+        * @param max_trans_vel The translational speed cap, negative lifts it
+        * @param max_rot_vel The rotational speed cap, negative lifts it
+        * @return True, the caps are always applied
+        */
+        bool setSpeedLimit(double max_trans_vel, double max_rot_vel);
+
     private:
         ///< @brief Callback to update the local planner's parameters based on dynamic reconfigure
         void reconfigureCB(DWAPlannerConfig &config, uint32_t level);
@@ -120,17 +144,31 @@ namespace dwa_local_planner {
         /// Planner utility
         base_local_planner::LocalPlannerUtil planner_util_;
 
+        /// The part of the global plan within the costmap, in the frame of the planner
+        std::vector<geometry_msgs::PoseStamped> local_plan_;
+
         boost::shared_ptr<DWAPlanner> dp_; ///< @brief The DWA Planner
 
         /// Pointer to the environment representation
         costmap_2d::Costmap2DROS* costmap_ros_;
 
+        /// The copy of the costmap the planner works on in this cycle, if use_costmap_snapshot_
+        costmap_2d::Costmap2D costmap_snapshot_;
+        bool use_costmap_snapshot_;
+
         /// Reconfiguration
         dynamic_reconfigure::Server<DWAPlannerConfig> *dsrv_;
         bool initialized_;
 
         /// To read the odometry
         base_local_planner::OdometryHelperRos odom_helper_;
+
+        /// Stops and turns in place once the goal position is reached, if stop_rotate_at_goal_
+        boost::shared_ptr<base_local_planner::LatchedStopRotateController> latched_stop_rotate_controller_;
+        bool stop_rotate_at_goal_;
+
+        /// Clears the in-place turns of the latched controller with the ring the footprint sweeps
+        boost::shared_ptr<base_local_planner::CostmapModel> swept_model_;
     };
 };
 #endif
@@ -48,6 +48,11 @@ public:
      */
     void publishTrajectoryCloud(const std::vector<base_local_planner::Trajectory>& trajectories, const std::string& frame = "/map");   
 
+    /**
+     * @brief  Whether anyone listens to the trajectory cloud, so the explored trajectories need to be kept
+     */
+    bool wantsTrajectoryCloud() const { return traj_cloud_pub_.getNumSubscribers() > 0; }
+
     void publishCostGrid();
     bool getCellCosts(int cx, int cy, float &path_cost, float &goal_cost, float &occ_cost, float &total_cost);
 
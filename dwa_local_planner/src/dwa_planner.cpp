@@ -65,6 +65,10 @@ namespace dwa_local_planner {
         sim_period_ = config.sim_period;
         sim_time_ = config.sim_time;
         generator_.setParameters(config.sim_time, config.sim_granularity, config.angular_sim_granularity, config.use_dwa, config.sim_period);
+        generator_.setRefinement(config.refine_samples);
+        generator_.setCoarseToFine(config.coarse_to_fine_levels, config.coarse_to_fine_top_k, config.coarse_to_fine_samples);
+        refine_iterations_ = config.refine_iterations;
+        use_dwa_ = config.use_dwa;
 
         ROS_INFO_STREAM("Trajectory Generator configured:\n"
                         << "    - Samples [x,y,th] : [" << (int)vsamples_[0] << "," << (int)vsamples_[1] << "," << (int)vsamples_[2] << "]\n"
@@ -153,6 +157,19 @@ namespace dwa_local_planner {
 
         // Sums scores by default
         obstacle_costs_.setSumScores(false);
+        obstacle_costs_.setFootprintMasks(config.footprint_mask_headings);
+        scored_sampling_planner_.setScoringThreads(config.scoring_threads);
+        scored_sampling_planner_.setExploredSummary(config.trajectory_cloud_endpoints, config.trajectory_cloud_stride);
+        plan_costs_.setIncremental(config.incremental_distance_fields);
+        goal_costs_.setIncremental(config.incremental_distance_fields);
+        obstacle_costs_.setTrajectoryCache(config.trajectory_cache);
+        inflation_fast_path_ = config.inflation_fast_path;
+        if (!inflation_fast_path_)
+            obstacle_costs_.setInflationThresholds(0, 0);
+        use_distance_field_ = config.obstacle_distance_field;
+        distance_field_costs_.setSumScores(false);
+        distance_field_costs_.setCircles(config.distance_field_circles);
+        distance_field_costs_.setMaxClearance(config.distance_field_max_clearance);
 
         //! Set parameters for occupancy velocity costfunction
         occ_vel_costs_.setParams(config.max_trans_vel);
@@ -164,6 +181,8 @@ namespace dwa_local_planner {
         plan_costs_(planner_util->getCostmap()),
         goal_costs_(planner_util->getCostmap()),
         obstacle_costs_(planner_util->getCostmap()),
+        distance_field_costs_(planner_util->getCostmap()),
+        use_distance_field_(false),
         vis_(planner_util->getCostmap(), goal_costs_, plan_costs_, planner_util->getGlobalFrame())
     {
         // Costfunctions
@@ -174,6 +193,7 @@ namespace dwa_local_planner {
         critics.push_back(&alignment_costs_);
         critics.push_back(&cmd_vel_costs_);
         critics.push_back(&obstacle_costs_);
+        critics.push_back(&distance_field_costs_);
 
         // trajectory generator
         std::vector<base_local_planner::TrajectorySampleGenerator*> generator_list;
@@ -182,6 +202,11 @@ namespace dwa_local_planner {
 
         // Time stamp
         stamp_last_motion_ = ros::Time::now();
+
+        inflation_fast_path_ = false;
+        refine_iterations_ = 0;
+        use_dwa_ = true;
+        has_last_cmd_ = false;
     }
 
     LocalPlannerState DWAPlanner::determineState(tf::Stamped<tf::Pose> robot_pose, double yaw_error, double plan_distance, double goal_distance)
@@ -211,6 +236,17 @@ namespace dwa_local_planner {
         return state;
     }
 
+    void DWAPlanner::setInflationThresholds(unsigned char inscribed_cost, unsigned char circumscribed_cost)
+    {
+        if (inflation_fast_path_)
+            obstacle_costs_.setInflationThresholds(inscribed_cost, circumscribed_cost);
+    }
+
+    void DWAPlanner::invalidateTrajectoryCache(unsigned int x0, unsigned int xn, unsigned int y0, unsigned int yn)
+    {
+        obstacle_costs_.invalidateTrajectoryCache(x0, xn, y0, yn);
+    }
+
     void DWAPlanner::updatePlanAndLocalCosts(tf::Stamped<tf::Pose> robot_pose, const std::vector<geometry_msgs::PoseStamped>& local_plan, double lookahead, const std::vector<geometry_msgs::Point>& footprint_spec)
     {
         /// Determine the errors
@@ -277,15 +313,28 @@ namespace dwa_local_planner {
             break;
         }
 
+        // The distance field takes over the obstacle scale, critics with scale 0 are not evaluated
+        if (use_distance_field_)
+        {
+            distance_field_costs_.setScale(obstacle_costs_.getScale());
+            obstacle_costs_.setScale(0.0);
+        }
+        else
+        {
+            distance_field_costs_.setScale(0.0);
+        }
+
         //! Optimization data (Set local plan)
-        std::vector<geometry_msgs::PoseStamped> local_plan_from_lookahead;
+        std::vector<geometry_msgs::PoseStamped>& local_plan_from_lookahead = local_plan_from_lookahead_;
         base_local_planner::planFromLookahead(local_plan, lookahead, local_plan_from_lookahead);
 
         goal_costs_.setTargetPoses(local_plan_from_lookahead);
         plan_costs_.setTargetPoses(local_plan);
 
-        //! Update footprint if changed
+        //! Update footprint if changed, checkTrajectory may score without a findBestPath
         occ_vel_costs_.setFootprint(footprint_spec);
+        obstacle_costs_.setFootprint(footprint_spec);
+        distance_field_costs_.setFootprint(footprint_spec);
     }
 
     base_local_planner::Trajectory DWAPlanner::findBestPath(tf::Stamped<tf::Pose> robot_pose, tf::Stamped<tf::Pose> robot_vel, tf::Stamped<tf::Pose> goal_pose,
@@ -293,6 +342,7 @@ namespace dwa_local_planner {
     {
 
         obstacle_costs_.setFootprint(footprint_spec);
+        distance_field_costs_.setFootprint(footprint_spec);
 
         //make sure that our configuration doesn't change mid-run
         boost::mutex::scoped_lock l(configuration_mutex_);
@@ -309,16 +359,102 @@ namespace dwa_local_planner {
         // find best trajectory by sampling and scoring the samples
         base_local_planner::Trajectory result_traj;
         std::vector<base_local_planner::Trajectory> all_explored;
-        scored_sampling_planner_.findBestTrajectory(result_traj, &all_explored);
+        // copying every explored trajectory is only worth it if someone looks at them
+        bool explore = vis_.wantsTrajectoryCloud();
+        scored_sampling_planner_.findBestTrajectory(result_traj, explore ? &all_explored : NULL);
+
+        // the trajectory velocities are the sampled command only without continued acceleration
+        if (refine_iterations_ > 0 && use_dwa_ && result_traj.cost_ >= 0)
+            refineTrajectory(result_traj);
+
+        // refine around the chosen command next cycle
+        has_last_cmd_ = result_traj.cost_ >= 0;
+        last_cmd_ = Eigen::Vector3f(result_traj.xv_, result_traj.yv_, result_traj.thetav_);
+        if (has_last_cmd_)
+            generator_.setPreviousCommand(last_cmd_);
+        else
+            generator_.clearPreviousCommand();
 
         //! Visualization
         vis_.publishDesiredOrientation(alignment_costs_.getDesiredOrientation(), robot_pose);
         vis_.publishCostGrid();
-        vis_.publishTrajectoryCloud(all_explored);
+        if (explore)
+            vis_.publishTrajectoryCloud(all_explored);
 
         return result_traj;
     }
 
+    bool DWAPlanner::checkTrajectory(Eigen::Vector3f pos, Eigen::Vector3f vel, Eigen::Vector3f vel_samples)
+    {
+        boost::mutex::scoped_lock l(configuration_mutex_);
+        base_local_planner::LocalPlannerLimits limits = planner_util_->getCurrentLimits();
+        generator_.initialise(pos, vel, pos, &limits, vsamples_, false);
+        if (!generator_.generateTrajectory(pos, vel, vel_samples, check_traj_))
+            return false;
+        return scored_sampling_planner_.scoreTrajectory(check_traj_, -1) >= 0;
+    }
+
+    void DWAPlanner::refineTrajectory(base_local_planner::Trajectory& traj)
+    {
+        // compass search within the dynamic window, starting at half the sample spacing
+        const Eigen::Vector3f& min_vel = generator_.getMinVelocity();
+        const Eigen::Vector3f& max_vel = generator_.getMaxVelocity();
+        Eigen::Vector3f step = 0.5 * generator_.getSampleStep();
+        Eigen::Vector3f best_cmd(traj.xv_, traj.yv_, traj.thetav_);
+        double best_cost = traj.cost_;
+        bool improved_any = false;
+
+        // warm start from the last command if it is still reachable
+        if (has_last_cmd_)
+        {
+            Eigen::Vector3f start = last_cmd_.cwiseMax(min_vel).cwiseMin(max_vel);
+            if (start != best_cmd)
+                improved_any = tryCommand(start, best_cmd, best_cost);
+        }
+
+        for (int i = 0; i < refine_iterations_; ++i)
+        {
+            // the sampled trajectory is good enough to return when time is up
+            if (scored_sampling_planner_.pastDeadline())
+                break;
+            bool improved = false;
+            for (int d = 0; d < 3; ++d)
+            {
+                if (step[d] <= 0)
+                    continue;
+                for (int sign = -1; sign <= 1; sign += 2)
+                {
+                    Eigen::Vector3f cmd = best_cmd;
+                    cmd[d] = std::min(max_vel[d], std::max(min_vel[d], best_cmd[d] + sign * step[d]));
+                    if (cmd[d] != best_cmd[d] && tryCommand(cmd, best_cmd, best_cost))
+                        improved = true;
+                }
+            }
+            improved_any = improved_any || improved;
+            if (!improved)
+                step *= 0.5;
+        }
+
+        if (improved_any)
+        {
+            traj = refine_best_traj_;
+            traj.cost_ = best_cost;
+        }
+    }
+
+    bool DWAPlanner::tryCommand(const Eigen::Vector3f& cmd, Eigen::Vector3f& best_cmd, double& best_cost)
+    {
+        if (!generator_.generateSample(cmd, refine_traj_))
+            return false;
+        double cost = scored_sampling_planner_.scoreTrajectory(refine_traj_, best_cost);
+        if (cost < 0 || cost >= best_cost)
+            return false;
+        best_cmd = cmd;
+        best_cost = cost;
+        refine_best_traj_.swap(refine_traj_);
+        return true;
+    }
+
     bool DWAPlanner::isMoving(tf::Stamped<tf::Pose>& robot_pose)
     {
         static double x_saved = 0.0;
@@ -44,6 +44,7 @@
 #include <pluginlib/class_list_macros.h>
 
 #include <base_local_planner/goal_functions.h>
+#include <nav_trace/trace.h>
 #include <nav_msgs/Path.h>
 
 //register this planner as a BaseLocalPlanner plugin
@@ -152,8 +153,10 @@ namespace dwa_local_planner {
     }
 
     DWAPlannerROS::DWAPlannerROS() :
+        use_costmap_snapshot_(false),
         initialized_(false),
-        odom_helper_("odom")
+        odom_helper_("odom"),
+        stop_rotate_at_goal_(false)
     {
 
     }
@@ -219,11 +222,24 @@ namespace dwa_local_planner {
         // make sure to update the costmap we'll use for this cycle
         costmap_2d::Costmap2D* costmap = costmap_ros_->getCostmap();
 
+        // with a snapshot the planner works on a copy taken at the start of each cycle, without holding the costmap lock
+        private_nh.param("costmap_snapshot", use_costmap_snapshot_, false);
+        if (use_costmap_snapshot_)
+        {
+            costmap_snapshot_.copyCostsFrom(*costmap_ros_->getCostmapSnapshot());
+            costmap = &costmap_snapshot_;
+        }
+
         planner_util_.initialize(tf, costmap, costmap_ros_->getGlobalFrameID());
 
         //create the actual planner that we'll use.. it'll configure itself from the parameter server
         dp_ = boost::shared_ptr<DWAPlanner>(new DWAPlanner(name, &planner_util_));
 
+        // instead of the arrive state, stop and turn in place once the goal position is reached
+        private_nh.param("stop_rotate_at_goal", stop_rotate_at_goal_, false);
+        latched_stop_rotate_controller_.reset(new base_local_planner::LatchedStopRotateController(name));
+        swept_model_.reset(new base_local_planner::CostmapModel(*costmap));
+
         initialized_ = true;
 
         dsrv_ = new dynamic_reconfigure::Server<DWAPlannerConfig>(private_nh);
@@ -241,10 +257,31 @@ namespace dwa_local_planner {
 
         // Reset the motion time stamp of the planner
         dp_->resetMotionStamp();
+        latched_stop_rotate_controller_->resetLatching();
 
         return planner_util_.setPlan(orig_global_plan);
     }
 
+    bool DWAPlannerROS::setPlan(const nav_core::PlanConstPtr& plan, unsigned int version)
+    {
+        if (!initialized_)
+        {
+            ROS_ERROR("This planner has not been initialized, please call initialize() before using this planner");
+            return false;
+        }
+
+        dp_->resetMotionStamp();
+        latched_stop_rotate_controller_->resetLatching();
+
+        return planner_util_.setPlan(plan, version);
+    }
+
+    bool DWAPlannerROS::setSpeedLimit(double max_trans_vel, double max_rot_vel)
+    {
+        planner_util_.setSpeedLimit(max_trans_vel, max_rot_vel);
+        return true;
+    }
+
     bool DWAPlannerROS::isGoalReached()
     {
         tf::Stamped<tf::Pose> robot_pose, robot_vel;
@@ -266,13 +303,24 @@ namespace dwa_local_planner {
             return false;
     }
 
+    void DWAPlannerROS::setControlDeadline(const ros::WallTime& deadline)
+    {
+        if (dp_)
+            dp_->setDeadline(deadline);
+    }
+
     bool DWAPlannerROS::computeVelocityCommands(geometry_msgs::Twist& cmd_vel)
     {
+        NAV_TRACE_SCOPE("DWAPlannerROS::computeVelocityCommands");
         ROS_DEBUG_NAMED("DWAPlannerROS","computeVelocityCommands");
 
-        std::vector<geometry_msgs::PoseStamped> local_plan;
+        // reused across cycles, so transforming the plan does not allocate
+        std::vector<geometry_msgs::PoseStamped>& local_plan = local_plan_;
         tf::Stamped<tf::Pose> robot_pose, robot_vel, goal_pose;
 
+        if (use_costmap_snapshot_)
+            costmap_snapshot_.copyCostsFrom(*costmap_ros_->getCostmapSnapshot());
+
         base_local_planner::Trajectory traj;
         if (getRobotStateAndLocalPlan(robot_pose, robot_vel, local_plan))
         {
@@ -287,11 +335,31 @@ namespace dwa_local_planner {
             // Get the local goal
             tf::poseStampedMsgToTF(local_plan.back(), goal_pose);
 
+            // the inflation thresholds follow footprint and inflation changes
+            costmap_2d::LayeredCostmap* layered_costmap = costmap_ros_->getLayeredCostmap();
+            dp_->setInflationThresholds(layered_costmap->getInscribedCost(), layered_costmap->getCircumscribedCost());
+
+            // cached obstacle scores over cells that changed since the last cycle are stale
+            unsigned int x0, xn, y0, yn;
+            if (layered_costmap->takeChangedBounds(&x0, &xn, &y0, &yn))
+                dp_->invalidateTrajectoryCache(x0, xn, y0, yn);
+
             // update plan in dwa planner to calculate cost grid
-            dp_->updatePlanAndLocalCosts(robot_pose, local_plan, lookahead, costmap_ros_->getRobotFootprint());
+            std::vector<geometry_msgs::Point> footprint = costmap_ros_->getRobotFootprint();
+            dp_->updatePlanAndLocalCosts(robot_pose, local_plan, lookahead, footprint);
+
+            if (stop_rotate_at_goal_ && latched_stop_rotate_controller_->isPositionReached(&planner_util_, robot_pose))
+            {
+                // turns in place are cleared by the swept ring, which the model keeps for an unchanged footprint
+                latched_stop_rotate_controller_->setSweptCheck(swept_model_.get(), footprint);
+                base_local_planner::publishPlan(std::vector<geometry_msgs::PoseStamped>(), l_traj_pub_);
+                return latched_stop_rotate_controller_->computeVelocityCommandsStopRotate(cmd_vel,
+                    planner_util_.getCurrentLimits().getAccLimits(), dp_->getSimPeriod(), &planner_util_, odom_helper_, robot_pose,
+                    boost::bind(&DWAPlanner::checkTrajectory, dp_, _1, _2, _3));
+            }
 
             // call with updated footprint
-            traj = dp_->findBestPath(robot_pose, robot_vel, goal_pose, costmap_ros_->getRobotFootprint());
+            traj = dp_->findBestPath(robot_pose, robot_vel, goal_pose, footprint);
         }
 
         // Set the command velocity
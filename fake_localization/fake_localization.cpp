@@ -67,6 +67,13 @@
   @section parameters ROS parameters
 
   - "~odom_frame_id" (string) : The odometry frame to be used, default: "odom"
+  - "~robots" (list of strings) : Namespaces of the robots to localize from this one process. Topics
+    of each robot live in its namespace, parameters are read from "~<namespace>/" first, and the
+    odometry and base frames default to "<namespace>/odom" and "<namespace>/base_link". Default: empty,
+    a single robot in the node's namespace.
+  - "~decimation" (int) : Only republish every n-th ground truth message, default: 1
+  - "~tf_batch_rate" (double) : When positive, transforms of all robots are collected and broadcast
+    together at this rate instead of one message per ground truth message, default: 0.0
 
  **/
 
@@ -86,58 +93,124 @@
 #include "tf/message_filter.h"
 #include "message_filters/subscriber.h"
 
+#include <algorithm>
+#include <vector>
+
+
+/**
+ * Transforms to be broadcast together, so that a fleet of robots sends one
+ * tf message per cycle instead of one per robot and ground truth message.
+ */
+class TransformBatch
+{
+  public:
+    TransformBatch(tf::TransformBroadcaster* broadcaster) : m_tfServer(broadcaster), m_enabled(false) {}
+
+    void start(ros::NodeHandle& nh, double rate)
+    {
+      m_enabled = true;
+      m_timer = nh.createTimer(ros::Duration(1.0 / rate), &TransformBatch::flush, this);
+    }
+
+    void send(const tf::StampedTransform& transform)
+    {
+      if (!m_enabled){
+        m_tfServer->sendTransform(transform);
+        return;
+      }
+
+      // only the latest transform per child frame is worth sending
+      for (unsigned int i = 0; i < m_pending.size(); ++i){
+        if (m_pending[i].child_frame_id_ == transform.child_frame_id_){
+          m_pending[i] = transform;
+          return;
+        }
+      }
+      m_pending.push_back(transform);
+    }
+
+    void flush(const ros::TimerEvent& e)
+    {
+      if (m_pending.empty())
+        return;
+      m_tfServer->sendTransform(m_pending);
+      m_pending.clear();
+    }
+
+  private:
+    tf::TransformBroadcaster* m_tfServer;
+    bool m_enabled;
+    ros::Timer m_timer;
+    std::vector<tf::StampedTransform> m_pending;
+};
 
 class FakeOdomNode
 {
   public:
-    FakeOdomNode(void)
+    /**
+     * @param nh Node handle in the namespace of the robot's topics
+     * @param private_nh The node's private node handle, for parameters shared by all robots
+     * @param robot_ns Namespace of the robot, empty when the node serves a single robot
+     */
+    FakeOdomNode(const ros::NodeHandle& nh, const ros::NodeHandle& private_nh, const std::string& robot_ns,
+                 tf::TransformListener* listener, TransformBatch* tf_batch)
+      : m_nh(nh), m_private_nh(private_nh), m_robot_nh(private_nh, robot_ns),
+        m_tfBatch(tf_batch), m_tfListener(listener), m_message_count(0)
     {
       m_posePub = m_nh.advertise<geometry_msgs::PoseWithCovarianceStamped>("amcl_pose",1,true);
       m_particlecloudPub = m_nh.advertise<geometry_msgs::PoseArray>("particlecloud",1,true);
-      m_tfServer = new tf::TransformBroadcaster();	
-      m_tfListener = new tf::TransformListener();
 
       m_base_pos_received = false;
 
-      ros::NodeHandle private_nh("~");
-      private_nh.param("odom_frame_id", odom_frame_id_, std::string("odom"));
-      private_nh.param("base_frame_id", base_frame_id_, std::string("base_link")); 
-      private_nh.param("global_frame_id", global_frame_id_, std::string("/map"));
-      private_nh.param("delta_x", delta_x_, 0.0);
-      private_nh.param("delta_y", delta_y_, 0.0);
-      private_nh.param("delta_yaw", delta_yaw_, 0.0);      
-      private_nh.param("transform_tolerance", transform_tolerance_, 0.1);      
+      param("odom_frame_id", odom_frame_id_, robot_ns.empty() ? std::string("odom") : tf::resolve(robot_ns, "odom"));
+      param("base_frame_id", base_frame_id_, robot_ns.empty() ? std::string("base_link") : tf::resolve(robot_ns, "base_link"));
+      param("global_frame_id", global_frame_id_, std::string("/map"));
+      param("delta_x", delta_x_, 0.0);
+      param("delta_y", delta_y_, 0.0);
+      param("delta_yaw", delta_yaw_, 0.0);
+      param("transform_tolerance", transform_tolerance_, 0.1);
+      param("decimation", decimation_, 1);
+      decimation_ = std::max(decimation_, 1);
       m_particleCloud.header.stamp = ros::Time::now();
       m_particleCloud.header.frame_id = global_frame_id_;
       m_particleCloud.poses.resize(1);
-      ros::NodeHandle nh;
 
       m_offsetTf = tf::Transform(tf::createQuaternionFromRPY(0, 0, -delta_yaw_ ), tf::Point(-delta_x_, -delta_y_, 0.0));
 
-      stuff_sub_ = nh.subscribe("base_pose_ground_truth", 100, &FakeOdomNode::stuffFilter, this);
-      filter_sub_ = new message_filters::Subscriber<nav_msgs::Odometry>(nh, "", 100);
+      stuff_sub_ = m_nh.subscribe("base_pose_ground_truth", 100, &FakeOdomNode::stuffFilter, this);
+      filter_sub_ = new message_filters::Subscriber<nav_msgs::Odometry>(m_nh, "", 100);
       filter_ = new tf::MessageFilter<nav_msgs::Odometry>(*filter_sub_, *m_tfListener, base_frame_id_, 100);
       filter_->registerCallback(boost::bind(&FakeOdomNode::update, this, _1));
 
       // subscription to "2D Pose Estimate" from RViz:
-      m_initPoseSub = new message_filters::Subscriber<geometry_msgs::PoseWithCovarianceStamped>(nh, "initialpose", 1);
+      m_initPoseSub = new message_filters::Subscriber<geometry_msgs::PoseWithCovarianceStamped>(m_nh, "initialpose", 1);
       m_initPoseFilter = new tf::MessageFilter<geometry_msgs::PoseWithCovarianceStamped>(*m_initPoseSub, *m_tfListener, global_frame_id_, 1);
       m_initPoseFilter->registerCallback(boost::bind(&FakeOdomNode::initPoseReceived, this, _1));
     }
 
     ~FakeOdomNode(void)
     {
-      if (m_tfServer)
-        delete m_tfServer; 
+      delete m_initPoseFilter;
+      delete m_initPoseSub;
+      delete filter_;
+      delete filter_sub_;
     }
 
 
   private:
-    ros::NodeHandle m_nh;
+    /// read a parameter of this robot, falling back to the value shared by all robots
+    template <class T>
+    void param(const std::string& name, T& value, const T& default_value)
+    {
+      if (!m_robot_nh.getParam(name, value))
+        m_private_nh.param(name, value, default_value);
+    }
+
+    ros::NodeHandle m_nh, m_private_nh, m_robot_nh;
     ros::Publisher m_posePub;
     ros::Publisher m_particlecloudPub;
     message_filters::Subscriber<geometry_msgs::PoseWithCovarianceStamped>* m_initPoseSub;
-    tf::TransformBroadcaster       *m_tfServer;
+    TransformBatch                 *m_tfBatch;
     tf::TransformListener          *m_tfListener;
     tf::MessageFilter<geometry_msgs::PoseWithCovarianceStamped>* m_initPoseFilter;
     tf::MessageFilter<nav_msgs::Odometry>* filter_;
@@ -147,6 +220,8 @@ class FakeOdomNode
     double                         delta_x_, delta_y_, delta_yaw_;
     bool                           m_base_pos_received;
     double transform_tolerance_;
+    int decimation_;
+    unsigned int m_message_count;
 
     nav_msgs::Odometry  m_basePosMsg;
     geometry_msgs::PoseArray      m_particleCloud;
@@ -160,6 +235,10 @@ class FakeOdomNode
 
   public:
     void stuffFilter(const nav_msgs::OdometryConstPtr& odom_msg){
+      // skip decimated messages before they cost a copy and a transform lookup
+      if (m_message_count++ % decimation_ != 0)
+        return;
+
       //we have to do this to force the message filter to wait for transforms
       //from odom_frame_id_ to base_frame_id_ to be available at time odom_msg.header.stamp
       //really, the base_pose_ground_truth should come in with no frame_id b/c it doesn't make sense
@@ -185,9 +264,9 @@ class FakeOdomNode
         return;
       }
 
-      m_tfServer->sendTransform(tf::StampedTransform(odom_to_map.inverse(),
-                                                     message->header.stamp + ros::Duration(transform_tolerance_),
-                                                     global_frame_id_, message->header.frame_id));
+      m_tfBatch->send(tf::StampedTransform(odom_to_map.inverse(),
+                                           message->header.stamp + ros::Duration(transform_tolerance_),
+                                           global_frame_id_, message->header.frame_id));
 
       tf::Pose current;
       tf::poseMsgToTF(message->pose.pose, current);
@@ -237,9 +316,35 @@ int main(int argc, char** argv)
 {
   ros::init(argc, argv, "fake_localization");
 
-  FakeOdomNode odom;
+  ros::NodeHandle nh;
+  ros::NodeHandle private_nh("~");
+
+  // one listener and broadcaster for however many robots this process serves
+  tf::TransformListener listener;
+  tf::TransformBroadcaster broadcaster;
+  TransformBatch tf_batch(&broadcaster);
+
+  double tf_batch_rate;
+  private_nh.param("tf_batch_rate", tf_batch_rate, 0.0);
+  if (tf_batch_rate > 0.0)
+    tf_batch.start(nh, tf_batch_rate);
+
+  std::vector<std::string> robots;
+  private_nh.getParam("robots", robots);
+
+  std::vector<FakeOdomNode*> odoms;
+  if (robots.empty())
+    odoms.push_back(new FakeOdomNode(nh, private_nh, "", &listener, &tf_batch));
+  else {
+    for (unsigned int i = 0; i < robots.size(); ++i)
+      odoms.push_back(new FakeOdomNode(ros::NodeHandle(nh, robots[i]), private_nh, robots[i], &listener, &tf_batch));
+    ROS_INFO("Fake localization for %d robots", (int)robots.size());
+  }
 
   ros::spin();
 
+  for (unsigned int i = 0; i < odoms.size(); ++i)
+    delete odoms[i];
+
   return 0;
 }
@@ -63,11 +63,53 @@ struct greater1 {
 class AStarExpansion : public Expander {
     public:
         AStarExpansion(PotentialCalculator* p_calc, int nx, int ny);
+
+        /**
+         * @brief  Calculates the potentials from the start towards the end.  Only the cells the last call
+         * set are reset, so the potential array must not change between calls unless it is a new one.
+         */
         bool calculatePotentials(unsigned char* costs, double start_x, double start_y, double end_x, double end_y, int cycles,
                                 float* potential);
+
+        /**
+         * @brief  Sets or resets the size of the map
+         * @param nx The x size of the map
+         * @param ny The y size of the map
+         */
+        void setSize(int nx, int ny); /**< sets or resets the size of the map */
+
+        /**
+         * @brief  Searches from both ends with an octile heuristic, until the searches meet
+         * @param bidirectional Whether to search from both ends
+         */
+        void setBidirectional(bool bidirectional){ bidirectional_ = bidirectional; }
     private:
         void add(unsigned char* costs, float* potential, float prev_potential, int next_i, int end_x, int end_y);
+
+        bool passable(unsigned char* costs, int n);
+        float octileDistance(int a, int b);
+
+        /**
+         * @brief  Calculates the potentials from both ends, joining them along the path where they meet
+         * @return True if the searches met
+         */
+        bool calculateBidirectional(unsigned char* costs, int start_i, int goal_i, int cycles, float* potential);
+
+        /**
+         * @brief  Expands the top cell of one of the two searches
+         * @param potential The potentials of this search
+         * @param other The potentials of the other search
+         * @return The cell where the searches met, -1 if they did not
+         */
+        int expand(unsigned char* costs, float* potential, const float* other, std::vector<Index>& queue,
+                   std::vector<int>& touched, int target_i);
+
         std::vector<Index> queue_;
+
+        bool bidirectional_;
+        std::vector<Index> back_queue_;
+        std::vector<float> back_potential_; /**< potentials of the search from the end */
+        std::vector<int> back_touched_;
 };
 
 } //end namespace global_planner
@@ -0,0 +1,116 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#ifndef _COARSE_COSTMAP_H
+#define _COARSE_COSTMAP_H
+
+#include <global_planner/astar.h>
+#include <vector>
+
+namespace global_planner {
+
+/**
+ * @brief  A coarse copy of the costmap for planning in two steps.  Every block of factor x factor cells is
+ * pooled into one, the highest cost of its passable cells, and a block is only blocked if none of its cells are
+ * passable.  A path over the blocks gives a corridor, and the full resolution search is then given a copy of the
+ * costs that is lethal outside of it.
+ */
+class CoarseCostmap {
+    public:
+        CoarseCostmap(int factor);
+
+        /**
+         * @brief  Sets the costs the blocks are pooled and searched with, they have to be pooled again if these change
+         */
+        void setCosts(unsigned char lethal_cost, unsigned char neutral_cost, bool unknown);
+
+        /**
+         * @brief  Pools all the blocks again, and resets the corridor if the size changed
+         */
+        void update(const unsigned char* costs, int nx, int ny);
+
+        /**
+         * @brief  Pools the blocks of the cells in [x0, xn) x [y0, yn) again
+         */
+        void update(const unsigned char* costs, int x0, int xn, int y0, int yn);
+
+        /**
+         * @brief  Searches the blocks for the corridor from the start to the end cell
+         * @param width The number of blocks the corridor reaches beyond those of the coarse path
+         * @return True if a corridor was found
+         */
+        bool findCorridor(int start_x, int start_y, int end_x, int end_y, int width);
+
+        /**
+         * @brief  Gets the costs within the last corridor found, lethal everywhere else
+         * @param costs The full resolution costs the corridor is copied from
+         * @return The copy, valid until the next call
+         */
+        unsigned char* getCorridorCosts(const unsigned char* costs);
+
+        /**
+         * @brief  Whether the blocks were pooled from a map of this size with the current costs
+         */
+        bool isCurrent(int nx, int ny) {
+            return !stale_ && nx == nx_ && ny == ny_;
+        }
+
+    private:
+        void pool(const unsigned char* costs, int b);
+
+        /**
+         * @brief  Copies the cells of a block or sets them lethal
+         */
+        void fill(const unsigned char* costs, int b, bool copy);
+
+        int factor_;
+        int nx_, ny_; /**< size of the full resolution map */
+        int bx_, by_; /**< size of the grid of blocks */
+        unsigned char lethal_cost_, neutral_cost_;
+        bool unknown_, stale_;
+
+        std::vector<unsigned char> blocks_; /**< pooled cost of every block, lethal_cost_ if it is blocked */
+        std::vector<float> cost_;
+        std::vector<int> parent_;
+        std::vector<Index> queue_;
+
+        std::vector<unsigned char> in_corridor_;
+        std::vector<int> corridor_; /**< blocks of the last corridor found */
+        std::vector<int> copied_; /**< blocks copied into corridor_costs_ */
+        std::vector<unsigned char> corridor_costs_;
+};
+
+} //end namespace global_planner
+#endif
@@ -0,0 +1,104 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#ifndef _COST_MATRIX_H
+#define _COST_MATRIX_H
+
+#include <global_planner/dijkstra.h>
+#include <boost/thread.hpp>
+#include <utility>
+#include <vector>
+
+namespace global_planner {
+
+/**
+ * @brief  Computes the travel costs from many start cells to many end cells.  Every start gets a Dijkstra
+ * expansion of its own over the whole map, and these run on a number of threads, each with its own expander and
+ * potential array.  The costs are only read, so all of the threads share one copy of them.
+ */
+class CostMatrix {
+    public:
+        /**
+         * @param p_calc The potential calculator of the expanders, only read while computing
+         * @param threads The number of expansions that run at the same time
+         */
+        CostMatrix(PotentialCalculator* p_calc, unsigned int threads);
+
+        ~CostMatrix();
+
+        /**
+         * @brief  Sets the costs the expanders are given by the dynamic reconfigure of the planner
+         */
+        void setCosts(unsigned char lethal_cost, unsigned char neutral_cost, float factor, bool unknown);
+
+        void setPreciseStart(bool precise);
+
+        /**
+         * @brief  Computes the cost of getting from every start to every end
+         * @param costs The costs of the map, not changed
+         * @param starts The start points, in cells
+         * @param ends The indices of the end cells
+         * @param matrix Filled with the potential at end j of the expansion from start i at i * ends.size() + j,
+         * POT_HIGH if it can't be reached
+         */
+        void compute(unsigned char* costs, int nx, int ny, const std::vector<std::pair<double, double> >& starts,
+                     const std::vector<int>& ends, std::vector<float>& matrix);
+
+    private:
+        struct Workspace {
+            DijkstraExpansion* expander;
+            std::vector<float> potential;
+        };
+
+        /**
+         * @brief  Takes the next start until there are none left and writes its row of the matrix
+         */
+        void worker(Workspace* workspace);
+
+        PotentialCalculator* p_calc_;
+        std::vector<Workspace> workspaces_; /**< one for every thread, kept between calls */
+
+        unsigned char* costs_;
+        int nx_, ny_;
+        const std::vector<std::pair<double, double> >* starts_;
+        const std::vector<int>* ends_;
+        std::vector<float>* matrix_;
+
+        unsigned int next_start_;
+        boost::mutex start_mutex_;
+};
+
+} //end namespace global_planner
+#endif
@@ -38,7 +38,7 @@
 #ifndef _DIJKSTRA_H
 #define _DIJKSTRA_H
 
-#define PRIORITYBUFSIZE 10000
+#define PRIORITYBUFSIZE 10000 // initial size, the buffers grow as needed
 #include <math.h>
 #include <stdint.h>
 #include <string.h>
@@ -46,11 +46,13 @@
 
 #include <global_planner/planner_core.h>
 #include <global_planner/expander.h>
+#include <boost/thread.hpp>
+#include <vector>
 
-// inserting onto the priority blocks
-#define push_cur(n)  { if (n>=0 && n<ns_ && !pending_[n] && getCost(costs, n)<lethal_cost_ && currentEnd_<PRIORITYBUFSIZE){ currentBuffer_[currentEnd_++]=n; pending_[n]=true; }}
-#define push_next(n) { if (n>=0 && n<ns_ && !pending_[n] && getCost(costs, n)<lethal_cost_ &&    nextEnd_<PRIORITYBUFSIZE){    nextBuffer_[   nextEnd_++]=n; pending_[n]=true; }}
-#define push_over(n) { if (n>=0 && n<ns_ && !pending_[n] && getCost(costs, n)<lethal_cost_ &&    overEnd_<PRIORITYBUFSIZE){    overBuffer_[   overEnd_++]=n; pending_[n]=true; }}
+// inserting onto the priority blocks, which grow rather than drop cells, and never take the edge of the map
+#define push_cur(n)  { if (n>=0 && n<ns_ && !pending_[n] && getCost(costs, n)<lethal_cost_ && !onBorder(n)){ if (currentEnd_ == currentSize_) growBuffer(currentBuffer_, currentSize_); currentBuffer_[currentEnd_++]=n; pending_[n]=true; }}
+#define push_next(n) { if (n>=0 && n<ns_ && !pending_[n] && getCost(costs, n)<lethal_cost_ && !onBorder(n)){ if (   nextEnd_ ==    nextSize_) growBuffer(   nextBuffer_,    nextSize_);    nextBuffer_[   nextEnd_++]=n; pending_[n]=true; }}
+#define push_over(n) { if (n>=0 && n<ns_ && !pending_[n] && getCost(costs, n)<lethal_cost_ && !onBorder(n)){ if (   overEnd_ ==    overSize_) growBuffer(   overBuffer_,    overSize_);    overBuffer_[   overEnd_++]=n; pending_[n]=true; }}
 // potential defs
 #define POT_HIGH 1.0e10        // unassigned cell potential
 
@@ -58,6 +60,7 @@ namespace global_planner {
 class DijkstraExpansion : public Expander {
     public:
         DijkstraExpansion(PotentialCalculator* p_calc, int nx, int ny);
+        ~DijkstraExpansion();
         bool calculatePotentials(unsigned char* costs, double start_x, double start_y, double end_x, double end_y, int cycles,
                                 float* potential);
 
@@ -74,6 +77,11 @@ class DijkstraExpansion : public Expander {
         }
 
         void setPreciseStart(bool precise){ precise_ = precise; }
+
+        /**
+         * @brief  Sets the number of threads large priority buffers are processed on, 1 processes them in order
+         */
+        void setThreads(unsigned int threads);
     private:
 
         /**
@@ -84,21 +92,57 @@ class DijkstraExpansion : public Expander {
          */
         void updateCell(unsigned char* costs, float* potential, int n); /** updates the cell at index n */
 
+        /**
+         * @brief  Updates all the cells of the current priority buffer on the threads.  The new potentials are
+         * all computed before any is written, so every cell of the buffer sees the same potentials of the others
+         * whichever thread it is on, and the cells are pushed in the order of the buffer afterwards.
+         * @param parallel False to update the whole buffer on the calling thread, which still updates it from the
+         * potentials before the buffer (Jacobi) rather than in place like updateCell() (Gauss-Seidel)
+         */
+        void updateBand(unsigned char* costs, float* potential, bool parallel);
+
+        /**
+         * @brief  Runs the steps of updateBand() for the part t of the buffer, every thread in step with the others
+         */
+        void bandStep(unsigned int t);
+
+        /**
+         * @brief  Waits for the other threads between the steps of updateBand(), if it runs on them
+         */
+        void bandSync();
+
+        /**
+         * @brief  The loop of the worker threads, a band step every time the barrier lets them go
+         */
+        void bandWorker(unsigned int t);
+
+        /**
+         * @brief  Stops and joins the worker threads
+         */
+        void stopWorkers();
+
+        /**
+         * @brief  Doubles the size of a priority buffer, keeping its contents
+         * @param buffer The buffer to grow
+         * @param size The allocated size of the buffer, updated
+         */
+        void growBuffer(int*& buffer, int& size);
+
+        /**
+         * @brief  Fills the cost table with the cost of every costmap value for the current settings
+         */
+        void setCostTable();
+
         float getCost(unsigned char* costs, int n) {
-            float c = costs[n];
-            if (c < lethal_cost_ - 1 || (unknown_ && c==255)) {
-                c = c * factor_ + neutral_cost_;
-                if (c >= lethal_cost_)
-                    c = lethal_cost_ - 1;
-                return c;
-            }
-            return lethal_cost_;
+            return cost_table_[costs[n]];
         }
 
+        float cost_table_[256]; /**< the cost of every costmap value, set at the start of every calculation */
+
         /** block priority buffers */
-        int *buffer1_, *buffer2_, *buffer3_; /**< storage buffers for priority blocks */
         int *currentBuffer_, *nextBuffer_, *overBuffer_; /**< priority buffer block ptrs */
         int currentEnd_, nextEnd_, overEnd_; /**< end points of arrays */
+        int currentSize_, nextSize_, overSize_; /**< allocated sizes of arrays */
         bool *pending_; /**< pending_ cells during propagation */
         bool precise_;
 
@@ -106,6 +150,18 @@ class DijkstraExpansion : public Expander {
         float threshold_; /**< current threshold */
         float priorityIncrement_; /**< priority threshold increment */
 
+        /** parallel processing of the priority buffer */
+        unsigned int threads_;
+        boost::thread_group workers_;
+        boost::barrier* barrier_; /**< the worker threads and the calling one, NULL without workers */
+        bool stopping_;
+        unsigned char* band_costs_;
+        float* band_potential_;
+        std::vector<float> band_pot_; /**< new potential of every cell of the buffer, or -1 if it didn't improve */
+        std::vector<float> band_cost_; /**< cost of every cell of the buffer, for a batched calculator */
+        unsigned int band_parts_; /**< the number of threads the current buffer is split over */
+        std::vector<std::vector<int> > band_next_, band_over_; /**< the cells every part of the buffer pushes */
+
 };
 } //end namespace global_planner
 #endif
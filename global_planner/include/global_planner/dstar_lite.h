@@ -0,0 +1,137 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#ifndef _DSTAR_LITE_H
+#define _DSTAR_LITE_H
+
+#include <global_planner/planner_core.h>
+#include <global_planner/expander.h>
+#include <costmap_2d/cost_values.h>
+#include <vector>
+
+namespace global_planner {
+
+/**
+ * @brief  D* Lite over the 8-connected grid.  The search runs back from the end cell and is kept between calls:
+ * while the end cell stays the same, only the cells whose cost changed since the last call are repaired, and the
+ * start cell may move.  The potential is only set along the path found, rising from the start to the end.
+ */
+class DStarLiteExpansion : public Expander {
+    public:
+        DStarLiteExpansion(PotentialCalculator* p_calc, int nx, int ny);
+        bool calculatePotentials(unsigned char* costs, double start_x, double start_y, double end_x, double end_y, int cycles,
+                                float* potential);
+
+        /**
+         * @brief  Sets or resets the size of the map
+         * @param nx The x size of the map
+         * @param ny The y size of the map
+         */
+        void setSize(int nx, int ny); /**< sets or resets the size of the map */
+
+        void setChangedBounds(int x0, int xn, int y0, int yn);
+
+        /**
+         * @brief  Does nothing, the potential along the path already leads from the end to the start
+         */
+        void clearEndpoint(unsigned char* costs, float* potential, int gx, int gy, int s) {
+        }
+
+    private:
+        struct Entry {
+            Entry(int a, float b, float c) :
+                    i(a), k1(b), k2(c) {
+            }
+            int i;
+            float k1, k2;
+        };
+        struct greaterEntry {
+            bool operator()(const Entry& a, const Entry& b) const {
+                return a.k1 > b.k1 || (a.k1 == b.k1 && a.k2 > b.k2);
+            }
+        };
+
+        bool passable(int n) {
+            if (onBorder(n))
+                return false;
+            return costs_[n] < lethal_cost_ || (unknown_ && costs_[n] == costmap_2d::NO_INFORMATION);
+        }
+
+        /**
+         * @brief  Forgets the search, the next call starts over
+         */
+        void reset();
+
+        float heuristic(int a, int b);
+        Entry key(int n);
+
+        /**
+         * @brief  Recomputes the cost to the end of a cell from its neighbours, and queues it if it changed
+         */
+        void updateVertex(int n);
+
+        /**
+         * @brief  Repairs the cells whose cost differs from the last call, in the changed bounds
+         */
+        void applyChanges(int start_i);
+
+        /**
+         * @brief  Runs the search until the cost of the start cell is settled
+         * @return False if there was no path within the cycles given
+         */
+        bool computeShortestPath(int start_i, int cycles);
+
+        /**
+         * @brief  Follows the cheapest neighbours from the start to the end cell, setting the potential on the way
+         */
+        bool setPath(float* potential, int start_i);
+
+        unsigned char* costs_;
+        int end_i_; /**< the cell the search is rooted at, -1 if there is none */
+        int last_start_;
+        float km_; /**< how far the start moved since the search began */
+        unsigned char last_lethal_, last_neutral_;
+        bool last_unknown_;
+        int x0_, xn_, y0_, yn_; /**< the cells that may have changed */
+        bool bounds_given_; /**< whether bounds were given since the last search, they are all cells otherwise */
+
+        std::vector<Entry> queue_;
+        std::vector<float> g_, rhs_;
+        std::vector<unsigned char> last_costs_; /**< the costs the search is consistent with */
+        std::vector<int> search_touched_; /**< cells of the search arrays set since they were reset */
+};
+
+} //end namespace global_planner
+#endif
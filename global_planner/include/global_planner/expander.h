@@ -38,15 +38,24 @@
 #ifndef _EXPANDER_H
 #define _EXPANDER_H
 #include <global_planner/potential_calculator.h>
+#include <algorithm>
+#include <vector>
+
+#ifndef POT_HIGH
+#define POT_HIGH 1.0e10        // unassigned cell potential
+#endif
 
 namespace global_planner {
 
 class Expander {
     public:
         Expander(PotentialCalculator* p_calc, int nx, int ny) :
-                unknown_(true), lethal_cost_(253), neutral_cost_(50), factor_(3.0), p_calc_(p_calc) {
+                nx_(0), ny_(0), ns_(0), unknown_(true), lethal_cost_(253), neutral_cost_(50), cells_visited_(0), factor_(3.0), p_calc_(p_calc),
+                last_potential_(NULL) {
             setSize(nx, ny);
         }
+        virtual ~Expander() {
+        }
         virtual bool calculatePotentials(unsigned char* costs, double start_x, double start_y, double end_x, double end_y,
                                         int cycles, float* potential) = 0;
 
@@ -56,6 +65,10 @@ class Expander {
          * @param ny The y size of the map
          */
         virtual void setSize(int nx, int ny) {
+            if (nx != nx_ || ny != ny_) {
+                touched_.clear();
+                last_potential_ = NULL;
+            }
             nx_ = nx;
             ny_ = ny;
             ns_ = nx * ny;
@@ -73,13 +86,39 @@ class Expander {
             unknown_ = unknown;
         }
 
-        void clearEndpoint(unsigned char* costs, float* potential, int gx, int gy, int s){
+        /**
+         * @brief  The number of cells expanded by the last call of calculatePotentials()
+         */
+        int getCellsVisited() const {
+            return cells_visited_;
+        }
+
+        /**
+         * @brief  Tells the expander that the potential array it was given last was written by something else
+         */
+        void forgetPotentials() {
+            touched_.clear();
+            last_potential_ = NULL;
+        }
+
+        /**
+         * @brief  Tells an expander that keeps its search between calls which cells changed since the last one
+         * @param x0, xn, y0, yn The changed cells are in [x0, xn) x [y0, yn), without a call any of them may have
+         */
+        virtual void setChangedBounds(int /*x0*/, int /*xn*/, int /*y0*/, int /*yn*/) {
+        }
+
+        virtual void clearEndpoint(unsigned char* costs, float* potential, int gx, int gy, int s){
             int startCell = toIndex(gx, gy);
             for(int i=-s;i<=s;i++){
             for(int j=-s;j<=s;j++){
+                if (gx + i < 1 || gx + i > nx_ - 2 || gy + j < 1 || gy + j > ny_ - 2)
+                    continue;
                 int n = startCell+i+nx_*j;
                 float c = costs[n]+neutral_cost_;
                 float pot = p_calc_->calculatePotential(potential, c, n);
+                if (potential == last_potential_)
+                    touched_.push_back(n);
                 potential[n] = pot;
             }
             }
@@ -90,6 +129,31 @@ class Expander {
             return x + nx_ * y;
         }
 
+        /**
+         * @brief  Whether a cell is on the edge of the map.  The expanders never enter these, so the edge
+         * doesn't have to be written into the costmap as lethal.
+         */
+        inline bool onBorder(int n) {
+            int x = n % nx_;
+            return n < nx_ || n >= ns_ - nx_ || x == 0 || x == nx_ - 1;
+        }
+
+        /**
+         * @brief  Resets the potential array for a new calculation.  Only the cells in touched_ are reset,
+         * unless the array is a new one, so they must be added to it as they are set.
+         * @param potential The potential array in which we are calculating
+         */
+        void resetPotentials(float* potential) {
+            if (potential != last_potential_) {
+                std::fill(potential, potential + ns_, POT_HIGH);
+                last_potential_ = potential;
+            } else {
+                for (unsigned int k = 0; k < touched_.size(); k++)
+                    potential[touched_[k]] = POT_HIGH;
+            }
+            touched_.clear();
+        }
+
         int nx_, ny_, ns_; /**< size of grid, in pixels */
         bool unknown_;
         unsigned char lethal_cost_, neutral_cost_;
@@ -97,6 +161,9 @@ class Expander {
         float factor_;
         PotentialCalculator* p_calc_;
 
+        std::vector<int> touched_; /**< cells of the potential array set since it was reset */
+        float* last_potential_; /**< the potential array of the last call, if it is kept track of */
+
 };
 
 } //end namespace global_planner
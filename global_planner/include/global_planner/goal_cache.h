@@ -0,0 +1,119 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#ifndef _GOAL_CACHE_H
+#define _GOAL_CACHE_H
+
+#include <global_planner/expander.h>
+#include <vector>
+
+namespace global_planner {
+
+/**
+ * @brief  Keeps the potential of the whole map from each of a few goals that are planned to again and again, so a
+ * plan to one of them is only a traceback from the start.  A change of the costmap only touches the potentials
+ * that are higher than those around the cells that changed, the lower ones stay good and so do plans from starts
+ * among them.
+ */
+class GoalCache {
+    public:
+        /**
+         * @param expander Expands the whole map from a goal, when the end it is given is on the edge of the map
+         */
+        GoalCache(Expander* expander) :
+                expander_(expander), nx_(0), ny_(0) {
+        }
+
+        /**
+         * @brief  Adds a goal for the map of the size last given to getPotential().  Its potential is only computed
+         * once it is planned to.
+         * @param x, y The goal, in cells
+         * @param cell_x, cell_y The cell it is in
+         */
+        void addGoal(double x, double y, int cell_x, int cell_y);
+
+        void clear() {
+            goals_.clear();
+        }
+
+        /**
+         * @brief  Has all of the potentials computed again, after the costs of the expander changed
+         */
+        void reset() {
+            for (unsigned int i = 0; i < goals_.size(); i++)
+                goals_[i].good_below = -1;
+        }
+
+        /**
+         * @brief  The goal in a cell, or -1 if there is none
+         */
+        int findGoal(int cell_x, int cell_y) const;
+
+        /**
+         * @brief  Tells the fields which cells changed, in [x0, xn) x [y0, yn)
+         */
+        void setChangedBounds(int x0, int xn, int y0, int yn);
+
+        /**
+         * @brief  Gets the potential from a goal that is good at a start cell, computing it again if it isn't
+         * @return NULL if the start can't be reached from the goal
+         */
+        float* getPotential(int goal, unsigned char* costs, int nx, int ny, int start_x, int start_y);
+
+        /**
+         * @brief  The goal, in cells
+         */
+        double getGoalX(int goal) const {
+            return goals_[goal].x;
+        }
+        double getGoalY(int goal) const {
+            return goals_[goal].y;
+        }
+
+    private:
+        struct Field {
+                double x, y;
+                int cell_x, cell_y;
+                std::vector<float> potential;
+                float good_below; /**< the potentials below this are still those for the costs, -1 before any */
+        };
+
+        Expander* expander_;
+        int nx_, ny_;
+        std::vector<Field> goals_;
+};
+
+} //end namespace global_planner
+#endif
@@ -46,9 +46,6 @@ namespace global_planner {
 class GradientPath : public Traceback {
     public:
         GradientPath(PotentialCalculator* p_calc);
-        ~GradientPath();
-
-        void setSize(int xs, int ys);
 
         //
         // Path construction
@@ -66,9 +63,12 @@ class GradientPath : public Traceback {
             int pt = stc + (int)round(dx) + (int)(xs_ * round(dy));
             return std::max(0, std::min(xs_ * ys_ - 1, pt));
         }
-        float gradCell(float* potential, int n);
-
-        float *gradx_, *grady_; /**< gradient arrays, size of potential array */
+        /**
+         * @brief  Calculates the gradient at a cell, only for the cells around the path so none are kept
+         * @param gx, gy Set to the normalized gradient, 0 if there is none
+         * @return The norm of the gradient before it was normalized
+         */
+        float gradCell(float* potential, int n, float& gx, float& gy);
 
         float pathStep_; /**< step size for following gradient */
 };
@@ -0,0 +1,113 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#ifndef _JUMP_POINT_H
+#define _JUMP_POINT_H
+
+#include <global_planner/planner_core.h>
+#include <global_planner/expander.h>
+#include <global_planner/astar.h>
+#include <costmap_2d/cost_values.h>
+#include <vector>
+
+namespace global_planner {
+
+/**
+ * @brief  Jump point search over the 8-connected grid.  Runs of free cells are crossed in one jump, only the
+ * cells where the search has to turn are queued.  Cells next to passable cells with a cost are expanded like
+ * plain A* instead.  The potential is only set along the path found, rising from the start to the end.
+ */
+class JumpPointExpansion : public Expander {
+    public:
+        JumpPointExpansion(PotentialCalculator* p_calc, int nx, int ny);
+        bool calculatePotentials(unsigned char* costs, double start_x, double start_y, double end_x, double end_y, int cycles,
+                                float* potential);
+
+        /**
+         * @brief  Sets or resets the size of the map
+         * @param nx The x size of the map
+         * @param ny The y size of the map
+         */
+        void setSize(int nx, int ny); /**< sets or resets the size of the map */
+
+        /**
+         * @brief  Does nothing, the potential along the path already leads from the end to the start
+         */
+        void clearEndpoint(unsigned char* costs, float* potential, int gx, int gy, int s) {
+        }
+
+    private:
+        bool passable(int n) {
+            if (onBorder(n))
+                return false;
+            return costs_[n] < lethal_cost_ || (unknown_ && costs_[n] == costmap_2d::NO_INFORMATION);
+        }
+        bool free(int n) {
+            return costs_[n] == costmap_2d::FREE_SPACE;
+        }
+
+        /**
+         * @brief  Queues a cell, if the cost to it is lower than before
+         */
+        void relax(int n, float cost, int parent);
+
+        /**
+         * @brief  Queues the successors of a cell, pruned by the direction it was reached from
+         */
+        void expand(int n);
+
+        /**
+         * @brief  Moves from a cell in a direction until a cell is found where the search has to turn
+         * @return The cell, -1 if there is none
+         */
+        int jump(int n, int dx, int dy);
+
+        /**
+         * @brief  Sets the potential along the path from the start to the end cell
+         */
+        void setPath(float* potential, int start_i, int end_i);
+
+        unsigned char* costs_;
+        int end_i_;
+
+        std::vector<Index> queue_;
+        std::vector<float> cost_; /**< the lowest cost found to each cell */
+        std::vector<int> parent_; /**< the cell each cell was reached from */
+        std::vector<bool> closed_;
+        std::vector<int> search_touched_; /**< cells of the search arrays set since they were reset */
+};
+
+} //end namespace global_planner
+#endif
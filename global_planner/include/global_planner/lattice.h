@@ -0,0 +1,171 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#ifndef _LATTICE_H
+#define _LATTICE_H
+
+#include <global_planner/astar.h>
+#include <global_planner/dijkstra.h>
+#include <global_planner/quadratic_calculator.h>
+#include <boost/unordered_map.hpp>
+#include <utility>
+#include <vector>
+
+namespace global_planner {
+
+/**
+ * @brief  A pose of a path on the lattice, in cells and radians
+ */
+struct LatticePose {
+        LatticePose(double a, double b, double c) :
+                x(a), y(b), theta(c) {
+        }
+        double x, y, theta;
+};
+
+/**
+ * @brief  A move of the lattice from a cell and heading, with the cells the footprint sweeps over on the way
+ */
+struct LatticePrimitive {
+        int start_heading, end_heading;
+        int dx, dy; /**< the cell it ends in, from the one it starts in */
+        double length; /**< in cells */
+        bool turn;
+        std::vector<LatticePose> poses; /**< along it, the last is the end, from the middle of the start cell */
+        std::vector<std::pair<int, int> > swept; /**< the cells the footprint sweeps over, from the start cell */
+        std::vector<std::pair<int, int> > center; /**< the cells the middle of the robot passes, from the start cell */
+        int min_x, max_x, min_y, max_y; /**< bounds of the swept cells */
+        std::vector<int> swept_offsets, center_offsets; /**< the same as offsets of the index, for the current width */
+};
+
+/**
+ * @brief  Searches paths that can be driven by a robot that can't turn on the spot.  The moves from every heading
+ * come from a fixed table, they join the middles of cells at one of 16 headings, and the cells the footprint
+ * sweeps over on every move are worked out once, so checking a move is only a lookup of those cells.  The search
+ * is an A* over the cells and headings, with the potential of a Dijkstra search from the end over the costmap as
+ * its heuristic.
+ */
+class Lattice {
+    public:
+        Lattice();
+
+        ~Lattice();
+
+        /**
+         * @brief  Builds the moves for a footprint
+         * @param footprint The corners of the footprint in cells, about the middle of the robot
+         * @param scale The moves of the table are made this many times longer
+         * @param min_radius Moves that turn tighter than this, in cells, are left out
+         * @return The number of moves that turn
+         */
+        int setPrimitives(const std::vector<std::pair<double, double> >& footprint, int scale, double min_radius);
+
+        /**
+         * @brief  Sets the costs of the moves, length * (1 + cost * factor / neutral_cost), times turn_penalty if it turns
+         */
+        void setCosts(unsigned char neutral_cost, float factor, float turn_penalty, bool unknown);
+
+        /**
+         * @brief  Sets how close to the end a path has to get, in cells and radians
+         */
+        void setTolerance(double xy_tolerance, double yaw_tolerance) {
+            xy_tolerance_ = xy_tolerance;
+            yaw_tolerance_ = yaw_tolerance;
+        }
+
+        void setMaxExpansions(int max_expansions) {
+            max_expansions_ = max_expansions;
+        }
+
+        /**
+         * @brief  Searches a path from the start pose to one near the end pose
+         * @param path Filled with the poses from the start to the end, in cells from the middle of cell 0, 0
+         * @return True if a path was found
+         */
+        bool findPath(const unsigned char* costs, int nx, int ny, double start_x, double start_y, double start_yaw,
+                      double end_x, double end_y, double end_yaw, std::vector<LatticePose>& path);
+
+        static double getHeadingAngle(int heading);
+
+        static int getHeading(double yaw);
+
+    private:
+        /**
+         * @brief  Follows a move and collects the cells the footprint sweeps over
+         * @return False if it turns tighter than min_radius
+         */
+        bool buildPrimitive(LatticePrimitive& p, const std::vector<std::pair<double, double> >& footprint,
+                            double min_radius);
+
+        /**
+         * @brief  Sets the offsets of the cells of the moves for a map this wide
+         */
+        void setOffsets(int nx);
+
+        /**
+         * @brief  The cost of a move from a cell, or -1 if the footprint hits an obstacle or leaves the map
+         */
+        float getPrimitiveCost(const LatticePrimitive& p, int x, int y, const unsigned char* costs, int nx, int ny);
+
+        std::vector<LatticePrimitive> primitives_;
+        std::vector<std::vector<int> > by_heading_; /**< the moves from every heading */
+        int offsets_nx_;
+
+        unsigned char neutral_cost_;
+        float factor_, turn_penalty_;
+        bool unknown_;
+        double xy_tolerance_, yaw_tolerance_;
+        int max_expansions_;
+
+        QuadraticCalculator h_calc_;
+        DijkstraExpansion* heuristic_;
+        std::vector<float> heuristic_potential_;
+
+        /** the states searched, a cell and heading each */
+        struct Node {
+                Node(long s, float c, int p, int m) :
+                        state(s), cost(c), parent(p), primitive(m) {
+                }
+                long state;
+                float cost;
+                int parent, primitive;
+        };
+        std::vector<Node> nodes_;
+        boost::unordered_map<long, int> node_index_;
+        std::vector<Index> queue_;
+};
+
+} //end namespace global_planner
+#endif
@@ -0,0 +1,91 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#ifndef _LATTICE_PLANNER_H
+#define _LATTICE_PLANNER_H
+
+#include <ros/ros.h>
+#include <costmap_2d/costmap_2d_ros.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <nav_core/base_global_planner.h>
+#include <boost/thread/mutex.hpp>
+#include <string>
+#include <vector>
+
+namespace global_planner {
+
+class Lattice;
+
+/**
+ * @class LatticePlanner
+ * @brief Plans paths a robot that can't turn on the spot can follow, on a lattice of moves between headings, with
+ * the footprint checked along every move
+ */
+class LatticePlanner : public nav_core::BaseGlobalPlanner {
+    public:
+        LatticePlanner();
+
+        LatticePlanner(std::string name, costmap_2d::Costmap2DROS* costmap_ros);
+
+        ~LatticePlanner();
+
+        /**
+         * @brief  Initialization function for the LatticePlanner object
+         * @param  name The name of this planner
+         * @param  costmap_ros A pointer to the ROS wrapper of the costmap to use for planning
+         */
+        void initialize(std::string name, costmap_2d::Costmap2DROS* costmap_ros);
+
+        /**
+         * @brief Given a goal pose in the world, compute a plan
+         * @param start The start pose
+         * @param goal The goal pose
+         * @param plan The plan... filled by the planner
+         * @return True if a valid plan was found, false otherwise
+         */
+        bool makePlan(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal,
+                      std::vector<geometry_msgs::PoseStamped>& plan);
+
+    private:
+        costmap_2d::Costmap2DROS* costmap_ros_;
+        Lattice* lattice_;
+        boost::mutex mutex_;
+        ros::Publisher plan_pub_;
+        bool initialized_;
+};
+
+} //end namespace global_planner
+
+#endif
@@ -0,0 +1,97 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#ifndef _PATH_SMOOTHER_H
+#define _PATH_SMOOTHER_H
+
+#include <utility>
+#include <vector>
+
+namespace global_planner {
+
+/**
+ * @brief  Shortens the paths of a Traceback by cutting corners where the costmap allows it.  From every point
+ * of the path the line to the furthest point that can be seen from it replaces the points in between, as long as
+ * none of the cells it crosses costs more than the highest cost of the cells the path went through.  Straight
+ * stretches become one long segment and turns keep their points, so the points left are spaced by the shape of
+ * the path.
+ */
+class PathSmoother {
+    public:
+        PathSmoother();
+
+        /**
+         * @brief  Sets the longest segment the path is shortened to, in cells
+         */
+        void setMaxSegment(float max_segment) {
+            max_segment_ = max_segment;
+        }
+
+        void setHasUnknown(bool unknown) {
+            unknown_ = unknown;
+        }
+
+        /**
+         * @brief  Shortens a path in place, its first and last point are kept
+         * @param costs The costmap
+         * @param offset What is added to a point of the path for the cell it is in
+         */
+        void smooth(const unsigned char* costs, int nx, int ny, float offset,
+                    std::vector<std::pair<float, float> >& path);
+
+    private:
+        /**
+         * @brief  The cost of the cell a point is in, more than any cost if it can't be crossed
+         */
+        int getCost(float x, float y);
+        int getCellCost(int mx, int my);
+
+        /**
+         * @brief  Whether the line between two points crosses no cell that costs more than limit
+         */
+        bool isClear(const std::pair<float, float>& a, const std::pair<float, float>& b, int limit);
+
+        float max_segment_;
+        bool unknown_;
+
+        const unsigned char* costs_;
+        int nx_, ny_;
+        float offset_;
+
+        std::vector<std::pair<float, float> > smoothed_;
+};
+
+} //end namespace global_planner
+#endif
@@ -38,9 +38,12 @@
  *         David V. Lu!!
  *********************************************************************/
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <ros/spinner.h>
 #include <costmap_2d/costmap_2d.h>
 #include <geometry_msgs/PoseStamped.h>
 #include <geometry_msgs/Point.h>
+#include <geometry_msgs/PolygonStamped.h>
 #include <nav_msgs/Path.h>
 #include <tf/transform_datatypes.h>
 #include <vector>
@@ -51,12 +54,21 @@
 #include <global_planner/expander.h>
 #include <global_planner/traceback.h>
 #include <global_planner/GlobalPlannerConfig.h>
+#include <navfn/MakeNavPlans.h>
+#include <navfn/MakeCostMatrix.h>
+#include <navfn/corridor.h>
+#include <navfn/plan_requests.h>
+#include <navfn/potential_publisher.h>
 
 #define POT_HIGH 1.0e10        // unassigned cell potential
 namespace global_planner {
 
 class Expander;
 class GridPath;
+class CoarseCostmap;
+class CostMatrix;
+class PathSmoother;
+class GoalCache;
 
 /**
  * @class PlannerCore
@@ -108,6 +120,48 @@ class GlobalPlanner : public nav_core::BaseGlobalPlanner {
         bool makePlan(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal, double tolerance,
                       std::vector<geometry_msgs::PoseStamped>& plan);
 
+        /**
+         * @brief Given many goal poses in the world, compute the plans to all of them from one navigation function
+         * @param start The start pose
+         * @param goals The goal poses, without tolerance
+         * @param costs Filled with the potential at every goal, the cost of getting there, or -1 if there is no plan
+         * @param plans If not NULL, filled with the plan to every goal, empty if there is none
+         * @return True if the navigation function was computed, false otherwise
+         */
+        bool makePlans(const geometry_msgs::PoseStamped& start, const std::vector<geometry_msgs::PoseStamped>& goals,
+                       std::vector<double>& costs, std::vector<std::vector<geometry_msgs::PoseStamped> >* plans);
+
+        /**
+         * @brief Compute the cost of getting from every start pose to every goal pose, on a copy of the costmap
+         * @param starts The start poses
+         * @param goals The goal poses, without tolerance
+         * @param costs Filled with the cost from start i to goal j at i * goals.size() + j, or -1 if there is no plan
+         * @return True if the costs were computed, false otherwise
+         */
+        bool makeCostMatrix(const std::vector<geometry_msgs::PoseStamped>& starts,
+                            const std::vector<geometry_msgs::PoseStamped>& goals, std::vector<double>& costs);
+
+        /**
+         * @brief  Restricts the search of the following plans to the cells within width / 2 of the lines between the
+         * waypoints, in the frame of the costmap.  If there is no plan within it the whole costmap is searched.
+         */
+        void setCorridor(const std::vector<geometry_msgs::Point>& waypoints, double width);
+
+        /**
+         * @brief  Restricts the search of the following plans to the inside of a polygon, in the frame of the costmap
+         */
+        void setCorridorPolygon(const std::vector<geometry_msgs::Point>& polygon);
+
+        void clearCorridor();
+
+        /**
+         * @brief  Keeps the potential of the whole map from a goal, in the frame of the costmap, so that plans to it
+         * are only a traceback.  It is computed again when the costs it depends on change.
+         */
+        void addCachedGoal(const geometry_msgs::Point& goal);
+
+        void clearCachedGoals();
+
         /**
          * @brief  Computes the full navigation function for the map given a point in the world to start from
          * @param world_point The point to use for seeding the navigation function
@@ -157,10 +211,31 @@ class GlobalPlanner : public nav_core::BaseGlobalPlanner {
         void publishPlan(const std::vector<geometry_msgs::PoseStamped>& path);
 
         ~GlobalPlanner() {
+            //no service call may still be using the planner once it is gone
+            if (service_spinner_)
+                service_spinner_->stop();
+            potential_publisher_.reset();
+            delete[] potential_array_;
+            delete coarse_;
+            delete corridor_;
+            delete cost_matrix_;
+            delete smoother_;
+            delete goal_cache_;
+            delete matrix_calc_;
+            if (field_planner_ != planner_)
+                delete field_planner_;
         }
 
+        /**
+         * @brief  Plans on a copy of the costmap with a planner of its own, without holding up makePlan(), see
+         * navfn::PlanRequests
+         */
         bool makePlanService(nav_msgs::GetPlan::Request& req, nav_msgs::GetPlan::Response& resp);
 
+        bool makePlansService(navfn::MakeNavPlans::Request& req, navfn::MakeNavPlans::Response& resp);
+
+        bool makeCostMatrixService(navfn::MakeCostMatrix::Request& req, navfn::MakeCostMatrix::Response& resp);
+
     protected:
 
         /**
@@ -175,24 +250,100 @@ class GlobalPlanner : public nav_core::BaseGlobalPlanner {
         void mapToWorld(double mx, double my, double& wx, double& wy);
         bool worldToMap(double wx, double wy, double& mx, double& my);
         void clearRobotCell(const tf::Stamped<tf::Pose>& global_pose, unsigned int mx, unsigned int my);
-        void publishPotential(float* potential);
+        /**
+         * @brief  Publishes the potential of a plan as a grid, on the thread of potential_publisher_
+         */
+        void publishPotential(const navfn::PotentialPublisher::Potential& potential);
+
+        /**
+         * @brief  Gets a copy of the costs within the corridor, lethal everywhere else
+         */
+        unsigned char* getCorridorCosts(const unsigned char* costs, int nx, int ny);
+
+        /**
+         * @brief  Runs the planner over the costs, all of them are rescanned by an incremental search if they
+         * or the costs of the last call are those of a corridor
+         */
+        bool calculatePotentials(unsigned char* costs, double start_x, double start_y, double goal_x, double goal_y,
+                                 int nx, int ny);
+
+        void corridorCB(const nav_msgs::Path::ConstPtr& path);
+        void corridorPolygonCB(const geometry_msgs::PolygonStamped::ConstPtr& polygon);
+
+        /**
+         * @brief  Smooths a path from the goal to the start, in cells, and turns it into a plan from the start
+         */
+        bool getPlanFromPath(std::vector<std::pair<float, float> >& path, const geometry_msgs::PoseStamped& goal,
+                             std::vector<geometry_msgs::PoseStamped>& plan);
+
+        /**
+         * @brief  Plans from the potential kept for a goal, if there is one and it reaches the start
+         */
+        bool getPlanFromCache(double start_x, double start_y, unsigned int start_x_i, unsigned int start_y_i,
+                              unsigned int goal_x_i, unsigned int goal_y_i, const geometry_msgs::PoseStamped& goal,
+                              std::vector<geometry_msgs::PoseStamped>& plan);
+
+        /**
+         * @brief  Adds a goal to the cache, in the cells of the costmap as it is now
+         */
+        void cacheGoal(const geometry_msgs::Point& goal);
+
+        /**
+         * @brief  Resizes the potential calculator, expanders, traceback and potential array to the costmap
+         */
+        void setSize(int nx, int ny);
+
+        /**
+         * @brief  Plans for a service call, with service_planner_ on a fresh copy of the costmap
+         */
+        bool makeServicePlan(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal,
+                             std::vector<geometry_msgs::PoseStamped>& plan);
 
         double planner_window_x_, planner_window_y_, default_tolerance_;
         std::string tf_prefix_;
         boost::mutex mutex_;
-        ros::ServiceServer make_plan_srv_;
+        ros::ServiceServer make_plan_srv_, make_plans_srv_, make_cost_matrix_srv_;
 
         PotentialCalculator* p_calc_;
         Expander* planner_;
+        Expander* field_planner_; /**< expands the whole map for computePotential(), the planner if it is Dijkstra */
         Traceback* path_maker_;
+        PathSmoother* smoother_; /**< NULL unless the paths are shortened before they are turned into plans */
+
+        CoarseCostmap* coarse_; /**< NULL unless planning through a coarse corridor first */
+        int coarse_corridor_; /**< blocks the corridor reaches beyond the coarse path */
+        navfn::Corridor* corridor_;
+        double corridor_width_; /**< width of the corridors given as a path */
+        std::vector<int> corridor_spans_;
+        std::vector<unsigned char> corridor_costs_;
+        bool corridor_costs_given_; /**< whether the planner was last given the costs of a corridor */
+        ros::Subscriber corridor_sub_, corridor_polygon_sub_;
+        costmap_2d::LayeredCostmap* layered_costmap_;
+
+        GoalCache* goal_cache_;
+        std::vector<geometry_msgs::Point> cached_goals_;
+        double cache_origin_x_, cache_origin_y_; /**< the origin of the costmap the goals of the cache are in cells of */
+
+        CostMatrix* cost_matrix_;
+        PotentialCalculator* matrix_calc_; /**< a calculator of its own, the cost matrix doesn't hold mutex_ */
+        boost::mutex matrix_mutex_;
+        std::vector<unsigned char> matrix_costs_; /**< the copy of the costmap the cost matrix is computed on */
+
+        bool service_worker_; /**< plans the service calls of another planner, without services or subscriptions of its own */
+        costmap_2d::Costmap2D service_costmap_;
+        boost::shared_ptr<GlobalPlanner> service_planner_;
+        boost::shared_ptr<navfn::PlanRequests> plan_requests_;
+        ros::CallbackQueue service_queue_; /**< the make_plan calls, they don't wait for the other callbacks */
+        boost::shared_ptr<ros::AsyncSpinner> service_spinner_;
 
         bool publish_potential_;
         ros::Publisher potential_pub_;
         int publish_scale_;
+        boost::shared_ptr<navfn::PotentialPublisher> potential_publisher_;
 
-        void outlineMap(unsigned char* costarr, int nx, int ny, unsigned char value);
         unsigned char* cost_array_;
         float* potential_array_;
+        int potential_size_;
         unsigned int start_x_, start_y_, end_x_, end_y_;
 
         bool old_navfn_behavior_;
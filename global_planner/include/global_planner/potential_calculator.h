@@ -37,6 +37,8 @@
  *********************************************************************/
 #ifndef _POTENTIAL_CALCULATOR_H
 #define _POTENTIAL_CALCULATOR_H
+#include <algorithm>
+
 namespace global_planner {
 
 class PotentialCalculator {
@@ -56,6 +58,29 @@ class PotentialCalculator {
             return prev_potential + cost;
         }
 
+        /**
+         * @brief  Calculates the potentials of a batch of cells, each as calculatePotential() without a previous
+         * potential would, all from the same potential array
+         * @param potential The potential array, which is not written
+         * @param costs The cost of every cell of the batch
+         * @param cells The indices of the cells of the batch
+         * @param count The number of cells in the batch
+         * @param out Set to the new potential of every cell of the batch
+         */
+        virtual void calculatePotentials(float* potential, const float* costs, const int* cells, int count,
+                                         float* out) {
+            for (int i = 0; i < count; i++)
+                out[i] = calculatePotential(potential, costs[i], cells[i]);
+        }
+
+        /**
+         * @brief  Whether calculatePotentials() is faster than calculatePotential() cell by cell, so expanders
+         * should hand over their cells in batches
+         */
+        virtual bool isBatched() const {
+            return false;
+        }
+
         /**
          * @brief  Sets or resets the size of the map
          * @param nx The x size of the map
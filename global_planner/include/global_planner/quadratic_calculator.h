@@ -49,6 +49,24 @@ class QuadraticCalculator : public PotentialCalculator {
         float calculatePotential(float* potential, unsigned char cost, int n, float prev_potential);
 };
 
+/**
+ * The quadratic update of QuadraticCalculator for batches of cells, four at a time with SSE2 where it is
+ * available.  The branches become masks, and the update is done in single precision, so the potentials may
+ * differ from QuadraticCalculator in the last bits.  An expander hands over a whole priority buffer at once, so
+ * its cells are updated from the potentials before the buffer rather than one after the other, see
+ * DijkstraExpansion::updateBand().
+ */
+class BatchQuadraticCalculator : public QuadraticCalculator {
+    public:
+        BatchQuadraticCalculator(int nx, int ny): QuadraticCalculator(nx,ny) {}
+
+        void calculatePotentials(float* potential, const float* costs, const int* cells, int count, float* out);
+
+        bool isBatched() const {
+            return true;
+        }
+};
+
 
 } //end namespace global_planner
 #endif
@@ -0,0 +1,132 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#ifndef _ROADMAP_H
+#define _ROADMAP_H
+
+#include <global_planner/astar.h>
+#include <costmap_2d/cost_values.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace global_planner {
+
+/**
+ * @brief  A sparse graph over the static costs for routes that are planned again and again.  Every block of
+ * spacing x spacing cells gets a node at its cheapest passable cell, and nodes are joined to those of the blocks
+ * around them by straight edges that only cross passable cells.  The edges are checked against the full costmap
+ * only once they are on a route, and routes are searched again without those found blocked.
+ */
+class Roadmap {
+    public:
+        Roadmap(int spacing);
+
+        /**
+         * @brief  Sets the costs the graph is built and searched with, it is built again if these change
+         */
+        void setCosts(unsigned char lethal_cost, unsigned char neutral_cost, float factor, bool unknown);
+
+        /**
+         * @brief  Brings the graph up to date with the static costs, only the blocks whose costs changed are built again
+         * @return True if the graph changed
+         */
+        bool update(const unsigned char* costs, int nx, int ny);
+
+        /**
+         * @brief  Writes the graph to a file
+         */
+        bool save(const std::string& filename) const;
+
+        /**
+         * @brief  Reads a graph written by save(), if it was built with the same settings from the same costs
+         */
+        bool load(const std::string& filename, const unsigned char* costs, int nx, int ny);
+
+        /**
+         * @brief  Searches the route between nodes near the start and the end cell
+         * @param costs The costs the edges of the route are checked against, of the same size as the static ones
+         * @param route Filled with the cells of the nodes from the start to the end
+         * @return True if a route was found
+         */
+        bool findRoute(const unsigned char* costs, int start_x, int start_y, int end_x, int end_y,
+                       std::vector<int>& route);
+
+        int getSpacing() const {
+            return spacing_;
+        }
+
+    private:
+        /**
+         * @brief  The cost a cell is passed with, unknown cells are the most expensive passable ones
+         * @return The cost, or -1 if it can't be passed
+         */
+        int getCellCost(unsigned char c) const {
+            if (c < lethal_cost_)
+                return c;
+            if (unknown_ && c == costmap_2d::NO_INFORMATION)
+                return lethal_cost_ - 1;
+            return -1;
+        }
+
+        /**
+         * @brief  The cost of the straight line between two cells, or -1 if it crosses a cell that can't be passed
+         */
+        float getLineCost(const unsigned char* costs, int from, int to) const;
+
+        void buildNode(int b);
+        void buildEdges(int b);
+        uint64_t checksum(const unsigned char* costs, int n) const;
+
+        int spacing_;
+        int nx_, ny_; /**< size of the static costs */
+        int bx_, by_; /**< size of the grid of blocks */
+        unsigned char lethal_cost_, neutral_cost_;
+        float factor_;
+        bool unknown_, stale_;
+
+        std::vector<unsigned char> costs_; /**< the static costs the graph was built from */
+        std::vector<int> nodes_; /**< cell of the node of every block, -1 if the block is blocked */
+        std::vector<float> edges_; /**< cost of edge k of block b at b * EDGES + k, -1 if there is none */
+
+        std::vector<unsigned char> blocked_; /**< edges found blocked by the search of a route */
+        std::vector<int> blocked_list_;
+        std::vector<float> cost_;
+        std::vector<int> parent_;
+        std::vector<Index> queue_;
+};
+
+} //end namespace global_planner
+#endif
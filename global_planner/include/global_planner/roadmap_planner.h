@@ -0,0 +1,113 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#ifndef _ROADMAP_PLANNER_H
+#define _ROADMAP_PLANNER_H
+
+#include <ros/ros.h>
+#include <costmap_2d/costmap_2d_ros.h>
+#include <costmap_2d/costmap_layer.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <nav_core/base_global_planner.h>
+#include <boost/thread/mutex.hpp>
+#include <string>
+#include <vector>
+
+namespace global_planner {
+
+class GlobalPlanner;
+class Roadmap;
+
+/**
+ * @class RoadmapPlanner
+ * @brief Plans on a roadmap built from the static layer of the costmap, and only plans the legs from the start onto
+ * it and from it to the goal on the grid.  The roadmap is built again where the static map changes, and kept in a
+ * file between runs if one is given.  Plans the whole way on the grid if there is no route on the roadmap.
+ */
+class RoadmapPlanner : public nav_core::BaseGlobalPlanner {
+    public:
+        RoadmapPlanner();
+
+        RoadmapPlanner(std::string name, costmap_2d::Costmap2DROS* costmap_ros);
+
+        ~RoadmapPlanner();
+
+        /**
+         * @brief  Initialization function for the RoadmapPlanner object
+         * @param  name The name of this planner
+         * @param  costmap_ros A pointer to the ROS wrapper of the costmap to use for planning
+         */
+        void initialize(std::string name, costmap_2d::Costmap2DROS* costmap_ros);
+
+        /**
+         * @brief Given a goal pose in the world, compute a plan
+         * @param start The start pose
+         * @param goal The goal pose
+         * @param plan The plan... filled by the planner
+         * @return True if a valid plan was found, false otherwise
+         */
+        bool makePlan(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal,
+                      std::vector<geometry_msgs::PoseStamped>& plan);
+
+    private:
+        /**
+         * @brief  Brings the roadmap up to date with the static layer, and saves it if it changed
+         * @return True if there is a roadmap to plan on
+         */
+        bool updateRoadmap();
+
+        /**
+         * @brief  Plans along the roadmap
+         * @return True if there is a route and both legs could be planned
+         */
+        bool makeRoutePlan(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal,
+                           std::vector<geometry_msgs::PoseStamped>& plan);
+
+        costmap_2d::Costmap2DROS* costmap_ros_;
+        costmap_2d::CostmapLayer* static_layer_; /**< NULL if the costmap has no static layer */
+        GlobalPlanner* leg_planner_; /**< plans the legs, and the whole way without a route */
+        Roadmap* roadmap_;
+        std::string cache_file_;
+        bool cache_checked_; /**< whether the cache file has been read, it is once there is a static map */
+        double min_distance_; /**< plans between poses closer than this are planned on the grid */
+        std::vector<int> route_;
+        boost::mutex mutex_;
+        ros::Publisher plan_pub_;
+        bool initialized_;
+};
+
+} //end namespace global_planner
+
+#endif
@@ -41,7 +41,16 @@
 namespace global_planner {
 
 AStarExpansion::AStarExpansion(PotentialCalculator* p_calc, int xs, int ys) :
-        Expander(p_calc, xs, ys) {
+        Expander(p_calc, xs, ys), bidirectional_(false) {
+    back_potential_.assign(ns_, POT_HIGH);
+}
+
+void AStarExpansion::setSize(int xs, int ys) {
+    if (xs == nx_ && ys == ny_)
+        return;
+    Expander::setSize(xs, ys);
+    back_potential_.assign(ns_, POT_HIGH);
+    back_touched_.clear();
 }
 
 bool AStarExpansion::calculatePotentials(unsigned char* costs, double start_x, double start_y, double end_x, double end_y,
@@ -50,16 +59,21 @@ bool AStarExpansion::calculatePotentials(unsigned char* costs, double start_x, d
     int start_i = toIndex(start_x, start_y);
     queue_.push_back(Index(start_i, 0));
 
-    std::fill(potential, potential + ns_, POT_HIGH);
+    resetPotentials(potential);
     potential[start_i] = 0;
+    touched_.push_back(start_i);
 
     int goal_i = toIndex(end_x, end_y);
-    int cycle = 0;
+    cells_visited_ = 0;
 
-    while (queue_.size() > 0 && cycle < cycles) {
+    if (bidirectional_)
+        return calculateBidirectional(costs, start_i, goal_i, cycles, potential);
+
+    while (queue_.size() > 0 && cells_visited_ < cycles) {
         Index top = queue_[0];
         std::pop_heap(queue_.begin(), queue_.end(), greater1());
         queue_.pop_back();
+        cells_visited_++;
 
         int i = top.i;
         if (i == goal_i)
@@ -79,10 +93,11 @@ void AStarExpansion::add(unsigned char* costs, float* potential, float prev_pote
     if (potential[next_i] < POT_HIGH)
         return;
 
-    if(costs[next_i]>=lethal_cost_ && !(unknown_ && costs[next_i]==costmap_2d::NO_INFORMATION))
+    if (!passable(costs, next_i))
         return;
 
     potential[next_i] = p_calc_->calculatePotential(potential, costs[next_i] + neutral_cost_, next_i, prev_potential);
+    touched_.push_back(next_i);
     int x = next_i % nx_, y = next_i / nx_;
     float distance = abs(end_x - x) + abs(end_y - y);
 
@@ -90,4 +105,95 @@ void AStarExpansion::add(unsigned char* costs, float* potential, float prev_pote
     std::push_heap(queue_.begin(), queue_.end(), greater1());
 }
 
+bool AStarExpansion::passable(unsigned char* costs, int n) {
+    if (onBorder(n))
+        return false;
+    return costs[n] < lethal_cost_ || (unknown_ && costs[n] == costmap_2d::NO_INFORMATION);
+}
+
+float AStarExpansion::octileDistance(int a, int b) {
+    int dx = abs(a % nx_ - b % nx_), dy = abs(a / nx_ - b / nx_);
+    return std::max(dx, dy) + 0.41421356f * std::min(dx, dy);
+}
+
+//
+// Searches from the start and from the goal in turns.  Once a cell is
+// reached by both, the path of the goal search from that cell down to the
+// goal is written into the potential array, rising on from the potential
+// of the start search there, so the traceback from the goal descends along
+// it into the start search.
+//
+bool AStarExpansion::calculateBidirectional(unsigned char* costs, int start_i, int goal_i, int cycles,
+                                            float* potential) {
+    for (unsigned int k = 0; k < back_touched_.size(); k++)
+        back_potential_[back_touched_[k]] = POT_HIGH;
+    back_touched_.clear();
+    back_queue_.clear();
+
+    if (start_i == goal_i)
+        return true;
+    if (!passable(costs, goal_i))
+        return false;
+
+    float* back = &back_potential_[0];
+    back[goal_i] = 0;
+    back_touched_.push_back(goal_i);
+    back_queue_.push_back(Index(goal_i, 0));
+
+    int meet_i = -1;
+    for (; meet_i < 0; cells_visited_++) {
+        if (cells_visited_ >= cycles || queue_.empty() || back_queue_.empty())
+            return false;
+        if (cells_visited_ % 2 == 0)
+            meet_i = expand(costs, potential, back, queue_, touched_, goal_i);
+        else
+            meet_i = expand(costs, back, potential, back_queue_, back_touched_, start_i);
+    }
+
+    // follow the goal search down from where they met
+    float joint = potential[meet_i] + back[meet_i];
+    int i = meet_i;
+    while (i != goal_i) {
+        int next = i;
+        int neighbors[4] = { i + 1, i - 1, i + nx_, i - nx_ };
+        for (int k = 0; k < 4; k++)
+            if (back[neighbors[k]] < back[next])
+                next = neighbors[k];
+        if (next == i)
+            return false;
+        i = next;
+
+        float pot = joint - back[i];
+        if (pot < potential[i]) {
+            if (potential[i] >= POT_HIGH)
+                touched_.push_back(i);
+            potential[i] = pot;
+        }
+    }
+    return true;
+}
+
+int AStarExpansion::expand(unsigned char* costs, float* potential, const float* other, std::vector<Index>& queue,
+                           std::vector<int>& touched, int target_i) {
+    int i = queue[0].i;
+    std::pop_heap(queue.begin(), queue.end(), greater1());
+    queue.pop_back();
+
+    int neighbors[4] = { i + 1, i - 1, i + nx_, i - nx_ };
+    for (int k = 0; k < 4; k++) {
+        int n = neighbors[k];
+        if (potential[n] < POT_HIGH || !passable(costs, n))
+            continue;
+
+        potential[n] = p_calc_->calculatePotential(potential, costs[n] + neutral_cost_, n, potential[i]);
+        touched.push_back(n);
+        if (other[n] < POT_HIGH)
+            return n;
+
+        queue.push_back(Index(n, potential[n] + octileDistance(n, target_i) * neutral_cost_));
+        std::push_heap(queue.begin(), queue.end(), greater1());
+    }
+    return -1;
+}
+
 } //end namespace global_planner
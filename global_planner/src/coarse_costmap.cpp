@@ -0,0 +1,200 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#include <global_planner/coarse_costmap.h>
+#include <costmap_2d/cost_values.h>
+#include <algorithm>
+#include <math.h>
+
+namespace global_planner {
+
+CoarseCostmap::CoarseCostmap(int factor) :
+        factor_(std::max(factor, 1)), nx_(0), ny_(0), bx_(0), by_(0), lethal_cost_(253), neutral_cost_(50),
+        unknown_(true), stale_(true) {
+}
+
+void CoarseCostmap::setCosts(unsigned char lethal_cost, unsigned char neutral_cost, bool unknown) {
+    if (lethal_cost == lethal_cost_ && neutral_cost == neutral_cost_ && unknown == unknown_)
+        return;
+    lethal_cost_ = lethal_cost;
+    neutral_cost_ = neutral_cost;
+    unknown_ = unknown;
+    stale_ = true;
+}
+
+void CoarseCostmap::update(const unsigned char* costs, int nx, int ny) {
+    if (nx != nx_ || ny != ny_) {
+        nx_ = nx;
+        ny_ = ny;
+        bx_ = (nx + factor_ - 1) / factor_;
+        by_ = (ny + factor_ - 1) / factor_;
+        blocks_.resize(bx_ * by_);
+        in_corridor_.assign(bx_ * by_, 0);
+        corridor_.clear();
+        copied_.clear();
+        corridor_costs_.assign(nx * ny, costmap_2d::LETHAL_OBSTACLE);
+    }
+    for (int b = 0; b < bx_ * by_; b++)
+        pool(costs, b);
+    stale_ = false;
+}
+
+void CoarseCostmap::update(const unsigned char* costs, int x0, int xn, int y0, int yn) {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    xn = std::min(xn, nx_);
+    yn = std::min(yn, ny_);
+    if (xn <= x0 || yn <= y0)
+        return;
+
+    for (int j = y0 / factor_; j <= (yn - 1) / factor_; j++)
+        for (int i = x0 / factor_; i <= (xn - 1) / factor_; i++)
+            pool(costs, i + j * bx_);
+}
+
+void CoarseCostmap::pool(const unsigned char* costs, int b) {
+    int x0 = (b % bx_) * factor_, y0 = (b / bx_) * factor_;
+    int xn = std::min(x0 + factor_, nx_), yn = std::min(y0 + factor_, ny_);
+
+    // unknown cells count as the most expensive passable ones
+    int cost = -1;
+    for (int y = y0; y < yn; y++) {
+        const unsigned char* row = costs + y * nx_;
+        for (int x = x0; x < xn; x++) {
+            unsigned char c = row[x];
+            if (c < lethal_cost_)
+                cost = std::max(cost, (int) c);
+            else if (unknown_ && c == costmap_2d::NO_INFORMATION)
+                cost = std::max(cost, lethal_cost_ - 1);
+        }
+    }
+    blocks_[b] = cost < 0 ? lethal_cost_ : cost;
+}
+
+bool CoarseCostmap::findCorridor(int start_x, int start_y, int end_x, int end_y, int width) {
+    for (unsigned int k = 0; k < corridor_.size(); k++)
+        in_corridor_[corridor_[k]] = 0;
+    corridor_.clear();
+    if (bx_ == 0 || by_ == 0)
+        return false;
+
+    int ns = bx_ * by_;
+    cost_.assign(ns, POT_HIGH);
+    parent_.assign(ns, -1);
+    queue_.clear();
+
+    int start_b = start_x / factor_ + (start_y / factor_) * bx_;
+    int end_b = end_x / factor_ + (end_y / factor_) * bx_;
+    int ex = end_b % bx_, ey = end_b / bx_;
+    float step = factor_ * neutral_cost_;
+
+    cost_[start_b] = 0;
+    queue_.push_back(Index(start_b, 0));
+    bool found = false;
+    while (!queue_.empty()) {
+        Index top = queue_[0];
+        std::pop_heap(queue_.begin(), queue_.end(), greater1());
+        queue_.pop_back();
+
+        int b = top.i;
+        if (b == end_b) {
+            found = true;
+            break;
+        }
+        int x = b % bx_, y = b / bx_;
+        int dx = abs(ex - x), dy = abs(ey - y);
+        if (top.cost > cost_[b] + (std::max(dx, dy) + 0.41421356f * std::min(dx, dy)) * step)
+            continue;
+
+        for (int j = std::max(y - 1, 0); j <= std::min(y + 1, by_ - 1); j++)
+            for (int i = std::max(x - 1, 0); i <= std::min(x + 1, bx_ - 1); i++) {
+                int n = i + j * bx_;
+                // the end block may be blocked and still hold the end cell, as the start block holds the start
+                if (n == b || (blocks_[n] >= lethal_cost_ && n != end_b))
+                    continue;
+
+                float c = factor_ * (float(blocks_[n] >= lethal_cost_ ? 0 : blocks_[n]) + neutral_cost_);
+                if (i != x && j != y)
+                    c *= 1.41421356f;
+                if (cost_[b] + c >= cost_[n])
+                    continue;
+                cost_[n] = cost_[b] + c;
+                parent_[n] = b;
+
+                int hx = abs(ex - i), hy = abs(ey - j);
+                queue_.push_back(Index(n, cost_[n] + (std::max(hx, hy) + 0.41421356f * std::min(hx, hy)) * step));
+                std::push_heap(queue_.begin(), queue_.end(), greater1());
+            }
+    }
+    if (!found)
+        return false;
+
+    for (int b = end_b; b >= 0; b = parent_[b]) {
+        int x = b % bx_, y = b / bx_;
+        for (int j = std::max(y - width, 0); j <= std::min(y + width, by_ - 1); j++)
+            for (int i = std::max(x - width, 0); i <= std::min(x + width, bx_ - 1); i++) {
+                int n = i + j * bx_;
+                if (!in_corridor_[n]) {
+                    in_corridor_[n] = 1;
+                    corridor_.push_back(n);
+                }
+            }
+    }
+    return true;
+}
+
+unsigned char* CoarseCostmap::getCorridorCosts(const unsigned char* costs) {
+    for (unsigned int k = 0; k < copied_.size(); k++)
+        if (!in_corridor_[copied_[k]])
+            fill(costs, copied_[k], false);
+    for (unsigned int k = 0; k < corridor_.size(); k++)
+        fill(costs, corridor_[k], true);
+    copied_ = corridor_;
+    return &corridor_costs_[0];
+}
+
+void CoarseCostmap::fill(const unsigned char* costs, int b, bool copy) {
+    int x0 = (b % bx_) * factor_, y0 = (b / bx_) * factor_;
+    int xn = std::min(x0 + factor_, nx_), yn = std::min(y0 + factor_, ny_);
+    for (int y = y0; y < yn; y++) {
+        unsigned char* row = &corridor_costs_[y * nx_];
+        if (copy)
+            std::copy(costs + y * nx_ + x0, costs + y * nx_ + xn, row + x0);
+        else
+            std::fill(row + x0, row + xn, costmap_2d::LETHAL_OBSTACLE);
+    }
+}
+
+} //end namespace global_planner
@@ -0,0 +1,121 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#include <global_planner/cost_matrix.h>
+#include <costmap_2d/executor.h>
+#include <boost/bind.hpp>
+#include <algorithm>
+
+namespace global_planner {
+
+CostMatrix::CostMatrix(PotentialCalculator* p_calc, unsigned int threads) :
+        p_calc_(p_calc), costs_(NULL), nx_(0), ny_(0), starts_(NULL), ends_(NULL), matrix_(NULL), next_start_(0) {
+    workspaces_.resize(std::max(threads, 1u));
+    for (unsigned int t = 0; t < workspaces_.size(); t++)
+        workspaces_[t].expander = new DijkstraExpansion(p_calc_, 0, 0);
+}
+
+CostMatrix::~CostMatrix() {
+    for (unsigned int t = 0; t < workspaces_.size(); t++)
+        delete workspaces_[t].expander;
+}
+
+void CostMatrix::setCosts(unsigned char lethal_cost, unsigned char neutral_cost, float factor, bool unknown) {
+    for (unsigned int t = 0; t < workspaces_.size(); t++) {
+        DijkstraExpansion* expander = workspaces_[t].expander;
+        expander->setLethalCost(lethal_cost);
+        expander->setNeutralCost(neutral_cost);
+        expander->setFactor(factor);
+        expander->setHasUnknown(unknown);
+    }
+}
+
+void CostMatrix::setPreciseStart(bool precise) {
+    for (unsigned int t = 0; t < workspaces_.size(); t++)
+        workspaces_[t].expander->setPreciseStart(precise);
+}
+
+void CostMatrix::compute(unsigned char* costs, int nx, int ny, const std::vector<std::pair<double, double> >& starts,
+                         const std::vector<int>& ends, std::vector<float>& matrix) {
+    matrix.assign(starts.size() * ends.size(), POT_HIGH);
+    if (starts.empty() || ends.empty())
+        return;
+
+    p_calc_->setSize(nx, ny);
+    unsigned int threads = std::min((unsigned int)workspaces_.size(), (unsigned int)starts.size());
+    for (unsigned int t = 0; t < threads; t++) {
+        workspaces_[t].expander->setSize(nx, ny);
+        workspaces_[t].potential.resize(nx * ny);
+    }
+
+    costs_ = costs;
+    nx_ = nx;
+    ny_ = ny;
+    starts_ = &starts;
+    ends_ = &ends;
+    matrix_ = &matrix;
+    next_start_ = 0;
+
+    costmap_2d::TaskGroup workers;
+    for (unsigned int t = 1; t < threads; t++)
+        workers.run(boost::bind(&CostMatrix::worker, this, &workspaces_[t]));
+    worker(&workspaces_[0]);
+    workers.wait();
+}
+
+void CostMatrix::worker(Workspace* workspace) {
+    float* potential = &workspace->potential[0];
+    unsigned int m = ends_->size();
+    while (true) {
+        unsigned int i;
+        {
+            boost::mutex::scoped_lock lock(start_mutex_);
+            i = next_start_++;
+        }
+        if (i >= starts_->size())
+            return;
+
+        //the end cell is on the edge of the map, which is never entered, so the whole map is expanded
+        const std::pair<double, double>& start = (*starts_)[i];
+        workspace->expander->calculatePotentials(costs_, start.first, start.second, 0, 0, nx_ * ny_ * 2, potential);
+
+        //every row is written by one thread only
+        float* row = &(*matrix_)[i * m];
+        for (unsigned int j = 0; j < m; j++)
+            row[j] = potential[(*ends_)[j]];
+    }
+}
+
+} //end namespace global_planner
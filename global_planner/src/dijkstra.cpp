@@ -37,22 +37,80 @@
  *********************************************************************/
 #include<global_planner/dijkstra.h>
 #include <algorithm>
+#include <boost/bind.hpp>
+
+// priority buffers smaller than this are processed in order, the threads don't pay off
+#define PARALLEL_BAND 2048
+
+#define INVSQRT2 0.707106781
+
 namespace global_planner {
 
 DijkstraExpansion::DijkstraExpansion(PotentialCalculator* p_calc, int nx, int ny) :
-        Expander(p_calc, nx, ny), pending_(NULL), precise_(false) {
+        Expander(p_calc, nx, ny), pending_(NULL), precise_(false), threads_(1), barrier_(NULL), stopping_(false),
+        band_costs_(NULL), band_potential_(NULL), band_parts_(1) {
     // priority buffers
-    buffer1_ = new int[PRIORITYBUFSIZE];
-    buffer2_ = new int[PRIORITYBUFSIZE];
-    buffer3_ = new int[PRIORITYBUFSIZE];
+    currentBuffer_ = new int[PRIORITYBUFSIZE];
+    nextBuffer_ = new int[PRIORITYBUFSIZE];
+    overBuffer_ = new int[PRIORITYBUFSIZE];
+    currentSize_ = nextSize_ = overSize_ = PRIORITYBUFSIZE;
+    band_next_.resize(1);
+    band_over_.resize(1);
 
     priorityIncrement_ = 2 * neutral_cost_;
 }
 
+DijkstraExpansion::~DijkstraExpansion() {
+    stopWorkers();
+    delete[] currentBuffer_;
+    delete[] nextBuffer_;
+    delete[] overBuffer_;
+    delete[] pending_;
+}
+
+void DijkstraExpansion::setThreads(unsigned int threads) {
+    threads = std::max(threads, 1u);
+    if (threads == threads_)
+        return;
+    stopWorkers();
+    threads_ = threads;
+    band_next_.resize(threads);
+    band_over_.resize(threads);
+    if (threads == 1)
+        return;
+
+    // the calling thread takes the first part of the buffer
+    barrier_ = new boost::barrier(threads);
+    for (unsigned int t = 1; t < threads; t++)
+        workers_.create_thread(boost::bind(&DijkstraExpansion::bandWorker, this, t));
+}
+
+void DijkstraExpansion::stopWorkers() {
+    if (!barrier_)
+        return;
+    stopping_ = true;
+    barrier_->wait();
+    workers_.join_all();
+    delete barrier_;
+    barrier_ = NULL;
+    stopping_ = false;
+}
+
+void DijkstraExpansion::bandWorker(unsigned int t) {
+    while (true) {
+        barrier_->wait();
+        if (stopping_)
+            return;
+        bandStep(t);
+    }
+}
+
 //
 // Set/Reset map size
 //
 void DijkstraExpansion::setSize(int xs, int ys) {
+    if (pending_ && xs == nx_ && ys == ny_)
+        return;
     Expander::setSize(xs, ys);
     if (pending_)
         delete[] pending_;
@@ -61,6 +119,19 @@ void DijkstraExpansion::setSize(int xs, int ys) {
     memset(pending_, 0, ns_ * sizeof(bool));
 }
 
+void DijkstraExpansion::setCostTable() {
+    for (int v = 0; v < 256; v++) {
+        float c = v;
+        if (c < lethal_cost_ - 1 || (unknown_ && v == 255)) {
+            c = c * factor_ + neutral_cost_;
+            if (c >= lethal_cost_)
+                c = lethal_cost_ - 1;
+            cost_table_[v] = c;
+        } else
+            cost_table_[v] = lethal_cost_;
+    }
+}
+
 //
 // main propagation function
 // Dijkstra method, breadth-first
@@ -72,13 +143,11 @@ void DijkstraExpansion::setSize(int xs, int ys) {
 bool DijkstraExpansion::calculatePotentials(unsigned char* costs, double start_x, double start_y, double end_x, double end_y,
                                            int cycles, float* potential) {
     cells_visited_ = 0;
+    setCostTable();
     // priority buffers
     threshold_ = lethal_cost_;
-    currentBuffer_ = buffer1_;
     currentEnd_ = 0;
-    nextBuffer_ = buffer2_;
     nextEnd_ = 0;
-    overBuffer_ = buffer3_;
     overEnd_ = 0;
     memset(pending_, 0, ns_ * sizeof(bool));
     std::fill(potential, potential + ns_, POT_HIGH);
@@ -137,11 +206,17 @@ bool DijkstraExpansion::calculatePotentials(unsigned char* costs, double start_x
         while (i-- > 0)
             pending_[*(pb++)] = false;
 
-        // process current priority buffer
-        pb = currentBuffer_;
-        i = currentEnd_;
-        while (i-- > 0)
-            updateCell(costs, potential, *pb++);
+        // process current priority buffer, in batches if the calculator takes them
+        if (barrier_ && currentEnd_ >= PARALLEL_BAND)
+            updateBand(costs, potential, true);
+        else if (p_calc_->isBatched())
+            updateBand(costs, potential, false);
+        else {
+            pb = currentBuffer_;
+            i = currentEnd_;
+            while (i-- > 0)
+                updateCell(costs, potential, *pb++);
+        }
 
         // swap priority blocks currentBuffer_ <=> nextBuffer_
         currentEnd_ = nextEnd_;
@@ -149,6 +224,7 @@ bool DijkstraExpansion::calculatePotentials(unsigned char* costs, double start_x
         pb = currentBuffer_;        // swap buffers
         currentBuffer_ = nextBuffer_;
         nextBuffer_ = pb;
+        std::swap(currentSize_, nextSize_);
 
         // see if we're done with this priority level
         if (currentEnd_ == 0) {
@@ -158,6 +234,7 @@ bool DijkstraExpansion::calculatePotentials(unsigned char* costs, double start_x
             pb = currentBuffer_;        // swap buffers
             currentBuffer_ = overBuffer_;
             overBuffer_ = pb;
+            std::swap(currentSize_, overSize_);
         }
 
         // check if we've hit the Start cell
@@ -171,6 +248,105 @@ bool DijkstraExpansion::calculatePotentials(unsigned char* costs, double start_x
         return false;
 }
 
+//
+// Process the current priority buffer on the threads: all the new potentials
+// are computed from the old ones first, then written, and only then is it
+// decided which neighbors to push, so the threads never write a cell another
+// one reads.  Every cell is in the buffer once, so no two threads write the
+// same cell either.  Without the threads the calling thread takes the whole
+// buffer the same way, which lets a batched calculator take it in one go.
+//
+void DijkstraExpansion::updateBand(unsigned char* costs, float* potential, bool parallel) {
+    band_costs_ = costs;
+    band_potential_ = potential;
+    band_pot_.resize(currentEnd_);
+    band_cost_.resize(currentEnd_);
+    band_parts_ = parallel ? threads_ : 1;
+    cells_visited_ += currentEnd_;
+
+    bandSync();
+    bandStep(0);
+
+    // the pushes in the order of the buffer, as if its cells had been updated one after the other
+    for (unsigned int t = 0; t < band_parts_; t++) {
+        for (unsigned int k = 0; k < band_next_[t].size(); k++)
+            push_next(band_next_[t][k]);
+        for (unsigned int k = 0; k < band_over_[t].size(); k++)
+            push_over(band_over_[t][k]);
+    }
+}
+
+void DijkstraExpansion::bandSync() {
+    if (band_parts_ > 1)
+        barrier_->wait();
+}
+
+void DijkstraExpansion::bandStep(unsigned int t) {
+    unsigned char* costs = band_costs_;
+    float* potential = band_potential_;
+    int begin = (long)currentEnd_ * t / band_parts_, end = (long)currentEnd_ * (t + 1) / band_parts_;
+
+    if (p_calc_->isBatched()) {
+        for (int i = begin; i < end; i++)
+            band_cost_[i] = getCost(costs, currentBuffer_[i]);
+        if (begin < end)
+            p_calc_->calculatePotentials(potential, &band_cost_[begin], currentBuffer_ + begin, end - begin,
+                                         &band_pot_[begin]);
+        for (int i = begin; i < end; i++)
+            if (band_cost_[i] >= lethal_cost_)
+                band_pot_[i] = POT_HIGH;
+    } else {
+        for (int i = begin; i < end; i++) {
+            int n = currentBuffer_[i];
+            float c = getCost(costs, n);
+            band_pot_[i] = c >= lethal_cost_ ? POT_HIGH : p_calc_->calculatePotential(potential, c, n);
+        }
+    }
+    bandSync();
+
+    for (int i = begin; i < end; i++) {
+        int n = currentBuffer_[i];
+        if (band_pot_[i] < potential[n])
+            potential[n] = band_pot_[i];
+        else
+            band_pot_[i] = -1;
+    }
+    bandSync();
+
+    std::vector<int>& next = band_next_[t];
+    std::vector<int>& over = band_over_[t];
+    next.clear();
+    over.clear();
+    for (int i = begin; i < end; i++) {
+        float pot = band_pot_[i];
+        if (pot < 0)
+            continue;
+        int n = currentBuffer_[i];
+        std::vector<int>& pushed = pot < threshold_ ? next : over;
+        if (potential[n - 1] > pot + INVSQRT2 * getCost(costs, n - 1))
+            pushed.push_back(n - 1);
+        if (potential[n + 1] > pot + INVSQRT2 * getCost(costs, n + 1))
+            pushed.push_back(n + 1);
+        if (potential[n - nx_] > pot + INVSQRT2 * getCost(costs, n - nx_))
+            pushed.push_back(n - nx_);
+        if (potential[n + nx_] > pot + INVSQRT2 * getCost(costs, n + nx_))
+            pushed.push_back(n + nx_);
+    }
+    bandSync();
+}
+
+//
+// Grow a priority buffer; a cell is in a buffer at most once, so none
+// grows beyond the size of the map, and they keep their size between plans
+//
+void DijkstraExpansion::growBuffer(int*& buffer, int& size) {
+    int* grown = new int[2 * size];
+    std::copy(buffer, buffer + size, grown);
+    delete[] buffer;
+    buffer = grown;
+    size *= 2;
+}
+
 //
 // Critical function: calculate updated potential value of a cell,
 //   given its neighbors' values
@@ -179,8 +355,6 @@ bool DijkstraExpansion::calculatePotentials(unsigned char* costs, double start_x
 // No checking of bounds here, this function should be fast
 //
 
-#define INVSQRT2 0.707106781
-
 inline void DijkstraExpansion::updateCell(unsigned char* costs, float* potential, int n) {
     cells_visited_++;
 
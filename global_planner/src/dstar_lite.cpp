@@ -0,0 +1,279 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#include <global_planner/dstar_lite.h>
+
+namespace global_planner {
+
+DStarLiteExpansion::DStarLiteExpansion(PotentialCalculator* p_calc, int xs, int ys) :
+        Expander(p_calc, xs, ys), costs_(NULL), end_i_(-1), last_start_(0), km_(0), last_lethal_(0),
+        last_neutral_(0), last_unknown_(false), bounds_given_(false) {
+    g_.assign(ns_, POT_HIGH);
+    rhs_.assign(ns_, POT_HIGH);
+}
+
+void DStarLiteExpansion::setSize(int xs, int ys) {
+    if (xs == nx_ && ys == ny_)
+        return;
+    Expander::setSize(xs, ys);
+    g_.assign(ns_, POT_HIGH);
+    rhs_.assign(ns_, POT_HIGH);
+    search_touched_.clear();
+    queue_.clear();
+    last_costs_.clear();
+    end_i_ = -1;
+}
+
+void DStarLiteExpansion::setChangedBounds(int x0, int xn, int y0, int yn) {
+    // bounds given for a plan that never ran, e.g. one served from a cache, still have to be repaired
+    if (bounds_given_) {
+        x0_ = std::min(x0_, x0);
+        xn_ = std::max(xn_, xn);
+        y0_ = std::min(y0_, y0);
+        yn_ = std::max(yn_, yn);
+    } else {
+        x0_ = x0;
+        xn_ = xn;
+        y0_ = y0;
+        yn_ = yn;
+    }
+    bounds_given_ = true;
+}
+
+bool DStarLiteExpansion::calculatePotentials(unsigned char* costs, double start_x, double start_y, double end_x,
+                                             double end_y, int cycles, float* potential) {
+    resetPotentials(potential);
+    cells_visited_ = 0;
+    costs_ = costs;
+    int start_i = toIndex(start_x, start_y);
+    int end_i = toIndex(end_x, end_y);
+
+    if (!passable(end_i)) {
+        reset();
+        return false;
+    }
+
+    if (end_i != end_i_ || int(last_costs_.size()) != ns_ || lethal_cost_ != last_lethal_
+            || neutral_cost_ != last_neutral_ || unknown_ != last_unknown_) {
+        reset();
+        end_i_ = end_i;
+        last_start_ = start_i;
+        km_ = 0;
+        last_lethal_ = lethal_cost_;
+        last_neutral_ = neutral_cost_;
+        last_unknown_ = unknown_;
+        last_costs_.assign(costs, costs + ns_);
+
+        rhs_[end_i] = 0;
+        search_touched_.push_back(end_i);
+        queue_.push_back(key(end_i));
+    } else {
+        // the keys already queued stay valid lower bounds as the start moves
+        km_ += heuristic(last_start_, start_i);
+        last_start_ = start_i;
+        // without bounds any cell may have changed
+        if (!bounds_given_)
+            setChangedBounds(0, nx_, 0, ny_);
+        applyChanges(start_i);
+    }
+    bounds_given_ = false;
+
+    if (!computeShortestPath(start_i, cycles) || rhs_[start_i] >= POT_HIGH)
+        return false;
+    return setPath(potential, start_i);
+}
+
+void DStarLiteExpansion::reset() {
+    for (unsigned int k = 0; k < search_touched_.size(); k++) {
+        g_[search_touched_[k]] = POT_HIGH;
+        rhs_[search_touched_[k]] = POT_HIGH;
+    }
+    search_touched_.clear();
+    queue_.clear();
+    end_i_ = -1;
+}
+
+float DStarLiteExpansion::heuristic(int a, int b) {
+    // octile distance, the moves are 8-connected and cost at least the neutral cost
+    int dx = abs(a % nx_ - b % nx_), dy = abs(a / nx_ - b / nx_);
+    return (std::max(dx, dy) + 0.41421356f * std::min(dx, dy)) * neutral_cost_;
+}
+
+DStarLiteExpansion::Entry DStarLiteExpansion::key(int n) {
+    float k2 = std::min(g_[n], rhs_[n]);
+    return Entry(n, k2 + heuristic(last_start_, n) + km_, k2);
+}
+
+void DStarLiteExpansion::updateVertex(int n) {
+    int x = n % nx_, y = n / nx_;
+    if (x == 0 || y == 0 || x == nx_ - 1 || y == ny_ - 1)
+        return;
+
+    if (n != end_i_) {
+        float rhs = POT_HIGH;
+        if (passable(n)) {
+            for (int dy = -1; dy <= 1; dy++)
+                for (int dx = -1; dx <= 1; dx++) {
+                    int m = n + dx + dy * nx_;
+                    if ((dx == 0 && dy == 0) || g_[m] >= POT_HIGH || !passable(m))
+                        continue;
+                    float cost = costs_[m] + neutral_cost_;
+                    if (dx != 0 && dy != 0) {
+                        // no cutting of corners
+                        if (!passable(n + dx) || !passable(n + dy * nx_))
+                            continue;
+                        cost *= 1.41421356f;
+                    }
+                    rhs = std::min(rhs, g_[m] + cost);
+                }
+        }
+        if (rhs_[n] >= POT_HIGH && g_[n] >= POT_HIGH && rhs < POT_HIGH)
+            search_touched_.push_back(n);
+        rhs_[n] = rhs;
+    }
+
+    if (g_[n] != rhs_[n]) {
+        queue_.push_back(key(n));
+        std::push_heap(queue_.begin(), queue_.end(), greaterEntry());
+    }
+}
+
+void DStarLiteExpansion::applyChanges(int start_i) {
+    int x0 = std::max(x0_, 0), xn = std::min(xn_, nx_);
+    int y0 = std::max(y0_, 0), yn = std::min(yn_, ny_);
+
+    // the planner clears the start cell in the costmap itself, no bounds cover it
+    int sx = start_i % nx_, sy = start_i / nx_;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int y = y0; y < yn; y++)
+            for (int x = x0; x < xn; x++) {
+                int n = x + y * nx_;
+                if (costs_[n] == last_costs_[n])
+                    continue;
+                last_costs_[n] = costs_[n];
+
+                // the cells next to it may move into it or past its corner
+                for (int dy = -1; dy <= 1; dy++)
+                    for (int dx = -1; dx <= 1; dx++)
+                        if (x + dx >= 0 && x + dx < nx_ && y + dy >= 0 && y + dy < ny_)
+                            updateVertex(n + dx + dy * nx_);
+            }
+        x0 = std::max(sx - 1, 0);
+        xn = std::min(sx + 2, nx_);
+        y0 = std::max(sy - 1, 0);
+        yn = std::min(sy + 2, ny_);
+    }
+}
+
+bool DStarLiteExpansion::computeShortestPath(int start_i, int cycles) {
+    greaterEntry greater;
+    while (!queue_.empty()) {
+        Entry top = queue_[0];
+        Entry start_key = key(start_i);
+        if (!greater(start_key, top) && rhs_[start_i] <= g_[start_i])
+            return true;
+        if (cells_visited_++ >= cycles)
+            return false;
+
+        std::pop_heap(queue_.begin(), queue_.end(), greater);
+        queue_.pop_back();
+
+        // a cell may be queued more than once, only its last entry counts
+        int n = top.i;
+        if (g_[n] == rhs_[n])
+            continue;
+        Entry now = key(n);
+        if (greater(now, top)) {
+            queue_.push_back(now);
+            std::push_heap(queue_.begin(), queue_.end(), greater);
+            continue;
+        }
+
+        if (g_[n] > rhs_[n]) {
+            g_[n] = rhs_[n];
+        } else {
+            g_[n] = POT_HIGH;
+            updateVertex(n);
+        }
+        for (int dy = -1; dy <= 1; dy++)
+            for (int dx = -1; dx <= 1; dx++)
+                if (dx != 0 || dy != 0)
+                    updateVertex(n + dx + dy * nx_);
+    }
+    return true;
+}
+
+bool DStarLiteExpansion::setPath(float* potential, int start_i) {
+    float pot = 0;
+    int i = start_i;
+    for (int steps = 0; i != end_i_; steps++) {
+        if (potential[i] >= POT_HIGH)
+            touched_.push_back(i);
+        potential[i] = pot;
+        if (steps >= ns_)
+            return false;
+
+        // the neighbour the cost of this cell came from
+        int next = -1;
+        float best = POT_HIGH, best_cost = 0;
+        for (int dy = -1; dy <= 1; dy++)
+            for (int dx = -1; dx <= 1; dx++) {
+                int m = i + dx + dy * nx_;
+                if ((dx == 0 && dy == 0) || g_[m] >= POT_HIGH || !passable(m))
+                    continue;
+                float cost = costs_[m] + neutral_cost_;
+                if (dx != 0 && dy != 0) {
+                    if (!passable(i + dx) || !passable(i + dy * nx_))
+                        continue;
+                    cost *= 1.41421356f;
+                }
+                if (g_[m] + cost < best) {
+                    best = g_[m] + cost;
+                    best_cost = cost;
+                    next = m;
+                }
+            }
+        if (next < 0)
+            return false;
+        pot += best_cost;
+        i = next;
+    }
+    if (potential[i] >= POT_HIGH)
+        touched_.push_back(i);
+    potential[i] = pot;
+    return true;
+}
+
+} //end namespace global_planner
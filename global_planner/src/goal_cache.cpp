@@ -0,0 +1,105 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#include <global_planner/goal_cache.h>
+#include <algorithm>
+#include <math.h>
+
+namespace global_planner {
+
+// the potential of a cell depends on those of the cells next to it, and the traceback looks at their neighbours
+#define CHANGE_MARGIN 2
+
+void GoalCache::addGoal(double x, double y, int cell_x, int cell_y) {
+    if (findGoal(cell_x, cell_y) >= 0)
+        return;
+    Field field;
+    field.x = x;
+    field.y = y;
+    field.cell_x = cell_x;
+    field.cell_y = cell_y;
+    field.good_below = -1;
+    goals_.push_back(field);
+}
+
+int GoalCache::findGoal(int cell_x, int cell_y) const {
+    for (unsigned int i = 0; i < goals_.size(); i++)
+        if (goals_[i].cell_x == cell_x && goals_[i].cell_y == cell_y)
+            return i;
+    return -1;
+}
+
+void GoalCache::setChangedBounds(int x0, int xn, int y0, int yn) {
+    x0 = std::max(x0 - CHANGE_MARGIN, 0);
+    y0 = std::max(y0 - CHANGE_MARGIN, 0);
+    xn = std::min(xn + CHANGE_MARGIN, nx_);
+    yn = std::min(yn + CHANGE_MARGIN, ny_);
+    if (xn <= x0 || yn <= y0)
+        return;
+
+    //a path from the goal to a cell of lower potential than any of these can't have gone through a changed cell,
+    //and one through them now is no shorter
+    for (unsigned int i = 0; i < goals_.size(); i++) {
+        Field& field = goals_[i];
+        if (field.good_below < 0)
+            continue;
+        float lowest = field.good_below;
+        for (int y = y0; y < yn; y++) {
+            const float* row = &field.potential[y * nx_];
+            lowest = std::min(lowest, *std::min_element(row + x0, row + xn));
+        }
+        field.good_below = lowest;
+    }
+}
+
+float* GoalCache::getPotential(int goal, unsigned char* costs, int nx, int ny, int start_x, int start_y) {
+    if (nx != nx_ || ny != ny_) {
+        reset();
+        nx_ = nx;
+        ny_ = ny;
+    }
+
+    Field& field = goals_[goal];
+    int start = start_x + start_y * nx;
+    if (field.good_below < 0 || field.potential[start] >= field.good_below) {
+        field.potential.resize(nx * ny);
+        //the end cell is on the edge of the map, which is never entered, so the whole map is expanded
+        expander_->calculatePotentials(costs, field.x, field.y, 0, 0, nx * ny * 2, &field.potential[0]);
+        field.good_below = POT_HIGH;
+    }
+    return field.potential[start] < POT_HIGH ? &field.potential[0] : NULL;
+}
+
+} //end namespace global_planner
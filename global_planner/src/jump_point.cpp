@@ -0,0 +1,241 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#include <global_planner/jump_point.h>
+
+namespace global_planner {
+
+JumpPointExpansion::JumpPointExpansion(PotentialCalculator* p_calc, int xs, int ys) :
+        Expander(p_calc, xs, ys), costs_(NULL), end_i_(0) {
+    cost_.assign(ns_, POT_HIGH);
+    parent_.assign(ns_, -1);
+    closed_.assign(ns_, false);
+}
+
+void JumpPointExpansion::setSize(int xs, int ys) {
+    if (xs == nx_ && ys == ny_)
+        return;
+    Expander::setSize(xs, ys);
+    cost_.assign(ns_, POT_HIGH);
+    parent_.assign(ns_, -1);
+    closed_.assign(ns_, false);
+    search_touched_.clear();
+}
+
+bool JumpPointExpansion::calculatePotentials(unsigned char* costs, double start_x, double start_y, double end_x,
+                                             double end_y, int cycles, float* potential) {
+    resetPotentials(potential);
+    for (unsigned int k = 0; k < search_touched_.size(); k++) {
+        int n = search_touched_[k];
+        cost_[n] = POT_HIGH;
+        parent_[n] = -1;
+        closed_[n] = false;
+    }
+    search_touched_.clear();
+    queue_.clear();
+    cells_visited_ = 0;
+
+    costs_ = costs;
+    int start_i = toIndex(start_x, start_y);
+    end_i_ = toIndex(end_x, end_y);
+
+    cost_[start_i] = 0;
+    search_touched_.push_back(start_i);
+    queue_.push_back(Index(start_i, 0));
+
+    while (queue_.size() > 0 && cells_visited_ < cycles) {
+        Index top = queue_[0];
+        std::pop_heap(queue_.begin(), queue_.end(), greater1());
+        queue_.pop_back();
+
+        // cells are queued again when a cheaper way to them is found
+        int i = top.i;
+        if (closed_[i])
+            continue;
+        closed_[i] = true;
+        cells_visited_++;
+
+        if (i == end_i_) {
+            setPath(potential, start_i, end_i_);
+            return true;
+        }
+        expand(i);
+    }
+
+    return false;
+}
+
+void JumpPointExpansion::relax(int n, float cost, int parent) {
+    if (closed_[n] || cost >= cost_[n])
+        return;
+    if (cost_[n] >= POT_HIGH)
+        search_touched_.push_back(n);
+    cost_[n] = cost;
+    parent_[n] = parent;
+
+    // octile distance, the moves are 8-connected
+    int dx = abs(n % nx_ - end_i_ % nx_), dy = abs(n / nx_ - end_i_ / nx_);
+    float distance = std::max(dx, dy) + 0.41421356f * std::min(dx, dy);
+
+    queue_.push_back(Index(n, cost + distance * neutral_cost_));
+    std::push_heap(queue_.begin(), queue_.end(), greater1());
+}
+
+void JumpPointExpansion::expand(int i) {
+    // the pruning only holds where every passable neighbour is free
+    bool uniform = free(i);
+    for (int dy = -1; dy <= 1 && uniform; dy++)
+        for (int dx = -1; dx <= 1 && uniform; dx++) {
+            int n = i + dx + dy * nx_;
+            if (passable(n) && !free(n))
+                uniform = false;
+        }
+
+    int dirs[8][2], count = 0;
+    int p = parent_[i];
+    if (!uniform || p < 0) {
+        for (int dy = -1; dy <= 1; dy++)
+            for (int dx = -1; dx <= 1; dx++)
+                if (dx != 0 || dy != 0) {
+                    dirs[count][0] = dx;
+                    dirs[count][1] = dy;
+                    count++;
+                }
+    } else {
+        int dx = (i % nx_ > p % nx_) - (i % nx_ < p % nx_);
+        int dy = (i / nx_ > p / nx_) - (i / nx_ < p / nx_);
+        if (dx != 0 && dy != 0) {
+            bool vertical = free(i + dy * nx_), horizontal = free(i + dx);
+            if (vertical) {
+                dirs[count][0] = 0; dirs[count][1] = dy; count++;
+            }
+            if (horizontal) {
+                dirs[count][0] = dx; dirs[count][1] = 0; count++;
+            }
+            if (vertical && horizontal) {
+                dirs[count][0] = dx; dirs[count][1] = dy; count++;
+            }
+        } else {
+            // the two sides of a straight move
+            int sx = dy != 0, sy = dx != 0;
+            bool next = free(i + dx + dy * nx_);
+            bool side1 = free(i + sx + sy * nx_), side2 = free(i - sx - sy * nx_);
+            if (next) {
+                dirs[count][0] = dx; dirs[count][1] = dy; count++;
+                if (side1) {
+                    dirs[count][0] = dx + sx; dirs[count][1] = dy + sy; count++;
+                }
+                if (side2) {
+                    dirs[count][0] = dx - sx; dirs[count][1] = dy - sy; count++;
+                }
+            }
+            if (side1) {
+                dirs[count][0] = sx; dirs[count][1] = sy; count++;
+            }
+            if (side2) {
+                dirs[count][0] = -sx; dirs[count][1] = -sy; count++;
+            }
+        }
+    }
+
+    for (int k = 0; k < count; k++) {
+        int dx = dirs[k][0], dy = dirs[k][1];
+        int n;
+        if (uniform)
+            n = jump(i, dx, dy);
+        else if (dx != 0 && dy != 0 && (!passable(i + dx) || !passable(i + dy * nx_)))
+            n = -1;
+        else
+            n = passable(i + dx + dy * nx_) ? i + dx + dy * nx_ : -1;
+        if (n < 0)
+            continue;
+
+        // the cells before the last one of a jump are free
+        int steps = std::max(abs(n % nx_ - i % nx_), abs(n / nx_ - i / nx_));
+        float cost = (steps - 1) * neutral_cost_ + costs_[n] + neutral_cost_;
+        if (dx != 0 && dy != 0)
+            cost *= 1.41421356f;
+        relax(n, cost_[i] + cost, i);
+    }
+}
+
+int JumpPointExpansion::jump(int i, int dx, int dy) {
+    int step = dx + dy * nx_;
+    while (true) {
+        // no cutting of corners
+        if (dx != 0 && dy != 0 && (!free(i + dx) || !free(i + dy * nx_)))
+            return -1;
+        int n = i + step;
+        if (!passable(n))
+            return -1;
+        if (n == end_i_ || !free(n))
+            return n;
+
+        // stop where a neighbour would not be reached as cheaply any other way
+        if (dx != 0 && dy != 0) {
+            if (jump(n, dx, 0) >= 0 || jump(n, 0, dy) >= 0)
+                return n;
+        } else if (dx != 0) {
+            if ((free(n + nx_) && !free(n - dx + nx_)) || (free(n - nx_) && !free(n - dx - nx_)))
+                return n;
+        } else {
+            if ((free(n + 1) && !free(n + 1 - step)) || (free(n - 1) && !free(n - 1 - step)))
+                return n;
+        }
+        i = n;
+    }
+}
+
+void JumpPointExpansion::setPath(float* potential, int start_i, int end_i) {
+    // the path is a chain of straight and diagonal runs between the queued cells
+    for (int i = end_i; i != start_i; i = parent_[i]) {
+        int p = parent_[i];
+        int dx = (i % nx_ > p % nx_) - (i % nx_ < p % nx_);
+        int dy = (i / nx_ > p / nx_) - (i / nx_ < p / nx_);
+        int steps = std::max(abs(i % nx_ - p % nx_), abs(i / nx_ - p / nx_));
+        for (int k = 0; k < steps; k++) {
+            int n = i - k * (dx + dy * nx_);
+            float pot = cost_[p] + (cost_[i] - cost_[p]) * (steps - k) / steps;
+            if (potential[n] >= POT_HIGH)
+                touched_.push_back(n);
+            potential[n] = std::min(potential[n], pot);
+        }
+    }
+    if (potential[start_i] >= POT_HIGH)
+        touched_.push_back(start_i);
+    potential[start_i] = 0;
+}
+
+} //end namespace global_planner
@@ -0,0 +1,347 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#include <global_planner/lattice.h>
+#include <costmap_2d/cost_values.h>
+#include <algorithm>
+#include <set>
+#include <math.h>
+
+namespace global_planner {
+
+enum {
+    HEADINGS = 16, MOVES = 4
+};
+
+// the directions of the headings of the first quarter, the others are turned by right angles; every straight move
+// ends in the middle of a cell
+static const int DIRECTION[4][2] = { { 1, 0 }, { 2, 1 }, { 1, 1 }, { 1, 2 } };
+
+// the moves from the headings of the first quarter: the cell they end in and the change of heading
+static const int MOVE[4][MOVES][3] = {
+    { { 1, 0, 0 }, { 8, 0, 0 }, { 8, 1, 1 }, { 8, -1, -1 } },
+    { { 2, 1, 0 }, { 6, 3, 0 }, { 5, 4, 1 }, { 7, 2, -1 } },
+    { { 1, 1, 0 }, { 6, 6, 0 }, { 4, 5, 1 }, { 5, 4, -1 } },
+    { { 1, 2, 0 }, { 3, 6, 0 }, { 2, 7, 1 }, { 4, 5, -1 } } };
+
+// the moves are followed in steps of at most a quarter of a cell
+#define SAMPLE_STEP 0.25
+
+static void rotate(int quarter, int x, int y, int& rx, int& ry) {
+    rx = x;
+    ry = y;
+    for (int q = 0; q < quarter; q++) {
+        int t = rx;
+        rx = -ry;
+        ry = t;
+    }
+}
+
+static double angleDiff(double a, double b) {
+    double d = fmod(a - b, 2 * M_PI);
+    if (d > M_PI)
+        d -= 2 * M_PI;
+    else if (d < -M_PI)
+        d += 2 * M_PI;
+    return fabs(d);
+}
+
+double Lattice::getHeadingAngle(int heading) {
+    int x, y;
+    rotate(heading / 4, DIRECTION[heading % 4][0], DIRECTION[heading % 4][1], x, y);
+    return atan2((double) y, (double) x);
+}
+
+int Lattice::getHeading(double yaw) {
+    int best = 0;
+    for (int h = 1; h < HEADINGS; h++)
+        if (angleDiff(yaw, getHeadingAngle(h)) < angleDiff(yaw, getHeadingAngle(best)))
+            best = h;
+    return best;
+}
+
+Lattice::Lattice() :
+        offsets_nx_(0), neutral_cost_(50), factor_(3.0), turn_penalty_(1.0), unknown_(false), xy_tolerance_(0.0),
+        yaw_tolerance_(M_PI), max_expansions_(1000000), h_calc_(0, 0), heuristic_(NULL) {
+    heuristic_ = new DijkstraExpansion(&h_calc_, 0, 0);
+}
+
+Lattice::~Lattice() {
+    delete heuristic_;
+}
+
+void Lattice::setCosts(unsigned char neutral_cost, float factor, float turn_penalty, bool unknown) {
+    neutral_cost_ = neutral_cost;
+    factor_ = factor;
+    turn_penalty_ = turn_penalty;
+    unknown_ = unknown;
+    heuristic_->setNeutralCost(neutral_cost);
+    heuristic_->setFactor(factor);
+    heuristic_->setHasUnknown(unknown);
+}
+
+int Lattice::setPrimitives(const std::vector<std::pair<double, double> >& footprint, int scale, double min_radius) {
+    primitives_.clear();
+    by_heading_.assign(HEADINGS, std::vector<int>());
+    offsets_nx_ = 0;
+    scale = std::max(scale, 1);
+
+    int turns = 0;
+    for (int h = 0; h < HEADINGS; h++)
+        for (int m = 0; m < MOVES; m++) {
+            LatticePrimitive p;
+            p.start_heading = h;
+            p.end_heading = (h + MOVE[h % 4][m][2] + HEADINGS) % HEADINGS;
+            rotate(h / 4, MOVE[h % 4][m][0] * scale, MOVE[h % 4][m][1] * scale, p.dx, p.dy);
+            p.turn = p.end_heading != h;
+            if (!buildPrimitive(p, footprint, min_radius))
+                continue;
+            by_heading_[h].push_back(primitives_.size());
+            primitives_.push_back(p);
+            turns += p.turn;
+        }
+    return turns;
+}
+
+bool Lattice::buildPrimitive(LatticePrimitive& p, const std::vector<std::pair<double, double> >& footprint,
+                             double min_radius) {
+    // a cubic from the start to the end with the tangents of both headings, a straight line if they are the same
+    double a0 = getHeadingAngle(p.start_heading), a1 = getHeadingAngle(p.end_heading);
+    double chord = hypot(p.dx, p.dy);
+    double m0x = chord * cos(a0), m0y = chord * sin(a0), m1x = chord * cos(a1), m1y = chord * sin(a1);
+    int steps = std::max((int) ceil(chord / SAMPLE_STEP), 1);
+
+    std::set<std::pair<int, int> > swept, center;
+    p.poses.clear();
+    p.length = 0;
+    double last_x = 0, last_y = 0;
+    for (int s = 0; s <= steps; s++) {
+        double t = (double) s / steps, t2 = t * t, t3 = t2 * t;
+        double x = (t3 - 2 * t2 + t) * m0x + (-2 * t3 + 3 * t2) * p.dx + (t3 - t2) * m1x;
+        double y = (t3 - 2 * t2 + t) * m0y + (-2 * t3 + 3 * t2) * p.dy + (t3 - t2) * m1y;
+        double vx = (3 * t2 - 4 * t + 1) * m0x + (-6 * t2 + 6 * t) * p.dx + (3 * t2 - 2 * t) * m1x;
+        double vy = (3 * t2 - 4 * t + 1) * m0y + (-6 * t2 + 6 * t) * p.dy + (3 * t2 - 2 * t) * m1y;
+        double ax = (6 * t - 4) * m0x + (-12 * t + 6) * p.dx + (6 * t - 2) * m1x;
+        double ay = (6 * t - 4) * m0y + (-12 * t + 6) * p.dy + (6 * t - 2) * m1y;
+        double speed = hypot(vx, vy);
+        if (min_radius > 0 && fabs(vx * ay - vy * ax) > speed * speed * speed / min_radius)
+            return false;
+        double theta = s == steps ? a1 : atan2(vy, vx);
+
+        p.length += hypot(x - last_x, y - last_y);
+        last_x = x;
+        last_y = y;
+        // a pose about every cell
+        if (s == steps || (s > 0 && s % (int) (1 / SAMPLE_STEP) == 0))
+            p.poses.push_back(LatticePose(x, y, theta));
+        center.insert(std::make_pair((int) floor(x + 0.5), (int) floor(y + 0.5)));
+
+        // the cells of the footprint, those its edges cross and those with their middle inside of it
+        double c = cos(theta), sn = sin(theta);
+        std::vector<double> fx(footprint.size()), fy(footprint.size());
+        double x0 = HUGE_VAL, x1 = -HUGE_VAL, y0 = HUGE_VAL, y1 = -HUGE_VAL;
+        for (unsigned int i = 0; i < footprint.size(); i++) {
+            fx[i] = x + c * footprint[i].first - sn * footprint[i].second;
+            fy[i] = y + sn * footprint[i].first + c * footprint[i].second;
+            x0 = std::min(x0, fx[i]);
+            x1 = std::max(x1, fx[i]);
+            y0 = std::min(y0, fy[i]);
+            y1 = std::max(y1, fy[i]);
+        }
+        for (unsigned int i = 0, j = footprint.size() - 1; i < footprint.size(); j = i++) {
+            int edge_steps = std::max((int) ceil(hypot(fx[i] - fx[j], fy[i] - fy[j]) / SAMPLE_STEP), 1);
+            for (int e = 0; e <= edge_steps; e++) {
+                double ex = fx[j] + (fx[i] - fx[j]) * e / edge_steps, ey = fy[j] + (fy[i] - fy[j]) * e / edge_steps;
+                swept.insert(std::make_pair((int) floor(ex + 0.5), (int) floor(ey + 0.5)));
+            }
+        }
+        for (int j = (int) ceil(y0); j <= (int) floor(y1); j++)
+            for (int i = (int) ceil(x0); i <= (int) floor(x1); i++) {
+                bool inside = false;
+                for (unsigned int k = 0, l = footprint.size() - 1; k < footprint.size(); l = k++)
+                    if ((fy[k] <= j) != (fy[l] <= j)
+                            && i < fx[k] + (j - fy[k]) * (fx[l] - fx[k]) / (fy[l] - fy[k]))
+                        inside = !inside;
+                if (inside)
+                    swept.insert(std::make_pair(i, j));
+            }
+    }
+    // the middle passes the cells the footprint sweeps, they have to be checked without a footprint too
+    swept.insert(center.begin(), center.end());
+
+    p.swept.assign(swept.begin(), swept.end());
+    p.center.assign(center.begin(), center.end());
+    p.min_x = p.max_x = p.min_y = p.max_y = 0;
+    for (unsigned int i = 0; i < p.swept.size(); i++) {
+        p.min_x = std::min(p.min_x, p.swept[i].first);
+        p.max_x = std::max(p.max_x, p.swept[i].first);
+        p.min_y = std::min(p.min_y, p.swept[i].second);
+        p.max_y = std::max(p.max_y, p.swept[i].second);
+    }
+    return true;
+}
+
+void Lattice::setOffsets(int nx) {
+    if (nx == offsets_nx_)
+        return;
+    for (unsigned int k = 0; k < primitives_.size(); k++) {
+        LatticePrimitive& p = primitives_[k];
+        p.swept_offsets.resize(p.swept.size());
+        for (unsigned int i = 0; i < p.swept.size(); i++)
+            p.swept_offsets[i] = p.swept[i].first + p.swept[i].second * nx;
+        p.center_offsets.resize(p.center.size());
+        for (unsigned int i = 0; i < p.center.size(); i++)
+            p.center_offsets[i] = p.center[i].first + p.center[i].second * nx;
+    }
+    offsets_nx_ = nx;
+}
+
+float Lattice::getPrimitiveCost(const LatticePrimitive& p, int x, int y, const unsigned char* costs, int nx,
+                                int ny) {
+    if (x + p.min_x < 0 || y + p.min_y < 0 || x + p.max_x >= nx || y + p.max_y >= ny)
+        return -1;
+
+    // the footprint only hits what is lethal itself, being close to it is in the costs of the middle
+    const unsigned char* at = costs + x + y * nx;
+    for (unsigned int i = 0; i < p.swept_offsets.size(); i++) {
+        unsigned char c = at[p.swept_offsets[i]];
+        if (c == costmap_2d::LETHAL_OBSTACLE || (c == costmap_2d::NO_INFORMATION && !unknown_))
+            return -1;
+    }
+    float sum = 0;
+    for (unsigned int i = 0; i < p.center_offsets.size(); i++) {
+        unsigned char c = at[p.center_offsets[i]];
+        sum += c == costmap_2d::NO_INFORMATION ? costmap_2d::INSCRIBED_INFLATED_OBSTACLE - 1 : c;
+    }
+    float cost = p.length * (1 + sum / p.center_offsets.size() * factor_ / neutral_cost_);
+    return p.turn ? cost * turn_penalty_ : cost;
+}
+
+bool Lattice::findPath(const unsigned char* costs, int nx, int ny, double start_x, double start_y, double start_yaw,
+                       double end_x, double end_y, double end_yaw, std::vector<LatticePose>& path) {
+    path.clear();
+    int sx = (int) floor(start_x + 0.5), sy = (int) floor(start_y + 0.5);
+    int ex = (int) floor(end_x + 0.5), ey = (int) floor(end_y + 0.5);
+    if (primitives_.empty() || sx < 0 || sy < 0 || ex < 0 || ey < 0 || sx >= nx || sy >= ny || ex >= nx || ey >= ny)
+        return false;
+    setOffsets(nx);
+
+    // the potential from the end, in the units of the moves; cells it didn't reach fall back on the distance
+    heuristic_->setSize(nx, ny);
+    h_calc_.setSize(nx, ny);
+    if (heuristic_potential_.size() != (size_t)nx * ny) {
+        heuristic_potential_.resize((size_t)nx * ny);
+        heuristic_->forgetPotentials();
+    }
+    heuristic_->calculatePotentials(const_cast<unsigned char*>(costs), ex, ey, sx, sy, nx * ny * 2,
+                                    &heuristic_potential_[0]);
+
+    nodes_.clear();
+    node_index_.clear();
+    queue_.clear();
+
+    int start_heading = getHeading(start_yaw);
+    long start = ((long) sx + (long) sy * nx) * HEADINGS + start_heading;
+    nodes_.push_back(Node(start, 0, -1, -1));
+    node_index_[start] = 0;
+    queue_.push_back(Index(0, 0));
+
+    int found = -1;
+    for (int expansions = 0; !queue_.empty() && expansions < max_expansions_; expansions++) {
+        Index top = queue_[0];
+        std::pop_heap(queue_.begin(), queue_.end(), greater1());
+        queue_.pop_back();
+
+        Node node = nodes_[top.i];
+        int cell = node.state / HEADINGS, heading = node.state % HEADINGS;
+        int x = cell % nx, y = cell / nx;
+        float h = heuristic_potential_[cell] < POT_HIGH ? heuristic_potential_[cell] / neutral_cost_ : hypot(x - ex, y - ey);
+        if (top.cost > node.cost + h)
+            continue;
+
+        if (hypot(x - end_x, y - end_y) <= xy_tolerance_ + 0.5
+                && angleDiff(getHeadingAngle(heading), end_yaw) <= yaw_tolerance_) {
+            found = top.i;
+            break;
+        }
+
+        for (unsigned int k = 0; k < by_heading_[heading].size(); k++) {
+            int m = by_heading_[heading][k];
+            const LatticePrimitive& p = primitives_[m];
+            float c = getPrimitiveCost(p, x, y, costs, nx, ny);
+            if (c < 0)
+                continue;
+            int n = cell + p.dx + p.dy * nx;
+            long state = (long) n * HEADINGS + p.end_heading;
+            float cost = node.cost + c;
+
+            boost::unordered_map<long, int>::iterator it = node_index_.find(state);
+            int i;
+            if (it == node_index_.end()) {
+                i = nodes_.size();
+                nodes_.push_back(Node(state, cost, top.i, m));
+                node_index_[state] = i;
+            } else {
+                i = it->second;
+                if (cost >= nodes_[i].cost)
+                    continue;
+                nodes_[i].cost = cost;
+                nodes_[i].parent = top.i;
+                nodes_[i].primitive = m;
+            }
+            float hn = heuristic_potential_[n] < POT_HIGH ? heuristic_potential_[n] / neutral_cost_ :
+                    hypot(n % nx - ex, n / nx - ey);
+            queue_.push_back(Index(i, cost + hn));
+            std::push_heap(queue_.begin(), queue_.end(), greater1());
+        }
+    }
+    if (found < 0)
+        return false;
+
+    std::vector<int> chain;
+    for (int i = found; i >= 0; i = nodes_[i].parent)
+        chain.push_back(i);
+    path.push_back(LatticePose(sx, sy, getHeadingAngle(start_heading)));
+    for (int k = chain.size() - 2; k >= 0; k--) {
+        const Node& from = nodes_[chain[k + 1]];
+        const LatticePrimitive& p = primitives_[nodes_[chain[k]].primitive];
+        int cell = from.state / HEADINGS;
+        for (unsigned int i = 0; i < p.poses.size(); i++)
+            path.push_back(LatticePose(cell % nx + p.poses[i].x, cell / nx + p.poses[i].y, p.poses[i].theta));
+    }
+    return true;
+}
+
+} //end namespace global_planner
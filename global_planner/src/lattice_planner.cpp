@@ -0,0 +1,159 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#include <global_planner/lattice_planner.h>
+#include <global_planner/lattice.h>
+#include <pluginlib/class_list_macros.h>
+#include <nav_msgs/Path.h>
+#include <tf/tf.h>
+#include <tf/transform_datatypes.h>
+#include <math.h>
+
+//register this planner as a BaseGlobalPlanner plugin
+PLUGINLIB_EXPORT_CLASS(global_planner::LatticePlanner, nav_core::BaseGlobalPlanner)
+
+namespace global_planner {
+
+LatticePlanner::LatticePlanner() :
+        costmap_ros_(NULL), lattice_(NULL), initialized_(false) {
+}
+
+LatticePlanner::LatticePlanner(std::string name, costmap_2d::Costmap2DROS* costmap_ros) :
+        costmap_ros_(NULL), lattice_(NULL), initialized_(false) {
+    initialize(name, costmap_ros);
+}
+
+LatticePlanner::~LatticePlanner() {
+    delete lattice_;
+}
+
+void LatticePlanner::initialize(std::string name, costmap_2d::Costmap2DROS* costmap_ros) {
+    if (initialized_) {
+        ROS_WARN("This planner has already been initialized, you can't call it twice, doing nothing");
+        return;
+    }
+    ros::NodeHandle private_nh("~/" + name);
+    costmap_ros_ = costmap_ros;
+    double resolution = costmap_ros->getCostmap()->getResolution();
+
+    int scale, neutral_cost, max_expansions;
+    double min_radius, cost_factor, turn_penalty, xy_tolerance, yaw_tolerance;
+    bool allow_unknown;
+    private_nh.param("primitive_scale", scale, 1);
+    private_nh.param("min_turning_radius", min_radius, 0.0);
+    private_nh.param("neutral_cost", neutral_cost, 50);
+    private_nh.param("cost_factor", cost_factor, 3.0);
+    private_nh.param("turn_penalty", turn_penalty, 1.2);
+    private_nh.param("allow_unknown", allow_unknown, false);
+    private_nh.param("xy_goal_tolerance", xy_tolerance, 2 * resolution);
+    private_nh.param("yaw_goal_tolerance", yaw_tolerance, M_PI / 8);
+    private_nh.param("max_expansions", max_expansions, 1000000);
+
+    //the moves are the same wherever the robot is, so the cells they sweep over are only worked out once
+    std::vector<geometry_msgs::Point> robot_footprint = costmap_ros->getRobotFootprint();
+    std::vector<std::pair<double, double> > footprint;
+    for (unsigned int i = 0; i < robot_footprint.size(); i++)
+        footprint.push_back(std::make_pair(robot_footprint[i].x / resolution, robot_footprint[i].y / resolution));
+
+    lattice_ = new Lattice();
+    lattice_->setCosts(neutral_cost, cost_factor, turn_penalty, allow_unknown);
+    lattice_->setTolerance(xy_tolerance / resolution, yaw_tolerance);
+    lattice_->setMaxExpansions(max_expansions);
+    if (!lattice_->setPrimitives(footprint, scale, min_radius / resolution))
+        ROS_WARN("None of the moves of the lattice turn as wide as min_turning_radius, only straight paths are found");
+
+    plan_pub_ = private_nh.advertise<nav_msgs::Path>("plan", 1);
+    initialized_ = true;
+}
+
+bool LatticePlanner::makePlan(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal,
+                              std::vector<geometry_msgs::PoseStamped>& plan) {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (!initialized_) {
+        ROS_ERROR(
+                "This planner has not been initialized yet, but it is being used, please call initialize() before use");
+        return false;
+    }
+    plan.clear();
+
+    std::string global_frame = costmap_ros_->getGlobalFrameID();
+    if (tf::resolve("", goal.header.frame_id) != tf::resolve("", global_frame)
+            || tf::resolve("", start.header.frame_id) != tf::resolve("", global_frame)) {
+        ROS_ERROR("The start and goal must be in the %s frame", global_frame.c_str());
+        return false;
+    }
+
+    //the lattice is in cells from the middle of the first one
+    costmap_2d::Costmap2D* costmap = costmap_ros_->getCostmap();
+    double resolution = costmap->getResolution(), origin_x = costmap->getOriginX(), origin_y = costmap->getOriginY();
+    double start_x = (start.pose.position.x - origin_x) / resolution - 0.5;
+    double start_y = (start.pose.position.y - origin_y) / resolution - 0.5;
+    double goal_x = (goal.pose.position.x - origin_x) / resolution - 0.5;
+    double goal_y = (goal.pose.position.y - origin_y) / resolution - 0.5;
+
+    std::vector<LatticePose> path;
+    bool found;
+    {
+        boost::shared_lock<boost::shared_mutex> costmap_lock(*(costmap->getLock()));
+        found = lattice_->findPath(costmap->getCharMap(), costmap->getSizeInCellsX(), costmap->getSizeInCellsY(),
+                                   start_x, start_y, tf::getYaw(start.pose.orientation), goal_x, goal_y,
+                                   tf::getYaw(goal.pose.orientation), path);
+    }
+    if (!found) {
+        ROS_ERROR("Failed to find a path on the lattice");
+        return false;
+    }
+
+    ros::Time plan_time = ros::Time::now();
+    for (unsigned int i = 0; i < path.size(); i++) {
+        geometry_msgs::PoseStamped pose;
+        pose.header.stamp = plan_time;
+        pose.header.frame_id = global_frame;
+        pose.pose.position.x = (path[i].x + 0.5) * resolution + origin_x;
+        pose.pose.position.y = (path[i].y + 0.5) * resolution + origin_y;
+        pose.pose.orientation = tf::createQuaternionMsgFromYaw(path[i].theta);
+        plan.push_back(pose);
+    }
+    //the lattice only gets close to the goal, the last pose is made the goal itself
+    plan.back().pose = goal.pose;
+
+    nav_msgs::Path gui_path;
+    gui_path.header = plan[0].header;
+    gui_path.poses = plan;
+    plan_pub_.publish(gui_path);
+    return true;
+}
+
+} //end namespace global_planner
@@ -0,0 +1,126 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#include <global_planner/path_smoother.h>
+#include <costmap_2d/cost_values.h>
+#include <algorithm>
+#include <math.h>
+
+namespace global_planner {
+
+PathSmoother::PathSmoother() :
+        max_segment_(20.0), unknown_(true), costs_(NULL), nx_(0), ny_(0), offset_(0.0) {
+}
+
+int PathSmoother::getCost(float x, float y) {
+    return getCellCost((int)floor(x + offset_), (int)floor(y + offset_));
+}
+
+int PathSmoother::getCellCost(int mx, int my) {
+    if (mx < 0 || my < 0 || mx >= nx_ || my >= ny_)
+        return costmap_2d::NO_INFORMATION + 1;
+
+    unsigned char c = costs_[mx + my * nx_];
+    if (c < costmap_2d::INSCRIBED_INFLATED_OBSTACLE)
+        return c;
+    if (c == costmap_2d::NO_INFORMATION && unknown_)
+        return costmap_2d::INSCRIBED_INFLATED_OBSTACLE - 1;
+    return costmap_2d::NO_INFORMATION + 1;
+}
+
+bool PathSmoother::isClear(const std::pair<float, float>& a, const std::pair<float, float>& b, int limit) {
+    // every cell the line goes through, and both cells beside a corner it passes exactly
+    float x0 = a.first + offset_, y0 = a.second + offset_;
+    float dx = b.first - a.first, dy = b.second - a.second;
+    int x = (int)floor(x0), y = (int)floor(y0);
+    int x1 = (int)floor(b.first + offset_), y1 = (int)floor(b.second + offset_);
+    int sx = dx > 0 ? 1 : -1, sy = dy > 0 ? 1 : -1;
+    float next_x = dx ? ((dx > 0 ? x + 1 : x) - x0) / dx : 2, next_y = dy ? ((dy > 0 ? y + 1 : y) - y0) / dy : 2;
+    float step_x = dx ? 1.0 / fabs(dx) : 0, step_y = dy ? 1.0 / fabs(dy) : 0;
+    while (x != x1 || y != y1) {
+        if (next_x > 1 && next_y > 1)
+            break;
+        if (next_x == next_y) {
+            if (getCellCost(x + sx, y) > limit || getCellCost(x, y + sy) > limit)
+                return false;
+            x += sx;
+            y += sy;
+            next_x += step_x;
+            next_y += step_y;
+        } else if (next_x < next_y) {
+            x += sx;
+            next_x += step_x;
+        } else {
+            y += sy;
+            next_y += step_y;
+        }
+        if (getCellCost(x, y) > limit)
+            return false;
+    }
+    return true;
+}
+
+void PathSmoother::smooth(const unsigned char* costs, int nx, int ny, float offset,
+                          std::vector<std::pair<float, float> >& path) {
+    if (path.size() < 3)
+        return;
+    costs_ = costs;
+    nx_ = nx;
+    ny_ = ny;
+    offset_ = offset;
+
+    smoothed_.clear();
+    smoothed_.push_back(path[0]);
+    unsigned int i = 0;
+    while (i < path.size() - 1) {
+        //the furthest point the line from i can go to, the points are tried in order until one can't be seen
+        unsigned int best = i + 1;
+        int limit = std::max(getCost(path[i].first, path[i].second), getCost(path[best].first, path[best].second));
+        for (unsigned int k = i + 2; k < path.size(); k++) {
+            limit = std::max(limit, getCost(path[k].first, path[k].second));
+            if (limit > costmap_2d::NO_INFORMATION)
+                break;
+            float dx = path[k].first - path[i].first, dy = path[k].second - path[i].second;
+            if (hypot(dx, dy) > max_segment_ || !isClear(path[i], path[k], limit))
+                break;
+            best = k;
+        }
+        smoothed_.push_back(path[best]);
+        i = best;
+    }
+    path.swap(smoothed_);
+}
+
+} //end namespace global_planner
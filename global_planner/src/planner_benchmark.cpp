@@ -0,0 +1,377 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+//
+// Plans between the start and goal cells given in a file on a PGM costmap,
+// with each of the planners named on the command line, and reports how long
+// the plans took, how many cells were expanded for them and how long the
+// paths are.  Every planner runs in a process of its own, so that the peak
+// memory reported for it is its own.
+//
+//   planner_benchmark [-r] [-n repeats] [-v] <costmap.pgm> <pairs> [planner ...]
+//
+// -r reads the costmap as a raw ROS costmap (see readPGM()).  Every line of
+// the pairs file is "start_x start_y goal_x goal_y" in cells, lines starting
+// with # are skipped.
+//
+#include <navfn/navfn.h>
+#include <navfn/read_pgm_costmap.h>
+#include <global_planner/quadratic_calculator.h>
+#include <global_planner/dijkstra.h>
+#include <global_planner/astar.h>
+#include <global_planner/jump_point.h>
+#include <global_planner/dstar_lite.h>
+#include <global_planner/gradient_path.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace global_planner {
+
+struct PlanPair {
+    int sx, sy, gx, gy;
+};
+
+struct BenchmarkResult {
+    int plans, found;
+    double ms;
+    double cells;
+    double length;
+};
+
+double get_ms() {
+    struct timeval t0;
+    gettimeofday(&t0, NULL);
+    return t0.tv_sec * 1000.0 + t0.tv_usec * 0.001;
+}
+
+double pathLength(const std::vector<std::pair<float, float> >& path) {
+    double length = 0;
+    for (unsigned int i = 1; i < path.size(); i++)
+        length += hypot(path[i].first - path[i - 1].first, path[i].second - path[i - 1].second);
+    return length;
+}
+
+class BenchmarkPlanner {
+    public:
+        virtual ~BenchmarkPlanner() {
+        }
+        virtual bool plan(const PlanPair& pair, std::vector<std::pair<float, float> >& path) = 0;
+        virtual int getCellsVisited() = 0;
+};
+
+//
+// NavFn as NavfnROS uses it: the propagation runs from the start of the
+// robot, until it reaches the goal the path is traced back from.
+//
+class NavfnBenchmark : public BenchmarkPlanner {
+    public:
+        NavfnBenchmark(unsigned char* costs, int nx, int ny, bool raw, bool astar) :
+                nav_(nx, ny), costs_(costs), raw_(raw), astar_(astar) {
+        }
+        bool plan(const PlanPair& pair, std::vector<std::pair<float, float> >& path) {
+            nav_.setCostmap(costs_, raw_, true);
+            int start[2] = { pair.gx, pair.gy };
+            int goal[2] = { pair.sx, pair.sy };
+            nav_.setStart(start);
+            nav_.setGoal(goal);
+            bool found = astar_ ? nav_.calcNavFnAstar() : nav_.calcNavFnDijkstra(true);
+
+            path.clear();
+            for (int i = 0; found && i < nav_.getPathLen(); i++)
+                path.push_back(std::make_pair(nav_.getPathX()[i], nav_.getPathY()[i]));
+            return found;
+        }
+        int getCellsVisited() {
+            return nav_.ncells;
+        }
+
+    private:
+        navfn::NavFn nav_;
+        unsigned char* costs_;
+        bool raw_, astar_;
+};
+
+//
+// An expander of the GlobalPlanner with its default settings, the path
+// traced back along the gradient.
+//
+class ExpanderBenchmark : public BenchmarkPlanner {
+    public:
+        ExpanderBenchmark(const std::string& name, unsigned char* costs, int nx, int ny) :
+                p_calc_(nx, ny), batch_calc_(nx, ny), path_maker_(&p_calc_), expander_(NULL), costs_(costs), nx_(nx), ny_(ny),
+                potential_(nx * ny) {
+            if (name == "dijkstra") {
+                DijkstraExpansion* de = new DijkstraExpansion(&p_calc_, nx, ny);
+                de->setPreciseStart(true);
+                expander_ = de;
+            } else if (name == "dijkstra_batch") {
+                DijkstraExpansion* de = new DijkstraExpansion(&batch_calc_, nx, ny);
+                de->setPreciseStart(true);
+                expander_ = de;
+            } else if (name == "astar" || name == "bidirectional_astar") {
+                AStarExpansion* ae = new AStarExpansion(&p_calc_, nx, ny);
+                ae->setBidirectional(name == "bidirectional_astar");
+                expander_ = ae;
+            } else if (name == "jump_point")
+                expander_ = new JumpPointExpansion(&p_calc_, nx, ny);
+            else if (name == "dstar_lite")
+                expander_ = new DStarLiteExpansion(&p_calc_, nx, ny);
+            if (expander_)
+                expander_->setSize(nx, ny);
+            path_maker_.setSize(nx, ny);
+            path_maker_.setLethalCost(253);
+        }
+        ~ExpanderBenchmark() {
+            delete expander_;
+        }
+        bool valid() {
+            return expander_ != NULL;
+        }
+        bool plan(const PlanPair& pair, std::vector<std::pair<float, float> >& path) {
+            path.clear();
+            bool found = expander_->calculatePotentials(costs_, pair.sx, pair.sy, pair.gx, pair.gy, nx_ * ny_ * 2,
+                                                        &potential_[0]);
+            expander_->clearEndpoint(costs_, &potential_[0], pair.gx, pair.gy, 2);
+            return found && path_maker_.getPath(&potential_[0], pair.sx, pair.sy, pair.gx, pair.gy, path);
+        }
+        int getCellsVisited() {
+            return expander_->getCellsVisited();
+        }
+
+    private:
+        QuadraticCalculator p_calc_;
+        BatchQuadraticCalculator batch_calc_;
+        GradientPath path_maker_;
+        Expander* expander_;
+        unsigned char* costs_;
+        int nx_, ny_;
+        std::vector<float> potential_;
+};
+
+bool readPairs(const char* fname, int nx, int ny, std::vector<PlanPair>& pairs) {
+    FILE* file = fopen(fname, "r");
+    if (!file) {
+        fprintf(stderr, "Can't open the pairs file %s\n", fname);
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        PlanPair pair;
+        if (line[0] == '#' || sscanf(line, "%d %d %d %d", &pair.sx, &pair.sy, &pair.gx, &pair.gy) != 4)
+            continue;
+        if (pair.sx < 1 || pair.sx > nx - 2 || pair.sy < 1 || pair.sy > ny - 2 || pair.gx < 1 || pair.gx > nx - 2
+                || pair.gy < 1 || pair.gy > ny - 2) {
+            fprintf(stderr, "Skipping %d %d -> %d %d, off the costmap or on its edge\n", pair.sx, pair.sy, pair.gx,
+                    pair.gy);
+            continue;
+        }
+        pairs.push_back(pair);
+    }
+    fclose(file);
+    return !pairs.empty();
+}
+
+//
+// Runs in the child process.  The costmap is copied first, so the peak
+// memory of every child includes it the same way.
+//
+BenchmarkResult runPlanner(const std::string& name, const unsigned char* map, int nx, int ny, bool raw,
+                           const std::vector<PlanPair>& pairs, int repeats, bool verbose) {
+    BenchmarkResult result;
+    memset(&result, 0, sizeof(result));
+    std::vector<unsigned char> costs(map, map + nx * ny);
+
+    BenchmarkPlanner* planner;
+    if (name == "navfn" || name == "navfn_astar")
+        planner = new NavfnBenchmark(&costs[0], nx, ny, raw, name == "navfn_astar");
+    else {
+        ExpanderBenchmark* eb = new ExpanderBenchmark(name, &costs[0], nx, ny);
+        if (!eb->valid()) {
+            delete eb;
+            fprintf(stderr, "Unknown planner %s\n", name.c_str());
+            result.plans = -1;
+            return result;
+        }
+        planner = eb;
+    }
+
+    std::vector<std::pair<float, float> > path;
+    for (int r = 0; r < repeats; r++) {
+        for (unsigned int i = 0; i < pairs.size(); i++) {
+            double t0 = get_ms();
+            bool found = planner->plan(pairs[i], path);
+            double ms = get_ms() - t0;
+            double length = pathLength(path);
+
+            result.plans++;
+            result.ms += ms;
+            result.cells += planner->getCellsVisited();
+            if (found) {
+                result.found++;
+                result.length += length;
+            }
+            if (verbose)
+                printf("%-20s %5d %5d -> %5d %5d  %s  %9.3f ms  %9d cells  %9.1f\n", name.c_str(), pairs[i].sx,
+                       pairs[i].sy, pairs[i].gx, pairs[i].gy, found ? "found " : "failed", ms,
+                       planner->getCellsVisited(), length);
+        }
+    }
+    delete planner;
+    return result;
+}
+
+//
+// Forks a child for the planner and reads its result back through a pipe.
+// A planner of name "" only copies the costmap, for the memory every child
+// starts with.
+//
+bool benchmark(const std::string& name, const unsigned char* map, int nx, int ny, bool raw,
+               const std::vector<PlanPair>& pairs, int repeats, bool verbose, BenchmarkResult& result, long& max_rss) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return false;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        if (name.empty()) {
+            std::vector<unsigned char> costs(map, map + nx * ny);
+            memset(&result, 0, sizeof(result));
+        } else
+            result = runPlanner(name, map, nx, ny, raw, pairs, repeats, verbose);
+        fflush(stdout);
+        ssize_t written = write(fds[1], &result, sizeof(result));
+        _exit(written == sizeof(result) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ssize_t got = read(fds[0], &result, sizeof(result));
+    close(fds[0]);
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0
+            || got != sizeof(result) || result.plans < 0)
+        return false;
+    max_rss = usage.ru_maxrss;
+    return true;
+}
+
+} // namespace global_planner
+
+int main(int argc, char** argv) {
+    using namespace global_planner;
+
+    bool raw = false, verbose = false;
+    int repeats = 1;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (!strcmp(argv[arg], "-r"))
+            raw = true;
+        else if (!strcmp(argv[arg], "-v"))
+            verbose = true;
+        else if (!strcmp(argv[arg], "-n") && arg + 1 < argc)
+            repeats = std::max(atoi(argv[++arg]), 1);
+        else
+            break;
+    }
+    if (argc - arg < 2) {
+        fprintf(stderr, "Usage: %s [-r] [-n repeats] [-v] <costmap.pgm> <pairs> [planner ...]\n", argv[0]);
+        fprintf(stderr, "Planners: navfn navfn_astar dijkstra dijkstra_batch astar bidirectional_astar jump_point dstar_lite\n");
+        return 1;
+    }
+
+    int nx, ny;
+    COSTTYPE* map = readPGM(argv[arg], &nx, &ny, raw);
+    if (!map)
+        return 1;
+    std::vector<PlanPair> pairs;
+    if (!readPairs(argv[arg + 1], nx, ny, pairs)) {
+        free(map);
+        return 1;
+    }
+
+    std::vector<std::string> names(argv + arg + 2, argv + argc);
+    if (names.empty()) {
+        names.push_back("navfn");
+        names.push_back("dijkstra");
+        names.push_back("astar");
+        names.push_back("jump_point");
+    }
+
+    BenchmarkResult base;
+    long base_rss = 0;
+    if (!benchmark("", map, nx, ny, raw, pairs, repeats, false, base, base_rss))
+        base_rss = 0;
+
+    std::vector<BenchmarkResult> results(names.size());
+    std::vector<long> rss(names.size(), -1);
+    for (unsigned int i = 0; i < names.size(); i++)
+        if (!benchmark(names[i], map, nx, ny, raw, pairs, repeats, verbose, results[i], rss[i]))
+            rss[i] = -1;
+    free(map);
+
+    printf("\n%d x %d cells, %d plans per planner\n", nx, ny, (int)pairs.size() * repeats);
+    printf("%-20s %7s %12s %12s %12s %12s\n", "planner", "found", "mean ms", "mean cells", "mean length",
+           "memory kB");
+    int failed = 0;
+    for (unsigned int i = 0; i < names.size(); i++) {
+        const BenchmarkResult& r = results[i];
+        if (rss[i] < 0) {
+            printf("%-20s %7s\n", names[i].c_str(), "error");
+            failed++;
+            continue;
+        }
+        printf("%-20s %3d/%-3d %12.3f %12.0f %12.1f %12ld\n", names[i].c_str(), r.found, r.plans, r.ms / r.plans,
+               r.cells / r.plans, r.found ? r.length / r.found : 0.0, rss[i] - base_rss);
+    }
+    return failed ? 1 : 0;
+}
@@ -40,11 +40,20 @@
 #include <tf/transform_listener.h>
 #include <costmap_2d/cost_values.h>
 #include <costmap_2d/costmap_2d.h>
+#include <nav_trace/trace.h>
+#include <float.h>
+#include <algorithm>
 
 #include <global_planner/dijkstra.h>
 #include <global_planner/astar.h>
+#include <global_planner/jump_point.h>
+#include <global_planner/dstar_lite.h>
+#include <global_planner/coarse_costmap.h>
+#include <global_planner/cost_matrix.h>
 #include <global_planner/grid_path.h>
 #include <global_planner/gradient_path.h>
+#include <global_planner/path_smoother.h>
+#include <global_planner/goal_cache.h>
 #include <global_planner/quadratic_calculator.h>
 
 //register this planner as a BaseGlobalPlanner plugin
@@ -52,32 +61,21 @@ PLUGINLIB_EXPORT_CLASS(global_planner::GlobalPlanner, nav_core::BaseGlobalPlanne
 
 namespace global_planner {
 
-void GlobalPlanner::outlineMap(unsigned char* costarr, int nx, int ny, unsigned char value) {
-    unsigned char* pc = costarr;
-    for (int i = 0; i < nx; i++)
-        *pc++ = value;
-    pc = costarr + (ny - 1) * nx;
-    for (int i = 0; i < nx; i++)
-        *pc++ = value;
-    pc = costarr;
-    for (int i = 0; i < ny; i++, pc += nx)
-        *pc = value;
-    pc = costarr + nx - 1;
-    for (int i = 0; i < ny; i++, pc += nx)
-        *pc = value;
-}
-
 GlobalPlanner::GlobalPlanner() :
-        costmap_(NULL), initialized_(false), allow_unknown_(true) {
+        costmap_(NULL), initialized_(false), allow_unknown_(true), planner_(NULL), field_planner_(NULL), smoother_(NULL), coarse_(NULL), corridor_(NULL),
+        corridor_costs_given_(false), layered_costmap_(NULL), goal_cache_(NULL), cost_matrix_(NULL), matrix_calc_(NULL), service_worker_(false), potential_array_(NULL), potential_size_(0) {
 }
 
 GlobalPlanner::GlobalPlanner(std::string name, costmap_2d::Costmap2D* costmap, std::string frame_id) :
-        costmap_(NULL), initialized_(false), allow_unknown_(true) {
+        costmap_(NULL), initialized_(false), allow_unknown_(true), planner_(NULL), field_planner_(NULL), smoother_(NULL), coarse_(NULL), corridor_(NULL),
+        corridor_costs_given_(false), layered_costmap_(NULL), goal_cache_(NULL), cost_matrix_(NULL), matrix_calc_(NULL), service_worker_(false), potential_array_(NULL), potential_size_(0) {
     //initialize the planner
     initialize(name, costmap, frame_id);
 }
 
 void GlobalPlanner::initialize(std::string name, costmap_2d::Costmap2DROS* costmap_ros) {
+    if (!initialized_)
+        layered_costmap_ = costmap_ros->getLayeredCostmap();
     initialize(name, costmap_ros->getCostmap(), costmap_ros->getGlobalFrameID());
 }
 
@@ -95,24 +93,59 @@ void GlobalPlanner::initialize(std::string name, costmap_2d::Costmap2D* costmap,
         else
             convert_offset_ = 0.0;
 
-        bool use_quadratic;
+        bool use_quadratic, batch_potentials;
         private_nh.param("use_quadratic", use_quadratic, true);
-        if (use_quadratic)
-            p_calc_ = new QuadraticCalculator(cx, cy);
-        else
+        // batch_potentials updates each priority buffer of the Dijkstra expansion from the potentials before it
+        // (Jacobi), where the unbatched calculator updates the cells in place one after the other
+        // (Gauss-Seidel), so a cell does not see the update of a neighbor earlier in the same buffer and the
+        // potentials and plans may differ slightly, also when the buffer is not split over threads
+        private_nh.param("batch_potentials", batch_potentials, false);
+        if (use_quadratic) {
+            if (batch_potentials)
+                p_calc_ = new BatchQuadraticCalculator(cx, cy);
+            else
+                p_calc_ = new QuadraticCalculator(cx, cy);
+            matrix_calc_ = new QuadraticCalculator(cx, cy);
+        } else {
             p_calc_ = new PotentialCalculator(cx, cy);
+            matrix_calc_ = new PotentialCalculator(cx, cy);
+        }
 
-        bool use_dijkstra;
+        bool use_dijkstra, use_jump_point, use_incremental;
+        int dijkstra_threads;
         private_nh.param("use_dijkstra", use_dijkstra, true);
-        if (use_dijkstra)
+        private_nh.param("use_jump_point", use_jump_point, false);
+        private_nh.param("use_incremental", use_incremental, false);
+        private_nh.param("dijkstra_threads", dijkstra_threads, 1);
+        if (use_incremental)
+            planner_ = new DStarLiteExpansion(p_calc_, cx, cy);
+        else if (use_jump_point)
+            planner_ = new JumpPointExpansion(p_calc_, cx, cy);
+        else if (use_dijkstra)
         {
             DijkstraExpansion* de = new DijkstraExpansion(p_calc_, cx, cy);
             if(!old_navfn_behavior_)
                 de->setPreciseStart(true);
+            de->setThreads(std::max(dijkstra_threads, 1));
             planner_ = de;
+            field_planner_ = de;
         }
         else
-            planner_ = new AStarExpansion(p_calc_, cx, cy);
+        {
+            AStarExpansion* ae = new AStarExpansion(p_calc_, cx, cy);
+            bool use_bidirectional_astar;
+            private_nh.param("use_bidirectional_astar", use_bidirectional_astar, false);
+            ae->setBidirectional(use_bidirectional_astar);
+            planner_ = ae;
+        }
+
+        if (!field_planner_) {
+            DijkstraExpansion* de = new DijkstraExpansion(p_calc_, cx, cy);
+            if(!old_navfn_behavior_)
+                de->setPreciseStart(true);
+            de->setThreads(std::max(dijkstra_threads, 1));
+            field_planner_ = de;
+        }
 
         bool use_grid_path;
         private_nh.param("use_grid_path", use_grid_path, false);
@@ -121,24 +154,114 @@ void GlobalPlanner::initialize(std::string name, costmap_2d::Costmap2D* costmap,
         else
             path_maker_ = new GradientPath(p_calc_);
 
+        bool smooth_path;
+        private_nh.param("smooth_path", smooth_path, false);
+        if (smooth_path) {
+            double max_segment;
+            private_nh.param("smooth_max_segment", max_segment, 1.0);
+            smoother_ = new PathSmoother();
+            smoother_->setMaxSegment(max_segment / costmap->getResolution());
+        }
+
         plan_pub_ = private_nh.advertise<nav_msgs::Path>("plan", 1);
         potential_pub_ = private_nh.advertise<nav_msgs::OccupancyGrid>("potential", 1);
 
         private_nh.param("allow_unknown", allow_unknown_, true);
         planner_->setHasUnknown(allow_unknown_);
+        field_planner_->setHasUnknown(allow_unknown_);
+        if (smoother_)
+            smoother_->setHasUnknown(allow_unknown_);
         private_nh.param("planner_window_x", planner_window_x_, 0.0);
         private_nh.param("planner_window_y", planner_window_y_, 0.0);
         private_nh.param("default_tolerance", default_tolerance_, 0.0);
         private_nh.param("publish_scale", publish_scale_, 100);
+        double potential_rate;
+        private_nh.param("potential_publish_rate", potential_rate, 0.0);
+        potential_publisher_.reset(new navfn::PotentialPublisher(
+                boost::bind(&GlobalPlanner::publishPotential, this, _1), potential_rate));
+
+        bool use_hierarchy;
+        private_nh.param("use_hierarchy", use_hierarchy, false);
+        if (use_hierarchy) {
+            int factor;
+            private_nh.param("hierarchy_factor", factor, 4);
+            private_nh.param("hierarchy_corridor", coarse_corridor_, 2);
+            // blocks next to each other by a corner only share a corner, a path can't go through it
+            coarse_corridor_ = std::max(coarse_corridor_, 1);
+            coarse_ = new CoarseCostmap(factor);
+        }
 
-        double costmap_pub_freq;
-        private_nh.param("planner_costmap_publish_frequency", costmap_pub_freq, 0.0);
+        corridor_ = new navfn::Corridor();
+        private_nh.param("corridor_width", corridor_width_, 1.0);
+
+        //the potentials of the frequent goals are expanded over the whole map, like that of computePotential()
+        goal_cache_ = new GoalCache(field_planner_);
+        cache_origin_x_ = costmap->getOriginX();
+        cache_origin_y_ = costmap->getOriginY();
 
         //get the tf prefix
         ros::NodeHandle prefix_nh;
         tf_prefix_ = tf::getPrefixParam(prefix_nh);
 
-        make_plan_srv_ = private_nh.advertiseService("make_plan", &GlobalPlanner::makePlanService, this);
+        //a planner of the service calls only plans, the one it works for takes the calls
+        if (service_worker_) {
+            initialized_ = true;
+            return;
+        }
+
+        corridor_sub_ = private_nh.subscribe("corridor", 1, &GlobalPlanner::corridorCB, this);
+        corridor_polygon_sub_ = private_nh.subscribe("corridor_polygon", 1, &GlobalPlanner::corridorPolygonCB, this);
+
+        XmlRpc::XmlRpcValue cached_goals;
+        if (private_nh.getParam("cached_goals", cached_goals)) {
+            if (cached_goals.getType() != XmlRpc::XmlRpcValue::TypeArray)
+                ROS_ERROR("cached_goals must be a list of [x, y] points, ignoring it");
+            else
+                for (int i = 0; i < cached_goals.size(); i++) {
+                    XmlRpc::XmlRpcValue& point = cached_goals[i];
+                    if (point.getType() != XmlRpc::XmlRpcValue::TypeArray || point.size() != 2) {
+                        ROS_ERROR("cached_goals must be a list of [x, y] points, ignoring entry %d", i);
+                        continue;
+                    }
+                    geometry_msgs::Point goal;
+                    goal.x = point[0].getType() == XmlRpc::XmlRpcValue::TypeInt ? (int) point[0] : (double) point[0];
+                    goal.y = point[1].getType() == XmlRpc::XmlRpcValue::TypeInt ? (int) point[1] : (double) point[1];
+                    cached_goals_.push_back(goal);
+                    cacheGoal(goal);
+                }
+        }
+
+        int matrix_threads;
+        private_nh.param("cost_matrix_threads", matrix_threads, (int)boost::thread::hardware_concurrency());
+        cost_matrix_ = new CostMatrix(matrix_calc_, std::max(matrix_threads, 1));
+        cost_matrix_->setPreciseStart(!old_navfn_behavior_);
+
+        double costmap_pub_freq;
+        private_nh.param("planner_costmap_publish_frequency", costmap_pub_freq, 0.0);
+
+        //the make_plan calls are planned on a copy of the costmap with a planner of their own, on threads of
+        //their own, so that they don't wait for the plans of the robot or hold them up
+        {
+            boost::shared_lock<boost::shared_mutex> costmap_lock(*(costmap->getLock()));
+            service_costmap_ = *costmap;
+        }
+        service_planner_.reset(new GlobalPlanner());
+        service_planner_->service_worker_ = true;
+        service_planner_->initialize(name, &service_costmap_, frame_id);
+        plan_requests_.reset(new navfn::PlanRequests(boost::bind(&GlobalPlanner::makeServicePlan, this, _1, _2, _3)));
+
+        int service_threads;
+        private_nh.param("service_threads", service_threads, 4);
+        ros::AdvertiseServiceOptions make_plan_ops = ros::AdvertiseServiceOptions::create<nav_msgs::GetPlan>(
+                "make_plan", boost::bind(&GlobalPlanner::makePlanService, this, _1, _2), ros::VoidPtr(),
+                &service_queue_);
+        make_plan_srv_ = private_nh.advertiseService(make_plan_ops);
+        service_spinner_.reset(new ros::AsyncSpinner(std::max(service_threads, 1), &service_queue_));
+        service_spinner_->start();
+
+        make_plans_srv_ = private_nh.advertiseService("make_plans", &GlobalPlanner::makePlansService, this);
+        make_cost_matrix_srv_ = private_nh.advertiseService("make_cost_matrix", &GlobalPlanner::makeCostMatrixService,
+                                                            this);
 
         dsrv_ = new dynamic_reconfigure::Server<global_planner::GlobalPlannerConfig>(ros::NodeHandle("~/" + name));
         dynamic_reconfigure::Server<global_planner::GlobalPlannerConfig>::CallbackType cb = boost::bind(
@@ -152,11 +275,26 @@ void GlobalPlanner::initialize(std::string name, costmap_2d::Costmap2D* costmap,
 }
 
 void GlobalPlanner::reconfigureCB(global_planner::GlobalPlannerConfig& config, uint32_t level) {
+    if (service_planner_) {
+        boost::mutex::scoped_lock lock(service_planner_->mutex_);
+        service_planner_->reconfigureCB(config, level);
+    }
     planner_->setLethalCost(config.lethal_cost);
     path_maker_->setLethalCost(config.lethal_cost);
     planner_->setNeutralCost(config.neutral_cost);
     planner_->setFactor(config.cost_factor);
+    field_planner_->setLethalCost(config.lethal_cost);
+    field_planner_->setNeutralCost(config.neutral_cost);
+    field_planner_->setFactor(config.cost_factor);
     publish_potential_ = config.publish_potential;
+    goal_cache_->reset();
+    if (coarse_)
+        coarse_->setCosts(config.lethal_cost, config.neutral_cost, allow_unknown_);
+
+    if (!cost_matrix_)
+        return;
+    boost::mutex::scoped_lock lock(matrix_mutex_);
+    cost_matrix_->setCosts(config.lethal_cost, config.neutral_cost, config.cost_factor, allow_unknown_);
 }
 
 void GlobalPlanner::clearRobotCell(const tf::Stamped<tf::Pose>& global_pose, unsigned int mx, unsigned int my) {
@@ -170,8 +308,247 @@ void GlobalPlanner::clearRobotCell(const tf::Stamped<tf::Pose>& global_pose, uns
     costmap_->setCost(mx, my, costmap_2d::FREE_SPACE);
 }
 
+void GlobalPlanner::setSize(int nx, int ny) {
+    //the workspaces are only reallocated when the size of the costmap changes
+    p_calc_->setSize(nx, ny);
+    planner_->setSize(nx, ny);
+    field_planner_->setSize(nx, ny);
+    path_maker_->setSize(nx, ny);
+
+    //the expanders may keep track of what they set in the potential array, so it is kept between plans
+    if (potential_size_ != nx * ny) {
+        delete[] potential_array_;
+        potential_array_ = new float[nx * ny];
+        potential_size_ = nx * ny;
+    }
+}
+
+bool GlobalPlanner::computePotential(const geometry_msgs::Point& world_point) {
+    if (!initialized_) {
+        ROS_ERROR(
+                "This planner has not been initialized yet, but it is being used, please call initialize() before use");
+        return false;
+    }
+
+    unsigned int mx, my;
+    double start_x, start_y;
+    if (!costmap_->worldToMap(world_point.x, world_point.y, mx, my))
+        return false;
+    if(old_navfn_behavior_){
+        start_x = mx;
+        start_y = my;
+    }else{
+        worldToMap(world_point.x, world_point.y, start_x, start_y);
+    }
+
+    int nx = costmap_->getSizeInCellsX(), ny = costmap_->getSizeInCellsY();
+    setSize(nx, ny);
+
+    //the end cell is on the edge of the map, which is never entered, so the whole map is expanded
+    planner_->forgetPotentials();
+    field_planner_->calculatePotentials(costmap_->getCharMap(), start_x, start_y, 0, 0, nx * ny * 2,
+                                        potential_array_);
+    return true;
+}
+
+double GlobalPlanner::getPointPotential(const geometry_msgs::Point& world_point) {
+    if (!initialized_) {
+        ROS_ERROR(
+                "This planner has not been initialized yet, but it is being used, please call initialize() before use");
+        return -1.0;
+    }
+
+    unsigned int mx, my;
+    if (!potential_array_ || !costmap_->worldToMap(world_point.x, world_point.y, mx, my)
+            || int(mx + my * costmap_->getSizeInCellsX()) >= potential_size_)
+        return DBL_MAX;
+
+    return potential_array_[mx + my * costmap_->getSizeInCellsX()];
+}
+
+bool GlobalPlanner::validPointPotential(const geometry_msgs::Point& world_point) {
+    return validPointPotential(world_point, default_tolerance_);
+}
+
+bool GlobalPlanner::validPointPotential(const geometry_msgs::Point& world_point, double tolerance) {
+    if (!initialized_) {
+        ROS_ERROR(
+                "This planner has not been initialized yet, but it is being used, please call initialize() before use");
+        return false;
+    }
+
+    double resolution = costmap_->getResolution();
+    geometry_msgs::Point p = world_point;
+    for (p.y = world_point.y - tolerance; p.y <= world_point.y + tolerance; p.y += resolution)
+        for (p.x = world_point.x - tolerance; p.x <= world_point.x + tolerance; p.x += resolution)
+            if (getPointPotential(p) < POT_HIGH)
+                return true;
+
+    return false;
+}
+
+bool GlobalPlanner::makePlans(const geometry_msgs::PoseStamped& start,
+                              const std::vector<geometry_msgs::PoseStamped>& goals, std::vector<double>& costs,
+                              std::vector<std::vector<geometry_msgs::PoseStamped> >* plans) {
+    boost::mutex::scoped_lock lock(mutex_);
+    costs.assign(goals.size(), -1.0);
+    if (plans)
+        plans->assign(goals.size(), std::vector<geometry_msgs::PoseStamped>());
+
+    if (!initialized_) {
+        ROS_ERROR(
+                "This planner has not been initialized yet, but it is being used, please call initialize() before use");
+        return false;
+    }
+
+    if (tf::resolve(tf_prefix_, start.header.frame_id) != tf::resolve(tf_prefix_, frame_id_)) {
+        ROS_ERROR(
+                "The start pose passed to this planner must be in the %s frame.  It is instead in the %s frame.", tf::resolve(tf_prefix_, frame_id_).c_str(), tf::resolve(tf_prefix_, start.header.frame_id).c_str());
+        return false;
+    }
+
+    unsigned int start_x_i, start_y_i;
+    double start_x, start_y;
+    if (!costmap_->worldToMap(start.pose.position.x, start.pose.position.y, start_x_i, start_y_i)) {
+        ROS_WARN(
+                "The robot's start position is off the global costmap. Planning will always fail, are you sure the robot has been properly localized?");
+        return false;
+    }
+    if(old_navfn_behavior_){
+        start_x = start_x_i;
+        start_y = start_y_i;
+    }else{
+        worldToMap(start.pose.position.x, start.pose.position.y, start_x, start_y);
+    }
+
+    //one expansion over the whole map from the start serves all of the goals
+    tf::Stamped<tf::Pose> start_pose;
+    tf::poseStampedMsgToTF(start, start_pose);
+    clearRobotCell(start_pose, start_x_i, start_y_i);
+    computePotential(start.pose.position);
+
+    for (unsigned int i = 0; i < goals.size(); i++) {
+        const geometry_msgs::PoseStamped& goal = goals[i];
+        unsigned int goal_x_i, goal_y_i;
+        double goal_x, goal_y;
+        if (tf::resolve(tf_prefix_, goal.header.frame_id) != tf::resolve(tf_prefix_, frame_id_)
+                || !costmap_->worldToMap(goal.pose.position.x, goal.pose.position.y, goal_x_i, goal_y_i))
+            continue;
+
+        double potential = getPointPotential(goal.pose.position);
+        if (potential >= POT_HIGH)
+            continue;
+        costs[i] = potential;
+
+        if (!plans)
+            continue;
+        if(old_navfn_behavior_){
+            goal_x = goal_x_i;
+            goal_y = goal_y_i;
+        }else{
+            worldToMap(goal.pose.position.x, goal.pose.position.y, goal_x, goal_y);
+        }
+        if (getPlanFromPotential(start_x, start_y, goal_x, goal_y, goal, (*plans)[i])) {
+            geometry_msgs::PoseStamped goal_copy = goal;
+            goal_copy.header.stamp = ros::Time::now();
+            (*plans)[i].push_back(goal_copy);
+        }
+    }
+
+    return true;
+}
+
+bool GlobalPlanner::makePlansService(navfn::MakeNavPlans::Request& req, navfn::MakeNavPlans::Response& resp) {
+    std::vector<std::vector<geometry_msgs::PoseStamped> > plans;
+    makePlans(req.start, req.goals, resp.costs, req.compute_paths ? &plans : NULL);
+
+    resp.plans.resize(plans.size());
+    for (unsigned int i = 0; i < plans.size(); i++) {
+        resp.plans[i].header.stamp = ros::Time::now();
+        resp.plans[i].header.frame_id = frame_id_;
+        resp.plans[i].poses.swap(plans[i]);
+    }
+
+    return true;
+}
+
+bool GlobalPlanner::makeCostMatrix(const std::vector<geometry_msgs::PoseStamped>& starts,
+                                   const std::vector<geometry_msgs::PoseStamped>& goals, std::vector<double>& costs) {
+    boost::mutex::scoped_lock lock(matrix_mutex_);
+    costs.assign(starts.size() * goals.size(), -1.0);
+
+    if (!initialized_) {
+        ROS_ERROR(
+                "This planner has not been initialized yet, but it is being used, please call initialize() before use");
+        return false;
+    }
+
+    //the poses that are on the map, and the row or column of the matrix they are for
+    std::vector<std::pair<double, double> > start_cells;
+    std::vector<int> goal_cells;
+    std::vector<unsigned int> rows, columns;
+    int nx, ny;
+    {
+        //the expansions run on a copy of the costs, the costmap can be updated and planned on while they do
+        boost::shared_lock<boost::shared_mutex> costmap_lock(*(costmap_->getLock()));
+        nx = costmap_->getSizeInCellsX();
+        ny = costmap_->getSizeInCellsY();
+        unsigned char* char_map = costmap_->getCharMap();
+        matrix_costs_.assign(char_map, char_map + nx * ny);
+
+        for (unsigned int i = 0; i < starts.size(); i++) {
+            const geometry_msgs::PoseStamped& start = starts[i];
+            unsigned int mx, my;
+            double start_x, start_y;
+            if (tf::resolve(tf_prefix_, start.header.frame_id) != tf::resolve(tf_prefix_, frame_id_)
+                    || !costmap_->worldToMap(start.pose.position.x, start.pose.position.y, mx, my))
+                continue;
+            if(old_navfn_behavior_){
+                start_x = mx;
+                start_y = my;
+            }else{
+                worldToMap(start.pose.position.x, start.pose.position.y, start_x, start_y);
+            }
+            //the cost of the start cell itself is never looked at, so it doesn't have to be cleared
+            start_cells.push_back(std::make_pair(start_x, start_y));
+            rows.push_back(i);
+        }
+
+        for (unsigned int j = 0; j < goals.size(); j++) {
+            const geometry_msgs::PoseStamped& goal = goals[j];
+            unsigned int mx, my;
+            if (tf::resolve(tf_prefix_, goal.header.frame_id) != tf::resolve(tf_prefix_, frame_id_)
+                    || !costmap_->worldToMap(goal.pose.position.x, goal.pose.position.y, mx, my))
+                continue;
+            goal_cells.push_back(mx + my * nx);
+            columns.push_back(j);
+        }
+    }
+
+    if (start_cells.empty() || goal_cells.empty())
+        return true;
+
+    std::vector<float> matrix;
+    cost_matrix_->compute(&matrix_costs_[0], nx, ny, start_cells, goal_cells, matrix);
+
+    for (unsigned int r = 0; r < rows.size(); r++)
+        for (unsigned int c = 0; c < columns.size(); c++) {
+            float potential = matrix[r * columns.size() + c];
+            if (potential < POT_HIGH)
+                costs[rows[r] * goals.size() + columns[c]] = potential;
+        }
+
+    return true;
+}
+
+bool GlobalPlanner::makeCostMatrixService(navfn::MakeCostMatrix::Request& req,
+                                          navfn::MakeCostMatrix::Response& resp) {
+    makeCostMatrix(req.starts, req.goals, resp.costs);
+    return true;
+}
+
 bool GlobalPlanner::makePlanService(nav_msgs::GetPlan::Request& req, nav_msgs::GetPlan::Response& resp) {
-    makePlan(req.start, req.goal, resp.plan.poses);
+    plan_requests_->makePlan(req.start, req.goal, resp.plan.poses);
 
     resp.plan.header.stamp = ros::Time::now();
     resp.plan.header.frame_id = frame_id_;
@@ -179,6 +556,15 @@ bool GlobalPlanner::makePlanService(nav_msgs::GetPlan::Request& req, nav_msgs::G
     return true;
 }
 
+bool GlobalPlanner::makeServicePlan(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal,
+                                    std::vector<geometry_msgs::PoseStamped>& plan) {
+    {
+        boost::shared_lock<boost::shared_mutex> costmap_lock(*(costmap_->getLock()));
+        service_costmap_ = *costmap_;
+    }
+    return service_planner_->makePlan(start, goal, plan);
+}
+
 void GlobalPlanner::mapToWorld(double mx, double my, double& wx, double& wy) {
     wx = costmap_->getOriginX() + (mx+convert_offset_) * costmap_->getResolution();
     wy = costmap_->getOriginY() + (my+convert_offset_) * costmap_->getResolution();
@@ -207,6 +593,7 @@ bool GlobalPlanner::makePlan(const geometry_msgs::PoseStamped& start, const geom
 
 bool GlobalPlanner::makePlan(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal,
                            double tolerance, std::vector<geometry_msgs::PoseStamped>& plan) {
+    NAV_TRACE_SCOPE("GlobalPlanner::makePlan");
     boost::mutex::scoped_lock lock(mutex_);
     if (!initialized_) {
         ROS_ERROR(
@@ -272,22 +659,63 @@ bool GlobalPlanner::makePlan(const geometry_msgs::PoseStamped& start, const geom
     clearRobotCell(start_pose, start_x_i, start_y_i);
 
     int nx = costmap_->getSizeInCellsX(), ny = costmap_->getSizeInCellsY();
+    setSize(nx, ny);
+
+    //the cells changed since the last plan, if the layered costmap keeps track of them
+    unsigned int x0 = 0, xn = 0, y0 = 0, yn = 0;
+    if (layered_costmap_) {
+        layered_costmap_->takeChangedBounds(&x0, &xn, &y0, &yn);
+        planner_->setChangedBounds(x0, xn, y0, yn);
+        goal_cache_->setChangedBounds(x0, xn, y0, yn);
+    } else
+        goal_cache_->setChangedBounds(0, nx, 0, ny);
+
+    //plans to the frequent goals only follow their potential, unless they have to stay within a corridor
+    if ((!corridor_ || corridor_->empty()) && getPlanFromCache(start_x, start_y, start_x_i, start_y_i, goal_x_i, goal_y_i, goal, plan)) {
+        geometry_msgs::PoseStamped goal_copy = goal;
+        goal_copy.header.stamp = ros::Time::now();
+        plan.push_back(goal_copy);
+        publishPlan(plan);
+        return true;
+    }
 
-    //make sure to resize the underlying array that Navfn uses
-    p_calc_->setSize(nx, ny);
-    planner_->setSize(nx, ny);
-    path_maker_->setSize(nx, ny);
-    potential_array_ = new float[nx * ny];
+    //search within the corridor given first, if there is one
+    unsigned char* costs = costmap_->getCharMap();
+    bool found_legal = false;
+    if (corridor_ && !corridor_->empty()) {
+        unsigned char* corridor_costs = getCorridorCosts(costs, nx, ny);
+        found_legal = calculatePotentials(corridor_costs, start_x, start_y, goal_x, goal_y, nx, ny);
+        if (found_legal)
+            costs = corridor_costs;
+        else
+            ROS_DEBUG("No path within the corridor, planning without it");
+    }
 
-    outlineMap(costmap_->getCharMap(), nx, ny, costmap_2d::LETHAL_OBSTACLE);
+    //search the blocks of the coarse costmap next and only expand the cells of the corridor they give
+    if (!found_legal && coarse_) {
+        if (!layered_costmap_ || !coarse_->isCurrent(nx, ny))
+            coarse_->update(costmap_->getCharMap(), nx, ny);
+        else
+            coarse_->update(costmap_->getCharMap(), x0, xn, y0, yn);
+        if (coarse_->findCorridor(start_x_i, start_y_i, goal_x_i, goal_y_i, coarse_corridor_)) {
+            unsigned char* corridor_costs = coarse_->getCorridorCosts(costs);
+            found_legal = calculatePotentials(corridor_costs, start_x, start_y, goal_x, goal_y, nx, ny);
+            if (found_legal)
+                costs = corridor_costs;
+            else
+                ROS_DEBUG("No path within the coarse corridor, planning over the whole costmap");
+        }
+    }
 
-    bool found_legal = planner_->calculatePotentials(costmap_->getCharMap(), start_x, start_y, goal_x, goal_y,
-                                                    nx * ny * 2, potential_array_);
+    if (!found_legal)
+        found_legal = calculatePotentials(costs, start_x, start_y, goal_x, goal_y, nx, ny);
 
     if(!old_navfn_behavior_)
-        planner_->clearEndpoint(costmap_->getCharMap(), potential_array_, goal_x_i, goal_y_i, 2);
-    if(publish_potential_)
-        publishPotential(potential_array_);
+        planner_->clearEndpoint(costs, potential_array_, goal_x_i, goal_y_i, 2);
+    //the grid is built on the thread of the publisher, only when someone is listening
+    if (publish_potential_ && potential_pub_.getNumSubscribers() > 0)
+        potential_publisher_->post(potential_array_, nx, ny, (float) POT_HIGH, 0.0f, costmap_->getOriginX(),
+                                   costmap_->getOriginY(), costmap_->getResolution(), frame_id_);
 
     if (found_legal) {
         //extract the plan
@@ -305,10 +733,142 @@ bool GlobalPlanner::makePlan(const geometry_msgs::PoseStamped& start, const geom
 
     //publish the plan for visualization purposes
     publishPlan(plan);
-    delete potential_array_;
     return !plan.empty();
 }
 
+bool GlobalPlanner::calculatePotentials(unsigned char* costs, double start_x, double start_y, double goal_x,
+                                        double goal_y, int nx, int ny) {
+    //the changed bounds only cover the costmap, the costs of a corridor may differ from it anywhere, and so
+    //may the costmap from the corridor the incremental search was consistent with before
+    bool corridor_costs = costs != costmap_->getCharMap();
+    if (corridor_costs || corridor_costs_given_)
+        planner_->setChangedBounds(0, nx, 0, ny);
+    corridor_costs_given_ = corridor_costs;
+    return planner_->calculatePotentials(costs, start_x, start_y, goal_x, goal_y, nx * ny * 2, potential_array_);
+}
+
+void GlobalPlanner::setCorridor(const std::vector<geometry_msgs::Point>& waypoints, double width) {
+    boost::mutex::scoped_lock lock(mutex_);
+    corridor_->setWaypoints(waypoints, width);
+}
+
+void GlobalPlanner::setCorridorPolygon(const std::vector<geometry_msgs::Point>& polygon) {
+    boost::mutex::scoped_lock lock(mutex_);
+    corridor_->setPolygon(polygon);
+}
+
+void GlobalPlanner::clearCorridor() {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (corridor_)
+        corridor_->clear();
+}
+
+void GlobalPlanner::addCachedGoal(const geometry_msgs::Point& goal) {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (!initialized_) {
+        ROS_ERROR(
+                "This planner has not been initialized yet, but it is being used, please call initialize() before use");
+        return;
+    }
+    cached_goals_.push_back(goal);
+    cacheGoal(goal);
+}
+
+void GlobalPlanner::clearCachedGoals() {
+    boost::mutex::scoped_lock lock(mutex_);
+    cached_goals_.clear();
+    if (goal_cache_)
+        goal_cache_->clear();
+}
+
+void GlobalPlanner::cacheGoal(const geometry_msgs::Point& goal) {
+    unsigned int cell_x, cell_y;
+    double mx, my;
+    if (!costmap_->worldToMap(goal.x, goal.y, cell_x, cell_y))
+        return;
+    if (old_navfn_behavior_) {
+        mx = cell_x;
+        my = cell_y;
+    } else {
+        worldToMap(goal.x, goal.y, mx, my);
+    }
+    goal_cache_->addGoal(mx, my, cell_x, cell_y);
+}
+
+bool GlobalPlanner::getPlanFromCache(double start_x, double start_y, unsigned int start_x_i,
+                                     unsigned int start_y_i, unsigned int goal_x_i, unsigned int goal_y_i,
+                                     const geometry_msgs::PoseStamped& goal,
+                                     std::vector<geometry_msgs::PoseStamped>& plan) {
+    if (cached_goals_.empty())
+        return false;
+
+    //the goals are kept in cells, they move when a rolling costmap does
+    if (costmap_->getOriginX() != cache_origin_x_ || costmap_->getOriginY() != cache_origin_y_) {
+        cache_origin_x_ = costmap_->getOriginX();
+        cache_origin_y_ = costmap_->getOriginY();
+        goal_cache_->clear();
+        for (unsigned int i = 0; i < cached_goals_.size(); i++)
+            cacheGoal(cached_goals_[i]);
+    }
+
+    int cached = goal_cache_->findGoal(goal_x_i, goal_y_i);
+    if (cached < 0)
+        return false;
+    int nx = costmap_->getSizeInCellsX(), ny = costmap_->getSizeInCellsY();
+    float* potential = goal_cache_->getPotential(cached, costmap_->getCharMap(), nx, ny, start_x_i, start_y_i);
+    if (!potential)
+        return false;
+
+    //the potential falls towards the goal, the traceback from the start gives the path the other way round
+    std::vector<std::pair<float, float> > path;
+    if (!path_maker_->getPath(potential, goal_cache_->getGoalX(cached), goal_cache_->getGoalY(cached), start_x,
+                              start_y, path))
+        return false;
+    std::reverse(path.begin(), path.end());
+    return getPlanFromPath(path, goal, plan);
+}
+
+void GlobalPlanner::corridorCB(const nav_msgs::Path::ConstPtr& path) {
+    if (!path->poses.empty() && tf::resolve(tf_prefix_, path->header.frame_id) != tf::resolve(tf_prefix_, frame_id_)) {
+        ROS_WARN(
+                "The corridor passed to this planner must be in the %s frame.  It is instead in the %s frame.", tf::resolve(tf_prefix_, frame_id_).c_str(), tf::resolve(tf_prefix_, path->header.frame_id).c_str());
+        return;
+    }
+
+    //an empty path lifts the corridor
+    std::vector<geometry_msgs::Point> waypoints(path->poses.size());
+    for (unsigned int i = 0; i < path->poses.size(); i++)
+        waypoints[i] = path->poses[i].pose.position;
+    setCorridor(waypoints, corridor_width_);
+}
+
+void GlobalPlanner::corridorPolygonCB(const geometry_msgs::PolygonStamped::ConstPtr& polygon) {
+    if (!polygon->polygon.points.empty()
+            && tf::resolve(tf_prefix_, polygon->header.frame_id) != tf::resolve(tf_prefix_, frame_id_)) {
+        ROS_WARN(
+                "The corridor passed to this planner must be in the %s frame.  It is instead in the %s frame.", tf::resolve(tf_prefix_, frame_id_).c_str(), tf::resolve(tf_prefix_, polygon->header.frame_id).c_str());
+        return;
+    }
+
+    std::vector<geometry_msgs::Point> points(polygon->polygon.points.size());
+    for (unsigned int i = 0; i < points.size(); i++) {
+        points[i].x = polygon->polygon.points[i].x;
+        points[i].y = polygon->polygon.points[i].y;
+    }
+    setCorridorPolygon(points);
+}
+
+unsigned char* GlobalPlanner::getCorridorCosts(const unsigned char* costs, int nx, int ny) {
+    corridor_->getSpans(*costmap_, corridor_spans_);
+    corridor_costs_.assign(nx * ny, costmap_2d::LETHAL_OBSTACLE);
+    for (unsigned int k = 0; k < corridor_spans_.size(); k += 3) {
+        int row = corridor_spans_[k] * nx;
+        std::copy(costs + row + corridor_spans_[k + 1], costs + row + corridor_spans_[k + 2],
+                  corridor_costs_.begin() + row + corridor_spans_[k + 1]);
+    }
+    return &corridor_costs_[0];
+}
+
 void GlobalPlanner::publishPlan(const std::vector<geometry_msgs::PoseStamped>& path) {
     if (!initialized_) {
         ROS_ERROR(
@@ -342,8 +902,6 @@ bool GlobalPlanner::getPlanFromPotential(double start_x, double start_y, double
         return false;
     }
 
-    std::string global_frame = frame_id_;
-
     //clear the plan, just in case
     plan.clear();
 
@@ -353,6 +911,16 @@ bool GlobalPlanner::getPlanFromPotential(double start_x, double start_y, double
         ROS_ERROR("NO PATH!");
         return false;
     }
+    return getPlanFromPath(path, goal, plan);
+}
+
+bool GlobalPlanner::getPlanFromPath(std::vector<std::pair<float, float> >& path,
+                                    const geometry_msgs::PoseStamped& goal,
+                                    std::vector<geometry_msgs::PoseStamped>& plan) {
+    std::string global_frame = frame_id_;
+    if (smoother_)
+        smoother_->smooth(costmap_->getCharMap(), costmap_->getSizeInCellsX(), costmap_->getSizeInCellsY(),
+                          convert_offset_, path);
 
     ros::Time plan_time = ros::Time::now();
     for (int i = path.size() -1; i>=0; i--) {
@@ -379,44 +947,32 @@ bool GlobalPlanner::getPlanFromPotential(double start_x, double start_y, double
     return !plan.empty();
 }
 
-void GlobalPlanner::publishPotential(float* potential)
+void GlobalPlanner::publishPotential(const navfn::PotentialPublisher::Potential& potential)
 {
-    int nx = costmap_->getSizeInCellsX(), ny = costmap_->getSizeInCellsY();
-    double resolution = costmap_->getResolution();
+    int width = potential.x1 - potential.x0 + 1, height = potential.y1 - potential.y0 + 1;
+    double resolution = potential.resolution;
     nav_msgs::OccupancyGrid grid;
-    // Publish Whole Grid
-    grid.header.frame_id = frame_id_;
-    grid.header.stamp = ros::Time::now();
+    // Publish the part of the grid the expansion reached
+    grid.header.frame_id = potential.frame_id;
+    grid.header.stamp = potential.stamp;
     grid.info.resolution = resolution;
 
-    grid.info.width = nx;
-    grid.info.height = ny;
+    grid.info.width = width;
+    grid.info.height = height;
 
-    double wx, wy;
-    costmap_->mapToWorld(0, 0, wx, wy);
-    grid.info.origin.position.x = wx - resolution / 2;
-    grid.info.origin.position.y = wy - resolution / 2;
+    grid.info.origin.position.x = potential.origin_x + potential.x0 * resolution;
+    grid.info.origin.position.y = potential.origin_y + potential.y0 * resolution;
     grid.info.origin.position.z = 0.0;
     grid.info.origin.orientation.w = 1.0;
 
-    grid.data.resize(nx * ny);
+    grid.data.resize(width * height);
 
-    float max = 0.0;
-    for (unsigned int i = 0; i < grid.data.size(); i++) {
-        float potential = potential_array_[i];
-        if (potential < POT_HIGH) {
-            if (potential > max) {
-                max = potential;
-            }
+    float scale = potential.max > 0.0 ? publish_scale_ / potential.max : 0.0;
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++) {
+            float pot = potential.at(potential.x0 + x, potential.y0 + y);
+            grid.data[x + y * width] = pot < 0.0 ? -1 : pot * scale;
         }
-    }
-
-    for (unsigned int i = 0; i < grid.data.size(); i++) {
-        if (potential_array_[i] >= POT_HIGH) {
-            grid.data[i] = -1;
-        } else 
-            grid.data[i] = potential_array_[i] * publish_scale_ / max;
-    }
     potential_pub_.publish(grid);
 }
 
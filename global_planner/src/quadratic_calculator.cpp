@@ -28,6 +28,10 @@
  */
 
 #include <global_planner/quadratic_calculator.h>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace global_planner {
 float QuadraticCalculator::calculatePotential(float* potential, unsigned char cost, int n, float prev_potential) {
@@ -73,5 +77,54 @@ float QuadraticCalculator::calculatePotential(float* potential, unsigned char co
         return ta + hf * v;
     }
 }
+
+// the quadratic update of four cells, given their neighbors and truncated costs
+#ifdef __SSE2__
+static inline __m128 quadraticUpdate(__m128 l, __m128 r, __m128 u, __m128 d, __m128 hf) {
+    __m128 tc = _mm_min_ps(l, r);
+    __m128 ta = _mm_min_ps(u, d);
+    __m128 lowest = _mm_min_ps(ta, tc);
+    __m128 dc = _mm_max_ps(_mm_sub_ps(tc, ta), _mm_sub_ps(ta, tc));
+
+    __m128 dd = _mm_div_ps(dc, hf);
+    __m128 v = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(-0.2301f), dd), _mm_set1_ps(0.5307f)), dd),
+                          _mm_set1_ps(0.7040f));
+    // the ta-only update where the neighbors are too far apart, hf where the quadratic would take more
+    __m128 one = _mm_cmpge_ps(dc, hf);
+    v = _mm_or_ps(_mm_and_ps(one, _mm_set1_ps(1.0f)), _mm_andnot_ps(one, v));
+    return _mm_add_ps(lowest, _mm_mul_ps(hf, v));
+}
+#endif
+
+void BatchQuadraticCalculator::calculatePotentials(float* potential, const float* costs, const int* cells, int count,
+                                                   float* out) {
+    int i = 0;
+#ifdef __SSE2__
+    for (; i + 4 <= count; i += 4) {
+        const int* n = cells + i;
+        __m128 l = _mm_setr_ps(potential[n[0] - 1], potential[n[1] - 1], potential[n[2] - 1], potential[n[3] - 1]);
+        __m128 r = _mm_setr_ps(potential[n[0] + 1], potential[n[1] + 1], potential[n[2] + 1], potential[n[3] + 1]);
+        __m128 u = _mm_setr_ps(potential[n[0] - nx_], potential[n[1] - nx_], potential[n[2] - nx_],
+                               potential[n[3] - nx_]);
+        __m128 d = _mm_setr_ps(potential[n[0] + nx_], potential[n[1] + nx_], potential[n[2] + nx_],
+                               potential[n[3] + nx_]);
+        // the costs are truncated like the unsigned char of calculatePotential()
+        __m128 hf = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_loadu_ps(costs + i)));
+        _mm_storeu_ps(out + i, quadraticUpdate(l, r, u, d, hf));
+    }
+#endif
+    // the rest one at a time, in the same single precision form
+    for (; i < count; i++) {
+        int n = cells[i];
+        float tc = std::min(potential[n - 1], potential[n + 1]);
+        float ta = std::min(potential[n - nx_], potential[n + nx_]);
+        float hf = (unsigned char)costs[i];
+        float lowest = std::min(ta, tc);
+        float dc = std::max(tc - ta, ta - tc);
+        float dd = dc / hf;
+        float v = dc >= hf ? 1.0f : (-0.2301f * dd + 0.5307f) * dd + 0.7040f;
+        out[i] = lowest + hf * v;
+    }
+}
 }
 
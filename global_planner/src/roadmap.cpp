@@ -0,0 +1,368 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#include <global_planner/roadmap.h>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+namespace global_planner {
+
+// the edges go to the blocks around and a knight's move away, the reverse of edge k is k ^ 1
+enum {
+    EDGES = 16
+};
+static const int EDGE_X[EDGES] = { 1, -1, 0, 0, 1, -1, 1, -1, 2, -2, 2, -2, 1, -1, 1, -1 };
+static const int EDGE_Y[EDGES] = { 0, 0, 1, -1, 1, -1, -1, 1, 1, -1, -1, 1, 2, -2, -2, 2 };
+
+// routes found blocked are searched again this many times before giving up
+#define MAX_ROUTES 16
+
+static const char MAGIC[4] = { 'R', 'M', 'A', 'P' };
+
+Roadmap::Roadmap(int spacing) :
+        spacing_(std::max(spacing, 1)), nx_(0), ny_(0), bx_(0), by_(0), lethal_cost_(253), neutral_cost_(50),
+        factor_(3.0), unknown_(false), stale_(true) {
+}
+
+void Roadmap::setCosts(unsigned char lethal_cost, unsigned char neutral_cost, float factor, bool unknown) {
+    if (lethal_cost == lethal_cost_ && neutral_cost == neutral_cost_ && factor == factor_ && unknown == unknown_)
+        return;
+    lethal_cost_ = lethal_cost;
+    neutral_cost_ = neutral_cost;
+    factor_ = factor;
+    unknown_ = unknown;
+    stale_ = true;
+}
+
+bool Roadmap::update(const unsigned char* costs, int nx, int ny) {
+    if (stale_ || nx != nx_ || ny != ny_) {
+        nx_ = nx;
+        ny_ = ny;
+        bx_ = (nx + spacing_ - 1) / spacing_;
+        by_ = (ny + spacing_ - 1) / spacing_;
+        costs_.assign(costs, costs + nx * ny);
+        nodes_.assign(bx_ * by_, -1);
+        edges_.assign(bx_ * by_ * EDGES, -1);
+        blocked_.assign(bx_ * by_ * EDGES, 0);
+        for (int b = 0; b < bx_ * by_; b++)
+            buildNode(b);
+        for (int b = 0; b < bx_ * by_; b++)
+            buildEdges(b);
+        stale_ = false;
+        return true;
+    }
+
+    std::vector<unsigned char> changed(bx_ * by_, 0);
+    bool any = false;
+    for (int b = 0; b < bx_ * by_; b++) {
+        int x0 = (b % bx_) * spacing_, y0 = (b / bx_) * spacing_;
+        int xn = std::min(x0 + spacing_, nx_), yn = std::min(y0 + spacing_, ny_);
+        for (int y = y0; y < yn; y++) {
+            const unsigned char* row = costs + y * nx_;
+            if (memcmp(row + x0, &costs_[y * nx_ + x0], xn - x0) != 0) {
+                std::copy(row + x0, row + xn, costs_.begin() + y * nx_ + x0);
+                changed[b] = 1;
+            }
+        }
+        if (changed[b]) {
+            buildNode(b);
+            any = true;
+        }
+    }
+    if (!any)
+        return false;
+
+    // an edge only crosses the blocks within two of either end
+    for (int b = 0; b < bx_ * by_; b++) {
+        int x = b % bx_, y = b / bx_;
+        bool near = false;
+        for (int j = std::max(y - 2, 0); j <= std::min(y + 2, by_ - 1) && !near; j++)
+            for (int i = std::max(x - 2, 0); i <= std::min(x + 2, bx_ - 1) && !near; i++)
+                near = changed[i + j * bx_];
+        if (near)
+            buildEdges(b);
+    }
+    return true;
+}
+
+void Roadmap::buildNode(int b) {
+    int x0 = (b % bx_) * spacing_, y0 = (b / bx_) * spacing_;
+    int xn = std::min(x0 + spacing_, nx_), yn = std::min(y0 + spacing_, ny_);
+    float cx = (x0 + xn - 1) / 2.0, cy = (y0 + yn - 1) / 2.0;
+
+    // the cheapest cell, the one nearest to the middle of the block of those
+    int node = -1, best_cost = 0;
+    float best_distance = 0;
+    for (int y = y0; y < yn; y++)
+        for (int x = x0; x < xn; x++) {
+            int c = getCellCost(costs_[x + y * nx_]);
+            if (c < 0)
+                continue;
+            float d = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+            if (node < 0 || c < best_cost || (c == best_cost && d < best_distance)) {
+                node = x + y * nx_;
+                best_cost = c;
+                best_distance = d;
+            }
+        }
+    nodes_[b] = node;
+}
+
+void Roadmap::buildEdges(int b) {
+    int x = b % bx_, y = b / bx_;
+    for (int k = 0; k < EDGES; k++) {
+        int i = x + EDGE_X[k], j = y + EDGE_Y[k];
+        float cost = -1;
+        if (nodes_[b] >= 0 && i >= 0 && j >= 0 && i < bx_ && j < by_ && nodes_[i + j * bx_] >= 0)
+            cost = getLineCost(&costs_[0], nodes_[b], nodes_[i + j * bx_]);
+        edges_[b * EDGES + k] = cost;
+    }
+}
+
+float Roadmap::getLineCost(const unsigned char* costs, int from, int to) const {
+    int x = from % nx_, y = from / nx_, x1 = to % nx_, y1 = to / nx_;
+    int dx = x1 - x, dy = y1 - y;
+    int sx = dx > 0 ? 1 : -1, sy = dy > 0 ? 1 : -1;
+
+    // every cell the line goes through, from the middle of one cell to the middle of the other, and both cells
+    // beside a corner it passes exactly
+    float next_x = dx ? 0.5 / abs(dx) : 2, next_y = dy ? 0.5 / abs(dy) : 2;
+    float step_x = dx ? 1.0 / abs(dx) : 0, step_y = dy ? 1.0 / abs(dy) : 0;
+    float sum = 0;
+    int cells = 0;
+    while (true) {
+        int c = getCellCost(costs[x + y * nx_]);
+        if (c < 0)
+            return -1;
+        sum += neutral_cost_ + factor_ * c;
+        cells++;
+        if (x == x1 && y == y1)
+            break;
+
+        if (next_x == next_y) {
+            if (getCellCost(costs[x + sx + y * nx_]) < 0 || getCellCost(costs[x + (y + sy) * nx_]) < 0)
+                return -1;
+            x += sx;
+            y += sy;
+            next_x += step_x;
+            next_y += step_y;
+        } else if (next_x < next_y) {
+            x += sx;
+            next_x += step_x;
+        } else {
+            y += sy;
+            next_y += step_y;
+        }
+    }
+    return sum / cells * hypot(dx, dy);
+}
+
+bool Roadmap::findRoute(const unsigned char* costs, int start_x, int start_y, int end_x, int end_y,
+                        std::vector<int>& route) {
+    route.clear();
+    if (stale_ || start_x < 0 || start_y < 0 || end_x < 0 || end_y < 0 || start_x >= nx_ || start_y >= ny_
+            || end_x >= nx_ || end_y >= ny_)
+        return false;
+
+    // the end cell has an index of its own after the blocks, it is reached from the nodes around it
+    int ns = bx_ * by_, end_b = ns;
+    int start = start_x + start_y * nx_, end = end_x + end_y * nx_;
+    int sx = start_x / spacing_, sy = start_y / spacing_, ex = end_x / spacing_, ey = end_y / spacing_;
+
+    std::vector<int> blocks;
+    bool found = false;
+    for (int tries = 0; tries < MAX_ROUTES && !found; tries++) {
+        cost_.assign(ns + 1, POT_HIGH);
+        parent_.assign(ns + 1, -1);
+        queue_.clear();
+
+        // the start is joined to the nodes of the blocks around it it can see
+        for (int j = std::max(sy - 1, 0); j <= std::min(sy + 1, by_ - 1); j++)
+            for (int i = std::max(sx - 1, 0); i <= std::min(sx + 1, bx_ - 1); i++) {
+                int b = i + j * bx_;
+                if (nodes_[b] < 0)
+                    continue;
+                float c = getLineCost(costs, start, nodes_[b]);
+                if (c < 0)
+                    continue;
+                cost_[b] = c;
+                queue_.push_back(Index(b, c + hypot(nodes_[b] % nx_ - end_x, nodes_[b] / nx_ - end_y) * neutral_cost_));
+                std::push_heap(queue_.begin(), queue_.end(), greater1());
+            }
+
+        bool reached = false;
+        while (!queue_.empty()) {
+            Index top = queue_[0];
+            std::pop_heap(queue_.begin(), queue_.end(), greater1());
+            queue_.pop_back();
+
+            int b = top.i;
+            if (b == end_b) {
+                reached = true;
+                break;
+            }
+            int x = b % bx_, y = b / bx_;
+            float h = hypot(nodes_[b] % nx_ - end_x, nodes_[b] / nx_ - end_y) * neutral_cost_;
+            if (top.cost > cost_[b] + h)
+                continue;
+
+            if (abs(x - ex) <= 1 && abs(y - ey) <= 1) {
+                float c = getLineCost(costs, nodes_[b], end);
+                if (c >= 0 && cost_[b] + c < cost_[end_b]) {
+                    cost_[end_b] = cost_[b] + c;
+                    parent_[end_b] = b;
+                    queue_.push_back(Index(end_b, cost_[end_b]));
+                    std::push_heap(queue_.begin(), queue_.end(), greater1());
+                }
+            }
+
+            for (int k = 0; k < EDGES; k++) {
+                int e = b * EDGES + k;
+                if (edges_[e] < 0 || blocked_[e])
+                    continue;
+                int n = x + EDGE_X[k] + (y + EDGE_Y[k]) * bx_;
+                float c = cost_[b] + edges_[e];
+                if (c >= cost_[n])
+                    continue;
+                cost_[n] = c;
+                parent_[n] = b;
+                queue_.push_back(Index(n, c + hypot(nodes_[n] % nx_ - end_x, nodes_[n] / nx_ - end_y) * neutral_cost_));
+                std::push_heap(queue_.begin(), queue_.end(), greater1());
+            }
+        }
+        if (!reached)
+            break;
+
+        blocks.clear();
+        for (int b = parent_[end_b]; b >= 0; b = parent_[b])
+            blocks.push_back(b);
+        std::reverse(blocks.begin(), blocks.end());
+
+        // the edges were built from the static costs, those that are blocked now are left out of the next search
+        found = true;
+        for (unsigned int r = 0; r + 1 < blocks.size(); r++) {
+            int a = blocks[r], n = blocks[r + 1];
+            if (getLineCost(costs, nodes_[a], nodes_[n]) >= 0)
+                continue;
+            int k = 0;
+            while (a % bx_ + EDGE_X[k] != n % bx_ || a / bx_ + EDGE_Y[k] != n / bx_)
+                k++;
+            blocked_[a * EDGES + k] = blocked_[n * EDGES + (k ^ 1)] = 1;
+            blocked_list_.push_back(a * EDGES + k);
+            blocked_list_.push_back(n * EDGES + (k ^ 1));
+            found = false;
+        }
+    }
+
+    for (unsigned int k = 0; k < blocked_list_.size(); k++)
+        blocked_[blocked_list_[k]] = 0;
+    blocked_list_.clear();
+    if (!found)
+        return false;
+
+    for (unsigned int r = 0; r < blocks.size(); r++)
+        route.push_back(nodes_[blocks[r]]);
+    return true;
+}
+
+uint64_t Roadmap::checksum(const unsigned char* costs, int n) const {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < n; i++) {
+        hash ^= costs[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool Roadmap::save(const std::string& filename) const {
+    if (stale_)
+        return false;
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (!file)
+        return false;
+
+    uint64_t hash = checksum(&costs_[0], nx_ * ny_);
+    unsigned char flags[3] = { lethal_cost_, neutral_cost_, unknown_ };
+    bool ok = fwrite(MAGIC, sizeof(MAGIC), 1, file) == 1 && fwrite(&nx_, sizeof(nx_), 1, file) == 1
+            && fwrite(&ny_, sizeof(ny_), 1, file) == 1 && fwrite(&spacing_, sizeof(spacing_), 1, file) == 1
+            && fwrite(flags, sizeof(flags), 1, file) == 1 && fwrite(&factor_, sizeof(factor_), 1, file) == 1
+            && fwrite(&hash, sizeof(hash), 1, file) == 1
+            && fwrite(&nodes_[0], sizeof(int), nodes_.size(), file) == nodes_.size()
+            && fwrite(&edges_[0], sizeof(float), edges_.size(), file) == edges_.size();
+    return fclose(file) == 0 && ok;
+}
+
+bool Roadmap::load(const std::string& filename, const unsigned char* costs, int nx, int ny) {
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (!file)
+        return false;
+
+    char magic[4];
+    int file_nx, file_ny, spacing;
+    unsigned char flags[3];
+    float factor;
+    uint64_t hash;
+    bool ok = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0
+            && fread(&file_nx, sizeof(file_nx), 1, file) == 1 && fread(&file_ny, sizeof(file_ny), 1, file) == 1
+            && fread(&spacing, sizeof(spacing), 1, file) == 1 && fread(flags, sizeof(flags), 1, file) == 1
+            && fread(&factor, sizeof(factor), 1, file) == 1 && fread(&hash, sizeof(hash), 1, file) == 1;
+    ok = ok && file_nx == nx && file_ny == ny && spacing == spacing_ && flags[0] == lethal_cost_
+            && flags[1] == neutral_cost_ && flags[2] == unknown_ && factor == factor_ && hash == checksum(costs, nx * ny);
+
+    int bx = (nx + spacing_ - 1) / spacing_, by = (ny + spacing_ - 1) / spacing_;
+    std::vector<int> nodes(ok ? bx * by : 0);
+    std::vector<float> edges(ok ? bx * by * EDGES : 0);
+    ok = ok && fread(&nodes[0], sizeof(int), nodes.size(), file) == nodes.size()
+            && fread(&edges[0], sizeof(float), edges.size(), file) == edges.size();
+    fclose(file);
+    if (!ok)
+        return false;
+
+    nx_ = nx;
+    ny_ = ny;
+    bx_ = bx;
+    by_ = by;
+    costs_.assign(costs, costs + nx * ny);
+    nodes_.swap(nodes);
+    edges_.swap(edges);
+    blocked_.assign(bx_ * by_ * EDGES, 0);
+    stale_ = false;
+    return true;
+}
+
+} //end namespace global_planner
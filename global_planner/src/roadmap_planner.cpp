@@ -0,0 +1,211 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#include <global_planner/roadmap_planner.h>
+#include <global_planner/planner_core.h>
+#include <global_planner/roadmap.h>
+#include <pluginlib/class_list_macros.h>
+#include <nav_msgs/Path.h>
+#include <boost/thread/locks.hpp>
+#include <algorithm>
+#include <math.h>
+
+//register this planner as a BaseGlobalPlanner plugin
+PLUGINLIB_EXPORT_CLASS(global_planner::RoadmapPlanner, nav_core::BaseGlobalPlanner)
+
+namespace global_planner {
+
+RoadmapPlanner::RoadmapPlanner() :
+        costmap_ros_(NULL), static_layer_(NULL), leg_planner_(NULL), roadmap_(NULL), cache_checked_(false),
+        min_distance_(0.0), initialized_(false) {
+}
+
+RoadmapPlanner::RoadmapPlanner(std::string name, costmap_2d::Costmap2DROS* costmap_ros) :
+        costmap_ros_(NULL), static_layer_(NULL), leg_planner_(NULL), roadmap_(NULL), cache_checked_(false),
+        min_distance_(0.0), initialized_(false) {
+    initialize(name, costmap_ros);
+}
+
+RoadmapPlanner::~RoadmapPlanner() {
+    delete leg_planner_;
+    delete roadmap_;
+}
+
+void RoadmapPlanner::initialize(std::string name, costmap_2d::Costmap2DROS* costmap_ros) {
+    if (initialized_) {
+        ROS_WARN("This planner has already been initialized, you can't call it twice, doing nothing");
+        return;
+    }
+    ros::NodeHandle private_nh("~/" + name);
+    costmap_ros_ = costmap_ros;
+
+    //the roadmap is built from the layer of the static map, the layers are named after the costmap they are in
+    std::string static_layer;
+    private_nh.param("static_layer", static_layer, std::string("static_layer"));
+    std::vector<boost::shared_ptr<costmap_2d::Layer> >* plugins = costmap_ros->getLayeredCostmap()->getPlugins();
+    for (unsigned int i = 0; i < plugins->size() && !static_layer_; i++) {
+        std::string layer = (*plugins)[i]->getName();
+        if (layer.size() > static_layer.size()
+                && layer.compare(layer.size() - static_layer.size() - 1, std::string::npos, "/" + static_layer) == 0)
+            static_layer_ = dynamic_cast<costmap_2d::CostmapLayer*>((*plugins)[i].get());
+    }
+    if (!static_layer_)
+        ROS_WARN("The costmap has no layer called %s, planning the whole way on the grid", static_layer.c_str());
+
+    double spacing, cost_factor;
+    int lethal_cost, neutral_cost;
+    bool allow_unknown;
+    private_nh.param("roadmap_spacing", spacing, 2.0);
+    private_nh.param("lethal_cost", lethal_cost, 253);
+    private_nh.param("neutral_cost", neutral_cost, 50);
+    private_nh.param("cost_factor", cost_factor, 3.0);
+    private_nh.param("roadmap_allow_unknown", allow_unknown, false);
+    private_nh.param("roadmap_cache", cache_file_, std::string(""));
+    private_nh.param("min_distance", min_distance_, 2 * spacing);
+
+    roadmap_ = new Roadmap((int) (spacing / costmap_ros->getCostmap()->getResolution()));
+    roadmap_->setCosts(lethal_cost, neutral_cost, cost_factor, allow_unknown);
+
+    leg_planner_ = new GlobalPlanner();
+    leg_planner_->initialize(name + "/legs", costmap_ros);
+
+    plan_pub_ = private_nh.advertise<nav_msgs::Path>("plan", 1);
+    initialized_ = true;
+}
+
+bool RoadmapPlanner::updateRoadmap() {
+    if (!static_layer_)
+        return false;
+    boost::shared_lock<boost::shared_mutex> lock(*(static_layer_->getLock()));
+    int nx = static_layer_->getSizeInCellsX(), ny = static_layer_->getSizeInCellsY();
+    unsigned char* costs = static_layer_->getCharMap();
+
+    //the static layer only starts once it has the map, so the cache is checked against the first one
+    if (!cache_checked_ && !cache_file_.empty()) {
+        cache_checked_ = true;
+        if (roadmap_->load(cache_file_, costs, nx, ny)) {
+            ROS_INFO("Read the roadmap from %s", cache_file_.c_str());
+            return true;
+        }
+    }
+    if (roadmap_->update(costs, nx, ny) && !cache_file_.empty() && !roadmap_->save(cache_file_))
+        ROS_WARN("Failed to write the roadmap to %s", cache_file_.c_str());
+    return true;
+}
+
+bool RoadmapPlanner::makePlan(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal,
+                              std::vector<geometry_msgs::PoseStamped>& plan) {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (!initialized_) {
+        ROS_ERROR(
+                "This planner has not been initialized yet, but it is being used, please call initialize() before use");
+        return false;
+    }
+    plan.clear();
+
+    double dx = goal.pose.position.x - start.pose.position.x, dy = goal.pose.position.y - start.pose.position.y;
+    if (hypot(dx, dy) >= min_distance_ && updateRoadmap() && makeRoutePlan(start, goal, plan)) {
+        nav_msgs::Path gui_path;
+        gui_path.header = plan[0].header;
+        gui_path.poses = plan;
+        plan_pub_.publish(gui_path);
+        return true;
+    }
+
+    ROS_DEBUG("No route on the roadmap, planning the whole way on the grid");
+    return leg_planner_->makePlan(start, goal, plan);
+}
+
+bool RoadmapPlanner::makeRoutePlan(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal,
+                                   std::vector<geometry_msgs::PoseStamped>& plan) {
+    costmap_2d::Costmap2D* costmap = costmap_ros_->getCostmap();
+    unsigned int start_x, start_y, goal_x, goal_y;
+    if (!costmap->worldToMap(start.pose.position.x, start.pose.position.y, start_x, start_y)
+            || !costmap->worldToMap(goal.pose.position.x, goal.pose.position.y, goal_x, goal_y))
+        return false;
+
+    //the route is checked against the whole costmap, which has to be of the size of the static map
+    {
+        boost::shared_lock<boost::shared_mutex> lock(*(costmap->getLock()));
+        if (costmap->getSizeInCellsX() != static_layer_->getSizeInCellsX()
+                || costmap->getSizeInCellsY() != static_layer_->getSizeInCellsY())
+            return false;
+        if (!roadmap_->findRoute(costmap->getCharMap(), start_x, start_y, goal_x, goal_y, route_))
+            return false;
+    }
+
+    unsigned int nx = costmap->getSizeInCellsX();
+    geometry_msgs::PoseStamped entry = start, exit;
+    entry.pose.orientation.x = 0.0;
+    entry.pose.orientation.y = 0.0;
+    entry.pose.orientation.z = 0.0;
+    entry.pose.orientation.w = 1.0;
+    exit = entry;
+    costmap->mapToWorld(route_.front() % nx, route_.front() / nx, entry.pose.position.x, entry.pose.position.y);
+    costmap->mapToWorld(route_.back() % nx, route_.back() / nx, exit.pose.position.x, exit.pose.position.y);
+
+    std::vector<geometry_msgs::PoseStamped> leg;
+    if (!leg_planner_->makePlan(start, entry, leg))
+        return false;
+    plan = leg;
+
+    //the edges are straight, they are filled in at the resolution of the costmap
+    double resolution = costmap->getResolution();
+    geometry_msgs::PoseStamped pose = entry;
+    for (unsigned int r = 0; r + 1 < route_.size(); r++) {
+        double x0, y0, x1, y1;
+        costmap->mapToWorld(route_[r] % nx, route_[r] / nx, x0, y0);
+        costmap->mapToWorld(route_[r + 1] % nx, route_[r + 1] / nx, x1, y1);
+        int steps = std::max((int) ceil(hypot(x1 - x0, y1 - y0) / resolution), 1);
+        for (int s = 1; s <= steps; s++) {
+            pose.pose.position.x = x0 + (x1 - x0) * s / steps;
+            pose.pose.position.y = y0 + (y1 - y0) * s / steps;
+            plan.push_back(pose);
+        }
+    }
+
+    if (!leg_planner_->makePlan(exit, goal, leg)) {
+        plan.clear();
+        return false;
+    }
+    plan.insert(plan.end(), leg.begin() + 1, leg.end());
+
+    ros::Time plan_time = ros::Time::now();
+    for (unsigned int i = 0; i < plan.size(); i++)
+        plan[i].header.stamp = plan_time;
+    return true;
+}
+
+} //end namespace global_planner
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <gtest/gtest.h>
+#include <global_planner/path_smoother.h>
+#include <costmap_2d/cost_values.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+using global_planner::PathSmoother;
+
+typedef std::vector<std::pair<float, float> > Path;
+
+static unsigned char cellCost(const std::vector<unsigned char>& costs, int nx, float x, float y)
+{
+    return costs[(int)floor(x) + (int)floor(y) * nx];
+}
+
+// the highest cost a line between the points crosses, sampled finely; the samples are kept off the corners of
+// the cells, a line that only touches a cell at its corner does not cross it
+static unsigned char lineCost(const std::vector<unsigned char>& costs, int nx, const std::pair<float, float>& a,
+                              const std::pair<float, float>& b)
+{
+    unsigned char highest = 0;
+    int steps = (int)(hypot(b.first - a.first, b.second - a.second) * 100) + 1;
+    for (int s = 0; s <= steps; s++) {
+        float t = (s + 0.37f) / (steps + 1);
+        highest = std::max(highest, cellCost(costs, nx, a.first + t * (b.first - a.first),
+                                             a.second + t * (b.second - a.second)));
+    }
+    return highest;
+}
+
+// smooth costs with lethal blobs, and a walk of cell centers through it that never enters a lethal cell nor
+// comes back to a cell, so every point of the path is distinct
+static void randomCase(int nx, int ny, unsigned int seed, std::vector<unsigned char>& costs, Path& path)
+{
+    srand(seed);
+    costs.assign(nx * ny, 0);
+    for (int y = 0; y < ny; y++)
+        for (int x = 0; x < nx; x++)
+            costs[x + y * nx] = (unsigned char)(100 + 90 * sin(x * 0.3) * cos(y * 0.2));
+    for (int b = 0; b < 15; b++) {
+        int bx = rand() % nx, by = rand() % ny;
+        for (int y = std::max(0, by - 2); y < std::min(ny, by + 3); y++)
+            for (int x = std::max(0, bx - 2); x < std::min(nx, bx + 3); x++)
+                costs[x + y * nx] = costmap_2d::LETHAL_OBSTACLE;
+    }
+
+    int x = nx / 2, y = ny / 2;
+    for (int dy = -2; dy <= 2; dy++)
+        for (int dx = -2; dx <= 2; dx++)
+            costs[x + dx + (y + dy) * nx] = 0;
+    std::vector<bool> visited(nx * ny, false);
+    visited[x + y * nx] = true;
+    path.clear();
+    path.push_back(std::make_pair(x + 0.5f, y + 0.5f));
+    int dx = 1, dy = 0;
+    for (int tries = 0; path.size() < 300 && tries < 100000; tries++) {
+        // mostly keep going, the walk gets long straight stretches to cut
+        if (rand() % 6 == 0) {
+            dx = rand() % 3 - 1;
+            dy = rand() % 3 - 1;
+        }
+        int mx = x + dx, my = y + dy;
+        if ((dx == 0 && dy == 0) || mx < 0 || my < 0 || mx >= nx || my >= ny
+            || costs[mx + my * nx] >= costmap_2d::INSCRIBED_INFLATED_OBSTACLE || visited[mx + my * nx]) {
+            dx = rand() % 3 - 1;
+            dy = rand() % 3 - 1;
+            continue;
+        }
+        x = mx;
+        y = my;
+        visited[x + y * nx] = true;
+        path.push_back(std::make_pair(x + 0.5f, y + 0.5f));
+    }
+}
+
+TEST(path_smoother, shortcuts_cross_no_costlier_cells)
+{
+    const int nx = 60, ny = 50;
+    for (unsigned int seed = 0; seed < 20; seed++) {
+        std::vector<unsigned char> costs;
+        Path path;
+        randomCase(nx, ny, seed, costs, path);
+
+        Path smoothed = path;
+        PathSmoother smoother;
+        smoother.setMaxSegment(15.0);
+        smoother.smooth(&costs[0], nx, ny, 0.0, smoothed);
+        ASSERT_GE(smoothed.size(), 2u);
+        EXPECT_LT(smoothed.size(), path.size()) << "seed " << seed;
+        EXPECT_EQ(path.front(), smoothed.front());
+        EXPECT_EQ(path.back(), smoothed.back());
+
+        // every point is one of the path, in order, and its segment costs no more than the points it replaced
+        unsigned int i = 0;
+        for (unsigned int j = 1; j < smoothed.size(); j++) {
+            unsigned int k = i + 1;
+            while (k < path.size() && path[k] != smoothed[j])
+                k++;
+            ASSERT_LT(k, path.size()) << "seed " << seed << " point " << j;
+
+            unsigned char limit = 0;
+            for (unsigned int p = i; p <= k; p++)
+                limit = std::max(limit, cellCost(costs, nx, path[p].first, path[p].second));
+            EXPECT_LE(lineCost(costs, nx, path[i], path[k]), limit) << "seed " << seed << " point " << j;
+            EXPECT_LE(hypot(path[k].first - path[i].first, path[k].second - path[i].second), 15.0);
+            i = k;
+        }
+    }
+}
+
+TEST(path_smoother, keeps_around_a_costly_corner)
+{
+    // a free map with a costly block, the path goes around its corner
+    const int nx = 30, ny = 30;
+    std::vector<unsigned char> costs(nx * ny, 0);
+    for (int y = 10; y < 20; y++)
+        for (int x = 10; x < 20; x++)
+            costs[x + y * nx] = 120;
+
+    Path path;
+    for (int x = 5; x <= 22; x++)
+        path.push_back(std::make_pair(x + 0.5f, 7.5f));
+    for (int y = 8; y <= 25; y++)
+        path.push_back(std::make_pair(22.5f, y + 0.5f));
+
+    Path smoothed = path;
+    PathSmoother smoother;
+    smoother.setMaxSegment(100.0);
+    smoother.smooth(&costs[0], nx, ny, 0.0, smoothed);
+
+    // the free corner stays, both legs become a single segment
+    ASSERT_EQ(3u, smoothed.size());
+    EXPECT_EQ(path.front(), smoothed[0]);
+    EXPECT_EQ(path.back(), smoothed[2]);
+    for (unsigned int j = 1; j < smoothed.size(); j++)
+        EXPECT_EQ(0, lineCost(costs, nx, smoothed[j - 1], smoothed[j]));
+
+    // a block no costlier than the path is cut through
+    std::fill(costs.begin(), costs.end(), 120);
+    smoothed = path;
+    smoother.smooth(&costs[0], nx, ny, 0.0, smoothed);
+    EXPECT_EQ(2u, smoothed.size());
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <gtest/gtest.h>
+#include <global_planner/quadratic_calculator.h>
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+using global_planner::BatchQuadraticCalculator;
+using global_planner::QuadraticCalculator;
+
+// batches of every length up to a few SSE2 blocks, so the scalar tail is covered too
+TEST(quadratic_calculator, batch_matches_single_cells)
+{
+  const int nx = 40, ny = 30;
+  QuadraticCalculator single(nx, ny);
+  BatchQuadraticCalculator batch(nx, ny);
+
+  srand(42);
+  std::vector<float> potential(nx * ny);
+  for (unsigned int i = 0; i < potential.size(); ++i)
+    potential[i] = rand() % 8 == 0 ? 1.0e10 : (rand() % 100000) / 10.0f;
+
+  for (int count = 1; count <= 19; ++count)
+  {
+    std::vector<int> cells(count);
+    std::vector<float> costs(count), out(count);
+    for (int i = 0; i < count; ++i)
+    {
+      cells[i] = (1 + rand() % (ny - 2)) * nx + 1 + rand() % (nx - 2);
+      // fractional costs are truncated like the unsigned char of calculatePotential()
+      costs[i] = 50 + rand() % 200 + (rand() % 10) / 10.0f;
+    }
+    batch.calculatePotentials(&potential[0], &costs[0], &cells[0], count, &out[0]);
+
+    for (int i = 0; i < count; ++i)
+    {
+      float expected = single.calculatePotential(&potential[0], (unsigned char)costs[i], cells[i], -1);
+      EXPECT_NEAR(expected, out[i], 1e-5 * std::max(1.0f, expected)) << "cell " << i << " of " << count;
+    }
+  }
+}
+
+// the neighbors that are exactly one cost apart sit on the switch to the ta-only update
+TEST(quadratic_calculator, batch_matches_at_the_branch)
+{
+  const int nx = 3, ny = 3;
+  QuadraticCalculator single(nx, ny);
+  BatchQuadraticCalculator batch(nx, ny);
+  float potential[] = {0, 100, 0,
+                       150, 0, 250,
+                       0, 200, 0};
+  int cells[] = {4, 4, 4, 4, 4};
+  float costs[] = {1, 49, 50, 51, 252};
+  float out[5];
+  batch.calculatePotentials(potential, costs, cells, 5, out);
+  for (int i = 0; i < 5; ++i)
+  {
+    float expected = single.calculatePotential(potential, (unsigned char)costs[i], 4, -1);
+    EXPECT_NEAR(expected, out[i], 1e-3) << "cost " << costs[i];
+  }
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef MAP_SERVER_MAP_FILE_H
+#define MAP_SERVER_MAP_FILE_H
+
+#include <string>
+#include "nav_msgs/OccupancyGrid.h"
+
+namespace map_server
+{
+
+/** Write a map in the binary map format: a header with the size, resolution
+ * and origin followed by the occupancy values, which are read back without
+ * decoding an image.
+ *
+ * With a tile size the cells are stored in square tiles, each one run length
+ * encoded if compress is set, so mostly free or unknown maps stay small.
+ *
+ * @param path The file to write, it is replaced as a whole
+ * @param map The map to write, the header is not stored
+ * @param tile_size The side of the tiles in cells, 0 stores the cells as one block
+ * @param compress Whether the tiles are run length encoded
+ * @return False if the file could not be written
+ */
+bool writeMapFile(const std::string& path, const nav_msgs::OccupancyGrid& map,
+                  unsigned int tile_size = 0, bool compress = false);
+
+/** Read a map written by writeMapFile().
+ *
+ * The file is mapped into memory, an untiled map is copied into the cells
+ * in one piece.
+ *
+ * @param path The file to read
+ * @param map Is filled with the map info and cells, the header is left alone
+ * @return False if the file can't be read or is malformed
+ */
+bool readMapFile(const std::string& path, nav_msgs::OccupancyGrid& map);
+
+/** Whether a file starts like a binary map file. */
+bool isMapFile(const std::string& path);
+
+}
+
+#endif
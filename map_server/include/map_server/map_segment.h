@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef MAP_SERVER_MAP_SEGMENT_H
+#define MAP_SERVER_MAP_SEGMENT_H
+
+#include <string>
+#include "nav_msgs/OccupancyGrid.h"
+
+namespace map_server
+{
+
+/** Write a map into a shared memory segment, so processes on the same host
+ * can get it without deserializing a message.
+ *
+ * The segment is replaced as a whole, readers that still have the old one
+ * mapped keep a consistent copy of it.
+ *
+ * @param name The name of the segment, without the leading slash
+ * @param map The map to write
+ * @return False if the segment could not be created
+ */
+bool writeMapSegment(const std::string& name, const nav_msgs::OccupancyGrid& map);
+
+/** Read a map written by writeMapSegment().
+ *
+ * @param name The name of the segment, without the leading slash
+ * @param map Is filled with the map, the header stamp is not stored
+ * @return False if there is no segment or it is malformed
+ */
+bool readMapSegment(const std::string& name, nav_msgs::OccupancyGrid& map);
+
+}
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef MAP_SERVER_MAP_SERVER_NODE_H
+#define MAP_SERVER_MAP_SERVER_NODE_H
+
+#include <map>
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+#include "ros/ros.h"
+#include "tf/transform_listener.h"
+#include "map_msgs/GetMapROI.h"
+#include "nav_msgs/GetMap.h"
+#include "nav_msgs/LoadMap.h"
+#include "nav_msgs/MapMetaData.h"
+#include "nav_msgs/OccupancyGrid.h"
+
+namespace map_server
+{
+
+/** Loads a map and offers it on the latched map topic and the static_map
+ * service.
+ *
+ * The map is published as a shared message, so subscribers in the same
+ * process (nodelets in the same manager) get it without a copy.
+ *
+ * Parts of the map are offered on the static_map_roi service. With
+ * ~window_size set, the map topic carries only the window of that size around
+ * ~window_frame, published again each time the robot gets
+ * ~window_update_distance away from its center, for rolling global costmaps
+ * that never need the whole map.
+ *
+ * The maps of ~maps, a dictionary of map ids and the files to load them
+ * from, are loaded up front next to the first one. The change_map service
+ * switches to one of them by its id, or to the map loaded from any other file
+ * given instead. Each map keeps the load time it got when it was loaded, so
+ * consumers can tell a map they saw before from a new one and keep what they
+ * built from it.
+ */
+class MapServer
+{
+  public:
+    /** Load the map and start offering it
+     *
+     * @param fname The map description file or a binary map file, or the image with the deprecated interface
+     * @param res The resolution of the image with the deprecated interface, 0 otherwise
+     * @param nh The handle the topics and the service are advertised on
+     * @param private_nh The handle the parameters are read from
+     * @throws std::runtime_error If the map can't be loaded
+     */
+    MapServer(const std::string& fname, double res, ros::NodeHandle nh = ros::NodeHandle(),
+              ros::NodeHandle private_nh = ros::NodeHandle("~"));
+
+  private:
+    ros::NodeHandle n;
+    ros::NodeHandle private_nh_;
+    ros::Publisher map_pub;
+    ros::Publisher metadata_pub;
+    ros::ServiceServer service;
+    ros::ServiceServer roi_service;
+    ros::ServiceServer change_map_service_;
+    std::string frame_id_;
+    std::string segment_;
+    ros::Time last_load_time_;
+
+    /** Load a map with a new load time
+     * @throws std::runtime_error If the map can't be loaded
+     */
+    nav_msgs::OccupancyGridPtr loadMap(const std::string& fname, double res);
+
+    /** Offer the current map on the topics and the shared memory segment */
+    void publishMap();
+
+    /** Callback invoked when someone requests our service */
+    bool mapCallback(nav_msgs::GetMap::Request  &req,
+                     nav_msgs::GetMap::Response &res );
+
+    /** Callback invoked when someone requests a part of the map */
+    bool roiCallback(map_msgs::GetMapROI::Request  &req,
+                     map_msgs::GetMapROI::Response &res );
+
+    /** Callback invoked when someone switches to another map */
+    bool changeMapCallback(nav_msgs::LoadMap::Request  &req,
+                           nav_msgs::LoadMap::Response &res );
+
+    /** Publish the window around the robot if it moved far enough from the last one */
+    void updateWindow(const ros::TimerEvent& event);
+
+    boost::shared_ptr<tf::TransformListener> tf_;
+    ros::Timer window_timer_;
+    std::string window_frame_;
+    double window_size_, window_update_distance_;
+    double window_x_, window_y_;
+    nav_msgs::OccupancyGridConstPtr window_;
+
+    /** The map data is cached here, to be published and sent out to service callers
+     */
+    nav_msgs::MapMetaData meta_data_message_;
+    nav_msgs::OccupancyGridConstPtr map_;
+
+    /** Every map loaded so far by its id or file, the current one included */
+    std::map<std::string, nav_msgs::OccupancyGridConstPtr> maps_;
+};
+
+}
+
+#endif
@@ -33,8 +33,11 @@
  * Author: Brian Gerkey
  */
 
+#include <cctype>
 #include <cstring>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -51,6 +54,116 @@
 namespace map_server
 {
 
+/** Fill a table with the map value of every gray level of a one channel image,
+ * the same values the per pixel conversion computes for an opaque pixel of
+ * that gray. */
+static void
+computeOccupancyLut(bool negate, double occ_th, double free_th, bool trinary,
+                    signed char* lut)
+{
+  for(int color = 0; color < 256; color++)
+  {
+    double occ;
+    if(negate)
+      occ = color / 255.0;
+    else
+      occ = (255 - color) / 255.0;
+
+    unsigned char value;
+    if(occ > occ_th)
+      value = +100;
+    else if(occ < free_th)
+      value = 0;
+    else if(trinary)
+      value = -1;
+    else {
+      double ratio = (occ - free_th) / (occ_th - free_th);
+      value = 99 * ratio;
+    }
+    lut[color] = value;
+  }
+}
+
+/** Map the gray levels in the cells of a map to map values, rows in parallel
+ * when OpenMP is available. */
+static void
+applyOccupancyLut(const signed char* lut, unsigned int width, unsigned int height,
+                  std::vector<signed char>& data)
+{
+  int rows = height;
+#pragma omp parallel for schedule(static)
+  for(int j = 0; j < rows; j++)
+  {
+    signed char* row = &data[(size_t)j * width];
+    for(unsigned int i = 0; i < width; i++)
+      row[i] = lut[(unsigned char)row[i]];
+  }
+}
+
+/** Read the next token of a PNM header, skipping whitespace and comments. */
+static bool
+readPnmToken(FILE* file, std::string& token)
+{
+  token.clear();
+  int c = fgetc(file);
+  while(c != EOF && (isspace(c) || c == '#'))
+  {
+    if(c == '#')
+      while(c != EOF && c != '\n')
+        c = fgetc(file);
+    c = fgetc(file);
+  }
+  while(c != EOF && !isspace(c))
+  {
+    token.push_back(c);
+    c = fgetc(file);
+  }
+  // the single whitespace after the token has been consumed
+  return !token.empty();
+}
+
+/** Load an 8 bit binary PGM straight into the cells of the map, flipping the
+ * rows while reading them.
+ *
+ * @return False if the file is not an 8 bit binary PGM, so the generic loader
+ *         has to be used
+ * @throws std::runtime_error If the file is a PGM but is truncated
+ */
+static bool
+loadGrayPgm(nav_msgs::GetMap::Response* resp, const char* fname)
+{
+  FILE* file = fopen(fname, "rb");
+  if(!file)
+    return false;
+
+  std::string magic, width, height, maxval;
+  if(!readPnmToken(file, magic) || magic != "P5" ||
+     !readPnmToken(file, width) || !readPnmToken(file, height) ||
+     !readPnmToken(file, maxval) || atoi(maxval.c_str()) != 255 ||
+     atoi(width.c_str()) <= 0 || atoi(height.c_str()) <= 0)
+  {
+    fclose(file);
+    return false;
+  }
+
+  resp->map.info.width = atoi(width.c_str());
+  resp->map.info.height = atoi(height.c_str());
+  resp->map.data.resize((size_t)resp->map.info.width * resp->map.info.height);
+
+  // the image starts with the top row, the map with the bottom one
+  for(unsigned int j = 0; j < resp->map.info.height; j++)
+  {
+    signed char* row = &resp->map.data[MAP_IDX((size_t)resp->map.info.width, 0, resp->map.info.height - j - 1)];
+    if(fread(row, 1, resp->map.info.width, file) != resp->map.info.width)
+    {
+      fclose(file);
+      throw std::runtime_error(std::string("truncated image file \"") + fname + "\"");
+    }
+  }
+  fclose(file);
+  return true;
+}
+
 void
 loadMapFromFile(nav_msgs::GetMap::Response* resp,
                 const char* fname, double res, bool negate,
@@ -70,6 +183,28 @@ loadMapFromFile(nav_msgs::GetMap::Response* resp,
   int color_sum;
   double color_avg;
 
+  resp->map.info.resolution = res;
+  resp->map.info.origin.position.x = *(origin);
+  resp->map.info.origin.position.y = *(origin+1);
+  resp->map.info.origin.position.z = 0.0;
+  tf::Quaternion q;
+  q.setRPY(0,0, *(origin+2));
+  resp->map.info.origin.orientation.x = q.x();
+  resp->map.info.origin.orientation.y = q.y();
+  resp->map.info.origin.orientation.z = q.z();
+  resp->map.info.origin.orientation.w = q.w();
+
+  // Gray levels map to values through a table, the same one for every cell
+  signed char lut[256];
+  computeOccupancyLut(negate, occ_th, free_th, trinary, lut);
+
+  // 8 bit PGMs are read without SDL, straight into the map
+  if(loadGrayPgm(resp, fname))
+  {
+    applyOccupancyLut(lut, resp->map.info.width, resp->map.info.height, resp->map.data);
+    return;
+  }
+
   // Load the image using SDL.  If we get NULL back, the image load failed.
   if(!(img = IMG_Load(fname)))
   {
@@ -81,16 +216,6 @@ loadMapFromFile(nav_msgs::GetMap::Response* resp,
   // Copy the image data into the map structure
   resp->map.info.width = img->w;
   resp->map.info.height = img->h;
-  resp->map.info.resolution = res;
-  resp->map.info.origin.position.x = *(origin);
-  resp->map.info.origin.position.y = *(origin+1);
-  resp->map.info.origin.position.z = 0.0;
-  tf::Quaternion q;
-  q.setRPY(0,0, *(origin+2));
-  resp->map.info.origin.orientation.x = q.x();
-  resp->map.info.origin.orientation.y = q.y();
-  resp->map.info.origin.orientation.z = q.z();
-  resp->map.info.origin.orientation.w = q.w();
 
   // Allocate space to hold the data
   resp->map.data.resize(resp->map.info.width * resp->map.info.height);
@@ -99,13 +224,27 @@ loadMapFromFile(nav_msgs::GetMap::Response* resp,
   rowstride = img->pitch;
   n_channels = img->format->BytesPerPixel;
 
-  if (trinary || n_channels == 1)
+  // Only images with an alpha channel have a last channel that is not a color
+  bool has_alpha = img->format->Amask != 0;
+  if (trinary || !has_alpha)
     avg_channels = n_channels;
   else
     avg_channels = n_channels - 1;
 
   // Copy pixel data into the map structure
   pixels = (unsigned char*)(img->pixels);
+
+  // One channel images (gray PNGs) are copied row by row and then go through the table
+  if (n_channels == 1)
+  {
+    for(j = 0; j < resp->map.info.height; j++)
+      memcpy(&resp->map.data[MAP_IDX(resp->map.info.width, 0, resp->map.info.height - j - 1)],
+             pixels + j*rowstride, resp->map.info.width);
+    SDL_FreeSurface(img);
+    applyOccupancyLut(lut, resp->map.info.width, resp->map.info.height, resp->map.data);
+    return;
+  }
+
   for(j = 0; j < resp->map.info.height; j++)
   {
     for (i = 0; i < resp->map.info.width; i++)
@@ -117,10 +256,7 @@ loadMapFromFile(nav_msgs::GetMap::Response* resp,
         color_sum += *(p + (k));
       color_avg = color_sum / (double)avg_channels;
 
-      if (n_channels == 1)
-          alpha = 1;
-      else
-          alpha = *(p+n_channels-1);
+      alpha = has_alpha ? *(p+n_channels-1) : 255;
 
       // If negate is true, we consider blacker pixels free, and whiter
       // pixels free.  Otherwise, it's vice versa.
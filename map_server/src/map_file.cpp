@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "map_server/map_file.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+namespace map_server
+{
+
+static const char FILE_MAGIC[8] = { 'M', 'A', 'P', 'F', 'I', 'L', 'E', '1' };
+
+enum { TILE_RAW = 0, TILE_RLE = 1 };
+
+struct FileHeader
+{
+  char magic[8];
+  uint32_t width, height;
+  double resolution;
+  double position[3];
+  double orientation[4];
+  uint32_t tile_size;  // 0 when the cells follow as one block
+  uint32_t encoding;
+};
+
+/** Append the cells of a tile, row by row, as (count, value) pairs. */
+static void encodeRuns(const signed char* cells, unsigned int stride, unsigned int width,
+                       unsigned int height, std::vector<char>& out)
+{
+  unsigned int count = 0;
+  signed char value = 0;
+  for (unsigned int j = 0; j < height; j++)
+  {
+    const signed char* row = cells + (size_t)j * stride;
+    for (unsigned int i = 0; i < width; i++)
+    {
+      if (count > 0 && (row[i] != value || count == 255))
+      {
+        out.push_back((char)count);
+        out.push_back(value);
+        count = 0;
+      }
+      value = row[i];
+      count++;
+    }
+  }
+  if (count > 0)
+  {
+    out.push_back((char)count);
+    out.push_back(value);
+  }
+}
+
+/** Expand the runs of a tile into the cells of the map.
+ * @return False if the runs don't cover the tile exactly */
+static bool decodeRuns(const unsigned char* in, size_t length, signed char* cells, unsigned int stride,
+                       unsigned int width, unsigned int height)
+{
+  size_t total = (size_t)width * height, done = 0;
+  for (size_t k = 0; k + 1 < length; k += 2)
+  {
+    unsigned int count = in[k];
+    if (count == 0 || done + count > total)
+      return false;
+    // a run can wrap over several rows of the tile
+    while (count > 0)
+    {
+      unsigned int i = done % width, j = done / width;
+      unsigned int n = std::min(count, width - i);
+      memset(cells + (size_t)j * stride + i, (signed char)in[k + 1], n);
+      count -= n;
+      done += n;
+    }
+  }
+  return length % 2 == 0 && done == total;
+}
+
+bool writeMapFile(const std::string& path, const nav_msgs::OccupancyGrid& map,
+                  unsigned int tile_size, bool compress)
+{
+  size_t cells = (size_t)map.info.width * map.info.height;
+  if (map.data.size() != cells)
+    return false;
+
+  FileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+  header.width = map.info.width;
+  header.height = map.info.height;
+  header.resolution = map.info.resolution;
+  header.position[0] = map.info.origin.position.x;
+  header.position[1] = map.info.origin.position.y;
+  header.position[2] = map.info.origin.position.z;
+  header.orientation[0] = map.info.origin.orientation.x;
+  header.orientation[1] = map.info.origin.orientation.y;
+  header.orientation[2] = map.info.origin.orientation.z;
+  header.orientation[3] = map.info.origin.orientation.w;
+  header.tile_size = tile_size;
+  header.encoding = compress && tile_size > 0 ? TILE_RLE : TILE_RAW;
+
+  // the tiles follow a table with the offset of each of them and of the end of the file
+  std::vector<uint64_t> offsets;
+  std::vector<char> tiles;
+  if (tile_size > 0)
+  {
+    unsigned int tiles_x = (header.width + tile_size - 1) / tile_size;
+    unsigned int tiles_y = (header.height + tile_size - 1) / tile_size;
+    uint64_t base = sizeof(header) + ((uint64_t)tiles_x * tiles_y + 1) * sizeof(uint64_t);
+    for (unsigned int ty = 0; ty < tiles_y; ty++)
+      for (unsigned int tx = 0; tx < tiles_x; tx++)
+      {
+        offsets.push_back(base + tiles.size());
+        unsigned int x0 = tx * tile_size, y0 = ty * tile_size;
+        unsigned int w = std::min(tile_size, header.width - x0), h = std::min(tile_size, header.height - y0);
+        const signed char* origin = &map.data[(size_t)y0 * header.width + x0];
+        if (header.encoding == TILE_RLE)
+          encodeRuns(origin, header.width, w, h, tiles);
+        else
+          for (unsigned int j = 0; j < h; j++)
+            tiles.insert(tiles.end(), origin + (size_t)j * header.width, origin + (size_t)j * header.width + w);
+      }
+    offsets.push_back(base + tiles.size());
+  }
+
+  // written next to the target and renamed, so a reader never sees half a map
+  std::string tmp = path + ".tmp";
+  FILE* out = fopen(tmp.c_str(), "wb");
+  if (!out)
+    return false;
+  bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+  if (tile_size > 0)
+  {
+    ok = ok && fwrite(&offsets[0], sizeof(uint64_t), offsets.size(), out) == offsets.size();
+    ok = ok && (tiles.empty() || fwrite(&tiles[0], 1, tiles.size(), out) == tiles.size());
+  }
+  else
+    ok = ok && (cells == 0 || fwrite(&map.data[0], 1, cells, out) == cells);
+  ok = fclose(out) == 0 && ok;
+  if (!ok || rename(tmp.c_str(), path.c_str()) != 0)
+  {
+    unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+/** Fill the cells from the data of a mapped file.
+ * @return False if the data does not match the header */
+static bool readCells(const FileHeader& header, const char* data, size_t length, nav_msgs::OccupancyGrid& map)
+{
+  size_t cells = (size_t)header.width * header.height;
+  if (header.tile_size == 0)
+  {
+    if (header.encoding != TILE_RAW || length != sizeof(header) + cells)
+      return false;
+    map.data.resize(cells);
+    if (cells > 0)
+      memcpy(&map.data[0], data + sizeof(header), cells);
+    return true;
+  }
+
+  if (header.encoding != TILE_RAW && header.encoding != TILE_RLE)
+    return false;
+  unsigned int tile_size = header.tile_size;
+  size_t tiles_x = (header.width + (size_t)tile_size - 1) / tile_size;
+  size_t tiles_y = (header.height + (size_t)tile_size - 1) / tile_size;
+  size_t table = (tiles_x * tiles_y + 1) * sizeof(uint64_t);
+  if (length < sizeof(header) + table)
+    return false;
+  std::vector<uint64_t> offsets(tiles_x * tiles_y + 1);
+  memcpy(&offsets[0], data + sizeof(header), table);
+  if (offsets.back() != length)
+    return false;
+
+  map.data.resize(cells);
+  for (size_t ty = 0; ty < tiles_y; ty++)
+    for (size_t tx = 0; tx < tiles_x; tx++)
+    {
+      size_t k = ty * tiles_x + tx;
+      if (offsets[k] < sizeof(header) + table || offsets[k] > offsets[k + 1])
+        return false;
+      const unsigned char* tile = (const unsigned char*)data + offsets[k];
+      size_t tile_length = offsets[k + 1] - offsets[k];
+      unsigned int x0 = tx * tile_size, y0 = ty * tile_size;
+      unsigned int w = std::min(tile_size, header.width - x0), h = std::min(tile_size, header.height - y0);
+      signed char* origin = &map.data[(size_t)y0 * header.width + x0];
+      if (header.encoding == TILE_RLE)
+      {
+        if (!decodeRuns(tile, tile_length, origin, header.width, w, h))
+          return false;
+      }
+      else
+      {
+        if (tile_length != (size_t)w * h)
+          return false;
+        for (unsigned int j = 0; j < h; j++)
+          memcpy(origin + (size_t)j * header.width, tile + (size_t)j * w, w);
+      }
+    }
+  return true;
+}
+
+bool readMapFile(const std::string& path, nav_msgs::OccupancyGrid& map)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FileHeader))
+  {
+    close(fd);
+    return false;
+  }
+  size_t length = st.st_size;
+  void* data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+
+  FileHeader header;
+  memcpy(&header, data, sizeof(header));
+  bool valid = memcmp(header.magic, FILE_MAGIC, sizeof(header.magic)) == 0 &&
+      readCells(header, (const char*)data, length, map);
+  if (valid)
+  {
+    map.info.width = header.width;
+    map.info.height = header.height;
+    map.info.resolution = header.resolution;
+    map.info.origin.position.x = header.position[0];
+    map.info.origin.position.y = header.position[1];
+    map.info.origin.position.z = header.position[2];
+    map.info.origin.orientation.x = header.orientation[0];
+    map.info.origin.orientation.y = header.orientation[1];
+    map.info.origin.orientation.z = header.orientation[2];
+    map.info.origin.orientation.w = header.orientation[3];
+  }
+  munmap(data, length);
+  return valid;
+}
+
+bool isMapFile(const std::string& path)
+{
+  char magic[sizeof(FILE_MAGIC)];
+  FILE* in = fopen(path.c_str(), "rb");
+  if (!in)
+    return false;
+  bool match = fread(magic, sizeof(magic), 1, in) == 1 && memcmp(magic, FILE_MAGIC, sizeof(magic)) == 0;
+  fclose(in);
+  return match;
+}
+
+}
@@ -29,13 +29,64 @@
  */
 
 #include <cstdio>
+#include <vector>
 #include "ros/ros.h"
 #include "ros/console.h"
 #include "nav_msgs/GetMap.h"
 #include "tf/LinearMath/Matrix3x3.h"
 #include "geometry_msgs/Quaternion.h"
+#include "map_server/map_file.h"
+#ifdef HAVE_PNG
+#include <png.h>
+#endif
 
 using namespace std;
+
+/** Write an image as a binary PGM in a single write. */
+static bool writePgm(const std::string& path, const std::vector<unsigned char>& image,
+                     unsigned int width, unsigned int height, double resolution)
+{
+  FILE* out = fopen(path.c_str(), "w");
+  if (!out)
+    return false;
+  fprintf(out, "P5\n# CREATOR: Map_generator.cpp %.3f m/pix\n%d %d\n255\n",
+          resolution, width, height);
+  bool ok = image.empty() || fwrite(&image[0], 1, image.size(), out) == image.size();
+  return fclose(out) == 0 && ok;
+}
+
+#ifdef HAVE_PNG
+/** Write an image as a gray PNG, compressed for speed rather than size. */
+static bool writePng(const std::string& path, const std::vector<unsigned char>& image,
+                     unsigned int width, unsigned int height)
+{
+  FILE* out = fopen(path.c_str(), "wb");
+  if (!out)
+    return false;
+  png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop info = png ? png_create_info_struct(png) : NULL;
+  if (!info || setjmp(png_jmpbuf(png)))
+  {
+    png_destroy_write_struct(&png, &info);
+    fclose(out);
+    return false;
+  }
+  png_init_io(png, out);
+  png_set_compression_level(png, 1);
+  png_set_filter(png, 0, PNG_FILTER_NONE);
+  png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_GRAY, PNG_INTERLACE_NONE,
+               PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  std::vector<png_bytep> rows(height);
+  for(unsigned int y = 0; y < height; y++)
+    rows[y] = (png_bytep)&image[(size_t)y * width];
+  png_write_info(png, info);
+  if (height > 0)
+    png_write_image(png, &rows[0]);
+  png_write_end(png, NULL);
+  png_destroy_write_struct(&png, &info);
+  return fclose(out) == 0;
+}
+#endif
  
 /**
  * @brief Map generation node.
@@ -44,7 +95,8 @@ class MapGenerator
 {
 
   public:
-    MapGenerator(const std::string& mapname) : mapname_(mapname), saved_map_(false)
+    MapGenerator(const std::string& mapname, bool binary, bool png) :
+      mapname_(mapname), binary_(binary), png_(png), saved_map_(false)
     {
       ros::NodeHandle n;
       ROS_INFO("Waiting for the map");
@@ -59,32 +111,49 @@ class MapGenerator
                map->info.resolution);
 
 
-      std::string mapdatafile = mapname_ + ".pgm";
-      ROS_INFO("Writing map occupancy data to %s", mapdatafile.c_str());
-      FILE* out = fopen(mapdatafile.c_str(), "w");
-      if (!out)
+      if (binary_)
       {
-        ROS_ERROR("Couldn't save map file to %s", mapdatafile.c_str());
+        // map_server loads this one as it is, the cells keep their exact values
+        std::string mapfile = mapname_ + ".map";
+        ROS_INFO("Writing binary map to %s", mapfile.c_str());
+        if (!map_server::writeMapFile(mapfile, *map, 256, true))
+          ROS_ERROR("Couldn't save map file to %s", mapfile.c_str());
+        else
+          ROS_INFO("Done\n");
+        saved_map_ = true;
         return;
       }
 
-      fprintf(out, "P5\n# CREATOR: Map_generator.cpp %.3f m/pix\n%d %d\n255\n",
-              map->info.resolution, map->info.width, map->info.height);
-      for(unsigned int y = 0; y < map->info.height; y++) {
-        for(unsigned int x = 0; x < map->info.width; x++) {
-          unsigned int i = x + (map->info.height - y - 1) * map->info.width;
-          if (map->data[i] == 0) { //occ [0,0.1)
-            fputc(254, out);
-          } else if (map->data[i] == +100) { //occ (0.65,1]
-            fputc(000, out);
-          } else { //occ [0.1,0.65]
-            fputc(205, out);
-          }
-        }
+      // every cell value has its gray level in a table, rows are converted in one pass
+      unsigned char gray[256];
+      for(int value = 0; value < 256; value++)
+        gray[value] = 205; //occ [0.1,0.65]
+      gray[0] = 254; //occ [0,0.1)
+      gray[100] = 000; //occ (0.65,1]
+
+      unsigned int width = map->info.width, height = map->info.height;
+      std::vector<unsigned char> image((size_t)width * height);
+      for(unsigned int y = 0; y < height; y++) {
+        const signed char* cells = &map->data[(size_t)(height - y - 1) * width];
+        unsigned char* row = &image[(size_t)y * width];
+        for(unsigned int x = 0; x < width; x++)
+          row[x] = gray[(unsigned char)cells[x]];
       }
 
-      fclose(out);
-
+      std::string mapdatafile = mapname_ + (png_ ? ".png" : ".pgm");
+      ROS_INFO("Writing map occupancy data to %s", mapdatafile.c_str());
+      bool written;
+#ifdef HAVE_PNG
+      if (png_)
+        written = writePng(mapdatafile, image, width, height);
+      else
+#endif
+        written = writePgm(mapdatafile, image, width, height, map->info.resolution);
+      if (!written)
+      {
+        ROS_ERROR("Couldn't save map file to %s", mapdatafile.c_str());
+        return;
+      }
 
       std::string mapmetadatafile = mapname_ + ".yaml";
       ROS_INFO("Writing map occupancy data to %s", mapmetadatafile.c_str());
@@ -116,6 +185,8 @@ free_thresh: 0.196
     }
 
     std::string mapname_;
+    bool binary_;
+    bool png_;
     ros::Subscriber map_sub_;
     bool saved_map_;
 
@@ -123,12 +194,16 @@ free_thresh: 0.196
 
 #define USAGE "Usage: \n" \
               "  map_saver -h\n"\
-              "  map_saver [-f <mapname>] [ROS remapping args]"
+              "  map_saver [-f <mapname>] [-b | -p] [ROS remapping args]\n"\
+              "  -p: write the image as <mapname>.png instead of <mapname>.pgm\n"\
+              "  -b: write <mapname>.map in the binary map format instead of an image and a description"
 
 int main(int argc, char** argv) 
 {
   ros::init(argc, argv, "map_saver");
   std::string mapname = "map";
+  bool binary = false;
+  bool png = false;
 
   for(int i=1; i<argc; i++)
   {
@@ -147,6 +222,19 @@ int main(int argc, char** argv)
         return 1;
       }
     }
+    else if(!strcmp(argv[i], "-b"))
+    {
+      binary = true;
+    }
+    else if(!strcmp(argv[i], "-p"))
+    {
+#ifdef HAVE_PNG
+      png = true;
+#else
+      puts("map_saver was built without PNG support");
+      return 1;
+#endif
+    }
     else
     {
       puts(USAGE);
@@ -154,7 +242,7 @@ int main(int argc, char** argv)
     }
   }
   
-  MapGenerator mg(mapname);
+  MapGenerator mg(mapname, binary, png);
 
   while(!mg.saved_map_)
     ros::spinOnce();
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "map_server/map_segment.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace map_server
+{
+
+static const char SEGMENT_MAGIC[8] = { 'M', 'A', 'P', 'S', 'E', 'G', '0', '1' };
+
+struct SegmentHeader
+{
+  char magic[8];
+  uint32_t width, height;
+  double resolution;
+  double position[3];
+  double orientation[4];
+  int32_t load_time_sec, load_time_nsec;
+  char frame_id[64];
+};
+
+bool writeMapSegment(const std::string& name, const nav_msgs::OccupancyGrid& map)
+{
+  SegmentHeader header;
+  memset(&header, 0, sizeof(header));
+  if (map.header.frame_id.size() >= sizeof(header.frame_id) ||
+      map.data.size() != (size_t)map.info.width * map.info.height)
+    return false;
+
+  memcpy(header.magic, SEGMENT_MAGIC, sizeof(header.magic));
+  header.width = map.info.width;
+  header.height = map.info.height;
+  header.resolution = map.info.resolution;
+  header.position[0] = map.info.origin.position.x;
+  header.position[1] = map.info.origin.position.y;
+  header.position[2] = map.info.origin.position.z;
+  header.orientation[0] = map.info.origin.orientation.x;
+  header.orientation[1] = map.info.origin.orientation.y;
+  header.orientation[2] = map.info.origin.orientation.z;
+  header.orientation[3] = map.info.origin.orientation.w;
+  header.load_time_sec = map.info.map_load_time.sec;
+  header.load_time_nsec = map.info.map_load_time.nsec;
+  memcpy(header.frame_id, map.header.frame_id.c_str(), map.header.frame_id.size());
+
+  // a fresh segment replaces the old one, so readers never see it half written
+  std::string path = "/" + name;
+  shm_unlink(path.c_str());
+  int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0)
+    return false;
+
+  size_t length = sizeof(header) + map.data.size();
+  if (ftruncate(fd, length) != 0)
+  {
+    close(fd);
+    shm_unlink(path.c_str());
+    return false;
+  }
+  void* data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+  {
+    shm_unlink(path.c_str());
+    return false;
+  }
+  if (!map.data.empty())
+    memcpy((char*)data + sizeof(header), &map.data[0], map.data.size());
+  memcpy(data, &header, sizeof(header));
+  munmap(data, length);
+  return true;
+}
+
+bool readMapSegment(const std::string& name, nav_msgs::OccupancyGrid& map)
+{
+  std::string path = "/" + name;
+  int fd = shm_open(path.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SegmentHeader))
+  {
+    close(fd);
+    return false;
+  }
+  size_t length = st.st_size;
+  void* data = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+
+  SegmentHeader header;
+  memcpy(&header, data, sizeof(header));
+  size_t cells = (size_t)header.width * header.height;
+  bool valid = memcmp(header.magic, SEGMENT_MAGIC, sizeof(header.magic)) == 0 &&
+      length == sizeof(header) + cells;
+  if (valid)
+  {
+    map.header.frame_id = std::string(header.frame_id, strnlen(header.frame_id, sizeof(header.frame_id)));
+    map.info.width = header.width;
+    map.info.height = header.height;
+    map.info.resolution = header.resolution;
+    map.info.origin.position.x = header.position[0];
+    map.info.origin.position.y = header.position[1];
+    map.info.origin.position.z = header.position[2];
+    map.info.origin.orientation.x = header.orientation[0];
+    map.info.origin.orientation.y = header.orientation[1];
+    map.info.origin.orientation.z = header.orientation[2];
+    map.info.origin.orientation.w = header.orientation[3];
+    map.info.map_load_time.sec = header.load_time_sec;
+    map.info.map_load_time.nsec = header.load_time_nsec;
+    map.data.resize(cells);
+    if (cells > 0)
+      memcpy(&map.data[0], (const char*)data + sizeof(header), cells);
+  }
+  munmap(data, length);
+  return valid;
+}
+
+}
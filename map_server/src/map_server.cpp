@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Author: Brian Gerkey */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <libgen.h>
+#include <math.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+#include "ros/console.h"
+#include "map_server/map_server.h"
+#include "map_server/image_loader.h"
+#include "map_server/map_file.h"
+#include "map_server/map_segment.h"
+#include "yaml-cpp/yaml.h"
+
+#ifdef HAVE_NEW_YAMLCPP
+// The >> operator disappeared in yaml-cpp 0.5, so this function is
+// added to provide support for code written under the yaml-cpp 0.3 API.
+template<typename T>
+void operator >> (const YAML::Node& node, T& i)
+{
+  i = node.as<T>();
+}
+#endif
+
+namespace map_server
+{
+
+/** Copy the cells of a map that cover a l_x by l_y rectangle centered on
+ * (x, y), both in the frame of the map, keeping the cells aligned with it.
+ *
+ * @return False if the rectangle does not overlap the map
+ */
+static bool extractSubMap(const nav_msgs::OccupancyGrid& map, double x, double y, double l_x, double l_y,
+                          nav_msgs::OccupancyGrid& sub)
+{
+  // the rectangle in the axes of the grid, which may be rotated
+  double yaw = tf::getYaw(map.info.origin.orientation);
+  double c = cos(yaw), s = sin(yaw);
+  double dx = x - map.info.origin.position.x, dy = y - map.info.origin.position.y;
+  double gx = c * dx + s * dy, gy = -s * dx + c * dy;
+  double res = map.info.resolution;
+  double width = map.info.width, height = map.info.height;
+  int x0 = std::min(width, std::max(0.0, floor((gx - l_x / 2) / res)));
+  int y0 = std::min(height, std::max(0.0, floor((gy - l_y / 2) / res)));
+  int xn = std::min(width, std::max(0.0, ceil((gx + l_x / 2) / res)));
+  int yn = std::min(height, std::max(0.0, ceil((gy + l_y / 2) / res)));
+  if (x0 >= xn || y0 >= yn)
+    return false;
+
+  sub.header = map.header;
+  sub.info = map.info;
+  sub.info.width = xn - x0;
+  sub.info.height = yn - y0;
+  sub.info.origin.position.x = map.info.origin.position.x + (c * x0 - s * y0) * res;
+  sub.info.origin.position.y = map.info.origin.position.y + (s * x0 + c * y0) * res;
+  sub.data.resize((size_t)sub.info.width * sub.info.height);
+  for (int j = y0; j < yn; j++)
+    std::copy(map.data.begin() + (size_t)j * map.info.width + x0, map.data.begin() + (size_t)j * map.info.width + xn,
+              sub.data.begin() + (size_t)(j - y0) * sub.info.width);
+  return true;
+}
+
+MapServer::MapServer(const std::string& fname, double res, ros::NodeHandle nh, ros::NodeHandle private_nh) :
+  n(nh), private_nh_(private_nh)
+{
+  private_nh_.param("frame_id", frame_id_, std::string("map"));
+  map_ = loadMap(fname, res);
+  maps_[fname] = map_;
+
+  // the other maps are loaded up front, so switching to one of them on change_map costs no loading
+  std::map<std::string, std::string> maps;
+  private_nh_.getParam("maps", maps);
+  for (std::map<std::string, std::string>::const_iterator it = maps.begin(); it != maps.end(); ++it)
+  {
+    ROS_INFO("Preloading map %s", it->first.c_str());
+    maps_[it->first] = loadMap(it->second, 0.0);
+  }
+
+  // processes on this host can map the cells instead of deserializing them, the metadata tells them when
+  private_nh_.param("map_segment", segment_, std::string(""));
+
+  service = n.advertiseService("static_map", &MapServer::mapCallback, this);
+  roi_service = n.advertiseService("static_map_roi", &MapServer::roiCallback, this);
+  change_map_service_ = n.advertiseService("change_map", &MapServer::changeMapCallback, this);
+
+  // Latched publisher for metadata
+  metadata_pub= n.advertise<nav_msgs::MapMetaData>("map_metadata", 1, true);
+
+  // Latched publisher for data
+  map_pub = n.advertise<nav_msgs::OccupancyGrid>("map", 1, true);
+
+  // with a window only the neighborhood of the robot is published, as it moves
+  private_nh_.param("window_size", window_size_, 0.0);
+  private_nh_.param("window_update_distance", window_update_distance_, window_size_ / 4);
+  private_nh_.param("window_frame", window_frame_, std::string("base_link"));
+  double window_frequency;
+  private_nh_.param("window_frequency", window_frequency, 2.0);
+  if (window_size_ > 0 && window_frequency > 0) {
+    ROS_INFO("Publishing a %.1f m window of the map around %s", window_size_, window_frame_.c_str());
+    tf_.reset(new tf::TransformListener(n));
+    window_timer_ = n.createTimer(ros::Duration(1.0 / window_frequency), &MapServer::updateWindow, this);
+  }
+  publishMap();
+}
+
+nav_msgs::OccupancyGridPtr MapServer::loadMap(const std::string& fname, double res)
+{
+  std::string mapfname = "";   
+  double origin[3];
+  int negate;
+  double occ_th, free_th;
+  bool trinary = true;
+  bool deprecated = (res != 0);
+  if (!deprecated && isMapFile(fname)) {
+    // a binary map file carries its resolution and origin, no description needed
+    mapfname = fname;
+  } else if (!deprecated) {
+    //mapfname = fname + ".pgm";
+    //std::ifstream fin((fname + ".yaml").c_str());
+    std::ifstream fin(fname.c_str());
+    if (fin.fail()) {
+      ROS_ERROR("Map_server could not open %s.", fname.c_str());
+      throw std::runtime_error("Could not load the map");
+    }
+#ifdef HAVE_NEW_YAMLCPP
+    // The document loading process changed in yaml-cpp 0.5.
+    YAML::Node doc = YAML::Load(fin);
+#else
+    YAML::Parser parser(fin);
+    YAML::Node doc;
+    parser.GetNextDocument(doc);
+#endif
+    try { 
+      doc["resolution"] >> res; 
+    } catch (YAML::InvalidScalar) { 
+      ROS_ERROR("The map does not contain a resolution tag or it is invalid.");
+      throw std::runtime_error("Could not load the map");
+    }
+    try { 
+      doc["negate"] >> negate; 
+    } catch (YAML::InvalidScalar) { 
+      ROS_ERROR("The map does not contain a negate tag or it is invalid.");
+      throw std::runtime_error("Could not load the map");
+    }
+    try { 
+      doc["occupied_thresh"] >> occ_th; 
+    } catch (YAML::InvalidScalar) { 
+      ROS_ERROR("The map does not contain an occupied_thresh tag or it is invalid.");
+      throw std::runtime_error("Could not load the map");
+    }
+    try { 
+      doc["free_thresh"] >> free_th; 
+    } catch (YAML::InvalidScalar) { 
+      ROS_ERROR("The map does not contain a free_thresh tag or it is invalid.");
+      throw std::runtime_error("Could not load the map");
+    }
+    try { 
+      doc["trinary"] >> trinary; 
+    } catch (YAML::Exception) { 
+      ROS_DEBUG("The map does not contain a trinary tag or it is invalid... assuming true");
+      trinary = true;
+    }
+    try { 
+      doc["origin"][0] >> origin[0]; 
+      doc["origin"][1] >> origin[1]; 
+      doc["origin"][2] >> origin[2]; 
+    } catch (YAML::InvalidScalar) { 
+      ROS_ERROR("The map does not contain an origin tag or it is invalid.");
+      throw std::runtime_error("Could not load the map");
+    }
+    try { 
+      doc["image"] >> mapfname; 
+      // TODO: make this path-handling more robust
+      if(mapfname.size() == 0)
+      {
+        ROS_ERROR("The image tag cannot be an empty string.");
+        throw std::runtime_error("Could not load the map");
+      }
+      if(mapfname[0] != '/')
+      {
+        // dirname can modify what you pass it
+        char* fname_copy = strdup(fname.c_str());
+        mapfname = std::string(dirname(fname_copy)) + '/' + mapfname;
+        free(fname_copy);
+      }
+    } catch (YAML::InvalidScalar) { 
+      ROS_ERROR("The map does not contain an image tag or it is invalid.");
+      throw std::runtime_error("Could not load the map");
+    }
+  } else {
+    private_nh_.param("negate", negate, 0);
+    private_nh_.param("occupied_thresh", occ_th, 0.65);
+    private_nh_.param("free_thresh", free_th, 0.196);
+    mapfname = fname;
+    origin[0] = origin[1] = origin[2] = 0.0;
+  }
+
+  nav_msgs::OccupancyGridPtr map(new nav_msgs::OccupancyGrid());
+  if (isMapFile(mapfname)) {
+    // the cells are stored as they are published, there is nothing to decode
+    ROS_INFO("Loading map from binary map file \"%s\"", mapfname.c_str());
+    if (!readMapFile(mapfname, *map)) {
+      ROS_ERROR("The binary map file %s is malformed.", mapfname.c_str());
+      throw std::runtime_error("Could not load the map");
+    }
+  } else {
+    ROS_INFO("Loading map from image \"%s\"", mapfname.c_str());
+    nav_msgs::GetMap::Response map_resp;
+    map_server::loadMapFromFile(&map_resp,mapfname.c_str(),res,negate,occ_th,free_th, origin, trinary);
+    map->info = map_resp.map.info;
+    map->data.swap(map_resp.map.data);
+  }
+  // the load time tells the maps apart, so consumers can keep what they built from each of them
+  map->info.map_load_time = ros::Time::now();
+  if (map->info.map_load_time <= last_load_time_)
+    map->info.map_load_time = last_load_time_ + ros::Duration(0, 1);
+  last_load_time_ = map->info.map_load_time;
+  map->header.frame_id = frame_id_;
+  map->header.stamp = ros::Time::now();
+  ROS_INFO("Read a %d X %d map @ %.3lf m/cell",
+           map->info.width,
+           map->info.height,
+           map->info.resolution);
+  return map;
+}
+
+void MapServer::publishMap()
+{
+  meta_data_message_ = map_->info;
+  if (!segment_.empty() && !writeMapSegment(segment_, *map_))
+    ROS_WARN("Could not write the map to the shared memory segment %s", segment_.c_str());
+  metadata_pub.publish( meta_data_message_ );
+
+  // the window of the new map goes out on the next tick of the window timer
+  window_.reset();
+  if (!tf_)
+    map_pub.publish( map_ );
+}
+
+void MapServer::updateWindow(const ros::TimerEvent& event)
+{
+  tf::StampedTransform robot;
+  try {
+    tf_->lookupTransform(map_->header.frame_id, window_frame_, ros::Time(0), robot);
+  } catch (tf::TransformException& ex) {
+    ROS_WARN_THROTTLE(5.0, "No window of the map is published, the robot pose is unknown: %s", ex.what());
+    return;
+  }
+
+  double x = robot.getOrigin().x(), y = robot.getOrigin().y();
+  if (window_ && hypot(x - window_x_, y - window_y_) < window_update_distance_)
+    return;
+
+  nav_msgs::OccupancyGridPtr window(new nav_msgs::OccupancyGrid());
+  if (!extractSubMap(*map_, x, y, window_size_, window_size_, *window)) {
+    ROS_WARN_THROTTLE(5.0, "The robot is too far outside the map to publish a window of it");
+    return;
+  }
+  window->header.stamp = ros::Time::now();
+  window_ = window;
+  window_x_ = x;
+  window_y_ = y;
+  map_pub.publish( window_ );
+}
+
+bool MapServer::mapCallback(nav_msgs::GetMap::Request  &req,
+                            nav_msgs::GetMap::Response &res )
+{
+  // request is empty; we ignore it
+
+  // = operator is overloaded to make deep copy (tricky!)
+  res.map = *map_;
+  ROS_INFO("Sending map");
+
+  return true;
+}
+
+bool MapServer::roiCallback(map_msgs::GetMapROI::Request  &req,
+                            map_msgs::GetMapROI::Response &res )
+{
+  if (!extractSubMap(*map_, req.x, req.y, req.l_x, req.l_y, res.sub_map)) {
+    ROS_WARN("The requested region does not overlap the map");
+    return false;
+  }
+  ROS_DEBUG("Sending a %d X %d part of the map", res.sub_map.info.width, res.sub_map.info.height);
+  return true;
+}
+
+bool MapServer::changeMapCallback(nav_msgs::LoadMap::Request  &req,
+                                  nav_msgs::LoadMap::Response &res )
+{
+  std::map<std::string, nav_msgs::OccupancyGridConstPtr>::const_iterator it = maps_.find(req.map_url);
+  if (it != maps_.end()) {
+    map_ = it->second;
+  } else {
+    // not preloaded, the url is the path of a map description or binary map file
+    if (std::ifstream(req.map_url.c_str()).fail()) {
+      ROS_ERROR("There is no map %s", req.map_url.c_str());
+      res.result = nav_msgs::LoadMap::Response::RESULT_MAP_DOES_NOT_EXIST;
+      return true;
+    }
+    try {
+      map_ = maps_[req.map_url] = loadMap(req.map_url, 0.0);
+    } catch (std::runtime_error&) {
+      res.result = nav_msgs::LoadMap::Response::RESULT_INVALID_MAP_DATA;
+      return true;
+    }
+  }
+
+  ROS_INFO("Changed to map %s", req.map_url.c_str());
+  publishMap();
+  res.map = *map_;
+  res.result = nav_msgs::LoadMap::Response::RESULT_SUCCESS;
+  return true;
+}
+
+}
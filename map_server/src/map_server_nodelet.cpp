@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdexcept>
+
+#include <boost/shared_ptr.hpp>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include "map_server/map_server.h"
+
+namespace map_server
+{
+
+/** Runs a MapServer in a nodelet manager, so nodelets in the same manager
+ * get the map without it being serialized.
+ *
+ * Takes the same arguments as the map_server node, or the map description
+ * file in the ~yaml_filename parameter.
+ */
+class MapServerNodelet : public nodelet::Nodelet
+{
+  private:
+    virtual void onInit()
+    {
+      std::string fname;
+      double res = 0.0;
+      const std::vector<std::string>& argv = getMyArgv();
+      if (!argv.empty())
+      {
+        fname = argv[0];
+        if (argv.size() > 1)
+          res = atof(argv[1].c_str());
+      }
+      else
+        getPrivateNodeHandle().param("yaml_filename", fname, std::string(""));
+
+      try
+      {
+        server_.reset(new MapServer(fname, res, getNodeHandle(), getPrivateNodeHandle()));
+      }
+      catch(std::runtime_error& e)
+      {
+        NODELET_ERROR("map_server exception: %s", e.what());
+      }
+    }
+
+    boost::shared_ptr<MapServer> server_;
+};
+
+}
+
+PLUGINLIB_EXPORT_CLASS(map_server::MapServerNodelet, nodelet::Nodelet)
@@ -30,8 +30,11 @@
 /* Author: Brian Gerkey */
 
 #include <stdexcept> // for std::runtime_error
+#include <stdio.h>
+#include <string>
 #include <gtest/gtest.h>
 #include "map_server/image_loader.h"
+#include "map_server/map_file.h"
 #include "test_constants.h"
 
 /* Try to load a valid PNG file.  Succeeds if no exception is thrown, and if
@@ -79,6 +82,27 @@ TEST(MapServer, loadValidBMP)
   }
 }
 
+/* Try to load a valid 8 bit PGM file, which is read without SDL.  Succeeds
+ * if the loaded image matches the known dimensions and content of the file. */
+TEST(MapServer, loadValidPGM)
+{
+  try
+  {
+    nav_msgs::GetMap::Response map_resp;
+    double origin[3] = { 0.0, 0.0, 0.0 };
+    map_server::loadMapFromFile(&map_resp, g_valid_pgm_file, g_valid_image_res, false, 0.65, 0.1, origin);
+    EXPECT_FLOAT_EQ(map_resp.map.info.resolution, g_valid_image_res);
+    EXPECT_EQ(map_resp.map.info.width, g_valid_image_width);
+    EXPECT_EQ(map_resp.map.info.height, g_valid_image_height);
+    for(unsigned int i=0; i < map_resp.map.info.width * map_resp.map.info.height; i++)
+      EXPECT_EQ(g_valid_image_content[i], map_resp.map.data[i]);
+  }
+  catch(...)
+  {
+    ADD_FAILURE() << "Uncaught exception";
+  }
+}
+
 /* Try to load an invalid file.  Succeeds if a std::runtime_error exception
  * is thrown. */
 TEST(MapServer, loadInvalidFile)
@@ -101,6 +125,149 @@ TEST(MapServer, loadInvalidFile)
   ADD_FAILURE() << "Didn't throw exception as expected";
 }
 
+/* Write the test map in the binary map format, untiled, in raw tiles that
+ * don't divide the map and in run length encoded tiles.  Succeeds if each
+ * one reads back with the same info and cells. */
+TEST(MapServer, binaryMapFileRoundTrip)
+{
+  nav_msgs::OccupancyGrid map;
+  map.info.width = g_valid_image_width;
+  map.info.height = g_valid_image_height;
+  map.info.resolution = g_valid_image_res;
+  map.info.origin.position.x = -1.5;
+  map.info.origin.position.y = 2.0;
+  map.info.origin.orientation.w = 1.0;
+  map.data.assign(g_valid_image_content, g_valid_image_content + g_valid_image_width * g_valid_image_height);
+
+  const unsigned int tile_sizes[3] = { 0, 4, 3 };
+  const bool compress[3] = { false, false, true };
+  for(unsigned int k = 0; k < 3; k++)
+  {
+    ASSERT_TRUE(map_server::writeMapFile("test/testmap.map", map, tile_sizes[k], compress[k]));
+    ASSERT_TRUE(map_server::isMapFile("test/testmap.map"));
+    nav_msgs::OccupancyGrid loaded;
+    ASSERT_TRUE(map_server::readMapFile("test/testmap.map", loaded));
+    EXPECT_EQ(map.info.width, loaded.info.width);
+    EXPECT_EQ(map.info.height, loaded.info.height);
+    EXPECT_FLOAT_EQ(map.info.resolution, loaded.info.resolution);
+    EXPECT_EQ(map.info.origin.position.x, loaded.info.origin.position.x);
+    EXPECT_EQ(map.info.origin.position.y, loaded.info.origin.position.y);
+    EXPECT_EQ(map.info.origin.orientation.w, loaded.info.origin.orientation.w);
+    EXPECT_TRUE(map.data == loaded.data);
+  }
+
+  // an image is not a binary map file
+  EXPECT_FALSE(map_server::isMapFile(g_valid_pgm_file));
+  nav_msgs::OccupancyGrid loaded;
+  EXPECT_FALSE(map_server::readMapFile(g_valid_pgm_file, loaded));
+}
+
+/* Little endian integers of image headers. */
+static void putLE(std::string& out, unsigned int value, int bytes)
+{
+  for(int b = 0; b < bytes; b++)
+    out.push_back((char)((value >> (8 * b)) & 0xff));
+}
+
+/* Write a 16x16 image in which the pixel in column i of row j (from the
+ * top) has the gray level 16 * j + i, so it holds every gray level once.
+ * Channels 1 writes an 8 bit PGM, 8 an 8 bit BMP with a gray palette, 3 a
+ * 24 bit BMP and 4 a 32 bit TGA with an opaque alpha channel. */
+static void writeGrayLevels(const char* fname, int channels)
+{
+  std::string out;
+  if(channels == 1)
+  {
+    out = "P5\n16 16\n255\n";
+    for(int g = 0; g < 256; g++)
+      out.push_back((char)g);
+  }
+  else if(channels == 4)
+  {
+    // uncompressed true color, 32 bits per pixel, 8 of them alpha, top row first
+    const unsigned char header[18] = { 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 16, 0, 32, 0x28 };
+    out.assign((const char*)header, sizeof(header));
+    for(int g = 0; g < 256; g++)
+    {
+      out.append(3, (char)g);
+      out.push_back((char)255);
+    }
+  }
+  else
+  {
+    int bytes = channels == 8 ? 1 : 3;
+    int palette = channels == 8 ? 256 * 4 : 0;
+    int offset = 14 + 40 + palette;
+    out = "BM";
+    putLE(out, offset + 256 * bytes, 4);
+    putLE(out, 0, 4);
+    putLE(out, offset, 4);
+    putLE(out, 40, 4);
+    putLE(out, 16, 4);
+    putLE(out, 16, 4);
+    putLE(out, 1, 2);
+    putLE(out, 8 * bytes, 2);
+    putLE(out, 0, 4);
+    putLE(out, 256 * bytes, 4);
+    putLE(out, 2835, 4);
+    putLE(out, 2835, 4);
+    putLE(out, palette ? 256 : 0, 4);
+    putLE(out, 0, 4);
+    for(int c = 0; c < palette / 4; c++)
+    {
+      out.append(3, (char)c);
+      out.push_back(0);
+    }
+    // rows are stored bottom up, 16 pixels need no padding
+    for(int j = 15; j >= 0; j--)
+      for(int i = 0; i < 16; i++)
+        out.append(bytes, (char)(16 * j + i));
+  }
+  FILE* file = fopen(fname, "wb");
+  ASSERT_TRUE(file != NULL);
+  ASSERT_EQ(out.size(), fwrite(out.data(), 1, out.size(), file));
+  fclose(file);
+}
+
+/* Load the same gray levels through the occupancy table (8 bit PGMs and one
+ * channel images) and through the per pixel conversion (RGB and RGBA
+ * images), in every mode.  Succeeds if every gray level gets the same value
+ * on both paths.  A trinary conversion averages the alpha channel in, so the
+ * RGBA image is only compared in the other modes. */
+TEST(MapServer, occupancyTableMatchesPerPixelConversion)
+{
+  const char* files[4] = { "test/levels.pgm", "test/levels8.bmp", "test/levels24.bmp", "test/levels32.tga" };
+  const int channels[4] = { 1, 8, 3, 4 };
+  for(int f = 0; f < 4; f++)
+    writeGrayLevels(files[f], channels[f]);
+
+  const double thresholds[3][2] = { { 0.65, 0.196 }, { 0.9, 0.0 }, { 1.0, 0.5 } };
+  double origin[3] = { 0.0, 0.0, 0.0 };
+  for(int t = 0; t < 3; t++)
+  {
+    for(int mode = 0; mode < 4; mode++)
+    {
+      bool negate = mode & 1;
+      bool trinary = mode & 2;
+      nav_msgs::GetMap::Response expected;
+      map_server::loadMapFromFile(&expected, files[2], 0.1, negate, thresholds[t][0], thresholds[t][1], origin, trinary);
+      ASSERT_EQ(256u, expected.map.data.size());
+      for(int f = 0; f < 4; f++)
+      {
+        if(f == 2 || (channels[f] == 4 && trinary))
+          continue;
+        nav_msgs::GetMap::Response loaded;
+        map_server::loadMapFromFile(&loaded, files[f], 0.1, negate, thresholds[t][0], thresholds[t][1], origin, trinary);
+        ASSERT_EQ(16u, loaded.map.info.width);
+        ASSERT_EQ(16u, loaded.map.info.height);
+        for(unsigned int i = 0; i < 256; i++)
+          EXPECT_EQ(expected.map.data[i], loaded.map.data[i]) << files[f] << " mode " << mode << " thresholds " << t
+                                                              << " cell " << i;
+      }
+    }
+  }
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
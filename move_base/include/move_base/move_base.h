@@ -52,6 +52,7 @@
 #include <costmap_2d/costmap_2d_ros.h>
 #include <costmap_2d/costmap_2d.h>
 #include <nav_msgs/GetPlan.h>
+#include <move_base/plan_validator.h>
 
 #include <pluginlib/class_loader.h>
 #include <std_srvs/Empty.h>
@@ -111,6 +112,14 @@ namespace move_base {
        */
       bool clearCostmapsService(std_srvs::Empty::Request &req, std_srvs::Empty::Response &resp);
 
+      /**
+       * @brief  A service call that writes the recorded trace events to ~trace_file
+       * @param req The service request
+       * @param resp The service response
+       * @return True if the trace was written, false otherwise
+       */
+      bool dumpTraceService(std_srvs::Empty::Request &req, std_srvs::Empty::Response &resp);
+
       /**
        * @brief  A service call that can be made when the action is inactive that will return a plan
        * @param  req The goal request
@@ -146,6 +155,14 @@ namespace move_base {
        */
       void clearCostmapWindows(double size_x, double size_y);
 
+      /**
+       * @brief  Clears obstacles within a window around the robot in one costmap, under the lock of the costmap
+       * @param costmap_ros The costmap to clear
+       * @param size_x The x size of the window
+       * @param size_y The y size of the window
+       */
+      void clearCostmapWindow(costmap_2d::Costmap2DROS* costmap_ros, double size_x, double size_y);
+
       /**
        * @brief  Publishes a velocity command of zero to the base
        */
@@ -156,10 +173,29 @@ namespace move_base {
        */
       void resetState();
 
+      /**
+       * @brief  Stop the costmaps while move_base is idle, or only let them idle with idle_costmaps set
+       */
+      void shutdownCostmaps();
+
       void goalCB(const geometry_msgs::PoseStamped::ConstPtr& goal);
 
       void planThread();
 
+      /**
+       * @brief  Wait until the plan has to be made again, with replan_on_change
+       *
+       * That is when a new plan is requested, when a cell of the global costmap the plan runs
+       * through becomes an obstacle, or at the fallback rate of planner_frequency.
+       * @param lock The lock of planner_mutex_, held on entry and on return
+       */
+      void waitForReplan(boost::unique_lock<boost::mutex>& lock);
+
+      /**
+       * @brief  Check whether cells of the plan in plan_validator_ that changed since the last check are obstacles now
+       */
+      bool isPlanBlocked();
+
       void executeCb(const move_base_msgs::MoveBaseGoalConstPtr& move_base_goal);
 
       bool isQuaternionValid(const geometry_msgs::Quaternion& q);
@@ -168,6 +204,17 @@ namespace move_base {
 
       geometry_msgs::PoseStamped goalToGlobalFrame(const geometry_msgs::PoseStamped& goal_pose_msg);
 
+      /**
+       * @brief  Apply the configured scheduling priority and CPU affinity to the thread running the control loop
+       */
+      void configureControllerThread();
+
+      /**
+       * @brief  Add the duration of a control cycle to the latency histogram and report it periodically
+       * @param cycle_time The wall time the cycle took in seconds
+       */
+      void recordCycleTime(double cycle_time);
+
       tf::TransformListener& tf_;
 
       MoveBaseActionServer* as_;
@@ -187,8 +234,10 @@ namespace move_base {
       double conservative_reset_dist_, clearing_radius_;
       ros::Publisher current_goal_pub_, vel_pub_, action_goal_pub_;
       ros::Subscriber goal_sub_;
-      ros::ServiceServer make_plan_srv_, clear_costmaps_srv_;
+      ros::ServiceServer make_plan_srv_, clear_costmaps_srv_, dump_trace_srv_;
+      std::string trace_file_;
       bool shutdown_costmaps_, clearing_rotation_allowed_, recovery_behavior_enabled_;
+      bool idle_costmaps_; ///< @brief Whether shutdown_costmaps lets the costmaps idle, see Costmap2DROS::idle()
       double oscillation_timeout_, oscillation_distance_;
 
       MoveBaseState state_;
@@ -200,10 +249,11 @@ namespace move_base {
       pluginlib::ClassLoader<nav_core::BaseLocalPlanner> blp_loader_;
       pluginlib::ClassLoader<nav_core::RecoveryBehavior> recovery_loader_;
 
-      //set up plan triple buffer
-      std::vector<geometry_msgs::PoseStamped>* planner_plan_;
-      std::vector<geometry_msgs::PoseStamped>* latest_plan_;
-      std::vector<geometry_msgs::PoseStamped>* controller_plan_;
+      //plans are handed from the planner thread to the controller as shared, immutable objects
+      boost::shared_ptr<std::vector<geometry_msgs::PoseStamped> > planner_plan_; ///< @brief Filled by the planner thread, shared once complete
+      nav_core::PlanConstPtr latest_plan_; ///< @brief The newest complete plan, guarded by planner_mutex_
+      nav_core::PlanConstPtr controller_plan_; ///< @brief The plan the local planner follows
+      unsigned int latest_plan_version_; ///< @brief Counts the plans made, guarded by planner_mutex_
 
       //set up the planner's thread
       bool runPlanner_;
@@ -211,6 +261,11 @@ namespace move_base {
       boost::condition_variable planner_cond_;
       geometry_msgs::PoseStamped planner_goal_;
       boost::thread* planner_thread_;
+      bool replan_on_change_, replan_requested_; ///< @brief replan_requested_ is set by anything that wants a new plan
+      double replan_check_frequency_;
+      unsigned int changed_bounds_user_; ///< @brief The id of move_base with the changed bounds of the global costmap
+      PlanValidator plan_validator_; ///< @brief Only used by the planner thread
+      std::vector<unsigned int> blocked_poses_;
 
 
       boost::recursive_mutex configuration_mutex_;
@@ -222,6 +277,16 @@ namespace move_base {
       move_base::MoveBaseConfig default_config_;
       bool setup_, p_freq_change_, c_freq_change_;
       bool new_global_plan_;
+
+      //control loop scheduling
+      int controller_thread_priority_, controller_cpu_;
+      bool controller_thread_configured_;
+      double controller_deadline_fraction_; ///< @brief The part of a control period the local planner may use, 0 for no deadline
+      ros::WallTime cycle_deadline_; ///< @brief When the local planner has to return in the current cycle
+      double latency_report_period_;
+      std::vector<unsigned int> cycle_histogram_; ///< @brief Cycle counts in bins of a tenth of the control period, the last bin holds the rest
+      unsigned int missed_cycles_;
+      ros::WallTime last_latency_report_;
   };
 };
 #endif
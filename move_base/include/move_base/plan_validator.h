@@ -0,0 +1,100 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*
+*********************************************************************/
+#ifndef NAV_MOVE_BASE_PLAN_VALIDATOR_H_
+#define NAV_MOVE_BASE_PLAN_VALIDATOR_H_
+
+#include <vector>
+
+#include <nav_core/base_local_planner.h>
+#include <costmap_2d/costmap_2d.h>
+
+namespace move_base {
+  /**
+   * @class PlanValidator
+   * @brief Keeps the cells of a global plan sorted by costmap index, so that a changed window
+   * of the costmap can be checked against the plan without walking the whole plan
+   */
+  class PlanValidator {
+    public:
+      PlanValidator();
+
+      /**
+       * @brief  Set the plan to check, its cells are found lazily on the next check
+       */
+      void setPlan(const nav_core::PlanConstPtr& plan);
+
+      /**
+       * @brief  The plan being checked, if any
+       */
+      const nav_core::PlanConstPtr& getPlan() const { return plan_; }
+
+      /**
+       * @brief  Find the poses of the plan within a window of the costmap that are in collision now
+       *
+       * The cost of each row of the window is only looked up for the cells of the plan in it,
+       * so a check takes O(rows * log(plan cells) + plan cells in the window).
+       * The caller must hold the lock of the costmap.
+       * @param costmap The costmap the window is in
+       * @param x0 The first column of the window
+       * @param xn One past the last column of the window
+       * @param y0 The first row of the window
+       * @param yn One past the last row of the window
+       * @param blocked Will be filled with the indices of the blocked poses, in the order of their cells
+       * @return True if any pose of the plan is blocked
+       */
+      bool findBlocked(const costmap_2d::Costmap2D& costmap, unsigned int x0, unsigned int xn,
+          unsigned int y0, unsigned int yn, std::vector<unsigned int>& blocked);
+
+    private:
+      struct PlanCell {
+        unsigned int index; ///< @brief The index of the cell in the costmap
+        unsigned int pose; ///< @brief The index of the pose in the plan
+        bool operator<(const PlanCell& other) const { return index < other.index; }
+      };
+
+      /**
+       * @brief  Find the cells of the plan again if the plan or the geometry of the costmap changed
+       */
+      void updateCells(const costmap_2d::Costmap2D& costmap);
+
+      nav_core::PlanConstPtr plan_;
+      std::vector<PlanCell> cells_;
+      bool cells_valid_;
+      unsigned int size_x_, size_y_;
+      double origin_x_, origin_y_, resolution_;
+  };
+};
+#endif
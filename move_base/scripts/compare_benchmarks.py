@@ -0,0 +1,99 @@
+#! /usr/bin/env python
+#***********************************************************
+#* Software License Agreement (BSD License)
+#*
+#*  Copyright (c) 2009, Willow Garage, Inc.
+#*  All rights reserved.
+#*
+#*  Redistribution and use in source and binary forms, with or without
+#*  modification, are permitted provided that the following conditions
+#*  are met:
+#*
+#*   * Redistributions of source code must retain the above copyright
+#*     notice, this list of conditions and the following disclaimer.
+#*   * Redistributions in binary form must reproduce the above
+#*     copyright notice, this list of conditions and the following
+#*     disclaimer in the documentation and/or other materials provided
+#*     with the distribution.
+#*   * Neither the name of Willow Garage, Inc. nor the names of its
+#*     contributors may be used to endorse or promote products derived
+#*     from this software without specific prior written permission.
+#*
+#*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+#*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+#*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+#*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+#*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+#*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+#*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+#*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+#*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+#*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+#*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+#*  POSSIBILITY OF SUCH DAMAGE.
+#*
+#***********************************************************
+
+# Puts the reports of nav_benchmark for two builds side by side:
+#
+#   compare_benchmarks.py <before.txt> <after.txt>
+#
+# Every value is printed as "before -> after (change)". Lines are matched by
+# their key, the words before the first number; the outcome of a goal is
+# shown next to its key.
+
+import sys
+
+
+def is_number(word):
+    try:
+        float(word)
+        return True
+    except ValueError:
+        return False
+
+
+def read_report(path):
+    keys = []
+    report = {}
+    for line in open(path):
+        words = line.split()
+        if not words or words[0].startswith('#'):
+            continue
+        if words[0].startswith('goal_') and len(words) > 1 and not is_number(words[1]):
+            key, label, values = words[0], words[1], words[2:]
+        else:
+            n = 0
+            while n < len(words) and not is_number(words[n]):
+                n += 1
+            key, label, values = ' '.join(words[:n]), '', words[n:]
+        keys.append(key)
+        report[key] = (label, [float(v) for v in values])
+    return keys, report
+
+
+def change(a, b):
+    if a == 0.0:
+        return ''
+    return ' (%+.1f%%)' % (100.0 * (b - a) / a)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.stderr.write('USAGE: compare_benchmarks.py <before.txt> <after.txt>\n')
+        sys.exit(1)
+    keys_a, a = read_report(sys.argv[1])
+    keys_b, b = read_report(sys.argv[2])
+
+    for key in keys_a + [k for k in keys_b if k not in a]:
+        if key not in a or key not in b:
+            print('%s: only in %s' % (key, sys.argv[1] if key in a else sys.argv[2]))
+            continue
+        label_a, values_a = a[key]
+        label_b, values_b = b[key]
+        label = ' %s -> %s' % (label_a, label_b) if label_a or label_b else ''
+        values = ', '.join('%g -> %g%s' % (x, y, change(x, y)) for x, y in zip(values_a, values_b))
+        print('%s%s: %s' % (key, label, values))
+
+if __name__ == '__main__':
+    main()
@@ -36,11 +36,21 @@
 *         Mike Phillips (put the planner in its own thread)
 *********************************************************************/
 #include <move_base/move_base.h>
+#include <costmap_2d/executor.h>
+#include <nav_trace/trace.h>
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/thread.hpp>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 #include <geometry_msgs/Twist.h>
 
 namespace move_base {
@@ -52,8 +62,10 @@ namespace move_base {
     bgp_loader_("nav_core", "nav_core::BaseGlobalPlanner"),
     blp_loader_("nav_core", "nav_core::BaseLocalPlanner"), 
     recovery_loader_("nav_core", "nav_core::RecoveryBehavior"),
-    planner_plan_(NULL), latest_plan_(NULL), controller_plan_(NULL),
-    runPlanner_(false), setup_(false), p_freq_change_(false), c_freq_change_(false), new_global_plan_(false) {
+    latest_plan_version_(0),
+    runPlanner_(false), setup_(false), p_freq_change_(false), c_freq_change_(false), new_global_plan_(false),
+    controller_thread_configured_(false), cycle_histogram_(21, 0), missed_cycles_(0),
+    replan_requested_(false), changed_bounds_user_(0) {
 
     as_ = new MoveBaseActionServer(ros::NodeHandle(), "move_base", boost::bind(&MoveBase::executeCb, this, _1), false);
 
@@ -69,17 +81,47 @@ namespace move_base {
     private_nh.param("global_costmap/robot_base_frame", robot_base_frame_, std::string("base_link"));
     private_nh.param("global_costmap/global_frame", global_frame_, std::string("/map"));
     private_nh.param("planner_frequency", planner_frequency_, 0.0);
+    private_nh.param("replan_on_change", replan_on_change_, false);
+    private_nh.param("replan_check_frequency", replan_check_frequency_, 5.0);
     private_nh.param("controller_frequency", controller_frequency_, 20.0);
     private_nh.param("planner_patience", planner_patience_, 5.0);
     private_nh.param("controller_patience", controller_patience_, 15.0);
 
+    //scheduling of the control loop, which runs on the action server's thread
+    private_nh.param("controller_thread_priority", controller_thread_priority_, 0);
+    private_nh.param("controller_cpu", controller_cpu_, -1);
+    private_nh.param("controller_deadline_fraction", controller_deadline_fraction_, 0.0);
+    private_nh.param("latency_report_period", latency_report_period_, 10.0);
+
+    //the costmaps and planners share one pool of workers, it has to be sized before any of them is created
+    int navigation_threads;
+    bool pin_navigation_threads;
+    private_nh.param("navigation_threads", navigation_threads, -1);
+    private_nh.param("pin_navigation_threads", pin_navigation_threads, false);
+    if (navigation_threads >= 0 || pin_navigation_threads)
+    {
+      unsigned int threads = navigation_threads >= 0 ? navigation_threads
+                                                     : std::max(boost::thread::hardware_concurrency(), 1u) - 1;
+      if (!costmap_2d::Executor::configureGlobal(threads, pin_navigation_threads))
+        ROS_WARN("The navigation workers are already running, ignoring ~navigation_threads");
+    }
+
+    //record where the time of the planning and control cycles goes, see nav_trace/trace.h
+    int trace_buffer_size;
+    bool trace_marker;
+    private_nh.param("trace_buffer_size", trace_buffer_size, 0);
+    private_nh.param("trace_marker", trace_marker, false);
+    private_nh.param("trace_file", trace_file_, std::string("/tmp/move_base_trace.json"));
+    if(trace_buffer_size > 0)
+      nav_trace::Tracer::enable(trace_buffer_size, trace_marker);
+
     private_nh.param("oscillation_timeout", oscillation_timeout_, 0.0);
     private_nh.param("oscillation_distance", oscillation_distance_, 0.5);
 
-    //set up plan triple buffer
-    planner_plan_ = new std::vector<geometry_msgs::PoseStamped>();
-    latest_plan_ = new std::vector<geometry_msgs::PoseStamped>();
-    controller_plan_ = new std::vector<geometry_msgs::PoseStamped>();
+    //set up the plan buffers
+    planner_plan_.reset(new std::vector<geometry_msgs::PoseStamped>());
+    latest_plan_.reset(new std::vector<geometry_msgs::PoseStamped>());
+    controller_plan_ = latest_plan_;
 
     //set up the planner's thread
     planner_thread_ = new boost::thread(boost::bind(&MoveBase::planThread, this));
@@ -104,12 +146,15 @@ namespace move_base {
     private_nh.param("conservative_reset_dist", conservative_reset_dist_, 3.0);
 
     private_nh.param("shutdown_costmaps", shutdown_costmaps_, false);
+    //keep the costmaps subscribed and their layers current while idle instead, so new goals start right away
+    private_nh.param("idle_costmaps", idle_costmaps_, false);
     private_nh.param("clearing_rotation_allowed", clearing_rotation_allowed_, true);
     private_nh.param("recovery_behavior_enabled", recovery_behavior_enabled_, true);
 
     //create the ros wrapper for the planner's costmap... and initializer a pointer we'll use with the underlying map
     planner_costmap_ros_ = new costmap_2d::Costmap2DROS("global_costmap", tf_);
     planner_costmap_ros_->pause();
+    changed_bounds_user_ = planner_costmap_ros_->getLayeredCostmap()->addChangedBoundsUser();
 
     //initialize the global planner
     try {
@@ -174,11 +219,14 @@ namespace move_base {
     //advertise a service for clearing the costmaps
     clear_costmaps_srv_ = private_nh.advertiseService("clear_costmaps", &MoveBase::clearCostmapsService, this);
 
+    //advertise a service for saving the trace
+    if(nav_trace::Tracer::isEnabled())
+      dump_trace_srv_ = private_nh.advertiseService("dump_trace", &MoveBase::dumpTraceService, this);
+
     //if we shutdown our costmaps when we're deactivated... we'll do that now
     if(shutdown_costmaps_){
       ROS_DEBUG_NAMED("move_base","Stopping costmaps initially");
-      planner_costmap_ros_->stop();
-      controller_costmap_ros_->stop();
+      shutdownCostmaps();
     }
 
     //load any user specified recovery behaviors, and if that fails load the defaults
@@ -266,9 +314,9 @@ namespace move_base {
         boost::unique_lock<boost::mutex> lock(planner_mutex_);
 
         // Clean up before initializing the new planner
-        planner_plan_->clear();
-        latest_plan_->clear();
-        controller_plan_->clear();
+        //the planner thread clears its own plan before planning, the shared ones are replaced
+        latest_plan_.reset(new std::vector<geometry_msgs::PoseStamped>());
+        controller_plan_ = latest_plan_;
         resetState();
         planner_->initialize(bgp_loader_.getName(config.base_global_planner), planner_costmap_ros_);
 
@@ -301,9 +349,9 @@ namespace move_base {
         }
         tc_ = blp_loader_.createInstance(config.base_local_planner);
         // Clean up before initializing the new planner
-        planner_plan_->clear();
-        latest_plan_->clear();
-        controller_plan_->clear();
+        //the planner thread clears its own plan before planning, the shared ones are replaced
+        latest_plan_.reset(new std::vector<geometry_msgs::PoseStamped>());
+        controller_plan_ = latest_plan_;
         resetState();
         tc_->initialize(blp_loader_.getName(config.base_local_planner), &tf_, controller_costmap_ros_);
       } catch (const pluginlib::PluginlibException& ex)
@@ -327,58 +375,27 @@ namespace move_base {
   }
 
   void MoveBase::clearCostmapWindows(double size_x, double size_y){
-    tf::Stamped<tf::Pose> global_pose;
-
     //clear the planner's costmap
-    planner_costmap_ros_->getRobotPose(global_pose);
-
-    std::vector<geometry_msgs::Point> clear_poly;
-    double x = global_pose.getOrigin().x();
-    double y = global_pose.getOrigin().y();
-    geometry_msgs::Point pt;
-
-    pt.x = x - size_x / 2;
-    pt.y = y - size_x / 2;
-    clear_poly.push_back(pt);
-
-    pt.x = x + size_x / 2;
-    pt.y = y - size_x / 2;
-    clear_poly.push_back(pt);
-
-    pt.x = x + size_x / 2;
-    pt.y = y + size_x / 2;
-    clear_poly.push_back(pt);
-
-    pt.x = x - size_x / 2;
-    pt.y = y + size_x / 2;
-    clear_poly.push_back(pt);
-
-    planner_costmap_ros_->getCostmap()->setConvexPolygonCost(clear_poly, costmap_2d::FREE_SPACE);
+    clearCostmapWindow(planner_costmap_ros_, size_x, size_y);
 
     //clear the controller's costmap
-    controller_costmap_ros_->getRobotPose(global_pose);
-
-    clear_poly.clear();
-    x = global_pose.getOrigin().x();
-    y = global_pose.getOrigin().y();
-
-    pt.x = x - size_x / 2;
-    pt.y = y - size_x / 2;
-    clear_poly.push_back(pt);
-
-    pt.x = x + size_x / 2;
-    pt.y = y - size_x / 2;
-    clear_poly.push_back(pt);
+    clearCostmapWindow(controller_costmap_ros_, size_x, size_y);
+  }
 
-    pt.x = x + size_x / 2;
-    pt.y = y + size_x / 2;
-    clear_poly.push_back(pt);
+  void MoveBase::clearCostmapWindow(costmap_2d::Costmap2DROS* costmap_ros, double size_x, double size_y){
+    tf::Stamped<tf::Pose> global_pose;
+    if(!costmap_ros->getRobotPose(global_pose))
+      return;
 
-    pt.x = x - size_x / 2;
-    pt.y = y + size_x / 2;
-    clear_poly.push_back(pt);
+    double x = global_pose.getOrigin().x();
+    double y = global_pose.getOrigin().y();
 
-    controller_costmap_ros_->getCostmap()->setConvexPolygonCost(clear_poly, costmap_2d::FREE_SPACE);
+    costmap_2d::Costmap2D* costmap = costmap_ros->getCostmap();
+    boost::unique_lock<boost::shared_mutex> lock(*(costmap->getLock()));
+    int x0, y0, xn, yn;
+    costmap->worldToMapEnforceBounds(x - size_x / 2, y - size_y / 2, x0, y0);
+    costmap->worldToMapEnforceBounds(x + size_x / 2, y + size_y / 2, xn, yn);
+    costmap->setRegionCost(x0, y0, xn + 1, yn + 1, costmap_2d::FREE_SPACE);
   }
 
   bool MoveBase::clearCostmapsService(std_srvs::Empty::Request &req, std_srvs::Empty::Response &resp){
@@ -388,6 +405,15 @@ namespace move_base {
     return true;
   }
 
+  bool MoveBase::dumpTraceService(std_srvs::Empty::Request &req, std_srvs::Empty::Response &resp){
+    if(!nav_trace::Tracer::exportChromeTrace(trace_file_)){
+      ROS_ERROR("Could not write the trace to %s", trace_file_.c_str());
+      return false;
+    }
+    ROS_INFO("Wrote the trace to %s", trace_file_.c_str());
+    return true;
+  }
+
 
   bool MoveBase::planService(nav_msgs::GetPlan::Request &req, nav_msgs::GetPlan::Response &resp){
     if(as_->isActive()){
@@ -413,6 +439,7 @@ namespace move_base {
 
     //update the copy of the costmap the planner uses
     clearCostmapWindows(2 * clearing_radius_, 2 * clearing_radius_);
+    planner_costmap_ros_->getLayeredCostmap()->completeDeferred();
 
     //first try to make a plan to the exact desired goal
     std::vector<geometry_msgs::PoseStamped> global_plan;
@@ -420,51 +447,65 @@ namespace move_base {
       ROS_DEBUG_NAMED("move_base","Failed to find a plan to exact goal of (%.2f, %.2f), searching for a feasible goal within tolerance", 
           req.goal.pose.position.x, req.goal.pose.position.y);
 
-      //search outwards for a feasible goal within the specified tolerance
+      //search outwards for a feasible goal within the specified tolerance, planning for all
+      //candidates of a layer at once and taking the cheapest plan of the first layer that has one
       geometry_msgs::PoseStamped p;
       p = req.goal;
       bool found_legal = false;
       float resolution = planner_costmap_ros_->getCostmap()->getResolution();
       float search_increment = resolution*3.0;
       if(req.tolerance < search_increment) search_increment = req.tolerance;
+      std::vector<geometry_msgs::PoseStamped> candidates;
+      std::vector<double> costs;
+      std::vector<std::vector<geometry_msgs::PoseStamped> > plans;
       for(float max_offset = search_increment; max_offset <= req.tolerance && !found_legal; max_offset += search_increment) {
-	for(float y_offset = 0; y_offset <= max_offset && !found_legal; y_offset += search_increment) {
-	  for(float x_offset = 0; x_offset <= max_offset && !found_legal; x_offset += search_increment) {
-
-	    //don't search again inside the current outer layer
-	    if(x_offset < max_offset-1e-9 && y_offset < max_offset-1e-9) continue;
-
-	    //search to both sides of the desired goal
-	    for(float y_mult = -1.0; y_mult <= 1.0 + 1e-9 && !found_legal; y_mult += 2.0) {
-
-	      //if one of the offsets is 0, -1*0 is still 0 (so get rid of one of the two)
-	      if(y_offset < 1e-9 && y_mult < -1.0 + 1e-9) continue;
-
-	      for(float x_mult = -1.0; x_mult <= 1.0 + 1e-9 && !found_legal; x_mult += 2.0) {
-		if(x_offset < 1e-9 && x_mult < -1.0 + 1e-9) continue;
-
-		p.pose.position.y = req.goal.pose.position.y + y_offset * y_mult;
-		p.pose.position.x = req.goal.pose.position.x + x_offset * x_mult;
-
-		if(planner_->makePlan(start, p, global_plan)){
-		  if(!global_plan.empty()){
-
-		    //adding the (unreachable) original goal to the end of the global plan, in case the local planner can get you there
-                    //(the reachable goal should have been added by the global planner)
-		    global_plan.push_back(req.goal);
-
-		    found_legal = true;
-		    ROS_DEBUG_NAMED("move_base", "Found a plan to point (%.2f, %.2f)", p.pose.position.x, p.pose.position.y);
-		    break;
-		  }
-		}
-		else{
-		  ROS_DEBUG_NAMED("move_base","Failed to find a plan to point (%.2f, %.2f)", p.pose.position.x, p.pose.position.y);
-		}
-	      }
-	    }
-	  }
-	}
+        candidates.clear();
+        for(float y_offset = 0; y_offset <= max_offset; y_offset += search_increment) {
+          for(float x_offset = 0; x_offset <= max_offset; x_offset += search_increment) {
+
+            //don't search again inside the current outer layer
+            if(x_offset < max_offset-1e-9 && y_offset < max_offset-1e-9) continue;
+
+            //search to both sides of the desired goal
+            for(float y_mult = -1.0; y_mult <= 1.0 + 1e-9; y_mult += 2.0) {
+
+              //if one of the offsets is 0, -1*0 is still 0 (so get rid of one of the two)
+              if(y_offset < 1e-9 && y_mult < -1.0 + 1e-9) continue;
+
+              for(float x_mult = -1.0; x_mult <= 1.0 + 1e-9; x_mult += 2.0) {
+                if(x_offset < 1e-9 && x_mult < -1.0 + 1e-9) continue;
+
+                p.pose.position.y = req.goal.pose.position.y + y_offset * y_mult;
+                p.pose.position.x = req.goal.pose.position.x + x_offset * x_mult;
+                candidates.push_back(p);
+              }
+            }
+          }
+        }
+
+        if(!planner_->makePlans(start, candidates, costs, &plans))
+          continue;
+
+        int best = -1;
+        for(unsigned int i = 0; i < candidates.size(); ++i){
+          if(costs[i] < 0 || plans[i].empty()){
+            ROS_DEBUG_NAMED("move_base","Failed to find a plan to point (%.2f, %.2f)", candidates[i].pose.position.x, candidates[i].pose.position.y);
+            continue;
+          }
+          if(best < 0 || costs[i] < costs[best])
+            best = i;
+        }
+
+        if(best >= 0){
+          global_plan.swap(plans[best]);
+
+          //adding the (unreachable) original goal to the end of the global plan, in case the local planner can get you there
+          //(the reachable goal should have been added by the global planner)
+          global_plan.push_back(req.goal);
+
+          found_legal = true;
+          ROS_DEBUG_NAMED("move_base", "Found a plan to point (%.2f, %.2f)", candidates[best].pose.position.x, candidates[best].pose.position.y);
+        }
       }
     }
 
@@ -494,15 +535,20 @@ namespace move_base {
     planner_thread_->interrupt();
     planner_thread_->join();
 
-    delete planner_plan_;
-    delete latest_plan_;
-    delete controller_plan_;
+    if(nav_trace::Tracer::isEnabled()){
+      nav_trace::Tracer::disable();
+      if(!nav_trace::Tracer::exportChromeTrace(trace_file_))
+        ROS_WARN("Could not write the trace to %s", trace_file_.c_str());
+    }
+
 
     planner_.reset();
     tc_.reset();
   }
 
   bool MoveBase::makePlan(const geometry_msgs::PoseStamped& goal, std::vector<geometry_msgs::PoseStamped>& plan){
+    //the planner reads all of the costmap, so the costs deferred at startup are needed now
+    planner_costmap_ros_->getLayeredCostmap()->completeDeferred();
     boost::unique_lock< boost::shared_mutex > lock(*(planner_costmap_ros_->getCostmap()->getLock()));
 
     //make sure to set the plan to be empty initially
@@ -597,6 +643,7 @@ namespace move_base {
 
   void MoveBase::planThread(){
     ROS_DEBUG_NAMED("move_base_plan_thread","Starting planner thread...");
+    NAV_TRACE_THREAD("planner");
     ros::NodeHandle n;
     ros::Rate r(planner_frequency_);
     boost::unique_lock<boost::mutex> lock(planner_mutex_);
@@ -616,21 +663,26 @@ namespace move_base {
       }
       //time to plan! get a copy of the goal and unlock the mutex
       geometry_msgs::PoseStamped temp_goal = planner_goal_;
+      replan_requested_ = false;
       lock.unlock();
       ROS_DEBUG_NAMED("move_base_plan_thread","Planning...");
 
-      //run planner
+      //run planner, into a new plan if the last one was shared, so shared plans never change
+      if(!planner_plan_.unique())
+        planner_plan_.reset(new std::vector<geometry_msgs::PoseStamped>());
       planner_plan_->clear();
-      bool gotPlan = n.ok() && makePlan(temp_goal, *planner_plan_);
+      bool gotPlan;
+      {
+        NAV_TRACE_SCOPE("MoveBase::planThread");
+        gotPlan = n.ok() && makePlan(temp_goal, *planner_plan_);
+      }
 
       if(gotPlan){
         ROS_DEBUG_NAMED("move_base_plan_thread","Got Plan with %zu points!", planner_plan_->size());
-        //pointer swap the plans under mutex (the controller will pull from latest_plan_)
-        std::vector<geometry_msgs::PoseStamped>* temp_plan = planner_plan_;
-
+        //share the plan under mutex (the controller will pull from latest_plan_)
         lock.lock();
-        planner_plan_ = latest_plan_;
-        latest_plan_ = temp_plan;
+        latest_plan_ = planner_plan_;
+        ++latest_plan_version_;
         last_valid_plan_ = ros::Time::now();
         new_global_plan_ = true;
 
@@ -639,7 +691,7 @@ namespace move_base {
         //make sure we only start the controller if we still haven't reached the goal
         if(runPlanner_)
           state_ = CONTROLLING;
-        if(planner_frequency_ <= 0)
+        if(planner_frequency_ <= 0 && !replan_on_change_)
           runPlanner_ = false;
         lock.unlock();
       }
@@ -657,6 +709,13 @@ namespace move_base {
         }
       }
 
+      //with a plan, wait until it may have become invalid instead of planning on a clock
+      if(gotPlan && replan_on_change_){
+        lock.lock();
+        waitForReplan(lock);
+        continue;
+      }
+
       if(!p_freq_change_ && planner_frequency_ > 0)
         r.sleep();
 
@@ -665,6 +724,60 @@ namespace move_base {
     }
   }
 
+  void MoveBase::waitForReplan(boost::unique_lock<boost::mutex>& lock){
+    ros::NodeHandle n;
+    ros::WallTime planned = ros::WallTime::now();
+    //changes made while planning are already in the plan
+    unsigned int x0, xn, y0, yn;
+    planner_costmap_ros_->getLayeredCostmap()->takeChangedBounds(changed_bounds_user_, &x0, &xn, &y0, &yn);
+
+    while(n.ok() && runPlanner_ && !replan_requested_){
+      planner_cond_.timed_wait(lock, boost::posix_time::milliseconds(int64_t(1000.0 / std::max(replan_check_frequency_, 0.1))));
+      if(!runPlanner_ || replan_requested_)
+        return;
+
+      //planner_frequency is the rate we fall back to
+      if(planner_frequency_ > 0 && (ros::WallTime::now() - planned).toSec() >= 1.0 / planner_frequency_){
+        ROS_DEBUG_NAMED("move_base_plan_thread","Replanning at the fallback rate");
+        return;
+      }
+
+      plan_validator_.setPlan(latest_plan_);
+      lock.unlock();
+      bool blocked = isPlanBlocked();
+      lock.lock();
+      if(blocked){
+        ROS_DEBUG_NAMED("move_base_plan_thread","The costmap changed on the plan, replanning");
+        return;
+      }
+    }
+  }
+
+  bool MoveBase::isPlanBlocked(){
+    unsigned int x0, xn, y0, yn;
+    if(!planner_costmap_ros_->getLayeredCostmap()->takeChangedBounds(changed_bounds_user_, &x0, &xn, &y0, &yn))
+      return false;
+
+    //the part of the plan the robot stands on may well be close to obstacles
+    tf::Stamped<tf::Pose> robot_pose;
+    if(!planner_costmap_ros_->getRobotPose(robot_pose))
+      return false;
+    double robot_x = robot_pose.getOrigin().x(), robot_y = robot_pose.getOrigin().y();
+
+    costmap_2d::Costmap2D* costmap = planner_costmap_ros_->getCostmap();
+    boost::shared_lock<boost::shared_mutex> lock(*(costmap->getLock()));
+    if(!plan_validator_.findBlocked(*costmap, x0, xn, y0, yn, blocked_poses_))
+      return false;
+
+    const std::vector<geometry_msgs::PoseStamped>& plan = *plan_validator_.getPlan();
+    for(unsigned int i = 0; i < blocked_poses_.size(); ++i){
+      const geometry_msgs::Point& position = plan[blocked_poses_[i]].pose.position;
+      if(hypot(position.x - robot_x, position.y - robot_y) > circumscribed_radius_)
+        return true;
+    }
+    return false;
+  }
+
   void MoveBase::executeCb(const move_base_msgs::MoveBaseGoalConstPtr& move_base_goal)
   {
     if(!isQuaternionValid(move_base_goal->target_pose.pose.orientation)){
@@ -678,12 +791,19 @@ namespace move_base {
     boost::unique_lock<boost::mutex> lock(planner_mutex_);
     planner_goal_ = goal;
     runPlanner_ = true;
+    replan_requested_ = true;
     planner_cond_.notify_one();
     lock.unlock();
 
     current_goal_pub_.publish(goal);
     std::vector<geometry_msgs::PoseStamped> global_plan;
 
+    if(!controller_thread_configured_){
+      configureControllerThread();
+      controller_thread_configured_ = true;
+    }
+    last_latency_report_ = ros::WallTime::now();
+
     ros::Rate r(controller_frequency_);
     if(shutdown_costmaps_){
       ROS_DEBUG_NAMED("move_base","Starting up costmaps that were shut down previously");
@@ -726,6 +846,7 @@ namespace move_base {
           lock.lock();
           planner_goal_ = goal;
           runPlanner_ = true;
+          replan_requested_ = true;
           planner_cond_.notify_one();
           lock.unlock();
 
@@ -763,6 +884,7 @@ namespace move_base {
         lock.lock();
         planner_goal_ = goal;
         runPlanner_ = true;
+        replan_requested_ = true;
         planner_cond_.notify_one();
         lock.unlock();
 
@@ -779,6 +901,12 @@ namespace move_base {
       //for timing that gives real time even in simulation
       ros::WallTime start = ros::WallTime::now();
 
+      //give the local planner its share of the cycle, after that it returns the best command it has
+      if(controller_deadline_fraction_ > 0.0 && controller_frequency_ > 0.0)
+        cycle_deadline_ = start + ros::WallDuration(controller_deadline_fraction_ / controller_frequency_);
+      else
+        cycle_deadline_ = ros::WallTime();
+
       //the real work on pursuing a goal is done here
       bool done = executeCycle(goal, global_plan);
 
@@ -790,16 +918,17 @@ namespace move_base {
 
       ros::WallDuration t_diff = ros::WallTime::now() - start;
       ROS_DEBUG_NAMED("move_base","Full control cycle time: %.9f\n", t_diff.toSec());
+      if(state_ == CONTROLLING)
+        recordCycleTime(t_diff.toSec());
 
-      r.sleep();
       //make sure to sleep for the remainder of our cycle time
-      if(r.cycleTime() > ros::Duration(1 / controller_frequency_) && state_ == CONTROLLING)
-        ROS_WARN("Control loop missed its desired rate of %.4fHz... the loop actually took %.4f seconds", controller_frequency_, r.cycleTime().toSec());
+      r.sleep();
     }
 
     //wake up the planner thread so that it can exit cleanly
     lock.lock();
     runPlanner_ = true;
+    replan_requested_ = true;
     planner_cond_.notify_one();
     lock.unlock();
 
@@ -808,12 +937,82 @@ namespace move_base {
     return;
   }
 
+  void MoveBase::configureControllerThread()
+  {
+    NAV_TRACE_THREAD("controller");
+#ifdef __linux__
+    if(controller_thread_priority_ > 0){
+      struct sched_param param;
+      param.sched_priority = controller_thread_priority_;
+      int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+      if(err != 0)
+        ROS_WARN("Could not run the control loop at real-time priority %d: %s", controller_thread_priority_, strerror(err));
+    }
+
+    if(controller_cpu_ >= 0){
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(controller_cpu_, &cpus);
+      int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+      if(err != 0)
+        ROS_WARN("Could not pin the control loop to cpu %d: %s", controller_cpu_, strerror(err));
+    }
+#else
+    if(controller_thread_priority_ > 0 || controller_cpu_ >= 0)
+      ROS_WARN("Setting the priority and cpu of the control loop is only supported on linux");
+#endif
+  }
+
+  void MoveBase::recordCycleTime(double cycle_time)
+  {
+    double period = 1.0 / controller_frequency_;
+    unsigned int bin = std::min((unsigned int)(10.0 * cycle_time / period), (unsigned int)cycle_histogram_.size() - 1);
+    ++cycle_histogram_[bin];
+    if(cycle_time > period)
+      ++missed_cycles_;
+
+    ros::WallTime now = ros::WallTime::now();
+    if((now - last_latency_report_).toSec() < latency_report_period_)
+      return;
+
+    //summarize instead of warning on every late cycle
+    unsigned int total = 0;
+    for(unsigned int i = 0; i < cycle_histogram_.size(); ++i)
+      total += cycle_histogram_[i];
+
+    double p50 = 0.0, p99 = 0.0;
+    unsigned int seen = 0;
+    for(unsigned int i = 0; i < cycle_histogram_.size(); ++i){
+      seen += cycle_histogram_[i];
+      //the upper edge of the bin, in multiples of the period
+      double edge = (i + 1) / 10.0;
+      if(p50 == 0.0 && 2 * seen >= total)
+        p50 = edge;
+      if(p99 == 0.0 && 100 * seen >= 99 * total)
+        p99 = edge;
+    }
+
+    std::string bins;
+    for(unsigned int i = 0; i < cycle_histogram_.size(); ++i)
+      bins += " " + boost::lexical_cast<std::string>(cycle_histogram_[i]);
+    ROS_DEBUG_NAMED("move_base", "Control cycle times in tenths of the period:%s", bins.c_str());
+
+    if(missed_cycles_ > 0)
+      ROS_WARN("Control loop missed its desired rate of %.4fHz in %u of %u cycles, median %.1f and 99th percentile %.1f periods",
+          controller_frequency_, missed_cycles_, total, p50, p99);
+
+    std::fill(cycle_histogram_.begin(), cycle_histogram_.end(), 0);
+    missed_cycles_ = 0;
+    last_latency_report_ = now;
+  }
+
   double MoveBase::distance(const geometry_msgs::PoseStamped& p1, const geometry_msgs::PoseStamped& p2)
   {
     return hypot(p1.pose.position.x - p2.pose.position.x, p1.pose.position.y - p2.pose.position.y);
   }
 
   bool MoveBase::executeCycle(geometry_msgs::PoseStamped& goal, std::vector<geometry_msgs::PoseStamped>& global_plan){
+    NAV_TRACE_SCOPE("MoveBase::executeCycle");
     boost::recursive_mutex::scoped_lock ecl(configuration_mutex_);
     //we need to be able to publish velocity commands
     geometry_msgs::Twist cmd_vel;
@@ -852,18 +1051,15 @@ namespace move_base {
       //make sure to set the new plan flag to false
       new_global_plan_ = false;
 
-      ROS_DEBUG_NAMED("move_base","Got a new plan...swap pointers");
-
-      //do a pointer swap under mutex
-      std::vector<geometry_msgs::PoseStamped>* temp_plan = controller_plan_;
+      ROS_DEBUG_NAMED("move_base","Got a new plan...sharing it with the controller");
 
+      //take a reference to the plan under mutex, it is never copied
       boost::unique_lock<boost::mutex> lock(planner_mutex_);
       controller_plan_ = latest_plan_;
-      latest_plan_ = temp_plan;
+      unsigned int plan_version = latest_plan_version_;
       lock.unlock();
-      ROS_DEBUG_NAMED("move_base","pointers swapped!");
 
-      if(!tc_->setPlan(*controller_plan_)){
+      if(!tc_->setPlan(controller_plan_, plan_version)){
         //ABORT and SHUTDOWN COSTMAPS
         ROS_ERROR("Failed to pass global plan to the controller, aborting.");
         resetState();
@@ -889,6 +1085,7 @@ namespace move_base {
         {
           boost::mutex::scoped_lock lock(planner_mutex_);
           runPlanner_ = true;
+          replan_requested_ = true;
           planner_cond_.notify_one();
         }
         ROS_DEBUG_NAMED("move_base","Waiting for plan, in the planning state.");
@@ -924,12 +1121,13 @@ namespace move_base {
         {
          boost::unique_lock< boost::shared_mutex > lock(*(controller_costmap_ros_->getCostmap()->getLock()));
         
-        if(tc_->computeVelocityCommands(cmd_vel)){
+        if(tc_->computeVelocityCommands(cmd_vel, cycle_deadline_)){
           ROS_DEBUG_NAMED( "move_base", "Got a valid command from the local planner: %.3lf, %.3lf, %.3lf",
                            cmd_vel.linear.x, cmd_vel.linear.y, cmd_vel.angular.z );
           last_valid_control_ = ros::Time::now();
           //make sure that we send the velocity command to the base
           vel_pub_.publish(cmd_vel);
+          NAV_TRACE_INSTANT("cmd_vel");
           if(recovery_trigger_ == CONTROLLING_R)
             recovery_index_ = 0;
         }
@@ -953,6 +1151,7 @@ namespace move_base {
             //enable the planner thread in case it isn't running on a clock
             boost::unique_lock<boost::mutex> lock(planner_mutex_);
             runPlanner_ = true;
+            replan_requested_ = true;
             planner_cond_.notify_one();
             lock.unlock();
           }
@@ -967,6 +1166,7 @@ namespace move_base {
         //we'll invoke whatever recovery behavior we're currently on if they're enabled
         if(recovery_behavior_enabled_ && recovery_index_ < recovery_behaviors_.size()){
           ROS_DEBUG_NAMED("move_base_recovery","Executing behavior %u of %zu", recovery_index_, recovery_behaviors_.size());
+          recovery_behaviors_[recovery_index_]->setLocalPlanner(tc_);
           recovery_behaviors_[recovery_index_]->runBehavior();
 
           //we at least want to give the robot some time to stop oscillating after executing the behavior
@@ -1149,6 +1349,16 @@ namespace move_base {
     //if we shutdown our costmaps when we're deactivated... we'll do that now
     if(shutdown_costmaps_){
       ROS_DEBUG_NAMED("move_base","Stopping costmaps");
+      shutdownCostmaps();
+    }
+  }
+
+  void MoveBase::shutdownCostmaps(){
+    if(idle_costmaps_){
+      planner_costmap_ros_->idle();
+      controller_costmap_ros_->idle();
+    }
+    else{
       planner_costmap_ros_->stop();
       controller_costmap_ros_->stop();
     }
@@ -0,0 +1,640 @@
+/*
+ * Copyright (c) 2013, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Drives move_base through a scenario on a simulated robot and reports how
+// the navigation stack performed, see launch/nav_benchmark.launch.
+//
+// The robot is kinematic: it moves exactly as commanded on cmd_vel and
+// stops when no command came for cmd_vel_timeout.  It publishes odometry, the
+// odom -> base frame transform and planar laser scans in the base frame,
+// cast into the map served on static_map and into the moving obstacles of
+// the scenario.  The scenario file has one entry per line:
+//
+//   start <x> <y> <yaw>
+//   obstacle <radius> <x0> <y0> <x1> <y1> <speed>
+//   goal <x> <y> <yaw> <timeout>
+//
+// in the map frame.  An obstacle shuttles between its two points, the goals
+// are sent one after the other.  Lines starting with '#' are ignored.
+//
+// The report has one "<key> <values>" line per measurement, with the same
+// keys for every run of a scenario, so that scripts/compare_benchmarks.py can
+// put the reports of two builds side by side.  It holds
+//  - the time and final position error of every goal,
+//  - percentiles of the interval between velocity commands,
+//  - percentiles of the time from each scan to the first velocity command
+//    after it, which bounds the reaction of the stack to a scan from below,
+//  - the CPU load of each node in ~nodes while goals were active,
+//  - percentiles of the durations of the spans in the traces of those nodes
+//    which record one (see nav_trace/trace.h), for the same time.
+
+#include <ros/ros.h>
+#include <ros/master.h>
+#include <ros/network.h>
+#include <actionlib/client/simple_action_client.h>
+#include <move_base_msgs/MoveBaseAction.h>
+#include <geometry_msgs/PoseWithCovarianceStamped.h>
+#include <geometry_msgs/Twist.h>
+#include <nav_msgs/GetMap.h>
+#include <nav_msgs/Odometry.h>
+#include <sensor_msgs/LaserScan.h>
+#include <std_srvs/Empty.h>
+#include <tf/transform_broadcaster.h>
+#include <tf/transform_datatypes.h>
+#include <boost/thread/mutex.hpp>
+#include <XmlRpc.h>
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef actionlib::SimpleActionClient<move_base_msgs::MoveBaseAction> MoveBaseClient;
+
+struct Pose2D
+{
+  double x, y, yaw;
+};
+
+// A disc that shuttles between two points
+struct Obstacle
+{
+  double radius;
+  double x0, y0, x1, y1;
+  double speed;
+
+  void position(double t, double& x, double& y) const
+  {
+    double length = hypot(x1 - x0, y1 - y0);
+    double s = 0.0;
+    if(length > 0.0 && speed > 0.0){
+      s = fmod(t * speed, 2 * length);
+      if(s > length)
+        s = 2 * length - s;
+      s /= length;
+    }
+    x = x0 + s * (x1 - x0);
+    y = y0 + s * (y1 - y0);
+  }
+};
+
+struct Goal
+{
+  Pose2D pose;
+  double timeout;
+};
+
+struct Scenario
+{
+  Pose2D start;
+  std::vector<Obstacle> obstacles;
+  std::vector<Goal> goals;
+};
+
+// Seconds on the monotonic clock, which the traces use as well
+static double monotonicTime()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static double percentile(std::vector<double> v, double q)
+{
+  if(v.empty())
+    return 0.0;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, (size_t)(q * v.size()))];
+}
+
+// Count, median, 90th and 99th percentile and maximum, in milliseconds
+static std::string summarize(const std::vector<double>& seconds)
+{
+  char line[128];
+  snprintf(line, sizeof(line), "%u %.3f %.3f %.3f %.3f", (unsigned int)seconds.size(),
+      1e3 * percentile(seconds, 0.5), 1e3 * percentile(seconds, 0.9),
+      1e3 * percentile(seconds, 0.99), 1e3 * percentile(seconds, 1.0));
+  return line;
+}
+
+static bool readScenario(const std::string& filename, Scenario& scenario)
+{
+  FILE* file = fopen(filename.c_str(), "r");
+  if(file == NULL){
+    ROS_ERROR("Could not open the scenario %s", filename.c_str());
+    return false;
+  }
+
+  scenario.start.x = scenario.start.y = scenario.start.yaw = 0.0;
+  char line[256];
+  int number = 0;
+  bool ok = true;
+  while(ok && fgets(line, sizeof(line), file)){
+    number++;
+    char word[16];
+    if(sscanf(line, "%15s", word) != 1 || word[0] == '#')
+      continue;
+
+    if(strcmp(word, "start") == 0){
+      Pose2D& p = scenario.start;
+      ok = sscanf(line, "%*s %lf %lf %lf", &p.x, &p.y, &p.yaw) == 3;
+    }
+    else if(strcmp(word, "obstacle") == 0){
+      Obstacle o;
+      ok = sscanf(line, "%*s %lf %lf %lf %lf %lf %lf", &o.radius, &o.x0, &o.y0, &o.x1, &o.y1, &o.speed) == 6;
+      if(ok)
+        scenario.obstacles.push_back(o);
+    }
+    else if(strcmp(word, "goal") == 0){
+      Goal g;
+      ok = sscanf(line, "%*s %lf %lf %lf %lf", &g.pose.x, &g.pose.y, &g.pose.yaw, &g.timeout) == 4;
+      if(ok)
+        scenario.goals.push_back(g);
+    }
+    else
+      ok = false;
+
+    if(!ok)
+      ROS_ERROR("%s: malformed line %d", filename.c_str(), number);
+  }
+  fclose(file);
+  return ok;
+}
+
+// Ask a node for its process id, like rosnode info does
+static int lookupPid(const std::string& node)
+{
+  XmlRpc::XmlRpcValue args, result, payload;
+  args[0] = ros::this_node::getName();
+  args[1] = node;
+  if(!ros::master::execute("lookupNode", args, result, payload, false))
+    return -1;
+
+  std::string uri = payload, host;
+  uint32_t port;
+  if(!ros::network::splitURI(uri, host, port))
+    return -1;
+
+  XmlRpc::XmlRpcClient client(host.c_str(), port, "/");
+  XmlRpc::XmlRpcValue request, response;
+  request[0] = ros::this_node::getName();
+  if(!client.execute("getPid", request, response) || response.getType() != XmlRpc::XmlRpcValue::TypeArray ||
+      response.size() != 3 || (int)response[0] != 1)
+    return -1;
+  return (int)response[2];
+}
+
+// User and system time of all threads of a process, in seconds
+static bool cpuTime(int pid, double& seconds)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+  FILE* file = fopen(path, "r");
+  if(file == NULL)
+    return false;
+  char stat[1024];
+  size_t length = fread(stat, 1, sizeof(stat) - 1, file);
+  fclose(file);
+  stat[length] = '\0';
+
+  //the command may contain spaces, the fields after it start after the last ')'
+  const char* fields = strrchr(stat, ')');
+  unsigned long utime, stime;
+  if(fields == NULL ||
+      sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2)
+    return false;
+  seconds = (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+  return true;
+}
+
+// Add the durations of the complete events of a Chrome trace written by
+// nav_trace::Tracer which began after since, by name
+static bool readTrace(const std::string& path, double since, std::map<std::string, std::vector<double> >& spans)
+{
+  FILE* file = fopen(path.c_str(), "r");
+  if(file == NULL)
+    return false;
+
+  //the tracer writes one event per line
+  char line[1024];
+  while(fgets(line, sizeof(line), file)){
+    const char* name = strstr(line, "{\"name\":\"");
+    const char* ts = strstr(line, "\"ts\":");
+    const char* dur = strstr(line, "\"dur\":");
+    if(name == NULL || ts == NULL || dur == NULL || strstr(line, "\"ph\":\"X\"") == NULL)
+      continue;
+    name += strlen("{\"name\":\"");
+    const char* end = strchr(name, '"');
+    if(end == NULL || atof(ts + strlen("\"ts\":")) * 1e-6 < since)
+      continue;
+    spans[std::string(name, end)].push_back(atof(dur + strlen("\"dur\":")) * 1e-6);
+  }
+  fclose(file);
+  return true;
+}
+
+class NavBenchmark
+{
+public:
+  NavBenchmark() :
+      private_nh_("~"), client_("move_base", true), start_(0.0), last_step_(0.0), last_scan_(0.0), first_goal_(0.0),
+      active_(false), last_cmd_time_(0.0), last_cmd_stamp_(0.0), active_time_(0.0)
+  {
+    private_nh_.param("base_frame", base_frame_, std::string("base_link"));
+    private_nh_.param("odom_frame", odom_frame_, std::string("odom"));
+    private_nh_.param("sim_frequency", sim_frequency_, 50.0);
+    private_nh_.param("scan_frequency", scan_frequency_, 10.0);
+    private_nh_.param("scan_beams", scan_beams_, 360);
+    private_nh_.param("scan_range", scan_range_, 10.0);
+    private_nh_.param("cmd_vel_timeout", cmd_vel_timeout_, 0.5);
+    private_nh_.param("settle_time", settle_time_, 3.0);
+    private_nh_.param("report_file", report_file_, std::string(""));
+
+    std::string nodes;
+    private_nh_.param("nodes", nodes, std::string("move_base amcl"));
+    std::istringstream names(nodes);
+    std::string node;
+    while(names >> node)
+      nodes_.push_back(ros::names::resolve(node));
+
+    odom_pub_ = nh_.advertise<nav_msgs::Odometry>("odom", 10);
+    scan_pub_ = nh_.advertise<sensor_msgs::LaserScan>("scan", 10);
+    initial_pose_pub_ = nh_.advertise<geometry_msgs::PoseWithCovarianceStamped>("initialpose", 1, true);
+    cmd_vel_sub_ = nh_.subscribe("cmd_vel", 10, &NavBenchmark::cmdVelCallback, this);
+
+    cmd_.linear.x = cmd_.linear.y = cmd_.angular.z = 0.0;
+  }
+
+  bool run(const Scenario& scenario)
+  {
+    nav_msgs::GetMap map;
+    if(!ros::service::waitForService("static_map", ros::Duration(30.0)) ||
+        !ros::service::call("static_map", map)){
+      ROS_ERROR("Could not get the map from static_map");
+      return false;
+    }
+    map_ = map.response.map;
+    scenario_ = scenario;
+    pose_ = scenario.start;
+    start_ = monotonicTime();
+    last_step_ = last_scan_ = start_;
+
+    //the odometry starts at the start pose, so that is where map -> odom puts it
+    geometry_msgs::PoseWithCovarianceStamped initial_pose;
+    initial_pose.header.frame_id = map_.header.frame_id;
+    initial_pose.header.stamp = ros::Time::now();
+    initial_pose.pose.pose.position.x = pose_.x;
+    initial_pose.pose.pose.position.y = pose_.y;
+    initial_pose.pose.pose.orientation = tf::createQuaternionMsgFromYaw(pose_.yaw);
+    initial_pose.pose.covariance[0] = initial_pose.pose.covariance[7] = 0.01;
+    initial_pose.pose.covariance[35] = 0.01;
+    initial_pose_pub_.publish(initial_pose);
+
+    //keep the robot alive while move_base comes up and the costmaps fill
+    while(ros::ok() && !client_.isServerConnected())
+      step();
+    double settled = monotonicTime() + settle_time_;
+    while(ros::ok() && monotonicTime() < settled)
+      step();
+
+    for(unsigned int i = 0; i < nodes_.size(); ++i){
+      pids_.push_back(lookupPid(nodes_[i]));
+      if(pids_.back() < 0)
+        ROS_WARN("Could not find the process of %s, its CPU load is not reported", nodes_[i].c_str());
+      cpu_.push_back(0.0);
+    }
+
+    for(unsigned int i = 0; i < scenario_.goals.size() && ros::ok(); ++i)
+      runGoal(scenario_.goals[i]);
+
+    report();
+    return true;
+  }
+
+private:
+  void runGoal(const Goal& goal)
+  {
+    move_base_msgs::MoveBaseGoal msg;
+    msg.target_pose.header.frame_id = map_.header.frame_id;
+    msg.target_pose.header.stamp = ros::Time::now();
+    msg.target_pose.pose.position.x = goal.pose.x;
+    msg.target_pose.pose.position.y = goal.pose.y;
+    msg.target_pose.pose.orientation = tf::createQuaternionMsgFromYaw(goal.pose.yaw);
+
+    std::vector<double> cpu_before(pids_.size(), 0.0);
+    for(unsigned int i = 0; i < pids_.size(); ++i)
+      cpuTime(pids_[i], cpu_before[i]);
+
+    double begin = monotonicTime();
+    if(goal_times_.empty())
+      first_goal_ = begin;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      active_ = true;
+      last_cmd_stamp_ = 0.0;
+      pending_scans_.clear();
+    }
+    client_.sendGoal(msg);
+
+    bool timed_out = false;
+    while(ros::ok() && !client_.getState().isDone()){
+      if(monotonicTime() - begin > goal.timeout){
+        client_.cancelGoal();
+        timed_out = true;
+        break;
+      }
+      step();
+    }
+
+    double end = monotonicTime();
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      active_ = false;
+    }
+    active_time_ += end - begin;
+    for(unsigned int i = 0; i < pids_.size(); ++i){
+      double after;
+      if(cpuTime(pids_[i], after))
+        cpu_[i] += after - cpu_before[i];
+    }
+
+    //wait for the cancel to go through, so it does not hit the next goal
+    if(timed_out){
+      double waited = monotonicTime() + 5.0;
+      while(ros::ok() && !client_.getState().isDone() && monotonicTime() < waited)
+        step();
+    }
+
+    goal_times_.push_back(end - begin);
+    goal_errors_.push_back(hypot(pose_.x - goal.pose.x, pose_.y - goal.pose.y));
+    goal_states_.push_back(timed_out ? std::string("TIMEOUT") : client_.getState().toString());
+  }
+
+  // Advance the simulation by one period
+  void step()
+  {
+    ros::WallDuration(1.0 / sim_frequency_).sleep();
+    double now = monotonicTime();
+    double dt = now - last_step_;
+    last_step_ = now;
+
+    geometry_msgs::Twist cmd;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      if(now - last_cmd_time_ < cmd_vel_timeout_)
+        cmd = cmd_;
+    }
+    double c = cos(pose_.yaw), s = sin(pose_.yaw);
+    pose_.x += (cmd.linear.x * c - cmd.linear.y * s) * dt;
+    pose_.y += (cmd.linear.x * s + cmd.linear.y * c) * dt;
+    pose_.yaw = atan2(sin(pose_.yaw + cmd.angular.z * dt), cos(pose_.yaw + cmd.angular.z * dt));
+
+    //odometry is the motion since the start, without drift
+    tf::Transform start(tf::createQuaternionFromYaw(scenario_.start.yaw),
+        tf::Vector3(scenario_.start.x, scenario_.start.y, 0.0));
+    tf::Transform pose(tf::createQuaternionFromYaw(pose_.yaw), tf::Vector3(pose_.x, pose_.y, 0.0));
+    tf::Transform odom = start.inverse() * pose;
+
+    ros::Time stamp = ros::Time::now();
+    broadcaster_.sendTransform(tf::StampedTransform(odom, stamp, odom_frame_, base_frame_));
+
+    nav_msgs::Odometry odom_msg;
+    odom_msg.header.stamp = stamp;
+    odom_msg.header.frame_id = odom_frame_;
+    odom_msg.child_frame_id = base_frame_;
+    tf::poseTFToMsg(odom, odom_msg.pose.pose);
+    odom_msg.twist.twist = cmd;
+    odom_pub_.publish(odom_msg);
+
+    if(now - last_scan_ >= 1.0 / scan_frequency_){
+      last_scan_ = now;
+      publishScan(stamp, now - start_);
+      boost::mutex::scoped_lock lock(mutex_);
+      if(active_)
+        pending_scans_.push_back(monotonicTime());
+    }
+  }
+
+  bool occupied(double x, double y) const
+  {
+    const nav_msgs::MapMetaData& info = map_.info;
+    int i = (int)floor((x - info.origin.position.x) / info.resolution);
+    int j = (int)floor((y - info.origin.position.y) / info.resolution);
+    if(i < 0 || j < 0 || i >= (int)info.width || j >= (int)info.height)
+      return false;
+    return map_.data[j * info.width + i] >= 65;
+  }
+
+  void publishScan(const ros::Time& stamp, double t)
+  {
+    std::vector<double> ox(scenario_.obstacles.size()), oy(scenario_.obstacles.size());
+    for(unsigned int k = 0; k < scenario_.obstacles.size(); ++k)
+      scenario_.obstacles[k].position(t, ox[k], oy[k]);
+
+    sensor_msgs::LaserScan& scan = scan_;
+    scan.header.stamp = stamp;
+    scan.header.frame_id = base_frame_;
+    scan.angle_min = -M_PI;
+    scan.angle_increment = 2 * M_PI / scan_beams_;
+    scan.angle_max = scan.angle_min + (scan_beams_ - 1) * scan.angle_increment;
+    scan.range_min = 0.05;
+    scan.range_max = scan_range_;
+    scan.scan_time = 1.0 / scan_frequency_;
+    scan.ranges.resize(scan_beams_);
+
+    double step = map_.info.resolution / 2;
+    for(int b = 0; b < scan_beams_; ++b){
+      double angle = pose_.yaw + scan.angle_min + b * scan.angle_increment;
+      double dx = cos(angle), dy = sin(angle);
+
+      //the map is walked in half cells, the obstacles are hit exactly
+      double range = scan_range_;
+      for(double r = step; r < range; r += step){
+        if(occupied(pose_.x + r * dx, pose_.y + r * dy)){
+          range = r;
+          break;
+        }
+      }
+      for(unsigned int k = 0; k < scenario_.obstacles.size(); ++k){
+        double px = ox[k] - pose_.x, py = oy[k] - pose_.y;
+        double along = px * dx + py * dy;
+        double off = px * px + py * py - along * along;
+        double radius = scenario_.obstacles[k].radius;
+        if(along > 0 && off < radius * radius){
+          double hit = along - sqrt(radius * radius - off);
+          if(hit > 0 && hit < range)
+            range = hit;
+        }
+      }
+      scan.ranges[b] = range;
+    }
+    scan_pub_.publish(scan);
+  }
+
+  void cmdVelCallback(const geometry_msgs::Twist::ConstPtr& cmd)
+  {
+    double now = monotonicTime();
+    boost::mutex::scoped_lock lock(mutex_);
+    cmd_ = *cmd;
+    last_cmd_time_ = now;
+    if(!active_)
+      return;
+
+    if(last_cmd_stamp_ > 0.0)
+      cmd_intervals_.push_back(now - last_cmd_stamp_);
+    last_cmd_stamp_ = now;
+    for(unsigned int i = 0; i < pending_scans_.size(); ++i)
+      scan_latencies_.push_back(now - pending_scans_[i]);
+    pending_scans_.clear();
+  }
+
+  void report()
+  {
+    std::vector<std::string> lines;
+    char line[256];
+
+    unsigned int succeeded = 0;
+    for(unsigned int i = 0; i < goal_times_.size(); ++i){
+      snprintf(line, sizeof(line), "goal_%u %s %.3f %.3f", i, goal_states_[i].c_str(), goal_times_[i], goal_errors_[i]);
+      lines.push_back(line);
+      if(goal_states_[i] == "SUCCEEDED")
+        succeeded++;
+    }
+    snprintf(line, sizeof(line), "goals_succeeded %u %u", succeeded, (unsigned int)goal_times_.size());
+    lines.push_back(line);
+    snprintf(line, sizeof(line), "goal_time_total %.3f", active_time_);
+    lines.push_back(line);
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      lines.push_back("cmd_vel_interval_ms " + summarize(cmd_intervals_));
+      lines.push_back("scan_to_cmd_vel_ms " + summarize(scan_latencies_));
+    }
+
+    for(unsigned int i = 0; i < nodes_.size(); ++i){
+      if(pids_[i] < 0 || active_time_ <= 0.0)
+        continue;
+      snprintf(line, sizeof(line), "cpu_percent %s %.1f", nodes_[i].c_str(), 100.0 * cpu_[i] / active_time_);
+      lines.push_back(line);
+    }
+
+    //the spans of the nodes which trace, from the first goal on
+    for(unsigned int i = 0; i < nodes_.size(); ++i){
+      std::string service = nodes_[i] + "/dump_trace", trace_file;
+      std_srvs::Empty empty;
+      if(!ros::service::exists(service, false) || !ros::param::get(nodes_[i] + "/trace_file", trace_file) ||
+          !ros::service::call(service, empty))
+        continue;
+
+      std::map<std::string, std::vector<double> > spans;
+      if(!readTrace(trace_file, first_goal_, spans)){
+        ROS_WARN("Could not read the trace of %s from %s", nodes_[i].c_str(), trace_file.c_str());
+        continue;
+      }
+      for(std::map<std::string, std::vector<double> >::const_iterator it = spans.begin(); it != spans.end(); ++it)
+        lines.push_back("span_ms " + nodes_[i] + " " + it->first + " " + summarize(it->second));
+    }
+
+    FILE* file = NULL;
+    if(!report_file_.empty()){
+      file = fopen(report_file_.c_str(), "w");
+      if(file == NULL)
+        ROS_ERROR("Could not write the report to %s", report_file_.c_str());
+    }
+    if(file != NULL)
+      fprintf(file, "# key values, times in seconds unless the key says otherwise, percentiles as count p50 p90 p99 max\n");
+    for(unsigned int i = 0; i < lines.size(); ++i){
+      printf("%s\n", lines[i].c_str());
+      if(file != NULL)
+        fprintf(file, "%s\n", lines[i].c_str());
+    }
+    if(file != NULL)
+      fclose(file);
+  }
+
+  ros::NodeHandle nh_, private_nh_;
+  ros::Publisher odom_pub_, scan_pub_, initial_pose_pub_;
+  ros::Subscriber cmd_vel_sub_;
+  tf::TransformBroadcaster broadcaster_;
+  MoveBaseClient client_;
+
+  std::string base_frame_, odom_frame_, report_file_;
+  double sim_frequency_, scan_frequency_, scan_range_, cmd_vel_timeout_, settle_time_;
+  int scan_beams_;
+  std::vector<std::string> nodes_;
+  std::vector<int> pids_;
+
+  nav_msgs::OccupancyGrid map_;
+  Scenario scenario_;
+  Pose2D pose_;
+  double start_, last_step_, last_scan_, first_goal_;
+  sensor_msgs::LaserScan scan_;  ///< kept to reuse its memory
+
+  //shared with the cmd_vel callback
+  boost::mutex mutex_;
+  geometry_msgs::Twist cmd_;
+  bool active_;
+  double last_cmd_time_, last_cmd_stamp_;
+  std::vector<double> pending_scans_;
+  std::vector<double> cmd_intervals_, scan_latencies_;
+
+  std::vector<double> cpu_;
+  double active_time_;
+  std::vector<double> goal_times_, goal_errors_;
+  std::vector<std::string> goal_states_;
+};
+
+int main(int argc, char** argv){
+  ros::init(argc, argv, "nav_benchmark");
+  ros::NodeHandle private_nh("~");
+
+  std::string scenario_file;
+  if(!private_nh.getParam("scenario", scenario_file)){
+    ROS_ERROR("No scenario given, set ~scenario");
+    return 1;
+  }
+  Scenario scenario;
+  if(!readScenario(scenario_file, scenario))
+    return 1;
+
+  //the simulation runs in the main thread, the callbacks in the spinner
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  NavBenchmark benchmark;
+  bool ok = benchmark.run(scenario);
+  ros::shutdown();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*
+*********************************************************************/
+#include <move_base/plan_validator.h>
+#include <costmap_2d/cost_values.h>
+#include <algorithm>
+
+namespace move_base {
+
+  PlanValidator::PlanValidator() : cells_valid_(false), size_x_(0), size_y_(0),
+    origin_x_(0.0), origin_y_(0.0), resolution_(0.0) {}
+
+  void PlanValidator::setPlan(const nav_core::PlanConstPtr& plan){
+    if(plan == plan_)
+      return;
+    plan_ = plan;
+    cells_valid_ = false;
+  }
+
+  void PlanValidator::updateCells(const costmap_2d::Costmap2D& costmap){
+    if(cells_valid_ && size_x_ == costmap.getSizeInCellsX() && size_y_ == costmap.getSizeInCellsY() &&
+        origin_x_ == costmap.getOriginX() && origin_y_ == costmap.getOriginY() &&
+        resolution_ == costmap.getResolution())
+      return;
+
+    size_x_ = costmap.getSizeInCellsX();
+    size_y_ = costmap.getSizeInCellsY();
+    origin_x_ = costmap.getOriginX();
+    origin_y_ = costmap.getOriginY();
+    resolution_ = costmap.getResolution();
+    cells_valid_ = true;
+
+    cells_.clear();
+    if(!plan_)
+      return;
+
+    const std::vector<geometry_msgs::PoseStamped>& plan = *plan_;
+    cells_.reserve(plan.size());
+    for(unsigned int i = 0; i < plan.size(); ++i){
+      unsigned int mx, my;
+      if(!costmap.worldToMap(plan[i].pose.position.x, plan[i].pose.position.y, mx, my))
+        continue;
+      PlanCell cell;
+      cell.index = costmap.getIndex(mx, my);
+      cell.pose = i;
+      cells_.push_back(cell);
+    }
+    //stable, so poses on the same cell stay in plan order
+    std::stable_sort(cells_.begin(), cells_.end());
+  }
+
+  bool PlanValidator::findBlocked(const costmap_2d::Costmap2D& costmap, unsigned int x0, unsigned int xn,
+      unsigned int y0, unsigned int yn, std::vector<unsigned int>& blocked){
+    blocked.clear();
+    updateCells(costmap);
+
+    xn = std::min(xn, size_x_);
+    yn = std::min(yn, size_y_);
+    if(cells_.empty() || x0 >= xn || y0 >= yn)
+      return false;
+
+    const unsigned char* charmap = costmap.getCharMap();
+    PlanCell key;
+    key.pose = 0;
+    for(unsigned int y = y0; y < yn; ++y){
+      key.index = y * size_x_ + x0;
+      unsigned int row_end = y * size_x_ + xn;
+      for(std::vector<PlanCell>::const_iterator it = std::lower_bound(cells_.begin(), cells_.end(), key);
+          it != cells_.end() && it->index < row_end; ++it){
+        unsigned char cost = charmap[it->index];
+        if(cost >= costmap_2d::INSCRIBED_INFLATED_OBSTACLE && cost != costmap_2d::NO_INFORMATION)
+          blocked.push_back(it->pose);
+      }
+    }
+    return !blocked.empty();
+  }
+};
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <vector>
+#include <move_base/plan_validator.h>
+#include <costmap_2d/cost_values.h>
+
+using move_base::PlanValidator;
+
+// along the row y = 1.05 from x = 0.05 to 1.95, then up the column x = 1.55 to y = 1.95
+static nav_core::PlanConstPtr lPlan(){
+  std::vector<geometry_msgs::PoseStamped>* plan = new std::vector<geometry_msgs::PoseStamped>();
+  geometry_msgs::PoseStamped pose;
+  pose.header.frame_id = "map";
+  pose.pose.orientation.w = 1.0;
+  for(unsigned int i = 0; i < 20; ++i){
+    pose.pose.position.x = 0.05 + 0.1 * i;
+    pose.pose.position.y = 1.05;
+    plan->push_back(pose);
+  }
+  for(unsigned int i = 1; i < 10; ++i){
+    pose.pose.position.x = 1.55;
+    pose.pose.position.y = 1.05 + 0.1 * i;
+    plan->push_back(pose);
+  }
+  return nav_core::PlanConstPtr(plan);
+}
+
+TEST(PlanValidator, reportsTheBlockedPoses){
+  costmap_2d::Costmap2D costmap(20, 20, 0.1, 0.0, 0.0);
+  PlanValidator validator;
+  validator.setPlan(lPlan());
+  std::vector<unsigned int> blocked;
+
+  EXPECT_FALSE(validator.findBlocked(costmap, 0, 20, 0, 20, blocked));
+  EXPECT_TRUE(blocked.empty());
+
+  // a segment of the row, and a cell of the column
+  costmap.setCost(12, 10, costmap_2d::LETHAL_OBSTACLE);
+  costmap.setCost(13, 10, costmap_2d::INSCRIBED_INFLATED_OBSTACLE);
+  costmap.setCost(15, 15, costmap_2d::LETHAL_OBSTACLE);
+  // neither unknown cells nor cells off the plan block it
+  costmap.setCost(3, 10, costmap_2d::NO_INFORMATION);
+  costmap.setCost(12, 11, costmap_2d::LETHAL_OBSTACLE);
+
+  ASSERT_TRUE(validator.findBlocked(costmap, 0, 20, 0, 20, blocked));
+  ASSERT_EQ(3u, blocked.size());
+  EXPECT_EQ(12u, blocked[0]);
+  EXPECT_EQ(13u, blocked[1]);
+  EXPECT_EQ(24u, blocked[2]);
+
+  // only the window is checked
+  ASSERT_TRUE(validator.findBlocked(costmap, 13, 16, 14, 18, blocked));
+  ASSERT_EQ(1u, blocked.size());
+  EXPECT_EQ(24u, blocked[0]);
+  EXPECT_FALSE(validator.findBlocked(costmap, 0, 12, 0, 20, blocked));
+  EXPECT_TRUE(blocked.empty());
+  // a window reaching past the costmap is clipped
+  ASSERT_TRUE(validator.findBlocked(costmap, 13, 100, 0, 100, blocked));
+  ASSERT_EQ(2u, blocked.size());
+  EXPECT_EQ(13u, blocked[0]);
+  EXPECT_EQ(24u, blocked[1]);
+}
+
+TEST(PlanValidator, followsTheCostmapAndThePlan){
+  costmap_2d::Costmap2D costmap(20, 20, 0.1, 0.0, 0.0);
+  PlanValidator validator;
+  validator.setPlan(lPlan());
+  std::vector<unsigned int> blocked;
+  EXPECT_FALSE(validator.findBlocked(costmap, 0, 20, 0, 20, blocked));
+
+  // the pose at x = 0.55 is in column 4 once the costmap moved by 0.1
+  costmap.updateOrigin(0.1, 0.0);
+  costmap.setCost(4, 10, costmap_2d::LETHAL_OBSTACLE);
+  ASSERT_TRUE(validator.findBlocked(costmap, 0, 20, 0, 20, blocked));
+  ASSERT_EQ(1u, blocked.size());
+  EXPECT_EQ(5u, blocked[0]);
+
+  // a new plan is picked up
+  std::vector<geometry_msgs::PoseStamped>* plan = new std::vector<geometry_msgs::PoseStamped>(1);
+  (*plan)[0].pose.position.x = 1.85;
+  (*plan)[0].pose.position.y = 0.25;
+  validator.setPlan(nav_core::PlanConstPtr(plan));
+  EXPECT_FALSE(validator.findBlocked(costmap, 0, 20, 0, 20, blocked));
+  costmap.setCost(17, 2, costmap_2d::LETHAL_OBSTACLE);
+  ASSERT_TRUE(validator.findBlocked(costmap, 0, 20, 0, 20, blocked));
+  EXPECT_EQ(0u, blocked[0]);
+}
+
+int main(int argc, char** argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
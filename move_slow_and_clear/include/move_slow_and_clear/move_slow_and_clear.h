@@ -59,6 +59,9 @@ namespace move_slow_and_clear
       /// Run the behavior
       void runBehavior();
 
+      /// Keep the local planner, whose speed is capped directly if it supports it
+      void setLocalPlanner(const boost::shared_ptr<nav_core::BaseLocalPlanner>& local_planner);
+
     private:
       void setRobotSpeed(double trans_speed, double rot_speed);
       void distanceCheck(const ros::TimerEvent& e);
@@ -77,6 +80,8 @@ namespace move_slow_and_clear
       boost::thread* remove_limit_thread_;
       boost::mutex mutex_;
       bool limit_set_;
+      boost::shared_ptr<nav_core::BaseLocalPlanner> local_planner_;
+      boost::shared_ptr<nav_core::BaseLocalPlanner> limited_planner_; ///< The planner whose speed is capped directly, if any
       ros::ServiceClient planner_dynamic_reconfigure_service_;
   };
 };
@@ -71,6 +71,11 @@ namespace move_slow_and_clear
     initialized_ = true;
   }
 
+  void MoveSlowAndClear::setLocalPlanner(const boost::shared_ptr<nav_core::BaseLocalPlanner>& local_planner)
+  {
+    local_planner_ = local_planner;
+  }
+
   void MoveSlowAndClear::runBehavior()
   {
     if(!initialized_)
@@ -129,6 +134,27 @@ namespace move_slow_and_clear
     //lock... just in case we're already speed limited
     boost::mutex::scoped_lock l(mutex_);
 
+    //we also want to save our current position so that we can remove the speed limit we impose later on
+    speed_limit_pose_ = global_pose;
+
+    //a planner that takes a speed cap gets it directly, in its next control cycle
+    if(limited_planner_ && limited_planner_ != local_planner_)
+    {
+      limited_planner_->setSpeedLimit(-1.0, -1.0);
+      limited_planner_.reset();
+    }
+    if(local_planner_ && local_planner_->setSpeedLimit(limited_trans_speed_, limited_rot_speed_))
+    {
+      //a limit set through dynamic_reconfigure before is lifted the same way
+      if(limit_set_ && !limited_planner_)
+        setRobotSpeed(old_trans_speed_, old_rot_speed_);
+      ROS_INFO("Recovery limiting speed to %.2f m/s and %.2f rad/s", limited_trans_speed_, limited_rot_speed_);
+      limited_planner_ = local_planner_;
+      limit_set_ = true;
+      distance_check_timer_ = private_nh_.createTimer(ros::Duration(0.1), &MoveSlowAndClear::distanceCheck, this);
+      return;
+    }
+
     //get the old maximum speed for the robot... we'll want to set it back
     if(!limit_set_)
     {
@@ -143,9 +169,6 @@ namespace move_slow_and_clear
       }
     }
 
-    //we also want to save our current position so that we can remove the speed limit we impose later on
-    speed_limit_pose_ = global_pose;
-
     //limit the speed of the robot until it moves a certain distance
     setRobotSpeed(limited_trans_speed_, limited_rot_speed_);
     limit_set_ = true;
@@ -170,6 +193,19 @@ namespace move_slow_and_clear
     if(limited_distance_ * limited_distance_ <= getSqDistance())
     {
       ROS_INFO("Moved far enough, removing speed limit.");
+      distance_check_timer_.stop();
+
+      {
+        boost::mutex::scoped_lock l(mutex_);
+        if(limited_planner_)
+        {
+          limited_planner_->setSpeedLimit(-1.0, -1.0);
+          limited_planner_.reset();
+          limit_set_ = false;
+          return;
+        }
+      }
+
       //have to do this because a system call within a timer cb does not seem to play nice
       if(remove_limit_thread_)
       {
@@ -177,8 +213,6 @@ namespace move_slow_and_clear
         delete remove_limit_thread_;
       }
       remove_limit_thread_ = new boost::thread(boost::bind(&MoveSlowAndClear::removeSpeedLimit, this));
-
-      distance_check_timer_.stop();
     }
   }
 
@@ -37,6 +37,7 @@
 #ifndef NAV_CORE_BASE_GLOBAL_PLANNER_
 #define NAV_CORE_BASE_GLOBAL_PLANNER_
 
+#include <cmath>
 #include <geometry_msgs/PoseStamped.h>
 #include <costmap_2d/costmap_2d_ros.h>
 
@@ -57,6 +58,40 @@ namespace nav_core {
       virtual bool makePlan(const geometry_msgs::PoseStamped& start, 
           const geometry_msgs::PoseStamped& goal, std::vector<geometry_msgs::PoseStamped>& plan) = 0;
 
+      /**
+       * @brief Given many candidate goal poses in the world, compute the plans to all of them
+       *
+       * Planners that can serve all goals from one search override this. The default calls
+       * makePlan() for every goal and uses the length of the plan as its cost.
+       * @param start The start pose
+       * @param goals The goal poses
+       * @param costs Filled with the cost of the plan to every goal, or -1 if there is none, comparable among the goals of one call
+       * @param plans If not NULL, filled with the plan to every goal, empty if there is none
+       * @return True if the goals could be planned for, false otherwise
+       */
+      virtual bool makePlans(const geometry_msgs::PoseStamped& start, const std::vector<geometry_msgs::PoseStamped>& goals,
+          std::vector<double>& costs, std::vector<std::vector<geometry_msgs::PoseStamped> >* plans){
+        costs.assign(goals.size(), -1.0);
+        if(plans)
+          plans->assign(goals.size(), std::vector<geometry_msgs::PoseStamped>());
+
+        std::vector<geometry_msgs::PoseStamped> plan;
+        for(unsigned int i = 0; i < goals.size(); ++i){
+          plan.clear();
+          if(!makePlan(start, goals[i], plan) || plan.empty())
+            continue;
+
+          double length = 0.0;
+          for(unsigned int j = 1; j < plan.size(); ++j)
+            length += hypot(plan[j].pose.position.x - plan[j - 1].pose.position.x,
+                plan[j].pose.position.y - plan[j - 1].pose.position.y);
+          costs[i] = length;
+          if(plans)
+            (*plans)[i].swap(plan);
+        }
+        return true;
+      }
+
       /**
        * @brief  Initialization function for the BaseGlobalPlanner
        * @param  name The name of this planner
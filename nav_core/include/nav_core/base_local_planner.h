@@ -41,8 +41,14 @@
 #include <geometry_msgs/Twist.h>
 #include <costmap_2d/costmap_2d_ros.h>
 #include <tf/transform_listener.h>
+#include <boost/shared_ptr.hpp>
 
 namespace nav_core {
+  /**
+   * @brief  A global plan that is shared between threads instead of copied, and is never changed once shared
+   */
+  typedef boost::shared_ptr<const std::vector<geometry_msgs::PoseStamped> > PlanConstPtr;
+
   /**
    * @class BaseLocalPlanner
    * @brief Provides an interface for local planners used in navigation. All local planners written as plugins for the navigation stack must adhere to this interface.
@@ -56,6 +62,21 @@ namespace nav_core {
        */
       virtual bool computeVelocityCommands(geometry_msgs::Twist& cmd_vel) = 0;
 
+      /**
+       * @brief  Compute velocity commands within a time budget
+       *
+       * Planners that support it search their samples in order of promise and return the best
+       * command found so far once the deadline has passed. The default sets the deadline with
+       * setControlDeadline() and calls computeVelocityCommands(cmd_vel).
+       * @param cmd_vel Will be filled with the velocity command to be passed to the robot base
+       * @param deadline The time by which the command is needed, a zero time means no deadline
+       * @return True if a valid velocity command was found, false otherwise
+       */
+      virtual bool computeVelocityCommands(geometry_msgs::Twist& cmd_vel, const ros::WallTime& deadline){
+        setControlDeadline(deadline);
+        return computeVelocityCommands(cmd_vel);
+      }
+
       /**
        * @brief  Check if the goal pose has been achieved by the local planner
        * @return True if achieved, false otherwise
@@ -69,6 +90,34 @@ namespace nav_core {
        */
       virtual bool setPlan(const std::vector<geometry_msgs::PoseStamped>& plan) = 0;
 
+      /**
+       * @brief  Set the plan that the local planner is following without copying it
+       *
+       * Planners may keep a reference to the plan. The default copies it with setPlan(*plan).
+       * @param plan The plan to pass to the local planner
+       * @param version Increases with every new plan, planners may keep their progress along a plan whose version they already have
+       * @return True if the plan was updated successfully, false otherwise
+       */
+      virtual bool setPlan(const PlanConstPtr& plan, unsigned int version){
+        return setPlan(*plan);
+      }
+
+      /**
+       * @brief  Set the time by which the next call to computeVelocityCommands should return
+       * @param deadline Planners that can cut their search short return the best command found so far once it has passed, a zero time means no deadline
+       */
+      virtual void setControlDeadline(const ros::WallTime& deadline){}
+
+      /**
+       * @brief  Cap the speed of the planner below its configured limits from the next control cycle on, without reconfiguring it
+       * @param max_trans_vel The translational speed cap, negative lifts it
+       * @param max_rot_vel The rotational speed cap, negative lifts it
+       * @return False if the planner does not support speed caps
+       */
+      virtual bool setSpeedLimit(double max_trans_vel, double max_rot_vel){
+        return false;
+      }
+
       /**
        * @brief  Constructs the local planner
        * @param name The name to give this instance of the local planner
@@ -38,6 +38,8 @@
 #define NAV_CORE_RECOVERY_BEHAVIOR_H_
 #include <costmap_2d/costmap_2d_ros.h>
 #include <tf/transform_listener.h>
+#include <nav_core/base_local_planner.h>
+#include <boost/shared_ptr.hpp>
 
 namespace nav_core {
   /**
@@ -59,6 +61,12 @@ namespace nav_core {
        */
       virtual void runBehavior() = 0;
 
+      /**
+       * @brief  Hands the behavior the local planner in use, before each run
+       * @param local_planner The local planner, behaviors that act on it directly may keep it
+       */
+      virtual void setLocalPlanner(const boost::shared_ptr<BaseLocalPlanner>& local_planner){}
+
       /**
        * @brief  Virtual destructor for the interface
        */
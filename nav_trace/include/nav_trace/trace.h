@@ -0,0 +1,165 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef NAV_TRACE_TRACE_H_
+#define NAV_TRACE_TRACE_H_
+
+#include <stdint.h>
+#include <string>
+#include <boost/atomic.hpp>
+
+/**
+ * Tracing of the navigation stack.
+ *
+ * NAV_TRACE_SCOPE("name") records how long the rest of the enclosing scope
+ * takes, NAV_TRACE_INSTANT("name") records a point in time and
+ * NAV_TRACE_THREAD("name") names the calling thread in the exported trace.
+ * Names must be string literals, only the pointer is stored. While tracing is
+ * disabled a scope costs one test of a flag, building with
+ * -DNAV_DISABLE_TRACING removes the macros altogether.
+ */
+#ifndef NAV_DISABLE_TRACING
+#define NAV_TRACE_CONCAT_(a, b) a ## b
+#define NAV_TRACE_CONCAT(a, b) NAV_TRACE_CONCAT_(a, b)
+#define NAV_TRACE_SCOPE(name) nav_trace::TraceScope NAV_TRACE_CONCAT(nav_trace_scope_, __LINE__)(name)
+#define NAV_TRACE_INSTANT(name) nav_trace::Tracer::instant(name)
+#define NAV_TRACE_THREAD(name) nav_trace::Tracer::setThreadName(name)
+#else
+#define NAV_TRACE_SCOPE(name) do {} while (0)
+#define NAV_TRACE_INSTANT(name) do {} while (0)
+#define NAV_TRACE_THREAD(name) do {} while (0)
+#endif
+
+namespace nav_trace
+{
+
+/**
+ * @class Tracer
+ * @brief Records trace events into a ring buffer per thread.
+ *
+ * Once a buffer is full the oldest events of the thread are overwritten, so
+ * the trace always holds the latest activity. Time is taken from the
+ * monotonic clock, which all processes of a host share, so the traces of
+ * several nodes can be merged into one timeline.
+ */
+class Tracer
+{
+public:
+  /**
+   * @brief  Start recording
+   * @param  capacity The number of events kept per thread
+   * @param  trace_marker Also write every event to the ftrace marker file,
+   *         where perf and trace-cmd show it next to the scheduler events
+   */
+  static void enable(unsigned int capacity, bool trace_marker = false);
+
+  /**
+   * @brief  Stop recording, the recorded events are kept for export. The
+   * ftrace marker stays open for the next enable, so a thread that is
+   * writing to it while tracing is disabled never hits a closed descriptor
+   */
+  static void disable();
+
+  static bool isEnabled()
+  {
+    return enabled_.load(boost::memory_order_relaxed);
+  }
+
+  static bool isMarkerEnabled()
+  {
+    return marker_enabled_.load(boost::memory_order_relaxed);
+  }
+
+  /** @brief  Nanoseconds on the monotonic clock */
+  static uint64_t now();
+
+  /** @brief  Record an event that started at begin and lasted duration nanoseconds */
+  static void complete(const char* name, uint64_t begin, uint64_t duration);
+
+  static void instant(const char* name);
+
+  static void setThreadName(const char* name);
+
+  /** @brief  Write a begin ('B') or end ('E') event to the ftrace marker */
+  static void mark(char phase, const char* name);
+
+  /**
+   * @brief  Write the recorded events in the Chrome trace event format,
+   * which chrome://tracing and Perfetto open
+   * @return False if the file could not be written
+   */
+  static bool exportChromeTrace(const std::string& path);
+
+  /** @brief  Drop all recorded events */
+  static void clear();
+
+private:
+  static boost::atomic<bool> enabled_;
+  static boost::atomic<bool> marker_enabled_;
+  static boost::atomic<int> marker_fd_;
+};
+
+/** @brief  Records the lifetime of the object as one event, see NAV_TRACE_SCOPE */
+class TraceScope
+{
+public:
+  explicit TraceScope(const char* name) :
+      name_(name), begin_(0)
+  {
+    if (Tracer::isEnabled())
+    {
+      begin_ = Tracer::now();
+      if (Tracer::isMarkerEnabled())
+        Tracer::mark('B', name_);
+    }
+  }
+
+  ~TraceScope()
+  {
+    if (begin_ != 0)
+    {
+      Tracer::complete(name_, begin_, Tracer::now() - begin_);
+      if (Tracer::isMarkerEnabled())
+        Tracer::mark('E', name_);
+    }
+  }
+
+private:
+  const char* name_;
+  uint64_t begin_;
+};
+
+}  // namespace nav_trace
+
+#endif  // NAV_TRACE_TRACE_H_
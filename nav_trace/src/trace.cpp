@@ -0,0 +1,280 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2013, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <nav_trace/trace.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <ros/console.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace nav_trace
+{
+
+boost::atomic<bool> Tracer::enabled_(false);
+boost::atomic<bool> Tracer::marker_enabled_(false);
+boost::atomic<int> Tracer::marker_fd_(-1);
+
+namespace
+{
+
+struct TraceEvent
+{
+  const char* name;
+  uint64_t begin;
+  uint64_t duration;
+  char phase;
+};
+
+struct ThreadTrace
+{
+  boost::mutex mutex;
+  std::vector<TraceEvent> events;
+  unsigned int next;  ///< Where the next event goes, once the ring is full the oldest event is there
+  bool wrapped;
+  unsigned int tid;
+  std::string name;
+};
+
+boost::mutex registry_mutex;
+std::vector<ThreadTrace*> registry;
+unsigned int capacity = 0;
+
+//the traces outlive their threads, so events of finished threads can still be exported
+void keepTrace(ThreadTrace*)
+{
+}
+
+boost::thread_specific_ptr<ThreadTrace> current_trace(keepTrace);
+
+ThreadTrace* threadTrace()
+{
+  ThreadTrace* trace = current_trace.get();
+  if (trace == NULL)
+  {
+    trace = new ThreadTrace();
+    trace->next = 0;
+    trace->wrapped = false;
+    boost::mutex::scoped_lock lock(registry_mutex);
+    trace->tid = registry.size() + 1;
+    registry.push_back(trace);
+    current_trace.reset(trace);
+  }
+  return trace;
+}
+
+void record(const char* name, char phase, uint64_t begin, uint64_t duration)
+{
+  ThreadTrace* trace = threadTrace();
+  boost::mutex::scoped_lock lock(trace->mutex);
+  if (trace->events.empty())
+  {
+    if (capacity == 0)
+      return;
+    trace->events.resize(capacity);
+  }
+
+  TraceEvent& event = trace->events[trace->next];
+  event.name = name;
+  event.begin = begin;
+  event.duration = duration;
+  event.phase = phase;
+  if (++trace->next == trace->events.size())
+  {
+    trace->next = 0;
+    trace->wrapped = true;
+  }
+}
+
+void writeString(FILE* file, const char* text)
+{
+  fputc('"', file);
+  for (const char* c = text; *c != '\0'; ++c)
+  {
+    if (*c == '"' || *c == '\\')
+      fputc('\\', file);
+    fputc(*c, file);
+  }
+  fputc('"', file);
+}
+
+}  // namespace
+
+void Tracer::enable(unsigned int events, bool trace_marker)
+{
+  {
+    boost::mutex::scoped_lock lock(registry_mutex);
+    capacity = events;
+  }
+
+  //the marker is opened once and never closed, so a scope ending on another
+  //thread never writes to a closed or reused descriptor
+  if (trace_marker && marker_fd_ < 0)
+  {
+    int fd = open("/sys/kernel/tracing/trace_marker", O_WRONLY);
+    if (fd < 0)
+      fd = open("/sys/kernel/debug/tracing/trace_marker", O_WRONLY);
+    if (fd < 0)
+      ROS_WARN("Could not open the ftrace marker, is tracefs mounted and writable?");
+    else
+      marker_fd_ = fd;
+  }
+  marker_enabled_ = trace_marker && marker_fd_ >= 0;
+  enabled_ = events > 0;
+}
+
+void Tracer::disable()
+{
+  enabled_ = false;
+  marker_enabled_ = false;
+}
+
+uint64_t Tracer::now()
+{
+  timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t)time.tv_sec * 1000000000ull + time.tv_nsec;
+}
+
+void Tracer::complete(const char* name, uint64_t begin, uint64_t duration)
+{
+  record(name, 'X', begin, duration);
+}
+
+void Tracer::instant(const char* name)
+{
+  if (!enabled_)
+    return;
+  record(name, 'i', now(), 0);
+  int fd = marker_fd_;
+  if (marker_enabled_ && fd >= 0)
+  {
+    char line[128];
+    int length = snprintf(line, sizeof(line), "I|%d|%s", (int)getpid(), name);
+    if (write(fd, line, std::min(length, (int)sizeof(line) - 1)) < 0)
+      return;
+  }
+}
+
+void Tracer::setThreadName(const char* name)
+{
+  ThreadTrace* trace = threadTrace();
+  boost::mutex::scoped_lock lock(trace->mutex);
+  trace->name = name;
+}
+
+void Tracer::mark(char phase, const char* name)
+{
+  int fd = marker_fd_;
+  if (fd < 0)
+    return;
+
+  //the format of systrace, which perf script, trace-cmd and Perfetto understand
+  char line[128];
+  int length;
+  if (phase == 'B')
+    length = snprintf(line, sizeof(line), "B|%d|%s", (int)getpid(), name);
+  else
+    length = snprintf(line, sizeof(line), "E|%d", (int)getpid());
+  if (write(fd, line, std::min(length, (int)sizeof(line) - 1)) < 0)
+    return;
+}
+
+bool Tracer::exportChromeTrace(const std::string& path)
+{
+  FILE* file = fopen(path.c_str(), "w");
+  if (file == NULL)
+    return false;
+
+  int pid = getpid();
+  bool first = true;
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+  std::vector<ThreadTrace*> traces;
+  {
+    boost::mutex::scoped_lock lock(registry_mutex);
+    traces = registry;
+  }
+  for (unsigned int t = 0; t < traces.size(); ++t)
+  {
+    ThreadTrace& trace = *traces[t];
+    boost::mutex::scoped_lock lock(trace.mutex);
+    if (!trace.name.empty())
+    {
+      fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":",
+              first ? "" : ",", pid, trace.tid);
+      writeString(file, trace.name.c_str());
+      fprintf(file, "}}");
+      first = false;
+    }
+
+    //oldest first, when the ring has wrapped that is the one about to be overwritten
+    unsigned int count = trace.wrapped ? trace.events.size() : trace.next;
+    unsigned int start = trace.wrapped ? trace.next : 0;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+      const TraceEvent& event = trace.events[(start + i) % trace.events.size()];
+      fprintf(file, "%s\n{\"name\":", first ? "" : ",");
+      writeString(file, event.name);
+      fprintf(file, ",\"ph\":\"%c\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f", event.phase, pid, trace.tid,
+              event.begin * 1e-3);
+      if (event.phase == 'X')
+        fprintf(file, ",\"dur\":%.3f}", event.duration * 1e-3);
+      else
+        fprintf(file, ",\"s\":\"t\"}");
+      first = false;
+    }
+  }
+
+  fprintf(file, "\n]}\n");
+  return fclose(file) == 0;
+}
+
+void Tracer::clear()
+{
+  boost::mutex::scoped_lock registry_lock(registry_mutex);
+  for (unsigned int t = 0; t < registry.size(); ++t)
+  {
+    boost::mutex::scoped_lock lock(registry[t]->mutex);
+    registry[t]->next = 0;
+    registry[t]->wrapped = false;
+  }
+}
+
+}  // namespace nav_trace
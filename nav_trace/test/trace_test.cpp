@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <nav_trace/trace.h>
+
+using namespace nav_trace;
+
+static std::string exportTrace()
+{
+  std::string path = "/tmp/nav_trace_test.json";
+  EXPECT_TRUE(Tracer::exportChromeTrace(path));
+  std::ifstream file(path.c_str());
+  std::stringstream text;
+  text << file.rdbuf();
+  return text.str();
+}
+
+static size_t occurrences(const std::string& text, const std::string& word)
+{
+  size_t count = 0;
+  for (size_t i = text.find(word); i != std::string::npos; i = text.find(word, i + 1))
+    ++count;
+  return count;
+}
+
+TEST(trace, records_scopes_while_enabled)
+{
+  Tracer::clear();
+  {
+    NAV_TRACE_SCOPE("before");
+  }
+
+  Tracer::enable(16);
+  NAV_TRACE_THREAD("tester");
+  {
+    NAV_TRACE_SCOPE("outer");
+    NAV_TRACE_SCOPE("inner");
+    NAV_TRACE_INSTANT("point");
+  }
+  Tracer::disable();
+
+  {
+    NAV_TRACE_SCOPE("after");
+  }
+
+  std::string text = exportTrace();
+  EXPECT_EQ(0u, occurrences(text, "\"before\""));
+  EXPECT_EQ(0u, occurrences(text, "\"after\""));
+  EXPECT_EQ(1u, occurrences(text, "\"outer\",\"ph\":\"X\""));
+  EXPECT_EQ(1u, occurrences(text, "\"inner\",\"ph\":\"X\""));
+  EXPECT_EQ(1u, occurrences(text, "\"point\",\"ph\":\"i\""));
+  EXPECT_EQ(1u, occurrences(text, "\"tester\""));
+}
+
+TEST(trace, ring_keeps_the_latest_events)
+{
+  Tracer::clear();
+  Tracer::enable(16);
+  for (int i = 0; i < 20; ++i)
+  {
+    NAV_TRACE_SCOPE("old");
+  }
+  for (int i = 0; i < 10; ++i)
+  {
+    NAV_TRACE_SCOPE("new");
+  }
+  Tracer::disable();
+
+  std::string text = exportTrace();
+  EXPECT_EQ(6u, occurrences(text, "\"old\""));
+  EXPECT_EQ(10u, occurrences(text, "\"new\""));
+  // events are exported oldest first
+  EXPECT_LT(text.rfind("\"old\""), text.find("\"new\""));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,86 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*
+*********************************************************************/
+#ifndef NAVFN_CORRIDOR_H_
+#define NAVFN_CORRIDOR_H_
+
+#include <costmap_2d/costmap_2d.h>
+#include <geometry_msgs/Point.h>
+#include <vector>
+
+namespace navfn {
+  /**
+   * @class Corridor
+   * @brief The part of the costmap a planner restricts its search to when the route is roughly known already,
+   * either the inside of a polygon or the cells within half a width of the lines between waypoints.  Kept in
+   * world coordinates, so it stays in place when the costmap moves.
+   */
+  class Corridor {
+    public:
+      Corridor();
+
+      /**
+       * @brief  Sets the corridor to the inside of a polygon, in the frame of the costmap
+       */
+      void setPolygon(const std::vector<geometry_msgs::Point>& polygon);
+
+      /**
+       * @brief  Sets the corridor to the cells within width / 2 of the lines between the waypoints, in the frame of the costmap
+       */
+      void setWaypoints(const std::vector<geometry_msgs::Point>& waypoints, double width);
+
+      void clear();
+
+      bool empty() const { return points_.empty(); }
+
+      /**
+       * @brief  Gets the cells of the costmap within the corridor
+       * @param costmap The costmap the cells are taken from
+       * @param spans Filled with a triple y, x0, xn for every run of cells [x0, xn) of row y, runs may overlap
+       */
+      void getSpans(const costmap_2d::Costmap2D& costmap, std::vector<int>& spans) const;
+
+    private:
+      /**
+       * @brief  Adds the run of the cells of row y whose centers lie in [lo, hi) to spans
+       */
+      void addSpan(int y, double lo, double hi, int nx, std::vector<int>& spans) const;
+
+      std::vector<geometry_msgs::Point> points_;
+      double width_; /**< 0 for the inside of a polygon */
+  };
+};
+
+#endif
@@ -72,9 +72,21 @@
 #endif
 
 // potential defs
+// Potentials are floats, or with NAVFN_INT_POTENTIAL fixed point integers
+// in 1/POT_SCALE of a cost, for targets where float arithmetic is slow.
+// The potentials given out by NavfnROS are in costs either way.
+#ifdef NAVFN_INT_POTENTIAL
+typedef int32_t POTTYPE;
+#define POT_SCALE 16
+#define POT_HIGH 1000000000	// unassigned cell potential
+#define QUAD_STEPS 256		// entries of the table of the quadratic update
+#else
+typedef float POTTYPE;
+#define POT_SCALE 1
 #define POT_HIGH 1.0e10		// unassigned cell potential
+#endif
 
-// priority buffers
+// initial size of the priority buffers, they grow as needed
 #define PRIORITYBUFSIZE 10000
 
 
@@ -168,18 +180,26 @@ positions at about 1/2 cell resolution; else returns 0.
 
       /** cell arrays */
       COSTTYPE *costarr;		/**< cost array in 2D configuration space */
-      float   *potarr;		/**< potential array, navigation function potential */
+      POTTYPE *potarr;		/**< potential array, navigation function potential */
       bool    *pending;		/**< pending cells during propagation */
       int nobs;			/**< number of obstacle cells */
+      int ncells;		/**< number of cells put into priority blocks by the last propagation */
 
       /** block priority buffers */
-      int *pb1, *pb2, *pb3;		/**< storage buffers for priority blocks */
       int *curP, *nextP, *overP;	/**< priority buffer block ptrs */
       int curPe, nextPe, overPe; /**< end points of arrays */
+      int curPs, nextPs, overPs; /**< allocated sizes of arrays */
+
+      /**
+       * @brief  Doubles the size of a priority block, keeping its contents
+       * @param block The block to grow
+       * @param size The allocated size of the block, updated
+       */
+      void growBlock(int *&block, int &size);
 
       /** block priority thresholds */
-      float curT;			/**< current threshold */
-      float priInc;			/**< priority threshold increment */
+      POTTYPE curT;			/**< current threshold */
+      float priInc;			/**< priority threshold increment, in costs */
 
       /** goal and start positions */
       /**
@@ -190,12 +210,24 @@ positions at about 1/2 cell resolution; else returns 0.
 
       /**
        * @brief  Sets the start position for the planner. Note: the navigation cost field computed gives the cost to get to a given point from the goal, not from the start.
+       * Resets the stop region to the start cell.
        * @param start the start position 
        */
       void setStart(int *start);	
 
+      /**
+       * @brief  Sets when propNavFnDijkstra() stops if it is to stop at the start: once every cell of the region
+       * that isn't an obstacle has a potential, and the propagation has gone on for the margin beyond that
+       * @param x0, y0, x1, y1 The corners of the region, the cells of both are in it
+       * @param margin The potential the threshold is raised by after the region is reached
+       */
+      void setStopRegion(int x0, int y0, int x1, int y1, float margin);
+
       int goal[2];
       int start[2];
+
+      int stopX0, stopY0, stopX1, stopY1; /**< stop region, stopX0 < 0 if it is just the start cell */
+      float stopMargin;		/**< potential propagated beyond the stop region */
       /**
        * @brief  Initialize cell k with cost v for propagation
        * @param k the cell to initialize 
@@ -203,6 +235,22 @@ positions at about 1/2 cell resolution; else returns 0.
        */
       void initCost(int k, float v); /**< initialize cell <k> with cost <v>, for propagation */
 
+      /**
+       * @brief  The potential of a cell from the two lowest of its neighbors
+       * @param ta, tc The lowest neighbors in either direction
+       * @param cost The cost of the cell
+       */
+      POTTYPE planarUpdate(POTTYPE ta, POTTYPE tc, COSTTYPE cost);
+
+      /**
+       * @brief  The potential a neighbor has to be above to be updated, for a neighbor of the given cost
+       */
+      POTTYPE neighborMargin(COSTTYPE cost);
+
+#ifdef NAVFN_INT_POTENTIAL
+      int32_t quadTable[QUAD_STEPS]; /**< quadratic update for the ratio of the neighbors, in 1/65536 of the cost */
+#endif
+
       /** simple obstacle for testing */
       void setObs();
 
@@ -229,6 +277,13 @@ positions at about 1/2 cell resolution; else returns 0.
        * @return true if the start point is reached
        */
       bool propNavFnDijkstra(int cycles, bool atStart = false); /**< returns true if start point found or full prop */
+
+      /**
+       * @brief  Checks whether all cells of the stop region that aren't obstacles have a potential
+       * @param next The number of cells of the region already found to have one, updated
+       * @return True if they all have one
+       */
+      bool stopRegionReached(int &next);
       /**
        * @brief  Run propagation for <cycles> iterations, or until start is reached using the best-first A* method with Euclidean distance heuristic
        * @param cycles The maximum number of iterations to run for
@@ -236,8 +291,7 @@ positions at about 1/2 cell resolution; else returns 0.
        */
       bool propNavFnAstar(int cycles); /**< returns true if start point found */
 
-      /** gradient and paths */
-      float *gradx, *grady;		/**< gradient arrays, size of potential array */
+      /** paths */
       float *pathx, *pathy;		/**< path points, as subpixel cell coordinates */
       int npath;			/**< number of path points */
       int npathbuf;			/**< size of pathx, pathy buffers */
@@ -252,7 +306,7 @@ positions at about 1/2 cell resolution; else returns 0.
        */
       int calcPath(int n, int *st = NULL); /**< calculates path for at most <n> cycles, returns path length, 0 if none */
 
-      float gradCell(int n);	/**< calculates gradient at cell <n>, returns norm */
+      float gradCell(int n, float &gx, float &gy); /**< calculates the gradient at cell <n> into <gx>, <gy>, returns norm */
       float pathStep;		/**< step size for following gradient */
 
       /** display callback */
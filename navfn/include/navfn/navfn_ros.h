@@ -38,16 +38,23 @@
 #define NAVFN_NAVFN_ROS_H_
 
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <ros/spinner.h>
 #include <navfn/navfn.h>
+#include <navfn/corridor.h>
+#include <navfn/plan_requests.h>
+#include <navfn/potential_publisher.h>
 #include <costmap_2d/costmap_2d.h>
 #include <geometry_msgs/PoseStamped.h>
 #include <geometry_msgs/Point.h>
+#include <geometry_msgs/PolygonStamped.h>
 #include <nav_msgs/Path.h>
 #include <tf/transform_datatypes.h>
 #include <vector>
 #include <nav_core/base_global_planner.h>
 #include <nav_msgs/GetPlan.h>
 #include <navfn/potarr_point.h>
+#include <navfn/MakeNavPlans.h>
 #include <pcl_ros/publisher.h>
 
 namespace navfn {
@@ -69,6 +76,14 @@ namespace navfn {
        */
       NavfnROS(std::string name, costmap_2d::Costmap2DROS* costmap_ros);
 
+      /**
+       * @brief  Constructor for the NavFnROS object
+       * @param  name The name of this planner
+       * @param  costmap A pointer to the costmap to use
+       * @param  global_frame The frame of the costmap
+       */
+      NavfnROS(std::string name, costmap_2d::Costmap2D* costmap, std::string global_frame);
+
       /**
        * @brief  Initialization function for the NavFnROS object
        * @param  name The name of this planner
@@ -76,6 +91,14 @@ namespace navfn {
        */
       void initialize(std::string name, costmap_2d::Costmap2DROS* costmap_ros);
 
+      /**
+       * @brief  Initialization function for the NavFnROS object
+       * @param  name The name of this planner
+       * @param  costmap A pointer to the costmap to use for planning
+       * @param  global_frame The frame of the costmap
+       */
+      void initialize(std::string name, costmap_2d::Costmap2D* costmap, std::string global_frame);
+
       /**
        * @brief Given a goal pose in the world, compute a plan
        * @param start The start pose 
@@ -97,6 +120,30 @@ namespace navfn {
       bool makePlan(const geometry_msgs::PoseStamped& start, 
           const geometry_msgs::PoseStamped& goal, double tolerance, std::vector<geometry_msgs::PoseStamped>& plan);
 
+      /**
+       * @brief Given many goal poses in the world, compute the plans to all of them from one navigation function, see nav_core::BaseGlobalPlanner
+       * @param start The start pose
+       * @param goals The goal poses, without tolerance
+       * @param costs Filled with the potential at every goal, the cost of getting there, or -1 if there is no plan
+       * @param plans If not NULL, filled with the plan to every goal, empty if there is none
+       * @return True if the navigation function was computed, false otherwise
+       */
+      bool makePlans(const geometry_msgs::PoseStamped& start, const std::vector<geometry_msgs::PoseStamped>& goals,
+          std::vector<double>& costs, std::vector<std::vector<geometry_msgs::PoseStamped> >* plans);
+
+      /**
+       * @brief  Restricts the search of the following plans to the cells within width / 2 of the lines between
+       * the waypoints, in the frame of the costmap.  If there is no plan within it the whole costmap is searched.
+       */
+      void setCorridor(const std::vector<geometry_msgs::Point>& waypoints, double width);
+
+      /**
+       * @brief  Restricts the search of the following plans to the inside of a polygon, in the frame of the costmap
+       */
+      void setCorridorPolygon(const std::vector<geometry_msgs::Point>& polygon);
+
+      void clearCorridor();
+
       /**
        * @brief  Computes the full navigation function for the map given a point in the world to start from
        * @param world_point The point to use for seeding the navigation function 
@@ -139,16 +186,23 @@ namespace navfn {
        */
       void publishPlan(const std::vector<geometry_msgs::PoseStamped>& path, double r, double g, double b, double a);
 
-      ~NavfnROS(){}
+      ~NavfnROS();
 
+      /**
+       * @brief  Plans on a copy of the costmap with a planner of its own, without holding up makePlan(), see PlanRequests
+       */
       bool makePlanService(nav_msgs::GetPlan::Request& req, nav_msgs::GetPlan::Response& resp);
 
+      bool makePlansService(MakeNavPlans::Request& req, MakeNavPlans::Response& resp);
+
     protected:
 
       /**
        * @brief Store a copy of the current costmap in \a costmap.  Called by makePlan.
        */
-      costmap_2d::Costmap2DROS* costmap_ros_;
+      costmap_2d::Costmap2DROS* costmap_ros_; /**< NULL unless initialized with the ROS wrapper */
+      costmap_2d::Costmap2D* costmap_;
+      std::string global_frame_;
       boost::shared_ptr<NavFn> planner_;
       ros::Publisher plan_pub_;
       pcl_ros::Publisher<PotarrPoint> potarr_pub_;
@@ -163,11 +217,47 @@ namespace navfn {
       }
 
       void mapToWorld(double mx, double my, double& wx, double& wy);
+
+      /**
+       * @brief  Publishes the potential of a plan as a point cloud, on the thread of potential_publisher_
+       */
+      void publishPotential(const PotentialPublisher::Potential& potential);
+
       void clearRobotCell(const tf::Stamped<tf::Pose>& global_pose, unsigned int mx, unsigned int my);
+
+      /**
+       * @brief  Sets the costs of the planner outside of the corridor to COST_OBS, unmaskCorridor() sets them back
+       */
+      void maskCorridor(const costmap_2d::Costmap2D& costmap);
+      void unmaskCorridor();
+
+      /**
+       * @brief  Plans for a service call, with service_planner_ on a fresh copy of the costmap
+       */
+      bool makeServicePlan(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal,
+          std::vector<geometry_msgs::PoseStamped>& plan);
+
+      void corridorCB(const nav_msgs::Path::ConstPtr& path);
+      void corridorPolygonCB(const geometry_msgs::PolygonStamped::ConstPtr& polygon);
+
       double planner_window_x_, planner_window_y_, default_tolerance_;
+      double stop_margin_;
+      Corridor corridor_;
+      double corridor_width_; /**< width of the corridors given as a path */
+      std::vector<int> corridor_spans_;
+      std::vector<COSTTYPE> corridor_costs_; /**< swapped with the costs of the planner while they are masked */
+      ros::Subscriber corridor_sub_, corridor_polygon_sub_;
       std::string tf_prefix_;
       boost::mutex mutex_;
-      ros::ServiceServer make_plan_srv_;
+      ros::ServiceServer make_plan_srv_, make_plans_srv_;
+
+      bool service_worker_; /**< plans the service calls of another planner, without services or subscriptions of its own */
+      costmap_2d::Costmap2D service_costmap_;
+      boost::shared_ptr<NavfnROS> service_planner_;
+      boost::shared_ptr<PlanRequests> plan_requests_;
+      ros::CallbackQueue service_queue_; /**< the make_plan calls, they don't wait for the other callbacks */
+      boost::shared_ptr<ros::AsyncSpinner> service_spinner_;
+      boost::shared_ptr<PotentialPublisher> potential_publisher_; /**< NULL unless visualize_potential is set */
   };
 };
 
@@ -0,0 +1,87 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*
+*********************************************************************/
+#ifndef NAVFN_PLAN_REQUESTS_H_
+#define NAVFN_PLAN_REQUESTS_H_
+
+#include <geometry_msgs/PoseStamped.h>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <vector>
+
+namespace navfn {
+  /**
+   * @class PlanRequests
+   * @brief Runs the plans asked for by concurrent service calls one at a time.  A call asking for the same plan
+   * as one that is being planned or waiting shares its result, and a new call supersedes the one waiting, which
+   * then returns without a plan.
+   */
+  class PlanRequests {
+    public:
+      typedef boost::function<bool (const geometry_msgs::PoseStamped&, const geometry_msgs::PoseStamped&,
+          std::vector<geometry_msgs::PoseStamped>&)> PlanFunction;
+
+      /**
+       * @param plan Makes a plan from start to goal, it is only ever called from one thread at a time
+       */
+      PlanRequests(const PlanFunction& plan);
+
+      /**
+       * @brief  Plans from start to goal, or waits for the plan of an identical request
+       * @return True if a plan was found, false if there is none or a newer request superseded this one
+       */
+      bool makePlan(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal,
+          std::vector<geometry_msgs::PoseStamped>& plan);
+
+    private:
+      struct Request {
+        geometry_msgs::PoseStamped start, goal;
+        std::vector<geometry_msgs::PoseStamped> plan;
+        bool found, done, cancelled;
+
+        bool matches(const geometry_msgs::PoseStamped& s, const geometry_msgs::PoseStamped& g) const;
+      };
+
+      PlanFunction plan_;
+      boost::mutex mutex_;
+      boost::condition_variable changed_;
+      boost::shared_ptr<Request> running_; /**< the request being planned, if there is one */
+      boost::shared_ptr<Request> waiting_; /**< the newest request, waiting for the one running */
+  };
+};
+
+#endif
@@ -0,0 +1,135 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*
+*********************************************************************/
+#ifndef NAVFN_POTENTIAL_PUBLISHER_H_
+#define NAVFN_POTENTIAL_PUBLISHER_H_
+
+#include <ros/time.h>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <string>
+#include <vector>
+
+namespace navfn {
+  /**
+   * @class PotentialPublisher
+   * @brief Publishes the potentials of the plans for visualization on a thread of its own.  The planning thread
+   * only copies the potential array; finding the explored region, scaling and building the message are left to
+   * the thread, and a copy that comes in while it is busy replaces the one still waiting.
+   */
+  class PotentialPublisher {
+    public:
+      /**
+       * @brief  The potentials of a plan, cropped to the cells that were reached
+       */
+      struct Potential {
+        std::vector<float> cells;  /**< the potentials of the whole map, row by row */
+        int nx, ny;
+        int x0, y0, x1, y1;        /**< the cells reached, x1 and y1 included */
+        float max;                 /**< the highest potential reached */
+        float reference;           /**< a potential given with the copy, for the scale of the message */
+        double origin_x, origin_y, resolution;
+        std::string frame_id;
+        ros::Time stamp;
+
+        float at(int x, int y) const { return cells[x + y * nx]; }
+      };
+
+      typedef boost::function<void (const Potential&)> PublishFunction;
+
+      /**
+       * @param publish Builds and publishes the message, only ever called from the thread of the publisher
+       * @param rate The highest rate of the copies taken, 0 to take one with every plan
+       */
+      PotentialPublisher(const PublishFunction& publish, double rate);
+
+      /**
+       * @brief  Stops the thread; the potential waiting, if any, is dropped
+       */
+      ~PotentialPublisher();
+
+      /**
+       * @brief  Whether a copy would be taken now, false if the last one is too recent
+       */
+      bool due() const;
+
+      /**
+       * @brief  Hands a copy of the potentials over to the thread, if one is due
+       * @param high The potential of the cells that weren't reached
+       */
+      template <typename T>
+      void post(const T* potential, int nx, int ny, T high, float reference, double origin_x, double origin_y,
+          double resolution, const std::string& frame_id){
+        if(!due())
+          return;
+        boost::mutex::scoped_lock lock(mutex_);
+        last_post_ = ros::WallTime::now();
+        waiting_.cells.resize(nx * ny);
+        for(int i = 0; i < nx * ny; i++)
+          waiting_.cells[i] = potential[i] < high ? (float)potential[i] : -1.0f;
+        waiting_.nx = nx;
+        waiting_.ny = ny;
+        waiting_.reference = reference;
+        waiting_.origin_x = origin_x;
+        waiting_.origin_y = origin_y;
+        waiting_.resolution = resolution;
+        waiting_.frame_id = frame_id;
+        waiting_.stamp = ros::Time::now();
+        pending_ = true;
+        changed_.notify_one();
+      }
+
+    private:
+      void run();
+
+      /**
+       * @brief  Finds the cells reached and the highest potential, false if no cell was reached
+       */
+      static bool crop(Potential& potential);
+
+      PublishFunction publish_;
+      ros::WallDuration period_;
+      ros::WallTime last_post_;
+      boost::mutex mutex_;
+      boost::condition_variable changed_;
+      Potential waiting_, publishing_;
+      bool pending_, stopping_;
+      boost::thread thread_;
+  };
+};
+
+#endif
@@ -0,0 +1,147 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*
+*********************************************************************/
+#include <navfn/corridor.h>
+#include <algorithm>
+#include <math.h>
+
+namespace navfn {
+
+  Corridor::Corridor() : width_(0.0) {}
+
+  void Corridor::setPolygon(const std::vector<geometry_msgs::Point>& polygon){
+    points_.clear();
+    width_ = 0.0;
+    //an area needs at least a triangle
+    if(polygon.size() >= 3)
+      points_ = polygon;
+  }
+
+  void Corridor::setWaypoints(const std::vector<geometry_msgs::Point>& waypoints, double width){
+    points_.clear();
+    width_ = 0.0;
+    if(width > 0.0){
+      points_ = waypoints;
+      width_ = width;
+    }
+  }
+
+  void Corridor::clear(){
+    points_.clear();
+    width_ = 0.0;
+  }
+
+  void Corridor::addSpan(int y, double lo, double hi, int nx, std::vector<int>& spans) const {
+    int x0 = std::max((int)ceil(lo - 0.5), 0);
+    int xn = std::min((int)ceil(hi - 0.5), nx);
+    if(x0 >= xn)
+      return;
+    spans.push_back(y);
+    spans.push_back(x0);
+    spans.push_back(xn);
+  }
+
+  void Corridor::getSpans(const costmap_2d::Costmap2D& costmap, std::vector<int>& spans) const {
+    spans.clear();
+    if(points_.empty())
+      return;
+
+    int nx = costmap.getSizeInCellsX(), ny = costmap.getSizeInCellsY();
+    double resolution = costmap.getResolution();
+    double r = width_ / 2 / resolution;
+
+    //the points in cells, cell i covering [i, i + 1)
+    std::vector<double> px(points_.size()), py(points_.size());
+    double ymin = HUGE_VAL, ymax = -HUGE_VAL;
+    for(unsigned int i = 0; i < points_.size(); i++){
+      px[i] = (points_[i].x - costmap.getOriginX()) / resolution;
+      py[i] = (points_[i].y - costmap.getOriginY()) / resolution;
+      ymin = std::min(ymin, py[i]);
+      ymax = std::max(ymax, py[i]);
+    }
+    int y0 = std::max((int)floor(ymin - r), 0);
+    int yn = std::min((int)ceil(ymax + r), ny);
+
+    std::vector<double> crossings;
+    for(int y = y0; y < yn; y++){
+      //the rows are cut at the centers of their cells
+      double yc = y + 0.5;
+
+      if(width_ == 0.0){
+        //the edges crossing the row, the inside lies between every other pair
+        crossings.clear();
+        for(unsigned int i = 0, j = px.size() - 1; i < px.size(); j = i++){
+          if((py[i] <= yc) != (py[j] <= yc))
+            crossings.push_back(px[i] + (yc - py[i]) * (px[j] - px[i]) / (py[j] - py[i]));
+        }
+        std::sort(crossings.begin(), crossings.end());
+        for(unsigned int k = 0; k + 1 < crossings.size(); k += 2)
+          addSpan(y, crossings[k], crossings[k + 1], nx, spans);
+        continue;
+      }
+
+      //every segment with the discs at its ends is convex, so the row crosses it in one run
+      unsigned int segments = px.size() > 1 ? px.size() - 1 : 1;
+      for(unsigned int i = 0; i < segments; i++){
+        unsigned int j = std::min(i + 1, (unsigned int)px.size() - 1);
+        double lo = HUGE_VAL, hi = -HUGE_VAL;
+        for(unsigned int k = i; k <= j; k++){
+          double dy = yc - py[k];
+          if(fabs(dy) <= r){
+            double h = sqrt(r * r - dy * dy);
+            lo = std::min(lo, px[k] - h);
+            hi = std::max(hi, px[k] + h);
+          }
+        }
+        double dx = px[j] - px[i], dy = py[j] - py[i], len = hypot(dx, dy);
+        if(len > 0.0){
+          //the rectangle between the two discs
+          double nx_r = -dy / len * r, ny_r = dx / len * r;
+          double cx[4] = {px[i] + nx_r, px[j] + nx_r, px[j] - nx_r, px[i] - nx_r};
+          double cy[4] = {py[i] + ny_r, py[j] + ny_r, py[j] - ny_r, py[i] - ny_r};
+          for(int a = 0, b = 3; a < 4; b = a++){
+            if((cy[a] <= yc) != (cy[b] <= yc)){
+              double x = cx[a] + (yc - cy[a]) * (cx[b] - cx[a]) / (cy[b] - cy[a]);
+              lo = std::min(lo, x);
+              hi = std::max(hi, x);
+            }
+          }
+        }
+        if(lo < hi)
+          addSpan(y, lo, hi, nx, spans);
+      }
+    }
+  }
+};
@@ -113,21 +113,34 @@ namespace navfn {
     costarr = NULL;
     potarr = NULL;
     pending = NULL;
-    gradx = grady = NULL;
     setNavArr(xs,ys);
 
     // priority buffers
-    pb1 = new int[PRIORITYBUFSIZE];
-    pb2 = new int[PRIORITYBUFSIZE];
-    pb3 = new int[PRIORITYBUFSIZE];
+    curP = new int[PRIORITYBUFSIZE];
+    nextP = new int[PRIORITYBUFSIZE];
+    overP = new int[PRIORITYBUFSIZE];
+    curPs = nextPs = overPs = PRIORITYBUFSIZE;
+    curPe = nextPe = overPe = 0;
+    ncells = 0;
 
     // for Dijkstra (breadth-first), set to COST_NEUTRAL
     // for A* (best-first), set to COST_NEUTRAL
     priInc = 2*COST_NEUTRAL;	
 
+#ifdef NAVFN_INT_POTENTIAL
+    // the quadratic of updateCell() sampled at the middle of every step
+    for (int i=0; i<QUAD_STEPS; i++)
+    {
+      float d = (i+0.5)/QUAD_STEPS;
+      quadTable[i] = (int32_t)((-0.2301*d*d + 0.5307*d + 0.7040)*65536 + 0.5);
+    }
+#endif
+
     // goal and start
     goal[0] = goal[1] = 0;
     start[0] = start[1] = 0;
+    stopX0 = stopY0 = stopX1 = stopY1 = -1;
+    stopMargin = 0.0;
 
     // display function
     displayFn = NULL;
@@ -148,20 +161,16 @@ namespace navfn {
       delete[] potarr;
     if(pending)
       delete[] pending;
-    if(gradx)
-      delete[] gradx;
-    if(grady)
-      delete[] grady;
     if(pathx)
       delete[] pathx;
     if(pathy)
       delete[] pathy;
-    if(pb1)
-      delete[] pb1;
-    if(pb2)
-      delete[] pb2;
-    if(pb3)
-      delete[] pb3;
+    if(curP)
+      delete[] curP;
+    if(nextP)
+      delete[] nextP;
+    if(overP)
+      delete[] overP;
   }
 
 
@@ -182,9 +191,21 @@ namespace navfn {
     {
       start[0] = g[0];
       start[1] = g[1];
+      stopX0 = stopY0 = stopX1 = stopY1 = -1;
+      stopMargin = 0.0;
       ROS_DEBUG("[NavFn] Setting start to %d,%d\n", start[0], start[1]);
     }
 
+  void
+    NavFn::setStopRegion(int x0, int y0, int x1, int y1, float margin)
+    {
+      stopX0 = std::max(std::min(x0, x1), 0);
+      stopY0 = std::max(std::min(y0, y1), 0);
+      stopX1 = std::min(std::max(x0, x1), nx-1);
+      stopY1 = std::min(std::max(y0, y1), ny-1);
+      stopMargin = margin;
+    }
+
   //
   // Set/Reset map size
   //
@@ -205,18 +226,11 @@ namespace navfn {
       if(pending)
         delete[] pending;
 
-      if(gradx)
-        delete[] gradx;
-      if(grady)
-        delete[] grady;
-
       costarr = new COSTTYPE[ns]; // cost array, 2d config space
       memset(costarr, 0, ns*sizeof(COSTTYPE));
-      potarr = new float[ns];	// navigation potential array
+      potarr = new POTTYPE[ns];	// navigation potential array
       pending = new bool[ns];
       memset(pending, 0, ns*sizeof(bool));
-      gradx = new float[ns];
-      grady = new float[ns];
     }
 
 
@@ -227,62 +241,42 @@ namespace navfn {
   void
     NavFn::setCostmap(const COSTTYPE *cmap, bool isROS, bool allow_unknown)
     {
-      COSTTYPE *cm = costarr;
-      if (isROS)			// ROS-type cost array
+      // This transforms the incoming cost values:
+      // COST_OBS                 -> COST_OBS (incoming "lethal obstacle")
+      // COST_OBS_ROS             -> COST_OBS (incoming "inscribed inflated obstacle")
+      // values in range 0 to 252 -> values from COST_NEUTRAL to COST_OBS_ROS.
+      // It only depends on the value, so it is tabulated and the map is
+      // translated in one pass without branches.
+      COSTTYPE table[256];
+      for (int v=0; v<256; v++)
       {
-        for (int i=0; i<ny; i++)
+        table[v] = COST_OBS;
+        if (v < COST_OBS_ROS)
         {
-          int k=i*nx;
-          for (int j=0; j<nx; j++, k++, cmap++, cm++)
-          {
-            // This transforms the incoming cost values:
-            // COST_OBS                 -> COST_OBS (incoming "lethal obstacle")
-            // COST_OBS_ROS             -> COST_OBS (incoming "inscribed inflated obstacle")
-            // values in range 0 to 252 -> values from COST_NEUTRAL to COST_OBS_ROS.
-            *cm = COST_OBS;
-            int v = *cmap;
-            if (v < COST_OBS_ROS)
-            {
-              v = COST_NEUTRAL+COST_FACTOR*v;
-              if (v >= COST_OBS)
-                v = COST_OBS-1;
-              *cm = v;
-            }
-            else if(v == COST_UNKNOWN_ROS && allow_unknown)
-            {
-              v = COST_OBS-1;
-              *cm = v;
-            }
-          }
+          int c = COST_NEUTRAL+COST_FACTOR*v;
+          if (c >= COST_OBS)
+            c = COST_OBS-1;
+          table[v] = c;
         }
+        else if(v == COST_UNKNOWN_ROS && (allow_unknown || !isROS))
+          table[v] = COST_OBS-1;
       }
 
-      else				// not a ROS map, just a PGM
+      COSTTYPE *cm = costarr;
+      for (int k=0; k<ns; k++)
+        cm[k] = table[cmap[k]];
+
+      if (!isROS)			// not a ROS map, just a PGM
       {
         for (int i=0; i<ny; i++)
         {
           int k=i*nx;
-          for (int j=0; j<nx; j++, k++, cmap++, cm++)
+          for (int j=0; j<nx; j++, k++)
           {
-            *cm = COST_OBS;
             if (i<7 || i > ny-8 || j<7 || j > nx-8)
-              continue;	// don't do borders
-            int v = *cmap;
-            if (v < COST_OBS_ROS)
-            {
-              v = COST_NEUTRAL+COST_FACTOR*v;
-              if (v >= COST_OBS)
-                v = COST_OBS-1;
-              *cm = v;
-            }
-            else if(v == COST_UNKNOWN_ROS)
-            {
-              v = COST_OBS-1;
-              *cm = v;
-            }
+              cm[k] = COST_OBS;	// don't do borders
           }
         }
-
       }
     }
 
@@ -384,16 +378,33 @@ namespace navfn {
     }
 
 
-  // inserting onto the priority blocks
+  // inserting onto the priority blocks; a cell is in a block at most
+  // once, so a block never needs to grow beyond the size of the map
 #define push_cur(n)  { if (n>=0 && n<ns && !pending[n] && \
-    costarr[n]<COST_OBS && curPe<PRIORITYBUFSIZE) \
-  { curP[curPe++]=n; pending[n]=true; }}
+    costarr[n]<COST_OBS) \
+  { if (curPe == curPs) growBlock(curP, curPs); \
+    curP[curPe++]=n; pending[n]=true; }}
 #define push_next(n) { if (n>=0 && n<ns && !pending[n] && \
-    costarr[n]<COST_OBS && nextPe<PRIORITYBUFSIZE) \
-  { nextP[nextPe++]=n; pending[n]=true; }}
+    costarr[n]<COST_OBS) \
+  { if (nextPe == nextPs) growBlock(nextP, nextPs); \
+    nextP[nextPe++]=n; pending[n]=true; }}
 #define push_over(n) { if (n>=0 && n<ns && !pending[n] && \
-    costarr[n]<COST_OBS && overPe<PRIORITYBUFSIZE) \
-  { overP[overPe++]=n; pending[n]=true; }}
+    costarr[n]<COST_OBS) \
+  { if (overPe == overPs) growBlock(overP, overPs); \
+    overP[overPe++]=n; pending[n]=true; }}
+
+
+  // grow a priority block; the blocks keep their size from plan to plan
+
+  void
+    NavFn::growBlock(int *&block, int &size)
+    {
+      int *grown = new int[2*size];
+      memcpy(grown, block, size*sizeof(int));
+      delete[] block;
+      block = grown;
+      size *= 2;
+    }
 
 
   // Set up navigation potential arrays for new propagation
@@ -406,7 +417,6 @@ namespace navfn {
       {
         potarr[i] = POT_HIGH;
         if (!keepit) costarr[i] = COST_NEUTRAL;
-        gradx[i] = grady[i] = 0.0;
       }
 
       // outer bounds of cost array
@@ -425,12 +435,9 @@ namespace navfn {
         *pc = COST_OBS;
 
       // priority buffers
-      curT = COST_OBS;
-      curP = pb1; 
+      curT = COST_OBS*POT_SCALE;
       curPe = 0;
-      nextP = pb2;
       nextPe = 0;
-      overP = pb3;
       overPe = 0;
       memset(pending, 0, ns*sizeof(bool));
 
@@ -455,7 +462,7 @@ namespace navfn {
   void
     NavFn::initCost(int k, float v)
     {
-      potarr[k] = v;
+      potarr[k] = v*POT_SCALE;
       push_cur(k+1);
       push_cur(k-1);
       push_cur(k-nx);
@@ -473,11 +480,52 @@ namespace navfn {
 
 #define INVSQRT2 0.707106781
 
+  inline POTTYPE
+    NavFn::planarUpdate(POTTYPE ta, POTTYPE tc, COSTTYPE cost)
+    {
+#ifdef NAVFN_INT_POTENTIAL
+      POTTYPE hf = cost*POT_SCALE; // traversability factor
+#else
+      float hf = (float)cost;	// traversability factor
+#endif
+      POTTYPE dc = tc-ta;		// relative cost between ta,tc
+      if (dc < 0) 		// ta is lowest
+      {
+        dc = -dc;
+        ta = tc;
+      }
+
+      // calculate new potential
+      if (dc >= hf)		// if too large, use ta-only update
+        return ta+hf;
+
+      // two-neighbor interpolation update
+      // use quadratic approximation
+#ifdef NAVFN_INT_POTENTIAL
+      // from the table, hf*65536 fits
+      return ta + ((hf*quadTable[dc*QUAD_STEPS/hf]) >> 16);
+#else
+      float d = dc/hf;
+      float v = -0.2301*d*d + 0.5307*d + 0.7040;
+      return ta + hf*v;
+#endif
+    }
+
+  inline POTTYPE
+    NavFn::neighborMargin(COSTTYPE cost)
+    {
+#ifdef NAVFN_INT_POTENTIAL
+      return (cost*POT_SCALE*181) >> 8; // 181/256 is about INVSQRT2
+#else
+      return INVSQRT2*(float)cost;
+#endif
+    }
+
   inline void
     NavFn::updateCell(int n)
     {
       // get neighbors
-      float u,d,l,r;
+      POTTYPE u,d,l,r;
       l = potarr[n-1];
       r = potarr[n+1];		
       u = potarr[n-nx];
@@ -487,44 +535,25 @@ namespace navfn {
       //  ROS_INFO("[Update] cost: %d\n", costarr[n]);
 
       // find lowest, and its lowest neighbor
-      float ta, tc;
+      POTTYPE ta, tc;
       if (l<r) tc=l; else tc=r;
       if (u<d) ta=u; else ta=d;
 
       // do planar wave update
       if (costarr[n] < COST_OBS)	// don't propagate into obstacles
       {
-        float hf = (float)costarr[n]; // traversability factor
-        float dc = tc-ta;		// relative cost between ta,tc
-        if (dc < 0) 		// ta is lowest
-        {
-          dc = -dc;
-          ta = tc;
-        }
-
         // calculate new potential
-        float pot;
-        if (dc >= hf)		// if too large, use ta-only update
-          pot = ta+hf;
-        else			// two-neighbor interpolation update
-        {
-          // use quadratic approximation
-          // might speed this up through table lookup, but still have to 
-          //   do the divide
-          float d = dc/hf;
-          float v = -0.2301*d*d + 0.5307*d + 0.7040;
-          pot = ta + hf*v;
-        }
+        POTTYPE pot = planarUpdate(ta, tc, costarr[n]);
 
         //      ROS_INFO("[Update] new pot: %d\n", costarr[n]);
 
         // now add affected neighbors to priority blocks
         if (pot < potarr[n])
         {
-          float le = INVSQRT2*(float)costarr[n-1];
-          float re = INVSQRT2*(float)costarr[n+1];
-          float ue = INVSQRT2*(float)costarr[n-nx];
-          float de = INVSQRT2*(float)costarr[n+nx];
+          POTTYPE le = neighborMargin(costarr[n-1]);
+          POTTYPE re = neighborMargin(costarr[n+1]);
+          POTTYPE ue = neighborMargin(costarr[n-nx]);
+          POTTYPE de = neighborMargin(costarr[n+nx]);
           potarr[n] = pot;
           if (pot < curT)	// low-cost buffer block 
           {
@@ -562,7 +591,7 @@ namespace navfn {
     NavFn::updateCellAstar(int n)
     {
       // get neighbors
-      float u,d,l,r;
+      POTTYPE u,d,l,r;
       l = potarr[n-1];
       r = potarr[n+1];		
       u = potarr[n-nx];
@@ -572,49 +601,30 @@ namespace navfn {
       // ROS_INFO("[Update] cost of %d: %d\n", n, costarr[n]);
 
       // find lowest, and its lowest neighbor
-      float ta, tc;
+      POTTYPE ta, tc;
       if (l<r) tc=l; else tc=r;
       if (u<d) ta=u; else ta=d;
 
       // do planar wave update
       if (costarr[n] < COST_OBS)	// don't propagate into obstacles
       {
-        float hf = (float)costarr[n]; // traversability factor
-        float dc = tc-ta;		// relative cost between ta,tc
-        if (dc < 0) 		// ta is lowest
-        {
-          dc = -dc;
-          ta = tc;
-        }
-
         // calculate new potential
-        float pot;
-        if (dc >= hf)		// if too large, use ta-only update
-          pot = ta+hf;
-        else			// two-neighbor interpolation update
-        {
-          // use quadratic approximation
-          // might speed this up through table lookup, but still have to 
-          //   do the divide
-          float d = dc/hf;
-          float v = -0.2301*d*d + 0.5307*d + 0.7040;
-          pot = ta + hf*v;
-        }
+        POTTYPE pot = planarUpdate(ta, tc, costarr[n]);
 
         //ROS_INFO("[Update] new pot: %d\n", costarr[n]);
 
         // now add affected neighbors to priority blocks
         if (pot < potarr[n])
         {
-          float le = INVSQRT2*(float)costarr[n-1];
-          float re = INVSQRT2*(float)costarr[n+1];
-          float ue = INVSQRT2*(float)costarr[n-nx];
-          float de = INVSQRT2*(float)costarr[n+nx];
+          POTTYPE le = neighborMargin(costarr[n-1]);
+          POTTYPE re = neighborMargin(costarr[n+1]);
+          POTTYPE ue = neighborMargin(costarr[n-nx]);
+          POTTYPE de = neighborMargin(costarr[n+nx]);
 
           // calculate distance
           int x = n%nx;
           int y = n/nx;
-          float dist = hypot(x-start[0], y-start[1])*(float)COST_NEUTRAL;
+          POTTYPE dist = hypot(x-start[0], y-start[1])*(float)(COST_NEUTRAL*POT_SCALE);
 
           potarr[n] = pot;
           pot += dist;
@@ -655,8 +665,9 @@ namespace navfn {
       int nc = 0;			// number of cells put into priority blocks
       int cycle = 0;		// which cycle we're on
 
-      // set up start cell
-      int startCell = start[1]*nx + start[0];
+      // set up the stop region
+      int stopNext = 0;		// cells of the region known to have a potential
+      POTTYPE stopT = POT_HIGH;	// threshold to stop at, once the region is reached
 
       for (; cycle < cycles; cycle++) // go for this many cycles, unless interrupted
       {
@@ -690,24 +701,36 @@ namespace navfn {
         pb = curP;		// swap buffers
         curP = nextP;
         nextP = pb;
+        i = curPs;
+        curPs = nextPs;
+        nextPs = i;
 
         // see if we're done with this priority level
         if (curPe == 0)
         {
-          curT += priInc;	// increment priority threshold
+          curT += priInc*POT_SCALE;	// increment priority threshold
           curPe = overPe;	// set current to overflow block
           overPe = 0;
           pb = curP;		// swap buffers
           curP = overP;
           overP = pb;
+          i = curPs;
+          curPs = overPs;
+          overPs = i;
         }
 
-        // check if we've hit the Start cell
+        // check if we've hit the Start cell, or the whole stop region, and
+        // gone on for the margin beyond it
         if (atStart)
-          if (potarr[startCell] < POT_HIGH)
+        {
+          if (stopT >= POT_HIGH && stopRegionReached(stopNext))
+            stopT = curT + stopMargin*POT_SCALE;
+          if (curT >= stopT)
             break;
+        }
       }
 
+      ncells = nc;
       ROS_DEBUG("[NavFn] Used %d cycles, %d cells visited (%d%%), priority buf max %d\n", 
           cycle,nc,(int)((nc*100.0)/(ns-nobs)),nwv);
 
@@ -716,6 +739,27 @@ namespace navfn {
     }
 
 
+  // cells that have a potential keep it, so the region is only scanned
+  // once over all of the calls of a propagation
+
+  bool
+    NavFn::stopRegionReached(int &next)
+    {
+      if (stopX0 < 0)
+        return potarr[start[1]*nx + start[0]] < POT_HIGH;
+
+      int w = stopX1 - stopX0 + 1;
+      int count = w * (stopY1 - stopY0 + 1);
+      for (; next < count; next++)
+      {
+        int n = (stopY0 + next/w)*nx + stopX0 + next%w;
+        if (costarr[n] < COST_OBS && potarr[n] >= POT_HIGH)
+          return false;
+      }
+      return true;
+    }
+
+
   //
   // main propagation function
   // A* method, best-first
@@ -733,7 +777,7 @@ namespace navfn {
       int cycle = 0;		// which cycle we're on
 
       // set initial threshold, based on distance
-      float dist = hypot(goal[0]-start[0], goal[1]-start[1])*(float)COST_NEUTRAL;
+      POTTYPE dist = hypot(goal[0]-start[0], goal[1]-start[1])*(float)(COST_NEUTRAL*POT_SCALE);
       curT = dist + curT;
 
       // set up start cell
@@ -772,16 +816,22 @@ namespace navfn {
         pb = curP;		// swap buffers
         curP = nextP;
         nextP = pb;
+        i = curPs;
+        curPs = nextPs;
+        nextPs = i;
 
         // see if we're done with this priority level
         if (curPe == 0)
         {
-          curT += priInc;	// increment priority threshold
+          curT += priInc*POT_SCALE;	// increment priority threshold
           curPe = overPe;	// set current to overflow block
           overPe = 0;
           pb = curP;		// swap buffers
           curP = overP;
           overP = pb;
+          i = curPs;
+          curPs = overPs;
+          overPs = i;
         }
 
         // check if we've hit the Start cell
@@ -790,8 +840,9 @@ namespace navfn {
 
       }
 
-      last_path_cost_ = potarr[startCell];
+      last_path_cost_ = (float)potarr[startCell]/POT_SCALE;
 
+      ncells = nc;
       ROS_DEBUG("[NavFn] Used %d cycles, %d cells visited (%d%%), priority buf max %d\n", 
           cycle,nc,(int)((nc*100.0)/(ns-nobs)),nwv);
 
@@ -849,7 +900,7 @@ namespace navfn {
       {
         // check if near goal
         int nearest_point=std::max(0,std::min(nx*ny-1,stc+(int)round(dx)+(int)(nx*round(dy))));
-        if (potarr[nearest_point] < COST_NEUTRAL)
+        if (potarr[nearest_point] < COST_NEUTRAL*POT_SCALE)
         {
           pathx[npath] = (float)goal[0];
           pathy[npath] = (float)goal[1];
@@ -891,7 +942,7 @@ namespace navfn {
             potarr[stcpx-1] >= POT_HIGH ||
             oscillation_detected)
         {
-          ROS_DEBUG("[Path] Pot fn boundary, following grid (%0.1f/%d)", potarr[stc], npath);
+          ROS_DEBUG("[Path] Pot fn boundary, following grid (%0.1f/%d)", (float)potarr[stc], npath);
           // check eight neighbors to find the lowest
           int minc = stc;
           int minp = potarr[stc];
@@ -916,7 +967,7 @@ namespace navfn {
           dy = 0;
 
           ROS_DEBUG("[Path] Pot: %0.1f  pos: %0.1f,%0.1f",
-              potarr[stc], pathx[npath-1], pathy[npath-1]);
+              (float)potarr[stc], pathx[npath-1], pathy[npath-1]);
 
           if (potarr[stc] >= POT_HIGH)
           {
@@ -930,26 +981,26 @@ namespace navfn {
         else			
         {
 
-          // get grad at four positions near cell
-          gradCell(stc);
-          gradCell(stc+1);
-          gradCell(stcnx);
-          gradCell(stcnx+1);
+          // get grad at four positions near cell, they are only ever
+          // needed along the path, so aren't kept for the whole map
+          float gx[4], gy[4];
+          gradCell(stc, gx[0], gy[0]);
+          gradCell(stc+1, gx[1], gy[1]);
+          gradCell(stcnx, gx[2], gy[2]);
+          gradCell(stcnx+1, gx[3], gy[3]);
 
 
           // get interpolated gradient
-          float x1 = (1.0-dx)*gradx[stc] + dx*gradx[stc+1];
-          float x2 = (1.0-dx)*gradx[stcnx] + dx*gradx[stcnx+1];
+          float x1 = (1.0-dx)*gx[0] + dx*gx[1];
+          float x2 = (1.0-dx)*gx[2] + dx*gx[3];
           float x = (1.0-dy)*x1 + dy*x2; // interpolated x
-          float y1 = (1.0-dx)*grady[stc] + dx*grady[stc+1];
-          float y2 = (1.0-dx)*grady[stcnx] + dx*grady[stcnx+1];
+          float y1 = (1.0-dx)*gy[0] + dx*gy[1];
+          float y2 = (1.0-dx)*gy[2] + dx*gy[3];
           float y = (1.0-dy)*y1 + dy*y2; // interpolated y
 
           // show gradients
           ROS_DEBUG("[Path] %0.2f,%0.2f  %0.2f,%0.2f  %0.2f,%0.2f  %0.2f,%0.2f; final x=%.3f, y=%.3f\n",
-                    gradx[stc], grady[stc], gradx[stc+1], grady[stc+1], 
-                    gradx[stcnx], grady[stcnx], gradx[stcnx+1], grady[stcnx+1],
-                    x, y);
+                    gx[0], gy[0], gx[1], gy[1], gx[2], gy[2], gx[3], gy[3], x, y);
 
           // check for zero gradient, failed
           if (x == 0.0 && y == 0.0)
@@ -989,15 +1040,13 @@ namespace navfn {
   // calculate gradient at a cell
   // positive value are to the right and down
   float				
-    NavFn::gradCell(int n)
+    NavFn::gradCell(int n, float &gx, float &gy)
     {
-      if (gradx[n]+grady[n] > 0.0)	// check this cell
-        return 1.0;			
-
+      gx = gy = 0.0;
       if (n < nx || n > ns-nx)	// would be out of bounds
         return 0.0;
 
-      float cv = potarr[n];
+      POTTYPE cv = potarr[n];
       float dx = 0.0;
       float dy = 0.0;
 
@@ -1035,8 +1084,8 @@ namespace navfn {
       if (norm > 0)
       {
         norm = 1.0/norm;
-        gradx[n] = norm*dx;
-        grady[n] = norm*dy;
+        gx = norm*dx;
+        gy = norm*dy;
       }
       return norm;
     }
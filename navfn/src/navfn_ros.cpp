@@ -39,6 +39,8 @@
 #include <tf/transform_listener.h>
 #include <costmap_2d/cost_values.h>
 #include <costmap_2d/costmap_2d.h>
+#include <nav_trace/trace.h>
+#include <algorithm>
 
 #include <pcl_conversions/pcl_conversions.h>
 
@@ -48,18 +50,37 @@ PLUGINLIB_DECLARE_CLASS(navfn, NavfnROS, navfn::NavfnROS, nav_core::BaseGlobalPl
 namespace navfn {
 
   NavfnROS::NavfnROS() 
-    : costmap_ros_(NULL),  planner_(), initialized_(false), allow_unknown_(true) {}
+    : costmap_ros_(NULL), costmap_(NULL), planner_(), initialized_(false), allow_unknown_(true), service_worker_(false) {}
 
   NavfnROS::NavfnROS(std::string name, costmap_2d::Costmap2DROS* costmap_ros) 
-    : costmap_ros_(NULL),  planner_(), initialized_(false), allow_unknown_(true) {
+    : costmap_ros_(NULL), costmap_(NULL), planner_(), initialized_(false), allow_unknown_(true), service_worker_(false) {
       //initialize the planner
       initialize(name, costmap_ros);
   }
 
+  NavfnROS::NavfnROS(std::string name, costmap_2d::Costmap2D* costmap, std::string global_frame) 
+    : costmap_ros_(NULL), costmap_(NULL), planner_(), initialized_(false), allow_unknown_(true), service_worker_(false) {
+      //initialize the planner
+      initialize(name, costmap, global_frame);
+  }
+
+  NavfnROS::~NavfnROS(){
+    //no service call may still be using the planner once it is gone
+    if(service_spinner_)
+      service_spinner_->stop();
+    potential_publisher_.reset();
+  }
+
   void NavfnROS::initialize(std::string name, costmap_2d::Costmap2DROS* costmap_ros){
-    if(!initialized_){
+    if(!initialized_)
       costmap_ros_ = costmap_ros;
-      costmap_2d::Costmap2D* costmap = costmap_ros_->getCostmap();
+    initialize(name, costmap_ros->getCostmap(), costmap_ros->getGlobalFrameID());
+  }
+
+  void NavfnROS::initialize(std::string name, costmap_2d::Costmap2D* costmap, std::string global_frame){
+    if(!initialized_){
+      costmap_ = costmap;
+      global_frame_ = global_frame;
       planner_ = boost::shared_ptr<NavFn>(new NavFn(costmap->getSizeInCellsX(), costmap->getSizeInCellsY()));
 
       ros::NodeHandle private_nh("~/" + name);
@@ -69,26 +90,120 @@ namespace navfn {
       private_nh.param("visualize_potential", visualize_potential_, false);
 
       //if we're going to visualize the potential array we need to advertise
-      if(visualize_potential_)
+      if(visualize_potential_){
         potarr_pub_.advertise(private_nh, "potential", 1);
+        double potential_rate;
+        private_nh.param("potential_publish_rate", potential_rate, 0.0);
+        potential_publisher_.reset(new PotentialPublisher(
+            boost::bind(&NavfnROS::publishPotential, this, _1), potential_rate));
+      }
 
       private_nh.param("allow_unknown", allow_unknown_, true);
       private_nh.param("planner_window_x", planner_window_x_, 0.0);
       private_nh.param("planner_window_y", planner_window_y_, 0.0);
       private_nh.param("default_tolerance", default_tolerance_, 0.0);
+      private_nh.param("stop_margin", stop_margin_, 0.0);
+      private_nh.param("corridor_width", corridor_width_, 1.0);
 
       //get the tf prefix
       ros::NodeHandle prefix_nh;
       tf_prefix_ = tf::getPrefixParam(prefix_nh);
 
-      make_plan_srv_ =  private_nh.advertiseService("make_plan", &NavfnROS::makePlanService, this);
-
       initialized_ = true;
+
+      //a planner of the service calls only plans, the one it works for takes the calls
+      if(service_worker_)
+        return;
+
+      //the make_plan calls are planned on a copy of the costmap with a planner of their own, on threads of
+      //their own, so that they don't wait for the plans of the robot or hold them up
+      {
+        boost::shared_lock<boost::shared_mutex> lock(*(costmap->getLock()));
+        service_costmap_ = *costmap;
+      }
+      service_planner_.reset(new NavfnROS());
+      service_planner_->service_worker_ = true;
+      service_planner_->initialize(name, &service_costmap_, global_frame);
+      plan_requests_.reset(new PlanRequests(boost::bind(&NavfnROS::makeServicePlan, this, _1, _2, _3)));
+
+      int service_threads;
+      private_nh.param("service_threads", service_threads, 4);
+      ros::AdvertiseServiceOptions make_plan_ops = ros::AdvertiseServiceOptions::create<nav_msgs::GetPlan>(
+          "make_plan", boost::bind(&NavfnROS::makePlanService, this, _1, _2), ros::VoidPtr(), &service_queue_);
+      make_plan_srv_ = private_nh.advertiseService(make_plan_ops);
+      service_spinner_.reset(new ros::AsyncSpinner(std::max(service_threads, 1), &service_queue_));
+      service_spinner_->start();
+
+      make_plans_srv_ =  private_nh.advertiseService("make_plans", &NavfnROS::makePlansService, this);
+
+      corridor_sub_ = private_nh.subscribe("corridor", 1, &NavfnROS::corridorCB, this);
+      corridor_polygon_sub_ = private_nh.subscribe("corridor_polygon", 1, &NavfnROS::corridorPolygonCB, this);
     }
     else
       ROS_WARN("This planner has already been initialized, you can't call it twice, doing nothing");
   }
 
+  void NavfnROS::setCorridor(const std::vector<geometry_msgs::Point>& waypoints, double width){
+    boost::mutex::scoped_lock lock(mutex_);
+    corridor_.setWaypoints(waypoints, width);
+  }
+
+  void NavfnROS::setCorridorPolygon(const std::vector<geometry_msgs::Point>& polygon){
+    boost::mutex::scoped_lock lock(mutex_);
+    corridor_.setPolygon(polygon);
+  }
+
+  void NavfnROS::clearCorridor(){
+    boost::mutex::scoped_lock lock(mutex_);
+    corridor_.clear();
+  }
+
+  void NavfnROS::corridorCB(const nav_msgs::Path::ConstPtr& path){
+    std::string global_frame = global_frame_;
+    if(!path->poses.empty() && tf::resolve(tf_prefix_, path->header.frame_id) != tf::resolve(tf_prefix_, global_frame)){
+      ROS_WARN("The corridor passed to this planner must be in the %s frame.  It is instead in the %s frame.", 
+               tf::resolve(tf_prefix_, global_frame).c_str(), tf::resolve(tf_prefix_, path->header.frame_id).c_str());
+      return;
+    }
+
+    //an empty path lifts the corridor
+    std::vector<geometry_msgs::Point> waypoints(path->poses.size());
+    for(unsigned int i = 0; i < path->poses.size(); i++)
+      waypoints[i] = path->poses[i].pose.position;
+    setCorridor(waypoints, corridor_width_);
+  }
+
+  void NavfnROS::corridorPolygonCB(const geometry_msgs::PolygonStamped::ConstPtr& polygon){
+    std::string global_frame = global_frame_;
+    if(!polygon->polygon.points.empty() && tf::resolve(tf_prefix_, polygon->header.frame_id) != tf::resolve(tf_prefix_, global_frame)){
+      ROS_WARN("The corridor passed to this planner must be in the %s frame.  It is instead in the %s frame.", 
+               tf::resolve(tf_prefix_, global_frame).c_str(), tf::resolve(tf_prefix_, polygon->header.frame_id).c_str());
+      return;
+    }
+
+    std::vector<geometry_msgs::Point> points(polygon->polygon.points.size());
+    for(unsigned int i = 0; i < points.size(); i++){
+      points[i].x = polygon->polygon.points[i].x;
+      points[i].y = polygon->polygon.points[i].y;
+    }
+    setCorridorPolygon(points);
+  }
+
+  void NavfnROS::maskCorridor(const costmap_2d::Costmap2D& costmap){
+    corridor_.getSpans(costmap, corridor_spans_);
+    corridor_costs_.assign(planner_->ns, COST_OBS);
+    for(unsigned int k = 0; k < corridor_spans_.size(); k += 3){
+      int row = corridor_spans_[k] * planner_->nx;
+      std::copy(planner_->costarr + row + corridor_spans_[k + 1], planner_->costarr + row + corridor_spans_[k + 2],
+                corridor_costs_.begin() + row + corridor_spans_[k + 1]);
+    }
+    std::swap_ranges(planner_->costarr, planner_->costarr + planner_->ns, corridor_costs_.begin());
+  }
+
+  void NavfnROS::unmaskCorridor(){
+    std::swap_ranges(planner_->costarr, planner_->costarr + planner_->ns, corridor_costs_.begin());
+  }
+
   bool NavfnROS::validPointPotential(const geometry_msgs::Point& world_point){
     return validPointPotential(world_point, default_tolerance_);
   }
@@ -99,7 +214,7 @@ namespace navfn {
       return false;
     }
 
-    double resolution = costmap_ros_->getCostmap()->getResolution();
+    double resolution = costmap_->getResolution();
     geometry_msgs::Point p;
     p = world_point;
 
@@ -127,11 +242,15 @@ namespace navfn {
     }
 
     unsigned int mx, my;
-    if(!costmap_ros_->getCostmap()->worldToMap(world_point.x, world_point.y, mx, my))
+    if(!costmap_->worldToMap(world_point.x, world_point.y, mx, my))
       return DBL_MAX;
 
+    //in costs, whatever the planner keeps its potentials in
     unsigned int index = my * planner_->nx + mx;
-    return planner_->potarr[index];
+    POTTYPE potential = planner_->potarr[index];
+    if(potential >= POT_HIGH)
+      return POT_HIGH;
+    return (double)potential / POT_SCALE;
   }
 
   bool NavfnROS::computePotential(const geometry_msgs::Point& world_point){
@@ -140,7 +259,7 @@ namespace navfn {
       return false;
     }
     
-    costmap_2d::Costmap2D* costmap = costmap_ros_->getCostmap();
+    costmap_2d::Costmap2D* costmap = costmap_;
 
     //make sure to resize the underlying array that Navfn uses
     planner_->setNavArr(costmap->getSizeInCellsX(), costmap->getSizeInCellsY());
@@ -161,7 +280,10 @@ namespace navfn {
     planner_->setStart(map_start);
     planner_->setGoal(map_goal);
 
-    return planner_->calcNavFnDijkstra();
+    //only the propagation, there is no path to look for, and a
+    //failed one from the corner start would be reported as failure
+    planner_->setupNavFn(true);
+    return planner_->propNavFnDijkstra(std::max(planner_->nx*planner_->ny/20, planner_->nx+planner_->ny));
   }
 
   void NavfnROS::clearRobotCell(const tf::Stamped<tf::Pose>& global_pose, unsigned int mx, unsigned int my){
@@ -171,20 +293,94 @@ namespace navfn {
     }
 
     //set the associated costs in the cost map to be free
-    costmap_ros_->getCostmap()->setCost(mx, my, costmap_2d::FREE_SPACE);
+    costmap_->setCost(mx, my, costmap_2d::FREE_SPACE);
   }
 
   bool NavfnROS::makePlanService(nav_msgs::GetPlan::Request& req, nav_msgs::GetPlan::Response& resp){
-    makePlan(req.start, req.goal, resp.plan.poses);
+    plan_requests_->makePlan(req.start, req.goal, resp.plan.poses);
 
     resp.plan.header.stamp = ros::Time::now();
-    resp.plan.header.frame_id = costmap_ros_->getGlobalFrameID();
+    resp.plan.header.frame_id = global_frame_;
 
     return true;
   } 
 
+  bool NavfnROS::makePlansService(MakeNavPlans::Request& req, MakeNavPlans::Response& resp){
+    std::vector<std::vector<geometry_msgs::PoseStamped> > plans;
+    makePlans(req.start, req.goals, resp.costs, req.compute_paths ? &plans : NULL);
+
+    resp.plans.resize(plans.size());
+    for(unsigned int i = 0; i < plans.size(); ++i){
+      resp.plans[i].header.stamp = ros::Time::now();
+      resp.plans[i].header.frame_id = global_frame_;
+      resp.plans[i].poses.swap(plans[i]);
+    }
+
+    return true;
+  }
+
+  bool NavfnROS::makeServicePlan(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal,
+      std::vector<geometry_msgs::PoseStamped>& plan){
+    {
+      boost::shared_lock<boost::shared_mutex> lock(*(costmap_->getLock()));
+      service_costmap_ = *costmap_;
+    }
+    return service_planner_->makePlan(start, goal, plan);
+  }
+
+  bool NavfnROS::makePlans(const geometry_msgs::PoseStamped& start, const std::vector<geometry_msgs::PoseStamped>& goals,
+      std::vector<double>& costs, std::vector<std::vector<geometry_msgs::PoseStamped> >* plans){
+    boost::mutex::scoped_lock lock(mutex_);
+    costs.assign(goals.size(), -1.0);
+    if(plans)
+      plans->assign(goals.size(), std::vector<geometry_msgs::PoseStamped>());
+
+    if(!initialized_){
+      ROS_ERROR("This planner has not been initialized yet, but it is being used, please call initialize() before use");
+      return false;
+    }
+
+    std::string global_frame = global_frame_;
+    if(tf::resolve(tf_prefix_, start.header.frame_id) != tf::resolve(tf_prefix_, global_frame)){
+      ROS_ERROR("The start pose passed to this planner must be in the %s frame.  It is instead in the %s frame.", 
+                tf::resolve(tf_prefix_, global_frame).c_str(), tf::resolve(tf_prefix_, start.header.frame_id).c_str());
+      return false;
+    }
+
+    unsigned int mx, my;
+    if(!costmap_->worldToMap(start.pose.position.x, start.pose.position.y, mx, my)){
+      ROS_WARN("The robot's start position is off the global costmap. Planning will always fail, are you sure the robot has been properly localized?");
+      return false;
+    }
+
+    //one expansion over the whole map from the start serves all of the goals
+    tf::Stamped<tf::Pose> start_pose;
+    tf::poseStampedMsgToTF(start, start_pose);
+    clearRobotCell(start_pose, mx, my);
+    if(!computePotential(start.pose.position))
+      return false;
+
+    for(unsigned int i = 0; i < goals.size(); ++i){
+      if(tf::resolve(tf_prefix_, goals[i].header.frame_id) != tf::resolve(tf_prefix_, global_frame))
+        continue;
+
+      double potential = getPointPotential(goals[i].pose.position);
+      if(potential >= POT_HIGH)
+        continue;
+      costs[i] = potential;
+
+      if(plans && getPlanFromPotential(goals[i], (*plans)[i])){
+        geometry_msgs::PoseStamped goal_copy = goals[i];
+        goal_copy.header.stamp = ros::Time::now();
+        (*plans)[i].push_back(goal_copy);
+      }
+    }
+
+    return true;
+  }
+
   void NavfnROS::mapToWorld(double mx, double my, double& wx, double& wy) {
-    costmap_2d::Costmap2D* costmap = costmap_ros_->getCostmap();
+    costmap_2d::Costmap2D* costmap = costmap_;
     wx = costmap->getOriginX() + mx * costmap->getResolution();
     wy = costmap->getOriginY() + my * costmap->getResolution();
   }
@@ -196,6 +392,7 @@ namespace navfn {
 
   bool NavfnROS::makePlan(const geometry_msgs::PoseStamped& start, 
       const geometry_msgs::PoseStamped& goal, double tolerance, std::vector<geometry_msgs::PoseStamped>& plan){
+    NAV_TRACE_SCOPE("NavfnROS::makePlan");
     boost::mutex::scoped_lock lock(mutex_);
     if(!initialized_){
       ROS_ERROR("This planner has not been initialized yet, but it is being used, please call initialize() before use");
@@ -206,8 +403,8 @@ namespace navfn {
     plan.clear();
 
     ros::NodeHandle n;
-    costmap_2d::Costmap2D* costmap = costmap_ros_->getCostmap();
-    std::string global_frame = costmap_ros_->getGlobalFrameID();
+    costmap_2d::Costmap2D* costmap = costmap_;
+    std::string global_frame = global_frame_;
 
     //until tf can handle transforming things that are way in the past... we'll require the goal to be in our global frame
     if(tf::resolve(tf_prefix_, goal.header.frame_id) != tf::resolve(tf_prefix_, global_frame)){
@@ -281,31 +478,52 @@ namespace navfn {
     planner_->setStart(map_goal);
     planner_->setGoal(map_start);
 
-    //bool success = planner_->calcNavFnAstar();
-    planner_->calcNavFnDijkstra(true);
+    //the propagation stops once every cell the tolerance search looks at has been reached, or found blocked
+    int x0 = map_goal[0], y0 = map_goal[1], x1 = map_goal[0], y1 = map_goal[1];
+    if(tolerance > 0.0){
+      costmap->worldToMapEnforceBounds(goal.pose.position.x - tolerance, goal.pose.position.y - tolerance, x0, y0);
+      costmap->worldToMapEnforceBounds(goal.pose.position.x + tolerance, goal.pose.position.y + tolerance, x1, y1);
+    }
+    planner_->setStopRegion(x0, y0, x1, y1, stop_margin_);
+
+    //search within the corridor first, and over the whole costmap if there is no plan in it
+    bool in_corridor = !corridor_.empty();
+    if(in_corridor)
+      maskCorridor(*costmap);
 
     double resolution = costmap->getResolution();
     geometry_msgs::PoseStamped p, best_pose;
-    p = goal;
 
     bool found_legal = false;
-    double best_sdist = DBL_MAX;
-
-    p.pose.position.y = goal.pose.position.y - tolerance;
-
-    while(p.pose.position.y <= goal.pose.position.y + tolerance){
-      p.pose.position.x = goal.pose.position.x - tolerance;
-      while(p.pose.position.x <= goal.pose.position.x + tolerance){
-        double potential = getPointPotential(p.pose.position);
-        double sdist = sq_distance(p, goal);
-        if(potential < POT_HIGH && sdist < best_sdist){
-          best_sdist = sdist;
-          best_pose = p;
-          found_legal = true;
+    while(true){
+      //bool success = planner_->calcNavFnAstar();
+      planner_->calcNavFnDijkstra(true);
+
+      p = goal;
+      double best_sdist = DBL_MAX;
+
+      p.pose.position.y = goal.pose.position.y - tolerance;
+
+      while(p.pose.position.y <= goal.pose.position.y + tolerance){
+        p.pose.position.x = goal.pose.position.x - tolerance;
+        while(p.pose.position.x <= goal.pose.position.x + tolerance){
+          double potential = getPointPotential(p.pose.position);
+          double sdist = sq_distance(p, goal);
+          if(potential < POT_HIGH && sdist < best_sdist){
+            best_sdist = sdist;
+            best_pose = p;
+            found_legal = true;
+          }
+          p.pose.position.x += resolution;
         }
-        p.pose.position.x += resolution;
+        p.pose.position.y += resolution;
       }
-      p.pose.position.y += resolution;
+
+      if(found_legal || !in_corridor)
+        break;
+      ROS_DEBUG("No plan within the corridor, planning over the whole costmap");
+      unmaskCorridor();
+      in_corridor = false;
     }
 
     if(found_legal){
@@ -321,32 +539,12 @@ namespace navfn {
       }
     }
 
-    if (visualize_potential_){
-      //publish potential array
-      pcl::PointCloud<PotarrPoint> pot_area;
-      pot_area.header.frame_id = global_frame;
-      pot_area.points.clear();
-      std_msgs::Header header;
-      pcl_conversions::fromPCL(pot_area.header, header);
-      header.stamp = ros::Time::now();
-      pot_area.header = pcl_conversions::toPCL(header);
-
-      PotarrPoint pt;
-      float *pp = planner_->potarr;
-      double pot_x, pot_y;
-      for (unsigned int i = 0; i < (unsigned int)planner_->ny*planner_->nx ; i++)
-      {
-        if (pp[i] < 10e7)
-        {
-          mapToWorld(i%planner_->nx, i/planner_->nx, pot_x, pot_y);
-          pt.x = pot_x;
-          pt.y = pot_y;
-          pt.z = pp[i]/pp[planner_->start[1]*planner_->nx + planner_->start[0]]*20;
-          pt.pot_value = pp[i];
-          pot_area.push_back(pt);
-        }
-      }
-      potarr_pub_.publish(pot_area);
+    //the cloud is built on the thread of the publisher, only when someone is listening
+    if(visualize_potential_ && potarr_pub_.getNumSubscribers() > 0){
+      POTTYPE *pp = planner_->potarr;
+      potential_publisher_->post(pp, planner_->nx, planner_->ny, (POTTYPE)POT_HIGH,
+          (float)pp[planner_->start[1]*planner_->nx + planner_->start[0]], costmap->getOriginX(),
+          costmap->getOriginY(), costmap->getResolution(), global_frame);
     }
 
     //publish the plan for visualization purposes
@@ -355,6 +553,29 @@ namespace navfn {
     return !plan.empty();
   }
 
+  void NavfnROS::publishPotential(const PotentialPublisher::Potential& potential){
+    pcl::PointCloud<PotarrPoint> pot_area;
+    pot_area.header.frame_id = potential.frame_id;
+    std_msgs::Header header;
+    pcl_conversions::fromPCL(pot_area.header, header);
+    header.stamp = potential.stamp;
+    pot_area.header = pcl_conversions::toPCL(header);
+
+    PotarrPoint pt;
+    for(int y = potential.y0; y <= potential.y1; y++)
+      for(int x = potential.x0; x <= potential.x1; x++){
+        float pot = potential.at(x, y);
+        if(pot < 0.0)
+          continue;
+        pt.x = potential.origin_x + x * potential.resolution;
+        pt.y = potential.origin_y + y * potential.resolution;
+        pt.z = pot / potential.reference * 20;
+        pt.pot_value = pot / POT_SCALE;
+        pot_area.push_back(pt);
+      }
+    potarr_pub_.publish(pot_area);
+  }
+
   void NavfnROS::publishPlan(const std::vector<geometry_msgs::PoseStamped>& path, double r, double g, double b, double a){
     if(!initialized_){
       ROS_ERROR("This planner has not been initialized yet, but it is being used, please call initialize() before use");
@@ -385,8 +606,8 @@ namespace navfn {
       return false;
     }
     
-    costmap_2d::Costmap2D* costmap = costmap_ros_->getCostmap();
-    std::string global_frame = costmap_ros_->getGlobalFrameID();
+    costmap_2d::Costmap2D* costmap = costmap_;
+    std::string global_frame = global_frame_;
 
     //clear the plan, just in case
     plan.clear();
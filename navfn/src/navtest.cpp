@@ -211,7 +211,7 @@ int main(int argc, char **argv)
 
   // draw potential field
   float mmax = 0.0;
-  float *pp = nav->potarr;
+  POTTYPE *pp = nav->potarr;
   int ntot = 0;
   for (int i=0; i<nav->ny*nav->nx; i++, pp++)
     {
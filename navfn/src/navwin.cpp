@@ -29,7 +29,7 @@ NavWin::~NavWin()
 void
 NavWin::drawPot(NavFn *nav)
 {
-  float *pot = nav->potarr;
+  POTTYPE *pot = nav->potarr;
   COSTTYPE *cst = nav->costarr;
   int width = nav->nx;
   int height = nav->ny;
@@ -65,7 +65,7 @@ NavWin::drawPot(NavFn *nav)
       // draw potential
       for (int i=0; i<height-dec+1; i+=dec)
 	{
-	  float *pp = pot + i*width;
+	  POTTYPE *pp = pot + i*width;
 	  uchar *ii = im + 3*i/dec * nw;
 	  for (int j=0; j<width-dec+1; j+=dec, pp+=dec)
 	    {
@@ -117,7 +117,7 @@ NavWin::drawPot(NavFn *nav)
 
       for (int i=0; i<height; i++)
 	{
-	  float *pp = pot + i*width;
+	  POTTYPE *pp = pot + i*width;
 	  uchar *ii = im + 3*i*inc * nw;
 	  for (int j=0; j<width; j++, pp++)
 	    {
@@ -0,0 +1,103 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*
+*********************************************************************/
+#include <navfn/plan_requests.h>
+#include <ros/console.h>
+
+namespace navfn {
+
+  static bool samePose(const geometry_msgs::PoseStamped& a, const geometry_msgs::PoseStamped& b){
+    return a.header.frame_id == b.header.frame_id && a.pose.position.x == b.pose.position.x
+      && a.pose.position.y == b.pose.position.y && a.pose.position.z == b.pose.position.z
+      && a.pose.orientation.x == b.pose.orientation.x && a.pose.orientation.y == b.pose.orientation.y
+      && a.pose.orientation.z == b.pose.orientation.z && a.pose.orientation.w == b.pose.orientation.w;
+  }
+
+  bool PlanRequests::Request::matches(const geometry_msgs::PoseStamped& s, const geometry_msgs::PoseStamped& g) const {
+    return samePose(start, s) && samePose(goal, g);
+  }
+
+  PlanRequests::PlanRequests(const PlanFunction& plan) : plan_(plan) {}
+
+  bool PlanRequests::makePlan(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal,
+      std::vector<geometry_msgs::PoseStamped>& plan){
+    boost::mutex::scoped_lock lock(mutex_);
+    plan.clear();
+
+    boost::shared_ptr<Request> request;
+    if(running_ && running_->matches(start, goal))
+      request = running_;
+    else if(waiting_ && waiting_->matches(start, goal))
+      request = waiting_;
+    else{
+      if(waiting_){
+        waiting_->cancelled = true;
+        changed_.notify_all();
+      }
+      request.reset(new Request());
+      request->start = start;
+      request->goal = goal;
+      request->found = request->done = request->cancelled = false;
+      waiting_ = request;
+
+      while(running_ && !request->cancelled)
+        changed_.wait(lock);
+
+      //the planning itself runs unlocked, so that newer requests can come in meanwhile
+      if(!request->cancelled){
+        waiting_.reset();
+        running_ = request;
+        lock.unlock();
+        std::vector<geometry_msgs::PoseStamped> result;
+        bool found = plan_(start, goal, result);
+        lock.lock();
+        request->plan.swap(result);
+        request->found = found;
+        request->done = true;
+        running_.reset();
+        changed_.notify_all();
+      }
+    }
+
+    while(!request->done && !request->cancelled)
+      changed_.wait(lock);
+    if(request->cancelled){
+      ROS_DEBUG("A newer plan request superseded this one before it was planned");
+      return false;
+    }
+    plan = request->plan;
+    return request->found;
+  }
+};
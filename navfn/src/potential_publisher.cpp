@@ -0,0 +1,104 @@
+/*********************************************************************
+*
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*
+*********************************************************************/
+#include <navfn/potential_publisher.h>
+#include <boost/bind.hpp>
+#include <algorithm>
+
+namespace navfn {
+
+  PotentialPublisher::PotentialPublisher(const PublishFunction& publish, double rate)
+    : publish_(publish), period_(rate > 0.0 ? 1.0 / rate : 0.0), pending_(false), stopping_(false) {
+    thread_ = boost::thread(boost::bind(&PotentialPublisher::run, this));
+  }
+
+  PotentialPublisher::~PotentialPublisher(){
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      stopping_ = true;
+      changed_.notify_one();
+    }
+    thread_.join();
+  }
+
+  bool PotentialPublisher::due() const {
+    return period_.isZero() || last_post_.isZero() || ros::WallTime::now() - last_post_ >= period_;
+  }
+
+  void PotentialPublisher::run(){
+    while(true){
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        while(!pending_ && !stopping_)
+          changed_.wait(lock);
+        if(stopping_)
+          return;
+        //the buffers are swapped, so that neither side allocates once they have the size of the map
+        std::swap(waiting_, publishing_);
+        pending_ = false;
+      }
+      if(crop(publishing_))
+        publish_(publishing_);
+    }
+  }
+
+  bool PotentialPublisher::crop(Potential& potential){
+    int nx = potential.nx, ny = potential.ny;
+    potential.x0 = nx;
+    potential.y0 = ny;
+    potential.x1 = potential.y1 = -1;
+    potential.max = 0.0;
+    for(int y = 0; y < ny; y++){
+      const float* row = &potential.cells[y * nx];
+      int first = -1, last = -1;
+      for(int x = 0; x < nx; x++){
+        if(row[x] < 0.0)
+          continue;
+        if(first < 0)
+          first = x;
+        last = x;
+        potential.max = std::max(potential.max, row[x]);
+      }
+      if(first < 0)
+        continue;
+      potential.x0 = std::min(potential.x0, first);
+      potential.x1 = std::max(potential.x1, last);
+      potential.y0 = std::min(potential.y0, y);
+      potential.y1 = y;
+    }
+    return potential.x1 >= 0;
+  }
+
+};
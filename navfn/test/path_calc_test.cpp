@@ -77,11 +77,20 @@ void print_neighborhood_of_last_path_entry( navfn::NavFn* nav )
     printf( "%5d:", y );
     for( int x = xf - 2; x <= xf + 2; x++ )
     {
-      printf( " %5.1f", nav->potarr[ y * nav->nx + x ] );
+      printf( " %5.1f", (float)nav->potarr[ y * nav->nx + x ] );
     }
     printf( "\n" );
   }
 
+  float gx[5][5], gy[5][5];
+  for( int y = yf - 2; y <= yf + 2; y++ )
+  {
+    for( int x = xf - 2; x <= xf + 2; x++ )
+    {
+      nav->gradCell( y * nav->nx + x, gx[ y - yf + 2 ][ x - xf + 2 ], gy[ y - yf + 2 ][ x - xf + 2 ]);
+    }
+  }
+
   printf("gradient neighborhood of last entry:\n");
   printf( "     " );
   for( int x = xf - 2; x <= xf + 2; x++ )
@@ -95,14 +104,14 @@ void print_neighborhood_of_last_path_entry( navfn::NavFn* nav )
     printf( "%5d x:", y );
     for( int x = xf - 2; x <= xf + 2; x++ )
     {
-      printf( " %5.1f", nav->gradx[ y * nav->nx + x ] );
+      printf( " %5.1f", gx[ y - yf + 2 ][ x - xf + 2 ] );
     }
     printf( "\n" );
 
     printf( "      y:" );
     for( int x = xf - 2; x <= xf + 2; x++ )
     {
-      printf( " %5.1f", nav->grady[ y * nav->nx + x ] );
+      printf( " %5.1f", gy[ y - yf + 2 ][ x - xf + 2 ] );
     }
     printf( "\n" );
   }
@@ -153,6 +162,108 @@ TEST(PathCalc, easy_nav_should_always_work)
   EXPECT_TRUE( nav->calcNavFnDijkstra( true ));
 }
 
+// The wavefront over a large open map is much longer than the initial
+// priority blocks; if any cell were dropped the field would lose its
+// symmetry about the goal.
+TEST(PathCalc, wide_wavefront_keeps_every_cell)
+{
+  int size = 3000;
+  navfn::NavFn* nav = new navfn::NavFn(size, size);
+  nav->priInc = 2*COST_NEUTRAL;
+  memset( nav->costarr, COST_NEUTRAL, size*size );
+
+  int goal[2];
+  int start[2];
+
+  goal[0] = size/2;
+  goal[1] = size/2;
+
+  start[0] = 2;
+  start[1] = 2;
+
+  nav->setGoal( goal );
+  nav->setStart( start );
+
+  EXPECT_TRUE( nav->calcNavFnDijkstra( true ));
+
+  int lo = 2, hi = size - 2;
+  POTTYPE pot = nav->potarr[ lo * size + lo ];
+  EXPECT_LT( pot, POT_HIGH );
+  EXPECT_FLOAT_EQ( pot, nav->potarr[ lo * size + hi ] );
+  EXPECT_FLOAT_EQ( pot, nav->potarr[ hi * size + lo ] );
+  EXPECT_FLOAT_EQ( pot, nav->potarr[ hi * size + hi ] );
+
+  delete nav;
+}
+
+// Stopping at the start has to wait for every cell of the stop region, but
+// not propagate over the rest of the map.
+TEST(PathCalc, stop_region_is_reached)
+{
+  int size = 200;
+  navfn::NavFn* nav = new navfn::NavFn(size, size);
+  nav->priInc = 2*COST_NEUTRAL;
+  memset( nav->costarr, COST_NEUTRAL, size*size );
+
+  int goal[2];
+  int start[2];
+
+  goal[0] = 100;
+  goal[1] = 100;
+
+  start[0] = 110;
+  start[1] = 100;
+
+  nav->setGoal( goal );
+  nav->setStart( start );
+  nav->setStopRegion( 105, 95, 115, 105, 0.0 );
+
+  EXPECT_TRUE( nav->calcNavFnDijkstra( true ));
+
+  for( int y = 95; y <= 105; y++ )
+  {
+    for( int x = 105; x <= 115; x++ )
+    {
+      EXPECT_LT( nav->potarr[ y * size + x ], POT_HIGH );
+    }
+  }
+  EXPECT_GE( nav->potarr[ 190 * size + 190 ], POT_HIGH );
+
+  delete nav;
+}
+
+// On an open map the potential grows with the distance to the goal, in
+// floats as well as in fixed point.
+TEST(PathCalc, potential_follows_the_distance)
+{
+  int size = 200;
+  navfn::NavFn* nav = new navfn::NavFn(size, size);
+  nav->priInc = 2*COST_NEUTRAL;
+  memset( nav->costarr, COST_NEUTRAL, size*size );
+
+  int goal[2];
+  int start[2];
+
+  goal[0] = 100;
+  goal[1] = 100;
+
+  start[0] = 20;
+  start[1] = 20;
+
+  nav->setGoal( goal );
+  nav->setStart( start );
+
+  EXPECT_TRUE( nav->calcNavFnDijkstra( true ));
+
+  double cell = COST_NEUTRAL*POT_SCALE;
+  EXPECT_NEAR( 60*cell, nav->potarr[ 100 * size + 160 ], 0.01*60*cell );
+  EXPECT_NEAR( 60*cell, nav->potarr[ 40 * size + 100 ], 0.01*60*cell );
+  EXPECT_NEAR( 60*M_SQRT2*cell, nav->potarr[ 160 * size + 160 ], 0.05*60*M_SQRT2*cell );
+  EXPECT_GT( nav->npath, 0 );
+
+  delete nav;
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
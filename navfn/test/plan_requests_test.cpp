@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <navfn/plan_requests.h>
+
+using navfn::PlanRequests;
+
+// A plan function that blocks until it is released, and records the goals it planned for
+class BlockingPlanner {
+  public:
+    BlockingPlanner() : released_(false) {}
+
+    bool plan(const geometry_msgs::PoseStamped& start, const geometry_msgs::PoseStamped& goal,
+        std::vector<geometry_msgs::PoseStamped>& plan){
+      boost::mutex::scoped_lock lock(mutex_);
+      goals_.push_back(goal.pose.position.x);
+      changed_.notify_all();
+      while(!released_)
+        changed_.wait(lock);
+      plan.push_back(start);
+      plan.push_back(goal);
+      return true;
+    }
+
+    void waitForCalls(unsigned int calls){
+      boost::mutex::scoped_lock lock(mutex_);
+      while(goals_.size() < calls)
+        changed_.wait(lock);
+    }
+
+    void release(){
+      boost::mutex::scoped_lock lock(mutex_);
+      released_ = true;
+      changed_.notify_all();
+    }
+
+    std::vector<double> goals(){
+      boost::mutex::scoped_lock lock(mutex_);
+      return goals_;
+    }
+
+  private:
+    boost::mutex mutex_;
+    boost::condition_variable changed_;
+    bool released_;
+    std::vector<double> goals_;
+};
+
+struct Call {
+  Call() : found(false) {}
+
+  void run(PlanRequests* requests, double goal_x){
+    geometry_msgs::PoseStamped start, goal;
+    start.header.frame_id = goal.header.frame_id = "map";
+    start.pose.orientation.w = goal.pose.orientation.w = 1.0;
+    goal.pose.position.x = goal_x;
+    found = requests->makePlan(start, goal, plan);
+  }
+
+  bool found;
+  std::vector<geometry_msgs::PoseStamped> plan;
+};
+
+// gives a call that was started the time to get to its wait
+static void settle(){
+  boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+}
+
+TEST(PlanRequests, identicalRequestsShareOnePlan){
+  BlockingPlanner planner;
+  PlanRequests requests(boost::bind(&BlockingPlanner::plan, &planner, _1, _2, _3));
+
+  Call first, second, third;
+  boost::thread first_thread(boost::bind(&Call::run, &first, &requests, 1.0));
+  planner.waitForCalls(1);
+  boost::thread second_thread(boost::bind(&Call::run, &second, &requests, 1.0));
+  boost::thread third_thread(boost::bind(&Call::run, &third, &requests, 1.0));
+  settle();
+  planner.release();
+  first_thread.join();
+  second_thread.join();
+  third_thread.join();
+
+  EXPECT_EQ(1u, planner.goals().size());
+  EXPECT_TRUE(first.found);
+  EXPECT_TRUE(second.found);
+  EXPECT_TRUE(third.found);
+  ASSERT_EQ(2u, second.plan.size());
+  EXPECT_EQ(1.0, second.plan[1].pose.position.x);
+  EXPECT_EQ(first.plan.size(), third.plan.size());
+}
+
+TEST(PlanRequests, newerRequestSupersedesWaitingOne){
+  BlockingPlanner planner;
+  PlanRequests requests(boost::bind(&BlockingPlanner::plan, &planner, _1, _2, _3));
+
+  Call running, superseded, newest;
+  boost::thread running_thread(boost::bind(&Call::run, &running, &requests, 1.0));
+  planner.waitForCalls(1);
+  boost::thread superseded_thread(boost::bind(&Call::run, &superseded, &requests, 2.0));
+  settle();
+  boost::thread newest_thread(boost::bind(&Call::run, &newest, &requests, 3.0));
+
+  // the waiting request returns as soon as the newer one comes in, while the plan is still running
+  superseded_thread.join();
+  EXPECT_FALSE(superseded.found);
+  EXPECT_TRUE(superseded.plan.empty());
+
+  planner.release();
+  running_thread.join();
+  newest_thread.join();
+
+  EXPECT_TRUE(running.found);
+  EXPECT_TRUE(newest.found);
+  ASSERT_EQ(2u, newest.plan.size());
+  EXPECT_EQ(3.0, newest.plan[1].pose.position.x);
+  std::vector<double> goals = planner.goals();
+  ASSERT_EQ(2u, goals.size());
+  EXPECT_EQ(1.0, goals[0]);
+  EXPECT_EQ(3.0, goals[1]);
+}
+
+int main(int argc, char** argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,100 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+
+#ifndef __MEASUREMENT_BUFFER__
+#define __MEASUREMENT_BUFFER__
+
+#include <boost/circular_buffer.hpp>
+#include <ros/time.h>
+#include <tf/tf.h>
+
+namespace estimation
+{
+
+/**
+ * Time ordered history of the measurements of a single sensor.
+ *
+ * Replaces a full tf::Transformer for the ekf: a sensor only ever needs
+ * the one edge it publishes, so there is no frame graph to walk and no
+ * frame id strings to copy. Storage is a ring that only grows when the
+ * requested history no longer fits, so steady state inserts and lookups
+ * do not allocate.
+ */
+class MeasurementBuffer
+{
+public:
+  /**
+   * @param  max_age Measurements older than this, relative to the newest one, are dropped
+   * @param  initial_capacity Number of measurements to reserve room for up front
+   */
+  MeasurementBuffer(const ros::Duration& max_age = ros::Duration(10.0), unsigned int initial_capacity = 128);
+
+  /**
+   * @brief  Add a measurement, keeping the buffer sorted by time
+   * @param  time The time stamp of the measurement
+   * @param  meas The measurement
+   */
+  void insert(const ros::Time& time, const tf::Transform& meas);
+
+  /**
+   * @brief  Get the measurement at a given time, interpolating between neighbours
+   * @param  time The time to look up, ros::Time() for the newest measurement
+   * @param  meas Will be set to the (interpolated) measurement
+   * @param  meas_time Will be set to the time of the returned measurement
+   * @return False if time lies outside the buffered history, the same cases tf reports as extrapolation
+   */
+  bool lookup(const ros::Time& time, tf::Transform& meas, ros::Time& meas_time) const;
+
+  bool empty() const { return buffer_.empty(); }
+
+  unsigned int size() const { return buffer_.size(); }
+
+  void clear() { buffer_.clear(); }
+
+private:
+  struct Entry
+  {
+    ros::Time time;
+    tf::Transform meas;
+  };
+
+  static bool entryBefore(const Entry& entry, const ros::Time& time) { return entry.time < time; }
+
+  boost::circular_buffer<Entry> buffer_;
+  ros::Duration max_age_;
+};
+
+}; // namespace
+
+#endif
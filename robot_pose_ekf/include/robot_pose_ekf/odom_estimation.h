@@ -37,17 +37,12 @@
 #define __ODOM_ESTIMATION__
 
 // bayesian filtering
-// #include <bfl/filter/extendedkalmanfilter.h> // should all become like this eventually, see comments in CMakeLists.txt.
-#include <filter/extendedkalmanfilter.h>
 #include <wrappers/matrix/matrix_wrapper.h>
-#include <model/linearanalyticsystemmodel_gaussianuncertainty.h>
-#include <model/linearanalyticmeasurementmodel_gaussianuncertainty.h>
-#include <pdf/analyticconditionalgaussian.h>
-#include <pdf/linearanalyticconditionalgaussian.h>
-#include "nonlinearanalyticconditionalgaussianodo.h"
+#include <Eigen/Core>
 
 // TF
 #include <tf/tf.h>
+#include <robot_pose_ekf/measurement_buffer.h>
 
 // msgs
 #include <geometry_msgs/PoseWithCovarianceStamped.h>
@@ -61,6 +56,8 @@ namespace estimation
 class OdomEstimation
 {
 public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
   /// constructor
   OdomEstimation();
 
@@ -68,6 +65,10 @@ public:
   virtual ~OdomEstimation();
 
   /** update the extended Kalman filter
+   * Active sensors whose newest measurement is older than filter_time are
+   * applied as delayed measurements: their increment is carried forward to
+   * filter_time with the filter estimate, and sensors without new data since
+   * their last update are skipped.
    * \param odom_active specifies if the odometry sensor is active or not
    * \param imu_active specifies if the imu sensor is active or not
    * \param gps_active specifies if the gps sensor is active or not
@@ -143,33 +144,49 @@ private:
 			  double& x, double& y, double&z, double&Rx, double& Ry, double& Rz);
 
 
-  // pdf / model / filter
-  BFL::AnalyticSystemModelGaussianUncertainty*            sys_model_;
-  BFL::NonLinearAnalyticConditionalGaussianOdo*           sys_pdf_;
-  BFL::LinearAnalyticConditionalGaussian*                 odom_meas_pdf_;
-  BFL::LinearAnalyticMeasurementModelGaussianUncertainty* odom_meas_model_;
-  BFL::LinearAnalyticConditionalGaussian*                 imu_meas_pdf_;
-  BFL::LinearAnalyticMeasurementModelGaussianUncertainty* imu_meas_model_;
-  BFL::LinearAnalyticConditionalGaussian*                 vo_meas_pdf_;
-  BFL::LinearAnalyticMeasurementModelGaussianUncertainty* vo_meas_model_;
-  BFL::LinearAnalyticConditionalGaussian*                 gps_meas_pdf_;
-  BFL::LinearAnalyticMeasurementModelGaussianUncertainty* gps_meas_model_;
-  BFL::Gaussian*                                          prior_;
-  BFL::ExtendedKalmanFilter*                              filter_;
-  MatrixWrapper::SymmetricMatrix                          odom_covariance_, imu_covariance_, vo_covariance_, gps_covariance_;
+  /// the measurement buffer of a sensor or of the filter estimate, NULL when unknown
+  MeasurementBuffer* getBuffer(const tf::StampedTransform& meas);
+
+  /// look up a sensor measurement at filter time, or the newest one when the sensor lags behind
+  bool lookupMeasurement(const MeasurementBuffer& buffer, const ros::Time& time, tf::Transform& meas, ros::Time& meas_time);
+
+  /// the filter estimate at a past time, the latest estimate for times at or after the last update
+  void estimateAt(const ros::Time& time, tf::Transform& estimate, double& yaw);
+
+  /// motion of the filter estimate from time up to the last update
+  tf::Transform estimateSince(const ros::Time& time);
+
+  /** kalman update with a linear measurement model, all sizes fixed at compile time
+   * \param H the measurement matrix
+   * \param z the measurement
+   * \param R the measurement noise covariance
+   */
+  template <int M>
+  void measurementUpdate(const Eigen::Matrix<double, M, 6>& H, const Eigen::Matrix<double, M, 1>& z,
+                         const Eigen::Matrix<double, M, M>& R);
+
+  // 6D state (x, y, z, roll, pitch, yaw) and its covariance
+  Eigen::Matrix<double, 6, 1> state_;
+  Eigen::Matrix<double, 6, 6> covariance_;
+
+  // measurement models
+  Eigen::Matrix<double, 6, 6> odom_H_, vo_H_;
+  Eigen::Matrix<double, 3, 6> imu_H_, gps_H_;
+  Eigen::Matrix<double, 6, 6> odom_covariance_, vo_covariance_;
+  Eigen::Matrix<double, 3, 3> imu_covariance_, gps_covariance_;
 
   // vars
-  MatrixWrapper::ColumnVector vel_desi_, filter_estimate_old_vec_;
+  MatrixWrapper::ColumnVector filter_estimate_old_vec_;
   tf::Transform filter_estimate_old_;
-  tf::StampedTransform odom_meas_, odom_meas_old_, imu_meas_, imu_meas_old_, vo_meas_, vo_meas_old_, gps_meas_, gps_meas_old_;
-  ros::Time filter_time_old_;
+  tf::Transform odom_meas_, odom_meas_old_, imu_meas_, imu_meas_old_, vo_meas_, vo_meas_old_, gps_meas_, gps_meas_old_;
+  ros::Time filter_time_old_, odom_time_old_, imu_time_old_, vo_time_old_, gps_time_old_;
   bool filter_initialized_, odom_initialized_, imu_initialized_, vo_initialized_, gps_initialized_;
 
   // diagnostics
   double diagnostics_odom_rot_rel_, diagnostics_imu_rot_rel_;
 
-  // tf transformer
-  tf::Transformer transformer_;
+  // measurement history per sensor, and of the filter estimate
+  MeasurementBuffer odom_buffer_, imu_buffer_, vo_buffer_, gps_buffer_, estimate_buffer_;
 
   std::string output_frame_;
   std::string base_footprint_frame_;
@@ -87,6 +87,15 @@ private:
   /// the mail filter loop that will be called periodically
   void spin(const ros::TimerEvent& e);
 
+  /// update the filter up to filter_stamp_ and publish or schedule the result
+  void updateFilter();
+
+  /// publish the latest estimate and broadcast it on tf
+  void publishEstimate();
+
+  /// publishes at its own rate when the imu drives the filter
+  void publishTimer(const ros::TimerEvent& e);
+
   /// callback function for odo data
   void odomCallback(const OdomConstPtr& odom);
 
@@ -104,7 +113,7 @@ private:
   bool getStatus(robot_pose_ekf::GetStatus::Request& req, robot_pose_ekf::GetStatus::Response& resp);
 
   ros::NodeHandle node_;
-  ros::Timer timer_;
+  ros::Timer timer_, publish_timer_;
   ros::Publisher pose_pub_;
   ros::Subscriber odom_sub_, imu_sub_, vo_sub_,gps_sub_;
   ros::ServiceServer state_srv_;
@@ -133,6 +142,7 @@ private:
   double timeout_;
   MatrixWrapper::SymmetricMatrix odom_covariance_, imu_covariance_, vo_covariance_, gps_covariance_;
   bool debug_, self_diagnose_;
+  bool imu_driven_, publish_pending_;
   std::string output_frame_, base_footprint_frame_, tf_prefix_;
 
   // log files for debugging
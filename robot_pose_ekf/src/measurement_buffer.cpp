@@ -0,0 +1,113 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+
+#include <robot_pose_ekf/measurement_buffer.h>
+#include <algorithm>
+
+namespace estimation
+{
+  MeasurementBuffer::MeasurementBuffer(const ros::Duration& max_age, unsigned int initial_capacity):
+    buffer_(std::max(initial_capacity, 2u)),
+    max_age_(max_age)
+  {}
+
+  void MeasurementBuffer::insert(const ros::Time& time, const tf::Transform& meas)
+  {
+    // too old to ever be looked up again
+    if (!buffer_.empty() && time + max_age_ < buffer_.back().time)
+      return;
+
+    // drop history that went out of date
+    while (!buffer_.empty() && buffer_.front().time + max_age_ < std::max(time, buffer_.back().time))
+      buffer_.pop_front();
+
+    Entry entry;
+    entry.time = time;
+    entry.meas = meas;
+
+    // the common case: measurements arrive in order
+    if (buffer_.empty() || buffer_.back().time < time){
+      if (buffer_.full())
+        buffer_.set_capacity(2 * buffer_.capacity());
+      buffer_.push_back(entry);
+      return;
+    }
+
+    boost::circular_buffer<Entry>::iterator it =
+      std::lower_bound(buffer_.begin(), buffer_.end(), time, entryBefore);
+    if (it->time == time){
+      it->meas = meas;
+      return;
+    }
+    if (buffer_.full()){
+      unsigned int index = it - buffer_.begin();
+      buffer_.set_capacity(2 * buffer_.capacity());
+      it = buffer_.begin() + index;
+    }
+    buffer_.insert(it, entry);
+  }
+
+  bool MeasurementBuffer::lookup(const ros::Time& time, tf::Transform& meas, ros::Time& meas_time) const
+  {
+    if (buffer_.empty())
+      return false;
+
+    if (time.isZero()){
+      meas = buffer_.back().meas;
+      meas_time = buffer_.back().time;
+      return true;
+    }
+
+    if (time < buffer_.front().time || time > buffer_.back().time)
+      return false;
+
+    boost::circular_buffer<Entry>::const_iterator after =
+      std::lower_bound(buffer_.begin(), buffer_.end(), time, entryBefore);
+    meas_time = time;
+    if (after->time == time){
+      meas = after->meas;
+      return true;
+    }
+
+    // same interpolation as tf: lerp the origin, slerp the rotation
+    const Entry& before = *(after - 1);
+    double ratio = (time - before.time).toSec() / (after->time - before.time).toSec();
+    tf::Vector3 origin;
+    origin.setInterpolate3(before.meas.getOrigin(), after->meas.getOrigin(), ratio);
+    meas.setOrigin(origin);
+    meas.setRotation(tf::slerp(before.meas.getRotation(), after->meas.getRotation(), ratio));
+    return true;
+  }
+
+}; // namespace
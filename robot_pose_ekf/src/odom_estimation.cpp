@@ -35,9 +35,9 @@
 /* Author: Wim Meeussen */
 
 #include <robot_pose_ekf/odom_estimation.h>
+#include <Eigen/Cholesky>
 
 using namespace MatrixWrapper;
-using namespace BFL;
 using namespace tf;
 using namespace std;
 using namespace ros;
@@ -47,8 +47,7 @@ namespace estimation
 {
   // constructor
   OdomEstimation::OdomEstimation():
-    prior_(NULL),
-    filter_(NULL),
+    filter_estimate_old_vec_(6),
     filter_initialized_(false),
     odom_initialized_(false),
     imu_initialized_(false),
@@ -57,71 +56,33 @@ namespace estimation
     output_frame_(std::string("odom_combined")),
     base_footprint_frame_(std::string("base_footprint"))
   {
-    // create SYSTEM MODEL
-    ColumnVector sysNoise_Mu(6);  sysNoise_Mu = 0;
-    SymmetricMatrix sysNoise_Cov(6); sysNoise_Cov = 0;
-    for (unsigned int i=1; i<=6; i++) sysNoise_Cov(i,i) = pow(1000.0,2);
-    Gaussian system_Uncertainty(sysNoise_Mu, sysNoise_Cov);
-    sys_pdf_   = new NonLinearAnalyticConditionalGaussianOdo(system_Uncertainty);
-    sys_model_ = new AnalyticSystemModelGaussianUncertainty(sys_pdf_);
+    state_.setZero();
+    covariance_.setZero();
 
     // create MEASUREMENT MODEL ODOM
-    ColumnVector measNoiseOdom_Mu(6);  measNoiseOdom_Mu = 0;
-    SymmetricMatrix measNoiseOdom_Cov(6);  measNoiseOdom_Cov = 0;
-    for (unsigned int i=1; i<=6; i++) measNoiseOdom_Cov(i,i) = 1;
-    Gaussian measurement_Uncertainty_Odom(measNoiseOdom_Mu, measNoiseOdom_Cov);
-    Matrix Hodom(6,6);  Hodom = 0;
-    Hodom(1,1) = 1;    Hodom(2,2) = 1;    Hodom(6,6) = 1;
-    odom_meas_pdf_   = new LinearAnalyticConditionalGaussian(Hodom, measurement_Uncertainty_Odom);
-    odom_meas_model_ = new LinearAnalyticMeasurementModelGaussianUncertainty(odom_meas_pdf_);
+    odom_H_.setZero();
+    odom_H_(0,0) = 1;    odom_H_(1,1) = 1;    odom_H_(5,5) = 1;
+    odom_covariance_.setIdentity();
 
     // create MEASUREMENT MODEL IMU
-    ColumnVector measNoiseImu_Mu(3);  measNoiseImu_Mu = 0;
-    SymmetricMatrix measNoiseImu_Cov(3);  measNoiseImu_Cov = 0;
-    for (unsigned int i=1; i<=3; i++) measNoiseImu_Cov(i,i) = 1;
-    Gaussian measurement_Uncertainty_Imu(measNoiseImu_Mu, measNoiseImu_Cov);
-    Matrix Himu(3,6);  Himu = 0;
-    Himu(1,4) = 1;    Himu(2,5) = 1;    Himu(3,6) = 1;
-    imu_meas_pdf_   = new LinearAnalyticConditionalGaussian(Himu, measurement_Uncertainty_Imu);
-    imu_meas_model_ = new LinearAnalyticMeasurementModelGaussianUncertainty(imu_meas_pdf_);
+    imu_H_.setZero();
+    imu_H_(0,3) = 1;    imu_H_(1,4) = 1;    imu_H_(2,5) = 1;
+    imu_covariance_.setIdentity();
 
     // create MEASUREMENT MODEL VO
-    ColumnVector measNoiseVo_Mu(6);  measNoiseVo_Mu = 0;
-    SymmetricMatrix measNoiseVo_Cov(6);  measNoiseVo_Cov = 0;
-    for (unsigned int i=1; i<=6; i++) measNoiseVo_Cov(i,i) = 1;
-    Gaussian measurement_Uncertainty_Vo(measNoiseVo_Mu, measNoiseVo_Cov);
-    Matrix Hvo(6,6);  Hvo = 0;
-    Hvo(1,1) = 1;    Hvo(2,2) = 1;    Hvo(3,3) = 1;    Hvo(4,4) = 1;    Hvo(5,5) = 1;    Hvo(6,6) = 1;
-    vo_meas_pdf_   = new LinearAnalyticConditionalGaussian(Hvo, measurement_Uncertainty_Vo);
-    vo_meas_model_ = new LinearAnalyticMeasurementModelGaussianUncertainty(vo_meas_pdf_);
+    vo_H_.setIdentity();
+    vo_covariance_.setIdentity();
 
     // create MEASUREMENT MODEL GPS
-    ColumnVector measNoiseGps_Mu(3);  measNoiseGps_Mu = 0;
-    SymmetricMatrix measNoiseGps_Cov(3);  measNoiseGps_Cov = 0;
-    for (unsigned int i=1; i<=3; i++) measNoiseGps_Cov(i,i) = 1;
-    Gaussian measurement_Uncertainty_GPS(measNoiseGps_Mu, measNoiseGps_Cov);
-    Matrix Hgps(3,6);  Hgps = 0;
-    Hgps(1,1) = 1;    Hgps(2,2) = 1;    Hgps(3,3) = 1;    
-    gps_meas_pdf_   = new LinearAnalyticConditionalGaussian(Hgps, measurement_Uncertainty_GPS);
-    gps_meas_model_ = new LinearAnalyticMeasurementModelGaussianUncertainty(gps_meas_pdf_);
+    gps_H_.setZero();
+    gps_H_(0,0) = 1;    gps_H_(1,1) = 1;    gps_H_(2,2) = 1;
+    gps_covariance_.setIdentity();
   };
 
 
 
   // destructor
   OdomEstimation::~OdomEstimation(){
-    if (filter_) delete filter_;
-    if (prior_)  delete prior_;
-    delete odom_meas_model_;
-    delete odom_meas_pdf_;
-    delete imu_meas_model_;
-    delete imu_meas_pdf_;
-    delete vo_meas_model_;
-    delete vo_meas_pdf_;
-    delete gps_meas_model_;
-    delete gps_meas_pdf_;
-    delete sys_pdf_;
-    delete sys_model_;
   };
 
 
@@ -129,21 +90,12 @@ namespace estimation
   void OdomEstimation::initialize(const Transform& prior, const Time& time)
   {
     // set prior of filter
-    ColumnVector prior_Mu(6); 
-    decomposeTransform(prior, prior_Mu(1), prior_Mu(2), prior_Mu(3), prior_Mu(4), prior_Mu(5), prior_Mu(6));
-    SymmetricMatrix prior_Cov(6); 
-    for (unsigned int i=1; i<=6; i++) {
-      for (unsigned int j=1; j<=6; j++){
-	if (i==j)  prior_Cov(i,j) = pow(0.001,2);
-	else prior_Cov(i,j) = 0;
-      }
-    }
-    prior_  = new Gaussian(prior_Mu,prior_Cov);
-    filter_ = new ExtendedKalmanFilter(prior_);
+    decomposeTransform(prior, state_(0), state_(1), state_(2), state_(3), state_(4), state_(5));
+    covariance_ = Eigen::Matrix<double, 6, 6>::Identity() * pow(0.001,2);
 
     // remember prior
     addMeasurement(StampedTransform(prior, time, output_frame_, base_footprint_frame_));
-    filter_estimate_old_vec_ = prior_Mu;
+    for (unsigned int i=0; i<6; i++) filter_estimate_old_vec_(i+1) = state_(i);
     filter_estimate_old_ = prior;
     filter_time_old_     = time;
 
@@ -176,40 +128,45 @@ namespace estimation
 
     // system update filter
     // --------------------
-    // for now only add system noise
-    ColumnVector vel_desi(2); vel_desi = 0;
-    filter_->Update(sys_model_, vel_desi);
+    // for now only add system noise: with a zero velocity input the
+    // odometry system model leaves the state unchanged and has an identity jacobian
+    covariance_.diagonal().array() += pow(1000.0,2);
 
     
     // process odom measurement
     // ------------------------
     ROS_DEBUG("Process odom meas");
     if (odom_active){
-      if (!transformer_.canTransform(base_footprint_frame_,"wheelodom", filter_time)){
+      Time odom_time;
+      if (!lookupMeasurement(odom_buffer_, filter_time, odom_meas_, odom_time)){
         ROS_ERROR("filter time older than odom message buffer");
         return false;
       }
-      transformer_.lookupTransform("wheelodom", base_footprint_frame_, filter_time, odom_meas_);
       if (odom_initialized_){
-	// convert absolute odom measurements to relative odom measurements in horizontal plane
-	Transform odom_rel_frame =  Transform(tf::createQuaternionFromYaw(filter_estimate_old_vec_(6)), 
-					      filter_estimate_old_.getOrigin()) * odom_meas_old_.inverse() * odom_meas_;
-	ColumnVector odom_rel(6); 
-	decomposeTransform(odom_rel_frame, odom_rel(1), odom_rel(2), odom_rel(3), odom_rel(4), odom_rel(5), odom_rel(6));
-	angleOverflowCorrect(odom_rel(6), filter_estimate_old_vec_(6));
-	// update filter
-	odom_meas_pdf_->AdditiveNoiseSigmaSet(odom_covariance_ * pow(dt,2));
-
-        ROS_DEBUG("Update filter with odom measurement %f %f %f %f %f %f", 
-                  odom_rel(1), odom_rel(2), odom_rel(3), odom_rel(4), odom_rel(5), odom_rel(6));
-	filter_->Update(odom_meas_model_, odom_rel);
-	diagnostics_odom_rot_rel_ = odom_rel(6);
+        if (odom_time > odom_time_old_){
+	  // convert absolute odom measurements to relative odom measurements in horizontal plane
+	  Transform odom_ref; double odom_ref_yaw;
+	  estimateAt(odom_time_old_, odom_ref, odom_ref_yaw);
+	  Transform odom_rel_frame =  Transform(tf::createQuaternionFromYaw(odom_ref_yaw), odom_ref.getOrigin())
+	    * odom_meas_old_.inverse() * odom_meas_ * estimateSince(odom_time);
+	  Eigen::Matrix<double, 6, 1> odom_rel;
+	  decomposeTransform(odom_rel_frame, odom_rel(0), odom_rel(1), odom_rel(2), odom_rel(3), odom_rel(4), odom_rel(5));
+	  angleOverflowCorrect(odom_rel(5), filter_estimate_old_vec_(6));
+	  // update filter
+          ROS_DEBUG("Update filter with odom measurement %f %f %f %f %f %f", 
+                    odom_rel(0), odom_rel(1), odom_rel(2), odom_rel(3), odom_rel(4), odom_rel(5));
+	  measurementUpdate<6>(odom_H_, odom_rel, odom_covariance_ * pow((odom_time - odom_time_old_).toSec(),2));
+	  diagnostics_odom_rot_rel_ = odom_rel(5);
+	  odom_meas_old_ = odom_meas_;
+	  odom_time_old_ = odom_time;
+        }
       }
       else{
 	odom_initialized_ = true;
 	diagnostics_odom_rot_rel_ = 0;
+	odom_meas_old_ = odom_meas_;
+	odom_time_old_ = odom_time;
       }
-      odom_meas_old_ = odom_meas_;
     }
     // sensor not active
     else odom_initialized_ = false;
@@ -218,28 +175,34 @@ namespace estimation
     // process imu measurement
     // -----------------------
     if (imu_active){
-      if (!transformer_.canTransform(base_footprint_frame_,"imu", filter_time)){
+      Time imu_time;
+      if (!lookupMeasurement(imu_buffer_, filter_time, imu_meas_, imu_time)){
         ROS_ERROR("filter time older than imu message buffer");
         return false;
       }
-      transformer_.lookupTransform("imu", base_footprint_frame_, filter_time, imu_meas_);
       if (imu_initialized_){
-	// convert absolute imu yaw measurement to relative imu yaw measurement 
-	Transform imu_rel_frame =  filter_estimate_old_ * imu_meas_old_.inverse() * imu_meas_;
-	ColumnVector imu_rel(3); double tmp;
-	decomposeTransform(imu_rel_frame, tmp, tmp, tmp, tmp, tmp, imu_rel(3));
-	decomposeTransform(imu_meas_,     tmp, tmp, tmp, imu_rel(1), imu_rel(2), tmp);
-	angleOverflowCorrect(imu_rel(3), filter_estimate_old_vec_(6));
-	diagnostics_imu_rot_rel_ = imu_rel(3);
-	// update filter
-	imu_meas_pdf_->AdditiveNoiseSigmaSet(imu_covariance_ * pow(dt,2));
-	filter_->Update(imu_meas_model_,  imu_rel);
+        if (imu_time > imu_time_old_){
+	  // convert absolute imu yaw measurement to relative imu yaw measurement 
+	  Transform imu_ref; double tmp;
+	  estimateAt(imu_time_old_, imu_ref, tmp);
+	  Transform imu_rel_frame =  imu_ref * imu_meas_old_.inverse() * imu_meas_ * estimateSince(imu_time);
+	  Eigen::Matrix<double, 3, 1> imu_rel;
+	  decomposeTransform(imu_rel_frame, tmp, tmp, tmp, tmp, tmp, imu_rel(2));
+	  decomposeTransform(imu_meas_,     tmp, tmp, tmp, imu_rel(0), imu_rel(1), tmp);
+	  angleOverflowCorrect(imu_rel(2), filter_estimate_old_vec_(6));
+	  diagnostics_imu_rot_rel_ = imu_rel(2);
+	  // update filter
+	  measurementUpdate<3>(imu_H_, imu_rel, imu_covariance_ * pow((imu_time - imu_time_old_).toSec(),2));
+	  imu_meas_old_ = imu_meas_;
+	  imu_time_old_ = imu_time;
+        }
       }
       else{
 	imu_initialized_ = true;
 	diagnostics_imu_rot_rel_ = 0;
+	imu_meas_old_ = imu_meas_;
+	imu_time_old_ = imu_time;
       }
-      imu_meas_old_ = imu_meas_; 
     }
     // sensor not active
     else imu_initialized_ = false;
@@ -249,23 +212,31 @@ namespace estimation
     // process vo measurement
     // ----------------------
     if (vo_active){
-      if (!transformer_.canTransform(base_footprint_frame_,"vo", filter_time)){
+      Time vo_time;
+      if (!lookupMeasurement(vo_buffer_, filter_time, vo_meas_, vo_time)){
         ROS_ERROR("filter time older than vo message buffer");
         return false;
       }
-      transformer_.lookupTransform("vo", base_footprint_frame_, filter_time, vo_meas_);
       if (vo_initialized_){
-	// convert absolute vo measurements to relative vo measurements
-	Transform vo_rel_frame =  filter_estimate_old_ * vo_meas_old_.inverse() * vo_meas_;
-	ColumnVector vo_rel(6);
-	decomposeTransform(vo_rel_frame, vo_rel(1),  vo_rel(2), vo_rel(3), vo_rel(4), vo_rel(5), vo_rel(6));
-	angleOverflowCorrect(vo_rel(6), filter_estimate_old_vec_(6));
-	// update filter
-        vo_meas_pdf_->AdditiveNoiseSigmaSet(vo_covariance_ * pow(dt,2));
-        filter_->Update(vo_meas_model_,  vo_rel);
+        if (vo_time > vo_time_old_){
+	  // convert absolute vo measurements to relative vo measurements
+	  Transform vo_ref; double tmp;
+	  estimateAt(vo_time_old_, vo_ref, tmp);
+	  Transform vo_rel_frame =  vo_ref * vo_meas_old_.inverse() * vo_meas_ * estimateSince(vo_time);
+	  Eigen::Matrix<double, 6, 1> vo_rel;
+	  decomposeTransform(vo_rel_frame, vo_rel(0),  vo_rel(1), vo_rel(2), vo_rel(3), vo_rel(4), vo_rel(5));
+	  angleOverflowCorrect(vo_rel(5), filter_estimate_old_vec_(6));
+	  // update filter
+          measurementUpdate<6>(vo_H_, vo_rel, vo_covariance_ * pow((vo_time - vo_time_old_).toSec(),2));
+	  vo_meas_old_ = vo_meas_;
+	  vo_time_old_ = vo_time;
+        }
+      }
+      else{
+	vo_initialized_ = true;
+	vo_meas_old_ = vo_meas_;
+	vo_time_old_ = vo_time;
       }
-      else vo_initialized_ = true;
-      vo_meas_old_ = vo_meas_;
     }
     // sensor not active
     else vo_initialized_ = false;
@@ -275,22 +246,29 @@ namespace estimation
     // process gps measurement
     // ----------------------
     if (gps_active){
-      if (!transformer_.canTransform(base_footprint_frame_,"gps", filter_time)){
+      Time gps_time;
+      if (!lookupMeasurement(gps_buffer_, filter_time, gps_meas_, gps_time)){
         ROS_ERROR("filter time older than gps message buffer");
         return false;
       }
-      transformer_.lookupTransform("gps", base_footprint_frame_, filter_time, gps_meas_);
       if (gps_initialized_){
-        gps_meas_pdf_->AdditiveNoiseSigmaSet(gps_covariance_ * pow(dt,2));
-        ColumnVector gps_vec(3);
-        double tmp;
-        //Take gps as an absolute measurement, do not convert to relative measurement
-        decomposeTransform(gps_meas_, gps_vec(1), gps_vec(2), gps_vec(3), tmp, tmp, tmp);
-        filter_->Update(gps_meas_model_,  gps_vec);
+        if (gps_time > gps_time_old_){
+          Eigen::Matrix<double, 3, 1> gps_vec;
+          double tmp;
+          //Take gps as an absolute measurement, do not convert to relative measurement,
+          //but do move a delayed fix along with the filter estimate since then
+          Transform gps_ref;
+          estimateAt(gps_time, gps_ref, tmp);
+          Transform gps_moved(gps_meas_.getRotation(), gps_meas_.getOrigin() + (filter_estimate_old_.getOrigin() - gps_ref.getOrigin()));
+          decomposeTransform(gps_moved, gps_vec(0), gps_vec(1), gps_vec(2), tmp, tmp, tmp);
+          measurementUpdate<3>(gps_H_, gps_vec, gps_covariance_ * pow((gps_time - gps_time_old_).toSec(),2));
+          gps_time_old_ = gps_time;
+        }
       }
       else {
         gps_initialized_ = true;
         gps_meas_old_ = gps_meas_;
+        gps_time_old_ = gps_time;
       }
     }
     // sensor not active
@@ -299,13 +277,13 @@ namespace estimation
   
     
     // remember last estimate
-    filter_estimate_old_vec_ = filter_->PostGet()->ExpectedValueGet();
+    for (unsigned int i=0; i<6; i++) filter_estimate_old_vec_(i+1) = state_(i);
     tf::Quaternion q;
     q.setRPY(filter_estimate_old_vec_(4), filter_estimate_old_vec_(5), filter_estimate_old_vec_(6));
     filter_estimate_old_ = Transform(q,
 				     Vector3(filter_estimate_old_vec_(1), filter_estimate_old_vec_(2), filter_estimate_old_vec_(3)));
     filter_time_old_ = filter_time;
-    addMeasurement(StampedTransform(filter_estimate_old_, filter_time, output_frame_, base_footprint_frame_));
+    estimate_buffer_.insert(filter_time, filter_estimate_old_);
 
     // diagnostics
     diagnostics_res = true;
@@ -319,6 +297,62 @@ namespace estimation
     return true;
   };
 
+  template <int M>
+  void OdomEstimation::measurementUpdate(const Eigen::Matrix<double, M, 6>& H, const Eigen::Matrix<double, M, 1>& z,
+                                         const Eigen::Matrix<double, M, M>& R)
+  {
+    // K = P H' (H P H' + R)^-1, solved instead of inverted since S is symmetric positive definite
+    Eigen::Matrix<double, 6, M> PHt = covariance_ * H.transpose();
+    Eigen::Matrix<double, M, M> S = H * PHt + R;
+    Eigen::Matrix<double, M, 6> Kt = S.ldlt().solve(PHt.transpose());
+
+    state_ += Kt.transpose() * (z - H * state_);
+    covariance_ -= Kt.transpose() * PHt.transpose();
+    covariance_ = 0.5 * (covariance_ + covariance_.transpose()).eval();
+  }
+
+  MeasurementBuffer* OdomEstimation::getBuffer(const StampedTransform& meas)
+  {
+    if (meas.child_frame_id_ == "wheelodom") return &odom_buffer_;
+    else if (meas.child_frame_id_ == "imu")  return &imu_buffer_;
+    else if (meas.child_frame_id_ == "vo")   return &vo_buffer_;
+    else if (meas.child_frame_id_ == "gps")  return &gps_buffer_;
+    else if (meas.frame_id_ == output_frame_ && meas.child_frame_id_ == base_footprint_frame_) return &estimate_buffer_;
+    return NULL;
+  }
+
+  bool OdomEstimation::lookupMeasurement(const MeasurementBuffer& buffer, const Time& time, Transform& meas, Time& meas_time)
+  {
+    // sensors are buffered as base_footprint -> sensor, the filter wants the sensor measurement itself
+    if (!buffer.lookup(Time(), meas, meas_time))
+      return false;
+    if (meas_time > time && !buffer.lookup(time, meas, meas_time))
+      return false;
+    meas = meas.inverse();
+    return true;
+  }
+
+  void OdomEstimation::estimateAt(const Time& time, Transform& estimate, double& yaw)
+  {
+    Time estimate_time;
+    if (time < filter_time_old_ && estimate_buffer_.lookup(time, estimate, estimate_time)){
+      double tmp;
+      decomposeTransform(estimate, tmp, tmp, tmp, tmp, tmp, yaw);
+      return;
+    }
+    estimate = filter_estimate_old_;
+    yaw = filter_estimate_old_vec_(6);
+  }
+
+  Transform OdomEstimation::estimateSince(const Time& time)
+  {
+    if (time >= filter_time_old_)
+      return Transform::getIdentity();
+    Transform estimate; double yaw;
+    estimateAt(time, estimate, yaw);
+    return estimate.inverseTimes(filter_estimate_old_);
+  }
+
   void OdomEstimation::addMeasurement(const StampedTransform& meas)
   {
     ROS_DEBUG("AddMeasurement from %s to %s:  (%f, %f, %f)  (%f, %f, %f, %f)",
@@ -326,7 +360,12 @@ namespace estimation
               meas.getOrigin().x(), meas.getOrigin().y(), meas.getOrigin().z(),
               meas.getRotation().x(),  meas.getRotation().y(), 
               meas.getRotation().z(), meas.getRotation().w());
-    transformer_.setTransform( meas );
+    MeasurementBuffer* buffer = getBuffer(meas);
+    if (!buffer){
+      ROS_ERROR("Adding a measurement for an unknown sensor %s", meas.child_frame_id_.c_str());
+      return;
+    }
+    buffer->insert(meas.stamp_, meas);
   }
 
   void OdomEstimation::addMeasurement(const StampedTransform& meas, const MatrixWrapper::SymmetricMatrix& covar)
@@ -340,11 +379,18 @@ namespace estimation
     }
     // add measurements
     addMeasurement(meas);
-    if (meas.child_frame_id_ == "wheelodom") odom_covariance_ = covar;
-    else if (meas.child_frame_id_ == "imu")  imu_covariance_  = covar;
-    else if (meas.child_frame_id_ == "vo")   vo_covariance_   = covar;
-    else if (meas.child_frame_id_ == "gps")  gps_covariance_  = covar;
-    else ROS_ERROR("Adding a measurement for an unknown sensor %s", meas.child_frame_id_.c_str());
+    if (meas.child_frame_id_ == "wheelodom"){
+      for (unsigned int i=0; i<6; i++) for (unsigned int j=0; j<6; j++) odom_covariance_(i,j) = covar(i+1,j+1);
+    }
+    else if (meas.child_frame_id_ == "imu"){
+      for (unsigned int i=0; i<3; i++) for (unsigned int j=0; j<3; j++) imu_covariance_(i,j) = covar(i+1,j+1);
+    }
+    else if (meas.child_frame_id_ == "vo"){
+      for (unsigned int i=0; i<6; i++) for (unsigned int j=0; j<6; j++) vo_covariance_(i,j) = covar(i+1,j+1);
+    }
+    else if (meas.child_frame_id_ == "gps"){
+      for (unsigned int i=0; i<3; i++) for (unsigned int j=0; j<3; j++) gps_covariance_(i,j) = covar(i+1,j+1);
+    }
   };
 
 
@@ -357,46 +403,44 @@ namespace estimation
   // get filter posterior at time 'time' as Transform
   void OdomEstimation::getEstimate(Time time, Transform& estimate)
   {
-    StampedTransform tmp;
-    if (!transformer_.canTransform(base_footprint_frame_,output_frame_, time)){
+    Time estimate_time;
+    if (!estimate_buffer_.lookup(time, estimate, estimate_time)){
       ROS_ERROR("Cannot get transform at time %f", time.toSec());
       return;
     }
-    transformer_.lookupTransform(output_frame_, base_footprint_frame_, time, tmp);
-    estimate = tmp;
   };
 
   // get filter posterior at time 'time' as Stamped Transform
   void OdomEstimation::getEstimate(Time time, StampedTransform& estimate)
   {
-    if (!transformer_.canTransform(output_frame_, base_footprint_frame_, time)){
+    if (!estimate_buffer_.lookup(time, estimate, estimate.stamp_)){
       ROS_ERROR("Cannot get transform at time %f", time.toSec());
       return;
     }
-    transformer_.lookupTransform(output_frame_, base_footprint_frame_, time, estimate);
+    estimate.frame_id_ = output_frame_;
+    estimate.child_frame_id_ = base_footprint_frame_;
   };
 
   // get most recent filter posterior as PoseWithCovarianceStamped
   void OdomEstimation::getEstimate(geometry_msgs::PoseWithCovarianceStamped& estimate)
   {
     // pose
-    StampedTransform tmp;
-    if (!transformer_.canTransform(output_frame_, base_footprint_frame_, ros::Time())){
+    Transform tmp;
+    Time tmp_time;
+    if (!estimate_buffer_.lookup(ros::Time(), tmp, tmp_time)){
       ROS_ERROR("Cannot get transform at time %f", 0.0);
       return;
     }
-    transformer_.lookupTransform(output_frame_, base_footprint_frame_, ros::Time(), tmp);
     poseTFToMsg(tmp, estimate.pose.pose);
 
     // header
-    estimate.header.stamp = tmp.stamp_;
+    estimate.header.stamp = tmp_time;
     estimate.header.frame_id = "odom";
 
     // covariance
-    SymmetricMatrix covar =  filter_->PostGet()->CovarianceGet();
     for (unsigned int i=0; i<6; i++)
       for (unsigned int j=0; j<6; j++)
-	estimate.pose.covariance[6*i+j] = covar(i+1,j+1);
+	estimate.pose.covariance[6*i+j] = covariance_(i,j);
   };
 
   // correct for angle overflow
@@ -64,6 +64,7 @@ namespace estimation
       imu_covariance_(3),
       vo_covariance_(6),
       gps_covariance_(3),
+      publish_pending_(false),
       odom_callback_counter_(0),
       imu_callback_counter_(0),
       vo_callback_counter_(0),
@@ -85,6 +86,9 @@ namespace estimation
     nh_private.param("self_diagnose",  self_diagnose_, false);
     double freq;
     nh_private.param("freq", freq, 30.0);
+    nh_private.param("imu_driven", imu_driven_, false);
+    double publish_freq;
+    nh_private.param("publish_freq", publish_freq, freq);
 
     tf_prefix_ = tf::getPrefixParam(nh_private);
     output_frame_ = tf::resolve(tf_prefix_, output_frame_);
@@ -100,6 +104,12 @@ namespace estimation
 
     timer_ = nh_private.createTimer(ros::Duration(1.0/max(freq,1.0)), &OdomEstimationNode::spin, this);
 
+    // when every imu message updates the filter, the output goes out at its own rate
+    if (imu_driven_){
+      ROS_INFO("Imu messages drive the filter, publishing at %f Hz", publish_freq);
+      publish_timer_ = nh_private.createTimer(ros::Duration(1.0/max(publish_freq,1.0)), &OdomEstimationNode::publishTimer, this);
+    }
+
     // advertise our estimation
     pose_pub_ = nh_private.advertise<geometry_msgs::PoseWithCovarianceStamped>(output_frame_, 10);
 
@@ -275,6 +285,13 @@ namespace estimation
       else ROS_DEBUG("Waiting to activate IMU, because IMU measurements are still %f sec in the future.", 
 		    (imu_init_stamp_ - filter_stamp_).toSec());
     }
+
+    // in imu driven mode every imu message advances the filter, the other
+    // sensors are folded in at the next imu message after they arrive
+    if (imu_driven_ && imu_active_ && my_filter_.isInitialized() && imu_stamp_ > filter_stamp_){
+      filter_stamp_ = imu_stamp_;
+      updateFilter();
+    }
     
     if (debug_){
       // write to file
@@ -416,37 +433,9 @@ namespace estimation
       if (gps_active_)  filter_stamp_ = min(filter_stamp_, gps_stamp_);
 
       
-      // update filter
-      if ( my_filter_.isInitialized() )  {
-        bool diagnostics = true;
-        if (my_filter_.update(odom_active_, imu_active_,gps_active_, vo_active_,  filter_stamp_, diagnostics)){
-          
-          // output most recent estimate and relative covariance
-          my_filter_.getEstimate(output_);
-          pose_pub_.publish(output_);
-          ekf_sent_counter_++;
-          
-          // broadcast most recent estimate to TransformArray
-          StampedTransform tmp;
-          my_filter_.getEstimate(ros::Time(), tmp);
-          if(!vo_active_ && !gps_active_)
-            tmp.getOrigin().setZ(0.0);
-          odom_broadcaster_.sendTransform(StampedTransform(tmp, tmp.stamp_, output_frame_, base_footprint_frame_));
-          
-          if (debug_){
-            // write to file
-            ColumnVector estimate; 
-            my_filter_.getEstimate(estimate);
-            corr_file_ << fixed << setprecision(5)<<ros::Time::now().toSec()<<" ";
-            
-            for (unsigned int i=1; i<=6; i++)
-            corr_file_ << estimate(i) << " ";
-            corr_file_ << endl;
-          }
-        }
-        if (self_diagnose_ && !diagnostics)
-          ROS_WARN("Robot pose ekf diagnostics discovered a potential problem");
-      }
+      // update filter, unless the imu callback is already doing so
+      if ( my_filter_.isInitialized() && !(imu_driven_ && imu_active_) )
+        updateFilter();
 
 
       // initialize filer with odometry frame
@@ -469,6 +458,56 @@ namespace estimation
   };
 
 
+  void OdomEstimationNode::updateFilter()
+  {
+    bool diagnostics = true;
+    if (my_filter_.update(odom_active_, imu_active_,gps_active_, vo_active_,  filter_stamp_, diagnostics)){
+      if (imu_driven_)
+        publish_pending_ = true;
+      else
+        publishEstimate();
+    }
+    if (self_diagnose_ && !diagnostics)
+      ROS_WARN("Robot pose ekf diagnostics discovered a potential problem");
+  };
+
+
+  void OdomEstimationNode::publishEstimate()
+  {
+    // output most recent estimate and relative covariance
+    my_filter_.getEstimate(output_);
+    pose_pub_.publish(output_);
+    ekf_sent_counter_++;
+
+    // broadcast most recent estimate to TransformArray
+    StampedTransform tmp;
+    my_filter_.getEstimate(ros::Time(), tmp);
+    if(!vo_active_ && !gps_active_)
+      tmp.getOrigin().setZ(0.0);
+    odom_broadcaster_.sendTransform(StampedTransform(tmp, tmp.stamp_, output_frame_, base_footprint_frame_));
+
+    if (debug_){
+      // write to file
+      ColumnVector estimate; 
+      my_filter_.getEstimate(estimate);
+      corr_file_ << fixed << setprecision(5)<<ros::Time::now().toSec()<<" ";
+
+      for (unsigned int i=1; i<=6; i++)
+        corr_file_ << estimate(i) << " ";
+      corr_file_ << endl;
+    }
+  };
+
+
+  void OdomEstimationNode::publishTimer(const ros::TimerEvent& e)
+  {
+    if (!publish_pending_)
+      return;
+    publish_pending_ = false;
+    publishEstimate();
+  };
+
+
 bool OdomEstimationNode::getStatus(robot_pose_ekf::GetStatus::Request& req, robot_pose_ekf::GetStatus::Response& resp)
 {
   stringstream ss;
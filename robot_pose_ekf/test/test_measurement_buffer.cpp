@@ -0,0 +1,98 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+
+#include <gtest/gtest.h>
+#include <robot_pose_ekf/measurement_buffer.h>
+
+using namespace estimation;
+
+tf::Transform meas(double x, double yaw)
+{
+  return tf::Transform(tf::createQuaternionFromYaw(yaw), tf::Vector3(x, 0, 0));
+}
+
+TEST(MeasurementBuffer, interpolateAndExtrapolate)
+{
+  MeasurementBuffer buffer(ros::Duration(10.0), 2);
+  tf::Transform m;
+  ros::Time t;
+  EXPECT_FALSE(buffer.lookup(ros::Time(1.0), m, t));
+
+  // a single measurement is only found at its own time
+  buffer.insert(ros::Time(1.0), meas(1.0, 0.0));
+  EXPECT_TRUE(buffer.lookup(ros::Time(1.0), m, t));
+  EXPECT_FALSE(buffer.lookup(ros::Time(1.5), m, t));
+
+  // grows past the initial capacity, but keeps only max_age of history
+  for (int i = 2; i <= 20; i++)
+    buffer.insert(ros::Time(i), meas(i, 0.1 * i));
+  EXPECT_EQ(11u, buffer.size());
+  EXPECT_FALSE(buffer.lookup(ros::Time(9.5), m, t));
+  EXPECT_FALSE(buffer.lookup(ros::Time(20.5), m, t));
+
+  EXPECT_TRUE(buffer.lookup(ros::Time(12.25), m, t));
+  EXPECT_NEAR(12.25, m.getOrigin().x(), 1e-9);
+  EXPECT_NEAR(1.225, tf::getYaw(m.getRotation()), 1e-9);
+
+  EXPECT_TRUE(buffer.lookup(ros::Time(), m, t));
+  EXPECT_EQ(ros::Time(20.0), t);
+}
+
+TEST(MeasurementBuffer, outOfOrder)
+{
+  MeasurementBuffer buffer(ros::Duration(10.0), 2);
+  tf::Transform m;
+  ros::Time t;
+  for (int i = 10; i <= 20; i++)
+    buffer.insert(ros::Time(i), meas(i, 0.0));
+
+  buffer.insert(ros::Time(15.5), meas(100.0, 0.0));
+  EXPECT_TRUE(buffer.lookup(ros::Time(15.5), m, t));
+  EXPECT_EQ(100.0, m.getOrigin().x());
+  EXPECT_TRUE(buffer.lookup(ros::Time(16.0), m, t));
+  EXPECT_EQ(16.0, m.getOrigin().x());
+
+  // same stamp replaces, too old is dropped
+  buffer.insert(ros::Time(16.0), meas(7.0, 0.0));
+  EXPECT_TRUE(buffer.lookup(ros::Time(16.0), m, t));
+  EXPECT_EQ(7.0, m.getOrigin().x());
+  buffer.insert(ros::Time(2.0), meas(7.0, 0.0));
+  EXPECT_EQ(12u, buffer.size());
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
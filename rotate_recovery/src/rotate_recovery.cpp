@@ -113,8 +113,13 @@ void RotateRecovery::runBehavior(){
 
     double x = global_pose.getOrigin().x(), y = global_pose.getOrigin().y();
 
-    //check if that velocity is legal by forward simulating
+    //the ring the footprint sweeps over a full turn is checked in one pass, the remaining
+    //rotation is only simulated step by step when the ring comes close to an obstacle
     double sim_angle = 0.0;
+    if(world_model_->sweptFootprintCost(x, y, local_costmap_->getRobotFootprint()) >= 0.0)
+      sim_angle = dist_left;
+
+    //check if that velocity is legal by forward simulating
     while(sim_angle < dist_left){
       double theta = tf::getYaw(global_pose.getRotation()) + sim_angle;
 
@@ -44,6 +44,7 @@
 #include <math.h>
 #include <limits.h>
 #include <algorithm>
+#include <vector>
 #include <ros/console.h>
 #include <ros/assert.h>
 
@@ -51,6 +52,9 @@
 /**
  * @class VoxelGrid
  * @brief A 3D grid sturcture that stores points as an integer array. X and Y index the array and Z selects which bit of the integer is used giving a limit of 16 vertical cells.
+ *
+ * Grids with more than 16 vertical cells store each column in a 64 bit integer instead, which allows up to 32 cells.
+ * Sparse grids only allocate storage for the parts of the grid that have been written, see setSparse().
  */
 namespace voxel_grid {
   enum VoxelStatus {
@@ -59,13 +63,167 @@ namespace voxel_grid {
     MARKED = 2,
   };
 
+  /**
+   * @brief  The layout of a column of voxels stored in an unsigned integer type
+   *
+   * The low half holds one bit per voxel that is set while the voxel is unknown or marked,
+   * the high half one bit per voxel that is set while it is marked.
+   */
+  template <class Column>
+    struct ColumnTraits {
+      static const unsigned int HEIGHT = sizeof(Column) * 4; ///< @brief The number of voxels in a column
+
+      static inline Column mask(unsigned int z){
+        return ((Column)1 << z << HEIGHT) | ((Column)1 << z);
+      }
+
+      static inline Column unknownColumn(){
+        return ~((Column)0) >> HEIGHT;
+      }
+
+      static inline Column markedBits(Column col){
+        return col >> HEIGHT;
+      }
+
+      static inline Column unknownBits(Column col){
+        return (col >> HEIGHT) ^ (col & unknownColumn());
+      }
+    };
+
+  static inline unsigned int numBits(uint32_t n){
+#ifdef __GNUC__
+    return __builtin_popcount(n);
+#else
+    unsigned int bit_count;
+    for(bit_count = 0; n; ++bit_count){
+      n &= n - 1; //clear the least significant bit set
+    }
+    return bit_count;
+#endif
+  }
+
+  static inline unsigned int numBits(uint64_t n){
+#ifdef __GNUC__
+    return __builtin_popcountll(n);
+#else
+    return numBits((uint32_t)n) + numBits((uint32_t)(n >> 32));
+#endif
+  }
+
+  /**
+   * @brief  Columns stored in bricks of consecutive columns that are allocated when they are first written
+   *
+   * Columns in bricks that were never written read as unknown. Bricks can be allocated from several
+   * threads at once, as long as the threads write disjoint columns.
+   */
+  template <class Column>
+    class SparseColumns {
+      public:
+        static const unsigned int BRICK_BITS = 6;
+        static const unsigned int BRICK_SIZE = 1 << BRICK_BITS; ///< @brief The number of columns in a brick
+
+        SparseColumns() : size_(0) {}
+
+        ~SparseColumns(){
+          reset();
+        }
+
+        /** @brief Set the number of columns, all columns are unknown afterwards */
+        void resize(unsigned int size){
+          reset();
+          size_ = size;
+          bricks_.assign((size + BRICK_SIZE - 1) >> BRICK_BITS, (Column*)NULL);
+        }
+
+        /** @brief Release all bricks, which makes every column unknown */
+        void reset(){
+          for(unsigned int i = 0; i < bricks_.size(); ++i){
+            delete[] bricks_[i];
+            bricks_[i] = NULL;
+          }
+        }
+
+        unsigned int size() const {return size_;}
+
+        /** @brief The number of columns that have storage */
+        unsigned int allocatedColumns() const {
+          unsigned int count = 0;
+          for(unsigned int i = 0; i < bricks_.size(); ++i){
+            if(bricks_[i])
+              count += BRICK_SIZE;
+          }
+          return count;
+        }
+
+        /** @brief Read a column without allocating its brick */
+        inline Column get(unsigned int index) const {
+          const Column* brick = bricks_[index >> BRICK_BITS];
+          return brick ? brick[index & (BRICK_SIZE - 1)] : ColumnTraits<Column>::unknownColumn();
+        }
+
+        /** @brief Access a column for writing, its brick is allocated if needed */
+        inline Column& operator[](unsigned int index){
+          Column* brick = bricks_[index >> BRICK_BITS];
+          if(!brick)
+            brick = allocate(index >> BRICK_BITS);
+          return brick[index & (BRICK_SIZE - 1)];
+        }
+
+        /**
+         * @brief  Move the columns of a size_x by size_y grid, see VoxelGrid::shift()
+         */
+        void shift(unsigned int size_x, unsigned int size_y, int cell_ox, int cell_oy){
+          SparseColumns<Column> shifted;
+          shifted.resize(size_);
+          for(unsigned int b = 0; b < bricks_.size(); ++b){
+            if(!bricks_[b])
+              continue;
+
+            unsigned int end = std::min(size_, (b + 1) << BRICK_BITS);
+            for(unsigned int index = b << BRICK_BITS; index < end; ++index){
+              Column col = bricks_[b][index & (BRICK_SIZE - 1)];
+              if(col == ColumnTraits<Column>::unknownColumn())
+                continue;
+
+              int x = int(index % size_x) - cell_ox;
+              int y = int(index / size_x) - cell_oy;
+              if(x >= 0 && x < int(size_x) && y >= 0 && y < int(size_y))
+                shifted[y * size_x + x] = col;
+            }
+          }
+          bricks_.swap(shifted.bricks_);
+        }
+
+      private:
+        SparseColumns(const SparseColumns&);
+        SparseColumns& operator=(const SparseColumns&);
+
+        Column* allocate(unsigned int b){
+          Column* brick = new Column[BRICK_SIZE];
+          std::fill(brick, brick + BRICK_SIZE, ColumnTraits<Column>::unknownColumn());
+#ifdef __GNUC__
+          //another thread may have allocated the brick in the meantime, the first one wins
+          if(!__sync_bool_compare_and_swap(&bricks_[b], (Column*)NULL, brick)){
+            delete[] brick;
+            return bricks_[b];
+          }
+#else
+          bricks_[b] = brick;
+#endif
+          return brick;
+        }
+
+        unsigned int size_;
+        std::vector<Column*> bricks_;
+    };
+
   class VoxelGrid{
     public:
       /**
        * @brief  Constructor for a voxel grid
        * @param size_x The x size of the grid
        * @param size_y The y size of the grid
-       * @param size_z The z size of the grid, only sizes <= 16 are supported
+       * @param size_z The z size of the grid, sizes up to 16 use 32 bit columns, only sizes <= 32 are supported
        */
       VoxelGrid(unsigned int size_x, unsigned int size_y, unsigned int size_z);
 
@@ -75,20 +233,71 @@ namespace voxel_grid {
        * @brief  Resizes a voxel grid to the desired size
        * @param size_x The x size of the grid
        * @param size_y The y size of the grid
-       * @param size_z The z size of the grid, only sizes <= 16 are supported
+       * @param size_z The z size of the grid, sizes up to 16 use 32 bit columns, only sizes <= 32 are supported
        */
       void resize(unsigned int size_x, unsigned int size_y, unsigned int size_z);
 
       void reset();
+
+      /**
+       * @brief  Choose between dense storage and storage in bricks that are allocated on demand
+       *
+       * Sparse grids use memory in proportion to the observed part of the grid, which suits large maps
+       * that are mostly unknown. Changing the storage makes every voxel unknown.
+       */
+      void setSparse(bool sparse);
+
+      bool isSparse() const {return sparse_;}
+
+      /** @brief The number of columns that have storage, all of them for dense grids */
+      unsigned int allocatedColumns() const;
+
+      /** @brief The columns of a dense grid with 32 bit columns, NULL otherwise */
       uint32_t* getData() {return data_;}
 
+      /** @brief The columns of a dense grid with 64 bit columns, NULL otherwise */
+      uint64_t* getData64() {return data64_;}
+
+      /** @brief The number of voxels a column can hold, the bits above sizeZ() count as unknown */
+      unsigned int columnHeight() const {
+        return tallColumns() ? ColumnTraits<uint64_t>::HEIGHT : ColumnTraits<uint32_t>::HEIGHT;
+      }
+
+      /** @brief The number of 32 bit words needed for copyData() */
+      unsigned int dataWords() const {
+        return size_x_ * size_y_ * (tallColumns() ? 2 : 1);
+      }
+
+      /**
+       * @brief  Move the columns so that column (x, y) holds the old column (x + cell_ox, y + cell_oy)
+       *
+       * Columns that are moved in from outside the grid are unknown.
+       */
+      void shift(int cell_ox, int cell_oy);
+
+      /**
+       * @brief  Copy the columns into 32 bit words, the layout read by the static getVoxel()
+       *
+       * 64 bit columns are split into their low and high word, in that order.
+       */
+      void copyData(uint32_t* words) const;
+
+      /**
+       * @brief  Copy the columns of a region in the layout of copyData(), row by row
+       *
+       * The region must lie within the grid.
+       */
+      void copyData(uint32_t* words, unsigned int x, unsigned int y, unsigned int width, unsigned int height) const;
+
       inline void markVoxel(unsigned int x, unsigned int y, unsigned int z){
         if(x >= size_x_ || y >= size_y_ || z >= size_z_){
           ROS_DEBUG("Error, voxel out of bounds.\n");
           return;
         }
-        uint32_t full_mask = ((uint32_t)1<<z<<16) | (1<<z);
-        data_[y * size_x_ + x] |= full_mask; //clear unknown and mark cell
+        if(tallColumns())
+          *column64(y * size_x_ + x) |= ColumnTraits<uint64_t>::mask(z); //clear unknown and mark cell
+        else
+          *column32(y * size_x_ + x) |= ColumnTraits<uint32_t>::mask(z); //clear unknown and mark cell
       }
 
       inline bool markVoxelInMap(unsigned int x, unsigned int y, unsigned int z, unsigned int marked_threshold){
@@ -98,14 +307,9 @@ namespace voxel_grid {
         }
 
         int index = y * size_x_ + x;
-        uint32_t* col = &data_[index];
-        uint32_t full_mask = ((uint32_t)1<<z<<16) | (1<<z);
-        *col |= full_mask; //clear unknown and mark cell
-
-        unsigned int marked_bits = *col>>16;
-
-        //make sure the number of bits in each is below our thesholds
-        return !bitsBelowThreshold(marked_bits, marked_threshold);
+        if(tallColumns())
+          return markVoxelInMap(column64(index), z, marked_threshold);
+        return markVoxelInMap(column32(index), z, marked_threshold);
       }
 
       inline void clearVoxel(unsigned int x, unsigned int y, unsigned int z){
@@ -113,53 +317,54 @@ namespace voxel_grid {
           ROS_DEBUG("Error, voxel out of bounds.\n");
           return;
         }
-        uint32_t full_mask = ((uint32_t)1<<z<<16) | (1<<z);
-        data_[y * size_x_ + x] &= ~(full_mask); //clear unknown and clear cell
+        if(tallColumns())
+          *column64(y * size_x_ + x) &= ~ColumnTraits<uint64_t>::mask(z); //clear unknown and clear cell
+        else
+          *column32(y * size_x_ + x) &= ~ColumnTraits<uint32_t>::mask(z); //clear unknown and clear cell
       }
 
       inline void clearVoxelColumn(unsigned int index){
         ROS_ASSERT(index < size_x_ * size_y_);
-        data_[index] = 0;
+        if(tallColumns())
+          *column64(index) = 0;
+        else
+          *column32(index) = 0;
       }
 
+      /**
+       * @brief  Make a run of consecutive columns completely free
+       * @param  index The index of the first column
+       * @param  count The number of columns
+       */
+      void clearVoxelColumns(unsigned int index, unsigned int count);
+
       inline void clearVoxelInMap(unsigned int x, unsigned int y, unsigned int z){
         if(x >= size_x_ || y >= size_y_ || z >= size_z_){
           ROS_DEBUG("Error, voxel out of bounds.\n");
           return;
         }
         int index = y * size_x_ + x;
-        uint32_t* col = &data_[index];
-        uint32_t full_mask = ((uint32_t)1<<z<<16) | (1<<z);
-        *col &= ~(full_mask); //clear unknown and clear cell
-
-        unsigned int unknown_bits = uint16_t(*col>>16) ^ uint16_t(*col);
-        unsigned int marked_bits = *col>>16;
-
-        //make sure the number of bits in each is below our thesholds
-        if(bitsBelowThreshold(unknown_bits, 1) && bitsBelowThreshold(marked_bits, 1))
+        bool free = tallColumns() ? clearVoxelInColumn(column64(index), z)
+          : clearVoxelInColumn(column32(index), z);
+        if(free)
           costmap[index] = 0;
       }
 
-      inline bool bitsBelowThreshold(unsigned int n, unsigned int bit_threshold){
-        unsigned int bit_count;
-        for(bit_count = 0; n;){
-          ++bit_count;
-          if(bit_count > bit_threshold)
-            return false;
-          n &= n - 1; //clear the least significant bit set
-        }
-        return true;
+      static inline bool bitsBelowThreshold(uint32_t n, unsigned int bit_threshold){
+        return voxel_grid::numBits(n) <= bit_threshold;
       }
 
-      static inline unsigned int numBits(unsigned int n){
-        unsigned int bit_count;
-        for(bit_count = 0; n; ++bit_count){
-          n &= n - 1; //clear the least significant bit set
-        }
-        return bit_count;
+      static inline bool bitsBelowThreshold(uint64_t n, unsigned int bit_threshold){
+        return voxel_grid::numBits(n) <= bit_threshold;
+      }
 
+      static inline unsigned int numBits(unsigned int n){
+        return voxel_grid::numBits((uint32_t)n);
       }
 
+      /**
+       * @brief  Get the status of a voxel from the columns of a grid, as copied by copyData()
+       */
       static VoxelStatus getVoxel(unsigned int x, unsigned int y, unsigned int z,
           unsigned int size_x, unsigned int size_y, unsigned int size_z, const uint32_t* data)
       {
@@ -167,9 +372,14 @@ namespace voxel_grid {
           ROS_DEBUG("Error, voxel out of bounds. (%d, %d, %d)\n", x, y, z);
           return UNKNOWN;
         }
-        uint32_t full_mask = ((uint32_t)1<<z<<16) | (1<<z);
-        uint32_t result = data[y * size_x + x] & full_mask;
-        unsigned int bits = numBits(result);
+        unsigned int index = y * size_x + x;
+        unsigned int bits;
+        if(size_z > ColumnTraits<uint32_t>::HEIGHT){
+          uint64_t col = data[2 * index] | ((uint64_t)data[2 * index + 1] << 32);
+          bits = voxel_grid::numBits(col & ColumnTraits<uint64_t>::mask(z));
+        }
+        else
+          bits = voxel_grid::numBits(data[index] & ColumnTraits<uint32_t>::mask(z));
 
         // known marked: 11 = 2 bits, unknown: 01 = 1 bit, known free: 00 = 0 bits
         if(bits < 2){
@@ -188,6 +398,55 @@ namespace voxel_grid {
           unsigned int unknown_threshold, unsigned int mark_threshold, 
           unsigned char free_cost = 0, unsigned char unknown_cost = 255, unsigned int max_length = UINT_MAX);
 
+      /**
+       * @brief  Like clearVoxelLineInMap(), but only the columns with an index in [min_index, max_index) are changed
+       *
+       * Lines can be cleared from several threads at once as long as the threads own disjoint ranges of columns.
+       */
+      void clearVoxelLineInMapRange(double x0, double y0, double z0, double x1, double y1, double z1,
+          unsigned char *map_2d, unsigned int unknown_threshold, unsigned int mark_threshold,
+          unsigned char free_cost, unsigned char unknown_cost, unsigned int max_length,
+          unsigned int min_index, unsigned int max_index);
+
+      /**
+       * @brief  Clear many lines that start at the same point, see clearVoxelLine()
+       * @param  ends The x, y and z coordinates of the end of each line, one after the other
+       * @param  count The number of lines
+       */
+      void clearVoxelLines(double x0, double y0, double z0, const double* ends, unsigned int count,
+          unsigned int max_length = UINT_MAX);
+
+      /**
+       * @brief  Clear many lines that start at the same point, see clearVoxelLineInMap()
+       * @param  ends The x, y and z coordinates of the end of each line, one after the other
+       * @param  count The number of lines
+       */
+      void clearVoxelLinesInMap(double x0, double y0, double z0, const double* ends, unsigned int count,
+          unsigned char *map_2d, unsigned int unknown_threshold, unsigned int mark_threshold,
+          unsigned char free_cost = 0, unsigned char unknown_cost = 255, unsigned int max_length = UINT_MAX,
+          unsigned int min_index = 0, unsigned int max_index = UINT_MAX);
+
+      /**
+       * @brief  Like clearVoxelLineInMapRange(), but the columns the line crosses are only noted in a mask, and
+       * written into the map by projectColumns() afterwards
+       * @param  mask One entry per column, set to 1 for each column the line crosses
+       */
+      void clearVoxelLineMasked(double x0, double y0, double z0, double x1, double y1, double z1,
+          unsigned char* mask, unsigned int max_length = UINT_MAX,
+          unsigned int min_index = 0, unsigned int max_index = UINT_MAX);
+
+      /**
+       * @brief  Write the costs of a run of columns into a 2D map, as clearVoxelLineInMap() writes them
+       *
+       * Columns crossed by many lines cleared with clearVoxelLineMasked(), as near a sensor, are written once
+       * here instead of at every voxel cleared in them, 16 columns at a time on x86. Columns with more than
+       * mark_threshold marked voxels keep their cost.
+       * @param  mask Only columns with a non zero entry are written, their entries are reset to zero
+       */
+      void projectColumns(unsigned int index, unsigned int count, unsigned char* map_2d, unsigned char* mask,
+          unsigned int unknown_threshold, unsigned int mark_threshold,
+          unsigned char free_cost = 0, unsigned char unknown_cost = 255);
+
       VoxelStatus getVoxel(unsigned int x, unsigned int y, unsigned int z);
       VoxelStatus getVoxelColumn(unsigned int x, unsigned int y,
           unsigned int unknown_threshold = 0, unsigned int marked_threshold = 0); //Are there any obstacles at that (x, y) location in the grid?
@@ -198,9 +457,117 @@ namespace voxel_grid {
       unsigned int sizeY();
       unsigned int sizeZ();
 
+      /**
+       * @brief  Raytrace a line through a grid with 32 bit columns, the action gets the offset and z mask of each voxel
+       */
       template <class ActionType>
         inline void raytraceLine(ActionType at, double x0, double y0, double z0,
             double x1, double y1, double z1, unsigned int max_length = UINT_MAX){
+          traceLine<uint32_t>(at, x0, y0, z0, x1, y1, z1, max_length);
+        }
+
+    private:
+      void allocate();
+
+      bool tallColumns() const {
+        return size_z_ > ColumnTraits<uint32_t>::HEIGHT;
+      }
+
+      /** @brief The storage of a 32 bit column for writing, allocated on demand in sparse grids */
+      inline uint32_t* column32(unsigned int index){
+        return sparse_ ? &sparse_data_[index] : &data_[index];
+      }
+
+      /** @brief The storage of a 64 bit column for writing, allocated on demand in sparse grids */
+      inline uint64_t* column64(unsigned int index){
+        return sparse_ ? &sparse_data64_[index] : &data64_[index];
+      }
+
+      /** @brief Read a 32 bit column without allocating storage for it */
+      inline uint32_t readColumn32(unsigned int index) const {
+        return sparse_ ? sparse_data_.get(index) : data_[index];
+      }
+
+      /** @brief Read a 64 bit column without allocating storage for it */
+      inline uint64_t readColumn64(unsigned int index) const {
+        return sparse_ ? sparse_data64_.get(index) : data64_[index];
+      }
+
+      template <class Column>
+        static inline bool markVoxelInMap(Column* col, unsigned int z, unsigned int marked_threshold){
+          *col |= ColumnTraits<Column>::mask(z); //clear unknown and mark cell
+
+          //make sure the number of bits in each is below our thesholds
+          return !bitsBelowThreshold(ColumnTraits<Column>::markedBits(*col), marked_threshold);
+        }
+
+      /** @brief Clear a voxel, returns whether its column is completely free afterwards */
+      template <class Column>
+        static inline bool clearVoxelInColumn(Column* col, unsigned int z){
+          *col &= ~ColumnTraits<Column>::mask(z); //clear unknown and clear cell
+
+          //make sure the number of bits in each is below our thesholds
+          return bitsBelowThreshold(ColumnTraits<Column>::unknownBits(*col), 1)
+            && bitsBelowThreshold(ColumnTraits<Column>::markedBits(*col), 1);
+        }
+
+      /** @brief Write the cost of a column into a cell of a 2D map unless it counts as marked */
+      template <class Column>
+        static inline void projectColumn(Column col, unsigned char* cost, unsigned int unknown_threshold,
+            unsigned int mark_threshold, unsigned char free_cost, unsigned char unknown_cost){
+          if(bitsBelowThreshold(ColumnTraits<Column>::markedBits(col), mark_threshold))
+            *cost = bitsBelowThreshold(ColumnTraits<Column>::unknownBits(col), unknown_threshold) ? free_cost : unknown_cost;
+        }
+
+      template <class Column>
+        VoxelStatus getColumnStatus(Column col, unsigned int unknown_threshold, unsigned int marked_threshold){
+          //check if the number of marked bits qualifies the col as marked
+          if(!bitsBelowThreshold(ColumnTraits<Column>::markedBits(col), marked_threshold)){
+            return MARKED;
+          }
+
+          //check if the number of unkown bits qualifies the col as unknown
+          if(!bitsBelowThreshold(ColumnTraits<Column>::unknownBits(col), unknown_threshold))
+            return UNKNOWN;
+
+          return FREE;
+        }
+
+      template <class Column, class Storage>
+        void clearLines(Storage data, double x0, double y0, double z0, const double* ends, unsigned int count,
+            unsigned int max_length){
+          ClearVoxel<Column, Storage> cv(data);
+          for(unsigned int i = 0; i < count; ++i, ends += 3){
+            if(ends[0] >= size_x_ || ends[1] >= size_y_ || ends[2] >= size_z_){
+              ROS_DEBUG("Error, line endpoint out of bounds. (%.2f, %.2f, %.2f) to (%.2f, %.2f, %.2f),  size: (%d, %d, %d)",
+                  x0, y0, z0, ends[0], ends[1], ends[2], size_x_, size_y_, size_z_);
+              continue;
+            }
+            traceLine<Column>(cv, x0, y0, z0, ends[0], ends[1], ends[2], max_length);
+          }
+        }
+
+      template <class Column, class Storage>
+        void clearLinesInMap(Storage data, double x0, double y0, double z0, const double* ends, unsigned int count,
+            unsigned char *map_2d, unsigned int unknown_threshold, unsigned int mark_threshold,
+            unsigned char free_cost, unsigned char unknown_cost, unsigned int max_length,
+            unsigned int min_index, unsigned int max_index){
+          //the functor is set up once and shared by all lines
+          ClearVoxelInMap<Column, Storage> cvm(data, map_2d, unknown_threshold, mark_threshold, free_cost, unknown_cost,
+              min_index, max_index);
+          for(unsigned int i = 0; i < count; ++i, ends += 3){
+            if(ends[0] >= size_x_ || ends[1] >= size_y_ || ends[2] >= size_z_){
+              ROS_DEBUG("Error, line endpoint out of bounds. (%.2f, %.2f, %.2f) to (%.2f, %.2f, %.2f),  size: (%d, %d, %d)",
+                  x0, y0, z0, ends[0], ends[1], ends[2], size_x_, size_y_, size_z_);
+              continue;
+            }
+            traceLine<Column>(cvm, x0, y0, z0, ends[0], ends[1], ends[2], max_length);
+          }
+        }
+
+      template <class Column, class ActionType>
+        inline void traceLine(ActionType at, double x0, double y0, double z0,
+            double x1, double y1, double z1, unsigned int max_length = UINT_MAX){
 
           int dx = int(x1) - int(x0);
           int dy = int(y1) - int(y0);
@@ -214,11 +581,11 @@ namespace voxel_grid {
           int offset_dy = sign(dy) * size_x_;
           int offset_dz = sign(dz);
 
-          unsigned int z_mask = ((1 << 16) | 1) << (unsigned int)z0;
+          Column z_mask = ColumnTraits<Column>::mask((unsigned int)z0);
           unsigned int offset = (unsigned int)y0 * size_x_ + (unsigned int)x0;
 
           GridOffset grid_off(offset);
-          ZOffset z_off(z_mask);
+          ZOffset<Column> z_off(z_mask);
 
           //we need to chose how much to scale our dominant dimension, based on the maximum length of the line
           double dist = sqrt((x0 - x1) * (x0 - x1) + (y0 - y1) * (y0 - y1) + (z0 - z1) * (z0 - z1));
@@ -247,17 +614,15 @@ namespace voxel_grid {
           int error_x = abs_dz / 2;
           int error_y = abs_dz / 2;
 
-          bresenham3D(at, z_off, grid_off, grid_off, abs_dz, abs_dx, abs_dy, error_x, error_y, offset_dz, offset_dx, offset_dy, offset, z_mask, (unsigned int)(scale * abs_dz));
+          bresenhamColumns(at, abs_dz, abs_dx, abs_dy, error_x, error_y, offset_dz, offset_dx, offset_dy, offset, z_mask, (unsigned int)(scale * abs_dz));
         }
 
-    private:
-
       //the real work is done here... 3D bresenham implementation
-      template <class ActionType, class OffA, class OffB, class OffC>
+      template <class ActionType, class OffA, class OffB, class OffC, class Column>
         inline void bresenham3D(ActionType at, OffA off_a, OffB off_b, OffC off_c,
             unsigned int abs_da, unsigned int abs_db, unsigned int abs_dc,
             int error_b, int error_c, int offset_a, int offset_b, int offset_c, unsigned int &offset,
-            unsigned int &z_mask, unsigned int max_length = UINT_MAX){
+            Column &z_mask, unsigned int max_length = UINT_MAX){
           unsigned int end = std::min(max_length, abs_da);
           for(unsigned int i = 0; i < end; ++i){
             at(offset, z_mask);
@@ -276,6 +641,43 @@ namespace voxel_grid {
           at(offset, z_mask);
         }
 
+      /**
+       * @brief  The 3D bresenham for lines that are dominant in z
+       *
+       * Such lines take several steps in the same column. The z masks of those steps are
+       * combined so the action is applied once per column with all of the bits at once.
+       */
+      template <class ActionType, class Column>
+        inline void bresenhamColumns(ActionType at, unsigned int abs_dz, unsigned int abs_dx, unsigned int abs_dy,
+            int error_x, int error_y, int offset_dz, int offset_dx, int offset_dy, unsigned int offset,
+            Column z_mask, unsigned int max_length = UINT_MAX){
+          unsigned int end = std::min(max_length, abs_dz);
+          Column run_mask = 0;
+          for(unsigned int i = 0; i < end; ++i){
+            run_mask |= z_mask;
+            z_mask = offset_dz > 0 ? z_mask << 1 : z_mask >> 1;
+            error_x += abs_dx;
+            error_y += abs_dy;
+            bool step_x = (unsigned int)error_x >= abs_dz;
+            bool step_y = (unsigned int)error_y >= abs_dz;
+            if(!step_x && !step_y)
+              continue;
+
+            //the line leaves the column, apply the bits collected in it
+            at(offset, run_mask);
+            run_mask = 0;
+            if(step_x){
+              offset += offset_dx;
+              error_x -= abs_dz;
+            }
+            if(step_y){
+              offset += offset_dy;
+              error_y -= abs_dz;
+            }
+          }
+          at(offset, run_mask | z_mask);
+        }
+
       inline int sign(int i){
         return i > 0 ? 1 : -1;
       }
@@ -286,66 +688,84 @@ namespace voxel_grid {
 
       unsigned int size_x_, size_y_, size_z_;
       uint32_t *data_;
+      uint64_t *data64_; ///< @brief Used instead of data_ for grids that are taller than 16 cells
+      bool sparse_; ///< @brief Whether the columns are kept in sparse_data_ or sparse_data64_ instead
+      SparseColumns<uint32_t> sparse_data_;
+      SparseColumns<uint64_t> sparse_data64_;
       unsigned char *costmap;
 
       //Aren't functors so much fun... used to recreate the Bresenham macro Eric wrote in the original version, but in "proper" c++
+      //the storage is a plain array of columns or a reference to the SparseColumns of a sparse grid
+      template <class Column, class Storage = Column*>
       class MarkVoxel {
         public:
-          MarkVoxel(uint32_t* data): data_(data){}
-          inline void operator()(unsigned int offset, unsigned int z_mask){
+          MarkVoxel(Storage data): data_(data){}
+          inline void operator()(unsigned int offset, Column z_mask){
             data_[offset] |= z_mask; //clear unknown and mark cell
           }
         private:
-          uint32_t* data_;
+          Storage data_;
       };
 
+      template <class Column, class Storage = Column*>
       class ClearVoxel {
         public:
-          ClearVoxel(uint32_t* data): data_(data){}
-          inline void operator()(unsigned int offset, unsigned int z_mask){
+          ClearVoxel(Storage data): data_(data){}
+          inline void operator()(unsigned int offset, Column z_mask){
+            data_[offset] &= ~(z_mask); //clear unknown and clear cell
+          }
+        private:
+          Storage data_;
+      };
+
+      template <class Column, class Storage = Column*>
+      class ClearVoxelMasked {
+        public:
+          ClearVoxelMasked(Storage data, unsigned char* mask, unsigned int min_index, unsigned int max_index):
+            data_(data), mask_(mask), min_index_(min_index), max_index_(max_index){}
+          inline void operator()(unsigned int offset, Column z_mask){
+            if(offset < min_index_ || offset >= max_index_)
+              return;
+
             data_[offset] &= ~(z_mask); //clear unknown and clear cell
+            mask_[offset] = 1;
           }
         private:
-          uint32_t* data_;
+          Storage data_;
+          unsigned char* mask_;
+          unsigned int min_index_, max_index_;
       };
 
+      template <class Column, class Storage = Column*>
       class ClearVoxelInMap {
         public:
-          ClearVoxelInMap(uint32_t* data, unsigned char *costmap,
+          ClearVoxelInMap(Storage data, unsigned char *costmap,
               unsigned int unknown_clear_threshold, unsigned int marked_clear_threshold, 
-              unsigned char free_cost = 0, unsigned char unknown_cost = 255): data_(data), costmap_(costmap),
+              unsigned char free_cost = 0, unsigned char unknown_cost = 255,
+              unsigned int min_index = 0, unsigned int max_index = UINT_MAX): data_(data), costmap_(costmap),
         unknown_clear_threshold_(unknown_clear_threshold), marked_clear_threshold_(marked_clear_threshold), 
-        free_cost_(free_cost), unknown_cost_(unknown_cost){}
-          inline void operator()(unsigned int offset, unsigned int z_mask){
-            uint32_t* col = &data_[offset];
-            *col &= ~(z_mask); //clear unknown and clear cell
+        free_cost_(free_cost), unknown_cost_(unknown_cost), min_index_(min_index), max_index_(max_index){}
+          inline void operator()(unsigned int offset, Column z_mask){
+            if(offset < min_index_ || offset >= max_index_)
+              return;
 
-            unsigned int unknown_bits = uint16_t(*col>>16) ^ uint16_t(*col);
-            unsigned int marked_bits = *col>>16;
+            Column* col = &data_[offset];
+            *col &= ~(z_mask); //clear unknown and clear cell
 
             //make sure the number of bits in each is below our thesholds
-            if(bitsBelowThreshold(marked_bits, marked_clear_threshold_)){
-              if(bitsBelowThreshold(unknown_bits, unknown_clear_threshold_))
+            if(bitsBelowThreshold(ColumnTraits<Column>::markedBits(*col), marked_clear_threshold_)){
+              if(bitsBelowThreshold(ColumnTraits<Column>::unknownBits(*col), unknown_clear_threshold_))
                 costmap_[offset] = free_cost_;
               else
                 costmap_[offset] = unknown_cost_;
             }
           }
         private:
-          inline bool bitsBelowThreshold(unsigned int n, unsigned int bit_threshold){
-            unsigned int bit_count;
-            for(bit_count = 0; n;){
-              ++bit_count;
-              if(bit_count > bit_threshold)
-                return false;
-              n &= n - 1; //clear the least significant bit set
-            }
-            return true;
-          }
-          uint32_t* data_;
+          Storage data_;
           unsigned char *costmap_;
           unsigned int unknown_clear_threshold_, marked_clear_threshold_;
           unsigned char free_cost_, unknown_cost_;
+          unsigned int min_index_, max_index_;
       };
 
       class GridOffset {
@@ -358,14 +778,15 @@ namespace voxel_grid {
           unsigned int &offset_;
       };
 
+      template <class Column>
       class ZOffset {
         public:
-          ZOffset(unsigned int &z_mask) : z_mask_(z_mask) {}
+          ZOffset(Column &z_mask) : z_mask_(z_mask) {}
           inline void operator()(int offset_val){
             offset_val > 0 ? z_mask_ <<= 1 : z_mask_ >>= 1;
           }
         private:
-          unsigned int & z_mask_;
+          Column & z_mask_;
       };
 
   };
@@ -37,26 +37,72 @@
 #include <voxel_grid/voxel_grid.h>
 #include <sys/time.h>
 #include <ros/console.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace voxel_grid {
+#ifdef __SSE2__
+  /** @brief The number of set bits of each 32 bit lane */
+  static inline __m128i popcount32(__m128i v){
+    const __m128i m1 = _mm_set1_epi32(0x55555555), m2 = _mm_set1_epi32(0x33333333), m4 = _mm_set1_epi32(0x0f0f0f0f);
+    v = _mm_sub_epi32(v, _mm_and_si128(_mm_srli_epi32(v, 1), m1));
+    v = _mm_add_epi32(_mm_and_si128(v, m2), _mm_and_si128(_mm_srli_epi32(v, 2), m2));
+    v = _mm_and_si128(_mm_add_epi32(v, _mm_srli_epi32(v, 4)), m4);
+    v = _mm_add_epi32(v, _mm_srli_epi32(v, 8));
+    v = _mm_add_epi32(v, _mm_srli_epi32(v, 16));
+    return _mm_and_si128(v, _mm_set1_epi32(0x3f));
+  }
+
+  /** @brief For 4 columns of 32 bits, whether each counts as marked, and the cost it gets otherwise */
+  static inline void projectColumns4(const uint32_t* columns, __m128i mark_threshold, __m128i unknown_threshold,
+      __m128i free_cost, __m128i unknown_cost, __m128i& marked, __m128i& cost){
+    __m128i col = _mm_loadu_si128((const __m128i*)columns);
+    __m128i marked_bits = _mm_srli_epi32(col, ColumnTraits<uint32_t>::HEIGHT);
+    __m128i unknown_bits = _mm_xor_si128(marked_bits, _mm_and_si128(col, _mm_set1_epi32(0xffff)));
+    marked = _mm_cmpgt_epi32(popcount32(marked_bits), mark_threshold);
+    __m128i unknown = _mm_cmpgt_epi32(popcount32(unknown_bits), unknown_threshold);
+    cost = _mm_or_si128(_mm_and_si128(unknown, unknown_cost), _mm_andnot_si128(unknown, free_cost));
+  }
+
+  /** @brief projectColumns() for dense 32 bit columns, 16 at a time, returns the index of the first column left */
+  static unsigned int projectColumns16(const uint32_t* data, unsigned int index, unsigned int end,
+      unsigned char* map_2d, unsigned char* mask, unsigned int unknown_threshold, unsigned int mark_threshold,
+      unsigned char free_cost, unsigned char unknown_cost){
+    const __m128i mark_t = _mm_set1_epi32(std::min(mark_threshold, 64u));
+    const __m128i unknown_t = _mm_set1_epi32(std::min(unknown_threshold, 64u));
+    const __m128i free_c = _mm_set1_epi32(free_cost), unknown_c = _mm_set1_epi32(unknown_cost);
+    const __m128i zero = _mm_setzero_si128();
+    for(; index + 16 <= end; index += 16){
+      __m128i touched = _mm_loadu_si128((const __m128i*)(mask + index));
+      __m128i untouched = _mm_cmpeq_epi8(touched, zero);
+      if(_mm_movemask_epi8(untouched) == 0xffff)
+        continue;
+
+      __m128i marked[4], cost[4];
+      for(unsigned int k = 0; k < 4; ++k)
+        projectColumns4(data + index + 4 * k, mark_t, unknown_t, free_c, unknown_c, marked[k], cost[k]);
+      __m128i keep = _mm_packs_epi16(_mm_packs_epi32(marked[0], marked[1]), _mm_packs_epi32(marked[2], marked[3]));
+      __m128i costs = _mm_packus_epi16(_mm_packs_epi32(cost[0], cost[1]), _mm_packs_epi32(cost[2], cost[3]));
+      keep = _mm_or_si128(keep, untouched);
+
+      __m128i old = _mm_loadu_si128((const __m128i*)(map_2d + index));
+      _mm_storeu_si128((__m128i*)(map_2d + index),
+          _mm_or_si128(_mm_and_si128(keep, old), _mm_andnot_si128(keep, costs)));
+      _mm_storeu_si128((__m128i*)(mask + index), zero);
+    }
+    return index;
+  }
+#endif
+
   VoxelGrid::VoxelGrid(unsigned int size_x, unsigned int size_y, unsigned int size_z)
+    : data_(NULL), data64_(NULL), sparse_(false)
   {
     size_x_ = size_x; 
     size_y_ = size_y; 
     size_z_ = size_z; 
 
-    if(size_z_ > 16){
-      ROS_INFO("Error, this implementation can only support up to 16 z values (%d)", size_z_); 
-      size_z_ = 16;
-    }
-
-    data_ = new uint32_t[size_x_ * size_y_];
-    uint32_t unknown_col = ~((uint32_t)0)>>16;
-    uint32_t* col = data_;
-    for(unsigned int i = 0; i < size_x_ * size_y_; ++i){
-      *col = unknown_col;
-      ++col;
-    }
+    allocate();
   }
 
   void VoxelGrid::resize(unsigned int size_x, unsigned int size_y, unsigned int size_z)
@@ -68,36 +114,175 @@ namespace voxel_grid {
     }
 
     delete[] data_;
+    delete[] data64_;
     size_x_ = size_x; 
     size_y_ = size_y; 
     size_z_ = size_z; 
 
-    if(size_z_ > 16){
-      ROS_INFO("Error, this implementation can only support up to 16 z values (%d)", size_z); 
-      size_z_ = 16;
+    allocate();
+  }
+
+  void VoxelGrid::setSparse(bool sparse)
+  {
+    if(sparse == sparse_)
+      return;
+
+    delete[] data_;
+    delete[] data64_;
+    sparse_ = sparse;
+    allocate();
+  }
+
+  unsigned int VoxelGrid::allocatedColumns() const
+  {
+    if(!sparse_)
+      return size_x_ * size_y_;
+    return tallColumns() ? sparse_data64_.allocatedColumns() : sparse_data_.allocatedColumns();
+  }
+
+  void VoxelGrid::allocate()
+  {
+    if(size_z_ > ColumnTraits<uint64_t>::HEIGHT){
+      ROS_INFO("Error, this implementation can only support up to 32 z values (%d)", size_z_); 
+      size_z_ = ColumnTraits<uint64_t>::HEIGHT;
     }
 
-    data_ = new uint32_t[size_x_ * size_y_];
-    uint32_t unknown_col = ~((uint32_t)0)>>16;
-    uint32_t* col = data_;
-    for(unsigned int i = 0; i < size_x_ * size_y_; ++i){
-      *col = unknown_col;
-      ++col;
+    //grids that fit use 32 bit columns, they take half the memory
+    data_ = NULL;
+    data64_ = NULL;
+    sparse_data_.resize(0);
+    sparse_data64_.resize(0);
+    if(sparse_){
+      if(tallColumns())
+        sparse_data64_.resize(size_x_ * size_y_);
+      else
+        sparse_data_.resize(size_x_ * size_y_);
+      return;
     }
+
+    if(tallColumns())
+      data64_ = new uint64_t[size_x_ * size_y_];
+    else
+      data_ = new uint32_t[size_x_ * size_y_];
+    reset();
   }
 
   VoxelGrid::~VoxelGrid()
   {
     delete [] data_;
+    delete [] data64_;
   }
 
   void VoxelGrid::reset(){
-    uint32_t unknown_col = ~((uint32_t)0)>>16;
-    uint32_t* col = data_;
-    for(unsigned int i = 0; i < size_x_ * size_y_; ++i){
-      *col = unknown_col;
-      ++col;
+    //sparse grids drop their storage, columns without storage are unknown
+    if(sparse_){
+      sparse_data_.reset();
+      sparse_data64_.reset();
+    }
+    else if(data64_)
+      std::fill(data64_, data64_ + size_x_ * size_y_, ColumnTraits<uint64_t>::unknownColumn());
+    else
+      std::fill(data_, data_ + size_x_ * size_y_, ColumnTraits<uint32_t>::unknownColumn());
+  }
+
+  void VoxelGrid::clearVoxelColumns(unsigned int index, unsigned int count){
+    ROS_ASSERT(index + count <= size_x_ * size_y_);
+    if(data_)
+      memset(data_ + index, 0, count * sizeof(uint32_t));
+    else if(data64_)
+      memset(data64_ + index, 0, count * sizeof(uint64_t));
+    else if(tallColumns()){
+      for(unsigned int i = index; i < index + count; ++i)
+        sparse_data64_[i] = 0;
+    }
+    else{
+      for(unsigned int i = index; i < index + count; ++i)
+        sparse_data_[i] = 0;
+    }
+  }
+
+  void VoxelGrid::copyData(uint32_t* words) const{
+    unsigned int size = size_x_ * size_y_;
+    if(data_){
+      memcpy(words, data_, size * sizeof(uint32_t));
+      return;
+    }
+
+    if(!tallColumns()){
+      for(unsigned int i = 0; i < size; ++i)
+        words[i] = readColumn32(i);
+      return;
+    }
+
+    for(unsigned int i = 0; i < size; ++i){
+      uint64_t col = readColumn64(i);
+      words[2 * i] = (uint32_t)col;
+      words[2 * i + 1] = (uint32_t)(col >> 32);
+    }
+  }
+
+  void VoxelGrid::copyData(uint32_t* words, unsigned int x, unsigned int y, unsigned int width, unsigned int height) const{
+    for(unsigned int j = 0; j < height; ++j){
+      unsigned int index = (y + j) * size_x_ + x;
+      if(data_){
+        memcpy(words, data_ + index, width * sizeof(uint32_t));
+        words += width;
+      }
+      else if(!tallColumns()){
+        for(unsigned int i = 0; i < width; ++i)
+          *words++ = readColumn32(index + i);
+      }
+      else{
+        for(unsigned int i = 0; i < width; ++i){
+          uint64_t col = readColumn64(index + i);
+          *words++ = (uint32_t)col;
+          *words++ = (uint32_t)(col >> 32);
+        }
+      }
+    }
+  }
+
+  template <class Column>
+    static void shiftColumns(Column* data, unsigned int size_x, unsigned int size_y, int cell_ox, int cell_oy){
+      Column fill_value = ColumnTraits<Column>::unknownColumn();
+      if(cell_ox <= -int(size_x) || cell_ox >= int(size_x) || cell_oy <= -int(size_y) || cell_oy >= int(size_y)){
+        std::fill(data, data + size_x * size_y, fill_value);
+        return;
+      }
+
+      //the columns of every row that keep data
+      unsigned int x0 = std::max(-cell_ox, 0);
+      unsigned int xn = size_x - std::max(cell_ox, 0);
+
+      //walk the rows so that no source row is overwritten before it is moved
+      int step = cell_oy >= 0 ? 1 : -1;
+      int y = step > 0 ? 0 : size_y - 1;
+      for(unsigned int i = 0; i < size_y; ++i, y += step){
+        Column* row = data + y * size_x;
+        int source_y = y + cell_oy;
+        if(source_y < 0 || source_y >= int(size_y)){
+          std::fill(row, row + size_x, fill_value);
+          continue;
+        }
+
+        memmove(row + x0, data + source_y * size_x + x0 + cell_ox, (xn - x0) * sizeof(Column));
+        std::fill(row, row + x0, fill_value);
+        std::fill(row + xn, row + size_x, fill_value);
+      }
     }
+
+  void VoxelGrid::shift(int cell_ox, int cell_oy){
+    if(cell_ox == 0 && cell_oy == 0)
+      return;
+
+    if(data_)
+      shiftColumns(data_, size_x_, size_y_, cell_ox, cell_oy);
+    else if(data64_)
+      shiftColumns(data64_, size_x_, size_y_, cell_ox, cell_oy);
+    else if(tallColumns())
+      sparse_data64_.shift(size_x_, size_y_, cell_ox, cell_oy);
+    else
+      sparse_data_.shift(size_x_, size_y_, cell_ox, cell_oy);
   }
 
   void VoxelGrid::markVoxelLine(double x0, double y0, double z0, double x1, double y1, double z1, unsigned int max_length){
@@ -107,8 +292,22 @@ namespace voxel_grid {
       return;
     }
 
-    MarkVoxel mv(data_);
-    raytraceLine(mv, x0, y0, z0, x1, y1, z1, max_length);
+    if(data64_){
+      MarkVoxel<uint64_t> mv(data64_);
+      traceLine<uint64_t>(mv, x0, y0, z0, x1, y1, z1, max_length);
+    }
+    else if(data_){
+      MarkVoxel<uint32_t> mv(data_);
+      traceLine<uint32_t>(mv, x0, y0, z0, x1, y1, z1, max_length);
+    }
+    else if(tallColumns()){
+      MarkVoxel<uint64_t, SparseColumns<uint64_t>&> mv(sparse_data64_);
+      traceLine<uint64_t>(mv, x0, y0, z0, x1, y1, z1, max_length);
+    }
+    else{
+      MarkVoxel<uint32_t, SparseColumns<uint32_t>&> mv(sparse_data_);
+      traceLine<uint32_t>(mv, x0, y0, z0, x1, y1, z1, max_length);
+    }
   }
 
   void VoxelGrid::clearVoxelLine(double x0, double y0, double z0, double x1, double y1, double z1, unsigned int max_length){
@@ -118,8 +317,22 @@ namespace voxel_grid {
       return;
     }
 
-    ClearVoxel cv(data_);
-    raytraceLine(cv, x0, y0, z0, x1, y1, z1, max_length);
+    if(data64_){
+      ClearVoxel<uint64_t> cv(data64_);
+      traceLine<uint64_t>(cv, x0, y0, z0, x1, y1, z1, max_length);
+    }
+    else if(data_){
+      ClearVoxel<uint32_t> cv(data_);
+      traceLine<uint32_t>(cv, x0, y0, z0, x1, y1, z1, max_length);
+    }
+    else if(tallColumns()){
+      ClearVoxel<uint64_t, SparseColumns<uint64_t>&> cv(sparse_data64_);
+      traceLine<uint64_t>(cv, x0, y0, z0, x1, y1, z1, max_length);
+    }
+    else{
+      ClearVoxel<uint32_t, SparseColumns<uint32_t>&> cv(sparse_data_);
+      traceLine<uint32_t>(cv, x0, y0, z0, x1, y1, z1, max_length);
+    }
   }
 
   void VoxelGrid::clearVoxelLineInMap(double x0, double y0, double z0, double x1, double y1, double z1, unsigned char *map_2d, 
@@ -130,14 +343,104 @@ namespace voxel_grid {
       return;
     }
 
-    if(x0 >= size_x_ || y0 >= size_y_ || z0 >= size_z_ || x1>=size_x_ || y1>=size_y_ || z1>=size_z_){
+    clearVoxelLineInMapRange(x0, y0, z0, x1, y1, z1, map_2d, unknown_threshold, mark_threshold, free_cost, unknown_cost,
+        max_length, 0, UINT_MAX);
+  }
+
+  void VoxelGrid::clearVoxelLineInMapRange(double x0, double y0, double z0, double x1, double y1, double z1,
+      unsigned char *map_2d, unsigned int unknown_threshold, unsigned int mark_threshold,
+      unsigned char free_cost, unsigned char unknown_cost, unsigned int max_length,
+      unsigned int min_index, unsigned int max_index){
+    if(x0 >= size_x_ || y0 >= size_y_ || z0 >= size_z_){
       ROS_DEBUG("Error, line endpoint out of bounds. (%.2f, %.2f, %.2f) to (%.2f, %.2f, %.2f),  size: (%d, %d, %d)", x0, y0, z0, x1, y1, z1, 
           size_x_, size_y_, size_z_);
       return;
     }
 
-    ClearVoxelInMap cvm(data_, costmap, unknown_threshold, mark_threshold, free_cost, unknown_cost);
-    raytraceLine(cvm, x0, y0, z0, x1, y1, z1, max_length);
+    double end[3] = {x1, y1, z1};
+    clearVoxelLinesInMap(x0, y0, z0, end, 1, map_2d, unknown_threshold, mark_threshold, free_cost, unknown_cost,
+        max_length, min_index, max_index);
+  }
+
+  void VoxelGrid::clearVoxelLineMasked(double x0, double y0, double z0, double x1, double y1, double z1,
+      unsigned char* mask, unsigned int max_length, unsigned int min_index, unsigned int max_index){
+    if(x0 >= size_x_ || y0 >= size_y_ || z0 >= size_z_ || x1 >= size_x_ || y1 >= size_y_ || z1 >= size_z_){
+      ROS_DEBUG("Error, line endpoint out of bounds. (%.2f, %.2f, %.2f) to (%.2f, %.2f, %.2f),  size: (%d, %d, %d)", x0, y0, z0, x1, y1, z1,
+          size_x_, size_y_, size_z_);
+      return;
+    }
+
+    if(data64_)
+      traceLine<uint64_t>(ClearVoxelMasked<uint64_t>(data64_, mask, min_index, max_index), x0, y0, z0, x1, y1, z1, max_length);
+    else if(data_)
+      traceLine<uint32_t>(ClearVoxelMasked<uint32_t>(data_, mask, min_index, max_index), x0, y0, z0, x1, y1, z1, max_length);
+    else if(tallColumns())
+      traceLine<uint64_t>(ClearVoxelMasked<uint64_t, SparseColumns<uint64_t>&>(sparse_data64_, mask, min_index, max_index),
+          x0, y0, z0, x1, y1, z1, max_length);
+    else
+      traceLine<uint32_t>(ClearVoxelMasked<uint32_t, SparseColumns<uint32_t>&>(sparse_data_, mask, min_index, max_index),
+          x0, y0, z0, x1, y1, z1, max_length);
+  }
+
+  void VoxelGrid::projectColumns(unsigned int index, unsigned int count, unsigned char* map_2d, unsigned char* mask,
+      unsigned int unknown_threshold, unsigned int mark_threshold, unsigned char free_cost, unsigned char unknown_cost){
+    ROS_ASSERT(index + count <= size_x_ * size_y_);
+    unsigned int end = index + count;
+#ifdef __SSE2__
+    if(data_)
+      index = projectColumns16(data_, index, end, map_2d, mask, unknown_threshold, mark_threshold, free_cost, unknown_cost);
+#endif
+    for(; index < end; ++index){
+      if(!mask[index])
+        continue;
+      mask[index] = 0;
+      if(tallColumns())
+        projectColumn(readColumn64(index), map_2d + index, unknown_threshold, mark_threshold, free_cost, unknown_cost);
+      else
+        projectColumn(readColumn32(index), map_2d + index, unknown_threshold, mark_threshold, free_cost, unknown_cost);
+    }
+  }
+
+  void VoxelGrid::clearVoxelLines(double x0, double y0, double z0, const double* ends, unsigned int count,
+      unsigned int max_length){
+    if(x0 >= size_x_ || y0 >= size_y_ || z0 >= size_z_){
+      ROS_DEBUG("Error, line origin out of bounds. (%.2f, %.2f, %.2f),  size: (%d, %d, %d)", x0, y0, z0,
+          size_x_, size_y_, size_z_);
+      return;
+    }
+
+    if(data64_)
+      clearLines<uint64_t>(data64_, x0, y0, z0, ends, count, max_length);
+    else if(data_)
+      clearLines<uint32_t>(data_, x0, y0, z0, ends, count, max_length);
+    else if(tallColumns())
+      clearLines<uint64_t, SparseColumns<uint64_t>&>(sparse_data64_, x0, y0, z0, ends, count, max_length);
+    else
+      clearLines<uint32_t, SparseColumns<uint32_t>&>(sparse_data_, x0, y0, z0, ends, count, max_length);
+  }
+
+  void VoxelGrid::clearVoxelLinesInMap(double x0, double y0, double z0, const double* ends, unsigned int count,
+      unsigned char *map_2d, unsigned int unknown_threshold, unsigned int mark_threshold,
+      unsigned char free_cost, unsigned char unknown_cost, unsigned int max_length,
+      unsigned int min_index, unsigned int max_index){
+    if(x0 >= size_x_ || y0 >= size_y_ || z0 >= size_z_){
+      ROS_DEBUG("Error, line origin out of bounds. (%.2f, %.2f, %.2f),  size: (%d, %d, %d)", x0, y0, z0,
+          size_x_, size_y_, size_z_);
+      return;
+    }
+
+    if(data64_)
+      clearLinesInMap<uint64_t>(data64_, x0, y0, z0, ends, count, map_2d, unknown_threshold, mark_threshold,
+          free_cost, unknown_cost, max_length, min_index, max_index);
+    else if(data_)
+      clearLinesInMap<uint32_t>(data_, x0, y0, z0, ends, count, map_2d, unknown_threshold, mark_threshold,
+          free_cost, unknown_cost, max_length, min_index, max_index);
+    else if(tallColumns())
+      clearLinesInMap<uint64_t, SparseColumns<uint64_t>&>(sparse_data64_, x0, y0, z0, ends, count, map_2d,
+          unknown_threshold, mark_threshold, free_cost, unknown_cost, max_length, min_index, max_index);
+    else
+      clearLinesInMap<uint32_t, SparseColumns<uint32_t>&>(sparse_data_, x0, y0, z0, ends, count, map_2d,
+          unknown_threshold, mark_threshold, free_cost, unknown_cost, max_length, min_index, max_index);
   }
 
   VoxelStatus VoxelGrid::getVoxel(unsigned int x, unsigned int y, unsigned int z)
@@ -146,9 +449,12 @@ namespace voxel_grid {
       ROS_DEBUG("Error, voxel out of bounds. (%d, %d, %d)\n", x, y, z);
       return UNKNOWN;
     }
-    uint32_t full_mask = ((uint32_t)1<<z<<16) | (1<<z);
-    uint32_t result = data_[y * size_x_ + x] & full_mask; 
-    unsigned int bits = numBits(result);
+    unsigned int index = y * size_x_ + x;
+    unsigned int bits;
+    if(tallColumns())
+      bits = voxel_grid::numBits(readColumn64(index) & ColumnTraits<uint64_t>::mask(z));
+    else
+      bits = voxel_grid::numBits(readColumn32(index) & ColumnTraits<uint32_t>::mask(z));
 
     // known marked: 11 = 2 bits, unknown: 01 = 1 bit, known free: 00 = 0 bits
     if(bits < 2){
@@ -168,21 +474,10 @@ namespace voxel_grid {
       return UNKNOWN;
     }
     
-    uint32_t* col = &data_[y * size_x_ + x];
-
-    unsigned int unknown_bits = uint16_t(*col>>16) ^ uint16_t(*col);
-    unsigned int marked_bits = *col>>16;
-
-    //check if the number of marked bits qualifies the col as marked
-    if(!bitsBelowThreshold(marked_bits, marked_threshold)){
-      return MARKED;
-    }
-
-    //check if the number of unkown bits qualifies the col as unknown
-    if(!bitsBelowThreshold(unknown_bits, unknown_threshold))
-      return UNKNOWN;
-
-    return FREE;
+    unsigned int index = y * size_x_ + x;
+    if(tallColumns())
+      return getColumnStatus(readColumn64(index), unknown_threshold, marked_threshold);
+    return getColumnStatus(readColumn32(index), unknown_threshold, marked_threshold);
   }
 
   unsigned int VoxelGrid::sizeX(){
@@ -213,7 +508,7 @@ namespace voxel_grid {
     printf("Column view:\n");
     for(unsigned int y = 0; y < size_y_; y++){
       for(unsigned int x = 0 ; x < size_x_; x++){
-        printf((getVoxelColumn(x, y, 16, 0) == voxel_grid::MARKED)? "#" : " ");
+        printf((getVoxelColumn(x, y, columnHeight(), 0) == voxel_grid::MARKED)? "#" : " ");
       }
       printf("|\n");
     } 
@@ -36,6 +36,7 @@
 *********************************************************************/
 #include <voxel_grid/voxel_grid.h>
 #include <sys/time.h>
+#include <vector>
 #include <ros/console.h>
 
 int main(int argc, char *argv[]){
@@ -75,6 +76,33 @@ int main(int argc, char *argv[]){
   t_diff = end_t - start_t;
   ROS_INFO("Cycle time: %.9f\n", t_diff);
 
+  //steep lines from a common origin, as seen by a camera looking down, cleared one by one and as a batch
+  voxel_grid::VoxelGrid *tall = new voxel_grid::VoxelGrid(size_x, size_y, 16);
+  std::vector<double> ends;
+  for(int i = 0; i < 700; ++i){
+    ends.push_back(500.5 + (i % 7) - 3);
+    ends.push_back(500.5 + (i / 7 % 7) - 3);
+    ends.push_back(0.5);
+  }
+  gettimeofday(&start, NULL);
+  for(unsigned int j = 0; j < 1000; ++j){
+    for(unsigned int i = 0; i < 700; ++i){
+      tall->clearVoxelLineInMap(500.5, 500.5, 15.5, ends[3 * i], ends[3 * i + 1], ends[3 * i + 2], costMap, 16, 0);
+    }
+  }
+  gettimeofday(&end, NULL);
+  t_diff = (end.tv_sec - start.tv_sec) + double(end.tv_usec - start.tv_usec) / 1e6;
+  ROS_INFO("Steep clearing time, single lines: %.9f\n", t_diff);
+
+  gettimeofday(&start, NULL);
+  for(unsigned int j = 0; j < 1000; ++j){
+    tall->clearVoxelLinesInMap(500.5, 500.5, 15.5, &ends[0], 700, costMap, 16, 0);
+  }
+  gettimeofday(&end, NULL);
+  t_diff = (end.tv_sec - start.tv_sec) + double(end.tv_usec - start.tv_usec) / 1e6;
+  ROS_INFO("Steep clearing time, batch: %.9f\n", t_diff);
+  delete tall;
+
   //clear a scan next to the table (will clear obstacles out)
   v->clearVoxelLineInMap(table_x_max + 1, 0, table_z, table_x_max + 1, size_y - 1, table_z, costMap, 16, 0);
 
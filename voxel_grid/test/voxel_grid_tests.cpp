@@ -36,6 +36,9 @@
 *********************************************************************/
 #include <voxel_grid/voxel_grid.h>
 #include <gtest/gtest.h>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
 
 TEST(voxel_grid, basicMarkingAndClearing){
   int size_x = 50, size_y = 10, size_z = 16;
@@ -129,6 +132,293 @@ TEST(voxel_grid, basicMarkingAndClearing){
 
 }
 
+TEST(voxel_grid, clearingSplitOverColumnRanges){
+  int size_x = 40, size_y = 30, size_z = 16;
+  voxel_grid::VoxelGrid full(size_x, size_y, size_z), split(size_x, size_y, size_z);
+  std::vector<unsigned char> full_map(size_x * size_y, 255), split_map(size_x * size_y, 255);
+
+  for(int x = 0; x < size_x; ++x){
+    full.markVoxelLine(x, 0, 5, x, size_y - 1, 5);
+    split.markVoxelLine(x, 0, 5, x, size_y - 1, 5);
+  }
+
+  //a fan of lines from one origin, cleared at once and in three bands of rows
+  unsigned int bands[4] = {0, 7u * size_x, 19u * size_x, 1u * size_x * size_y};
+  for(int i = 0; i < 20; ++i){
+    double x1 = 0.5 + i * (size_x - 1) / 20.0, y1 = size_y - 0.5, z1 = 5.5 - i % 3;
+    full.clearVoxelLineInMap(20.5, 2.5, 5.5, x1, y1, z1, &full_map[0], 0, 0, 0, 255);
+    for(int band = 0; band < 3; ++band){
+      split.clearVoxelLineInMapRange(20.5, 2.5, 5.5, x1, y1, z1, &split_map[0], 0, 0, 0, 255, UINT_MAX,
+          bands[band], bands[band + 1]);
+    }
+  }
+
+  for(int x = 0; x < size_x; ++x){
+    for(int y = 0; y < size_y; ++y){
+      ASSERT_EQ(full_map[y * size_x + x], split_map[y * size_x + x]);
+      for(int z = 0; z < size_z; ++z){
+        ASSERT_EQ(full.getVoxel(x, y, z), split.getVoxel(x, y, z));
+      }
+    }
+  }
+}
+
+//walks a line that is dominant in z one voxel at a time, marking the columns it passes
+static void clearLineStepwise(voxel_grid::VoxelGrid& vg, int x0, int y0, int z0, int x1, int y1, int z1,
+    std::vector<bool>& touched){
+  int dx = x1 - x0, dy = y1 - y0, dz = z1 - z0;
+  int abs_dx = abs(dx), abs_dy = abs(dy), abs_dz = abs(dz);
+  int error_x = abs_dz / 2, error_y = abs_dz / 2;
+  int x = x0, y = y0, z = z0;
+  for(int i = 0; i < abs_dz; ++i){
+    vg.clearVoxel(x, y, z);
+    touched[y * vg.sizeX() + x] = true;
+    z += dz > 0 ? 1 : -1;
+    error_x += abs_dx;
+    if(error_x >= abs_dz){
+      x += dx > 0 ? 1 : -1;
+      error_x -= abs_dz;
+    }
+    error_y += abs_dy;
+    if(error_y >= abs_dz){
+      y += dy > 0 ? 1 : -1;
+      error_y -= abs_dz;
+    }
+  }
+  vg.clearVoxel(x, y, z);
+  touched[y * vg.sizeX() + x] = true;
+}
+
+static void checkSteepLines(int size_z){
+  int size_x = 8, size_y = 8;
+  voxel_grid::VoxelGrid lines(size_x, size_y, size_z), steps(size_x, size_y, size_z);
+  std::vector<unsigned char> map(size_x * size_y, 128);
+  std::vector<bool> touched(size_x * size_y, false);
+
+  srand(7);
+  for(int i = 0; i < 200; ++i){
+    int x = rand() % size_x, y = rand() % size_y, z = rand() % size_z;
+    lines.markVoxel(x, y, z);
+    steps.markVoxel(x, y, z);
+  }
+
+  for(int i = 0; i < 50; ++i){
+    int x0 = rand() % 4 + 2, y0 = rand() % 4 + 2, z0 = rand() % 3;
+    int x1 = x0 + rand() % 5 - 2, y1 = y0 + rand() % 5 - 2, z1 = size_z - 1 - rand() % 3;
+    if(i % 2)
+      std::swap(z0, z1);
+    lines.clearVoxelLineInMap(x0, y0, z0, x1, y1, z1, &map[0], 1, 1, 0, 255);
+    clearLineStepwise(steps, x0, y0, z0, x1, y1, z1, touched);
+  }
+
+  for(int x = 0; x < size_x; ++x){
+    for(int y = 0; y < size_y; ++y){
+      unsigned int marked = 0, unknown = 0;
+      for(int z = 0; z < size_z; ++z){
+        voxel_grid::VoxelStatus status = steps.getVoxel(x, y, z);
+        ASSERT_EQ(status, lines.getVoxel(x, y, z));
+        marked += status == voxel_grid::MARKED;
+        unknown += status == voxel_grid::UNKNOWN;
+      }
+
+      //the map holds the state of the column after the last line passed it, unused bits count as unknown
+      unknown += lines.columnHeight() - size_z;
+      unsigned char expected = 128;
+      if(touched[y * size_x + x] && marked <= 1)
+        expected = unknown <= 1 ? 0 : 255;
+      ASSERT_EQ(expected, map[y * size_x + x]);
+    }
+  }
+}
+
+TEST(voxel_grid, steepLinesClearColumnRuns){
+  checkSteepLines(16);
+  checkSteepLines(28);
+}
+
+TEST(voxel_grid, tallColumns){
+  voxel_grid::VoxelGrid vg(5, 4, 30);
+  ASSERT_EQ(30u, vg.sizeZ());
+  ASSERT_EQ(32u, vg.columnHeight());
+  ASSERT_TRUE(vg.getData() == NULL);
+
+  //mark a vertical line through the whole column and a few voxels above 16
+  vg.markVoxelLine(1, 1, 0, 1, 1, 29);
+  vg.markVoxel(3, 2, 17);
+  vg.markVoxel(3, 2, 29);
+  for(unsigned int z = 0; z < 30; ++z){
+    ASSERT_EQ(voxel_grid::MARKED, vg.getVoxel(1, 1, z));
+  }
+  ASSERT_EQ(voxel_grid::MARKED, vg.getVoxel(3, 2, 17));
+  ASSERT_EQ(voxel_grid::UNKNOWN, vg.getVoxel(3, 2, 16));
+  ASSERT_EQ(voxel_grid::MARKED, vg.getVoxelColumn(3, 2, 32, 1));
+  ASSERT_EQ(voxel_grid::FREE, vg.getVoxelColumn(3, 2, 32, 2));
+
+  //the copied words decode to the same voxels
+  std::vector<uint32_t> words(vg.dataWords());
+  ASSERT_EQ(2u * 5 * 4, words.size());
+  vg.copyData(&words[0]);
+  for(unsigned int x = 0; x < 5; ++x){
+    for(unsigned int y = 0; y < 4; ++y){
+      for(unsigned int z = 0; z < 30; ++z){
+        ASSERT_EQ(vg.getVoxel(x, y, z), voxel_grid::VoxelGrid::getVoxel(x, y, z, 5, 4, 30, &words[0]));
+      }
+    }
+  }
+
+  //so do the words of a region
+  std::vector<uint32_t> region(2 * 3 * 2);
+  vg.copyData(&region[0], 2, 1, 3, 2);
+  for(unsigned int j = 0; j < 2; ++j){
+    for(unsigned int i = 0; i < 3 * 2; ++i){
+      ASSERT_EQ(words[((1 + j) * 5 + 2) * 2 + i], region[j * 3 * 2 + i]);
+    }
+  }
+
+  //clearing the top of the column leaves the bottom marked
+  vg.clearVoxelLine(1, 1, 29, 1, 1, 20);
+  ASSERT_EQ(voxel_grid::FREE, vg.getVoxel(1, 1, 25));
+  ASSERT_EQ(voxel_grid::MARKED, vg.getVoxel(1, 1, 19));
+
+  //shrinking the grid goes back to 32 bit columns
+  vg.resize(5, 4, 10);
+  ASSERT_EQ(16u, vg.columnHeight());
+  ASSERT_TRUE(vg.getData64() == NULL);
+  ASSERT_EQ(voxel_grid::UNKNOWN, vg.getVoxel(1, 1, 5));
+}
+
+TEST(voxel_grid, batchClearingMatchesSingleLines){
+  int size_x = 30, size_y = 30, size_z = 16;
+  voxel_grid::VoxelGrid single(size_x, size_y, size_z), batch(size_x, size_y, size_z), plain(size_x, size_y, size_z);
+  std::vector<unsigned char> single_map(size_x * size_y, 128), batch_map(size_x * size_y, 128);
+
+  srand(3);
+  std::vector<double> ends;
+  for(int i = 0; i < 100; ++i){
+    ends.push_back(rand() % size_x + 0.5);
+    ends.push_back(rand() % size_y + 0.5);
+    ends.push_back(rand() % size_z + 0.5);
+    single.clearVoxelLineInMap(15.5, 15.5, 8.5, ends[3 * i], ends[3 * i + 1], ends[3 * i + 2], &single_map[0], 0, 0);
+  }
+  batch.clearVoxelLinesInMap(15.5, 15.5, 8.5, &ends[0], 100, &batch_map[0], 0, 0);
+  plain.clearVoxelLines(15.5, 15.5, 8.5, &ends[0], 100);
+
+  for(int x = 0; x < size_x; ++x){
+    for(int y = 0; y < size_y; ++y){
+      ASSERT_EQ(single_map[y * size_x + x], batch_map[y * size_x + x]);
+      for(int z = 0; z < size_z; ++z){
+        ASSERT_EQ(single.getVoxel(x, y, z), batch.getVoxel(x, y, z));
+        ASSERT_EQ(single.getVoxel(x, y, z), plain.getVoxel(x, y, z));
+      }
+    }
+  }
+}
+
+static void checkSparseMatchesDense(int size_z){
+  int size_x = 200, size_y = 150;
+  voxel_grid::VoxelGrid dense(size_x, size_y, size_z), sparse(size_x, size_y, size_z);
+  sparse.setSparse(true);
+  ASSERT_TRUE(sparse.isSparse());
+  ASSERT_TRUE(sparse.getData() == NULL && sparse.getData64() == NULL);
+  ASSERT_EQ(0u, sparse.allocatedColumns());
+  ASSERT_EQ(voxel_grid::UNKNOWN, sparse.getVoxel(10, 10, 1));
+
+  //observe a small corner of the grid only
+  std::vector<unsigned char> dense_map(size_x * size_y, 128), sparse_map(size_x * size_y, 128);
+  srand(5);
+  for(int i = 0; i < 50; ++i){
+    double x = rand() % 20 + 0.5, y = rand() % 20 + 0.5, z = rand() % size_z + 0.5;
+    dense.clearVoxelLineInMap(10.5, 10.5, 1.5, x, y, z, &dense_map[0], 0, 0);
+    sparse.clearVoxelLineInMap(10.5, 10.5, 1.5, x, y, z, &sparse_map[0], 0, 0);
+    dense.markVoxelInMap(x, y, z, 0);
+    sparse.markVoxelInMap(x, y, z, 0);
+  }
+  ASSERT_GT(sparse.allocatedColumns(), 0u);
+  ASSERT_LT(sparse.allocatedColumns(), (unsigned int)(size_x * size_y / 10));
+
+  //free a run of columns across the observed part and beyond it
+  dense.clearVoxelColumns(5 * size_x + 3, 30);
+  sparse.clearVoxelColumns(5 * size_x + 3, 30);
+  ASSERT_EQ(voxel_grid::FREE, sparse.getVoxelColumn(32, 5, 0, 0));
+
+  //move the grid and compare everything, including what publishing would copy
+  dense.shift(-7, 3);
+  sparse.shift(-7, 3);
+  std::vector<uint32_t> dense_words(dense.dataWords()), sparse_words(sparse.dataWords());
+  dense.copyData(&dense_words[0]);
+  sparse.copyData(&sparse_words[0]);
+  ASSERT_TRUE(dense_words == sparse_words);
+  ASSERT_TRUE(dense_map == sparse_map);
+
+  //a region copies the same columns as the whole grid
+  std::vector<uint32_t> dense_region(4 * 3 * 2), sparse_region(4 * 3 * 2);
+  dense.copyData(&dense_region[0], 2, 4, 4, 3);
+  sparse.copyData(&sparse_region[0], 2, 4, 4, 3);
+  ASSERT_TRUE(dense_region == sparse_region);
+  unsigned int words_per_column = dense.dataWords() / (size_x * size_y);
+  for(unsigned int j = 0; j < 3; ++j){
+    for(unsigned int i = 0; i < 4 * words_per_column; ++i){
+      ASSERT_EQ(dense_words[((4 + j) * size_x + 2) * words_per_column + i], dense_region[j * 4 * words_per_column + i]);
+    }
+  }
+  for(int x = 0; x < size_x; ++x){
+    for(int y = 0; y < size_y; ++y){
+      ASSERT_EQ(dense.getVoxelColumn(x, y, 0, 0), sparse.getVoxelColumn(x, y, 0, 0));
+    }
+  }
+
+  //resetting releases the storage
+  sparse.reset();
+  ASSERT_EQ(0u, sparse.allocatedColumns());
+  ASSERT_EQ(voxel_grid::UNKNOWN, sparse.getVoxel(10, 10, 1));
+}
+
+TEST(voxel_grid, sparseStorageMatchesDense){
+  checkSparseMatchesDense(10);
+  checkSparseMatchesDense(28);
+}
+
+static void checkProjectionMatchesClearing(int size_z, bool sparse, unsigned int unknown_threshold,
+    unsigned int mark_threshold){
+  int size_x = 37, size_y = 29;
+  voxel_grid::VoxelGrid single(size_x, size_y, size_z), masked(size_x, size_y, size_z);
+  single.setSparse(sparse);
+  masked.setSparse(sparse);
+  std::vector<unsigned char> single_map(size_x * size_y, 128), masked_map(size_x * size_y, 128);
+  std::vector<unsigned char> mask(size_x * size_y, 0);
+
+  //some obstacles for the lines to clear around and through
+  srand(7);
+  for(int i = 0; i < 200; ++i){
+    unsigned int x = rand() % size_x, y = rand() % size_y, z = rand() % size_z;
+    single.markVoxelInMap(x, y, z, mark_threshold);
+    masked.markVoxelInMap(x, y, z, mark_threshold);
+  }
+
+  for(int i = 0; i < 100; ++i){
+    double x = rand() % size_x + 0.5, y = rand() % size_y + 0.5, z = rand() % size_z + 0.5;
+    single.clearVoxelLineInMap(18.5, 14.5, 1.5, x, y, z, &single_map[0], unknown_threshold, mark_threshold);
+    masked.clearVoxelLineMasked(18.5, 14.5, 1.5, x, y, z, &mask[0]);
+  }
+  masked.projectColumns(0, size_x * size_y, &masked_map[0], &mask[0], unknown_threshold, mark_threshold);
+
+  ASSERT_TRUE(single_map == masked_map);
+  ASSERT_TRUE(std::vector<unsigned char>(size_x * size_y, 0) == mask);
+  for(int x = 0; x < size_x; ++x){
+    for(int y = 0; y < size_y; ++y){
+      ASSERT_EQ(single.getVoxelColumn(x, y, 0, 0), masked.getVoxelColumn(x, y, 0, 0));
+    }
+  }
+}
+
+TEST(voxel_grid, projectionMatchesClearingInMap){
+  checkProjectionMatchesClearing(16, false, 0, 0);
+  checkProjectionMatchesClearing(16, false, 4, 2);
+  checkProjectionMatchesClearing(16, true, 0, 0);
+  checkProjectionMatchesClearing(28, false, 3, 1);
+  checkProjectionMatchesClearing(28, true, 0, 0);
+}
+
 int main(int argc, char** argv){
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();